@@ -0,0 +1,387 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <thread>
+
+#include "json.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/oflog/oflog.h"
+
+using json = nlohmann::json;
+
+namespace bench
+{
+
+namespace
+{
+
+std::vector<Benchmark*>& benchmarks()
+{
+    static std::vector<Benchmark*> registered;
+    return registered;
+}
+
+std::vector<std::function<void()>>& teardowns()
+{
+    static std::vector<std::function<void()>> registered;
+    return registered;
+}
+
+std::map<std::string, std::string>& options()
+{
+    static std::map<std::string, std::string> parsed;
+    return parsed;
+}
+
+std::string humanTime(double nanoseconds)
+{
+    char buffer[32];
+    if (nanoseconds < 1e3) {
+        snprintf(buffer, sizeof(buffer), "%.1f ns", nanoseconds);
+    } else if (nanoseconds < 1e6) {
+        snprintf(buffer, sizeof(buffer), "%.1f us", nanoseconds / 1e3);
+    } else if (nanoseconds < 1e9) {
+        snprintf(buffer, sizeof(buffer), "%.1f ms", nanoseconds / 1e6);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.2f s", nanoseconds / 1e9);
+    }
+    return buffer;
+}
+
+std::string humanRate(double perSecond, const char* unit)
+{
+    char buffer[32];
+    if (perSecond >= 1e9) {
+        snprintf(buffer, sizeof(buffer), "%.2fG %s/s", perSecond / 1e9, unit);
+    } else if (perSecond >= 1e6) {
+        snprintf(buffer, sizeof(buffer), "%.2fM %s/s", perSecond / 1e6, unit);
+    } else if (perSecond >= 1e3) {
+        snprintf(buffer, sizeof(buffer), "%.2fk %s/s", perSecond / 1e3, unit);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.2f %s/s", perSecond, unit);
+    }
+    return buffer;
+}
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+State::State(uint64_t iterations, const std::vector<int64_t>& args)
+    : _iterations(iterations), _args(args), _running(false), _started(false), _cpuStart(0),
+      _realSeconds(0), _cpuSeconds(0), _items(0), _bytes(0)
+{
+}
+
+bool State::Iterator::operator!=(const Iterator& /*end*/) const
+{
+    if (_remaining > 0 && _state->_error.empty()) {
+        return true;
+    }
+    _state->stop();
+    return false;
+}
+
+State::Iterator State::begin()
+{
+    _started = true;
+    start();
+    return Iterator(this, _iterations);
+}
+
+void State::PauseTiming()
+{
+    stop();
+}
+
+void State::ResumeTiming()
+{
+    start();
+}
+
+void State::SkipWithError(const std::string& message)
+{
+    _error = message;
+}
+
+void State::start()
+{
+    if (!_running) {
+        _running = true;
+        _realStart = std::chrono::steady_clock::now();
+        _cpuStart = std::clock();
+    }
+}
+
+void State::stop()
+{
+    if (_running) {
+        _running = false;
+        _realSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - _realStart).count();
+        _cpuSeconds += static_cast<double>(std::clock() - _cpuStart) / CLOCKS_PER_SEC;
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+Benchmark* Benchmark::Arg(int64_t arg)
+{
+    _args.push_back(arg);
+    return this;
+}
+
+Benchmark* Benchmark::Iterations(uint64_t iterations)
+{
+    _iterations = iterations;
+    return this;
+}
+
+Benchmark* registerBenchmark(const char* name, Function function)
+{
+    Benchmark* benchmark = new Benchmark(name, function);
+    benchmarks().push_back(benchmark);
+    return benchmark;
+}
+
+void registerTeardown(const std::function<void()>& teardown)
+{
+    teardowns().push_back(teardown);
+}
+
+std::string option(const std::string& name, const std::string& fallback)
+{
+    std::map<std::string, std::string>::const_iterator it = options().find(name);
+    return it != options().end() ? it->second : fallback;
+}
+
+//--------------------------------------------------------------------------------------------
+
+class Runner
+{
+public:
+    // runs one benchmark with one argument list, grows the iterations like Google Benchmark until
+    // the run takes minTime
+    static json run(const Benchmark& benchmark, const std::string& name, const std::vector<int64_t>& args, double minTime)
+    {
+        uint64_t iterations = benchmark._iterations > 0 ? benchmark._iterations : 1;
+        while (true) {
+            State state(iterations, args);
+            benchmark._function(state);
+            if (!state._error.empty() || !state._started) {
+                json result = {{"name", name}, {"run_name", name}, {"run_type", "iteration"}, {"iterations", 0},
+                    {"error_occurred", true}, {"error_message", state._error.empty() ? "benchmark did not run its loop" : state._error}};
+                return result;
+            }
+            const uint64_t maxIterations = 1000000000;
+            if (benchmark._iterations > 0 || state._realSeconds >= minTime || iterations >= maxIterations) {
+                return report(name, state);
+            }
+            // at most 10 times more iterations per step, aiming a bit beyond minTime
+            double multiplier = state._realSeconds > 0 ? minTime * 1.4 / state._realSeconds : 10;
+            multiplier = std::min(std::max(multiplier, 1.0), 10.0);
+            iterations = std::min(std::max(static_cast<uint64_t>(iterations * multiplier), iterations + 1), maxIterations);
+        }
+    }
+
+    static json report(const std::string& name, const State& state)
+    {
+        const double n = static_cast<double>(state._iterations);
+        json result = json::object();
+        result["name"] = name;
+        result["run_name"] = name;
+        result["run_type"] = "iteration";
+        result["iterations"] = state._iterations;
+        result["real_time"] = state._realSeconds * 1e9 / n;
+        result["cpu_time"] = state._cpuSeconds * 1e9 / n;
+        result["time_unit"] = "ns";
+        if (state._items > 0 && state._realSeconds > 0) {
+            result["items_per_second"] = state._items / state._realSeconds;
+        }
+        if (state._bytes > 0 && state._realSeconds > 0) {
+            result["bytes_per_second"] = state._bytes / state._realSeconds;
+        }
+        if (!state._label.empty()) {
+            result["label"] = state._label;
+        }
+        for (const auto& counter : state.counters) {
+            result[counter.first] = counter.second;
+        }
+        return result;
+    }
+
+    static const std::vector<Benchmark*>& all() { return benchmarks(); }
+
+    static std::vector<std::string> names(const Benchmark& benchmark)
+    {
+        std::vector<std::string> result;
+        if (benchmark._args.empty()) {
+            result.push_back(benchmark._name);
+        }
+        for (int64_t arg : benchmark._args) {
+            result.push_back(benchmark._name + "/" + std::to_string(arg));
+        }
+        return result;
+    }
+
+    static std::vector<int64_t> args(const Benchmark& benchmark, size_t index)
+    {
+        std::vector<int64_t> result;
+        if (!benchmark._args.empty()) {
+            result.push_back(benchmark._args[index]);
+        }
+        return result;
+    }
+};
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+namespace
+{
+
+void printResult(const json& result)
+{
+    char line[256];
+    if (result.value("error_occurred", false)) {
+        snprintf(line, sizeof(line), "%-44s ERROR: %s", result["name"].get<std::string>().c_str(),
+            result["error_message"].get<std::string>().c_str());
+        std::cout << line << std::endl;
+        return;
+    }
+    std::string rate;
+    if (result.count("items_per_second")) {
+        rate = bench::humanRate(result["items_per_second"].get<double>(), "items");
+    } else if (result.count("bytes_per_second")) {
+        rate = bench::humanRate(result["bytes_per_second"].get<double>(), "B");
+    }
+    snprintf(line, sizeof(line), "%-44s %12s %12s %12llu  %s", result["name"].get<std::string>().c_str(),
+        bench::humanTime(result["real_time"].get<double>()).c_str(), bench::humanTime(result["cpu_time"].get<double>()).c_str(),
+        static_cast<unsigned long long>(result["iterations"].get<uint64_t>()), rate.c_str());
+    std::cout << line << std::endl;
+}
+
+// relative change of the time per iteration against the same benchmarks of a previous --benchmark_out file
+void printComparison(const json& results, const std::string& baselinePath)
+{
+    std::ifstream in(baselinePath.c_str());
+    json baseline = json::parse(in, nullptr, false);
+    if (baseline.is_discarded() || !baseline.count("benchmarks")) {
+        std::cerr << "cannot read baseline " << baselinePath << std::endl;
+        return;
+    }
+    std::map<std::string, double> before;
+    for (const json& b : baseline["benchmarks"]) {
+        if (b.count("real_time")) {
+            before[b["name"].get<std::string>()] = b["real_time"].get<double>();
+        }
+    }
+    std::cout << std::endl << "compared to " << baselinePath << ":" << std::endl;
+    for (const json& result : results) {
+        std::map<std::string, double>::const_iterator it = before.find(result["name"].get<std::string>());
+        if (it == before.end() || !result.count("real_time") || it->second <= 0) {
+            continue;
+        }
+        char line[256];
+        const double now = result["real_time"].get<double>();
+        snprintf(line, sizeof(line), "%-44s %12s -> %12s  %+6.1f%%", it->first.c_str(), bench::humanTime(it->second).c_str(),
+            bench::humanTime(now).c_str(), (now - it->second) * 100 / it->second);
+        std::cout << line << std::endl;
+    }
+}
+
+std::string isoDate()
+{
+    std::time_t now = std::time(NULL);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+    return buffer;
+}
+
+}
+
+// --benchmark_filter=<regex>, --benchmark_min_time=<seconds>, --benchmark_list_tests,
+// --benchmark_out=<file> for the JSON results, --benchmark_context=<key>=<value> (repeatable, e.g. the
+// release version), --compare=<file> to print the change against a previous --benchmark_out file.
+// Other --name=value options are read by the benchmarks through bench::option()
+int main(int argc, char* argv[])
+{
+    json context = json::object();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg.compare(0, 2, "--") != 0) {
+            std::cerr << "unknown argument " << arg << std::endl;
+            return 1;
+        }
+        const size_t equals = arg.find('=');
+        const std::string name = arg.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+        const std::string value = equals == std::string::npos ? "true" : arg.substr(equals + 1);
+        if (name == "benchmark_context") {
+            const size_t split = value.find('=');
+            context[value.substr(0, split)] = split == std::string::npos ? "" : value.substr(split + 1);
+        } else {
+            bench::options()[name] = value;
+        }
+    }
+
+    OFLog::configure(OFLogger::WARN_LOG_LEVEL);
+    const std::regex filter(bench::option("benchmark_filter", "."));
+    const double minTime = std::stod(bench::option("benchmark_min_time", "0.5"));
+    const bool list = bench::option("benchmark_list_tests", "false") == "true";
+
+    context["date"] = isoDate();
+    context["executable"] = argv[0];
+    context["num_cpus"] = std::thread::hardware_concurrency();
+    context["dcmtk_version"] = OFFIS_DCMTK_VERSION;
+#ifdef NDEBUG
+    context["library_build_type"] = "release";
+#else
+    context["library_build_type"] = "debug";
+#endif
+
+    if (!list) {
+        char header[256];
+        snprintf(header, sizeof(header), "%-44s %12s %12s %12s", "Benchmark", "Time", "CPU", "Iterations");
+        std::cout << header << std::endl << std::string(84, '-') << std::endl;
+    }
+    json results = json::array();
+    for (const bench::Benchmark* benchmark : bench::Runner::all()) {
+        std::vector<std::string> names = bench::Runner::names(*benchmark);
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (!std::regex_search(names[i], filter)) {
+                continue;
+            }
+            if (list) {
+                std::cout << names[i] << std::endl;
+                continue;
+            }
+            json result = bench::Runner::run(*benchmark, names[i], bench::Runner::args(*benchmark, i), minTime);
+            printResult(result);
+            results.push_back(result);
+        }
+    }
+    for (const std::function<void()>& teardown : bench::teardowns()) {
+        teardown();
+    }
+
+    const std::string out = bench::option("benchmark_out", "");
+    if (!out.empty()) {
+        std::ofstream file(out.c_str());
+        file << json({{"context", context}, {"benchmarks", results}}).dump(2) << std::endl;
+        if (!file) {
+            std::cerr << "cannot write " << out << std::endl;
+            return 1;
+        }
+    }
+    const std::string baseline = bench::option("compare", "");
+    if (!baseline.empty()) {
+        printComparison(results, baseline);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness following the Google Benchmark API, so benchmarks read the same and the
+// results (--benchmark_out) can be compared with Google Benchmark's tools/compare.py:
+//
+//     static void BM_Example(bench::State& state) {
+//         setup();                      // not timed
+//         for (auto _ : state) {
+//             work(state.range(0));
+//         }
+//         state.SetItemsProcessed(state.iterations() * state.range(0));
+//     }
+//     BENCHMARK(BM_Example)->Arg(10000)->Arg(1000000);
+namespace bench
+{
+
+class State
+{
+public:
+    State(uint64_t iterations, const std::vector<int64_t>& args);
+
+    // times the loop body, iterations() times
+    class Iterator
+    {
+    public:
+        Iterator(State* state, uint64_t remaining) : _state(state), _remaining(remaining) {}
+        bool operator!=(const Iterator& end) const;
+        void operator++() { --_remaining; }
+        // the loop variable does nothing, its destructor keeps compilers from warning that it is unused
+        struct Value {
+            ~Value() {}
+        };
+        Value operator*() const { return Value(); }
+
+    private:
+        State* _state;
+        uint64_t _remaining;
+    };
+
+    Iterator begin();
+    Iterator end() { return Iterator(this, 0); }
+
+    int64_t range(size_t index = 0) const { return _args.at(index); }
+    uint64_t iterations() const { return _iterations; }
+
+    // excludes per-iteration setup from the measurement
+    void PauseTiming();
+    void ResumeTiming();
+
+    void SetItemsProcessed(int64_t items) { _items = items; }
+    void SetBytesProcessed(int64_t bytes) { _bytes = bytes; }
+    void SetLabel(const std::string& label) { _label = label; }
+    // reported as is next to the timings
+    std::map<std::string, double> counters;
+
+    // stops the benchmark, e.g. when a peer is not reachable
+    void SkipWithError(const std::string& message);
+
+private:
+    friend class Runner;
+    friend class Iterator;
+
+    void start();
+    void stop();
+
+    uint64_t _iterations;
+    std::vector<int64_t> _args;
+    bool _running;
+    bool _started;
+    std::chrono::steady_clock::time_point _realStart;
+    std::clock_t _cpuStart;
+    double _realSeconds;
+    double _cpuSeconds;
+    int64_t _items;
+    int64_t _bytes;
+    std::string _label;
+    std::string _error;
+};
+
+typedef void (*Function)(State&);
+
+class Benchmark
+{
+public:
+    Benchmark(const std::string& name, Function function) : _name(name), _function(function), _iterations(0) {}
+
+    // one run per argument, the argument is part of the name
+    Benchmark* Arg(int64_t arg);
+    // fixed number of iterations instead of running for --benchmark_min_time, for expensive runs
+    Benchmark* Iterations(uint64_t iterations);
+
+private:
+    friend class Runner;
+    std::string _name;
+    Function _function;
+    std::vector<int64_t> _args;
+    uint64_t _iterations;
+};
+
+Benchmark* registerBenchmark(const char* name, Function function);
+
+// called once after all benchmarks ran, e.g. to stop servers shared by the runs of a benchmark
+void registerTeardown(const std::function<void()>& teardown);
+
+// value of a --name=value command line option, fallback if not given
+std::string option(const std::string& name, const std::string& fallback);
+
+// keeps the compiler from optimizing away a result
+template <class T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static const volatile void* sink;
+    sink = &value;
+#endif
+}
+
+}
+
+#define BENCH_CONCAT2(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT2(a, b)
+#define BENCHMARK(function) \
+    static bench::Benchmark* BENCH_CONCAT(benchmark_, __LINE__) = bench::registerBenchmark(#function, function)
@@ -0,0 +1,172 @@
+// encoding and decoding 512x512 12 bit images per transfer syntax with the codecs registered by the addon
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include "Utils.h"
+
+#include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmjpeg/djrplol.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// argument of the codec benchmarks
+const E_TransferSyntax transferSyntaxes[] = {
+    EXS_RLELossless,
+    EXS_JPEGProcess14SV1,
+    EXS_JPEGLSLossless,
+    EXS_JPEGLSLossy,
+    EXS_JPEG2000LosslessOnly,
+    EXS_JPEG2000,
+    EXS_HighThroughputJPEG2000LosslessOnly
+};
+
+void BM_CodecEncode(bench::State& state)
+{
+    ns::registerCodecs();
+    const E_TransferSyntax xfer = transferSyntaxes[state.range(0)];
+    state.SetLabel(DcmXfer(xfer).getXferName());
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, 512, 512);
+    DcmDataset* dataset = file->getDataset();
+    for (auto _ : state) {
+        OFCondition cond = dataset->chooseRepresentation(xfer, NULL);
+        if (cond.bad() || !dataset->canWriteXfer(xfer)) {
+            state.SkipWithError(cond.bad() ? cond.text() : "no encoder");
+            break;
+        }
+        // the next iteration encodes again
+        state.PauseTiming();
+        dataset->removeAllButOriginalRepresentations();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 512 * 512 * 2));
+}
+
+void BM_CodecDecode(bench::State& state)
+{
+    ns::registerCodecs();
+    const E_TransferSyntax xfer = transferSyntaxes[state.range(0)];
+    state.SetLabel(DcmXfer(xfer).getXferName());
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, 512, 512);
+    DcmDataset* compressed = file->getDataset();
+    if (compressed->chooseRepresentation(xfer, NULL).bad() || !compressed->canWriteXfer(xfer)) {
+        state.SkipWithError("no encoder");
+        return;
+    }
+    // only the compressed pixel data remains, as in a received instance
+    compressed->removeAllButCurrentRepresentations();
+    for (auto _ : state) {
+        state.PauseTiming();
+        DcmDataset dataset(*compressed);
+        state.ResumeTiming();
+        OFCondition cond = dataset.chooseRepresentation(EXS_LittleEndianExplicit, NULL);
+        if (cond.bad()) {
+            state.SkipWithError(cond.text());
+            break;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 512 * 512 * 2));
+}
+
+// decoding a 2048x2048 lossless JPEG image with restart intervals of 16 rows,
+// argument is the number of threads decoding the intervals
+void BM_LosslessRestartDecode(bench::State& state)
+{
+    ns::registerCodecs();
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, 2048, 2048);
+    DcmDataset* compressed = file->getDataset();
+    DJ_RPLossless rp(1, 0, 16);
+    if (compressed->chooseRepresentation(EXS_JPEGProcess14SV1, &rp).bad() || !compressed->canWriteXfer(EXS_JPEGProcess14SV1)) {
+        state.SkipWithError("no encoder");
+        return;
+    }
+    compressed->removeAllButCurrentRepresentations();
+    ns::setFrameThreads(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        state.PauseTiming();
+        DcmDataset dataset(*compressed);
+        state.ResumeTiming();
+        OFCondition cond = dataset.chooseRepresentation(EXS_LittleEndianExplicit, NULL);
+        if (cond.bad()) {
+            state.SkipWithError(cond.text());
+            break;
+        }
+    }
+    ns::setFrameThreads(0);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 2048 * 2048 * 2));
+}
+
+// makeInstance() with its 512x512 pixel data repeated as the frames of a multi-frame image
+std::unique_ptr<DcmFileFormat> makeMultiFrame(unsigned int frames)
+{
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, 512, 512);
+    DcmDataset* dataset = file->getDataset();
+    const Uint16* frame = NULL;
+    unsigned long count = 0;
+    dataset->findAndGetUint16Array(DCM_PixelData, frame, &count);
+    std::vector<Uint16> pixels;
+    for (unsigned int i = 0; i < frames; ++i) pixels.insert(pixels.end(), frame, frame + count);
+    dataset->putAndInsertUint16Array(DCM_PixelData, pixels.data(), static_cast<unsigned long>(pixels.size()));
+    dataset->putAndInsertString(DCM_NumberOfFrames, std::to_string(frames).c_str());
+    return file;
+}
+
+// encoding a 16 frame RLE image, argument is the number of threads encoding the frames
+void BM_RleMultiFrameEncode(bench::State& state)
+{
+    ns::registerCodecs();
+    std::unique_ptr<DcmFileFormat> file = makeMultiFrame(16);
+    DcmDataset* dataset = file->getDataset();
+    ns::setFrameThreads(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        OFCondition cond = dataset->chooseRepresentation(EXS_RLELossless, NULL);
+        if (cond.bad()) {
+            state.SkipWithError(cond.text());
+            break;
+        }
+        state.PauseTiming();
+        dataset->removeAllButOriginalRepresentations();
+        state.ResumeTiming();
+    }
+    ns::setFrameThreads(0);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 16 * 512 * 512 * 2));
+}
+
+// decoding a 16 frame RLE image, argument is the number of threads decoding the frames
+void BM_RleMultiFrameDecode(bench::State& state)
+{
+    ns::registerCodecs();
+    std::unique_ptr<DcmFileFormat> file = makeMultiFrame(16);
+    DcmDataset* compressed = file->getDataset();
+    if (compressed->chooseRepresentation(EXS_RLELossless, NULL).bad()) {
+        state.SkipWithError("no encoder");
+        return;
+    }
+    compressed->removeAllButCurrentRepresentations();
+    ns::setFrameThreads(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        state.PauseTiming();
+        DcmDataset dataset(*compressed);
+        state.ResumeTiming();
+        OFCondition cond = dataset.chooseRepresentation(EXS_LittleEndianExplicit, NULL);
+        if (cond.bad()) {
+            state.SkipWithError(cond.text());
+            break;
+        }
+    }
+    ns::setFrameThreads(0);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 16 * 512 * 512 * 2));
+}
+
+}
+
+BENCHMARK(BM_CodecEncode)->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(4)->Arg(5)->Arg(6);
+BENCHMARK(BM_CodecDecode)->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Arg(4)->Arg(5)->Arg(6);
+BENCHMARK(BM_LosslessRestartDecode)->Arg(0)->Arg(4);
+BENCHMARK(BM_RleMultiFrameEncode)->Arg(0)->Arg(4);
+BENCHMARK(BM_RleMultiFrameDecode)->Arg(0)->Arg(4);
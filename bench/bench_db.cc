@@ -0,0 +1,200 @@
+// the SQLite index of the storage area: inserting received instances and resolving C-FIND and C-MOVE requests
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "dcmsqldb.h"
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+
+namespace
+{
+
+typedef std::map<DB_FindAttrExt, std::string, DB_FindAttrExtCompare> Attributes;
+
+// the indexed attributes of instances first to first + count, the pixel data is kept small
+std::vector<Attributes> extract(const DcmSQLiteDatabase& db, size_t first, size_t count)
+{
+    std::vector<Attributes> result(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::unique_ptr<DcmFileFormat> file = bench::makeInstance(first + i, 8, 8);
+        db.extractMetaData(file->getDataset(), ("/data/" + std::to_string(first + i) + ".dcm").c_str(), result[i]);
+    }
+    return result;
+}
+
+// inserts in transactions of 1000 instances as the ingest writer does, returns false on any failure
+bool fill(DcmSQLiteDatabase& db, size_t first, size_t count)
+{
+    const size_t chunk = 1000;
+    for (size_t i = 0; i < count; i += chunk) {
+        std::vector<bool> inserted = db.insertBatch(extract(db, first + i, std::min(chunk, count - i)));
+        for (bool ok : inserted) {
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+struct sIndex {
+    std::string directory;
+    std::unique_ptr<DcmSQLiteDatabase> db;
+};
+
+// index with the given number of instances, filled once and shared by the benchmarks of that size
+DcmSQLiteDatabase* filledIndex(size_t instances)
+{
+    static std::map<size_t, std::unique_ptr<sIndex>> indexes;
+    std::unique_ptr<sIndex>& index = indexes[instances];
+    if (!index) {
+        if (indexes.size() == 1) {
+            bench::registerTeardown([]() {
+                for (auto& entry : indexes) {
+                    if (entry.second) {
+                        entry.second->db.reset();
+                        bench::removeIndexDirectory(entry.second->directory);
+                    }
+                }
+            });
+        }
+        index.reset(new sIndex());
+        index->directory = bench::tempDirectory("index-" + std::to_string(instances));
+        index->db.reset(new DcmSQLiteDatabase(index->directory.c_str()));
+        if (!index->db->isInitialized() || !fill(*index->db, 0, instances)) {
+            index->db.reset();
+        }
+    }
+    return index->db.get();
+}
+
+void BM_DbInsertBatch(bench::State& state)
+{
+    const size_t instances = static_cast<size_t>(state.range(0));
+    const std::string directory = bench::tempDirectory("insert");
+    bool ok = true;
+    {
+        DcmSQLiteDatabase db(directory.c_str());
+        if (!db.isInitialized()) {
+            state.SkipWithError("cannot create index");
+        }
+        for (auto _ : state) {
+            // creating the datasets is not part of the measurement
+            state.PauseTiming();
+            std::vector<Attributes> batch = extract(db, 0, std::min<size_t>(instances, 1000));
+            state.ResumeTiming();
+            for (size_t i = 0; ok && i < instances; i += batch.size()) {
+                if (i > 0) {
+                    state.PauseTiming();
+                    batch = extract(db, i, std::min<size_t>(instances - i, 1000));
+                    state.ResumeTiming();
+                }
+                for (bool inserted : db.insertBatch(batch)) {
+                    ok = ok && inserted;
+                }
+            }
+        }
+    }
+    bench::removeIndexDirectory(directory);
+    if (!ok) {
+        state.SkipWithError("insert failed");
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * instances));
+}
+BENCHMARK(BM_DbInsertBatch)->Arg(10000)->Arg(1000000)->Iterations(1);
+
+// one instance at a time as stored without the ingest queue, into an index of the given size
+void BM_DbInsertMetaData(bench::State& state)
+{
+    DcmSQLiteDatabase* db = filledIndex(static_cast<size_t>(state.range(0)));
+    if (db == NULL) {
+        state.SkipWithError("cannot fill index");
+        return;
+    }
+    static size_t next = 100000000;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<DcmFileFormat> file = bench::makeInstance(next, 8, 8);
+        const OFString filename = ("/data/" + std::to_string(next++) + ".dcm").c_str();
+        state.ResumeTiming();
+        if (db->insertMetaData(file->getDataset(), filename).bad()) {
+            state.SkipWithError("insert failed");
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_DbInsertMetaData)->Arg(10000)->Arg(1000000);
+
+void runFind(bench::State& state, DcmSQLiteDatabase* db, const std::list<DcmSmallDcmElm>& request, DB_LEVEL level)
+{
+    size_t matches = 0;
+    for (auto _ : state) {
+        if (db == NULL) {
+            state.SkipWithError("cannot fill index");
+            break;
+        }
+        matches += db->find(request, level, level, level).size();
+    }
+    state.counters["matches"] = state.iterations() > 0 ? static_cast<double>(matches) / static_cast<double>(state.iterations()) : 0;
+    state.SetItemsProcessed(static_cast<int64_t>(matches));
+}
+
+// the studies of a patient with the attributes a worklist client asks for
+void BM_DbFindStudiesOfPatient(bench::State& state)
+{
+    const size_t instances = static_cast<size_t>(state.range(0));
+    std::list<DcmSmallDcmElm> request;
+    request.push_back(DcmSmallDcmElm(DCM_PatientID, "P" + std::to_string(instances / 1000 / 2)));
+    request.push_back(DcmSmallDcmElm(DCM_PatientName, ""));
+    request.push_back(DcmSmallDcmElm(DCM_StudyInstanceUID, ""));
+    request.push_back(DcmSmallDcmElm(DCM_StudyDate, ""));
+    request.push_back(DcmSmallDcmElm(DCM_StudyDescription, ""));
+    request.push_back(DcmSmallDcmElm(DCM_AccessionNumber, ""));
+    request.push_back(DcmSmallDcmElm(DCM_ModalitiesInStudy, ""));
+    request.push_back(DcmSmallDcmElm(DCM_NumberOfStudyRelatedInstances, ""));
+    runFind(state, filledIndex(instances), request, STUDY_LEVEL);
+}
+BENCHMARK(BM_DbFindStudiesOfPatient)->Arg(10000)->Arg(1000000);
+
+// the studies of a month, a date range over all patients
+void BM_DbFindStudiesByDate(bench::State& state)
+{
+    std::list<DcmSmallDcmElm> request;
+    request.push_back(DcmSmallDcmElm(DCM_StudyDate, "20240301-20240331"));
+    request.push_back(DcmSmallDcmElm(DCM_StudyInstanceUID, ""));
+    request.push_back(DcmSmallDcmElm(DCM_PatientID, ""));
+    request.push_back(DcmSmallDcmElm(DCM_ModalitiesInStudy, ""));
+    runFind(state, filledIndex(static_cast<size_t>(state.range(0))), request, STUDY_LEVEL);
+}
+BENCHMARK(BM_DbFindStudiesByDate)->Arg(10000)->Arg(1000000);
+
+// the patients whose name starts with a prefix, a range scan on the uppercase names
+void BM_DbFindPatientsByNamePrefix(bench::State& state)
+{
+    std::list<DcmSmallDcmElm> request;
+    request.push_back(DcmSmallDcmElm(DCM_PatientName, "bench^patient1*"));
+    request.push_back(DcmSmallDcmElm(DCM_PatientID, ""));
+    request.push_back(DcmSmallDcmElm(DCM_PatientBirthDate, ""));
+    runFind(state, filledIndex(static_cast<size_t>(state.range(0))), request, PATIENT_LEVEL);
+}
+BENCHMARK(BM_DbFindPatientsByNamePrefix)->Arg(10000)->Arg(1000000);
+
+// the instances of a study, as a C-MOVE of the study resolves them
+void BM_DbFindInstancesOfStudy(bench::State& state)
+{
+    const size_t instances = static_cast<size_t>(state.range(0));
+    std::list<DcmSmallDcmElm> request;
+    request.push_back(DcmSmallDcmElm(DCM_StudyInstanceUID, bench::studyInstanceUID(instances / 2)));
+    request.push_back(DcmSmallDcmElm(DCM_SeriesInstanceUID, ""));
+    request.push_back(DcmSmallDcmElm(DCM_SOPInstanceUID, ""));
+    request.push_back(DcmSmallDcmElm(DCM_SOPClassUID, ""));
+    runFind(state, filledIndex(instances), request, IMAGE_LEVEL);
+}
+BENCHMARK(BM_DbFindInstancesOfStudy)->Arg(10000)->Arg(1000000);
+
+}
@@ -0,0 +1,75 @@
+// loading the builtin data dictionary, which every process pays on its first parse, looking up tags in it
+// and parsing data set headers, which does such a lookup for each element
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include <vector>
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcdict.h"
+#include "dcmtk/dcmdata/dcelem.h"
+#include "dcmtk/dcmdata/dcistrmb.h"
+#include "dcmtk/dcmdata/dcostrmb.h"
+
+namespace
+{
+
+// a dictionary as created by the first lookup of a process, without external dictionaries
+void BM_DictionaryLoad(bench::State& state)
+{
+    for (auto _ : state) {
+        DcmDataDictionary dictionary(OFTrue, OFFalse);
+        bench::DoNotOptimize(dictionary.numberOfEntries());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_DictionaryLoad);
+
+// the tags of a CT instance looked up by key, as the parser does for each element it reads
+void BM_DictionaryLookup(bench::State& state)
+{
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, 16, 16);
+    std::vector<DcmTagKey> keys;
+    DcmDataset* dataset = file->getDataset();
+    for (unsigned long i = 0; i < dataset->card(); ++i) {
+        keys.push_back(dataset->getElement(i)->getTag().getXTag());
+    }
+    const DcmDataDictionary& dictionary = dcmDataDict.rdlock();
+    for (auto _ : state) {
+        for (const DcmTagKey& key : keys) {
+            bench::DoNotOptimize(dictionary.findEntry(key, NULL));
+        }
+    }
+    dcmDataDict.rdunlock();
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+}
+BENCHMARK(BM_DictionaryLookup);
+
+// the header of a CT instance read from memory in the transfer syntax given as argument, as the ingest
+// and parse paths do before touching the pixel data
+void BM_HeaderParse(bench::State& state)
+{
+    const E_TransferSyntax xfer = static_cast<E_TransferSyntax>(state.range(0));
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, 16, 16);
+    DcmDataset* dataset = file->getDataset();
+    delete dataset->remove(DCM_PixelData);
+    std::vector<char> buffer(dataset->calcElementLength(xfer, EET_ExplicitLength));
+    DcmOutputBufferStream out(buffer.data(), buffer.size());
+    dataset->transferInit();
+    dataset->write(out, xfer, EET_ExplicitLength, NULL);
+    dataset->transferEnd();
+    for (auto _ : state) {
+        DcmInputBufferStream in;
+        in.setBuffer(buffer.data(), buffer.size());
+        in.setEos();
+        DcmDataset parsed;
+        parsed.transferInit();
+        bench::DoNotOptimize(parsed.read(in, xfer).good());
+        parsed.transferEnd();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_HeaderParse)->Arg(EXS_LittleEndianExplicit)->Arg(EXS_LittleEndianImplicit)->Arg(EXS_BigEndianExplicit);
+
+}
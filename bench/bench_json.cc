@@ -0,0 +1,109 @@
+// option parsing and the serialization of received instances for JS
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+#include "base64.h"
+
+#include "dcmtk/dcmdata/dcostrmb.h"
+
+using json = nlohmann::json;
+
+namespace
+{
+
+// the options of a C-MOVE request as sent by index.ts
+const char* moveRequest = R"({
+    "source": { "aet": "DIMSE", "ip": "127.0.0.1", "port": 9999 },
+    "target": { "aet": "CONQUESTSRV1", "ip": "127.0.0.1", "port": 5678 },
+    "tags": [
+        { "key": "0020000D", "value": "1.3.46.670589.5.2.10.2156913941.892665384.993397" },
+        { "key": "00080052", "value": "STUDY" }
+    ],
+    "destination": "DIMSE",
+    "netTransferPrefer": "1.2.840.10008.1.2.4.80",
+    "storagePath": "/data/dicom",
+    "moveAssociations": 4,
+    "moveReadAhead": 8,
+    "verbose": false
+})";
+
+void BM_ParseInputJson(bench::State& state)
+{
+    const std::string input(moveRequest);
+    for (auto _ : state) {
+        ns::sInput in = ns::parseInputJson(input);
+        bench::DoNotOptimize(in);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_ParseInputJson);
+
+// the work storeSCPCallback does per instance received into memory: write the instance to a buffer, base64
+// encode it and serialize the progress message, argument is the number of rows and columns
+void BM_StoreResponseSerialization(bench::State& state)
+{
+    const unsigned short size = static_cast<unsigned short>(state.range(0));
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, size, size);
+    const E_TransferSyntax xfer = EXS_LittleEndianExplicit;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        file->validateMetaInfo(xfer, EWM_fileformat);
+        file->removeInvalidGroups();
+        const Uint32 length = file->calcElementLength(xfer, EET_ExplicitLength);
+        std::vector<unsigned char> buffer(length);
+        DcmOutputBufferStream stream(buffer.data(), length);
+        file->transferInit();
+        OFCondition cond = file->write(stream, xfer, EET_ExplicitLength, NULL, EGL_recalcGL, EPD_noChange, 0, 0, EWM_fileformat);
+        file->transferEnd();
+        if (cond.bad()) {
+            state.SkipWithError(cond.text());
+            break;
+        }
+        json v = json::object();
+        v["StudyInstanceUID"] = bench::studyInstanceUID(0);
+        v["SeriesInstanceUID"] = "2.25.20";
+        v["SOPInstanceUID"] = "2.25.30";
+        v["base64"] = base64_encode(buffer.data(), length);
+        std::string message = ns::dumpResponse(ns::createResponse(ns::PENDING, "BUFFER_STORAGE", v));
+        bench::DoNotOptimize(message);
+        bytes += length;
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+BENCHMARK(BM_StoreResponseSerialization)->Arg(256)->Arg(512);
+
+void BM_Base64Encode(bench::State& state)
+{
+    std::vector<unsigned char> data(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<unsigned char>(i * 131 + (i >> 8));
+    }
+    for (auto _ : state) {
+        std::string encoded = base64_encode(data.data(), data.size());
+        bench::DoNotOptimize(encoded);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK(BM_Base64Encode)->Arg(64 << 10)->Arg(1 << 20)->Arg(16 << 20);
+
+void BM_Base64Decode(bench::State& state)
+{
+    std::vector<unsigned char> data(static_cast<size_t>(state.range(0)));
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<unsigned char>(i * 131 + (i >> 8));
+    }
+    const std::string encoded = base64_encode(data.data(), data.size());
+    for (auto _ : state) {
+        std::string decoded = base64_decode(encoded);
+        bench::DoNotOptimize(decoded);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK(BM_Base64Decode)->Arg(64 << 10)->Arg(1 << 20)->Arg(16 << 20);
+
+}
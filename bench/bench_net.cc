@@ -0,0 +1,200 @@
+// C-STORE and C-FIND throughput over a loopback association to an in-process SCP (--port, default 11190)
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "dcmtk/dcmnet/scp.h"
+#include "dcmtk/dcmnet/scu.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcuid.h"
+
+namespace
+{
+
+// accepts all storage and answers each C-FIND with the number of pending responses given in
+// NumberOfStudyRelatedInstances of the query
+class LoopbackSCP : public DcmSCP
+{
+public:
+    LoopbackSCP() : m_stop(false)
+    {
+        OFList<OFString> xfers;
+        xfers.push_back(UID_LittleEndianExplicitTransferSyntax);
+        xfers.push_back(UID_LittleEndianImplicitTransferSyntax);
+        addPresentationContext(UID_VerificationSOPClass, xfers);
+        addPresentationContext(UID_CTImageStorage, xfers);
+        addPresentationContext(UID_FINDStudyRootQueryRetrieveInformationModel, xfers);
+        setAETitle("BENCHSCP");
+        // returns from listen() a second after stop()
+        setConnectionBlockingMode(DUL_NOBLOCK);
+        setConnectionTimeout(1);
+    }
+
+    void stop() { m_stop = true; }
+
+protected:
+    virtual OFCondition handleIncomingCommand(T_DIMSE_Message* incomingMsg, const DcmPresentationContextInfo& presInfo)
+    {
+        const T_ASC_PresentationContextID presID = presInfo.presentationContextID;
+        if (incomingMsg->CommandField == DIMSE_C_STORE_RQ) {
+            T_DIMSE_C_StoreRQ& request = incomingMsg->msg.CStoreRQ;
+            DcmDataset* dataset = NULL;
+            OFCondition cond = receiveSTORERequest(request, presID, dataset);
+            delete dataset;
+            if (cond.bad()) {
+                return cond;
+            }
+            return sendSTOREResponse(presID, request, STATUS_Success);
+        }
+        if (incomingMsg->CommandField == DIMSE_C_FIND_RQ) {
+            T_DIMSE_C_FindRQ& request = incomingMsg->msg.CFindRQ;
+            DcmDataset* query = NULL;
+            OFCondition cond = receiveFINDRequest(request, presID, query);
+            if (cond.bad()) {
+                delete query;
+                return cond;
+            }
+            long matches = 0;
+            query->findAndGetLongInt(DCM_NumberOfStudyRelatedInstances, matches);
+            delete query;
+            for (long i = 0; cond.good() && i < matches; ++i) {
+                std::unique_ptr<DcmFileFormat> file = bench::makeInstance(static_cast<size_t>(i) * 100, 1, 1);
+                DcmDataset response;
+                response.putAndInsertString(DCM_QueryRetrieveLevel, "STUDY");
+                copyElement(*file->getDataset(), response, DCM_StudyInstanceUID);
+                copyElement(*file->getDataset(), response, DCM_PatientID);
+                copyElement(*file->getDataset(), response, DCM_PatientName);
+                copyElement(*file->getDataset(), response, DCM_StudyDate);
+                copyElement(*file->getDataset(), response, DCM_AccessionNumber);
+                cond = sendFINDResponse(presID, request.MessageID, request.AffectedSOPClassUID, &response, STATUS_Pending);
+            }
+            if (cond.bad()) {
+                return cond;
+            }
+            return sendFINDResponse(presID, request.MessageID, request.AffectedSOPClassUID, NULL, STATUS_Success);
+        }
+        return DcmSCP::handleIncomingCommand(incomingMsg, presInfo);
+    }
+
+    virtual OFBool stopAfterConnectionTimeout() { return m_stop; }
+    virtual OFBool stopAfterCurrentAssociation() { return m_stop; }
+
+private:
+    static void copyElement(DcmItem& from, DcmItem& to, const DcmTagKey& key)
+    {
+        OFString value;
+        from.findAndGetOFString(key, value);
+        to.putAndInsertOFStringArray(key, value);
+    }
+
+    std::atomic<bool> m_stop;
+};
+
+// the SCP shared by all runs, stopped once all benchmarks are done
+Uint16 loopbackPort()
+{
+    static std::unique_ptr<LoopbackSCP> scp;
+    static std::thread listener;
+    static const Uint16 port = static_cast<Uint16>(std::stoi(bench::option("port", "11190")));
+    if (!scp) {
+        scp.reset(new LoopbackSCP());
+        scp->setPort(port);
+        listener = std::thread([]() { scp->listen(); });
+        bench::registerTeardown([]() {
+            scp->stop();
+            listener.join();
+        });
+        // the listener binds the port before the first association request is answered
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    return port;
+}
+
+bool connect(DcmSCU& scu, bench::State& state)
+{
+    OFList<OFString> xfers;
+    xfers.push_back(UID_LittleEndianExplicitTransferSyntax);
+    scu.setPeerHostName("127.0.0.1");
+    scu.setPeerPort(loopbackPort());
+    scu.setPeerAETitle("BENCHSCP");
+    scu.setAETitle("BENCHSCU");
+    scu.addPresentationContext(UID_CTImageStorage, xfers);
+    scu.addPresentationContext(UID_FINDStudyRootQueryRetrieveInformationModel, xfers);
+    OFCondition cond = scu.initNetwork();
+    if (cond.good()) {
+        cond = scu.negotiateAssociation();
+    }
+    if (cond.bad()) {
+        state.SkipWithError(std::string("cannot connect to the loopback SCP: ") + cond.text());
+        return false;
+    }
+    return true;
+}
+
+// argument is the number of rows and columns of the 16 bit images sent
+void BM_LoopbackStore(bench::State& state)
+{
+    DcmSCU scu;
+    if (!connect(scu, state)) {
+        return;
+    }
+    const unsigned short size = static_cast<unsigned short>(state.range(0));
+    std::unique_ptr<DcmFileFormat> file = bench::makeInstance(0, size, size);
+    const T_ASC_PresentationContextID presID = scu.findPresentationContextID(UID_CTImageStorage, UID_LittleEndianExplicitTransferSyntax);
+    size_t sent = 0;
+    for (auto _ : state) {
+        Uint16 status = 0;
+        OFCondition cond = scu.sendSTORERequest(presID, "", file->getDataset(), status);
+        if (cond.bad() || status != STATUS_Success) {
+            state.SkipWithError(cond.bad() ? cond.text() : "C-STORE failed");
+            break;
+        }
+        ++sent;
+    }
+    scu.releaseAssociation();
+    state.SetItemsProcessed(static_cast<int64_t>(sent));
+    state.SetBytesProcessed(static_cast<int64_t>(sent) * size * size * 2);
+}
+BENCHMARK(BM_LoopbackStore)->Arg(64)->Arg(512);
+
+// argument is the number of matches per query
+void BM_LoopbackFind(bench::State& state)
+{
+    DcmSCU scu;
+    if (!connect(scu, state)) {
+        return;
+    }
+    const T_ASC_PresentationContextID presID = scu.findPresentationContextID(UID_FINDStudyRootQueryRetrieveInformationModel, UID_LittleEndianExplicitTransferSyntax);
+    DcmDataset query;
+    query.putAndInsertString(DCM_QueryRetrieveLevel, "STUDY");
+    query.putAndInsertString(DCM_StudyInstanceUID, "");
+    query.putAndInsertString(DCM_PatientID, "");
+    query.putAndInsertString(DCM_PatientName, "");
+    query.putAndInsertString(DCM_StudyDate, "");
+    query.putAndInsertString(DCM_AccessionNumber, "");
+    query.putAndInsertString(DCM_NumberOfStudyRelatedInstances, std::to_string(state.range(0)).c_str());
+    size_t responses = 0;
+    for (auto _ : state) {
+        OFList<QRResponse*> received;
+        OFCondition cond = scu.sendFINDRequest(presID, &query, &received);
+        for (QRResponse* response : received) {
+            delete response;
+        }
+        if (cond.bad()) {
+            state.SkipWithError(cond.text());
+            break;
+        }
+        // the final response carries no match
+        responses += received.size() - 1;
+    }
+    scu.releaseAssociation();
+    state.SetItemsProcessed(static_cast<int64_t>(responses));
+}
+BENCHMARK(BM_LoopbackFind)->Arg(1)->Arg(100);
+
+}
@@ -0,0 +1,160 @@
+// accept-to-first-response latency of the Q/R SCP serving associations on threads or on forked
+// processes (--qrport, default 11191 and 11192), from the A-ASSOCIATE-RQ to the C-ECHO-RSP
+
+#include "bench.h"
+#include "fixtures.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "dcmtk/dcmnet/scu.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmnet/dcasccfg.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"
+#include "dcmtk/dcmqrdb/dcmqrdbi.h"
+#include "dcmtk/dcmqrdb/dcmqropt.h"
+#include "dcmtk/dcmqrdb/dcmqrsrv.h"
+
+namespace
+{
+
+// any peer may connect to the storage area of the benchmark
+class BenchConfig : public DcmQueryRetrieveConfig
+{
+public:
+    explicit BenchConfig(const std::string& storageArea) : m_storageArea(storageArea) {}
+
+    virtual int peerInAETitle(const char*, const char*, const char*) const { return 1; }
+    virtual const char* getStorageArea(const char*) const { return m_storageArea.c_str(); }
+    virtual int getMaxStudies(const char*) const { return 1000; }
+    virtual long getMaxBytesPerStudy(const char*) const { return 1024 * 1024; }
+    virtual OFBool writableStorageArea(const char*) const { return OFTrue; }
+
+private:
+    std::string m_storageArea;
+};
+
+// a Q/R SCP on its own thread, as in ServerAsyncWorker
+class BenchQRSCP
+{
+public:
+    BenchQRSCP(Uint16 port, bool threads)
+    : m_directory(bench::tempDirectory(threads ? "qrscp-threads" : "qrscp-fork"))
+    , m_config(m_directory)
+    , m_factory(&m_config)
+    , m_net(NULL)
+    , m_stop(false)
+    {
+        m_options.singleProcess_ = threads ? OFTrue : OFFalse;
+        m_options.maxAssociations_ = 64;
+        m_options.disableGetSupport_ = OFTrue;
+        if (ASC_initializeNetwork(NET_ACCEPTOR, port, 30, &m_net).bad()) {
+            m_net = NULL;
+            return;
+        }
+        m_options.net_ = m_net;
+        m_scp.reset(new DcmQueryRetrieveSCP(m_config, m_options, m_factory, m_associationConfiguration));
+        // the listener only returns from waitForAssociation() after up to a second without requests
+        m_listener = std::thread([this]() {
+            while (!m_stop && m_scp->waitForAssociation(m_net).good()) {
+                m_scp->cleanChildren();
+            }
+        });
+    }
+
+    ~BenchQRSCP()
+    {
+        m_stop = true;
+        if (m_listener.joinable()) {
+            m_listener.join();
+        }
+        m_scp.reset();
+        if (m_net != NULL) {
+            ASC_dropNetwork(&m_net);
+        }
+        OFStandard::deleteFile((m_directory + "/" DBINDEXFILE).c_str());
+        bench::removeIndexDirectory(m_directory);
+    }
+
+    bool listening() const { return m_net != NULL; }
+
+private:
+    std::string m_directory;
+    BenchConfig m_config;
+    DcmQueryRetrieveIndexDatabaseHandleFactory m_factory;
+    DcmQueryRetrieveOptions m_options;
+    DcmAssociationConfiguration m_associationConfiguration;
+    T_ASC_Network* m_net;
+    std::unique_ptr<DcmQueryRetrieveSCP> m_scp;
+    std::thread m_listener;
+    std::atomic<bool> m_stop;
+};
+
+// the SCPs shared by all runs, by threading model. They are never destroyed by static destructors,
+// which forked children would run on exit
+Uint16 qrscpPort(bool threads)
+{
+    static std::map<bool, BenchQRSCP*> scps;
+    const Uint16 port = static_cast<Uint16>(std::stoi(bench::option("qrport", "11191")) + (threads ? 0 : 1));
+    if (scps.count(threads) == 0) {
+        BenchQRSCP* scp = new BenchQRSCP(port, threads);
+        scps[threads] = scp;
+        bench::registerTeardown([scp]() { delete scp; });
+        if (!scp->listening()) {
+            return 0;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    return scps[threads]->listening() ? port : 0;
+}
+
+// argument is 1 for associations served on threads, 0 for a forked process per association
+void BM_QRSCPFirstResponse(bench::State& state)
+{
+    const bool threads = state.range(0) != 0;
+#ifndef HAVE_FORK
+    if (!threads) {
+        state.SkipWithError("fork() is not available");
+        return;
+    }
+#endif
+    const Uint16 port = qrscpPort(threads);
+    if (port == 0) {
+        state.SkipWithError("cannot listen for the Q/R SCP");
+        return;
+    }
+    OFList<OFString> xfers;
+    xfers.push_back(UID_LittleEndianImplicitTransferSyntax);
+    size_t associations = 0;
+    for (auto _ : state) {
+        DcmSCU scu;
+        scu.setPeerHostName("127.0.0.1");
+        scu.setPeerPort(port);
+        scu.setPeerAETitle("BENCHQR");
+        scu.setAETitle("BENCHSCU");
+        scu.addPresentationContext(UID_VerificationSOPClass, xfers);
+        OFCondition cond = scu.initNetwork();
+        if (cond.good()) {
+            cond = scu.negotiateAssociation();
+        }
+        if (cond.good()) {
+            cond = scu.sendECHORequest(0);
+        }
+        state.PauseTiming();
+        if (cond.bad()) {
+            state.SkipWithError(std::string("C-ECHO failed: ") + cond.text());
+            break;
+        }
+        scu.releaseAssociation();
+        ++associations;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(associations));
+    state.SetLabel(threads ? "threads" : "fork");
+}
+BENCHMARK(BM_QRSCPFirstResponse)->Arg(1)->Arg(0);
+
+}
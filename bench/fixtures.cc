@@ -0,0 +1,100 @@
+#include "fixtures.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcmetinf.h"
+#include "dcmtk/dcmdata/dcuid.h"
+
+#ifdef HAVE_WINDOWS_H
+#include <direct.h> /* for _rmdir() */
+#else
+#include <unistd.h> /* for rmdir() */
+#endif
+
+namespace bench
+{
+
+std::unique_ptr<DcmFileFormat> makeInstance(size_t index, unsigned short rows, unsigned short columns)
+{
+    const size_t series = index / 10;
+    const size_t study = series / 10;
+    const size_t patient = study / 10;
+
+    std::unique_ptr<DcmFileFormat> file(new DcmFileFormat());
+    DcmDataset* dataset = file->getDataset();
+    dataset->putAndInsertString(DCM_SOPClassUID, UID_CTImageStorage);
+    dataset->putAndInsertString(DCM_SOPInstanceUID, ("2.25.3" + std::to_string(index)).c_str());
+    dataset->putAndInsertString(DCM_StudyInstanceUID, studyInstanceUID(index).c_str());
+    dataset->putAndInsertString(DCM_SeriesInstanceUID, ("2.25.2" + std::to_string(series)).c_str());
+    dataset->putAndInsertString(DCM_PatientID, ("P" + std::to_string(patient)).c_str());
+    dataset->putAndInsertString(DCM_PatientName, ("Bench^Patient" + std::to_string(patient)).c_str());
+    dataset->putAndInsertString(DCM_PatientBirthDate, "19700101");
+    dataset->putAndInsertString(DCM_PatientSex, patient % 2 ? "F" : "M");
+    dataset->putAndInsertString(DCM_StudyDate, ("2024" + std::string(study % 12 < 9 ? "0" : "") + std::to_string(study % 12 + 1) + "15").c_str());
+    dataset->putAndInsertString(DCM_StudyTime, "120000");
+    dataset->putAndInsertString(DCM_AccessionNumber, ("A" + std::to_string(study)).c_str());
+    dataset->putAndInsertString(DCM_StudyID, std::to_string(study % 1000).c_str());
+    dataset->putAndInsertString(DCM_StudyDescription, "BENCHMARK");
+    dataset->putAndInsertString(DCM_Modality, "CT");
+    dataset->putAndInsertString(DCM_SeriesNumber, std::to_string(series % 10 + 1).c_str());
+    dataset->putAndInsertString(DCM_InstanceNumber, std::to_string(index % 10 + 1).c_str());
+
+    dataset->putAndInsertUint16(DCM_SamplesPerPixel, 1);
+    dataset->putAndInsertString(DCM_PhotometricInterpretation, "MONOCHROME2");
+    dataset->putAndInsertUint16(DCM_Rows, rows);
+    dataset->putAndInsertUint16(DCM_Columns, columns);
+    dataset->putAndInsertUint16(DCM_BitsAllocated, 16);
+    dataset->putAndInsertUint16(DCM_BitsStored, 12);
+    dataset->putAndInsertUint16(DCM_HighBit, 11);
+    dataset->putAndInsertUint16(DCM_PixelRepresentation, 0);
+
+    std::vector<Uint16> pixels(static_cast<size_t>(rows) * columns);
+    Uint32 noise = static_cast<Uint32>(index) * 2654435761u + 1;
+    for (size_t y = 0; y < rows; ++y) {
+        for (size_t x = 0; x < columns; ++x) {
+            noise = noise * 1664525u + 1013904223u;
+            pixels[y * columns + x] = static_cast<Uint16>(((x + y) * 2048 / (rows + columns) + (noise >> 28)) & 0x0fff);
+        }
+    }
+    dataset->putAndInsertUint16Array(DCM_PixelData, pixels.data(), static_cast<unsigned long>(pixels.size()));
+    file->getMetaInfo()->putAndInsertString(DCM_MediaStorageSOPClassUID, UID_CTImageStorage);
+    file->getMetaInfo()->putAndInsertString(DCM_MediaStorageSOPInstanceUID, ("2.25.3" + std::to_string(index)).c_str());
+    return file;
+}
+
+std::string studyInstanceUID(size_t index)
+{
+    return "2.25.1" + std::to_string(index / 100);
+}
+
+std::string tempDirectory(const std::string& name)
+{
+    const char* system = std::getenv("TMPDIR");
+#ifdef HAVE_WINDOWS_H
+    if (system == NULL) system = std::getenv("TEMP");
+#endif
+    const std::string root = option("tmp", system != NULL ? system : "/tmp");
+    const std::string directory = root + "/dcmtk-bench-" + std::to_string(OFStandard::getProcessID()) + "-" + name;
+    removeIndexDirectory(directory);
+    OFStandard::createDirectory(directory.c_str(), root.c_str());
+    return directory;
+}
+
+void removeIndexDirectory(const std::string& directory)
+{
+    OFStandard::deleteFile((directory + "/image.db").c_str());
+    OFStandard::deleteFile((directory + "/image.db-wal").c_str());
+    OFStandard::deleteFile((directory + "/image.db-shm").c_str());
+#ifdef HAVE_WINDOWS_H
+    _rmdir(directory.c_str());
+#else
+    rmdir(directory.c_str());
+#endif
+}
+
+}
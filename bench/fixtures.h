@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcfilefo.h"
+
+namespace bench
+{
+
+// CT instance number index of a synthetic archive with 10 instances per series, 10 series per study and
+// 10 studies per patient. The pixel data is a gradient with noise, 12 bits stored, so codecs see
+// realistic rather than constant data
+std::unique_ptr<DcmFileFormat> makeInstance(size_t index, unsigned short rows = 256, unsigned short columns = 256);
+
+// UID of the study of instance index, for queries matching makeInstance()
+std::string studyInstanceUID(size_t index);
+
+// creates a fresh directory below --tmp (default: the system temporary directory)
+std::string tempDirectory(const std::string& name);
+
+// removes a directory created by tempDirectory() holding an image.db index
+void removeIndexDirectory(const std::string& directory);
+
+}
@@ -0,0 +1,100 @@
+/*
+ *
+ *  Copyright (C) 1994-2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmdata
+ *
+ *  Purpose: arena allocation of DICOM objects
+ *
+ */
+
+#ifndef DCARENA_H
+#define DCARENA_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+
+#include "dcmtk/dcmdata/dcdefine.h"
+
+#define INCLUDE_CSTDDEF
+#include "dcmtk/ofstd/ofstdinc.h"
+
+class DcmArena;
+
+/** scope in which all DcmObject instances (elements, items, sequences) created
+ *  by the current thread are allocated from a common arena instead of the
+ *  global heap. The arena grows in chunks, deleting an object does not return
+ *  its memory individually; all chunks are freed in one shot once the scope
+ *  has ended and the last object allocated in it has been deleted, no matter
+ *  by which thread. Objects may therefore outlive the scope, e.g.\ a dataset
+ *  handed over to a writer thread, but they keep the whole arena alive.
+ *  Value buffers are still allocated on the heap.
+ *  Scopes may be nested, the innermost one is used. A scope must be destroyed
+ *  by the thread that created it.
+ */
+class DCMTK_DCMDATA_EXPORT DcmArenaScope
+{
+public:
+
+  /** constructor, makes the new arena the current one for this thread
+   *  @param chunkSize size of the memory chunks the arena allocates in bytes
+   */
+  explicit DcmArenaScope(size_t chunkSize = 65536);
+
+  /// destructor, restores the previous arena of this thread
+  ~DcmArenaScope();
+
+  /** returns the number of bytes allocated from the arena so far
+   *  @return number of bytes
+   */
+  size_t bytesAllocated() const;
+
+  /** allocates memory, from the current arena of this thread if any.
+   *  Used by DcmObject::operator new() only.
+   *  @param size number of bytes
+   *  @return pointer to memory, NULL if out of memory
+   */
+  static void *allocate(size_t size);
+
+  /** frees memory returned by allocate()
+   *  Used by DcmObject::operator delete() only.
+   *  @param ptr pointer to memory, may be NULL
+   */
+  static void deallocate(void *ptr);
+
+  /** returns the number of DcmObject instances alive in this process,
+   *  whether allocated from an arena or from the heap
+   *  @return number of objects
+   */
+  static size_t liveObjects();
+
+  /** returns the memory taken by the DcmObject instances alive in this
+   *  process, excluding their value buffers
+   *  @return number of bytes
+   */
+  static size_t liveBytes();
+
+private:
+
+  /// private undefined copy constructor
+  DcmArenaScope(const DcmArenaScope&);
+
+  /// private undefined copy assignment operator
+  DcmArenaScope& operator=(const DcmArenaScope&);
+
+  /// arena of this scope
+  DcmArena *arena_;
+
+  /// arena that was current when this scope was created
+  DcmArena *previous_;
+};
+
+#endif
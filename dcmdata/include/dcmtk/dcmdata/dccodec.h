@@ -282,6 +282,25 @@ public:
     Sint32 numberOfFrames,
     DcmPixelSequence * fromPixSeq,
     Uint32& currentItem);
+
+  /** create the offset tables of a newly encoded pixel sequence. If the global flag
+   *  dcmCreateExtendedOffsetTable is set and the image has more than one frame, the
+   *  Extended Offset Table and Extended Offset Table Lengths are inserted into the
+   *  dataset and the Basic Offset Table is left empty. Otherwise, an Extended Offset
+   *  Table of the previous representation is removed from the dataset and the Basic
+   *  Offset Table is created if requested.
+   *  @param dataset dataset containing the pixel data
+   *  @param pixelSequence pixel sequence, the first item is the (empty) Basic Offset Table
+   *  @param offsetList size of each frame including item headers, as filled
+   *    by DcmPixelSequence::storeCompressedFrame()
+   *  @param createBasicOffsetTable create the Basic Offset Table
+   *  @return EC_Normal if successful, an error code otherwise
+   */
+  static OFCondition createOffsetTables(
+    DcmItem *dataset,
+    DcmPixelSequence *pixelSequence,
+    const OFList<Uint32>& offsetList,
+    OFBool createBasicOffsetTable);
 };
 
 
@@ -335,6 +354,22 @@ public:
     const DcmCodec *aCodec,
     const DcmCodecParameter *aCodecParameter);
 
+  /** callback receiving the duration of a single encode or decode call.
+   *  @param xfer transfer syntax that is encoded or decoded
+   *  @param encode OFTrue for an encode call, OFFalse for a decode call
+   *  @param seconds duration of the call in seconds
+   *  @param uncompressedBytes length of the uncompressed pixel data, 0 if unknown
+   *  @param compressedBytes length of the compressed pixel sequence, 0 if unknown
+   */
+  typedef void (*TimingCallback)(E_TransferSyntax xfer, OFBool encode, double seconds, Uint32 uncompressedBytes, Uint32 compressedBytes);
+
+  /** sets the callback that receives the duration of each encode and
+   *  decode call of the registered codecs, NULL disables timing.
+   *  The callback may be called concurrently from several threads.
+   *  @param callback callback function, may be NULL
+   */
+  static void setTimingCallback(TimingCallback callback);
+
   /** looks for a codec that is able to decode from the given transfer syntax
    *  and calls the decode() method of the codec.  A read lock on the list of
    *  codecs is acquired until this method returns.
@@ -454,6 +489,56 @@ public:
     const E_TransferSyntax fromRepType,
     const E_TransferSyntax toRepType);
 
+  /** checks whether compressed pixel data can be converted between the given
+   *  transfer syntaxes by copying the fragments unchanged. This is the case
+   *  where the bitstreams allowed by the first transfer syntax are a subset of
+   *  those allowed by the second one, e.g. JPEG Lossless SV1 to JPEG Lossless or
+   *  JPEG-LS Lossless to JPEG-LS Near-Lossless.
+   *  @param fromRepType current transfer syntax
+   *  @param toRepType desired new transfer syntax
+   *  @return true if the fragments can be passed through, false otherwise
+   */
+  static OFBool canPassThrough(
+    const E_TransferSyntax fromRepType,
+    const E_TransferSyntax toRepType);
+
+  /** copies the fragments of a compressed pixel sequence into a new pixel
+   *  sequence for a transfer syntax that accepts the same bitstream,
+   *  see canPassThrough().
+   *  @param fromRepType current transfer syntax of the compressed image
+   *  @param fromPixSeq compressed pixel sequence
+   *  @param toRepType transfer syntax to convert to
+   *  @param toPixSeq new pixel sequence (allocated on heap) returned in this
+   *    parameter upon success
+   *  @return EC_Normal if successful, EC_CannotChangeRepresentation if the
+   *    fragments cannot be passed through
+   */
+  static OFCondition passThrough(
+    const E_TransferSyntax fromRepType,
+    DcmPixelSequence * fromPixSeq,
+    const E_TransferSyntax toRepType,
+    DcmPixelSequence * & toPixSeq);
+
+  /** determines the cheapest way of converting pixel data between two transfer
+   *  syntaxes. The transfer syntaxes form a graph in which all unencapsulated ones
+   *  are represented by EXS_LittleEndianExplicit. Its edges are the conversions
+   *  the registered codecs claim to support (decoding and encoding cost 10 each,
+   *  direct transcoding 15) and fragment pass-through (cost 1, see canPassThrough()).
+   *  A read lock on the list of codecs is acquired until this method returns.
+   *  @param fromRepType current transfer syntax
+   *  @param toRepType desired new transfer syntax
+   *  @param nextRepType first conversion step of the cheapest path on return,
+   *    EXS_LittleEndianExplicit if the pixel data has to be decoded first,
+   *    toRepType if a single step suffices, EXS_Unknown if there is no path
+   *  @param cost total cost of the cheapest path on return, may be NULL
+   *  @return true if there is a path, false otherwise
+   */
+  static OFBool findCodingPath(
+    const E_TransferSyntax fromRepType,
+    const E_TransferSyntax toRepType,
+    E_TransferSyntax & nextRepType,
+    Uint32 * cost = NULL);
+
   /** determine color model of the decompressed image
    *  @param fromType transfer syntax to decode from
    *  @param fromParam representation parameter of current compressed
@@ -130,6 +130,16 @@ class DCMTK_DCMDATA_EXPORT DcmDataset
      */
     virtual void updateOriginalXfer();
 
+    /** select the elements that are read by the following calls of read(), readUntilTag()
+     *  and loadFile(). The values of the other elements are skipped in the stream without
+     *  creating elements for them, and reading stops at the first element behind the
+     *  projection, see DcmReadProjection for details. Only the elements of the dataset
+     *  itself are selected, a selected sequence is read completely.
+     *  @param projection elements to be read, NULL (default) reads all elements. The
+     *    projection is not copied and must not be deleted while the dataset is read.
+     */
+    void setReadProjection(const DcmReadProjection *projection);
+
     /** print all elements of the dataset to a stream
      *  @param out output stream
      *  @param flags optional flag used to customize the output (see DCMTypes::PF_xxx)
@@ -368,6 +378,18 @@ class DCMTK_DCMDATA_EXPORT DcmDataset
     OFCondition chooseRepresentation(const E_TransferSyntax repType,
                                      const DcmRepresentationParameter *repParam);
 
+    /** select a specific representation like chooseRepresentation(), but compress the
+     *  top-level pixel data of multi-frame images one frame at a time (see
+     *  DcmPixelData::chooseRepresentationFrameByFrame()). Peak memory is then bounded
+     *  by a few frames instead of the complete uncompressed image. Falls back to
+     *  chooseRepresentation() if the frames cannot be processed individually.
+     *  @param repType desired transfer syntax
+     *  @param repParam desired representation parameter (e.g. quality factor for lossy compression)
+     *  @return EC_Normal upon success, an error code otherwise.
+     */
+    OFCondition chooseRepresentationFrameByFrame(const E_TransferSyntax repType,
+                                                 const DcmRepresentationParameter *repParam);
+
     /** check if all PixelData elements in this dataset have a representation conforming
      *  to the given transfer syntax and representation parameters (see dcpixel.h for
      *  definition of "conforming").
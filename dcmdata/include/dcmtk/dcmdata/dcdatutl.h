@@ -36,6 +36,16 @@ class DCMTK_DCMDATA_EXPORT DcmDataUtil
 
 public:
 
+  /** Check whether a file looks like a DICOM file without parsing it.
+   *  Only the first 132 bytes are read: the file is accepted if it contains
+   *  the "DICM" prefix after a 128 byte preamble or, for files without
+   *  preamble, if it starts with a data element of the command, meta-header
+   *  or identifying groups (0000-0008) in any byte order and VR encoding.
+   *  @param  filename Name of the file to be checked
+   *  @return OFTrue if the file might be a DICOM file, OFFalse otherwise
+   */
+  static OFBool isDicomFile(const OFFilename &filename);
+
   /** Get SOP Class UID, SOP Instance UID and Transfer Syntax UID from a DICOM
    *  file. The first two UID values are either copied from the meta-header
    *  (preferred) or from the dataset. The latter is either copied from the
@@ -301,6 +301,20 @@ class DCMTK_DCMDATA_EXPORT DicomDirInterface
     OFCondition addDicomFile(const OFFilename &filename,
                              const OFFilename &directory = OFFilename());
 
+    /** add specified DICOM file to the current DICOMDIR, with its attributes given
+     *  instead of loaded from the file, e.g. by a database that indexed the file.
+     *  The file itself is not accessed, so it might not even exist (yet).  The
+     *  attributes are checked like those of a loaded file.
+     *  @param filename name of the DICOM file to be added
+     *  @param fileformat file meta information (with the SOP class, SOP instance and
+     *    transfer syntax of the file) and the attributes of the records referring to it
+     *  @param directory directory where the DICOM file is stored (optional)
+     *  @return EC_Normal upon success, an error code otherwise
+     */
+    OFCondition addDicomFile(const OFFilename &filename,
+                             DcmFileFormat &fileformat,
+                             const OFFilename &directory = OFFilename());
+
     /** set the file-set descriptor file ID and character set.
      *  Prior to any internal modification both 'filename' and 'charset' are checked
      *  using the above checking routines.  Existence of 'filename' is not checked.
@@ -614,6 +628,24 @@ class DCMTK_DCMDATA_EXPORT DicomDirInterface
                                       DcmFileFormat &fileformat,
                                       const OFBool checkFilename = OFTrue);
 
+    /** check the content of a loaded DICOM file regarding the current application profile
+     *  @param filename name of the DICOM file to be checked
+     *  @param fileformat object in which the loaded data is stored
+     *  @return EC_Normal upon success, an error code otherwise
+     */
+    OFCondition checkFileFormat(const OFFilename &filename,
+                                DcmFileFormat &fileformat);
+
+    /** add the records of a checked DICOM file to the current DICOMDIR
+     *  @param filename name of the DICOM file to be added
+     *  @param directory directory where the DICOM file is stored
+     *  @param fileformat object in which the data of the file is stored
+     *  @return EC_Normal upon success, an error code otherwise
+     */
+    OFCondition addRecords(const OFFilename &filename,
+                           const OFFilename &directory,
+                           DcmFileFormat &fileformat);
+
     /** check SOP class and transfer syntax for compliance with current profile
      *  @param metainfo object where the DICOM file meta information is stored
      *  @param dataset object where the DICOM dataset is stored
@@ -27,6 +27,9 @@
 
 #include "dcmtk/ofstd/ofthread.h"
 #include "dcmtk/dcmdata/dchashdi.h"
+#include "dcmtk/dcmdata/dcdicent.h"
+
+#include <atomic>
 
 /// maximum length of a line in the loadable DICOM dictionary
 #define DCM_MAXDICTLINESIZE     2048
@@ -50,6 +53,26 @@
 #endif
 
 
+/** an entry of the builtin dictionary as generated by mkdictbi. The
+ *  non-repeating public entries stay in a static table of these, sorted by
+ *  tag, and a DcmDictEntry is only created for those that are looked up.
+ */
+struct DCMTK_DCMDATA_EXPORT DcmDictBuiltinEntry
+{
+    Uint16 group;
+    Uint16 element;
+    Uint16 upperGroup;
+    Uint16 upperElement;
+    DcmEVR evr;
+    const char* tagName;
+    int vmMin;
+    int vmMax;
+    const char* standardVersion;
+    DcmDictRangeRestriction groupRestriction;
+    DcmDictRangeRestriction elementRestriction;
+    const char* privateCreator;
+};
+
 /** this class implements a loadable DICOM Data Dictionary
  */
 class DCMTK_DCMDATA_EXPORT DcmDataDictionary
@@ -72,8 +95,11 @@ public:
      */
     OFBool isDictionaryLoaded() const { return dictionaryLoaded; }
 
-    /// returns the number of normal (non-repeating) tag entries
-    int numberOfNormalTagEntries() const { return hashDict.size(); }
+    /** returns the number of normal (non-repeating) tag entries. Builtin
+     *  entries also in the hash dictionary, e.g. those of the skeleton or
+     *  replaced by a loaded dictionary, are counted twice.
+     */
+    int numberOfNormalTagEntries() const { return hashDict.size() + OFstatic_cast(int, builtinCount); }
 
     /// returns the number of repeating tag entries
     int numberOfRepeatingTagEntries() const { return OFstatic_cast(int, repDict.size()); }
@@ -138,7 +164,10 @@ public:
      */
     void addEntry(DcmDictEntry* entry);
 
-    /* Iterators to access the normal and the repeating entries */
+    /* Iterators to access the normal and the repeating entries. The
+     * non-repeating public entries of the builtin dictionary are not
+     * part of the normal entries.
+     */
 
     /// returns an iterator to the start of the normal (non-repeating) dictionary
     DcmHashDictIterator normalBegin() { return hashDict.begin(); }
@@ -152,6 +181,29 @@ public:
     /// returns an iterator to the end of the repeating tag dictionary
     DcmDictEntryListIterator repeatingEnd() { return repDict.end(); }
 
+    /** returns the first slot probed for a tag of the builtin dictionary
+     *  in its hash table, as generated by mkdictbi
+     *  @param key tag as (group << 16 | element)
+     *  @param mask number of slots minus one, a power of two minus one
+     *  @return slot index
+     */
+    static size_t builtinSlot(Uint32 key, size_t mask)
+    {
+        return (OFstatic_cast(Uint32, key * 0x9e3779b1U) >> 16) & mask;
+    }
+
+    /** builds a sorted array of the standard (non-private, non-repeating)
+     *  entries of the hash dictionary, which is then searched instead of it for
+     *  lookups without private creator. The array is discarded when the
+     *  dictionary is modified.
+     */
+    void freeze();
+
+    /** checks if the sorted array of standard entries is present
+     *  @return true if freeze() has been called and the dictionary has not been modified since
+     */
+    OFBool isFrozen() const { return standardEntries != NULL; }
+
 private:
 
     /** private undefined assignment operator
@@ -167,7 +219,8 @@ private:
      */
     OFBool loadExternalDictionaries();
 
-    /** loads a builtin (compiled) data dictionary.
+    /** loads a builtin (compiled) data dictionary: points builtinEntries to
+     *  its static table of non-repeating public entries and adds the others.
      *  Depending on which code is in use, this function may not
      *  do anything.
      */
@@ -187,6 +240,38 @@ private:
      */
     void deleteEntry(const DcmDictEntry& entry);
 
+    /** deletes the sorted array of standard entries built by freeze()
+     */
+    void unfreeze();
+
+    /** looks up a standard entry in the sorted array built by freeze()
+     *  @param key tag key
+     *  @return pointer to entry if found, NULL otherwise
+     */
+    const DcmDictEntry* findStandardEntry(const DcmTagKey& key) const;
+
+    /** returns the index of key in builtinKeys, builtinCount if absent.
+     *  Probes builtinSlots from builtinSlot() on.
+     */
+    size_t builtinIndex(const DcmTagKey& key) const;
+
+    /** looks up a non-repeating public entry of the builtin dictionary
+     *  @param key tag key
+     *  @return pointer to entry if found, NULL otherwise
+     */
+    const DcmDictEntry* findBuiltinEntry(const DcmTagKey& key) const;
+
+    /** looks up a non-repeating public entry of the builtin dictionary
+     *  @param name attribute name
+     *  @return pointer to entry if found, NULL otherwise
+     */
+    const DcmDictEntry* findBuiltinEntry(const char *name) const;
+
+    /** returns the entry created from builtinEntries[index], creating it
+     *  on first use. Safe to call from concurrent readers.
+     */
+    const DcmDictEntry* builtinEntry(size_t index) const;
+
 
     /** dictionary of normal tags
      */
@@ -204,6 +289,54 @@ private:
      */
     OFBool dictionaryLoaded;
 
+    /** tag keys (group << 16 | element) of the standard entries in
+     *  ascending order, NULL unless frozen
+     */
+    Uint32 *standardKeys;
+
+    /** standard entries in the same order as standardKeys, NULL unless frozen
+     */
+    const DcmDictEntry **standardEntries;
+
+    /** number of standard entries
+     */
+    size_t standardCount;
+
+    /** non-repeating public entries of the builtin dictionary in ascending
+     *  tag order, NULL unless it is loaded. Entries of the hash dictionary
+     *  with the same tag take precedence.
+     */
+    const DcmDictBuiltinEntry *builtinEntries;
+
+    /** the tags of builtinEntries as (group << 16 | element), compared
+     *  instead of them
+     */
+    const Uint32 *builtinKeys;
+
+    /** hash table of indexes into builtinEntries with linear probing,
+     *  0xffff for an empty slot
+     */
+    const Uint16 *builtinSlots;
+
+    /** number of builtinSlots minus one, a power of two minus one
+     */
+    size_t builtinSlotMask;
+
+    /** the entries created from builtinEntries so far, by index, shared by
+     *  all dictionaries that loaded the builtin one
+     */
+    std::atomic<const DcmDictEntry*> *builtinCreated;
+
+    /** number of builtinEntries
+     */
+    size_t builtinCount;
+
+    /** number of entries added to the hash dictionary after the builtin one
+     *  that replace one of builtinEntries. While there are none, the builtin
+     *  entries are searched first.
+     */
+    size_t builtinShadowed;
+
 };
 
 
@@ -211,7 +344,8 @@ private:
  *  attribute VR, tag names and so on.  The dictionary is internally populated
  *  on first use, if the user accesses it via rdlock() or wrlock().  The
  *  dictionary allows safe read (shared) and write (exclusive) access from
- *  multiple threads in parallel.
+ *  multiple threads in parallel. Once frozen, read access does not lock
+ *  the dictionary any more.
  */
 class DCMTK_DCMDATA_EXPORT GlobalDcmDataDictionary
 {
@@ -225,13 +359,14 @@ public:
   ~GlobalDcmDataDictionary();
 
   /** acquires a read lock and returns a const reference to
-   *  the dictionary.
+   *  the dictionary. No lock is acquired if the dictionary is frozen.
    *  @return const reference to dictionary
    */
   const DcmDataDictionary& rdlock();
 
   /** acquires a write lock and returns a non-const reference
-   *  to the dictionary.
+   *  to the dictionary. A frozen dictionary must not be modified since
+   *  readers do not lock it.
    *  @return non-const reference to dictionary.
    */
   DcmDataDictionary& wrlock();
@@ -258,6 +393,22 @@ public:
    */
   void clear();
 
+  /** makes the dictionary immutable. The dictionary is loaded if necessary
+   *  and standard entries are looked up in a sorted array afterwards.
+   *  From then on, rdlock() and rdunlock() do not lock, so that parallel
+   *  parsers do not contend for the read/write lock. This is meant to be
+   *  called once at startup, after all private and external dictionaries
+   *  have been added. It must not be called with another lock on the
+   *  dictionary being held by the calling thread, and the dictionary must
+   *  not be modified afterwards.
+   */
+  void freeze();
+
+  /** checks if the dictionary has been frozen
+   *  @return OFTrue if freeze() has been called, OFFalse otherwise
+   */
+  OFBool isFrozen() const;
+
 private:
   /** private undefined assignment operator
    */
@@ -282,6 +433,12 @@ private:
    *  support enabled.
    */
   OFReadWriteLock dataDictLock;
+
+  /** true after freeze(), read without locking
+   *  @remark this member is only available if DCMTK is compiled with thread
+   *  support enabled.
+   */
+  std::atomic<bool> frozen;
 #endif
 };
 
@@ -0,0 +1,114 @@
+/*
+ *
+ *  Copyright (C) 1994-2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmdata
+ *
+ *  Purpose: frame parallel encoding and decoding of multi-frame pixel data
+ *
+ */
+
+#ifndef DCFRMTHR_H
+#define DCFRMTHR_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+
+#include "dcmtk/dcmdata/dcdefine.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/dcmdata/dcofsetl.h"   /* for class DcmOffsetList */
+
+class DcmPixelSequence;
+
+/** abstract task compressing single frames of a multi-frame image.
+ *  encodeFrame() is called concurrently for different frames and must therefore
+ *  not modify shared state such as the dataset or a shared pixel sequence.
+ */
+class DCMTK_DCMDATA_EXPORT DcmFrameEncodeTask
+{
+public:
+
+  /// destructor
+  virtual ~DcmFrameEncodeTask() {}
+
+  /** compresses one frame.
+   *  @param frameNo number of the frame to compress, starting with 0
+   *  @param compressedData pointer to the compressed frame, allocated with new[], on return.
+   *    Ownership is transferred to the caller.
+   *  @param compressedLen length of the compressed frame in bytes on return
+   *  @return EC_Normal if successful, an error code otherwise
+   */
+  virtual OFCondition encodeFrame(Uint32 frameNo, Uint8 *&compressedData, Uint32 &compressedLen) const = 0;
+};
+
+
+/** abstract task decompressing single frames of a multi-frame image.
+ *  decodeFrame() is called concurrently for different frames, each call
+ *  must write to its own region of the uncompressed pixel data only.
+ */
+class DCMTK_DCMDATA_EXPORT DcmFrameDecodeTask
+{
+public:
+
+  /// destructor
+  virtual ~DcmFrameDecodeTask() {}
+
+  /** decompresses one frame.
+   *  @param frameNo number of the frame to decompress, starting with 0
+   *  @return EC_Normal if successful, an error code otherwise
+   */
+  virtual OFCondition decodeFrame(Uint32 frameNo) const = 0;
+};
+
+
+/** helper for codecs that process the frames of a multi-frame image independently.
+ *  Frames are distributed over a number of worker threads, with numThreads <= 1
+ *  all frames are processed in order by the calling thread.
+ */
+class DCMTK_DCMDATA_EXPORT DcmFrameThreads
+{
+public:
+
+  /** compresses all frames and stores them in the pixel sequence in frame order.
+   *  The fragments are written by the calling thread, frames compressed ahead of
+   *  their predecessors are kept in memory, at most two per thread.
+   *  Processing stops at the first frame that fails to compress.
+   *  @param task task compressing a single frame
+   *  @param frameCount number of frames to compress
+   *  @param numThreads maximum number of worker threads
+   *  @param pixelSequence pixel sequence the fragments are appended to
+   *  @param offsetList offset list updated for each frame, see DcmPixelSequence::storeCompressedFrame()
+   *  @param fragmentSize maximum fragment size in kbytes, 0 for unlimited
+   *  @param compressedSize total size of all compressed frames in bytes on return
+   *  @return EC_Normal if successful, the error of the first failing frame otherwise
+   */
+  static OFCondition encodeFrames(
+    const DcmFrameEncodeTask &task,
+    Uint32 frameCount,
+    Uint16 numThreads,
+    DcmPixelSequence *pixelSequence,
+    DcmOffsetList &offsetList,
+    Uint32 fragmentSize,
+    size_t &compressedSize);
+
+  /** decompresses all frames.
+   *  @param task task decompressing a single frame
+   *  @param frameCount number of frames to decompress
+   *  @param numThreads maximum number of worker threads
+   *  @return EC_Normal if successful, the error of the first failing frame otherwise
+   */
+  static OFCondition decodeFrames(
+    const DcmFrameDecodeTask &task,
+    Uint32 frameCount,
+    Uint16 numThreads);
+};
+
+#endif
@@ -25,9 +25,97 @@
 
 #include "dcmtk/config/osconfig.h"
 #include "dcmtk/dcmdata/dcistrma.h"
+#include "dcmtk/ofstd/ofglobal.h"
+
+/** global flag defining whether DcmFileProducer maps files into memory
+ *  instead of reading them through stdio. Skipping over values, e.g.\ large
+ *  elements that are not loaded, then does not touch the skipped pages at all,
+ *  and reading copies directly from the page cache. Files that cannot be
+ *  mapped are read through stdio. Default is true.
+ */
+extern DCMTK_DCMDATA_EXPORT OFGlobal<OFBool> dcmMemoryMappedFileInput;
+
+struct DcmFileMapping;
+
+/** process-wide cache of memory mapped input files.
+ *  Mappings are keyed by file path and checked against the modification time
+ *  and size of the file, so opening a file that is still cached, e.g.\ for
+ *  loading a deferred element value or sending the same instance again, skips
+ *  opening and mapping the file. Mappings no longer used by any producer are
+ *  kept up to the configured number of entries, least recently used ones are
+ *  unmapped first. The cache is disabled by default and is thread safe.
+ */
+class DCMTK_DCMDATA_EXPORT DcmFileMapCache
+{
+public:
+
+  /** sets the number of unused mappings kept, 0 disables the cache.
+   *  Excess entries are unmapped immediately.
+   *  @param maxEntries maximum number of unused mappings
+   */
+  static void setMaxEntries(size_t maxEntries);
+
+  /** returns the number of unused mappings kept
+   *  @return maximum number of unused mappings
+   */
+  static size_t getMaxEntries();
+
+  /** returns the number of files opened from the cache
+   *  @return number of cache hits
+   */
+  static size_t hits();
+
+  /** returns the number of files that had to be mapped while the cache was enabled
+   *  @return number of cache misses
+   */
+  static size_t misses();
+
+  /** returns the number of cached mappings, including the ones in use
+   *  @return number of entries
+   */
+  static size_t entries();
+
+  /** unmaps all unused mappings, mappings in use are not affected
+   */
+  static void clear();
+
+  /** looks up the mapping of a file that has not changed since it was mapped.
+   *  Used by DcmFileProducer only.
+   *  @param filename name of the file
+   *  @return mapping, to be released with release(), or NULL if not cached
+   */
+  static DcmFileMapping *acquire(const OFFilename &filename);
+
+  /** maps an open file and adds the mapping to the cache if enabled.
+   *  Used by DcmFileProducer only.
+   *  @param filename name of the file
+   *  @param file open file, the mapping stays valid after the file is closed
+   *  @param size size of the file in bytes
+   *  @return mapping, to be released with release(), or NULL if the file cannot be mapped
+   */
+  static DcmFileMapping *map(const OFFilename &filename, OFFile &file, offile_off_t size);
+
+  /** releases a mapping returned by acquire() or map()
+   *  @param mapping mapping to release
+   */
+  static void release(DcmFileMapping *mapping);
+
+  /** returns the start of a mapped file
+   *  @param mapping mapping returned by acquire() or map()
+   *  @return pointer to the first byte of the file
+   */
+  static const unsigned char *data(const DcmFileMapping *mapping);
+
+  /** returns the size of a mapped file
+   *  @param mapping mapping returned by acquire() or map()
+   *  @return size of the file in bytes
+   */
+  static offile_off_t size(const DcmFileMapping *mapping);
+};
 
 
 /** producer class that reads data from a plain file.
+ *  The file is mapped into memory if dcmMemoryMappedFileInput is set.
  */
 class DCMTK_DCMDATA_EXPORT DcmFileProducer: public DcmProducer
 {
@@ -95,9 +183,24 @@ private:
   /// private unimplemented copy assignment operator
   DcmFileProducer& operator=(const DcmFileProducer&);
 
-  /// the file we're actually reading from
+  /** maps the open file into memory and closes it if successful
+   *  @param filename name of the open file
+   *  @param offset byte offset to start reading at
+   */
+  void mapFile(const OFFilename &filename, offile_off_t offset);
+
+  /// the file we're actually reading from, closed if the file is mapped
   OFFile file_;
 
+  /// mapping of the file, NULL if the file is read through file_
+  DcmFileMapping *mapping_;
+
+  /// start of the mapped file, NULL if the file is read through file_
+  const unsigned char *map_;
+
+  /// read position in the mapped file
+  offile_off_t mapPos_;
+
   /// status
   OFCondition status_;
 
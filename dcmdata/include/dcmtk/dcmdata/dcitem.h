@@ -35,6 +35,7 @@
 // forward declarations
 class DcmElement;
 class DcmJsonFormat;
+class DcmReadProjection;
 class DcmSequenceOfItems;
 class DcmSpecificCharacterSet;
 
@@ -1354,6 +1355,16 @@ class DCMTK_DCMDATA_EXPORT DcmItem
      */
     offile_off_t fStartPosition;
 
+    /** used during reading of the main data set. Selects the elements that
+     *  are read, see DcmDataset::setReadProjection(). NULL reads all elements.
+     */
+    const DcmReadProjection *readProjection;
+
+    /** used during reading. Number of bytes of the value of an element outside
+     *  readProjection that are still to be skipped in the stream.
+     */
+    Uint32 fSkipValueBytes;
+
     /** This function reads tag and length information from inStream and
      *  returns this information to the caller. When reading information,
      *  the transfer syntax which was passed is accounted for. If the
@@ -1378,6 +1389,52 @@ class DCMTK_DCMDATA_EXPORT DcmItem
                                  Uint32 &length,                 // out
                                  Uint32 &bytesRead);             // out
 
+    /** This function reads tag and length information like readTagAndLength(),
+     *  specialized for Explicit and Implicit VR Little Endian on a little endian
+     *  machine, which cover most data sets. readUntilTag() selects it once per
+     *  item and passes in the global options which readTagAndLength() looks up
+     *  for each element. A header which is not completely available in inStream
+     *  or carries a non-standard VR is read by readTagAndLength().
+     *  @tparam explicitVR OFTrue for Explicit VR, OFFalse for Implicit VR Little Endian
+     *  @param inStream  The stream which contains the information.
+     *  @param preferVRFromDataDictionary value of dcmPreferVRFromDataDictionary
+     *  @param preferLengthFieldSizeFromDataDictionary value of
+     *    dcmPreferLengthFieldSizeFromDataDictionary
+     *  @param tag       Contains in the end the tag that was read.
+     *  @param length    Contains in the end the length value that was read.
+     *  @param bytesRead Contains in the end the amount of bytes which were
+     *                   read from inStream.
+     *  @return status, EC_Normal if successful, an error code otherwise
+     */
+    template <OFBool explicitVR>
+    OFCondition readTagAndLengthLittleEndian(DcmInputStream &inStream,                             // inout
+                                             const OFBool preferVRFromDataDictionary,              // in
+                                             const OFBool preferLengthFieldSizeFromDataDictionary, // in
+                                             DcmTag &tag,                                          // out
+                                             Uint32 &length,                                       // out
+                                             Uint32 &bytesRead);                                   // out
+
+    /** This function checks the length of an element whose tag and length were
+     *  just read: odd lengths are reported, private attributes with undefined
+     *  length are turned into sequences if desired, and the length is checked
+     *  against the remaining bytes of a surrounding item with explicit length.
+     *  @param inStream    The stream the element is read from.
+     *  @param tag         The tag that was read, its VR may be updated.
+     *  @param valueLength The length value that was read.
+     *  @return status, EC_Normal if successful, an error code otherwise
+     */
+    OFCondition checkElementLength(DcmInputStream &inStream,   // inout
+                                   DcmTag &tag,                // inout
+                                   const Uint32 valueLength);  // in
+
+    /** This function skips the value of an element outside readProjection,
+     *  fSkipValueBytes bytes of it are still in inStream.
+     *  @param inStream The stream which contains the value.
+     *  @return EC_Normal if the value has been skipped completely,
+     *    EC_StreamNotifyClient if more data is needed, an error code otherwise
+     */
+    OFCondition skipElementValue(DcmInputStream &inStream);  // inout
+
     /** This function creates a new DcmElement object on the basis of the newTag
      *  and newLength information which was passed, inserts this new element into
      *  elementList, reads the actual data value which belongs to this element
@@ -1473,6 +1530,22 @@ class DCMTK_DCMDATA_EXPORT DcmItem
                                   DcmStack &resultStack,         // inout
                                   OFBool searchIntoSub );        // in
 
+    /** helper function for searchSubFromHere(). Looks up an element of this item
+     *  (not of its sub-items) by binary search in an index of the elements sorted
+     *  by tag. The index is only built once an item with a larger number of
+     *  elements is searched repeatedly, and it is rebuilt whenever the element
+     *  list has been modified since.
+     *  @param tag tag key to be searched
+     *  @param indexed set to true if the index was used, false if the element
+     *    list must be searched instead
+     *  @return pointer to element if found in the index, NULL otherwise
+     */
+    DcmObject *findInSearchIndex(const DcmTagKey &tag,
+                                 OFBool &indexed);
+
+    /// deletes the search index built by findInSearchIndex()
+    void clearSearchIndex();
+
     /** helper function that interprets the given pointer as a pointer to an
      *  array of two characters and checks whether these two characters form
      *  a valid standard DICOM VR.
@@ -1483,6 +1556,18 @@ class DCMTK_DCMDATA_EXPORT DcmItem
 
     /// cache for private creator tags and names
     DcmPrivateTagCache privateCreatorCache;
+
+    /// elements of this item sorted by tag, NULL if not (yet) built
+    DcmObject **searchIndex;
+
+    /// number of elements in searchIndex
+    unsigned long searchIndexSize;
+
+    /// value of elementList->modifications() when searchCount was last reset
+    unsigned long searchIndexVersion;
+
+    /// number of searches since the element list was last modified
+    unsigned long searchCount;
 };
 
 /** Checks whether left hand side item is smaller than right hand side
@@ -136,6 +136,14 @@ public:
      */
     static void escapeControlCharacters(STD_NAMESPACE ostream &out, OFString const &value);
 
+    /** Escapes all forbidden control characters in JSON.
+     *  Runs of characters that need no escaping are written in one piece.
+     *  @param out output stream to which the escaped String is written
+     *  @param value characters that should be escaped
+     *  @param length number of characters
+     */
+    static void escapeControlCharacters(STD_NAMESPACE ostream &out, const char *value, size_t length);
+
     /** Normalize Decimal String to specific JSON format.
      *  remove leading zeros, except before dot.
      *  @b Example:
@@ -195,6 +203,17 @@ public:
     static void printNumberDecimal(STD_NAMESPACE ostream &out,
                                    OFString &value);
 
+    /** Print a binary floating point value (FD, FL) as a JSON number.
+     *  Produces the same digits as OFStandard::ftoa() with the given precision,
+     *  integral values are written without going through the float formatter.
+     *  @param out output stream to which the number is written
+     *  @param value number that should be printed
+     *  @param precision number of significant digits
+     */
+    static void printNumberDecimal(STD_NAMESPACE ostream &out,
+                                   Float64 value,
+                                   int precision);
+
     /** Constructor
      *  @param printMetaInfo parameter that defines if meta information should be written
      */
@@ -164,6 +164,12 @@ public:
     /// return true if current node exists, false otherwise
     inline OFBool valid(void) const { return currentNode != NULL; }
 
+    /** return the number of insert and remove operations performed so far.
+     *  Allows users of the list to detect whether cached information about
+     *  the list content is still valid.
+     */
+    inline unsigned long modifications() const { return modificationCount; }
+
 private:
     /// pointer to first node in list
     DcmListNode *firstNode;
@@ -176,6 +182,9 @@ private:
 
     /// number of elements in list
     unsigned long cardinality;
+
+    /// number of insert and remove operations, see modifications()
+    unsigned long modificationCount;
  
     /// private undefined copy constructor 
     DcmList &operator=(const DcmList &);
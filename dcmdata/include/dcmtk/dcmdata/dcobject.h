@@ -33,6 +33,8 @@
 #include "dcmtk/dcmdata/dctag.h"
 #include "dcmtk/dcmdata/dcstack.h"
 
+#include <new>
+
 
 // forward declarations
 class DcmItem;
@@ -227,6 +229,17 @@ extern DCMTK_DCMDATA_EXPORT OFGlobal<OFBool> dcmConvertVOILUTSequenceOWtoSQ; /*
  */
 extern DCMTK_DCMDATA_EXPORT OFGlobal<OFBool> dcmUseExplLengthPixDataForEncTS; /* default OFFalse */
 
+/** This flag influences the behaviour of the encoders when compressing
+ *  multi-frame images. If set to OFTrue, the frame offsets are stored in the
+ *  Extended Offset Table (7FE0,0001) and the frame lengths in the Extended
+ *  Offset Table Lengths (7FE0,0002) attribute, using 64-bit values, and the
+ *  Basic Offset Table is left empty. This allows for random access to the
+ *  frames of images with more than 4 GB of compressed pixel data.
+ *  If set to OFFalse (default), only the Basic Offset Table is created (if
+ *  enabled in the codec parameters).
+ */
+extern DCMTK_DCMDATA_EXPORT OFGlobal<OFBool> dcmCreateExtendedOffsetTable; /* default OFFalse */
+
 /** Abstract base class for most classes in module dcmdata. As a rule of thumb,
  *  everything that is either a dataset or that can be identified with a DICOM
  *  attribute tag is derived from class DcmObject.
@@ -250,6 +263,29 @@ class DCMTK_DCMDATA_EXPORT DcmObject
     /// destructor
     virtual ~DcmObject();
 
+    /** allocates memory for an object, from the arena of the innermost
+     *  DcmArenaScope of the current thread if there is one
+     *  @param size number of bytes
+     *  @return pointer to memory, throws std::bad_alloc if out of memory
+     */
+    static void *operator new(size_t size);
+
+    /** allocates memory for an object, see above
+     *  @param size number of bytes
+     *  @return pointer to memory, NULL if out of memory
+     */
+    static void *operator new(size_t size, const std::nothrow_t&) throw();
+
+    /** frees the memory of an object, arena memory is freed with its arena
+     *  @param ptr pointer to memory
+     */
+    static void operator delete(void *ptr);
+
+    /** frees the memory of an object, see above
+     *  @param ptr pointer to memory
+     */
+    static void operator delete(void *ptr, const std::nothrow_t&) throw();
+
     /** clone method
      *  @return deep copy of this object
      */
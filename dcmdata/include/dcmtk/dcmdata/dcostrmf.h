@@ -25,10 +25,29 @@
 
 #include "dcmtk/config/osconfig.h"
 #include "dcmtk/dcmdata/dcostrma.h"
+#include "dcmtk/ofstd/ofglobal.h"
 
 #define INCLUDE_CSTDIO
 #include "dcmtk/ofstd/ofstdinc.h"
 
+/** Files expected to be at least this many bytes long are preallocated on
+ *  disk before they are written, so that they are not fragmented, and are
+ *  written in blocks of DcmFileConsumer_LARGE_BLOCK_SIZE bytes instead of
+ *  through the default stdio buffer. 0 (default) disables both.
+ */
+extern DCMTK_DCMDATA_EXPORT OFGlobal<Uint32> dcmLargeFileWriteSize; /* default 0 */
+
+/** Files expected to be at least this many bytes long are written with
+ *  direct I/O, bypassing the page cache (O_DIRECT on Linux, F_NOCACHE on
+ *  macOS, not supported on other systems), so that writing large objects
+ *  does not evict cached data that is read again. They are preallocated as
+ *  well. 0 (default) disables direct I/O.
+ */
+extern DCMTK_DCMDATA_EXPORT OFGlobal<Uint32> dcmDirectFileWriteSize; /* default 0 */
+
+/// size of the aligned blocks large files are written in
+#define DcmFileConsumer_LARGE_BLOCK_SIZE 4194304 /* 4 MByte */
+
 
 /** consumer class that stores data in a plain file.
  */
@@ -41,6 +60,15 @@ public:
    */
   DcmFileConsumer(const OFFilename &filename);
 
+  /** constructor for a file of about the given size, which is preallocated
+   *  and written in large blocks or with direct I/O depending on
+   *  dcmLargeFileWriteSize and dcmDirectFileWriteSize
+   *  @param filename name of file to be created (may contain wide chars
+   *    if support enabled)
+   *  @param expectedLength expected length of the file in bytes, 0 if unknown
+   */
+  DcmFileConsumer(const OFFilename &filename, offile_off_t expectedLength);
+
   /** constructor
    *  @param file structure, file must already be open for writing
    */
@@ -93,6 +121,21 @@ public:
 
 private:
 
+  /** opens the file for direct I/O, falls back to buffered I/O if the
+   *  file system does not support it
+   *  @param filename name of file to be created
+   *  @return true if the file is open for direct I/O
+   */
+  OFBool openDirect(const OFFilename &filename);
+
+  /** writes a part of the block buffer to the file opened for direct I/O
+   *  @param data start of the part, aligned unless the file is no longer
+   *    written with direct I/O
+   *  @param length number of bytes, a multiple of the alignment unless the
+   *    file is no longer written with direct I/O
+   */
+  void writeBlock(const unsigned char *data, size_t length);
+
   /// private unimplemented copy constructor
   DcmFileConsumer(const DcmFileConsumer&);
 
@@ -104,6 +147,15 @@ private:
 
   /// status
   OFCondition status_;
+
+  /// descriptor of a file written with direct I/O, -1 if file_ is used
+  int directFd_;
+
+  /// aligned block buffer collecting the data written to directFd_
+  unsigned char *block_;
+
+  /// number of bytes in block_
+  size_t blockUsed_;
 };
 
 
@@ -118,6 +170,14 @@ public:
    */
   DcmOutputFileStream(const OFFilename &filename);
 
+  /** constructor for a file of about the given size, see
+   *  DcmFileConsumer(const OFFilename &, offile_off_t)
+   *  @param filename name of file to be created (may contain wide chars
+   *    if support enabled)
+   *  @param expectedLength expected length of the file in bytes, 0 if unknown
+   */
+  DcmOutputFileStream(const OFFilename &filename, offile_off_t expectedLength);
+
   /** constructor
    *  @param file structure, file must already be open for writing
    */
@@ -444,6 +444,28 @@ public:
         const DcmRepresentationParameter * repParam,
         DcmStack & stack);
 
+    /** create an encapsulated representation of a multi-frame image one frame at a
+     *  time. Each frame is decompressed (or read from file) on its own, compressed
+     *  in a temporary single-frame copy of the dataset and its fragments are moved
+     *  to the new pixel sequence, so the complete uncompressed image never has to
+     *  be kept in memory. Fragments of the original representation that can be
+     *  reloaded from file are released once their frame is done. The new
+     *  representation replaces all others and becomes the original one.
+     *  Attributes the encoder changes for the first frame (e.g. Photometric
+     *  Interpretation or SOP Instance UID) are applied to the dataset, the lossy
+     *  compression ratio is updated for the complete image.
+     *  @param repType desired encapsulated transfer syntax
+     *  @param repParam desired representation parameter, may be NULL
+     *  @param dataset dataset in which this pixel data object is located
+     *  @return EC_Normal if successful, EC_CannotChangeRepresentation if the image
+     *    has a single frame only or no frame level codec is available, another error
+     *    code otherwise. On failure, the pixel data and the dataset are unchanged.
+     */
+    OFCondition chooseRepresentationFrameByFrame(
+        const E_TransferSyntax repType,
+        const DcmRepresentationParameter * repParam,
+        DcmItem *dataset);
+
     /** Inserts an original encapsulated representation. current and original
      *  representations are changed, all old representations are deleted
      */
@@ -0,0 +1,79 @@
+/*
+ *
+ *  Copyright (C) 1994-2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmdata
+ *
+ *  Purpose: selection of the elements of a data set that are read
+ *
+ */
+
+#ifndef DCPROJ_H
+#define DCPROJ_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+
+#include "dcmtk/dcmdata/dctagkey.h"
+#include "dcmtk/ofstd/ofvector.h"
+
+/** selection of the elements of the main data set that are read, see
+ *  DcmDataset::setReadProjection(). The value of an element outside the
+ *  selection is skipped in the stream without creating an element for it,
+ *  and parsing stops at the first element behind the selection.
+ *  Specific Character Set and private creator elements are always read,
+ *  the first is needed to interpret the selected string values, the others
+ *  to recognize selected private elements. Elements of undefined length
+ *  are read like selected ones since their end is only found by parsing.
+ *  A projection without tags and without last group selects all elements.
+ */
+class DCMTK_DCMDATA_EXPORT DcmReadProjection
+{
+public:
+
+  /// constructor, selects all elements
+  DcmReadProjection();
+
+  /** adds an element to the selection. Once a tag has been added, only the
+   *  added elements are read and parsing stops behind the largest of them.
+   *  @param tag tag key of the element
+   */
+  void addTag(const DcmTagKey &tag);
+
+  /** limits the selection to the elements up to the given group, parsing
+   *  stops at the first element of a later group
+   *  @param group last group that is read
+   */
+  void setLastGroup(const Uint16 group);
+
+  /** checks whether an element is selected
+   *  @param tag tag key of the element
+   *  @return OFTrue if the element is read, OFFalse if its value is skipped
+   */
+  OFBool isSelected(const DcmTagKey &tag) const;
+
+  /** checks whether an element comes after all selected elements, in which
+   *  case nothing more of the data set needs to be read
+   *  @param tag tag key of the element
+   *  @return OFTrue if parsing can stop at this element, OFFalse otherwise
+   */
+  OFBool isBehind(const DcmTagKey &tag) const;
+
+private:
+
+  /// the added tags in ascending order
+  OFVector<DcmTagKey> tags_;
+
+  /// last group that is read
+  Uint16 lastGroup_;
+};
+
+#endif
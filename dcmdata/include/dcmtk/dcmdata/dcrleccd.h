@@ -175,6 +175,42 @@ private:
 
   /// private undefined copy assignment operator
   DcmRLECodecDecoder& operator=(const DcmRLECodecDecoder&);
+
+  /** decompresses a frame stored in a single fragment. Each segment (one byte
+   *  of one sample of every pixel) is decompressed into a plane of its own,
+   *  the planes are then interleaved into the frame. Segments that are
+   *  already contiguous in the frame, as for 8 bit images, are decompressed
+   *  in place.
+   *  @param rleData compressed frame, starting with the RLE header
+   *  @param fragmentLength length of the compressed frame in bytes
+   *  @param frame buffer for the decompressed frame in little endian byte order
+   *  @param columns columns
+   *  @param rows rows
+   *  @param samplesPerPixel samples per pixel
+   *  @param bytesAllocated bytes allocated per sample
+   *  @param planarConfiguration planar configuration
+   *  @param reverseByteOrder true if the segments are stored from LSB to MSB,
+   *    see DcmRLECodecParameter::getReverseDecompressionByteOrder()
+   *  @param numThreads number of threads decompressing the segments, 0 or 1 for serial operation
+   *  @return EC_Normal if successful, an error code otherwise
+   */
+  static OFCondition decodeSegments(
+    const Uint8 *rleData,
+    Uint32 fragmentLength,
+    Uint8 *frame,
+    Uint16 columns,
+    Uint16 rows,
+    Uint16 samplesPerPixel,
+    Uint16 bytesAllocated,
+    Uint16 planarConfiguration,
+    OFBool reverseByteOrder,
+    Uint16 numThreads);
+
+  /// task decompressing the segments of a frame, see decodeSegments()
+  class SegmentTask;
+
+  /// task decompressing frames stored in a single fragment each, see decode()
+  class FrameTask;
 };
 
 #endif
@@ -187,6 +187,39 @@ private:
   static OFCondition updateDerivationDescription(
       DcmItem *dataset,
       double ratio);
+
+  /** compresses one frame. The bytes of each segment (one byte of one sample
+   *  of every pixel) are first gathered into a plane of their own, unless they
+   *  are contiguous in the frame already as for 8 bit images, then every row
+   *  of the plane is compressed with the same PackBits encoding as DcmRLEEncoder.
+   *  @param frame uncompressed frame in little endian byte order
+   *  @param columns columns
+   *  @param rows rows
+   *  @param samplesPerPixel samples per pixel
+   *  @param bytesAllocated bytes allocated per sample
+   *  @param planarConfiguration planar configuration
+   *  @param numThreads number of threads compressing the segments, 0 or 1 for serial operation
+   *  @param compressedData pointer to the compressed frame including the RLE header,
+   *    allocated with new[], on return. Ownership is transferred to the caller.
+   *  @param compressedLen length of the compressed frame in bytes on return
+   *  @return EC_Normal if successful, an error code otherwise
+   */
+  static OFCondition encodeSegments(
+      const Uint8 *frame,
+      Uint16 columns,
+      Uint16 rows,
+      Uint16 samplesPerPixel,
+      Uint16 bytesAllocated,
+      Uint16 planarConfiguration,
+      Uint16 numThreads,
+      Uint8 *&compressedData,
+      Uint32 &compressedLen);
+
+  /// task compressing the segments of a frame, see encodeSegments()
+  class SegmentTask;
+
+  /// task compressing the frames of an image, see encode()
+  class FrameTask;
 };
 
 #endif
@@ -44,13 +44,16 @@ public:
    *  @param pReverseDecompressionByteOrder flag indicating whether the byte order should
    *    be reversed upon decompression. Needed to correctly decode some incorrectly encoded
    *    images with more than one byte per sample.
+   *  @param pNumThreads number of threads compressing or decompressing the frames
+   *    of a multi-frame image, or the stripes of a single frame, 0 or 1 for serial operation
    */
   DcmRLECodecParameter(
     OFBool pCreateSOPInstanceUID = OFFalse,
     Uint32 pFragmentSize = 0,
     OFBool pCreateOffsetTable = OFTrue,
     OFBool pConvertToSC = OFFalse,
-    OFBool pReverseDecompressionByteOrder = OFFalse);
+    OFBool pReverseDecompressionByteOrder = OFFalse,
+    Uint16 pNumThreads = 0);
 
   /// copy constructor
   DcmRLECodecParameter(const DcmRLECodecParameter& arg);
@@ -109,6 +112,25 @@ public:
     return reverseDecompressionByteOrder;
   }
 
+  /** returns the number of threads compressing or decompressing the frames
+   *  of a multi-frame image, or the stripes of a single frame
+   *  @return number of threads, 0 or 1 for serial operation
+   */
+  Uint16 getNumThreads() const
+  {
+    return numThreads;
+  }
+
+  /** sets the number of threads compressing or decompressing the frames
+   *  of a multi-frame image, or the stripes of a single frame.
+   *  Applies to images compressed or decompressed afterwards.
+   *  @param pNumThreads number of threads, 0 or 1 for serial operation
+   */
+  void setNumThreads(Uint16 pNumThreads)
+  {
+    numThreads = pNumThreads;
+  }
+
 
 private:
 
@@ -131,6 +153,9 @@ private:
    *  decompress certain incorrectly encoded RLE images
    */
   OFBool reverseDecompressionByteOrder;
+
+  /// number of threads compressing or decompressing frames or stripes
+  Uint16 numThreads;
 };
 
 
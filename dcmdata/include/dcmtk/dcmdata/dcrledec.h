@@ -25,6 +25,9 @@
 #include "dcmtk/config/osconfig.h"
 #include "dcmtk/dcmdata/dcerror.h"
 
+#define INCLUDE_CSTRING
+#include "dcmtk/ofstd/ofstdinc.h"
+
 /** this class implements an RLE decompressor conforming to the DICOM standard.
  *  The class is loosely based on an implementation by Phil Norman <forrey@eh.org>
  */
@@ -42,6 +45,7 @@ public:
   , outputBuffer_(NULL)
   , offset_(0)
   , suspendInfo_(128)
+  , ownsBuffer_(OFTrue)
   {
     if (outputBufferSize_ == 0) fail_ = 1;
     else
@@ -51,10 +55,27 @@ public:
     }
   }
 
+  /** constructor for a decoder writing to a buffer of the caller, which
+   *  saves a copy when the decompressed stripe is needed at a known place.
+   *  @param outputBuffer buffer to which the RLE codec will write decompressed
+   *    output. Not deleted by the decoder.
+   *  @param outputBufferSize size of the output buffer (in bytes)
+   */
+  DcmRLEDecoder(void *outputBuffer, size_t outputBufferSize)
+  : fail_(0)
+  , outputBufferSize_(outputBufferSize)
+  , outputBuffer_(OFstatic_cast(unsigned char *, outputBuffer))
+  , offset_(0)
+  , suspendInfo_(128)
+  , ownsBuffer_(OFFalse)
+  {
+    if ((outputBufferSize_ == 0) || (outputBuffer_ == NULL)) fail_ = 1;
+  }
+
   /// destructor
   ~DcmRLEDecoder()
   {
-    delete[] outputBuffer_;
+    if (ownsBuffer_) delete[] outputBuffer_;
   }
 
   /** resets the decoder object to newly constructed state.
@@ -210,7 +231,8 @@ private:
        nbytes = OFstatic_cast(unsigned char, outputBufferSize_ - offset_);
      }
 
-     while (nbytes--) outputBuffer_[offset_++] = ch;
+     memset(outputBuffer_ + offset_, ch, nbytes);
+     offset_ += nbytes;
   }
 
 
@@ -227,7 +249,8 @@ private:
        nbytes = OFstatic_cast(unsigned char, outputBufferSize_ - offset_);
      }
 
-     while (nbytes--) outputBuffer_[offset_++] = *cp++;
+     memcpy(outputBuffer_ + offset_, cp, nbytes);
+     offset_ += nbytes;
   }
 
   /* member variables */
@@ -259,6 +282,9 @@ private:
    *  If suspended during a literal run, contains number of remaining bytes in literal run minus 1 (< 128).
    */
   unsigned char suspendInfo_;
+
+  /// true if outputBuffer_ was allocated by this object
+  OFBool ownsBuffer_;
 };
 
 #endif
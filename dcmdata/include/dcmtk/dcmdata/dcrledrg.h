@@ -47,6 +47,12 @@ public:
     OFBool pCreateSOPInstanceUID = OFFalse,
     OFBool pReverseDecompressionByteOrder = OFFalse);
 
+  /** changes the number of threads decompressing the frames of a multi-frame
+   *  image, or the stripes of a single frame. Ignored if the decoder is not registered.
+   *  @param numThreads number of threads, 0 or 1 for serial operation
+   */
+  static void setNumThreads(Uint16 numThreads);
+
   /** deregisters decoder.
    *  Attention: Must not be called while other threads might still use
    *  the registered codecs, e.g. because they are currently decoding
@@ -51,6 +51,12 @@ public:
     OFBool pCreateOffsetTable = OFTrue,
     OFBool pConvertToSC = OFFalse);
 
+  /** changes the number of threads compressing the frames of a multi-frame
+   *  image, or the stripes of a single frame. Ignored if the encoder is not registered.
+   *  @param numThreads number of threads, 0 or 1 for serial operation
+   */
+  static void setNumThreads(Uint16 numThreads);
+
   /** deregisters encoder.
    *  Attention: Must not be called while other threads might still use
    *  the registered codecs, e.g. because they are currently encoding
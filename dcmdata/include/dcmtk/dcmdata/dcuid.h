@@ -345,6 +345,12 @@ DCMTK_DCMDATA_EXPORT unsigned long dcmGuessModalityBytes(const char *sopClassUID
 #define UID_JPEG2000Part2MulticomponentImageCompressionLosslessOnlyTransferSyntax "1.2.840.10008.1.2.4.92"
 /// JPEG 2000 Part 2 Multi-component Image Compression (Lossless or Lossy)
 #define UID_JPEG2000Part2MulticomponentImageCompressionTransferSyntax "1.2.840.10008.1.2.4.93"
+/// High-Throughput JPEG 2000 Image Compression (Lossless Only)
+#define UID_HTJ2KLosslessTransferSyntax         "1.2.840.10008.1.2.4.201"
+/// High-Throughput JPEG 2000 with RPCL Options Image Compression (Lossless Only)
+#define UID_HTJ2KLosslessRPCLTransferSyntax     "1.2.840.10008.1.2.4.202"
+/// High-Throughput JPEG 2000 Image Compression (Lossless or Lossy)
+#define UID_HTJ2KTransferSyntax                 "1.2.840.10008.1.2.4.203"
 /// JPIP Referenced
 #define UID_JPIPReferencedTransferSyntax        "1.2.840.10008.1.2.4.94"
 /// JPIP Referenced Deflate
@@ -120,7 +120,13 @@ typedef enum {
     /// HEVC/H.265 Main 10 Profile / Level 5.1
     EXS_HEVCMain10ProfileLevel5_1 = 40,
     /// Private GE Little Endian Implicit with big endian pixel data
-    EXS_PrivateGE_LEI_WithBigEndianPixelData = 41
+    EXS_PrivateGE_LEI_WithBigEndianPixelData = 41,
+    /// High-Throughput JPEG 2000 (lossless)
+    EXS_HighThroughputJPEG2000LosslessOnly = 42,
+    /// High-Throughput JPEG 2000 with RPCL options (lossless)
+    EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly = 43,
+    /// High-Throughput JPEG 2000 (lossless or lossy)
+    EXS_HighThroughputJPEG2000 = 44
 } E_TransferSyntax;
 
 /** enumeration of byte orders
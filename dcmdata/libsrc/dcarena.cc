@@ -0,0 +1,212 @@
+/*
+ *
+ *  Copyright (C) 1994-2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmdata
+ *
+ *  Purpose: arena allocation of DICOM objects
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcarena.h"
+
+#define INCLUDE_CSTDLIB
+#include "dcmtk/ofstd/ofstdinc.h"
+
+#include <atomic>
+#include <new>
+
+
+/* every allocation is preceded by a header naming the arena it belongs to
+ * and the size of the object, padded to keep the object maximally aligned
+ */
+union DcmArenaHeader
+{
+  struct
+  {
+    DcmArena *arena;
+    size_t size;
+  } info;
+  double alignDouble;
+  long double alignLongDouble;
+  void *alignPointer;
+};
+
+
+/** chunk of arena memory. Internal use only.
+ */
+struct DcmArenaChunk
+{
+  /// next (older) chunk
+  DcmArenaChunk *next;
+
+  /// pad the chunk header as well
+  DcmArenaHeader align;
+};
+
+
+/** monotonic arena, freed when its scope has ended and all objects are deleted.
+ *  Internal use only.
+ */
+class DcmArena
+{
+public:
+  explicit DcmArena(size_t chunkSize)
+  : chunkSize_(chunkSize < 1024 ? 1024 : chunkSize)
+  , chunks_(NULL)
+  , pos_(NULL)
+  , end_(NULL)
+  , allocated_(0)
+  , refs_(1)
+  {
+  }
+
+  ~DcmArena()
+  {
+    while (chunks_)
+    {
+      DcmArenaChunk *next = chunks_->next;
+      free(chunks_);
+      chunks_ = next;
+    }
+  }
+
+  /// allocates memory, called by the thread owning the scope only
+  void *allocate(size_t size)
+  {
+    // round up so that the next allocation is aligned as well
+    const size_t align = sizeof(DcmArenaHeader);
+    size = (size + align - 1) / align * align;
+    if (pos_ == NULL || OFstatic_cast(size_t, end_ - pos_) < size)
+    {
+      // large objects get a chunk of their own
+      const size_t dataSize = size > chunkSize_ / 4 ? size : chunkSize_;
+      DcmArenaChunk *chunk = OFstatic_cast(DcmArenaChunk *, malloc(sizeof(DcmArenaChunk) + dataSize));
+      if (chunk == NULL) return NULL;
+      char *data = OFreinterpret_cast(char *, chunk + 1);
+      if (dataSize == size && pos_ != NULL)
+      {
+        // keep allocating from the current chunk afterwards
+        chunk->next = chunks_->next;
+        chunks_->next = chunk;
+        allocated_ += size;
+        refs_.fetch_add(1, std::memory_order_relaxed);
+        return data;
+      }
+      chunk->next = chunks_;
+      chunks_ = chunk;
+      pos_ = data;
+      end_ = data + dataSize;
+    }
+    void *result = pos_;
+    pos_ += size;
+    allocated_ += size;
+    refs_.fetch_add(1, std::memory_order_relaxed);
+    return result;
+  }
+
+  /// releases one reference, deletes the arena when the last one is gone
+  void release()
+  {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
+
+  size_t allocated() const
+  {
+    return allocated_;
+  }
+
+private:
+  DcmArena(const DcmArena&);
+  DcmArena& operator=(const DcmArena&);
+
+  const size_t chunkSize_;
+  DcmArenaChunk *chunks_;
+  char *pos_;
+  char *end_;
+  size_t allocated_;
+
+  /// one reference for the open scope and one per live object
+  std::atomic<size_t> refs_;
+};
+
+
+/* arena of the innermost scope of each thread */
+static thread_local DcmArena *currentArena = NULL;
+
+/* number and size of the DcmObject instances alive in this process */
+static std::atomic<size_t> liveObjectCount(0);
+static std::atomic<size_t> liveObjectBytes(0);
+
+
+DcmArenaScope::DcmArenaScope(size_t chunkSize)
+: arena_(new DcmArena(chunkSize))
+, previous_(currentArena)
+{
+  currentArena = arena_;
+}
+
+
+DcmArenaScope::~DcmArenaScope()
+{
+  currentArena = previous_;
+  arena_->release();
+}
+
+
+size_t DcmArenaScope::bytesAllocated() const
+{
+  return arena_->allocated();
+}
+
+
+void *DcmArenaScope::allocate(size_t size)
+{
+  DcmArenaHeader *header;
+  if (currentArena)
+    header = OFstatic_cast(DcmArenaHeader *, currentArena->allocate(size + sizeof(DcmArenaHeader)));
+  else
+    header = OFstatic_cast(DcmArenaHeader *, malloc(size + sizeof(DcmArenaHeader)));
+  if (header == NULL) return NULL;
+  header->info.arena = currentArena;
+  header->info.size = size;
+  liveObjectCount.fetch_add(1, std::memory_order_relaxed);
+  liveObjectBytes.fetch_add(size, std::memory_order_relaxed);
+  return header + 1;
+}
+
+
+size_t DcmArenaScope::liveObjects()
+{
+  return liveObjectCount.load(std::memory_order_relaxed);
+}
+
+
+size_t DcmArenaScope::liveBytes()
+{
+  return liveObjectBytes.load(std::memory_order_relaxed);
+}
+
+
+void DcmArenaScope::deallocate(void *ptr)
+{
+  if (ptr == NULL) return;
+  DcmArenaHeader *header = OFstatic_cast(DcmArenaHeader *, ptr) - 1;
+  liveObjectCount.fetch_sub(1, std::memory_order_relaxed);
+  liveObjectBytes.fetch_sub(header->info.size, std::memory_order_relaxed);
+  if (header->info.arena)
+    header->info.arena->release();
+  else
+    free(header);
+}
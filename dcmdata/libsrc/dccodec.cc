@@ -31,6 +31,10 @@
 #include "dcmtk/dcmdata/dcpxitem.h"  /* for DcmPixelItem */
 #include "dcmtk/dcmdata/dcswap.h"    /* for swapIfNecessary */
 #include "dcmtk/dcmdata/dcvrui.h"    /* for DcmUniqueIdentifier */
+#include "dcmtk/dcmdata/dcvrov.h"    /* for DcmOther64bitVeryLong */
+#include "dcmtk/ofstd/oftimer.h"     /* for OFTimer */
+
+#include <atomic>
 
 // static member variables
 OFList<DcmCodecList *> DcmCodecList::registeredCodecs;
@@ -39,6 +43,9 @@ OFList<DcmCodecList *> DcmCodecList::registeredCodecs;
 OFReadWriteLock DcmCodecList::codecLock;
 #endif
 
+// receives the duration of each encode and decode call, if set
+static std::atomic<DcmCodecList::TimingCallback> codecTimingCallback(NULL);
+
 /* --------------------------------------------------------------- */
 
 // DcmCodec static helper methods
@@ -313,6 +320,90 @@ OFCondition DcmCodec::determineStartFragment(
 }
 
 
+OFCondition DcmCodec::createOffsetTables(
+    DcmItem *dataset,
+    DcmPixelSequence *pixelSequence,
+    const OFList<Uint32>& offsetList,
+    OFBool createBasicOffsetTable)
+{
+  if ((dataset == NULL) || (pixelSequence == NULL)) return EC_IllegalCall;
+
+  DcmPixelItem *offsetTable = NULL;
+  OFCondition result = pixelSequence->getItem(offsetTable, 0);
+  if (result.bad()) return result;
+
+  const size_t numberOfFrames = offsetList.size();
+  if (!dcmCreateExtendedOffsetTable.get() || (numberOfFrames < 2))
+  {
+    // an extended offset table of the previous representation does not apply any longer
+    dataset->findAndDeleteElement(DCM_ExtendedOffsetTable);
+    dataset->findAndDeleteElement(DCM_ExtendedOffsetTableLengths);
+    if (createBasicOffsetTable) result = offsetTable->createOffsetTable(offsetList);
+    return result;
+  }
+
+  // offsets are relative to the first fragment of the first frame, lengths exclude item headers and padding
+  Uint64 *offsets = new Uint64[numberOfFrames];
+  Uint64 *lengths = new Uint64[numberOfFrames];
+  Uint64 current = 0;
+  const unsigned long numberOfItems = pixelSequence->card();
+  unsigned long item = 1;
+  size_t idx = 0;
+  for (OFListConstIterator(Uint32) it = offsetList.begin(); (it != offsetList.end()) && result.good(); ++it, ++idx)
+  {
+    offsets[idx] = current;
+    lengths[idx] = 0;
+    Uint64 remaining = *it;
+    DcmPixelItem *fragment = NULL;
+    while ((remaining > 0) && result.good())
+    {
+      if ((item >= numberOfItems) || pixelSequence->getItem(fragment, item++).bad())
+        result = EC_CorruptedData;
+      else
+      {
+        const Uint32 length = fragment->getLength();
+        const Uint64 size = OFstatic_cast(Uint64, length) + (length & 1) + 8;
+        if (size > remaining)
+          result = EC_CorruptedData;
+        else
+        {
+          remaining -= size;
+          lengths[idx] += length;
+        }
+      }
+    }
+    current += *it;
+  }
+  if (result.bad() || (item != numberOfItems))
+  {
+    DCMDATA_WARN("DcmCodec: frame sizes do not match the pixel sequence, cannot create extended offset table");
+    result = EC_CorruptedData;
+  }
+
+  if (result.good())
+  {
+    DCMDATA_DEBUG("DcmCodec: creating extended offset table with " << numberOfFrames << " entries");
+    DcmOther64bitVeryLong *table = new DcmOther64bitVeryLong(DcmTag(DCM_ExtendedOffsetTable, EVR_OV));
+    result = table->putUint64Array(offsets, OFstatic_cast(unsigned long, numberOfFrames));
+    if (result.good()) result = dataset->insert(table, OFTrue);
+    else delete table;
+  }
+  if (result.good())
+  {
+    DcmOther64bitVeryLong *table = new DcmOther64bitVeryLong(DcmTag(DCM_ExtendedOffsetTableLengths, EVR_OV));
+    result = table->putUint64Array(lengths, OFstatic_cast(unsigned long, numberOfFrames));
+    if (result.good()) result = dataset->insert(table, OFTrue);
+    else delete table;
+  }
+  // the basic offset table shall be empty if the extended offset table is present
+  if (result.good()) result = offsetTable->putUint8Array(NULL, 0);
+
+  delete[] offsets;
+  delete[] lengths;
+  return result;
+}
+
+
 /* --------------------------------------------------------------- */
 
 DcmCodecList::DcmCodecList(
@@ -429,6 +520,12 @@ OFCondition DcmCodecList::updateCodecParameter(
 }
 
 
+void DcmCodecList::setTimingCallback(TimingCallback callback)
+{
+  codecTimingCallback.store(callback);
+}
+
+
 OFCondition DcmCodecList::decode(
   const DcmXfer & fromType,
   const DcmRepresentationParameter * fromParam,
@@ -454,7 +551,10 @@ OFCondition DcmCodecList::decode(
     {
       if ((*first)->codec->canChangeCoding(fromXfer, EXS_LittleEndianExplicit))
       {
+        DcmCodecList::TimingCallback callback = codecTimingCallback.load();
+        OFTimer timer;
         result = (*first)->codec->decode(fromParam, fromPixSeq, uncompressedPixelData, (*first)->codecParameter, pixelStack);
+        if (callback) callback(fromXfer, OFFalse, timer.getDiff(), 0, 0);
         first = last;
       } else ++first;
     }
@@ -494,8 +594,11 @@ OFCondition DcmCodecList::decodeFrame(
     {
       if ((*first)->codec->canChangeCoding(fromXfer, EXS_LittleEndianExplicit))
       {
+        DcmCodecList::TimingCallback callback = codecTimingCallback.load();
+        OFTimer timer;
         result = (*first)->codec->decodeFrame(fromParam, fromPixSeq, (*first)->codecParameter,
                  dataset, frameNo, startFragment, buffer, bufSize, decompressedColorModel);
+        if (callback) callback(fromXfer, OFFalse, timer.getDiff(), 0, 0);
         first = last;
       } else ++first;
     }
@@ -534,8 +637,11 @@ OFCondition DcmCodecList::encode(
       if ((*first)->codec->canChangeCoding(fromRepType, toRepType))
       {
         if (!toRepParam) toRepParam = (*first)->defaultRepParam;
+        DcmCodecList::TimingCallback callback = codecTimingCallback.load();
+        OFTimer timer;
         result = (*first)->codec->encode(fromRepType, fromParam, fromPixSeq,
                  toRepParam, toPixSeq, (*first)->codecParameter, pixelStack);
+        if (callback) callback(toRepType, OFTrue, timer.getDiff(), 0, 0);
         first = last;
       } else ++first;
     }
@@ -574,8 +680,12 @@ OFCondition DcmCodecList::encode(
       if ((*first)->codec->canChangeCoding(fromRepType, toRepType))
       {
         if (!toRepParam) toRepParam = (*first)->defaultRepParam;
+        DcmCodecList::TimingCallback callback = codecTimingCallback.load();
+        OFTimer timer;
         result = (*first)->codec->encode(pixelData, length, toRepParam, toPixSeq,
                  (*first)->codecParameter, pixelStack);
+        if (callback) callback(toRepType, OFTrue, timer.getDiff(), length,
+          result.good() && toPixSeq ? toPixSeq->getLength(toRepType) : 0);
         first = last;
       } else ++first;
     }
@@ -618,6 +728,148 @@ OFBool DcmCodecList::canChangeCoding(
   return result;
 }
 
+OFBool DcmCodecList::canPassThrough(
+  const E_TransferSyntax fromRepType,
+  const E_TransferSyntax toRepType)
+{
+  // the first transfer syntax of each pair only allows a subset of the bitstreams of the second one
+  static const E_TransferSyntax compatible[][2] =
+  {
+    { EXS_JPEGProcess1, EXS_JPEGProcess2_4 },
+    { EXS_JPEGProcess14SV1, EXS_JPEGProcess14 },
+    { EXS_JPEGLSLossless, EXS_JPEGLSLossy },
+    { EXS_JPEG2000LosslessOnly, EXS_JPEG2000 },
+    { EXS_JPEG2000MulticomponentLosslessOnly, EXS_JPEG2000Multicomponent },
+    { EXS_HighThroughputJPEG2000LosslessOnly, EXS_HighThroughputJPEG2000 },
+    { EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly, EXS_HighThroughputJPEG2000 }
+  };
+  for (size_t i = 0; i < sizeof(compatible) / sizeof(compatible[0]); ++i)
+  {
+    if ((compatible[i][0] == fromRepType) && (compatible[i][1] == toRepType)) return OFTrue;
+  }
+  return OFFalse;
+}
+
+OFCondition DcmCodecList::passThrough(
+  const E_TransferSyntax fromRepType,
+  DcmPixelSequence * fromPixSeq,
+  const E_TransferSyntax toRepType,
+  DcmPixelSequence * & toPixSeq)
+{
+  toPixSeq = NULL;
+  if ((fromPixSeq == NULL) || !canPassThrough(fromRepType, toRepType)) return EC_CannotChangeRepresentation;
+
+  // a copy of the sequence would keep the old transfer syntax, copy the items to a new one instead
+  OFCondition result = EC_Normal;
+  toPixSeq = new DcmPixelSequence(DCM_PixelSequenceTag);
+  DcmPixelItem *fragment = NULL;
+  for (unsigned long i = 0; (i < fromPixSeq->card()) && result.good(); ++i)
+  {
+    result = fromPixSeq->getItem(fragment, i);
+    if (result.good()) result = toPixSeq->insert(new DcmPixelItem(*fragment));
+  }
+  if (result.bad())
+  {
+    delete toPixSeq;
+    toPixSeq = NULL;
+  }
+  return result;
+}
+
+// relative costs of the conversion steps considered by DcmCodecList::findCodingPath()
+#define DCMCODEC_COST_PASSTHROUGH 1
+#define DCMCODEC_COST_DECODE 10
+#define DCMCODEC_COST_ENCODE 10
+#define DCMCODEC_COST_TRANSCODE 15
+
+// number of nodes in the transfer syntax graph
+#define DCMCODEC_GRAPH_NODES (EXS_HighThroughputJPEG2000 + 1)
+
+OFBool DcmCodecList::findCodingPath(
+  const E_TransferSyntax fromRepType,
+  const E_TransferSyntax toRepType,
+  E_TransferSyntax & nextRepType,
+  Uint32 * cost)
+{
+  nextRepType = EXS_Unknown;
+  if ((fromRepType < 0) || (fromRepType >= DCMCODEC_GRAPH_NODES) ||
+      (toRepType < 0) || (toRepType >= DCMCODEC_GRAPH_NODES)) return OFFalse;
+#ifdef WITH_THREADS
+  if (! codecLock.initialized()) return OFFalse; // should never happen
+#endif
+
+  // all unencapsulated transfer syntaxes share a single node
+  OFBool encapsulated[DCMCODEC_GRAPH_NODES];
+  for (int n = 0; n < DCMCODEC_GRAPH_NODES; ++n)
+    encapsulated[n] = DcmXfer(OFstatic_cast(E_TransferSyntax, n)).isEncapsulated();
+  const int source = encapsulated[fromRepType] ? OFstatic_cast(int, fromRepType) : OFstatic_cast(int, EXS_LittleEndianExplicit);
+  const int target = encapsulated[toRepType] ? OFstatic_cast(int, toRepType) : OFstatic_cast(int, EXS_LittleEndianExplicit);
+  if (source == target)
+  {
+    nextRepType = toRepType;
+    if (cost) *cost = 0;
+    return OFTrue;
+  }
+
+  // Dijkstra's algorithm, the graph is small enough for a linear search of the next node
+  const Uint32 infinite = OFstatic_cast(Uint32, -1);
+  Uint32 distance[DCMCODEC_GRAPH_NODES];
+  int firstStep[DCMCODEC_GRAPH_NODES];
+  OFBool done[DCMCODEC_GRAPH_NODES];
+  for (int n = 0; n < DCMCODEC_GRAPH_NODES; ++n)
+  {
+    distance[n] = infinite;
+    firstStep[n] = -1;
+    done[n] = OFFalse;
+  }
+  distance[source] = 0;
+
+#ifdef WITH_THREADS
+  OFReadWriteLocker locker(codecLock);
+  if (0 != locker.rdlock()) return OFFalse;
+#endif
+  while (!done[target])
+  {
+    int u = -1;
+    for (int n = 0; n < DCMCODEC_GRAPH_NODES; ++n)
+    {
+      if (!done[n] && (distance[n] != infinite) && ((u < 0) || (distance[n] < distance[u]))) u = n;
+    }
+    if (u < 0) break;
+    done[u] = OFTrue;
+
+    for (int v = 0; v < DCMCODEC_GRAPH_NODES; ++v)
+    {
+      if (done[v] || (!encapsulated[v] && (v != EXS_LittleEndianExplicit))) continue;
+      const E_TransferSyntax from = OFstatic_cast(E_TransferSyntax, u);
+      const E_TransferSyntax to = OFstatic_cast(E_TransferSyntax, v);
+      Uint32 weight = 0;
+      if (canPassThrough(from, to))
+        weight = DCMCODEC_COST_PASSTHROUGH;
+      else
+      {
+        OFListIterator(DcmCodecList *) first = registeredCodecs.begin();
+        OFListIterator(DcmCodecList *) last = registeredCodecs.end();
+        for (; (first != last) && (weight == 0); ++first)
+        {
+          if ((*first)->codec->canChangeCoding(from, to))
+            weight = !encapsulated[u] ? DCMCODEC_COST_ENCODE : (!encapsulated[v] ? DCMCODEC_COST_DECODE : DCMCODEC_COST_TRANSCODE);
+        }
+      }
+      if ((weight > 0) && (distance[u] + weight < distance[v]))
+      {
+        distance[v] = distance[u] + weight;
+        firstStep[v] = (u == source) ? v : firstStep[u];
+      }
+    }
+  }
+
+  if (distance[target] == infinite) return OFFalse;
+  nextRepType = (firstStep[target] == target) ? toRepType : OFstatic_cast(E_TransferSyntax, firstStep[target]);
+  if (cost) *cost = distance[target];
+  return OFTrue;
+}
+
 OFCondition DcmCodecList::determineDecompressedColorModel(
   const DcmXfer &fromType,
   const DcmRepresentationParameter *fromParam,
@@ -30,6 +30,7 @@
 #include "dcmtk/ofstd/ofstream.h"
 #include "dcmtk/ofstd/ofstack.h"
 #include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/oftrace.h"
 
 #include "dcmtk/dcmdata/dcjson.h"
 #include "dcmtk/dcmdata/dcdatset.h"
@@ -123,6 +124,12 @@ E_TransferSyntax DcmDataset::getCurrentXfer() const
 }
 
 
+void DcmDataset::setReadProjection(const DcmReadProjection *projection)
+{
+    readProjection = projection;
+}
+
+
 void DcmDataset::updateOriginalXfer()
 {
     DcmStack resultStack;
@@ -697,8 +704,16 @@ OFCondition DcmDataset::saveFile(const OFFilename &fileName,
     if (!fileName.isEmpty())
     {
         DcmWriteCache wcache;
+        /* the expected size lets large files be preallocated and written in large blocks */
+        offile_off_t expectedLength = 0;
+        if (dcmLargeFileWriteSize.get() > 0 || dcmDirectFileWriteSize.get() > 0)
+        {
+            const E_TransferSyntax xfer = (writeXfer == EXS_Unknown) ? getOriginalXfer() : writeXfer;
+            if (xfer != EXS_Unknown)
+                expectedLength = calcElementLength(xfer, encodingType);
+        }
         /* open file for output */
-        DcmOutputFileStream fileStream(fileName);
+        DcmOutputFileStream fileStream(fileName, expectedLength);
 
         /* check stream status */
         l_error = fileStream.status();
@@ -708,6 +723,10 @@ OFCondition DcmDataset::saveFile(const OFFilename &fileName,
             transferInit();
             l_error = write(fileStream, writeXfer, encodingType, &wcache, groupLength, padEncoding, padLength, subPadLength);
             transferEnd();
+            /* data still buffered for direct I/O is written before the status is final */
+            fileStream.flush();
+            if (l_error.good())
+                l_error = fileStream.status();
         }
     }
     return l_error;
@@ -720,6 +739,7 @@ OFCondition DcmDataset::saveFile(const OFFilename &fileName,
 OFCondition DcmDataset::chooseRepresentation(const E_TransferSyntax repType,
                                              const DcmRepresentationParameter *repParam)
 {
+    OFTraceSpan span("dcmdata.chooseRepresentation");
     OFCondition l_error = EC_Normal;
     OFBool pixelDataEncountered = OFFalse;
     OFStack<DcmStack> pixelStack;
@@ -806,6 +826,23 @@ OFCondition DcmDataset::chooseRepresentation(const E_TransferSyntax repType,
 }
 
 
+OFCondition DcmDataset::chooseRepresentationFrameByFrame(const E_TransferSyntax repType,
+                                                         const DcmRepresentationParameter *repParam)
+{
+    DcmElement *element = NULL;
+    if (DcmXfer(repType).isEncapsulated() &&
+        findAndGetElement(DCM_PixelData, element).good() && (element->ident() == EVR_PixelData))
+    {
+        OFCondition l_error = OFstatic_cast(DcmPixelData *, element)->
+            chooseRepresentationFrameByFrame(repType, repParam, this);
+        if (l_error.bad())
+            DCMDATA_DEBUG("DcmDataset: Cannot compress frame by frame (" << l_error.text() << "), compressing all frames at once");
+    }
+    // handles pixel data in sequences and updates the current transfer syntax
+    return chooseRepresentation(repType, repParam);
+}
+
+
 OFBool DcmDataset::hasRepresentation(const E_TransferSyntax repType,
                                      const DcmRepresentationParameter *repParam)
 {
@@ -26,9 +26,39 @@
 #include "dcmtk/dcmdata/dcmetinf.h"
 #include "dcmtk/dcmdata/dcfilefo.h"
 
+#define INCLUDE_CSTRING
+#include "dcmtk/ofstd/ofstdinc.h"
+
 
 // --- static helpers ---
 
+OFBool DcmDataUtil::isDicomFile(const OFFilename &filename)
+{
+  unsigned char buf[DCM_PreambleLen + DCM_MagicLen];
+  OFFile file;
+  if (!file.fopen(filename, "rb"))
+    return OFFalse;
+  const size_t len = file.fread(buf, 1, sizeof(buf));
+  file.fclose();
+
+  // DICOM file with preamble and magic word
+  if ((len == sizeof(buf)) && (memcmp(buf + DCM_PreambleLen, DCM_Magic, DCM_MagicLen) == 0))
+    return OFTrue;
+
+  // dataset or meta-header without preamble, starting with a tag and either a VR or a length
+  if (len < 8)
+    return OFFalse;
+  const Uint16 groupLittle = OFstatic_cast(Uint16, buf[0] | (buf[1] << 8));
+  const Uint16 groupBig = OFstatic_cast(Uint16, (buf[0] << 8) | buf[1]);
+  if ((groupLittle > 0x0008) && (groupBig > 0x0008))
+    return OFFalse;
+  // explicit VR: two upper-case letters, implicit VR: a 32 bit length below 64 KB in either byte order
+  const OFBool explicitVR = (buf[4] >= 'A') && (buf[4] <= 'Z') && (buf[5] >= 'A') && (buf[5] <= 'Z');
+  const OFBool implicitVR = (buf[6] == 0 && buf[7] == 0) || (buf[4] == 0 && buf[5] == 0);
+  return explicitVR || implicitVR;
+}
+
+
 OFCondition DcmDataUtil::getSOPInstanceFromFile(const OFFilename &filename,
                                                 OFString &sopClassUID,
                                                 OFString &sopInstanceUID,
@@ -2831,47 +2831,8 @@ OFCondition DicomDirInterface::loadAndCheckDicomFile(const OFFilename &filename,
         result = fileformat.loadFile(pathname);
         if (result.good())
         {
-            /* check for correct part 10 file format */
-            DcmMetaInfo *metainfo = fileformat.getMetaInfo();
-            DcmDataset *dataset = fileformat.getDataset();
-            if ((metainfo == NULL) || (metainfo->card() == 0))
-            {
-                /* create error message */
-                OFOStringStream oss;
-                oss << "file not in part 10 format (no file meta information): " << filename
-                    << OFStringStream_ends;
-                OFSTRINGSTREAM_GETSTR(oss, tmpString)
-                /* file meta information is required */
-                if (FileFormatCheck)
-                {
-                    DCMDATA_ERROR(tmpString);
-                    result = EC_FileMetaInfoHeaderMissing;
-                } else {
-                    DCMDATA_WARN(tmpString);
-                    /* add missing file meta information */
-                    if (dataset != NULL)
-                        fileformat.validateMetaInfo(dataset->getOriginalXfer());
-                }
-                OFSTRINGSTREAM_FREESTR(tmpString)
-            }
-            /* check for empty dataset */
-            if ((dataset == NULL) || (dataset->card() == 0))
-            {
-                DCMDATA_ERROR("file contains no data (no data set): " << filename);
-                result = EC_CorruptedData;
-            }
-            /* only proceed if previous checks have been passed */
-            if (result.good())
-            {
-                /* check for SOP class and transfer syntax */
-                result = checkSOPClassAndXfer(metainfo, dataset, filename);
-                if (result.good())
-                {
-                    /* check for mandatory attributes */
-                    if (checkMandatoryAttributes(metainfo, dataset, filename).bad())
-                        result = EC_ApplicationProfileViolated;
-                }
-            }
+            /* check its content */
+            result = checkFileFormat(filename, fileformat);
         } else {
             /* report an error */
             DCMDATA_ERROR(result.text() << ": reading file: " << filename);
@@ -2881,6 +2842,56 @@ OFCondition DicomDirInterface::loadAndCheckDicomFile(const OFFilename &filename,
 }
 
 
+// check whether the content of a loaded DICOM file is suitable for a DICOMDIR of the specified application profile
+OFCondition DicomDirInterface::checkFileFormat(const OFFilename &filename,
+                                               DcmFileFormat &fileformat)
+{
+    OFCondition result = EC_Normal;
+    /* check for correct part 10 file format */
+    DcmMetaInfo *metainfo = fileformat.getMetaInfo();
+    DcmDataset *dataset = fileformat.getDataset();
+    if ((metainfo == NULL) || (metainfo->card() == 0))
+    {
+        /* create error message */
+        OFOStringStream oss;
+        oss << "file not in part 10 format (no file meta information): " << filename
+            << OFStringStream_ends;
+        OFSTRINGSTREAM_GETSTR(oss, tmpString)
+        /* file meta information is required */
+        if (FileFormatCheck)
+        {
+            DCMDATA_ERROR(tmpString);
+            result = EC_FileMetaInfoHeaderMissing;
+        } else {
+            DCMDATA_WARN(tmpString);
+            /* add missing file meta information */
+            if (dataset != NULL)
+                fileformat.validateMetaInfo(dataset->getOriginalXfer());
+        }
+        OFSTRINGSTREAM_FREESTR(tmpString)
+    }
+    /* check for empty dataset */
+    if ((dataset == NULL) || (dataset->card() == 0))
+    {
+        DCMDATA_ERROR("file contains no data (no data set): " << filename);
+        result = EC_CorruptedData;
+    }
+    /* only proceed if previous checks have been passed */
+    if (result.good())
+    {
+        /* check for SOP class and transfer syntax */
+        result = checkSOPClassAndXfer(metainfo, dataset, filename);
+        if (result.good())
+        {
+            /* check for mandatory attributes */
+            if (checkMandatoryAttributes(metainfo, dataset, filename).bad())
+                result = EC_ApplicationProfileViolated;
+        }
+    }
+    return result;
+}
+
+
 // check whether given record matches dataset
 OFBool DicomDirInterface::recordMatchesDataset(DcmDirectoryRecord *record,
                                                DcmItem *dataset)
@@ -4867,90 +4878,120 @@ OFCondition DicomDirInterface::addDicomFile(const OFFilename &filename,
     /* first, make sure that a DICOMDIR object exists */
     if (DicomDir != NULL)
     {
-        /* create fully qualified pathname of the DICOM file to be added */
-        OFFilename pathname;
-        OFStandard::combineDirAndFilename(pathname, directory, filename, OFTrue /*allowEmptyDirName*/);
         /* then check the file name, load the file and check the content */
         DcmFileFormat fileformat;
         result = loadAndCheckDicomFile(filename, directory, fileformat, OFTrue /*checkFilename*/);
         if (result.good())
+            result = addRecords(filename, directory, fileformat);
+    }
+    return result;
+}
+
+
+// add a DICOM file whose attributes are given to the current DICOMDIR
+OFCondition DicomDirInterface::addDicomFile(const OFFilename &filename,
+                                            DcmFileFormat &fileformat,
+                                            const OFFilename &directory)
+{
+    OFCondition result = EC_IllegalParameter;
+    /* first, make sure that a DICOMDIR object exists */
+    if (DicomDir != NULL)
+    {
+        /* then check the file name and the given content, the file is not accessed */
+        if (isFilenameValid(filename))
         {
-            DCMDATA_INFO("adding file: " << pathname);
-            /* start creating the DICOMDIR directory structure */
-            DcmDirectoryRecord *rootRecord = &(DicomDir->getRootRecord());
-            DcmMetaInfo *metainfo = fileformat.getMetaInfo();
-            /* massage filename into DICOM format (DOS conventions for path separators, uppercase) */
-            OFString fileID;
-            hostToDicomFilename(OFSTRING_GUARD(filename.getCharPointer()), fileID);
-            /* what kind of object (SOP Class) is stored in the file */
-            OFString sopClass;
-            metainfo->findAndGetOFString(DCM_MediaStorageSOPClassUID, sopClass);
-            /* if hanging protocol, palette or implant file then attach it to the root record and stop */
-            if (compare(sopClass, UID_HangingProtocolStorage))
-            {
-                /* add a hanging protocol record below the root */
-                if (addRecord(rootRecord, ERT_HangingProtocol, &fileformat, fileID, pathname) == NULL)
-                    result = EC_CorruptedData;
-            }
-            else if (compare(sopClass, UID_ColorPaletteStorage))
-            {
-                /* add a palette record below the root */
-                if (addRecord(rootRecord, ERT_Palette, &fileformat, fileID, pathname) == NULL)
-                    result = EC_CorruptedData;
-            }
-            else if (compare(sopClass, UID_GenericImplantTemplateStorage))
-            {
-                /* add an implant record below the root */
-                if (addRecord(rootRecord, ERT_Implant, &fileformat, fileID, pathname) == NULL)
-                    result = EC_CorruptedData;
-            }
-            else if (compare(sopClass, UID_ImplantAssemblyTemplateStorage))
-            {
-                /* add an implant group record below the root */
-                if (addRecord(rootRecord, ERT_ImplantGroup, &fileformat, fileID, pathname) == NULL)
-                    result = EC_CorruptedData;
-            }
-            else if (compare(sopClass, UID_ImplantTemplateGroupStorage))
+            result = checkFileFormat(filename, fileformat);
+            if (result.good())
+                result = addRecords(filename, directory, fileformat);
+        }
+    }
+    return result;
+}
+
+
+// add the records of a checked DICOM file to the current DICOMDIR
+OFCondition DicomDirInterface::addRecords(const OFFilename &filename,
+                                          const OFFilename &directory,
+                                          DcmFileFormat &fileformat)
+{
+    OFCondition result = EC_Normal;
+    /* create fully qualified pathname of the DICOM file to be added */
+    OFFilename pathname;
+    OFStandard::combineDirAndFilename(pathname, directory, filename, OFTrue /*allowEmptyDirName*/);
+    DCMDATA_INFO("adding file: " << pathname);
+    /* start creating the DICOMDIR directory structure */
+    DcmDirectoryRecord *rootRecord = &(DicomDir->getRootRecord());
+    DcmMetaInfo *metainfo = fileformat.getMetaInfo();
+    /* massage filename into DICOM format (DOS conventions for path separators, uppercase) */
+    OFString fileID;
+    hostToDicomFilename(OFSTRING_GUARD(filename.getCharPointer()), fileID);
+    /* what kind of object (SOP Class) is stored in the file */
+    OFString sopClass;
+    metainfo->findAndGetOFString(DCM_MediaStorageSOPClassUID, sopClass);
+    /* if hanging protocol, palette or implant file then attach it to the root record and stop */
+    if (compare(sopClass, UID_HangingProtocolStorage))
+    {
+        /* add a hanging protocol record below the root */
+        if (addRecord(rootRecord, ERT_HangingProtocol, &fileformat, fileID, pathname) == NULL)
+            result = EC_CorruptedData;
+    }
+    else if (compare(sopClass, UID_ColorPaletteStorage))
+    {
+        /* add a palette record below the root */
+        if (addRecord(rootRecord, ERT_Palette, &fileformat, fileID, pathname) == NULL)
+            result = EC_CorruptedData;
+    }
+    else if (compare(sopClass, UID_GenericImplantTemplateStorage))
+    {
+        /* add an implant record below the root */
+        if (addRecord(rootRecord, ERT_Implant, &fileformat, fileID, pathname) == NULL)
+            result = EC_CorruptedData;
+    }
+    else if (compare(sopClass, UID_ImplantAssemblyTemplateStorage))
+    {
+        /* add an implant group record below the root */
+        if (addRecord(rootRecord, ERT_ImplantGroup, &fileformat, fileID, pathname) == NULL)
+            result = EC_CorruptedData;
+    }
+    else if (compare(sopClass, UID_ImplantTemplateGroupStorage))
+    {
+        /* add an implant assy record below the root */
+        if (addRecord(rootRecord, ERT_ImplantAssy, &fileformat, fileID, pathname) == NULL)
+            result = EC_CorruptedData;
+    } else {
+        /* add a patient record below the root */
+        DcmDirectoryRecord *patientRecord = addRecord(rootRecord, ERT_Patient, &fileformat, fileID, pathname);
+        if (patientRecord != NULL)
+        {
+            /* if patient management file then attach it to patient record and stop */
+            if (compare(sopClass, UID_RETIRED_DetachedPatientManagementMetaSOPClass))
             {
-                /* add an implant assy record below the root */
-                if (addRecord(rootRecord, ERT_ImplantAssy, &fileformat, fileID, pathname) == NULL)
-                    result = EC_CorruptedData;
+                result = patientRecord->assignToSOPFile(fileID.c_str(), pathname);
+                DCMDATA_ERROR(result.text() << ": cannot assign patient record to file: " << pathname);
             } else {
-                /* add a patient record below the root */
-                DcmDirectoryRecord *patientRecord = addRecord(rootRecord, ERT_Patient, &fileformat, fileID, pathname);
-                if (patientRecord != NULL)
+                /* add a study record below the current patient record */
+                DcmDirectoryRecord *studyRecord = addRecord(patientRecord, ERT_Study, &fileformat, fileID, pathname);;
+                if (studyRecord != NULL)
                 {
-                    /* if patient management file then attach it to patient record and stop */
-                    if (compare(sopClass, UID_RETIRED_DetachedPatientManagementMetaSOPClass))
+                    /* add a series record below the current study record */
+                    DcmDirectoryRecord *seriesRecord = addRecord(studyRecord, ERT_Series, &fileformat, fileID, pathname);;
+                    if (seriesRecord != NULL)
                     {
-                        result = patientRecord->assignToSOPFile(fileID.c_str(), pathname);
-                        DCMDATA_ERROR(result.text() << ": cannot assign patient record to file: " << pathname);
-                    } else {
-                        /* add a study record below the current patient record */
-                        DcmDirectoryRecord *studyRecord = addRecord(patientRecord, ERT_Study, &fileformat, fileID, pathname);;
-                        if (studyRecord != NULL)
-                        {
-                            /* add a series record below the current study record */
-                            DcmDirectoryRecord *seriesRecord = addRecord(studyRecord, ERT_Series, &fileformat, fileID, pathname);;
-                            if (seriesRecord != NULL)
-                            {
-                                /* add one of the instance record below the current series record */
-                                if (addRecord(seriesRecord, sopClassToRecordType(sopClass), &fileformat, fileID, pathname) == NULL)
-                                    result = EC_CorruptedData;
-                            } else
-                                result = EC_CorruptedData;
-                        } else
+                        /* add one of the instance record below the current series record */
+                        if (addRecord(seriesRecord, sopClassToRecordType(sopClass), &fileformat, fileID, pathname) == NULL)
                             result = EC_CorruptedData;
-                    }
+                    } else
+                        result = EC_CorruptedData;
                 } else
                     result = EC_CorruptedData;
-                /* invent missing attributes on all levels or PatientID only */
-                if (InventMode)
-                    inventMissingAttributes(rootRecord);
-                else if (InventPatientIDMode)
-                    inventMissingAttributes(rootRecord, OFFalse /*recurse*/);
             }
-        }
+        } else
+            result = EC_CorruptedData;
+        /* invent missing attributes on all levels or PatientID only */
+        if (InventMode)
+            inventMissingAttributes(rootRecord);
+        else if (InventPatientIDMode)
+            inventMissingAttributes(rootRecord, OFFalse /*recurse*/);
     }
     return result;
 }
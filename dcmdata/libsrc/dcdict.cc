@@ -36,6 +36,8 @@
 #define INCLUDE_CCTYPE
 #include "dcmtk/ofstd/ofstdinc.h"
 
+#include <algorithm>
+
 /*
 ** The separator character between fields in the data dictionary file(s)
 */
@@ -114,7 +116,17 @@ DcmDataDictionary::DcmDataDictionary(OFBool loadBuiltin, OFBool loadExternal)
   : hashDict(),
     repDict(),
     skeletonCount(0),
-    dictionaryLoaded(OFFalse)
+    dictionaryLoaded(OFFalse),
+    standardKeys(NULL),
+    standardEntries(NULL),
+    standardCount(0),
+    builtinEntries(NULL),
+    builtinKeys(NULL),
+    builtinSlots(NULL),
+    builtinSlotMask(0),
+    builtinCreated(NULL),
+    builtinCount(0),
+    builtinShadowed(0)
 {
     /* Make sure any DCMDICTPATH dictionary is loaded even if loading
      * of external (default) dictionary is not enabled.
@@ -136,8 +148,16 @@ DcmDataDictionary::~DcmDataDictionary()
 
 void DcmDataDictionary::clear()
 {
+   unfreeze();
    hashDict.clear();
    repDict.clear();
+   builtinEntries = NULL;
+   builtinKeys = NULL;
+   builtinSlots = NULL;
+   builtinSlotMask = 0;
+   builtinCreated = NULL;
+   builtinCount = 0;
+   builtinShadowed = 0;
    skeletonCount = 0;
    dictionaryLoaded = OFFalse;
 }
@@ -686,10 +706,123 @@ DcmDataDictionary::addEntry(DcmDictEntry* e)
             inserted = OFTrue;
         }
     } else {
+        /* the entry may replace or add a standard entry */
+        unfreeze();
+        if (e->getPrivateCreator() == NULL && builtinIndex(*e) < builtinCount)
+            ++builtinShadowed;
         hashDict.put(e);
     }
 }
 
+static inline Uint32
+standardKey(const DcmTagKey& key)
+{
+    return (OFstatic_cast(Uint32, key.getGroup()) << 16) | key.getElement();
+}
+
+static bool
+lessStandardKey(const DcmDictEntry *e1, const DcmDictEntry *e2)
+{
+    return standardKey(*e1) < standardKey(*e2);
+}
+
+void
+DcmDataDictionary::freeze()
+{
+    unfreeze();
+    size_t count = 0;
+    DcmHashDictIterator iter;
+    for (iter = hashDict.begin(); iter != hashDict.end(); ++iter) {
+        if ((*iter)->getPrivateCreator() == NULL) ++count;
+    }
+
+    standardEntries = new const DcmDictEntry*[count + 1];
+    standardCount = 0;
+    for (iter = hashDict.begin(); iter != hashDict.end(); ++iter) {
+        if ((*iter)->getPrivateCreator() == NULL) standardEntries[standardCount++] = *iter;
+    }
+    std::sort(standardEntries, standardEntries + standardCount, lessStandardKey);
+
+    /* the keys are stored separately so that the binary search stays within few cache lines */
+    standardKeys = new Uint32[count + 1];
+    for (size_t i = 0; i < standardCount; ++i) {
+        standardKeys[i] = standardKey(*standardEntries[i]);
+    }
+}
+
+void
+DcmDataDictionary::unfreeze()
+{
+    delete[] standardKeys;
+    delete[] standardEntries;
+    standardKeys = NULL;
+    standardEntries = NULL;
+    standardCount = 0;
+}
+
+const DcmDictEntry*
+DcmDataDictionary::findStandardEntry(const DcmTagKey& key) const
+{
+    const Uint32 k = standardKey(key);
+    size_t low = 0;
+    size_t high = standardCount;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        if (standardKeys[mid] < k) low = mid + 1;
+        else high = mid;
+    }
+    if (low < standardCount && standardKeys[low] == k) return standardEntries[low];
+    return NULL;
+}
+
+const DcmDictEntry*
+DcmDataDictionary::builtinEntry(size_t index) const
+{
+    const DcmDictEntry* e = builtinCreated[index].load(std::memory_order_acquire);
+    if (e == NULL) {
+        const DcmDictBuiltinEntry& b = builtinEntries[index];
+        DcmDictEntry* created = new DcmDictEntry(b.group, b.element,
+            b.upperGroup, b.upperElement, b.evr,
+            b.tagName, b.vmMin, b.vmMax,
+            b.standardVersion, OFFalse, b.privateCreator);
+        created->setGroupRangeRestriction(b.groupRestriction);
+        created->setElementRangeRestriction(b.elementRestriction);
+        /* a reader that created the same entry concurrently wins, ours is dropped */
+        if (builtinCreated[index].compare_exchange_strong(e, created, std::memory_order_acq_rel))
+            e = created;
+        else
+            delete created;
+    }
+    return e;
+}
+
+size_t
+DcmDataDictionary::builtinIndex(const DcmTagKey& key) const
+{
+    if (builtinCount == 0) return 0;
+    const Uint32 k = standardKey(key);
+    for (size_t slot = builtinSlot(k, builtinSlotMask); builtinSlots[slot] != 0xffff; slot = (slot + 1) & builtinSlotMask) {
+        if (builtinKeys[builtinSlots[slot]] == k) return builtinSlots[slot];
+    }
+    return builtinCount;
+}
+
+const DcmDictEntry*
+DcmDataDictionary::findBuiltinEntry(const DcmTagKey& key) const
+{
+    const size_t index = builtinIndex(key);
+    return index < builtinCount ? builtinEntry(index) : NULL;
+}
+
+const DcmDictEntry*
+DcmDataDictionary::findBuiltinEntry(const char *name) const
+{
+    for (size_t i = 0; i < builtinCount; ++i) {
+        if (strcmp(builtinEntries[i].tagName, name) == 0) return builtinEntry(i);
+    }
+    return NULL;
+}
+
 void
 DcmDataDictionary::deleteEntry(const DcmDictEntry& entry)
 {
@@ -700,6 +833,7 @@ DcmDataDictionary::deleteEntry(const DcmDictEntry& entry)
             repDict.remove(e);
             delete e;
         } else {
+            unfreeze();
             hashDict.del(entry.getKey(), entry.getPrivateCreator());
         }
     }
@@ -734,7 +868,19 @@ DcmDataDictionary::findEntry(const DcmTagKey& key, const char *privCreator) cons
      */
     const DcmDictEntry* e = NULL;
 
-    e = hashDict.get(key, privCreator);
+    /* entries loaded into the hash dictionary replace builtin ones, which
+     * are searched first as long as none did
+     */
+    if (builtinShadowed == 0 && privCreator == NULL)
+        e = findBuiltinEntry(key);
+    if (e == NULL) {
+        if (standardEntries != NULL && privCreator == NULL)
+            e = findStandardEntry(key);
+        else
+            e = hashDict.get(key, privCreator);
+    }
+    if (e == NULL && builtinShadowed > 0 && privCreator == NULL)
+        e = findBuiltinEntry(key);
     if (e == NULL) {
         /* search in the repeating tags dictionary */
         OFBool found = OFFalse;
@@ -772,6 +918,9 @@ DcmDataDictionary::findEntry(const char *name) const
         }
     }
 
+    if (e == NULL)
+        e = findBuiltinEntry(name);
+
     if (e == NULL) {
         /* search in the repeating tags dictionary */
         OFBool found = OFFalse;
@@ -801,6 +950,7 @@ GlobalDcmDataDictionary::GlobalDcmDataDictionary()
   : dataDict(NULL)
 #ifdef WITH_THREADS
   , dataDictLock()
+  , frozen(false)
 #endif
 {
 }
@@ -839,6 +989,9 @@ void GlobalDcmDataDictionary::createDataDict()
 const DcmDataDictionary& GlobalDcmDataDictionary::rdlock()
 {
 #ifdef WITH_THREADS
+  /* a frozen dictionary is never modified, readers need no lock */
+  if (frozen.load(std::memory_order_acquire))
+    return *dataDict;
   dataDictLock.rdlock();
 #endif
   if (!dataDict)
@@ -877,6 +1030,9 @@ DcmDataDictionary& GlobalDcmDataDictionary::wrlock()
 void GlobalDcmDataDictionary::rdunlock()
 {
 #ifdef WITH_THREADS
+  /* freeze() waits for all readers that locked the dictionary before */
+  if (frozen.load(std::memory_order_acquire))
+    return;
   dataDictLock.rdunlock();
 #endif
 }
@@ -900,3 +1056,27 @@ void GlobalDcmDataDictionary::clear()
   wrlock().clear();
   wrunlock();
 }
+
+void GlobalDcmDataDictionary::freeze()
+{
+  DcmDataDictionary& dict = wrlock();
+#ifdef WITH_THREADS
+  if (!frozen.load(std::memory_order_relaxed))
+  {
+    dict.freeze();
+    frozen.store(true, std::memory_order_release);
+  }
+#else
+  dict.freeze();
+#endif
+  wrunlock();
+}
+
+OFBool GlobalDcmDataDictionary::isFrozen() const
+{
+#ifdef WITH_THREADS
+  return frozen.load(std::memory_order_acquire);
+#else
+  return dataDict != NULL && dataDict->isFrozen();
+#endif
+}
@@ -1655,19 +1655,27 @@ OFCondition DcmElement::writeXML(STD_NAMESPACE ostream &out,
 void DcmElement::writeJsonOpener(STD_NAMESPACE ostream &out,
                                  DcmJsonFormat &format)
 {
-    DcmVR vr(getTag().getVR());
-    DcmTag tag = getTag();
+    /* the group has always been written in lower case, keep it that way */
+    static const char groupDigits[] = "0123456789abcdef";
+    static const char elementDigits[] = "0123456789ABCDEF";
+    const DcmTag &tag = getTag();
+    DcmVR vr(tag.getVR());
     /* increase indention level */
-    /* write attribute tag */
-    out << ++format.indent() << "\""
-        << STD_NAMESPACE hex << STD_NAMESPACE setfill('0')
-        << STD_NAMESPACE setw(4) << tag.getGTag();
-    /* write "ggggeeee" (no comma, upper case!) */
-    /* for private element numbers, zero out 2 first element digits */
-    /* or output full element number "eeee" */
-    out << STD_NAMESPACE setw(4) << STD_NAMESPACE uppercase << tag.getETag() << "\":"
-        << format.space() << "{" << STD_NAMESPACE dec << STD_NAMESPACE setfill(' ');
-    out << STD_NAMESPACE nouppercase;
+    /* write attribute tag "ggggeeee" (no comma, upper case element number!) */
+    char key[11];
+    const Uint16 group = tag.getGTag();
+    const Uint16 element = tag.getETag();
+    key[0] = '"';
+    for (int i = 0; i < 4; ++i)
+    {
+        key[4 - i] = groupDigits[(group >> (4 * i)) & 0xf];
+        key[8 - i] = elementDigits[(element >> (4 * i)) & 0xf];
+    }
+    key[9] = '"';
+    key[10] = ':';
+    out << ++format.indent();
+    out.write(key, sizeof(key));
+    out << format.space() << "{";
     /* increase indention level */
     /* value representation = VR */
     out << format.newline() << ++format.indent() << "\"vr\":" << format.space() << "\""
@@ -1698,6 +1706,29 @@ OFCondition DcmElement::writeJson(STD_NAMESPACE ostream &out,
             format.printBulkDataURIPrefix(out);
             DcmJsonFormat::printString(out, value);
         }
+        else if (ident() == EVR_FD || ident() == EVR_FL)
+        {
+            /* format binary floating point values without a string per value */
+            const OFBool isDouble = (ident() == EVR_FD);
+            const unsigned long vm = getVM();
+            format.printValuePrefix(out);
+            for (unsigned long valNo = 0; valNo < vm; ++valNo)
+            {
+                Float64 doubleVal = 0;
+                Float32 floatVal = 0;
+                OFCondition status = isDouble ? getFloat64(doubleVal, valNo) : getFloat32(floatVal, valNo);
+                if (status.bad())
+                    return status;
+                if (valNo > 0)
+                    format.printNextArrayElementPrefix(out);
+                /* same precision as getOFString(): DBL_DIG + 2 for FD, FLT_DIG + 2 for FL */
+                if (isDouble)
+                    DcmJsonFormat::printNumberDecimal(out, doubleVal, 17);
+                else
+                    DcmJsonFormat::printNumberDecimal(out, floatVal, 8);
+            }
+            format.printValueSuffix(out);
+        }
         else
         {
             OFCondition status = getOFString(value, 0L);
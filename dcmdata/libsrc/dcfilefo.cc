@@ -49,6 +49,7 @@
 #include "dcmtk/dcmdata/dcistrmf.h"    /* for class DcmInputFileStream */
 #include "dcmtk/dcmdata/dcwcache.h"    /* for class DcmWriteCache */
 #include "dcmtk/dcmdata/dcjson.h"
+#include "dcmtk/ofstd/oftrace.h"      /* for class OFTraceSpan */
 
 
 // ********************************
@@ -898,6 +899,7 @@ OFCondition DcmFileFormat::loadFileUntilTag(
                                     const E_FileReadMode readMode,
                                     const DcmTagKey &stopParsingAtElement)
 {
+    OFTraceSpan span("dcmdata.loadFile");
     if (readMode == ERM_dataset)
         return getDataset()->loadFileUntilTag(fileName, readXfer, groupLength, maxReadLength, stopParsingAtElement);
 
@@ -951,8 +953,17 @@ OFCondition DcmFileFormat::saveFile(const OFFilename &fileName,
     {
         DcmWriteCache wcache;
 
+        /* the expected size lets large files be preallocated and written in large blocks */
+        offile_off_t expectedLength = 0;
+        if (dcmLargeFileWriteSize.get() > 0 || dcmDirectFileWriteSize.get() > 0)
+        {
+            const E_TransferSyntax xfer = (writeXfer == EXS_Unknown) ? getDataset()->getOriginalXfer() : writeXfer;
+            if (xfer != EXS_Unknown)
+                expectedLength = calcElementLength(xfer, encodingType);
+        }
+
         /* open file for output */
-        DcmOutputFileStream fileStream(fileName);
+        DcmOutputFileStream fileStream(fileName, expectedLength);
 
         /* check stream status */
         l_error = fileStream.status();
@@ -963,6 +974,10 @@ OFCondition DcmFileFormat::saveFile(const OFFilename &fileName,
             l_error = write(fileStream, writeXfer, encodingType, &wcache, groupLength,
                 padEncoding, padLength, subPadLength, 0 /*instanceLength*/, writeMode);
             transferEnd();
+            /* data still buffered for direct I/O is written before the status is final */
+            fileStream.flush();
+            if (l_error.good())
+                l_error = fileStream.status();
         }
     }
     return l_error;
@@ -0,0 +1,199 @@
+/*
+ *
+ *  Copyright (C) 1994-2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmdata
+ *
+ *  Purpose: frame parallel encoding and decoding of multi-frame pixel data
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcfrmthr.h"
+#include "dcmtk/dcmdata/dcpixseq.h"   /* for class DcmPixelSequence */
+#include "dcmtk/dcmdata/dcerror.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+
+/// state of a frame compressed by DcmFrameThreads::encodeFrames()
+struct DcmEncodedFrame
+{
+  DcmEncodedFrame() : data(NULL), length(0), result(EC_Normal), done(OFFalse) {}
+
+  /// compressed frame, allocated with new[]
+  Uint8 *data;
+
+  /// length of the compressed frame
+  Uint32 length;
+
+  /// result of the compression
+  OFCondition result;
+
+  /// true once the frame has been compressed
+  OFBool done;
+};
+
+
+OFCondition DcmFrameThreads::encodeFrames(
+  const DcmFrameEncodeTask &task,
+  Uint32 frameCount,
+  Uint16 numThreads,
+  DcmPixelSequence *pixelSequence,
+  DcmOffsetList &offsetList,
+  Uint32 fragmentSize,
+  size_t &compressedSize)
+{
+  compressedSize = 0;
+  if (pixelSequence == NULL) return EC_IllegalCall;
+
+  OFCondition result = EC_Normal;
+  Uint32 threadCount = (numThreads < frameCount) ? numThreads : frameCount;
+  if (threadCount <= 1)
+  {
+    for (Uint32 i = 0; (i < frameCount) && result.good(); ++i)
+    {
+      Uint8 *data = NULL;
+      Uint32 length = 0;
+      result = task.encodeFrame(i, data, length);
+      if (result.good())
+      {
+        result = pixelSequence->storeCompressedFrame(offsetList, data, length, fragmentSize);
+        compressedSize += length;
+      }
+      delete[] data;
+    }
+    return result;
+  }
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<DcmEncodedFrame> frames(frameCount);
+  Uint32 nextFrame = 0;   // next frame to hand out to a worker
+  Uint32 nextStore = 0;   // next frame to append to the pixel sequence
+  OFBool stopped = OFFalse;
+
+  // limits the number of compressed frames waiting for their predecessors
+  const Uint32 window = 2 * threadCount;
+
+  std::vector<std::thread> workers;
+  for (Uint32 t = 0; t < threadCount; ++t)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true)
+      {
+        changed.wait(lock, [&]() { return stopped || nextFrame >= frameCount || nextFrame < nextStore + window; });
+        if (stopped || nextFrame >= frameCount) return;
+        Uint32 frameNo = nextFrame++;
+        lock.unlock();
+
+        Uint8 *data = NULL;
+        Uint32 length = 0;
+        OFCondition cond = task.encodeFrame(frameNo, data, length);
+
+        lock.lock();
+        DcmEncodedFrame &frame = frames[frameNo];
+        frame.data = data;
+        frame.length = length;
+        frame.result = cond;
+        frame.done = OFTrue;
+        changed.notify_all();
+      }
+    }));
+  }
+
+  // the fragments are written in frame order by the calling thread
+  for (Uint32 i = 0; (i < frameCount) && result.good(); ++i)
+  {
+    DcmEncodedFrame frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return frames[i].done; });
+      frame = frames[i];
+      frames[i].data = NULL;
+    }
+
+    result = frame.result;
+    if (result.good())
+    {
+      result = pixelSequence->storeCompressedFrame(offsetList, frame.data, frame.length, fragmentSize);
+      compressedSize += frame.length;
+    }
+    delete[] frame.data;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    nextStore = i + 1;
+    if (result.bad()) stopped = OFTrue;
+    changed.notify_all();
+  }
+
+  for (size_t t = 0; t < workers.size(); ++t)
+    workers[t].join();
+
+  // frames compressed ahead of a failed one
+  for (size_t i = 0; i < frames.size(); ++i)
+    delete[] frames[i].data;
+
+  return result;
+}
+
+
+OFCondition DcmFrameThreads::decodeFrames(
+  const DcmFrameDecodeTask &task,
+  Uint32 frameCount,
+  Uint16 numThreads)
+{
+  OFCondition result = EC_Normal;
+  Uint32 threadCount = (numThreads < frameCount) ? numThreads : frameCount;
+  if (threadCount <= 1)
+  {
+    for (Uint32 i = 0; (i < frameCount) && result.good(); ++i)
+      result = task.decodeFrame(i);
+    return result;
+  }
+
+  std::mutex mutex;
+  Uint32 nextFrame = 0;
+  Uint32 failedFrame = frameCount;
+
+  std::vector<std::thread> workers;
+  for (Uint32 t = 0; t < threadCount; ++t)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      // frames behind a failed one are skipped, frames before it still report their error
+      while (nextFrame < frameCount && nextFrame < failedFrame)
+      {
+        Uint32 frameNo = nextFrame++;
+        lock.unlock();
+        OFCondition cond = task.decodeFrame(frameNo);
+        lock.lock();
+        if (cond.bad() && frameNo < failedFrame)
+        {
+          failedFrame = frameNo;
+          result = cond;
+        }
+      }
+    }));
+  }
+
+  for (size_t t = 0; t < workers.size(); ++t)
+    workers[t].join();
+
+  return result;
+}
@@ -26,21 +26,336 @@
 
 #define INCLUDE_CSTDIO
 #define INCLUDE_CERRNO
+#define INCLUDE_CSTRING
+#define INCLUDE_CTIME
 #include "dcmtk/ofstd/ofstdinc.h"
+#include "dcmtk/ofstd/ofmap.h"
+#include "dcmtk/ofstd/oflist.h"
+#include "dcmtk/ofstd/ofthread.h"
 
+#ifdef HAVE_WINDOWS_H
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+OFGlobal<OFBool> dcmMemoryMappedFileInput(OFTrue);
+
+/** mapped file, shared by all producers reading the same unchanged file.
+ *  Internal use only.
+ */
+struct DcmFileMapping
+{
+  /// start of the mapped file
+  const unsigned char *data;
+
+  /// size of the file in bytes
+  offile_off_t size;
+
+  /// modification time of the file when it was mapped
+  time_t mtime;
+
+  /// number of producers using the mapping
+  size_t refs;
+
+  /// true if the mapping is in the cache index
+  OFBool cached;
+
+  /// key of the mapping in the cache index
+  OFString path;
+};
+
+/** index and LRU list of DcmFileMapCache. Internal use only.
+ */
+struct DcmFileMapCacheState
+{
+  DcmFileMapCacheState()
+  : maxEntries(0)
+  , hits(0)
+  , misses(0)
+  , index()
+  , unused()
+#ifdef WITH_THREADS
+  , mutex()
+#endif
+  {
+  }
+
+  size_t maxEntries;
+  size_t hits;
+  size_t misses;
+
+  /// cached mappings by file path
+  OFMap<OFString, DcmFileMapping *> index;
+
+  /// cached mappings not used by any producer, most recently used first
+  OFList<DcmFileMapping *> unused;
+
+#ifdef WITH_THREADS
+  OFMutex mutex;
+#endif
+};
+
+/** locks the cache state for the lifetime of the object. Internal use only.
+ */
+class DcmFileMapCacheLock
+{
+public:
+  DcmFileMapCacheLock(DcmFileMapCacheState &cache)
+#ifdef WITH_THREADS
+  : cache_(cache)
+  {
+    cache_.mutex.lock();
+  }
+#else
+  {
+  }
+#endif
+
+  ~DcmFileMapCacheLock()
+  {
+#ifdef WITH_THREADS
+    cache_.mutex.unlock();
+#endif
+  }
+
+private:
+#ifdef WITH_THREADS
+  DcmFileMapCacheState &cache_;
+#endif
+};
+
+static DcmFileMapCacheState& fileMapCache()
+{
+  static DcmFileMapCacheState state;
+  return state;
+}
+
+static void unmapFile(DcmFileMapping *mapping)
+{
+#ifdef HAVE_WINDOWS_H
+  UnmapViewOfFile(mapping->data);
+#else
+  munmap(OFconst_cast(unsigned char *, mapping->data), OFstatic_cast(size_t, mapping->size));
+#endif
+  delete mapping;
+}
+
+/// returns the modification time and size of a file, false if unknown
+static OFBool fileStatus(const OFFilename &filename, time_t &mtime, offile_off_t &size)
+{
+  const char *path = filename.getCharPointer();
+  if (path == NULL) return OFFalse;
+#ifdef HAVE_WINDOWS_H
+  struct _stati64 st;
+  if (_stati64(path, &st) != 0) return OFFalse;
+#else
+  struct stat st;
+  if (stat(path, &st) != 0) return OFFalse;
+#endif
+  mtime = st.st_mtime;
+  size = OFstatic_cast(offile_off_t, st.st_size);
+  return OFTrue;
+}
+
+/// removes a mapping from the index, caller must hold the mutex
+static void uncache(DcmFileMapCacheState &cache, DcmFileMapping *mapping)
+{
+  cache.index.erase(mapping->path);
+  mapping->cached = OFFalse;
+  if (mapping->refs == 0)
+  {
+    cache.unused.remove(mapping);
+    unmapFile(mapping);
+  }
+}
+
+/// unmaps unused mappings beyond the limit, caller must hold the mutex
+static void trim(DcmFileMapCacheState &cache)
+{
+  while (cache.unused.size() > cache.maxEntries)
+  {
+    DcmFileMapping *mapping = cache.unused.back();
+    cache.unused.pop_back();
+    cache.index.erase(mapping->path);
+    unmapFile(mapping);
+  }
+}
+
+void DcmFileMapCache::setMaxEntries(size_t maxEntries)
+{
+  DcmFileMapCacheState &cache = fileMapCache();
+  DcmFileMapCacheLock lock(cache);
+  cache.maxEntries = maxEntries;
+  trim(cache);
+}
+
+size_t DcmFileMapCache::getMaxEntries()
+{
+  DcmFileMapCacheState &cache = fileMapCache();
+  DcmFileMapCacheLock lock(cache);
+  return cache.maxEntries;
+}
+
+size_t DcmFileMapCache::hits()
+{
+  DcmFileMapCacheState &cache = fileMapCache();
+  DcmFileMapCacheLock lock(cache);
+  return cache.hits;
+}
+
+size_t DcmFileMapCache::misses()
+{
+  DcmFileMapCacheState &cache = fileMapCache();
+  DcmFileMapCacheLock lock(cache);
+  return cache.misses;
+}
+
+size_t DcmFileMapCache::entries()
+{
+  DcmFileMapCacheState &cache = fileMapCache();
+  DcmFileMapCacheLock lock(cache);
+  return cache.index.size();
+}
+
+void DcmFileMapCache::clear()
+{
+  DcmFileMapCacheState &cache = fileMapCache();
+  DcmFileMapCacheLock lock(cache);
+  const size_t maxEntries = cache.maxEntries;
+  cache.maxEntries = 0;
+  trim(cache);
+  cache.maxEntries = maxEntries;
+}
+
+DcmFileMapping *DcmFileMapCache::acquire(const OFFilename &filename)
+{
+  DcmFileMapCacheState &cache = fileMapCache();
+  time_t mtime;
+  offile_off_t size;
+  {
+    DcmFileMapCacheLock lock(cache);
+    if (cache.maxEntries == 0 || cache.index.empty()) return NULL;
+  }
+  if (!fileStatus(filename, mtime, size)) return NULL;
+
+  DcmFileMapCacheLock lock(cache);
+  OFMap<OFString, DcmFileMapping *>::iterator it = cache.index.find(filename.getCharPointer());
+  if (it == cache.index.end()) return NULL;
+  DcmFileMapping *mapping = it->second;
+  if (mapping->mtime != mtime || mapping->size != size)
+  {
+    // the file has been modified since it was mapped
+    uncache(cache, mapping);
+    return NULL;
+  }
+  if (mapping->refs++ == 0) cache.unused.remove(mapping);
+  ++cache.hits;
+  return mapping;
+}
+
+DcmFileMapping *DcmFileMapCache::map(const OFFilename &filename, OFFile &file, offile_off_t size)
+{
+  // files larger than the address space are read through stdio
+  if (OFstatic_cast(unsigned long long, size) > OFstatic_cast(unsigned long long, OFstatic_cast(size_t, -1))) return NULL;
+
+#ifdef HAVE_WINDOWS_H
+  HANDLE handle = CreateFileMapping(OFreinterpret_cast(HANDLE, _get_osfhandle(file.fileNo())), NULL, PAGE_READONLY, 0, 0, NULL);
+  if (handle == NULL) return NULL;
+  void *view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+  // the view keeps the mapping alive
+  CloseHandle(handle);
+  if (view == NULL) return NULL;
+#else
+  void *view = mmap(NULL, OFstatic_cast(size_t, size), PROT_READ, MAP_PRIVATE, file.fileNo(), 0);
+  if (view == MAP_FAILED) return NULL;
+#endif
+
+  DcmFileMapping *mapping = new DcmFileMapping;
+  mapping->data = OFstatic_cast(const unsigned char *, view);
+  mapping->size = size;
+  mapping->mtime = 0;
+  mapping->refs = 1;
+  mapping->cached = OFFalse;
+
+  DcmFileMapCacheState &cache = fileMapCache();
+  offile_off_t statSize = 0;
+  if (getMaxEntries() > 0 && fileStatus(filename, mapping->mtime, statSize) && statSize == size)
+  {
+    DcmFileMapCacheLock lock(cache);
+    ++cache.misses;
+    mapping->path = filename.getCharPointer();
+    OFMap<OFString, DcmFileMapping *>::iterator it = cache.index.find(mapping->path);
+    // replace an outdated mapping or one added concurrently by another producer
+    if (it != cache.index.end()) uncache(cache, it->second);
+    cache.index[mapping->path] = mapping;
+    mapping->cached = OFTrue;
+  }
+  return mapping;
+}
+
+void DcmFileMapCache::release(DcmFileMapping *mapping)
+{
+  if (mapping == NULL) return;
+  DcmFileMapCacheState &cache = fileMapCache();
+  DcmFileMapCacheLock lock(cache);
+  if (--mapping->refs > 0) return;
+  if (mapping->cached)
+  {
+    cache.unused.push_front(mapping);
+    trim(cache);
+  }
+  else unmapFile(mapping);
+}
+
+const unsigned char *DcmFileMapCache::data(const DcmFileMapping *mapping)
+{
+  return mapping->data;
+}
+
+offile_off_t DcmFileMapCache::size(const DcmFileMapping *mapping)
+{
+  return mapping->size;
+}
+
+/* ======================================================================= */
 
 DcmFileProducer::DcmFileProducer(const OFFilename &filename, offile_off_t offset)
 : DcmProducer()
 , file_()
+, mapping_(NULL)
+, map_(NULL)
+, mapPos_(0)
 , status_(EC_Normal)
 , size_(0)
 {
+  if (dcmMemoryMappedFileInput.get() && (mapping_ = DcmFileMapCache::acquire(filename)) != NULL)
+  {
+    // the file is still mapped, no need to open it
+    size_ = DcmFileMapCache::size(mapping_);
+    if (offset <= size_)
+    {
+      map_ = DcmFileMapCache::data(mapping_);
+      mapPos_ = offset;
+      return;
+    }
+    DcmFileMapCache::release(mapping_);
+    mapping_ = NULL;
+  }
+
   if (file_.fopen(filename, "rb"))
   {
      // Get number of bytes in file
      file_.fseek(0L, SEEK_END);
      size_ =  file_.ftell();
-     if (0 != file_.fseek(offset, SEEK_SET))
+     if (dcmMemoryMappedFileInput.get() && size_ > 0 && offset <= size_)
+     {
+       mapFile(filename, offset);
+     }
+     if (map_ == NULL && 0 != file_.fseek(offset, SEEK_SET))
      {
        OFString s("(unknown error code)");
        file_.getLastErrorString(s);
@@ -57,6 +372,18 @@ DcmFileProducer::DcmFileProducer(const OFFilename &filename, offile_off_t offset
 
 DcmFileProducer::~DcmFileProducer()
 {
+  DcmFileMapCache::release(mapping_);
+}
+
+void DcmFileProducer::mapFile(const OFFilename &filename, offile_off_t offset)
+{
+  mapping_ = DcmFileMapCache::map(filename, file_, size_);
+  if (mapping_ == NULL) return;
+
+  map_ = DcmFileMapCache::data(mapping_);
+  mapPos_ = offset;
+  // the mapping stays valid without the file descriptor
+  file_.fclose();
 }
 
 OFBool DcmFileProducer::good() const
@@ -71,6 +398,7 @@ OFCondition DcmFileProducer::status() const
 
 OFBool DcmFileProducer::eos()
 {
+  if (map_) return (mapPos_ >= size_);
   if (file_.open())
   {
     return (file_.eof() || (size_ == file_.ftell()));
@@ -80,13 +408,20 @@ OFBool DcmFileProducer::eos()
 
 offile_off_t DcmFileProducer::avail()
 {
+  if (map_) return size_ - mapPos_;
   if (file_.open()) return size_ - file_.ftell(); else return 0;
 }
 
 offile_off_t DcmFileProducer::read(void *buf, offile_off_t buflen)
 {
   offile_off_t result = 0;
-  if (status_.good() && file_.open() && buf && buflen)
+  if (status_.good() && map_ && buf && buflen)
+  {
+    result = (size_ - mapPos_ < buflen) ? (size_ - mapPos_) : buflen;
+    memcpy(buf, map_ + mapPos_, OFstatic_cast(size_t, result));
+    mapPos_ += result;
+  }
+  else if (status_.good() && file_.open() && buf && buflen)
   {
     result = file_.fread(buf, 1, OFstatic_cast(size_t, buflen));
   }
@@ -96,7 +431,13 @@ offile_off_t DcmFileProducer::read(void *buf, offile_off_t buflen)
 offile_off_t DcmFileProducer::skip(offile_off_t skiplen)
 {
   offile_off_t result = 0;
-  if (status_.good() && file_.open() && skiplen)
+  if (status_.good() && map_ && skiplen)
+  {
+    // the skipped pages are never read
+    result = (size_ - mapPos_ < skiplen) ? (size_ - mapPos_) : skiplen;
+    mapPos_ += result;
+  }
+  else if (status_.good() && file_.open() && skiplen)
   {
     offile_off_t pos = file_.ftell();
     result = (size_ - pos < skiplen) ? (size_ - pos) : skiplen;
@@ -112,7 +453,12 @@ offile_off_t DcmFileProducer::skip(offile_off_t skiplen)
 
 void DcmFileProducer::putback(offile_off_t num)
 {
-  if (status_.good() && file_.open() && num)
+  if (status_.good() && map_ && num)
+  {
+    if (num <= mapPos_) mapPos_ -= num;
+    else status_ = EC_PutbackFailed; // tried to putback before start of file
+  }
+  else if (status_.good() && file_.open() && num)
   {
     offile_off_t pos = file_.ftell();
     if (num <= pos)
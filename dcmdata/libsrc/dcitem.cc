@@ -36,6 +36,7 @@
 #include "dcmtk/dcmdata/dcostrma.h"   /* for class DcmOutputStream */
 #include "dcmtk/dcmdata/dcovlay.h"
 #include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmdata/dcproj.h"
 #include "dcmtk/dcmdata/dcsequen.h"
 #include "dcmtk/dcmdata/dcswap.h"
 #include "dcmtk/dcmdata/dcvr.h"
@@ -80,6 +81,8 @@
 #include "dcmtk/ofstd/ofcast.h"
 #include "dcmtk/ofstd/ofstd.h"
 
+#include <algorithm>
+
 // ********************************
 
 
@@ -88,7 +91,13 @@ DcmItem::DcmItem()
     elementList(NULL),
     lastElementComplete(OFTrue),
     fStartPosition(0),
-    privateCreatorCache()
+    readProjection(NULL),
+    fSkipValueBytes(0),
+    privateCreatorCache(),
+    searchIndex(NULL),
+    searchIndexSize(0),
+    searchIndexVersion(0),
+    searchCount(0)
 {
     elementList = new DcmList;
 }
@@ -100,7 +109,13 @@ DcmItem::DcmItem(const DcmTag &tag,
     elementList(NULL),
     lastElementComplete(OFTrue),
     fStartPosition(0),
-    privateCreatorCache()
+    readProjection(NULL),
+    fSkipValueBytes(0),
+    privateCreatorCache(),
+    searchIndex(NULL),
+    searchIndexSize(0),
+    searchIndexVersion(0),
+    searchCount(0)
 {
     elementList = new DcmList;
 }
@@ -111,7 +126,13 @@ DcmItem::DcmItem(const DcmItem &old)
     elementList(new DcmList),
     lastElementComplete(old.lastElementComplete),
     fStartPosition(old.fStartPosition),
-    privateCreatorCache()
+    readProjection(NULL),
+    fSkipValueBytes(0),
+    privateCreatorCache(),
+    searchIndex(NULL),
+    searchIndexSize(0),
+    searchIndexVersion(0),
+    searchCount(0)
 {
     if (!old.elementList->empty())
     {
@@ -217,6 +238,7 @@ OFCondition DcmItem::copyFrom(const DcmObject& rhs)
 
 DcmItem::~DcmItem()
 {
+    clearSearchIndex();
     elementList->deleteAllElements();
     delete elementList;
 }
@@ -1145,6 +1167,26 @@ OFCondition DcmItem::readTagAndLength(DcmInputStream &inStream,
             DCMDATA_WARN("DcmItem: Length of element " << newTag << " is not a multiple of " << vrSize << " (VR=" << vr.getVRName() << ")");
         }
     }
+    l_error = checkElementLength(inStream, newTag, valueLength);
+
+    /* assign values to out parameter */
+    length = valueLength;
+    tag = newTag;
+
+    /* return return value */
+    return l_error;
+}
+
+
+// ********************************
+
+
+OFCondition DcmItem::checkElementLength(DcmInputStream &inStream,
+                                        DcmTag &newTag,
+                                        const Uint32 valueLength)
+{
+    OFCondition l_error = EC_Normal;
+
     /* if the value in the length field is odd, print an error message */
     if ((valueLength & 1) && (valueLength != DCM_UndefinedLength))
     {
@@ -1152,7 +1194,7 @@ OFCondition DcmItem::readTagAndLength(DcmInputStream &inStream,
     }
 
     /* if desired, handle private attributes with maximum length as VR SQ */
-    if (isPrivate && dcmReadImplPrivAttribMaxLengthAsSQ.get() && (valueLength == DCM_UndefinedLength))
+    if ((newTag.getGroup() & 1) && dcmReadImplPrivAttribMaxLengthAsSQ.get() && (valueLength == DCM_UndefinedLength))
     {
         /* re-set tag to be a sequence and also delete private creator cache */
         newTag.setVR(EVR_SQ);
@@ -1191,11 +1233,124 @@ OFCondition DcmItem::readTagAndLength(DcmInputStream &inStream,
         }
     }
 
-    /* assign values to out parameter */
+    return l_error;
+}
+
+
+// ********************************
+
+
+OFCondition DcmItem::skipElementValue(DcmInputStream &inStream)
+{
+    /* a network stream may provide the value in several parts */
+    while (fSkipValueBytes > 0)
+    {
+        const offile_off_t skipped = inStream.skip(fSkipValueBytes);
+        if (skipped <= 0)
+            break;
+        fSkipValueBytes -= OFstatic_cast(Uint32, skipped);
+    }
+    if (fSkipValueBytes == 0)
+        return EC_Normal;
+    if (inStream.status().bad())
+        return inStream.status();
+    return EC_StreamNotifyClient;
+}
+
+
+// ********************************
+
+
+template <OFBool explicitVR>
+OFCondition DcmItem::readTagAndLengthLittleEndian(DcmInputStream &inStream,
+                                                  const OFBool preferVRFromDataDictionary,
+                                                  const OFBool preferLengthFieldSizeFromDataDictionary,
+                                                  DcmTag &tag,
+                                                  Uint32 &length,
+                                                  Uint32 &bytesRead)
+{
+    const E_TransferSyntax xfer = explicitVR ? EXS_LittleEndianExplicit : EXS_LittleEndianImplicit;
+
+    /* bail out if at end of stream */
+    if (inStream.eos())
+        return EC_EndOfStream;
+
+    /* the longest header is 12 bytes (explicit VR with extended length field), shorter */
+    /* remainders of the stream are left to the general function, which waits for more */
+    if (inStream.avail() < (explicitVR ? 12 : 8))
+        return readTagAndLength(inStream, xfer, tag, length, bytesRead);
+
+    /* read tag, VR and a 2 or 4 byte length field in one go, no swapping needed */
+    Uint8 header[8];
+    inStream.mark();
+    inStream.read(header, 8);
+    bytesRead = 8;
+    const Uint16 groupTag = OFstatic_cast(Uint16, header[0] | (header[1] << 8));
+    const Uint16 elementTag = OFstatic_cast(Uint16, header[2] | (header[3] << 8));
+    DcmTag newTag(groupTag, elementTag);
+    DcmEVR newEVR = newTag.getEVR();
+    Uint32 valueLength = 0;
+
+    if (explicitVR && (newEVR != EVR_na))
+    {
+        const char vrstr[3] = { OFstatic_cast(char, header[4]), OFstatic_cast(char, header[5]), '\0' };
+        DcmVR vr(vrstr);
+        if (!vr.isStandard())
+        {
+            /* non-standard VRs get the warnings and workarounds of the general function */
+            inStream.putback();
+            bytesRead = 0;
+            return readTagAndLength(inStream, xfer, tag, length, bytesRead);
+        }
+        if (preferVRFromDataDictionary && (newEVR != EVR_UNKNOWN) && (newEVR != EVR_UNKNOWN2B))
+        {
+            if (newEVR != vr.getEVR())
+            {
+                DCMDATA_DEBUG("DcmItem::readTagAndLength() ignoring explicit VR in data set ("
+                    << vr.getVRName() << ") for element " << newTag
+                    << ", using the one from data dictionary (" << newTag.getVRName() << ")");
+            }
+        } else {
+            newTag.setVR(vr);
+        }
+        if (!preferLengthFieldSizeFromDataDictionary || newEVR == EVR_UNKNOWN || newEVR == EVR_UNKNOWN2B)
+            newEVR = vr.getEVR();
+
+        const DcmVR lengthVR(newEVR);
+        if (lengthVR.usesExtendedLengthEncoding())
+        {
+            /* 2 reserved bytes, then the 4 byte length field */
+            inStream.read(&valueLength, 4);
+            bytesRead = 12;
+        } else {
+            valueLength = header[6] | (header[7] << 8);
+        }
+        const size_t vrSize = lengthVR.getValueWidth();
+        if ((vrSize > 1) && (valueLength % vrSize != 0))
+        {
+            DCMDATA_WARN("DcmItem: Length of element " << newTag << " is not a multiple of " << vrSize << " (VR=" << lengthVR.getVRName() << ")");
+        }
+    } else {
+        /* implicit VR and delimitation items: 4 byte length field */
+        valueLength = OFstatic_cast(Uint32, header[4]) | (OFstatic_cast(Uint32, header[5]) << 8) |
+            (OFstatic_cast(Uint32, header[6]) << 16) | (OFstatic_cast(Uint32, header[7]) << 24);
+    }
+
+    /* special handling for private elements */
+    if ((groupTag & 1) && (newTag.getElement() >= 0x1000))
+    {
+        const char *pc = privateCreatorCache.findPrivateCreator(newTag);
+        if (pc)
+        {
+            newTag.setPrivateCreator(pc);
+            if (!explicitVR)
+                newTag.lookupVRinDictionary();
+        }
+    }
+
+    const OFCondition l_error = checkElementLength(inStream, newTag, valueLength);
     length = valueLength;
     tag = newTag;
-
-    /* return return value */
     return l_error;
 }
 
@@ -1339,18 +1494,34 @@ OFCondition DcmItem::readUntilTag(DcmInputStream & inStream,
         }
         DcmTag newTag;
         OFBool readStopElem = OFFalse;
+        /* the transfer syntax and the global options are looked up once, not for each element */
+        const OFBool implicitVR = DcmXfer(xfer).isImplicitVR();
+        const OFBool littleEndianMachine = (gLocalByteOrder == EBO_LittleEndian);
+        const OFBool readExplicitLittleEndian = littleEndianMachine && (xfer == EXS_LittleEndianExplicit);
+        const OFBool readImplicitLittleEndian = littleEndianMachine && (xfer == EXS_LittleEndianImplicit);
+        const OFBool preferVRFromDataDictionary = dcmPreferVRFromDataDictionary.get();
+        const OFBool preferLengthFieldSizeFromDataDictionary = dcmPreferLengthFieldSizeFromDataDictionary.get();
+        const DcmTagKey stopParsingAfterElement = dcmStopParsingAfterElement.get();
         /* start a loop in order to read all elements (attributes) which are contained in the inStream */
         while (inStream.good() && (getTransferredBytes() < getLengthField() || !lastElementComplete) && !readStopElem)
         {
             /* initialize variables */
             Uint32 newValueLength = 0;
             Uint32 bytes_tagAndLen = 0;
+            OFBool elementSkipped = OFFalse;
             /* if the reading of the last element was complete, go ahead and read the next element */
             if (lastElementComplete)
             {
                 /* read this element's tag and length information */
                 /* (and possibly also VR information) from the inStream */
-                errorFlag = readTagAndLength(inStream, xfer, newTag, newValueLength, bytes_tagAndLen);
+                if (readExplicitLittleEndian)
+                    errorFlag = readTagAndLengthLittleEndian<OFTrue>(inStream, preferVRFromDataDictionary,
+                        preferLengthFieldSizeFromDataDictionary, newTag, newValueLength, bytes_tagAndLen);
+                else if (readImplicitLittleEndian)
+                    errorFlag = readTagAndLengthLittleEndian<OFFalse>(inStream, preferVRFromDataDictionary,
+                        preferLengthFieldSizeFromDataDictionary, newTag, newValueLength, bytes_tagAndLen);
+                else
+                    errorFlag = readTagAndLength(inStream, xfer, newTag, newValueLength, bytes_tagAndLen);
                 /* increase counter correspondingly */
                 incTransferredBytes(bytes_tagAndLen);
 
@@ -1389,17 +1560,36 @@ OFCondition DcmItem::readUntilTag(DcmInputStream & inStream,
                     /* of an element; hence, lastElementComplete is not longer true */
                     lastElementComplete = OFFalse;
                     /* in case of implicit VR, check whether the "default VR" is really appropriate */
-                    if (DcmXfer(xfer).isImplicitVR())
+                    if (implicitVR)
                         checkAndUpdateVR(*this, newTag);
 
+                    /* the read projection applies to the elements of the main dataset only */
+                    const OFBool projected = (readProjection != NULL) && (ident() == EVR_dataset) && (newTag.getGroup() != 0xfffe);
+
                     /* check if we want to stop parsing at this point, in the main dataset only */
                     if( (stopParsingAtElement != DCM_UndefinedTagKey) && (newTag.getXTag()>=stopParsingAtElement) && ident() == EVR_dataset)
                     {
                       lastElementComplete = OFTrue;
                       readStopElem = OFTrue;
-                      DCMDATA_WARN("DcmItem: Element " << newTag.getTagName() << " " << newTag
+                      DCMDATA_DEBUG("DcmItem: Element " << newTag.getTagName() << " " << newTag
                         << " encountered, skipping rest of dataset");
                     }
+                    /* check if the rest of the main dataset is outside the read projection */
+                    else if (projected && readProjection->isBehind(newTag))
+                    {
+                      lastElementComplete = OFTrue;
+                      readStopElem = OFTrue;
+                      DCMDATA_TRACE("DcmItem: Element " << newTag << " behind the read projection, skipping rest of dataset");
+                    }
+                    /* skip the value of an element outside the read projection without creating an element */
+                    else if (projected && (newValueLength != DCM_UndefinedLength) && !readProjection->isSelected(newTag))
+                    {
+                      fSkipValueBytes = newValueLength;
+                      elementSkipped = OFTrue;
+                      errorFlag = skipElementValue(inStream);
+                      if (errorFlag.good())
+                        lastElementComplete = OFTrue;
+                    }
                     else
                     {
                       /* read the actual data value which belongs to this element */
@@ -1420,8 +1610,15 @@ OFCondition DcmItem::readUntilTag(DcmInputStream & inStream,
                 /* if lastElementComplete is false, we have only read the current element's */
                 /* tag and length (and possibly VR) information as well as maybe some data */
                 /* data value information. We need to continue reading the data value */
-                /* information for this particular element. */
-                errorFlag = elementList->get()->read(inStream, xfer, glenc, maxReadLength);
+                /* information for this particular element, or skipping it if it is */
+                /* outside the read projection. */
+                if (fSkipValueBytes > 0)
+                {
+                    elementSkipped = OFTrue;
+                    errorFlag = skipElementValue(inStream);
+                }
+                else
+                    errorFlag = elementList->get()->read(inStream, xfer, glenc, maxReadLength);
                 /* if reading was successful, we read the entire information */
                 /* for this element; hence lastElementComplete is true */
                 if (errorFlag.good())
@@ -1432,12 +1629,12 @@ OFCondition DcmItem::readUntilTag(DcmInputStream & inStream,
             if (errorFlag.good())
             {
                 // If we completed one element, update the private tag cache.
-                if (lastElementComplete)
+                if (lastElementComplete && !elementSkipped)
                 {
                     privateCreatorCache.updateCache(elementList->get());
                     // evaluate option for skipping rest of dataset
-                    if ( (dcmStopParsingAfterElement.get() != DCM_UndefinedTagKey) &&
-                         (dcmStopParsingAfterElement.get() == elementList->get()->getTag()) &&
+                    if ( (stopParsingAfterElement != DCM_UndefinedTagKey) &&
+                         (stopParsingAfterElement == elementList->get()->getTag()) &&
                           ident() == EVR_dataset)
                     {
                         DCMDATA_WARN("DcmItem: Element " << newTag.getTagName() << " " << newTag
@@ -1689,6 +1886,7 @@ void DcmItem::transferInit()
     DcmObject::transferInit();
     fStartPosition = 0;
     lastElementComplete = OFTrue;
+    fSkipValueBytes = 0;
     privateCreatorCache.clear();
     if (!elementList->empty())
     {
@@ -2070,6 +2268,20 @@ OFCondition DcmItem::searchSubFromHere(const DcmTagKey &tag,
 {
     DcmObject *dO;
     OFCondition l_error = EC_TagNotFound;
+    if (!searchIntoSub)
+    {
+        OFBool indexed = OFFalse;
+        dO = findInSearchIndex(tag, indexed);
+        if (indexed)
+        {
+            if (dO != NULL)
+            {
+                resultStack.push(dO);
+                l_error = EC_Normal;
+            }
+            return l_error;
+        }
+    }
     if (!elementList->empty())
     {
         elementList->seek(ELP_first);
@@ -2104,6 +2316,73 @@ OFCondition DcmItem::searchSubFromHere(const DcmTagKey &tag,
 // ********************************
 
 
+/* items with fewer elements are always searched linearly */
+static const unsigned long DCM_SearchIndexMinElements = 16;
+
+/* number of searches without modification after which the index is built */
+static const unsigned long DCM_SearchIndexMinSearches = 4;
+
+static bool lessTag(DcmObject *obj1, DcmObject *obj2)
+{
+    return obj1->getTag() < obj2->getTag();
+}
+
+
+DcmObject *DcmItem::findInSearchIndex(const DcmTagKey &tag,
+                                      OFBool &indexed)
+{
+    indexed = OFFalse;
+    if (elementList->modifications() != searchIndexVersion)
+    {
+        // elements have been inserted or removed since the index was built
+        clearSearchIndex();
+        searchIndexVersion = elementList->modifications();
+    }
+    if (searchIndex == NULL)
+    {
+        if (++searchCount < DCM_SearchIndexMinSearches || elementList->card() < DCM_SearchIndexMinElements)
+            return NULL;
+        searchIndexSize = elementList->card();
+        searchIndex = new DcmObject*[searchIndexSize];
+        unsigned long i = 0;
+        elementList->seek(ELP_first);
+        do {
+            searchIndex[i++] = elementList->get();
+        } while (i < searchIndexSize && elementList->seek(ELP_next));
+        // the list is sorted already unless elements were inserted at a fixed position,
+        // stable sorting finds the same element as a linear search in case of duplicates
+        std::stable_sort(searchIndex, searchIndex + searchIndexSize, lessTag);
+    }
+    indexed = OFTrue;
+
+    unsigned long low = 0;
+    unsigned long high = searchIndexSize;
+    while (low < high)
+    {
+        const unsigned long mid = low + (high - low) / 2;
+        if (searchIndex[mid]->getTag() < tag)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low < searchIndexSize && searchIndex[low]->getTag() == tag)
+        return searchIndex[low];
+    return NULL;
+}
+
+
+void DcmItem::clearSearchIndex()
+{
+    delete[] searchIndex;
+    searchIndex = NULL;
+    searchIndexSize = 0;
+    searchCount = 0;
+}
+
+
+// ********************************
+
+
 OFCondition DcmItem::search(const DcmTagKey &tag,
                             DcmStack &resultStack,
                             E_SearchMode mode,
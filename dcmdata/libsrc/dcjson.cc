@@ -29,13 +29,71 @@
 
 #include "dcmtk/ofstd/ofdefine.h"
 #include "dcmtk/ofstd/ofstring.h"
+#include "dcmtk/ofstd/ofstd.h"
+
+/* SSE2 is part of every x86-64 CPU and used to find the next character
+ * that needs escaping 16 bytes at a time.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define DCJSON_SSE2
+#include <emmintrin.h>
+#endif
+
+// returns true if the character must be escaped in a JSON string
+static inline OFBool needsEscaping(const char c)
+{
+    return (c == '"') || (c == '\\') || (c >= '\0' && c < ' ');
+}
+
+// returns the number of leading characters that need no escaping
+static size_t plainCharacters(const char *value, size_t length)
+{
+    size_t i = 0;
+#ifdef DCJSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= length; i += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, value + i));
+        // unsigned comparison, bytes >= 0x80 are part of multi-byte characters
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+        const int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+        {
+            for (int bit = 0; !(mask & (1 << bit)); ++bit)
+                ++i;
+            return i;
+        }
+    }
+#endif
+    while (i < length && !needsEscaping(value[i]))
+        ++i;
+    return i;
+}
 
 void DcmJsonFormat::escapeControlCharacters(STD_NAMESPACE ostream &out, const OFString &value)
+{
+    escapeControlCharacters(out, value.c_str(), value.size());
+}
+
+void DcmJsonFormat::escapeControlCharacters(STD_NAMESPACE ostream &out, const char *value, size_t length)
 {
     // escapes all forbidden control characters in JSON
-    for (size_t i = 0; i < value.size(); ++i)
+    size_t i = 0;
+    while (i < length)
     {
-        const char c = value.at(i);
+        const size_t plain = plainCharacters(value + i, length - i);
+        if (plain > 0)
+        {
+            out.write(value + i, OFstatic_cast(STD_NAMESPACE streamsize, plain));
+            i += plain;
+            if (i == length)
+                break;
+        }
+        const char c = value[i++];
         switch (c)
         {
         case '\\':
@@ -60,17 +118,13 @@ void DcmJsonFormat::escapeControlCharacters(STD_NAMESPACE ostream &out, const OF
             out << "\\f";
             break;
         default:
+        {
             //escapes all other control characters
-            if (c >= '\0' && c < ' ')
-            {
-                out << "\\u" << STD_NAMESPACE hex
-                    << STD_NAMESPACE setw(4) << STD_NAMESPACE setfill('0')
-                    << OFstatic_cast(unsigned, OFstatic_cast(unsigned char, c));
-            }
-            else
-            {
-                out << c;
-            }
+            static const char hexDigits[] = "0123456789abcdef";
+            const unsigned char u = OFstatic_cast(unsigned char, c);
+            const char escaped[6] = { '\\', 'u', '0', '0', hexDigits[u >> 4], hexDigits[u & 15] };
+            out.write(escaped, 6);
+        }
         }
     }
 }
@@ -78,50 +132,27 @@ void DcmJsonFormat::escapeControlCharacters(STD_NAMESPACE ostream &out, const OF
 // Formats the number to JSON standard as DecimalString
 void DcmJsonFormat::normalizeDecimalString(OFString &value)
 {
-    OFBool minus = OFFalse;
-
-    if (value[0] == '-')
-    {
-        value = value.substr(1);
-        minus = OFTrue;
-    }
-
-    size_t pos = value.find_first_not_of("0");
+    const size_t sign = (value[0] == '-') ? 1 : 0;
+    const size_t pos = value.find_first_not_of("0", sign);
 
     if (pos == OFString_npos)
-        value = "0";
-    else
-    {
-        if (value[pos] == '.')
-            value = '0' + value.substr(pos);
-        else
-            value = value.substr(pos);
-    }
-
-    if (minus)
-        value = '-' + value;
+        value.replace(sign, OFString_npos, "0");
+    else if (value[pos] == '.')
+        value.replace(sign, pos - sign, "0");
+    else if (pos > sign)
+        value.erase(sign, pos - sign);
 }
 
 // Formats the number to JSON standard as IntegerString
 void DcmJsonFormat::normalizeIntegerString(OFString &value)
 {
-    OFBool minus = OFFalse;
-
-    if (value[0] == '-')
-    {
-        value = value.substr(1);
-        minus = OFTrue;
-    }
-
-    size_t pos = value.find_first_not_of("0");
+    const size_t sign = (value[0] == '-') ? 1 : 0;
+    const size_t pos = value.find_first_not_of("0", sign);
 
     if (pos == OFString_npos)
-        value = "0";
-    else
-        value = value.substr(pos);
-
-    if (minus)
-        value = '-' + value;
+        value.replace(sign, OFString_npos, "0");
+    else if (pos > sign)
+        value.erase(sign, pos - sign);
 }
 
 // Print a string in JSON format
@@ -180,6 +211,40 @@ void DcmJsonFormat::printNumberDecimal(STD_NAMESPACE ostream &out,
     }
 }
 
+// Print a binary floating point number in JSON format
+void DcmJsonFormat::printNumberDecimal(STD_NAMESPACE ostream &out,
+                                       Float64 value,
+                                       int precision)
+{
+    // integral values with fewer digits than the precision come out of ftoa()
+    // without a fraction or exponent, format them directly
+    double limit = 1.0;
+    for (int i = 0; i < precision && i < 18; ++i)
+        limit *= 10.0;
+    const double magnitude = value < 0 ? -value : value;
+    Uint64 digits = 0;
+    if (magnitude >= 1.0 && magnitude < limit)
+        digits = OFstatic_cast(Uint64, magnitude);
+    // the truncated magnitude is never larger, the value is integral unless it is smaller
+    if (digits > 0 && !(OFstatic_cast(double, digits) < magnitude))
+    {
+        char buffer[24];
+        char *p = buffer + sizeof(buffer);
+        do
+        {
+            *--p = OFstatic_cast(char, '0' + digits % 10);
+            digits /= 10;
+        } while (digits > 0);
+        if (value < 0)
+            *--p = '-';
+        out.write(p, buffer + sizeof(buffer) - p);
+        return;
+    }
+    char buffer[64];
+    OFStandard::ftoa(buffer, sizeof(buffer), value, 0, 0, precision);
+    out << buffer;
+}
+
 // Print the prefix for Value
 void DcmJsonFormat::printValuePrefix(STD_NAMESPACE ostream &out)
 {
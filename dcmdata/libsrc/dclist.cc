@@ -55,7 +55,8 @@ DcmList::DcmList()
   : firstNode(NULL),
     lastNode(NULL),
     currentNode(NULL),
-    cardinality(0)
+    cardinality(0),
+    modificationCount(0)
 {
 }
 
@@ -96,6 +97,7 @@ DcmObject *DcmList::append( DcmObject *obj )
             currentNode = lastNode = node;
         }
         cardinality++;
+        modificationCount++;
     } // obj == NULL
     return obj;
 }
@@ -118,6 +120,7 @@ DcmObject *DcmList::prepend( DcmObject *obj )
             currentNode = firstNode = node;
         }
         cardinality++;
+        modificationCount++;
     } // obj == NULL
     return obj;
 }
@@ -134,6 +137,7 @@ DcmObject *DcmList::insert( DcmObject *obj, E_ListPos pos )
         {
             currentNode = firstNode = lastNode = new DcmListNode(obj);
             cardinality++;
+            modificationCount++;
         }
         else {
             if ( pos==ELP_last )
@@ -156,6 +160,7 @@ DcmObject *DcmList::insert( DcmObject *obj, E_ListPos pos )
                 currentNode->prevNode = node;
                 currentNode = node;
                 cardinality++;
+                modificationCount++;
             }
             else //( pos==ELP_next || pos==ELP_atpos )
                                                 // insert after current node
@@ -170,6 +175,7 @@ DcmObject *DcmList::insert( DcmObject *obj, E_ListPos pos )
                 currentNode->nextNode = node;
                 currentNode = node;
                 cardinality++;
+                modificationCount++;
             }
         }
     } // obj == NULL
@@ -207,6 +213,7 @@ DcmObject *DcmList::remove()
         tempobj = tempnode->value();
         delete tempnode;
         cardinality--;
+        modificationCount++;
         return tempobj;
     }
 }
@@ -292,4 +299,5 @@ void DcmList::deleteAllElements()
     lastNode = NULL;
     currentNode = NULL;
     cardinality = 0;
+    modificationCount++;
 }
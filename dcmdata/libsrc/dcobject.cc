@@ -34,6 +34,7 @@
 #include "dcmtk/dcmdata/dcswap.h"
 #include "dcmtk/dcmdata/dcistrma.h"    /* for class DcmInputStream */
 #include "dcmtk/dcmdata/dcostrma.h"    /* for class DcmOutputStream */
+#include "dcmtk/dcmdata/dcarena.h"     /* for class DcmArenaScope */
 
 #define INCLUDE_CSTDIO
 #define INCLUDE_IOMANIP
@@ -59,6 +60,7 @@ OFGlobal<OFBool>    dcmReplaceWrongDelimitationItem(OFFalse);
 OFGlobal<OFBool>    dcmConvertUndefinedLengthOBOWtoSQ(OFFalse);
 OFGlobal<OFBool>    dcmConvertVOILUTSequenceOWtoSQ(OFFalse);
 OFGlobal<OFBool>    dcmUseExplLengthPixDataForEncTS(OFFalse);
+OFGlobal<OFBool>    dcmCreateExtendedOffsetTable(OFFalse);
 
 // ****** public methods **********************************
 
@@ -91,6 +93,33 @@ DcmObject::~DcmObject()
 }
 
 
+void *DcmObject::operator new(size_t size)
+{
+    void *ptr = DcmArenaScope::allocate(size);
+    if (ptr == NULL)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+
+void *DcmObject::operator new(size_t size, const std::nothrow_t&) throw()
+{
+    return DcmArenaScope::allocate(size);
+}
+
+
+void DcmObject::operator delete(void *ptr)
+{
+    DcmArenaScope::deallocate(ptr);
+}
+
+
+void DcmObject::operator delete(void *ptr, const std::nothrow_t&) throw()
+{
+    DcmArenaScope::deallocate(ptr);
+}
+
+
 DcmObject &DcmObject::operator=(const DcmObject &obj)
 {
     if (this != &obj)
@@ -25,18 +25,105 @@
 #include "dcmtk/dcmdata/dcerror.h"
 
 #define INCLUDE_CSTDIO
+#define INCLUDE_CSTDLIB
+#define INCLUDE_CSTRING
+#define INCLUDE_CERRNO
 #include "dcmtk/ofstd/ofstdinc.h"
 
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_WINDOWS_H
+#include <windows.h>
+#include <io.h>
+#endif
+
+OFGlobal<Uint32> dcmLargeFileWriteSize(0);
+OFGlobal<Uint32> dcmDirectFileWriteSize(0);
+
+/* direct I/O requires buffers, lengths and file offsets aligned to the
+ * logical block size of the device, which is 4K or less on current devices
+ */
+#define DcmFileConsumer_DIRECT_ALIGNMENT 4096
+
+/* reserves the blocks of a file of the given length without changing its
+ * size, so a shorter file has no trailing garbage. Failures are ignored, the
+ * file is written anyway. On Windows the allocation size is set instead of
+ * SetFileValidData(), which needs the volume management privilege and would
+ * expose the previous content of the blocks.
+ */
+static void preallocateFile(int fd, offile_off_t length)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+  (void) fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, length);
+#elif defined(__APPLE__) && defined(F_PREALLOCATE)
+  fstore_t store;
+  memset(&store, 0, sizeof(store));
+  store.fst_flags = F_ALLOCATECONTIG;
+  store.fst_posmode = F_PEOFPOSMODE;
+  store.fst_length = length;
+  if (fcntl(fd, F_PREALLOCATE, &store) == -1)
+  {
+    // contiguous space is not available, any will do
+    store.fst_flags = F_ALLOCATEALL;
+    (void) fcntl(fd, F_PREALLOCATE, &store);
+  }
+#elif defined(_WIN32)
+  FILE_ALLOCATION_INFO info;
+  info.AllocationSize.QuadPart = length;
+  (void) SetFileInformationByHandle(OFreinterpret_cast(HANDLE, _get_osfhandle(fd)), FileAllocationInfo, &info, sizeof(info));
+#else
+  (void) fd;
+  (void) length;
+#endif
+}
+
 
 DcmFileConsumer::DcmFileConsumer(const OFFilename &filename)
 : DcmConsumer()
 , file_()
 , status_(EC_Normal)
+, directFd_(-1)
+, block_(NULL)
+, blockUsed_(0)
+{
+  if (!file_.fopen(filename, "wb"))
+  {
+    OFString buffer = OFStandard::getLastSystemErrorCode().message();
+    status_ = makeOFCondition(OFM_dcmdata, 19, OF_error, buffer.c_str());
+  }
+}
+
+DcmFileConsumer::DcmFileConsumer(const OFFilename &filename, offile_off_t expectedLength)
+: DcmConsumer()
+, file_()
+, status_(EC_Normal)
+, directFd_(-1)
+, block_(NULL)
+, blockUsed_(0)
 {
+  const offile_off_t directSize = dcmDirectFileWriteSize.get();
+  const offile_off_t largeSize = dcmLargeFileWriteSize.get();
+  if (expectedLength > 0 && directSize > 0 && expectedLength >= directSize && openDirect(filename))
+  {
+    preallocateFile(directFd_, expectedLength);
+    return;
+  }
   if (!file_.fopen(filename, "wb"))
   {
     OFString buffer = OFStandard::getLastSystemErrorCode().message();
     status_ = makeOFCondition(OFM_dcmdata, 19, OF_error, buffer.c_str());
+    return;
+  }
+  if (expectedLength > 0 && ((largeSize > 0 && expectedLength >= largeSize) || (directSize > 0 && expectedLength >= directSize)))
+  {
+    // before anything is written, a large stdio buffer turns the many small
+    // writes of the elements into few large ones
+    file_.setvbuf(NULL, _IOFBF, DcmFileConsumer_LARGE_BLOCK_SIZE);
+    preallocateFile(file_.fileNo(), expectedLength);
   }
 }
 
@@ -44,12 +131,76 @@ DcmFileConsumer::DcmFileConsumer(FILE *file)
 : DcmConsumer()
 , file_(file)
 , status_(EC_Normal)
+, directFd_(-1)
+, block_(NULL)
+, blockUsed_(0)
 {
 }
 
 DcmFileConsumer::~DcmFileConsumer()
 {
-  file_.fclose();
+  if (directFd_ >= 0)
+  {
+    flush();
+    ::close(directFd_);
+    free(block_);
+  }
+  else
+    file_.fclose();
+}
+
+OFBool DcmFileConsumer::openDirect(const OFFilename &filename)
+{
+#if (defined(__linux__) && defined(O_DIRECT)) || (defined(__APPLE__) && defined(F_NOCACHE))
+  if (filename.usesWideChars())
+    return OFFalse;
+#ifdef __linux__
+  // fails on file systems without direct I/O, which are written the usual way
+  int fd = ::open(filename.getCharPointer(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+  if (fd < 0)
+    return OFFalse;
+#else
+  int fd = ::open(filename.getCharPointer(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    return OFFalse;
+  (void) fcntl(fd, F_NOCACHE, 1);
+#endif
+  void *block = NULL;
+  if (posix_memalign(&block, DcmFileConsumer_DIRECT_ALIGNMENT, DcmFileConsumer_LARGE_BLOCK_SIZE) != 0)
+  {
+    ::close(fd);
+    return OFFalse;
+  }
+  directFd_ = fd;
+  block_ = OFstatic_cast(unsigned char *, block);
+  return OFTrue;
+#else
+  (void) filename;
+  return OFFalse;
+#endif
+}
+
+void DcmFileConsumer::writeBlock(const unsigned char *data, size_t length)
+{
+#ifdef HAVE_UNISTD_H
+  while (length > 0 && status_.good())
+  {
+    const ssize_t written = ::write(directFd_, data, length);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+    {
+      OFString buffer = OFStandard::getLastSystemErrorCode().message();
+      status_ = makeOFCondition(OFM_dcmdata, 19, OF_error, buffer.c_str());
+      return;
+    }
+    data += written;
+    length -= OFstatic_cast(size_t, written);
+  }
+#else
+  (void) data;
+  (void) length;
+#endif
 }
 
 OFBool DcmFileConsumer::good() const
@@ -64,7 +215,7 @@ OFCondition DcmFileConsumer::status() const
 
 OFBool DcmFileConsumer::isFlushed() const
 {
-  return OFTrue;
+  return blockUsed_ == 0;
 }
 
 offile_off_t DcmFileConsumer::avail() const
@@ -77,7 +228,26 @@ offile_off_t DcmFileConsumer::avail() const
 offile_off_t DcmFileConsumer::write(const void *buf, offile_off_t buflen)
 {
   offile_off_t result = 0;
-  if (status_.good() && file_.open() && buf && buflen)
+  if (directFd_ >= 0)
+  {
+    // collected in aligned blocks, which are written once full
+    const unsigned char *data = OFstatic_cast(const unsigned char *, buf);
+    while (status_.good() && data && result < buflen)
+    {
+      size_t length = DcmFileConsumer_LARGE_BLOCK_SIZE - blockUsed_;
+      if (OFstatic_cast(offile_off_t, length) > buflen - result)
+        length = OFstatic_cast(size_t, buflen - result);
+      memcpy(block_ + blockUsed_, data + result, length);
+      blockUsed_ += length;
+      result += length;
+      if (blockUsed_ == DcmFileConsumer_LARGE_BLOCK_SIZE)
+      {
+        writeBlock(block_, blockUsed_);
+        blockUsed_ = 0;
+      }
+    }
+  }
+  else if (status_.good() && file_.open() && buf && buflen)
   {
 #ifdef WRITE_VERY_LARGE_CHUNKS
     /* This is the old behaviour prior to DCMTK 3.5.5 */
@@ -114,7 +284,19 @@ offile_off_t DcmFileConsumer::write(const void *buf, offile_off_t buflen)
 
 void DcmFileConsumer::flush()
 {
-  // nothing to flush
+  if (directFd_ < 0 || blockUsed_ == 0)
+    return;
+  // the aligned part with direct I/O, the rest of the last block the usual way
+  const size_t aligned = blockUsed_ / DcmFileConsumer_DIRECT_ALIGNMENT * DcmFileConsumer_DIRECT_ALIGNMENT;
+  writeBlock(block_, aligned);
+  if (aligned < blockUsed_)
+  {
+#if defined(__linux__) && defined(O_DIRECT)
+    (void) fcntl(directFd_, F_SETFL, fcntl(directFd_, F_GETFL) & ~O_DIRECT);
+#endif
+    writeBlock(block_ + aligned, blockUsed_ - aligned);
+  }
+  blockUsed_ = 0;
 }
 
 /* ======================================================================= */
@@ -125,6 +307,12 @@ DcmOutputFileStream::DcmOutputFileStream(const OFFilename &filename)
 {
 }
 
+DcmOutputFileStream::DcmOutputFileStream(const OFFilename &filename, offile_off_t expectedLength)
+: DcmOutputStream(&consumer_) // safe because DcmOutputStream only stores pointer
+, consumer_(filename, expectedLength)
+{
+}
+
 DcmOutputFileStream::DcmOutputFileStream(FILE *file)
 : DcmOutputStream(&consumer_) // safe because DcmOutputStream only stores pointer
 , consumer_(file)
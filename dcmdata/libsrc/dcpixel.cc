@@ -26,6 +26,9 @@
 #include "dcmtk/dcmdata/dcdeftag.h"
 #include "dcmtk/dcmdata/dcitem.h"
 #include "dcmtk/dcmdata/dcpxitem.h"
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/dcmdata/dcfcache.h"
+#include "dcmtk/ofstd/ofstd.h"
 
 //
 // class DcmRepresentationEntry
@@ -233,14 +236,10 @@ DcmPixelData::canChooseRepresentation(
         }
         else if (toType.isEncapsulated())
         {
-          // we have already compressed data, check whether we know how to transcode
-          result = DcmCodecList::canChangeCoding((*original)->repType, toType.getXfer());
-          if (!result)
-          {
-            // direct transcoding is not possible. Check if we can decode and then encode.
-            result = canChooseRepresentation(EXS_LittleEndianExplicit, NULL);
-            if (result) result = DcmCodecList::canChangeCoding(EXS_LittleEndianExplicit, toType.getXfer());
-          }
+          // we have already compressed data, check whether there is any way of converting it:
+          // fragment pass-through, direct transcoding or decoding and encoding again
+          E_TransferSyntax nextRepType = EXS_Unknown;
+          result = DcmCodecList::findCodingPath((*original)->repType, toType.getXfer(), nextRepType);
         }
         else
         {
@@ -303,6 +302,167 @@ DcmPixelData::chooseRepresentation(
 }
 
 
+OFCondition
+DcmPixelData::chooseRepresentationFrameByFrame(
+    const E_TransferSyntax repType,
+    const DcmRepresentationParameter * repParam,
+    DcmItem *dataset)
+{
+    if (dataset == NULL) return EC_IllegalCall;
+    DcmXfer toType(repType);
+    if (!toType.isEncapsulated()) return EC_CannotChangeRepresentation;
+
+    const DcmRepresentationEntry findEntry(repType, repParam, NULL);
+    DcmRepresentationListIterator found(repListEnd);
+    if (findRepresentationEntry(findEntry, found) == EC_Normal)
+    {
+        // representation already available
+        current = found;
+        recalcVR();
+        return EC_Normal;
+    }
+
+    Sint32 numberOfFrames = 1;
+    dataset->findAndGetSint32(DCM_NumberOfFrames, numberOfFrames);
+    if (numberOfFrames < 2 || (existUnencapsulated && writeUnencapsulated(repType)))
+        return EC_CannotChangeRepresentation;
+
+    Uint32 frameSize = 0;
+    OFCondition l_error = getUncompressedFrameSize(dataset, frameSize);
+    if (l_error.bad()) return l_error;
+    Uint16 bitsAllocated = 0;
+    dataset->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+
+    // single-frame copy of all other attributes, cloned for every frame since encoders modify it
+    DcmDataset frameTemplate;
+    for (unsigned long i = 0; i < dataset->card() && l_error.good(); ++i)
+    {
+        DcmElement *element = dataset->getElement(i);
+        if (element != this)
+            l_error = frameTemplate.insert(OFstatic_cast(DcmElement *, element->clone()), OFTrue);
+    }
+    if (l_error.good()) l_error = frameTemplate.putAndInsertString(DCM_NumberOfFrames, "1");
+
+    // the buffer passed to getUncompressedFrame() must have even length
+    const Uint32 bufSize = frameSize + (frameSize & 1);
+    Uint8 *buffer = new Uint8[bufSize];
+    DcmPixelSequence *pixelSequence = new DcmPixelSequence(DCM_PixelSequenceTag);
+    // the offset table is filled in once all frame sizes are known
+    DcmPixelItem *offsetTable = new DcmPixelItem(DCM_PixelItemTag);
+    pixelSequence->insert(offsetTable);
+    DcmDataset *firstFrame = NULL;
+    DcmOffsetList offsetList;
+    DcmFileCache cache;
+    double compressedSize = 0;
+    Uint32 startFragment = 0;
+    OFString colorModel;
+
+    for (Uint32 frameNo = 0; l_error.good() && frameNo < OFstatic_cast(Uint32, numberOfFrames); ++frameNo)
+    {
+        const Uint32 frameStart = startFragment;
+        l_error = getUncompressedFrame(dataset, frameNo, startFragment, buffer, bufSize, colorModel, &cache);
+        if (l_error.bad()) break;
+
+        // release the compressed fragments of this frame again if they can be reloaded
+        if (!existUnencapsulated && original != repListEnd && (*original)->pixSeq)
+        {
+            DcmPixelItem *fragment = NULL;
+            for (Uint32 i = (frameStart > 0 ? frameStart : 1); i < startFragment; ++i)
+            {
+                if ((*original)->pixSeq->getItem(fragment, i).good())
+                    fragment->compact();
+            }
+        }
+
+        DcmDataset *frameDataset = new DcmDataset(frameTemplate);
+        DcmPixelData *framePixels = new DcmPixelData(DCM_PixelData);
+        framePixels->setVR(bitsAllocated > 8 ? EVR_OW : EVR_OB);
+        if (bitsAllocated > 8)
+            l_error = framePixels->putUint16Array(OFreinterpret_cast(Uint16 *, buffer), frameSize / 2);
+        else
+            l_error = framePixels->putUint8Array(buffer, frameSize);
+        if (l_error.good()) l_error = frameDataset->insert(framePixels, OFTrue);
+        else delete framePixels;
+        if (l_error.good() && !colorModel.empty())
+            l_error = frameDataset->putAndInsertString(DCM_PhotometricInterpretation, colorModel.c_str());
+
+        DcmPixelSequence *frameSequence = NULL;
+        if (l_error.good())
+        {
+            DcmStack stack;
+            stack.push(frameDataset);
+            stack.push(framePixels);
+            l_error = framePixels->chooseRepresentation(repType, repParam, stack);
+        }
+        if (l_error.good())
+            l_error = framePixels->getEncapsulatedRepresentation(repType, repParam, frameSequence);
+
+        // move the fragments, the first item is the offset table of the single frame
+        Uint32 frameLength = 0;
+        DcmPixelItem *fragment = NULL;
+        while (l_error.good() && frameSequence->card() > 1 && frameSequence->remove(fragment, 1).good())
+        {
+            frameLength += fragment->getLength() + 8;
+            l_error = pixelSequence->insert(fragment);
+        }
+        if (l_error.good())
+        {
+            offsetList.push_back(frameLength);
+            compressedSize += frameLength;
+        }
+
+        if (l_error.good() && frameNo == 0)
+        {
+            delete frameDataset->remove(framePixels);
+            firstFrame = frameDataset;
+        }
+        else
+            delete frameDataset;
+    }
+    delete[] buffer;
+
+    if (l_error.good())
+    {
+        // apply the attributes as changed by the encoder for the first frame
+        for (unsigned long i = dataset->card(); i > 0; --i)
+        {
+            DcmElement *element = dataset->getElement(i - 1);
+            if ((element != this) && !firstFrame->tagExists(element->getTag()))
+                delete dataset->remove(element);
+        }
+        while (firstFrame->card() > 0)
+        {
+            DcmElement *element = firstFrame->remove(OFstatic_cast(unsigned long, 0));
+            if (element->getTag() == DCM_NumberOfFrames)
+                delete element;
+            else
+                dataset->insert(element, OFTrue);
+        }
+
+        // the first frame's ratio was appended, replace it with the one of the complete image
+        OFString ratios;
+        if (dataset->findAndGetOFStringArray(DCM_LossyImageCompressionRatio, ratios).good() && compressedSize > 0)
+        {
+            const size_t pos = ratios.rfind('\\');
+            char buf[64];
+            OFStandard::ftoa(buf, sizeof(buf), OFstatic_cast(double, frameSize) * numberOfFrames / compressedSize,
+                OFStandard::ftoa_uppercase, 0, 5);
+            ratios = (pos == OFString_npos) ? OFString(buf) : ratios.substr(0, pos + 1) + buf;
+            dataset->putAndInsertOFStringArray(DCM_LossyImageCompressionRatio, ratios);
+        }
+
+        // the offset tables are created last, the extended one is an attribute of the dataset
+        l_error = DcmCodec::createOffsetTables(dataset, pixelSequence, offsetList, OFTrue);
+    }
+    if (l_error.good())
+        putOriginalRepresentation(repType, repParam, pixelSequence);
+    else
+        delete pixelSequence;
+    delete firstFrame;
+    return l_error;
+}
+
+
 int DcmPixelData::compare(const DcmElement& rhs) const
 {
   // check tag and VR
@@ -474,8 +634,33 @@ DcmPixelData::encode(
        DcmPixelSequence * toPixSeq = NULL;
        if (fromType.isEncapsulated())
        {
-         l_error = DcmCodecList::encode(fromType.getXfer(), fromParam, fromPixSeq,
-                   toType.getXfer(), toParam, toPixSeq, pixelStack);
+         // take the first step of the cheapest conversion path, unless that is decoding
+         E_TransferSyntax nextRepType = EXS_Unknown;
+         if (DcmCodecList::findCodingPath(fromType.getXfer(), toType.getXfer(), nextRepType) &&
+             (nextRepType != toType.getXfer()) && DcmXfer(nextRepType).isEncapsulated())
+         {
+           // convert to an intermediate representation and continue from there
+           if (DcmCodecList::canPassThrough(fromType.getXfer(), nextRepType))
+             l_error = DcmCodecList::passThrough(fromType.getXfer(), fromPixSeq, nextRepType, toPixSeq);
+           else
+             l_error = DcmCodecList::encode(fromType.getXfer(), fromParam, fromPixSeq,
+                       nextRepType, NULL, toPixSeq, pixelStack);
+           if (l_error.good())
+           {
+             insertRepresentationEntry(new DcmRepresentationEntry(nextRepType, NULL, toPixSeq));
+             l_error = encode(DcmXfer(nextRepType), NULL, toPixSeq, toType, toParam, pixelStack);
+             if (l_error.good()) return l_error;
+           } else delete toPixSeq;
+           toPixSeq = NULL;
+         }
+         else if (nextRepType == toType.getXfer())
+         {
+           if (DcmCodecList::canPassThrough(fromType.getXfer(), toType.getXfer()))
+             l_error = DcmCodecList::passThrough(fromType.getXfer(), fromPixSeq, toType.getXfer(), toPixSeq);
+           else
+             l_error = DcmCodecList::encode(fromType.getXfer(), fromParam, fromPixSeq,
+                       toType.getXfer(), toParam, toPixSeq, pixelStack);
+         }
        }
        else
        {
@@ -0,0 +1,74 @@
+/*
+ *
+ *  Copyright (C) 1994-2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmdata
+ *
+ *  Purpose: selection of the elements of a data set that are read
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcproj.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+
+
+DcmReadProjection::DcmReadProjection()
+: tags_()
+, lastGroup_(0xffff)
+{
+}
+
+
+void DcmReadProjection::addTag(const DcmTagKey &tag)
+{
+    /* keep the tags sorted, so lookups are binary searches */
+    OFVector<DcmTagKey>::iterator it = tags_.begin();
+    while ((it != tags_.end()) && (*it < tag))
+        ++it;
+    if ((it == tags_.end()) || (*it != tag))
+        tags_.insert(it, tag);
+}
+
+
+void DcmReadProjection::setLastGroup(const Uint16 group)
+{
+    lastGroup_ = group;
+}
+
+
+OFBool DcmReadProjection::isSelected(const DcmTagKey &tag) const
+{
+    if (tag.getGroup() > lastGroup_)
+        return OFFalse;
+    if (tags_.empty() || (tag == DCM_SpecificCharacterSet) || tag.isPrivateReservation())
+        return OFTrue;
+    size_t lower = 0;
+    size_t upper = tags_.size();
+    while (lower < upper)
+    {
+        const size_t middle = lower + (upper - lower) / 2;
+        if (tags_[middle] < tag)
+            lower = middle + 1;
+        else if (tag < tags_[middle])
+            upper = middle;
+        else
+            return OFTrue;
+    }
+    return OFFalse;
+}
+
+
+OFBool DcmReadProjection::isBehind(const DcmTagKey &tag) const
+{
+    return (tag.getGroup() > lastGroup_) || (!tags_.empty() && (tags_.back() < tag));
+}
@@ -32,6 +32,138 @@
 #include "dcmtk/dcmdata/dcvrpobw.h"  /* for class DcmPolymorphOBOW */
 #include "dcmtk/dcmdata/dcswap.h"    /* for swapIfNecessary() */
 #include "dcmtk/dcmdata/dcuid.h"     /* for dcmGenerateUniqueIdentifer()*/
+#include "dcmtk/dcmdata/dcfrmthr.h"  /* for class DcmFrameThreads */
+#include "dcmtk/ofstd/ofvector.h"    /* for class OFVector */
+
+/* SIMD kernels for interleaving the decompressed segments. SSE2 is part of
+ * every x86-64 CPU and NEON of every AArch64 CPU.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define DCMRLE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || (defined(__ARM_NEON) && defined(__GNUC__))
+#define DCMRLE_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* interleaves count planes of length bytes each, byte i of plane p is stored
+ * at dest[i * count + p]. Two planes are a 16 bit image, three or four planes
+ * an 8 bit color image or a 24 or 32 bit grayscale image.
+ */
+static void interleavePlanes(const Uint8 * const *planes, Uint32 count, size_t length, Uint8 *dest)
+{
+    size_t i = 0;
+    if (count == 1)
+    {
+        memcpy(dest, planes[0], length);
+    }
+    else if (count == 2)
+    {
+        const Uint8 *p0 = planes[0];
+        const Uint8 *p1 = planes[1];
+#ifdef DCMRLE_SSE2
+        for (; i + 16 <= length; i += 16)
+        {
+            const __m128i a = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, p0 + i));
+            const __m128i b = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, p1 + i));
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, dest + 2 * i), _mm_unpacklo_epi8(a, b));
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, dest + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+        }
+#endif
+#ifdef DCMRLE_NEON
+        for (; i + 16 <= length; i += 16)
+        {
+            uint8x16x2_t v;
+            v.val[0] = vld1q_u8(p0 + i);
+            v.val[1] = vld1q_u8(p1 + i);
+            vst2q_u8(dest + 2 * i, v);
+        }
+#endif
+        for (; i < length; ++i)
+        {
+            dest[2 * i] = p0[i];
+            dest[2 * i + 1] = p1[i];
+        }
+    }
+    else if (count == 3)
+    {
+        const Uint8 *p0 = planes[0];
+        const Uint8 *p1 = planes[1];
+        const Uint8 *p2 = planes[2];
+#ifdef DCMRLE_NEON
+        for (; i + 16 <= length; i += 16)
+        {
+            uint8x16x3_t v;
+            v.val[0] = vld1q_u8(p0 + i);
+            v.val[1] = vld1q_u8(p1 + i);
+            v.val[2] = vld1q_u8(p2 + i);
+            vst3q_u8(dest + 3 * i, v);
+        }
+#endif
+        for (; i < length; ++i)
+        {
+            dest[3 * i] = p0[i];
+            dest[3 * i + 1] = p1[i];
+            dest[3 * i + 2] = p2[i];
+        }
+    }
+    else if (count == 4)
+    {
+        const Uint8 *p0 = planes[0];
+        const Uint8 *p1 = planes[1];
+        const Uint8 *p2 = planes[2];
+        const Uint8 *p3 = planes[3];
+#ifdef DCMRLE_SSE2
+        for (; i + 16 <= length; i += 16)
+        {
+            const __m128i a = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, p0 + i));
+            const __m128i b = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, p1 + i));
+            const __m128i c = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, p2 + i));
+            const __m128i d = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, p3 + i));
+            const __m128i ab0 = _mm_unpacklo_epi8(a, b);
+            const __m128i ab1 = _mm_unpackhi_epi8(a, b);
+            const __m128i cd0 = _mm_unpacklo_epi8(c, d);
+            const __m128i cd1 = _mm_unpackhi_epi8(c, d);
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, dest + 4 * i), _mm_unpacklo_epi16(ab0, cd0));
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, dest + 4 * i + 16), _mm_unpackhi_epi16(ab0, cd0));
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, dest + 4 * i + 32), _mm_unpacklo_epi16(ab1, cd1));
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, dest + 4 * i + 48), _mm_unpackhi_epi16(ab1, cd1));
+        }
+#endif
+#ifdef DCMRLE_NEON
+        for (; i + 16 <= length; i += 16)
+        {
+            uint8x16x4_t v;
+            v.val[0] = vld1q_u8(p0 + i);
+            v.val[1] = vld1q_u8(p1 + i);
+            v.val[2] = vld1q_u8(p2 + i);
+            v.val[3] = vld1q_u8(p3 + i);
+            vst4q_u8(dest + 4 * i, v);
+        }
+#endif
+        for (; i < length; ++i)
+        {
+            dest[4 * i] = p0[i];
+            dest[4 * i + 1] = p1[i];
+            dest[4 * i + 2] = p2[i];
+            dest[4 * i + 3] = p3[i];
+        }
+    }
+    else
+    {
+        for (Uint32 p = 0; p < count; ++p)
+        {
+            const Uint8 *src = planes[p];
+            Uint8 *pixelPointer = dest + p;
+            for (i = 0; i < length; ++i)
+            {
+                *pixelPointer = src[i];
+                pixelPointer += count;
+            }
+        }
+    }
+}
 
 
 DcmRLECodecDecoder::DcmRLECodecDecoder()
@@ -45,6 +177,125 @@ DcmRLECodecDecoder::~DcmRLECodecDecoder()
 }
 
 
+class DcmRLECodecDecoder::SegmentTask: public DcmFrameDecodeTask
+{
+public:
+  SegmentTask(
+    const Uint8 *rleData,
+    const Uint32 *segmentStart,
+    const Uint32 *segmentEnd,
+    Uint8 *planes,
+    size_t bytesPerStripe,
+    Uint32 numberOfStripes,
+    Uint16 bytesAllocated,
+    Uint16 planarConfiguration)
+  : rleData_(rleData)
+  , segmentStart_(segmentStart)
+  , segmentEnd_(segmentEnd)
+  , planes_(planes)
+  , bytesPerStripe_(bytesPerStripe)
+  , numberOfStripes_(numberOfStripes)
+  , bytesAllocated_(bytesAllocated)
+  , planarConfiguration_(planarConfiguration)
+  {
+  }
+
+  virtual OFCondition decodeFrame(Uint32 stripeIndex) const
+  {
+    Uint8 *plane = planes_ + stripeIndex * bytesPerStripe_;
+    DcmRLEDecoder rledecoder(plane, bytesPerStripe_);
+    (void) rledecoder.decompress(OFconst_cast(Uint8 *, rleData_) + segmentStart_[stripeIndex],
+      OFstatic_cast(size_t, segmentEnd_[stripeIndex] - segmentStart_[stripeIndex]));
+
+    // a zero pad byte at the end of the RLE stream or trailing garbage data
+    // is ignored once the stripe is complete
+    const size_t decoderSize = rledecoder.size();
+    if (decoderSize == bytesPerStripe_) return EC_Normal;
+
+    // make sure the RLE decoder has produced the right amount of data
+    const OFBool lastStripeOfColor = (stripeIndex + 1 == numberOfStripes_) ||
+      ((planarConfiguration_ == 1) && ((stripeIndex + 1) % bytesAllocated_ == 0));
+    if (lastStripeOfColor && (decoderSize < bytesPerStripe_))
+    {
+      // stripe ended prematurely? report a warning and fill the remainder
+      // of the image with copies of the last decoded pixel
+      DCMDATA_WARN("RLE decoder is finished but has produced insufficient data for this stripe, filling remaining pixels");
+      memset(plane + decoderSize, (decoderSize > 0) ? plane[decoderSize - 1] : 0, bytesPerStripe_ - decoderSize);
+      return EC_Normal;
+    }
+    DCMDATA_ERROR("RLE decoder is finished but has produced insufficient data for this stripe");
+    return EC_CannotChangeRepresentation;
+  }
+
+private:
+  const Uint8 *rleData_;
+  const Uint32 *segmentStart_;
+  const Uint32 *segmentEnd_;
+  Uint8 *planes_;
+  size_t bytesPerStripe_;
+  Uint32 numberOfStripes_;
+  Uint16 bytesAllocated_;
+  Uint16 planarConfiguration_;
+};
+
+
+class DcmRLECodecDecoder::FrameTask: public DcmFrameDecodeTask
+{
+public:
+  FrameTask(
+    Uint8 *pixelData,
+    size_t frameSize,
+    Uint16 imageColumns,
+    Uint16 imageRows,
+    Uint16 imageSamplesPerPixel,
+    Uint16 imageBytesAllocated,
+    Uint16 imagePlanarConfiguration,
+    OFBool reverseByteOrder,
+    Uint16 segmentThreads)
+  : pixelData_(pixelData)
+  , frameSize_(frameSize)
+  , imageColumns_(imageColumns)
+  , imageRows_(imageRows)
+  , imageSamplesPerPixel_(imageSamplesPerPixel)
+  , imageBytesAllocated_(imageBytesAllocated)
+  , imagePlanarConfiguration_(imagePlanarConfiguration)
+  , reverseByteOrder_(reverseByteOrder)
+  , segmentThreads_(segmentThreads)
+  , fragments_()
+  , fragmentLengths_()
+  {
+  }
+
+  /// adds the compressed frame stored in the next fragment
+  void addFragment(Uint8 *fragmentData, Uint32 fragmentLength)
+  {
+    fragments_.push_back(fragmentData);
+    fragmentLengths_.push_back(fragmentLength);
+  }
+
+  virtual OFCondition decodeFrame(Uint32 frameNo) const
+  {
+    DCMDATA_DEBUG("RLE decoder processes frame " << frameNo);
+    return decodeSegments(fragments_[frameNo], fragmentLengths_[frameNo], pixelData_ + frameNo * frameSize_,
+      imageColumns_, imageRows_, imageSamplesPerPixel_, imageBytesAllocated_, imagePlanarConfiguration_,
+      reverseByteOrder_, segmentThreads_);
+  }
+
+private:
+  Uint8 *pixelData_;
+  size_t frameSize_;
+  Uint16 imageColumns_;
+  Uint16 imageRows_;
+  Uint16 imageSamplesPerPixel_;
+  Uint16 imageBytesAllocated_;
+  Uint16 imagePlanarConfiguration_;
+  OFBool reverseByteOrder_;
+  Uint16 segmentThreads_;
+  OFVector<Uint8 *> fragments_;
+  OFVector<Uint32> fragmentLengths_;
+};
+
+
 OFBool DcmRLECodecDecoder::canChangeCoding(
     const E_TransferSyntax oldRepType,
     const E_TransferSyntax newRepType) const
@@ -143,6 +394,27 @@ OFCondition DcmRLECodecDecoder::decode(
         {
           Uint8 *imageData8 = OFreinterpret_cast(Uint8 *, imageData16);
 
+          // frames stored in a single fragment each, the usual case, are decompressed
+          // independently. Frames are distributed over the threads if there are enough
+          // of them to keep all threads busy, otherwise the segments of each frame are.
+          if (OFstatic_cast(Sint32, pixSeq->card()) == imageFrames + 1)
+          {
+            const Uint16 numThreads = djcp->getNumThreads();
+            const OFBool frameParallel = (OFstatic_cast(Uint32, imageFrames) >= numThreads);
+            FrameTask task(imageData8, frameSize, imageColumns, imageRows, imageSamplesPerPixel, imageBytesAllocated,
+              imagePlanarConfiguration, enableReverseByteOrder, frameParallel ? 0 : numThreads);
+            for (Uint32 i = 1; (i <= OFstatic_cast(Uint32, imageFrames)) && result.good(); ++i)
+            {
+              result = pixSeq->getItem(pixItem, i);
+              if (result.good()) result = pixItem->getUint8Array(rleData);
+              if (result.good()) task.addFragment(rleData, pixItem->getLength());
+            }
+            if (result.good()) result = DcmFrameThreads::decodeFrames(task, OFstatic_cast(Uint32, imageFrames), frameParallel ? numThreads : 0);
+
+            // all frames are done, skip the fragment by fragment decompression below
+            currentFrame = imageFrames;
+          }
+
           while ((currentFrame < imageFrames) && result.good())
           {
             DCMDATA_DEBUG("RLE decoder processes frame " << currentFrame);
@@ -464,7 +736,6 @@ OFCondition DcmRLECodecDecoder::decodeFrame(
     Uint16 imageBitsAllocated = 0;
     Uint16 imageBytesAllocated = 0;
     Uint16 imagePlanarConfiguration = 0;
-    Uint32 rleHeader[16];
     OFString photometricInterpretation;
     DcmItem *ditem = OFstatic_cast(DcmItem *, dataset);
 
@@ -496,17 +767,12 @@ OFCondition DcmRLECodecDecoder::decodeFrame(
 
     DcmPixelItem *pixItem = NULL;
     Uint8 * rleData = NULL;
-    const size_t bytesPerStripe = OFstatic_cast(size_t, imageColumns) * OFstatic_cast(size_t, imageRows);
-    Uint32 numberOfStripes = 0;
     Uint32 fragmentLength = 0;
     Uint32 frameSize = OFstatic_cast(Uint32, imageBytesAllocated) * OFstatic_cast(Uint32, imageRows)
                        * OFstatic_cast(Uint32, imageColumns) * OFstatic_cast(Uint32, imageSamplesPerPixel);
 
     if (frameSize > bufSize) return EC_IllegalCall;
 
-    DcmRLEDecoder rledecoder(bytesPerStripe);
-    if (rledecoder.fail()) return EC_MemoryExhausted;  // RLE decoder failed to initialize
-
     DCMDATA_DEBUG("RLE decoder processes frame " << frameNo);
 
     // determine the corresponding item (first fragment) for this frame
@@ -532,168 +798,110 @@ OFCondition DcmRLECodecDecoder::decodeFrame(
     if (result.bad())
        return result;
 
-    // copy RLE header to buffer and adjust byte order
-    memcpy(rleHeader, rleData, 64);
-    swapIfNecessary(gLocalByteOrder, EBO_LittleEndian, rleHeader, OFstatic_cast(Uint32, 16*sizeof(Uint32)), sizeof(Uint32));
+    // decompress the segments of the frame, in parallel if requested
+    result = decodeSegments(rleData, fragmentLength, OFstatic_cast(Uint8 *, buffer), imageColumns, imageRows,
+      imageSamplesPerPixel, imageBytesAllocated, imagePlanarConfiguration, enableReverseByteOrder, djcp->getNumThreads());
 
-    // determine number of stripes.
-    numberOfStripes = rleHeader[0];
+    /* remove used fragment from memory */
+    pixItem->compact(); // there should only be one...
 
-    // check that number of stripes in RLE header matches our expectation
-    if ((numberOfStripes < 1) || (numberOfStripes > 15) || (numberOfStripes != OFstatic_cast(Uint32, imageBytesAllocated) * imageSamplesPerPixel))
+    if (result.good())
     {
-        DCMDATA_ERROR("Number of stripes in RLE header incorrect: found " << numberOfStripes << ", expected " << (OFstatic_cast(Uint32, imageBytesAllocated) * imageSamplesPerPixel));
-        return EC_CannotChangeRepresentation;
+      // compression was successful. Now update output parameters
+      startFragment = currentItem + 1;
+      decompressedColorModel = photometricInterpretation;
     }
 
-    // this variable keeps the current position within the current fragment
-    Uint32 byteOffset = 0;
+    // adjust byte order for uncompressed image to little endian
+    swapIfNecessary(EBO_LittleEndian, gLocalByteOrder, buffer, frameSize, sizeof(Uint16));
 
-    OFBool lastStripe = OFFalse;
-    OFBool lastStripeOfColor = OFFalse;
-    Uint32 inputBytes = 0;
+    return result;
+}
 
-    // pointers for buffer copy operations
-    Uint8 *outputBuffer = NULL;
-    Uint8 *pixelPointer = NULL;
-    Uint16 *imageData16 = OFreinterpret_cast(Uint16 *, buffer);
-    Uint8 *imageData8 = OFreinterpret_cast(Uint8 *, buffer);
 
-    // byte offset for first sample in frame
-    Uint32 sampleOffset = 0;
+OFCondition DcmRLECodecDecoder::decodeSegments(
+    const Uint8 *rleData,
+    Uint32 fragmentLength,
+    Uint8 *frame,
+    Uint16 columns,
+    Uint16 rows,
+    Uint16 samplesPerPixel,
+    Uint16 bytesAllocated,
+    Uint16 planarConfiguration,
+    OFBool reverseByteOrder,
+    Uint16 numThreads)
+{
+    // we require that the RLE header must be completely
+    // contained in the fragment; otherwise bail out
+    if ((rleData == NULL) || (fragmentLength < 64))
+    {
+        DCMDATA_ERROR("Pixel item shorter than 64 bytes, RLE header incomplete.");
+        return EC_CannotChangeRepresentation;
+    }
 
-    // byte offset between samples
-    Uint32 offsetBetweenSamples = 0;
+    // copy RLE header to buffer and adjust byte order
+    Uint32 rleHeader[16];
+    memcpy(rleHeader, rleData, 64);
+    swapIfNecessary(gLocalByteOrder, EBO_LittleEndian, rleHeader, OFstatic_cast(Uint32, 16*sizeof(Uint32)), sizeof(Uint32));
 
-    // temporary variables
-    Uint32 sample = 0;
-    Uint32 byte = 0;
-    Uint32 pixel = 0;
-    size_t bytesToDecode;
+    // check that number of stripes in RLE header matches our expectation
+    const Uint32 numberOfStripes = rleHeader[0];
+    if ((numberOfStripes < 1) || (numberOfStripes > 15) || (numberOfStripes != OFstatic_cast(Uint32, bytesAllocated) * samplesPerPixel))
+    {
+        DCMDATA_ERROR("Number of stripes in RLE header incorrect: found " << numberOfStripes << ", expected " << (OFstatic_cast(Uint32, bytesAllocated) * samplesPerPixel));
+        return EC_CannotChangeRepresentation;
+    }
 
-    // for each stripe in stripe set
+    // determine the compressed bytes of each stripe. The last stripe
+    // extends to the end of the fragment, including the pad byte.
+    Uint32 segmentStart[15];
+    Uint32 segmentEnd[15];
     for (Uint32 stripeIndex = 0; stripeIndex < numberOfStripes; ++stripeIndex)
     {
-        // reset RLE codec
-        rledecoder.clear();
-
-        // adjust start point for RLE stripe
-        byteOffset = rleHeader[stripeIndex + 1];
-
-        // byteOffset now points to the first byte of the new RLE stripe
-        // check if the current stripe is the last one for this frame
-        if (stripeIndex + 1 == numberOfStripes) lastStripe = OFTrue; else lastStripe = OFFalse;
-
-        if (lastStripe)
-        {
-            // the last stripe needs special handling because we cannot use the
-            // offset table to determine the number of bytes to feed to the codec
-            // if the RLE data is split in multiple fragments. We need to feed
-            // data fragment by fragment until the RLE codec has produced
-            // sufficient output.
-            bytesToDecode = OFstatic_cast(size_t, fragmentLength - byteOffset);
-        }
-        else
-        {
-            // not the last stripe. We can use the offset table to determine
-            // the number of bytes to feed to the RLE codec.
-            inputBytes = rleHeader[stripeIndex+2];
-            if (inputBytes < rleHeader[stripeIndex + 1])
-            {
-              DCMDATA_ERROR("Byte offset in RLE header is wrong.");
-              return EC_CannotChangeRepresentation;
-            }
-
-            inputBytes -= rleHeader[stripeIndex + 1]; // number of bytes to feed to codec
-
-            bytesToDecode = OFstatic_cast(size_t, inputBytes);
-        }
-
-        // last fragment for this RLE stripe
-        result = rledecoder.decompress(rleData + byteOffset, bytesToDecode);
-
-        // special handling for zero pad byte at the end of the RLE stream
-        // which results in an EC_StreamNotifyClient return code
-        // or trailing garbage data which results in EC_CorruptedData
-        if (rledecoder.size() == bytesPerStripe) result = EC_Normal;
-
-        byteOffset += inputBytes;
-
-        // copy the decoded stuff over to the buffer here...
-        // make sure the RLE decoder has produced the right amount of data
-        lastStripeOfColor = lastStripe || ((imagePlanarConfiguration == 1) && ((stripeIndex + 1) % imageBytesAllocated == 0));
-        if (lastStripeOfColor && (rledecoder.size() < bytesPerStripe))
-        {
-            // stripe ended prematurely? report a warning and continue
-            DCMDATA_WARN("RLE decoder is finished but has produced insufficient data for this stripe, filling remaining pixels");
-            result = EC_Normal;
-        }
-        else if (rledecoder.size() != bytesPerStripe)
+        segmentStart[stripeIndex] = rleHeader[stripeIndex + 1];
+        segmentEnd[stripeIndex] = (stripeIndex + 1 < numberOfStripes) ? rleHeader[stripeIndex + 2] : fragmentLength;
+        if ((segmentStart[stripeIndex] > segmentEnd[stripeIndex]) || (segmentEnd[stripeIndex] > fragmentLength))
         {
-            DCMDATA_ERROR("RLE decoder is finished but has produced insufficient data for this stripe");
+            DCMDATA_ERROR("Byte offset in RLE header is wrong.");
             return EC_CannotChangeRepresentation;
         }
+    }
 
-        // distribute decompressed bytes into output image array
-        // which sample and byte are we currently decompressing?
-        sample = stripeIndex / imageBytesAllocated;
-        byte = stripeIndex % imageBytesAllocated;
-
-        // raw buffer containing bytesPerStripe bytes of uncompressed data
-        outputBuffer = OFstatic_cast(Uint8 *, rledecoder.getOutputBuffer());
-
-        // compute byte offsets
-        if (imagePlanarConfiguration == 0)
-        {
-            sampleOffset = sample * imageBytesAllocated;
-            offsetBetweenSamples = imageSamplesPerPixel * imageBytesAllocated;
-        }
-        else
-        {
-            sampleOffset = sample * imageBytesAllocated * imageColumns * imageRows;
-            offsetBetweenSamples = imageBytesAllocated;
-        }
-
-        // initialize pointer to output data
-        if (enableReverseByteOrder)
-        {
-            // assume incorrect LSB to MSB order of RLE segments as produced by some tools
-            pixelPointer = imageData8 + sampleOffset + byte;
-        }
-        else
-        {
-            pixelPointer = imageData8 + sampleOffset + imageBytesAllocated - byte - 1;
-        }
-
-        // copy the pixel data that was decoded
-        const size_t decoderSize = rledecoder.size();
-        for (pixel = 0; pixel < decoderSize; ++pixel)
-        {
-            *pixelPointer = *outputBuffer++;
-            pixelPointer += offsetBetweenSamples;
-        }
-        // and fill the remainder of the image with copies of the last decoded pixel
-        const Uint8 lastPixelValue = *(outputBuffer - 1);
-        for (pixel = OFstatic_cast(Uint32, decoderSize); pixel < bytesPerStripe; ++pixel)
-        {
-            *pixelPointer = lastPixelValue;
-            pixelPointer += offsetBetweenSamples;
-        }
+    // the stripes of 8 bit images without color-by-pixel interleaving
+    // are contiguous in the frame and decompressed in place
+    const size_t bytesPerStripe = OFstatic_cast(size_t, columns) * OFstatic_cast(size_t, rows);
+    const OFBool inPlace = (bytesAllocated == 1) && ((samplesPerPixel == 1) || (planarConfiguration == 1));
+    Uint8 *planes = frame;
+    if (!inPlace)
+    {
+        planes = new Uint8[numberOfStripes * bytesPerStripe];
+        if (planes == NULL) return EC_MemoryExhausted;
     }
 
-    /* remove used fragment from memory */
-    pixItem->compact(); // there should only be one...
+    SegmentTask task(rleData, segmentStart, segmentEnd, planes, bytesPerStripe, numberOfStripes, bytesAllocated, planarConfiguration);
+    OFCondition result = DcmFrameThreads::decodeFrames(task, numberOfStripes, numThreads);
 
-    if (result.good())
+    // distribute decompressed bytes into output image array. The stripes of
+    // a sample are stored from MSB to LSB, unless the byte order is reversed.
+    if (result.good() && !inPlace)
     {
-      // compression was successful. Now update output parameters
-      startFragment = currentItem + 1;
-      decompressedColorModel = photometricInterpretation;
+        const Uint8 *sources[15];
+        const Uint32 samplesPerGroup = (planarConfiguration == 0) ? samplesPerPixel : 1;
+        const Uint32 stripesPerGroup = samplesPerGroup * bytesAllocated;
+        for (Uint32 group = 0; group < numberOfStripes / stripesPerGroup; ++group)
+        {
+            for (Uint32 position = 0; position < stripesPerGroup; ++position)
+            {
+                const Uint32 byte = position % bytesAllocated;
+                const Uint32 stripeIndex = group * stripesPerGroup + position - byte +
+                  (reverseByteOrder ? byte : bytesAllocated - byte - 1);
+                sources[position] = planes + stripeIndex * bytesPerStripe;
+            }
+            interleavePlanes(sources, stripesPerGroup, bytesPerStripe, frame + group * stripesPerGroup * bytesPerStripe);
+        }
     }
 
-    // adjust byte order for uncompressed image to little endian
-    swapIfNecessary(EBO_LittleEndian, gLocalByteOrder, imageData16, frameSize, sizeof(Uint16));
-
+    if (!inPlace) delete[] planes;
     return result;
 }
 
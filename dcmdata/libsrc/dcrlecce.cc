@@ -22,7 +22,6 @@
 #include "dcmtk/config/osconfig.h"
 #include "dcmtk/dcmdata/dcrlecce.h"
 
-#include "dcmtk/dcmdata/dcrleenc.h"  /* for class DcmRLEEncoder */
 #include "dcmtk/dcmdata/dcrlecp.h"   /* for class DcmRLECodecParameter */
 #include "dcmtk/dcmdata/dcdeftag.h"  /* for tag constants */
 #include "dcmtk/dcmdata/dcpixseq.h"  /* for class DcmPixelSequence */
@@ -30,13 +29,224 @@
 #include "dcmtk/dcmdata/dcswap.h"    /* for swapIfNecessary */
 #include "dcmtk/dcmdata/dcitem.h"
 #include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcfrmthr.h"  /* for class DcmFrameThreads */
 
 #define INCLUDE_CSTDIO
+#define INCLUDE_CSTRING
 #include "dcmtk/ofstd/ofstdinc.h"
 
+/* SIMD kernels for gathering the segments and finding replicate runs.
+ * SSE2 is part of every x86-64 CPU and NEON of every AArch64 CPU.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define DCMRLE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || (defined(__ARM_NEON) && defined(__GNUC__))
+#define DCMRLE_NEON
+#include <arm_neon.h>
+#endif
+
+
+/* splits length groups of count interleaved bytes into count planes,
+ * src[i * count + p] is stored at planes[p][i]
+ */
+static void splitPlanes(const Uint8 *src, Uint32 count, size_t length, Uint8 * const *planes)
+{
+    size_t i = 0;
+    if (count == 2)
+    {
+        Uint8 *p0 = planes[0];
+        Uint8 *p1 = planes[1];
+#ifdef DCMRLE_SSE2
+        const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+        for (; i + 16 <= length; i += 16)
+        {
+            const __m128i a = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, src + 2 * i));
+            const __m128i b = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, src + 2 * i + 16));
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, p0 + i),
+                _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes)));
+            _mm_storeu_si128(OFreinterpret_cast(__m128i *, p1 + i),
+                _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+        }
+#endif
+#ifdef DCMRLE_NEON
+        for (; i + 16 <= length; i += 16)
+        {
+            const uint8x16x2_t v = vld2q_u8(src + 2 * i);
+            vst1q_u8(p0 + i, v.val[0]);
+            vst1q_u8(p1 + i, v.val[1]);
+        }
+#endif
+        for (; i < length; ++i)
+        {
+            p0[i] = src[2 * i];
+            p1[i] = src[2 * i + 1];
+        }
+    }
+    else if (count == 3)
+    {
+        Uint8 *p0 = planes[0];
+        Uint8 *p1 = planes[1];
+        Uint8 *p2 = planes[2];
+#ifdef DCMRLE_NEON
+        for (; i + 16 <= length; i += 16)
+        {
+            const uint8x16x3_t v = vld3q_u8(src + 3 * i);
+            vst1q_u8(p0 + i, v.val[0]);
+            vst1q_u8(p1 + i, v.val[1]);
+            vst1q_u8(p2 + i, v.val[2]);
+        }
+#endif
+        for (; i < length; ++i)
+        {
+            p0[i] = src[3 * i];
+            p1[i] = src[3 * i + 1];
+            p2[i] = src[3 * i + 2];
+        }
+    }
+    else
+    {
+        for (Uint32 p = 0; p < count; ++p)
+        {
+            const Uint8 *pixelPointer = src + p;
+            Uint8 *dest = planes[p];
+            for (i = 0; i < length; ++i)
+            {
+                dest[i] = *pixelPointer;
+                pixelPointer += count;
+            }
+        }
+    }
+}
+
+
+/* returns the number of bytes at the start of src that are equal
+ * to the first one, at least 1 and at most length
+ */
+static size_t replicateLength(const Uint8 *src, size_t length)
+{
+    const Uint8 value = src[0];
+    size_t i = 1;
+    if ((length > 16) && (src[1] == value))
+    {
+#ifdef DCMRLE_SSE2
+        const __m128i v = _mm_set1_epi8(OFstatic_cast(char, value));
+        while ((i + 16 <= length) &&
+               (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(OFreinterpret_cast(const __m128i *, src + i)), v)) == 0xffff))
+            i += 16;
+#endif
+#ifdef DCMRLE_NEON
+        const uint8x16_t v = vdupq_n_u8(value);
+        while (i + 16 <= length)
+        {
+            const uint64x2_t equal = vreinterpretq_u64_u8(vceqq_u8(vld1q_u8(src + i), v));
+            if ((vgetq_lane_u64(equal, 0) & vgetq_lane_u64(equal, 1)) != ~OFstatic_cast(Uint64, 0)) break;
+            i += 16;
+        }
+#endif
+    }
+    while ((i < length) && (src[i] == value)) ++i;
+    return i;
+}
 
-typedef OFList<DcmRLEEncoder *> DcmRLEEncoderList;
-typedef OFListIterator(DcmRLEEncoder *) DcmRLEEncoderListIterator;
+
+/* returns the position of the first run of three or more equal bytes
+ * in src[start, length), or length if there is none
+ */
+static size_t findReplicateRun(const Uint8 *src, size_t start, size_t length)
+{
+    size_t i = start;
+#ifdef DCMRLE_SSE2
+    for (; i + 18 <= length; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, src + i));
+        const __m128i b = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, src + i + 1));
+        const __m128i c = _mm_loadu_si128(OFreinterpret_cast(const __m128i *, src + i + 2));
+        if (_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(b, c))) != 0) break;
+    }
+#endif
+#ifdef DCMRLE_NEON
+    for (; i + 18 <= length; i += 16)
+    {
+        const uint8x16_t a = vld1q_u8(src + i);
+        const uint8x16_t b = vld1q_u8(src + i + 1);
+        const uint8x16_t c = vld1q_u8(src + i + 2);
+        const uint64x2_t equal = vreinterpretq_u64_u8(vandq_u8(vceqq_u8(a, b), vceqq_u8(b, c)));
+        if ((vgetq_lane_u64(equal, 0) | vgetq_lane_u64(equal, 1)) != 0) break;
+    }
+#endif
+    // the exact position is found byte by byte within the last block
+    for (; i + 2 < length; ++i)
+    {
+        if ((src[i] == src[i + 1]) && (src[i] == src[i + 2])) return i;
+    }
+    return length;
+}
+
+
+/* writes a literal run of at most 128 bytes, returns the new output position */
+static Uint8 *writeLiteralRun(const Uint8 *src, size_t length, Uint8 *dest)
+{
+    if (length > 0)
+    {
+        *dest++ = OFstatic_cast(Uint8, length - 1);
+        memcpy(dest, src, length);
+        dest += length;
+    }
+    return dest;
+}
+
+
+/* compresses one row with the PackBits scheme of DICOM part 5 section G.3.1,
+ * giving the same output as DcmRLEEncoder::add() followed by flush().
+ * Runs of three or more equal bytes, or two at the end of the row, become
+ * replicate runs, all other bytes are collected in literal runs. dest must
+ * have room for length + length / 128 + 2 bytes. Returns the number of bytes
+ * written.
+ */
+static size_t encodeRow(const Uint8 *src, size_t length, Uint8 *dest)
+{
+    Uint8 *out = dest;
+    size_t literalStart = 0;
+    size_t literalLength = 0;
+    size_t i = 0;
+    while (i < length)
+    {
+        // all bytes up to the next replicate run belong to the literal run,
+        // which is flushed in pieces of 128 bytes once it exceeds 128 bytes
+        size_t next = findReplicateRun(src, i, length);
+        if ((next == length) && (length - i >= 2) && (src[length - 2] == src[length - 1])) next = length - 2;
+        if (next > i)
+        {
+            if (literalLength == 0) literalStart = i;
+            literalLength += next - i;
+            while (literalLength > 128)
+            {
+                out = writeLiteralRun(src + literalStart, 128, out);
+                literalStart += 128;
+                literalLength -= 128;
+            }
+            i = next;
+        }
+        if (i < length)
+        {
+            // flush the pending literal run, then write as many replicate runs as necessary.
+            // DICOM uses 257 - count for replicate runs, a remainder of one byte is thus
+            // written as literal run of one byte.
+            const size_t run = replicateLength(src + i, length - i);
+            out = writeLiteralRun(src + literalStart, literalLength, out);
+            literalLength = 0;
+            for (size_t remaining = run; remaining > 0; remaining = (remaining > 128) ? remaining - 128 : 0)
+            {
+                *out++ = OFstatic_cast(Uint8, (remaining > 128) ? 0x81 : 257 - remaining);
+                *out++ = src[i];
+            }
+            i += run;
+        }
+    }
+    out = writeLiteralRun(src + literalStart, literalLength, out);
+    return OFstatic_cast(size_t, out - dest);
+}
 
 
 // =======================================================================
@@ -52,6 +262,96 @@ DcmRLECodecEncoder::~DcmRLECodecEncoder()
 }
 
 
+// DcmFrameThreads::decodeFrames() only distributes indices over the threads,
+// here it is used for the segments of a frame
+class DcmRLECodecEncoder::SegmentTask: public DcmFrameDecodeTask
+{
+public:
+  SegmentTask(
+    const Uint8 * const *planes,
+    Uint16 columns,
+    Uint16 rows,
+    Uint8 *segments,
+    size_t maxSegmentSize,
+    size_t *segmentSizes)
+  : planes_(planes)
+  , columns_(columns)
+  , rows_(rows)
+  , segments_(segments)
+  , maxSegmentSize_(maxSegmentSize)
+  , segmentSizes_(segmentSizes)
+  {
+  }
+
+  virtual OFCondition decodeFrame(Uint32 stripeIndex) const
+  {
+    const Uint8 *plane = planes_[stripeIndex];
+    Uint8 *segment = segments_ + stripeIndex * maxSegmentSize_;
+    size_t size = 0;
+
+    // enforce DICOM rule that "Each row of the image shall be encoded
+    // separately and not cross a row boundary."
+    // (see DICOM part 5 section G.3.1)
+    for (Uint16 row = 0; row < rows_; ++row)
+      size += encodeRow(plane + OFstatic_cast(size_t, row) * columns_, columns_, segment + size);
+
+    // pad to even number of bytes
+    if (size & 1) segment[size++] = 0;
+    segmentSizes_[stripeIndex] = size;
+    return EC_Normal;
+  }
+
+private:
+  const Uint8 * const *planes_;
+  Uint16 columns_;
+  Uint16 rows_;
+  Uint8 *segments_;
+  size_t maxSegmentSize_;
+  size_t *segmentSizes_;
+};
+
+
+class DcmRLECodecEncoder::FrameTask: public DcmFrameEncodeTask
+{
+public:
+  FrameTask(
+    const Uint8 *pixelData,
+    size_t frameSize,
+    Uint16 columns,
+    Uint16 rows,
+    Uint16 samplesPerPixel,
+    Uint16 bytesAllocated,
+    Uint16 planarConfiguration,
+    Uint16 segmentThreads)
+  : pixelData_(pixelData)
+  , frameSize_(frameSize)
+  , columns_(columns)
+  , rows_(rows)
+  , samplesPerPixel_(samplesPerPixel)
+  , bytesAllocated_(bytesAllocated)
+  , planarConfiguration_(planarConfiguration)
+  , segmentThreads_(segmentThreads)
+  {
+  }
+
+  virtual OFCondition encodeFrame(Uint32 frameNo, Uint8 *&compressedData, Uint32 &compressedLen) const
+  {
+    return encodeSegments(pixelData_ + frameNo * frameSize_, columns_, rows_, samplesPerPixel_,
+      bytesAllocated_, planarConfiguration_, segmentThreads_, compressedData, compressedLen);
+  }
+
+private:
+  const Uint8 *pixelData_;
+  size_t frameSize_;
+  Uint16 columns_;
+  Uint16 rows_;
+  Uint16 samplesPerPixel_;
+  Uint16 bytesAllocated_;
+  Uint16 planarConfiguration_;
+  Uint16 segmentThreads_;
+};
+
+
 OFBool DcmRLECodecEncoder::canChangeCoding(
     const E_TransferSyntax oldRepType,
     const E_TransferSyntax newRepType) const
@@ -123,14 +423,8 @@ OFCondition DcmRLECodecEncoder::encode(
   DcmStack localStack(objStack);
   (void)localStack.pop();             // pop pixel data element from stack
   DcmObject *dataset = localStack.pop(); // this is the item in which the pixel data is located
-  Uint8 *pixelData8 = OFreinterpret_cast(Uint8 *, OFconst_cast(Uint16 *, pixelData));
-  Uint8 *pixelPointer = NULL;
+  const Uint8 *pixelData8 = OFreinterpret_cast(const Uint8 *, pixelData);
   DcmOffsetList offsetList;
-  DcmRLEEncoderList rleEncoderList;
-  DcmRLEEncoderListIterator first = rleEncoderList.begin();
-  DcmRLEEncoderListIterator last = rleEncoderList.end();
-  Uint32 rleHeader[16];
-  Uint32 i;
   OFBool byteSwapped = OFFalse;  // true if we have byte-swapped the original pixel data
 
   if ((!dataset)||((dataset->ident()!= EVR_dataset) && (dataset->ident()!= EVR_item))) result = EC_InvalidTag;
@@ -145,7 +439,7 @@ OFCondition DcmRLECodecEncoder::encode(
     Uint16 rows = 0;
     Sint32 numberOfFrames = 1;
     Uint32 numberOfStripes = 0;
-    Uint32 compressedSize = 0;
+    size_t compressedSize = 0;
 
     result = ditem->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
     if (result.good()) result = ditem->findAndGetUint16(DCM_SamplesPerPixel, samplesPerPixel);
@@ -205,137 +499,20 @@ OFCondition DcmRLECodecEncoder::encode(
     // create RLE stripe sets
     if (result.good())
     {
-      const Uint32 bytesPerStripe = columns * rows;
-      const Uint32 frameSize = columns * rows * samplesPerPixel * bytesAllocated;
-      Uint32 frameOffset = 0;
-      Uint32 sampleOffset = 0;
-      Uint32 offsetBetweenSamples = 0;
-      Uint32 sample = 0;
-      Uint32 byte = 0;
-      Uint32 pixel = 0;
-      Uint32 columnCounter = 0;
-
-      DcmRLEEncoder *rleEncoder = NULL;
-      Uint32 rleSize = 0;
-      Uint8 *rleData = NULL;
-      Uint8 *rleData2 = NULL;
+      const size_t frameSize = OFstatic_cast(size_t, columns) * rows * samplesPerPixel * bytesAllocated;
 
       // warn about (possibly) non-standard fragmentation
       if (djcp->getFragmentSize() > 0)
          DCMDATA_WARN("DcmRLECodecEncoder: limiting the fragment size may result in non-standard conformant encoding");
 
-      // compute byte offset between samples
-      if (planarConfiguration == 0)
-         offsetBetweenSamples = samplesPerPixel * bytesAllocated;
-         else offsetBetweenSamples = bytesAllocated;
-
-      // loop through all frames of the image
-      for (Uint32 currentFrame = 0; ((currentFrame < OFstatic_cast(Uint32, numberOfFrames)) && result.good()); currentFrame++)
-      {
-        // offset to start of frame, in bytes
-        frameOffset = frameSize * currentFrame;
-
-        // loop through all samples of one frame
-        for (sample = 0; sample < samplesPerPixel; sample++)
-        {
-          // compute byte offset for first sample in frame
-          if (planarConfiguration == 0)
-             sampleOffset = sample * bytesAllocated;
-             else sampleOffset = sample * bytesAllocated * columns * rows;
-
-          // loop through the bytes of one sample
-          for (byte = 0; byte < bytesAllocated; byte++)
-          {
-            pixelPointer = pixelData8 + frameOffset + sampleOffset + bytesAllocated - byte - 1;
-
-            // initialize new RLE codec for this stripe
-            rleEncoder = new DcmRLEEncoder(1 /* DICOM padding required */);
-            if (rleEncoder)
-            {
-              rleEncoderList.push_back(rleEncoder);
-              columnCounter = columns;
-
-              // loop through all pixels of the frame
-              for (pixel = 0; pixel < bytesPerStripe; ++pixel)
-              {
-                rleEncoder->add(*pixelPointer);
-
-                // enforce DICOM rule that "Each row of the image shall be encoded
-                // separately and not cross a row boundary."
-                // (see DICOM part 5 section G.3.1)
-                if (--columnCounter == 0)
-                {
-                  rleEncoder->flush();
-                  columnCounter = columns;
-                }
-                pixelPointer += offsetBetweenSamples;
-              }
-
-              rleEncoder->flush();
-              if (rleEncoder->fail()) result = EC_MemoryExhausted;
-            } else result = EC_MemoryExhausted;
-          }
-        }
-
-        // store frame and erase RLE codec list
-        if (result.good() && (rleEncoderList.size() > 0) && (rleEncoderList.size() < 16))
-        {
-          // compute size of compressed frame including RLE header
-          // and populate RLE header
-          for (i=0; i<16; i++) rleHeader[i] = 0;
-          rleHeader[0] = OFstatic_cast(Uint32, rleEncoderList.size());
-          rleSize = 64;
-          i = 1;
-          first = rleEncoderList.begin();
-          while (first != last)
-          {
-            rleHeader[i++] = rleSize;
-            rleSize += OFstatic_cast(Uint32, (*first)->size());
-            ++first;
-          }
-
-          // allocate buffer for compressed frame
-          rleData = new Uint8[rleSize];
-
-          if (rleData)
-          {
-            // copy RLE header to compressed frame buffer
-            swapIfNecessary(EBO_LittleEndian, gLocalByteOrder, rleHeader, OFstatic_cast(Uint32, 16*sizeof(Uint32)), sizeof(Uint32));
-            memcpy(rleData, rleHeader, 64);
-
-            // store RLE stripe sets in compressed frame buffer
-            rleData2 = rleData + 64;
-            first = rleEncoderList.begin();
-            while (first != last)
-            {
-              (*first)->write(rleData2);
-              rleData2 += (*first)->size();
-              delete *first;
-              first = rleEncoderList.erase(first);
-            }
-
-            // store compressed frame, breaking into segments if necessary
-            result = pixelSequence->storeCompressedFrame(offsetList, rleData, rleSize, djcp->getFragmentSize());
-            compressedSize += rleSize;
-
-            // erase buffer for compressed frame
-            delete[] rleData;
-          } else result = EC_MemoryExhausted;
-        }
-        else
-        {
-          // erase RLE codec list
-          first = rleEncoderList.begin();
-          while (first != last)
-          {
-            delete *first;
-            first = rleEncoderList.erase(first);
-          }
-          if (result.good()) result = EC_CannotChangeRepresentation;
-        }
-
-      }
-
+      // frames are independent and distributed over the threads if there are enough
+      // of them to keep all threads busy, otherwise the segments of each frame are
+      const Uint16 numThreads = djcp->getNumThreads();
+      const OFBool frameParallel = (OFstatic_cast(Uint32, numberOfFrames) >= numThreads);
+      FrameTask task(pixelData8, frameSize, columns, rows, samplesPerPixel, bytesAllocated, planarConfiguration,
+        frameParallel ? 0 : numThreads);
+      result = DcmFrameThreads::encodeFrames(task, OFstatic_cast(Uint32, numberOfFrames), frameParallel ? numThreads : 0,
+        pixelSequence, offsetList, djcp->getFragmentSize(), compressedSize);
     }
 
     // store pixel sequence if everything went well.
@@ -346,10 +523,10 @@ OFCondition DcmRLECodecEncoder::encode(
       pixSeq = NULL;
     }
 
-    if ((result.good()) && (djcp->getCreateOffsetTable()))
+    if (result.good())
     {
       // create offset table
-      result = offsetTable->createOffsetTable(offsetList);
+      result = createOffsetTables(ditem, pixSeq, offsetList, djcp->getCreateOffsetTable());
     }
 
     // the following operations do not affect the Image Pixel Module
@@ -395,6 +572,91 @@ OFCondition DcmRLECodecEncoder::encode(
 }
 
 
+OFCondition DcmRLECodecEncoder::encodeSegments(
+    const Uint8 *frame,
+    Uint16 columns,
+    Uint16 rows,
+    Uint16 samplesPerPixel,
+    Uint16 bytesAllocated,
+    Uint16 planarConfiguration,
+    Uint16 numThreads,
+    Uint8 *&compressedData,
+    Uint32 &compressedLen)
+{
+  const size_t bytesPerStripe = OFstatic_cast(size_t, columns) * rows;
+  const Uint32 numberOfStripes = OFstatic_cast(Uint32, bytesAllocated) * samplesPerPixel;
+
+  // worst case size of a compressed segment, see encodeRow()
+  const size_t maxSegmentSize = OFstatic_cast(size_t, rows) * (columns + columns / 128 + 2) + 1;
+
+  // the stripes of 8 bit images without color-by-pixel interleaving are
+  // contiguous in the frame, all others are gathered into planes. Stripes
+  // are stored from MSB to LSB of each sample.
+  const Uint8 *planes[15];
+  Uint8 *planeBuffer = NULL;
+  Uint32 stripeIndex = 0;
+  if ((bytesAllocated == 1) && ((samplesPerPixel == 1) || (planarConfiguration == 1)))
+  {
+    for (stripeIndex = 0; stripeIndex < numberOfStripes; ++stripeIndex)
+      planes[stripeIndex] = frame + stripeIndex * bytesPerStripe;
+  }
+  else
+  {
+    planeBuffer = new Uint8[numberOfStripes * bytesPerStripe];
+    if (planeBuffer == NULL) return EC_MemoryExhausted;
+    Uint8 *targets[15];
+    const Uint32 stripesPerGroup = ((planarConfiguration == 0) ? samplesPerPixel : 1) * OFstatic_cast(Uint32, bytesAllocated);
+    for (Uint32 group = 0; group < numberOfStripes / stripesPerGroup; ++group)
+    {
+      for (Uint32 position = 0; position < stripesPerGroup; ++position)
+      {
+        const Uint32 byte = position % bytesAllocated;
+        stripeIndex = group * stripesPerGroup + position - byte + bytesAllocated - byte - 1;
+        targets[position] = planeBuffer + stripeIndex * bytesPerStripe;
+        planes[stripeIndex] = targets[position];
+      }
+      splitPlanes(frame + group * stripesPerGroup * bytesPerStripe, stripesPerGroup, bytesPerStripe, targets);
+    }
+  }
+
+  // compress the segments into slots of the worst case size behind the RLE header
+  Uint8 *rleData = new Uint8[64 + numberOfStripes * maxSegmentSize];
+  if (rleData == NULL)
+  {
+    delete[] planeBuffer;
+    return EC_MemoryExhausted;
+  }
+  size_t segmentSizes[15];
+  SegmentTask task(planes, columns, rows, rleData + 64, maxSegmentSize, segmentSizes);
+  OFCondition result = DcmFrameThreads::decodeFrames(task, numberOfStripes, numThreads);
+  delete[] planeBuffer;
+
+  if (result.good())
+  {
+    // move the segments behind each other and populate the RLE header
+    Uint32 rleHeader[16];
+    for (stripeIndex = 0; stripeIndex < 16; ++stripeIndex) rleHeader[stripeIndex] = 0;
+    rleHeader[0] = numberOfStripes;
+    size_t rleSize = 64;
+    for (stripeIndex = 0; stripeIndex < numberOfStripes; ++stripeIndex)
+    {
+      rleHeader[stripeIndex + 1] = OFstatic_cast(Uint32, rleSize);
+      memmove(rleData + rleSize, rleData + 64 + stripeIndex * maxSegmentSize, segmentSizes[stripeIndex]);
+      rleSize += segmentSizes[stripeIndex];
+    }
+
+    // copy RLE header to compressed frame buffer
+    swapIfNecessary(EBO_LittleEndian, gLocalByteOrder, rleHeader, OFstatic_cast(Uint32, 16*sizeof(Uint32)), sizeof(Uint32));
+    memcpy(rleData, rleHeader, 64);
+    compressedData = rleData;
+    compressedLen = OFstatic_cast(Uint32, rleSize);
+  }
+  else delete[] rleData;
+
+  return result;
+}
+
+
 OFCondition DcmRLECodecEncoder::updateDerivationDescription(
   DcmItem *dataset,
   double ratio)
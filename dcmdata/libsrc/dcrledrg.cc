@@ -51,6 +51,11 @@ void DcmRLEDecoderRegistration::registerCodecs(
   }
 }
 
+void DcmRLEDecoderRegistration::setNumThreads(Uint16 numThreads)
+{
+  if (registered && cp) cp->setNumThreads(numThreads);
+}
+
 void DcmRLEDecoderRegistration::cleanup()
 {
   if (registered)
@@ -54,6 +54,11 @@ void DcmRLEEncoderRegistration::registerCodecs(
   }
 }
 
+void DcmRLEEncoderRegistration::setNumThreads(Uint16 numThreads)
+{
+  if (registered && cp) cp->setNumThreads(numThreads);
+}
+
 void DcmRLEEncoderRegistration::cleanup()
 {
   if (registered)
@@ -22,6 +22,121 @@
 #include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
 #include "dcmtk/dcmdata/dcswap.h"
 
+/* SIMD kernels for swapping whole frames of 2, 4 and 8 byte values. SSE2 is
+ * part of every x86-64 CPU and NEON of every AArch64 CPU, AVX2 is detected
+ * at runtime where the compiler supports function specific targets.
+ */
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define DCMSWAP_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#define DCMSWAP_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || (defined(__ARM_NEON) && defined(__GNUC__))
+#define DCMSWAP_NEON
+#include <arm_neon.h>
+#endif
+
+
+#ifdef DCMSWAP_AVX2
+
+/* swaps 32 bytes at a time, returns the number of bytes swapped */
+__attribute__((target("avx2")))
+static size_t swapBytesAVX2(Uint8 *value, const size_t byteLength, const size_t valWidth)
+{
+    __m256i mask;
+    if (valWidth == 2)
+        mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    else if (valWidth == 4)
+        mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    else
+        mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const size_t blocks = byteLength / 32;
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        __m256i *p = OFreinterpret_cast(__m256i *, value + i * 32);
+        _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+    }
+    return blocks * 32;
+}
+
+#endif
+
+
+#ifdef DCMSWAP_SSE2
+
+/* swaps 16 bytes at a time, returns the number of bytes swapped */
+static size_t swapBytesSSE2(Uint8 *value, const size_t byteLength, const size_t valWidth)
+{
+    const size_t blocks = byteLength / 16;
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        __m128i *p = OFreinterpret_cast(__m128i *, value + i * 16);
+        __m128i v = _mm_loadu_si128(p);
+        /* reverse the order of the 16 bit words within each value, then swap the bytes of each word */
+        if (valWidth == 4)
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        else if (valWidth == 8)
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(p, v);
+    }
+    return blocks * 16;
+}
+
+#endif
+
+
+#ifdef DCMSWAP_NEON
+
+/* swaps 16 bytes at a time, returns the number of bytes swapped */
+static size_t swapBytesNEON(Uint8 *value, const size_t byteLength, const size_t valWidth)
+{
+    const size_t blocks = byteLength / 16;
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        Uint8 *p = value + i * 16;
+        const uint8x16_t v = vld1q_u8(p);
+        if (valWidth == 2)
+            vst1q_u8(p, vrev16q_u8(v));
+        else if (valWidth == 4)
+            vst1q_u8(p, vrev32q_u8(v));
+        else
+            vst1q_u8(p, vrev64q_u8(v));
+    }
+    return blocks * 16;
+}
+
+#endif
+
+
+/* swaps the largest possible part of the given block using SIMD instructions,
+ * returns the number of bytes swapped (a multiple of valWidth)
+ */
+static size_t swapBytesSIMD(Uint8 *value, const size_t byteLength, const size_t valWidth)
+{
+    size_t done = 0;
+    if (valWidth == 2 || valWidth == 4 || valWidth == 8)
+    {
+#ifdef DCMSWAP_AVX2
+        if (byteLength >= 32 && __builtin_cpu_supports("avx2"))
+            done = swapBytesAVX2(value, byteLength, valWidth);
+#endif
+#ifdef DCMSWAP_SSE2
+        done += swapBytesSSE2(value + done, byteLength - done, valWidth);
+#endif
+#ifdef DCMSWAP_NEON
+        done = swapBytesNEON(value, byteLength, valWidth);
+#endif
+    }
+    return done;
+}
+
+
 OFCondition swapIfNecessary(const E_ByteOrder newByteOrder,
                             const E_ByteOrder oldByteOrder,
                             void * value, const Uint32 byteLength,
@@ -81,12 +196,17 @@ void swapBytes(void * value, const Uint32 byteLength,
 {
     Uint8 save;
 
+    /* swap whole blocks with SIMD instructions first, the remainder value by value */
+    const size_t done = swapBytesSIMD(OFstatic_cast(Uint8 *, value), byteLength, valWidth);
+    value = OFstatic_cast(Uint8 *, value) + done;
+    const Uint32 remaining = byteLength - OFstatic_cast(Uint32, done);
+
     /* in case valWidth equals 2, swap correspondingly */
     if (valWidth == 2)
     {
         Uint8 *first = &OFstatic_cast(Uint8*, value)[0];
         Uint8 *second = &OFstatic_cast(Uint8*, value)[1];
-        Uint32 times = byteLength / 2;
+        Uint32 times = remaining / 2;
         while(times)
         {
             --times;
@@ -106,7 +226,7 @@ void swapBytes(void * value, const Uint32 byteLength,
         Uint8 *start;
         Uint8 *end;
 
-        Uint32 times = OFstatic_cast(Uint32, byteLength / valWidth);
+        Uint32 times = OFstatic_cast(Uint32, remaining / valWidth);
         Uint8  *base = OFstatic_cast(Uint8 *, value);
 
         while (times)
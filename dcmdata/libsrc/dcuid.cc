@@ -128,6 +128,9 @@ static const UIDNameMap uidNameMap[] = {
     { UID_JPEG2000TransferSyntax,                              "JPEG2000" },
     { UID_JPEG2000Part2MulticomponentImageCompressionLosslessOnlyTransferSyntax, "JPEG2000MulticomponentLosslessOnly" },
     { UID_JPEG2000Part2MulticomponentImageCompressionTransferSyntax,             "JPEG2000Multicomponent" },
+    { UID_HTJ2KLosslessTransferSyntax,                                           "HTJ2KLossless" },
+    { UID_HTJ2KLosslessRPCLTransferSyntax,                                       "HTJ2KLosslessRPCL" },
+    { UID_HTJ2KTransferSyntax,                                                   "HTJ2K" },
     { UID_JPIPReferencedTransferSyntax,                        "JPIPReferenced" },
     { UID_JPIPReferencedDeflateTransferSyntax,                 "JPIPReferencedDeflate" },
     { UID_MPEG2MainProfileAtMainLevelTransferSyntax,           "MPEG2MainProfile@MainLevel" },
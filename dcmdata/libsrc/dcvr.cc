@@ -228,26 +228,60 @@ DcmVR::setVR(DcmEVR evr)
     }
 }
 
+/* looks up the VR of a name, only the first two characters of the
+ * name are compared and VRs labeled for internal use are never accepted
+ */
+static OFBool findVRName(const char* vrName, DcmEVR& vr)
+{
+    for (int i = 0; i < DcmVRDict_DIM; i++)
+    {
+        if ((strncmp(vrName, DcmVRDict[i].vrName, 2) == 0) &&
+            !(DcmVRDict[i].propertyFlags & DCMVR_PROP_INTERNAL))
+        {
+            vr = DcmVRDict[i].vr;
+            return OFTrue;
+        }
+    }
+    return OFFalse;
+}
+
+/* the VRs of all names of two uppercase letters, built on first use. Every
+ * element of an explicit VR data set is parsed with such a name, which is
+ * resolved by an array access instead of a linear search of DcmVRDict.
+ */
+struct DcmVRNameIndex
+{
+    DcmVRNameIndex()
+    {
+        char name[3] = { 0, 0, 0 };
+        for (int i = 0; i < 26 * 26; i++)
+        {
+            name[0] = OFstatic_cast(char, 'A' + i / 26);
+            name[1] = OFstatic_cast(char, 'A' + i % 26);
+            vr[i] = EVR_UNKNOWN;
+            findVRName(name, vr[i]);
+        }
+    }
+
+    DcmEVR vr[26 * 26];
+};
+
 void
 DcmVR::setVR(const char* vrName)
 {
     vr = EVR_UNKNOWN;   /* default */
     if (vrName != NULL)
     {
-        int found = OFFalse;
-        int i = 0;
-        for (i = 0; (!found && (i < DcmVRDict_DIM)); i++)
+        char c1 = *vrName;
+        char c2 = (c1) ? (*(vrName + 1)) : ('\0');
+        if ((c1 >= 'A') && (c1 <= 'Z') && (c2 >= 'A') && (c2 <= 'Z'))
         {
-            /* We only compare the first two characters of the passed string and
-             * never accept a VR that is labeled for internal use only.
-             */
-            if ((strncmp(vrName, DcmVRDict[i].vrName, 2) == 0) &&
-                !(DcmVRDict[i].propertyFlags & DCMVR_PROP_INTERNAL))
-            {
-                found = OFTrue;
-                vr = DcmVRDict[i].vr;
-            }
+            /* unknown names of uppercase letters stay EVR_UNKNOWN, see below */
+            static const DcmVRNameIndex index;
+            vr = index.vr[(c1 - 'A') * 26 + (c2 - 'A')];
+            return;
         }
+        const OFBool found = findVRName(vrName, vr);
         /* Workaround: There have been reports of systems transmitting
          * illegal VR strings in explicit VR (i.e. "??") without using
          * extended length fields. This is particularly bad because the
@@ -257,8 +291,6 @@ DcmVR::setVR(const char* vrName)
          * letters as "real" future VRs (and thus assume extended length).
          * All other VR strings are treated as "illegal" VRs.
          */
-        char c1 = *vrName;
-        char c2 = (c1) ? (*(vrName + 1)) : ('\0');
         if ((c1 == '?') && (c2 == '?')) vr = EVR_UNKNOWN2B;
         if (!found && ((c1 < 'A') || (c1 > 'Z') || (c2 < 'A') || (c2 > 'Z'))) vr = EVR_UNKNOWN2B;
     }
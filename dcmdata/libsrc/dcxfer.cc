@@ -645,6 +645,48 @@ const S_XferNames XferNames[] =
       OFFalse,
       ESC_none,
       OFFalse 
+    },
+    // entry #42
+    { UID_HTJ2KLosslessTransferSyntax,
+      "High-Throughput JPEG 2000 Image Compression (Lossless Only)",
+      EXS_HighThroughputJPEG2000LosslessOnly,
+      EBO_LittleEndian,
+      EBO_LittleEndian,
+      EVT_Explicit,
+      EJE_Encapsulated,
+      0L, 0L,
+      OFFalse,
+      OFFalse,
+      ESC_none,
+      OFFalse 
+    },
+    // entry #43
+    { UID_HTJ2KLosslessRPCLTransferSyntax,
+      "High-Throughput JPEG 2000 with RPCL Options Image Compression (Lossless Only)",
+      EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly,
+      EBO_LittleEndian,
+      EBO_LittleEndian,
+      EVT_Explicit,
+      EJE_Encapsulated,
+      0L, 0L,
+      OFFalse,
+      OFFalse,
+      ESC_none,
+      OFFalse 
+    },
+    // entry #44
+    { UID_HTJ2KTransferSyntax,
+      "High-Throughput JPEG 2000 Image Compression",
+      EXS_HighThroughputJPEG2000,
+      EBO_LittleEndian,
+      EBO_LittleEndian,
+      EVT_Explicit,
+      EJE_Encapsulated,
+      0L, 0L,
+      OFTrue,
+      OFFalse,
+      ESC_none,
+      OFFalse 
     }
 };
 
@@ -654,6 +696,110 @@ const int DIM_OF_XferNames = OFstatic_cast(int, sizeof(XferNames) / sizeof(S_Xfe
 // ********************************
 
 
+namespace
+{
+
+/* The entries of XferNames by enum value and by UID and name, built on first use.
+ * Transfer syntaxes are resolved for every presentation context proposed during
+ * association negotiation and for most requests, and all UIDs share the prefix
+ * "1.2.840.10008.1.2", so a linear scan with strcmp() is comparatively slow.
+ */
+class XferIndex
+{
+public:
+    static const XferIndex& instance()
+    {
+        static const XferIndex index;
+        return index;
+    }
+
+    /// index of the entry of xfer in XferNames, -1 if there is none
+    int find(E_TransferSyntax xfer) const
+    {
+        const int value = OFstatic_cast(int, xfer);
+        return (value >= 0 && value < byEnumCount) ? byEnum[value] : -1;
+    }
+
+    /// index of the entry with the UID or else the name xname in XferNames, -1 if there is none
+    int find(const char *xname) const
+    {
+        const Uint32 hash = hashOf(xname);
+        int i = lookup(byUID, hash, xname, OFTrue);
+        if (i < 0)
+            i = lookup(byName, hash, xname, OFFalse);
+        return i;
+    }
+
+private:
+    /// slots of the open addressed tables, at least twice the number of entries
+    enum { slotCount = 128, byEnumCount = 64 };
+
+    XferIndex()
+    {
+        for (int i = 0; i < byEnumCount; ++i)
+            byEnum[i] = -1;
+        for (int i = 0; i < slotCount; ++i)
+            byUID[i] = byName[i] = -1;
+        for (int i = 0; i < DIM_OF_XferNames; ++i)
+        {
+            const int value = OFstatic_cast(int, XferNames[i].xfer);
+            // the first entry wins, as with the linear scan
+            if (value >= 0 && value < byEnumCount && byEnum[value] < 0)
+                byEnum[value] = OFstatic_cast(Sint16, i);
+            insert(byUID, XferNames[i].xferID, i, OFTrue);
+            insert(byName, XferNames[i].xferName, i, OFFalse);
+        }
+    }
+
+    /// FNV-1a
+    static Uint32 hashOf(const char *text)
+    {
+        Uint32 hash = 2166136261U;
+        for (; *text != '\0'; ++text)
+            hash = (hash ^ OFstatic_cast(unsigned char, *text)) * 16777619U;
+        return hash;
+    }
+
+    static const char *keyOf(int index, OFBool uid)
+    {
+        return uid ? XferNames[index].xferID : XferNames[index].xferName;
+    }
+
+    static void insert(Sint16 *slots, const char *key, int index, OFBool uid)
+    {
+        int slot = OFstatic_cast(int, hashOf(key) & (slotCount - 1));
+        while (slots[slot] >= 0)
+        {
+            if (strcmp(keyOf(slots[slot], uid), key) == 0)
+                return;
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = OFstatic_cast(Sint16, index);
+    }
+
+    static int lookup(const Sint16 *slots, Uint32 hash, const char *key, OFBool uid)
+    {
+        int slot = OFstatic_cast(int, hash & (slotCount - 1));
+        while (slots[slot] >= 0)
+        {
+            if (strcmp(keyOf(slots[slot], uid), key) == 0)
+                return slots[slot];
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        return -1;
+    }
+
+    Sint16 byEnum[byEnumCount];
+    Sint16 byUID[slotCount];
+    Sint16 byName[slotCount];
+};
+
+}
+
+
+// ********************************
+
+
 DcmXfer::DcmXfer(E_TransferSyntax xfer)
   : xferID(""),
     xferName(ERROR_XferName),
@@ -669,25 +815,7 @@ DcmXfer::DcmXfer(E_TransferSyntax xfer)
     streamCompression(ESC_none),
     referenced(OFFalse)
 {
-    int i = 0;
-    while ((i < DIM_OF_XferNames) && XferNames[i].xfer != xfer)
-        i++;
-    if ((i < DIM_OF_XferNames) && (XferNames[i].xfer == xfer))
-    {
-        xferSyn            = XferNames[i].xfer;
-        xferID             = XferNames[i].xferID;
-        xferName           = XferNames[i].xferName;
-        byteOrder          = XferNames[i].byteOrder;
-        pixelDataByteOrder = XferNames[i].pixelDataByteOrder;
-        vrType             = XferNames[i].vrType;
-        encapsulated       = XferNames[i].encapsulated;
-        JPEGProcess8       = XferNames[i].JPEGProcess8;
-        JPEGProcess12      = XferNames[i].JPEGProcess12;
-        lossy              = XferNames[i].lossy;
-        retired            = XferNames[i].retired;
-        streamCompression  = XferNames[i].streamCompression;
-        referenced         = XferNames[i].referenced;
-    }
+    *this = xfer;
 }
 
 
@@ -709,50 +837,11 @@ DcmXfer::DcmXfer(const char* xferName_xferID)
     streamCompression(ESC_none),
     referenced(OFFalse)
 {
-    const char* xname = xferName_xferID;
-    if (xname != NULL)
+    if (xferName_xferID != NULL)
     {
-        int i = 0;
-        while ((i < DIM_OF_XferNames) && (strcmp(XferNames[i].xferID, xname) != 0))
-            i++;
-        if ((i < DIM_OF_XferNames) && (strcmp(XferNames[i].xferID, xname) == 0))
-        {
-            xferSyn            = XferNames[i].xfer;
-            xferID             = XferNames[i].xferID;
-            xferName           = XferNames[i].xferName;
-            byteOrder          = XferNames[i].byteOrder;
-            pixelDataByteOrder = XferNames[i].pixelDataByteOrder;
-            vrType             = XferNames[i].vrType;
-            encapsulated       = XferNames[i].encapsulated;
-            JPEGProcess8       = XferNames[i].JPEGProcess8;
-            JPEGProcess12      = XferNames[i].JPEGProcess12;
-            lossy              = XferNames[i].lossy;
-            retired            = XferNames[i].retired;
-            streamCompression  = XferNames[i].streamCompression;
-            referenced         = XferNames[i].referenced;
-        }
-        else
-        {
-            i = 0;
-            while ((i < DIM_OF_XferNames) && (strcmp(XferNames[i].xferName, xname) != 0))
-                i++;
-            if ((i < DIM_OF_XferNames) && (strcmp(XferNames[i].xferName, xname) == 0))
-            {
-                xferSyn            = XferNames[i].xfer;
-                xferID             = XferNames[i].xferID;
-                xferName           = XferNames[i].xferName;
-                byteOrder          = XferNames[i].byteOrder;
-                pixelDataByteOrder = XferNames[i].pixelDataByteOrder;
-                vrType             = XferNames[i].vrType;
-                encapsulated       = XferNames[i].encapsulated;
-                JPEGProcess8       = XferNames[i].JPEGProcess8;
-                JPEGProcess12      = XferNames[i].JPEGProcess12;
-                lossy              = XferNames[i].lossy;
-                retired            = XferNames[i].retired;
-                streamCompression  = XferNames[i].streamCompression;
-                referenced         = XferNames[i].referenced;
-            }
-        }
+        const int i = XferIndex::instance().find(xferName_xferID);
+        if (i >= 0)
+            *this = XferNames[i].xfer;
     }
 }
 
@@ -791,12 +880,8 @@ DcmXfer::~DcmXfer()
 
 DcmXfer &DcmXfer::operator=(const E_TransferSyntax xfer)
 {
-    // tbc: if the enum value is consistent with the index of the array,
-    //      why do we need to iterate over the array entries?
-    int i = 0;
-    while ((i < DIM_OF_XferNames) && (XferNames[i].xfer != xfer))
-        i++;
-    if ((i < DIM_OF_XferNames) && (XferNames[i].xfer == xfer))
+    const int i = XferIndex::instance().find(xfer);
+    if (i >= 0)
     {
         xferSyn            = XferNames[i].xfer;
         xferID             = XferNames[i].xferID;
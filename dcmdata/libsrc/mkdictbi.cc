@@ -172,22 +172,8 @@ main(int argc, char* argv[])
     fprintf(fout, "#ifdef ENABLE_BUILTIN_DICTIONARY\n");
     fprintf(fout, "#include \"dcmtk/dcmdata/dcdicent.h\"\n");
     fprintf(fout, "\n");
-    fprintf(fout, "struct DBI_SimpleEntry {\n");
-    fprintf(fout, "    Uint16 group;\n");
-    fprintf(fout, "    Uint16 element;\n");
-    fprintf(fout, "    Uint16 upperGroup;\n");
-    fprintf(fout, "    Uint16 upperElement;\n");
-    fprintf(fout, "    DcmEVR evr;\n");
-    fprintf(fout, "    const char* tagName;\n");
-    fprintf(fout, "    int vmMin;\n");
-    fprintf(fout, "    int vmMax;\n");
-    fprintf(fout, "    const char* standardVersion;\n");
-    fprintf(fout, "    DcmDictRangeRestriction groupRestriction;\n");
-    fprintf(fout, "    DcmDictRangeRestriction elementRestriction;\n");
-    fprintf(fout, "    const char* privateCreator;\n");
-    fprintf(fout, "};\n");
-    fprintf(fout, "\n");
-    fprintf(fout, "static const DBI_SimpleEntry simpleBuiltinDict[] = {\n");
+    fprintf(fout, "/* non-repeating public entries, sorted by tag and looked up in place */\n");
+    fprintf(fout, "static const DcmDictBuiltinEntry standardBuiltinDict[] = {\n");
 
     OFBool isFirst = OFTrue;
     OFBool isPrivate = OFFalse;
@@ -205,20 +191,81 @@ main(int argc, char* argv[])
     }
     /* output the list contents */
 
-    /* non-repeating standard elements */
+    /* non-repeating standard elements, the lookup relies on their order */
     DcmDictEntryListIterator listIter(list.begin());
     DcmDictEntryListIterator listLast(list.end());
     for (; listIter != listLast; ++listIter)
     {
-        printSimpleEntry(fout, *listIter, isFirst, isPrivate);
+        if ((*listIter)->getPrivateCreator() == NULL)
+            printSimpleEntry(fout, *listIter, isFirst, isPrivate);
+    }
+
+    fprintf(fout, "\n};\n");
+    fprintf(fout, "\n");
+    fprintf(fout, "static const size_t standardBuiltinDict_count =\n");
+    fprintf(fout, "    sizeof(standardBuiltinDict)/sizeof(DcmDictBuiltinEntry);\n");
+    fprintf(fout, "\n");
+    fprintf(fout, "/* the tags of standardBuiltinDict, compared by the lookup */\n");
+    fprintf(fout, "static const Uint32 standardBuiltinKeys[] = {\n");
+    size_t keyCount = 0;
+    for (listIter = list.begin(); listIter != listLast; ++listIter)
+    {
+        if ((*listIter)->getPrivateCreator() == NULL) {
+            fprintf(fout, "%s0x%04x%04x", keyCount == 0 ? "    " : (keyCount % 8 == 0 ? ",\n    " : ", "),
+                (*listIter)->getGroup(), (*listIter)->getElement());
+            ++keyCount;
+        }
+    }
+    fprintf(fout, "\n};\n");
+    fprintf(fout, "\n");
+
+    /* open addressing with linear probing, at most two thirds of the slots used */
+    size_t slotCount = 1;
+    while (slotCount * 2 < keyCount * 3) slotCount *= 2;
+    Uint16 *slots = new Uint16[slotCount];
+    for (size_t i = 0; i < slotCount; ++i) slots[i] = 0xffff;
+    Uint16 index = 0;
+    for (listIter = list.begin(); listIter != listLast; ++listIter)
+    {
+        if ((*listIter)->getPrivateCreator() == NULL) {
+            const Uint32 key = (OFstatic_cast(Uint32, (*listIter)->getGroup()) << 16) | (*listIter)->getElement();
+            size_t slot = DcmDataDictionary::builtinSlot(key, slotCount - 1);
+            while (slots[slot] != 0xffff) slot = (slot + 1) & (slotCount - 1);
+            slots[slot] = index++;
+        }
     }
+    fprintf(fout, "/* indexes into standardBuiltinDict by DcmDataDictionary::builtinSlot(), 0xffff if empty */\n");
+    fprintf(fout, "static const Uint16 standardBuiltinSlots[%lu] = {\n", OFstatic_cast(unsigned long, slotCount));
+    for (size_t i = 0; i < slotCount; ++i)
+        fprintf(fout, "%s0x%04x", i == 0 ? "    " : (i % 12 == 0 ? ",\n    " : ", "), slots[i]);
+    fprintf(fout, "\n};\n");
+    fprintf(fout, "\n");
+    delete[] slots;
+    fprintf(fout, "/* repeating and private entries, added to the dictionary when it is loaded */\n");
+    fprintf(fout, "static const DcmDictBuiltinEntry simpleBuiltinDict[] = {\n");
 
-    /* repeating standard elements */
+    /* repeating standard elements first, so that the first entry is never left out */
+    isFirst = OFTrue;
     DcmDictEntryListIterator repIter(globalDataDict.repeatingBegin());
     DcmDictEntryListIterator repLast(globalDataDict.repeatingEnd());
     for (; repIter != repLast; ++repIter)
     {
-        printSimpleEntry(fout, *repIter, isFirst, isPrivate);
+        if ((*repIter)->getPrivateCreator() == NULL)
+            printSimpleEntry(fout, *repIter, isFirst, isPrivate);
+    }
+
+    /* non-repeating private elements */
+    for (listIter = list.begin(); listIter != listLast; ++listIter)
+    {
+        if ((*listIter)->getPrivateCreator() != NULL)
+            printSimpleEntry(fout, *listIter, isFirst, isPrivate);
+    }
+
+    /* repeating private elements */
+    for (repIter = globalDataDict.repeatingBegin(); repIter != repLast; ++repIter)
+    {
+        if ((*repIter)->getPrivateCreator() != NULL)
+            printSimpleEntry(fout, *repIter, isFirst, isPrivate);
     }
 
     if (isPrivate)
@@ -229,15 +276,33 @@ main(int argc, char* argv[])
     fprintf(fout, "\n};\n");
     fprintf(fout, "\n");
     fprintf(fout, "static const size_t simpleBuiltinDict_count =\n");
-    fprintf(fout, "    sizeof(simpleBuiltinDict)/sizeof(DBI_SimpleEntry);\n");
+    fprintf(fout, "    sizeof(simpleBuiltinDict)/sizeof(DcmDictBuiltinEntry);\n");
+    fprintf(fout, "\n");
+    fprintf(fout, "\n");
+    fprintf(fout, "/* the entries created from standardBuiltinDict so far, by index */\n");
+    fprintf(fout, "static std::atomic<const DcmDictEntry*> standardBuiltinEntries[standardBuiltinDict_count];\n");
+    fprintf(fout, "\n");
+    fprintf(fout, "static struct DBI_CreatedEntries {\n");
+    fprintf(fout, "    ~DBI_CreatedEntries() {\n");
+    fprintf(fout, "        for (size_t i=0; i<standardBuiltinDict_count; ++i) {\n");
+    fprintf(fout, "            delete standardBuiltinEntries[i].exchange(NULL);\n");
+    fprintf(fout, "        }\n");
+    fprintf(fout, "    }\n");
+    fprintf(fout, "} createdBuiltinEntries;\n");
     fprintf(fout, "\n");
-
     fprintf(fout, "\n");
     fprintf(fout, "void\n");
     fprintf(fout, "DcmDataDictionary::loadBuiltinDictionary()\n");
     fprintf(fout, "{\n");
+    fprintf(fout, "    builtinEntries = standardBuiltinDict;\n");
+    fprintf(fout, "    builtinKeys = standardBuiltinKeys;\n");
+    fprintf(fout, "    builtinSlots = standardBuiltinSlots;\n");
+    fprintf(fout, "    builtinSlotMask = sizeof(standardBuiltinSlots)/sizeof(Uint16) - 1;\n");
+    fprintf(fout, "    builtinCreated = standardBuiltinEntries;\n");
+    fprintf(fout, "    builtinCount = standardBuiltinDict_count;\n");
+    fprintf(fout, "\n");
     fprintf(fout, "    DcmDictEntry* e = NULL;\n");
-    fprintf(fout, "    const DBI_SimpleEntry *b = simpleBuiltinDict;\n");
+    fprintf(fout, "    const DcmDictBuiltinEntry *b = simpleBuiltinDict;\n");
     fprintf(fout, "    for (size_t i=0; i<simpleBuiltinDict_count; ++i) {\n");
     fprintf(fout, "        b = simpleBuiltinDict + i;\n");
     fprintf(fout, "        e = new DcmDictEntry(b->group, b->element,\n");
@@ -35,6 +35,7 @@
 #include "dcmtk/dcmimgle/dipxrept.h"
 #include "dcmtk/dcmimgle/didispfn.h"
 #include "dcmtk/dcmimgle/didislut.h"
+#include "dcmtk/dcmimgle/dimosimd.h"
 
 #ifdef PASTEL_COLOR_OUTPUT
 #include "dimcopxt.h"
@@ -755,7 +756,7 @@ class DiMonoOutputPixelTemplate
                             }
                         } else {                                                      // don't use display: invalid or absent
                             DCMIMGLE_TRACE("monochrome rendering: VOI NONE #8");
-                            for (i = Count; i != 0; --i)
+                            for (i = Count - DiMonoSimdScale(p, q, Count, absmin, gradient, low); i != 0; --i)
                                 *(q++) = OFstatic_cast(T3, OFstatic_cast(double, low) + (OFstatic_cast(double, *(p++)) - absmin) * gradient);
                         }
                     }
@@ -1111,7 +1112,7 @@ class DiMonoOutputPixelTemplate
                             DCMIMGLE_TRACE("monochrome rendering: VOI LINEAR #8");
                             const double offset = (width_1 == 0) ? 0 : (high - ((center - 0.5) / width_1 + 0.5) * outrange);
                             const double gradient = (width_1 == 0) ? 0 : outrange / width_1;
-                            for (i = Count; i != 0; --i)
+                            for (i = Count - DiMonoSimdWindow(p, q, Count, leftBorder, rightBorder, offset, gradient, low, high); i != 0; --i)
                             {
                                 value = OFstatic_cast(double, *(p++));
                                 if (value <= leftBorder)
@@ -0,0 +1,260 @@
+/*
+ *
+ *  Copyright (C) 2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmimgle
+ *
+ *  Purpose: SIMD kernels for the monochrome output transformation (Header)
+ *
+ */
+
+
+#ifndef DIMOSIMD_H
+#define DIMOSIMD_H
+
+#include "dcmtk/config/osconfig.h"
+
+#include "dcmtk/ofstd/ofcast.h"
+
+#define INCLUDE_CSTRING
+#include "dcmtk/ofstd/ofstdinc.h"
+
+/* SSE2 is part of every x86-64 CPU. The kernels compute in double precision
+ * like the scalar code, so the output is exactly the same. Define
+ * DIMOSIMD_DISABLED to always use the scalar code.
+ */
+#if (defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)) && !defined(DIMOSIMD_DISABLED)
+#define DIMOSIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+
+#ifdef DIMOSIMD_SSE2
+
+/*------------------------------*
+ *  load and store of 4 pixels  *
+ *------------------------------*/
+
+/** convert four 32-bit signed values to double precision
+ */
+static inline void DiMonoSimdConvert(const __m128i value, __m128d &lo, __m128d &hi)
+{
+    lo = _mm_cvtepi32_pd(value);
+    hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+static inline __m128i DiMonoSimdLoad32(const void *p)
+{
+    int value;
+    memcpy(&value, p, sizeof(value));
+    return _mm_cvtsi32_si128(value);
+}
+
+static inline void DiMonoSimdLoad(const Uint8 *p, __m128d &lo, __m128d &hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    DiMonoSimdConvert(_mm_unpacklo_epi16(_mm_unpacklo_epi8(DiMonoSimdLoad32(p), zero), zero), lo, hi);
+}
+
+static inline void DiMonoSimdLoad(const Sint8 *p, __m128d &lo, __m128d &hi)
+{
+    const __m128i value = DiMonoSimdLoad32(p);
+    DiMonoSimdConvert(_mm_srai_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(value, value), _mm_unpacklo_epi8(value, value)), 24), lo, hi);
+}
+
+static inline void DiMonoSimdLoad(const Uint16 *p, __m128d &lo, __m128d &hi)
+{
+    DiMonoSimdConvert(_mm_unpacklo_epi16(_mm_loadl_epi64(OFreinterpret_cast(const __m128i *, p)), _mm_setzero_si128()), lo, hi);
+}
+
+static inline void DiMonoSimdLoad(const Sint16 *p, __m128d &lo, __m128d &hi)
+{
+    const __m128i value = _mm_loadl_epi64(OFreinterpret_cast(const __m128i *, p));
+    DiMonoSimdConvert(_mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16), lo, hi);
+}
+
+static inline void DiMonoSimdLoad(const Uint32 *p, __m128d &lo, __m128d &hi)
+{
+    /* convert as signed values with the sign bit flipped, then add 2^31 */
+    const __m128i value = _mm_xor_si128(_mm_loadu_si128(OFreinterpret_cast(const __m128i *, p)), _mm_set1_epi32(OFstatic_cast(int, 0x80000000)));
+    const __m128d bias = _mm_set1_pd(2147483648.0);
+    DiMonoSimdConvert(value, lo, hi);
+    lo = _mm_add_pd(lo, bias);
+    hi = _mm_add_pd(hi, bias);
+}
+
+static inline void DiMonoSimdLoad(const Sint32 *p, __m128d &lo, __m128d &hi)
+{
+    DiMonoSimdConvert(_mm_loadu_si128(OFreinterpret_cast(const __m128i *, p)), lo, hi);
+}
+
+/** truncate eight values (in the range of the output type) and store them
+ */
+static inline void DiMonoSimdStore(Uint8 *q, const __m128d r0, const __m128d r1, const __m128d r2, const __m128d r3)
+{
+    const __m128i a = _mm_unpacklo_epi64(_mm_cvttpd_epi32(r0), _mm_cvttpd_epi32(r1));
+    const __m128i b = _mm_unpacklo_epi64(_mm_cvttpd_epi32(r2), _mm_cvttpd_epi32(r3));
+    const __m128i value = _mm_packs_epi32(a, b);
+    _mm_storel_epi64(OFreinterpret_cast(__m128i *, q), _mm_packus_epi16(value, value));
+}
+
+static inline void DiMonoSimdStore(Uint16 *q, const __m128d r0, const __m128d r1, const __m128d r2, const __m128d r3)
+{
+    /* there is no unsigned 32 to 16 bit pack in SSE2, pack signed values biased by 2^15 */
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i a = _mm_sub_epi32(_mm_unpacklo_epi64(_mm_cvttpd_epi32(r0), _mm_cvttpd_epi32(r1)), bias);
+    const __m128i b = _mm_sub_epi32(_mm_unpacklo_epi64(_mm_cvttpd_epi32(r2), _mm_cvttpd_epi32(r3)), bias);
+    _mm_storeu_si128(OFreinterpret_cast(__m128i *, q), _mm_xor_si128(_mm_packs_epi32(a, b), _mm_set1_epi16(OFstatic_cast(short, 0x8000))));
+}
+
+/** convert two values in the range of Uint32, values >= 2^31 are reduced by 2^31 before
+ *  the conversion and get their sign bit flipped afterwards
+ */
+static inline __m128i DiMonoSimdTruncate32(const __m128d value)
+{
+    const __m128d bias = _mm_and_pd(_mm_cmpge_pd(value, _mm_set1_pd(2147483648.0)), _mm_set1_pd(-2147483648.0));
+    return _mm_xor_si128(_mm_cvttpd_epi32(_mm_add_pd(value, bias)), _mm_cvttpd_epi32(bias));
+}
+
+static inline void DiMonoSimdStore(Uint32 *q, const __m128d r0, const __m128d r1, const __m128d r2, const __m128d r3)
+{
+    _mm_storeu_si128(OFreinterpret_cast(__m128i *, q), _mm_unpacklo_epi64(DiMonoSimdTruncate32(r0), DiMonoSimdTruncate32(r1)));
+    _mm_storeu_si128(OFreinterpret_cast(__m128i *, q + 4), _mm_unpacklo_epi64(DiMonoSimdTruncate32(r2), DiMonoSimdTruncate32(r3)));
+}
+
+/** linear window of two pixels, see DiMonoSimdWindow()
+ */
+static inline __m128d DiMonoSimdWindow2(const __m128d value,
+                                        const __m128d leftBorder,
+                                        const __m128d rightBorder,
+                                        const __m128d offset,
+                                        const __m128d gradient,
+                                        const __m128d low,
+                                        const __m128d high)
+{
+    const __m128d left = _mm_cmple_pd(value, leftBorder);
+    const __m128d right = _mm_cmpgt_pd(value, rightBorder);
+    const __m128d gray = _mm_add_pd(offset, _mm_mul_pd(value, gradient));
+    return _mm_or_pd(_mm_andnot_pd(_mm_or_pd(left, right), gray),
+                     _mm_or_pd(_mm_and_pd(left, low), _mm_and_pd(right, high)));
+}
+
+#endif
+
+
+/*-----------*
+ *  kernels  *
+ *-----------*/
+
+/** apply a linear VOI window without presentation LUT and display function, i.e.
+ *  'low' for values <= leftBorder, 'high' for values > rightBorder and
+ *  'offset + value * gradient' in between.
+ *
+ ** @param  p         input pixels, advanced by the number of processed pixels
+ *  @param  q         output pixels, advanced by the number of processed pixels
+ *  @param  count     number of pixels
+ *  @param  leftBorder   left window border
+ *  @param  rightBorder  right window border
+ *  @param  offset    offset of the linear function
+ *  @param  gradient  gradient of the linear function
+ *  @param  low       output value left of the window
+ *  @param  high      output value right of the window
+ *
+ ** @return number of processed pixels, a multiple of 8. The remaining pixels are
+ *          left to the caller (all of them if SIMD is not available)
+ */
+template<class T1, class T3>
+unsigned long DiMonoSimdWindow(const T1 *&p,
+                               T3 *&q,
+                               const unsigned long count,
+                               const double leftBorder,
+                               const double rightBorder,
+                               const double offset,
+                               const double gradient,
+                               const T3 low,
+                               const T3 high)
+{
+#ifdef DIMOSIMD_SSE2
+    const __m128d vleft = _mm_set1_pd(leftBorder);
+    const __m128d vright = _mm_set1_pd(rightBorder);
+    const __m128d voffset = _mm_set1_pd(offset);
+    const __m128d vgradient = _mm_set1_pd(gradient);
+    const __m128d vlow = _mm_set1_pd(OFstatic_cast(double, low));
+    const __m128d vhigh = _mm_set1_pd(OFstatic_cast(double, high));
+    const unsigned long blocks = count / 8;
+    __m128d v0, v1, v2, v3;
+    for (unsigned long i = blocks; i != 0; --i)
+    {
+        DiMonoSimdLoad(p, v0, v1);
+        DiMonoSimdLoad(p + 4, v2, v3);
+        DiMonoSimdStore(q, DiMonoSimdWindow2(v0, vleft, vright, voffset, vgradient, vlow, vhigh),
+                           DiMonoSimdWindow2(v1, vleft, vright, voffset, vgradient, vlow, vhigh),
+                           DiMonoSimdWindow2(v2, vleft, vright, voffset, vgradient, vlow, vhigh),
+                           DiMonoSimdWindow2(v3, vleft, vright, voffset, vgradient, vlow, vhigh));
+        p += 8;
+        q += 8;
+    }
+    return blocks * 8;
+#else
+    (void)p; (void)q; (void)count; (void)leftBorder; (void)rightBorder;
+    (void)offset; (void)gradient; (void)low; (void)high;
+    return 0;
+#endif
+}
+
+
+/** apply a linear scaling without presentation LUT and display function, i.e.
+ *  'low + (value - absmin) * gradient'.
+ *
+ ** @param  p         input pixels, advanced by the number of processed pixels
+ *  @param  q         output pixels, advanced by the number of processed pixels
+ *  @param  count     number of pixels
+ *  @param  absmin    minimum pixel value
+ *  @param  gradient  gradient of the linear function
+ *  @param  low       lowest output value
+ *
+ ** @return number of processed pixels, a multiple of 8. The remaining pixels are
+ *          left to the caller (all of them if SIMD is not available)
+ */
+template<class T1, class T3>
+unsigned long DiMonoSimdScale(const T1 *&p,
+                              T3 *&q,
+                              const unsigned long count,
+                              const double absmin,
+                              const double gradient,
+                              const T3 low)
+{
+#ifdef DIMOSIMD_SSE2
+    const __m128d vmin = _mm_set1_pd(absmin);
+    const __m128d vgradient = _mm_set1_pd(gradient);
+    const __m128d vlow = _mm_set1_pd(OFstatic_cast(double, low));
+    const unsigned long blocks = count / 8;
+    __m128d v0, v1, v2, v3;
+    for (unsigned long i = blocks; i != 0; --i)
+    {
+        DiMonoSimdLoad(p, v0, v1);
+        DiMonoSimdLoad(p + 4, v2, v3);
+        DiMonoSimdStore(q, _mm_add_pd(vlow, _mm_mul_pd(_mm_sub_pd(v0, vmin), vgradient)),
+                           _mm_add_pd(vlow, _mm_mul_pd(_mm_sub_pd(v1, vmin), vgradient)),
+                           _mm_add_pd(vlow, _mm_mul_pd(_mm_sub_pd(v2, vmin), vgradient)),
+                           _mm_add_pd(vlow, _mm_mul_pd(_mm_sub_pd(v3, vmin), vgradient)));
+        p += 8;
+        q += 8;
+    }
+    return blocks * 8;
+#else
+    (void)p; (void)q; (void)count; (void)absmin; (void)gradient; (void)low;
+    return 0;
+#endif
+}
+
+#endif
@@ -29,6 +29,11 @@
 
 #include "dcmtk/dcmimgle/ditranst.h"
 #include "dcmtk/dcmimgle/dipxrept.h"
+#include "dcmtk/dcmimgle/diutils.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
 
 
 /*---------------------*
@@ -177,11 +182,13 @@ class DiScaleTemplate
     }
 
     /** choose scaling/clipping algorithm depending on specified parameters.
+     *  With DicomImageClass::setScaleThreads() multi-frame images are scaled frame parallel.
      *
      ** @param  src          array of pointers to source image pixels
      *  @param  dest         array of pointers to destination image pixels
      *  @param  interpolate  preferred interpolation algorithm (0 = no interpolation, 1 = pbmplus algorithm,
-     *                         2 = c't algorithm, 3 = bilinear magnification, 4 = bicubic magnification)
+     *                         2 = c't algorithm, 3 = bilinear magnification, 4 = bicubic magnification,
+     *                         5 = area averaging reduction)
      *  @param  value        value to be set outside the image boundaries (used for clipping, default: 0)
      */
     void scaleData(const T *src[],
@@ -191,46 +198,11 @@ class DiScaleTemplate
     {
         if ((src != NULL) && (dest != NULL))
         {
-            DCMIMGLE_TRACE("Col/Rows: " << Columns << " " << Rows << OFendl
-                        << "Left/Top: " << Left << " " << Top << OFendl
-                        << "Src  X/Y: " << this->Src_X << " " << this->Src_Y << OFendl
-                        << "Dest X/Y: " << this->Dest_X << " " << this->Dest_Y);
-            if ((Left + OFstatic_cast(signed long, this->Src_X) <= 0) || (Top + OFstatic_cast(signed long, this->Src_Y) <= 0) ||
-                (Left >= OFstatic_cast(signed long, Columns)) || (Top >= OFstatic_cast(signed long, Rows)))
-            {                                                                         // no image to be displayed
-                DCMIMGLE_DEBUG("clipping area is fully outside the image boundaries");
-                this->fillPixel(dest, value);                                         // ... fill bitmap
-            }
-            else if ((this->Src_X == this->Dest_X) && (this->Src_Y == this->Dest_Y))  // no scaling
-            {
-                if ((Left == 0) && (Top == 0) && (Columns == this->Src_X) && (Rows == this->Src_Y))
-                    this->copyPixel(src, dest);                                       // copying
-                else if ((Left >= 0) && (OFstatic_cast(Uint16, Left + this->Src_X) <= Columns) &&
-                         (Top >= 0) && (OFstatic_cast(Uint16, Top + this->Src_Y) <= Rows))
-                    clipPixel(src, dest);                                             // clipping
-                else
-                    clipBorderPixel(src, dest, value);                                // clipping (with border)
-            }
-            else if ((interpolate == 1) && (this->Bits <= MAX_INTERPOLATION_BITS))
-                interpolatePixel(src, dest);                                          // interpolation (pbmplus)
-            else if ((interpolate == 4) && (this->Dest_X >= this->Src_X) && (this->Dest_Y >= this->Src_Y) &&
-                     (this->Src_X >= 3) && (this->Src_Y >= 3))
-                bicubicPixel(src, dest);                                              // bicubic magnification
-            else if ((interpolate >= 3) && (this->Dest_X >= this->Src_X) && (this->Dest_Y >= this->Src_Y) &&
-                     (this->Src_X >= 2) && (this->Src_Y >= 2))
-                bilinearPixel(src, dest);                                             // bilinear magnification
-            else if ((interpolate >= 1) && (this->Dest_X >= this->Src_X) && (this->Dest_Y >= this->Src_Y))
-                expandPixel(src, dest);                                               // interpolated expansion (c't)
-            else if ((interpolate >= 1) && (this->Src_X >= this->Dest_X) && (this->Src_Y >= this->Dest_Y))
-                reducePixel(src, dest);                                               // interpolated reduction (c't)
-            else if ((interpolate >= 1) && (this->Bits <= MAX_INTERPOLATION_BITS))
-                interpolatePixel(src, dest);                                          // interpolation (pbmplus), fallback
-            else if ((this->Dest_X % this->Src_X == 0) && (this->Dest_Y % this->Src_Y == 0))
-                replicatePixel(src, dest);                                            // replication
-            else if ((this->Src_X % this->Dest_X == 0) && (this->Src_Y % this->Dest_Y == 0))
-                suppressPixel(src, dest);                                             // suppression
+            const unsigned int threads = DicomImageClass::getScaleThreads();
+            if ((threads > 1) && (this->Frames > 1))
+                scaleFrameParallel(src, dest, interpolate, value, threads);
             else
-                scalePixel(src, dest);                                                // general scaling
+                scaleFrames(src, dest, interpolate, value, threads);
         }
     }
 
@@ -248,6 +220,232 @@ class DiScaleTemplate
 
  private:
 
+    /** choose scaling/clipping algorithm depending on specified parameters, see scaleData()
+     *
+     ** @param  src          array of pointers to source image pixels
+     *  @param  dest         array of pointers to destination image pixels
+     *  @param  interpolate  preferred interpolation algorithm
+     *  @param  value        value to be set outside the image boundaries
+     *  @param  threads      maximum number of threads used for a single frame
+     */
+    void scaleFrames(const T *src[],
+                     T *dest[],
+                     const int interpolate,
+                     const T value,
+                     const unsigned int threads)
+    {
+        DCMIMGLE_TRACE("Col/Rows: " << Columns << " " << Rows << OFendl
+                    << "Left/Top: " << Left << " " << Top << OFendl
+                    << "Src  X/Y: " << this->Src_X << " " << this->Src_Y << OFendl
+                    << "Dest X/Y: " << this->Dest_X << " " << this->Dest_Y);
+        if ((Left + OFstatic_cast(signed long, this->Src_X) <= 0) || (Top + OFstatic_cast(signed long, this->Src_Y) <= 0) ||
+            (Left >= OFstatic_cast(signed long, Columns)) || (Top >= OFstatic_cast(signed long, Rows)))
+        {                                                                         // no image to be displayed
+            DCMIMGLE_DEBUG("clipping area is fully outside the image boundaries");
+            this->fillPixel(dest, value);                                         // ... fill bitmap
+        }
+        else if ((this->Src_X == this->Dest_X) && (this->Src_Y == this->Dest_Y))  // no scaling
+        {
+            if ((Left == 0) && (Top == 0) && (Columns == this->Src_X) && (Rows == this->Src_Y))
+                this->copyPixel(src, dest);                                       // copying
+            else if ((Left >= 0) && (OFstatic_cast(Uint16, Left + this->Src_X) <= Columns) &&
+                     (Top >= 0) && (OFstatic_cast(Uint16, Top + this->Src_Y) <= Rows))
+                clipPixel(src, dest);                                             // clipping
+            else
+                clipBorderPixel(src, dest, value);                                // clipping (with border)
+        }
+        else if ((interpolate == 5) && (this->Src_X >= this->Dest_X) && (this->Src_Y >= this->Dest_Y))
+            areaPixel(src, dest, threads);                                        // area averaging reduction
+        else if ((interpolate == 1) && (this->Bits <= MAX_INTERPOLATION_BITS))
+            interpolatePixel(src, dest);                                          // interpolation (pbmplus)
+        else if ((interpolate == 4) && (this->Dest_X >= this->Src_X) && (this->Dest_Y >= this->Src_Y) &&
+                 (this->Src_X >= 3) && (this->Src_Y >= 3))
+            bicubicPixel(src, dest);                                              // bicubic magnification
+        else if ((interpolate >= 3) && (this->Dest_X >= this->Src_X) && (this->Dest_Y >= this->Src_Y) &&
+                 (this->Src_X >= 2) && (this->Src_Y >= 2))
+            bilinearPixel(src, dest);                                             // bilinear magnification
+        else if ((interpolate >= 1) && (this->Dest_X >= this->Src_X) && (this->Dest_Y >= this->Src_Y))
+            expandPixel(src, dest);                                               // interpolated expansion (c't)
+        else if ((interpolate >= 1) && (this->Src_X >= this->Dest_X) && (this->Src_Y >= this->Dest_Y))
+            reducePixel(src, dest);                                               // interpolated reduction (c't)
+        else if ((interpolate >= 1) && (this->Bits <= MAX_INTERPOLATION_BITS))
+            interpolatePixel(src, dest);                                          // interpolation (pbmplus), fallback
+        else if ((this->Dest_X % this->Src_X == 0) && (this->Dest_Y % this->Src_Y == 0))
+            replicatePixel(src, dest);                                            // replication
+        else if ((this->Src_X % this->Dest_X == 0) && (this->Src_Y % this->Dest_Y == 0))
+            suppressPixel(src, dest);                                             // suppression
+        else
+            scalePixel(src, dest);                                                // general scaling
+    }
+
+    /** scale consecutive ranges of frames in parallel, each thread uses its own scaling
+     *  object with the same parameters
+     *
+     ** @param  src          array of pointers to source image pixels
+     *  @param  dest         array of pointers to destination image pixels
+     *  @param  interpolate  preferred interpolation algorithm
+     *  @param  value        value to be set outside the image boundaries
+     *  @param  threads      maximum number of threads (> 1)
+     */
+    void scaleFrameParallel(const T *src[],
+                            T *dest[],
+                            const int interpolate,
+                            const T value,
+                            const unsigned int threads)
+    {
+        const Uint32 count = (threads < this->Frames) ? threads : this->Frames;
+        DCMIMGLE_DEBUG("scaling " << this->Frames << " frames using " << count << " threads");
+        const unsigned long src_size = OFstatic_cast(unsigned long, Rows) * OFstatic_cast(unsigned long, Columns);
+        const unsigned long dest_size = OFstatic_cast(unsigned long, this->Dest_X) * OFstatic_cast(unsigned long, this->Dest_Y);
+        std::vector<std::thread> workers;
+        Uint32 first = 0;
+        for (Uint32 t = 0; t < count; ++t)
+        {
+            const Uint32 frames = (this->Frames - first) / (count - t);
+            workers.push_back(std::thread([this, src, dest, interpolate, value, first, frames, src_size, dest_size]()
+            {
+                const T *part_src[3] = { NULL, NULL, NULL };
+                T *part_dest[3] = { NULL, NULL, NULL };
+                for (int j = 0; (j < this->Planes) && (j < 3); ++j)
+                {
+                    part_src[j] = src[j] + OFstatic_cast(unsigned long, first) * src_size;
+                    part_dest[j] = dest[j] + OFstatic_cast(unsigned long, first) * dest_size;
+                }
+                DiScaleTemplate<T> part(this->Planes, Columns, Rows, Left, Top, this->Src_X, this->Src_Y,
+                                        this->Dest_X, this->Dest_Y, frames, this->Bits);
+                part.scaleFrames(part_src, part_dest, interpolate, value, 1);
+            }));
+            first += frames;
+        }
+        for (size_t t = 0; t < workers.size(); ++t)
+            workers[t].join();
+    }
+
+    /** area averaging reduction (only for reduction).
+     *  Each destination pixel is the mean of the source area it covers, partially covered
+     *  pixels at the borders are weighted by their coverage. Same result as reducePixel()
+     *  apart from rounding, but the coverage is determined once per row and column, so
+     *  large reduction factors cost little more than reading the source.
+     *
+     ** @param  src      array of pointers to source image pixels
+     *  @param  dest     array of pointers to destination image pixels
+     *  @param  threads  maximum number of threads the destination rows are split into
+     */
+    void areaPixel(const T *src[],
+                   T *dest[],
+                   const unsigned int threads)
+    {
+        DCMIMGLE_DEBUG("using area averaging reduction algorithm");
+        const double x_factor = OFstatic_cast(double, this->Src_X) / OFstatic_cast(double, this->Dest_X);
+        const double y_factor = OFstatic_cast(double, this->Src_Y) / OFstatic_cast(double, this->Dest_Y);
+        std::vector<int> bxi, exi, byi, eyi;
+        std::vector<double> l_factor, r_factor, b_factor, t_factor;
+        determineCoverage(this->Dest_X, this->Src_X, bxi, exi, l_factor, r_factor);
+        determineCoverage(this->Dest_Y, this->Src_Y, byi, eyi, b_factor, t_factor);
+        const double xy_factor = x_factor * y_factor;
+        const unsigned long f_size = OFstatic_cast(unsigned long, Rows) * OFstatic_cast(unsigned long, Columns);
+        const unsigned long d_size = OFstatic_cast(unsigned long, this->Dest_X) * OFstatic_cast(unsigned long, this->Dest_Y);
+
+        // scales the destination rows [y0, y1) of all planes and frames
+        auto scaleRows = [&](const Uint16 y0, const Uint16 y1)
+        {
+            std::vector<double> sum(this->Dest_X);
+            for (int j = 0; j < this->Planes; ++j)
+            {
+                const T *sp = src[j] + OFstatic_cast(unsigned long, Top) * OFstatic_cast(unsigned long, Columns) + Left;
+                T *dp = dest[j];
+                for (unsigned long f = 0; f < this->Frames; ++f)
+                {
+                    for (Uint16 y = y0; y < y1; ++y)
+                    {
+                        std::fill(sum.begin(), sum.end(), 0.0);
+                        for (int yi = byi[y]; yi <= eyi[y]; ++yi)
+                        {
+                            const double weight = (yi == byi[y]) ? b_factor[y] : ((yi == eyi[y]) ? t_factor[y] : 1.0);
+                            const T *p = sp + OFstatic_cast(unsigned long, yi) * OFstatic_cast(unsigned long, Columns);
+                            for (Uint16 x = 0; x < this->Dest_X; ++x)
+                            {
+                                double value = l_factor[x] * OFstatic_cast(double, p[bxi[x]]);
+                                if (exi[x] > bxi[x])
+                                {
+                                    for (int xi = bxi[x] + 1; xi < exi[x]; ++xi)
+                                        value += OFstatic_cast(double, p[xi]);
+                                    value += r_factor[x] * OFstatic_cast(double, p[exi[x]]);
+                                }
+                                sum[x] += weight * value;
+                            }
+                        }
+                        T *q = dp + OFstatic_cast(unsigned long, y) * OFstatic_cast(unsigned long, this->Dest_X);
+                        for (Uint16 x = 0; x < this->Dest_X; ++x)
+                            *(q++) = OFstatic_cast(T, sum[x] / xy_factor + 0.5);
+                    }
+                    sp += f_size;
+                    dp += d_size;
+                }
+            }
+        };
+
+        // rows are only worth splitting if each thread gets a reasonable share of the source
+        const unsigned long min_pixels = 65536;
+        unsigned long count = (threads > 1) ? OFstatic_cast(unsigned long, this->Src_X) * OFstatic_cast(unsigned long, this->Src_Y) / min_pixels : 1;
+        if (count > threads)
+            count = threads;
+        if (count > this->Dest_Y)
+            count = this->Dest_Y;
+        if (count <= 1)
+            scaleRows(0, this->Dest_Y);
+        else
+        {
+            DCMIMGLE_DEBUG("scaling " << this->Dest_Y << " rows using " << count << " threads");
+            std::vector<std::thread> workers;
+            for (unsigned long t = 0; t < count; ++t)
+            {
+                const Uint16 y0 = OFstatic_cast(Uint16, t * this->Dest_Y / count);
+                const Uint16 y1 = OFstatic_cast(Uint16, (t + 1) * this->Dest_Y / count);
+                workers.push_back(std::thread(scaleRows, y0, y1));
+            }
+            for (size_t t = 0; t < workers.size(); ++t)
+                workers[t].join();
+        }
+    }
+
+    /** determine the source pixels covered by each destination pixel along one axis,
+     *  like reducePixel() does, but from integer ratios rather than a floating point factor
+     *
+     ** @param  dest_size  number of destination pixels
+     *  @param  src_size   number of source pixels
+     *  @param  first      first covered source pixel on return
+     *  @param  last       last covered source pixel on return
+     *  @param  first_weight  fraction of the first pixel that is covered on return
+     *  @param  last_weight   fraction of the last pixel that is covered on return
+     */
+    static void determineCoverage(const Uint16 dest_size,
+                                  const Uint16 src_size,
+                                  std::vector<int> &first,
+                                  std::vector<int> &last,
+                                  std::vector<double> &first_weight,
+                                  std::vector<double> &last_weight)
+    {
+        first.resize(dest_size);
+        last.resize(dest_size);
+        first_weight.resize(dest_size);
+        last_weight.resize(dest_size);
+        for (Uint16 i = 0; i < dest_size; ++i)
+        {
+            // bounds as integer ratios, exact for pixel boundaries so that a pixel the area ends at is not covered
+            const unsigned long begin = OFstatic_cast(unsigned long, src_size) * i;
+            const unsigned long end = OFstatic_cast(unsigned long, src_size) * (i + 1);
+            const double b = OFstatic_cast(double, begin) / dest_size;
+            const double e = OFstatic_cast(double, end) / dest_size;
+            first[i] = OFstatic_cast(int, begin / dest_size);
+            last[i] = OFstatic_cast(int, end / dest_size);
+            if (end % dest_size == 0)
+                --last[i];
+            first_weight[i] = 1 + OFstatic_cast(double, first[i]) - b;
+            last_weight[i] = e - OFstatic_cast(double, last[i]);
+        }
+    }
+
     /** clip image to specified area (only inside image boundaries).
      *  This is an optimization of the more general method clipBorderPixel().
      *
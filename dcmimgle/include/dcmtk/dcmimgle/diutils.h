@@ -460,6 +460,20 @@ class DCMTK_DCMIMGLE_EXPORT DicomImageClass
     static EP_Representation determineRepresentation(double minvalue,
                                                      double maxvalue);
 
+    /** set the number of threads used for scaling images. Multi-frame images are scaled
+     *  frame parallel, single frames are split into rows by the area averaging algorithm.
+     *  Applies to all images scaled afterwards.
+     *
+     ** @param  threads  maximum number of threads, 0 or 1 for no parallel scaling (default)
+     */
+    static void setScaleThreads(const unsigned int threads);
+
+    /** get the number of threads used for scaling images
+     *
+     ** @return maximum number of threads, see setScaleThreads()
+     */
+    static unsigned int getScaleThreads();
+
 };
 
 
@@ -30,6 +30,8 @@
 #define INCLUDE_CMATH
 #include "dcmtk/ofstd/ofstdinc.h"
 
+#include <atomic>
+
 
 /*--------------------*
  *  global variables  *
@@ -37,6 +39,9 @@
 
 OFLogger DCM_dcmimgleLogger = OFLog::getLogger("dcmtk.dcmimgle");
 
+// read by every scaling operation, possibly set from another thread
+static std::atomic<unsigned int> ScaleThreads(1);
+
 
 /*------------------------*
  *  function definitions  *
@@ -136,3 +141,15 @@ EP_Representation DicomImageClass::determineRepresentation(double minvalue,
 #endif
     return EPR_Uint32;
 }
+
+
+void DicomImageClass::setScaleThreads(const unsigned int threads)
+{
+    ScaleThreads = (threads > 0) ? threads : 1;
+}
+
+
+unsigned int DicomImageClass::getScaleThreads()
+{
+    return ScaleThreads;
+}
@@ -25,6 +25,8 @@
 
 /* forward declaration */
 class DJPEG2KCodecParameter;
+class DcmDataset;
+struct opj_image;
 
 /** abstract codec class for JPEG-2000 decoders.
  *  This abstract class contains most of the application logic
@@ -248,6 +250,66 @@ public:
     DcmItem *dataset,
     OFString &decompressedColorModel) const;
 
+  /** decompresses a single frame of a JPEG-2000 compressed dataset at a reduced
+   *  resolution and/or for a region of the image only. Only the parts of the code
+   *  stream needed for the requested resolution level and region are decoded, which
+   *  makes previews of large images cheap. The dataset and its pixel data are not modified.
+   *  The result is always color-by-pixel with 1 byte per sample for up to 8 bits per sample
+   *  and 2 bytes per sample in local byte order otherwise.
+   *  @param dataset dataset containing JPEG-2000 compressed pixel data in its original transfer syntax
+   *  @param frameNo number of frame, starting with 0 for the first frame
+   *  @param reduce number of highest resolution levels to discard, each level halves width and height.
+   *    Limited to the number of resolution levels present in the code stream.
+   *  @param regionLeft left edge of the region, in full resolution pixels
+   *  @param regionTop top edge of the region, in full resolution pixels
+   *  @param regionWidth width of the region in full resolution pixels, 0 for up to the right edge
+   *  @param regionHeight height of the region in full resolution pixels, 0 for up to the bottom edge
+   *  @param cp codec parameters (offset table handling and number of threads), may be NULL
+   *  @param pixelData pointer to the decoded pixels, allocated with new[], on return.
+   *    Ownership is transferred to the caller.
+   *  @param pixelDataLength length of the decoded pixels in bytes on return
+   *  @param columns number of columns of the decoded image on return
+   *  @param rows number of rows of the decoded image on return
+   *  @param bytesPerSample number of bytes per sample (1 or 2) of the decoded image on return
+   *  @return EC_Normal if successful, an error code otherwise.
+   */
+  static OFCondition decodeFrameRegion(
+    DcmDataset *dataset,
+    Uint32 frameNo,
+    Uint32 reduce,
+    Uint16 regionLeft,
+    Uint16 regionTop,
+    Uint16 regionWidth,
+    Uint16 regionHeight,
+    const DJPEG2KCodecParameter *cp,
+    Uint8 *& pixelData,
+    size_t& pixelDataLength,
+    Uint16& columns,
+    Uint16& rows,
+    Uint16& bytesPerSample);
+
+  /** decoder of whole frames on another device, e.g. a GPU. It is called with the code stream
+   *  of each frame decompressed by decode() or decodeFrame() before OpenJPEG, and writes the frame
+   *  into buffer, color-by-pixel if planarConfiguration is 0, with bytesPerSample bytes per sample
+   *  in local byte order. Returns OFFalse if it cannot decode the frame, OpenJPEG decodes it then.
+   */
+  typedef OFBool (*FrameDecoder)(
+    const Uint8 *codeStream,
+    size_t length,
+    Uint16 columns,
+    Uint16 rows,
+    Uint16 samplesPerPixel,
+    Uint16 bytesPerSample,
+    Uint16 planarConfiguration,
+    void *buffer,
+    Uint32 bufSize);
+
+  /** installs a frame decoder for all JPEG-2000 decoders, NULL for none.
+   *  Must be called before frames are decompressed.
+   *  @param decoder frame decoder
+   */
+  static void setFrameDecoder(FrameDecoder decoder);
+
 private:
 
   // static private helper methods
@@ -291,6 +353,60 @@ private:
     Uint16 imageSamplesPerPixel,
     Uint16 bytesPerSample);
 
+  /** reads the code stream of a single frame from its fragments.
+   *  @param fromPixSeq compressed pixel sequence
+   *  @param cp codec parameters for this codec, may be NULL
+   *  @param frameNo number of frame, starting with 0 for the first frame
+   *  @param startFragment index of the first fragment of the frame, updated to
+   *    the first fragment of the next frame upon successful return
+   *  @param imageFrames number of frames in this image
+   *  @param codeStream code stream allocated with new[] on return, without padding
+   *  @param length length of the code stream in bytes on return
+   *  @return EC_Normal if successful, an error code otherwise.
+   */
+  static OFCondition readCodeStream(
+    DcmPixelSequence * fromPixSeq,
+    const DJPEG2KCodecParameter *cp,
+    Uint32 frameNo,
+    Uint32& startFragment,
+    Sint32 imageFrames,
+    Uint8 *& codeStream,
+    size_t& length);
+
+  /** decompresses the code stream of a single frame with OpenJPEG.
+   *  @param fromPixSeq compressed pixel sequence
+   *  @param cp codec parameters for this codec, may be NULL
+   *  @param frameNo number of frame, starting with 0 for the first frame
+   *  @param startFragment index of the first fragment of the frame, updated to
+   *    the first fragment of the next frame upon successful return
+   *  @param imageFrames number of frames in this image
+   *  @param imageColumns number of columns for each frame
+   *  @param imageRows number of rows for each frame
+   *  @param imageSamplesPerPixel number of samples per pixel
+   *  @param reduce number of highest resolution levels to discard, 0 for full resolution
+   *  @param regionLeft left edge of the region to decode
+   *  @param regionTop top edge of the region to decode
+   *  @param regionWidth width of the region to decode, 0 for up to the right edge
+   *  @param regionHeight height of the region to decode, 0 for up to the bottom edge
+   *  @param image decoded image on return, to be freed with opj_image_destroy()
+   *  @return EC_Normal if successful, an error code otherwise.
+   */
+  static OFCondition decodeImage(
+    DcmPixelSequence * fromPixSeq,
+    const DJPEG2KCodecParameter *cp,
+    Uint32 frameNo,
+    Uint32& startFragment,
+    Sint32 imageFrames,
+    Uint16 imageColumns,
+    Uint16 imageRows,
+    Uint16 imageSamplesPerPixel,
+    Uint32 reduce,
+    Uint16 regionLeft,
+    Uint16 regionTop,
+    Uint16 regionWidth,
+    Uint16 regionHeight,
+    struct opj_image *& image);
+
   /** determines if a given image requires color-by-plane planar configuration
    *  depending on SOP Class UID (DICOM IOD) and photometric interpretation.
    *  All SOP classes defined in the 2003 edition of the DICOM standard or earlier
@@ -383,7 +499,7 @@ private:
     Uint16 rows);
 };
 
-/** codec class for JPEG-2000 lossy and lossless TS decoding
+/** codec class for JPEG-2000 and High-Throughput JPEG 2000 lossy and lossless TS decoding
  */
 class FMJPEG2K_EXPORT DJPEG2KDecoder : public DJPEG2KDecoderBase
 {
@@ -258,6 +258,18 @@ private:
    */
   virtual E_TransferSyntax supportedTransferSyntax() const = 0;
 
+  /** returns true if the transfer syntax supported by this codec
+   *  only permits lossless compression
+   *  @return lossless only flag
+   */
+  OFBool isLosslessOnly() const;
+
+  /** returns true if the transfer syntax supported by this codec
+   *  uses the High-Throughput block coder of JPEG 2000 Part 15 (HTJ2K)
+   *  @return high-throughput flag
+   */
+  OFBool isHighThroughput() const;
+
   /** lossless encoder that compresses the complete pixel cell
    *  (very much like the RLE encoder in module dcmdata).
    *  @param pixelData pointer to the uncompressed image data in OW format
@@ -441,4 +453,38 @@ class FMJPEG2K_EXPORT DJPEG2KNearLosslessEncoder : public DJPEG2KEncoderBase
   virtual E_TransferSyntax supportedTransferSyntax() const;
 };
 
+/** codec class for High-Throughput JPEG 2000 lossless only TS encoding
+ */
+class FMJPEG2K_EXPORT DJPEG2KHTLosslessEncoder : public DJPEG2KEncoderBase
+{
+  /** returns the transfer syntax that this particular codec
+   *  is able to encode
+   *  @return supported transfer syntax
+   */
+  virtual E_TransferSyntax supportedTransferSyntax() const;
+};
+
+/** codec class for High-Throughput JPEG 2000 with RPCL options lossless only TS encoding.
+ *  The code-stream uses the RPCL progression order and a TLM marker segment.
+ */
+class FMJPEG2K_EXPORT DJPEG2KHTLosslessRPCLEncoder : public DJPEG2KEncoderBase
+{
+  /** returns the transfer syntax that this particular codec
+   *  is able to encode
+   *  @return supported transfer syntax
+   */
+  virtual E_TransferSyntax supportedTransferSyntax() const;
+};
+
+/** codec class for High-Throughput JPEG 2000 lossy and lossless TS encoding
+ */
+class FMJPEG2K_EXPORT DJPEG2KHTEncoder : public DJPEG2KEncoderBase
+{
+  /** returns the transfer syntax that this particular codec
+   *  is able to encode
+   *  @return supported transfer syntax
+   */
+  virtual E_TransferSyntax supportedTransferSyntax() const;
+};
+
 #endif
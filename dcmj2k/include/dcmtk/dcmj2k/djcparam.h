@@ -40,6 +40,9 @@ public:
    *  @param convertToSC               flag indicating whether image should be converted to Secondary Capture upon compression
    *  @param planarConfiguration       flag describing how planar configuration of decompressed color images should be handled
    *  @param ignoreOffsetTable         flag indicating whether to ignore the offset table when decompressing multiframe images
+   *  @param numThreads                number of OpenJPEG worker threads per codec, 0 for single threaded operation
+   *  @param qualityLayers             number of quality layers of the code-stream, 1 for a single layer
+   *  @param progressionOrder          order of the packets in the code-stream
    */
    DJPEG2KCodecParameter(
      OFBool jp2k_optionsEnabled,
@@ -51,17 +54,22 @@ public:
      J2K_UIDCreation uidCreation = EJ2KUC_default,
      OFBool convertToSC = OFFalse,
      J2K_PlanarConfiguration planarConfiguration = EJ2KPC_restore,
-     OFBool ignoreOffsetTable = OFFalse);
+     OFBool ignoreOffsetTable = OFFalse,
+     Uint16 numThreads = 0,
+     Uint16 qualityLayers = 1,
+     J2K_ProgressionOrder progressionOrder = EJ2KPO_default);
 
   /** constructor, for use with decoders. Initializes all encoder options to defaults.
    *  @param uidCreation               mode for SOP Instance UID creation (used both for encoding and decoding)
    *  @param planarConfiguration       flag describing how planar configuration of decompressed color images should be handled
    *  @param ignoreOffsetTable         flag indicating whether to ignore the offset table when decompressing multiframe images
+   *  @param numThreads                number of OpenJPEG worker threads per codec, 0 for single threaded operation
    */
   DJPEG2KCodecParameter(
     J2K_UIDCreation uidCreation = EJ2KUC_default,
     J2K_PlanarConfiguration planarConfiguration = EJ2KPC_restore,
-    OFBool ignoreOffsetTable = OFFalse);
+    OFBool ignoreOffsetTable = OFFalse,
+    Uint16 numThreads = 0);
 
   /// copy constructor
   DJPEG2KCodecParameter(const DJPEG2KCodecParameter& arg);
@@ -161,6 +169,51 @@ public:
     return ignoreOffsetTable_;
   } 
 
+  /** returns the number of OpenJPEG worker threads used for tile and code-block
+   *  parallelism of a single frame, 0 for single threaded operation
+   *  @return number of worker threads
+   */
+  Uint16 getNumThreads() const
+  {
+    return numThreads_;
+  }
+
+  /** sets the number of OpenJPEG worker threads, applies to frames encoded
+   *  or decoded afterwards
+   *  @param numThreads number of worker threads, 0 for single threaded operation
+   */
+  void setNumThreads(Uint16 numThreads)
+  {
+    numThreads_ = numThreads;
+  }
+
+  /** returns the number of quality layers of the code-streams, each one adding detail
+   *  to the ones before. Ignored by the High-Throughput encoders, which write one layer
+   *  @return number of quality layers
+   */
+  Uint16 getQualityLayers() const
+  {
+    return qualityLayers_;
+  }
+
+  /** returns the order of the packets in the code-streams
+   *  @return progression order
+   */
+  J2K_ProgressionOrder getProgressionOrder() const
+  {
+    return progressionOrder_;
+  }
+
+  /** sets the quality layers and progression order, applies to frames encoded afterwards
+   *  @param qualityLayers number of quality layers, 1 for a single layer
+   *  @param progressionOrder order of the packets in the code-stream
+   */
+  void setProgression(Uint16 qualityLayers, J2K_ProgressionOrder progressionOrder)
+  {
+    qualityLayers_ = qualityLayers;
+    progressionOrder_ = progressionOrder;
+  }
+
 private:
 
   /// private undefined copy assignment operator
@@ -193,6 +246,12 @@ private:
   /// flag indicating whether image should be converted to Secondary Capture upon compression
   OFBool convertToSC_;
 
+  /// number of quality layers of the code-stream
+  Uint16 qualityLayers_;
+
+  /// order of the packets in the code-stream
+  J2K_ProgressionOrder progressionOrder_;
+
   // ****************************************************
   // **** Parameters describing the decoding process ****
 
@@ -202,6 +261,12 @@ private:
   /// flag indicating if temporary files should be kept, false if they should be deleted after use
   OFBool ignoreOffsetTable_;
 
+  // ****************************************************
+  // **** Parameters used for encoding and decoding  ****
+
+  /// number of OpenJPEG worker threads per codec, 0 for single threaded operation
+  Uint16 numThreads_;
+
 };
 
 
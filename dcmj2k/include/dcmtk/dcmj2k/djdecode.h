@@ -20,6 +20,7 @@
 
 #include "dcmtk/config/osconfig.h"
 #include "dcmtk/ofstd/oftypes.h"      /* for OFBool */
+#include "dcmtk/dcmdata/dctypes.h"    /* for Uint16 */
 #include "djlsutil.h"  /* for enums */
 
 class DJPEG2KCodecParameter;
@@ -39,11 +40,19 @@ public:
    *  @param planarconfig flag indicating how planar configuration
    *    of color images should be encoded upon decompression.
    *  @param ignoreOffsetTable flag indicating whether to ignore the offset table when decompressing multiframe images
+   *  @param numThreads number of OpenJPEG worker threads per decoded frame, 0 for single threaded operation
    */
   static void registerCodecs(
     J2K_UIDCreation uidcreation = EJ2KUC_default,
     J2K_PlanarConfiguration planarconfig = EJ2KPC_restore,
-    OFBool ignoreOffsetTable = OFFalse);
+    OFBool ignoreOffsetTable = OFFalse,
+    Uint16 numThreads = 0);
+
+  /** sets the number of OpenJPEG worker threads used by the registered decoder.
+   *  Call is ignored if the decoder is not registered.
+   *  @param numThreads number of worker threads per decoded frame, 0 for single threaded operation
+   */
+  static void setNumThreads(Uint16 numThreads);
 
   /** deregisters decoders.
    *  Attention: Must not be called while other threads might still use
@@ -27,6 +27,9 @@
 class DJPEG2KCodecParameter;
 class DJPEG2KLosslessEncoder;
 class DJPEG2KNearLosslessEncoder;
+class DJPEG2KHTLosslessEncoder;
+class DJPEG2KHTLosslessRPCLEncoder;
+class DJPEG2KHTEncoder;
 
 /** singleton class that registers encoders for all supported JPEG 2000 processes.
  */
@@ -46,6 +49,9 @@ public:
    *  @param uidCreation               mode for SOP Instance UID creation
    *  @param convertToSC               flag indicating whether image should be converted to Secondary Capture upon compression
    *  @param jplsInterleaveMode        flag describing which interleave the JPEG-LS datastream should use
+   *  @param numThreads                number of OpenJPEG worker threads per encoded frame, 0 for single threaded operation
+   *  @param qualityLayers             number of quality layers of the code-streams, 1 for a single layer
+   *  @param progressionOrder          order of the packets in the code-streams
    */
   static void registerCodecs(
     OFBool jp2k_optionsEnabled = OFFalse,
@@ -55,7 +61,23 @@ public:
     Uint32 fragmentSize = 0,
     OFBool createOffsetTable = OFTrue,
     J2K_UIDCreation uidCreation = EJ2KUC_default,
-    OFBool convertToSC = OFFalse);
+    OFBool convertToSC = OFFalse,
+    Uint16 numThreads = 0,
+    Uint16 qualityLayers = 1,
+    J2K_ProgressionOrder progressionOrder = EJ2KPO_default);
+
+  /** sets the number of OpenJPEG worker threads used by the registered encoders.
+   *  Call is ignored if the encoders are not registered.
+   *  @param numThreads number of worker threads per encoded frame, 0 for single threaded operation
+   */
+  static void setNumThreads(Uint16 numThreads);
+
+  /** sets the quality layers and progression order of the code-streams written by the
+   *  registered encoders. Call is ignored if the encoders are not registered.
+   *  @param qualityLayers number of quality layers, 1 for a single layer
+   *  @param progressionOrder order of the packets in the code-streams
+   */
+  static void setProgression(Uint16 qualityLayers, J2K_ProgressionOrder progressionOrder);
 
   /** deregisters encoders.
    *  Attention: Must not be called while other threads might still use
@@ -84,6 +106,15 @@ private:
   /// pointer to encoder for lossy JPEG 2000
   static DJPEG2KNearLosslessEncoder *nearlosslessencoder_;
 
+  /// pointer to encoder for lossless High-Throughput JPEG 2000
+  static DJPEG2KHTLosslessEncoder *htlosslessencoder_;
+
+  /// pointer to encoder for lossless High-Throughput JPEG 2000 with RPCL options
+  static DJPEG2KHTLosslessRPCLEncoder *htlosslessrpclencoder_;
+
+  /// pointer to encoder for lossy High-Throughput JPEG 2000
+  static DJPEG2KHTEncoder *htencoder_;
+
 };
 
 #endif
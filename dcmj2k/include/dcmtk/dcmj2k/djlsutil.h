@@ -63,6 +63,30 @@ enum J2K_UIDCreation
   EJ2KUC_never
 };
 
+/** describes the order in which the encoder writes the packets of a code-stream,
+ *  i.e. what a decoder can show from its beginning.
+ */
+enum J2K_ProgressionOrder
+{
+  /// the default of the encoder (layer-resolution-component-position)
+  EJ2KPO_default,
+
+  /// layer-resolution-component-position, quality progressive
+  EJ2KPO_LRCP,
+
+  /// resolution-layer-component-position, resolution progressive
+  EJ2KPO_RLCP,
+
+  /// resolution-position-component-layer, resolution progressive
+  EJ2KPO_RPCL,
+
+  /// position-component-resolution-layer, spatially progressive
+  EJ2KPO_PCRL,
+
+  /// component-position-resolution-layer, component progressive
+  EJ2KPO_CPRL
+};
+
 /** describes how the decoder should handle planar configuration of
  *  decompressed color images.
  */
@@ -33,6 +33,7 @@
 #include "dcmtk/dcmdata/dcdatset.h"  /* for class DcmDataset */
 #include "dcmtk/dcmdata/dcdeftag.h"  /* for tag constants */
 #include "dcmtk/dcmdata/dcpixseq.h"  /* for class DcmPixelSequence */
+#include "dcmtk/dcmdata/dcpixel.h"   /* for class DcmPixelData */
 #include "dcmtk/dcmdata/dcpxitem.h"  /* for class DcmPixelItem */
 #include "dcmtk/dcmdata/dcvrpobw.h"  /* for class DcmPolymorphOBOW */
 #include "dcmtk/dcmdata/dcswap.h"    /* for swapIfNecessary() */
@@ -46,6 +47,10 @@
 #include "dcmtk/dcmj2k/memory_file.h"
 
 
+// decoder tried before OpenJPEG, see setFrameDecoder()
+static DJPEG2KDecoderBase::FrameDecoder frameDecoder = NULL;
+
+
 
 
 
@@ -60,6 +65,12 @@ DJPEG2KDecoderBase::~DJPEG2KDecoderBase()
 }
 
 
+void DJPEG2KDecoderBase::setFrameDecoder(FrameDecoder decoder)
+{
+  frameDecoder = decoder;
+}
+
+
 OFBool DJPEG2KDecoderBase::canChangeCoding(
     const E_TransferSyntax oldRepType,
     const E_TransferSyntax newRepType) const
@@ -69,7 +80,9 @@ OFBool DJPEG2KDecoderBase::canChangeCoding(
   DcmXfer newRep(newRepType);
   if (newRep.isNotEncapsulated() &&
      ((oldRepType == EXS_JPEG2000LosslessOnly)||(oldRepType == EXS_JPEG2000)||
-	  (oldRepType == EXS_JPEG2000MulticomponentLosslessOnly)||(oldRepType == EXS_JPEG2000Multicomponent)))
+	  (oldRepType == EXS_JPEG2000MulticomponentLosslessOnly)||(oldRepType == EXS_JPEG2000Multicomponent)||
+	  (oldRepType == EXS_HighThroughputJPEG2000LosslessOnly)||(oldRepType == EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly)||
+	  (oldRepType == EXS_HighThroughputJPEG2000)))
      return OFTrue;
   
   return OFFalse;
@@ -287,6 +300,107 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
   return result;
 }
 
+OFCondition DJPEG2KDecoderBase::decodeFrameRegion(
+    DcmDataset *dataset,
+    Uint32 frameNo,
+    Uint32 reduce,
+    Uint16 regionLeft,
+    Uint16 regionTop,
+    Uint16 regionWidth,
+    Uint16 regionHeight,
+    const DJPEG2KCodecParameter *cp,
+    Uint8 *& pixelData,
+    size_t& pixelDataLength,
+    Uint16& columns,
+    Uint16& rows,
+    Uint16& bytesPerSample)
+{
+  pixelData = NULL;
+  pixelDataLength = 0;
+  columns = 0;
+  rows = 0;
+  bytesPerSample = 0;
+  if (dataset == NULL) return EC_IllegalCall;
+
+  // the compressed representation the dataset was read in is decoded
+  E_TransferSyntax xfer = dataset->getOriginalXfer();
+  if ((xfer != EXS_JPEG2000LosslessOnly) && (xfer != EXS_JPEG2000) &&
+      (xfer != EXS_JPEG2000MulticomponentLosslessOnly) && (xfer != EXS_JPEG2000Multicomponent) &&
+      (xfer != EXS_HighThroughputJPEG2000LosslessOnly) && (xfer != EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly) &&
+      (xfer != EXS_HighThroughputJPEG2000))
+    return EC_CannotChangeRepresentation;
+
+  DcmElement *element = NULL;
+  if (dataset->findAndGetElement(DCM_PixelData, element).bad() || (element == NULL)) return EC_TagNotFound;
+  DcmPixelSequence *pixSeq = NULL;
+  OFCondition result = OFstatic_cast(DcmPixelData *, element)->getEncapsulatedRepresentation(xfer, NULL, pixSeq);
+  if (result.bad()) return result;
+  if (pixSeq == NULL) return EC_CannotChangeRepresentation;
+
+  // determine properties of the compressed image
+  Uint16 imageSamplesPerPixel = 0;
+  if (dataset->findAndGetUint16(DCM_SamplesPerPixel, imageSamplesPerPixel).bad()) return EC_TagNotFound;
+  if ((imageSamplesPerPixel != 3) && (imageSamplesPerPixel != 1)) return EC_InvalidTag;
+
+  Uint16 imageRows = 0;
+  if (dataset->findAndGetUint16(DCM_Rows, imageRows).bad()) return EC_TagNotFound;
+  if (imageRows < 1) return EC_InvalidTag;
+
+  Uint16 imageColumns = 0;
+  if (dataset->findAndGetUint16(DCM_Columns, imageColumns).bad()) return EC_TagNotFound;
+  if (imageColumns < 1) return EC_InvalidTag;
+
+  Sint32 imageFrames = 0;
+  dataset->findAndGetSint32(DCM_NumberOfFrames, imageFrames);
+  if (imageFrames >= OFstatic_cast(Sint32, pixSeq->card()))
+    imageFrames = OFstatic_cast(Sint32, pixSeq->card()) - 1; // limit number of frames to number of pixel items - 1
+  if (imageFrames < 1)
+    imageFrames = 1;
+  if (frameNo >= OFstatic_cast(Uint32, imageFrames)) return EC_IllegalParameter;
+
+  Uint32 currentItem = 0;
+  result = determineStartFragment(frameNo, imageFrames, pixSeq, currentItem);
+
+  opj_image_t *image = NULL;
+  if (result.good())
+  {
+    FMJPEG2K_DEBUG("JPEG-2000 decoder processes frame " << frameNo << " with reduction " << reduce);
+    result = decodeImage(pixSeq, cp, frameNo, currentItem, imageFrames, imageColumns, imageRows,
+      imageSamplesPerPixel, reduce, regionLeft, regionTop, regionWidth, regionHeight, image);
+  }
+
+  if (result.good())
+  {
+    columns = OFstatic_cast(Uint16, image->comps[0].w);
+    rows = OFstatic_cast(Uint16, image->comps[0].h);
+    bytesPerSample = (image->comps[0].prec > 8) ? 2 : 1;
+    const size_t numPixels = OFstatic_cast(size_t, columns) * rows;
+    const OPJ_UINT32 numComps = image->numcomps;
+    pixelDataLength = numPixels * numComps * bytesPerSample;
+    pixelData = new Uint8[pixelDataLength];
+
+    // interleave the component planes
+    for (OPJ_UINT32 c = 0; c < numComps; ++c)
+    {
+      const OPJ_INT32 *s = image->comps[c].data;
+      if (bytesPerSample == 1)
+      {
+        Uint8 *t = pixelData + c;
+        for (size_t i = numPixels; i; --i, t += numComps) *t = OFstatic_cast(Uint8, *s++);
+      }
+      else
+      {
+        Uint16 *t = OFreinterpret_cast(Uint16 *, pixelData) + c;
+        for (size_t i = numPixels; i; --i, t += numComps) *t = OFstatic_cast(Uint16, *s++);
+      }
+    }
+    opj_image_destroy(image);
+  }
+
+  return result;
+}
+
+
 OFCondition copyUint32ToUint8(
   opj_image_t * image,
   Uint8 *imageFrame,
@@ -325,18 +439,7 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
     Uint16 imageSamplesPerPixel,
     Uint16 bytesPerSample)
 {
-  DcmPixelItem *pixItem = NULL;
-  Uint8 * jlsData = NULL;
-  Uint8 * jlsFragmentData = NULL;
-  Uint32 fragmentLength = 0;
-  size_t compressedSize = 0;
-  Uint32 fragmentsForThisFrame = 0;
   OFCondition result = EC_Normal;
-  OFBool ignoreOffsetTable = cp->ignoreOffsetTable();
-
-  // compute the number of JPEG-LS fragments we need in order to decode the next frame
-  fragmentsForThisFrame = computeNumberOfFragments(imageFrames, frameNo, currentItem, ignoreOffsetTable, fromPixSeq);
-  if (fragmentsForThisFrame == 0) result = EC_J2KCannotComputeNumberOfFragments;
 
   // determine planar configuration for uncompressed data
   OFString imageSopClass;
@@ -369,16 +472,102 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
     }
   }
 
+  // let the frame decoder try first, OpenJPEG reads the fragments again if it declines
+  OFBool decoded = OFFalse;
+  if (frameDecoder)
+  {
+    Uint32 nextItem = currentItem;
+    Uint8 *codeStream = NULL;
+    size_t length = 0;
+    if (readCodeStream(fromPixSeq, cp, frameNo, nextItem, imageFrames, codeStream, length).good() &&
+        frameDecoder(codeStream, length, imageColumns, imageRows, imageSamplesPerPixel, bytesPerSample,
+          imagePlanarConfiguration, buffer, bufSize))
+    {
+      currentItem = nextItem;
+      decoded = OFTrue;
+    }
+    delete[] codeStream;
+  }
+
+  opj_image_t *image = NULL;
+  if (result.good() && !decoded)
+  {
+    result = decodeImage(fromPixSeq, cp, frameNo, currentItem, imageFrames, imageColumns, imageRows,
+      imageSamplesPerPixel, 0, 0, 0, 0, 0, image);
+  }
+
+  if (result.good() && !decoded)
+  {
+    // copy the image depending on planer configuration and bits
+    if (image->numcomps == 1) // Greyscale
+    {
+      if (image->comps[0].prec <= 8)
+        copyUint32ToUint8(image, OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
+      if (image->comps[0].prec > 8)
+        copyUint32ToUint16(image, OFreinterpret_cast(Uint16*, buffer), imageColumns, imageRows);
+    }
+    else if (image->numcomps == 3)
+    {
+      if (imagePlanarConfiguration == 0)
+      {
+        copyRGBUint8ToRGBUint8(image, OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
+      }
+      else if (imagePlanarConfiguration == 1)
+      {
+        copyRGBUint8ToRGBUint8Planar(image, OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
+      }
+    }
+    opj_image_destroy(image);
+  }
+
+  if (result.good())
+  {
+    // decompression is complete, finally adjust byte order if necessary
+    if (bytesPerSample == 1) // we're writing bytes into words
+    {
+      result = swapIfNecessary(gLocalByteOrder, EBO_LittleEndian, buffer,
+              bufSize, sizeof(Uint16));
+    }
+  }
+
+  return result;
+}
+
+
+OFCondition DJPEG2KDecoderBase::readCodeStream(
+    DcmPixelSequence * fromPixSeq,
+    const DJPEG2KCodecParameter *cp,
+    Uint32 frameNo,
+    Uint32& startFragment,
+    Sint32 imageFrames,
+    Uint8 *& codeStream,
+    size_t& length)
+{
+  DcmPixelItem *pixItem = NULL;
+  Uint8 * jlsData = NULL;
+  Uint8 * jlsFragmentData = NULL;
+  Uint32 fragmentLength = 0;
+  size_t compressedSize = 0;
+  Uint32 fragmentsForThisFrame = 0;
+  OFCondition result = EC_Normal;
+  OFBool ignoreOffsetTable = cp ? cp->ignoreOffsetTable() : OFFalse;
+  codeStream = NULL;
+  length = 0;
+
+  // compute the number of JPEG-2000 fragments we need in order to decode the next frame
+  fragmentsForThisFrame = computeNumberOfFragments(imageFrames, frameNo, startFragment, ignoreOffsetTable, fromPixSeq);
+  if (fragmentsForThisFrame == 0) result = EC_J2KCannotComputeNumberOfFragments;
+
   // get the size of all the fragments
   if (result.good())
   {
     // Don't modify the original values for now
     Uint32 fragmentsForThisFrame2 = fragmentsForThisFrame;
-    Uint32 currentItem2 = currentItem;
+    Uint32 startFragment2 = startFragment;
 
     while (result.good() && fragmentsForThisFrame2--)
     {
-      result = fromPixSeq->getItem(pixItem, currentItem2++);
+      result = fromPixSeq->getItem(pixItem, startFragment2++);
       if (result.good() && pixItem)
       {
         fragmentLength = pixItem->getLength();
@@ -396,7 +585,7 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
 
     while (result.good() && fragmentsForThisFrame--)
     {
-      result = fromPixSeq->getItem(pixItem, currentItem++);
+      result = fromPixSeq->getItem(pixItem, startFragment++);
       if (result.good() && pixItem)
       {
         fragmentLength = pixItem->getLength();
@@ -410,19 +599,53 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
     } /* while */
   }
 
-  if (result.good())
+  if (result.good() && compressedSize > 0)
+  {
+    // see if the last byte is a padding, otherwise, it should be 0xd9
+    if (jlsData[compressedSize - 1] == 0)
+      compressedSize--;
+    codeStream = jlsData;
+    length = compressedSize;
+  }
+  else
   {
-	// see if the last byte is a padding, otherwise, it should be 0xd9
-	if(jlsData[compressedSize - 1] == 0)
-		compressedSize--;
+    delete[] jlsData;
+    if (result.good()) result = EC_CorruptedData;
+  }
+
+  return result;
+}
+
 
+OFCondition DJPEG2KDecoderBase::decodeImage(
+    DcmPixelSequence * fromPixSeq,
+    const DJPEG2KCodecParameter *cp,
+    Uint32 frameNo,
+    Uint32& currentItem,
+    Sint32 imageFrames,
+    Uint16 imageColumns,
+    Uint16 imageRows,
+    Uint16 imageSamplesPerPixel,
+    Uint32 reduce,
+    Uint16 regionLeft,
+    Uint16 regionTop,
+    Uint16 regionWidth,
+    Uint16 regionHeight,
+    opj_image *& image)
+{
+  Uint8 * jlsData = NULL;
+  size_t compressedSize = 0;
+  image = NULL;
+  OFCondition result = readCodeStream(fromPixSeq, cp, frameNo, currentItem, imageFrames, jlsData, compressedSize);
+
+  if (result.good())
+  {
     DecodeData mysrc((unsigned char*)jlsData, compressedSize);	
 	   
 	// start of open jpeg stuff
 	opj_dparameters_t parameters;
 	opj_codec_t* l_codec = NULL;
 	opj_stream_t *l_stream = NULL;
-	opj_image_t *image = NULL;
 	
 	l_stream = opj_stream_create_memory_stream(&mysrc, OPJ_J2K_STREAM_CHUNK_SIZE, true);
 
@@ -442,6 +665,10 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
 
 	l_codec = opj_create_decompress(format);
 
+	// let OpenJPEG decode tiles and code-blocks in parallel if requested
+	if (cp && cp->getNumThreads() > 0 && opj_has_thread_support())
+		opj_codec_set_threads(l_codec, cp->getNumThreads());
+
 	opj_set_info_handler(l_codec, msg_callback, NULL);
 	opj_set_warning_handler(l_codec, msg_callback, NULL);
 	opj_set_error_handler(l_codec, msg_callback, NULL);
@@ -450,16 +677,11 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
 
 	if(!opj_setup_decoder(l_codec, &parameters))
 	{		
-		opj_stream_destroy(l_stream); l_stream = NULL;
-		opj_destroy_codec(l_codec); l_codec = NULL;
 		result = EC_CorruptedData;
 	}
 
 	if(result.good() && !opj_read_header(l_stream, l_codec, &image))
 	{
-		opj_stream_destroy(l_stream); l_stream = NULL;
-		opj_destroy_codec(l_codec); l_codec = NULL;
-		opj_image_destroy(image); image = NULL;
 		result = EC_CorruptedData;
 	}
 
@@ -472,58 +694,59 @@ OFCondition DJPEG2KDecoderBase::decodeFrame(
       //else if ((bytesPerSample == 2) && (image->bitspersample <= 8)) result = EC_J2KImageDataMismatch;
     }
 
-    if (!result.good())
+    if (result.good() && reduce > 0)
     {
-       delete[] jlsData;
+      // discard resolution levels, but keep at least the lowest one
+      opj_codestream_info_v2_t *cstrInfo = opj_get_cstr_info(l_codec);
+      if (cstrInfo && cstrInfo->m_default_tile_info.tccp_info)
+      {
+        Uint32 levels = cstrInfo->m_default_tile_info.tccp_info[0].numresolutions;
+        if (levels > 0 && reduce >= levels) reduce = levels - 1;
+      }
+      opj_destroy_cstr_info(&cstrInfo);
+      if (reduce > 0 && !opj_set_decoded_resolution_factor(l_codec, reduce))
+        result = EC_IllegalParameter;
     }
-    else
+
+    if (result.good() && (regionLeft > 0 || regionTop > 0 || regionWidth > 0 || regionHeight > 0))
     {
-	  if (!(opj_decode(l_codec, l_stream, image) && opj_end_decompress(l_codec,	l_stream))) {				
-		opj_stream_destroy(l_stream); l_stream = NULL;
-		opj_destroy_codec(l_codec); l_codec = NULL;
-		opj_image_destroy(image); image = NULL;
-		result = EC_CorruptedData;
-	  }
-            	   	        
-	  if(result.good())
-	  {
-		  // copy the image depending on planer configuration and bits
-		  if(image->numcomps == 1)	// Greyscale
-		  {
-			  if(image->comps[0].prec <= 8)
-				copyUint32ToUint8(image, OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
-			  if(image->comps[0].prec > 8)
-				copyUint32ToUint16(image, OFreinterpret_cast(Uint16*, buffer), imageColumns, imageRows);
-		  }
-		  else if(image->numcomps == 3)
-		  {
-			  if(imagePlanarConfiguration == 0)
-			  {
-				  copyRGBUint8ToRGBUint8(image, OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
-			  }
-			  else if(imagePlanarConfiguration == 1)
-			  {
-				  copyRGBUint8ToRGBUint8Planar(image, OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
-			  }
-		  }
-	  }
-
-	  opj_stream_destroy(l_stream); l_stream = NULL;
-	  opj_destroy_codec(l_codec); l_codec = NULL;
-	  opj_image_destroy(image); image = NULL;
-	  delete[] jlsData;
-      
-      if (result.good())
+      // the area is given on the full resolution reference grid
+      if (regionLeft >= imageColumns || regionTop >= imageRows) result = EC_IllegalParameter;
+      else
       {
-          // decompression is complete, finally adjust byte order if necessary
-          if (bytesPerSample == 1) // we're writing bytes into words
-          {
-              result = swapIfNecessary(gLocalByteOrder, EBO_LittleEndian, buffer,
-                      bufSize, sizeof(Uint16));
-          }
+        Uint32 right = (regionWidth == 0) ? imageColumns : OFstatic_cast(Uint32, regionLeft) + regionWidth;
+        Uint32 bottom = (regionHeight == 0) ? imageRows : OFstatic_cast(Uint32, regionTop) + regionHeight;
+        if (right > imageColumns) right = imageColumns;
+        if (bottom > imageRows) bottom = imageRows;
+        if (!opj_set_decode_area(l_codec, image, image->x0 + regionLeft, image->y0 + regionTop,
+            image->x0 + right, image->y0 + bottom))
+          result = EC_IllegalParameter;
       }
     }
+
+    if (result.good() && !(opj_decode(l_codec, l_stream, image) && opj_end_decompress(l_codec, l_stream)))
+    {
+      result = EC_CorruptedData;
+    }
+
+    if (result.good())
+    {
+      // all components must have been decoded to the same size
+      for (OPJ_UINT32 c = 1; c < image->numcomps; ++c)
+      {
+        if ((image->comps[c].w != image->comps[0].w) || (image->comps[c].h != image->comps[0].h))
+          result = EC_J2KImageDataMismatch;
+      }
+    }
+
+    opj_stream_destroy(l_stream); l_stream = NULL;
+    opj_destroy_codec(l_codec); l_codec = NULL;
+    if (result.bad())
+    {
+      opj_image_destroy(image); image = NULL;
+    }
   }
+  delete[] jlsData;
 
   return result;
 }
@@ -84,6 +84,108 @@ E_TransferSyntax DJPEG2KNearLosslessEncoder::supportedTransferSyntax() const
 	return EXS_JPEG2000;
 }
 
+E_TransferSyntax DJPEG2KHTLosslessEncoder::supportedTransferSyntax() const
+{
+	return EXS_HighThroughputJPEG2000LosslessOnly;
+}
+
+E_TransferSyntax DJPEG2KHTLosslessRPCLEncoder::supportedTransferSyntax() const
+{
+	return EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly;
+}
+
+E_TransferSyntax DJPEG2KHTEncoder::supportedTransferSyntax() const
+{
+	return EXS_HighThroughputJPEG2000;
+}
+
+/* adjusts the encoder parameters of the JPEG 2000 process to the High-Throughput
+ * JPEG 2000 transfer syntax xfer. A HT code-block is coded in a single pass which
+ * rate allocation cannot truncate, so all of it goes into one layer and the quality
+ * of lossy compression is governed by the irreversible quantization alone.
+ */
+static void setHighThroughputParameters(E_TransferSyntax xfer, OFBool lossless, opj_cparameters_t *parameters)
+{
+	// code-block style: HT block coder
+	parameters->mode |= 0x40;
+	// the terminations of the cleanup pass outweigh smaller code-blocks of noisy data
+	// beyond the buffer OpenJPEG reserves for a tile
+	const int minBlockSize = 32;
+	if (parameters->cblockw_init < minBlockSize)
+		parameters->cblockw_init = minBlockSize;
+	if (parameters->cblockh_init < minBlockSize)
+		parameters->cblockh_init = minBlockSize;
+	// a code-block holds at most 4096 samples, the longer side gives way
+	if (parameters->cblockw_init * parameters->cblockh_init > 4096)
+	{
+		if (parameters->cblockw_init > parameters->cblockh_init)
+			parameters->cblockw_init = 4096 / parameters->cblockh_init;
+		else
+			parameters->cblockh_init = 4096 / parameters->cblockw_init;
+	}
+	// colour components are kept as they are, like with the JPEG 2000 transfer syntaxes
+	parameters->tcp_mct = 0;
+	parameters->tcp_numlayers = 1;
+	parameters->tcp_rates[0] = 0;
+	parameters->cp_disto_alloc = 1;
+	parameters->cp_fixed_quality = 0;
+	if (!lossless)
+		parameters->irreversible = 1;
+	if (xfer == EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly)
+		parameters->prog_order = OPJ_RPCL;
+}
+
+/* spreads the code-stream over the quality layers of the codec parameters, each one adding
+ * detail to the ones before, and orders its packets, so a viewer can show the image once the
+ * first part of it arrived. Lossless code-streams get layers at compression ratios of 10, 20,
+ * 40, ... counted back from a last, lossless layer. Lossy ones reach the requested PSNR in the
+ * last layer, the ones before evenly spaced below it. Called before the High-Throughput
+ * adjustments, which write a single layer.
+ */
+static void setProgressionParameters(const DJPEG2KCodecParameter *djcp, opj_cparameters_t *parameters)
+{
+	// the rate allocation gets slow beyond a few layers, and viewers gain little from more
+	const int maxLayers = 16;
+	const int layers = djcp->getQualityLayers() > maxLayers ? maxLayers : OFstatic_cast(int, djcp->getQualityLayers());
+	if (layers > 1)
+	{
+		parameters->tcp_numlayers = layers;
+		if (parameters->cp_fixed_quality)
+		{
+			const float target = parameters->tcp_distoratio[0];
+			for (int i = 0; i < layers; ++i)
+				parameters->tcp_distoratio[i] = target * OFstatic_cast(float, i + 2) / OFstatic_cast(float, layers + 1);
+		}
+		else
+		{
+			float rate = 10;
+			for (int i = layers - 2; i >= 0; --i, rate *= 2)
+				parameters->tcp_rates[i] = rate;
+			parameters->tcp_rates[layers - 1] = 0;
+			parameters->cp_disto_alloc = 1;
+		}
+	}
+	switch (djcp->getProgressionOrder())
+	{
+	case EJ2KPO_LRCP: parameters->prog_order = OPJ_LRCP; break;
+	case EJ2KPO_RLCP: parameters->prog_order = OPJ_RLCP; break;
+	case EJ2KPO_RPCL: parameters->prog_order = OPJ_RPCL; break;
+	case EJ2KPO_PCRL: parameters->prog_order = OPJ_PCRL; break;
+	case EJ2KPO_CPRL: parameters->prog_order = OPJ_CPRL; break;
+	default: break;
+	}
+}
+
+/* adds the TLM marker segment the RPCL options of High-Throughput JPEG 2000 require */
+static void setHighThroughputOptions(E_TransferSyntax xfer, opj_codec_t *codec)
+{
+	if (xfer == EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly)
+	{
+		const char *options[] = { "TLM=YES", NULL };
+		opj_encoder_set_extra_options(codec, options);
+	}
+}
+
 // --------------------------------------------------------------------------
 
 DJPEG2KEncoderBase::DJPEG2KEncoderBase()
@@ -97,6 +199,22 @@ DJPEG2KEncoderBase::~DJPEG2KEncoderBase()
 }
 
 
+OFBool DJPEG2KEncoderBase::isLosslessOnly() const
+{
+	const E_TransferSyntax xfer = supportedTransferSyntax();
+	return (xfer == EXS_JPEG2000LosslessOnly) || (xfer == EXS_JPEG2000MulticomponentLosslessOnly) ||
+		(xfer == EXS_HighThroughputJPEG2000LosslessOnly) || (xfer == EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly);
+}
+
+
+OFBool DJPEG2KEncoderBase::isHighThroughput() const
+{
+	const E_TransferSyntax xfer = supportedTransferSyntax();
+	return (xfer == EXS_HighThroughputJPEG2000LosslessOnly) || (xfer == EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly) ||
+		(xfer == EXS_HighThroughputJPEG2000);
+}
+
+
 OFBool DJPEG2KEncoderBase::canChangeCoding(
 	const E_TransferSyntax oldRepType,
 	const E_TransferSyntax newRepType) const
@@ -201,7 +319,7 @@ OFCondition DJPEG2KEncoderBase::encode(
 	if (!djrp)
 		djrp = &defRep;
 
-	if (supportedTransferSyntax() == EXS_JPEG2000LosslessOnly || djrp->useLosslessProcess())
+	if (isLosslessOnly() || djrp->useLosslessProcess())
 	{
 		if (djcp->cookedEncodingPreferred())
 			result = RenderedEncode(pixelData, length, dataset, djrp, pixSeq, djcp, compressionRatio);
@@ -222,7 +340,7 @@ OFCondition DJPEG2KEncoderBase::encode(
 	{
 		if (result.good())
 		{
-			if (supportedTransferSyntax() == EXS_JPEG2000LosslessOnly || supportedTransferSyntax() == EXS_JPEG2000MulticomponentLosslessOnly || djrp->useLosslessProcess())
+			if (isLosslessOnly() || djrp->useLosslessProcess())
 			{
 				// lossless process - create new UID if mode is EUC_always or if we're converting to Secondary Capture
 				if (djcp->getConvertToSC() || (djcp->getUIDCreation() == EJ2KUC_always))
@@ -579,9 +697,9 @@ OFCondition DJPEG2KEncoderBase::losslessRawEncode(
 	}
 
 	// create offset table
-	if ((result.good()) && (djcp->getCreateOffsetTable()))
+	if (result.good())
 	{
-		result = offsetTable->createOffsetTable(offsetList);
+		result = createOffsetTables(dataset, pixSeq, offsetList, djcp->getCreateOffsetTable());
 	}
 
 	if (compressedSize > 0) compressionRatio = uncompressedSize / compressedSize;
@@ -636,12 +754,15 @@ OFCondition DJPEG2KEncoderBase::compressRawFrame(
 			parameters.cblockw_init = djcp->get_cblkwidth();
 			parameters.cblockh_init = djcp->get_cblkheight();
 		}
+		setProgressionParameters(djcp, &parameters);
 
 		// turn on/off MCT depending on transfer syntax
 		if(supportedTransferSyntax() == EXS_JPEG2000LosslessOnly)
 			parameters.tcp_mct = 0;
 		else if(supportedTransferSyntax() == EXS_JPEG2000MulticomponentLosslessOnly)
 			parameters.tcp_mct = (image->numcomps >= 3) ? 1 : 0;	
+		else if(isHighThroughput())
+			setHighThroughputParameters(supportedTransferSyntax(), OFTrue, &parameters);
 
 		// We have no idea how big the compressed pixel data will be and we have no
 		// way to find out, so we just allocate a buffer large enough for the raw data
@@ -651,6 +772,9 @@ OFCondition DJPEG2KEncoderBase::compressRawFrame(
 		// places charls fails to do proper bounds checking and writes behind the end
 		// of the buffer (sometimes way behind its end...).
 		size_t size = frameSize + 1024;
+		// HT code-blocks of noisy data exceed their raw size, OpenJPEG reserves twice of it
+		if (isHighThroughput())
+			size += frameSize;
 		Uint8 *buffer = new Uint8[size];
 
 		// Set up the information structure for OpenJPEG
@@ -658,6 +782,10 @@ OFCondition DJPEG2KEncoderBase::compressRawFrame(
 		opj_codec_t* l_codec = NULL;
 		l_codec = opj_create_compress(OPJ_CODEC_J2K);
 
+		// let OpenJPEG encode code-blocks in parallel if requested
+		if (djcp->getNumThreads() > 0 && opj_has_thread_support())
+			opj_codec_set_threads(l_codec, djcp->getNumThreads());
+
 		opj_set_info_handler(l_codec, msg_callback, NULL);
 		opj_set_warning_handler(l_codec, msg_callback, NULL);
 		opj_set_error_handler(l_codec, msg_callback, NULL);
@@ -668,6 +796,8 @@ OFCondition DJPEG2KEncoderBase::compressRawFrame(
 			l_codec = NULL;
 			result = EC_MemoryExhausted;
 		}
+		if (result.good())
+			setHighThroughputOptions(supportedTransferSyntax(), l_codec);
 
 		DecodeData mysrc((unsigned char*)buffer, size);	
 		l_stream = opj_stream_create_memory_stream(&mysrc, size, OPJ_FALSE);
@@ -816,9 +946,9 @@ OFCondition DJPEG2KEncoderBase::RenderedEncode(
 	}
 
 	// create offset table
-	if ((result.good()) && (djcp->getCreateOffsetTable()))
+	if (result.good())
 	{
-		result = offsetTable->createOffsetTable(offsetList);
+		result = createOffsetTables(dataset, pixSeq, offsetList, djcp->getCreateOffsetTable());
 	}
 
 	// adapt attributes in image pixel module
@@ -1030,12 +1160,15 @@ OFCondition DJPEG2KEncoderBase::compressRenderedFrame(
 		parameters.cblockw_init = djcp->get_cblkwidth();
 		parameters.cblockh_init = djcp->get_cblkheight();
 	}
+	setProgressionParameters(djcp, &parameters);
 
 	// turn on/off MCT depending on transfer syntax
 	if(supportedTransferSyntax() == EXS_JPEG2000)
 		parameters.tcp_mct = 0;
 	else if(supportedTransferSyntax() == EXS_JPEG2000Multicomponent)
 		parameters.tcp_mct = (image->numcomps >= 3) ? 1 : 0;
+	else if(isHighThroughput())
+		setHighThroughputParameters(supportedTransferSyntax(), isLosslessOnly() || djrp->useLosslessProcess(), &parameters);
 		
 	
 	// We have no idea how big the compressed pixel data will be and we have no
@@ -1046,6 +1179,9 @@ OFCondition DJPEG2KEncoderBase::compressRenderedFrame(
 	// places charls fails to do proper bounds checking and writes behind the end
 	// of the buffer (sometimes way behind its end...).
 	size_t compressed_buffer_size = buffer_size + 1024;
+	// HT code-blocks of noisy data exceed their raw size, OpenJPEG reserves twice of it
+	if (isHighThroughput())
+		compressed_buffer_size += buffer_size;
 	Uint8 *compressed_buffer = new Uint8[compressed_buffer_size];
 
 	// Set up the information structure for OpenJPEG
@@ -1053,6 +1189,10 @@ OFCondition DJPEG2KEncoderBase::compressRenderedFrame(
 	opj_codec_t* l_codec = NULL;
 	l_codec = opj_create_compress(OPJ_CODEC_J2K);
 
+	// let OpenJPEG encode code-blocks in parallel if requested
+	if (djcp->getNumThreads() > 0 && opj_has_thread_support())
+		opj_codec_set_threads(l_codec, djcp->getNumThreads());
+
 	opj_set_info_handler(l_codec, msg_callback, NULL);
 	opj_set_warning_handler(l_codec, msg_callback, NULL);
 	opj_set_error_handler(l_codec, msg_callback, NULL);
@@ -1062,6 +1202,8 @@ OFCondition DJPEG2KEncoderBase::compressRenderedFrame(
 		opj_destroy_codec(l_codec);       
 		result = EC_MemoryExhausted;
 	}
+	if (result.good())
+		setHighThroughputOptions(supportedTransferSyntax(), l_codec);
 
 	DecodeData mysrc((unsigned char*)compressed_buffer, compressed_buffer_size);	
 	l_stream = opj_stream_create_memory_stream(&mysrc, compressed_buffer_size, OPJ_FALSE);
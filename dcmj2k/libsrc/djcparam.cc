@@ -37,7 +37,10 @@ DJPEG2KCodecParameter::DJPEG2KCodecParameter(
      J2K_UIDCreation uidCreation,
      OFBool convertToSC,
      J2K_PlanarConfiguration planarConfiguration,
-     OFBool ignoreOffsetTble)
+     OFBool ignoreOffsetTble,
+     Uint16 numThreads,
+     Uint16 qualityLayers,
+     J2K_ProgressionOrder progressionOrder)
 : DcmCodecParameter()
 , jp2k_optionsEnabled_(jp2k_optionsEnabled)
 , jp2k_cblkwidth_(jp2k_cblkwidth)
@@ -47,8 +50,11 @@ DJPEG2KCodecParameter::DJPEG2KCodecParameter(
 , preferCookedEncoding_(preferCookedEncoding)
 , uidCreation_(uidCreation)
 , convertToSC_(convertToSC)
+, qualityLayers_(qualityLayers)
+, progressionOrder_(progressionOrder)
 , planarConfiguration_(planarConfiguration)
 , ignoreOffsetTable_(ignoreOffsetTble)
+, numThreads_(numThreads)
 {
 }
 
@@ -56,7 +62,8 @@ DJPEG2KCodecParameter::DJPEG2KCodecParameter(
 DJPEG2KCodecParameter::DJPEG2KCodecParameter(
     J2K_UIDCreation uidCreation,
     J2K_PlanarConfiguration planarConfiguration,
-    OFBool ignoreOffsetTble)
+    OFBool ignoreOffsetTble,
+    Uint16 numThreads)
 : DcmCodecParameter()
 , jp2k_optionsEnabled_(OFFalse)
 , jp2k_cblkwidth_(0)
@@ -66,8 +73,11 @@ DJPEG2KCodecParameter::DJPEG2KCodecParameter(
 , preferCookedEncoding_(OFTrue)
 , uidCreation_(uidCreation)
 , convertToSC_(OFFalse)
+, qualityLayers_(1)
+, progressionOrder_(EJ2KPO_default)
 , planarConfiguration_(planarConfiguration)
 , ignoreOffsetTable_(ignoreOffsetTble)
+, numThreads_(numThreads)
 {
 }
 
@@ -82,8 +92,11 @@ DJPEG2KCodecParameter::DJPEG2KCodecParameter(const DJPEG2KCodecParameter& arg)
 , preferCookedEncoding_(arg.preferCookedEncoding_)
 , uidCreation_(arg.uidCreation_)
 , convertToSC_(arg.convertToSC_)
+, qualityLayers_(arg.qualityLayers_)
+, progressionOrder_(arg.progressionOrder_)
 , planarConfiguration_(arg.planarConfiguration_)
 , ignoreOffsetTable_(arg.ignoreOffsetTable_)
+, numThreads_(arg.numThreads_)
 {
 }
 
@@ -37,11 +37,12 @@ DJPEG2KDecoder *FMJPEG2KDecoderRegistration::decoder_         = NULL;
 void FMJPEG2KDecoderRegistration::registerCodecs(
     J2K_UIDCreation uidcreation,
     J2K_PlanarConfiguration planarconfig,
-    OFBool ignoreOffsetTable)
+    OFBool ignoreOffsetTable,
+    Uint16 numThreads)
 {
   if (! registered_)
   {
-    cp_ = new DJPEG2KCodecParameter(uidcreation, planarconfig, ignoreOffsetTable);
+    cp_ = new DJPEG2KCodecParameter(uidcreation, planarconfig, ignoreOffsetTable, numThreads);
     if (cp_)
     {
       decoder_ = new DJPEG2KDecoder();
@@ -52,6 +53,11 @@ void FMJPEG2KDecoderRegistration::registerCodecs(
   }
 }
 
+void FMJPEG2KDecoderRegistration::setNumThreads(Uint16 numThreads)
+{
+  if (registered_ && cp_) cp_->setNumThreads(numThreads);
+}
+
 void FMJPEG2KDecoderRegistration::cleanup()
 {
   if (registered_)
@@ -34,6 +34,9 @@ OFBool FMJPEG2KEncoderRegistration::registered_                             = OF
 DJPEG2KCodecParameter *FMJPEG2KEncoderRegistration::cp_                        = NULL;
 DJPEG2KLosslessEncoder *FMJPEG2KEncoderRegistration::losslessencoder_          = NULL;
 DJPEG2KNearLosslessEncoder *FMJPEG2KEncoderRegistration::nearlosslessencoder_  = NULL;
+DJPEG2KHTLosslessEncoder *FMJPEG2KEncoderRegistration::htlosslessencoder_      = NULL;
+DJPEG2KHTLosslessRPCLEncoder *FMJPEG2KEncoderRegistration::htlosslessrpclencoder_ = NULL;
+DJPEG2KHTEncoder *FMJPEG2KEncoderRegistration::htencoder_                      = NULL;
 
 
 void FMJPEG2KEncoderRegistration::registerCodecs(
@@ -44,13 +47,16 @@ void FMJPEG2KEncoderRegistration::registerCodecs(
 	Uint32 fragmentSize,
 	OFBool createOffsetTable,
 	J2K_UIDCreation uidCreation,
-	OFBool convertToSC)
+	OFBool convertToSC,
+	Uint16 numThreads,
+	Uint16 qualityLayers,
+	J2K_ProgressionOrder progressionOrder)
 {
 	if (! registered_)
 	{
 		cp_ = new DJPEG2KCodecParameter(jp2k_optionsEnabled, jp2k_cblkwidth, jp2k_cblkheight,
 			preferCookedEncoding, fragmentSize, createOffsetTable, uidCreation, 
-			convertToSC, EJ2KPC_restore, OFFalse);
+			convertToSC, EJ2KPC_restore, OFFalse, numThreads, qualityLayers, progressionOrder);
 
 		if (cp_)
 		{
@@ -58,25 +64,50 @@ void FMJPEG2KEncoderRegistration::registerCodecs(
 			if (losslessencoder_) DcmCodecList::registerCodec(losslessencoder_, NULL, cp_);
 			nearlosslessencoder_ = new DJPEG2KNearLosslessEncoder();
 			if (nearlosslessencoder_) DcmCodecList::registerCodec(nearlosslessencoder_, NULL, cp_);
+			htlosslessencoder_ = new DJPEG2KHTLosslessEncoder();
+			if (htlosslessencoder_) DcmCodecList::registerCodec(htlosslessencoder_, NULL, cp_);
+			htlosslessrpclencoder_ = new DJPEG2KHTLosslessRPCLEncoder();
+			if (htlosslessrpclencoder_) DcmCodecList::registerCodec(htlosslessrpclencoder_, NULL, cp_);
+			htencoder_ = new DJPEG2KHTEncoder();
+			if (htencoder_) DcmCodecList::registerCodec(htencoder_, NULL, cp_);
 			registered_ = OFTrue;
 		}
 	}
 }
 
+void FMJPEG2KEncoderRegistration::setNumThreads(Uint16 numThreads)
+{
+	if (registered_ && cp_) cp_->setNumThreads(numThreads);
+}
+
+void FMJPEG2KEncoderRegistration::setProgression(Uint16 qualityLayers, J2K_ProgressionOrder progressionOrder)
+{
+	if (registered_ && cp_) cp_->setProgression(qualityLayers, progressionOrder);
+}
+
 void FMJPEG2KEncoderRegistration::cleanup()
 {
 	if (registered_)
 	{
 		DcmCodecList::deregisterCodec(losslessencoder_);
 		DcmCodecList::deregisterCodec(nearlosslessencoder_);
+		DcmCodecList::deregisterCodec(htlosslessencoder_);
+		DcmCodecList::deregisterCodec(htlosslessrpclencoder_);
+		DcmCodecList::deregisterCodec(htencoder_);
 		delete losslessencoder_;
 		delete nearlosslessencoder_;
+		delete htlosslessencoder_;
+		delete htlosslessrpclencoder_;
+		delete htencoder_;
 		delete cp_;
 		registered_ = OFFalse;
 #ifdef DEBUG
 		// not needed but useful for debugging purposes
 		losslessencoder_ = NULL;
 		nearlosslessencoder_ = NULL;
+		htlosslessencoder_ = NULL;
+		htlosslessrpclencoder_ = NULL;
+		htencoder_ = NULL;
 		cp_     = NULL;
 #endif
 	}
@@ -0,0 +1,664 @@
+//***************************************************************************/
+// This software is released under the 2-Clause BSD license, included
+// below.
+//
+// Copyright (c) 2019, Aous Naman
+// Copyright (c) 2019, Kakadu Software Pty Ltd, Australia
+// Copyright (c) 2019, The University of New South Wales, Australia
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+// IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+// TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//***************************************************************************/
+// This file is part of the OpenJpeg software implementation.
+// File: ht_enc.c
+// Based on the block encoder of OpenJPH by Aous Naman
+//***************************************************************************/
+
+//***************************************************************************/
+/** @file ht_enc.c
+ *  @brief implements HTJ2K block encoder
+ *
+ *  Only the HT cleanup pass is generated, each code-block is coded with
+ *  all its bitplanes in a single pass, which is sufficient for lossless
+ *  coding and for lossy coding by quantization alone.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "opj_includes.h"
+
+#include "t1_ht_enc_luts.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// compiler detection
+/////////////////////////////////////////////////////////////////////////////
+#ifdef _MSC_VER
+#define OPJ_COMPILER_MSVC
+#elif (defined __GNUC__)
+#define OPJ_COMPILER_GNUC
+#endif
+
+//************************************************************************/
+/** @brief Counts the number of leading zeros
+  *
+  *   @param [in]  val is the value for which leading zero count is sought,
+  *                must not be zero
+  */
+#ifdef OPJ_COMPILER_MSVC
+#pragma intrinsic(_BitScanReverse)
+#endif
+static INLINE
+OPJ_UINT32 count_leading_zeros(OPJ_UINT32 val)
+{
+#ifdef OPJ_COMPILER_MSVC
+    unsigned long result = 0;
+    _BitScanReverse(&result, val);
+    return 31U ^ (OPJ_UINT32)result;
+#elif (defined OPJ_COMPILER_GNUC)
+    return (OPJ_UINT32)__builtin_clz(val);
+#else
+    OPJ_UINT32 n = 0;
+    while ((val & 0x80000000U) == 0) {
+        val <<= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+//************************************************************************/
+/** @brief MEL exponents, the run length threshold of state k is
+  *        1 << mel_exp[k]
+  */
+static const int mel_exp[13] = { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 4, 5 };
+
+//************************************************************************/
+/** @brief UVLC prefix and suffix codewords for u values, indexed by u
+  */
+static const OPJ_UINT8 uvlc_pre[33] = {
+    0, 1, 2, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+static const OPJ_UINT8 uvlc_pre_len[33] = {
+    0, 1, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3
+};
+static const OPJ_UINT8 uvlc_suf[33] = {
+    0, 0, 0, 0, 1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+    12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27
+};
+static const OPJ_UINT8 uvlc_suf_len[33] = {
+    0, 0, 0, 1, 1, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5
+};
+
+//************************************************************************/
+/** @brief MEL state structure for encoding the MEL bitstream
+  */
+typedef struct enc_mel {
+    OPJ_UINT8* buf;        //!<the address of the buffer
+    OPJ_UINT32 pos;        //!<number of bytes written
+    int remaining_bits;    //!<bits still available in tmp
+    int tmp;               //!<the byte being assembled
+    int run;               //!<number of zero events in the current run
+    int k;                 //!<state of the MEL coder
+    int threshold;         //!<run length that emits a 1 bit
+} enc_mel_t;
+
+//************************************************************************/
+/** @brief VLC state structure, the VLC bitstream is written backwards
+  */
+typedef struct enc_vlc {
+    OPJ_UINT8* buf;        //!<the address of the last byte of the buffer
+    OPJ_UINT32 pos;        //!<number of bytes written
+    int used_bits;         //!<bits already used in tmp
+    int tmp;               //!<the byte being assembled
+    OPJ_BOOL last_gt_8F;   //!<true if the last byte written is above 0x8F
+} enc_vlc_t;
+
+//************************************************************************/
+/** @brief MagSgn state structure
+  */
+typedef struct enc_ms {
+    OPJ_UINT8* buf;        //!<the address of the buffer
+    OPJ_UINT32 pos;        //!<number of bytes written
+    int max_bits;          //!<bits that may be used in tmp, 7 after 0xFF
+    int used_bits;         //!<bits already used in tmp
+    OPJ_UINT32 tmp;        //!<the byte being assembled
+} enc_ms_t;
+
+//************************************************************************/
+static INLINE
+void mel_init(enc_mel_t* melp, OPJ_UINT8* data)
+{
+    melp->buf = data;
+    melp->pos = 0;
+    melp->remaining_bits = 8;
+    melp->tmp = 0;
+    melp->run = 0;
+    melp->k = 0;
+    melp->threshold = 1;
+}
+
+//************************************************************************/
+static INLINE
+void mel_emit_bit(enc_mel_t* melp, int v)
+{
+    melp->tmp = (melp->tmp << 1) + v;
+    melp->remaining_bits--;
+    if (melp->remaining_bits == 0) {
+        melp->buf[melp->pos++] = (OPJ_UINT8)melp->tmp;
+        melp->remaining_bits = (melp->tmp == 0xFF ? 7 : 8);
+        melp->tmp = 0;
+    }
+}
+
+//************************************************************************/
+static INLINE
+void mel_encode(enc_mel_t* melp, OPJ_BOOL bit)
+{
+    if (!bit) {
+        ++melp->run;
+        if (melp->run >= melp->threshold) {
+            mel_emit_bit(melp, 1);
+            melp->run = 0;
+            melp->k = opj_int_min(12, melp->k + 1);
+            melp->threshold = 1 << mel_exp[melp->k];
+        }
+    } else {
+        int t = mel_exp[melp->k];
+        mel_emit_bit(melp, 0);
+        while (t > 0) {
+            --t;
+            mel_emit_bit(melp, (melp->run >> t) & 1);
+        }
+        melp->run = 0;
+        melp->k = opj_int_max(0, melp->k - 1);
+        melp->threshold = 1 << mel_exp[melp->k];
+    }
+}
+
+//************************************************************************/
+static INLINE
+void vlc_init(enc_vlc_t* vlcp, OPJ_UINT8* data, OPJ_UINT32 size)
+{
+    vlcp->buf = data + size - 1;
+    vlcp->pos = 1;
+    vlcp->buf[0] = 0xFF;
+    vlcp->used_bits = 4;
+    vlcp->tmp = 0xF;
+    vlcp->last_gt_8F = OPJ_TRUE;
+}
+
+//************************************************************************/
+static INLINE
+void vlc_encode(enc_vlc_t* vlcp, int cwd, int cwd_len)
+{
+    while (cwd_len > 0) {
+        int avail_bits = 8 - (vlcp->last_gt_8F ? 1 : 0) - vlcp->used_bits;
+        int t = opj_int_min(avail_bits, cwd_len);
+        vlcp->tmp |= (cwd & ((1 << t) - 1)) << vlcp->used_bits;
+        vlcp->used_bits += t;
+        avail_bits -= t;
+        cwd_len -= t;
+        cwd >>= t;
+        if (avail_bits == 0) {
+            if (vlcp->last_gt_8F && vlcp->tmp != 0x7F) {
+                // the bit reserved for stuffing is not needed
+                vlcp->last_gt_8F = OPJ_FALSE;
+                continue;
+            }
+            *(vlcp->buf - vlcp->pos) = (OPJ_UINT8)vlcp->tmp;
+            vlcp->pos++;
+            vlcp->last_gt_8F = vlcp->tmp > 0x8F;
+            vlcp->tmp = 0;
+            vlcp->used_bits = 0;
+        }
+    }
+}
+
+//************************************************************************/
+/** @brief Terminates the MEL and VLC bitstreams, fusing their last bytes
+  *        where possible
+  */
+static INLINE
+void terminate_mel_vlc(enc_mel_t* melp, enc_vlc_t* vlcp)
+{
+    int mel_mask, vlc_mask, fuse;
+
+    if (melp->run > 0) {
+        mel_emit_bit(melp, 1);
+    }
+
+    melp->tmp = melp->tmp << melp->remaining_bits;
+    mel_mask = (0xFF << melp->remaining_bits) & 0xFF;
+    vlc_mask = 0xFF >> (8 - vlcp->used_bits);
+    if ((mel_mask | vlc_mask) == 0) {
+        return;
+    }
+
+    fuse = melp->tmp | vlcp->tmp;
+    if ((((fuse ^ melp->tmp) & mel_mask) | ((fuse ^ vlcp->tmp) & vlc_mask)) == 0
+            && fuse != 0xFF && vlcp->pos > 1) {
+        melp->buf[melp->pos++] = (OPJ_UINT8)fuse;
+    } else {
+        melp->buf[melp->pos++] = (OPJ_UINT8)melp->tmp;
+        *(vlcp->buf - vlcp->pos) = (OPJ_UINT8)vlcp->tmp;
+        vlcp->pos++;
+    }
+}
+
+//************************************************************************/
+static INLINE
+void ms_init(enc_ms_t* msp, OPJ_UINT8* data)
+{
+    msp->buf = data;
+    msp->pos = 0;
+    msp->max_bits = 8;
+    msp->used_bits = 0;
+    msp->tmp = 0;
+}
+
+//************************************************************************/
+static INLINE
+void ms_encode(enc_ms_t* msp, OPJ_UINT32 cwd, int cwd_len)
+{
+    while (cwd_len > 0) {
+        int t = opj_int_min(msp->max_bits - msp->used_bits, cwd_len);
+        msp->tmp |= (cwd & ((1U << t) - 1)) << msp->used_bits;
+        msp->used_bits += t;
+        cwd >>= t;
+        cwd_len -= t;
+        if (msp->used_bits >= msp->max_bits) {
+            msp->buf[msp->pos++] = (OPJ_UINT8)msp->tmp;
+            msp->max_bits = (msp->tmp == 0xFF) ? 7 : 8;
+            msp->tmp = 0;
+            msp->used_bits = 0;
+        }
+    }
+}
+
+//************************************************************************/
+static INLINE
+void ms_terminate(enc_ms_t* msp)
+{
+    if (msp->used_bits) {
+        int t = msp->max_bits - msp->used_bits;
+        msp->tmp |= (0xFFU & ((1U << t) - 1)) << msp->used_bits;
+        if (msp->tmp != 0xFF) {
+            msp->buf[msp->pos++] = (OPJ_UINT8)msp->tmp;
+        }
+    } else if (msp->max_bits == 7) {
+        msp->pos--;
+    }
+}
+
+//************************************************************************/
+/** @brief Reads the samples of a quad
+  *
+  *  Samples are stored as sign bit | magnitude. For each significant
+  *  sample, e_q receives the exponent of 2 * mu - 1 and s receives
+  *  2 * (mu - 1) + sign.
+  *
+  *   @param [in]  sp points to the top left sample of the quad
+  *   @param [in]  stride is the distance between two rows of samples
+  *   @param [in]  has_right is true if the quad has a second column
+  *   @param [in]  has_below is true if the quad has a second row
+  *   @param [out] e_q exponents of the 4 samples
+  *   @param [out] s magnitude and sign to code for the 4 samples
+  *   @param [out] e_qmax the largest exponent of the quad
+  *   @return rho, the significance pattern of the quad
+  */
+static INLINE
+int read_quad(const OPJ_UINT32* sp, OPJ_UINT32 stride, OPJ_BOOL has_right,
+              OPJ_BOOL has_below, int* e_q, OPJ_UINT32* s, int* e_qmax)
+{
+    OPJ_UINT32 t[4];
+    int rho = 0, i;
+
+    t[0] = sp[0];
+    t[1] = has_below ? sp[stride] : 0;
+    t[2] = has_right ? sp[1] : 0;
+    t[3] = (has_right && has_below) ? sp[stride + 1] : 0;
+    *e_qmax = 0;
+    for (i = 0; i < 4; ++i) {
+        OPJ_UINT32 val = t[i] << 1; // 2 * mu, drops the sign
+        e_q[i] = 0;
+        s[i] = 0;
+        if (val) {
+            rho |= 1 << i;
+            --val;
+            e_q[i] = 32 - (int)count_leading_zeros(val);
+            *e_qmax = opj_int_max(*e_qmax, e_q[i]);
+            s[i] = --val + (t[i] >> 31);
+        }
+    }
+    return rho;
+}
+
+//************************************************************************/
+/** @brief Computes the EMB pattern of a quad, the samples whose exponent
+  *        equals U_q, where the decoder infers the leading magnitude bit
+  */
+static INLINE
+int quad_emb(const int* e_q, int e_qmax, int u_q)
+{
+    int eps = 0;
+    if (u_q > 0) {
+        eps |= (e_q[0] == e_qmax);
+        eps |= (e_q[1] == e_qmax) << 1;
+        eps |= (e_q[2] == e_qmax) << 2;
+        eps |= (e_q[3] == e_qmax) << 3;
+    }
+    return eps;
+}
+
+//************************************************************************/
+/** @brief Writes the magnitude and sign bits of the significant samples
+  *        of a quad
+  */
+static INLINE
+void quad_magsgn(enc_ms_t* msp, const OPJ_UINT32* s, int rho, int U_q,
+                 OPJ_UINT32 tuple)
+{
+    int i;
+    for (i = 0; i < 4; ++i) {
+        if (rho & (1 << i)) {
+            int m = U_q - (int)((tuple >> i) & 1);
+            ms_encode(msp, s[i] & (OPJ_UINT32)((1ULL << m) - 1), m);
+        }
+    }
+}
+
+//************************************************************************/
+/** @brief Codes the u values of a pair of quads in a non-initial row
+  */
+static INLINE
+void encode_uvlc(enc_vlc_t* vlcp, int u_q0, int u_q1)
+{
+    vlc_encode(vlcp, uvlc_pre[u_q0], uvlc_pre_len[u_q0]);
+    vlc_encode(vlcp, uvlc_pre[u_q1], uvlc_pre_len[u_q1]);
+    vlc_encode(vlcp, uvlc_suf[u_q0], uvlc_suf_len[u_q0]);
+    vlc_encode(vlcp, uvlc_suf[u_q1], uvlc_suf_len[u_q1]);
+}
+
+//************************************************************************/
+/** @brief Encodes one code-block with the HT cleanup pass
+  *
+  *  t1->data holds the code-block in raster order with
+  *  T1_NMSEDEC_FRACBITS fractional bits. The code-block is coded as a
+  *  single cleanup pass without missing most significant bitplanes beyond
+  *  those that leave one bitplane for the pass, so cblk->numbps is set to
+  *  1 for a significant code-block and to 0 for an empty one.
+  *
+  *   @param [in]  t1 is the tier-1 handle
+  *   @param [in]  cblk is the code-block whose data and passes are set
+  *   @param [in]  qmfbid is 1 for the reversible transform, 0 otherwise
+  *   @param [out] distortion is the decrease of the squared error in units
+  *                of the squared step size
+  *   @return OPJ_FALSE if the coded data do not fit into the code-block
+  *           buffer or the limits of the codestream syntax
+  */
+OPJ_BOOL opj_t1_ht_encode_cblk(opj_t1_t *t1,
+                               opj_tcd_cblk_enc_t* cblk,
+                               OPJ_UINT32 qmfbid,
+                               OPJ_FLOAT64* distortion)
+{
+    const OPJ_UINT32 width = t1->w;
+    const OPJ_UINT32 height = t1->h;
+    const OPJ_UINT32 stride = width;
+    const OPJ_UINT32 num_quads = ((width + 1) / 2) * ((height + 1) / 2);
+    const OPJ_UINT32 ms_size = (width * height * 32) / 7 + 8;
+    const OPJ_UINT32 mel_size = num_quads * 2 + 8;
+    const OPJ_UINT32 vlc_size = num_quads * 3 + 8;
+    OPJ_UINT32* samples = (OPJ_UINT32*)t1->data;
+    OPJ_UINT32 i, x, y, max = 0;
+    OPJ_UINT32 lcup, scup;
+    OPJ_FLOAT64 dist = 0.0;
+    OPJ_UINT8 e_val[514];
+    OPJ_UINT8 cx_val[514];
+    OPJ_UINT8 *lep, *lcxp;
+    enc_mel_t mel;
+    enc_vlc_t vlc;
+    enc_ms_t ms;
+    OPJ_BYTE* out;
+
+    *distortion = 0.0;
+
+    // convert the samples to sign | magnitude of the quantization index
+    for (i = 0; i < width * height; ++i) {
+        OPJ_INT32 v = t1->data[i];
+        OPJ_UINT32 a = (OPJ_UINT32)(v < 0 ? -v : v);
+        OPJ_UINT32 mu = a >> T1_NMSEDEC_FRACBITS;
+        if (mu) {
+            const OPJ_FLOAT64 r = (OPJ_FLOAT64)a / (1 << T1_NMSEDEC_FRACBITS);
+            const OPJ_FLOAT64 e = r - (OPJ_FLOAT64)mu - (qmfbid == 1 ? 0.0 : 0.5);
+            dist += r * r - e * e;
+            max |= mu;
+        }
+        samples[i] = (v < 0 && mu ? 0x80000000U : 0) | mu;
+    }
+
+    if (max == 0) {
+        cblk->numbps = 0;
+        cblk->totalpasses = 0;
+        return OPJ_TRUE;
+    }
+    if (max >= (1U << 30)) {
+        return OPJ_FALSE;
+    }
+
+    if (ms_size + mel_size + vlc_size > t1->cblkdatabuffersize) {
+        OPJ_BYTE* buf = (OPJ_BYTE*)opj_realloc(t1->cblkdatabuffer,
+                                               ms_size + mel_size + vlc_size);
+        if (buf == NULL) {
+            return OPJ_FALSE;
+        }
+        t1->cblkdatabuffer = buf;
+        t1->cblkdatabuffersize = ms_size + mel_size + vlc_size;
+    }
+    ms_init(&ms, t1->cblkdatabuffer);
+    mel_init(&mel, t1->cblkdatabuffer + ms_size);
+    vlc_init(&vlc, t1->cblkdatabuffer + ms_size + mel_size, vlc_size);
+
+    // e_val holds the exponents of a line of quads and cx_val their
+    // significance, each entry covering the right column of one quad and
+    // the left column of the next
+    memset(e_val, 0, sizeof(e_val));
+    memset(cx_val, 0, sizeof(cx_val));
+
+    // initial row of quads
+    {
+        int c_q0 = 0;
+        lep = e_val;
+        lcxp = cx_val;
+        for (x = 0; x < width; x += 4) {
+            int e_q[8], e_qmax[2], rho[2], U_q0, u_q0, u_q1 = 0;
+            OPJ_UINT32 s[8], tuple0;
+            const OPJ_UINT32* sp = samples + x;
+
+            rho[0] = read_quad(sp, stride, x + 1 < width, height > 1,
+                               e_q, s, &e_qmax[0]);
+            U_q0 = opj_int_max(e_qmax[0], 1);
+            u_q0 = U_q0 - 1;
+            lep[0] = (OPJ_UINT8)opj_int_max(lep[0], e_q[1]);
+            lep++;
+            lep[0] = (OPJ_UINT8)e_q[3];
+            lcxp[0] = (OPJ_UINT8)(lcxp[0] | ((rho[0] & 2) >> 1));
+            lcxp++;
+            lcxp[0] = (OPJ_UINT8)((rho[0] & 8) >> 3);
+
+            tuple0 = vlc_enc_tbl0[(c_q0 << 8) + (rho[0] << 4)
+                                  + quad_emb(e_q, e_qmax[0], u_q0)];
+            vlc_encode(&vlc, (int)(tuple0 >> 8), (int)((tuple0 >> 4) & 7));
+            if (c_q0 == 0) {
+                mel_encode(&mel, rho[0] != 0);
+            }
+            quad_magsgn(&ms, s, rho[0], U_q0, tuple0);
+
+            rho[1] = 0;
+            if (x + 2 < width) {
+                int c_q1, U_q1;
+                OPJ_UINT32 tuple1;
+
+                rho[1] = read_quad(sp + 2, stride, x + 3 < width, height > 1,
+                                   e_q + 4, s + 4, &e_qmax[1]);
+                c_q1 = (rho[0] >> 1) | (rho[0] & 1);
+                U_q1 = opj_int_max(e_qmax[1], 1);
+                u_q1 = U_q1 - 1;
+                lep[0] = (OPJ_UINT8)opj_int_max(lep[0], e_q[5]);
+                lep++;
+                lep[0] = (OPJ_UINT8)e_q[7];
+                lcxp[0] = (OPJ_UINT8)(lcxp[0] | ((rho[1] & 2) >> 1));
+                lcxp++;
+                lcxp[0] = (OPJ_UINT8)((rho[1] & 8) >> 3);
+
+                tuple1 = vlc_enc_tbl0[(c_q1 << 8) + (rho[1] << 4)
+                                      + quad_emb(e_q + 4, e_qmax[1], u_q1)];
+                vlc_encode(&vlc, (int)(tuple1 >> 8), (int)((tuple1 >> 4) & 7));
+                if (c_q1 == 0) {
+                    mel_encode(&mel, rho[1] != 0);
+                }
+                quad_magsgn(&ms, s + 4, rho[1], U_q1, tuple1);
+            }
+
+            // u values of the initial row pair have their own coding
+            if (u_q0 > 0 && u_q1 > 0) {
+                mel_encode(&mel, opj_int_min(u_q0, u_q1) > 2);
+            }
+            if (u_q0 > 2 && u_q1 > 2) {
+                vlc_encode(&vlc, uvlc_pre[u_q0 - 2], uvlc_pre_len[u_q0 - 2]);
+                vlc_encode(&vlc, uvlc_pre[u_q1 - 2], uvlc_pre_len[u_q1 - 2]);
+                vlc_encode(&vlc, uvlc_suf[u_q0 - 2], uvlc_suf_len[u_q0 - 2]);
+                vlc_encode(&vlc, uvlc_suf[u_q1 - 2], uvlc_suf_len[u_q1 - 2]);
+            } else if (u_q0 > 2 && u_q1 > 0) {
+                vlc_encode(&vlc, uvlc_pre[u_q0], uvlc_pre_len[u_q0]);
+                vlc_encode(&vlc, u_q1 - 1, 1);
+                vlc_encode(&vlc, uvlc_suf[u_q0], uvlc_suf_len[u_q0]);
+            } else {
+                encode_uvlc(&vlc, u_q0, u_q1);
+            }
+
+            c_q0 = (rho[1] >> 1) | (rho[1] & 1);
+        }
+        lep[1] = 0;
+    }
+
+    // non-initial rows of quads
+    for (y = 2; y < height; y += 2) {
+        int max_e, c_q0;
+        lep = e_val;
+        max_e = opj_int_max(lep[0], lep[1]) - 1;
+        lep[0] = 0;
+        lcxp = cx_val;
+        c_q0 = lcxp[0] + (lcxp[1] << 2);
+        lcxp[0] = 0;
+
+        for (x = 0; x < width; x += 4) {
+            int e_q[8], e_qmax[2], rho[2], kappa, c_q1, U_q0, u_q0, u_q1 = 0;
+            OPJ_UINT32 s[8], tuple0;
+            const OPJ_UINT32* sp = samples + y * stride + x;
+
+            rho[0] = read_quad(sp, stride, x + 1 < width, y + 1 < height,
+                               e_q, s, &e_qmax[0]);
+            kappa = (rho[0] & (rho[0] - 1)) ? opj_int_max(1, max_e) : 1;
+            U_q0 = opj_int_max(e_qmax[0], kappa);
+            u_q0 = U_q0 - kappa;
+            lep[0] = (OPJ_UINT8)opj_int_max(lep[0], e_q[1]);
+            lep++;
+            max_e = opj_int_max(lep[0], lep[1]) - 1;
+            lep[0] = (OPJ_UINT8)e_q[3];
+            lcxp[0] = (OPJ_UINT8)(lcxp[0] | ((rho[0] & 2) >> 1));
+            lcxp++;
+            c_q1 = lcxp[0] + (lcxp[1] << 2);
+            lcxp[0] = (OPJ_UINT8)((rho[0] & 8) >> 3);
+
+            tuple0 = vlc_enc_tbl1[(c_q0 << 8) + (rho[0] << 4)
+                                  + quad_emb(e_q, e_qmax[0], u_q0)];
+            vlc_encode(&vlc, (int)(tuple0 >> 8), (int)((tuple0 >> 4) & 7));
+            if (c_q0 == 0) {
+                mel_encode(&mel, rho[0] != 0);
+            }
+            quad_magsgn(&ms, s, rho[0], U_q0, tuple0);
+
+            rho[1] = 0;
+            if (x + 2 < width) {
+                int U_q1;
+                OPJ_UINT32 tuple1;
+
+                rho[1] = read_quad(sp + 2, stride, x + 3 < width, y + 1 < height,
+                                   e_q + 4, s + 4, &e_qmax[1]);
+                c_q1 |= ((rho[0] & 4) >> 1) | ((rho[0] & 8) >> 2);
+                kappa = (rho[1] & (rho[1] - 1)) ? opj_int_max(1, max_e) : 1;
+                U_q1 = opj_int_max(e_qmax[1], kappa);
+                u_q1 = U_q1 - kappa;
+                lep[0] = (OPJ_UINT8)opj_int_max(lep[0], e_q[5]);
+                lep++;
+                max_e = opj_int_max(lep[0], lep[1]) - 1;
+                lep[0] = (OPJ_UINT8)e_q[7];
+                lcxp[0] = (OPJ_UINT8)(lcxp[0] | ((rho[1] & 2) >> 1));
+                lcxp++;
+                c_q0 = lcxp[0] + (lcxp[1] << 2);
+                lcxp[0] = (OPJ_UINT8)((rho[1] & 8) >> 3);
+
+                tuple1 = vlc_enc_tbl1[(c_q1 << 8) + (rho[1] << 4)
+                                      + quad_emb(e_q + 4, e_qmax[1], u_q1)];
+                vlc_encode(&vlc, (int)(tuple1 >> 8), (int)((tuple1 >> 4) & 7));
+                if (c_q1 == 0) {
+                    mel_encode(&mel, rho[1] != 0);
+                }
+                quad_magsgn(&ms, s + 4, rho[1], U_q1, tuple1);
+            }
+
+            encode_uvlc(&vlc, u_q0, u_q1);
+
+            c_q0 |= ((rho[1] & 4) >> 1) | ((rho[1] & 8) >> 2);
+        }
+    }
+
+    terminate_mel_vlc(&mel, &vlc);
+    ms_terminate(&ms);
+
+    // the cleanup segment is MagSgn, MEL and VLC, in this order, with the
+    // length of MEL + VLC in the last 12 bits
+    lcup = ms.pos + mel.pos + vlc.pos;
+    scup = mel.pos + vlc.pos;
+    if (lcup > cblk->data_size || scup > 4079) {
+        return OPJ_FALSE;
+    }
+    out = cblk->data;
+    memcpy(out, ms.buf, ms.pos);
+    memcpy(out + ms.pos, mel.buf, mel.pos);
+    memcpy(out + ms.pos + mel.pos, vlc.buf - vlc.pos + 1, vlc.pos);
+    out[lcup - 1] = (OPJ_BYTE)(scup >> 4);
+    out[lcup - 2] = (OPJ_BYTE)((out[lcup - 2] & 0xF0) | (scup & 0xF));
+
+    cblk->numbps = 1;
+    cblk->totalpasses = 1;
+    cblk->passes[0].rate = lcup;
+    cblk->passes[0].len = lcup;
+    cblk->passes[0].term = 1;
+    *distortion = dist;
+
+    return OPJ_TRUE;
+}
@@ -1203,6 +1203,18 @@ static OPJ_BOOL opj_j2k_read_cpf(opj_j2k_t *p_j2k,
                                  OPJ_UINT32 p_header_size,
                                  opj_event_mgr_t * p_manager);
 
+/**
+ * Writes the CAP marker (extended capabilities) announcing HT code-blocks
+ * as defined in 15444-15.
+ *
+ * @param       p_j2k           J2K codec.
+ * @param       p_stream        the stream to write data to.
+ * @param       p_manager       the user event manager.
+*/
+static OPJ_BOOL opj_j2k_write_cap(opj_j2k_t *p_j2k,
+                                  opj_stream_private_t *p_stream,
+                                  opj_event_mgr_t * p_manager);
+
 
 /**
  * Writes COC marker for each component.
@@ -5269,6 +5281,7 @@ static OPJ_BOOL opj_j2k_update_rates(opj_j2k_t *p_j2k,
     OPJ_UINT64 l_tile_size = 0;
     OPJ_UINT32 l_last_res;
     OPJ_FLOAT32(* l_tp_stride_func)(opj_tcp_t *) = 00;
+    OPJ_BOOL l_ht = OPJ_FALSE;
 
     /* preconditions */
     assert(p_j2k != 00);
@@ -5390,7 +5403,20 @@ static OPJ_BOOL opj_j2k_update_rates(opj_j2k_t *p_j2k,
     /* bin/test_tile_encoder 1 256 256 32 32 8 0 reversible_with_precinct.j2k 4 4 3 0 0 1 16 16 */
     /* TODO revise this to take into account the overhead linked to the */
     /* number of packets and number of code blocks in packets */
-    l_tile_size = (OPJ_UINT64)((double)l_tile_size * 1.4 / 8);
+    /* HT code-blocks are coded in a single cleanup pass which, on noise, */
+    /* spends the sign and about two bits of VLC and MEL code per sample on */
+    /* top of the magnitude bits, up to about 1.7 times the raw size with */
+    /* 32x32 code-blocks. */
+    l_tcp = l_cp->tcps;
+    for (i = 0; i < l_cp->th * l_cp->tw && !l_ht; ++i, ++l_tcp) {
+        for (j = 0; j < l_image->numcomps; ++j) {
+            if (l_tcp->tccps[j].cblksty & J2K_CCP_CBLKSTY_HT) {
+                l_ht = OPJ_TRUE;
+                break;
+            }
+        }
+    }
+    l_tile_size = (OPJ_UINT64)((double)l_tile_size * (l_ht ? 2.0 : 1.4) / 8);
 
     /* Arbitrary amount to make the following work: */
     /* bin/test_tile_encoder 1 256 256 17 16 8 0 reversible_no_precinct.j2k 4 4 3 0 0 1 */
@@ -6650,6 +6676,66 @@ static OPJ_BOOL opj_j2k_read_cap(opj_j2k_t *p_j2k,
     return OPJ_TRUE;
 }
 
+static OPJ_BOOL opj_j2k_write_cap(opj_j2k_t *p_j2k,
+                                  opj_stream_private_t *p_stream,
+                                  opj_event_mgr_t * p_manager)
+{
+    OPJ_BYTE l_data[10];
+    opj_tcp_t *l_tcp = 00;
+    OPJ_UINT32 l_ccap = 0x0020;
+    OPJ_INT32 l_magb = 0;
+    OPJ_UINT32 l_magbp;
+    OPJ_UINT32 l_compno, l_band_no;
+
+    /* preconditions */
+    assert(p_j2k != 00);
+    assert(p_manager != 00);
+    assert(p_stream != 00);
+
+    /* Ccap15: bit 5 is set when only reversible transforms are used, */
+    /* the low bits encode the largest magnitude bitplane count MAGB */
+    l_tcp = p_j2k->m_cp.tcps;
+    for (l_compno = 0; l_compno < p_j2k->m_private_image->numcomps; ++l_compno) {
+        const opj_tccp_t *l_tccp = &l_tcp->tccps[l_compno];
+        const OPJ_UINT32 l_numbands = (l_tccp->qntsty == J2K_CCP_QNTSTY_SIQNT) ? 1 :
+                                      l_tccp->numresolutions * 3 - 2;
+        if (l_tccp->qmfbid == 0) {
+            l_ccap = 0;
+        }
+        for (l_band_no = 0; l_band_no < l_numbands; ++l_band_no) {
+            OPJ_INT32 l_b = l_tccp->stepsizes[l_band_no].expn + (OPJ_INT32)l_tccp->numgbits;
+            if (l_tccp->qmfbid == 1) {
+                l_b -= 1;
+            } else {
+                /* decomposition level of the band */
+                l_b -= (OPJ_INT32)(l_tccp->numresolutions - 1) -
+                       (l_band_no ? (OPJ_INT32)((l_band_no - 1) / 3) : 0);
+            }
+            l_magb = opj_int_max(l_magb, l_b);
+        }
+    }
+    if (l_magb <= 8) {
+        l_magbp = 0;
+    } else if (l_magb < 28) {
+        l_magbp = (OPJ_UINT32)l_magb - 8;
+    } else if (l_magb < 48) {
+        l_magbp = 13 + ((OPJ_UINT32)l_magb >> 2);
+    } else {
+        l_magbp = 31;
+    }
+
+    opj_write_bytes(l_data, J2K_MS_CAP, 2);                  /* CAP */
+    opj_write_bytes(l_data + 2, 8, 2);                       /* Lcap */
+    opj_write_bytes(l_data + 4, 0x00020000, 4);              /* Pcap: Part 15 */
+    opj_write_bytes(l_data + 8, l_ccap | l_magbp, 2);        /* Ccap15 */
+
+    if (opj_stream_write_data(p_stream, l_data, 10, p_manager) != 10) {
+        return OPJ_FALSE;
+    }
+
+    return OPJ_TRUE;
+}
+
 /**
  * Reads a CPF marker (corresponding profile). Empty implementation. Found in HTJ2K files
  * @param       p_header_data   the data contained in the CPF box.
@@ -7871,6 +7957,10 @@ OPJ_BOOL opj_j2k_setup_encoder(opj_j2k_t *p_j2k,
     cp->m_specific_param.m_enc.m_max_comp_size = (OPJ_UINT32)
             parameters->max_comp_size;
     cp->rsiz = parameters->rsiz;
+    /* HT code-blocks require the Part 15 capability */
+    if ((parameters->mode & J2K_CCP_CBLKSTY_HT) != 0) {
+        cp->rsiz |= OPJ_PROFILE_PART15;
+    }
     cp->m_specific_param.m_enc.m_disto_alloc = (OPJ_UINT32)
             parameters->cp_disto_alloc & 1u;
     cp->m_specific_param.m_enc.m_fixed_alloc = (OPJ_UINT32)
@@ -12636,6 +12726,12 @@ static OPJ_BOOL opj_j2k_setup_header_writing(opj_j2k_t *p_j2k,
                                            (opj_procedure)opj_j2k_write_siz, p_manager)) {
         return OPJ_FALSE;
     }
+    if ((p_j2k->m_cp.rsiz & OPJ_PROFILE_PART15) != 0) {
+        if (! opj_procedure_list_add_procedure(p_j2k->m_procedure_list,
+                                               (opj_procedure)opj_j2k_write_cap, p_manager)) {
+            return OPJ_FALSE;
+        }
+    }
     if (! opj_procedure_list_add_procedure(p_j2k->m_procedure_list,
                                            (opj_procedure)opj_j2k_write_cod, p_manager)) {
         return OPJ_FALSE;
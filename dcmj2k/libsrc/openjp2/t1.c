@@ -238,6 +238,18 @@ OPJ_BOOL opj_t1_ht_decode_cblk(opj_t1_t *t1,
                                OPJ_BOOL check_pterm);
 
 
+/**
+Encode 1 code-block with the HT cleanup pass
+@param t1 T1 handle, holding the code-block samples in raster order
+@param cblk Code-block coding parameters
+@param qmfbid 1 for the reversible transform, 0 for the irreversible one
+@param distortion decrease of the squared error in units of the squared step size
+*/
+OPJ_BOOL opj_t1_ht_encode_cblk(opj_t1_t *t1,
+                               opj_tcd_cblk_enc_t* cblk,
+                               OPJ_UINT32 qmfbid,
+                               OPJ_FLOAT64* distortion);
+
 static OPJ_BOOL opj_t1_allocate_buffers(opj_t1_t *t1,
                                         OPJ_UINT32 w,
                                         OPJ_UINT32 h);
@@ -2215,6 +2227,53 @@ static void opj_t1_cblk_encode_processor(void* user_data, opj_tls_t* tls)
 
     tiledp = &tilec->data[(OPJ_SIZE_T)y * tile_w + (OPJ_SIZE_T)x];
 
+    if ((tccp->cblksty & J2K_CCP_CBLKSTY_HT) != 0) {
+        /* The HT block coder scans quads of the code-block in raster order */
+        OPJ_FLOAT64 distortion;
+        OPJ_INT32* OPJ_RESTRICT t1data = t1->data;
+        for (j = 0; j < cblk_h; ++j) {
+            if (tccp->qmfbid == 1) {
+                const OPJ_UINT32* OPJ_RESTRICT tiledp_u =
+                    (const OPJ_UINT32*) tiledp + (OPJ_SIZE_T)j * tile_w;
+                for (i = 0; i < cblk_w; ++i) {
+                    t1data[i] = (OPJ_INT32)(tiledp_u[i] << T1_NMSEDEC_FRACBITS);
+                }
+            } else {
+                const OPJ_FLOAT32* OPJ_RESTRICT tiledp_f =
+                    (const OPJ_FLOAT32*) tiledp + (OPJ_SIZE_T)j * tile_w;
+                for (i = 0; i < cblk_w; ++i) {
+                    t1data[i] = (OPJ_INT32)opj_lrintf((tiledp_f[i] / band->stepsize) *
+                                                      (1 << T1_NMSEDEC_FRACBITS));
+                }
+            }
+            t1data += cblk_w;
+        }
+
+        if (!opj_t1_ht_encode_cblk(t1, cblk, tccp->qmfbid, &distortion)) {
+            *(job->pret) = OPJ_FALSE;
+            opj_free(job);
+            return;
+        }
+        if (cblk->totalpasses) {
+            /* the weight of the band, as for a pass at bitplane 0 */
+            distortion *= opj_t1_getwmsedec(1 << 13, job->compno,
+                                            tilec->numresolutions - 1 - resno,
+                                            band->bandno, 0, tccp->qmfbid,
+                                            band->stepsize, job->tile->numcomps,
+                                            job->mct_norms, job->mct_numcomps);
+            cblk->passes[0].distortiondec = distortion;
+            if (job->mutex) {
+                opj_mutex_lock(job->mutex);
+            }
+            job->tile->distotile += distortion;
+            if (job->mutex) {
+                opj_mutex_unlock(job->mutex);
+            }
+        }
+        opj_free(job);
+        return;
+    }
+
     if (tccp->qmfbid == 1) {
         /* Do multiplication on unsigned type, even if the
             * underlying type is signed, to avoid potential
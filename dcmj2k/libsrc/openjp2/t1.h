@@ -200,10 +200,12 @@ typedef struct opj_t1 {
     OPJ_UINT32 flagssize;
     OPJ_BOOL   encoder;
 
-    /* The 3 variables below are only used by the decoder */
+    /* The 3 variables below are only used by the decoder, */
+    /* except for cblkdatabuffer which is also used by the HT encoder */
     /* set to TRUE in multithreaded context */
     OPJ_BOOL     mustuse_cblkdatabuffer;
-    /* Temporary buffer to concatenate all chunks of a codebock */
+    /* Temporary buffer to concatenate all chunks of a codebock, */
+    /* or to assemble the bitstreams of an HT code-block when encoding */
     OPJ_BYTE    *cblkdatabuffer;
     /* Maximum size available in cblkdatabuffer */
     OPJ_UINT32   cblkdatabuffersize;
@@ -209,6 +209,43 @@ private:
     Uint8 bitsPerSample,
     OFBool isYBR) const = 0;
 
+  /** decompresses a lossless JPEG frame stored in a single fragment on several
+   *  threads if the frame has restart intervals. Each interval covers whole rows
+   *  and predictions restart with it, so every interval is decompressed as an
+   *  image of its own rows, which gives the same result as serial decompression.
+   *  Does nothing if the number of threads in the codec parameters is 0 or 1,
+   *  the process is lossy or the fragment does not hold a complete frame with
+   *  restart intervals.
+   *  @param fromParam representation parameter of current compressed
+   *    representation, may be NULL.
+   *  @param pixSeq compressed pixel sequence
+   *  @param itemNo index of the fragment holding the frame
+   *  @param cp codec parameters for this codec
+   *  @param precision bit depth of the JPEG data
+   *  @param isYBR flag indicating whether DICOM photometric interpretation is YCbCr
+   *  @param buffer pointer to buffer where frame is to be stored
+   *  @param bufSize size of buffer in bytes
+   *  @param isSigned OFTrue, if uncompressed pixel data is signed, OFFalse otherwise
+   *  @param decompressedColorModel color model of the decompressed frame on return
+   *  @param result result of the decompression on return, only set if the frame was processed
+   *  @return OFTrue if the frame was processed, OFFalse if it must be decompressed serially
+   */
+  OFBool decodeRestartIntervals(
+    const DcmRepresentationParameter * fromParam,
+    DcmPixelSequence * pixSeq,
+    Uint32 itemNo,
+    const DJCodecParameter *cp,
+    Uint8 precision,
+    OFBool isYBR,
+    Uint8 *buffer,
+    Uint32 bufSize,
+    OFBool isSigned,
+    EP_Interpretation& decompressedColorModel,
+    OFCondition& result) const;
+
+  /// task decompressing consecutive restart intervals of a frame, see decodeRestartIntervals()
+  class RestartIntervalTask;
+
   // static private helper methods
 
   /** scans the given block of JPEG data for a Start of Frame marker
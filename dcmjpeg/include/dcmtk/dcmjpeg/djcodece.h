@@ -298,6 +298,9 @@ private:
     const DcmCodecParameter *cp,
     DcmStack & objStack) const;
 
+  /// task compressing single frames for encodeTrueLossless()
+  class TrueLosslessFrameTask;
+
   /** create Lossy Image Compression and Lossy Image Compression Ratio.
    *  @param dataset dataset to be modified
    *  @param ratio image compression ratio > 1. This is not the "quality factor"
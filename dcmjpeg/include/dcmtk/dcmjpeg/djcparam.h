@@ -323,6 +323,25 @@ public:
     return forceSingleFragmentPerFrame;
   }
 
+  /** returns the number of threads compressing the frames of a multi-frame image
+   *  in true lossless mode, or decompressing the restart intervals of a lossless frame
+   *  @return number of threads, 0 or 1 for serial operation
+   */
+  Uint16 getNumThreads() const
+  {
+    return numThreads;
+  }
+
+  /** sets the number of threads compressing the frames of a multi-frame image
+   *  in true lossless mode, or decompressing the restart intervals of a lossless frame.
+   *  Applies to images compressed or decompressed afterwards.
+   *  @param pNumThreads number of threads, 0 or 1 for serial operation
+   */
+  void setNumThreads(Uint16 pNumThreads)
+  {
+    numThreads = pNumThreads;
+  }
+
 private:
 
   /// private undefined copy assignment operator
@@ -427,6 +446,9 @@ private:
    */
   OFBool forceSingleFragmentPerFrame;
 
+  /// number of threads compressing frames in true lossless mode or decompressing restart intervals
+  Uint16 numThreads;
+
 };
 
 
@@ -61,6 +61,12 @@ public:
     OFBool cornellWorkaroundEnable = OFFalse,
     OFBool pForceSingleFragmentPerFrame = OFFalse);
 
+  /** changes the number of threads decompressing the restart intervals of a
+   *  lossless JPEG frame. Ignored if the decoders are not registered.
+   *  @param numThreads number of threads, 0 or 1 for serial operation
+   */
+  static void setNumThreads(Uint16 numThreads);
+
   /** deregisters decoders.
    *  Attention: Must not be called while other threads might still use
    *  the registered codecs, e.g. because they are currently decoding
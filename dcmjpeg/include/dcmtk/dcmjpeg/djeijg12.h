@@ -55,8 +55,9 @@ public:
    *  @param cp codec parameters
    *  @param prediction predictor
    *  @param ptrans point transform
+   *  @param restartRows number of image rows per restart interval, 0 for none
    */
-  DJCompressIJG12Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans);
+  DJCompressIJG12Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans, int restartRows = 0);
 
   /// destructor
   virtual ~DJCompressIJG12Bit();
@@ -159,6 +160,9 @@ private:
   /// for lossless compression, defines point transform
   int pt;
 
+  /// for lossless compression, number of image rows per restart interval, 0 for none
+  int restartRows;
+
   /// enum for mode of operation (baseline, sequential, progressive etc.)
   EJ_Mode modeofOperation;
 
@@ -51,8 +51,9 @@ public:
    *  @param cp codec parameters
    *  @param prediction predictor
    *  @param ptrans point transform
+   *  @param restartRows number of image rows per restart interval, 0 for none
    */
-  DJCompressIJG8Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans);
+  DJCompressIJG8Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans, int restartRows = 0);
 
   /// destructor
   virtual ~DJCompressIJG8Bit();
@@ -155,6 +156,9 @@ private:
   /// for lossless compression, defines point transform
   int pt;
 
+  /// for lossless compression, number of image rows per restart interval, 0 for none
+  int restartRows;
+
   /// enum for mode of operation (baseline, sequential, progressive etc.)
   EJ_Mode modeofOperation;
 
@@ -96,6 +96,12 @@ public:
     OFBool pAcrNemaCompatibility = OFFalse,
     OFBool pRealLossless = OFTrue);
 
+  /** changes the number of threads compressing the frames of a multi-frame
+   *  image in true lossless mode. Ignored if the encoders are not registered.
+   *  @param numThreads number of threads, 0 or 1 for serial operation
+   */
+  static void setNumThreads(Uint16 numThreads);
+
   /** deregisters encoders.
    *  Attention: Must not be called while other threads might still use
    *  the registered codecs, e.g. because they are currently encoding
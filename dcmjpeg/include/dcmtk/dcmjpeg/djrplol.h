@@ -35,8 +35,10 @@ public:
   /** constructor
    *  @param aPrediction prediction value
    *  @param aPt point transform value
+   *  @param aRestartRows number of image rows per restart interval, 0 for none.
+   *    Restart intervals allow a decoder to decompress the parts of a frame in parallel.
    */
-  DJ_RPLossless(int aPrediction=1, int aPt=0);
+  DJ_RPLossless(int aPrediction=1, int aPt=0, int aRestartRows=0);
 
   /// copy constructor
   DJ_RPLossless(const DJ_RPLossless& arg);
@@ -78,6 +80,14 @@ public:
     return pt;
   }
 
+  /** returns the number of image rows per restart interval
+   *  @return rows per restart interval, 0 for none
+   */
+  int getRestartRows() const
+  {
+    return restartRows;
+  }
+
 private:
 
   /// prediction value
@@ -85,6 +95,9 @@ private:
 
   /// point transform value
   int pt;
+
+  /// number of image rows per restart interval, 0 for none
+  int restartRows;
 };
 
 #endif
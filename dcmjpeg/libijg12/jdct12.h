@@ -85,6 +85,7 @@ typedef FAST_FLOAT FLOAT_MULT_TYPE; /* preferred floating type */
 #define jpeg_fdct_ifast		jpeg12_fdct_ifast
 #define jpeg_fdct_float		jpeg12_fdct_float
 #define jpeg_idct_islow		jpeg12_idct_islow
+#define jpeg_idct_islow_sse41	jpeg12_idct_islow_sse41
 #define jpeg_idct_ifast		jpeg12_idct_ifast
 #define jpeg_idct_float		jpeg12_idct_float
 #define jpeg_idct_4x4		jpeg12_idct_4x4
@@ -101,6 +102,11 @@ EXTERN(void) jpeg_fdct_float JPP((FAST_FLOAT * data));
 EXTERN(void) jpeg_idct_islow
     JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
 	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+#ifdef JSIMD_SSE41_SUPPORTED
+EXTERN(void) jpeg_idct_islow_sse41
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+#endif
 EXTERN(void) jpeg_idct_ifast
     JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
 	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
@@ -386,4 +386,229 @@ jpeg_idct_islow (j_decompress_ptr cinfo, jpeg_component_info * compptr,
   }
 }
 
+#ifdef JSIMD_SSE41_SUPPORTED
+
+/*
+ * SSE4.1 version of jpeg_idct_islow.  Each pass computes four columns (rows)
+ * at a time with exactly the same 32-bit integer arithmetic as above, so the
+ * output is identical.  The range-limiting table lookup is replaced by the
+ * equivalent sign extension of the masked value followed by clamping.
+ */
+
+#include <smmintrin.h>
+
+#define MULTIPLY_SSE(var,const)  _mm_mullo_epi32(var, _mm_set1_epi32((int) (const)))
+#define DESCALE_SSE(x,n)  _mm_srai_epi32(_mm_add_epi32(x, _mm_set1_epi32(1 << ((n)-1))), n)
+
+/* Transpose a 4x4 matrix of 32-bit values held in four registers. */
+
+#define TRANSPOSE_SSE(r0,r1,r2,r3) \
+  { __m128i t0 = _mm_unpacklo_epi32(r0, r1); \
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3); \
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1); \
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3); \
+    r0 = _mm_unpacklo_epi64(t0, t1); \
+    r1 = _mm_unpackhi_epi64(t0, t1); \
+    r2 = _mm_unpacklo_epi64(t2, t3); \
+    r3 = _mm_unpackhi_epi64(t2, t3); }
+
+
+/* One-dimensional IDCT of four columns, see jpeg_idct_islow for comments. */
+
+JSIMD_SSE41_TARGET __attribute__((always_inline)) LOCAL(__inline__ void)
+idct_islow_1d_sse41 (const __m128i * in, __m128i * out, int pass1)
+{
+  __m128i tmp0, tmp1, tmp2, tmp3;
+  __m128i tmp10, tmp11, tmp12, tmp13;
+  __m128i z1, z2, z3, z4, z5;
+
+  /* Even part */
+
+  z2 = in[2];
+  z3 = in[6];
+
+  z1 = MULTIPLY_SSE(_mm_add_epi32(z2, z3), FIX_0_541196100);
+  tmp2 = _mm_add_epi32(z1, MULTIPLY_SSE(z3, - FIX_1_847759065));
+  tmp3 = _mm_add_epi32(z1, MULTIPLY_SSE(z2, FIX_0_765366865));
+
+  tmp0 = _mm_slli_epi32(_mm_add_epi32(in[0], in[4]), CONST_BITS);
+  tmp1 = _mm_slli_epi32(_mm_sub_epi32(in[0], in[4]), CONST_BITS);
+
+  tmp10 = _mm_add_epi32(tmp0, tmp3);
+  tmp13 = _mm_sub_epi32(tmp0, tmp3);
+  tmp11 = _mm_add_epi32(tmp1, tmp2);
+  tmp12 = _mm_sub_epi32(tmp1, tmp2);
+
+  /* Odd part */
+
+  tmp0 = in[7];
+  tmp1 = in[5];
+  tmp2 = in[3];
+  tmp3 = in[1];
+
+  z1 = _mm_add_epi32(tmp0, tmp3);
+  z2 = _mm_add_epi32(tmp1, tmp2);
+  z3 = _mm_add_epi32(tmp0, tmp2);
+  z4 = _mm_add_epi32(tmp1, tmp3);
+  z5 = MULTIPLY_SSE(_mm_add_epi32(z3, z4), FIX_1_175875602);
+
+  tmp0 = MULTIPLY_SSE(tmp0, FIX_0_298631336);
+  tmp1 = MULTIPLY_SSE(tmp1, FIX_2_053119869);
+  tmp2 = MULTIPLY_SSE(tmp2, FIX_3_072711026);
+  tmp3 = MULTIPLY_SSE(tmp3, FIX_1_501321110);
+  z1 = MULTIPLY_SSE(z1, - FIX_0_899976223);
+  z2 = MULTIPLY_SSE(z2, - FIX_2_562915447);
+  z3 = MULTIPLY_SSE(z3, - FIX_1_961570560);
+  z4 = MULTIPLY_SSE(z4, - FIX_0_390180644);
+
+  z3 = _mm_add_epi32(z3, z5);
+  z4 = _mm_add_epi32(z4, z5);
+
+  tmp0 = _mm_add_epi32(tmp0, _mm_add_epi32(z1, z3));
+  tmp1 = _mm_add_epi32(tmp1, _mm_add_epi32(z2, z4));
+  tmp2 = _mm_add_epi32(tmp2, _mm_add_epi32(z2, z3));
+  tmp3 = _mm_add_epi32(tmp3, _mm_add_epi32(z1, z4));
+
+  /* Final output stage */
+
+  if (pass1) {
+    out[0] = DESCALE_SSE(_mm_add_epi32(tmp10, tmp3), CONST_BITS-PASS1_BITS);
+    out[7] = DESCALE_SSE(_mm_sub_epi32(tmp10, tmp3), CONST_BITS-PASS1_BITS);
+    out[1] = DESCALE_SSE(_mm_add_epi32(tmp11, tmp2), CONST_BITS-PASS1_BITS);
+    out[6] = DESCALE_SSE(_mm_sub_epi32(tmp11, tmp2), CONST_BITS-PASS1_BITS);
+    out[2] = DESCALE_SSE(_mm_add_epi32(tmp12, tmp1), CONST_BITS-PASS1_BITS);
+    out[5] = DESCALE_SSE(_mm_sub_epi32(tmp12, tmp1), CONST_BITS-PASS1_BITS);
+    out[3] = DESCALE_SSE(_mm_add_epi32(tmp13, tmp0), CONST_BITS-PASS1_BITS);
+    out[4] = DESCALE_SSE(_mm_sub_epi32(tmp13, tmp0), CONST_BITS-PASS1_BITS);
+  } else {
+    out[0] = DESCALE_SSE(_mm_add_epi32(tmp10, tmp3), CONST_BITS+PASS1_BITS+3);
+    out[7] = DESCALE_SSE(_mm_sub_epi32(tmp10, tmp3), CONST_BITS+PASS1_BITS+3);
+    out[1] = DESCALE_SSE(_mm_add_epi32(tmp11, tmp2), CONST_BITS+PASS1_BITS+3);
+    out[6] = DESCALE_SSE(_mm_sub_epi32(tmp11, tmp2), CONST_BITS+PASS1_BITS+3);
+    out[2] = DESCALE_SSE(_mm_add_epi32(tmp12, tmp1), CONST_BITS+PASS1_BITS+3);
+    out[5] = DESCALE_SSE(_mm_sub_epi32(tmp12, tmp1), CONST_BITS+PASS1_BITS+3);
+    out[3] = DESCALE_SSE(_mm_add_epi32(tmp13, tmp0), CONST_BITS+PASS1_BITS+3);
+    out[4] = DESCALE_SSE(_mm_sub_epi32(tmp13, tmp0), CONST_BITS+PASS1_BITS+3);
+  }
+}
+
+
+/* Range limit an output value the way range_limit[x & RANGE_MASK] does. */
+
+JSIMD_SSE41_TARGET LOCAL(__m128i)
+range_limit_sse41 (__m128i x)
+{
+  x = _mm_srai_epi32(_mm_slli_epi32(x, 30 - BITS_IN_JSAMPLE),
+		     30 - BITS_IN_JSAMPLE);
+  x = _mm_add_epi32(x, _mm_set1_epi32(CENTERJSAMPLE));
+  x = _mm_max_epi32(x, _mm_setzero_si128());
+  return _mm_min_epi32(x, _mm_set1_epi32(MAXJSAMPLE));
+}
+
+
+JSIMD_SSE41_TARGET GLOBAL(void)
+jpeg_idct_islow_sse41 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		       JCOEFPTR coef_block,
+		       JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  ISLOW_MULT_TYPE * quantptr = (ISLOW_MULT_TYPE *) compptr->dct_table;
+  __m128i in[DCTSIZE], out[DCTSIZE];
+  __m128i ws[DCTSIZE][2];	/* ws[i][j]: index i, lanes 4*j..4*j+3 */
+  __m128i r0, r1, r2, r3;
+  JSAMPROW outptr;
+  int ctr, i, j;
+
+  /* Blocks with only a DC coefficient are frequent; the result is the
+   * same as the one of the zero column and zero row shortcuts above.
+   */
+  r0 = _mm_or_si128(_mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE)),
+		    _mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE*2)));
+  r1 = _mm_or_si128(_mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE*3)),
+		    _mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE*4)));
+  r2 = _mm_or_si128(_mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE*5)),
+		    _mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE*6)));
+  r3 = _mm_or_si128(_mm_loadu_si128((const __m128i *) (coef_block + DCTSIZE*7)),
+		    _mm_srli_si128(_mm_loadu_si128((const __m128i *) coef_block), 2));
+  r0 = _mm_or_si128(_mm_or_si128(r0, r1), _mm_or_si128(r2, r3));
+  if (_mm_testz_si128(r0, r0)) {
+    int dcval = (int) (DEQUANTIZE(coef_block[0], quantptr[0]) << PASS1_BITS);
+    r0 = range_limit_sse41(DESCALE_SSE(_mm_set1_epi32(dcval), PASS1_BITS+3));
+#if BITS_IN_JSAMPLE == 8
+    r0 = _mm_packs_epi32(r0, r0);
+    r0 = _mm_packus_epi16(r0, r0);
+    for (ctr = 0; ctr < DCTSIZE; ctr++)
+      _mm_storel_epi64((__m128i *) (output_buf[ctr] + output_col), r0);
+#else
+    r0 = _mm_packus_epi32(r0, r0);
+    for (ctr = 0; ctr < DCTSIZE; ctr++)
+      _mm_storeu_si128((__m128i *) (output_buf[ctr] + output_col), r0);
+#endif
+    return;
+  }
+
+  /* Pass 1: process columns 0..3 and 4..7 from input. */
+  /* ws[row][column half] holds the results. */
+
+  for (j = 0; j < 2; j++) {
+    for (ctr = 0; ctr < DCTSIZE; ctr++) {
+      const int k = DCTSIZE*ctr + 4*j;
+      __m128i coef = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *) (coef_block + k)));
+      __m128i quant = _mm_setr_epi32((int) quantptr[k], (int) quantptr[k+1],
+				     (int) quantptr[k+2], (int) quantptr[k+3]);
+      in[ctr] = _mm_mullo_epi32(coef, quant);
+    }
+    idct_islow_1d_sse41(in, out, TRUE);
+    for (ctr = 0; ctr < DCTSIZE; ctr++)
+      ws[ctr][j] = out[ctr];
+  }
+
+  /* Transpose the four 4x4 blocks, ws[column][row half] holds the rows now. */
+
+  for (i = 0; i < 2; i++) {
+    for (j = i; j < 2; j++) {
+      r0 = ws[4*i][j]; r1 = ws[4*i+1][j]; r2 = ws[4*i+2][j]; r3 = ws[4*i+3][j];
+      TRANSPOSE_SSE(r0, r1, r2, r3);
+      if (i != j) {
+	/* swap with the mirrored block */
+	__m128i s0 = ws[4*j][i], s1 = ws[4*j+1][i], s2 = ws[4*j+2][i], s3 = ws[4*j+3][i];
+	TRANSPOSE_SSE(s0, s1, s2, s3);
+	ws[4*i][j] = s0; ws[4*i+1][j] = s1; ws[4*i+2][j] = s2; ws[4*i+3][j] = s3;
+      }
+      ws[4*j][i] = r0; ws[4*j+1][i] = r1; ws[4*j+2][i] = r2; ws[4*j+3][i] = r3;
+    }
+  }
+
+  /* Pass 2: process rows 0..3 and 4..7 from work array. */
+  /* ws[column][row half] holds the range limited results. */
+
+  for (j = 0; j < 2; j++) {
+    for (ctr = 0; ctr < DCTSIZE; ctr++)
+      in[ctr] = ws[ctr][j];
+    idct_islow_1d_sse41(in, out, FALSE);
+    for (ctr = 0; ctr < DCTSIZE; ctr++)
+      ws[ctr][j] = range_limit_sse41(out[ctr]);
+  }
+
+  /* Transpose back and store four rows at a time. */
+
+  for (j = 0; j < 2; j++) {
+    __m128i lo[4], hi[4];
+    lo[0] = ws[0][j]; lo[1] = ws[1][j]; lo[2] = ws[2][j]; lo[3] = ws[3][j];
+    hi[0] = ws[4][j]; hi[1] = ws[5][j]; hi[2] = ws[6][j]; hi[3] = ws[7][j];
+    TRANSPOSE_SSE(lo[0], lo[1], lo[2], lo[3]);
+    TRANSPOSE_SSE(hi[0], hi[1], hi[2], hi[3]);
+    for (i = 0; i < 4; i++) {
+      outptr = output_buf[4*j + i] + output_col;
+#if BITS_IN_JSAMPLE == 8
+      r0 = _mm_packs_epi32(lo[i], hi[i]);
+      _mm_storel_epi64((__m128i *) outptr, _mm_packus_epi16(r0, r0));
+#else
+      _mm_storeu_si128((__m128i *) outptr, _mm_packus_epi32(lo[i], hi[i]));
+#endif
+    }
+  }
+}
+
+#endif /* JSIMD_SSE41_SUPPORTED */
+
 #endif /* DCT_ISLOW_SUPPORTED */
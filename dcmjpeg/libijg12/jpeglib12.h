@@ -952,6 +952,7 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_idct_float                jpeg12_idct_float
 #define jpeg_idct_ifast                jpeg12_idct_ifast
 #define jpeg_idct_islow                jpeg12_idct_islow
+#define jpeg_idct_islow_sse41          jpeg12_idct_islow_sse41
 #define jpeg_input_complete            jpeg12_input_complete
 #define jpeg_make_c_derived_tbl        jpeg12_make_c_derived_tbl
 #define jpeg_make_d_derived_tbl        jpeg12_make_d_derived_tbl
@@ -172,6 +172,118 @@ rgb_ycc_convert (j_compress_ptr cinfo,
 }
 
 
+#if defined(JSIMD_SSE41_SUPPORTED) && BITS_IN_JSAMPLE == 8 && \
+    RGB_RED == 0 && RGB_GREEN == 1 && RGB_BLUE == 2 && RGB_PIXELSIZE == 3
+
+/*
+ * SSE4.1 version of rgb_ycc_convert.  Eight pixels are converted at a time
+ * with the same fixed-point arithmetic the table is built with, so the
+ * output is identical.  The remaining pixels of a row use the table.
+ */
+
+#include <smmintrin.h>
+
+/* Compute (cr * r + cg * g + cb * b + offset) >> SCALEBITS for 32-bit samples. */
+
+JSIMD_SSE41_TARGET __attribute__((always_inline)) LOCAL(__inline__ __m128i)
+rgb_ycc_4_sse41 (__m128i r, __m128i g, __m128i b,
+		 IJG_INT32 cr, IJG_INT32 cg, IJG_INT32 cb, IJG_INT32 offset)
+{
+  __m128i sum = _mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32((int) cr)),
+			      _mm_mullo_epi32(g, _mm_set1_epi32((int) cg)));
+  sum = _mm_add_epi32(sum, _mm_mullo_epi32(b, _mm_set1_epi32((int) cb)));
+  return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32((int) offset)), SCALEBITS);
+}
+
+
+/* Convert eight 8-bit samples of each color to Y, Cb and Cr. */
+
+JSIMD_SSE41_TARGET __attribute__((always_inline)) LOCAL(__inline__ void)
+rgb_ycc_8_sse41 (__m128i r8, __m128i g8, __m128i b8,
+		 JSAMPROW outptr0, JSAMPROW outptr1, JSAMPROW outptr2)
+{
+  __m128i r0 = _mm_cvtepu8_epi32(r8), r1 = _mm_cvtepu8_epi32(_mm_srli_si128(r8, 4));
+  __m128i g0 = _mm_cvtepu8_epi32(g8), g1 = _mm_cvtepu8_epi32(_mm_srli_si128(g8, 4));
+  __m128i b0 = _mm_cvtepu8_epi32(b8), b1 = _mm_cvtepu8_epi32(_mm_srli_si128(b8, 4));
+  __m128i lo, hi;
+
+  lo = rgb_ycc_4_sse41(r0, g0, b0, FIX(0.29900), FIX(0.58700), FIX(0.11400), ONE_HALF);
+  hi = rgb_ycc_4_sse41(r1, g1, b1, FIX(0.29900), FIX(0.58700), FIX(0.11400), ONE_HALF);
+  lo = _mm_packs_epi32(lo, hi);
+  _mm_storel_epi64((__m128i *) outptr0, _mm_packus_epi16(lo, lo));
+  lo = rgb_ycc_4_sse41(r0, g0, b0, -FIX(0.16874), -FIX(0.33126), FIX(0.50000),
+		       CBCR_OFFSET + ONE_HALF-1);
+  hi = rgb_ycc_4_sse41(r1, g1, b1, -FIX(0.16874), -FIX(0.33126), FIX(0.50000),
+		       CBCR_OFFSET + ONE_HALF-1);
+  lo = _mm_packs_epi32(lo, hi);
+  _mm_storel_epi64((__m128i *) outptr1, _mm_packus_epi16(lo, lo));
+  lo = rgb_ycc_4_sse41(r0, g0, b0, FIX(0.50000), -FIX(0.41869), -FIX(0.08131),
+		       CBCR_OFFSET + ONE_HALF-1);
+  hi = rgb_ycc_4_sse41(r1, g1, b1, FIX(0.50000), -FIX(0.41869), -FIX(0.08131),
+		       CBCR_OFFSET + ONE_HALF-1);
+  lo = _mm_packs_epi32(lo, hi);
+  _mm_storel_epi64((__m128i *) outptr2, _mm_packus_epi16(lo, lo));
+}
+
+
+JSIMD_SSE41_TARGET METHODDEF(void)
+rgb_ycc_convert_sse41 (j_compress_ptr cinfo,
+		       JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+		       JDIMENSION output_row, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  /* gather the red, green and blue samples of 8 pixels from 16 + 8 bytes */
+  const __m128i r_lo = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i r_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i g_lo = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i g_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i b_lo = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i b_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+  int r, g, b;
+  IJG_INT32 * ctab = cconvert->rgb_ycc_tab;
+  JSAMPROW inptr;
+  JSAMPROW outptr0, outptr1, outptr2;
+  JDIMENSION col;
+  JDIMENSION num_cols = cinfo->image_width;
+
+  while (--num_rows >= 0) {
+    inptr = *input_buf++;
+    outptr0 = output_buf[0][output_row];
+    outptr1 = output_buf[1][output_row];
+    outptr2 = output_buf[2][output_row];
+    output_row++;
+    for (col = 0; col + 8 <= num_cols; col += 8) {
+      __m128i lo = _mm_loadu_si128((const __m128i *) inptr);
+      __m128i hi = _mm_loadl_epi64((const __m128i *) (inptr + 16));
+      rgb_ycc_8_sse41(_mm_or_si128(_mm_shuffle_epi8(lo, r_lo), _mm_shuffle_epi8(hi, r_hi)),
+		      _mm_or_si128(_mm_shuffle_epi8(lo, g_lo), _mm_shuffle_epi8(hi, g_hi)),
+		      _mm_or_si128(_mm_shuffle_epi8(lo, b_lo), _mm_shuffle_epi8(hi, b_hi)),
+		      outptr0 + col, outptr1 + col, outptr2 + col);
+      inptr += 8 * RGB_PIXELSIZE;
+    }
+    for (; col < num_cols; col++) {
+      r = GETJSAMPLE(inptr[RGB_RED]);
+      g = GETJSAMPLE(inptr[RGB_GREEN]);
+      b = GETJSAMPLE(inptr[RGB_BLUE]);
+      inptr += RGB_PIXELSIZE;
+      outptr0[col] = (JSAMPLE)
+		((ctab[r+R_Y_OFF] + ctab[g+G_Y_OFF] + ctab[b+B_Y_OFF])
+		 >> SCALEBITS);
+      outptr1[col] = (JSAMPLE)
+		((ctab[r+R_CB_OFF] + ctab[g+G_CB_OFF] + ctab[b+B_CB_OFF])
+		 >> SCALEBITS);
+      outptr2[col] = (JSAMPLE)
+		((ctab[r+R_CR_OFF] + ctab[g+G_CR_OFF] + ctab[b+B_CR_OFF])
+		 >> SCALEBITS);
+    }
+  }
+}
+
+#define RGB_YCC_SSE41_SUPPORTED
+
+#endif /* JSIMD_SSE41_SUPPORTED */
+
+
 /**************** Cases other than RGB -> YCbCr **************/
 
 
@@ -422,6 +534,10 @@ jinit_color_converter (j_compress_ptr cinfo)
     if (cinfo->in_color_space == JCS_RGB) {
       cconvert->pub.start_pass = rgb_ycc_start;
       cconvert->pub.color_convert = rgb_ycc_convert;
+#ifdef RGB_YCC_SSE41_SUPPORTED
+      if (jsimd_can_sse41())
+	cconvert->pub.color_convert = rgb_ycc_convert_sse41;
+#endif
     } else if (cinfo->in_color_space == JCS_YCbCr)
       cconvert->pub.color_convert = null_convert;
     else
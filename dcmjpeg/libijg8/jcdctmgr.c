@@ -265,6 +265,69 @@ forward_DCT (j_compress_ptr cinfo, jpeg_component_info * compptr,
 }
 
 
+#if defined(JSIMD_SSE41_SUPPORTED) && BITS_IN_JSAMPLE == 8
+
+/*
+ * SSE4.1 version of forward_DCT.  The quantization divides in single
+ * precision floating point, which yields the exact integer quotient because
+ * dividend and divisor are below 2^23.
+ */
+
+#include <smmintrin.h>
+
+JSIMD_SSE41_TARGET METHODDEF(void)
+forward_DCT_sse41 (j_compress_ptr cinfo, jpeg_component_info * compptr,
+		   JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+		   JDIMENSION start_row, JDIMENSION start_col,
+		   JDIMENSION num_blocks)
+{
+  j_lossy_c_ptr lossyc = (j_lossy_c_ptr) cinfo->codec;
+  fdct_ptr fdct = (fdct_ptr) lossyc->fdct_private;
+  forward_DCT_method_ptr do_dct = fdct->do_dct;
+  DCTELEM * divisors = fdct->divisors[compptr->quant_tbl_no];
+  DCTELEM workspace[DCTSIZE2];	/* work area for FDCT subroutine */
+  const __m128i center = _mm_set1_epi32(CENTERJSAMPLE);
+  JDIMENSION bi;
+  int i;
+
+  sample_data += start_row;	/* fold in the vertical offset once */
+
+  for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
+    /* Load data into workspace, applying unsigned->signed conversion */
+    for (i = 0; i < DCTSIZE; i++) {
+      __m128i row = _mm_loadl_epi64((const __m128i *) (sample_data[i] + start_col));
+      _mm_storeu_si128((__m128i *) (workspace + DCTSIZE*i),
+		       _mm_sub_epi32(_mm_cvtepu8_epi32(row), center));
+      _mm_storeu_si128((__m128i *) (workspace + DCTSIZE*i + 4),
+		       _mm_sub_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(row, 4)), center));
+    }
+
+    /* Perform the DCT */
+    (*do_dct) (workspace);
+
+    /* Quantize/descale the coefficients, and store into coef_blocks[] */
+    for (i = 0; i < DCTSIZE2; i += 8) {
+      __m128i temp0 = _mm_loadu_si128((const __m128i *) (workspace + i));
+      __m128i temp1 = _mm_loadu_si128((const __m128i *) (workspace + i + 4));
+      __m128i qval0 = _mm_loadu_si128((const __m128i *) (divisors + i));
+      __m128i qval1 = _mm_loadu_si128((const __m128i *) (divisors + i + 4));
+      /* (|temp| + qval/2) / qval, with the sign of temp */
+      __m128i quot0 = _mm_cvttps_epi32(_mm_div_ps(
+	_mm_cvtepi32_ps(_mm_add_epi32(_mm_abs_epi32(temp0), _mm_srai_epi32(qval0, 1))),
+	_mm_cvtepi32_ps(qval0)));
+      __m128i quot1 = _mm_cvttps_epi32(_mm_div_ps(
+	_mm_cvtepi32_ps(_mm_add_epi32(_mm_abs_epi32(temp1), _mm_srai_epi32(qval1, 1))),
+	_mm_cvtepi32_ps(qval1)));
+      _mm_storeu_si128((__m128i *) (coef_blocks[bi] + i),
+		       _mm_packs_epi32(_mm_sign_epi32(quot0, temp0),
+				       _mm_sign_epi32(quot1, temp1)));
+    }
+  }
+}
+
+#endif /* JSIMD_SSE41_SUPPORTED */
+
+
 #ifdef DCT_FLOAT_SUPPORTED
 
 METHODDEF(void)
@@ -361,6 +424,12 @@ jinit_forward_dct (j_compress_ptr cinfo)
   case JDCT_ISLOW:
     lossyc->fdct_forward_DCT = forward_DCT;
     fdct->do_dct = jpeg_fdct_islow;
+#if defined(JSIMD_SSE41_SUPPORTED) && BITS_IN_JSAMPLE == 8
+    if (jsimd_can_sse41()) {
+      lossyc->fdct_forward_DCT = forward_DCT_sse41;
+      fdct->do_dct = jpeg_fdct_islow_sse41;
+    }
+#endif
     break;
 #endif
 #ifdef DCT_IFAST_SUPPORTED
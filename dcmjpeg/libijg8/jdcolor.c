@@ -174,6 +174,107 @@ ycc_rgb_convert (j_decompress_ptr cinfo,
 }
 
 
+#if defined(JSIMD_SSE41_SUPPORTED) && BITS_IN_JSAMPLE == 8 && \
+    RGB_RED == 0 && RGB_GREEN == 1 && RGB_BLUE == 2 && RGB_PIXELSIZE == 3
+
+/*
+ * SSE4.1 version of ycc_rgb_convert.  Eight pixels are converted at a time
+ * with the same fixed-point arithmetic the tables are built with, so the
+ * output is identical.  The remaining pixels of a row are converted with
+ * the tables.
+ */
+
+#include <smmintrin.h>
+
+/* Convert four pixels, y, cb and cr hold 32-bit samples. */
+
+JSIMD_SSE41_TARGET __attribute__((always_inline)) LOCAL(__inline__ void)
+ycc_rgb_4_sse41 (__m128i y, __m128i cb, __m128i cr,
+		 __m128i * r, __m128i * g, __m128i * b)
+{
+  const __m128i center = _mm_set1_epi32(CENTERJSAMPLE);
+  const __m128i half = _mm_set1_epi32((int) ONE_HALF);
+
+  cb = _mm_sub_epi32(cb, center);
+  cr = _mm_sub_epi32(cr, center);
+  *r = _mm_add_epi32(y, _mm_srai_epi32(_mm_add_epi32(
+	 _mm_mullo_epi32(cr, _mm_set1_epi32((int) FIX(1.40200))), half), SCALEBITS));
+  *b = _mm_add_epi32(y, _mm_srai_epi32(_mm_add_epi32(
+	 _mm_mullo_epi32(cb, _mm_set1_epi32((int) FIX(1.77200))), half), SCALEBITS));
+  *g = _mm_add_epi32(y, _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(
+	 _mm_mullo_epi32(cb, _mm_set1_epi32((int) - FIX(0.34414))),
+	 _mm_mullo_epi32(cr, _mm_set1_epi32((int) - FIX(0.71414)))), half), SCALEBITS));
+}
+
+
+JSIMD_SSE41_TARGET METHODDEF(void)
+ycc_rgb_convert_sse41 (j_decompress_ptr cinfo,
+		       JSAMPIMAGE input_buf, JDIMENSION input_row,
+		       JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  /* interleave 8 red and green (first register) and blue samples */
+  const __m128i rg_lo = _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+  const __m128i b_lo = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+  const __m128i rg_hi = _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i b_hi = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+  int y, cb, cr;
+  JSAMPROW outptr;
+  JSAMPROW inptr0, inptr1, inptr2;
+  JDIMENSION col;
+  JDIMENSION num_cols = cinfo->output_width;
+  JSAMPLE * range_limit = cinfo->sample_range_limit;
+  int * Crrtab = cconvert->Cr_r_tab;
+  int * Cbbtab = cconvert->Cb_b_tab;
+  IJG_INT32 * Crgtab = cconvert->Cr_g_tab;
+  IJG_INT32 * Cbgtab = cconvert->Cb_g_tab;
+  SHIFT_TEMPS
+
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr = *output_buf++;
+    for (col = 0; col + 8 <= num_cols; col += 8) {
+      __m128i y8 = _mm_loadl_epi64((const __m128i *) (inptr0 + col));
+      __m128i cb8 = _mm_loadl_epi64((const __m128i *) (inptr1 + col));
+      __m128i cr8 = _mm_loadl_epi64((const __m128i *) (inptr2 + col));
+      __m128i r0, g0, b0, r1, g1, b1, rg, bb;
+      ycc_rgb_4_sse41(_mm_cvtepu8_epi32(y8), _mm_cvtepu8_epi32(cb8),
+		      _mm_cvtepu8_epi32(cr8), &r0, &g0, &b0);
+      ycc_rgb_4_sse41(_mm_cvtepu8_epi32(_mm_srli_si128(y8, 4)),
+		      _mm_cvtepu8_epi32(_mm_srli_si128(cb8, 4)),
+		      _mm_cvtepu8_epi32(_mm_srli_si128(cr8, 4)), &r1, &g1, &b1);
+      /* range limit while packing to bytes */
+      rg = _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(g0, g1));
+      bb = _mm_packs_epi32(b0, b1);
+      bb = _mm_packus_epi16(bb, bb);
+      _mm_storeu_si128((__m128i *) outptr,
+		       _mm_or_si128(_mm_shuffle_epi8(rg, rg_lo), _mm_shuffle_epi8(bb, b_lo)));
+      _mm_storel_epi64((__m128i *) (outptr + 16),
+		       _mm_or_si128(_mm_shuffle_epi8(rg, rg_hi), _mm_shuffle_epi8(bb, b_hi)));
+      outptr += 8 * RGB_PIXELSIZE;
+    }
+    for (; col < num_cols; col++) {
+      y  = GETJSAMPLE(inptr0[col]);
+      cb = GETJSAMPLE(inptr1[col]);
+      cr = GETJSAMPLE(inptr2[col]);
+      outptr[RGB_RED] =   range_limit[y + Crrtab[cr]];
+      outptr[RGB_GREEN] = range_limit[y +
+			      ((int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr],
+						 SCALEBITS))];
+      outptr[RGB_BLUE] =  range_limit[y + Cbbtab[cb]];
+      outptr += RGB_PIXELSIZE;
+    }
+  }
+}
+
+#define YCC_RGB_SSE41_SUPPORTED
+
+#endif /* JSIMD_SSE41_SUPPORTED */
+
+
 /**************** Cases other than YCbCr -> RGB **************/
 
 
@@ -376,6 +477,10 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
     cinfo->out_color_components = RGB_PIXELSIZE;
     if (cinfo->jpeg_color_space == JCS_YCbCr) {
       cconvert->pub.color_convert = ycc_rgb_convert;
+#ifdef YCC_RGB_SSE41_SUPPORTED
+      if (jsimd_can_sse41())
+	cconvert->pub.color_convert = ycc_rgb_convert_sse41;
+#endif
       build_ycc_rgb_table(cinfo);
     } else if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
       cconvert->pub.color_convert = gray_rgb_convert;
@@ -82,9 +82,11 @@ typedef FAST_FLOAT FLOAT_MULT_TYPE; /* preferred floating type */
 
 #ifdef NEED_SHORT_EXTERNAL_NAMES
 #define jpeg_fdct_islow		jpeg8_fdct_islow
+#define jpeg_fdct_islow_sse41	jpeg8_fdct_islow_sse41
 #define jpeg_fdct_ifast		jpeg8_fdct_ifast
 #define jpeg_fdct_float		jpeg8_fdct_float
 #define jpeg_idct_islow		jpeg8_idct_islow
+#define jpeg_idct_islow_sse41	jpeg8_idct_islow_sse41
 #define jpeg_idct_ifast		jpeg8_idct_ifast
 #define jpeg_idct_float		jpeg8_idct_float
 #define jpeg_idct_4x4		jpeg8_idct_4x4
@@ -95,12 +97,20 @@ typedef FAST_FLOAT FLOAT_MULT_TYPE; /* preferred floating type */
 /* Extern declarations for the forward and inverse DCT routines. */
 
 EXTERN(void) jpeg_fdct_islow JPP((DCTELEM * data));
+#ifdef JSIMD_SSE41_SUPPORTED
+EXTERN(void) jpeg_fdct_islow_sse41 JPP((DCTELEM * data));
+#endif
 EXTERN(void) jpeg_fdct_ifast JPP((DCTELEM * data));
 EXTERN(void) jpeg_fdct_float JPP((FAST_FLOAT * data));
 
 EXTERN(void) jpeg_idct_islow
     JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
 	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+#ifdef JSIMD_SSE41_SUPPORTED
+EXTERN(void) jpeg_idct_islow_sse41
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+#endif
 EXTERN(void) jpeg_idct_ifast
     JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
 	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
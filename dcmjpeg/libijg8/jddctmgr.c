@@ -117,6 +117,11 @@ start_pass (j_decompress_ptr cinfo)
       switch (cinfo->dct_method) {
 #ifdef DCT_ISLOW_SUPPORTED
       case JDCT_ISLOW:
+#ifdef JSIMD_SSE41_SUPPORTED
+	if (jsimd_can_sse41())
+	  method_ptr = jpeg_idct_islow_sse41;
+	else
+#endif
 	method_ptr = jpeg_idct_islow;
 	method = JDCT_ISLOW;
 	break;
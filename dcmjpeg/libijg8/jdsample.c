@@ -333,6 +333,70 @@ h2v1_fancy_upsample (j_decompress_ptr cinfo, jpeg_component_info * compptr,
 }
 
 
+#if defined(JSIMD_SSE41_SUPPORTED) && BITS_IN_JSAMPLE == 8
+
+/*
+ * SSE4.1 version of h2v1_fancy_upsample, computing 16 output samples at a
+ * time.  The first and last columns and the rest of a row are processed as
+ * above.
+ */
+
+#include <smmintrin.h>
+
+JSIMD_SSE41_TARGET METHODDEF(void)
+h2v1_fancy_upsample_sse41 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+			   JSAMPARRAY input_data, JSAMPARRAY * output_data_ptr)
+{
+  JSAMPARRAY output_data = *output_data_ptr;
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i two = _mm_set1_epi16(2);
+  JSAMPROW inptr, outptr;
+  int invalue;
+  JDIMENSION colctr;
+  int inrow;
+
+  for (inrow = 0; inrow < cinfo->max_v_samp_factor; inrow++) {
+    inptr = input_data[inrow];
+    outptr = output_data[inrow];
+    /* Special case for first column */
+    invalue = GETJSAMPLE(*inptr++);
+    *outptr++ = (JSAMPLE) invalue;
+    *outptr++ = (JSAMPLE) ((invalue * 3 + GETJSAMPLE(*inptr) + 2) >> 2);
+
+    colctr = compptr->downsampled_width - 2;
+    for (; colctr >= 8; colctr -= 8) {
+      __m128i prev = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (inptr - 1)));
+      __m128i cur = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) inptr));
+      __m128i next = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (inptr + 1)));
+      __m128i even, odd;
+      cur = _mm_add_epi16(cur, _mm_add_epi16(cur, cur));
+      even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(cur, prev), one), 2);
+      odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(cur, next), two), 2);
+      _mm_storeu_si128((__m128i *) outptr,
+		       _mm_packus_epi16(_mm_unpacklo_epi16(even, odd),
+					_mm_unpackhi_epi16(even, odd)));
+      inptr += 8;
+      outptr += 16;
+    }
+    for (; colctr > 0; colctr--) {
+      /* General case: 3/4 * nearer pixel + 1/4 * further pixel */
+      invalue = GETJSAMPLE(*inptr++) * 3;
+      *outptr++ = (JSAMPLE) ((invalue + GETJSAMPLE(inptr[-2]) + 1) >> 2);
+      *outptr++ = (JSAMPLE) ((invalue + GETJSAMPLE(*inptr) + 2) >> 2);
+    }
+
+    /* Special case for last column */
+    invalue = GETJSAMPLE(*inptr);
+    *outptr++ = (JSAMPLE) ((invalue * 3 + GETJSAMPLE(inptr[-1]) + 1) >> 2);
+    *outptr++ = (JSAMPLE) invalue;
+  }
+}
+
+#define H2V1_FANCY_SSE41_SUPPORTED
+
+#endif /* JSIMD_SSE41_SUPPORTED */
+
+
 /*
  * Fancy processing for the common case of 2:1 horizontal and 2:1 vertical.
  * Again a triangle filter; see comments for h2v1 case, above.
@@ -447,9 +511,13 @@ jinit_upsampler (j_decompress_ptr cinfo)
     } else if (h_in_group * 2 == h_out_group &&
            v_in_group == v_out_group) {
       /* Special cases for 2h1v upsampling */
-      if (do_fancy && compptr->downsampled_width > 2)
+      if (do_fancy && compptr->downsampled_width > 2) {
     upsample->methods[ci] = h2v1_fancy_upsample;
-      else
+#ifdef H2V1_FANCY_SSE41_SUPPORTED
+    if (jsimd_can_sse41())
+      upsample->methods[ci] = h2v1_fancy_upsample_sse41;
+#endif
+      } else
     upsample->methods[ci] = h2v1_upsample;
     } else if (h_in_group * 2 == h_out_group &&
            v_in_group * 2 == v_out_group) {
@@ -280,4 +280,152 @@ jpeg_fdct_islow (DCTELEM * data)
   }
 }
 
+#if defined(JSIMD_SSE41_SUPPORTED) && BITS_IN_JSAMPLE == 8
+
+/*
+ * SSE4.1 version of jpeg_fdct_islow.  Each pass computes four rows (columns)
+ * at a time with exactly the same 32-bit integer arithmetic as above, so the
+ * output is identical.
+ */
+
+#include <smmintrin.h>
+
+#define MULTIPLY_SSE(var,const)  _mm_mullo_epi32(var, _mm_set1_epi32((int) (const)))
+#define DESCALE_SSE(x,n)  _mm_srai_epi32(_mm_add_epi32(x, _mm_set1_epi32(1 << ((n)-1))), n)
+
+/* Transpose a 4x4 matrix of 32-bit values held in four registers. */
+
+#define TRANSPOSE_SSE(r0,r1,r2,r3) \
+  { __m128i t0 = _mm_unpacklo_epi32(r0, r1); \
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3); \
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1); \
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3); \
+    r0 = _mm_unpacklo_epi64(t0, t1); \
+    r1 = _mm_unpackhi_epi64(t0, t1); \
+    r2 = _mm_unpacklo_epi64(t2, t3); \
+    r3 = _mm_unpackhi_epi64(t2, t3); }
+
+
+/* One-dimensional DCT of four rows, see jpeg_fdct_islow for comments. */
+
+JSIMD_SSE41_TARGET __attribute__((always_inline)) LOCAL(__inline__ void)
+fdct_islow_1d_sse41 (const __m128i * in, __m128i * out, int pass1)
+{
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  __m128i tmp10, tmp11, tmp12, tmp13;
+  __m128i z1, z2, z3, z4, z5;
+
+  tmp0 = _mm_add_epi32(in[0], in[7]);
+  tmp7 = _mm_sub_epi32(in[0], in[7]);
+  tmp1 = _mm_add_epi32(in[1], in[6]);
+  tmp6 = _mm_sub_epi32(in[1], in[6]);
+  tmp2 = _mm_add_epi32(in[2], in[5]);
+  tmp5 = _mm_sub_epi32(in[2], in[5]);
+  tmp3 = _mm_add_epi32(in[3], in[4]);
+  tmp4 = _mm_sub_epi32(in[3], in[4]);
+
+  /* Even part */
+
+  tmp10 = _mm_add_epi32(tmp0, tmp3);
+  tmp13 = _mm_sub_epi32(tmp0, tmp3);
+  tmp11 = _mm_add_epi32(tmp1, tmp2);
+  tmp12 = _mm_sub_epi32(tmp1, tmp2);
+
+  z1 = MULTIPLY_SSE(_mm_add_epi32(tmp12, tmp13), FIX_0_541196100);
+  tmp12 = _mm_add_epi32(z1, MULTIPLY_SSE(tmp12, - FIX_1_847759065));
+  tmp13 = _mm_add_epi32(z1, MULTIPLY_SSE(tmp13, FIX_0_765366865));
+
+  if (pass1) {
+    out[0] = _mm_slli_epi32(_mm_add_epi32(tmp10, tmp11), PASS1_BITS);
+    out[4] = _mm_slli_epi32(_mm_sub_epi32(tmp10, tmp11), PASS1_BITS);
+    out[2] = DESCALE_SSE(tmp13, CONST_BITS-PASS1_BITS);
+    out[6] = DESCALE_SSE(tmp12, CONST_BITS-PASS1_BITS);
+  } else {
+    out[0] = DESCALE_SSE(_mm_add_epi32(tmp10, tmp11), PASS1_BITS);
+    out[4] = DESCALE_SSE(_mm_sub_epi32(tmp10, tmp11), PASS1_BITS);
+    out[2] = DESCALE_SSE(tmp13, CONST_BITS+PASS1_BITS);
+    out[6] = DESCALE_SSE(tmp12, CONST_BITS+PASS1_BITS);
+  }
+
+  /* Odd part */
+
+  z1 = _mm_add_epi32(tmp4, tmp7);
+  z2 = _mm_add_epi32(tmp5, tmp6);
+  z3 = _mm_add_epi32(tmp4, tmp6);
+  z4 = _mm_add_epi32(tmp5, tmp7);
+  z5 = MULTIPLY_SSE(_mm_add_epi32(z3, z4), FIX_1_175875602);
+
+  tmp4 = MULTIPLY_SSE(tmp4, FIX_0_298631336);
+  tmp5 = MULTIPLY_SSE(tmp5, FIX_2_053119869);
+  tmp6 = MULTIPLY_SSE(tmp6, FIX_3_072711026);
+  tmp7 = MULTIPLY_SSE(tmp7, FIX_1_501321110);
+  z1 = MULTIPLY_SSE(z1, - FIX_0_899976223);
+  z2 = MULTIPLY_SSE(z2, - FIX_2_562915447);
+  z3 = MULTIPLY_SSE(z3, - FIX_1_961570560);
+  z4 = MULTIPLY_SSE(z4, - FIX_0_390180644);
+
+  z3 = _mm_add_epi32(z3, z5);
+  z4 = _mm_add_epi32(z4, z5);
+
+  tmp4 = _mm_add_epi32(tmp4, _mm_add_epi32(z1, z3));
+  tmp5 = _mm_add_epi32(tmp5, _mm_add_epi32(z2, z4));
+  tmp6 = _mm_add_epi32(tmp6, _mm_add_epi32(z2, z3));
+  tmp7 = _mm_add_epi32(tmp7, _mm_add_epi32(z1, z4));
+
+  if (pass1) {
+    out[7] = DESCALE_SSE(tmp4, CONST_BITS-PASS1_BITS);
+    out[5] = DESCALE_SSE(tmp5, CONST_BITS-PASS1_BITS);
+    out[3] = DESCALE_SSE(tmp6, CONST_BITS-PASS1_BITS);
+    out[1] = DESCALE_SSE(tmp7, CONST_BITS-PASS1_BITS);
+  } else {
+    out[7] = DESCALE_SSE(tmp4, CONST_BITS+PASS1_BITS);
+    out[5] = DESCALE_SSE(tmp5, CONST_BITS+PASS1_BITS);
+    out[3] = DESCALE_SSE(tmp6, CONST_BITS+PASS1_BITS);
+    out[1] = DESCALE_SSE(tmp7, CONST_BITS+PASS1_BITS);
+  }
+}
+
+
+JSIMD_SSE41_TARGET GLOBAL(void)
+jpeg_fdct_islow_sse41 (DCTELEM * data)
+{
+  __m128i in[DCTSIZE], out[DCTSIZE];
+  __m128i ws[DCTSIZE][2];	/* ws[i][j]: index i, lanes 4*j..4*j+3 */
+  __m128i r0, r1, r2, r3;
+  int ctr, i, j;
+
+  /* Pass 1: process rows 0..3 and 4..7. */
+  /* ws[column][row half] holds the results. */
+
+  for (j = 0; j < 2; j++) {
+    for (i = 0; i < 2; i++) {
+      r0 = _mm_loadu_si128((const __m128i *) (data + DCTSIZE*(4*j+0) + 4*i));
+      r1 = _mm_loadu_si128((const __m128i *) (data + DCTSIZE*(4*j+1) + 4*i));
+      r2 = _mm_loadu_si128((const __m128i *) (data + DCTSIZE*(4*j+2) + 4*i));
+      r3 = _mm_loadu_si128((const __m128i *) (data + DCTSIZE*(4*j+3) + 4*i));
+      TRANSPOSE_SSE(r0, r1, r2, r3);
+      in[4*i] = r0; in[4*i+1] = r1; in[4*i+2] = r2; in[4*i+3] = r3;
+    }
+    fdct_islow_1d_sse41(in, out, TRUE);
+    for (ctr = 0; ctr < DCTSIZE; ctr++)
+      ws[ctr][j] = out[ctr];
+  }
+
+  /* Pass 2: process columns 0..3 and 4..7, transposing the results of */
+  /* pass 1 back to rows first. */
+
+  for (j = 0; j < 2; j++) {
+    for (i = 0; i < 2; i++) {
+      r0 = ws[4*j][i]; r1 = ws[4*j+1][i]; r2 = ws[4*j+2][i]; r3 = ws[4*j+3][i];
+      TRANSPOSE_SSE(r0, r1, r2, r3);
+      in[4*i] = r0; in[4*i+1] = r1; in[4*i+2] = r2; in[4*i+3] = r3;
+    }
+    fdct_islow_1d_sse41(in, out, FALSE);
+    for (ctr = 0; ctr < DCTSIZE; ctr++)
+      _mm_storeu_si128((__m128i *) (data + DCTSIZE*ctr + 4*j), out[ctr]);
+  }
+}
+
+#endif /* JSIMD_SSE41_SUPPORTED */
+
 #endif /* DCT_ISLOW_SUPPORTED */
@@ -363,6 +363,18 @@ extern const int jpeg_zigzag_order[]; /* natural coef order to zigzag order */
 #endif
 extern const int jpeg_natural_order[]; /* zigzag coef order to natural order */
 
+/* SIMD support.  On x86 processors supporting SSE4.1 some of the most time
+ * consuming routines are replaced at run time by vectorized versions, which
+ * produce exactly the same results.  Define JSIMD_DISABLED to always use the
+ * portable routines.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (__GNUC__ >= 5 || defined(__clang__)) && !defined(JSIMD_DISABLED)
+#define JSIMD_SSE41_SUPPORTED
+#define JSIMD_SSE41_TARGET  __attribute__((target("sse4.1")))
+#define jsimd_can_sse41()  (__builtin_cpu_supports("sse4.1"))
+#endif
+
 /* Suppress undefined-structure complaints if necessary. */
 
 #ifdef INCOMPLETE_TYPES_BROKEN
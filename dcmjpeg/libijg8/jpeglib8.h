@@ -935,6 +935,7 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_fdct_float                jpeg8_fdct_float
 #define jpeg_fdct_ifast                jpeg8_fdct_ifast
 #define jpeg_fdct_islow                jpeg8_fdct_islow
+#define jpeg_fdct_islow_sse41          jpeg8_fdct_islow_sse41
 #define jpeg_fill_bit_buffer           jpeg8_fill_bit_buffer
 #define jpeg_finish_compress           jpeg8_finish_compress
 #define jpeg_finish_decompress         jpeg8_finish_decompress
@@ -952,6 +953,7 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_idct_float                jpeg8_idct_float
 #define jpeg_idct_ifast                jpeg8_idct_ifast
 #define jpeg_idct_islow                jpeg8_idct_islow
+#define jpeg_idct_islow_sse41          jpeg8_idct_islow_sse41
 #define jpeg_input_complete            jpeg8_input_complete
 #define jpeg_make_c_derived_tbl        jpeg8_make_c_derived_tbl
 #define jpeg_make_d_derived_tbl        jpeg8_make_d_derived_tbl
@@ -30,6 +30,8 @@
 #include "dcmtk/dcmdata/dcvrpobw.h"  /* for class DcmPolymorphOBOW */
 #include "dcmtk/dcmdata/dcswap.h"    /* for swapIfNecessary() */
 #include "dcmtk/dcmdata/dcuid.h"     /* for dcmGenerateUniqueIdentifer()*/
+#include "dcmtk/dcmdata/dcfrmthr.h"  /* for class DcmFrameThreads */
+#include "dcmtk/ofstd/ofvector.h"    /* for class OFVector */
 
 // dcmjpeg includes
 #include "dcmtk/dcmjpeg/djcparam.h"  /* for class DJCodecParameter */
@@ -47,6 +49,114 @@ DJCodecDecoder::~DJCodecDecoder()
 }
 
 
+class DJCodecDecoder::RestartIntervalTask: public DcmFrameDecodeTask
+{
+public:
+  RestartIntervalTask(
+    const DJCodecDecoder& codec,
+    const DcmRepresentationParameter *fromParam,
+    const DJCodecParameter *djcp,
+    Uint8 precision,
+    OFBool isYBR,
+    OFBool isSigned,
+    const Uint8 *jpegData,
+    const OFVector<Uint8>& header,
+    size_t sofOffset,
+    const OFVector<Uint32>& intervalStart,
+    const OFVector<Uint32>& intervalEnd,
+    Uint32 imageRows,
+    Uint32 rowsPerInterval,
+    size_t rowSize,
+    Uint8 *buffer,
+    Uint32 groupCount,
+    EP_Interpretation *colorModel)
+  : codec_(codec)
+  , fromParam_(fromParam)
+  , djcp_(djcp)
+  , precision_(precision)
+  , isYBR_(isYBR)
+  , isSigned_(isSigned)
+  , jpegData_(jpegData)
+  , header_(header)
+  , sofOffset_(sofOffset)
+  , intervalStart_(intervalStart)
+  , intervalEnd_(intervalEnd)
+  , imageRows_(imageRows)
+  , rowsPerInterval_(rowsPerInterval)
+  , rowSize_(rowSize)
+  , buffer_(buffer)
+  , groupCount_(groupCount)
+  , colorModel_(colorModel)
+  {
+  }
+
+  /// decompresses the restart intervals of the given group with a decoder of its own
+  virtual OFCondition decodeFrame(Uint32 groupNo) const
+  {
+    const size_t intervalCount = intervalStart_.size();
+    const size_t first = intervalCount * groupNo / groupCount_;
+    const size_t last = intervalCount * (groupNo + 1) / groupCount_;
+
+    size_t maxLength = 0;
+    for (size_t i = first; i < last; ++i)
+    {
+      if (intervalEnd_[i] - intervalStart_[i] > maxLength) maxLength = intervalEnd_[i] - intervalStart_[i];
+    }
+    const size_t headerLength = header_.size();
+    Uint8 *stream = new Uint8[headerLength + maxLength + 2];
+    memcpy(stream, &header_[0], headerLength);
+
+    DJDecoder *jpeg = codec_.createDecoderInstance(fromParam_, djcp_, precision_, isYBR_);
+    OFCondition result = (jpeg == NULL) ? EC_MemoryExhausted : EC_Normal;
+    for (size_t i = first; (i < last) && result.good(); ++i)
+    {
+      // a complete image of the rows of this interval: the original tables and
+      // scan header with the frame height patched, followed by the entropy coded data
+      const Uint32 row = OFstatic_cast(Uint32, i) * rowsPerInterval_;
+      const Uint32 rows = (imageRows_ - row < rowsPerInterval_) ? imageRows_ - row : rowsPerInterval_;
+      const size_t length = intervalEnd_[i] - intervalStart_[i];
+      stream[sofOffset_ + 5] = OFstatic_cast(Uint8, rows >> 8);
+      stream[sofOffset_ + 6] = OFstatic_cast(Uint8, rows & 0xff);
+      memcpy(stream + headerLength, jpegData_ + intervalStart_[i], length);
+      stream[headerLength + length] = 0xff;     // EOI
+      stream[headerLength + length + 1] = 0xd9;
+
+      result = jpeg->init();
+      if (result.good())
+      {
+        result = jpeg->decode(stream, OFstatic_cast(Uint32, headerLength + length + 2),
+          buffer_ + row * rowSize_, OFstatic_cast(Uint32, rows * rowSize_), isSigned_);
+        // the stream is complete, so the decoder must not ask for more data
+        if (result == EJ_Suspension) result = EC_CorruptedData;
+      }
+      if (result.good() && (i == 0)) *colorModel_ = jpeg->getDecompressedColorModel();
+    }
+    delete jpeg;
+    delete[] stream;
+    return result;
+  }
+
+private:
+  const DJCodecDecoder& codec_;
+  const DcmRepresentationParameter *fromParam_;
+  const DJCodecParameter *djcp_;
+  Uint8 precision_;
+  OFBool isYBR_;
+  OFBool isSigned_;
+  const Uint8 *jpegData_;
+  const OFVector<Uint8>& header_;
+  size_t sofOffset_;
+  const OFVector<Uint32>& intervalStart_;
+  const OFVector<Uint32>& intervalEnd_;
+  Uint32 imageRows_;
+  Uint32 rowsPerInterval_;
+  size_t rowSize_;
+  Uint8 *buffer_;
+  Uint32 groupCount_;
+  EP_Interpretation *colorModel_;
+};
+
+
 OFBool DJCodecDecoder::canChangeCoding(
     const E_TransferSyntax oldRepType,
     const E_TransferSyntax newRepType) const
@@ -167,10 +277,15 @@ OFCondition DJCodecDecoder::decode(
 
                   while ((currentFrame < imageFrames)&&(result.good()))
                   {
-                    result = jpeg->init();
+                    // a frame with restart intervals may be decompressed in parallel
+                    EP_Interpretation frameColorModel = EPI_Unknown;
+                    const OFBool frameDecoded = decodeRestartIntervals(fromRepParam, pixSeq, OFstatic_cast(Uint32, currentItem),
+                      djcp, precision, isYBR, imageData8, OFstatic_cast(Uint32, frameSize), isSigned, frameColorModel, result);
+                    if (frameDecoded) currentItem++;
+                    else result = jpeg->init();
                     if (result.good())
                     {
-                      result = EJ_Suspension;
+                      if (! frameDecoded) result = EJ_Suspension;
                       while (EJ_Suspension == result)
                       {
                         result = pixSeq->getItem(pixItem, OFstatic_cast(Uint32, currentItem++));
@@ -193,6 +308,7 @@ OFCondition DJCodecDecoder::decode(
                           }
                         }
                       }
+                      if (! frameDecoded) frameColorModel = jpeg->getDecompressedColorModel();
                       if (result.good())
                       {
                         if (! createPlanarConfigurationInitialized)
@@ -200,7 +316,7 @@ OFCondition DJCodecDecoder::decode(
                           // we need to know the decompressed photometric interpretation in order
                           // to determine the final planar configuration.  However, this is only
                           // known after the first call to jpeg->decode(), i.e. here.
-                          colorModel = jpeg->getDecompressedColorModel();
+                          colorModel = frameColorModel;
                           if (colorModel == EPI_Unknown)
                           {
                             // derive color model from DICOM photometric interpretation
@@ -501,10 +617,15 @@ OFCondition DJCodecDecoder::decodeFrame(
                   }
                 }
 
-                result = jpeg->init();
+                // a frame with restart intervals may be decompressed in parallel
+                EP_Interpretation frameColorModel = EPI_Unknown;
+                const OFBool frameDecoded = decodeRestartIntervals(fromParam, fromPixSeq, currentItem,
+                  djcp, precision, isYBR, OFreinterpret_cast(Uint8*, buffer), OFstatic_cast(Uint32, frameSize), isSigned, frameColorModel, result);
+                if (frameDecoded) pastLastFragmentUsed = ++currentItem;
+                else result = jpeg->init();
                 if (result.good())
                 {
-                  result = EJ_Suspension;
+                  if (! frameDecoded) result = EJ_Suspension;
                   while (EJ_Suspension == result)
                   {
                     result = fromPixSeq->getItem(pixItem, currentItem++);
@@ -519,6 +640,7 @@ OFCondition DJCodecDecoder::decodeFrame(
                       }
                     }
                   }
+                  if (! frameDecoded) frameColorModel = jpeg->getDecompressedColorModel();
                   if (result.good())
                   {
                     // convert planar configuration to color by plane if necessary
@@ -547,7 +669,7 @@ OFCondition DJCodecDecoder::decodeFrame(
 
                     // now see if we have to change the photometric interpretation
                     // because the decompression has changed something
-                    switch (jpeg->getDecompressedColorModel())
+                    switch (frameColorModel)
                     {
                       case EPI_Monochrome2:
                         decompressedColorModel = "MONOCHROME2";
@@ -588,6 +710,148 @@ OFCondition DJCodecDecoder::decodeFrame(
 }
 
 
+OFBool DJCodecDecoder::decodeRestartIntervals(
+    const DcmRepresentationParameter * fromParam,
+    DcmPixelSequence * pixSeq,
+    Uint32 itemNo,
+    const DJCodecParameter *cp,
+    Uint8 precision,
+    OFBool isYBR,
+    Uint8 *buffer,
+    Uint32 bufSize,
+    OFBool isSigned,
+    EP_Interpretation& decompressedColorModel,
+    OFCondition& result) const
+{
+  const Uint16 numThreads = cp->getNumThreads();
+  if ((numThreads <= 1) || !isLosslessProcess()) return OFFalse;
+
+  DcmPixelItem *pixItem = NULL;
+  Uint8 *data = NULL;
+  if (pixSeq->getItem(pixItem, itemNo).bad() || pixItem->getUint8Array(data).bad() || (data == NULL)) return OFFalse;
+  const Uint32 length = pixItem->getLength();
+  if ((length < 4) || (readUint16(data) != 0xffd8)) return OFFalse; // SOI
+
+  // parse the marker segments up to the start of scan
+  size_t sofOffset = 0;
+  Uint32 imageRows = 0;
+  Uint32 imageColumns = 0;
+  Uint32 components = 0;
+  Uint32 restartInterval = 0;
+  OFVector<size_t> driOffsets;
+  Uint32 offset = 2;
+  Uint32 scanOffset = 0;
+  while ((scanOffset == 0) && (offset + 4 <= length))
+  {
+    if (data[offset] != 0xff) return OFFalse;
+    const Uint8 marker = data[offset + 1];
+    if (marker == 0xff)
+    {
+      ++offset; // fill byte
+      continue;
+    }
+    const Uint32 segmentLength = readUint16(data + offset + 2);
+    if ((segmentLength < 2) || (offset + 2 + segmentLength > length)) return OFFalse;
+    switch (marker)
+    {
+      case 0xc3: // SOF_3: JPEG lossless sequential, the only process handled here
+        if (segmentLength < 8) return OFFalse;
+        sofOffset = offset;
+        imageRows = readUint16(data + offset + 5);
+        imageColumns = readUint16(data + offset + 7);
+        components = data[offset + 9];
+        if ((components == 0) || (segmentLength != 8 + 3 * components)) return OFFalse;
+        // every MCU must be a single pixel for the intervals to cover whole rows
+        for (Uint32 c = 0; c < components; ++c)
+        {
+          if (data[offset + 11 + 3 * c] != 0x11) return OFFalse;
+        }
+        break;
+      case 0xc4: // DHT
+      case 0xcc: // DAC
+        break;
+      case 0xdd: // DRI
+        if (segmentLength != 4) return OFFalse;
+        restartInterval = readUint16(data + offset + 4);
+        driOffsets.push_back(offset);
+        break;
+      case 0xda: // SOS, all components must be coded in this single scan
+        if ((sofOffset == 0) || (data[offset + 4] != components)) return OFFalse;
+        scanOffset = offset + 2 + segmentLength;
+        break;
+      default:
+        if ((marker >= 0xc0) && (marker <= 0xcf)) return OFFalse; // other processes
+        if ((marker < 0xe0) && (marker != 0xdb)) return OFFalse; // only DQT, APPn and COM remain
+        break;
+    }
+    offset += 2 + segmentLength;
+  }
+  if ((scanOffset == 0) || (restartInterval == 0) || (imageRows == 0) || (imageColumns == 0)) return OFFalse;
+  if (restartInterval % imageColumns != 0) return OFFalse;
+  const Uint32 rowsPerInterval = restartInterval / imageColumns;
+  const Uint32 intervalCount = (imageRows + rowsPerInterval - 1) / rowsPerInterval;
+  if (intervalCount < 2) return OFFalse;
+
+  const size_t rowSize = OFstatic_cast(size_t, imageColumns) * components * ((precision > 8) ? sizeof(Uint16) : sizeof(Uint8));
+  if (rowSize * imageRows > bufSize) return OFFalse;
+
+  // locate the restart markers in the entropy coded data, which must end with EOI
+  OFVector<Uint32> intervalStart;
+  OFVector<Uint32> intervalEnd;
+  intervalStart.reserve(intervalCount);
+  intervalEnd.reserve(intervalCount);
+  intervalStart.push_back(scanOffset);
+  Uint8 expectedRestart = 0;
+  OFBool complete = OFFalse;
+  offset = scanOffset;
+  while (!complete)
+  {
+    const Uint8 *next = OFstatic_cast(const Uint8 *, memchr(data + offset, 0xff, length - offset));
+    if ((next == NULL) || (next + 1 >= data + length)) return OFFalse;
+    offset = OFstatic_cast(Uint32, next - data);
+    const Uint8 marker = data[offset + 1];
+    if (marker == 0x00) offset += 2;    // stuffed zero byte
+    else if (marker == 0xff) ++offset;  // fill byte
+    else if ((marker & 0xf8) == 0xd0)   // RST m
+    {
+      if (((marker & 7) != expectedRestart) || (intervalStart.size() == intervalCount)) return OFFalse;
+      expectedRestart = OFstatic_cast(Uint8, (expectedRestart + 1) & 7);
+      intervalEnd.push_back(offset);
+      intervalStart.push_back(offset + 2);
+      offset += 2;
+    }
+    else if (marker == 0xd9) // EOI
+    {
+      intervalEnd.push_back(offset);
+      complete = OFTrue;
+    }
+    else return OFFalse; // DNL or another scan
+  }
+  if (intervalStart.size() != intervalCount) return OFFalse;
+
+  // the header of the streams decompressed per interval, without restart interval
+  OFVector<Uint8> header;
+  header.reserve(scanOffset);
+  for (Uint32 i = 0; i < scanOffset; ++i) header.push_back(data[i]);
+  for (size_t i = 0; i < driOffsets.size(); ++i)
+  {
+    header[driOffsets[i] + 4] = 0;
+    header[driOffsets[i] + 5] = 0;
+  }
+
+  const Uint32 groupCount = (numThreads < intervalCount) ? numThreads : intervalCount;
+  DCMJPEG_DEBUG("decompressing " << intervalCount << " restart intervals of " << rowsPerInterval
+    << " rows on " << groupCount << " threads");
+  decompressedColorModel = EPI_Unknown;
+  RestartIntervalTask task(*this, fromParam, cp, precision, isYBR, isSigned, data, header, sofOffset,
+    intervalStart, intervalEnd, imageRows, rowsPerInterval, rowSize, buffer, groupCount, &decompressedColorModel);
+  // one thread per group, never more than the Uint16 thread count of the codec parameters
+  const Uint16 threadCount = OFstatic_cast(Uint16, (groupCount < numThreads) ? groupCount : numThreads);
+  result = DcmFrameThreads::decodeFrames(task, groupCount, threadCount);
+  return OFTrue;
+}
+
+
 OFCondition DJCodecDecoder::encode(
     const Uint16 * /* pixelData */,
     const Uint32 /* length */,
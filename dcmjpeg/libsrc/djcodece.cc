@@ -39,6 +39,7 @@
 #include "dcmtk/dcmdata/dcvrst.h"     /* for class DcmShortText */
 #include "dcmtk/dcmdata/dcvrus.h"     /* for class DcmUnsignedShort */
 #include "dcmtk/dcmdata/dcswap.h"     /* for swapIfNecessary */
+#include "dcmtk/dcmdata/dcfrmthr.h"   /* for class DcmFrameThreads */
 
 // dcmjpeg includes
 #include "dcmtk/dcmjpeg/djcparam.h"   /* for class DJCodecParameter */
@@ -51,6 +52,78 @@
 #include "dcmtk/ofstd/ofstdinc.h"
 
 
+class DJCodecEncoder::TrueLosslessFrameTask: public DcmFrameEncodeTask
+{
+public:
+  TrueLosslessFrameTask(
+    const DJCodecEncoder& codec,
+    const DcmRepresentationParameter *toRepParam,
+    const DJCodecParameter *djcp,
+    const Uint8 *pixelData,
+    size_t frameSize,
+    Uint16 bitsAllocated,
+    Uint16 columns,
+    Uint16 rows,
+    EP_Interpretation interpr,
+    Uint16 samplesPerPixel)
+  : codec_(codec)
+  , toRepParam_(toRepParam)
+  , djcp_(djcp)
+  , pixelData_(pixelData)
+  , frameSize_(frameSize)
+  , bitsAllocated_(bitsAllocated)
+  , columns_(columns)
+  , rows_(rows)
+  , interpr_(interpr)
+  , samplesPerPixel_(samplesPerPixel)
+  {
+  }
+
+  virtual OFCondition encodeFrame(Uint32 frameNo, Uint8 *&compressedData, Uint32 &compressedLen) const
+  {
+    // encoder instances keep per image state, each frame gets its own
+    DJEncoder *jpeg = codec_.createEncoderInstance(toRepParam_, djcp_, OFstatic_cast(Uint8, bitsAllocated_));
+    if (jpeg == NULL)
+    {
+      DCMJPEG_ERROR("True lossless encoder: Cannot allocate encoder instance");
+      return EC_IllegalCall;
+    }
+
+    Uint8 *framePointer = OFconst_cast(Uint8*, pixelData_) + frameNo * frameSize_;
+    compressedData = NULL;
+    compressedLen = 0;
+    if (bitsAllocated_ == 8)
+    {
+      jpeg->encode(columns_, rows_, interpr_, samplesPerPixel_, framePointer, compressedData, compressedLen);
+    }
+    else if (bitsAllocated_ == 16)
+    {
+      jpeg->encode(columns_, rows_, interpr_, samplesPerPixel_, OFreinterpret_cast(Uint16*, framePointer), compressedData, compressedLen);
+    }
+    delete jpeg;
+
+    if (compressedLen == 0)
+    {
+      DCMJPEG_ERROR("True lossless encoder: Error encoding frame");
+      return EC_CannotChangeRepresentation;
+    }
+    return EC_Normal;
+  }
+
+private:
+  const DJCodecEncoder& codec_;
+  const DcmRepresentationParameter *toRepParam_;
+  const DJCodecParameter *djcp_;
+  const Uint8 *pixelData_;
+  size_t frameSize_;
+  Uint16 bitsAllocated_;
+  Uint16 columns_;
+  Uint16 rows_;
+  EP_Interpretation interpr_;
+  Uint16 samplesPerPixel_;
+};
+
+
 DJCodecEncoder::DJCodecEncoder()
 : DcmCodec()
 {
@@ -411,10 +484,10 @@ OFCondition DJCodecEncoder::encodeColorImage(
     pixSeq = NULL;
   }
 
-  if ((result.good()) && (cp->getCreateOffsetTable()))
+  if (result.good())
   {
     // create offset table
-    result = offsetTable->createOffsetTable(offsetList);
+    result = createOffsetTables(dataset, pixSeq, offsetList, cp->getCreateOffsetTable());
   }
 
   if (result.good())
@@ -493,8 +566,6 @@ OFCondition DJCodecEncoder::encodeTrueLossless(
     Uint16 rows = 0;
     Sint32 numberOfFrames = 1;
     EP_Interpretation interpr = EPI_Unknown;
-    Uint8 *jpegData = NULL;
-    Uint32 jpegLen  = 0;
     OFBool byteSwapped = OFFalse;      // true if we have byte-swapped the original pixel data
     OFBool planConfSwitched = OFFalse; // true if planar configuration was toggled
     DcmOffsetList offsetList;
@@ -624,41 +695,14 @@ OFCondition DJCodecEncoder::encodeTrueLossless(
     const Uint8 *framePointer = OFreinterpret_cast(const Uint8 *, pixelData);
     size_t compressedSize = 0;
 
-    // create encoder corresponding to bit depth (8 or 16 bit)
-    DJEncoder *jpeg = createEncoderInstance(toRepParam, djcp, OFstatic_cast(Uint8, bitsAllocated));
-    if (jpeg)
-    {
-      // main loop for compression: compress each frame
-      for (unsigned int i=0; i<frameCount && result.good(); i++)
-      {
-        if (bitsAllocated == 8)
-        {
-          jpeg->encode(columns, rows, interpr, samplesPerPixel, OFconst_cast(Uint8*, framePointer), jpegData, jpegLen);
-        }
-        else if (bitsAllocated == 16)
-        {
-          jpeg->encode(columns, rows, interpr, samplesPerPixel, OFreinterpret_cast(Uint16*, OFconst_cast(Uint8*, framePointer)), jpegData, jpegLen);
-        }
-        // update variables
-        compressedSize+=jpegLen;
-        framePointer+=frameSize;
-        if (jpegLen == 0)
-        {
-          DCMJPEG_ERROR("True lossless encoder: Error encoding frame");
-          result = EC_CannotChangeRepresentation;
-        }
-        else
-        {
-          result = pixelSequence->storeCompressedFrame(offsetList, jpegData, jpegLen, djcp->getFragmentSize());
-        }
-        // free memory
-        delete[] jpegData;
-      }
-    }
-    else
+    // main loop for compression: compress each frame, the frames are
+    // independent and compressed in parallel if requested
+    if (result.good())
     {
-      DCMJPEG_ERROR("True lossless encoder: Cannot allocate encoder instance");
-      result = EC_IllegalCall;
+      TrueLosslessFrameTask task(*this, toRepParam, djcp, framePointer, frameSize,
+        bitsAllocated, columns, rows, interpr, samplesPerPixel);
+      result = DcmFrameThreads::encodeFrames(task, OFstatic_cast(Uint32, frameCount), djcp->getNumThreads(),
+        pixelSequence, offsetList, djcp->getFragmentSize(), compressedSize);
     }
     if (result.good())
     {
@@ -667,12 +711,11 @@ OFCondition DJCodecEncoder::encodeTrueLossless(
     }
     else
       delete pixelSequence;
-    delete jpeg; // encoder no longer in use
 
-    if ((result.good()) && (djcp->getCreateOffsetTable()))
+    if (result.good())
     {
       // create offset table
-      result = offsetTable->createOffsetTable(offsetList);
+      result = createOffsetTables(datsetItem, pixSeq, offsetList, djcp->getCreateOffsetTable());
     }
 
     // the following operations do not affect the Image Pixel Module
@@ -1227,10 +1270,10 @@ OFCondition DJCodecEncoder::encodeMonochromeImage(
     pixSeq = NULL;
   }
 
-  if ((result.good()) && (cp->getCreateOffsetTable()))
+  if (result.good())
   {
     // create offset table
-    result = offsetTable->createOffsetTable(offsetList);
+    result = createOffsetTables(dataset, pixSeq, offsetList, cp->getCreateOffsetTable());
   }
 
   if (result.good())
@@ -80,6 +80,7 @@ DJCodecParameter::DJCodecParameter(
 , predictor6WorkaroundEnabled_(predictor6WorkaroundEnable)
 , cornellWorkaroundEnabled_(cornellWorkaroundEnable)
 , forceSingleFragmentPerFrame(pForceSingleFragmentPerFrame)
+, numThreads(0)
 {
 }
 
@@ -114,6 +115,7 @@ DJCodecParameter::DJCodecParameter(const DJCodecParameter& arg)
 , predictor6WorkaroundEnabled_(arg.predictor6WorkaroundEnabled_)
 , cornellWorkaroundEnabled_(arg.cornellWorkaroundEnabled_)
 , forceSingleFragmentPerFrame(arg.forceSingleFragmentPerFrame)
+, numThreads(arg.numThreads)
 {
 }
 
@@ -91,6 +91,11 @@ void DJDecoderRegistration::registerCodecs(
   }
 }
 
+void DJDecoderRegistration::setNumThreads(Uint16 numThreads)
+{
+  if (registered && cp) cp->setNumThreads(numThreads);
+}
+
 void DJDecoderRegistration::cleanup()
 {
   if (registered)
@@ -299,6 +299,7 @@ DJCompressIJG12Bit::DJCompressIJG12Bit(const DJCodecParameter& cp, EJ_Mode mode,
 , quality(theQuality)
 , psv(1)
 , pt(0)
+, restartRows(0)
 , modeofOperation(mode)
 , pixelDataList()
 , bytesInLastBlock(0)
@@ -306,12 +307,13 @@ DJCompressIJG12Bit::DJCompressIJG12Bit(const DJCodecParameter& cp, EJ_Mode mode,
   assert((mode != EJM_lossless) && (mode != EJM_baseline));
 }
 
-DJCompressIJG12Bit::DJCompressIJG12Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans)
+DJCompressIJG12Bit::DJCompressIJG12Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans, int theRestartRows)
 : DJEncoder()
 , cparam(&cp)
 , quality(90)
 , psv(prediction)
 , pt(ptrans)
+, restartRows(theRestartRows)
 , modeofOperation(mode)
 , pixelDataList()
 , bytesInLastBlock(0)
@@ -404,6 +406,9 @@ OFCondition DJCompressIJG12Bit::encode(
     case EJM_lossless:
      // always disables any kind of color space conversion
      jpeg_simple_lossless(&cinfo,psv,pt);
+     // restart intervals are counted in MCUs in 16 bits and must cover whole rows
+     if ((restartRows > 0) && (columns > 0))
+       cinfo.restart_in_rows = (restartRows < 65535 / columns) ? restartRows : 65535 / columns;
      break;
   }
 
@@ -152,11 +152,12 @@ static J_COLOR_SPACE getJpegColorSpace(EP_Interpretation interpr)
   }
 }
 
-DJCompressIJG16Bit::DJCompressIJG16Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans)
+DJCompressIJG16Bit::DJCompressIJG16Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans, int theRestartRows)
 : DJEncoder()
 , cparam(&cp)
 , psv(prediction)
 , pt(ptrans)
+, restartRows(theRestartRows)
 , modeofOperation(mode)
 , pixelDataList()
 , bytesInLastBlock(0)
@@ -237,6 +238,9 @@ OFCondition DJCompressIJG16Bit::encode(
     case EJM_lossless:
      // always disables any kind of color space conversion
      jpeg_simple_lossless(&cinfo,psv,pt);
+     // restart intervals are counted in MCUs in 16 bits and must cover whole rows
+     if ((restartRows > 0) && (columns > 0))
+       cinfo.restart_in_rows = (restartRows < 65535 / columns) ? restartRows : 65535 / columns;
      break;
     default:
      return makeOFCondition(OFM_dcmjpeg, EJCode_IJG16_Compression, OF_error, "JPEG with 16 bits/sample only allowed with lossless compression");
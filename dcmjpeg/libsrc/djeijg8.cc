@@ -300,6 +300,7 @@ DJCompressIJG8Bit::DJCompressIJG8Bit(const DJCodecParameter& cp, EJ_Mode mode, U
 , quality(theQuality)
 , psv(1)
 , pt(0)
+, restartRows(0)
 , modeofOperation(mode)
 , pixelDataList()
 , bytesInLastBlock(0)
@@ -307,12 +308,13 @@ DJCompressIJG8Bit::DJCompressIJG8Bit(const DJCodecParameter& cp, EJ_Mode mode, U
   assert(mode != EJM_lossless);
 }
 
-DJCompressIJG8Bit::DJCompressIJG8Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans)
+DJCompressIJG8Bit::DJCompressIJG8Bit(const DJCodecParameter& cp, EJ_Mode mode, int prediction, int ptrans, int theRestartRows)
 : DJEncoder()
 , cparam(&cp)
 , quality(90)
 , psv(prediction)
 , pt(ptrans)
+, restartRows(theRestartRows)
 , modeofOperation(mode)
 , pixelDataList()
 , bytesInLastBlock(0)
@@ -408,6 +410,9 @@ OFCondition DJCompressIJG8Bit::encode(
     case EJM_lossless:
      // always disables any kind of color space conversion
      jpeg_simple_lossless(&cinfo,psv,pt);
+     // restart intervals are counted in MCUs in 16 bits and must cover whole rows
+     if ((restartRows > 0) && (columns > 0))
+       cinfo.restart_in_rows = (restartRows < 65535 / columns) ? restartRows : 65535 / columns;
      break;
   }
 
@@ -128,6 +128,11 @@ void DJEncoderRegistration::registerCodecs(
   }
 }
 
+void DJEncoderRegistration::setNumThreads(Uint16 numThreads)
+{
+  if (registered && cp) cp->setNumThreads(numThreads);
+}
+
 void DJEncoderRegistration::cleanup()
 {
   if (registered)
@@ -83,10 +83,10 @@ DJEncoder *DJEncoderP14SV1::createEncoderInstance(
   DJEncoder *result = NULL;
   // prediction/selection value is always 1 for this transfer syntax
   if (bitsPerSample > 12)
-    result = new DJCompressIJG16Bit(*cp, EJM_lossless, 1, rp->getPointTransformation());
+    result = new DJCompressIJG16Bit(*cp, EJM_lossless, 1, rp->getPointTransformation(), rp->getRestartRows());
   else if (bitsPerSample > 8)
-    result = new DJCompressIJG12Bit(*cp, EJM_lossless, 1, rp->getPointTransformation());
+    result = new DJCompressIJG12Bit(*cp, EJM_lossless, 1, rp->getPointTransformation(), rp->getRestartRows());
   else
-    result = new DJCompressIJG8Bit(*cp, EJM_lossless, 1, rp->getPointTransformation());
+    result = new DJCompressIJG8Bit(*cp, EJM_lossless, 1, rp->getPointTransformation(), rp->getRestartRows());
   return result;
 }
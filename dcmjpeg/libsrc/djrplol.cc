@@ -23,10 +23,11 @@
 #include "dcmtk/dcmjpeg/djrplol.h"
 
 
-DJ_RPLossless::DJ_RPLossless(int aPrediction, int aPt)
+DJ_RPLossless::DJ_RPLossless(int aPrediction, int aPt, int aRestartRows)
 : DcmRepresentationParameter()
 , prediction(aPrediction)
 , pt(aPt)
+, restartRows(aRestartRows)
 {
 }
 
@@ -34,6 +35,7 @@ DJ_RPLossless::DJ_RPLossless(const DJ_RPLossless& arg)
 : DcmRepresentationParameter(arg)
 , prediction(arg.prediction)
 , pt(arg.pt)
+, restartRows(arg.restartRows)
 {
 }
 
@@ -60,7 +62,7 @@ OFBool DJ_RPLossless::operator==(const DcmRepresentationParameter &arg) const
     if (argstring == className())
     {
       const DJ_RPLossless& argll = OFstatic_cast(const DJ_RPLossless&, arg);
-      if ((prediction == argll.prediction) && (pt == argll.pt)) return OFTrue;
+      if ((prediction == argll.prediction) && (pt == argll.pt) && (restartRows == argll.restartRows)) return OFTrue;
     }
   }
   return OFFalse;
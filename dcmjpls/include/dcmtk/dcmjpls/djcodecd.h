@@ -224,6 +224,44 @@ private:
     Uint16 imageSamplesPerPixel,
     Uint16 bytesPerSample);
 
+  /** determines the planar configuration of the decompressed image
+   *  @param cp codec parameters for this codec
+   *  @param dataset pointer to dataset in which pixel data element is contained
+   *  @param imageSamplesPerPixel number of samples per pixel
+   *  @return planar configuration, 0 for color-by-pixel and 1 for color-by-plane
+   */
+  static Uint16 decodedPlanarConfiguration(
+    const DJLSCodecParameter *cp,
+    DcmItem *dataset,
+    Uint16 imageSamplesPerPixel);
+
+  /** decompresses the JPEG-LS bitstream of a single frame into the given buffer,
+   *  does not access the dataset or the pixel sequence.
+   *  @param jlsData compressed bitstream of the frame
+   *  @param compressedSize length of the compressed bitstream in bytes
+   *  @param buffer pointer to buffer where frame is to be stored
+   *  @param bufSize size of buffer in bytes
+   *  @param imageColumns number of columns for each frame
+   *  @param imageRows number of rows for each frame
+   *  @param imageSamplesPerPixel number of samples per pixel
+   *  @param bytesPerSample number of bytes per sample
+   *  @param imagePlanarConfiguration planar configuration of the decompressed frame
+   *  @return EC_Normal if successful, an error code otherwise.
+   */
+  static OFCondition decodeBuffer(
+    Uint8 *jlsData,
+    size_t compressedSize,
+    void *buffer,
+    Uint32 bufSize,
+    Uint16 imageColumns,
+    Uint16 imageRows,
+    Uint16 imageSamplesPerPixel,
+    Uint16 bytesPerSample,
+    Uint16 imagePlanarConfiguration);
+
+  /// task decompressing frames stored in a single fragment each, see decode()
+  class FrameTask;
+
   /** determines if a given image requires color-by-plane planar configuration
    *  depending on SOP Class UID (DICOM IOD) and photometric interpretation.
    *  All SOP classes defined in the 2003 edition of the DICOM standard or earlier
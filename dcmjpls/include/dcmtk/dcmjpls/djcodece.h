@@ -271,8 +271,7 @@ private:
    *  @param samplesPerPixel image samples per pixel
    *  @param planarConfiguration image planar configuration
    *  @param photometricInterpretation photometric interpretation of the DICOM dataset
-   *  @param pixelSequence object in which the compressed frame is stored
-   *  @param offsetList list of frame offsets updated in this parameter
+   *  @param compressedData compressed frame, allocated with new[], returned in this parameter
    *  @param compressedSize size of compressed frame returned in this parameter
    *  @param djcp parameters for the codec
    *  @return EC_Normal if successful, an error code otherwise
@@ -285,16 +284,14 @@ private:
     Uint16 samplesPerPixel,
     Uint16 planarConfiguration,
     const OFString& photometricInterpretation,
-    DcmPixelSequence *pixelSequence,
-    DcmOffsetList &offsetList,
-    unsigned long &compressedSize,
+    Uint8 *&compressedData,
+    Uint32 &compressedSize,
     const DJLSCodecParameter *djcp) const;
 
   /** perform the lossless cooked compression of a single frame
-   *  @param pixelSequence object in which the compressed frame is stored
    *  @param dimage DicomImage instance used to process frame
    *  @param photometricInterpretation photometric interpretation of the DICOM dataset
-   *  @param offsetList list of frame offsets updated in this parameter
+   *  @param compressedData compressed frame, allocated with new[], returned in this parameter
    *  @param compressedSize size of compressed frame returned in this parameter
    *  @param djcp parameters for the codec
    *  @param frame frame index
@@ -302,15 +299,20 @@ private:
    *  @return EC_Normal if successful, an error code otherwise
    */
   OFCondition compressCookedFrame(
-    DcmPixelSequence *pixelSequence,
-    DicomImage *dimage,
+    const DicomImage *dimage,
     const OFString& photometricInterpretation,
-    DcmOffsetList &offsetList,
-    unsigned long &compressedSize,
+    Uint8 *&compressedData,
+    Uint32 &compressedSize,
     const DJLSCodecParameter *djcp,
     Uint32 frame,
     Uint16 nearLosslessDeviation) const;
 
+  /// task compressing the frames of uncompressed pixel data through compressRawFrame()
+  class RawFrameTask;
+
+  /// task compressing the frames of a DicomImage through compressCookedFrame()
+  class CookedFrameTask;
+
   /** Convert an image from sample interleaved to uninterleaved.
    *  @param target A buffer where the converted image will be stored
    *  @param source The image buffer to be converted
@@ -62,6 +62,7 @@ public:
    *  @param ignoreOffsetTable         flag indicating whether to ignore the offset table when decompressing multiframe images
    *  @param jplsInterleaveMode        flag describing which interleave the JPEG-LS datastream should use
    *  @param useFFbitstreamPadding     flag indicating whether the JPEG-LS bitstream should be FF padded as required by DICOM.
+   *  @param numThreads                number of threads compressing the frames of a multi-frame image, 0 or 1 for serial operation
    */
    DJLSCodecParameter(
      OFBool preferCookedEncoding,
@@ -76,7 +77,8 @@ public:
      JLS_PlanarConfiguration planarConfiguration = EJLSPC_restore,
      OFBool ignoreOffsetTable = OFFalse,
      interleaveMode jplsInterleaveMode = interleaveLine,
-     OFBool useFFbitstreamPadding = OFTrue );
+     OFBool useFFbitstreamPadding = OFTrue,
+     Uint16 numThreads = 0);
 
   /** constructor, for use with decoders. Initializes all encoder options to defaults.
    *  @param uidCreation                 mode for SOP Instance UID creation (used both for encoding and decoding)
@@ -84,12 +86,14 @@ public:
    *  @param ignoreOffsetTable           flag indicating whether to ignore the offset table when decompressing multiframe images
    *  @param forceSingleFragmentPerFrame while decompressing a multiframe image, assume one fragment per frame even if the JPEG
    *                                     data for some frame is incomplete
+   *  @param numThreads                  number of threads decompressing the frames of a multi-frame image, 0 or 1 for serial operation
    */
   DJLSCodecParameter(
     JLS_UIDCreation uidCreation = EJLSUC_default,
     JLS_PlanarConfiguration planarConfiguration = EJLSPC_restore,
     OFBool ignoreOffsetTable = OFFalse,
-    OFBool forceSingleFragmentPerFrame = OFFalse);
+    OFBool forceSingleFragmentPerFrame = OFFalse,
+    Uint16 numThreads = 0);
 
   /// copy constructor
   DJLSCodecParameter(const DJLSCodecParameter& arg);
@@ -221,6 +225,23 @@ public:
     return useFFbitstreamPadding_;
   }
 
+  /** returns the number of threads processing the frames of a multi-frame image
+   *  @return number of threads, 0 or 1 for serial operation
+   */
+  Uint16 getNumThreads() const
+  {
+    return numThreads_;
+  }
+
+  /** sets the number of threads processing the frames of a multi-frame image.
+   *  Applies to images compressed or decompressed afterwards.
+   *  @param numThreads number of threads, 0 or 1 for serial operation
+   */
+  void setNumThreads(Uint16 numThreads)
+  {
+    numThreads_ = numThreads;
+  }
+
 private:
 
   /// private undefined copy assignment operator
@@ -281,6 +302,12 @@ private:
    */
   OFBool forceSingleFragmentPerFrame_;
 
+  // ****************************************************
+  // **** Parameters describing both processes       ****
+
+  /// number of threads compressing or decompressing the frames of a multi-frame image
+  Uint16 numThreads_;
+
 };
 
 
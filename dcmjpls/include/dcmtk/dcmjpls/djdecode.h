@@ -46,12 +46,20 @@ public:
    *  @param ignoreOffsetTable flag indicating whether to ignore the offset table when decompressing multiframe images
    *  @param forceSingleFragmentPerFrame while decompressing a multiframe image,
    *    assume one fragment per frame even if the JPEG data for some frame is incomplete
+   *  @param numThreads number of threads decompressing the frames of a multi-frame image, 0 or 1 for serial operation
    */
   static void registerCodecs(
     JLS_UIDCreation uidcreation = EJLSUC_default,
     JLS_PlanarConfiguration planarconfig = EJLSPC_restore,
     OFBool ignoreOffsetTable = OFFalse,
-    OFBool forceSingleFragmentPerFrame = OFFalse);
+    OFBool forceSingleFragmentPerFrame = OFFalse,
+    Uint16 numThreads = 0);
+
+  /** changes the number of threads decompressing the frames of a multi-frame image.
+   *  Ignored if the decoders are not registered.
+   *  @param numThreads number of threads, 0 or 1 for serial operation
+   */
+  static void setNumThreads(Uint16 numThreads);
 
   /** deregisters decoders.
    *  Attention: Must not be called while other threads might still use
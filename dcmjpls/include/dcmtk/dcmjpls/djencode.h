@@ -52,6 +52,7 @@ public:
    *  @param convertToSC               flag indicating whether image should be converted to Secondary Capture upon compression
    *  @param jplsInterleaveMode        flag describing which interleave the JPEG-LS datastream should use
    *  @param useFFbitstreamPadding     flag indicating whether the JPEG-LS bitstream should be FF padded as required by DICOM.
+   *  @param numThreads                number of threads compressing the frames of a multi-frame image, 0 or 1 for serial operation
    */
   static void registerCodecs(
     Uint16 jpls_t1 = 0,
@@ -64,7 +65,14 @@ public:
     JLS_UIDCreation uidCreation = EJLSUC_default,
     OFBool convertToSC = OFFalse,
     DJLSCodecParameter::interleaveMode jplsInterleaveMode = DJLSCodecParameter::interleaveDefault,
-    OFBool useFFbitstreamPadding = OFTrue );
+    OFBool useFFbitstreamPadding = OFTrue,
+    Uint16 numThreads = 0);
+
+  /** changes the number of threads compressing the frames of a multi-frame image.
+   *  Ignored if the encoders are not registered.
+   *  @param numThreads number of threads, 0 or 1 for serial operation
+   */
+  static void setNumThreads(Uint16 numThreads);
 
   /** deregisters encoders.
    *  Attention: Must not be called while other threads might still use
@@ -149,19 +149,15 @@ public:
 
 	  size_t FindNextFF()
 	  {
-		  size_t off = _current_offset;
+		  if (_current_offset >= *_size)
+			  return _current_offset;
 
-		  while (off < *_size)
-	      {
-			  if ((*_position)[off] == 0xFF)
-			  {				  
-				  break;
-			  }
-		  off++;
-		  }
-		  
+		  // memchr is vectorized by the C library
+		  const void* pFF = memchr(*_position + _current_offset, 0xFF, *_size - _current_offset);
+		  if (pFF == NULL)
+			  return *_size;
 
-		  return off;
+		  return (const BYTE*)pFF - *_position;
 	  }
 
 
@@ -232,16 +228,11 @@ public:
 		  {
 			  MakeValid();
 		  }
-		  bufType valTest = _readCache;
+		  // only the first 16 bits are examined
+		  if ((_readCache >> (bufferbits - 16)) == 0)
+			  return -1;
 
-		  for (LONG count = 0; count < 16; count++)
-		  {
-			  if ((valTest & (bufType(1) << (bufferbits - 1))) != 0)
-				  return count;
-
-			  valTest <<= 1;
-		  }
-		  return -1;
+		  return CountLeadingZeros(_readCache);
 	  }
 
 
@@ -111,6 +111,21 @@ protected:
 
   void Flush()
   {
+    // fast path: a full word without 0xFF bytes needs no bit stuffing and is written at once
+    if (bitpos <= 0 && !_isFFWritten && !HasFFByte(valcurrent) && _current_offset + 4 <= *_size)
+    {
+      BYTE* pbyte = *_position + _current_offset;
+      pbyte[0] = BYTE(valcurrent >> 24);
+      pbyte[1] = BYTE(valcurrent >> 16);
+      pbyte[2] = BYTE(valcurrent >> 8);
+      pbyte[3] = BYTE(valcurrent);
+      _current_offset += 4;
+      _bytesWritten += 4;
+      valcurrent = 0;
+      bitpos += 32;
+      return;
+    }
+
     for (LONG i = 0; i < 4; ++i)
     {
       if (bitpos >= 32)
@@ -126,8 +141,9 @@ protected:
       }
       else
       {
-        write(BYTE(valcurrent >> 24));
-        _isFFWritten = (*_position)[_current_offset - 1] == 0xFF;
+        const BYTE value = BYTE(valcurrent >> 24);
+        write(value);
+        _isFFWritten = value == 0xFF;
         valcurrent = valcurrent << 8;     
         bitpos += 8;
       }
@@ -154,6 +170,13 @@ protected:
   JlsParameters _info;
   OFunique_ptr<ProcessLine> _processLine;
 private:
+  // true if any of the four bytes of the value is 0xFF
+  static bool HasFFByte(unsigned int value)
+  {
+    const unsigned int inverted = ~value;
+    return ((inverted - 0x01010101u) & ~inverted & 0x80808080u) != 0;
+  }
+
   static BYTE *re_alloc(BYTE *old_ptr, size_t *old_size)
   {
     size_t new_size = *old_size * 2;
@@ -6,6 +6,11 @@
 
 #include "clrtrans.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (__GNUC__ >= 5 || defined(__clang__))
+#define CHARLS_SSSE3
+#include <tmmintrin.h>
+#endif
+
 //
 // This file defines the ProcessLine base class, its derivitives and helper functions.
 // During coding/decoding, CharLS process one line at a time. The different Processline implementations
@@ -110,6 +115,160 @@ void TransformLine(Triplet<SAMPLE>* pDest, const Triplet<SAMPLE>* pSrc, int pixe
 }
 
 
+// Copy the channels of untransformed (colorTransform == 0) lines without calling the transform per pixel.
+// This is the only case used for DICOM, where the HP color transforms are not allowed.
+
+template<class SAMPLE> 
+void TransformLine(Triplet<SAMPLE>* pDest, const Triplet<SAMPLE>* pSrc, int pixelCount, TransformNoneImpl<SAMPLE>&) 
+{	
+	memcpy(pDest, pSrc, pixelCount * sizeof(Triplet<SAMPLE>));
+}
+
+
+template<class SAMPLE> 
+void TransformLine(Triplet<SAMPLE>* pDest, const Triplet<SAMPLE>* pSrc, int pixelCount, TransformNone<SAMPLE>&) 
+{	
+	memcpy(pDest, pSrc, pixelCount * sizeof(Triplet<SAMPLE>));
+}
+
+
+// SIMD kernels converting between 8 bit triplets and three planes, 16 pixels at a time.
+// They return the number of pixels converted, the remainder is left to the caller.
+
+template<class SAMPLE> 
+int PlanesToTriplets(const SAMPLE*, LONG, Triplet<SAMPLE>*, int)
+{
+	return 0;
+}
+
+
+template<class SAMPLE> 
+int TripletsToPlanes(const Triplet<SAMPLE>*, SAMPLE*, LONG, int)
+{
+	return 0;
+}
+
+
+#ifdef CHARLS_SSSE3
+
+inline bool HasSsse3()
+{
+	static const bool result = __builtin_cpu_supports("ssse3") != 0;
+	return result;
+}
+
+
+__attribute__((target("ssse3")))
+inline int PlanesToTripletsSsse3(const BYTE* ptypeInput, LONG pixelStrideIn, BYTE* pbyteBuffer, int cpixel)
+{
+	const __m128i m00 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+	const __m128i m01 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+	const __m128i m02 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+	const __m128i m10 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+	const __m128i m11 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+	const __m128i m12 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+	const __m128i m20 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+	const __m128i m21 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+	const __m128i m22 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+	int x = 0;
+	for (; x + 16 <= cpixel; x += 16)
+	{
+		const __m128i v1 = _mm_loadu_si128((const __m128i*)(ptypeInput + x));
+		const __m128i v2 = _mm_loadu_si128((const __m128i*)(ptypeInput + x + pixelStrideIn));
+		const __m128i v3 = _mm_loadu_si128((const __m128i*)(ptypeInput + x + 2*pixelStrideIn));
+
+		const __m128i a = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v1, m00), _mm_shuffle_epi8(v2, m01)), _mm_shuffle_epi8(v3, m02));
+		const __m128i b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v1, m10), _mm_shuffle_epi8(v2, m11)), _mm_shuffle_epi8(v3, m12));
+		const __m128i c = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v1, m20), _mm_shuffle_epi8(v2, m21)), _mm_shuffle_epi8(v3, m22));
+
+		_mm_storeu_si128((__m128i*)(pbyteBuffer + 3*x), a);
+		_mm_storeu_si128((__m128i*)(pbyteBuffer + 3*x + 16), b);
+		_mm_storeu_si128((__m128i*)(pbyteBuffer + 3*x + 32), c);
+	}
+	return x;
+}
+
+
+__attribute__((target("ssse3")))
+inline int TripletsToPlanesSsse3(const BYTE* pbyteInput, BYTE* ptypeBuffer, LONG pixelStride, int cpixel)
+{
+	const __m128i m00 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i m01 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+	const __m128i m02 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+	const __m128i m10 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i m11 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+	const __m128i m12 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+	const __m128i m20 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i m21 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+	const __m128i m22 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+
+	int x = 0;
+	for (; x + 16 <= cpixel; x += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(pbyteInput + 3*x));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(pbyteInput + 3*x + 16));
+		const __m128i c = _mm_loadu_si128((const __m128i*)(pbyteInput + 3*x + 32));
+
+		_mm_storeu_si128((__m128i*)(ptypeBuffer + x),
+			_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m00), _mm_shuffle_epi8(b, m01)), _mm_shuffle_epi8(c, m02)));
+		_mm_storeu_si128((__m128i*)(ptypeBuffer + x + pixelStride),
+			_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m10), _mm_shuffle_epi8(b, m11)), _mm_shuffle_epi8(c, m12)));
+		_mm_storeu_si128((__m128i*)(ptypeBuffer + x + 2*pixelStride),
+			_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m20), _mm_shuffle_epi8(b, m21)), _mm_shuffle_epi8(c, m22)));
+	}
+	return x;
+}
+
+
+inline int PlanesToTriplets(const BYTE* ptypeInput, LONG pixelStrideIn, Triplet<BYTE>* pbyteBuffer, int cpixel)
+{
+	if (!HasSsse3())
+		return 0;
+
+	return PlanesToTripletsSsse3(ptypeInput, pixelStrideIn, (BYTE*)pbyteBuffer, cpixel);
+}
+
+
+inline int TripletsToPlanes(const Triplet<BYTE>* pbyteInput, BYTE* ptypeBuffer, LONG pixelStride, int cpixel)
+{
+	if (!HasSsse3())
+		return 0;
+
+	return TripletsToPlanesSsse3((const BYTE*)pbyteInput, ptypeBuffer, pixelStride, cpixel);
+}
+
+#endif
+
+
+template<class SAMPLE> 
+void TransformLineToTriplet(const SAMPLE* ptypeInput, LONG pixelStrideIn, Triplet<SAMPLE>* pbyteBuffer, LONG pixelStride, TransformNoneImpl<SAMPLE>&)
+{
+	int cpixel = MIN(pixelStride, pixelStrideIn);
+
+	for (int x = PlanesToTriplets(ptypeInput, pixelStrideIn, pbyteBuffer, cpixel); x < cpixel; ++x)
+	{
+		pbyteBuffer[x].v1 = ptypeInput[x];
+		pbyteBuffer[x].v2 = ptypeInput[x + pixelStrideIn];
+		pbyteBuffer[x].v3 = ptypeInput[x + 2*pixelStrideIn];
+	}
+}
+
+
+template<class SAMPLE> 
+void TransformTripletToLine(const Triplet<SAMPLE>* pbyteInput, LONG pixelStrideIn, SAMPLE* ptypeBuffer, LONG pixelStride, TransformNone<SAMPLE>&)
+{
+	int cpixel = MIN(pixelStride, pixelStrideIn);
+
+	for (int x = TripletsToPlanes(pbyteInput, ptypeBuffer, pixelStride, cpixel); x < cpixel; ++x)
+	{
+		ptypeBuffer[x] = pbyteInput[x].v1;
+		ptypeBuffer[x + pixelStride] = pbyteInput[x].v2;
+		ptypeBuffer[x + 2 *pixelStride] = pbyteInput[x].v3;
+	}
+}
+
+
 template<class TRANSFORM, class SAMPLE> 
 void TransformLineToTriplet(const SAMPLE* ptypeInput, LONG pixelStrideIn, Triplet<SAMPLE>* pbyteBuffer, LONG pixelStride, TRANSFORM& transform)
 {
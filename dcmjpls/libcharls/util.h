@@ -7,9 +7,14 @@
 #define CHARLS_UTIL
 
 #define INCLUDE_CSTDDEF
+#define INCLUDE_CSTRING
 #include "dcmtk/ofstd/ofstdinc.h"
 #include "pubtypes.h"
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
 #ifndef MAX
 #define MAX(a,b)            (((a) > (b)) ? (a) : (b))
 #endif
@@ -54,6 +59,30 @@ inline LONG BitWiseSign(LONG i)
 	{ return i >> (LONG_BITCOUNT-1); }	
 
 
+// Number of leading zero bits of a non-zero value, used by the bit reader 
+// to decode the unary part of golomb codes without a loop.
+inline LONG CountLeadingZeros(size_t value)
+{
+	ASSERT(value != 0);
+#if defined(__GNUC__)
+	return LONG(__builtin_clzll(value)) - LONG(64 - sizeof(size_t) * 8);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return LONG(sizeof(size_t) * 8 - 1 - index);
+#elif defined(_MSC_VER) && defined(_M_IX86)
+	unsigned long index;
+	_BitScanReverse(&index, (unsigned long)value);
+	return LONG(sizeof(size_t) * 8 - 1 - index);
+#else
+	LONG count = 0;
+	for (size_t mask = size_t(1) << (sizeof(size_t) * 8 - 1); (value & mask) == 0; mask >>= 1)
+		++count;
+	return count;
+#endif
+}
+
+
 template<class SAMPLE>
 struct Triplet
 { 
@@ -122,7 +151,14 @@ struct FromBigEndian<4>
 {
 	inlinehint static unsigned int Read(BYTE* pbyte)
 	{
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+		// single unaligned load and byte swap instead of four byte loads
+		unsigned int value;
+		memcpy(&value, pbyte, sizeof(value));
+		return __builtin_bswap32(value);
+#else
 		return  (pbyte[0] << 24) + (pbyte[1] << 16) + (pbyte[2] << 8) + (pbyte[3] << 0);
+#endif
 	}
 };
 
@@ -133,9 +169,15 @@ struct FromBigEndian<8>
 {
 	inlinehint static size_t Read(BYTE* pbyte)
 	{
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+		unsigned long long value;
+		memcpy(&value, pbyte, sizeof(value));
+		return size_t(__builtin_bswap64(value));
+#else
 		size_t a = FromBigEndian<4>::Read(&pbyte[0]);
 		size_t b = FromBigEndian<4>::Read(&pbyte[4]);
 		return ((a << 16) << 16) + b;
+#endif
 	}
 };
 
@@ -26,6 +26,7 @@
 #include "dcmtk/ofstd/ofcast.h"      /* for casts */
 #include "dcmtk/ofstd/offile.h"      /* for class OFFile */
 #include "dcmtk/ofstd/ofstd.h"       /* for class OFStandard */
+#include "dcmtk/ofstd/ofvector.h"    /* for class OFVector */
 #include "dcmtk/dcmdata/dcdatset.h"  /* for class DcmDataset */
 #include "dcmtk/dcmdata/dcdeftag.h"  /* for tag constants */
 #include "dcmtk/dcmdata/dcpixseq.h"  /* for class DcmPixelSequence */
@@ -33,6 +34,7 @@
 #include "dcmtk/dcmdata/dcvrpobw.h"  /* for class DcmPolymorphOBOW */
 #include "dcmtk/dcmdata/dcswap.h"    /* for swapIfNecessary() */
 #include "dcmtk/dcmdata/dcuid.h"     /* for dcmGenerateUniqueIdentifer()*/
+#include "dcmtk/dcmdata/dcfrmthr.h"  /* for class DcmFrameThreads */
 #include "dcmtk/dcmjpls/djcparam.h"  /* for class DJLSCodecParameter */
 #include "djerror.h"                 /* for private class DJLSError */
 
@@ -62,6 +64,68 @@ DJLSDecoderBase::~DJLSDecoderBase()
 }
 
 
+class DJLSDecoderBase::FrameTask: public DcmFrameDecodeTask
+{
+public:
+  FrameTask(
+    const DJLSCodecParameter *djcp,
+    Uint8 *pixelData,
+    Uint32 frameSize,
+    Uint16 imageColumns,
+    Uint16 imageRows,
+    Uint16 imageSamplesPerPixel,
+    Uint16 bytesPerSample,
+    Uint16 imagePlanarConfiguration)
+  : djcp_(djcp)
+  , pixelData_(pixelData)
+  , frameSize_(frameSize)
+  , imageColumns_(imageColumns)
+  , imageRows_(imageRows)
+  , imageSamplesPerPixel_(imageSamplesPerPixel)
+  , bytesPerSample_(bytesPerSample)
+  , imagePlanarConfiguration_(imagePlanarConfiguration)
+  , fragments_()
+  , fragmentLengths_()
+  {
+  }
+
+  /// adds the compressed bitstream of the next frame
+  void addFragment(Uint8 *fragmentData, Uint32 fragmentLength)
+  {
+    fragments_.push_back(fragmentData);
+    fragmentLengths_.push_back(fragmentLength);
+  }
+
+  virtual OFCondition decodeFrame(Uint32 frameNo) const
+  {
+    DCMJPLS_DEBUG("JPEG-LS decoder processes frame " << (frameNo+1));
+    OFCondition result = decodeBuffer(fragments_[frameNo], fragmentLengths_[frameNo],
+        pixelData_ + OFstatic_cast(size_t, frameNo) * frameSize_, frameSize_,
+        imageColumns_, imageRows_, imageSamplesPerPixel_, bytesPerSample_, imagePlanarConfiguration_);
+
+    // see DJLSDecoderBase::decode()
+    if ((result == EC_JLSInvalidCompressedData) && djcp_->getForceSingleFragmentPerFrame())
+    {
+      DCMJPLS_WARN("JPEG-LS bitstream invalid or incomplete, ignoring (but image is likely to be incomplete).");
+      result = EC_Normal;
+    }
+    return result;
+  }
+
+private:
+  const DJLSCodecParameter *djcp_;
+  Uint8 *pixelData_;
+  Uint32 frameSize_;
+  Uint16 imageColumns_;
+  Uint16 imageRows_;
+  Uint16 imageSamplesPerPixel_;
+  Uint16 bytesPerSample_;
+  Uint16 imagePlanarConfiguration_;
+  OFVector<Uint8 *> fragments_;
+  OFVector<Uint32> fragmentLengths_;
+};
+
+
 OFBool DJLSDecoderBase::canChangeCoding(
     const E_TransferSyntax oldRepType,
     const E_TransferSyntax newRepType) const
@@ -159,6 +223,38 @@ OFCondition DJLSDecoderBase::decode(
   OFBool done = OFFalse;
   OFBool forceSingleFragmentPerFrame = djcp->getForceSingleFragmentPerFrame();
 
+  // with one fragment per frame, the frames can be decompressed independently
+  if ((djcp->getNumThreads() > 1) && (imageFrames > 1) && (pixSeq->card() == OFstatic_cast(unsigned long, imageFrames) + 1))
+  {
+    Uint16 imagePlanarConfiguration = decodedPlanarConfiguration(djcp, dataset, imageSamplesPerPixel);
+    FrameTask task(djcp, pixeldata8, frameSize, imageColumns, imageRows, imageSamplesPerPixel,
+        bytesPerSample, imagePlanarConfiguration);
+
+    // pixel items are not thread safe, collect the fragments up front
+    DcmPixelItem *pixItem = NULL;
+    for (Uint32 i = 1; result.good() && (i <= OFstatic_cast(Uint32, imageFrames)); ++i)
+    {
+      Uint8 *fragmentData = NULL;
+      result = pixSeq->getItem(pixItem, i);
+      if (result.good()) result = pixItem->getUint8Array(fragmentData);
+      if (result.good() && (fragmentData == NULL)) result = EC_JLSInvalidCompressedData;
+      if (result.good()) task.addFragment(fragmentData, pixItem->getLength());
+    }
+
+    if (result.good())
+    {
+      DCMJPLS_DEBUG("JPEG-LS decoder processes " << imageFrames << " frames on " << djcp->getNumThreads() << " threads");
+      result = DcmFrameThreads::decodeFrames(task, OFstatic_cast(Uint32, imageFrames), djcp->getNumThreads());
+    }
+
+    // update planar configuration if we are decoding a color image
+    if (result.good() && (imageSamplesPerPixel > 1))
+    {
+      result = dataset->putAndInsertUint16(DCM_PlanarConfiguration, imagePlanarConfiguration);
+    }
+    done = OFTrue;
+  }
+
   while (result.good() && !done)
   {
       DCMJPLS_DEBUG("JPEG-LS decoder processes frame " << (currentFrame+1));
@@ -320,35 +416,7 @@ OFCondition DJLSDecoderBase::decodeFrame(
   if (fragmentsForThisFrame == 0) result = EC_JLSCannotComputeNumberOfFragments;
 
   // determine planar configuration for uncompressed data
-  OFString imageSopClass;
-  OFString imagePhotometricInterpretation;
-  dataset->findAndGetOFString(DCM_SOPClassUID, imageSopClass);
-  dataset->findAndGetOFString(DCM_PhotometricInterpretation, imagePhotometricInterpretation);
-  Uint16 imagePlanarConfiguration = 0; // 0 is color-by-pixel, 1 is color-by-plane
-
-  if (imageSamplesPerPixel > 1)
-  {
-    switch (cp->getPlanarConfiguration())
-    {
-      case EJLSPC_restore:
-        // get planar configuration from dataset
-        imagePlanarConfiguration = 2; // invalid value
-        dataset->findAndGetUint16(DCM_PlanarConfiguration, imagePlanarConfiguration);
-        // determine auto default if not found or invalid
-        if (imagePlanarConfiguration > 1)
-          imagePlanarConfiguration = determinePlanarConfiguration(imageSopClass, imagePhotometricInterpretation);
-        break;
-      case EJLSPC_auto:
-        imagePlanarConfiguration = determinePlanarConfiguration(imageSopClass, imagePhotometricInterpretation);
-        break;
-      case EJLSPC_colorByPixel:
-        imagePlanarConfiguration = 0;
-        break;
-      case EJLSPC_colorByPlane:
-        imagePlanarConfiguration = 1;
-        break;
-    }
-  }
+  Uint16 imagePlanarConfiguration = decodedPlanarConfiguration(cp, dataset, imageSamplesPerPixel);
 
   // get the size of all the fragments
   if (result.good())
@@ -393,77 +461,130 @@ OFCondition DJLSDecoderBase::decodeFrame(
 
   if (result.good())
   {
-    JlsParameters params;
-    JLS_ERROR err;
-
-    err = JpegLsReadHeader(jlsData, compressedSize, &params);
-    result = DJLSError::convert(err);
+    result = decodeBuffer(jlsData, compressedSize, buffer, bufSize, imageColumns, imageRows,
+        imageSamplesPerPixel, bytesPerSample, imagePlanarConfiguration);
+    delete[] jlsData;
 
-    if (result.good())
+    // update planar configuration if we are decoding a color image
+    if (result.good() && (imageSamplesPerPixel > 1))
     {
-      if (params.width != imageColumns) result = EC_JLSImageDataMismatch;
-      else if (params.height != imageRows) result = EC_JLSImageDataMismatch;
-      else if (params.components != imageSamplesPerPixel) result = EC_JLSImageDataMismatch;
-      else if ((bytesPerSample == 1) && (params.bitspersample > 8)) result = EC_JLSImageDataMismatch;
-      else if ((bytesPerSample == 2) && (params.bitspersample <= 8)) result = EC_JLSImageDataMismatch;
+      dataset->putAndInsertUint16(DCM_PlanarConfiguration, imagePlanarConfiguration);
     }
+  }
+
+  return result;
+}
+
 
-    if (!result.good())
+Uint16 DJLSDecoderBase::decodedPlanarConfiguration(
+    const DJLSCodecParameter *cp,
+    DcmItem *dataset,
+    Uint16 imageSamplesPerPixel)
+{
+  OFString imageSopClass;
+  OFString imagePhotometricInterpretation;
+  dataset->findAndGetOFString(DCM_SOPClassUID, imageSopClass);
+  dataset->findAndGetOFString(DCM_PhotometricInterpretation, imagePhotometricInterpretation);
+  Uint16 imagePlanarConfiguration = 0; // 0 is color-by-pixel, 1 is color-by-plane
+
+  if (imageSamplesPerPixel > 1)
+  {
+    switch (cp->getPlanarConfiguration())
     {
-      delete[] jlsData;
+      case EJLSPC_restore:
+        // get planar configuration from dataset
+        imagePlanarConfiguration = 2; // invalid value
+        dataset->findAndGetUint16(DCM_PlanarConfiguration, imagePlanarConfiguration);
+        // determine auto default if not found or invalid
+        if (imagePlanarConfiguration > 1)
+          imagePlanarConfiguration = determinePlanarConfiguration(imageSopClass, imagePhotometricInterpretation);
+        break;
+      case EJLSPC_auto:
+        imagePlanarConfiguration = determinePlanarConfiguration(imageSopClass, imagePhotometricInterpretation);
+        break;
+      case EJLSPC_colorByPixel:
+        imagePlanarConfiguration = 0;
+        break;
+      case EJLSPC_colorByPlane:
+        imagePlanarConfiguration = 1;
+        break;
     }
-    else
-    {
-      err = JpegLsDecode(buffer, bufSize, jlsData, compressedSize, &params);
-      result = DJLSError::convert(err);
-      delete[] jlsData;
+  }
 
-      if (result.good() && imageSamplesPerPixel == 3)
-      {
-        if (imagePlanarConfiguration == 1 && params.ilv != ILV_NONE)
-        {
-          // The dataset says this should be planarConfiguration == 1, but
-          // it isn't -> convert it.
-          DCMJPLS_WARN("different planar configuration in JPEG stream, converting to \"1\"");
-          if (bytesPerSample == 1)
-            result = createPlanarConfiguration1Byte(OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
-          else
-            result = createPlanarConfiguration1Word(OFreinterpret_cast(Uint16*, buffer), imageColumns, imageRows);
-        }
-        else if (imagePlanarConfiguration == 0 && params.ilv != ILV_SAMPLE && params.ilv != ILV_LINE)
-        {
-          // The dataset says this should be planarConfiguration == 0, but
-          // it isn't -> convert it.
-          DCMJPLS_WARN("different planar configuration in JPEG stream, converting to \"0\"");
-          if (bytesPerSample == 1)
-            result = createPlanarConfiguration0Byte(OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
-          else
-            result = createPlanarConfiguration0Word(OFreinterpret_cast(Uint16*, buffer), imageColumns, imageRows);
-        }
-      }
 
-      if (result.good())
-      {
-          // decompression is complete, finally adjust byte order if necessary
-          if (bytesPerSample == 1) // we're writing bytes into words
-          {
-              result = swapIfNecessary(gLocalByteOrder, EBO_LittleEndian, buffer,
-                      bufSize, sizeof(Uint16));
-          }
-      }
+  return imagePlanarConfiguration;
+}
+
+
+OFCondition DJLSDecoderBase::decodeBuffer(
+    Uint8 *jlsData,
+    size_t compressedSize,
+    void *buffer,
+    Uint32 bufSize,
+    Uint16 imageColumns,
+    Uint16 imageRows,
+    Uint16 imageSamplesPerPixel,
+    Uint16 bytesPerSample,
+    Uint16 imagePlanarConfiguration)
+{
+  JlsParameters params;
+  JLS_ERROR err;
+
+  err = JpegLsReadHeader(jlsData, compressedSize, &params);
+  OFCondition result = DJLSError::convert(err);
+
+  if (result.good())
+  {
+    if (params.width != imageColumns) result = EC_JLSImageDataMismatch;
+    else if (params.height != imageRows) result = EC_JLSImageDataMismatch;
+    else if (params.components != imageSamplesPerPixel) result = EC_JLSImageDataMismatch;
+    else if ((bytesPerSample == 1) && (params.bitspersample > 8)) result = EC_JLSImageDataMismatch;
+    else if ((bytesPerSample == 2) && (params.bitspersample <= 8)) result = EC_JLSImageDataMismatch;
+  }
 
-      // update planar configuration if we are decoding a color image
-      if (result.good() && (imageSamplesPerPixel > 1))
+  if (result.good())
+  {
+    err = JpegLsDecode(buffer, bufSize, jlsData, compressedSize, &params);
+    result = DJLSError::convert(err);
+  }
+
+  if (result.good() && imageSamplesPerPixel == 3)
+  {
+    if (imagePlanarConfiguration == 1 && params.ilv != ILV_NONE)
+    {
+      // The dataset says this should be planarConfiguration == 1, but
+      // it isn't -> convert it.
+      DCMJPLS_WARN("different planar configuration in JPEG stream, converting to \"1\"");
+      if (bytesPerSample == 1)
+        result = createPlanarConfiguration1Byte(OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
+      else
+        result = createPlanarConfiguration1Word(OFreinterpret_cast(Uint16*, buffer), imageColumns, imageRows);
+    }
+    else if (imagePlanarConfiguration == 0 && params.ilv != ILV_SAMPLE && params.ilv != ILV_LINE)
+    {
+      // The dataset says this should be planarConfiguration == 0, but
+      // it isn't -> convert it.
+      DCMJPLS_WARN("different planar configuration in JPEG stream, converting to \"0\"");
+      if (bytesPerSample == 1)
+        result = createPlanarConfiguration0Byte(OFreinterpret_cast(Uint8*, buffer), imageColumns, imageRows);
+      else
+        result = createPlanarConfiguration0Word(OFreinterpret_cast(Uint16*, buffer), imageColumns, imageRows);
+    }
+  }
+
+  if (result.good())
+  {
+      // decompression is complete, finally adjust byte order if necessary
+      if (bytesPerSample == 1) // we're writing bytes into words
       {
-        dataset->putAndInsertUint16(DCM_PlanarConfiguration, imagePlanarConfiguration);
+          result = swapIfNecessary(gLocalByteOrder, EBO_LittleEndian, buffer,
+                  bufSize, sizeof(Uint16));
       }
-    }
   }
 
   return result;
 }
 
-
 OFCondition DJLSDecoderBase::encode(
     const Uint16 * /* pixelData */,
     const Uint32 /* length */,
@@ -45,6 +45,7 @@
 #include "dcmtk/dcmdata/dcvrst.h"    /* for class DcmShortText */
 #include "dcmtk/dcmdata/dcvrus.h"    /* for class DcmUnsignedShort */
 #include "dcmtk/dcmdata/dcswap.h"    /* for swapIfNecessary */
+#include "dcmtk/dcmdata/dcfrmthr.h"  /* for class DcmFrameThreads */
 
 // dcmjpls includes
 #include "dcmtk/dcmjpls/djcparam.h"  /* for class DJLSCodecParameter */
@@ -82,6 +83,92 @@ E_TransferSyntax DJLSNearLosslessEncoder::supportedTransferSyntax() const
 
 // --------------------------------------------------------------------------
 
+class DJLSEncoderBase::RawFrameTask: public DcmFrameEncodeTask
+{
+public:
+  RawFrameTask(
+    const DJLSEncoderBase& encoder,
+    const Uint8 *pixelData,
+    Uint32 frameCount,
+    Uint16 bitsAllocated,
+    Uint16 columns,
+    Uint16 rows,
+    Uint16 samplesPerPixel,
+    Uint16 planarConfiguration,
+    const OFString& photometricInterpretation,
+    const DJLSCodecParameter *djcp)
+  : encoder_(encoder)
+  , pixelData_(pixelData)
+  , frameCount_(frameCount)
+  , bitsAllocated_(bitsAllocated)
+  , columns_(columns)
+  , rows_(rows)
+  , samplesPerPixel_(samplesPerPixel)
+  , planarConfiguration_(planarConfiguration)
+  , photometricInterpretation_(photometricInterpretation)
+  , djcp_(djcp)
+  {
+  }
+
+  virtual OFCondition encodeFrame(Uint32 frameNo, Uint8 *&compressedData, Uint32 &compressedLen) const
+  {
+    DCMJPLS_DEBUG("JPEG-LS encoder processes frame " << (frameNo+1) << " of " << frameCount_);
+    size_t frameSize = OFstatic_cast(size_t, columns_) * rows_ * samplesPerPixel_ * (bitsAllocated_ / 8);
+    return encoder_.compressRawFrame(pixelData_ + frameNo * frameSize, bitsAllocated_, columns_, rows_,
+        samplesPerPixel_, planarConfiguration_, photometricInterpretation_, compressedData, compressedLen, djcp_);
+  }
+
+private:
+  const DJLSEncoderBase& encoder_;
+  const Uint8 *pixelData_;
+  Uint32 frameCount_;
+  Uint16 bitsAllocated_;
+  Uint16 columns_;
+  Uint16 rows_;
+  Uint16 samplesPerPixel_;
+  Uint16 planarConfiguration_;
+  const OFString& photometricInterpretation_;
+  const DJLSCodecParameter *djcp_;
+};
+
+
+class DJLSEncoderBase::CookedFrameTask: public DcmFrameEncodeTask
+{
+public:
+  CookedFrameTask(
+    const DJLSEncoderBase& encoder,
+    const DicomImage *dimage,
+    Uint32 frameCount,
+    const OFString& photometricInterpretation,
+    const DJLSCodecParameter *djcp,
+    Uint16 nearLosslessDeviation)
+  : encoder_(encoder)
+  , dimage_(dimage)
+  , frameCount_(frameCount)
+  , photometricInterpretation_(photometricInterpretation)
+  , djcp_(djcp)
+  , nearLosslessDeviation_(nearLosslessDeviation)
+  {
+  }
+
+  virtual OFCondition encodeFrame(Uint32 frameNo, Uint8 *&compressedData, Uint32 &compressedLen) const
+  {
+    DCMJPLS_DEBUG("JPEG-LS encoder processes frame " << (frameNo+1) << " of " << frameCount_);
+    return encoder_.compressCookedFrame(dimage_, photometricInterpretation_, compressedData, compressedLen,
+        djcp_, frameNo, nearLosslessDeviation_);
+  }
+
+private:
+  const DJLSEncoderBase& encoder_;
+  const DicomImage *dimage_;
+  Uint32 frameCount_;
+  const OFString& photometricInterpretation_;
+  const DJLSCodecParameter *djcp_;
+  Uint16 nearLosslessDeviation_;
+};
+
+// --------------------------------------------------------------------------
+
 DJLSEncoderBase::DJLSEncoderBase()
 : DcmCodec()
 {
@@ -485,8 +572,7 @@ OFCondition DJLSEncoderBase::losslessRawEncode(
   }
 
   DcmOffsetList offsetList;
-  unsigned long compressedSize = 0;
-  unsigned long compressedFrameSize = 0;
+  size_t compressedSize = 0;
   double uncompressedSize = 0.0;
 
   // render and compress each frame
@@ -501,23 +587,15 @@ OFCondition DJLSEncoderBase::losslessRawEncode(
     }
 
     unsigned long frameCount = OFstatic_cast(unsigned long, numberOfFrames);
-    unsigned long frameSize = columns * rows * samplesPerPixel * bytesAllocated;
-    const Uint8 *framePointer = OFreinterpret_cast(const Uint8 *, pixelData);
 
     // compute original image size in bytes, ignoring any padding bits.
     uncompressedSize = columns * rows * samplesPerPixel * bitsStored * frameCount / 8.0;
 
-    for (unsigned long i=0; (i<frameCount) && (result.good()); ++i)
-    {
-      // compress frame
-      DCMJPLS_DEBUG("JPEG-LS encoder processes frame " << (i+1) << " of " << frameCount);
-      result = compressRawFrame(framePointer, bitsAllocated, columns, rows,
-          samplesPerPixel, planarConfiguration, photometricInterpretation,
-          pixelSequence, offsetList, compressedFrameSize, djcp);
-
-      compressedSize += compressedFrameSize;
-      framePointer += frameSize;
-    }
+    // frames are independent, compress them in parallel if requested
+    RawFrameTask task(*this, OFreinterpret_cast(const Uint8 *, pixelData), OFstatic_cast(Uint32, frameCount),
+        bitsAllocated, columns, rows, samplesPerPixel, planarConfiguration, photometricInterpretation, djcp);
+    result = DcmFrameThreads::encodeFrames(task, OFstatic_cast(Uint32, frameCount), djcp->getNumThreads(),
+        pixelSequence, offsetList, djcp->getFragmentSize(), compressedSize);
   }
 
   // store pixel sequence if everything went well.
@@ -529,9 +607,9 @@ OFCondition DJLSEncoderBase::losslessRawEncode(
   }
 
   // create offset table
-  if ((result.good()) && (djcp->getCreateOffsetTable()))
+  if (result.good())
   {
-    result = offsetTable->createOffsetTable(offsetList);
+    result = createOffsetTables(dataset, pixSeq, offsetList, djcp->getCreateOffsetTable());
   }
 
   // adjust planar configuration
@@ -629,15 +707,13 @@ OFCondition DJLSEncoderBase::compressRawFrame(
   Uint16 samplesPerPixel,
   Uint16 planarConfiguration,
   const OFString& /* photometricInterpretation */,
-  DcmPixelSequence *pixelSequence,
-  DcmOffsetList &offsetList,
-  unsigned long &compressedSize,
+  Uint8 *&compressedData,
+  Uint32 &compressedSize,
   const DJLSCodecParameter *djcp) const
 {
   OFCondition result = EC_Normal;
   Uint16 bytesAllocated = bitsAllocated / 8;
   Uint32 frameSize = width*height*bytesAllocated*samplesPerPixel;
-  Uint32 fragmentSize = djcp->getFragmentSize();
   JlsParameters jls_params;
   Uint8 *frameBuffer = NULL;
 
@@ -736,12 +812,13 @@ OFCondition DJLSEncoderBase::compressRawFrame(
 
     if (result.good())
     {
-      compressedSize = OFstatic_cast(unsigned long, bytesWritten);
-      fixPaddingIfNecessary(OFstatic_cast(Uint8 *, buffer), size, compressedSize, djcp->getUseFFbitstreamPadding());
-      result = pixelSequence->storeCompressedFrame(offsetList, buffer, compressedSize, fragmentSize);
+      unsigned long bufferLength = OFstatic_cast(unsigned long, bytesWritten);
+      fixPaddingIfNecessary(OFstatic_cast(Uint8 *, buffer), size, bufferLength, djcp->getUseFFbitstreamPadding());
+      compressedData = buffer;
+      compressedSize = OFstatic_cast(Uint32, bufferLength);
     }
-
-    delete[] buffer;
+    else
+      delete[] buffer;
   }
 
   if (frameBuffer)
@@ -858,8 +935,7 @@ OFCondition DJLSEncoderBase::losslessCookedEncode(
   }
 
   DcmOffsetList offsetList;
-  unsigned long compressedSize = 0;
-  unsigned long compressedFrameSize = 0;
+  size_t compressedSize = 0;
   double uncompressedSize = 0.0;
 
   // render and compress each frame
@@ -873,15 +949,11 @@ OFCondition DJLSEncoderBase::losslessCookedEncode(
     uncompressedSize = dimage->getWidth() * dimage->getHeight() *
       bitsPerSample * frameCount * samplesPerPixel / 8.0;
 
-    for (unsigned long i=0; (i<frameCount) && (result.good()); ++i)
-    {
-      // compress frame
-      DCMJPLS_DEBUG("JPEG-LS encoder processes frame " << (i+1) << " of " << frameCount);
-      result = compressCookedFrame(pixelSequence, dimage,
-          photometricInterpretation, offsetList, compressedFrameSize, djcp, i, nearLosslessDeviation);
-
-      compressedSize += compressedFrameSize;
-    }
+    // all frames have been rendered by the DicomImage constructor, the
+    // intermediate representation is only read from here on
+    CookedFrameTask task(*this, dimage, OFstatic_cast(Uint32, frameCount), photometricInterpretation, djcp, nearLosslessDeviation);
+    result = DcmFrameThreads::encodeFrames(task, OFstatic_cast(Uint32, frameCount), djcp->getNumThreads(),
+        pixelSequence, offsetList, djcp->getFragmentSize(), compressedSize);
   }
 
   // store pixel sequence if everything went well.
@@ -893,9 +965,9 @@ OFCondition DJLSEncoderBase::losslessCookedEncode(
   }
 
   // create offset table
-  if ((result.good()) && (djcp->getCreateOffsetTable()))
+  if (result.good())
   {
-    result = offsetTable->createOffsetTable(offsetList);
+    result = createOffsetTables(dataset, pixSeq, offsetList, djcp->getCreateOffsetTable());
   }
 
   // adapt attributes in image pixel module
@@ -931,11 +1003,10 @@ OFCondition DJLSEncoderBase::losslessCookedEncode(
 
 
 OFCondition DJLSEncoderBase::compressCookedFrame(
-  DcmPixelSequence *pixelSequence,
-  DicomImage *dimage,
+  const DicomImage *dimage,
   const OFString& /* photometricInterpretation */,
-  DcmOffsetList &offsetList,
-  unsigned long &compressedSize,
+  Uint8 *&compressedData,
+  Uint32 &compressedSize,
   const DJLSCodecParameter *djcp,
   Uint32 frame,
   Uint16 nearLosslessDeviation) const
@@ -948,8 +1019,6 @@ OFCondition DJLSEncoderBase::compressCookedFrame(
   int depth = dimage->getDepth();
   if ((depth < 1) || (depth > 16)) return EC_JLSUnsupportedBitDepth;
 
-  Uint32 fragmentSize = djcp->getFragmentSize();
-
   const DiPixel *dinter = dimage->getInterData();
   if (dinter == NULL) return EC_IllegalCall;
 
@@ -1138,13 +1207,15 @@ OFCondition DJLSEncoderBase::compressCookedFrame(
   if (result.good())
   {
     // 'compressed_buffer_size' now contains the size of the compressed data in buffer
-    compressedSize = OFstatic_cast(unsigned long, bytesWritten);
-    fixPaddingIfNecessary(OFstatic_cast(Uint8 *, buffer), compressed_buffer_size, compressedSize, djcp->getUseFFbitstreamPadding());
-    result = pixelSequence->storeCompressedFrame(offsetList, compressed_buffer, compressedSize, fragmentSize);
+    unsigned long bufferLength = OFstatic_cast(unsigned long, bytesWritten);
+    fixPaddingIfNecessary(OFstatic_cast(Uint8 *, buffer), compressed_buffer_size, bufferLength, djcp->getUseFFbitstreamPadding());
+    compressedData = compressed_buffer;
+    compressedSize = OFstatic_cast(Uint32, bufferLength);
   }
+  else
+    delete[] compressed_buffer;
 
   delete[] buffer;
-  delete[] compressed_buffer;
   if (frameBuffer)
     delete[] frameBuffer;
 
@@ -35,11 +35,12 @@ void DJLSDecoderRegistration::registerCodecs(
     JLS_UIDCreation uidcreation,
     JLS_PlanarConfiguration planarconfig,
     OFBool ignoreOffsetTable,
-    OFBool forceSingleFragmentPerFrame)
+    OFBool forceSingleFragmentPerFrame,
+    Uint16 numThreads)
 {
   if (! registered_)
   {
-    cp_ = new DJLSCodecParameter(uidcreation, planarconfig, ignoreOffsetTable, forceSingleFragmentPerFrame);
+    cp_ = new DJLSCodecParameter(uidcreation, planarconfig, ignoreOffsetTable, forceSingleFragmentPerFrame, numThreads);
     if (cp_)
     {
       losslessdecoder_ = new DJLSLosslessDecoder();
@@ -52,6 +53,11 @@ void DJLSDecoderRegistration::registerCodecs(
   }
 }
 
+void DJLSDecoderRegistration::setNumThreads(Uint16 numThreads)
+{
+  if (registered_ && cp_) cp_->setNumThreads(numThreads);
+}
+
 void DJLSDecoderRegistration::cleanup()
 {
   if (registered_)
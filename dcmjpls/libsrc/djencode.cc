@@ -43,13 +43,14 @@ void DJLSEncoderRegistration::registerCodecs(
     JLS_UIDCreation uidCreation,
     OFBool convertToSC,
     DJLSCodecParameter::interleaveMode jplsInterleaveMode,
-    OFBool useFFbitstreamPadding)
+    OFBool useFFbitstreamPadding,
+    Uint16 numThreads)
 {
   if (! registered_)
   {
     cp_ = new DJLSCodecParameter(preferCookedEncoding, jpls_t1, jpls_t2, jpls_t3,
       jpls_reset, fragmentSize, createOffsetTable, uidCreation,
-      convertToSC, EJLSPC_restore, OFFalse, jplsInterleaveMode, useFFbitstreamPadding);
+      convertToSC, EJLSPC_restore, OFFalse, jplsInterleaveMode, useFFbitstreamPadding, numThreads);
 
     if (cp_)
     {
@@ -62,6 +63,11 @@ void DJLSEncoderRegistration::registerCodecs(
   }
 }
 
+void DJLSEncoderRegistration::setNumThreads(Uint16 numThreads)
+{
+  if (registered_ && cp_) cp_->setNumThreads(numThreads);
+}
+
 void DJLSEncoderRegistration::cleanup()
 {
   if (registered_)
@@ -234,6 +234,13 @@ struct DCMTK_DCMNET_EXPORT T_ASC_Parameters
     long ourMaxPDUReceiveSize;    /* we say what we can receive */
     long theirMaxPDUReceiveSize;  /* they say what we can send */
 
+    /* asynchronous operations window of the peer: what the requestor
+     * proposed (acceptor) or the acceptor granted (requestor), 1 if
+     * the sub-item was omitted and 0 for an unlimited number
+     */
+    unsigned short theirMaxOperationsInvoked;
+    unsigned short theirMaxOperationsPerformed;
+
 };
 
 /*
@@ -324,6 +331,31 @@ ASC_setAPTitles(
   * into the supplied string variables.  You must provide storage to copy
   * into.
   */
+/*
+ * Sets the Asynchronous Operations Window sent in the A-ASSOCIATE-RQ
+ * (requestor) or the one granted in the A-ASSOCIATE-AC (acceptor). The
+ * sub-item is only sent if one of the values exceeds 1, the default of
+ * synchronous operation. An acceptor should not grant more than the
+ * requestor proposed (see ASC_getAsyncOperationsWindow()).
+ */
+DCMTK_DCMNET_EXPORT OFCondition
+ASC_setAsyncOperationsWindow(
+    T_ASC_Parameters * params,
+    unsigned short maxOperationsInvoked,
+    unsigned short maxOperationsPerformed);
+
+/*
+ * Returns the Asynchronous Operations Window of the peer, i.e. the one
+ * proposed by the requestor after ASC_receiveAssociation() or the one
+ * granted by the acceptor after ASC_requestAssociation(). Both values are
+ * 1 if the peer omitted the sub-item, 0 stands for an unlimited number.
+ */
+DCMTK_DCMNET_EXPORT OFCondition
+ASC_getAsyncOperationsWindow(
+    T_ASC_Parameters * params,
+    unsigned short * maxOperationsInvoked,
+    unsigned short * maxOperationsPerformed);
+
 DCMTK_DCMNET_EXPORT OFCondition
 ASC_getAPTitles(
     T_ASC_Parameters * params,
@@ -624,6 +656,22 @@ DCMTK_DCMNET_EXPORT unsigned long ASC_getPeerCertificate(T_ASC_Association *asso
 DCMTK_DCMNET_EXPORT OFCondition
 ASC_setTransportLayer(T_ASC_Network *network, DcmTransportLayer *newLayer, int takeoverOwnership);
 
+/* set SO_SNDBUF/SO_RCVBUF (bytes, 0 for 64 KB) and TCP_NODELAY (0 or 1) for all
+ * connections of the network. -1 keeps the behaviour controlled by the environment
+ * variables TCP_BUFFER_LENGTH and TCP_NODELAY.
+ */
+DCMTK_DCMNET_EXPORT OFCondition
+ASC_setTCPSocketOptions(T_ASC_Network *network, int bufferLength, int noDelay);
+
+/* enable TCP keepalive for all connections of the network, so that peers that vanished
+ * without closing the connection are noticed: probes are sent after idle seconds without
+ * traffic and then every interval seconds, after probes unanswered ones the connection
+ * fails. Where supported, data left unacknowledged as long fails it as well. idle 0
+ * disables keepalive (the default).
+ */
+DCMTK_DCMNET_EXPORT OFCondition
+ASC_setTCPKeepAlive(T_ASC_Network *network, int idle, int interval, int probes);
+
 enum ASC_associateType
 {
     ASC_ASSOC_RQ,
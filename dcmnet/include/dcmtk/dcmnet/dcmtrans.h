@@ -28,6 +28,7 @@
 #include "dcmtk/ofstd/ofglobal.h"     /* for OFGlobal */
 #include "dcmtk/ofstd/oftypes.h"      /* for OFBool */
 #include "dcmtk/ofstd/ofstream.h"     /* for ostream */
+#include "dcmtk/ofstd/offile.h"       /* for OFFile */
 #include "dcmtk/dcmnet/dcmlayer.h"    /* for DcmTransportLayerStatus */
 
 #define INCLUDE_UNISTD
@@ -59,6 +60,17 @@ extern DCMTK_DCMNET_EXPORT OFGlobal<Sint32> dcmSocketSendTimeout;   /* default:
  */
 extern DCMTK_DCMNET_EXPORT OFGlobal<Sint32> dcmSocketReceiveTimeout;   /* default: 60 */
 
+/** a block of data for a gathered write, see DcmTransportConnection::writeBlocks()
+ */
+struct DCMTK_DCMNET_EXPORT DcmTransportBlock
+{
+  /// start of the data
+  const void *data;
+
+  /// number of bytes
+  size_t length;
+};
+
 /** this class represents a TCP/IP based transport connection
  *  which can be a transparent TCP/IP socket communication or a
  *  secure transport protocol such as TLS.
@@ -116,6 +128,28 @@ public:
    */
   virtual ssize_t write(void *buf, size_t nbyte) = 0;
 
+  /** writes the given blocks of data in the given order to the transport
+   *  connection. The default implementation calls write() for each block.
+   *  @param blocks blocks of data to be written
+   *  @param count number of blocks
+   *  @return number of bytes written, which is less than the sum of the block
+   *    lengths (or negative) only if an error occurred.
+   */
+  virtual ssize_t writeBlocks(const DcmTransportBlock *blocks, size_t count);
+
+  /** writes a block of data followed by a range of a file to the transport
+   *  connection. The default implementation reads the file into a buffer and
+   *  calls write(). The file position is undefined afterwards.
+   *  @param head block of data written before the file contents
+   *  @param headLength number of bytes in head
+   *  @param file file to be read
+   *  @param offset position of the first byte in the file
+   *  @param length number of bytes to be written from the file
+   *  @return number of bytes written including headLength, which is less than
+   *    requested (or negative) only if an error occurred.
+   */
+  virtual ssize_t writeFile(const void *head, size_t headLength, OFFile &file, offile_off_t offset, size_t length);
+
   /** Closes the transport connection. If a secure connection
    *  is used, a closure alert is sent before the connection
    *  is closed. Abstract method.
@@ -185,18 +219,34 @@ public:
    */
   static OFBool selectReadableAssociation(DcmTransportConnection *connections[], int connCount, int timeout);
 
-protected:
-
   /** returns the socket file descriptor managed by this object.
+   *  Event loops may poll it directly, which is only meaningful for
+   *  transparent connections, see isTransparentConnection().
    *  @return socket file descriptor
    */
   DcmNativeSocketType getSocket() { return theSocket; }
 
+  /** ends pending and further reads and writes of this connection, so that
+   *  another thread can stop an association blocked waiting for its peer.
+   *  The socket itself stays open until close() is called.
+   */
+  void interrupt();
+
+protected:
+
   /** set the socket file descriptor managed by this object.
    *  @param socket file descriptor
    */
   void setSocket(DcmNativeSocketType socket) { theSocket = socket; }
 
+  /** writes a range of a file through a buffer by calling write().
+   *  @param file file to be read
+   *  @param offset position of the first byte in the file
+   *  @param length number of bytes to be written
+   *  @return number of bytes written, less than length (or negative) only if an error occurred.
+   */
+  ssize_t writeFileBuffered(OFFile &file, offile_off_t offset, size_t length);
+
 private:
 
   /// private undefined copy constructor
@@ -301,6 +351,28 @@ public:
    */
   virtual ssize_t write(void *buf, size_t nbyte);
 
+  /** writes the given blocks of data in the given order to the transport
+   *  connection with a single gathered write (writev) where available.
+   *  @param blocks blocks of data to be written
+   *  @param count number of blocks
+   *  @return number of bytes written, which is less than the sum of the block
+   *    lengths (or negative) only if an error occurred.
+   */
+  virtual ssize_t writeBlocks(const DcmTransportBlock *blocks, size_t count);
+
+  /** writes a block of data followed by a range of a file to the transport
+   *  connection. Where available (sendfile), the file contents are sent from
+   *  the page cache without being copied into user space.
+   *  @param head block of data written before the file contents
+   *  @param headLength number of bytes in head
+   *  @param file file to be read
+   *  @param offset position of the first byte in the file
+   *  @param length number of bytes to be written from the file
+   *  @return number of bytes written including headLength, which is less than
+   *    requested (or negative) only if an error occurred.
+   */
+  virtual ssize_t writeFile(const void *head, size_t headLength, OFFile &file, offile_off_t offset, size_t length);
+
   /** Closes the transport connection. If a secure connection
    *  is used, a closure alert is sent before the connection
    *  is closed.
@@ -346,6 +418,38 @@ public:
    */
   virtual const char *errorString(DcmTransportLayerStatus code);
 
+  /** returns the number of bytes received over all transparent TCP
+   *  connections of this process since it was started.
+   *  @return bytes received
+   */
+  static Uint64 bytesReceived();
+
+  /** returns the number of bytes sent over all transparent TCP
+   *  connections of this process since it was started.
+   *  @return bytes sent
+   */
+  static Uint64 bytesSent();
+
+  /** returns the number of transparent TCP connections that are
+   *  currently open in this process.
+   *  @return open connections
+   */
+  static size_t openConnections();
+
+protected:
+
+  /** adds bytes a subclass received without calling DcmTCPConnection::read()
+   *  to the ones returned by bytesReceived().
+   *  @param count number of bytes received
+   */
+  static void countBytesReceived(size_t count);
+
+  /** adds bytes a subclass sent without calling DcmTCPConnection::write()
+   *  to the ones returned by bytesSent().
+   *  @param count number of bytes sent
+   */
+  static void countBytesSent(size_t count);
+
 private:
 
   /// private undefined copy constructor
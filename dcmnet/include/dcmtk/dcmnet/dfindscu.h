@@ -29,6 +29,7 @@
 
 // forward declarations of classes and structs
 class DcmDataset;
+class DcmReadProjection;
 class DcmTransportLayer;
 class OFConsoleApplication;
 struct T_ASC_Association;
@@ -99,6 +100,14 @@ public:
         T_DIMSE_C_FindRSP *rsp,
         DcmDataset *responseIdentifiers) = 0;
 
+  /** returns the elements of the response identifiers that are read from the
+   *  network, the values of the others are skipped while receiving a response
+   *  (see DcmDataset::setReadProjection()). The default implementation reads
+   *  all elements.
+   *  @return projection, which must remain valid during the C-FIND, or NULL
+   */
+  virtual const DcmReadProjection *responseProjection() const;
+
   /** assigns a value to member variable assoc_. Used by FindSCU code
    *  (class DcmFindSCU) to store a pointer to the current association
    *  before the callback object is used.
@@ -219,6 +228,16 @@ public:
    */
   OFCondition setTransportLayer(DcmTransportLayer *tLayer);
 
+  /** set TCP socket options for the network associations. Must be called
+   *  after initializeNetwork(), but prior to any call to performQuery().
+   *  @param bufferLength SO_SNDBUF/SO_RCVBUF in bytes, 0 for 64 KB,
+   *    -1 to use the environment variable TCP_BUFFER_LENGTH
+   *  @param noDelay 1 to disable the Nagle algorithm, 0 to keep it,
+   *    -1 to use the environment variable TCP_NODELAY
+   *  @return EC_Normal if successful, an error code otherwise.
+   */
+  OFCondition setTCPSocketOptions(int bufferLength, int noDelay);
+
   /** destroy network struct. This should be done only once.
    *  @return EC_Normal if successful, an error code otherwise.
    */
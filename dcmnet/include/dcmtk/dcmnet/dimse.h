@@ -119,6 +119,22 @@ extern DCMTK_DCMNET_EXPORT OFGlobal<OFBool> dcmPeerRequiresExactUIDCopy; /* defa
  */
 extern DCMTK_DCMNET_EXPORT OFGlobal<Uint32> dcmMaxOutgoingPDUSize; /* default 2^32-1 */
 
+/** global variable specifying the minimum length of incoming P-DATA PDUs
+ *  whose data set fragment is received straight from the socket into the
+ *  value fields of the data set by DIMSE_receiveDataSetInMemory(), instead
+ *  of being read into the PDU buffer and copied from there. 0 disables this.
+ */
+extern DCMTK_DCMNET_EXPORT OFGlobal<Uint32> dcmDirectPDVReceiveLength; /* default 65536 */
+
+/** global variable specifying whether the data set of a file passed to
+ *  DIMSE_sendMessageUsingFileData() is sent as stored in the file if it is
+ *  encoded in the transfer syntax of the presentation context, instead of
+ *  being parsed and encoded again. The bytes are passed from the file to the
+ *  transport connection without being copied into the PDU buffer where the
+ *  platform allows (sendfile on Linux).
+ */
+extern DCMTK_DCMNET_EXPORT OFGlobal<OFBool> dcmSendFileDataUnchanged; /* default OFFalse */
+
 
 /*
  * General Status Codes.
@@ -732,6 +748,31 @@ DIMSE_storeUser(
         /* in */
         long imageFileTotalBytes=0);
 
+/* sends a C-STORE-RQ without waiting for the response, see DIMSE_storeUser() */
+DCMTK_DCMNET_EXPORT OFCondition
+DIMSE_sendStoreRequest(
+        /* in */
+        T_ASC_Association *assoc, T_ASC_PresentationContextID presId,
+        T_DIMSE_C_StoreRQ *request,
+        const char *imageFileName, DcmDataset *imageDataSet,
+        DIMSE_StoreUserCallback callback, void *callbackData,
+        long imageFileTotalBytes=0);
+
+/* receives the next C-STORE-RSP on the association, the caller matches it to
+ * an outstanding request by its MessageIDBeingRespondedTo
+ */
+DCMTK_DCMNET_EXPORT OFCondition
+DIMSE_receiveStoreResponse(
+        /* in */
+        T_ASC_Association *assoc,
+        /* blocking info for response */
+        T_DIMSE_BlockingMode blockMode, int timeout,
+        /* out */
+        T_ASC_PresentationContextID *presId,
+        T_DIMSE_C_StoreRSP *response,
+        DcmDataset **statusDetail,
+        T_DIMSE_DetectedCancelParameters *checkForCancelParams = NULL);
+
 typedef void (*DIMSE_StoreProviderCallback)(
     /* in */
     void *callbackData,
@@ -796,7 +837,11 @@ DIMSE_findUser(
          * then any status detail information from the C-FIND-RSP message will
          * be returned in this dataset.
          */
-        DcmDataset **statusDetail);
+        DcmDataset **statusDetail,
+        /* if not NULL, only the elements of the response identifiers selected
+         * by this projection are read, see DcmDataset::setReadProjection().
+         */
+        const DcmReadProjection *responseProjection = NULL);
 
 typedef void (*DIMSE_FindProviderCallback)(
         /* in */
@@ -1048,6 +1093,36 @@ DIMSE_sendMessageUsingMemoryData(T_ASC_Association *association,
                   void *callbackContext,
                   DcmDataset **commandSet=NULL);
 
+/** send the command of a DIMSE message whose data set is sent separately in fragments
+ *  with DIMSE_sendDataSetFragment(), e.g. while it is still being received from
+ *  another association.
+ *  @param assoc            The association (network connection to another DICOM application).
+ *  @param presId           The ID of the presentation context which shall be used
+ *  @param msg              Structure that represents a certain DIMSE command which shall be sent.
+ *  @return EC_Normal if successful, an error code otherwise.
+ */
+DCMTK_DCMNET_EXPORT OFCondition
+DIMSE_sendMessageCommand(T_ASC_Association *assoc,
+                  T_ASC_PresentationContextID presID,
+                  T_DIMSE_Message *msg);
+
+/** send a fragment of the data set of a DIMSE message whose command was sent with
+ *  DIMSE_sendMessageCommand(). The fragments are passed on as they are, they have to be
+ *  encoded in the transfer syntax of the presentation context and of even length.
+ *  @param assoc            The association (network connection to another DICOM application).
+ *  @param presId           The ID of the presentation context which shall be used
+ *  @param data             The fragment, split into PDVs of the outgoing PDU size.
+ *  @param length           Length of the fragment.
+ *  @param last             OFTrue for the last fragment of the data set.
+ *  @return EC_Normal if successful, an error code otherwise.
+ */
+DCMTK_DCMNET_EXPORT OFCondition
+DIMSE_sendDataSetFragment(T_ASC_Association *assoc,
+                  T_ASC_PresentationContextID presID,
+                  const void *data,
+                  Uint32 length,
+                  OFBool last);
+
 /** receive a DIMSE command via network from another DICOM application.
  *  @param assoc        The association (network connection to another DICOM application).
  *  @param blocking     The blocking mode for reading data (either DIMSE_BLOCKING or DIMSE_NONBLOCKING)
@@ -25,6 +25,7 @@
 #include "dcmtk/config/osconfig.h"  /* make sure OS specific configuration is included first */
 
 #include "dcmtk/dcmnet/scu.h"       /* for base class DcmSCU */
+#include "dcmtk/ofstd/ofmap.h"      /* for class OFMap */
 
 
 /*---------------------*
@@ -146,6 +147,12 @@ class DCMTK_DCMNET_EXPORT DcmStorageSCU
      */
     OFBool getAllowIllegalProposalMode() const;
 
+    /** get mode that specifies whether to propose Deflated Explicit VR Little Endian first
+     *  for uncompressed SOP instances of non-image storage SOP classes.
+     *  @return mode indicating whether to propose deflate first or not
+     */
+    OFBool getProposeDeflatedMode() const;
+
     /** get mode that specifies whether to read information on SOP instances to be sent from
      *  the DICOMDIR files that are added to the transfer list.
      *  @return mode indicating whether to read from DICOMDIR files or not
@@ -195,6 +202,16 @@ class DCMTK_DCMNET_EXPORT DcmStorageSCU
      */
     void setAllowIllegalProposalMode(const OFBool allowMode);
 
+    /** set mode that specifies whether to propose Deflated Explicit VR Little Endian first
+     *  for uncompressed SOP instances of non-image storage SOP classes, e.g. structured
+     *  reports or encapsulated documents, followed by the three uncompressed transfer
+     *  syntaxes.  Image SOP classes are not affected.  The mode has no effect if DCMTK is
+     *  compiled without zlib support.
+     *  @param  deflatedMode  mode indicating whether to propose deflate first or not
+     *                        (default: OFFalse, i.e.\ do not propose)
+     */
+    void setProposeDeflatedMode(const OFBool deflatedMode);
+
     /** set mode that specifies whether to read information on SOP instances to be sent from
      *  the DICOMDIR files that are added to the transfer list.  If this mode is disabled, a
      *  DICOMDIR file is treated like any other input file.  If this mode is enabled, a
@@ -332,6 +349,10 @@ class DCMTK_DCMNET_EXPORT DcmStorageSCU
      *  The sending process can be stopped by overwriting shouldStopAfterCurrentSOPInstance()
      *  in a derived class.  The sending process can be continued with the next SOP instance
      *  by calling sendSOPInstances() again.
+     *  If the peer granted an asynchronous operations window (see setAsyncOperationsWindow()),
+     *  up to that number of C-STORE requests are sent before waiting for their responses,
+     *  which are matched to the SOP instances by message ID. notifySOPInstanceSent() is then
+     *  called when the response has been received.
      *  @return status, EC_Normal if successful, an error code otherwise
      */
     OFCondition sendSOPInstances();
@@ -522,6 +543,8 @@ class DCMTK_DCMNET_EXPORT DcmStorageSCU
     OFBool HaltOnUnsuccessfulStoreMode;
     /// flag indicating whether to allow illegal proposals
     OFBool AllowIllegalProposalMode;
+    /// flag indicating whether to propose deflate first for non-image SOP classes
+    OFBool ProposeDeflatedMode;
     /// flag indicating whether to read from DICOMDIR files
     OFBool ReadFromDICOMDIRMode;
     /// AE title of the C-MOVE client that initiated the C-STORE operation (if applicable)
@@ -532,6 +555,14 @@ class DCMTK_DCMNET_EXPORT DcmStorageSCU
     OFList<TransferEntry *> TransferList;
     /// iterator pointing to the current entry in the list of SOP instances to be transferred
     OFListIterator(TransferEntry *) CurrentTransferEntry;
+    /// SOP instances sent with an outstanding C-STORE response, by message ID
+    OFMap<Uint16, TransferEntry *> OutstandingRequests;
+
+    /** receive the next C-STORE response for one of the outstanding requests and
+     *  notify the user of this class that the SOP instance has been processed
+     *  @return status, EC_Normal if successful, an error code otherwise
+     */
+    OFCondition receiveOutstandingResponse();
 
     // private undefined copy constructor
     DcmStorageSCU(const DcmStorageSCU &);
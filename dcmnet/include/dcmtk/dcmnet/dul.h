@@ -68,6 +68,8 @@
 #include "dcmtk/ofstd/ofglobal.h"
 #include "dcmtk/ofstd/oftypes.h"
 #include "dcmtk/ofstd/ofcast.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/ofstd/ofsockad.h"
 #include "dcmtk/dcmnet/extneg.h"
 #include "dcmtk/dcmnet/dicom.h"
 #include "dcmtk/dcmnet/dcuserid.h"
@@ -96,6 +98,18 @@ extern DCMTK_DCMNET_EXPORT OFGlobal<OFBool> dcmDisableGethostbyaddr;   /* defaul
  */
 extern DCMTK_DCMNET_EXPORT OFGlobal<Sint32> dcmConnectionTimeout;   /* default: -1 */
 
+/** function resolving the host name of a peer an association is requested with,
+ *  e.g. from a cache. Leaves result cleared if the host is unknown.
+ *  @param name host name, never a numeric IPv4 address
+ *  @param result address of the host
+ */
+typedef void (*DUL_HostResolver)(const char *name, OFSockAddr& result);
+
+/** Global resolver for the host names of requested associations. Default value
+ *  is NULL, which looks each one up with OFStandard::getAddressByHostname().
+ */
+extern DCMTK_DCMNET_EXPORT OFGlobal<DUL_HostResolver> dcmHostResolver;   /* default: NULL */
+
 /** This global flag allows to set an already opened socket file descriptor which
  *  will be used by dcmnet the next time receiveTransportConnectionTCP() is called.
  *  Useful for use with proxy applications, but inherently thread unsafe!
@@ -467,6 +481,20 @@ DUL_WritePDVs(DUL_ASSOCIATIONKEY ** association,
         DUL_PDVLIST * pdvList);
 DCMTK_DCMNET_EXPORT OFCondition DUL_NextPDV(DUL_ASSOCIATIONKEY ** association, DUL_PDV * pdv);
 
+/* Functions for receiving the value of a single PDV of a large P-DATA PDU
+** straight from the socket into the caller's buffer (see DUL_DeferPDVData).
+*/
+DCMTK_DCMNET_EXPORT OFCondition DUL_DeferPDVData(DUL_ASSOCIATIONKEY ** association, unsigned long minLength);
+DCMTK_DCMNET_EXPORT unsigned long DUL_PendingPDVData(DUL_ASSOCIATIONKEY ** association);
+DCMTK_DCMNET_EXPORT OFCondition
+DUL_ReadPDVData(DUL_ASSOCIATIONKEY ** association, void *buffer,
+        unsigned long length, unsigned long *bytesRead);
+
+/* Send the data of PDVs without data pointer from a file (see DUL_setPDVFile).
+*/
+DCMTK_DCMNET_EXPORT OFCondition
+DUL_setPDVFile(DUL_ASSOCIATIONKEY ** association, OFFile *file, offile_off_t offset);
+
 
 /* Miscellaneous functions.
 */
@@ -511,6 +539,13 @@ DCMTK_DCMNET_EXPORT DcmTransportConnection *DUL_getTransportConnection(DUL_ASSOC
 /* change transport layer */
 DCMTK_DCMNET_EXPORT OFCondition DUL_setTransportLayer(DUL_NETWORKKEY *callerNetworkKey, DcmTransportLayer *newLayer, int takeoverOwnership);
 
+/* set socket options for all connections of a network, -1 keeps the TCP_BUFFER_LENGTH and TCP_NODELAY behaviour */
+DCMTK_DCMNET_EXPORT OFCondition DUL_setTCPSocketOptions(DUL_NETWORKKEY *callerNetworkKey, int bufferLength, int noDelay);
+
+/* enable TCP keepalive for all connections of a network: probes after idle seconds without traffic,
+ * every interval seconds, the connection is dropped after probes unanswered ones. idle 0 disables */
+DCMTK_DCMNET_EXPORT OFCondition DUL_setTCPKeepAlive(DUL_NETWORKKEY *callerNetworkKey, int idle, int interval, int probes);
+
 /* activate compatibility mode and callback */
 DCMTK_DCMNET_EXPORT void DUL_activateCompatibilityMode(DUL_ASSOCIATIONKEY *dulassoc, unsigned long mode);
 DCMTK_DCMNET_EXPORT void DUL_activateCallback(DUL_ASSOCIATIONKEY *dulassoc, DUL_ModeCallback *cb);
@@ -141,6 +141,20 @@ public:
    */
   virtual Uint16 getMaxThreads();
 
+  /** Set the number of associations that may wait for a worker if all
+   *  workers are busy. Waiting associations have been received on TCP/IP
+   *  level but not answered yet; they are handed to the next worker that
+   *  finishes its association. Requests exceeding the limit are rejected.
+   *  @param maxQueued Number of associations permitted to wait, 0 (the
+   *         default) rejects requests as soon as all workers are busy.
+   */
+  virtual void setMaxQueuedAssociations(const Uint16 maxQueued);
+
+  /** Get number of associations that may wait for a worker.
+   *  @return Number of associations permitted to wait.
+   */
+  virtual Uint16 getMaxQueuedAssociations();
+
   /** Get number of currently active connections.
    *  @param onlyBusy Return only number of those workers that are busy with a
    *         connection and not idle, if OFTrue.
@@ -192,6 +206,13 @@ protected:
   OFCondition runAssociation(T_ASC_Association* assoc,
                              const DcmSharedSCPConfig& sharedConfig);
 
+  /** Join all worker threads after they have finished their associations.
+   *  Associations still waiting for a worker are rejected. Called at the end
+   *  of listen(), derived classes that receive associations themselves and
+   *  hand them to runAssociation() must call it before destruction.
+   */
+  void joinWorkers();
+
   /** Drops association and clears internal structures to free memory
    *  @param assoc The association to free
    */
@@ -213,6 +234,18 @@ protected:
   void notifyThreadExit(DcmBaseSCPWorker* thread,
                         OFCondition result);
 
+  /** Used by thread to fetch the next waiting association once it has
+   *  finished the current one. If there is none, the thread is no longer
+   *  counted as busy, so that the listener does not queue associations for
+   *  a thread that is about to exit.
+   *  @param thread The thread that is calling this function.
+   *  @param assoc The association to be run next on return.
+   *  @return OFTrue if an association was taken from the queue, OFFalse
+   *          otherwise.
+   */
+  OFBool nextQueuedAssociation(DcmBaseSCPWorker* thread,
+                               T_ASC_Association*& assoc);
+
 private:
 
   /// Possible run modes of pool
@@ -245,9 +278,11 @@ private:
   // specific timeout
   // Uint16 m_workersBusyTimeout;
 
-  // Not implemented yet: list of associations that are waiting for a worker
-  // becoming available
-  // OFList<T_ASC_Association*> m_waiting;
+  /// List of associations that are waiting for a worker becoming available
+  OFList<T_ASC_Association*> m_waiting;
+
+  /// Maximum number of associations waiting for a worker
+  Uint16 m_maxWaiting;
 
   /// Current run mode of pool
   runmode m_runMode;
@@ -256,10 +291,10 @@ private:
 /** Implementation of DICOM SCP server pool. The pool waits for incoming
  *  TCP/IP connection requests, accepts them on TCP/IP level and hands the
  *  connection to a worker thread. The maximum number of worker threads, i.e.
- *  simultaneous connections, is configurable. The default is 5. At the moment,
- *  if no free worker slots are available, an incoming request is rejected with
- *  the error "local limit exceeded", i.e. those requests are not queued. This
- *  behaviour might change in the future.
+ *  simultaneous connections, is configurable. The default is 5. If no free
+ *  worker slots are available, an incoming request waits for a worker if
+ *  setMaxQueuedAssociations() permits, otherwise it is rejected with the error
+ *  "local limit exceeded". By default, requests are not queued.
  *  @tparam SCP the service class provider to be instantiated for each request,
  *    should follow the @ref SCPThread_Concept.
  *  @tparam SCPPool the base SCP pool class to use. Use this parameter if you
@@ -307,6 +307,35 @@ public:
                                        const OFString &moveOriginatorAETitle = "",
                                        const Uint16 moveOriginatorMsgID = 0);
 
+  /** Sends a C-STORE request without waiting for the response. If an asynchronous
+   *  operations window was negotiated (see getAsyncOperationsWindow()), further requests
+   *  can be sent before the responses are received with receiveSTOREResponse(). The
+   *  parameters have the same meaning as for sendSTORERequest().
+   *  @param presID        [in]  The presentation context ID, 0 to find one automatically.
+   *  @param dicomFile     [in]  The filename of the DICOM file to be sent.
+   *  @param dataset       [in]  The dataset to be sent, if no filename is given.
+   *  @param messageID     [out] The message ID of the request, to be matched with the one
+   *                             returned by receiveSTOREResponse().
+   *  @param moveOriginatorAETitle [in] The C-MOVE client's AE title, if any.
+   *  @param moveOriginatorMsgID   [in] The C-MOVE message ID, if any.
+   *  @return EC_Normal if the request was sent, error code otherwise
+   */
+  virtual OFCondition sendSTORERequestAsync(const T_ASC_PresentationContextID presID,
+                                            const OFFilename &dicomFile,
+                                            DcmDataset *dataset,
+                                            Uint16 &messageID,
+                                            const OFString &moveOriginatorAETitle = "",
+                                            const Uint16 moveOriginatorMsgID = 0);
+
+  /** Receives the next C-STORE response for one of the requests sent with
+   *  sendSTORERequestAsync().
+   *  @param messageID     [out] The message ID of the request being responded to.
+   *  @param rspStatusCode [out] The response status code received.
+   *  @return EC_Normal if a C-STORE response was received, error code otherwise
+   */
+  virtual OFCondition receiveSTOREResponse(Uint16 &messageID,
+                                           Uint16 &rspStatusCode);
+
   /** Sends a C-MOVE Request on given presentation context and receives list of responses.
    *  The function receives the first response and then calls the function handleMOVEResponse()
    *  which gets the relevant presentation context together with the response dataset and
@@ -597,6 +626,31 @@ public:
    */
   void setMaxReceivePDULength(const Uint32 maxRecPDU);
 
+  /** Set the number of C-STORE requests the SCU proposes to have outstanding on
+   *  the association, negotiated with the Asynchronous Operations Window sub-item.
+   *  Must be called before negotiateAssociation() to take effect.
+   *  @param maxOperationsInvoked [in] Outstanding requests, 1 (default) for
+   *    synchronous operation without proposing a window
+   */
+  void setAsyncOperationsWindow(const Uint16 maxOperationsInvoked);
+
+  /** Set TCP socket options for the connection to the peer. Must be called
+   *  before initNetwork() to take effect.
+   *  @param bufferLength [in] SO_SNDBUF/SO_RCVBUF in bytes, 0 for 64 KB, -1 to use
+   *    the environment variable TCP_BUFFER_LENGTH or the system default
+   *  @param noDelay [in] 1 to disable the Nagle algorithm, 0 to keep it, -1 to use
+   *    the environment variable TCP_NODELAY or the compile time default
+   */
+  void setTCPSocketOptions(const int bufferLength, const int noDelay);
+
+  /** Enable TCP keepalive for the connection to the peer, see ASC_setTCPKeepAlive().
+   *  Must be set before initNetwork() to take effect.
+   *  @param idle [in] seconds without traffic before the first probe, 0 disables keepalive
+   *  @param interval [in] seconds between probes
+   *  @param probes [in] unanswered probes before the connection fails
+   */
+  void setTCPKeepAlive(const int idle, const int interval, const int probes);
+
   /** Set whether to send in DIMSE blocking or non-blocking mode
    *  @param blockingMode [in] Either blocking or non-blocking mode
    */
@@ -630,6 +684,11 @@ public:
    */
   void setDIMSETimeout(const Uint32 dimseTimeout);
 
+  /** Set the priority of the C-STORE, C-FIND, C-GET and C-MOVE requests sent
+   *  @param priority [in] DIMSE priority, DIMSE_PRIORITY_MEDIUM by default
+   */
+  void setPriority(const T_DIMSE_Priority priority);
+
   /** Set timeout for receiving ACSE messages
    *  @param acseTimeout [in] ACSE timeout in seconds used by timer for message timeouts
    *                          during association negotiation
@@ -695,11 +754,32 @@ public:
    */
   OFBool isConnected() const;
 
+  /** Check without blocking whether the peer sent anything on the association or closed
+   *  the connection. On an association without outstanding requests this is an
+   *  A-RELEASE-RQ or A-ABORT, or the end of the connection, and no further request can
+   *  be sent on it.
+   *  @return OFTrue if data or the end of the connection is waiting, OFFalse otherwise
+   */
+  OFBool isDataWaiting() const;
+
+  /** Returns the number of DIMSE messages this SCU has sent completely, i.e. that
+   *  the peer may have acted upon
+   *  @return Number of DIMSE messages sent
+   */
+  Uint32 getMessagesSent() const;
+
   /** Returns maximum PDU length configured to be received by SCU
    *  @return Maximum PDU length in bytes
    */
   Uint32 getMaxReceivePDULength() const;
 
+  /** Returns the number of requests the SCU may have outstanding on the current
+   *  association, i.e.\ the window granted by the peer but not more than the one
+   *  proposed. 1 if the peer declined the window or none was proposed.
+   *  @return Maximum number of outstanding requests
+   */
+  Uint16 getAsyncOperationsWindow() const;
+
   /** Returns whether DIMSE messaging is configured to be blocking or unblocking
    *  @return The blocking mode configured
    */
@@ -732,6 +812,11 @@ public:
    */
   Uint32 getDIMSETimeout() const;
 
+  /** Returns the priority of the C-STORE, C-FIND, C-GET and C-MOVE requests sent
+   *  @return The DIMSE priority configured
+   */
+  T_DIMSE_Priority getPriority() const;
+
   /** Returns ACSE timeout in seconds used by timer for message timeouts during
    *  association negotiation.
    *  @return The ACSE timeout (in seconds) configured
@@ -781,13 +866,21 @@ public:
   OFBool getProgressNotificationMode() const;
 
   /** Returns whether SCU is configured to create a TLS connection with the SCP
-   *  @return OFFalse for this class but may be overridden by derived classes
+   *  @return OFTrue once useSecureConnection() was called with a layer, may be overridden by derived classes
    */
   OFBool getTLSEnabled() const;
 
   /** Deletes internal networking structures from memory */
   void freeNetwork();
 
+  /** Tells DcmSCU to use a secure TLS connection described by the given TLS layer.
+   *  May be called before initNetwork(), the layer is used again by each later call
+   *  of initNetwork(). The layer is not owned and must outlive the SCU.
+   *  @param tlayer [in] The TLS transport layer including all TLS parameters
+   *  @return EC_Normal if given transport layer is ok, an error code otherwise
+   */
+  OFCondition useSecureConnection(DcmTransportLayer *tlayer);
+
 protected:
 
   /** Sends a DIMSE command and possibly also a dataset from a data object via network to
@@ -821,12 +914,6 @@ protected:
                              OFString &sopInstanceUID,
                              E_TransferSyntax &transferSyntax);
 
-  /** Tells DcmSCU to use a secure TLS connection described by the given TLS layer
-   *  @param tlayer [in] The TLS transport layer including all TLS parameters
-   *  @return EC_Normal if given transport layer is ok, an error code otherwise
-   */
-  OFCondition useSecureConnection(DcmTransportLayer *tlayer);
-
   /** Receive DIMSE command (excluding dataset!) over the currently open association
    *  @param presID       [out] Contains in the end the ID of the presentation context
    *                            which was specified in the DIMSE command received
@@ -1037,6 +1124,20 @@ private:
   /// Maximum PDU size (default: 16384 bytes)
   Uint32 m_maxReceivePDULength;
 
+  /// Outstanding requests proposed in the asynchronous operations window (default: 1)
+  Uint16 m_maxOperationsInvoked;
+
+  /// TCP send and receive buffer length (default: -1, from the environment)
+  int m_tcpBufferLength;
+
+  /// TCP_NODELAY socket option (default: -1, from the environment)
+  int m_tcpNoDelay;
+
+  /// TCP keepalive idle time, interval and probes (default: 0, disabled)
+  int m_tcpKeepAliveIdle;
+  int m_tcpKeepAliveInterval;
+  int m_tcpKeepAliveProbes;
+
   /// DIMSE blocking mode (default: blocking)
   T_DIMSE_BlockingMode m_blockMode;
 
@@ -1055,6 +1156,12 @@ private:
   /// DIMSE timeout (default: unlimited)
   Uint32 m_dimseTimeout;
 
+  /// Priority of the requests sent (default: medium)
+  T_DIMSE_Priority m_priority;
+
+  /// Number of DIMSE messages sent completely
+  Uint32 m_messagesSent;
+
   /// ACSE timeout (default: 30 seconds)
   Uint32 m_acseTimeout;
 
@@ -1083,6 +1190,9 @@ private:
   // object able to send messages
   DcmNotifier *m_notifier;
 
+  /// TLS transport layer set by useSecureConnection(), not owned (NULL for plain TCP)
+  DcmTransportLayer *m_transportLayer;
+
   /** Returns next available message ID free to be used by SCU
    *  @return Next free message ID
    */
@@ -328,6 +328,8 @@ ASC_createAssociationParameters(T_ASC_Parameters ** params,
     (*params)->ourMaxPDUReceiveSize = maxReceivePDUSize;
     (*params)->DULparams.maxPDU = maxReceivePDUSize;
     (*params)->theirMaxPDUReceiveSize = 0;      /* not yet negotiated */
+    (*params)->theirMaxOperationsInvoked = 1;   /* synchronous unless negotiated */
+    (*params)->theirMaxOperationsPerformed = 1;
     (*params)->modeCallback = NULL;
 
     /* set something unusable */
@@ -422,6 +424,30 @@ ASC_getAPTitles(T_ASC_Parameters * params,
     return EC_Normal;
 }
 
+OFCondition
+ASC_setAsyncOperationsWindow(T_ASC_Parameters * params,
+    unsigned short maxOperationsInvoked,
+    unsigned short maxOperationsPerformed)
+{
+    if (params == NULL) return ASC_NULLKEY;
+    params->DULparams.maximumOperationsInvoked = maxOperationsInvoked;
+    params->DULparams.maximumOperationsPerformed = maxOperationsPerformed;
+    return EC_Normal;
+}
+
+OFCondition
+ASC_getAsyncOperationsWindow(T_ASC_Parameters * params,
+    unsigned short * maxOperationsInvoked,
+    unsigned short * maxOperationsPerformed)
+{
+    if (params == NULL) return ASC_NULLKEY;
+    if (maxOperationsInvoked)
+        *maxOperationsInvoked = params->theirMaxOperationsInvoked;
+    if (maxOperationsPerformed)
+        *maxOperationsPerformed = params->theirMaxOperationsPerformed;
+    return EC_Normal;
+}
+
 OFCondition
 ASC_getApplicationContextName(T_ASC_Parameters * params,
                               char* applicationContextName,
@@ -1522,6 +1548,12 @@ ASC_dumpParameters(OFString& str, T_ASC_Parameters * params, ASC_associateType d
         << params->ourMaxPDUReceiveSize << OFendl
         << "Their Max PDU Receive Size:  "
         << params->theirMaxPDUReceiveSize << OFendl;
+    if (params->DULparams.maximumOperationsInvoked > 1 || params->DULparams.maximumOperationsPerformed > 1)
+    {
+      outstream << "Async Operations Window:     "
+        << params->DULparams.maximumOperationsInvoked << " invoked / "
+        << params->DULparams.maximumOperationsPerformed << " performed" << OFendl;
+    }
 
     outstream << "Presentation Contexts:" << OFendl;
     for (i=0; i<ASC_countPresentationContexts(params); i++) {
@@ -1808,6 +1840,15 @@ ASC_receiveAssociation(T_ASC_Network * network,
      */
     params->theirMaxPDUReceiveSize = params->DULparams.peerMaxPDU;
 
+    /*
+     * Keep the proposed asynchronous operations window and answer with the
+     * default (synchronous operation) unless the acceptor grants one.
+     */
+    params->theirMaxOperationsInvoked = params->DULparams.maximumOperationsInvoked;
+    params->theirMaxOperationsPerformed = params->DULparams.maximumOperationsPerformed;
+    params->DULparams.maximumOperationsInvoked = 0;
+    params->DULparams.maximumOperationsPerformed = 0;
+
     /* the PDV buffer and length get set when we acknowledge the association */
     (*assoc)->sendPDVLength = 0;
     (*assoc)->sendPDVBuffer = NULL;
@@ -1925,6 +1966,10 @@ ASC_requestAssociation(T_ASC_Network * network,
         */
         params->theirMaxPDUReceiveSize = params->DULparams.peerMaxPDU;
 
+        /* the asynchronous operations window granted by the acceptor */
+        params->theirMaxOperationsInvoked = params->DULparams.maximumOperationsInvoked;
+        params->theirMaxOperationsPerformed = params->DULparams.maximumOperationsPerformed;
+
         if (!((params->theirMaxPDUReceiveSize & DUL_MAXPDUCOMPAT) ^ DUL_DULCOMPAT))
         {
           /* activate compatibility with DCMTK releases prior to 3.0 */
@@ -2163,6 +2208,20 @@ ASC_setTransportLayer(T_ASC_Network *network, DcmTransportLayer *newLayer, int t
   return DUL_setTransportLayer(network->network, newLayer, takeoverOwnership);
 }
 
+OFCondition
+ASC_setTCPSocketOptions(T_ASC_Network *network, int bufferLength, int noDelay)
+{
+  if (network == NULL) return ASC_NULLKEY;
+  return DUL_setTCPSocketOptions(network->network, bufferLength, noDelay);
+}
+
+OFCondition
+ASC_setTCPKeepAlive(T_ASC_Network *network, int idle, int interval, int probes)
+{
+  if (network == NULL) return ASC_NULLKEY;
+  return DUL_setTCPKeepAlive(network->network, idle, interval, probes);
+}
+
 unsigned long ASC_getPeerCertificateLength(T_ASC_Association *assoc)
 {
   if (assoc==NULL) return 0;
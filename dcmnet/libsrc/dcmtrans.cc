@@ -41,6 +41,8 @@
 #include "dcmtk/ofstd/ofstdinc.h"
 #include "dcmtk/ofstd/oftimer.h"
 
+#include <atomic>
+
 BEGIN_EXTERN_C
 #ifdef HAVE_SYS_TIME_H
 #include <sys/time.h>
@@ -51,6 +53,12 @@ BEGIN_EXTERN_C
 #ifdef HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 END_EXTERN_C
 
 #ifdef DCMTK_HAVE_POLL
@@ -140,6 +148,59 @@ DcmTransportConnection::~DcmTransportConnection()
 {
 }
 
+void DcmTransportConnection::interrupt()
+{
+  if (theSocket != DCMNET_INVALID_SOCKET)
+    (void) shutdown(theSocket, 2 /* SD_BOTH, SHUT_RDWR */);
+}
+
+ssize_t DcmTransportConnection::writeBlocks(const DcmTransportBlock *blocks, size_t count)
+{
+  ssize_t result = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    char *data = OFstatic_cast(char *, OFconst_cast(void *, blocks[i].data));
+    size_t length = blocks[i].length;
+    while (length > 0)
+    {
+      ssize_t written = write(data, length);
+      if ((written == -1) && (OFStandard::getLastNetworkErrorCode().value() == DCMNET_EINTR)) continue;
+      if (written <= 0) return (result > 0) ? result : written;
+      data += written;
+      length -= OFstatic_cast(size_t, written);
+      result += written;
+    }
+  }
+  return result;
+}
+
+ssize_t DcmTransportConnection::writeFile(const void *head, size_t headLength, OFFile &file, offile_off_t offset, size_t length)
+{
+  DcmTransportBlock block = { head, headLength };
+  ssize_t result = writeBlocks(&block, 1);
+  if (result != OFstatic_cast(ssize_t, headLength)) return result;
+  ssize_t written = writeFileBuffered(file, offset, length);
+  return (written < 0) ? written : result + written;
+}
+
+ssize_t DcmTransportConnection::writeFileBuffered(OFFile &file, offile_off_t offset, size_t length)
+{
+  char buffer[32768];
+  ssize_t result = 0;
+  if (file.fseek(offset, SEEK_SET) != 0) return -1;
+  while (length > 0)
+  {
+    size_t count = (length < sizeof(buffer)) ? length : sizeof(buffer);
+    if (file.fread(buffer, 1, count) != count) return (result > 0) ? result : -1;
+    DcmTransportBlock block = { buffer, count };
+    ssize_t written = writeBlocks(&block, 1);
+    if (written > 0) result += written;
+    if (written != OFstatic_cast(ssize_t, count)) return (result > 0) ? result : written;
+    length -= count;
+  }
+  return result;
+}
+
 OFBool DcmTransportConnection::safeSelectReadableAssociation(DcmTransportConnection *connections[], int connCount, int timeout)
 {
   int numberOfRounds = timeout+1;
@@ -274,13 +335,17 @@ OFBool DcmTransportConnection::fastSelectReadableAssociation(DcmTransportConnect
     }
   }
 
+#ifdef DCMTK_HAVE_POLL
+  size_t polled = 0;
+#endif
   for (i=0; i<connCount; i++)
   {
     if (connections[i])
     {
       /* if not available, set entry in array to NULL */
 #ifdef DCMTK_HAVE_POLL
-      if(!(pfd[i].revents & POLLIN)) connections[i] = NULL;
+      /* pfd only holds the connections that are not NULL, in the same order */
+      if(!(pfd[polled++].revents & POLLIN)) connections[i] = NULL;
 #else
       socketfd = connections[i]->getSocket();
       if (!FD_ISSET(socketfd, &fdset)) connections[i] = NULL;
@@ -309,9 +374,15 @@ void DcmTransportConnection::dumpConnectionParameters(STD_NAMESPACE ostream& out
 
 /* ================================================ */
 
+/* traffic and open connections of all TCP connections of the process */
+static std::atomic<Uint64> tcpBytesReceived(0);
+static std::atomic<Uint64> tcpBytesSent(0);
+static std::atomic<size_t> tcpOpenConnections(0);
+
 DcmTCPConnection::DcmTCPConnection(DcmNativeSocketType openSocket)
 : DcmTransportConnection(openSocket)
 {
+  if (openSocket != -1) ++tcpOpenConnections;
 }
 
 DcmTCPConnection::~DcmTCPConnection()
@@ -337,18 +408,109 @@ DcmTransportLayerStatus DcmTCPConnection::renegotiate(const char * /* newSuite *
 ssize_t DcmTCPConnection::read(void *buf, size_t nbyte)
 {
 #ifdef HAVE_WINSOCK_H
-  return recv(getSocket(), (char *)buf, OFstatic_cast(int, nbyte), 0);
+  ssize_t result = recv(getSocket(), (char *)buf, OFstatic_cast(int, nbyte), 0);
 #else
-  return ::read(getSocket(), (char *)buf, nbyte);
+  ssize_t result = ::read(getSocket(), (char *)buf, nbyte);
 #endif
+  if (result > 0) tcpBytesReceived += OFstatic_cast(Uint64, result);
+  return result;
 }
 
 ssize_t DcmTCPConnection::write(void *buf, size_t nbyte)
 {
 #ifdef HAVE_WINSOCK_H
-  return send(getSocket(), (char *)buf, OFstatic_cast(int, nbyte), 0);
+  ssize_t result = send(getSocket(), (char *)buf, OFstatic_cast(int, nbyte), 0);
+#else
+  ssize_t result = ::write(getSocket(), (char *)buf, nbyte);
+#endif
+  if (result > 0) tcpBytesSent += OFstatic_cast(Uint64, result);
+  return result;
+}
+
+ssize_t DcmTCPConnection::writeBlocks(const DcmTransportBlock *blocks, size_t count)
+{
+#ifdef HAVE_SYS_UIO_H
+  struct iovec iov[16];
+  if ((count == 0) || (count > sizeof(iov) / sizeof(iov[0])))
+    return DcmTransportConnection::writeBlocks(blocks, count);
+
+  size_t remaining = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    iov[i].iov_base = OFconst_cast(void *, blocks[i].data);
+    iov[i].iov_len = blocks[i].length;
+    remaining += blocks[i].length;
+  }
+
+  /* writev() may write less than requested, continue behind the last byte written */
+  struct iovec *next = iov;
+  int nextCount = OFstatic_cast(int, count);
+  ssize_t result = 0;
+  while (remaining > 0)
+  {
+    ssize_t written = ::writev(getSocket(), next, nextCount);
+    if ((written == -1) && (errno == EINTR)) continue;
+    if (written <= 0) return (result > 0) ? result : written;
+    tcpBytesSent += OFstatic_cast(Uint64, written);
+    result += written;
+    remaining -= OFstatic_cast(size_t, written);
+    size_t skip = OFstatic_cast(size_t, written);
+    while ((nextCount > 0) && (skip >= next->iov_len))
+    {
+      skip -= next->iov_len;
+      ++next;
+      --nextCount;
+    }
+    if (nextCount > 0)
+    {
+      next->iov_base = OFstatic_cast(char *, next->iov_base) + skip;
+      next->iov_len -= skip;
+    }
+  }
+  return result;
+#else
+  return DcmTransportConnection::writeBlocks(blocks, count);
+#endif
+}
+
+ssize_t DcmTCPConnection::writeFile(const void *head, size_t headLength, OFFile &file, offile_off_t offset, size_t length)
+{
+#ifdef HAVE_SYS_SENDFILE_H
+  ssize_t result = 0;
+  const char *data = OFstatic_cast(const char *, head);
+  while (result < OFstatic_cast(ssize_t, headLength))
+  {
+#ifdef MSG_MORE
+    /* the file contents follow, let the header share a TCP segment with them */
+    ssize_t written = ::send(getSocket(), data + result, headLength - result, MSG_MORE);
+#else
+    ssize_t written = ::write(getSocket(), data + result, headLength - result);
+#endif
+    if ((written == -1) && (errno == EINTR)) continue;
+    if (written <= 0) return (result > 0) ? result : written;
+    tcpBytesSent += OFstatic_cast(Uint64, written);
+    result += written;
+  }
+
+  off_t position = OFstatic_cast(off_t, offset);
+  while (length > 0)
+  {
+    ssize_t written = ::sendfile(getSocket(), file.fileNo(), &position, length);
+    if ((written == -1) && (errno == EINTR)) continue;
+    if ((written == -1) && (position == offset) && ((errno == EINVAL) || (errno == ENOSYS)))
+    {
+      /* the file cannot be sent this way (e.g. not a regular file) */
+      written = writeFileBuffered(file, offset, length);
+      return (written < 0) ? written : result + written;
+    }
+    if (written <= 0) return result;
+    tcpBytesSent += OFstatic_cast(Uint64, written);
+    result += written;
+    length -= OFstatic_cast(size_t, written);
+  }
+  return result;
 #else
-  return ::write(getSocket(), (char *)buf, nbyte);
+  return DcmTransportConnection::writeFile(head, headLength, file, offset, length);
 #endif
 }
 
@@ -364,9 +526,35 @@ void DcmTCPConnection::close()
 #endif
   /* forget about this socket (now closed) */
     setSocket(-1);
+    --tcpOpenConnections;
   }
 }
 
+Uint64 DcmTCPConnection::bytesReceived()
+{
+  return tcpBytesReceived.load();
+}
+
+Uint64 DcmTCPConnection::bytesSent()
+{
+  return tcpBytesSent.load();
+}
+
+size_t DcmTCPConnection::openConnections()
+{
+  return tcpOpenConnections.load();
+}
+
+void DcmTCPConnection::countBytesReceived(size_t count)
+{
+  tcpBytesReceived += OFstatic_cast(Uint64, count);
+}
+
+void DcmTCPConnection::countBytesSent(size_t count)
+{
+  tcpBytesSent += OFstatic_cast(Uint64, count);
+}
+
 unsigned long DcmTCPConnection::getPeerCertificateLength()
 {
   return 0;
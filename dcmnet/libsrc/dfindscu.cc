@@ -61,6 +61,11 @@ DcmFindSCUCallback::DcmFindSCUCallback()
 {
 }
 
+const DcmReadProjection *DcmFindSCUCallback::responseProjection() const
+{
+    return NULL;
+}
+
 void DcmFindSCUCallback::setAssociation(T_ASC_Association *assoc)
 {
     assoc_ = assoc;
@@ -203,6 +208,11 @@ OFCondition DcmFindSCU::setTransportLayer(DcmTransportLayer *tLayer)
     return ASC_setTransportLayer(net_, tLayer, 0);
 }
 
+OFCondition DcmFindSCU::setTCPSocketOptions(int bufferLength, int noDelay)
+{
+    return ASC_setTCPSocketOptions(net_, bufferLength, noDelay);
+}
+
 OFCondition DcmFindSCU::dropNetwork()
 {
     if (net_) return ASC_dropNetwork(&net_); else return EC_Normal;
@@ -699,7 +709,7 @@ OFCondition DcmFindSCU::findSCU(
         /* finally conduct transmission of data */
         cond = DIMSE_findUser(assoc, presId, &req, dset, responseCount,
             progressCallback, callback, blockMode, dimse_timeout,
-            &rsp, &statusDetail);
+            &rsp, &statusDetail, callback->responseProjection());
 
         /* dump some more general information */
         if (cond.good()) {
@@ -2062,3 +2062,511 @@ DIMSE_countElements(DcmDataset *obj)
 
     return n;
 }
+
+/*
+ * Direct encoding and decoding of command sets
+ *
+ * The command sets of the C-services hold a handful of US, UI and AE
+ * elements of group 0x0000. They are written to and read from the PDV
+ * buffer here without building a DcmDataset, following the semantics of
+ * the build and parse functions above. Anything unusual (other commands,
+ * other elements, status detail, strings dcmdata would correct) is left to
+ * the dataset path, which reports errors the usual way.
+ */
+
+enum T_DIMSE_CmdVR { CMD_UL, CMD_US, CMD_UI, CMD_AE };
+
+/* the elements of the C-service command sets, in ascending order */
+static const struct {
+    Uint16 element;
+    T_DIMSE_CmdVR vr;
+} cmdElements[] = {
+    { 0x0000, CMD_UL },     /* CommandGroupLength */
+    { 0x0002, CMD_UI },     /* AffectedSOPClassUID */
+    { 0x0100, CMD_US },     /* CommandField */
+    { 0x0110, CMD_US },     /* MessageID */
+    { 0x0120, CMD_US },     /* MessageIDBeingRespondedTo */
+    { 0x0600, CMD_AE },     /* MoveDestination */
+    { 0x0700, CMD_US },     /* Priority */
+    { 0x0800, CMD_US },     /* CommandDataSetType */
+    { 0x0900, CMD_US },     /* Status */
+    { 0x1000, CMD_UI },     /* AffectedSOPInstanceUID */
+    { 0x1020, CMD_US },     /* NumberOfRemainingSuboperations */
+    { 0x1021, CMD_US },     /* NumberOfCompletedSuboperations */
+    { 0x1022, CMD_US },     /* NumberOfFailedSuboperations */
+    { 0x1023, CMD_US },     /* NumberOfWarningSuboperations */
+    { 0x1030, CMD_AE },     /* MoveOriginatorApplicationEntityTitle */
+    { 0x1031, CMD_US }      /* MoveOriginatorMessageID */
+};
+
+enum {
+    CMD_GROUPLENGTH, CMD_AFFECTEDSOPCLASSUID, CMD_COMMANDFIELD, CMD_MESSAGEID,
+    CMD_MESSAGEIDBEINGRESPONDEDTO, CMD_MOVEDESTINATION, CMD_PRIORITY,
+    CMD_DATASETTYPE, CMD_STATUS, CMD_AFFECTEDSOPINSTANCEUID, CMD_REMAINING,
+    CMD_COMPLETED, CMD_FAILED, CMD_WARNING, CMD_MOVEORIGINATORAETITLE,
+    CMD_MOVEORIGINATORID, CMD_ELEMENTS
+};
+
+/* values of a command set, strings point into the message or the PDV */
+struct T_DIMSE_CmdValues {
+    unsigned long present;      /* bit per entry of cmdElements */
+    Uint16 us[CMD_ELEMENTS];
+    const char *s[CMD_ELEMENTS];
+    size_t len[CMD_ELEMENTS];
+    char instanceUID[DIC_UI_LEN + 10];
+};
+
+static void
+putCmdUS(T_DIMSE_CmdValues *v, int i, Uint16 us)
+{
+    v->present |= (1UL << i);
+    v->us[i] = us;
+}
+
+static void
+putCmdString(T_DIMSE_CmdValues *v, int i, char *s, OFBool keepPadding)
+{
+    /* same in-place stripping as addString() */
+    if (! keepPadding) DU_stripLeadingAndTrailingSpaces(s);
+    v->present |= (1UL << i);
+    v->s[i] = s;
+    v->len[i] = strlen(s);
+}
+
+static OFBool
+checkCmdStrings(const T_DIMSE_CmdValues *v)
+{
+    /* dcmdata removes white space from UIDs it writes, such commands are left to it */
+    for (int i = 0; i < CMD_ELEMENTS; i++) {
+        if (!(v->present & (1UL << i)) || cmdElements[i].vr != CMD_UI) continue;
+        for (size_t n = 0; n < v->len[i]; n++)
+            if (isspace(OFstatic_cast(unsigned char, v->s[i][n]))) return OFFalse;
+    }
+    return OFTrue;
+}
+
+static void
+putCmdCommonRQ(T_DIMSE_CmdValues *v, Uint16 command, Uint16 messageID,
+    Uint16 dataSetType)
+{
+    putCmdUS(v, CMD_COMMANDFIELD, command);
+    putCmdUS(v, CMD_MESSAGEID, messageID);
+    putCmdUS(v, CMD_DATASETTYPE, dataSetType);
+}
+
+static void
+putCmdCommonRSP(T_DIMSE_CmdValues *v, Uint16 command,
+    Uint16 messageIDBeingRespondedTo, Uint16 dataSetType, Uint16 status)
+{
+    putCmdUS(v, CMD_COMMANDFIELD, command);
+    putCmdUS(v, CMD_MESSAGEIDBEINGRESPONDEDTO, messageIDBeingRespondedTo);
+    putCmdUS(v, CMD_DATASETTYPE, dataSetType);
+    putCmdUS(v, CMD_STATUS, status);
+}
+
+static void
+putCmdSubOperations(T_DIMSE_CmdValues *v, unsigned int opts,
+    unsigned int remaining, unsigned int completed, unsigned int failed,
+    unsigned int warning, const DIC_US *counts)
+{
+    /* counts are remaining, completed, failed and warning in this order */
+    if (opts & remaining) putCmdUS(v, CMD_REMAINING, counts[0]);
+    if (opts & completed) putCmdUS(v, CMD_COMPLETED, counts[1]);
+    if (opts & failed) putCmdUS(v, CMD_FAILED, counts[2]);
+    if (opts & warning) putCmdUS(v, CMD_WARNING, counts[3]);
+}
+
+static OFBool
+collectCmdValues(T_DIMSE_Message *msg, T_DIMSE_CmdValues *v)
+{
+    v->present = 0;
+    switch (msg->CommandField) {
+    case DIMSE_C_ECHO_RQ: {
+        T_DIMSE_C_EchoRQ *e = &msg->msg.CEchoRQ;
+        putCmdCommonRQ(v, DIMSE_C_ECHO_RQ, e->MessageID, e->DataSetType);
+        putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        break;
+    }
+    case DIMSE_C_ECHO_RSP: {
+        T_DIMSE_C_EchoRSP *e = &msg->msg.CEchoRSP;
+        putCmdCommonRSP(v, DIMSE_C_ECHO_RSP, e->MessageIDBeingRespondedTo,
+            e->DataSetType, e->DimseStatus);
+        if (e->opts & O_ECHO_AFFECTEDSOPCLASSUID)
+            putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        break;
+    }
+    case DIMSE_C_STORE_RQ: {
+        T_DIMSE_C_StoreRQ *e = &msg->msg.CStoreRQ;
+        putCmdCommonRQ(v, DIMSE_C_STORE_RQ, e->MessageID, e->DataSetType);
+        putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        putCmdString(v, CMD_AFFECTEDSOPINSTANCEUID, e->AffectedSOPInstanceUID, OFFalse);
+        putCmdUS(v, CMD_PRIORITY, e->Priority);
+        if (e->opts & O_STORE_MOVEORIGINATORAETITLE)
+            putCmdString(v, CMD_MOVEORIGINATORAETITLE, e->MoveOriginatorApplicationEntityTitle, OFFalse);
+        if (e->opts & O_STORE_MOVEORIGINATORID)
+            putCmdUS(v, CMD_MOVEORIGINATORID, e->MoveOriginatorID);
+        break;
+    }
+    case DIMSE_C_STORE_RSP: {
+        T_DIMSE_C_StoreRSP *e = &msg->msg.CStoreRSP;
+        putCmdCommonRSP(v, DIMSE_C_STORE_RSP, e->MessageIDBeingRespondedTo,
+            e->DataSetType, e->DimseStatus);
+        if (e->opts & O_STORE_AFFECTEDSOPCLASSUID)
+            putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        if (e->opts & O_STORE_AFFECTEDSOPINSTANCEUID)
+        {
+            /* see buildCStoreRSP() */
+            OFStandard::strlcpy(v->instanceUID, e->AffectedSOPInstanceUID, DIC_UI_LEN + 10);
+            if ((e->opts & O_STORE_PEER_REQUIRES_EXACT_UID_COPY) &&
+                (e->opts & O_STORE_RSP_BLANK_PADDING))
+            {
+                OFStandard::strlcat(v->instanceUID, " ", DIC_UI_LEN + 10);
+            }
+            putCmdString(v, CMD_AFFECTEDSOPINSTANCEUID, v->instanceUID, OFTrue);
+        }
+        break;
+    }
+    case DIMSE_C_FIND_RQ: {
+        T_DIMSE_C_FindRQ *e = &msg->msg.CFindRQ;
+        putCmdCommonRQ(v, DIMSE_C_FIND_RQ, e->MessageID, e->DataSetType);
+        putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        putCmdUS(v, CMD_PRIORITY, e->Priority);
+        break;
+    }
+    case DIMSE_C_FIND_RSP: {
+        T_DIMSE_C_FindRSP *e = &msg->msg.CFindRSP;
+        putCmdCommonRSP(v, DIMSE_C_FIND_RSP, e->MessageIDBeingRespondedTo,
+            e->DataSetType, e->DimseStatus);
+        if (e->opts & O_FIND_AFFECTEDSOPCLASSUID)
+            putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        break;
+    }
+    case DIMSE_C_GET_RQ: {
+        T_DIMSE_C_GetRQ *e = &msg->msg.CGetRQ;
+        putCmdCommonRQ(v, DIMSE_C_GET_RQ, e->MessageID, e->DataSetType);
+        putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        putCmdUS(v, CMD_PRIORITY, e->Priority);
+        break;
+    }
+    case DIMSE_C_GET_RSP: {
+        T_DIMSE_C_GetRSP *e = &msg->msg.CGetRSP;
+        DIC_US counts[4] = { e->NumberOfRemainingSubOperations, e->NumberOfCompletedSubOperations,
+            e->NumberOfFailedSubOperations, e->NumberOfWarningSubOperations };
+        putCmdCommonRSP(v, DIMSE_C_GET_RSP, e->MessageIDBeingRespondedTo,
+            e->DataSetType, e->DimseStatus);
+        if (e->opts & O_GET_AFFECTEDSOPCLASSUID)
+            putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        putCmdSubOperations(v, e->opts, O_GET_NUMBEROFREMAININGSUBOPERATIONS,
+            O_GET_NUMBEROFCOMPLETEDSUBOPERATIONS, O_GET_NUMBEROFFAILEDSUBOPERATIONS,
+            O_GET_NUMBEROFWARNINGSUBOPERATIONS, counts);
+        break;
+    }
+    case DIMSE_C_MOVE_RQ: {
+        T_DIMSE_C_MoveRQ *e = &msg->msg.CMoveRQ;
+        putCmdCommonRQ(v, DIMSE_C_MOVE_RQ, e->MessageID, e->DataSetType);
+        putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        putCmdUS(v, CMD_PRIORITY, e->Priority);
+        putCmdString(v, CMD_MOVEDESTINATION, e->MoveDestination, OFFalse);
+        break;
+    }
+    case DIMSE_C_MOVE_RSP: {
+        T_DIMSE_C_MoveRSP *e = &msg->msg.CMoveRSP;
+        DIC_US counts[4] = { e->NumberOfRemainingSubOperations, e->NumberOfCompletedSubOperations,
+            e->NumberOfFailedSubOperations, e->NumberOfWarningSubOperations };
+        putCmdCommonRSP(v, DIMSE_C_MOVE_RSP, e->MessageIDBeingRespondedTo,
+            e->DataSetType, e->DimseStatus);
+        if (e->opts & O_MOVE_AFFECTEDSOPCLASSUID)
+            putCmdString(v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, OFFalse);
+        putCmdSubOperations(v, e->opts, O_MOVE_NUMBEROFREMAININGSUBOPERATIONS,
+            O_MOVE_NUMBEROFCOMPLETEDSUBOPERATIONS, O_MOVE_NUMBEROFFAILEDSUBOPERATIONS,
+            O_MOVE_NUMBEROFWARNINGSUBOPERATIONS, counts);
+        break;
+    }
+    case DIMSE_C_CANCEL_RQ: {
+        T_DIMSE_C_CancelRQ *e = &msg->msg.CCancelRQ;
+        putCmdUS(v, CMD_COMMANDFIELD, DIMSE_C_CANCEL_RQ);
+        putCmdUS(v, CMD_MESSAGEIDBEINGRESPONDEDTO, e->MessageIDBeingRespondedTo);
+        putCmdUS(v, CMD_DATASETTYPE, e->DataSetType);
+        break;
+    }
+    default:
+        return OFFalse;
+    }
+    return OFTrue;
+}
+
+static unsigned char *
+writeCmdHeader(unsigned char *p, Uint16 element, Uint32 length)
+{
+    /* implicit VR little endian, group 0x0000 */
+    p[0] = 0; p[1] = 0;
+    p[2] = OFstatic_cast(unsigned char, element & 0xff);
+    p[3] = OFstatic_cast(unsigned char, element >> 8);
+    p[4] = OFstatic_cast(unsigned char, length & 0xff);
+    p[5] = OFstatic_cast(unsigned char, (length >> 8) & 0xff);
+    p[6] = OFstatic_cast(unsigned char, (length >> 16) & 0xff);
+    p[7] = OFstatic_cast(unsigned char, length >> 24);
+    return p + 8;
+}
+
+OFBool
+DIMSE_encodeCmd(T_DIMSE_Message *msg, void *buf, unsigned long bufLen,
+    unsigned long *length)
+{
+    T_DIMSE_CmdValues v;
+    if (!collectCmdValues(msg, &v) || !checkCmdStrings(&v)) return OFFalse;
+
+    /* the group length counts all elements following it, strings are padded to even length */
+    Uint32 groupLength = 0;
+    int i;
+    for (i = 1; i < CMD_ELEMENTS; i++) {
+        if (!(v.present & (1UL << i))) continue;
+        if (cmdElements[i].vr == CMD_US) groupLength += 8 + 2;
+        else groupLength += OFstatic_cast(Uint32, 8 + v.len[i] + (v.len[i] & 1));
+    }
+    if (12 + OFstatic_cast(unsigned long, groupLength) > bufLen) return OFFalse;
+
+    unsigned char *p = OFstatic_cast(unsigned char *, buf);
+    p = writeCmdHeader(p, cmdElements[CMD_GROUPLENGTH].element, 4);
+    p[0] = OFstatic_cast(unsigned char, groupLength & 0xff);
+    p[1] = OFstatic_cast(unsigned char, (groupLength >> 8) & 0xff);
+    p[2] = OFstatic_cast(unsigned char, (groupLength >> 16) & 0xff);
+    p[3] = OFstatic_cast(unsigned char, groupLength >> 24);
+    p += 4;
+    for (i = 1; i < CMD_ELEMENTS; i++) {
+        if (!(v.present & (1UL << i))) continue;
+        if (cmdElements[i].vr == CMD_US) {
+            p = writeCmdHeader(p, cmdElements[i].element, 2);
+            p[0] = OFstatic_cast(unsigned char, v.us[i] & 0xff);
+            p[1] = OFstatic_cast(unsigned char, v.us[i] >> 8);
+            p += 2;
+        } else {
+            size_t padded = v.len[i] + (v.len[i] & 1);
+            p = writeCmdHeader(p, cmdElements[i].element, OFstatic_cast(Uint32, padded));
+            memcpy(p, v.s[i], v.len[i]);
+            /* UI is padded with a null byte, AE with a space */
+            if (padded > v.len[i]) p[v.len[i]] = (cmdElements[i].vr == CMD_UI) ? '\0' : ' ';
+            p += padded;
+        }
+    }
+    *length = 12 + groupLength;
+    return OFTrue;
+}
+
+static OFBool
+getCmdString(const T_DIMSE_CmdValues *v, int i, char *s, int maxlen)
+{
+    /* see getString(). UIDs with white space are corrected by dcmdata, so they are left to it */
+    const char *value = v->s[i];
+    size_t len = v->len[i];
+    if (len > OFstatic_cast(size_t, maxlen)) return OFFalse;
+    size_t n = 0;
+    while (n < len && value[n] != '\0') {
+        if (cmdElements[i].vr == CMD_UI && isspace(OFstatic_cast(unsigned char, value[n]))) return OFFalse;
+        n++;
+    }
+    memcpy(s, value, n);
+    s[n] = '\0';
+    DU_stripLeadingAndTrailingSpaces(s);
+    return OFTrue;
+}
+
+/* takes the element if present, returns OFFalse if it is required but missing */
+#define TAKE(v, i) (((v).present & (1UL << (i))) ? ((v).present &= ~(1UL << (i)), OFTrue) : OFFalse)
+
+/* messageIDElement is CMD_MESSAGEID or CMD_MESSAGEIDBEINGRESPONDEDTO, status is NULL if there is none */
+static OFBool
+takeCmdCommon(T_DIMSE_CmdValues *v, int messageIDElement, DIC_US *messageID,
+    T_DIMSE_DataSetType *dataSetType, DIC_US *status)
+{
+    if (!TAKE(*v, messageIDElement)) return OFFalse;
+    *messageID = v->us[messageIDElement];
+    if (!TAKE(*v, CMD_DATASETTYPE)) return OFFalse;
+    *dataSetType = (v->us[CMD_DATASETTYPE] == DIMSE_DATASET_NULL) ? DIMSE_DATASET_NULL : DIMSE_DATASET_PRESENT;
+    if (status) {
+        if (!TAKE(*v, CMD_STATUS)) return OFFalse;
+        *status = v->us[CMD_STATUS];
+    }
+    return OFTrue;
+}
+
+static OFBool
+takeCmdString(T_DIMSE_CmdValues *v, int i, char *s, int maxlen)
+{
+    return TAKE(*v, i) && getCmdString(v, i, s, maxlen);
+}
+
+static OFBool
+takeCmdPriority(T_DIMSE_CmdValues *v, T_DIMSE_Priority *priority)
+{
+    if (!TAKE(*v, CMD_PRIORITY)) return OFFalse;
+    *priority = OFstatic_cast(T_DIMSE_Priority, v->us[CMD_PRIORITY]);
+    return OFTrue;
+}
+
+/* optional string, sets flag in opts if present */
+static OFBool
+takeCmdStringOpt(T_DIMSE_CmdValues *v, int i, char *s, int maxlen,
+    unsigned int *opts, unsigned int flag)
+{
+    if (!TAKE(*v, i)) return OFTrue;
+    if (!getCmdString(v, i, s, maxlen)) return OFFalse;
+    *opts |= flag;
+    return OFTrue;
+}
+
+static void
+takeCmdUSOpt(T_DIMSE_CmdValues *v, int i, DIC_US *us, unsigned int *opts,
+    unsigned int flag)
+{
+    if (TAKE(*v, i)) {
+        *us = v->us[i];
+        *opts |= flag;
+    }
+}
+
+OFBool
+DIMSE_decodeCmd(T_DIMSE_Message *msg, const void *buf, unsigned long length)
+{
+    T_DIMSE_CmdValues v;
+    const unsigned char *p = OFstatic_cast(const unsigned char *, buf);
+    const unsigned char *end = p + length;
+    int next = 0;
+
+    /* read the elements, which must be known and in ascending order */
+    v.present = 0;
+    while (p < end) {
+        if (end - p < 8) return OFFalse;
+        Uint16 group = OFstatic_cast(Uint16, p[0] | (p[1] << 8));
+        Uint16 element = OFstatic_cast(Uint16, p[2] | (p[3] << 8));
+        Uint32 len = OFstatic_cast(Uint32, p[4]) | (OFstatic_cast(Uint32, p[5]) << 8) |
+            (OFstatic_cast(Uint32, p[6]) << 16) | (OFstatic_cast(Uint32, p[7]) << 24);
+        p += 8;
+        if (group != 0 || (len & 1) || len > OFstatic_cast(unsigned long, end - p)) return OFFalse;
+        while (next < CMD_ELEMENTS && cmdElements[next].element < element) next++;
+        if (next == CMD_ELEMENTS || cmdElements[next].element != element) return OFFalse;
+        switch (cmdElements[next].vr) {
+        case CMD_UL:
+            if (len != 4) return OFFalse;
+            break;
+        case CMD_US:
+            if (len != 2) return OFFalse;
+            v.us[next] = OFstatic_cast(Uint16, p[0] | (p[1] << 8));
+            break;
+        default:
+            v.s[next] = OFreinterpret_cast(const char *, p);
+            v.len[next] = len;
+            break;
+        }
+        v.present |= (1UL << next);
+        p += len;
+        next++;
+    }
+
+    /* the group length is optional and ignored */
+    TAKE(v, CMD_GROUPLENGTH);
+    if (!TAKE(v, CMD_COMMANDFIELD)) return OFFalse;
+
+    bzero((char*)msg, sizeof(*msg));
+    msg->CommandField = OFstatic_cast(T_DIMSE_Command, v.us[CMD_COMMANDFIELD]);
+
+    OFBool ok = OFFalse;
+    switch (msg->CommandField) {
+    case DIMSE_C_ECHO_RQ: {
+        T_DIMSE_C_EchoRQ *e = &msg->msg.CEchoRQ;
+        ok = takeCmdCommon(&v, CMD_MESSAGEID, &e->MessageID, &e->DataSetType, NULL) &&
+            takeCmdString(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN);
+        break;
+    }
+    case DIMSE_C_ECHO_RSP: {
+        T_DIMSE_C_EchoRSP *e = &msg->msg.CEchoRSP;
+        ok = takeCmdCommon(&v, CMD_MESSAGEIDBEINGRESPONDEDTO, &e->MessageIDBeingRespondedTo, &e->DataSetType, &e->DimseStatus) &&
+            takeCmdStringOpt(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN,
+                &e->opts, O_ECHO_AFFECTEDSOPCLASSUID);
+        break;
+    }
+    case DIMSE_C_STORE_RQ: {
+        T_DIMSE_C_StoreRQ *e = &msg->msg.CStoreRQ;
+        ok = takeCmdCommon(&v, CMD_MESSAGEID, &e->MessageID, &e->DataSetType, NULL) &&
+            takeCmdString(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN) &&
+            takeCmdString(&v, CMD_AFFECTEDSOPINSTANCEUID, e->AffectedSOPInstanceUID, DIC_UI_LEN) &&
+            takeCmdPriority(&v, &e->Priority) &&
+            takeCmdStringOpt(&v, CMD_MOVEORIGINATORAETITLE, e->MoveOriginatorApplicationEntityTitle,
+                DIC_AE_LEN, &e->opts, O_STORE_MOVEORIGINATORAETITLE);
+        takeCmdUSOpt(&v, CMD_MOVEORIGINATORID, &e->MoveOriginatorID, &e->opts, O_STORE_MOVEORIGINATORID);
+        break;
+    }
+    case DIMSE_C_STORE_RSP: {
+        T_DIMSE_C_StoreRSP *e = &msg->msg.CStoreRSP;
+        ok = takeCmdCommon(&v, CMD_MESSAGEIDBEINGRESPONDEDTO, &e->MessageIDBeingRespondedTo, &e->DataSetType, &e->DimseStatus) &&
+            takeCmdStringOpt(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN,
+                &e->opts, O_STORE_AFFECTEDSOPCLASSUID) &&
+            takeCmdStringOpt(&v, CMD_AFFECTEDSOPINSTANCEUID, e->AffectedSOPInstanceUID, DIC_UI_LEN,
+                &e->opts, O_STORE_AFFECTEDSOPINSTANCEUID);
+        break;
+    }
+    case DIMSE_C_FIND_RQ: {
+        T_DIMSE_C_FindRQ *e = &msg->msg.CFindRQ;
+        ok = takeCmdCommon(&v, CMD_MESSAGEID, &e->MessageID, &e->DataSetType, NULL) &&
+            takeCmdString(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN) &&
+            takeCmdPriority(&v, &e->Priority);
+        break;
+    }
+    case DIMSE_C_FIND_RSP: {
+        T_DIMSE_C_FindRSP *e = &msg->msg.CFindRSP;
+        ok = takeCmdCommon(&v, CMD_MESSAGEIDBEINGRESPONDEDTO, &e->MessageIDBeingRespondedTo, &e->DataSetType, &e->DimseStatus) &&
+            takeCmdStringOpt(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN,
+                &e->opts, O_FIND_AFFECTEDSOPCLASSUID);
+        break;
+    }
+    case DIMSE_C_GET_RQ: {
+        T_DIMSE_C_GetRQ *e = &msg->msg.CGetRQ;
+        ok = takeCmdCommon(&v, CMD_MESSAGEID, &e->MessageID, &e->DataSetType, NULL) &&
+            takeCmdString(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN) &&
+            takeCmdPriority(&v, &e->Priority);
+        break;
+    }
+    case DIMSE_C_GET_RSP: {
+        T_DIMSE_C_GetRSP *e = &msg->msg.CGetRSP;
+        ok = takeCmdCommon(&v, CMD_MESSAGEIDBEINGRESPONDEDTO, &e->MessageIDBeingRespondedTo, &e->DataSetType, &e->DimseStatus) &&
+            takeCmdStringOpt(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN,
+                &e->opts, O_GET_AFFECTEDSOPCLASSUID);
+        takeCmdUSOpt(&v, CMD_REMAINING, &e->NumberOfRemainingSubOperations, &e->opts, O_GET_NUMBEROFREMAININGSUBOPERATIONS);
+        takeCmdUSOpt(&v, CMD_COMPLETED, &e->NumberOfCompletedSubOperations, &e->opts, O_GET_NUMBEROFCOMPLETEDSUBOPERATIONS);
+        takeCmdUSOpt(&v, CMD_FAILED, &e->NumberOfFailedSubOperations, &e->opts, O_GET_NUMBEROFFAILEDSUBOPERATIONS);
+        takeCmdUSOpt(&v, CMD_WARNING, &e->NumberOfWarningSubOperations, &e->opts, O_GET_NUMBEROFWARNINGSUBOPERATIONS);
+        break;
+    }
+    case DIMSE_C_MOVE_RQ: {
+        T_DIMSE_C_MoveRQ *e = &msg->msg.CMoveRQ;
+        ok = takeCmdCommon(&v, CMD_MESSAGEID, &e->MessageID, &e->DataSetType, NULL) &&
+            takeCmdString(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN) &&
+            takeCmdPriority(&v, &e->Priority) &&
+            takeCmdString(&v, CMD_MOVEDESTINATION, e->MoveDestination, DIC_AE_LEN);
+        break;
+    }
+    case DIMSE_C_MOVE_RSP: {
+        T_DIMSE_C_MoveRSP *e = &msg->msg.CMoveRSP;
+        ok = takeCmdCommon(&v, CMD_MESSAGEIDBEINGRESPONDEDTO, &e->MessageIDBeingRespondedTo, &e->DataSetType, &e->DimseStatus) &&
+            takeCmdStringOpt(&v, CMD_AFFECTEDSOPCLASSUID, e->AffectedSOPClassUID, DIC_UI_LEN,
+                &e->opts, O_MOVE_AFFECTEDSOPCLASSUID);
+        takeCmdUSOpt(&v, CMD_REMAINING, &e->NumberOfRemainingSubOperations, &e->opts, O_MOVE_NUMBEROFREMAININGSUBOPERATIONS);
+        takeCmdUSOpt(&v, CMD_COMPLETED, &e->NumberOfCompletedSubOperations, &e->opts, O_MOVE_NUMBEROFCOMPLETEDSUBOPERATIONS);
+        takeCmdUSOpt(&v, CMD_FAILED, &e->NumberOfFailedSubOperations, &e->opts, O_MOVE_NUMBEROFFAILEDSUBOPERATIONS);
+        takeCmdUSOpt(&v, CMD_WARNING, &e->NumberOfWarningSubOperations, &e->opts, O_MOVE_NUMBEROFWARNINGSUBOPERATIONS);
+        break;
+    }
+    case DIMSE_C_CANCEL_RQ: {
+        T_DIMSE_C_CancelRQ *e = &msg->msg.CCancelRQ;
+        ok = takeCmdCommon(&v, CMD_MESSAGEIDBEINGRESPONDEDTO, &e->MessageIDBeingRespondedTo, &e->DataSetType, NULL);
+        break;
+    }
+    default:
+        break;
+    }
+
+    /* elements left over would be status detail */
+    return ok && v.present == 0;
+}
+
+#undef TAKE
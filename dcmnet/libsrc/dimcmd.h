@@ -100,4 +100,21 @@ DIMSE_isDataSetPresent(T_DIMSE_Message *msg);
 unsigned long
 DIMSE_countElements(DcmDataset *obj);
 
+/* Writes the command set of a C-service message to buf in little endian
+ * implicit, including the group length. Returns OFFalse without writing a
+ * valid command set if the message is not a C-service one or does not fit
+ * into bufLen bytes; DIMSE_buildCmdObject() must be used then.
+ */
+OFBool
+DIMSE_encodeCmd(T_DIMSE_Message *msg, void *buf, unsigned long bufLen,
+    unsigned long *length);
+
+/* Reads a complete command set of a C-service message from buf. Returns
+ * OFFalse if it is anything else, holds elements that would be status
+ * detail, or is malformed; it must be read into a DcmDataset and parsed by
+ * DIMSE_parseCmdObject() then, which also reports the errors.
+ */
+OFBool
+DIMSE_decodeCmd(T_DIMSE_Message *msg, const void *buf, unsigned long length);
+
 #endif
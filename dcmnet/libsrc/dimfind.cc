@@ -108,7 +108,8 @@ DIMSE_findUser(
         int &responseCount,
         DIMSE_FindUserCallback callback, void *callbackData,
         T_DIMSE_BlockingMode blockMode, int timeout,
-        T_DIMSE_C_FindRSP *response, DcmDataset **statusDetail)
+        T_DIMSE_C_FindRSP *response, DcmDataset **statusDetail,
+        const DcmReadProjection *responseProjection)
     /*
      * This function sends a C-FIND-RQ message and data set information containing the given
      * search mask over the network connection to an SCP. Having sent this information, the
@@ -139,6 +140,8 @@ DIMSE_findUser(
      *                                information with regard to the status information which is captured in the status
      *                                element (0000,0900) of the response message. Note that the value for element (0000,0900)
      *                                is not contained in this return value but in response.
+     *   responseProjection   - [in] If not NULL, only the elements of the response identifiers selected by this
+     *                               projection are read, the others are skipped while receiving them.
      */
 {
     T_DIMSE_Message req, rsp;
@@ -231,9 +234,14 @@ DIMSE_findUser(
             }
 
             /* receive the result data set on the network connection */
+            if (responseProjection != NULL) {
+                rspIds = new DcmDataset();
+                rspIds->setReadProjection(responseProjection);
+            }
             cond = DIMSE_receiveDataSetInMemory(assoc, blockMode, timeout,
                 &presID, &rspIds, NULL, NULL);
             if (cond != EC_Normal) {
+                delete rspIds;
                 return cond;
             }
 
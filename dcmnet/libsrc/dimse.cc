@@ -108,10 +108,12 @@
 #include "dcmtk/dcmdata/dcfilefo.h"    /* for class DcmFileFormat */
 #include "dcmtk/dcmdata/dcmetinf.h"    /* for class DcmMetaInfo */
 #include "dcmtk/dcmdata/dcistrmb.h"    /* for class DcmInputBufferStream */
+#include "dcmtk/dcmdata/dcistrmf.h"    /* for class DcmInputFileStream */
 #include "dcmtk/dcmdata/dcostrmb.h"    /* for class DcmOutputBufferStream */
 #include "dcmtk/dcmdata/dcostrmf.h"    /* for class DcmOutputFileStream */
 #include "dcmtk/dcmdata/dcvrul.h"      /* for class DcmUnsignedLong */
 #include "dcmtk/dcmdata/dcvrobow.h"    /* for class DcmOtherByteOtherWord */
+#include "dcmtk/ofstd/oftrace.h"      /* for class OFTraceSpan */
 #include "dcmtk/dcmdata/dcvrsh.h"      /* for class DcmShortString */
 #include "dcmtk/dcmdata/dcvrae.h"      /* for class DcmApplicationEntity */
 #include "dcmtk/dcmdata/dcdicent.h"    /* for class DcmDictEntry, needed for MSVC5 */
@@ -131,6 +133,14 @@
  */
 OFGlobal<Uint32> dcmMaxOutgoingPDUSize((Uint32) -1);
 
+/*  global variable specifying the minimum length of incoming P-DATA PDUs
+ *  whose data set fragment is received straight from the socket into the
+ *  value fields of the data set (see DIMSE_receiveDataSetInMemory()).
+ *  0 reads all PDUs into the PDU buffer first.
+ */
+OFGlobal<Uint32> dcmDirectPDVReceiveLength(65536);
+OFGlobal<OFBool> dcmSendFileDataUnchanged(OFFalse);
+
 /*
  * Other global variables (should be used very, very rarely).
  * Modification of this variables is THREAD UNSAFE.
@@ -355,6 +365,9 @@ getTransferSyntax(
         case EXS_JPEG2000:
         case EXS_JPEG2000MulticomponentLosslessOnly:
         case EXS_JPEG2000Multicomponent:
+        case EXS_HighThroughputJPEG2000LosslessOnly:
+        case EXS_HighThroughputJPEG2000withRPCLOptionsLosslessOnly:
+        case EXS_HighThroughputJPEG2000:
         case EXS_MPEG2MainProfileAtMainLevel:
         case EXS_MPEG2MainProfileAtHighLevel:
         case EXS_MPEG4HighProfileLevel4_1:
@@ -822,6 +835,118 @@ sendDcmDataset(
     return EC_Normal;
 }
 
+static OFBool
+findFileDataset(
+        const char *dataFileName,
+        E_TransferSyntax xferSyntax,
+        offile_off_t *offset,
+        offile_off_t *length)
+    /*
+     * This function checks if the data set of a DICOM file can be sent as stored in the file,
+     * i.e. if the file has a meta header and its data set is encoded in the given transfer
+     * syntax, and determines the position of the data set in the file.
+     *
+     * Parameters:
+     *   dataFileName    - [in] The name of the DICOM file.
+     *   xferSyntax      - [in] The transfer syntax of the presentation context.
+     *   offset          - [out] Position of the data set in the file.
+     *   length          - [out] Length of the data set, always even.
+     */
+{
+    DcmXfer xfer(xferSyntax);
+    /* deflated data sets are compressed by the output stream while being sent */
+    if (xfer.getStreamCompression() != ESC_none) return OFFalse;
+
+    DcmInputFileStream inStream(dataFileName);
+    if (inStream.status().bad()) return OFFalse;
+    const offile_off_t fileSize = OFstatic_cast(offile_off_t, OFStandard::getFileSize(dataFileName));
+
+    DcmMetaInfo metaInfo;
+    metaInfo.transferInit();
+    OFCondition cond = metaInfo.read(inStream, EXS_Unknown, EGL_noChange);
+    metaInfo.transferEnd();
+    OFString fileXfer;
+    if (cond.bad() || metaInfo.findAndGetOFString(DCM_TransferSyntaxUID, fileXfer).bad()) return OFFalse;
+    if (fileXfer != xfer.getXferID()) return OFFalse;
+
+    *offset = inStream.tell();
+    *length = fileSize - *offset;
+    return (*length > 0) && ((*length & 1) == 0);
+}
+
+static OFCondition
+sendFileDataset(
+        T_ASC_Association *assoc,
+        const char *dataFileName,
+        offile_off_t offset,
+        offile_off_t length,
+        T_ASC_PresentationContextID presID,
+        DIMSE_ProgressCallback callback,
+        void *callbackContext)
+    /*
+     * This function sends the data set of a DICOM file as stored in the file. The PDVs carry
+     * no data pointer, DUL reads their data from the file (see DUL_setPDVFile()).
+     *
+     * Parameters:
+     *   assoc           - [in] The association (network connection to another DICOM application).
+     *   dataFileName    - [in] The name of the DICOM file.
+     *   offset          - [in] Position of the data set in the file, see findFileDataset().
+     *   length          - [in] Length of the data set.
+     *   presId          - [in] The ID of the presentation context which shall be used
+     *   callback        - [in] Pointer to a function which shall be called to indicate progress.
+     *   callbackContext - []
+     */
+{
+    OFFile file;
+    if (!file.fopen(dataFileName, "rb"))
+    {
+        DCMNET_WARN(DIMSE_warn_str(assoc) << "sendMessage: cannot open DICOM file ("
+            << dataFileName << "): " << OFStandard::getLastSystemErrorCode().message());
+        return DIMSE_SENDFAILED;
+    }
+
+    /* same PDV size as for data sets in memory, see sendDcmDataset() */
+    unsigned long bufLen = assoc->sendPDVLength;
+    Uint32 maxpdulen = dcmMaxOutgoingPDUSize.get();
+    if (bufLen + 12 > maxpdulen)
+    {
+      bufLen = maxpdulen - 12;
+    }
+
+    OFCondition cond = DUL_setPDVFile(&assoc->DULassociation, &file, offset);
+    Uint32 bytesTransmitted = 0;
+    DUL_PDVLIST pdvList;
+    DUL_PDV pdv;
+    while (cond.good() && length > 0)
+    {
+        pdv.fragmentLength = (OFstatic_cast(offile_off_t, bufLen) < length) ? bufLen : OFstatic_cast(unsigned long, length);
+        pdv.presentationContextID = presID;
+        pdv.pdvType = DUL_DATASETPDV;
+        pdv.lastPDV = (OFstatic_cast(offile_off_t, pdv.fragmentLength) == length);
+        pdv.data = NULL;
+
+        pdvList.count = 1;
+        pdvList.pdv = &pdv;
+
+        DCMNET_TRACE("DIMSE sendFileDataset: sending " << pdv.fragmentLength << " bytes");
+
+        OFCondition dulCond = DUL_WritePDVs(&assoc->DULassociation, &pdvList);
+        if (dulCond.bad())
+        {
+            cond = makeDcmnetSubCondition(DIMSEC_SENDFAILED, OF_error, "DIMSE Failed to send message", dulCond);
+            break;
+        }
+
+        length -= pdv.fragmentLength;
+        bytesTransmitted += OFstatic_cast(Uint32, pdv.fragmentLength);
+        if (callback) {
+            callback(callbackContext, bytesTransmitted);
+        }
+    }
+    DUL_setPDVFile(&assoc->DULassociation, NULL, 0);
+    return cond;
+}
+
 /*
 ** Public Functions Bodies
 */
@@ -834,6 +959,64 @@ sendDcmDataset(
  * Message Send
  */
 
+static OFBool
+directCommandCoding()
+    /*
+     * Returns OFTrue if command sets may be encoded and decoded without a DcmDataset,
+     * see DIMSE_encodeCmd() and DIMSE_decodeCmd(). Saving and dumping them needs one.
+     */
+{
+    return !g_dimse_save_dimse_data && !DCM_dcmnetLogger.isEnabledFor(OFLogger::TRACE_LOG_LEVEL);
+}
+
+static OFBool
+encodeCommand(
+        T_ASC_Association *assoc,
+        T_DIMSE_Message *msg,
+        unsigned long *length)
+    /*
+     * This function writes the command set of msg into the association's send buffer,
+     * to be sent with sendCommandPDV(). Returns OFFalse if the command set has to be
+     * built as a DcmDataset instead.
+     */
+{
+    unsigned long bufLen = assoc->sendPDVLength;
+
+    /* same PDV size as for data sets in memory, see sendDcmDataset() */
+    Uint32 maxpdulen = dcmMaxOutgoingPDUSize.get();
+    if (bufLen + 12 > maxpdulen)
+    {
+      bufLen = maxpdulen - 12;
+    }
+    return DIMSE_encodeCmd(msg, assoc->sendPDVBuffer, bufLen, length);
+}
+
+static OFCondition
+sendCommandPDV(
+        T_ASC_Association *assoc,
+        T_ASC_PresentationContextID presID,
+        unsigned long length)
+    /*
+     * This function sends the command set written by encodeCommand() as a single PDV.
+     */
+{
+    DUL_PDVLIST pdvList;
+    DUL_PDV pdv;
+
+    pdv.fragmentLength = length;
+    pdv.presentationContextID = presID;
+    pdv.pdvType = DUL_COMMANDPDV;
+    pdv.lastPDV = OFTrue;
+    pdv.data = assoc->sendPDVBuffer;
+    pdvList.count = 1;
+    pdvList.pdv = &pdv;
+
+    OFCondition dulCond = DUL_WritePDVs(&assoc->DULassociation, &pdvList);
+    if (dulCond.bad())
+        return makeDcmnetSubCondition(DIMSEC_SENDFAILED, OF_error, "DIMSE Failed to send message", dulCond);
+    return EC_Normal;
+}
+
 static OFCondition
 DIMSE_sendMessage(
         T_ASC_Association *assoc,
@@ -867,10 +1050,16 @@ DIMSE_sendMessage(
      *                           DICOM application.
      */
 {
+    OFTraceSpan span("dimse.sendMessage");
     E_TransferSyntax xferSyntax;
     DcmDataset *cmdObj = NULL;
+    OFBool direct = OFFalse;
+    unsigned long cmdLength = 0;
     DcmFileFormat dcmff;
     int fromFile = 0;
+    OFBool sendFileData = OFFalse;
+    offile_off_t fileDataOffset = 0;
+    offile_off_t fileDataLength = 0;
     OFCondition cond = EC_Normal;
 
     if (commandSet) *commandSet = NULL;
@@ -889,10 +1078,16 @@ DIMSE_sendMessage(
     /* transfer syntax is supported at all. If any of the checks returns an error, return this error. */
     if (EC_Normal != (cond = checkPresentationContextForMessage(assoc, msg, presID, &xferSyntax))) return cond;
 
-    /* create a DcmDataset object ("command object") based on the information in the DIMSE command */
+    /* unless there is status detail or the caller wants a copy of the command, write the command */
+    /* of a C-service straight into the send buffer. Nothing else uses the buffer before it is sent. */
+    if (statusDetail == NULL && commandSet == NULL && directCommandCoding())
+      direct = encodeCommand(assoc, msg, &cmdLength);
+
+    /* otherwise create a DcmDataset object ("command object") based on the information in the DIMSE command */
     /* variable (remember that all DICOM commands are - in the end - particular data sets). The */
     /* information which will shortly be set in this object will be sent over the network later. */
-    cond = DIMSE_buildCmdObject(msg, &cmdObj);
+    if (!direct)
+      cond = DIMSE_buildCmdObject(msg, &cmdObj);
 
     /* if the command object has been created successfully and there is status detail */
     /* information move the status detail information to the command object. */
@@ -914,6 +1109,14 @@ DIMSE_sendMessage(
       }
       /* if there is no data object but a file name, we need to read data from the specified file */
       /* to create a data object with the actual instance data that shall be sent */
+      /* if requested, send the data set as stored in the file if it already has the */
+      /* transfer syntax of the presentation context, without parsing it */
+      else if ((dataObject == NULL)&&(dataFileName != NULL)&&dcmSendFileDataUnchanged.get()&&!g_dimse_save_dimse_data&&
+               findFileDataset(dataFileName, xferSyntax, &fileDataOffset, &fileDataLength))
+      {
+        DCMNET_DEBUG("DIMSE sendMessage: sending data set of file " << dataFileName << " unchanged");
+        sendFileData = OFTrue;
+      }
       else if ((dataObject == NULL)&&(dataFileName != NULL))
       {
         if (! dcmff.loadFile(dataFileName, EXS_Unknown).good())
@@ -954,7 +1157,7 @@ DIMSE_sendMessage(
           }
           cond = DIMSE_SENDFAILED;
         }
-      } else {
+      } else if (!sendFileData) {
         /* if there is neither a data object nor a file name, create a warning, since */
         /* the information in msg specified that instance data should be present. */
         DCMNET_WARN(DIMSE_warn_str(assoc) << "sendMessage: no dataset to send");
@@ -964,7 +1167,11 @@ DIMSE_sendMessage(
 
     /* if all previous calls were successful, go ahead and send the */
     /* specified DIMSE command to the other DICOM application */
-    if (cond.good())
+    if (cond.good() && direct)
+    {
+      cond = sendCommandPDV(assoc, presID, cmdLength);
+    }
+    else if (cond.good())
     {
       /* if the global variable says so, we want to save the */
       /* DIMSE command's information to a file */
@@ -992,6 +1199,10 @@ DIMSE_sendMessage(
       cond = sendDcmDataset(assoc, dataObject, presID, xferSyntax,
           DUL_DATASETPDV, callback, callbackContext);
     }
+    else if (cond.good() && sendFileData)
+    {
+      cond = sendFileDataset(assoc, dataFileName, fileDataOffset, fileDataLength, presID, callback, callbackContext);
+    }
 
     /* clean up some memory */
     delete cmdObj;
@@ -1030,6 +1241,86 @@ DIMSE_sendMessageUsingMemoryData(
     return DIMSE_sendMessage(assoc, presID, msg, statusDetail, dataObject, NULL, callback, callbackContext, commandSet);
 }
 
+OFCondition
+DIMSE_sendMessageCommand(
+        T_ASC_Association *assoc,
+        T_ASC_PresentationContextID presID,
+        T_DIMSE_Message *msg)
+{
+    E_TransferSyntax xferSyntax;
+    DcmDataset *cmdObj = NULL;
+    unsigned long cmdLength = 0;
+    OFCondition cond = EC_Normal;
+
+    if (!isDataDictPresent()) return DIMSE_NODATADICT;
+    if (EC_Normal != (cond = validateMessage(assoc, msg))) return cond;
+    if (EC_Normal != (cond = checkPresentationContextForMessage(assoc, msg, presID, &xferSyntax))) return cond;
+
+    if (directCommandCoding() && encodeCommand(assoc, msg, &cmdLength))
+      return sendCommandPDV(assoc, presID, cmdLength);
+
+    cond = DIMSE_buildCmdObject(msg, &cmdObj);
+    if (cond.good())
+    {
+      DCMNET_TRACE("DIMSE Command to be sent on Presentation Context ID: " << OFstatic_cast(Uint16, presID));
+      DCMNET_TRACE("DIMSE Command to send:" << OFendl << DcmObject::PrintHelper(*cmdObj));
+
+      /* DIMSE commands are always little endian implicit, the data set follows separately */
+      cond = sendDcmDataset(assoc, cmdObj, presID, EXS_LittleEndianImplicit, DUL_COMMANDPDV, NULL, NULL);
+    }
+    delete cmdObj;
+    return cond;
+}
+
+OFCondition
+DIMSE_sendDataSetFragment(
+        T_ASC_Association *assoc,
+        T_ASC_PresentationContextID presID,
+        const void *data,
+        Uint32 length,
+        OFBool last)
+{
+    if ((assoc == NULL) || (data == NULL && length > 0)) return DIMSE_NULLKEY;
+    if ((length % 2) != 0) return DIMSE_BADDATA;
+
+    /* same PDV size as for data sets in memory, see sendDcmDataset() */
+    unsigned long bufLen = assoc->sendPDVLength;
+    Uint32 maxpdulen = dcmMaxOutgoingPDUSize.get();
+    if (bufLen + 12 > maxpdulen)
+    {
+      bufLen = maxpdulen - 12;
+    }
+    /* PDVs split off a fragment have to be of even length as well */
+    bufLen &= ~1UL;
+
+    const unsigned char *pos = OFstatic_cast(const unsigned char *, data);
+    DUL_PDVLIST pdvList;
+    DUL_PDV pdv;
+    do
+    {
+        pdv.fragmentLength = (bufLen < length) ? bufLen : length;
+        pdv.presentationContextID = presID;
+        pdv.pdvType = DUL_DATASETPDV;
+        pdv.lastPDV = last && (pdv.fragmentLength == length);
+        pdv.data = OFconst_cast(unsigned char *, pos);
+
+        pdvList.count = 1;
+        pdvList.pdv = &pdv;
+
+        DCMNET_TRACE("DIMSE sendDataSetFragment: sending " << pdv.fragmentLength << " bytes (last: "
+            << ((pdv.lastPDV)?("YES"):("NO")) << ")");
+
+        OFCondition dulCond = DUL_WritePDVs(&assoc->DULassociation, &pdvList);
+        if (dulCond.bad())
+        {
+            return makeDcmnetSubCondition(DIMSEC_SENDFAILED, OF_error, "DIMSE Failed to send message", dulCond);
+        }
+        pos += pdv.fragmentLength;
+        length -= OFstatic_cast(Uint32, pdv.fragmentLength);
+    } while (length > 0);
+    return EC_Normal;
+}
+
 /*
  * Message Receive
  */
@@ -1098,6 +1389,29 @@ DIMSE_receiveCommand(
     /* set PDV counter to 0 */
     pdvCount = 0;
 
+    /* get the first PDV of the command */
+    cond = DIMSE_readNextPDV(assoc, blocking, timeout, &pdv);
+    if (cond.bad() || (cond == DUL_PEERREQUESTEDRELEASE))
+    {
+        if (cond == DIMSE_READPDVFAILED)
+            return makeDcmnetSubCondition(DIMSEC_RECEIVEFAILED, OF_error, "DIMSE Failed to receive message", cond);
+        else return cond; /* it was an abort or release request */
+    }
+
+    /* the command of a C-service usually arrives in a single PDV. Unless the caller wants a copy */
+    /* of it, decode it without a DcmDataset; anything else is read into one below. */
+    if (commandSet == NULL && pdv.pdvType == DUL_COMMANDPDV && pdv.lastPDV &&
+        (pdv.fragmentLength % 2) == 0 && directCommandCoding() &&
+        DIMSE_decodeCmd(msg, pdv.data, pdv.fragmentLength))
+    {
+        pid = pdv.presentationContextID;
+        cond = getTransferSyntax(assoc, pid, &xferSyntax);
+        if (cond.bad()) return cond;
+        cond = validateMessage(assoc, msg);
+        *presID = pid;
+        return cond;
+    }
+
     /* create a new DcmDataset variable to capture the DIMSE command which we are about to receive */
     cmdSet = new DcmDataset();
     if (cmdSet == NULL) return EC_MemoryExhausted;
@@ -1122,14 +1436,18 @@ DIMSE_receiveCommand(
         cmdBuf.releaseBuffer();
 
         /* get next PDV (in detail, in order to get this PDV, a */
-        /* PDU has to be read from the incoming socket stream) */
-        cond = DIMSE_readNextPDV(assoc, blocking, timeout, &pdv);
-        if (cond.bad() || (cond == DUL_PEERREQUESTEDRELEASE))
+        /* PDU has to be read from the incoming socket stream). */
+        /* The first one has been read above already. */
+        if (pdvCount > 0)
         {
-            delete cmdSet;
-            if (cond == DIMSE_READPDVFAILED)
-                return makeDcmnetSubCondition(DIMSEC_RECEIVEFAILED, OF_error, "DIMSE Failed to receive message", cond);
-            else return cond; /* it was an abort or release request */
+            cond = DIMSE_readNextPDV(assoc, blocking, timeout, &pdv);
+            if (cond.bad() || (cond == DUL_PEERREQUESTEDRELEASE))
+            {
+                delete cmdSet;
+                if (cond == DIMSE_READPDVFAILED)
+                    return makeDcmnetSubCondition(DIMSEC_RECEIVEFAILED, OF_error, "DIMSE Failed to receive message", cond);
+                else return cond; /* it was an abort or release request */
+            }
         }
 
         /* if this is the first loop iteration, get the presentation context ID which is captured in the */
@@ -1414,6 +1732,7 @@ DIMSE_receiveDataSetInFile(
     OFBool last = OFFalse;
     DIC_UL pdvCount = 0;
     DIC_UL bytesRead = 0;
+    OFTraceSpan span("dimse.receiveDataSet");
 
     if ((assoc == NULL) || (presID==NULL) || (filestream==NULL)) return DIMSE_NULLKEY;
 
@@ -1500,6 +1819,256 @@ DIMSE_receiveDataSetInFile(
 }
 
 
+/* size of the buffer for the small reads (tags and lengths) from a deferred PDV,
+ * larger reads go straight from the socket into the buffer of the caller
+ */
+#define DIMSE_PDV_STAGING_SIZE 16384
+
+/** producer for the fragments of a data set received as PDVs. The fragments of
+ *  PDVs that were read into the PDU buffer are handled like DcmBufferProducer
+ *  does. The fragment of a deferred PDV (see DUL_DeferPDVData()) is read from
+ *  the socket on demand: large reads, usually the value of an element, go
+ *  directly into the buffer of the caller, small reads through a staging buffer.
+ */
+class DcmPDVProducer: public DcmProducer
+{
+public:
+  /** constructor
+   *  @param assoc association from which deferred PDV fragments are read
+   */
+  DcmPDVProducer(T_ASC_Association *assoc)
+  : assoc_(assoc)
+  , buffer_()
+  , staging_(new unsigned char[DIMSE_PDV_STAGING_SIZE])
+  , status_(EC_Normal)
+  , eosflag_(OFFalse)
+  , direct_(OFFalse)
+  , buffered_(0)
+  {
+  }
+
+  /// destructor
+  virtual ~DcmPDVProducer()
+  {
+    delete[] staging_;
+  }
+
+  virtual OFBool good() const
+  {
+    return status_.good() && buffer_.good();
+  }
+
+  virtual OFCondition status() const
+  {
+    return status_.good() ? buffer_.status() : status_;
+  }
+
+  virtual OFBool eos()
+  {
+    return (eosflag_ && (avail() == 0)) || (!good());
+  }
+
+  virtual offile_off_t avail()
+  {
+    if (good()) return buffer_.avail() + pending(); else return 0;
+  }
+
+  virtual offile_off_t read(void *buf, offile_off_t buflen)
+  {
+    offile_off_t result = 0;
+    if (good() && buflen && buf)
+    {
+      unsigned char *target = OFstatic_cast(unsigned char *, buf);
+      result = readBuffered(target, buflen);
+      while (good() && (result < buflen) && pending())
+      {
+        if (buflen - result >= DIMSE_PDV_STAGING_SIZE)
+        {
+          // the buffered data has been read completely, receive the rest in place
+          unsigned long length = 0;
+          unsigned long count = pending();
+          if (OFstatic_cast(offile_off_t, count) > buflen - result) count = OFstatic_cast(unsigned long, buflen - result);
+          OFCondition cond = DUL_ReadPDVData(&assoc_->DULassociation, target + result, count, &length);
+          if (cond.bad()) status_ = cond;
+          result += length;
+          direct_ = OFTrue;
+          buffered_ = 0;
+        }
+        else if (stage())
+          result += readBuffered(target + result, buflen - result);
+      }
+    }
+    return result;
+  }
+
+  virtual offile_off_t skip(offile_off_t skiplen)
+  {
+    offile_off_t result = 0;
+    if (good() && skiplen)
+    {
+      result = buffer_.skip(skiplen);
+      buffered_ += result;
+      while (good() && (result < skiplen) && pending() && stage())
+      {
+        offile_off_t skipped = buffer_.skip(skiplen - result);
+        buffered_ += skipped;
+        result += skipped;
+      }
+    }
+    return result;
+  }
+
+  virtual void putback(offile_off_t num)
+  {
+    // data received in place is not available a second time
+    if (direct_ && (num > buffered_)) status_ = EC_PutbackFailed;
+    else
+    {
+      buffer_.putback(num);
+      buffered_ -= num;
+    }
+  }
+
+  /** adds a fragment which was read into the PDU buffer, see DcmBufferProducer::setBuffer()
+   */
+  void setBuffer(const void *buf, offile_off_t buflen)
+  {
+    buffer_.setBuffer(buf, buflen);
+  }
+
+  /** releases the current buffer, see DcmBufferProducer::releaseBuffer()
+   */
+  void releaseBuffer()
+  {
+    buffer_.releaseBuffer();
+  }
+
+  /** marks the end of stream, the data available now and the rest of
+   *  a deferred fragment are the last data of the stream
+   */
+  void setEos()
+  {
+    eosflag_ = OFTrue;
+  }
+
+private:
+
+  /// private unimplemented copy constructor
+  DcmPDVProducer(const DcmPDVProducer&);
+
+  /// private unimplemented copy assignment operator
+  DcmPDVProducer& operator=(const DcmPDVProducer&);
+
+  /// bytes of a deferred fragment which are still on the socket
+  unsigned long pending()
+  {
+    return DUL_PendingPDVData(&assoc_->DULassociation);
+  }
+
+  /// reads from the buffered data
+  offile_off_t readBuffered(unsigned char *target, offile_off_t buflen)
+  {
+    offile_off_t result = buffer_.read(target, buflen);
+    buffered_ += result;
+    return result;
+  }
+
+  /// receives the next part of a deferred fragment into the staging buffer
+  OFBool stage()
+  {
+    unsigned long length = 0;
+    buffer_.releaseBuffer();
+    OFCondition cond = DUL_ReadPDVData(&assoc_->DULassociation, staging_, DIMSE_PDV_STAGING_SIZE, &length);
+    if (cond.bad()) status_ = cond;
+    else buffer_.setBuffer(staging_, length);
+    return good();
+  }
+
+  /// the association from which deferred fragments are read
+  T_ASC_Association *assoc_;
+
+  /// fragments in memory: PDU buffer or staging buffer
+  DcmBufferProducer buffer_;
+
+  /// the staging buffer for small reads from a deferred fragment
+  unsigned char *staging_;
+
+  /// status of reading deferred fragments
+  OFCondition status_;
+
+  /// true if setEos has been called before
+  OFBool eosflag_;
+
+  /// true if data has been received in place
+  OFBool direct_;
+
+  /// number of bytes read from buffer_ since data has last been received in place
+  offile_off_t buffered_;
+};
+
+
+/** input stream for the fragments of a data set received as PDVs
+ */
+class DcmInputPDVStream: public DcmInputStream
+{
+public:
+  /** constructor
+   *  @param assoc association from which deferred PDV fragments are read
+   */
+  DcmInputPDVStream(T_ASC_Association *assoc)
+  : DcmInputStream(&producer_) // safe because DcmInputStream only stores pointer
+  , producer_(assoc)
+  {
+  }
+
+  virtual DcmInputStreamFactory *newFactory() const
+  {
+    // we don't support delayed loading from network streams
+    return NULL;
+  }
+
+  /** adds the fragment of a PDV to the input stream. The fragment is either in
+   *  the PDU buffer or is read from the association when it is needed.
+   *  @param pdv PDV returned by DIMSE_readNextPDV()
+   */
+  void setPDV(const DUL_PDV& pdv)
+  {
+    if (pdv.data && (pdv.fragmentLength > 0))
+      producer_.setBuffer(pdv.data, pdv.fragmentLength);
+
+    // if there is a compression filter, the following call will
+    // cause it to feed the compression engine with data from the
+    // new fragment.
+    skip(0);
+  }
+
+  /** makes the stream remember any unread bytes, see DcmInputBufferStream::releaseBuffer()
+   */
+  void releaseBuffer()
+  {
+    producer_.releaseBuffer();
+  }
+
+  /** marks the end of stream
+   */
+  void setEos()
+  {
+    producer_.setEos();
+  }
+
+private:
+
+  /// private unimplemented copy constructor
+  DcmInputPDVStream(const DcmInputPDVStream&);
+
+  /// private unimplemented copy assignment operator
+  DcmInputPDVStream& operator=(const DcmInputPDVStream&);
+
+  /// the final producer of the filter chain
+  DcmPDVProducer producer_;
+};
+
+
 OFCondition
 DIMSE_receiveDataSetInMemory(
         T_ASC_Association *assoc,
@@ -1519,6 +2088,7 @@ DIMSE_receiveDataSetInMemory(
     OFBool last = OFFalse;
     DIC_UL pdvCount = 0;
     DIC_UL bytesRead = 0;
+    OFTraceSpan span("dimse.receiveDataSet");
 
     /* check if the caller provided an address where the data set can be stored. If not return an error */
     if (dataObject == NULL) return DIMSE_NULLKEY;
@@ -1551,8 +2121,11 @@ DIMSE_receiveDataSetInMemory(
         return cond;
     }
 
-    /* create a buffer variable which can be used to store the received information */
-    DcmInputBufferStream dataBuf;
+    /* create a stream variable which can be used to store the received information. The fragments */
+    /* of large PDUs are received from the socket as they are parsed, so that the values of large */
+    /* elements (e.g. pixel data) go straight into their value fields without an intermediate copy. */
+    DcmInputPDVStream dataBuf(assoc);
+    DUL_DeferPDVData(&assoc->DULassociation, dcmDirectPDVReceiveLength.get());
 
     /* prepare the DcmDataset variable for transfer of data */
     dset->transferInit();
@@ -1623,11 +2196,9 @@ DIMSE_receiveDataSetInMemory(
 
         if (!last)
         {
-            /* if information is contained the PDVs fragment, we want to insert this information into the buffer */
-            if (pdv.fragmentLength > 0)
-            {
-                dataBuf.setBuffer(pdv.data, pdv.fragmentLength);
-            }
+            /* if information is contained the PDVs fragment, we want to insert this information into the */
+            /* stream; a deferred fragment is still on the socket and read while the data set is parsed */
+            dataBuf.setPDV(pdv);
 
             /* if this fragment contains the last fragment of the data set, set the end of the stream */
             if (pdv.lastPDV)
@@ -1645,6 +2216,12 @@ DIMSE_receiveDataSetInMemory(
                 cond = DIMSE_RECEIVEFAILED;
                 last = OFTrue;
             }
+            /* a data set read with a projection (see DcmDataset::setReadProjection()) may be */
+            /* complete before its end has been received, the rest of it is skipped */
+            else if (dset->transferState() == ERW_ready)
+            {
+                dataBuf.skip(dataBuf.avail());
+            }
         }
 
         if (!last)
@@ -1673,8 +2250,9 @@ DIMSE_receiveDataSetInMemory(
         }
     }
 
-    /* indicate the end of the transfer */
+    /* indicate the end of the transfer; unread deferred data is skipped with the next PDU */
     dset->transferEnd();
+    DUL_DeferPDVData(&assoc->DULassociation, 0);
 
     /* in case an error occurred, return this error */
     if (cond.bad())
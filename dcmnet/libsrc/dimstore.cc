@@ -135,48 +135,22 @@ privateUserCallback(void *callbackData, unsigned long bytes)
 }
 
 OFCondition
-DIMSE_storeUser(
+DIMSE_sendStoreRequest(
     T_ASC_Association *assoc, T_ASC_PresentationContextID presId,
     T_DIMSE_C_StoreRQ *request,
     const char *imageFileName, DcmDataset *imageDataSet,
     DIMSE_StoreUserCallback callback, void *callbackData,
-    T_DIMSE_BlockingMode blockMode, int timeout,
-    T_DIMSE_C_StoreRSP *response,
-    DcmDataset **statusDetail,
-    T_DIMSE_DetectedCancelParameters *checkForCancelParams,
     long imageFileTotalBytes)
     /*
-     * This function transmits data from a file or a dataset to an SCP. The transmission is
-     * conducted via network and using DIMSE C-STORE messages. Additionally, this function
-     * evaluates C-STORE-Response messages which were received from the SCP.
-     *
-     * Parameters:
-     *   assoc                - [in] The association (network connection to SCP).
-     *   presId               - [in] The ID of the presentation context which shall be used
-     *   request              - [in] Represents a DIMSE C-Store Request Message. Contains corresponding
-     *                               information, e.g. message ID, affected SOP class UID, etc.
-     *   imageFileName        - [in] The name of the file which is currently processed.
-     *   imageDataSet         - [in] The data set which is currently processed.
-     *   callback             - [in] Pointer to a function which shall be called to indicate progress.
-     *   callbackData         - [in] Pointer to data which shall be passed to the progress indicating function
-     *   blockMode            - [in] The blocking mode for receiving data (either DIMSE_BLOCKING or DIMSE_NONBLOCKING)
-     *   timeout              - [in] Timeout interval for receiving data. If the blocking mode is DIMSE_NONBLOCKING
-     *   response             - [out] Represents a DIMSE C-Store Response Message. Contains corresponding
-     *                                information, e.g. message ID being responded to, affected SOP class UID, etc.
-     *                                This variable contains in the end the C-STORE-RSP command which was received
-     *                                as a response to the C-STORE-RQ which was sent.
-     *   statusDetail         - [out] If a non-NULL value is passed this variable will in the end contain detailed
-     *                                information with regard to the status information which is captured in the status
-     *                                element (0000,0900) of the response message. Note that the value for element (0000,0900)
-     *                                is not contained in this return value but in response.
-     *   checkForCancelParams - [out] Indicates, if a C-Cancel (Request) Message was encountered. Contains corresponding
-     *                                information, e.g. a boolean value if a corresponding message was encountered and the
-     *                                C-Cancel (Request) Message itself (in case it actually was encountered).
-     *   imageFileTotalBytes  - [in] The size of the file which is currently processed in bytes.
+     * This function transmits a C-STORE-RQ message with the data from a file or a
+     * dataset without waiting for the C-STORE-RSP. It allows an SCU to have several
+     * requests outstanding if an asynchronous operations window was negotiated, the
+     * responses are received with DIMSE_receiveStoreResponse(). The parameters have
+     * the same meaning as for DIMSE_storeUser().
      */
 {
     OFCondition cond = EC_Normal;
-    T_DIMSE_Message req, rsp;
+    T_DIMSE_Message req;
     DIMSE_PrivateUserContext callbackCtx;
     DIMSE_ProgressCallback privCallback = NULL;
     T_DIMSE_StoreProgress progress;
@@ -184,9 +158,8 @@ DIMSE_storeUser(
     /* if there is no image file or no data set, no data can be sent */
     if (imageFileName == NULL && imageDataSet == NULL) return DIMSE_NULLKEY;
 
-    /* initialize the variables which represent DIMSE C-STORE request and DIMSE C-STORE response messages */
+    /* initialize the variable which represents the DIMSE C-STORE request message */
     bzero((char*)&req, sizeof(req));
-    bzero((char*)&rsp, sizeof(rsp));
 
     /* set corresponding values in the request message variable */
     req.CommandField = DIMSE_C_STORE_RQ;
@@ -241,6 +214,33 @@ DIMSE_storeUser(
         callback(callbackData, &progress, request);
     }
 
+    return EC_Normal;
+}
+
+OFCondition
+DIMSE_receiveStoreResponse(
+    T_ASC_Association *assoc,
+    T_DIMSE_BlockingMode blockMode, int timeout,
+    T_ASC_PresentationContextID *presId,
+    T_DIMSE_C_StoreRSP *response,
+    DcmDataset **statusDetail,
+    T_DIMSE_DetectedCancelParameters *checkForCancelParams)
+    /*
+     * This function receives the next C-STORE-RSP message on an association, the
+     * caller matches it to one of its outstanding requests by the value of
+     * MessageIDBeingRespondedTo. C-CANCEL-RQ messages received before the response
+     * are reported in checkForCancelParams if it is not NULL.
+     *
+     * Parameters:
+     *   presId               - [out] The ID of the presentation context the response was received on.
+     *   other parameters     - see DIMSE_storeUser().
+     */
+{
+    OFCondition cond = EC_Normal;
+    T_DIMSE_Message rsp;
+
+    bzero((char*)&rsp, sizeof(rsp));
+
     /* check if a C-CANCEL-RQ message was encountered earlier */
     if (checkForCancelParams != NULL) {
         checkForCancelParams->cancelEncountered = OFFalse;
@@ -249,12 +249,9 @@ DIMSE_storeUser(
     /* try to receive C-STORE-RSP */
     do
     {
-        /* remember the ID of the presentation context in a local variable */
-        T_ASC_PresentationContextID thisPresId = presId;
-
         /* try to receive a C-STORE-RSP over the network. */
         cond = DIMSE_receiveCommand(assoc, blockMode, timeout,
-            &thisPresId, &rsp, statusDetail);
+            presId, &rsp, statusDetail);
         if (cond != EC_Normal) return cond;
 
         /* if everything was successful so far, the rsp variable contains the command which */
@@ -263,7 +260,7 @@ DIMSE_storeUser(
         {
             checkForCancelParams->cancelEncountered = OFTrue;
             checkForCancelParams->req = rsp.msg.CCancelRQ;
-            checkForCancelParams->presId = thisPresId;
+            checkForCancelParams->presId = *presId;
         } else {
         /* if we did not receive a C-CANCEL-RQ */
 
@@ -277,14 +274,6 @@ DIMSE_storeUser(
 
             /* if we get to here, we received a C-STORE-RSP; store this message in the reference parameter */
             *response = rsp.msg.CStoreRSP;          // BoundsChecker warning !?
-
-            /* check if the response relates to the request which was sent earlier; if not, return an error */
-            if (response->MessageIDBeingRespondedTo != request->MessageID)
-            {
-              char buf2[256];
-              sprintf(buf2, "DIMSE: Unexpected Response MsgId: %d (expected: %d)", response->MessageIDBeingRespondedTo, request->MessageID);
-              return makeDcmnetCondition(DIMSEC_UNEXPECTEDRESPONSE, OF_error, buf2);
-            }
         }
     } while (checkForCancelParams != NULL && rsp.CommandField == DIMSE_C_CANCEL_RQ);
 
@@ -292,6 +281,72 @@ DIMSE_storeUser(
     return EC_Normal;
 }
 
+OFCondition
+DIMSE_storeUser(
+    T_ASC_Association *assoc, T_ASC_PresentationContextID presId,
+    T_DIMSE_C_StoreRQ *request,
+    const char *imageFileName, DcmDataset *imageDataSet,
+    DIMSE_StoreUserCallback callback, void *callbackData,
+    T_DIMSE_BlockingMode blockMode, int timeout,
+    T_DIMSE_C_StoreRSP *response,
+    DcmDataset **statusDetail,
+    T_DIMSE_DetectedCancelParameters *checkForCancelParams,
+    long imageFileTotalBytes)
+    /*
+     * This function transmits data from a file or a dataset to an SCP. The transmission is
+     * conducted via network and using DIMSE C-STORE messages. Additionally, this function
+     * evaluates C-STORE-Response messages which were received from the SCP.
+     *
+     * Parameters:
+     *   assoc                - [in] The association (network connection to SCP).
+     *   presId               - [in] The ID of the presentation context which shall be used
+     *   request              - [in] Represents a DIMSE C-Store Request Message. Contains corresponding
+     *                               information, e.g. message ID, affected SOP class UID, etc.
+     *   imageFileName        - [in] The name of the file which is currently processed.
+     *   imageDataSet         - [in] The data set which is currently processed.
+     *   callback             - [in] Pointer to a function which shall be called to indicate progress.
+     *   callbackData         - [in] Pointer to data which shall be passed to the progress indicating function
+     *   blockMode            - [in] The blocking mode for receiving data (either DIMSE_BLOCKING or DIMSE_NONBLOCKING)
+     *   timeout              - [in] Timeout interval for receiving data. If the blocking mode is DIMSE_NONBLOCKING
+     *   response             - [out] Represents a DIMSE C-Store Response Message. Contains corresponding
+     *                                information, e.g. message ID being responded to, affected SOP class UID, etc.
+     *                                This variable contains in the end the C-STORE-RSP command which was received
+     *                                as a response to the C-STORE-RQ which was sent.
+     *   statusDetail         - [out] If a non-NULL value is passed this variable will in the end contain detailed
+     *                                information with regard to the status information which is captured in the status
+     *                                element (0000,0900) of the response message. Note that the value for element (0000,0900)
+     *                                is not contained in this return value but in response.
+     *   checkForCancelParams - [out] Indicates, if a C-Cancel (Request) Message was encountered. Contains corresponding
+     *                                information, e.g. a boolean value if a corresponding message was encountered and the
+     *                                C-Cancel (Request) Message itself (in case it actually was encountered).
+     *   imageFileTotalBytes  - [in] The size of the file which is currently processed in bytes.
+     */
+{
+    /* send C-STORE-RQ message and instance data */
+    OFCondition cond = DIMSE_sendStoreRequest(assoc, presId, request,
+        imageFileName, imageDataSet, callback, callbackData, imageFileTotalBytes);
+    if (cond != EC_Normal) return cond;
+
+    /* remember the ID of the presentation context in a local variable */
+    T_ASC_PresentationContextID thisPresId = presId;
+
+    /* receive C-STORE-RSP */
+    cond = DIMSE_receiveStoreResponse(assoc, blockMode, timeout,
+        &thisPresId, response, statusDetail, checkForCancelParams);
+    if (cond != EC_Normal) return cond;
+
+    /* check if the response relates to the request which was sent earlier; if not, return an error */
+    if (response->MessageIDBeingRespondedTo != request->MessageID)
+    {
+      char buf2[256];
+      sprintf(buf2, "DIMSE: Unexpected Response MsgId: %d (expected: %d)", response->MessageIDBeingRespondedTo, request->MessageID);
+      return makeDcmnetCondition(DIMSEC_UNEXPECTEDRESPONSE, OF_error, buf2);
+    }
+
+    /* return result value */
+    return EC_Normal;
+}
+
 
 
 OFCondition
@@ -142,11 +142,13 @@ DcmStorageSCU::DcmStorageSCU()
     HaltOnInvalidFileMode(OFTrue),
     HaltOnUnsuccessfulStoreMode(OFTrue),
     AllowIllegalProposalMode(OFTrue),
+    ProposeDeflatedMode(OFFalse),
     ReadFromDICOMDIRMode(OFFalse),
     MoveOriginatorAETitle(),
     MoveOriginatorMsgID(0),
     TransferList(),
-    CurrentTransferEntry()
+    CurrentTransferEntry(),
+    OutstandingRequests()
 {
     CurrentTransferEntry = TransferList.begin();
 }
@@ -168,6 +170,7 @@ void DcmStorageSCU::clear()
     HaltOnInvalidFileMode = OFTrue;
     HaltOnUnsuccessfulStoreMode = OFTrue;
     AllowIllegalProposalMode = OFTrue;
+    ProposeDeflatedMode = OFFalse;
     ReadFromDICOMDIRMode = OFFalse;
     MoveOriginatorAETitle.clear();
     MoveOriginatorMsgID = 0;
@@ -228,6 +231,12 @@ OFBool DcmStorageSCU::getAllowIllegalProposalMode() const
 }
 
 
+OFBool DcmStorageSCU::getProposeDeflatedMode() const
+{
+    return ProposeDeflatedMode;
+}
+
+
 OFBool DcmStorageSCU::getReadFromDICOMDIRMode() const
 {
     return ReadFromDICOMDIRMode;
@@ -267,6 +276,12 @@ void DcmStorageSCU::setAllowIllegalProposalMode(const OFBool allowMode)
 }
 
 
+void DcmStorageSCU::setProposeDeflatedMode(const OFBool deflatedMode)
+{
+    ProposeDeflatedMode = deflatedMode;
+}
+
+
 void DcmStorageSCU::setReadFromDICOMDIRMode(const OFBool readMode)
 {
     ReadFromDICOMDIRMode = readMode;
@@ -560,6 +575,12 @@ OFCondition DcmStorageSCU::addPresentationContexts()
         uncompressedXfers.push_back(UID_LittleEndianExplicitTransferSyntax);
         uncompressedXfers.push_back(UID_BigEndianExplicitTransferSyntax);
         uncompressedXfers.push_back(UID_LittleEndianImplicitTransferSyntax);
+        // the same preceded by deflate for non-image SOP classes (if enabled)
+        OFList<OFString> deflatedXfers;
+        deflatedXfers.push_back(UID_DeflatedExplicitVRLittleEndianTransferSyntax);
+        deflatedXfers.push_back(UID_LittleEndianExplicitTransferSyntax);
+        deflatedXfers.push_back(UID_BigEndianExplicitTransferSyntax);
+        deflatedXfers.push_back(UID_LittleEndianImplicitTransferSyntax);
         // make sure that the list of presentation contexts is empty before we start
         clearPresentationContexts();
         // iterate over the list of SOP instance to be transferred
@@ -717,6 +738,14 @@ OFCondition DcmStorageSCU::addPresentationContexts()
                     // uncompressed case: always propose all three transfer syntaxes without compression
                     else
                     {
+#ifdef WITH_ZLIB
+                        // non-image objects compress well with deflate, so propose it first (if enabled)
+                        if (ProposeDeflatedMode && !dcmIsImageStorageSOPClassUID(sopClassUID))
+                        {
+                            DCMNET_DEBUG("also propose the deflated transfer syntax for this non-image SOP class");
+                            status = addPresentationContext(sopClassUID, deflatedXfers);
+                        } else
+#endif
                         // call the inherited method from the base class doing the real work
                         status = addPresentationContext(sopClassUID, uncompressedXfers);
                     }
@@ -792,6 +821,10 @@ OFCondition DcmStorageSCU::sendSOPInstances()
     if (!TransferList.empty())
     {
         DcmDataset *dataset = NULL;
+        // number of C-STORE requests that may be outstanding on this association
+        const size_t window = getAsyncOperationsWindow();
+        if (window > 1)
+            DCMNET_DEBUG("sending up to " << window << " C-STORE requests before waiting for the responses");
         // iterate over the list of SOP instance to be transferred
         // (continue with next SOP instance if there already was a transmission)
         OFListConstIterator(TransferEntry *) lastEntry = TransferList.end();
@@ -801,6 +834,7 @@ OFCondition DcmStorageSCU::sendSOPInstances()
             if (!(*CurrentTransferEntry)->RequestSent)
             {
                 DcmFileFormat fileformat;
+                OFBool responsePending = OFFalse;
                 // check whether SOP instance can be sent on this association
                 // (i.e. whether it has been negotiated for this association)
                 if ((*CurrentTransferEntry)->PresentationContextID == 0)
@@ -870,9 +904,22 @@ OFCondition DcmStorageSCU::sendSOPInstances()
                     // notify user of this class that the current SOP instance is to be sent
                     notifySOPInstanceToBeSent(**CurrentTransferEntry);
                     // call the inherited method from the base class doing the real work
-                    status = sendSTORERequest((*CurrentTransferEntry)->PresentationContextID, "" /* filename */,
-                        dataset, (*CurrentTransferEntry)->ResponseStatusCode,
-                        MoveOriginatorAETitle, MoveOriginatorMsgID);
+                    if (window > 1)
+                    {
+                        // the response is received later and matched by message ID
+                        Uint16 messageID = 0;
+                        status = sendSTORERequestAsync((*CurrentTransferEntry)->PresentationContextID, "" /* filename */,
+                            dataset, messageID, MoveOriginatorAETitle, MoveOriginatorMsgID);
+                        if (status.good())
+                        {
+                            OutstandingRequests[messageID] = *CurrentTransferEntry;
+                            responsePending = OFTrue;
+                        }
+                    } else {
+                        status = sendSTORERequest((*CurrentTransferEntry)->PresentationContextID, "" /* filename */,
+                            dataset, (*CurrentTransferEntry)->ResponseStatusCode,
+                            MoveOriginatorAETitle, MoveOriginatorMsgID);
+                    }
                     // store some further information (even in case of error)
                     (*CurrentTransferEntry)->AssociationNumber = AssociationCounter;
                     (*CurrentTransferEntry)->NetworkTransferSyntax = dataset->getCurrentXfer();
@@ -912,13 +959,24 @@ OFCondition DcmStorageSCU::sendSOPInstances()
                         status = EC_Normal;
                 }
                 // notify user of this class that the current SOP instance has been processed
-                notifySOPInstanceSent(**CurrentTransferEntry);
+                // (for an outstanding request as soon as the response has been received)
+                if (!responsePending)
+                    notifySOPInstanceSent(**CurrentTransferEntry);
+                // wait for a response if the window is full
+                while (status.good() && (OutstandingRequests.size() >= window))
+                    status = receiveOutstandingResponse();
             }
             ++CurrentTransferEntry;
             // check whether the sending process should be stopped
             if (shouldStopAfterCurrentSOPInstance())
                 break;
         }
+        // receive the responses to the requests that are still outstanding
+        OFCondition rspStatus = EC_Normal;
+        while (!OutstandingRequests.empty() && rspStatus.good())
+            rspStatus = receiveOutstandingResponse();
+        if (status.good())
+            status = rspStatus;
     } else {
         // report an error to the caller
         status = NET_EC_NoSOPInstancesToSend;
@@ -927,6 +985,37 @@ OFCondition DcmStorageSCU::sendSOPInstances()
 }
 
 
+OFCondition DcmStorageSCU::receiveOutstandingResponse()
+{
+    Uint16 messageID = 0;
+    Uint16 rspStatusCode = 0;
+    OFCondition status = receiveSTOREResponse(messageID, rspStatusCode);
+    if (status.good())
+    {
+        OFMap<Uint16, TransferEntry *>::iterator it = OutstandingRequests.find(messageID);
+        if (it != OutstandingRequests.end())
+        {
+            TransferEntry *entry = it->second;
+            OutstandingRequests.erase(it);
+            entry->ResponseStatusCode = rspStatusCode;
+            // notify user of this class that the SOP instance has been processed
+            notifySOPInstanceSent(*entry);
+        } else {
+            DCMNET_WARN("received C-STORE response for unknown message ID " << messageID);
+        }
+    } else {
+        // as for a synchronous request, SOP instances without a response count as not sent
+        for (OFMap<Uint16, TransferEntry *>::iterator it = OutstandingRequests.begin(); it != OutstandingRequests.end(); ++it)
+        {
+            it->second->RequestSent = OFFalse;
+            notifySOPInstanceSent(*it->second);
+        }
+        OutstandingRequests.clear();
+    }
+    return status;
+}
+
+
 void DcmStorageSCU::notifySOPInstanceToBeSent(const TransferEntry & /*transferEntry*/)
 {
     // do nothing in the default implementation
@@ -75,6 +75,7 @@
 #ifdef HAVE_WINDOWS_H
 #include <winsock2.h>  /* for SO_EXCLUSIVEADDRUSE */
 #include <ws2tcpip.h>  /* for socklen_t */
+#include <mstcpip.h>   /* for SIO_KEEPALIVE_VALS */
 #endif
 
 #include "dcmtk/dcmnet/diutil.h"
@@ -151,6 +152,7 @@ END_EXTERN_C
 
 OFGlobal<OFBool> dcmDisableGethostbyaddr(OFFalse);
 OFGlobal<Sint32> dcmConnectionTimeout(-1);
+OFGlobal<DUL_HostResolver> dcmHostResolver((DUL_HostResolver)NULL);
 OFGlobal<DcmNativeSocketType> dcmExternalSocketHandle(DCMNET_INVALID_SOCKET);
 OFGlobal<const char *> dcmTCPWrapperDaemonName((const char *)NULL);
 OFGlobal<unsigned long> dcmEnableBackwardCompatibility(0);
@@ -191,9 +193,9 @@ get_association_parameter(void *paramAddress,
   DUL_DATA_TYPE outputType, void *outputAddress, size_t outputLength);
 
 #ifdef _WIN32
-static void setTCPBufferLength(SOCKET sock);
+static void setTCPBufferLength(SOCKET sock, int bufferLength);
 #else
-static void setTCPBufferLength(int sock);
+static void setTCPBufferLength(int sock, int bufferLength);
 #endif
 
 static OFCondition checkNetwork(PRIVATE_NETWORKKEY ** networkKey);
@@ -1426,6 +1428,139 @@ DUL_NextPDV(DUL_ASSOCIATIONKEY ** callerAssociation, DUL_PDV * pdv)
 }
 
 
+/* DUL_DeferPDVData
+**
+** Purpose:
+**      Let the association leave the value of a PDV on the socket
+**      instead of reading it into the fragment buffer. This is done
+**      for P-DATA PDUs of at least minLength bytes that contain a
+**      single PDV. The value of such a PDV is returned by DUL_NextPDV
+**      with a NULL data pointer and must be read by DUL_ReadPDVData,
+**      so that it can be received straight into its final buffer.
+**
+** Parameter Dictionary:
+**      callerAssociation  Caller's handle to the Association
+**      minLength          Minimum PDU length, 0 reads all PDUs completely
+**
+** Return Values:
+**
+**
+** Algorithm:
+**      Description of the algorithm (optional) and any other notes.
+*/
+OFCondition
+DUL_DeferPDVData(DUL_ASSOCIATIONKEY ** callerAssociation, unsigned long minLength)
+{
+    PRIVATE_ASSOCIATIONKEY
+        ** association = (PRIVATE_ASSOCIATIONKEY **) callerAssociation;
+
+    OFCondition cond = checkAssociation(association);
+    if (cond.bad()) return cond;
+
+    /* the PDU has to hold at least the PDV item header */
+    if ((minLength > 0) && (minLength < 6)) minLength = 6;
+    (*association)->deferPDVLength = minLength;
+    return EC_Normal;
+}
+
+
+/* DUL_setPDVFile
+**
+** Purpose:
+**      Let DUL_WritePDVs send the data of PDVs with a NULL data pointer
+**      from the given file, starting at the given offset and advancing
+**      by the fragment length of each such PDV. The transport connection
+**      sends the file contents without copying them into the PDU buffer
+**      where possible.
+**
+** Parameter Dictionary:
+**      callerAssociation  Caller's handle to the Association
+**      file               File to be sent, NULL to stop sending from a file.
+**                         Must remain open until it is reset.
+**      offset             Position of the data of the next PDV in the file
+**
+** Return Values:
+**
+**
+** Algorithm:
+**      Description of the algorithm (optional) and any other notes.
+*/
+OFCondition
+DUL_setPDVFile(DUL_ASSOCIATIONKEY ** callerAssociation, OFFile *file, offile_off_t offset)
+{
+    PRIVATE_ASSOCIATIONKEY
+        ** association = (PRIVATE_ASSOCIATIONKEY **) callerAssociation;
+
+    OFCondition cond = checkAssociation(association);
+    if (cond.bad()) return cond;
+
+    (*association)->pdvFile = file;
+    (*association)->pdvFileOffset = offset;
+    return EC_Normal;
+}
+
+
+/* DUL_PendingPDVData
+**
+** Purpose:
+**      Return the number of bytes of the current PDV value which are
+**      still to be read from the socket with DUL_ReadPDVData.
+**
+** Parameter Dictionary:
+**      callerAssociation  Caller's handle to the Association
+**
+** Return Values:
+**      Number of bytes, 0 if the PDV value is in memory.
+**
+** Algorithm:
+**      Description of the algorithm (optional) and any other notes.
+*/
+unsigned long
+DUL_PendingPDVData(DUL_ASSOCIATIONKEY ** callerAssociation)
+{
+    PRIVATE_ASSOCIATIONKEY
+        ** association = (PRIVATE_ASSOCIATIONKEY **) callerAssociation;
+
+    if (checkAssociation(association).bad()) return 0;
+    return (*association)->pendingPDVData;
+}
+
+
+/* DUL_ReadPDVData
+**
+** Purpose:
+**      Read (a part of) the value of a deferred PDV from the socket
+**      into the buffer of the caller.
+**
+** Parameter Dictionary:
+**      callerAssociation  Caller's handle to the Association
+**      buffer             Buffer to hold the data
+**      length             Number of bytes to read, at most the number
+**                         returned by DUL_PendingPDVData
+**      bytesRead          Number of bytes actually read (returned to
+**                         the caller)
+**
+** Return Values:
+**
+**
+** Algorithm:
+**      Description of the algorithm (optional) and any other notes.
+*/
+OFCondition
+DUL_ReadPDVData(DUL_ASSOCIATIONKEY ** callerAssociation, void *buffer,
+                unsigned long length, unsigned long *bytesRead)
+{
+    PRIVATE_ASSOCIATIONKEY
+        ** association = (PRIVATE_ASSOCIATIONKEY **) callerAssociation;
+
+    *bytesRead = 0;
+    OFCondition cond = checkAssociation(association);
+    if (cond.bad()) return cond;
+
+    return PRV_ReadPDVData(association, buffer, length, bytesRead);
+}
+
+
 /* DUL_ClearServiceParameters
 **
 ** Purpose:
@@ -1913,13 +2048,15 @@ receiveTransportConnectionTCP(PRIVATE_NETWORKKEY ** network,
         msg += OFStandard::getLastNetworkErrorCode().message();
         return makeDcmnetCondition(DULC_TCPINITERROR, OF_error, msg.c_str());
     }
-    setTCPBufferLength(sock);
+    setTCPBufferLength(sock, (*network)->tcpBufferLength);
+    PRV_SetTCPKeepAlive(*network, sock);
 
     /*
      * Disable the so-called Nagle algorithm (if requested).
      * This might provide a better network performance on some systems/environments.
      * By default, the algorithm is not disabled unless DISABLE_NAGLE_ALGORITHM is defined.
-     * The default behavior can be changed by setting the environment variable TCP_NODELAY.
+     * The default behavior can be changed by setting the environment variable TCP_NODELAY
+     * or per network with DUL_setTCPSocketOptions().
      */
 
 #ifdef DONT_DISABLE_NAGLE_ALGORITHM
@@ -1931,16 +2068,26 @@ receiveTransportConnectionTCP(PRIVATE_NETWORKKEY ** network,
 #else
     int tcpNoDelay = 0; // don't disable
 #endif
-    char* tcpNoDelayString = NULL;
-    DCMNET_TRACE("checking whether environment variable TCP_NODELAY is set");
-    if ((tcpNoDelayString = getenv("TCP_NODELAY")) != NULL)
+    const char* tcpNoDelayString = NULL;
+    if ((*network)->tcpNoDelay >= 0)
     {
-      if (sscanf(tcpNoDelayString, "%d", &tcpNoDelay) != 1)
+      // the network setting takes precedence over the environment variable
+      tcpNoDelay = (*network)->tcpNoDelay;
+      tcpNoDelayString = tcpNoDelay ? "1" : "0";
+      DCMNET_TRACE("  TCP_NODELAY set for this network, using the value " << tcpNoDelay);
+    }
+    else
+    {
+      DCMNET_TRACE("checking whether environment variable TCP_NODELAY is set");
+      if ((tcpNoDelayString = getenv("TCP_NODELAY")) != NULL)
       {
-        DCMNET_WARN("DUL: cannot parse environment variable TCP_NODELAY=" << tcpNoDelayString);
-      }
-    } else
-      DCMNET_TRACE("  environment variable TCP_NODELAY not set, using the default value (" << tcpNoDelay << ")");
+        if (sscanf(tcpNoDelayString, "%d", &tcpNoDelay) != 1)
+        {
+          DCMNET_WARN("DUL: cannot parse environment variable TCP_NODELAY=" << tcpNoDelayString);
+        }
+      } else
+        DCMNET_TRACE("  environment variable TCP_NODELAY not set, using the default value (" << tcpNoDelay << ")");
+    }
     if (tcpNoDelay) {
 #ifdef DISABLE_NAGLE_ALGORITHM
       DCMNET_DEBUG("DUL: disabling Nagle algorithm as defined at compilation time (DISABLE_NAGLE_ALGORITHM)");
@@ -2114,6 +2261,11 @@ createNetworkKey(const char *mode,
         (*key)->timeout = DEFAULT_TIMEOUT;
 
     (*key)->options = opt;
+    (*key)->tcpBufferLength = -1;
+    (*key)->tcpNoDelay = -1;
+    (*key)->tcpKeepAliveIdle = 0;
+    (*key)->tcpKeepAliveInterval = 0;
+    (*key)->tcpKeepAliveProbes = 0;
 
     return EC_Normal;
 }
@@ -2316,6 +2468,10 @@ createAssociationKey(PRIVATE_NETWORKKEY ** networkKey,
     key->pdvIndex = -1;
     key->pdvPointer = NULL;
     (void) memset(&key->currentPDV, 0, sizeof(key->currentPDV));
+    key->deferPDVLength = 0;
+    key->pendingPDVData = 0;
+    key->pdvFile = NULL;
+    key->pdvFileOffset = 0;
 
     key->associatePDUFlag = 0;
     key->associatePDU = NULL;
@@ -2402,7 +2558,9 @@ get_association_parameter(void *paramAddress,
 **      Initialize the length of the buffer.
 **
 ** Parameter Dictionary:
-**      sock  Socket descriptor.
+**      sock          Socket descriptor.
+**      bufferLength  Buffer length set for the network, -1 to use
+**                    the environment variable TCP_BUFFER_LENGTH.
 **
 ** Return Values:
 **      None
@@ -2414,36 +2572,105 @@ get_association_parameter(void *paramAddress,
 **      Description of the algorithm (optional) and any other notes.
 */
 #ifdef _WIN32
-static void setTCPBufferLength(SOCKET sock)
+static void setTCPBufferLength(SOCKET sock, int bufferLength)
 #else
-static void setTCPBufferLength(int sock)
+static void setTCPBufferLength(int sock, int bufferLength)
 #endif
 {
     char *TCPBufferLength;
     int bufLen;
 
     /*
-     * check whether environment variable TCP_BUFFER_LENGTH is set.
-     * If not, the the operating system is responsible for selecting
-     * appropriate values for the TCP send and receive buffer lengths.
+     * a buffer length set for the network takes precedence. Otherwise check
+     * whether environment variable TCP_BUFFER_LENGTH is set. If not, the
+     * operating system is responsible for selecting appropriate values for
+     * the TCP send and receive buffer lengths.
      */
-    DCMNET_TRACE("checking whether environment variable TCP_BUFFER_LENGTH is set");
-    if ((TCPBufferLength = getenv("TCP_BUFFER_LENGTH")) != NULL) {
-        if (sscanf(TCPBufferLength, "%d", &bufLen) == 1) {
+    if (bufferLength >= 0) {
+        bufLen = bufferLength;
+    } else {
+        DCMNET_TRACE("checking whether environment variable TCP_BUFFER_LENGTH is set");
+        if ((TCPBufferLength = getenv("TCP_BUFFER_LENGTH")) == NULL) {
+            DCMNET_TRACE("  environment variable TCP_BUFFER_LENGTH not set, using the system defaults");
+            return;
+        }
+        if (sscanf(TCPBufferLength, "%d", &bufLen) != 1) {
+            DCMNET_WARN("DUL: cannot parse environment variable TCP_BUFFER_LENGTH=" << TCPBufferLength);
+            return;
+        }
+    }
 #if defined(SO_SNDBUF) && defined(SO_RCVBUF)
-            if (bufLen == 0)
-                bufLen = 65536; // a socket buffer size of 64K gives good throughput for image transmission
-            DCMNET_DEBUG("DUL: setting TCP buffer length to " << bufLen << " bytes");
-            (void) setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *) &bufLen, sizeof(bufLen));
-            (void) setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *) &bufLen, sizeof(bufLen));
+    if (bufLen == 0)
+        bufLen = 65536; // a socket buffer size of 64K gives good throughput for image transmission
+    DCMNET_DEBUG("DUL: setting TCP buffer length to " << bufLen << " bytes");
+    (void) setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *) &bufLen, sizeof(bufLen));
+    (void) setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *) &bufLen, sizeof(bufLen));
 #else
-            DCMNET_WARN("DUL: setTCPBufferLength: cannot set TCP buffer length socket option: "
-                << "code disabled because SO_SNDBUF and SO_RCVBUF constants are unknown");
+    DCMNET_WARN("DUL: setTCPBufferLength: cannot set TCP buffer length socket option: "
+        << "code disabled because SO_SNDBUF and SO_RCVBUF constants are unknown");
 #endif // SO_SNDBUF and SO_RCVBUF
-        } else
-            DCMNET_WARN("DUL: cannot parse environment variable TCP_BUFFER_LENGTH=" << TCPBufferLength);
-    } else
-        DCMNET_TRACE("  environment variable TCP_BUFFER_LENGTH not set, using the system defaults");
+}
+
+
+/* PRV_SetTCPKeepAlive
+**
+** Purpose:
+**      Enable TCP keepalive on a connection as set for its network.
+**
+** Parameter Dictionary:
+**      network       Network of the connection.
+**      sock          Socket descriptor.
+**
+** Return Values:
+**      None
+**
+** Notes:
+**      Without keepalive a peer that disappears without closing the
+**      connection is only noticed by the next write, a thread blocked
+**      reading from it waits forever. Options the system does not know
+**      keep its defaults. On Linux TCP_USER_TIMEOUT additionally fails
+**      a connection whose data stays unacknowledged for as long as the
+**      probes take, keepalive does not probe while data is in flight.
+*/
+void PRV_SetTCPKeepAlive(const PRIVATE_NETWORKKEY * network, DcmNativeSocketType sock)
+{
+    if (network == NULL || network->tcpKeepAliveIdle <= 0)
+        return;
+    const int idle = network->tcpKeepAliveIdle;
+    const int interval = network->tcpKeepAliveInterval;
+    const int probes = network->tcpKeepAliveProbes;
+    DCMNET_DEBUG("DUL: enabling TCP keepalive after " << idle << " s, every " << interval << " s, " << probes << " probes");
+#ifdef _WIN32
+    struct tcp_keepalive alive;
+    alive.onoff = 1;
+    alive.keepalivetime = OFstatic_cast(u_long, idle) * 1000;
+    alive.keepaliveinterval = OFstatic_cast(u_long, interval) * 1000;
+    DWORD returned = 0;
+    if (WSAIoctl(sock, SIO_KEEPALIVE_VALS, &alive, sizeof(alive), NULL, 0, &returned, NULL, NULL) != 0)
+        DCMNET_WARN("DUL: cannot enable TCP keepalive: " << OFStandard::getLastNetworkErrorCode().message());
+#else
+    int on = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (char *) &on, sizeof(on)) < 0)
+    {
+        DCMNET_WARN("DUL: cannot enable TCP keepalive: " << OFStandard::getLastNetworkErrorCode().message());
+        return;
+    }
+#if defined(TCP_KEEPIDLE)
+    (void) setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, (char *) &idle, sizeof(idle));
+#elif defined(TCP_KEEPALIVE)
+    (void) setsockopt(sock, IPPROTO_TCP, TCP_KEEPALIVE, (char *) &idle, sizeof(idle));
+#endif
+#ifdef TCP_KEEPINTVL
+    (void) setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, (char *) &interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPCNT
+    (void) setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, (char *) &probes, sizeof(probes));
+#endif
+#ifdef TCP_USER_TIMEOUT
+    unsigned int userTimeout = OFstatic_cast(unsigned int, idle + interval * probes) * 1000;
+    (void) setsockopt(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, (char *) &userTimeout, sizeof(userTimeout));
+#endif
+#endif
 }
 
 
@@ -2801,6 +3028,25 @@ clearPresentationContext(LST_HEAD ** l)
     LST_Destroy(l);
 }
 
+OFCondition DUL_setTCPSocketOptions(DUL_NETWORKKEY *callerNetworkKey, int bufferLength, int noDelay)
+{
+  if (callerNetworkKey == NULL) return DUL_NULLKEY;
+  PRIVATE_NETWORKKEY * key = (PRIVATE_NETWORKKEY *) callerNetworkKey;
+  key->tcpBufferLength = bufferLength < 0 ? -1 : bufferLength;
+  key->tcpNoDelay = noDelay < 0 ? -1 : (noDelay ? 1 : 0);
+  return EC_Normal;
+}
+
+OFCondition DUL_setTCPKeepAlive(DUL_NETWORKKEY *callerNetworkKey, int idle, int interval, int probes)
+{
+  if (callerNetworkKey == NULL) return DUL_NULLKEY;
+  PRIVATE_NETWORKKEY * key = (PRIVATE_NETWORKKEY *) callerNetworkKey;
+  key->tcpKeepAliveIdle = idle > 0 ? idle : 0;
+  key->tcpKeepAliveInterval = interval > 0 ? interval : 1;
+  key->tcpKeepAliveProbes = probes > 0 ? probes : 1;
+  return EC_Normal;
+}
+
 OFCondition DUL_setTransportLayer(DUL_NETWORKKEY *callerNetworkKey, DcmTransportLayer *newLayer, int takeoverOwnership)
 {
   if (callerNetworkKey && newLayer)
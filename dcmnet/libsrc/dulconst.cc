@@ -97,6 +97,9 @@ static OFCondition
 constructMaxLength(unsigned long maxPDU, DUL_MAXLENGTH * max,
                    unsigned long *rtnLen);
 static OFCondition
+constructAsyncOperations(DUL_ASSOCIATESERVICEPARAMETERS * params,
+                         PRV_ASYNCOPERATIONS * async, unsigned long *rtnLen);
+static OFCondition
 constructSCUSCPRoles(unsigned char type,
                      DUL_ASSOCIATESERVICEPARAMETERS * params,
                      LST_HEAD ** lst,
@@ -118,6 +121,9 @@ streamUserInfo(DUL_USERINFO * userInfo, unsigned char *b,
 static OFCondition
 streamMaxLength(DUL_MAXLENGTH * max, unsigned char *b,
                 unsigned long *length);
+static OFCondition
+streamAsyncOperations(PRV_ASYNCOPERATIONS * async, unsigned char *b,
+                      unsigned long *length);
 static OFCondition
     streamSCUSCPList(LST_HEAD ** lst, unsigned char *b, unsigned long *length);
 static OFCondition
@@ -850,7 +856,12 @@ constructUserInfo(unsigned char type, DUL_ASSOCIATESERVICEPARAMETERS * params,
     totalUserInfoLength += length;
     *rtnLen += length;
 
-    // user info sub-item 53H (async operations) is not yet implemented!
+    // construct user info sub-item 53H: asynchronous operations window
+    // (only if it differs from the default of one outstanding operation)
+    cond = constructAsyncOperations(params, &userInfo->asyncOperations, &length);
+    if (cond.bad()) return cond;
+    totalUserInfoLength += length;
+    *rtnLen += length;
 
     // construct user info sub-item 55H: implementation version name
     if (type == DUL_TYPEASSOCIATERQ) {
@@ -950,6 +961,42 @@ constructMaxLength(unsigned long maxPDU, DUL_MAXLENGTH * max,
 }
 
 
+/* constructAsyncOperations
+**
+** Purpose:
+**  Construct the Asynchronous Operations Window part of the PDU
+**
+** Parameter Dictionary:
+**  params    Service parameters describing the Association
+**  async     The window sub-item that is to be constructed
+**  rtnLength Length of the sub-item constructed, 0 if it is omitted.
+**
+** Return Values:
+**
+** Algorithm:
+**  The sub-item is omitted if neither value exceeds 1, which is
+**  the default when no window is negotiated.
+*/
+
+static OFCondition
+constructAsyncOperations(DUL_ASSOCIATESERVICEPARAMETERS * params,
+       PRV_ASYNCOPERATIONS * async, unsigned long *rtnLen)
+{
+    async->type = 0;
+    *rtnLen = 0;
+    if (params->maximumOperationsInvoked > 1 || params->maximumOperationsPerformed > 1)
+    {
+        async->type = DUL_TYPEASYNCOPERATIONS;
+        async->rsv1 = 0;
+        async->length = 4;
+        async->maximumOperationsInvoked = params->maximumOperationsInvoked;
+        async->maximumOperationsProvided = params->maximumOperationsPerformed;
+        *rtnLen = 8;
+    }
+    return EC_Normal;
+}
+
+
 /* constructSCUSCPRoles
 **
 ** Purpose:
@@ -1303,7 +1350,14 @@ streamUserInfo(DUL_USERINFO * userInfo, unsigned char *b,
     b += subLength;
     *length += subLength;
 
-    // user info sub-item 53H (async operations) is not yet implemented!
+    // stream user info sub-item 53H: asynchronous operations window
+    if (userInfo->asyncOperations.type == DUL_TYPEASYNCOPERATIONS) {
+        cond = streamAsyncOperations(&userInfo->asyncOperations, b, &subLength);
+        if (cond.bad())
+            return cond;
+        b += subLength;
+        *length += subLength;
+    }
 
 #ifdef OLD_USER_INFO_SUB_ITEM_ORDER
     /* prior DCMTK releases did not encode user information sub items
@@ -1394,6 +1448,38 @@ streamMaxLength(DUL_MAXLENGTH * max, unsigned char *b,
     return EC_Normal;
 }
 
+/* streamAsyncOperations
+**
+** Purpose:
+**  Convert the Asynchronous Operations Window structure into stream format
+**
+** Parameter Dictionary:
+**  async     Window structure to be converted to stream format
+**  b         The stream version (output)
+**  length    Length of the stream version
+**
+** Return Values:
+**
+** Algorithm:
+**  Description of the algorithm (optional) and any other notes.
+*/
+static OFCondition
+streamAsyncOperations(PRV_ASYNCOPERATIONS * async, unsigned char *b,
+    unsigned long *length)
+{
+
+    *b++ = async->type;
+    *b++ = async->rsv1;
+    COPY_SHORT_BIG(async->length, b);
+    b += 2;
+    COPY_SHORT_BIG(async->maximumOperationsInvoked, b);
+    b += 2;
+    COPY_SHORT_BIG(async->maximumOperationsProvided, b);
+
+    *length = 8;
+    return EC_Normal;
+}
+
 /* streamSCUSCPList
 **
 ** Purpose:
@@ -277,6 +277,13 @@ readPDUBody(PRIVATE_ASSOCIATIONKEY ** association,
             unsigned char *pduType, unsigned char *pduReserved,
             unsigned long *pduLength);
 static OFCondition
+readPDataPDUBody(PRIVATE_ASSOCIATIONKEY ** association,
+                 unsigned char *buffer, unsigned long maxLength,
+                 unsigned char *pduType, unsigned char *pduReserved,
+                 unsigned long *pduLength, unsigned long *deferredLength);
+static OFCondition
+skipPendingPDVData(PRIVATE_ASSOCIATIONKEY ** association);
+static OFCondition
 readPDUHeadTCP(PRIVATE_ASSOCIATIONKEY ** association,
                unsigned char *buffer, unsigned long maxLength,
                DUL_BLOCKOPTIONS block, int timeout,
@@ -295,9 +302,9 @@ defragmentTCP(DcmTransportConnection *connection, DUL_BLOCKOPTIONS block, time_t
 static OFString dump_pdu(const char *type, void *buffer, unsigned long length);
 
 #ifdef _WIN32
-static void setTCPBufferLength(SOCKET sock);
+static void setTCPBufferLength(SOCKET sock, int bufferLength);
 #else
-static void setTCPBufferLength(int sock);
+static void setTCPBufferLength(int sock, int bufferLength);
 #endif
 
 OFCondition
@@ -1023,6 +1030,15 @@ AE_3_AssociateConfirmationAccept(PRIVATE_NETWORKKEY ** /*network*/,
 
         destroyPresentationContextList(&assoc.presentationContextList);
         destroyUserInformationLists(&assoc.userInfo);
+        /* asynchronous operations window, one operation each if the acceptor omitted it */
+        if (assoc.userInfo.asyncOperations.type == DUL_TYPEASYNCOPERATIONS) {
+            service->maximumOperationsInvoked = assoc.userInfo.asyncOperations.maximumOperationsInvoked;
+            service->maximumOperationsPerformed = assoc.userInfo.asyncOperations.maximumOperationsProvided;
+        } else {
+            service->maximumOperationsInvoked = 1;
+            service->maximumOperationsPerformed = 1;
+        }
+
         service->peerMaxPDU = assoc.userInfo.maxLength.maxLength;
         (*association)->maxPDV = assoc.userInfo.maxLength.maxLength;
         (*association)->maxPDVAcceptor =
@@ -1228,6 +1244,15 @@ AE_6_ExamineAssociateRequest(PRIVATE_NETWORKKEY ** /*network*/,
             *(service->reqUserIdentNeg) = *(OFstatic_cast(UserIdentityNegotiationSubItemRQ*,assoc.userInfo.usrIdent));
         }
 
+        /* asynchronous operations window, one operation each if the requestor omitted it */
+        if (assoc.userInfo.asyncOperations.type == DUL_TYPEASYNCOPERATIONS) {
+            service->maximumOperationsInvoked = assoc.userInfo.asyncOperations.maximumOperationsInvoked;
+            service->maximumOperationsPerformed = assoc.userInfo.asyncOperations.maximumOperationsProvided;
+        } else {
+            service->maximumOperationsInvoked = 1;
+            service->maximumOperationsPerformed = 1;
+        }
+
         service->peerMaxPDU = assoc.userInfo.maxLength.maxLength;
         (*association)->maxPDV = assoc.userInfo.maxLength.maxLength;
         (*association)->maxPDVRequestor =
@@ -1406,18 +1431,20 @@ DT_2_IndicatePData(PRIVATE_NETWORKKEY ** /*network*/,
 
     /* read PDU body information from the incoming socket stream. In case the incoming */
     /* PDU's header information has not yet been read, also read this information. */
-    OFCondition cond = readPDUBody(association, DUL_BLOCK, 0,
+    /* The value of a single PDV in a large PDU may be left on the socket (deferred). */
+    unsigned long deferredLength = 0;
+    OFCondition cond = readPDataPDUBody(association,
                        (*association)->fragmentBuffer,
                        (*association)->fragmentBufferLength,
-                       &pduType, &pduReserved, &pduLength);
+                       &pduType, &pduReserved, &pduLength, &deferredLength);
 
     /* return error if there was one */
     if (cond.bad())
         return cond;
 
-    /* count the amount of PDVs in the current PDU */
-    length = pduLength;                     //set length to the PDU's length
-    pdvCount = 0;                           //set counter variable to 0
+    /* count the amount of PDVs in the current PDU, a deferred PDV is the only one */
+    length = (deferredLength > 0) ? 0 : pduLength;  //set length to the PDU's length
+    pdvCount = (deferredLength > 0) ? 1 : 0;        //set counter variable to 0
     p = (*association)->fragmentBuffer;     //set p to the buffer which contains the PDU's PDVs
     while (length >= 4) {                   //as long as length is at least 4 (= a length field can be read)
         EXTRACT_LONG_BIG(p, pdvLength);     //determine the length of the current PDV (the PDV p points to)
@@ -1507,8 +1534,9 @@ DT_2_IndicatePData(PRIVATE_NETWORKKEY ** /*network*/,
 
     /* now assign the data fragment of the next (unprocessed) PDV to the association's */
     /* currentPDV.data variable. The fragment starts 6 bytes to the right of the address */
-    /* p currently points to. */
-    (*association)->currentPDV.data = p + 6;
+    /* p currently points to. A deferred fragment is still on the socket (DUL_ReadPDVData). */
+    (*association)->currentPDV.data = (deferredLength > 0) ? NULL : p + 6;
+    (*association)->pendingPDVData = deferredLength;
 
     /* return ok */
     return DUL_PDATAPDUARRIVED;
@@ -2258,7 +2286,11 @@ requestAssociationTCP(PRIVATE_NETWORKKEY ** network,
     else
     {
         // must be a host name or an IPv6 address
-        OFStandard::getAddressByHostname(node, server);
+        DUL_HostResolver resolver = dcmHostResolver.get();
+        if (resolver)
+            resolver(node, server);
+        else
+            OFStandard::getAddressByHostname(node, server);
         if (server.getFamily() == 0)
         {
           char buf2[4095]; // node could be a long string
@@ -2476,13 +2508,16 @@ requestAssociationTCP(PRIVATE_NETWORKKEY ** network,
           msg += OFStandard::getLastNetworkErrorCode().message();
           return makeDcmnetCondition(DULC_TCPINITERROR, OF_error, msg.c_str());
         }
-        setTCPBufferLength(s);
+        const PRIVATE_NETWORKKEY *networkKey = (network && *network) ? *network : NULL;
+        setTCPBufferLength(s, networkKey ? networkKey->tcpBufferLength : -1);
+        PRV_SetTCPKeepAlive(networkKey, s);
 
         /*
          * Disable the so-called Nagle algorithm (if requested).
          * This might provide a better network performance on some systems/environments.
          * By default, the algorithm is not disabled unless DISABLE_NAGLE_ALGORITHM is defined.
-         * The default behavior can be changed by setting the environment variable TCP_NODELAY.
+         * The default behavior can be changed by setting the environment variable TCP_NODELAY
+         * or per network with DUL_setTCPSocketOptions().
          */
 
 #ifdef DONT_DISABLE_NAGLE_ALGORITHM
@@ -2494,16 +2529,26 @@ requestAssociationTCP(PRIVATE_NETWORKKEY ** network,
 #else
         int tcpNoDelay = 0; // don't disable
 #endif
-        char* tcpNoDelayString = NULL;
-        DCMNET_TRACE("checking whether environment variable TCP_NODELAY is set");
-        if ((tcpNoDelayString = getenv("TCP_NODELAY")) != NULL)
+        const char* tcpNoDelayString = NULL;
+        if (networkKey && networkKey->tcpNoDelay >= 0)
         {
-          if (sscanf(tcpNoDelayString, "%d", &tcpNoDelay) != 1)
+          // the network setting takes precedence over the environment variable
+          tcpNoDelay = networkKey->tcpNoDelay;
+          tcpNoDelayString = tcpNoDelay ? "1" : "0";
+          DCMNET_TRACE("  TCP_NODELAY set for this network, using the value " << tcpNoDelay);
+        }
+        else
+        {
+          DCMNET_TRACE("checking whether environment variable TCP_NODELAY is set");
+          if ((tcpNoDelayString = getenv("TCP_NODELAY")) != NULL)
           {
-            DCMNET_WARN("DULFSM: cannot parse environment variable TCP_NODELAY=" << tcpNoDelayString);
-          }
-        } else
-          DCMNET_TRACE("  environment variable TCP_NODELAY not set, using the default value (" << tcpNoDelay << ")");
+            if (sscanf(tcpNoDelayString, "%d", &tcpNoDelay) != 1)
+            {
+              DCMNET_WARN("DULFSM: cannot parse environment variable TCP_NODELAY=" << tcpNoDelayString);
+            }
+          } else
+            DCMNET_TRACE("  environment variable TCP_NODELAY not set, using the default value (" << tcpNoDelay << ")");
+        }
         if (tcpNoDelay) {
 #ifdef DISABLE_NAGLE_ALGORITHM
           DCMNET_DEBUG("DULFSM: disabling Nagle algorithm as defined at compilation time (DISABLE_NAGLE_ALGORITHM)");
@@ -3044,7 +3089,8 @@ sendPDataTCP(PRIVATE_ASSOCIATIONKEY ** association,
             cond = writeDataPDU(association, &dataPDU);
 
             /* adjust the pointer to the data, so that he points to data which still has to be sent */
-            p += pdvLength;
+            /* (PDVs without data are sent from the association's PDV file, see writeDataPDU) */
+            if (p != NULL) p += pdvLength;
             /* adjust the length of the fragment which still has to be sent */
             length -= pdvLength;
         }
@@ -3083,8 +3129,6 @@ writeDataPDU(PRIVATE_ASSOCIATIONKEY ** association,
         head[24];
     unsigned long
         length;
-    int
-        nbytes;
 
     /* construct a stream variable that will contain PDU head information */
     /* (in detail, this variable will contain PDU type, PDU reserved field, */
@@ -3093,30 +3137,30 @@ writeDataPDU(PRIVATE_ASSOCIATIONKEY ** association,
     OFCondition cond = streamDataPDUHead(pdu, head, sizeof(head), &length);
     if (cond.bad()) return cond;
 
-    /* send the PDU head information (see above) */
-    do
+    /* send the PDU head information (see above) and the PDU's PDV data in one */
+    /* gathered write (note that our representation of a PDU can only contain one PDV.) */
+    /* PDVs without data are sent from the PDV file of the association which is */
+    /* passed to the transport connection without copying it into memory first. */
+    DcmTransportConnection *connection = (*association)->connection;
+    const size_t dataLength = size_t(pdu->presentationDataValue.length - 2);
+    ssize_t nbytes = -1;
+    if (connection == NULL)
+        nbytes = 0;
+    else if (pdu->presentationDataValue.data == NULL && dataLength > 0)
     {
-      nbytes = (*association)->connection ? (*association)->connection->write((char*)head, size_t(length)) : 0;
-    } while (nbytes == -1 && OFStandard::getLastNetworkErrorCode().value() == DCMNET_EINTR);
-
-    /* if not all head information was sent, return an error */
-    if ((unsigned long) nbytes != length)
-    {
-        OFString msg = "TCP I/O Error (";
-        msg += OFStandard::getLastNetworkErrorCode().message();
-        msg += ") occurred in routine: writeDataPDU";
-        return makeDcmnetCondition(DULC_TCPIOERROR, OF_error, msg.c_str());
+        if ((*association)->pdvFile == NULL)
+            return makeDcmnetCondition(DULC_ILLEGALPDU, OF_error, "DUL Cannot send P-DATA PDU: PDV without data and no PDV file");
+        nbytes = connection->writeFile(head, size_t(length), *(*association)->pdvFile, (*association)->pdvFileOffset, dataLength);
+        (*association)->pdvFileOffset += OFstatic_cast(offile_off_t, dataLength);
     }
-
-    /* send the PDU's PDV data (note that our representation of a PDU can only contain one PDV.) */
-    do
+    else
     {
-      nbytes = (*association)->connection ? (*association)->connection->write((char*)pdu->presentationDataValue.data,
-        size_t(pdu->presentationDataValue.length - 2)) : 0;
-    } while (nbytes == -1 && OFStandard::getLastNetworkErrorCode().value() == DCMNET_EINTR);
+        DcmTransportBlock blocks[2] = { { head, size_t(length) }, { pdu->presentationDataValue.data, dataLength } };
+        nbytes = connection->writeBlocks(blocks, 2);
+    }
 
-        /* if not all head information was sent, return an error */
-    if ((unsigned long) nbytes != pdu->presentationDataValue.length - 2)
+    /* if not all information was sent, return an error */
+    if (nbytes < 0 || (unsigned long) nbytes != length + dataLength)
     {
         OFString msg = "TCP I/O Error (";
         msg += OFStandard::getLastNetworkErrorCode().message();
@@ -3361,9 +3405,13 @@ readPDUHead(PRIVATE_ASSOCIATIONKEY ** association,
     /* initialize return value */
     OFCondition cond = EC_Normal;
 
+    /* the next PDU starts behind the value of a deferred PDV, skip what was not read */
+    if (((*association)->inputPDU == NO_PDU) && ((*association)->pendingPDVData > 0))
+        cond = skipPendingPDVData(association);
+
     /* if the association does not already contain PDU header */
     /* information, we need to try to receive a PDU on the network */
-    if ((*association)->inputPDU == NO_PDU)
+    if (cond.good() && ((*association)->inputPDU == NO_PDU))
     {
         /* try to receive data */
         cond = readPDUHeadTCP(association, buffer, maxLength, block, timeout,
@@ -3443,6 +3491,157 @@ readPDUBody(PRIVATE_ASSOCIATIONKEY ** association,
     return cond;
 }
 
+
+/* readPDataPDUBody
+**
+** Purpose:
+**      Read the body of an incoming P-DATA PDU. If the association defers
+**      PDV values (see DUL_DeferPDVData), the PDU is large enough and it
+**      contains a single PDV, only the PDV item header is read into the
+**      buffer and the value of the PDV is left on the socket.
+**
+** Parameter Dictionary:
+**      association     Handle to the Association
+**      buffer          Buffer to hold the PDU
+**      maxLength       Maximum number of bytes to read
+**      pduType         PDU Type of the incoming PDU (returned to caller)
+**      pduReserved     Reserved field in the PDU
+**      pduLength       Actual number of bytes read
+**      deferredLength  Length of the PDV value left on the socket, 0 if
+**                      the PDU was read completely (returned to caller)
+**
+** Return Values:
+**
+**
+** Notes:
+**
+** Algorithm:
+**      Description of the algorithm (optional) and any other notes.
+*/
+
+static OFCondition
+readPDataPDUBody(PRIVATE_ASSOCIATIONKEY ** association,
+                 unsigned char *buffer, unsigned long maxLength,
+                 unsigned char *pduType, unsigned char *pduReserved,
+                 unsigned long *pduLength, unsigned long *deferredLength)
+{
+    *deferredLength = 0;
+
+    /* without a known PDU head of a large enough PDU, read the PDU as usual */
+    if (((*association)->deferPDVLength == 0) || ((*association)->inputPDU == NO_PDU) ||
+        ((*association)->nextPDULength < (*association)->deferPDVLength))
+    {
+        return readPDUBody(association, DUL_BLOCK, 0, buffer, maxLength,
+                           pduType, pduReserved, pduLength);
+    }
+
+    *pduType = (*association)->nextPDUType;
+    *pduReserved = (*association)->nextPDUReserved;
+    *pduLength = (*association)->nextPDULength;
+
+    OFCondition cond = EC_Normal;
+    unsigned long length;
+    if (*pduLength > maxLength)
+    {
+        cond = DUL_ILLEGALPDULENGTH;
+    } else {
+        /* read the PDV item header (length, presentation context ID and message control header) */
+        cond = defragmentTCP((*association)->connection, DUL_BLOCK, (*association)->timerStart, 0,
+                             buffer, 6, &length);
+        if (cond.good())
+        {
+            unsigned long pdvLength;
+            EXTRACT_LONG_BIG(buffer, pdvLength);
+            if (pdvLength + 4 == *pduLength)
+            {
+                /* a single PDV, its value is read by the caller */
+                *deferredLength = pdvLength - 2;
+            } else {
+                /* several PDVs, read the rest of the PDU */
+                cond = defragmentTCP((*association)->connection, DUL_BLOCK, (*association)->timerStart, 0,
+                                     buffer + 6, *pduLength - 6, &length);
+            }
+        }
+    }
+
+    /* the association can be used to store new PDU information, see readPDUBody() */
+    (*association)->inputPDU = NO_PDU;
+    return cond;
+}
+
+
+/* skipPendingPDVData
+**
+** Purpose:
+**      Read and discard the rest of the value of a deferred PDV.
+**
+** Parameter Dictionary:
+**      association     Handle to the Association
+**
+** Return Values:
+**
+**
+** Notes:
+**
+** Algorithm:
+**      Description of the algorithm (optional) and any other notes.
+*/
+
+static OFCondition
+skipPendingPDVData(PRIVATE_ASSOCIATIONKEY ** association)
+{
+    DCMNET_DEBUG("DUL skipping " << (*association)->pendingPDVData << " bytes of unread PDV data");
+
+    OFCondition cond = EC_Normal;
+    unsigned long length;
+    while (cond.good() && ((*association)->pendingPDVData > 0))
+    {
+        /* the deferred value is never larger than the fragment buffer, but be safe */
+        cond = PRV_ReadPDVData(association, (*association)->fragmentBuffer,
+                               (*association)->fragmentBufferLength, &length);
+    }
+    return cond;
+}
+
+
+/* PRV_ReadPDVData
+**
+** Purpose:
+**      Read (a part of) the value of a deferred PDV from the socket.
+**
+** Parameter Dictionary:
+**      association     Handle to the Association
+**      buffer          Buffer to hold the data
+**      length          Maximum number of bytes to read
+**      bytesRead       Number of bytes actually read (returned to caller)
+**
+** Return Values:
+**
+**
+** Notes:
+**
+** Algorithm:
+**      Description of the algorithm (optional) and any other notes.
+*/
+
+OFCondition
+PRV_ReadPDVData(PRIVATE_ASSOCIATIONKEY ** association, void *buffer,
+                unsigned long length, unsigned long *bytesRead)
+{
+    if (length > (*association)->pendingPDVData)
+        length = (*association)->pendingPDVData;
+
+    OFCondition cond = defragmentTCP((*association)->connection, DUL_BLOCK,
+                                     (*association)->timerStart, 0, buffer, length, bytesRead);
+
+    /* after a network error nothing more is read from this association */
+    if (cond.good())
+        (*association)->pendingPDVData -= *bytesRead;
+    else
+        (*association)->pendingPDVData = 0;
+    return cond;
+}
+
 /* readPDUHeadTCP
 **
 ** Purpose:
@@ -3782,10 +3981,12 @@ dump_pdu(const char *type, void *buffer, unsigned long length)
 **      This routine checks for the existence of an environment
 **      variable (TCP_BUFFER_LENGTH).  If that variable is defined (and
 **      is a legal integer), this routine sets the socket SNDBUF and RCVBUF
-**      variables to the value defined in TCP_BUFFER_LENGTH.
+**      variables to the value defined in TCP_BUFFER_LENGTH. A buffer length
+**      set for the network takes precedence over the environment variable.
 **
 ** Parameter Dictionary:
 **      sock            Socket descriptor (identifier)
+**      bufferLength    Buffer length set for the network, -1 if none
 **
 ** Return Values:
 **      None
@@ -3797,36 +3998,43 @@ dump_pdu(const char *type, void *buffer, unsigned long length)
 */
 
 #ifdef _WIN32
-static void setTCPBufferLength(SOCKET sock)
+static void setTCPBufferLength(SOCKET sock, int bufferLength)
 #else
-static void setTCPBufferLength(int sock)
+static void setTCPBufferLength(int sock, int bufferLength)
 #endif
 {
     char *TCPBufferLength;
     int bufLen;
 
     /*
-     * check whether environment variable TCP_BUFFER_LENGTH is set.
-     * If not, the the operating system is responsible for selecting
-     * appropriate values for the TCP send and receive buffer lengths.
+     * a buffer length set for the network takes precedence. Otherwise check
+     * whether environment variable TCP_BUFFER_LENGTH is set. If not, the
+     * operating system is responsible for selecting appropriate values for
+     * the TCP send and receive buffer lengths.
      */
-    DCMNET_TRACE("checking whether environment variable TCP_BUFFER_LENGTH is set");
-    if ((TCPBufferLength = getenv("TCP_BUFFER_LENGTH")) != NULL) {
-        if (sscanf(TCPBufferLength, "%d", &bufLen) == 1) {
+    if (bufferLength >= 0) {
+        bufLen = bufferLength;
+    } else {
+        DCMNET_TRACE("checking whether environment variable TCP_BUFFER_LENGTH is set");
+        if ((TCPBufferLength = getenv("TCP_BUFFER_LENGTH")) == NULL) {
+            DCMNET_TRACE("  environment variable TCP_BUFFER_LENGTH not set, using the system defaults");
+            return;
+        }
+        if (sscanf(TCPBufferLength, "%d", &bufLen) != 1) {
+            DCMNET_WARN("DULFSM: cannot parse environment variable TCP_BUFFER_LENGTH=" << TCPBufferLength);
+            return;
+        }
+    }
 #if defined(SO_SNDBUF) && defined(SO_RCVBUF)
-            if (bufLen == 0)
-                bufLen = 65536; // a socket buffer size of 64K gives good throughput for image transmission
-            DCMNET_DEBUG("DULFSM: setting TCP buffer length to " << bufLen << " bytes");
-            (void) setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *) &bufLen, sizeof(bufLen));
-            (void) setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *) &bufLen, sizeof(bufLen));
+    if (bufLen == 0)
+        bufLen = 65536; // a socket buffer size of 64K gives good throughput for image transmission
+    DCMNET_DEBUG("DULFSM: setting TCP buffer length to " << bufLen << " bytes");
+    (void) setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *) &bufLen, sizeof(bufLen));
+    (void) setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *) &bufLen, sizeof(bufLen));
 #else
-            DCMNET_WARN("DULFSM: setTCPBufferLength: cannot set TCP buffer length socket option: "
-                << "code disabled because SO_SNDBUF and SO_RCVBUF constants are unknown");
+    DCMNET_WARN("DULFSM: setTCPBufferLength: cannot set TCP buffer length socket option: "
+        << "code disabled because SO_SNDBUF and SO_RCVBUF constants are unknown");
 #endif // SO_SNDBUF and SO_RCVBUF
-        } else
-            DCMNET_WARN("DULFSM: cannot parse environment variable TCP_BUFFER_LENGTH=" << TCPBufferLength);
-    } else
-        DCMNET_TRACE("  environment variable TCP_BUFFER_LENGTH not set, using the system defaults");
 }
 
 /* translatePresentationContextList
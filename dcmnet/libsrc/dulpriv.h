@@ -75,6 +75,7 @@
 #define	PRV_LISTENBACKLOG	50
 
 OFCondition DUL_InitializeFSM(void);
+void PRV_SetTCPKeepAlive(const PRIVATE_NETWORKKEY * network, DcmNativeSocketType sock);
 OFCondition
 PRV_StateMachine(PRIVATE_NETWORKKEY ** network,
 		 PRIVATE_ASSOCIATIONKEY ** association, int event, int state,
@@ -110,5 +111,8 @@ parseAssociate(unsigned char *buf, unsigned long len,
 OFCondition
 PRV_NextPDUType(PRIVATE_ASSOCIATIONKEY ** association,
 		DUL_BLOCKOPTIONS block, int timeout, unsigned char *type);
+OFCondition
+PRV_ReadPDVData(PRIVATE_ASSOCIATIONKEY ** association, void *buffer,
+		unsigned long length, unsigned long *bytesRead);
 
 #endif
@@ -97,6 +97,11 @@ typedef struct {
     int protocolState;
     int timeout;
     unsigned long options;
+    int tcpBufferLength;      /* SO_SNDBUF/SO_RCVBUF in bytes, -1 = TCP_BUFFER_LENGTH or system default */
+    int tcpNoDelay;           /* TCP_NODELAY, -1 = environment variable or compile time default */
+    int tcpKeepAliveIdle;     /* SO_KEEPALIVE, seconds idle before the first probe, 0 = off */
+    int tcpKeepAliveInterval; /* seconds between probes */
+    int tcpKeepAliveProbes;   /* unanswered probes before the connection is dropped */
     union {
   struct {
       int port;
@@ -146,6 +151,10 @@ typedef struct {
     unsigned char *pdvPointer;
     unsigned long fragmentBufferLength;
     unsigned char *fragmentBuffer;
+    unsigned long deferPDVLength;   /* P-DATA PDUs of at least this length leave a single PDV value on the socket, 0 = never */
+    unsigned long pendingPDVData;   /* bytes of the current PDV value that are still to be read from the socket */
+    OFFile *pdvFile;                /* file from which PDVs without data are sent, see DUL_setPDVFile() */
+    offile_off_t pdvFileOffset;     /* position in pdvFile of the next data to be sent */
     DUL_ModeCallback *modeCallback;
 }   PRIVATE_ASSOCIATIONKEY;
 
@@ -238,7 +247,7 @@ typedef struct user_info {
     unsigned char rsv1;
     unsigned short length;
     DUL_MAXLENGTH maxLength;                             // 51H: maximum length
-    PRV_ASYNCOPERATIONS asyncOperations;                 // 53H: async operations (not yet implemented!)
+    PRV_ASYNCOPERATIONS asyncOperations;                 // 53H: async operations window
     DUL_SUBITEM implementationClassUID;                  // 52H: implementation class UID
     DUL_SUBITEM implementationVersionName;               // 55H: implementation version name
     LST_HEAD *SCUSCPRoleList;                            // 54H: SCP/SCU role selection
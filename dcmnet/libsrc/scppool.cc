@@ -37,9 +37,10 @@ DcmBaseSCPPool::DcmBaseSCPPool()
     m_workersIdle(),
     m_cfg(),
     m_maxWorkers(5),
+    m_waiting(),
+    m_maxWaiting(0),
     m_runMode( LISTEN )
     // not implemented yet: m_workersBusyTimeout(60),
-    // not implemented yet: m_waiting(),
 {
 }
 
@@ -113,6 +114,18 @@ OFCondition DcmBaseSCPPool::listen()
     }
   }
 
+  joinWorkers();
+
+  /* In the end, clean up the rest of the memory and drop network */
+  ASC_dropNetwork(&network);
+
+  return EC_Normal;
+}
+
+// ----------------------------------------------------------------------------
+
+void DcmBaseSCPPool::joinWorkers()
+{
   m_criticalSection.lock();
   m_runMode = SHUTDOWN;
 
@@ -131,12 +144,22 @@ OFCondition DcmBaseSCPPool::listen()
   }
 
   m_workersBusy.clear();
-  m_criticalSection.unlock();
 
-  /* In the end, clean up the rest of the memory and drop network */
-  ASC_dropNetwork(&network);
+  // workers do not take associations from the queue while shutting down
+  OFList<T_ASC_Association*> waiting(m_waiting);
+  m_waiting.clear();
+  m_criticalSection.unlock();
 
-  return EC_Normal;
+  for
+  (
+    OFListIterator( T_ASC_Association* ) it = waiting.begin();
+    it != waiting.end();
+    ++it
+  )
+  {
+    rejectAssociation(*it, ASC_REASON_SP_PRES_TEMPORARYCONGESTION);
+    dropAndDestroyAssociation(*it);
+  }
 }
 
 void DcmBaseSCPPool::stopAfterCurrentAssociations()
@@ -179,6 +202,20 @@ void DcmBaseSCPPool::setMaxThreads(const Uint16 maxWorkers)
 
 // ----------------------------------------------------------------------------
 
+void DcmBaseSCPPool::setMaxQueuedAssociations(const Uint16 maxQueued)
+{
+  m_maxWaiting = maxQueued;
+}
+
+// ----------------------------------------------------------------------------
+
+Uint16 DcmBaseSCPPool::getMaxQueuedAssociations()
+{
+  return m_maxWaiting;
+}
+
+// ----------------------------------------------------------------------------
+
 OFCondition DcmBaseSCPPool::runAssociation(T_ASC_Association *assoc,
                                            const DcmSharedSCPConfig& sharedConfig)
 {
@@ -192,8 +229,17 @@ OFCondition DcmBaseSCPPool::runAssociation(T_ASC_Association *assoc,
   {
     if (m_workersBusy.size() >= m_maxWorkers)
     {
-      /* No idle workers and maximum of busy workers reached? Return busy */
-      result = NET_EC_SCPBusy;
+      if (m_waiting.size() < m_maxWaiting)
+      {
+        /* Let the association wait for the next worker becoming available */
+        DCMNET_DEBUG("DcmBaseSCPPool: All workers busy, queueing association");
+        m_waiting.push_back(assoc);
+      }
+      else
+      {
+        /* No idle workers and maximum of busy workers reached? Return busy */
+        result = NET_EC_SCPBusy;
+      }
     }
     else /* Else we can produce another worker */
     {
@@ -222,12 +268,12 @@ OFCondition DcmBaseSCPPool::runAssociation(T_ASC_Association *assoc,
   m_criticalSection.unlock();
 
   /* Hand association to worker */
-  if (result.good())
+  if (result.good() && chosen)
   {
     result = chosen->setAssociation(assoc);
   }
   /* Start the thread */
-  if (result.good())
+  if (result.good() && chosen)
   {
      if (chosen->start() != 0)
      {
@@ -285,6 +331,31 @@ void DcmBaseSCPPool::notifyThreadExit(DcmBaseSCPPool::DcmBaseSCPWorker* thread,
   m_criticalSection.unlock();
 }
 
+// ----------------------------------------------------------------------------
+
+OFBool DcmBaseSCPPool::nextQueuedAssociation(DcmBaseSCPPool::DcmBaseSCPWorker* thread,
+                                             T_ASC_Association*& assoc)
+{
+  OFBool result = OFFalse;
+  m_criticalSection.lock();
+  if( m_runMode != SHUTDOWN )
+  {
+    if (!m_waiting.empty())
+    {
+      assoc = m_waiting.front();
+      m_waiting.pop_front();
+      result = OFTrue;
+    }
+    else
+    {
+      /* notifyThreadExit() follows, do not count the thread as busy meanwhile */
+      m_workersBusy.remove(thread);
+    }
+  }
+  m_criticalSection.unlock();
+  return result;
+}
+
 
 /* *********************************************************************** */
 /*                        DcmBaseSCPPool::BaseSCPWorker class              */
@@ -332,8 +403,13 @@ void DcmBaseSCPPool::DcmBaseSCPWorker::run()
   {
     T_ASC_Association *param = m_assoc;
     m_assoc = NULL;
-    result = workerListen(param);
-    DCMNET_DEBUG("DcmBaseSCPPool: Worker thread #" << threadID() << " returns with code: " << result.text() );
+    do
+    {
+      result = workerListen(param);
+      DCMNET_DEBUG("DcmBaseSCPPool: Worker thread #" << threadID() << " returns with code: " << result.text() );
+    }
+    /* Serve associations that were queued while all workers were busy */
+    while (m_pool.nextQueuedAssociation(this, param));
   }
   m_pool.notifyThreadExit(this, result);
   thread_exit();
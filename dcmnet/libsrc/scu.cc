@@ -42,19 +42,28 @@ DcmSCU::DcmSCU() :
   m_assocConfigFile(),
   m_openDIMSERequest(NULL),
   m_maxReceivePDULength(ASC_DEFAULTMAXPDU),
+  m_maxOperationsInvoked(1),
+  m_tcpBufferLength(-1),
+  m_tcpNoDelay(-1),
+  m_tcpKeepAliveIdle(0),
+  m_tcpKeepAliveInterval(0),
+  m_tcpKeepAliveProbes(0),
   m_blockMode(DIMSE_BLOCKING),
   m_ourAETitle("ANY-SCU"),
   m_peer(),
   m_peerAETitle("ANY-SCP"),
   m_peerPort(104),
   m_dimseTimeout(0),
+  m_priority(DIMSE_PRIORITY_MEDIUM),
+  m_messagesSent(0),
   m_acseTimeout(30),
   m_storageDir(),
   m_storageMode(DCMSCU_STORAGE_DISK),
   m_verbosePCMode(OFFalse),
   m_datasetConversionMode(OFFalse),
   m_progressNotificationMode(OFTrue),
-  m_notifier(NULL)
+  m_notifier(NULL),
+  m_transportLayer(NULL)
 {
   OFStandard::initializeNetwork();
 }
@@ -119,6 +128,14 @@ OFCondition DcmSCU::initNetwork()
     DCMNET_ERROR(tempStr);
     return cond;
   }
+  cond = ASC_setTCPSocketOptions(m_net, m_tcpBufferLength, m_tcpNoDelay);
+  if (cond.good())
+    cond = ASC_setTCPKeepAlive(m_net, m_tcpKeepAliveIdle, m_tcpKeepAliveInterval, m_tcpKeepAliveProbes);
+  if (cond.bad())
+  {
+    DCMNET_ERROR(DimseCondition::dump(tempStr, cond));
+    return cond;
+  }
 
   /* initialize association parameters, i.e. create an instance of T_ASC_Parameters*. */
   cond = ASC_createAssociationParameters(&m_params, m_maxReceivePDULength);
@@ -128,6 +145,17 @@ OFCondition DcmSCU::initNetwork()
     return cond;
   }
 
+  /* use the TLS transport layer set before (if any) */
+  if (m_transportLayer != NULL)
+  {
+    cond = useSecureConnection(m_transportLayer);
+    if (cond.bad())
+    {
+      DCMNET_ERROR(DimseCondition::dump(tempStr, cond));
+      return cond;
+    }
+  }
+
   /* sets this application's title and the called application's title in the params */
   /* structure. The default values are "ANY-SCU" and "ANY-SCP". */
   ASC_setAPTitles(m_params, m_ourAETitle.c_str(), m_peerAETitle.c_str(), NULL);
@@ -260,6 +288,10 @@ OFCondition DcmSCU::negotiateAssociation()
   if (isConnected())
     return NET_EC_AlreadyConnected;
 
+  /* propose an asynchronous operations window, the SCU does not perform operations */
+  /* itself, so only the number of invoked operations exceeds the default */
+  ASC_setAsyncOperationsWindow(m_params, m_maxOperationsInvoked > 1 ? m_maxOperationsInvoked : 0, m_maxOperationsInvoked > 1 ? 1 : 0);
+
   /* dump presentation contexts if required */
   OFString tempStr;
   if (m_verbosePCMode)
@@ -330,6 +362,10 @@ OFCondition DcmSCU::addPresentationContext(const OFString &abstractSyntax,
 
 OFCondition DcmSCU::useSecureConnection(DcmTransportLayer *tlayer)
 {
+  m_transportLayer = tlayer;
+  /* the network is not initialized yet, initNetwork() sets up the layer */
+  if ((m_net == NULL) || (m_params == NULL))
+    return EC_Normal;
   OFCondition cond = ASC_setTransportLayer(m_net, tlayer, OFFalse /* do not take over ownership */);
   if (cond.good())
     cond = ASC_setTransportLayerType(m_params, OFTrue /* use TLS */);
@@ -674,6 +710,30 @@ OFCondition DcmSCU::sendSTORERequest(const T_ASC_PresentationContextID presID,
                                      Uint16 &rspStatusCode,
                                      const OFString &moveOriginatorAETitle,
                                      const Uint16 moveOriginatorMsgID)
+{
+  Uint16 messageID = 0;
+  OFCondition cond = sendSTORERequestAsync(presID, dicomFile, dataset, messageID,
+                                           moveOriginatorAETitle, moveOriginatorMsgID);
+  if (cond.bad())
+    return cond;
+
+  Uint16 rspMessageID = 0;
+  cond = receiveSTOREResponse(rspMessageID, rspStatusCode);
+  if (cond.good() && (rspMessageID != messageID))
+  {
+    DCMNET_WARN("Received C-STORE Response for MsgID " << rspMessageID
+      << " (expected: " << messageID << ")");
+  }
+  return cond;
+}
+
+
+OFCondition DcmSCU::sendSTORERequestAsync(const T_ASC_PresentationContextID presID,
+                                          const OFFilename &dicomFile,
+                                          DcmDataset *dataset,
+                                          Uint16 &messageID,
+                                          const OFString &moveOriginatorAETitle,
+                                          const Uint16 moveOriginatorMsgID)
 {
   // Do some basic validity checks
   if (!isConnected())
@@ -682,7 +742,6 @@ OFCondition DcmSCU::sendSTORERequest(const T_ASC_PresentationContextID presID,
   OFCondition cond;
   OFString tempStr;
   T_ASC_PresentationContextID pcid = presID;
-  DcmDataset* statusDetail = NULL;
   T_DIMSE_Message msg;
   // Make sure everything is zeroed (especially options)
   bzero((char*)&msg, sizeof(msg));
@@ -692,6 +751,7 @@ OFCondition DcmSCU::sendSTORERequest(const T_ASC_PresentationContextID presID,
   msg.CommandField = DIMSE_C_STORE_RQ;
   /* Set message ID */
   req->MessageID = nextMessageID();
+  messageID = req->MessageID;
   /* Load file if necessary */
   DcmFileFormat *fileformat = NULL;
   if (!dicomFile.isEmpty())
@@ -733,7 +793,7 @@ OFCondition DcmSCU::sendSTORERequest(const T_ASC_PresentationContextID presID,
   OFStandard::strlcpy(req->AffectedSOPClassUID, sopClassUID.c_str(), sizeof(req->AffectedSOPClassUID));
   OFStandard::strlcpy(req->AffectedSOPInstanceUID, sopInstanceUID.c_str(), sizeof(req->AffectedSOPInstanceUID));
   req->DataSetType = DIMSE_DATASET_PRESENT;
-  req->Priority = DIMSE_PRIORITY_MEDIUM;
+  req->Priority = m_priority;
 
   /* If desired (optional), insert MOVE originator information if this C-STORE
      was initiated through a C-MOVE request.
@@ -807,20 +867,51 @@ OFCondition DcmSCU::sendSTORERequest(const T_ASC_PresentationContextID presID,
     DCMNET_INFO("Sending C-STORE Request (MsgID " << req->MessageID << ", "
       << dcmSOPClassUIDToModality(sopClassUID.c_str(), "OT") << ")");
   }
-  cond = sendDIMSEMessage(pcid, &msg, dataset);
+  /* Large values are not loaded from the file (see DCM_MaxReadLength), so if the */
+  /* file already has the negotiated transfer syntax, the data set is sent as is */
+  OFString networkXfer;
+  if (fileformat && dcmSendFileDataUnchanged.get())
+  {
+    OFString abstractSyntax;
+    findPresentationContext(pcid, abstractSyntax, networkXfer);
+  }
+  if (fileformat && !networkXfer.empty() && (networkXfer == xfer.getXferID()) && (dataset->getCurrentXfer() == xferSyntax))
+  {
+    DCMNET_DEBUG("Sending data set of file " << dicomFile << " unchanged");
+    cond = DIMSE_sendMessageUsingFileData(m_assoc, pcid, &msg, NULL /*statusDetail*/, dicomFile.getCharPointer(),
+                                          m_progressNotificationMode ? callbackSENDProgress : NULL,
+                                          m_progressNotificationMode ? this : NULL);
+    if (cond.good())
+      ++m_messagesSent;
+  } else {
+    cond = sendDIMSEMessage(pcid, &msg, dataset);
+  }
   delete fileformat;
   fileformat = NULL;
   if (cond.bad())
   {
     DCMNET_ERROR("Failed sending C-STORE request: " << DimseCondition::dump(tempStr, cond));
-    return cond;
   }
+  return cond;
+}
+
+
+OFCondition DcmSCU::receiveSTOREResponse(Uint16 &messageID,
+                                         Uint16 &rspStatusCode)
+{
+  // Do some basic validity checks
+  if (!isConnected())
+    return DIMSE_ILLEGALASSOCIATION;
+
+  OFString tempStr;
+  T_ASC_PresentationContextID pcid = 0;
+  DcmDataset* statusDetail = NULL;
 
   /* Receive response */
   T_DIMSE_Message rsp;
   // Make sure everything is zeroed (especially options)
   bzero((char*)&rsp, sizeof(rsp));
-  cond = receiveDIMSECommand(&pcid, &rsp, &statusDetail, NULL /* not interested in the command set */);
+  OFCondition cond = receiveDIMSECommand(&pcid, &rsp, &statusDetail, NULL /* not interested in the command set */);
   if (cond.bad())
   {
     DCMNET_ERROR("Failed receiving DIMSE response: " << DimseCondition::dump(tempStr, cond));
@@ -845,6 +936,7 @@ OFCondition DcmSCU::sendSTORERequest(const T_ASC_PresentationContextID presID,
     return DIMSE_BADCOMMANDTYPE;
   }
   T_DIMSE_C_StoreRSP storeRsp = rsp.msg.CStoreRSP;
+  messageID = storeRsp.MessageIDBeingRespondedTo;
   rspStatusCode = storeRsp.DimseStatus;
   if (statusDetail != NULL)
   {
@@ -890,7 +982,7 @@ OFCondition DcmSCU::sendMOVERequest(const T_ASC_PresentationContextID presID,
   // Set target for embedded C-Store's
   OFStandard::strlcpy(req->MoveDestination, moveDestinationAETitle.c_str(), sizeof(req->MoveDestination));
   // Set priority (mandatory)
-  req->Priority = DIMSE_PRIORITY_MEDIUM;
+  req->Priority = m_priority;
 
   /* Determine SOP Class from presentation context */
   OFString abstractSyntax, transferSyntax;
@@ -1093,7 +1185,7 @@ OFCondition DcmSCU::sendCGETRequest(const T_ASC_PresentationContextID presID,
   // Announce dataset
   req->DataSetType = DIMSE_DATASET_PRESENT;
   // Specify priority
-  req->Priority = DIMSE_PRIORITY_MEDIUM;
+  req->Priority = m_priority;
 
   // Determine SOP Class from presentation context
   OFString abstractSyntax, transferSyntax;
@@ -1559,7 +1651,7 @@ OFCondition DcmSCU::sendFINDRequest(const T_ASC_PresentationContextID presID,
   // Announce dataset
   req->DataSetType = DIMSE_DATASET_PRESENT;
   // Specify priority
-  req->Priority = DIMSE_PRIORITY_MEDIUM;
+  req->Priority = m_priority;
 
   // Determine SOP Class from presentation context
   OFString abstractSyntax, transferSyntax;
@@ -2190,6 +2282,8 @@ OFCondition DcmSCU::sendDIMSEMessage(const T_ASC_PresentationContextID presID,
     cond = DIMSE_sendMessageUsingMemoryData(m_assoc, presID, msg, NULL /*statusDetail*/, dataObject,
                                             NULL /*callback*/, NULL /*callbackData*/, commandSet);
   }
+  if (cond.good())
+    ++m_messagesSent;
 
 #if 0
   // currently disabled because it is not (yet) needed
@@ -2275,6 +2369,27 @@ void DcmSCU::setMaxReceivePDULength(const Uint32 maxRecPDU)
 }
 
 
+void DcmSCU::setAsyncOperationsWindow(const Uint16 maxOperationsInvoked)
+{
+  m_maxOperationsInvoked = maxOperationsInvoked;
+}
+
+
+void DcmSCU::setTCPSocketOptions(const int bufferLength, const int noDelay)
+{
+  m_tcpBufferLength = bufferLength;
+  m_tcpNoDelay = noDelay;
+}
+
+
+void DcmSCU::setTCPKeepAlive(const int idle, const int interval, const int probes)
+{
+  m_tcpKeepAliveIdle = idle;
+  m_tcpKeepAliveInterval = interval;
+  m_tcpKeepAliveProbes = probes;
+}
+
+
 void DcmSCU::setDIMSEBlockingMode(const T_DIMSE_BlockingMode blockingMode)
 {
   m_blockMode = blockingMode;
@@ -2311,6 +2426,12 @@ void DcmSCU::setDIMSETimeout(const Uint32 dimseTimeout)
 }
 
 
+void DcmSCU::setPriority(const T_DIMSE_Priority priority)
+{
+  m_priority = priority;
+}
+
+
 void DcmSCU::setACSETimeout(const Uint32 acseTimeout)
 {
   m_acseTimeout = acseTimeout;
@@ -2368,15 +2489,38 @@ OFBool DcmSCU::isConnected() const
   return (m_assoc != NULL) && (m_assoc->DULassociation != NULL);
 }
 
+OFBool DcmSCU::isDataWaiting() const
+{
+  return isConnected() && ASC_dataWaiting(m_assoc, 0);
+}
+
+Uint32 DcmSCU::getMessagesSent() const
+{
+  return m_messagesSent;
+}
+
 Uint32 DcmSCU::getMaxReceivePDULength() const
 {
   return m_maxReceivePDULength;
 }
 
 
+Uint16 DcmSCU::getAsyncOperationsWindow() const
+{
+  if (!isConnected() || (m_maxOperationsInvoked <= 1))
+    return 1;
+  unsigned short granted = 1;
+  ASC_getAsyncOperationsWindow(m_assoc->params, &granted, NULL);
+  /* 0 means unlimited, never exceed what was proposed */
+  if ((granted == 0) || (granted > m_maxOperationsInvoked))
+    granted = m_maxOperationsInvoked;
+  return granted;
+}
+
+
 OFBool DcmSCU::getTLSEnabled() const
 {
-  return OFFalse;
+  return m_transportLayer != NULL;
 }
 
 
@@ -2416,6 +2560,12 @@ Uint32 DcmSCU::getDIMSETimeout() const
 }
 
 
+T_DIMSE_Priority DcmSCU::getPriority() const
+{
+  return m_priority;
+}
+
+
 Uint32 DcmSCU::getACSETimeout() const
 {
   return m_acseTimeout;
@@ -29,6 +29,7 @@
 class DcmQueryRetrieveDatabaseHandle;
 class DcmQueryRetrieveOptions;
 class DcmQueryRetrieveCharacterSetOptions;
+class DcmQueryRetrieveFindPrefetch;
 
 /** this class maintains the context information that is passed to the
  *  callback function called by DIMSE_findProvider.
@@ -51,9 +52,13 @@ public:
     , priorStatus(priorStat)
     , ourAETitle()
     , characterSetOptions(characterSetOptions)
+    , prefetch_(NULL)
     {
     }
 
+    /// destructor, stops reading responses ahead
+    ~DcmQueryRetrieveFindContext();
+
     /** set the AEtitle under which this application operates
      *  @param ae AEtitle, is copied into this object.
      */
@@ -80,6 +85,12 @@ public:
 
 private:
 
+    /// private undefined copy constructor
+    DcmQueryRetrieveFindContext(const DcmQueryRetrieveFindContext& other);
+
+    /// private undefined assignment operator
+    DcmQueryRetrieveFindContext& operator=(const DcmQueryRetrieveFindContext& other);
+
     /// reference to database handle
     DcmQueryRetrieveDatabaseHandle& dbHandle;
 
@@ -95,6 +106,9 @@ private:
     /// Specific Character Set related options
     const DcmQueryRetrieveCharacterSetOptions& characterSetOptions;
 
+    /// responses read ahead of the one being sent, NULL while they are read in the callback
+    DcmQueryRetrieveFindPrefetch *prefetch_;
+
 };
 
 #endif
@@ -29,9 +29,13 @@
 class DcmQueryRetrieveDatabaseHandle;
 class DcmQueryRetrieveOptions;
 class DcmQueryRetrieveDatabaseStatus;
+class DcmQueryRetrieveMoveSubOps;
+class DcmQueryRetrieveMovePrefetch;
 
 /** this class maintains the context information that is passed to the
- *  callback function called by DIMSE_getProvider.
+ *  callback function called by DIMSE_getProvider. The C-STORE sub-operations are
+ *  sent on the association of the C-GET, up to the asynchronous operations window
+ *  the requestor was granted before their responses are awaited.
  */
 class DCMTK_DCMQRDB_EXPORT DcmQueryRetrieveGetContext
 {
@@ -69,10 +73,15 @@ public:
     , nFailed(0)
     , nWarning(0)
     , getCancelled(OFFalse)
+    , subOps(NULL)
+    , prefetch(NULL)
     {
       origHostName[0] = '\0';
     }
 
+    /// destructor, completes the sub-operations still outstanding
+    ~DcmQueryRetrieveGetContext();
+
     /** set the AEtitle under which this application operates
      *  @param ae AEtitle, is copied into this object.
      */
@@ -107,8 +116,16 @@ private:
     DcmQueryRetrieveGetContext& operator=(const DcmQueryRetrieveGetContext& other);
 
     void addFailedUIDInstance(const char *sopInstance);
-    OFCondition performGetSubOp(DIC_UI sopClass, DIC_UI sopInstance, char *fname);
+    void subOpFailed(const char *sopInstance);
+    void startSubOperations();
+    void endSubOperations();
+    OFCondition performGetSubOp(const char *sopClass, const char *sopInstance, const char *fname);
+    OFCondition receiveGetSubOpResponse();
+    void failGetSubOps();
+    void completeGetSubOps();
+    void getNextImages(DcmQueryRetrieveDatabaseStatus * dbStatus);
     void getNextImage(DcmQueryRetrieveDatabaseStatus * dbStatus);
+    void getNextPrefetchedImage(DcmQueryRetrieveDatabaseStatus * dbStatus);
     void buildFailedInstanceList(DcmDataset ** rspIds);
 
     /// reference to database handle
@@ -163,6 +180,12 @@ private:
     /// true if the get sub-operations have been cancelled
     OFBool getCancelled;
 
+    /// C-STORE sub-operations awaiting their response, up to the window granted to the requestor
+    DcmQueryRetrieveMoveSubOps *subOps;
+
+    /// read-ahead of the files to be sent, NULL if disabled
+    DcmQueryRetrieveMovePrefetch *prefetch;
+
 };
 
 #endif
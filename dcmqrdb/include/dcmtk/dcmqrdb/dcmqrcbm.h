@@ -26,11 +26,17 @@
 #include "dcmtk/dcmnet/dimse.h"
 #include "dcmtk/dcmnet/dcasccfg.h"
 #include "dcmtk/dcmqrdb/qrdefine.h"
+#include "dcmtk/dcmqrdb/dcmqrdba.h"
+#include "dcmtk/ofstd/oftimer.h"
 
 class DcmQueryRetrieveDatabaseHandle;
 class DcmQueryRetrieveOptions;
 class DcmQueryRetrieveConfig;
 class DcmQueryRetrieveDatabaseStatus;
+class DcmQueryRetrieveTranscodeCache;
+class DcmQueryRetrieveMoveWorkers;
+class DcmQueryRetrieveMoveSubOps;
+class DcmQueryRetrieveMovePrefetch;
 
 /** this class maintains the context information that is passed to the
  *  callback function called by DIMSE_moveProvider.
@@ -75,12 +81,23 @@ public:
     , nCompleted(0)
     , nFailed(0)
     , nWarning(0)
+    , transcodeCache(NULL)
+    , workers(NULL)
+    , subOps(NULL)
+    , prefetch(NULL)
+    , forwardedMoves()
+    , forwardedRemaining(0)
+    , forwarding(OFFalse)
     {
       origAETitle[0] = '\0';
       origHostName[0] = '\0';
       dstAETitle[0] = '\0';
+      dstHostName[0] = '\0';
     }
 
+    /// destructor, releases the sub-associations if the C-MOVE was aborted
+    ~DcmQueryRetrieveMoveContext();
+
     /** callback handler called by the DIMSE_storeProvider callback function.
      *  @param cancelled (in) flag indicating whether a C-CANCEL was received
      *  @param request original move request (in)
@@ -106,6 +123,27 @@ public:
       if (ae) ourAETitle = ae; else ourAETitle.clear();
     }
 
+    /** set the cache used for instances that have to be converted to the
+     *  transfer syntax accepted on the sub-association
+     *  @param cache transcode cache, not owned by this object. NULL disables caching.
+     */
+    void setTranscodeCache(DcmQueryRetrieveTranscodeCache *cache)
+    {
+      transcodeCache = cache;
+    }
+
+    /** notify of a dataset sent to the move destination, e.g. to measure the link
+     *  @param bytes bytes of the dataset
+     *  @param seconds seconds spent sending it
+     */
+    void subOpSent(Uint64 bytes, double seconds);
+
+    /** notify of bytes about to be sent to the move destination, blocks while
+     *  they exceed the bandwidth configured for it
+     *  @param bytes bytes of the next fragment
+     */
+    void subOpSending(Uint64 bytes);
+
 private:
 
     /// private undefined copy constructor
@@ -115,11 +153,22 @@ private:
     DcmQueryRetrieveMoveContext& operator=(const DcmQueryRetrieveMoveContext& other);
 
     void addFailedUIDInstance(const char *sopInstance);
-    OFCondition performMoveSubOp(DIC_UI sopClass, DIC_UI sopInstance, char *fname);
+    void subOpCompleted();
+    void subOpWarning();
+    void subOpFailed(const char *sopInstance);
+    OFCondition performMoveSubOp(T_ASC_Association *assoc, DcmQueryRetrieveMoveSubOps& pending, const char *sopClass, const char *sopInstance, const char *fname);
+    OFCondition receiveMoveSubOpResponse(T_ASC_Association *assoc, DcmQueryRetrieveMoveSubOps& pending);
+    void completeMoveSubOps(T_ASC_Association *assoc, DcmQueryRetrieveMoveSubOps& pending);
+    void failMoveSubOps(DcmQueryRetrieveMoveSubOps& pending);
     OFCondition buildSubAssociation(T_DIMSE_C_MoveRQ *request);
+    OFCondition requestSubAssociation(int dstPortNumber, T_ASC_Association **assoc);
     OFCondition closeSubAssociation();
     void moveNextImage(DcmQueryRetrieveDatabaseStatus * dbStatus);
+    void moveNextImages(DcmQueryRetrieveDatabaseStatus * dbStatus);
+    void moveNextPrefetchedImage(DcmQueryRetrieveDatabaseStatus * dbStatus);
     void failAllSubOperations(DcmQueryRetrieveDatabaseStatus * dbStatus);
+    void forwardNextMove(DcmQueryRetrieveDatabaseStatus * dbStatus);
+    OFCondition forwardMove(const DcmQueryRetrieveForwardedMove& move, T_DIMSE_C_MoveRSP& rsp, DcmDataset **rspIds);
     void buildFailedInstanceList(DcmDataset ** rspIds);
     OFBool mapMoveDestination(
       const char *origPeer, const char *origAE,
@@ -168,6 +217,9 @@ private:
     /// destination title for move
     DIC_AE dstAETitle;
 
+    /// hostname of move destination
+    DIC_NODENAME dstHostName;
+
     /// instance UIDs of failed store sub-ops
     char *failedUIDs;
 
@@ -183,6 +235,30 @@ private:
     /// number of completed sub-operations that causes warnings
     DIC_US nWarning;
 
+    /// cache of transcoded instances, may be NULL
+    DcmQueryRetrieveTranscodeCache *transcodeCache;
+
+    /// threads sending over parallel sub-associations, NULL if sub-operations are performed serially
+    DcmQueryRetrieveMoveWorkers *workers;
+
+    /// C-STORE sub-operations awaiting their response on subAssoc if sub-operations are performed serially
+    DcmQueryRetrieveMoveSubOps *subOps;
+
+    /// files of the next sub-operations read ahead if sub-operations are performed serially, may be NULL
+    DcmQueryRetrieveMovePrefetch *prefetch;
+
+    /// started when the C-MOVE request is received, for the throughput of the sub-operations
+    OFTimer timer;
+
+    /// matching instances held by other SCPs, moved by them after the local sub-operations
+    OFList<DcmQueryRetrieveForwardedMove> forwardedMoves;
+
+    /// number of instances in forwardedMoves
+    size_t forwardedRemaining;
+
+    /// true once the local sub-operations are done and the C-MOVE is forwarded
+    OFBool forwarding;
+
 };
 
 #endif
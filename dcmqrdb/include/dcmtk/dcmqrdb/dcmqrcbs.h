@@ -23,12 +23,15 @@
 #define DCMQRCBS_H
 
 #include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstring.h"
+#include "dcmtk/ofstd/oftimer.h"
 #include "dcmtk/dcmnet/dimse.h"
 #include "dcmtk/dcmqrdb/qrdefine.h"
 
 class DcmQueryRetrieveDatabaseHandle;
 class DcmQueryRetrieveOptions;
 class DcmFileFormat;
+class DcmQueryRetrieveCompressionQueue;
 
 /** this class maintains the context information that is passed to the
  *  callback function called by DIMSE_storeProvider.
@@ -55,6 +58,12 @@ public:
     , fileName(NULL)
     , dcmff(ff)
     , correctUIDPadding(correctuidpadding)
+    , compressionQueue(NULL)
+    , receivedFile(NULL)
+    , duplicate(OFFalse)
+    , receiveTimer()
+    , receivedBytes(0)
+    , receiveSeconds(0)
     {
     }
 
@@ -71,6 +80,48 @@ public:
      */
     void setFileName(const char *fn) { fileName = fn; }
 
+    /** set the queue converting stored files to the write transfer syntax in
+     *  the background
+     *  @param queue compression queue, not owned by this object. NULL converts
+     *    datasets before they are written.
+     */
+    void setCompressionQueue(DcmQueryRetrieveCompressionQueue *queue) { compressionQueue = queue; }
+
+    /** set the file the dataset was written to as received, the dataset passed
+     *  to the callback handler then only contains its header
+     *  @param fn file name. String is not copied. NULL if received in memory.
+     */
+    void setReceivedFile(const char *fn) { receivedFile = fn; }
+
+    /** mark the instance being received as already stored, it is received
+     *  into the null device and acknowledged without being stored again
+     *  @param d true for an instance already stored
+     */
+    void setDuplicate(OFBool d) { duplicate = d; }
+
+    /// return true if the instance being received is already stored
+    OFBool isDuplicate() const { return duplicate; }
+
+    /** measures the time from the first to the last PDV of the dataset,
+     *  called with every progress state of the store provider
+     *  @param progress progress state
+     */
+    void measureReceive(const T_DIMSE_StoreProgress *progress)
+    {
+        if (progress->state == DIMSE_StoreBegin) receiveTimer.reset();
+        else if (progress->state == DIMSE_StoreEnd)
+        {
+            receivedBytes = progress->progressBytes;
+            receiveSeconds = receiveTimer.getDiff();
+        }
+    }
+
+    /// return the bytes of the dataset received, 0 until it is complete
+    Uint64 getReceivedBytes() const { return receivedBytes; }
+
+    /// return the seconds the dataset took to receive
+    double getReceiveSeconds() const { return receiveSeconds; }
+
     void setStorageDir(const char* fn) { _storageDir = fn; }
     const char* storageDir() { return _storageDir; }
 
@@ -97,6 +148,7 @@ private:
     void saveImageToDB(
         T_DIMSE_C_StoreRQ *req,             /* original store request */
         const char *imageFileName,
+        DcmDataset *imageDataSet,           /* NULL if received into file */
         /* out */
         T_DIMSE_C_StoreRSP *rsp,            /* final store response */
         DcmDataset **stDetail);
@@ -106,6 +158,23 @@ private:
         const char* fname,
         T_DIMSE_C_StoreRSP *rsp);
 
+    void moveReceivedFile(
+        DcmDataset *header,
+        const char* fname,
+        T_DIMSE_C_StoreRSP *rsp);
+
+    /** appends a stored instance file to the pack file of its series and
+     *  removes it, the file is kept if it cannot be appended
+     *  @param dataset dataset or header of the instance
+     *  @param fname file the instance was stored in
+     *  @param member member name of the instance in the pack returned
+     *  @return OFTrue if the instance was packed
+     */
+    OFBool packFile(
+        DcmDataset *dataset,
+        const char* fname,
+        OFString& member);
+
     void checkRequestAgainstDataset(
         T_DIMSE_C_StoreRQ *req,     /* original store request */
         const char* fname,          /* filename of dataset */
@@ -133,6 +202,24 @@ private:
     /// flag indicating whether space padded UIDs should be silently corrected
     OFBool correctUIDPadding;
 
+    /// background compression of stored files, NULL if disabled
+    DcmQueryRetrieveCompressionQueue *compressionQueue;
+
+    /// file the dataset was received into as is, NULL if received in memory
+    const char *receivedFile;
+
+    /// true if the instance being received is already stored
+    OFBool duplicate;
+
+    /// started with the first PDV of the dataset
+    OFTimer receiveTimer;
+
+    /// bytes of the dataset received
+    Uint64 receivedBytes;
+
+    /// seconds from the first to the last PDV of the dataset
+    double receiveSeconds;
+
 };
 
 #endif
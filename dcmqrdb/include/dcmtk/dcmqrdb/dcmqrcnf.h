@@ -28,6 +28,7 @@
 #include "dcmtk/ofstd/ofstdinc.h"
 #include "dcmtk/ofstd/ofcmdln.h"
 #include "dcmtk/oflog/oflog.h"
+#include "dcmtk/dcmnet/dimse.h"
 #include "dcmtk/dcmqrdb/qrdefine.h"
 
 extern DCMTK_DCMQRDB_EXPORT OFLogger DCM_dcmqrdbLogger;
@@ -241,6 +242,61 @@ public:
    */
   virtual int checkForSameVendor(const char *AETitle1, const char *AETitle2) const;
 
+  /*
+   *  check whether compressed or uncompressed transfer syntaxes are
+   *  preferred for a SOP Class on the link to a peer
+   *  Input : AETitle and Host Name of the peer, SOP Class UID
+   *  Return : 1 - compressed (lossless for images, deflated for other objects)
+   *     0 - uncompressed
+   *    -1 - the configured transfer syntaxes
+   */
+  virtual int preferCompressed(const char *AETitle, const char *HostName, const char *SOPClassUID) const;
+
+  /*
+   *  notify of data sent to or received from a peer, e.g. to measure the link
+   *  Input : AETitle and Host Name of the peer, bytes of the datasets,
+   *     seconds spent transferring them
+   */
+  virtual void transferCompleted(const char *AETitle, const char *HostName, Uint64 bytes, double seconds) const;
+
+  /*
+   *  get the priority the C-GET and C-MOVE sub-operations of a peer are scheduled with
+   *  Input : AETitle of the peer, priority of its request
+   *  Return : priority configured for the peer, the requested one by default
+   */
+  virtual T_DIMSE_Priority priorityForAETitle(const char *AETitle, T_DIMSE_Priority requested) const;
+
+  /*
+   *  check an incoming association against the limits of its peer before it is
+   *  negotiated, e.g. associations per second or at a time per AE title or host.
+   *  An admitted association is passed to associationReleased() when it ends
+   *  Input : AETitle and Host Name of the calling peer
+   *  Return : OFTrue to continue, OFFalse to refuse it as transient (default OFTrue)
+   */
+  virtual OFBool admitAssociation(const char *AETitle, const char *HostName) const;
+
+  /*
+   *  notify that a worker thread starts serving an admitted association in
+   *  single process mode, e.g. to place the thread. associationReleased() is
+   *  called from the same thread when the association ends
+   *  Input : AETitle and Host Name of the calling peer
+   */
+  virtual void associationStarted(const char *AETitle, const char *HostName) const;
+
+  /*
+   *  notify of the end of an association admitted by admitAssociation(), in
+   *  multi-processing mode once it is handed to its child process
+   *  Input : AETitle and Host Name of the calling peer
+   */
+  virtual void associationReleased(const char *AETitle, const char *HostName) const;
+
+  /*
+   *  notify of bytes about to be sent to a peer, may block to cap the bandwidth
+   *  to it. Called from the threads sending C-MOVE sub-operations
+   *  Input : AETitle and Host Name of the peer, bytes to be sent
+   */
+  virtual void throttleTransfer(const char *AETitle, const char *HostName, Uint64 bytes) const;
+
   /*
    *  get Storage Area for AETitle
    *  Input : AETitle
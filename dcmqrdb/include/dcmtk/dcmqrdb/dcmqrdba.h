@@ -29,10 +29,37 @@
 #define INCLUDE_UNISTD
 #include "dcmtk/ofstd/ofstdinc.h"
 #include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/oflist.h"
+#include "dcmtk/ofstd/ofstring.h"
 #include "dcmtk/dcmqrdb/qrdefine.h"
 
 class DcmDataset;
 class DcmQueryRetrieveDatabaseStatus;
+
+/** instances of a series matched by a C-MOVE request which another SCP holds
+ *  locally, e.g. a node of a cluster sharing the database. The C-MOVE is
+ *  forwarded to it for them, with the same move destination.
+ */
+struct DCMTK_DCMQRDB_EXPORT DcmQueryRetrieveForwardedMove
+{
+  /// AE title of the SCP holding the instances
+  OFString aeTitle;
+
+  /// host name of the SCP
+  OFString hostName;
+
+  /// port number of the SCP
+  int port;
+
+  /// study of the instances
+  OFString studyInstanceUID;
+
+  /// series of the instances
+  OFString seriesInstanceUID;
+
+  /// the instances
+  OFList<OFString> sopInstanceUIDs;
+};
 struct DcmQueryRetrieveCharacterSetOptions;
 
 #ifndef MAXPATHLEN
@@ -90,6 +117,61 @@ public:
       DcmQueryRetrieveDatabaseStatus  *status,
       OFBool     isNew = OFTrue ) = 0;
 
+  /** register the given DICOM object, which has been received through a C-STORE
+   *  operation and stored in a file, in the database. If the dataset is still
+   *  available in memory, database handles may take the attributes to be indexed
+   *  from there instead of reading the file again. The default implementation
+   *  ignores the dataset and calls storeRequest().
+   *  @param SOPClassUID SOP class UID of DICOM instance
+   *  @param SOPInstanceUID SOP instance UID of DICOM instance
+   *  @param imageFileName file name (full path) of DICOM instance
+   *  @param imageDataSet dataset written to the file, NULL if the dataset was
+   *    received directly into the file (bit preserving mode)
+   *  @param status pointer to DB status object in which a DIMSE status code
+        suitable for use with the C-STORE-RSP message is set.
+   *  @param isNew if true, the instance is marked as "new" in the database,
+   *    if such a flag is maintained in the database.
+   *  @return EC_Normal upon normal completion, or some other OFCondition code upon failure.
+   */
+  virtual OFCondition storeDatasetRequest(
+      const char *SOPClassUID,
+      const char *SOPInstanceUID,
+      const char *imageFileName,
+      DcmDataset *imageDataSet,
+      DcmQueryRetrieveDatabaseStatus  *status,
+      OFBool     isNew = OFTrue )
+  {
+    (void) imageDataSet;
+    return storeRequest(SOPClassUID, SOPInstanceUID, imageFileName, status, isNew);
+  }
+
+  /** check whether an instance is registered in the database and its file
+   *  still exists, before a C-STORE of the same instance is received. The
+   *  default implementation does not know and returns false.
+   *  @param SOPInstanceUID SOP instance UID of DICOM instance
+   *  @return OFTrue if the instance is stored
+   */
+  virtual OFBool isInstanceStored(const char *SOPInstanceUID)
+  {
+    (void) SOPInstanceUID;
+    return OFFalse;
+  }
+
+  /** check which of a set of instances are stored, e.g. for a storage
+   *  commitment request. The default implementation asks
+   *  isInstanceStored() for each instance, handles that can look them up
+   *  together should do so.
+   *  @param SOPInstanceUIDs SOP instance UIDs of the instances
+   *  @param stored receives the SOP instance UIDs of the stored instances
+   */
+  virtual void storedInstances(const OFList<OFString>& SOPInstanceUIDs, OFList<OFString>& stored)
+  {
+    for (OFListConstIterator(OFString) it = SOPInstanceUIDs.begin(); it != SOPInstanceUIDs.end(); ++it)
+    {
+      if (isInstanceStored((*it).c_str())) stored.push_back(*it);
+    }
+  }
+
   /** initiate FIND operation using the given SOP class UID (which identifies
    *  the query model) and DICOM dataset containing find request identifiers.
    *  @param SOPClassUID SOP class UID of query service, identifies Q/R model
@@ -191,6 +273,19 @@ public:
    */
   virtual OFCondition cancelMoveRequest(DcmQueryRetrieveDatabaseStatus *status) = 0;
 
+  /** remove the instances of the move request started last that another SCP
+   *  holds locally from the sub-operations, to forward the C-MOVE to it. Not
+   *  used for C-GET, whose instances are sent over the association of the
+   *  request. The default implementation sends all instances itself.
+   *  @param moves one or more entries per series and SCP returned
+   *  @param status set to success if no instances are left to be sent locally
+   */
+  virtual void takeForwardedMoves(OFList<DcmQueryRetrieveForwardedMove>& moves, DcmQueryRetrieveDatabaseStatus *status)
+  {
+    (void) moves;
+    (void) status;
+  }
+
   /** Prune invalid records from the database.
    *  Records referring to non-existant image files are invalid.
    */
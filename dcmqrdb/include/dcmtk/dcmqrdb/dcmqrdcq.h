@@ -0,0 +1,90 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveCompressionQueue
+ *
+ */
+
+#ifndef DCMQRDCQ_H
+#define DCMQRDCQ_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftypes.h"
+#include "dcmtk/ofstd/ofstring.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+#include "dcmtk/dcmqrdb/qrdefine.h"
+
+class DcmQueryRetrieveOptions;
+class DcmQueryRetrieveCompressionQueuePrivate;
+
+/** background compression of stored instances. The C-STORE SCP writes the
+ *  dataset in the transfer syntax it was received in and responds, the file
+ *  is converted to the write transfer syntax later by a small number of
+ *  threads running at the lowest scheduling priority, so compression only
+ *  uses CPU time left over by the associations. The converted file replaces
+ *  the original by an atomic rename, readers see either the one or the other.
+ *  Files still waiting when the queue is destroyed stay as received.
+ *  The queue is shared by all associations of a process and is thread safe.
+ */
+class DCMTK_DCMQRDB_EXPORT DcmQueryRetrieveCompressionQueue
+{
+public:
+  /** constructor, starts the threads
+   *  @param options options for the Q/R service, the encoding settings for
+   *    writing files are copied
+   *  @param threads number of threads compressing files, at least one
+   */
+  DcmQueryRetrieveCompressionQueue(const DcmQueryRetrieveOptions& options, size_t threads);
+
+  /// destructor, finishes the files being compressed and drops the others
+  virtual ~DcmQueryRetrieveCompressionQueue();
+
+  /** queues a stored file for conversion
+   *  @param filename file the instance is stored in
+   *  @param xfer transfer syntax the file is converted to
+   */
+  void add(const OFString& filename, E_TransferSyntax xfer);
+
+  /** returns the number of files waiting or being compressed
+   *  @return number of pending files
+   */
+  size_t pending() const;
+
+  /** returns the number of files replaced by their compressed version
+   *  @return number of compressed files
+   */
+  size_t compressed() const;
+
+  /** returns the number of files that could not be converted and were kept
+   *  as received
+   *  @return number of failed conversions
+   */
+  size_t failed() const;
+
+private:
+  /// private undefined copy constructor
+  DcmQueryRetrieveCompressionQueue(const DcmQueryRetrieveCompressionQueue& other);
+
+  /// private undefined assignment operator
+  DcmQueryRetrieveCompressionQueue& operator=(const DcmQueryRetrieveCompressionQueue& other);
+
+  /// worker thread body
+  void run();
+
+  /// private implementation
+  DcmQueryRetrieveCompressionQueuePrivate *d;
+};
+
+#endif
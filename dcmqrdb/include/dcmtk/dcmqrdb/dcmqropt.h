@@ -32,10 +32,45 @@
 #include "dcmtk/ofstd/ofconapp.h"
 #include "dcmtk/dcmnet/dimse.h"
 
+#include <functional>
+#include <vector>
+
+class DcmDataset;
+
 /// invalid peer for move operation
 extern DCMTK_DCMQRDB_EXPORT const OFConditionConst QR_EC_InvalidPeer;
 extern DCMTK_DCMQRDB_EXPORT const OFConditionConst QR_EC_IndexDatabaseError;
 
+/** state of a C-MOVE handled by the SCP, reported with each C-MOVE response
+ *  to the handler set in DcmQueryRetrieveOptions::moveProgress_
+ */
+struct DCMTK_DCMQRDB_EXPORT DcmQueryRetrieveMoveProgress
+{
+  /// title of the move requestor
+  const char *requestorAETitle;
+
+  /// title of the move destination
+  const char *destinationAETitle;
+
+  /// DIMSE status of the response, pending until all sub-operations are done
+  DIC_US status;
+
+  /// number of remaining sub-operations, including those awaiting their response
+  DIC_US remaining;
+
+  /// number of completed sub-operations
+  DIC_US completed;
+
+  /// number of failed sub-operations
+  DIC_US failed;
+
+  /// number of sub-operations completed with a warning
+  DIC_US warning;
+
+  /// seconds since the C-MOVE request was received
+  double elapsed;
+};
+
 /** this class encapsulates all the various options that affect the
  *  operation of the SCP, in addition to those defined in the config file
  */
@@ -84,7 +119,7 @@ public:
   /// maximum number of parallel associations accepted
   int               maxAssociations_;
 
-  /// maximum PDU size
+  /// maximum PDU size, received on incoming associations and on C-MOVE sub-associations
   OFCmdUnsignedInt  maxPDU_;
 
   /// pointer to network structure used for requesting C-STORE sub-associations
@@ -124,12 +159,52 @@ public:
   /// restrict MOVE operations to same vendor according to vendor table
   OFBool            restrictMoveToSameVendor_;
 
+  /** accept associations and request C-MOVE sub-associations over the transport layer
+   *  of the networks (e.g. TLS) instead of plain TCP
+   */
+  OFBool            secureConnection_;
+
   /// sequence encoding when writing DICOM files
   E_EncodingType    sequenceType_;
 
   /// single process mode
   OFBool            singleProcess_;
 
+  /** maximum number of worker threads serving associations in single process mode.
+   *  Zero means one worker per permitted association (see maxAssociations_).
+   */
+  int               maxWorkerThreads_;
+
+  /** number of parallel sub-associations opened to a C-MOVE destination.
+   *  Values below two send all sub-operations serially over a single association.
+   */
+  int               moveSubAssociations_;
+
+  /** number of C-STORE sub-operations outstanding on a C-MOVE sub-association,
+   *  proposed in the asynchronous operations window. Values below two, or a
+   *  destination declining the window, wait for each C-STORE response.
+   */
+  int               moveAsyncOperations_;
+
+  /** maximum number of files read ahead of the C-MOVE or C-GET sub-operation being
+   *  sent, if sub-operations are performed serially. The depth used follows the measured
+   *  read and send times. Values below one read each file when it is sent.
+   */
+  int               moveReadAhead_;
+
+  /** maximum number of C-FIND responses read from the database ahead of the one
+   *  being sent, by a thread started once a query has a second match. Values below
+   *  one read each response when it is sent.
+   */
+  int               findReadAhead_;
+
+  /** number of outstanding requests granted to an SCU proposing an asynchronous
+   *  operations window. The requests are still performed one at a time, the C-STORE
+   *  sub-operations of a C-GET are sent up to this number before their responses are
+   *  awaited. Values below two decline the window.
+   */
+  int               asyncOperationsWindow_;
+
   /// support for patient root q/r model
   OFBool            supportPatientRoot_;
 
@@ -157,9 +232,89 @@ public:
   /// timeout for DIMSE operations
   int dimse_timeout_;
 
+  /** seconds an association may go without a request before it is aborted,
+   *  also while the DIMSE operations wait forever. Zero waits forever.
+   */
+  int idle_timeout_;
+
   /// timeout for ACSE operations
   int acse_timeout_;
 
+  /** maximum total size in bytes of the transcoded files kept for C-MOVE sub-operations.
+   *  Zero disables the transcode cache, files are then converted on every transfer.
+   */
+  size_t transcodeCacheSize_;
+
+  /// directory of the transcode cache
+  OFString transcodeCacheDirectory_;
+
+  /** number of low priority threads converting stored files to the write
+   *  transfer syntax after the C-STORE response was sent. Zero converts
+   *  each dataset before it is written and the response is sent.
+   */
+  size_t compressionThreads_;
+
+  /** acknowledge a C-STORE of an instance the database handle reports as
+   *  already stored (see DcmQueryRetrieveDatabaseHandle::isInstanceStored())
+   *  with success, the dataset is received into the null device and the
+   *  stored file and its index entry are kept. Resent instances then cost
+   *  neither a file write nor an index update, corrections sent with the
+   *  same SOP Instance UID are lost however.
+   */
+  OFBool skipDuplicates_;
+
+  /** append each stored instance to the pack file of its series in the
+   *  study directory (see DcmQueryRetrievePackFile) instead of keeping it as
+   *  a file of its own, the index refers to it by its offset in the pack.
+   *  Not used with a compression queue, which replaces files after the
+   *  response.
+   */
+  OFBool packSeries_;
+
+  /** called with each C-MOVE response by the thread serving the association,
+   *  e.g. to watch the throughput of outgoing moves. Empty by default.
+   */
+  std::function<void(const DcmQueryRetrieveMoveProgress&)> moveProgress_;
+
+  /** called by the thread serving the association with the duration in
+   *  seconds of each handled C-ECHO, C-STORE, C-FIND, C-MOVE, C-GET and
+   *  N-ACTION request ("echo", "store", "find", "move", "get", "commit")
+   *  and, once it ends, of the association ("association"). Empty by
+   *  default.
+   */
+  std::function<void(const char *operation, double seconds, OFBool success)> operationTiming_;
+
+  /** called with the name of each file the SCP wrote to the storage area,
+   *  once it has its final content, e.g. to copy it to another store. The
+   *  C-STORE fails with "out of resources" if it returns false. Files
+   *  converted by the compression queue are passed again once replaced.
+   *  Empty by default.
+   */
+  std::function<OFBool(const char *filename)> storedFile_;
+
+  /** called with the name of each file before the SCP reads it for a
+   *  C-MOVE or C-GET, e.g. to fetch it from another store if it is not on
+   *  local disk. The file is treated as missing if it returns false. Empty
+   *  by default.
+   */
+  std::function<OFBool(const char *filename)> fetchFile_;
+
+  /** answers the C-FIND requests of the Modality Worklist Information
+   *  Model with the matches of the request identifier, which are sent in
+   *  that order and deleted afterwards. The model is only accepted if set.
+   *  Empty by default.
+   */
+  std::function<void(DcmDataset& query, std::vector<DcmDataset*>& matches)> worklistFind_;
+
+  /** called after the response to each Storage Commitment request with
+   *  the AE title of the requester, the event information of the
+   *  N-EVENT-REPORT it is owed and its event type (1 if all instances are
+   *  committed, 2 if some failed), e.g. to send it over an association of
+   *  its own. Must not block the association for long. The Storage
+   *  Commitment Push Model is only accepted if set. Empty by default.
+   */
+  std::function<void(const char *callingAETitle, const DcmDataset& eventInfo, Uint16 eventTypeID)> storageCommitmentReport_;
+
   // association configuration file name
   OFString associationConfigFile;
 
@@ -0,0 +1,119 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrievePackFile
+ *
+ */
+
+#ifndef DCMQRPCK_H
+#define DCMQRPCK_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftypes.h"
+#include "dcmtk/ofstd/ofstring.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/dcmdata/dctagkey.h"
+#include "dcmtk/dcmqrdb/qrdefine.h"
+
+#include <vector>
+
+class DcmFileFormat;
+
+/** append-only pack files holding the instances of a series. Each instance
+ *  is stored as a record of a 16 byte header, the magic "DCMPACK1" and the
+ *  length of the instance as 64 bit little endian number, followed by the
+ *  bytes of its DICOM file. An instance is referred to by a member name of
+ *  the form "<pack file>#<offset>,<length>", with the offset of its DICOM
+ *  file zero padded so that member names sort in the order of the pack.
+ *  The member names are kept in the index in place of file names, so a
+ *  series is retrieved by reading one file sequentially. Records are never
+ *  rewritten, an instance stored again is appended as a new record.
+ *  All functions are thread safe, appends to the same pack are serialized.
+ */
+class DCMTK_DCMQRDB_EXPORT DcmQueryRetrievePackFile
+{
+public:
+  /** checks whether a file name refers to an instance in a pack file
+   *  @param filename file name as kept in the index
+   *  @return OFTrue if filename is a member name
+   */
+  static OFBool isMember(const char *filename);
+
+  /** splits a member name into its parts
+   *  @param member member name
+   *  @param packFile pack file returned
+   *  @param offset position of the DICOM file of the instance in the pack returned
+   *  @param length length of the DICOM file of the instance returned
+   *  @return OFTrue if member is a valid member name
+   */
+  static OFBool parseMember(const char *member, OFString& packFile, offile_off_t& offset, offile_off_t& length);
+
+  /** returns the file holding the data of an instance, the pack file for a
+   *  member name and the file name itself otherwise
+   *  @param filename file name as kept in the index
+   *  @return file to open, lock or fetch for the instance
+   */
+  static OFString container(const char *filename);
+
+  /** returns the pack file of a series next to a stored instance file
+   *  @param filename file an instance of the series was written to
+   *  @param seriesInstanceUID series instance UID of the instance
+   *  @return pack file of the series in the directory of filename
+   */
+  static OFString packFileOf(const char *filename, const char *seriesInstanceUID);
+
+  /** appends a DICOM file to a pack file, which is created if missing. The
+   *  file itself is left in place.
+   *  @param packFile pack file the instance is appended to
+   *  @param filename DICOM file of the instance
+   *  @param member member name of the appended instance returned
+   *  @return EC_Normal if successful, an error code otherwise. A failed
+   *    append is truncated again.
+   */
+  static OFCondition append(const OFString& packFile, const char *filename, OFString& member);
+
+  /** reads the DICOM file of an instance from its pack file
+   *  @param member member name of the instance
+   *  @param bytes content of the DICOM file returned
+   *  @return EC_Normal if successful, an error code if member does not refer
+   *    to a complete record
+   */
+  static OFCondition read(const char *member, std::vector<char>& bytes);
+
+  /** loads an instance from its pack file
+   *  @param member member name of the instance
+   *  @param fileformat DICOM file the instance is read into
+   *  @param stopParsingAtElement parsing stops at this tag or any higher tag,
+   *    e.g. DCM_PixelData when only the header is needed
+   *  @return EC_Normal if successful, an error code otherwise
+   */
+  static OFCondition load(const char *member, DcmFileFormat& fileformat,
+    const DcmTagKey& stopParsingAtElement = DCM_UndefinedTagKey);
+
+  /** lists the instances of a pack file, e.g. to rebuild the index. The
+   *  listing stops at a record which runs past the end of the file.
+   *  @param packFile pack file
+   *  @param members member names of its instances returned, in the order of
+   *    the pack
+   *  @return EC_Normal if successful, an error code if the file cannot be
+   *    read or is not a pack file
+   */
+  static OFCondition list(const char *packFile, std::vector<OFString>& members);
+
+  /// file name extension of pack files
+  static const char *extension;
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveAssociationPool
+ *
+ */
+
+#ifndef DCMQRPOL_H
+#define DCMQRPOL_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftypes.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/dcmnet/assoc.h"
+#include "dcmtk/dcmqrdb/qrdefine.h"
+
+class DcmQueryRetrieveAssociationPoolPrivate;
+
+/** callback executed by a pool worker for each accepted association.
+ *  The callback takes ownership of the association, i.e. it must drop
+ *  and destroy it before returning.
+ *  @param callbackData opaque pointer passed to DcmQueryRetrieveAssociationPool::submit()
+ *  @param assoc accepted association to be served
+ *  @return EC_Normal if successful, an error code otherwise
+ */
+typedef OFCondition (*DcmQueryRetrieveAssociationHandler)(void *callbackData, T_ASC_Association *assoc);
+
+/** bounded pool of worker threads serving associations in single process mode.
+ *  Accepted associations are queued and picked up by the next idle worker, so
+ *  one long running association (e.g. a slow C-MOVE) does not block the others.
+ *  Worker threads are spawned lazily up to the configured maximum and are joined
+ *  when the pool is destroyed.
+ */
+class DCMTK_DCMQRDB_EXPORT DcmQueryRetrieveAssociationPool
+{
+public:
+  /** constructor
+   *  @param maxWorkers maximum number of worker threads (at least one is used)
+   *  @param maxPending maximum number of associations that can be active or
+   *    queued at the same time, zero for no limit
+   */
+  DcmQueryRetrieveAssociationPool(size_t maxWorkers, size_t maxPending);
+
+  /// destructor, waits for all queued and running associations to terminate
+  virtual ~DcmQueryRetrieveAssociationPool();
+
+  /** hand over an accepted association to the pool.
+   *  @param assoc association to be served
+   *  @param handler callback serving the association in a worker thread
+   *  @param callbackData opaque pointer passed to the callback
+   *  @return OFTrue if the association was queued, OFFalse if the pool is
+   *    saturated or shutting down. In the latter case the caller keeps
+   *    ownership of the association.
+   */
+  OFBool submit(T_ASC_Association *assoc, DcmQueryRetrieveAssociationHandler handler, void *callbackData);
+
+  /** stops accepting associations and waits for the queued and running ones
+   *  to terminate. The connections of those still open after the timeout are
+   *  interrupted, which makes their workers finish right away.
+   *  @param timeout maximum time to wait in milliseconds
+   *  @return OFTrue if all associations terminated in time, OFFalse otherwise
+   */
+  OFBool drain(int timeout);
+
+  /** returns the number of associations currently served by a worker
+   *  @return number of active associations
+   */
+  size_t activeAssociations() const;
+
+  /** returns the number of associations waiting for an idle worker
+   *  @return queue depth
+   */
+  size_t queuedAssociations() const;
+
+  /** returns the number of worker threads spawned so far
+   *  @return number of worker threads
+   */
+  size_t workerThreads() const;
+
+  /** check if another association can be accepted without exceeding the
+   *  configured limit.
+   *  @return OFTrue if the pool is saturated, OFFalse otherwise
+   */
+  OFBool isSaturated() const;
+
+private:
+
+  /// private undefined copy constructor
+  DcmQueryRetrieveAssociationPool(const DcmQueryRetrieveAssociationPool& other);
+
+  /// private undefined assignment operator
+  DcmQueryRetrieveAssociationPool& operator=(const DcmQueryRetrieveAssociationPool& other);
+
+  /// private implementation (worker threads, queue and synchronization)
+  DcmQueryRetrieveAssociationPoolPrivate *d;
+};
+
+#endif
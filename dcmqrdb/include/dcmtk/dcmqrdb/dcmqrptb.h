@@ -39,6 +39,7 @@ END_EXTERN_C
 
 
 class DcmQueryRetrieveProcessSlot;
+class DcmQueryRetrieveConfig;
 
 
 /** this class maintains a table of client processes. For each client process,
@@ -57,8 +58,11 @@ public:
   /** adds a new child process to the process table.
    *  @param pid process ID of the child process
    *  @param assoc peer hostname and AEtitles are read from this object
+   *  @param admitted true if the association was admitted by
+   *    DcmQueryRetrieveConfig::admitAssociation(), the admission is released
+   *    when the child process is cleaned up
    */
-  void addProcessToTable(int pid, T_ASC_Association * assoc);
+  void addProcessToTable(int pid, T_ASC_Association * assoc, OFBool admitted = OFFalse);
 
   /** returns the number of child processes in the table
    *  @return number of child processes
@@ -71,8 +75,10 @@ public:
   /** check if child processes have terminated and, if yes, remove
    *  them from the process table.  This method should be called
    *  regularly.
+   *  @param config configuration whose admissions of the terminated child
+   *    processes are released, NULL if none
    */
-  void cleanChildren();
+  void cleanChildren(const DcmQueryRetrieveConfig *config = NULL);
 
   /** check if we have a child process that has write access to the
    *  given aetitle. Used to enforce an ad-hoc rule that allows only
@@ -85,8 +91,9 @@ private:
 
   /** remove the process with the given process ID from the table
    *  @param pid process ID
+   *  @param config configuration whose admission of the process is released, NULL if none
    */
-  void removeProcessFromTable(int pid);
+  void removeProcessFromTable(int pid, const DcmQueryRetrieveConfig *config);
 
   /// the list of process entries maintained by this object.
   OFList<DcmQueryRetrieveProcessSlot *> table_;
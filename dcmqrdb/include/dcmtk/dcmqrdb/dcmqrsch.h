@@ -0,0 +1,139 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveScheduler
+ *
+ */
+
+#ifndef DCMQRSCH_H
+#define DCMQRSCH_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftypes.h"
+#include "dcmtk/ofstd/oftimer.h"
+#include "dcmtk/dcmnet/dimse.h"
+#include "dcmtk/dcmqrdb/qrdefine.h"
+
+/** weighted fair scheduling of the DIMSE work of all associations of a process.
+ *  Units of work, i.e. a C-MOVE or C-GET sub-operation, a file read ahead for one
+ *  or a file converted by the compression queue, take one of a fixed number of
+ *  slots for their duration. While all slots are taken, units wait in a queue per
+ *  priority class, and a freed slot goes to the class with the smallest virtual
+ *  time, which advances by the inverse of its weight with each grant. So a high
+ *  priority C-MOVE of a radiologist gets most of the slots while a bulk migration
+ *  or a prefetch is running, and the lower classes still progress. A class that
+ *  was idle starts at the current virtual time and cannot save up grants. Within
+ *  a class units are served in order of arrival. Without slots configured units
+ *  never wait. The scheduler is shared by all associations and is thread safe.
+ */
+class DCMTK_DCMQRDB_EXPORT DcmQueryRetrieveScheduler
+{
+public:
+  /// priority classes, from the DIMSE priority of the request or configured per peer
+  enum PriorityClass
+  {
+    /// DIMSE_PRIORITY_HIGH, e.g. interactive retrieves
+    PC_High,
+    /// DIMSE_PRIORITY_MEDIUM, the default of most requesters
+    PC_Medium,
+    /// DIMSE_PRIORITY_LOW, e.g. migrations, prefetches and background compression
+    PC_Low,
+    /// number of classes
+    PC_Count
+  };
+
+  /** callback receiving the time a unit waited for its slot and the time it held
+   *  it, e.g. to record latency histograms per class
+   *  @param priorityClass class of the unit
+   *  @param stage kind of unit, "move", "get", "readAhead" or "compress"
+   *  @param waitSeconds seconds waited for the slot
+   *  @param serviceSeconds seconds the slot was held
+   */
+  typedef void (*TimingCallback)(PriorityClass priorityClass, const char *stage, double waitSeconds, double serviceSeconds);
+
+  /** a slot held from construction to destruction. The constructor blocks while
+   *  all slots are taken by units of the same or more entitled classes.
+   */
+  class DCMTK_DCMQRDB_EXPORT Ticket
+  {
+  public:
+    /** waits for a slot
+     *  @param priorityClass class the unit is scheduled in
+     *  @param stage kind of unit passed to the timing callback, must be a literal
+     */
+    Ticket(PriorityClass priorityClass, const char *stage);
+
+    /// frees the slot
+    ~Ticket();
+
+  private:
+    /// private undefined copy constructor
+    Ticket(const Ticket& other);
+
+    /// private undefined assignment operator
+    Ticket& operator=(const Ticket& other);
+
+    /// class the slot was granted in
+    PriorityClass class_;
+
+    /// kind of unit
+    const char *stage_;
+
+    /// seconds waited for the slot
+    double waitSeconds_;
+
+    /// started when the slot was granted
+    OFTimer timer_;
+  };
+
+  /** sets the number of slots and the weights of the classes, applies to units
+   *  arriving afterwards. Waiting units are admitted if slots were added.
+   *  @param slots number of units running at a time, 0 for no limit
+   *  @param high weight of PC_High, at least 1
+   *  @param medium weight of PC_Medium, at least 1
+   *  @param low weight of PC_Low, at least 1
+   */
+  static void configure(size_t slots, unsigned high = defaultHighWeight, unsigned medium = defaultMediumWeight, unsigned low = defaultLowWeight);
+
+  /** sets the function called for every unit when it frees its slot
+   *  @param callback timing callback, NULL to disable
+   */
+  static void setTimingCallback(TimingCallback callback);
+
+  /** returns the class of a DIMSE priority
+   *  @param priority priority of a request
+   *  @return priority class
+   */
+  static PriorityClass classOf(T_DIMSE_Priority priority);
+
+  /** returns the name of a class
+   *  @param priorityClass class
+   *  @return "high", "medium" or "low"
+   */
+  static const char *name(PriorityClass priorityClass);
+
+  /** returns the number of units waiting for a slot in a class
+   *  @param priorityClass class
+   *  @return number of waiting units
+   */
+  static size_t waiting(PriorityClass priorityClass);
+
+  /// default weights, a high priority unit gets twice the slots of a medium one
+  static const unsigned defaultHighWeight = 8;
+  static const unsigned defaultMediumWeight = 4;
+  static const unsigned defaultLowWeight = 1;
+};
+
+#endif
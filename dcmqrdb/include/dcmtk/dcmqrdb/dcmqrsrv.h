@@ -28,11 +28,14 @@
 #include "dcmtk/dcmnet/dimse.h"
 #include "dcmtk/dcmnet/dcasccfg.h"
 #include "dcmtk/dcmqrdb/dcmqrptb.h"
+#include "dcmtk/dcmqrdb/dcmqrpol.h"
 
 class DcmQueryRetrieveConfig;
 class DcmQueryRetrieveOptions;
 class DcmQueryRetrieveDatabaseHandle;
 class DcmQueryRetrieveDatabaseHandleFactory;
+class DcmQueryRetrieveTranscodeCache;
+class DcmQueryRetrieveCompressionQueue;
 
 /// enumeration describing reasons for refusing an association request
 enum CTN_RefuseReason
@@ -68,8 +71,8 @@ public:
     const DcmQueryRetrieveDatabaseHandleFactory& factory,
     const DcmAssociationConfiguration& associationConfiguration);
 
-  /// destructor
-  virtual ~DcmQueryRetrieveSCP() { }
+  /// destructor, waits for associations still served by the worker pool
+  virtual ~DcmQueryRetrieveSCP();
 
   /** wait for incoming A-ASSOCIATE requests, perform association negotiation
    *  and serve the requests. May fork child processes depending on availability
@@ -91,6 +94,27 @@ public:
    */
   void cleanChildren();
 
+  /** returns the number of associations currently being served, either by
+   *  child processes or by worker threads in single process mode.
+   *  @return number of active associations
+   */
+  size_t activeAssociations() const;
+
+  /** returns the number of acknowledged associations waiting for an idle
+   *  worker thread. Always zero in multi-processing mode.
+   *  @return queue depth
+   */
+  size_t queuedAssociations() const;
+
+  /** waits for the associations being served by worker threads to terminate,
+   *  to be called once waitForAssociation() is no longer called. Connections
+   *  still open after the timeout are interrupted. Child processes in
+   *  multi-processing mode are not waited for.
+   *  @param timeout maximum time to wait in milliseconds
+   *  @return OFTrue if all associations terminated in time, OFFalse otherwise
+   */
+  OFBool drainAssociations(int timeout);
+
 private:
 
   /// private undefined copy constructor
@@ -113,17 +137,41 @@ private:
     T_ASC_Association * assoc,
     OFBool correctUIDPadding);
 
+  /** worker pool callback, serves an association in single process mode
+   *  @param callbackData pointer to the DcmQueryRetrieveSCP instance
+   *  @param assoc association to be served
+   *  @return result of handleAssociation()
+   */
+  static OFCondition associationWorker(void *callbackData, T_ASC_Association *assoc);
+
   OFCondition echoSCP(
     T_ASC_Association * assoc,
     T_DIMSE_C_EchoRQ * req,
     T_ASC_PresentationContextID presId);
 
+  OFCondition actionSCP(
+    T_ASC_Association * assoc,
+    T_DIMSE_N_ActionRQ * request,
+    T_ASC_PresentationContextID presID,
+    DcmQueryRetrieveDatabaseHandle& dbHandle);
+
   OFCondition findSCP(
     T_ASC_Association * assoc,
     T_DIMSE_C_FindRQ * request,
     T_ASC_PresentationContextID presID,
     DcmQueryRetrieveDatabaseHandle& dbHandle);
 
+  /** returns the priority the sub-operations of a C-GET or C-MOVE request are
+   *  scheduled and sent with, the one configured for the calling AE title or
+   *  the one of the request
+   *  @param assoc association the request was received on
+   *  @param requested priority of the request
+   *  @return priority of the sub-operations
+   */
+  T_DIMSE_Priority schedulingPriority(
+    T_ASC_Association * assoc,
+    T_DIMSE_Priority requested) const;
+
   OFCondition getSCP(
     T_ASC_Association * assoc,
     T_DIMSE_C_GetRQ * request,
@@ -136,6 +184,15 @@ private:
     T_ASC_PresentationContextID presID,
     DcmQueryRetrieveDatabaseHandle& dbHandle);
 
+  /** checks whether datasets received on a presentation context are stored in
+   *  the transfer syntax they arrive in, either because it is the write transfer
+   *  syntax or because they are compressed in the background
+   *  @param assoc association
+   *  @param presId presentation context of the C-STORE request
+   *  @return OFTrue if the received byte stream can be written as is
+   */
+  OFBool storesAsReceived(T_ASC_Association * assoc, T_ASC_PresentationContextID presId) const;
+
   OFCondition storeSCP(
     T_ASC_Association * assoc,
     T_DIMSE_C_StoreRQ * req,
@@ -155,6 +212,15 @@ private:
   /// child process table, only used in multi-processing mode
   DcmQueryRetrieveProcessTable processtable_;
 
+  /// worker thread pool, only used in single process mode (created on demand)
+  DcmQueryRetrieveAssociationPool *workerPool_;
+
+  /// cache of instances transcoded for C-MOVE sub-operations, NULL if disabled
+  DcmQueryRetrieveTranscodeCache *transcodeCache_;
+
+  /// stored files waiting for conversion to the write transfer syntax, NULL if disabled
+  DcmQueryRetrieveCompressionQueue *compressionQueue_;
+
   /// flag for database interface: check C-FIND identifier
   OFBool dbCheckFindIdentifier_;
 
@@ -0,0 +1,109 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveTranscodeCache
+ *
+ */
+
+#ifndef DCMQRTCC_H
+#define DCMQRTCC_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftypes.h"
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/ofstring.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+#include "dcmtk/dcmqrdb/qrdefine.h"
+
+class DcmQueryRetrieveTranscodeCachePrivate;
+
+/** bounded on-disk cache of transcoded instances for C-MOVE sub-operations.
+ *  Entries are keyed by (SOP Instance UID, transfer syntax) and stored as DICOM
+ *  files in the cache directory. When the total size exceeds the limit, the least
+ *  recently used entries are deleted, except the ones currently being sent.
+ *  Files left in the directory by an earlier run are picked up on construction.
+ *  The cache is shared by all associations of a process and is thread safe.
+ */
+class DCMTK_DCMQRDB_EXPORT DcmQueryRetrieveTranscodeCache
+{
+public:
+  /** constructor
+   *  @param directory cache directory, created if it does not exist
+   *  @param maxSize maximum total size of the cached files in bytes
+   */
+  DcmQueryRetrieveTranscodeCache(const OFString& directory, size_t maxSize);
+
+  /// destructor, cached files are kept for the next run
+  virtual ~DcmQueryRetrieveTranscodeCache();
+
+  /** returns a file containing the instance in the given transfer syntax.
+   *  On a miss, the source file is transcoded and added to the cache. Concurrent
+   *  requests for an entry being transcoded wait for the first one to finish.
+   *  The entry is pinned until release() is called.
+   *  @param sopInstanceUID SOP Instance UID of the instance
+   *  @param sourceFile file the instance is stored in
+   *  @param xfer transfer syntax the instance is needed in
+   *  @param cachedFile name of the cached file on return
+   *  @return EC_Normal if successful, an error code otherwise
+   */
+  OFCondition acquire(
+    const char *sopInstanceUID,
+    const char *sourceFile,
+    E_TransferSyntax xfer,
+    OFString& cachedFile);
+
+  /** unpins an entry returned by acquire()
+   *  @param cachedFile name of the cached file
+   */
+  void release(const OFString& cachedFile);
+
+  /** returns the number of requests served from the cache
+   *  @return number of cache hits
+   */
+  size_t hits() const;
+
+  /** returns the number of requests that required transcoding
+   *  @return number of cache misses
+   */
+  size_t misses() const;
+
+  /** returns the number of entries deleted to stay within the size limit
+   *  @return number of evictions
+   */
+  size_t evictions() const;
+
+  /** returns the total size of the cached files
+   *  @return size in bytes
+   */
+  size_t size() const;
+
+  /** returns the number of cached entries
+   *  @return number of entries
+   */
+  size_t entries() const;
+
+private:
+
+  /// private undefined copy constructor
+  DcmQueryRetrieveTranscodeCache(const DcmQueryRetrieveTranscodeCache& other);
+
+  /// private undefined assignment operator
+  DcmQueryRetrieveTranscodeCache& operator=(const DcmQueryRetrieveTranscodeCache& other);
+
+  /// private implementation (index, LRU list and synchronization)
+  DcmQueryRetrieveTranscodeCachePrivate *d;
+};
+
+#endif
@@ -29,6 +29,152 @@
 #include "dcmtk/dcmdata/dcfilefo.h"
 #include "dcmtk/dcmqrdb/dcmqrdbs.h"
 #include "dcmtk/dcmqrdb/dcmqrdbi.h"
+#include "dcmtk/ofstd/oftrace.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+
+/** C-FIND responses read from the database by a thread of their own, up to a
+ *  maximum number ahead of the response being sent, so database and network
+ *  work overlap. The database handle is only used by the thread until it is
+ *  stopped. Internal use only.
+ */
+class DcmQueryRetrieveFindPrefetch
+{
+public:
+  DcmQueryRetrieveFindPrefetch(DcmQueryRetrieveDatabaseHandle& handle,
+    const DcmQueryRetrieveCharacterSetOptions& characterSetOptions,
+    DIC_US priorStatus, size_t maxDepth)
+  : dbHandle_(handle)
+  , characterSetOptions_(characterSetOptions)
+  , priorStatus_(priorStatus)
+  , maxDepth_(maxDepth)
+  , association_(OFTraceContext::association())
+  , cancelled_(OFFalse)
+  , finished_(OFFalse)
+  , stopping_(OFFalse)
+  {
+    thread_ = std::thread(&DcmQueryRetrieveFindPrefetch::run, this);
+  }
+
+  ~DcmQueryRetrieveFindPrefetch()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = OFTrue;
+    }
+    cond_.notify_all();
+    thread_.join();
+    clear();
+  }
+
+  /** waits for the next response. Once cancelled, the responses read ahead are
+   *  dropped and the one of the cancelled request follows
+   */
+  void next(OFBool cancelled, DcmDataset **identifiers, DcmQueryRetrieveDatabaseStatus *status)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (cancelled && !cancelled_) {
+      cancelled_ = OFTrue;
+      clear();
+      if (finished_) {
+        /* the database has nothing open any more */
+        push(NULL, DcmQueryRetrieveDatabaseStatus(STATUS_FIND_Cancel_MatchingTerminatedDueToCancelRequest));
+      }
+      cond_.notify_all();
+    }
+    cond_.wait(lock, [this] { return !responses_.empty(); });
+    *identifiers = responses_.front().identifiers;
+    *status = responses_.front().status;
+    responses_.pop_front();
+    cond_.notify_all();
+  }
+
+private:
+  struct Response
+  {
+    DcmDataset *identifiers;
+    DcmQueryRetrieveDatabaseStatus status;
+  };
+
+  /// mutex_ is held
+  void push(DcmDataset *identifiers, const DcmQueryRetrieveDatabaseStatus& status)
+  {
+    Response response = { identifiers, status };
+    responses_.push_back(response);
+    cond_.notify_all();
+  }
+
+  /// drops the responses not taken yet, mutex_ is held or the thread stopped
+  void clear()
+  {
+    for (size_t i = 0; i < responses_.size(); ++i)
+      delete responses_[i].identifiers;
+    responses_.clear();
+  }
+
+  void run()
+  {
+    OFTraceContext context(association_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      if (cancelled_) {
+        lock.unlock();
+        DcmQueryRetrieveDatabaseStatus status(priorStatus_);
+        dbHandle_.cancelFindRequest(&status);
+        lock.lock();
+        push(NULL, status);
+        break;
+      }
+      if (responses_.size() >= maxDepth_) {
+        cond_.wait(lock);
+        continue;
+      }
+      lock.unlock();
+      DcmDataset *identifiers = NULL;
+      DcmQueryRetrieveDatabaseStatus status(priorStatus_);
+      OFCondition dbcond = dbHandle_.nextFindResponse(&identifiers, &status, characterSetOptions_);
+      if (dbcond.bad()) {
+        DCMQRDB_ERROR("findSCP: Database: nextFindResponse Failed ("
+                << DU_cfindStatusString(status.status()) << "):");
+      }
+      lock.lock();
+      const OFBool pending = DICOM_PENDING_STATUS(status.status());
+      if (cancelled_) {
+        /* a pending match is dropped and the request cancelled above */
+        delete identifiers;
+        if (pending) continue;
+        push(NULL, DcmQueryRetrieveDatabaseStatus(STATUS_FIND_Cancel_MatchingTerminatedDueToCancelRequest));
+        break;
+      }
+      push(identifiers, status);
+      if (!pending) break;
+    }
+    finished_ = OFTrue;
+  }
+
+  DcmQueryRetrieveDatabaseHandle& dbHandle_;
+  const DcmQueryRetrieveCharacterSetOptions& characterSetOptions_;
+  const DIC_US priorStatus_;
+  const size_t maxDepth_;
+  const Uint64 association_;
+  std::deque<Response> responses_;
+  OFBool cancelled_;
+  OFBool finished_;
+  OFBool stopping_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread thread_;
+};
+
+
+DcmQueryRetrieveFindContext::~DcmQueryRetrieveFindContext()
+{
+    delete prefetch_;
+}
 
 
 void DcmQueryRetrieveFindContext::callbackHandler(
@@ -43,27 +189,40 @@ void DcmQueryRetrieveFindContext::callbackHandler(
     OFCondition dbcond = EC_Normal;
     DcmQueryRetrieveDatabaseStatus dbStatus(priorStatus);
 
-    if (responseCount == 1) {
-        /* start the database search */
-        DCMQRDB_INFO("Find SCP Request Identifiers:" << OFendl << DcmObject::PrintHelper(*requestIdentifiers));
-        dbcond = dbHandle.startFindRequest(
-            request->AffectedSOPClassUID, requestIdentifiers, &dbStatus);
-        if (dbcond.bad()) {
-            DCMQRDB_ERROR("findSCP: Database: startFindRequest Failed ("
-                    << DU_cfindStatusString(dbStatus.status()) << "):");
+    if (prefetch_ != NULL) {
+        /* the response has been read ahead while the previous ones were sent */
+        prefetch_->next(cancelled, responseIdentifiers, &dbStatus);
+    } else {
+        if (responseCount == 1) {
+            /* start the database search */
+            DCMQRDB_INFO("Find SCP Request Identifiers:" << OFendl << DcmObject::PrintHelper(*requestIdentifiers));
+            dbcond = dbHandle.startFindRequest(
+                request->AffectedSOPClassUID, requestIdentifiers, &dbStatus);
+            if (dbcond.bad()) {
+                DCMQRDB_ERROR("findSCP: Database: startFindRequest Failed ("
+                        << DU_cfindStatusString(dbStatus.status()) << "):");
+            }
         }
-    }
 
-    /* only cancel if we have pending responses */
-    if (cancelled && DICOM_PENDING_STATUS(dbStatus.status())) {
-        dbHandle.cancelFindRequest(&dbStatus);
-    }
+        /* only cancel if we have pending responses */
+        if (cancelled && DICOM_PENDING_STATUS(dbStatus.status())) {
+            dbHandle.cancelFindRequest(&dbStatus);
+        }
+
+        if (DICOM_PENDING_STATUS(dbStatus.status())) {
+            dbcond = dbHandle.nextFindResponse(responseIdentifiers, &dbStatus, characterSetOptions);
+            if (dbcond.bad()) {
+                 DCMQRDB_ERROR("findSCP: Database: nextFindResponse Failed ("
+                         << DU_cfindStatusString(dbStatus.status()) << "):");
+            }
+        }
 
-    if (DICOM_PENDING_STATUS(dbStatus.status())) {
-        dbcond = dbHandle.nextFindResponse(responseIdentifiers, &dbStatus, characterSetOptions);
-        if (dbcond.bad()) {
-             DCMQRDB_ERROR("findSCP: Database: nextFindResponse Failed ("
-                     << DU_cfindStatusString(dbStatus.status()) << "):");
+        /* once a query has a second match, the rest are read while the responses are sent.
+         * Queries with at most one match never start the thread.
+         */
+        if (responseCount > 1 && options_.findReadAhead_ > 0 && DICOM_PENDING_STATUS(dbStatus.status())) {
+            prefetch_ = new DcmQueryRetrieveFindPrefetch(dbHandle, characterSetOptions, priorStatus,
+                OFstatic_cast(size_t, options_.findReadAhead_));
         }
     }
 
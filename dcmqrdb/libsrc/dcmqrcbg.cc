@@ -30,7 +30,12 @@
 #include "dcmtk/dcmdata/dcfilefo.h"
 #include "dcmtk/dcmqrdb/dcmqrdbs.h"
 #include "dcmtk/dcmqrdb/dcmqrdbi.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
 #include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/oftimer.h"
+#include "dcmtk/ofstd/oftrace.h"
+#include "dcmqrsub.h"
 
 BEGIN_EXTERN_C
 #ifdef HAVE_FCNTL_H
@@ -88,19 +93,26 @@ void DcmQueryRetrieveGetContext::callbackHandler(
                 << DU_cmoveStatusString(dbStatus.status()) << "): "
                 << DimseCondition::dump(temp_str, dbcond));
         }
+        if (dbStatus.status() == STATUS_Pending) {
+            startSubOperations();
+        }
     }
 
     /* only cancel if we have pending status */
     if (cancelled && dbStatus.status() == STATUS_Pending) {
         dbHandle.cancelMoveRequest(&dbStatus);
+        /* sub-operations read ahead but not started are reported as remaining */
+        if (prefetch) nRemaining = OFstatic_cast(DIC_US, nRemaining + prefetch->clear());
     }
 
     if (dbStatus.status() == STATUS_Pending) {
-        getNextImage(&dbStatus);
+        getNextImages(&dbStatus);
     }
 
     if (dbStatus.status() != STATUS_Pending) {
 
+        endSubOperations();
+
         /*
          * Need to adjust the final status if any sub-operations failed or
          * had warnings
@@ -130,9 +142,9 @@ void DcmQueryRetrieveGetContext::callbackHandler(
         buildFailedInstanceList(responseIdentifiers);
     }
 
-    /* set response status */
+    /* set response status, sub-operations read ahead count as remaining */
     response->DimseStatus = dbStatus.status();
-    response->NumberOfRemainingSubOperations = nRemaining;
+    response->NumberOfRemainingSubOperations = OFstatic_cast(DIC_US, nRemaining + (prefetch ? prefetch->queued() : 0));
     response->NumberOfCompletedSubOperations = nCompleted;
     response->NumberOfFailedSubOperations = nFailed;
     response->NumberOfWarningSubOperations = nWarning;
@@ -140,6 +152,11 @@ void DcmQueryRetrieveGetContext::callbackHandler(
 
 }
 
+DcmQueryRetrieveGetContext::~DcmQueryRetrieveGetContext()
+{
+    endSubOperations();
+}
+
 void DcmQueryRetrieveGetContext::addFailedUIDInstance(const char *sopInstance)
 {
     size_t len;
@@ -163,41 +180,74 @@ void DcmQueryRetrieveGetContext::addFailedUIDInstance(const char *sopInstance)
     }
 }
 
-OFCondition DcmQueryRetrieveGetContext::performGetSubOp(DIC_UI sopClass, DIC_UI sopInstance, char *fname)
+void DcmQueryRetrieveGetContext::subOpFailed(const char *sopInstance)
+{
+    nFailed++;
+    addFailedUIDInstance(sopInstance);
+}
+
+void DcmQueryRetrieveGetContext::startSubOperations()
+{
+    /* the number of C-STORE requests the requestor performs asynchronously, as granted
+     * during association negotiation, 0 if no window was negotiated */
+    const unsigned short window = origAssoc->params->DULparams.maximumOperationsPerformed;
+    subOps = new DcmQueryRetrieveMoveSubOps(OFstatic_cast(size_t, window));
+    if (subOps->window_ > 1) {
+        DCMQRDB_DEBUG("Get SCP: up to " << subOps->window_ << " outstanding sub-operations on the association");
+    }
+    if (options_.moveReadAhead_ > 0) {
+        prefetch = new DcmQueryRetrieveMovePrefetch(OFstatic_cast(size_t, options_.moveReadAhead_), options_.fetchFile_,
+            DcmQueryRetrieveScheduler::classOf(priority), "get.readAhead");
+    }
+}
+
+void DcmQueryRetrieveGetContext::endSubOperations()
+{
+    if (prefetch != NULL) {
+        nRemaining = OFstatic_cast(DIC_US, nRemaining + prefetch->clear());
+        delete prefetch;
+        prefetch = NULL;
+    }
+
+    if (subOps != NULL) {
+        completeGetSubOps();
+        delete subOps;
+        subOps = NULL;
+    }
+}
+
+OFCondition DcmQueryRetrieveGetContext::performGetSubOp(const char *sopClass, const char *sopInstance, const char *fname)
 {
     OFCondition cond = EC_Normal;
     T_DIMSE_C_StoreRQ req;
-    T_DIMSE_C_StoreRSP rsp;
     DIC_US msgId;
     T_ASC_PresentationContextID presId;
-    DcmDataset *stDetail = NULL;
-
-#ifdef LOCK_IMAGE_FILES
-    /* shared lock image file */
-    int lockfd;
-#ifdef O_BINARY
-    lockfd = open(fname, O_RDONLY | O_BINARY, 0666);
-#else
-    lockfd = open(fname, O_RDONLY , 0666);
-#endif
-    if (lockfd < 0) {
-        /* due to quota system the file could have been deleted */
-        DCMQRDB_ERROR("Get SCP: storeSCU: [file: " << fname << "]: " << OFStandard::getLastSystemErrorCode().message());
-        nFailed++;
-        addFailedUIDInstance(sopInstance);
+    OFTraceContext context(0, sopInstance);
+    OFTraceSpan span("get.subOperation");
+    DcmQueryRetrieveScheduler::Ticket ticket(DcmQueryRetrieveScheduler::classOf(priority), "get");
+
+    /* an instance in a pack file is fetched and locked with its pack */
+    const OFString storedFile = DcmQueryRetrievePackFile::container(fname);
+    if (options_.fetchFile_ && !options_.fetchFile_(storedFile.c_str())) {
+        DCMQRDB_ERROR("Get SCP: storeSCU: [file: " << fname << "]: cannot be fetched from the storage backend");
+        subOpFailed(sopInstance);
         return EC_Normal;
     }
-    dcmtk_flock(lockfd, LOCK_SH);
-#endif
 
-    msgId = origAssoc->nextMsgID++;
+    /* and sent from the dataset read at its offset */
+    DcmFileFormat packed;
+    const OFBool isPacked = DcmQueryRetrievePackFile::isMember(fname);
+    if (isPacked && (cond = DcmQueryRetrievePackFile::load(fname, packed)).bad()) {
+        DCMQRDB_ERROR("Get SCP: storeSCU: [file: " << fname << "]: cannot be read from the pack file: " << cond.text());
+        subOpFailed(sopInstance);
+        return EC_Normal;
+    }
 
     /* which presentation context should be used */
     presId = ASC_findAcceptedPresentationContextID(origAssoc,
         sopClass);
     if (presId == 0) {
-        nFailed++;
-        addFailedUIDInstance(sopInstance);
+        subOpFailed(sopInstance);
         DCMQRDB_ERROR("Get SCP: storeSCU: [file: " << fname << "] No presentation context for: ("
             << dcmSOPClassUIDToModality(sopClass, "OT") << ") " << sopClass);
         return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
@@ -208,14 +258,32 @@ OFCondition DcmQueryRetrieveGetContext::performGetSubOp(DIC_UI sopClass, DIC_UI
         /* the acceptedRole is the association requestor role */
         if ((pc.acceptedRole != ASC_SC_ROLE_SCP) && (pc.acceptedRole != ASC_SC_ROLE_SCUSCP)) {
             /* the role is not appropriate */
-            nFailed++;
-            addFailedUIDInstance(sopInstance);
+            subOpFailed(sopInstance);
             DCMQRDB_ERROR("Get SCP: storeSCU: [file: " << fname << "] No presentation context with requestor SCP role for: ("
                 << dcmSOPClassUIDToModality(sopClass, "OT") << ") " << sopClass);
             return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
         }
     }
 
+#ifdef LOCK_IMAGE_FILES
+    /* shared lock image file */
+    int lockfd;
+#ifdef O_BINARY
+    lockfd = open(storedFile.c_str(), O_RDONLY | O_BINARY, 0666);
+#else
+    lockfd = open(storedFile.c_str(), O_RDONLY , 0666);
+#endif
+    if (lockfd < 0) {
+        /* due to quota system the file could have been deleted */
+        DCMQRDB_ERROR("Get SCP: storeSCU: [file: " << fname << "]: " << OFStandard::getLastSystemErrorCode().message());
+        subOpFailed(sopInstance);
+        return EC_Normal;
+    }
+    dcmtk_flock(lockfd, LOCK_SH);
+#endif
+
+    msgId = origAssoc->nextMsgID++;
+
     req.MessageID = msgId;
     OFStandard::strlcpy(req.AffectedSOPClassUID, sopClass, DIC_UI_LEN + 1);
     OFStandard::strlcpy(req.AffectedSOPInstanceUID, sopInstance, DIC_UI_LEN + 1);
@@ -226,58 +294,159 @@ OFCondition DcmQueryRetrieveGetContext::performGetSubOp(DIC_UI sopClass, DIC_UI
     DCMQRDB_INFO("Store SCU RQ: MsgID " << msgId << ", ("
         << dcmSOPClassUIDToModality(sopClass, "OT") << ")");
 
-    T_DIMSE_DetectedCancelParameters cancelParameters;
+    /* the response is received once the window of outstanding sub-operations is full */
+    cond = DIMSE_sendStoreRequest(origAssoc, presId, &req,
+        isPacked ? NULL : fname, isPacked ? packed.getDataset() : NULL, getSubOpProgressCallback, this);
+
+    DcmQueryRetrieveMoveSubOp subOp;
+    subOp.msgId = msgId;
+    subOp.sopInstance = sopInstance;
+    subOp.sendFile = fname;
+    subOp.cached = OFFalse;
+#ifdef LOCK_IMAGE_FILES
+    subOp.lockfd = lockfd;
+#endif
+    subOps->pending_.push_back(subOp);
 
-    cond = DIMSE_storeUser(origAssoc, presId, &req,
-        fname, NULL, getSubOpProgressCallback, this, options_.blockMode_, options_.dimse_timeout_,
-        &rsp, &stDetail, &cancelParameters);
+    if (cond.bad()) {
+        /* the association is unusable, fail this and all outstanding sub-operations */
+        OFString temp_str;
+        DCMQRDB_ERROR("Get SCP: storeSCU: Store Request Failed: " << DimseCondition::dump(temp_str, cond));
+        failGetSubOps();
+        return cond;
+    }
+
+    while (cond.good() && subOps->pending_.size() >= subOps->window_) {
+        cond = receiveGetSubOpResponse();
+    }
+    return cond;
+}
 
+/* releases the file of a sub-operation whose response was received or which failed */
+static void releaseGetSubOp(const DcmQueryRetrieveMoveSubOp& subOp)
+{
 #ifdef LOCK_IMAGE_FILES
     /* unlock image file */
-    dcmtk_flock(lockfd, LOCK_UN);
-    close(lockfd);
+    dcmtk_flock(subOp.lockfd, LOCK_UN);
+    close(subOp.lockfd);
+#else
+    (void) subOp;
 #endif
+}
+
+OFCondition DcmQueryRetrieveGetContext::receiveGetSubOpResponse()
+{
+    T_DIMSE_C_StoreRSP rsp;
+    T_ASC_PresentationContextID presId = 0;
+    DcmDataset *stDetail = NULL;
+    T_DIMSE_DetectedCancelParameters cancelParameters;
+    OFString temp_str;
 
+    OFCondition cond;
+    {
+        OFTraceSpan span("get.receiveResponse");
+        cond = DIMSE_receiveStoreResponse(origAssoc,
+            options_.blockMode_, options_.dimse_timeout_, &presId, &rsp, &stDetail, &cancelParameters);
+    }
+
+    /* a C-CANCEL-RQ arrives between the C-STORE responses on the same association */
+    if (cond.good() && cancelParameters.cancelEncountered) {
+        if (origPresId == cancelParameters.presId &&
+            origMsgId == cancelParameters.req.MessageIDBeingRespondedTo) {
+            getCancelled = OFTrue;
+        } else {
+            DCMQRDB_ERROR("Get SCP: Unexpected C-Cancel-RQ encountered: pid=" << (int)cancelParameters.presId
+                << ", mid=" << (int)cancelParameters.req.MessageIDBeingRespondedTo);
+        }
+    }
+
+    /* responses are matched to the outstanding sub-operations by message ID */
+    std::deque<DcmQueryRetrieveMoveSubOp>::iterator it = subOps->pending_.end();
     if (cond.good()) {
-        if (cancelParameters.cancelEncountered) {
-            if (origPresId == cancelParameters.presId &&
-                origMsgId == cancelParameters.req.MessageIDBeingRespondedTo) {
-                getCancelled = OFTrue;
-            } else {
-                DCMQRDB_ERROR("Get SCP: Unexpected C-Cancel-RQ encountered: pid=" << (int)cancelParameters.presId
-                    << ", mid=" << (int)cancelParameters.req.MessageIDBeingRespondedTo);
-            }
+        for (it = subOps->pending_.begin(); it != subOps->pending_.end(); ++it) {
+            if (it->msgId == rsp.MessageIDBeingRespondedTo) break;
         }
-        DCMQRDB_INFO("Get SCP: Received Store SCU RSP [Status="
-            << DU_cstoreStatusString(rsp.DimseStatus) << "]");
-        if (rsp.DimseStatus == STATUS_Success) {
-            /* everything ok */
-            nCompleted++;
-        } else if (DICOM_WARNING_STATUS(rsp.DimseStatus)) {
-            /* a warning status message */
-            nWarning++;
-            DCMQRDB_ERROR("Get SCP: Store Warning: Response Status: " <<
-                DU_cstoreStatusString(rsp.DimseStatus));
-        } else {
-            nFailed++;
-            addFailedUIDInstance(sopInstance);
-            /* print a status message */
-            DCMQRDB_ERROR("Get SCP: Store Failed: Response Status: "
-                << DU_cstoreStatusString(rsp.DimseStatus));
+        if (it == subOps->pending_.end()) {
+            char buf[256];
+            sprintf(buf, "DIMSE: Unexpected Response MsgId: %d", rsp.MessageIDBeingRespondedTo);
+            cond = makeDcmnetCondition(DIMSEC_UNEXPECTEDRESPONSE, OF_error, buf);
         }
-    } else {
-        nFailed++;
-        addFailedUIDInstance(sopInstance);
-        OFString temp_str;
+    }
+
+    if (cond.bad()) {
+        /* the outstanding sub-operations cannot complete any more */
         DCMQRDB_ERROR("Get SCP: storeSCU: Store Request Failed: " << DimseCondition::dump(temp_str, cond));
+        failGetSubOps();
+        delete stDetail;
+        return cond;
+    }
+
+    DcmQueryRetrieveMoveSubOp subOp = *it;
+    subOps->pending_.erase(it);
+    subOps->completed_++;
+    releaseGetSubOp(subOp);
+
+    DCMQRDB_INFO("Get SCP: Received Store SCU RSP [MsgID " << subOp.msgId << ", Status="
+        << DU_cstoreStatusString(rsp.DimseStatus) << "]");
+    if (rsp.DimseStatus == STATUS_Success) {
+        /* everything ok */
+        nCompleted++;
+    } else if (DICOM_WARNING_STATUS(rsp.DimseStatus)) {
+        /* a warning status message */
+        nWarning++;
+        DCMQRDB_ERROR("Get SCP: Store Warning: Response Status: " <<
+            DU_cstoreStatusString(rsp.DimseStatus));
+    } else {
+        subOpFailed(subOp.sopInstance.c_str());
+        /* print a status message */
+        DCMQRDB_ERROR("Get SCP: Store Failed: Response Status: "
+            << DU_cstoreStatusString(rsp.DimseStatus));
     }
-    if (stDetail) {
+    if (stDetail != NULL) {
         DCMQRDB_INFO("  Status Detail:" << OFendl << DcmObject::PrintHelper(*stDetail));
         delete stDetail;
     }
     return cond;
 }
 
+void DcmQueryRetrieveGetContext::failGetSubOps()
+{
+    while (!subOps->pending_.empty()) {
+        subOpFailed(subOps->pending_.front().sopInstance.c_str());
+        releaseGetSubOp(subOps->pending_.front());
+        subOps->pending_.pop_front();
+        subOps->completed_++;
+    }
+}
+
+void DcmQueryRetrieveGetContext::completeGetSubOps()
+{
+    /* a failed receive fails all outstanding sub-operations and empties the list */
+    while (!subOps->pending_.empty()) {
+        receiveGetSubOpResponse();
+    }
+}
+
+void DcmQueryRetrieveGetContext::getNextImages(DcmQueryRetrieveDatabaseStatus * dbStatus)
+{
+    /* the sub-operations stream on the association up to the window, several windows
+     * per C-GET-RSP. All responses are received before it is sent, as the provider
+     * checks for a C-CANCEL-RQ in between, which must not consume a C-STORE-RSP
+     */
+    const size_t batch = subOps->window_ > 1 ? 4 * subOps->window_ : 1;
+    for (size_t started = 0; started < batch && dbStatus->status() == STATUS_Pending && !getCancelled; ++started) {
+        getNextImage(dbStatus);
+    }
+    completeGetSubOps();
+
+    if (getCancelled) {
+        /* sub-operations read ahead but not started are reported as remaining */
+        if (prefetch) nRemaining = OFstatic_cast(DIC_US, nRemaining + prefetch->clear());
+        dbStatus->setStatus(STATUS_GET_Cancel_SubOperationsTerminatedDueToCancelIndication);
+        DCMQRDB_INFO("Get SCP: Received C-Cancel RQ");
+    }
+}
+
 void DcmQueryRetrieveGetContext::getNextImage(DcmQueryRetrieveDatabaseStatus * dbStatus)
 {
     OFCondition cond = EC_Normal;
@@ -286,6 +455,11 @@ void DcmQueryRetrieveGetContext::getNextImage(DcmQueryRetrieveDatabaseStatus * d
     DIC_UI subImgSOPInstance;   /* sub-operation image SOP Instance */
     char subImgFileName[MAXPATHLEN + 1];    /* sub-operation image file */
 
+    if (prefetch) {
+        getNextPrefetchedImage(dbStatus);
+        return;
+    }
+
     /* clear out strings */
     bzero(subImgFileName, sizeof(subImgFileName));
     bzero(subImgSOPClass, sizeof(subImgSOPClass));
@@ -302,17 +476,65 @@ void DcmQueryRetrieveGetContext::getNextImage(DcmQueryRetrieveDatabaseStatus * d
     if (dbStatus->status() == STATUS_Pending) {
         /* perform sub-op */
         cond = performGetSubOp(subImgSOPClass, subImgSOPInstance, subImgFileName);
+        if (cond != EC_Normal) {
+            OFString temp_str;
+            DCMQRDB_ERROR("getSCP: Get Sub-Op Failed: " << DimseCondition::dump(temp_str, cond));
+            /* clear condition stack */
+        }
+    }
+}
 
-        if (getCancelled) {
-            dbStatus->setStatus(STATUS_GET_Cancel_SubOperationsTerminatedDueToCancelIndication);
-            DCMQRDB_INFO("Get SCP: Received C-Cancel RQ");
-       }
+void DcmQueryRetrieveGetContext::getNextPrefetchedImage(DcmQueryRetrieveDatabaseStatus * dbStatus)
+{
+    OFCondition dbcond = EC_Normal;
+    DIC_UI subImgSOPClass;      /* sub-operation image SOP Class */
+    DIC_UI subImgSOPInstance;   /* sub-operation image SOP Instance */
+    char subImgFileName[MAXPATHLEN + 1];    /* sub-operation image file */
 
+    /* fetch jobs from the database until the read-ahead depth is reached */
+    while (!prefetch->exhausted_ && prefetch->queued() < prefetch->depth()) {
+        /* clear out strings */
+        bzero(subImgFileName, sizeof(subImgFileName));
+        bzero(subImgSOPClass, sizeof(subImgSOPClass));
+        bzero(subImgSOPInstance, sizeof(subImgSOPInstance));
+
+        /* get DB response */
+        dbcond = dbHandle.nextMoveResponse(
+            subImgSOPClass, sizeof(subImgSOPClass), subImgSOPInstance, sizeof(subImgSOPInstance), subImgFileName, sizeof(subImgFileName), &nRemaining, dbStatus);
+        if (dbcond.bad()) {
+            DCMQRDB_ERROR("getSCP: Database: nextMoveResponse Failed ("
+                    << DU_cmoveStatusString(dbStatus->status()) << "):");
+        }
+        if (dbStatus->status() != STATUS_Pending) {
+            prefetch->exhausted_ = OFTrue;
+            break;
+        }
+
+        DcmQueryRetrieveMoveJob job;
+        job.sopClass = subImgSOPClass;
+        job.sopInstance = subImgSOPInstance;
+        job.filename = subImgFileName;
+        prefetch->push(job);
+    }
+
+    if (prefetch->exhausted_ && dbStatus->status() != STATUS_Pending && dbStatus->status() != STATUS_Success) {
+        /* the database failed, the sub-operations read ahead are not started and reported as remaining */
+        nRemaining = OFstatic_cast(DIC_US, nRemaining + prefetch->clear());
+        return;
+    }
+
+    DcmQueryRetrieveMoveJob job;
+    if (prefetch->pop(job)) {
+        /* perform sub-op */
+        OFTimer timer;
+        OFCondition cond = performGetSubOp(job.sopClass.c_str(), job.sopInstance.c_str(), job.filename.c_str());
+        prefetch->sent(timer.getDiff());
         if (cond != EC_Normal) {
             OFString temp_str;
             DCMQRDB_ERROR("getSCP: Get Sub-Op Failed: " << DimseCondition::dump(temp_str, cond));
-            /* clear condition stack */
         }
+        /* the final status of the database applies once all jobs read ahead are sent */
+        dbStatus->setStatus(prefetch->exhausted_ && prefetch->queued() == 0 ? STATUS_Success : STATUS_Pending);
     }
 }
 
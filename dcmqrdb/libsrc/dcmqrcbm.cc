@@ -29,9 +29,16 @@
 #include "dcmtk/dcmnet/diutil.h"
 #include "dcmtk/dcmnet/dimse.h"       /* for DICOM_WARNING_STATUS */
 #include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcmetinf.h"
 #include "dcmtk/dcmqrdb/dcmqrdbs.h"
 #include "dcmtk/dcmqrdb/dcmqrdbi.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
+#include "dcmtk/dcmqrdb/dcmqrtcc.h"
+#include "dcmqrsub.h"
 #include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/oftimer.h"
+#include "dcmtk/ofstd/oftrace.h"
 
 BEGIN_EXTERN_C
 #ifdef HAVE_FCNTL_H
@@ -39,12 +46,73 @@ BEGIN_EXTERN_C
 #endif
 END_EXTERN_C
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 
-static void moveSubOpProgressCallback(void * /* callbackData */,
+/** threads performing C-MOVE sub-operations over parallel sub-associations.
+ *  Jobs are fetched from the database by the thread running the move provider
+ *  and taken from a shared queue by one thread per sub-association. Internal use only.
+ */
+class DcmQueryRetrieveMoveWorkers
+{
+public:
+  DcmQueryRetrieveMoveWorkers()
+  : inFlight_(0)
+  , finished_(0)
+  , stopping_(OFFalse)
+  {
+  }
+
+  /// number of sub-operations fetched from the database but not yet completed
+  size_t outstanding() const
+  {
+    return queue_.size() + inFlight_;
+  }
+
+  /// sub-associations, the first one is the context's subAssoc
+  std::vector<T_ASC_Association *> assocs_;
+  std::vector<std::thread> threads_;
+  std::deque<DcmQueryRetrieveMoveJob> queue_;
+  size_t inFlight_;
+
+  /// sub-operations completed since the last C-MOVE-RSP
+  size_t finished_;
+  OFBool stopping_;
+
+  /// protects the members above and the counters of the move context
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable finishedCond_;
+};
+
+static void moveSubOpProgressCallback(void * callbackData,
     T_DIMSE_StoreProgress *progress,
     T_DIMSE_C_StoreRQ * /*req*/)
 {
-  //DcmQueryRetrieveMoveContext *context = OFstatic_cast(DcmQueryRetrieveMoveContext *, callbackData);
+  DcmQueryRetrieveMoveContext *context = OFstatic_cast(DcmQueryRetrieveMoveContext *, callbackData);
+  /* the sub-associations send on their own threads */
+  static thread_local OFTimer sendTimer;
+  static thread_local Uint64 sentBytes = 0;
+  if (progress->state == DIMSE_StoreBegin)
+  {
+    sendTimer.reset();
+    sentBytes = 0;
+  }
+  else if (progress->state == DIMSE_StoreEnd)
+    context->subOpSent(OFstatic_cast(Uint64, progress->progressBytes), sendTimer.getDiff());
+  else if (OFstatic_cast(Uint64, progress->progressBytes) > sentBytes)
+  {
+    /* shape the outbound bandwidth fragment by fragment */
+    context->subOpSending(OFstatic_cast(Uint64, progress->progressBytes) - sentBytes);
+    sentBytes = OFstatic_cast(Uint64, progress->progressBytes);
+  }
   // We can't use oflog for the pdu output, but we use a special logger for
   // generating this output. If it is set to level "INFO" we generate the
   // output, if it's set to "DEBUG" then we'll assume that there is debug output
@@ -90,6 +158,17 @@ void DcmQueryRetrieveMoveContext::callbackHandler(
                 << DU_cmoveStatusString(dbStatus.status()) << "):");
         }
 
+        if (dbStatus.status() == STATUS_Pending) {
+            /* instances that other SCPs hold locally are moved by them, after the local ones */
+            dbHandle.takeForwardedMoves(forwardedMoves, &dbStatus);
+            for (OFListIterator(DcmQueryRetrieveForwardedMove) it = forwardedMoves.begin(); it != forwardedMoves.end(); ++it) {
+                forwardedRemaining += it->sopInstanceUIDs.size();
+            }
+            if (!forwardedMoves.empty()) {
+                OFStandard::strlcpy(dstAETitle, request->MoveDestination, DIC_AE_LEN + 1);
+            }
+        }
+
         if (dbStatus.status() == STATUS_Pending) {
             /* If we are going to be performing sub-operations, build
              * a new association to the move destination.
@@ -107,10 +186,34 @@ void DcmQueryRetrieveMoveContext::callbackHandler(
     /* only cancel if we have pending status */
     if (cancelled && dbStatus.status() == STATUS_Pending) {
         dbHandle.cancelMoveRequest(&dbStatus);
+        /* sub-operations read ahead but not started are reported as remaining */
+        if (prefetch) nRemaining = OFstatic_cast(DIC_US, nRemaining + prefetch->clear());
+    }
+
+    /* forwarded moves not started yet are reported as remaining */
+    if (cancelled && !forwardedMoves.empty()) {
+        nRemaining = OFstatic_cast(DIC_US, nRemaining + forwardedRemaining);
+        forwardedMoves.clear();
+        forwardedRemaining = 0;
+        if (forwarding) dbStatus.setStatus(STATUS_MOVE_Cancel_SubOperationsTerminatedDueToCancelIndication);
     }
 
     if (dbStatus.status() == STATUS_Pending) {
-        moveNextImage(&dbStatus);
+        if (forwarding) {
+            forwardNextMove(&dbStatus);
+        } else if (workers) {
+            moveNextImages(&dbStatus);
+        } else {
+            moveNextImage(&dbStatus);
+        }
+    }
+
+    /* the local sub-operations are done, the C-MOVE is forwarded for the other instances */
+    if (!forwarding && !forwardedMoves.empty() && (dbStatus.status() == STATUS_Success ||
+        dbStatus.status() == STATUS_MOVE_Warning_SubOperationsCompleteOneOrMoreFailures)) {
+        closeSubAssociation();
+        forwarding = OFTrue;
+        dbStatus.setStatus(STATUS_Pending);
     }
 
     if (dbStatus.status() != STATUS_Pending) {
@@ -119,6 +222,13 @@ void DcmQueryRetrieveMoveContext::callbackHandler(
          */
         closeSubAssociation();
 
+        if (transcodeCache) {
+            DCMQRDB_DEBUG("Transcode cache: " << transcodeCache->hits() << " hits, "
+                << transcodeCache->misses() << " misses, " << transcodeCache->evictions()
+                << " evictions, " << transcodeCache->entries() << " files ("
+                << transcodeCache->size() << " bytes)");
+        }
+
         /*
          * Need to adjust the final status if any sub-operations failed or
          * had warnings
@@ -147,15 +257,44 @@ void DcmQueryRetrieveMoveContext::callbackHandler(
 
     /* set response status */
     response->DimseStatus = dbStatus.status();
-    response->NumberOfRemainingSubOperations = nRemaining;
-    response->NumberOfCompletedSubOperations = nCompleted;
-    response->NumberOfFailedSubOperations = nFailed;
-    response->NumberOfWarningSubOperations = nWarning;
+    if (workers) {
+        /* sub-operations still queued or in flight count as remaining */
+        std::lock_guard<std::mutex> lock(workers->mutex_);
+        response->NumberOfRemainingSubOperations = OFstatic_cast(DIC_US, nRemaining + workers->outstanding() + forwardedRemaining);
+        response->NumberOfCompletedSubOperations = nCompleted;
+        response->NumberOfFailedSubOperations = nFailed;
+        response->NumberOfWarningSubOperations = nWarning;
+    } else {
+        /* sub-operations awaiting their response or read ahead count as remaining */
+        const size_t inFlight = (subOps ? subOps->pending_.size() : 0) + (prefetch ? prefetch->queued() : 0);
+        response->NumberOfRemainingSubOperations = OFstatic_cast(DIC_US, nRemaining + inFlight + forwardedRemaining);
+        response->NumberOfCompletedSubOperations = nCompleted;
+        response->NumberOfFailedSubOperations = nFailed;
+        response->NumberOfWarningSubOperations = nWarning;
+    }
     *stDetail = dbStatus.extractStatusDetail();
 
+    /* report the progress of the sub-operations */
+    DcmQueryRetrieveMoveProgress progress;
+    progress.requestorAETitle = origAETitle;
+    progress.destinationAETitle = dstAETitle;
+    progress.status = response->DimseStatus;
+    progress.remaining = response->NumberOfRemainingSubOperations;
+    progress.completed = response->NumberOfCompletedSubOperations;
+    progress.failed = response->NumberOfFailedSubOperations;
+    progress.warning = response->NumberOfWarningSubOperations;
+    progress.elapsed = timer.getDiff();
+    const unsigned long done = progress.completed + progress.failed + progress.warning;
+
     OFString str;
     DCMQRDB_INFO("Move SCP Response " << responseCount << " [status: "
-            << DU_cmoveStatusString(dbStatus.status()) << "]");
+            << DU_cmoveStatusString(dbStatus.status()) << ", remaining: " << progress.remaining
+            << ", completed: " << progress.completed << ", failed: " << progress.failed
+            << ", warning: " << progress.warning << ", " << done << " sub-operations in "
+            << progress.elapsed << " s]");
+    if (options_.moveProgress_) {
+        options_.moveProgress_(progress);
+    }
     DCMQRDB_DEBUG(DIMSE_dumpMessage(str, *response, DIMSE_OUTGOING));
     if (DICOM_PENDING_STATUS(dbStatus.status()) && (*responseIdentifiers != NULL)) {
         DCMQRDB_DEBUG("Move SCP Response Identifiers:" << OFendl << DcmObject::PrintHelper(**responseIdentifiers));
@@ -188,44 +327,97 @@ void DcmQueryRetrieveMoveContext::addFailedUIDInstance(const char *sopInstance)
     }
 }
 
-OFCondition DcmQueryRetrieveMoveContext::performMoveSubOp(DIC_UI sopClass, DIC_UI sopInstance, char *fname)
+DcmQueryRetrieveMoveContext::~DcmQueryRetrieveMoveContext()
+{
+    closeSubAssociation();
+}
+
+void DcmQueryRetrieveMoveContext::subOpCompleted()
+{
+    if (workers) {
+        std::lock_guard<std::mutex> lock(workers->mutex_);
+        nCompleted++;
+    } else {
+        nCompleted++;
+    }
+}
+
+void DcmQueryRetrieveMoveContext::subOpWarning()
+{
+    if (workers) {
+        std::lock_guard<std::mutex> lock(workers->mutex_);
+        nWarning++;
+    } else {
+        nWarning++;
+    }
+}
+
+void DcmQueryRetrieveMoveContext::subOpFailed(const char *sopInstance)
+{
+    if (workers) {
+        std::lock_guard<std::mutex> lock(workers->mutex_);
+        nFailed++;
+        addFailedUIDInstance(sopInstance);
+    } else {
+        nFailed++;
+        addFailedUIDInstance(sopInstance);
+    }
+}
+
+OFCondition DcmQueryRetrieveMoveContext::performMoveSubOp(T_ASC_Association *assoc,
+    DcmQueryRetrieveMoveSubOps& pending, const char *sopClass, const char *sopInstance, const char *fname)
 {
     OFCondition cond = EC_Normal;
     T_DIMSE_C_StoreRQ req;
-    T_DIMSE_C_StoreRSP rsp;
     DIC_US msgId;
     T_ASC_PresentationContextID presId;
-    DcmDataset *stDetail = NULL;
+    OFTraceContext context(0, sopInstance);
+    OFTraceSpan span("move.subOperation");
+    /* sub-operations of all associations share the slots of the scheduler by priority */
+    DcmQueryRetrieveScheduler::Ticket ticket(DcmQueryRetrieveScheduler::classOf(priority), "move");
+
+    /* an instance in a pack file is fetched and locked with its pack */
+    const OFString storedFile = DcmQueryRetrievePackFile::container(fname);
+    if (options_.fetchFile_ && !options_.fetchFile_(storedFile.c_str())) {
+        DCMQRDB_ERROR("Move SCP: storeSCU: [file: " << fname << "]: cannot be fetched from the storage backend");
+        subOpFailed(sopInstance);
+        pending.completed_++;
+        return EC_Normal;
+    }
 
 #ifdef LOCK_IMAGE_FILES
     /* shared lock image file */
     int lockfd;
 #ifdef O_BINARY
-    lockfd = open(fname, O_RDONLY | O_BINARY, 0666);
+    lockfd = open(storedFile.c_str(), O_RDONLY | O_BINARY, 0666);
 #else
-    lockfd = open(fname, O_RDONLY , 0666);
+    lockfd = open(storedFile.c_str(), O_RDONLY , 0666);
 #endif
     if (lockfd < 0) {
         /* due to quota system the file could have been deleted */
         DCMQRDB_ERROR("Move SCP: storeSCU: [file: " << fname << "]: "
             << OFStandard::getLastSystemErrorCode().message());
-        nFailed++;
-        addFailedUIDInstance(sopInstance);
+        subOpFailed(sopInstance);
+        pending.completed_++;
         return EC_Normal;
     }
     dcmtk_flock(lockfd, LOCK_SH);
 #endif
 
-    msgId = subAssoc->nextMsgID++;
+    msgId = assoc->nextMsgID++;
 
     /* which presentation context should be used */
-    presId = ASC_findAcceptedPresentationContextID(subAssoc,
+    presId = ASC_findAcceptedPresentationContextID(assoc,
         sopClass);
     if (presId == 0) {
-        nFailed++;
-        addFailedUIDInstance(sopInstance);
+        subOpFailed(sopInstance);
+        pending.completed_++;
         DCMQRDB_ERROR("Move SCP: storeSCU: [file: " << fname << "] No presentation context for: ("
             << dcmSOPClassUIDToModality(sopClass, "OT") << ") " << sopClass);
+#ifdef LOCK_IMAGE_FILES
+        dcmtk_flock(lockfd, LOCK_UN);
+        close(lockfd);
+#endif
         return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
     }
 
@@ -241,40 +433,144 @@ OFCondition DcmQueryRetrieveMoveContext::performMoveSubOp(DIC_UI sopClass, DIC_U
     DCMQRDB_INFO("Store SCU RQ: MsgID " << msgId << ", ("
         << dcmSOPClassUIDToModality(sopClass, "OT") << ")");
 
-    cond = DIMSE_storeUser(subAssoc, presId, &req,
-        fname, NULL, moveSubOpProgressCallback, this,
-        options_.blockMode_, options_.dimse_timeout_,
-        &rsp, &stDetail);
+    /* an instance in a pack file is sent from the dataset read at its offset, which dcmnet
+     * converts to the accepted transfer syntax like a file */
+    DcmFileFormat packed;
+    const OFBool isPacked = DcmQueryRetrievePackFile::isMember(fname);
+    if (isPacked) {
+        cond = DcmQueryRetrievePackFile::load(fname, packed);
+        if (cond.bad()) {
+            DCMQRDB_ERROR("Move SCP: storeSCU: [file: " << fname << "]: cannot be read from the pack file: " << cond.text());
+            subOpFailed(sopInstance);
+            pending.completed_++;
+#ifdef LOCK_IMAGE_FILES
+            dcmtk_flock(lockfd, LOCK_UN);
+            close(lockfd);
+#endif
+            return EC_Normal;
+        }
+    }
+
+    /* send a cached conversion if the file has to be transcoded for the accepted transfer syntax */
+    OFString sendFile(fname);
+    OFBool cached = OFFalse;
+    if (transcodeCache && !isPacked) {
+        T_ASC_PresentationContext pc;
+        if (ASC_findAcceptedPresentationContext(assoc->params, presId, &pc).good()) {
+            DcmXfer netXfer(pc.acceptedTransferSyntax);
+            DcmFileFormat meta;
+            OFString fileXferUID;
+            if (meta.loadFile(fname, EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_metaOnly).good())
+                meta.getMetaInfo()->findAndGetOFString(DCM_TransferSyntaxUID, fileXferUID);
+            DcmXfer fileXfer(fileXferUID.c_str());
+            /* conversions between uncompressed transfer syntaxes are cheap and not cached */
+            if (fileXfer.getXfer() != EXS_Unknown && fileXfer.getXfer() != netXfer.getXfer() &&
+                (fileXfer.isEncapsulated() || netXfer.isEncapsulated())) {
+                OFString cachedFile;
+                if (transcodeCache->acquire(sopInstance, fname, netXfer.getXfer(), cachedFile).good()) {
+                    sendFile = cachedFile;
+                    cached = OFTrue;
+                }
+            }
+        }
+    }
+
+    /* the response is received once the window of outstanding sub-operations is full */
+    cond = DIMSE_sendStoreRequest(assoc, presId, &req,
+        isPacked ? NULL : sendFile.c_str(), isPacked ? packed.getDataset() : NULL, moveSubOpProgressCallback, this);
+
+    DcmQueryRetrieveMoveSubOp subOp;
+    subOp.msgId = msgId;
+    subOp.sopInstance = sopInstance;
+    subOp.sendFile = sendFile.c_str();
+    subOp.cached = cached;
+#ifdef LOCK_IMAGE_FILES
+    subOp.lockfd = lockfd;
+#endif
+    pending.pending_.push_back(subOp);
+
+    if (cond.bad()) {
+        /* the association is unusable, fail this and all outstanding sub-operations */
+        OFString temp_str;
+        DCMQRDB_ERROR("Move SCP: storeSCU: Store Request Failed: " << DimseCondition::dump(temp_str, cond));
+        failMoveSubOps(pending);
+        return cond;
+    }
+
+    while (cond.good() && pending.pending_.size() >= pending.window_) {
+        cond = receiveMoveSubOpResponse(assoc, pending);
+    }
+    return cond;
+}
+
+/* releases the file of a sub-operation whose response was received or which failed */
+static void releaseMoveSubOp(const DcmQueryRetrieveMoveSubOp& subOp, DcmQueryRetrieveTranscodeCache *transcodeCache)
+{
+    if (subOp.cached) transcodeCache->release(subOp.sendFile.c_str());
 
 #ifdef LOCK_IMAGE_FILES
     /* unlock image file */
-    dcmtk_flock(lockfd, LOCK_UN);
-    close(lockfd);
+    dcmtk_flock(subOp.lockfd, LOCK_UN);
+    close(subOp.lockfd);
 #endif
+}
 
+OFCondition DcmQueryRetrieveMoveContext::receiveMoveSubOpResponse(T_ASC_Association *assoc,
+    DcmQueryRetrieveMoveSubOps& pending)
+{
+    T_DIMSE_C_StoreRSP rsp;
+    T_ASC_PresentationContextID presId = 0;
+    DcmDataset *stDetail = NULL;
+    OFString temp_str;
+
+    OFCondition cond;
+    {
+        OFTraceSpan span("move.receiveResponse");
+        cond = DIMSE_receiveStoreResponse(assoc,
+            options_.blockMode_, options_.dimse_timeout_, &presId, &rsp, &stDetail);
+    }
+
+    /* responses are matched to the outstanding sub-operations by message ID */
+    std::deque<DcmQueryRetrieveMoveSubOp>::iterator it = pending.pending_.end();
     if (cond.good()) {
-        DCMQRDB_INFO("Move SCP: Received Store SCU RSP [Status="
-            << DU_cstoreStatusString(rsp.DimseStatus) << "]");
-        if (rsp.DimseStatus == STATUS_Success) {
-            /* everything ok */
-            nCompleted++;
-        } else if (DICOM_WARNING_STATUS(rsp.DimseStatus)) {
-            /* a warning status message */
-            nWarning++;
-            DCMQRDB_ERROR("Move SCP: Store Warning: Response Status: " <<
-                    DU_cstoreStatusString(rsp.DimseStatus));
-        } else {
-            nFailed++;
-            addFailedUIDInstance(sopInstance);
-            /* print a status message */
-            DCMQRDB_ERROR("Move SCP: Store Failed: Response Status: " <<
-                DU_cstoreStatusString(rsp.DimseStatus));
+        for (it = pending.pending_.begin(); it != pending.pending_.end(); ++it) {
+            if (it->msgId == rsp.MessageIDBeingRespondedTo) break;
         }
-    } else {
-        nFailed++;
-        addFailedUIDInstance(sopInstance);
-        OFString temp_str;
+        if (it == pending.pending_.end()) {
+            char buf[256];
+            sprintf(buf, "DIMSE: Unexpected Response MsgId: %d", rsp.MessageIDBeingRespondedTo);
+            cond = makeDcmnetCondition(DIMSEC_UNEXPECTEDRESPONSE, OF_error, buf);
+        }
+    }
+
+    if (cond.bad()) {
+        /* the outstanding sub-operations cannot complete any more */
         DCMQRDB_ERROR("Move SCP: storeSCU: Store Request Failed: " << DimseCondition::dump(temp_str, cond));
+        failMoveSubOps(pending);
+        delete stDetail;
+        return cond;
+    }
+
+    DcmQueryRetrieveMoveSubOp subOp = *it;
+    pending.pending_.erase(it);
+    pending.completed_++;
+    releaseMoveSubOp(subOp, transcodeCache);
+
+    DCMQRDB_INFO("Move SCP: Received Store SCU RSP [MsgID " << subOp.msgId << ", Status="
+        << DU_cstoreStatusString(rsp.DimseStatus) << "]");
+    if (rsp.DimseStatus == STATUS_Success) {
+        /* everything ok */
+        subOpCompleted();
+    } else if (DICOM_WARNING_STATUS(rsp.DimseStatus)) {
+        /* a warning status message */
+        subOpWarning();
+        DCMQRDB_ERROR("Move SCP: Store Warning: Response Status: " <<
+                DU_cstoreStatusString(rsp.DimseStatus));
+    } else {
+        subOpFailed(subOp.sopInstance.c_str());
+        /* print a status message */
+        DCMQRDB_ERROR("Move SCP: Store Failed: Response Status: " <<
+            DU_cstoreStatusString(rsp.DimseStatus));
     }
     if (stDetail != NULL) {
         DCMQRDB_INFO("  Status Detail:" << OFendl << DcmObject::PrintHelper(*stDetail));
@@ -283,14 +579,29 @@ OFCondition DcmQueryRetrieveMoveContext::performMoveSubOp(DIC_UI sopClass, DIC_U
     return cond;
 }
 
+void DcmQueryRetrieveMoveContext::failMoveSubOps(DcmQueryRetrieveMoveSubOps& pending)
+{
+    while (!pending.pending_.empty()) {
+        subOpFailed(pending.pending_.front().sopInstance.c_str());
+        releaseMoveSubOp(pending.pending_.front(), transcodeCache);
+        pending.pending_.pop_front();
+        pending.completed_++;
+    }
+}
+
+void DcmQueryRetrieveMoveContext::completeMoveSubOps(T_ASC_Association *assoc,
+    DcmQueryRetrieveMoveSubOps& pending)
+{
+    /* a failed receive fails all outstanding sub-operations and empties the list */
+    while (!pending.pending_.empty()) {
+        receiveMoveSubOpResponse(assoc, pending);
+    }
+}
+
 OFCondition DcmQueryRetrieveMoveContext::buildSubAssociation(T_DIMSE_C_MoveRQ *request)
 {
     OFCondition cond = EC_Normal;
-    DIC_NODENAME dstHostName;
-    DIC_NODENAME dstHostNamePlusPort;
     int dstPortNumber;
-    T_ASC_Parameters *params;
-    OFString temp_str;
 
     OFStandard::strlcpy(dstAETitle, request->MoveDestination, DIC_AE_LEN + 1);
 
@@ -311,17 +622,97 @@ OFCondition DcmQueryRetrieveMoveContext::buildSubAssociation(T_DIMSE_C_MoveRQ *r
         request->MoveDestination, dstHostName, DIC_NODENAME_LEN + 1, &dstPortNumber)) {
         return QR_EC_InvalidPeer;
     }
+
+    cond = requestSubAssociation(dstPortNumber, &subAssoc);
     if (cond.good()) {
-        cond = ASC_createAssociationParameters(&params, ASC_DEFAULTMAXPDU);
-        if (cond.bad()) {
-            DCMQRDB_ERROR("moveSCP: Cannot create Association-params for sub-ops: " << DimseCondition::dump(temp_str, cond));
+        assocStarted = OFTrue;
+    }
+
+    if (cond.good() && options_.moveSubAssociations_ > 1) {
+        /* open further sub-associations, the move proceeds with the ones the destination accepts */
+        workers = new DcmQueryRetrieveMoveWorkers();
+        workers->assocs_.push_back(subAssoc);
+        for (int i = 1; i < options_.moveSubAssociations_; ++i) {
+            T_ASC_Association *assoc = NULL;
+            if (requestSubAssociation(dstPortNumber, &assoc).bad()) break;
+            workers->assocs_.push_back(assoc);
+        }
+        DCMQRDB_INFO("Move SCP: performing sub-operations over " << workers->assocs_.size() << " sub-associations");
+
+        const Uint64 association = OFTraceContext::association();
+        const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+        for (size_t i = 0; i < workers->assocs_.size(); ++i) {
+            T_ASC_Association *assoc = workers->assocs_[i];
+            workers->threads_.push_back(std::thread([this, assoc, association, logLevel]()
+            {
+                OFTraceContext context(association);
+                OFLog::setThreadLogLevel(logLevel);
+                /* sub-operations stay in flight until their response has been received */
+                DcmQueryRetrieveMoveSubOps pending(assoc, options_.moveAsyncOperations_);
+                std::unique_lock<std::mutex> lock(workers->mutex_);
+                while (true) {
+                    if (workers->queue_.empty() && !pending.pending_.empty()) {
+                        /* nothing else to send, wait for the outstanding responses */
+                        lock.unlock();
+                        completeMoveSubOps(assoc, pending);
+                    } else {
+                        workers->queued_.wait(lock, [this] { return workers->stopping_ || !workers->queue_.empty(); });
+                        if (workers->queue_.empty()) break;
+                        DcmQueryRetrieveMoveJob job = workers->queue_.front();
+                        workers->queue_.pop_front();
+                        workers->inFlight_++;
+                        lock.unlock();
+
+                        OFCondition subOpCond = performMoveSubOp(assoc, pending,
+                            job.sopClass.c_str(), job.sopInstance.c_str(), job.filename.c_str());
+                        if (subOpCond != EC_Normal) {
+                            OFString temp_str;
+                            DCMQRDB_ERROR("moveSCP: Move Sub-Op Failed: " << DimseCondition::dump(temp_str, subOpCond));
+                        }
+                    }
+
+                    lock.lock();
+                    if (pending.completed_ > 0) {
+                        workers->inFlight_ -= pending.completed_;
+                        workers->finished_ += pending.completed_;
+                        pending.completed_ = 0;
+                        workers->finishedCond_.notify_all();
+                    }
+                }
+            }));
+        }
+    } else if (cond.good()) {
+        subOps = new DcmQueryRetrieveMoveSubOps(subAssoc, options_.moveAsyncOperations_);
+        if (options_.moveReadAhead_ > 0) {
+            prefetch = new DcmQueryRetrieveMovePrefetch(OFstatic_cast(size_t, options_.moveReadAhead_), options_.fetchFile_,
+                DcmQueryRetrieveScheduler::classOf(priority));
         }
     }
+    return cond;
+}
+
+OFCondition DcmQueryRetrieveMoveContext::requestSubAssociation(int dstPortNumber, T_ASC_Association **assoc)
+{
+    OFCondition cond = EC_Normal;
+    DIC_NODENAME dstHostNamePlusPort;
+    T_ASC_Parameters *params;
+    OFString temp_str;
+
+    cond = ASC_createAssociationParameters(&params, OFstatic_cast(int, options_.maxPDU_));
+    if (cond.bad()) {
+        DCMQRDB_ERROR("moveSCP: Cannot create Association-params for sub-ops: " << DimseCondition::dump(temp_str, cond));
+    }
     if (cond.good()) {
         OFStandard::snprintf(dstHostNamePlusPort, sizeof(DIC_NODENAME), "%s:%d", dstHostName, dstPortNumber);
         ASC_setPresentationAddresses(params, OFStandard::getHostName().c_str(),
             dstHostNamePlusPort);
         ASC_setAPTitles(params, ourAETitle.c_str(), dstAETitle,NULL);
+        ASC_setTransportLayerType(params, options_.secureConnection_);
+
+        /* propose to have several C-STORE sub-operations outstanding at a time */
+        if (options_.moveAsyncOperations_ > 1) {
+            ASC_setAsyncOperationsWindow(params, OFstatic_cast(unsigned short, options_.moveAsyncOperations_), 1);
+        }
 
         if (options_.outgoingProfile.empty()) {
             cond = addAllStoragePresentationContexts(params);
@@ -336,7 +727,7 @@ OFCondition DcmQueryRetrieveMoveContext::buildSubAssociation(T_DIMSE_C_MoveRQ *r
     if (cond.good()) {
         /* create association */
         DCMQRDB_INFO("Requesting Sub-Association");
-        cond = ASC_requestAssociation(options_.net_, params, &subAssoc);
+        cond = ASC_requestAssociation(options_.net_, params, assoc);
         if (cond.bad()) {
             if (cond == DUL_ASSOCIATIONREJECTED) {
                 T_ASC_RejectParameters rej;
@@ -346,11 +737,42 @@ OFCondition DcmQueryRetrieveMoveContext::buildSubAssociation(T_DIMSE_C_MoveRQ *r
             } else {
                 DCMQRDB_ERROR("moveSCP: Sub-Association Request Failed: " << DimseCondition::dump(temp_str, cond));
             }
+            /* destroying the association also frees the parameters */
+            if (*assoc != NULL) {
+                ASC_dropAssociation(*assoc);
+                ASC_destroyAssociation(assoc);
+            }
         }
     }
+    return cond;
+}
 
-    if (cond.good()) {
-        assocStarted = OFTrue;
+void DcmQueryRetrieveMoveContext::subOpSent(Uint64 bytes, double seconds)
+{
+    if (bytes > 0) config->transferCompleted(dstAETitle, dstHostName, bytes, seconds);
+}
+
+void DcmQueryRetrieveMoveContext::subOpSending(Uint64 bytes)
+{
+    config->throttleTransfer(dstAETitle, dstHostName, bytes);
+}
+
+static OFCondition releaseSubAssociation(T_ASC_Association **assoc)
+{
+    /* release association */
+    OFString temp_str;
+    DCMQRDB_INFO("Releasing Sub-Association");
+    OFCondition cond = ASC_releaseAssociation(*assoc);
+    if (cond.bad()) {
+        DCMQRDB_ERROR("moveSCP: Sub-Association Release Failed: " << DimseCondition::dump(temp_str, cond));
+    }
+    cond = ASC_dropAssociation(*assoc);
+    if (cond.bad()) {
+        DCMQRDB_ERROR("moveSCP: Sub-Association Drop Failed: " << DimseCondition::dump(temp_str, cond));
+    }
+    cond = ASC_destroyAssociation(assoc);
+    if (cond.bad()) {
+        DCMQRDB_ERROR("moveSCP: Sub-Association Destroy Failed: " << DimseCondition::dump(temp_str, cond));
     }
     return cond;
 }
@@ -359,22 +781,40 @@ OFCondition DcmQueryRetrieveMoveContext::closeSubAssociation()
 {
     OFCondition cond = EC_Normal;
 
-    if (subAssoc != NULL) {
-        /* release association */
-        OFString temp_str;
-        DCMQRDB_INFO("Releasing Sub-Association");
-        cond = ASC_releaseAssociation(subAssoc);
-        if (cond.bad()) {
-            DCMQRDB_ERROR("moveSCP: Sub-Association Release Failed: " << DimseCondition::dump(temp_str, cond));
-        }
-        cond = ASC_dropAssociation(subAssoc);
-        if (cond.bad()) {
-            DCMQRDB_ERROR("moveSCP: Sub-Association Drop Failed: " << DimseCondition::dump(temp_str, cond));
-        }
-        cond = ASC_destroyAssociation(&subAssoc);
-        if (cond.bad()) {
-            DCMQRDB_ERROR("moveSCP: Sub-Association Destroy Failed: " << DimseCondition::dump(temp_str, cond));
+    if (workers != NULL) {
+        {
+            /* sub-operations not started yet (cancel) are reported as remaining */
+            std::lock_guard<std::mutex> lock(workers->mutex_);
+            nRemaining = OFstatic_cast(DIC_US, nRemaining + workers->queue_.size());
+            workers->queue_.clear();
+            workers->stopping_ = OFTrue;
+            workers->queued_.notify_all();
         }
+        for (size_t i = 0; i < workers->threads_.size(); ++i)
+            workers->threads_[i].join();
+        /* the first sub-association is released below */
+        for (size_t i = 1; i < workers->assocs_.size(); ++i)
+            releaseSubAssociation(&workers->assocs_[i]);
+        delete workers;
+        workers = NULL;
+    }
+
+    if (prefetch != NULL) {
+        nRemaining = OFstatic_cast(DIC_US, nRemaining + prefetch->clear());
+        delete prefetch;
+        prefetch = NULL;
+    }
+
+    if (subOps != NULL) {
+        /* the responses to the outstanding sub-operations are received before the release */
+        if (subAssoc != NULL) completeMoveSubOps(subAssoc, *subOps);
+        else failMoveSubOps(*subOps);
+        delete subOps;
+        subOps = NULL;
+    }
+
+    if (subAssoc != NULL) {
+        cond = releaseSubAssociation(&subAssoc);
     }
 
     if (assocStarted) {
@@ -392,6 +832,11 @@ void DcmQueryRetrieveMoveContext::moveNextImage(DcmQueryRetrieveDatabaseStatus *
     DIC_UI subImgSOPInstance;   /* sub-operation image SOP Instance */
     char subImgFileName[MAXPATHLEN + 1];    /* sub-operation image file */
 
+    if (prefetch) {
+        moveNextPrefetchedImage(dbStatus);
+        return;
+    }
+
     /* clear out strings */
     bzero(subImgFileName, sizeof(subImgFileName));
     bzero(subImgSOPClass, sizeof(subImgSOPClass));
@@ -407,7 +852,7 @@ void DcmQueryRetrieveMoveContext::moveNextImage(DcmQueryRetrieveDatabaseStatus *
 
     if (dbStatus->status() == STATUS_Pending) {
         /* perform sub-op */
-        cond = performMoveSubOp(subImgSOPClass, subImgSOPInstance, subImgFileName);
+        cond = performMoveSubOp(subAssoc, *subOps, subImgSOPClass, subImgSOPInstance, subImgFileName);
         if (cond != EC_Normal) {
             OFString temp_str;
             DCMQRDB_ERROR("moveSCP: Move Sub-Op Failed: " << DimseCondition::dump(temp_str, cond));
@@ -416,6 +861,112 @@ void DcmQueryRetrieveMoveContext::moveNextImage(DcmQueryRetrieveDatabaseStatus *
     }
 }
 
+void DcmQueryRetrieveMoveContext::moveNextPrefetchedImage(DcmQueryRetrieveDatabaseStatus * dbStatus)
+{
+    OFCondition dbcond = EC_Normal;
+    DIC_UI subImgSOPClass;      /* sub-operation image SOP Class */
+    DIC_UI subImgSOPInstance;   /* sub-operation image SOP Instance */
+    char subImgFileName[MAXPATHLEN + 1];    /* sub-operation image file */
+
+    /* fetch jobs from the database until the read-ahead depth is reached */
+    while (!prefetch->exhausted_ && prefetch->queued() < prefetch->depth()) {
+        /* clear out strings */
+        bzero(subImgFileName, sizeof(subImgFileName));
+        bzero(subImgSOPClass, sizeof(subImgSOPClass));
+        bzero(subImgSOPInstance, sizeof(subImgSOPInstance));
+
+        /* get DB response */
+        dbcond = dbHandle.nextMoveResponse(
+            subImgSOPClass, sizeof(subImgSOPClass), subImgSOPInstance, sizeof(subImgSOPInstance), subImgFileName, sizeof(subImgFileName), &nRemaining, dbStatus);
+        if (dbcond.bad()) {
+            DCMQRDB_ERROR("moveSCP: Database: nextMoveResponse Failed ("
+                    << DU_cmoveStatusString(dbStatus->status()) << "):");
+        }
+        if (dbStatus->status() != STATUS_Pending) {
+            prefetch->exhausted_ = OFTrue;
+            break;
+        }
+
+        DcmQueryRetrieveMoveJob job;
+        job.sopClass = subImgSOPClass;
+        job.sopInstance = subImgSOPInstance;
+        job.filename = subImgFileName;
+        prefetch->push(job);
+    }
+
+    if (prefetch->exhausted_ && dbStatus->status() != STATUS_Pending && dbStatus->status() != STATUS_Success) {
+        /* the database failed, the sub-operations read ahead are not started and reported as remaining */
+        nRemaining = OFstatic_cast(DIC_US, nRemaining + prefetch->clear());
+        return;
+    }
+
+    DcmQueryRetrieveMoveJob job;
+    if (prefetch->pop(job)) {
+        /* perform sub-op */
+        OFTimer timer;
+        OFCondition cond = performMoveSubOp(subAssoc, *subOps, job.sopClass.c_str(), job.sopInstance.c_str(), job.filename.c_str());
+        prefetch->sent(timer.getDiff());
+        if (cond != EC_Normal) {
+            OFString temp_str;
+            DCMQRDB_ERROR("moveSCP: Move Sub-Op Failed: " << DimseCondition::dump(temp_str, cond));
+        }
+        /* the final status of the database applies once all jobs read ahead are sent */
+        dbStatus->setStatus(prefetch->exhausted_ && prefetch->queued() == 0 ? STATUS_Success : STATUS_Pending);
+    }
+}
+
+void DcmQueryRetrieveMoveContext::moveNextImages(DcmQueryRetrieveDatabaseStatus * dbStatus)
+{
+    OFCondition dbcond = EC_Normal;
+    DIC_UI subImgSOPClass;      /* sub-operation image SOP Class */
+    DIC_UI subImgSOPInstance;   /* sub-operation image SOP Instance */
+    char subImgFileName[MAXPATHLEN + 1];    /* sub-operation image file */
+
+    /* keep up to two sub-operations per sub-association queued besides the ones
+     * awaiting their response, the database handle is only used by this thread
+     */
+    const size_t pipelined = options_.moveAsyncOperations_ > 1 ? OFstatic_cast(size_t, options_.moveAsyncOperations_) : 1;
+    const size_t window = (pipelined + 1) * workers->assocs_.size();
+    std::unique_lock<std::mutex> lock(workers->mutex_);
+    while (dbStatus->status() == STATUS_Pending && workers->outstanding() < window) {
+        lock.unlock();
+
+        /* clear out strings */
+        bzero(subImgFileName, sizeof(subImgFileName));
+        bzero(subImgSOPClass, sizeof(subImgSOPClass));
+        bzero(subImgSOPInstance, sizeof(subImgSOPInstance));
+
+        /* get DB response */
+        DIC_US dbRemaining = 0;
+        dbcond = dbHandle.nextMoveResponse(
+            subImgSOPClass, sizeof(subImgSOPClass), subImgSOPInstance, sizeof(subImgSOPInstance), subImgFileName, sizeof(subImgFileName), &dbRemaining, dbStatus);
+        if (dbcond.bad()) {
+            DCMQRDB_ERROR("moveSCP: Database: nextMoveResponse Failed ("
+                    << DU_cmoveStatusString(dbStatus->status()) << "):");
+        }
+
+        lock.lock();
+        nRemaining = dbRemaining;
+        if (dbStatus->status() == STATUS_Pending) {
+            DcmQueryRetrieveMoveJob job;
+            job.sopClass = subImgSOPClass;
+            job.sopInstance = subImgSOPInstance;
+            job.filename = subImgFileName;
+            workers->queue_.push_back(job);
+            workers->queued_.notify_one();
+        }
+    }
+
+    if (dbStatus->status() == STATUS_Pending) {
+        /* send the next pending response once a sub-operation has completed */
+        workers->finishedCond_.wait(lock, [this] { return workers->finished_ > 0; });
+    } else {
+        /* the final response has to report all sub-operations */
+        workers->finishedCond_.wait(lock, [this] { return workers->outstanding() == 0; });
+    }
+    workers->finished_ = 0;
+}
+
 void DcmQueryRetrieveMoveContext::failAllSubOperations(DcmQueryRetrieveDatabaseStatus * dbStatus)
 {
     OFCondition dbcond = EC_Normal;
@@ -445,6 +996,119 @@ void DcmQueryRetrieveMoveContext::failAllSubOperations(DcmQueryRetrieveDatabaseS
     dbStatus->setStatus(STATUS_MOVE_Warning_SubOperationsCompleteOneOrMoreFailures);
 }
 
+void DcmQueryRetrieveMoveContext::forwardNextMove(DcmQueryRetrieveDatabaseStatus * dbStatus)
+{
+    const DcmQueryRetrieveForwardedMove move = forwardedMoves.front();
+    forwardedMoves.pop_front();
+    forwardedRemaining -= move.sopInstanceUIDs.size();
+
+    T_DIMSE_C_MoveRSP rsp;
+    DcmDataset *rspIds = NULL;
+    OFCondition cond = forwardMove(move, rsp, &rspIds);
+    if (cond.good()) {
+        nCompleted = OFstatic_cast(DIC_US, nCompleted + rsp.NumberOfCompletedSubOperations);
+        nWarning = OFstatic_cast(DIC_US, nWarning + rsp.NumberOfWarningSubOperations);
+        nFailed = OFstatic_cast(DIC_US, nFailed + rsp.NumberOfFailedSubOperations);
+        const char *failed = NULL;
+        if (rspIds != NULL && rspIds->findAndGetString(DCM_FailedSOPInstanceUIDList, failed).good() && failed != NULL) {
+            OFString uids(failed);
+            size_t begin = 0;
+            while (begin <= uids.length()) {
+                size_t end = uids.find('\\', begin);
+                if (end == OFString_npos) end = uids.length();
+                if (end > begin) addFailedUIDInstance(uids.substr(begin, end - begin).c_str());
+                begin = end + 1;
+            }
+        }
+        DCMQRDB_INFO("Move SCP: forwarded " << move.sopInstanceUIDs.size() << " instances to " << move.aeTitle
+            << "@" << move.hostName << ":" << move.port << " [status: " << DU_cmoveStatusString(rsp.DimseStatus) << "]");
+    } else {
+        OFString temp_str;
+        DCMQRDB_ERROR("moveSCP: forwarding to " << move.aeTitle << "@" << move.hostName << ":" << move.port
+            << " failed: " << DimseCondition::dump(temp_str, cond));
+        for (OFListConstIterator(OFString) it = move.sopInstanceUIDs.begin(); it != move.sopInstanceUIDs.end(); ++it) {
+            nFailed++;
+            addFailedUIDInstance(it->c_str());
+        }
+    }
+    delete rspIds;
+
+    if (forwardedMoves.empty()) {
+        dbStatus->setStatus(STATUS_Success);
+    }
+}
+
+OFCondition DcmQueryRetrieveMoveContext::forwardMove(const DcmQueryRetrieveForwardedMove& move,
+    T_DIMSE_C_MoveRSP& rsp, DcmDataset **rspIds)
+{
+    T_ASC_Parameters *params = NULL;
+    T_ASC_Association *assoc = NULL;
+    DIC_NODENAME peer;
+
+    OFCondition cond = ASC_createAssociationParameters(&params, OFstatic_cast(int, options_.maxPDU_));
+    if (cond.bad()) return cond;
+    OFStandard::snprintf(peer, sizeof(peer), "%s:%d", move.hostName.c_str(), move.port);
+    ASC_setPresentationAddresses(params, OFStandard::getHostName().c_str(), peer);
+    ASC_setAPTitles(params, ourAETitle.c_str(), move.aeTitle.c_str(), NULL);
+    ASC_setTransportLayerType(params, options_.secureConnection_);
+    const char *transferSyntaxes[] = { UID_LittleEndianExplicitTransferSyntax, UID_LittleEndianImplicitTransferSyntax };
+    cond = ASC_addPresentationContext(params, 1, UID_MOVEStudyRootQueryRetrieveInformationModel, transferSyntaxes, 2);
+    if (cond.bad()) {
+        ASC_destroyAssociationParameters(&params);
+        return cond;
+    }
+    cond = ASC_requestAssociation(options_.net_, params, &assoc);
+    if (cond.bad()) {
+        /* destroying the association also frees the parameters */
+        if (assoc != NULL) {
+            ASC_dropAssociation(assoc);
+            ASC_destroyAssociation(&assoc);
+        } else {
+            ASC_destroyAssociationParameters(&params);
+        }
+        return cond;
+    }
+
+    const T_ASC_PresentationContextID presId = ASC_findAcceptedPresentationContextID(assoc, UID_MOVEStudyRootQueryRetrieveInformationModel);
+    if (presId == 0) {
+        cond = DIMSE_NOVALIDPRESENTATIONCONTEXTID;
+    } else {
+        /* the instances of one series at the image level of the study root */
+        OFString instances;
+        for (OFListConstIterator(OFString) it = move.sopInstanceUIDs.begin(); it != move.sopInstanceUIDs.end(); ++it) {
+            if (!instances.empty()) instances += "\\";
+            instances += *it;
+        }
+        DcmDataset identifiers;
+        identifiers.putAndInsertString(DCM_QueryRetrieveLevel, "IMAGE");
+        identifiers.putAndInsertOFStringArray(DCM_StudyInstanceUID, move.studyInstanceUID);
+        identifiers.putAndInsertOFStringArray(DCM_SeriesInstanceUID, move.seriesInstanceUID);
+        identifiers.putAndInsertOFStringArray(DCM_SOPInstanceUID, instances);
+
+        T_DIMSE_C_MoveRQ req;
+        memset(&req, 0, sizeof(req));
+        req.MessageID = assoc->nextMsgID++;
+        OFStandard::strlcpy(req.AffectedSOPClassUID, UID_MOVEStudyRootQueryRetrieveInformationModel, sizeof(req.AffectedSOPClassUID));
+        req.Priority = priority;
+        req.DataSetType = DIMSE_DATASET_PRESENT;
+        OFStandard::strlcpy(req.MoveDestination, dstAETitle, sizeof(req.MoveDestination));
+
+        DcmDataset *statusDetail = NULL;
+        cond = DIMSE_moveUser(assoc, presId, &req, &identifiers, NULL, NULL, options_.blockMode_, options_.dimse_timeout_,
+            options_.net_, NULL, NULL, &rsp, &statusDetail, rspIds, OFTrue);
+        delete statusDetail;
+    }
+
+    if (cond.good()) {
+        ASC_releaseAssociation(assoc);
+    } else {
+        ASC_abortAssociation(assoc);
+    }
+    ASC_dropAssociation(assoc);
+    ASC_destroyAssociation(&assoc);
+    return cond;
+}
+
 void DcmQueryRetrieveMoveContext::buildFailedInstanceList(DcmDataset ** rspIds)
 {
     OFBool ok;
@@ -512,14 +1176,15 @@ OFBool DcmQueryRetrieveMoveContext::mapMoveDestination(
 
 OFCondition DcmQueryRetrieveMoveContext::addAllStoragePresentationContexts(T_ASC_Parameters *params)
 {
-    // this would be the place to add support for compressed transfer syntaxes
     OFCondition cond = EC_Normal;
 
     int i;
-    int pid = 1;
+    T_ASC_PresentationContextID pid = 1;
 
     const char* transferSyntaxes[] = { NULL, NULL, NULL, NULL };
     int numTransferSyntaxes = 0;
+    /* non-image objects are proposed deflated first unless a transfer syntax is configured */
+    OFBool proposeDeflated = OFFalse;
 
 #ifdef DISABLE_COMPRESSION_EXTENSION
     /* gLocalByteOrder is defined in dcxfer.h */
@@ -692,15 +1357,44 @@ OFCondition DcmQueryRetrieveMoveContext::addAllStoragePresentationContexts(T_ASC
         }
         transferSyntaxes[2] = UID_LittleEndianImplicitTransferSyntax;
         numTransferSyntaxes = 3;
+#ifdef WITH_ZLIB
+        proposeDeflated = OFTrue;
+#endif
         break;
     }
 #endif
 
+    const char* deflatedSyntaxes[] = { UID_DeflatedExplicitVRLittleEndianTransferSyntax, NULL, NULL, NULL };
+    for (int j = 0; j < numTransferSyntaxes && j < 3; j++) deflatedSyntaxes[j + 1] = transferSyntaxes[j];
+
+    /* the configuration may prefer lossless compressed or uncompressed transfer syntaxes on the
+     * link to the destination, e.g. measured on earlier transfers. Single transfer syntaxes
+     * configured, e.g. for video, are kept
+     */
+    const OFBool compressedFirst = numTransferSyntaxes > 1 &&
+        (DcmXfer(transferSyntaxes[0]).isEncapsulated() || DcmXfer(transferSyntaxes[0]).getStreamCompression() != ESC_none);
+    const char* losslessSyntaxes[] = { UID_JPEGLSLosslessTransferSyntax, NULL, NULL, NULL, NULL };
+    for (int j = 0; j < numTransferSyntaxes && j < 4; j++) losslessSyntaxes[j + 1] = transferSyntaxes[j];
+    const char** uncompressedSyntaxes = compressedFirst ? transferSyntaxes + 1 : transferSyntaxes;
+    const int numUncompressedSyntaxes = compressedFirst ? numTransferSyntaxes - 1 : numTransferSyntaxes;
+
     for (i = 0; i < numberOfDcmLongSCUStorageSOPClassUIDs && cond.good(); i++) {
-        cond = ASC_addPresentationContext(
-            params, pid, dcmLongSCUStorageSOPClassUIDs[i],
-            transferSyntaxes, numTransferSyntaxes);
-        pid += 2;   /* only odd presentation context id's */
+        const char* sopClass = dcmLongSCUStorageSOPClassUIDs[i];
+        const OFBool image = dcmIsImageStorageSOPClassUID(sopClass);
+        const int compressed = numTransferSyntaxes > 1 ? config->preferCompressed(dstAETitle, dstHostName, sopClass) : -1;
+        if (compressed == 0)
+            cond = ASC_addPresentationContext(params, pid, sopClass, uncompressedSyntaxes, numUncompressedSyntaxes);
+        else if (compressed > 0 && image && !compressedFirst)
+            cond = ASC_addPresentationContext(params, pid, sopClass, losslessSyntaxes, numTransferSyntaxes + 1);
+#ifdef WITH_ZLIB
+        else if (compressed > 0 && !image && !compressedFirst)
+            cond = ASC_addPresentationContext(params, pid, sopClass, deflatedSyntaxes, numTransferSyntaxes + 1);
+#endif
+        else if (proposeDeflated && !image && compressed < 0)
+            cond = ASC_addPresentationContext(params, pid, sopClass, deflatedSyntaxes, numTransferSyntaxes + 1);
+        else
+            cond = ASC_addPresentationContext(params, pid, sopClass, transferSyntaxes, numTransferSyntaxes);
+        pid = OFstatic_cast(T_ASC_PresentationContextID, pid + 2);   /* only odd presentation context id's */
     }
     return cond;
 }
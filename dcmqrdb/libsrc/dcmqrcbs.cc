@@ -29,6 +29,8 @@
 #include "dcmtk/dcmdata/dcfilefo.h"
 #include "dcmtk/dcmqrdb/dcmqrdbs.h"
 #include "dcmtk/dcmqrdb/dcmqrdbi.h"
+#include "dcmtk/dcmqrdb/dcmqrdcq.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
 
 
 void DcmQueryRetrieveStoreContext::updateDisplay(T_DIMSE_StoreProgress * progress)
@@ -60,6 +62,7 @@ void DcmQueryRetrieveStoreContext::updateDisplay(T_DIMSE_StoreProgress * progres
 void DcmQueryRetrieveStoreContext::saveImageToDB(
     T_DIMSE_C_StoreRQ *req,             /* original store request */
     const char *imageFileName,
+    DcmDataset *imageDataSet,           /* NULL if received into file */
     /* out */
     T_DIMSE_C_StoreRSP *rsp,            /* final store response */
     DcmDataset **stDetail)
@@ -76,9 +79,9 @@ void DcmQueryRetrieveStoreContext::saveImageToDB(
 
     if (status == STATUS_Success)
     {
-        dbcond = dbHandle.storeRequest(
+        dbcond = dbHandle.storeDatasetRequest(
             req->AffectedSOPClassUID, req->AffectedSOPInstanceUID,
-            imageFileName, &dbStatus);
+            imageFileName, imageDataSet, &dbStatus);
         if (dbcond.bad())
         {
             OFString temp_str;
@@ -99,9 +102,23 @@ void DcmQueryRetrieveStoreContext::writeToFile(
     T_DIMSE_C_StoreRSP *rsp)
 {
     E_TransferSyntax xfer = options_.writeTransferSyntax_;
-    if (xfer == EXS_Unknown) xfer = ff->getDataset()->getOriginalXfer();
+    const E_TransferSyntax originalXfer = ff->getDataset()->getOriginalXfer();
+    if (xfer == EXS_Unknown) xfer = originalXfer;
 
-    ff->chooseRepresentation(xfer, NULL);
+    // with a compression queue the file is written as received and converted after the response
+    OFBool deferred = OFFalse;
+    if (compressionQueue && xfer != originalXfer && originalXfer != EXS_Unknown)
+    {
+        deferred = OFTrue;
+        xfer = originalXfer;
+    }
+    else
+        ff->chooseRepresentation(xfer, NULL);
+
+    // a resent instance replaces the file instead of overwriting it, hard links
+    // to the previous file and readers which opened it keep its content
+    if (OFStandard::fileExists(fname))
+        OFStandard::deleteFile(fname);
 
     OFCondition cond = ff->saveFile(fname, xfer, options_.sequenceType_,
         options_.groupLength_, options_.paddingType_, (Uint32)options_.filepad_,
@@ -115,6 +132,49 @@ void DcmQueryRetrieveStoreContext::writeToFile(
       // delete incomplete file
       OFStandard::deleteFile(fname);
     }
+    else if (deferred)
+    {
+      compressionQueue->add(fname, options_.writeTransferSyntax_);
+    }
+}
+
+void DcmQueryRetrieveStoreContext::moveReceivedFile(
+    DcmDataset *header,
+    const char* fname,
+    T_DIMSE_C_StoreRSP *rsp)
+{
+    // same storage area, the rename does not copy
+    if (!OFStandard::renameFile(receivedFile, fname))
+    {
+      DCMQRDB_ERROR("storescp: Cannot write image file: " << fname);
+      rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+      OFStandard::deleteFile(receivedFile);
+      return;
+    }
+
+    const E_TransferSyntax xfer = options_.writeTransferSyntax_;
+    if (compressionQueue && xfer != EXS_Unknown && xfer != header->getOriginalXfer())
+      compressionQueue->add(fname, xfer);
+}
+
+OFBool DcmQueryRetrieveStoreContext::packFile(
+    DcmDataset *dataset,
+    const char* fname,
+    OFString& member)
+{
+    OFString seriesInstanceUID;
+    if (dataset == NULL || dataset->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID).bad() || seriesInstanceUID.empty())
+        return OFFalse;
+
+    const OFString pack = DcmQueryRetrievePackFile::packFileOf(fname, seriesInstanceUID.c_str());
+    if (DcmQueryRetrievePackFile::append(pack, fname, member).bad())
+    {
+      DCMQRDB_WARN("storescp: Cannot append image file to " << pack << ", keeping it as " << fname);
+      member.clear();
+      return OFFalse;
+    }
+    OFStandard::deleteFile(fname);
+    return OFTrue;
 }
 
 void DcmQueryRetrieveStoreContext::checkRequestAgainstDataset(
@@ -170,11 +230,23 @@ void DcmQueryRetrieveStoreContext::callbackHandler(
         }
 
         if (!options_.ignoreStoreData_ && rsp->DimseStatus == STATUS_Success) {
-            if ((imageDataSet)&&(*imageDataSet)) {
+            if (receivedFile) {
+                moveReceivedFile(*imageDataSet, fileName, rsp);
+            } else if ((imageDataSet)&&(*imageDataSet)) {
                 writeToFile(dcmff, fileName, rsp);
             }
+            // the complete file is appended to the pack of its series, the index refers to its copy there
+            OFString member;
+            if (rsp->DimseStatus == STATUS_Success && options_.packSeries_ && compressionQueue == NULL) {
+                packFile((imageDataSet) ? *imageDataSet : NULL, fileName, member);
+            }
+            // the instance is only acknowledged once its file is in the storage backend
+            if (rsp->DimseStatus == STATUS_Success && member.empty() && options_.storedFile_ && !options_.storedFile_(fileName)) {
+                DCMQRDB_ERROR("storescp: Cannot hand image file to the storage backend: " << fileName);
+                rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+            }
             if (rsp->DimseStatus == STATUS_Success) {
-                saveImageToDB(req, fileName, rsp, stDetail);
+                saveImageToDB(req, member.empty() ? fileName : member.c_str(), (imageDataSet) ? *imageDataSet : NULL, rsp, stDetail);
             }
         }
 
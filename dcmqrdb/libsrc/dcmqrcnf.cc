@@ -1092,6 +1092,37 @@ int DcmQueryRetrieveConfig::HostNamesForVendor(const char *Vendor, const char **
    return(CNF_VendorTable.HostEntries[i].noOfPeers);
 }
 
+int DcmQueryRetrieveConfig::preferCompressed(const char * /* AETitle */, const char * /* HostName */, const char * /* SOPClassUID */) const
+{
+   return -1;
+}
+
+void DcmQueryRetrieveConfig::transferCompleted(const char * /* AETitle */, const char * /* HostName */, Uint64 /* bytes */, double /* seconds */) const
+{
+}
+
+T_DIMSE_Priority DcmQueryRetrieveConfig::priorityForAETitle(const char * /* AETitle */, T_DIMSE_Priority requested) const
+{
+   return requested;
+}
+
+OFBool DcmQueryRetrieveConfig::admitAssociation(const char * /* AETitle */, const char * /* HostName */) const
+{
+   return OFTrue;
+}
+
+void DcmQueryRetrieveConfig::associationStarted(const char * /* AETitle */, const char * /* HostName */) const
+{
+}
+
+void DcmQueryRetrieveConfig::associationReleased(const char * /* AETitle */, const char * /* HostName */) const
+{
+}
+
+void DcmQueryRetrieveConfig::throttleTransfer(const char * /* AETitle */, const char * /* HostName */, Uint64 /* bytes */) const
+{
+}
+
 OFBool DcmQueryRetrieveConfig::writableStorageArea(const char *aeTitle) const
 {
     const char *axs = getAccess((char*)aeTitle);
@@ -0,0 +1,270 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveCompressionQueue
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmqrdb/dcmqrdcq.h"
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"    /* for DCMQRDB_ logging macros */
+#include "dcmtk/dcmqrdb/dcmqropt.h"
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcerror.h"
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/oftrace.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/** helper class describing a stored file waiting for compression. Internal use only.
+ */
+struct DcmQueryRetrieveCompressionJob
+{
+  /// file the instance is stored in
+  OFString filename;
+
+  /// transfer syntax the file is converted to
+  E_TransferSyntax xfer;
+};
+
+/** private implementation of DcmQueryRetrieveCompressionQueue. Internal use only.
+ */
+class DcmQueryRetrieveCompressionQueuePrivate
+{
+public:
+  DcmQueryRetrieveCompressionQueuePrivate(const DcmQueryRetrieveOptions& options)
+  : sequenceType_(options.sequenceType_)
+  , groupLength_(options.groupLength_)
+  , paddingType_(options.paddingType_)
+  , filepad_(OFstatic_cast(Uint32, options.filepad_))
+  , itempad_(OFstatic_cast(Uint32, options.itempad_))
+  , writeMode_(options.useMetaheader_ ? EWM_fileformat : EWM_dataset)
+  , storedFile_(options.storedFile_)
+  , active_(0)
+  , compressed_(0)
+  , failed_(0)
+  , stopping_(OFFalse)
+  {
+  }
+
+  /// converts one file, the original is kept if anything fails
+  OFCondition compress(const DcmQueryRetrieveCompressionJob& job) const;
+
+  /// encoding settings of the SCP for writing files
+  E_EncodingType sequenceType_;
+  E_GrpLenEncoding groupLength_;
+  E_PaddingEncoding paddingType_;
+  Uint32 filepad_;
+  Uint32 itempad_;
+  E_FileWriteMode writeMode_;
+
+  /// hook of the options, called with each replaced file
+  std::function<OFBool(const char *filename)> storedFile_;
+
+  /// files waiting, oldest first
+  std::deque<DcmQueryRetrieveCompressionJob> jobs_;
+
+  /// number of files being compressed
+  size_t active_;
+
+  size_t compressed_;
+  size_t failed_;
+
+  /// set by the destructor, the threads end after their current file
+  OFBool stopping_;
+
+  std::vector<std::thread> threads_;
+  mutable std::mutex mutex_;
+  std::condition_variable queued_;
+};
+
+
+/** returns size and modification time of a file, used to notice files
+ *  replaced by another store of the same instance while being compressed
+ */
+static OFBool fileVersion(const OFString& filename, off_t& size, time_t& modified)
+{
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) return OFFalse;
+  size = info.st_size;
+  modified = info.st_mtime;
+  return OFTrue;
+}
+
+
+/// lowers the scheduling priority of the calling thread to the minimum
+static void lowerThreadPriority()
+{
+#ifdef _WIN32
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+  // on Linux the nice value is a property of the thread
+  if (setpriority(PRIO_PROCESS, OFstatic_cast(id_t, syscall(SYS_gettid)), 19) != 0)
+    DCMQRDB_DEBUG("Compression queue: cannot lower the thread priority");
+#endif
+}
+
+
+OFCondition DcmQueryRetrieveCompressionQueuePrivate::compress(const DcmQueryRetrieveCompressionJob& job) const
+{
+  OFTraceSpan span("compressionQueue.compress");
+  /* background work, gets the slots left over by the sub-operations of the associations */
+  DcmQueryRetrieveScheduler::Ticket ticket(DcmQueryRetrieveScheduler::PC_Low, "compress");
+  off_t size = 0;
+  time_t modified = 0;
+  if (!fileVersion(job.filename, size, modified)) return EC_InvalidFilename;
+
+  DcmFileFormat fileformat;
+  OFCondition cond = fileformat.loadFile(job.filename);
+  if (cond.bad()) return cond;
+
+  DcmDataset *dataset = fileformat.getDataset();
+  if (dataset->getOriginalXfer() == job.xfer) return EC_Normal;
+  dataset->chooseRepresentation(job.xfer, NULL);
+  if (!dataset->canWriteXfer(job.xfer)) return EC_CannotChangeRepresentation;
+
+  // the temporary file is hidden, so a reindex of the storage area never picks it up
+  OFString directory;
+  OFString name;
+  OFStandard::getDirNameFromPath(directory, job.filename, OFFalse);
+  OFStandard::getFilenameFromPath(name, job.filename);
+  OFString tempFile = directory;
+  if (!tempFile.empty()) tempFile += PATH_SEPARATOR;
+  tempFile += ".";
+  tempFile += name;
+  tempFile += ".compress";
+
+  cond = fileformat.saveFile(tempFile, job.xfer, sequenceType_, groupLength_,
+    paddingType_, filepad_, itempad_, writeMode_);
+  if (cond.good())
+  {
+    off_t currentSize = 0;
+    time_t currentModified = 0;
+    if (!fileVersion(job.filename, currentSize, currentModified) || currentSize != size || currentModified != modified)
+    {
+      // stored again or deleted meanwhile, the newer file wins
+      DCMQRDB_DEBUG("Compression queue: " << job.filename << " changed while being compressed");
+      OFStandard::deleteFile(tempFile);
+      return EC_Normal;
+    }
+    // readers which opened the file before keep reading the original
+    if (!OFStandard::renameFile(tempFile, job.filename))
+      cond = EC_InvalidFilename;
+    else if (storedFile_ && !storedFile_(job.filename.c_str()))
+      DCMQRDB_WARN("Compression queue: cannot hand " << job.filename << " to the storage backend, which keeps the received version");
+  }
+  if (cond.bad())
+    OFStandard::deleteFile(tempFile);
+  return cond;
+}
+
+
+DcmQueryRetrieveCompressionQueue::DcmQueryRetrieveCompressionQueue(const DcmQueryRetrieveOptions& options, size_t threads)
+: d(new DcmQueryRetrieveCompressionQueuePrivate(options))
+{
+  if (threads == 0) threads = 1;
+  for (size_t i = 0; i < threads; ++i)
+    d->threads_.push_back(std::thread(&DcmQueryRetrieveCompressionQueue::run, this));
+}
+
+
+DcmQueryRetrieveCompressionQueue::~DcmQueryRetrieveCompressionQueue()
+{
+  {
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    d->stopping_ = OFTrue;
+    if (!d->jobs_.empty())
+      DCMQRDB_INFO("Compression queue: " << d->jobs_.size() << " files are kept in the received transfer syntax");
+    d->jobs_.clear();
+    d->queued_.notify_all();
+  }
+  for (size_t i = 0; i < d->threads_.size(); ++i)
+    d->threads_[i].join();
+  DCMQRDB_DEBUG("Compression queue: " << d->compressed_ << " files compressed, " << d->failed_ << " failed");
+  delete d;
+}
+
+
+void DcmQueryRetrieveCompressionQueue::add(const OFString& filename, E_TransferSyntax xfer)
+{
+  DcmQueryRetrieveCompressionJob job;
+  job.filename = filename;
+  job.xfer = xfer;
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  d->jobs_.push_back(job);
+  d->queued_.notify_one();
+}
+
+
+void DcmQueryRetrieveCompressionQueue::run()
+{
+  lowerThreadPriority();
+  std::unique_lock<std::mutex> lock(d->mutex_);
+  while (true)
+  {
+    d->queued_.wait(lock, [this]() { return d->stopping_ || !d->jobs_.empty(); });
+    if (d->stopping_) break;
+
+    const DcmQueryRetrieveCompressionJob job = d->jobs_.front();
+    d->jobs_.pop_front();
+    ++d->active_;
+    lock.unlock();
+
+    const OFCondition cond = d->compress(job);
+    if (cond.bad())
+      DCMQRDB_WARN("Compression queue: cannot convert " << job.filename << " to "
+        << DcmXfer(job.xfer).getXferName() << ", the file is kept as received: " << cond.text());
+
+    lock.lock();
+    --d->active_;
+    cond.good() ? ++d->compressed_ : ++d->failed_;
+  }
+}
+
+
+size_t DcmQueryRetrieveCompressionQueue::pending() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->jobs_.size() + d->active_;
+}
+
+
+size_t DcmQueryRetrieveCompressionQueue::compressed() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->compressed_;
+}
+
+
+size_t DcmQueryRetrieveCompressionQueue::failed() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->failed_;
+}
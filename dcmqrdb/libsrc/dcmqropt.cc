@@ -52,12 +52,19 @@ DcmQueryRetrieveOptions::DcmQueryRetrieveOptions()
 , restrictMoveToSameAE_(OFFalse)
 , restrictMoveToSameHost_(OFFalse)
 , restrictMoveToSameVendor_(OFFalse)
+, secureConnection_(OFFalse)
 , sequenceType_(EET_ExplicitLength)
 #ifdef HAVE_FORK
 , singleProcess_(OFFalse)
 #else
 , singleProcess_(OFTrue)
 #endif
+, maxWorkerThreads_(0)
+, moveSubAssociations_(1)
+, moveAsyncOperations_(1)
+, moveReadAhead_(0)
+, findReadAhead_(0)
+, asyncOperationsWindow_(1)
 , supportPatientRoot_(OFTrue)
 #ifdef NO_PATIENTSTUDYONLY_SUPPORT
 , supportPatientStudyOnly_(OFFalse)
@@ -70,7 +77,13 @@ DcmQueryRetrieveOptions::DcmQueryRetrieveOptions()
 , writeTransferSyntax_(EXS_Unknown)
 , blockMode_(DIMSE_BLOCKING)
 , dimse_timeout_(0)
+, idle_timeout_(0)
 , acse_timeout_(30)
+, transcodeCacheSize_(0)
+, transcodeCacheDirectory_()
+, compressionThreads_(0)
+, skipDuplicates_(OFFalse)
+, packSeries_(OFFalse)
 , associationConfigFile()
 , incomingProfile()
 , outgoingProfile()
@@ -0,0 +1,252 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrievePackFile
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"    /* for DCMQRDB_ logging macros */
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcistrmb.h"
+#include "dcmtk/dcmdata/dcerror.h"
+#include "dcmtk/ofstd/ofstd.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+const char *DcmQueryRetrievePackFile::extension = ".pack";
+
+/// magic at the start of each record
+static const char packMagic[8] = { 'D', 'C', 'M', 'P', 'A', 'C', 'K', '1' };
+
+/// length of the record header, the magic and the length of the DICOM file
+static const size_t packHeaderLength = 16;
+
+/// marker separating the pack file from offset and length in member names
+static const char packSeparator = '#';
+
+/// appends to the same pack are serialized, packs share one of these locks by the hash of their name
+static std::mutex packLocks[64];
+
+static std::mutex& packLock(const OFString& packFile)
+{
+  return packLocks[std::hash<std::string>()(packFile.c_str()) % (sizeof(packLocks) / sizeof(packLocks[0]))];
+}
+
+static void encodeLength(unsigned char *header, Uint64 length)
+{
+  memcpy(header, packMagic, sizeof(packMagic));
+  for (size_t i = 0; i < 8; ++i)
+    header[8 + i] = OFstatic_cast(unsigned char, (length >> (8 * i)) & 0xff);
+}
+
+static OFBool decodeLength(const unsigned char *header, Uint64& length)
+{
+  if (memcmp(header, packMagic, sizeof(packMagic)) != 0) return OFFalse;
+  length = 0;
+  for (size_t i = 0; i < 8; ++i)
+    length |= OFstatic_cast(Uint64, header[8 + i]) << (8 * i);
+  return OFTrue;
+}
+
+static OFString makeMember(const OFString& packFile, offile_off_t offset, offile_off_t length)
+{
+  char suffix[64];
+  sprintf(suffix, "%c%016llu,%llu", packSeparator, OFstatic_cast(unsigned long long, offset),
+    OFstatic_cast(unsigned long long, length));
+  return packFile + suffix;
+}
+
+static OFBool truncateFile(OFFile& file, offile_off_t length)
+{
+#ifdef _WIN32
+  return _chsize_s(file.fileNo(), length) == 0;
+#else
+  return ftruncate(file.fileNo(), length) == 0;
+#endif
+}
+
+
+OFBool DcmQueryRetrievePackFile::isMember(const char *filename)
+{
+  OFString packFile;
+  offile_off_t offset = 0;
+  offile_off_t length = 0;
+  return parseMember(filename, packFile, offset, length);
+}
+
+
+OFBool DcmQueryRetrievePackFile::parseMember(const char *member, OFString& packFile, offile_off_t& offset, offile_off_t& length)
+{
+  if (member == NULL) return OFFalse;
+  const char *separator = strrchr(member, packSeparator);
+  const size_t extensionLength = strlen(extension);
+  if (separator == NULL || OFstatic_cast(size_t, separator - member) < extensionLength ||
+      strncmp(separator - extensionLength, extension, extensionLength) != 0)
+    return OFFalse;
+
+  char *end = NULL;
+  const unsigned long long position = strtoull(separator + 1, &end, 10);
+  if (end == separator + 1 || *end != ',') return OFFalse;
+  const char *lengthField = end + 1;
+  const unsigned long long size = strtoull(lengthField, &end, 10);
+  if (end == lengthField || *end != '\0' || position < packHeaderLength) return OFFalse;
+
+  packFile.assign(member, separator - member);
+  offset = OFstatic_cast(offile_off_t, position);
+  length = OFstatic_cast(offile_off_t, size);
+  return OFTrue;
+}
+
+
+OFString DcmQueryRetrievePackFile::container(const char *filename)
+{
+  OFString packFile;
+  offile_off_t offset = 0;
+  offile_off_t length = 0;
+  if (parseMember(filename, packFile, offset, length)) return packFile;
+  return filename ? OFString(filename) : OFString();
+}
+
+
+OFString DcmQueryRetrievePackFile::packFileOf(const char *filename, const char *seriesInstanceUID)
+{
+  OFString directory;
+  OFStandard::getDirNameFromPath(directory, filename, OFFalse);
+  OFString packFile;
+  OFStandard::combineDirAndFilename(packFile, directory, OFString(seriesInstanceUID) + extension, OFTrue);
+  return packFile;
+}
+
+
+OFCondition DcmQueryRetrievePackFile::append(const OFString& packFile, const char *filename, OFString& member)
+{
+  OFFile in;
+  if (!in.fopen(filename, "rb")) return EC_InvalidFilename;
+  const offile_off_t length = OFstatic_cast(offile_off_t, OFStandard::getFileSize(filename));
+  if (length <= 0) return EC_InvalidStream;
+
+  std::lock_guard<std::mutex> lock(packLock(packFile));
+  OFFile out;
+  if (!out.fopen(packFile.c_str(), "ab")) return EC_InvalidFilename;
+  out.fseek(0, SEEK_END);
+  const offile_off_t start = out.ftell();
+
+  unsigned char header[packHeaderLength];
+  encodeLength(header, OFstatic_cast(Uint64, length));
+  OFBool ok = out.fwrite(header, 1, sizeof(header)) == sizeof(header);
+
+  std::vector<char> buffer(1024 * 1024);
+  offile_off_t copied = 0;
+  size_t count;
+  while (ok && (count = in.fread(&buffer[0], 1, buffer.size())) > 0)
+  {
+    ok = out.fwrite(&buffer[0], 1, count) == count;
+    copied += OFstatic_cast(offile_off_t, count);
+  }
+  ok = ok && in.error() == 0 && copied == length && out.fflush() == 0;
+  if (!ok)
+  {
+    // the next record starts where this one did, readers never saw it
+    if (!truncateFile(out, start))
+      DCMQRDB_WARN("Pack file: cannot remove the incomplete record at " << start << " of " << packFile);
+    return EC_InvalidStream;
+  }
+  if (out.fclose() != 0) return EC_InvalidStream;
+
+  member = makeMember(packFile, start + OFstatic_cast(offile_off_t, packHeaderLength), length);
+  return EC_Normal;
+}
+
+
+OFCondition DcmQueryRetrievePackFile::read(const char *member, std::vector<char>& bytes)
+{
+  OFString packFile;
+  offile_off_t offset = 0;
+  offile_off_t length = 0;
+  if (!parseMember(member, packFile, offset, length)) return EC_InvalidFilename;
+
+  OFFile file;
+  if (!file.fopen(packFile.c_str(), "rb")) return EC_InvalidFilename;
+  if (file.fseek(offset - OFstatic_cast(offile_off_t, packHeaderLength), SEEK_SET) != 0) return EC_InvalidStream;
+
+  // the record header guards against a member name not matching the pack, e.g. of an older index
+  unsigned char header[packHeaderLength];
+  Uint64 recordLength = 0;
+  if (file.fread(header, 1, sizeof(header)) != sizeof(header) || !decodeLength(header, recordLength) ||
+      recordLength != OFstatic_cast(Uint64, length))
+    return EC_InvalidStream;
+
+  bytes.resize(OFstatic_cast(size_t, length));
+  if (length > 0 && file.fread(&bytes[0], 1, bytes.size()) != bytes.size()) return EC_InvalidStream;
+  return EC_Normal;
+}
+
+
+OFCondition DcmQueryRetrievePackFile::load(const char *member, DcmFileFormat& fileformat, const DcmTagKey& stopParsingAtElement)
+{
+  std::vector<char> bytes;
+  OFCondition cond = read(member, bytes);
+  if (cond.bad()) return cond;
+  if (bytes.empty()) return EC_InvalidStream;
+
+  // the record is complete in memory, so parsing cannot run into the next one
+  DcmInputBufferStream stream;
+  stream.setBuffer(&bytes[0], OFstatic_cast(offile_off_t, bytes.size()));
+  stream.setEos();
+  fileformat.transferInit();
+  cond = fileformat.readUntilTag(stream, EXS_Unknown, EGL_noChange, DCM_MaxReadLength, stopParsingAtElement);
+  fileformat.transferEnd();
+  return cond;
+}
+
+
+OFCondition DcmQueryRetrievePackFile::list(const char *packFile, std::vector<OFString>& members)
+{
+  OFFile file;
+  if (!file.fopen(packFile, "rb")) return EC_InvalidFilename;
+  const offile_off_t size = OFstatic_cast(offile_off_t, OFStandard::getFileSize(packFile));
+
+  offile_off_t position = 0;
+  unsigned char header[packHeaderLength];
+  while (position + OFstatic_cast(offile_off_t, packHeaderLength) <= size)
+  {
+    Uint64 length = 0;
+    if (file.fseek(position, SEEK_SET) != 0 || file.fread(header, 1, sizeof(header)) != sizeof(header) ||
+        !decodeLength(header, length))
+      return members.empty() ? EC_InvalidStream : EC_Normal;
+    const offile_off_t start = position + OFstatic_cast(offile_off_t, packHeaderLength);
+    if (start + OFstatic_cast(offile_off_t, length) > size)
+    {
+      DCMQRDB_WARN("Pack file: incomplete record at " << position << " of " << packFile);
+      break;
+    }
+    members.push_back(makeMember(packFile, start, OFstatic_cast(offile_off_t, length)));
+    position = start + OFstatic_cast(offile_off_t, length);
+  }
+  return EC_Normal;
+}
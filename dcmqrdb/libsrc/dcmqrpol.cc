@@ -0,0 +1,209 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveAssociationPool
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmqrdb/dcmqrpol.h"
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"    /* for DCMQRDB_ logging macros */
+#include "dcmtk/dcmnet/dcmtrans.h"    /* for DcmTransportConnection::interrupt() */
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+/** helper class describing a queued association. Internal use only.
+ */
+struct DcmQueryRetrieveAssociationJob
+{
+  T_ASC_Association *assoc;
+  DcmQueryRetrieveAssociationHandler handler;
+  void *callbackData;
+};
+
+/** private implementation of DcmQueryRetrieveAssociationPool. Internal use only.
+ */
+class DcmQueryRetrieveAssociationPoolPrivate
+{
+public:
+  DcmQueryRetrieveAssociationPoolPrivate(size_t maxWorkers, size_t maxPending)
+  : maxWorkers_(maxWorkers > 0 ? maxWorkers : 1)
+  , maxPending_(maxPending)
+  , active_(0)
+  , idle_(0)
+  , stopping_(OFFalse)
+  {
+  }
+
+  /// main loop of a worker thread
+  void run();
+
+  size_t maxWorkers_;
+  size_t maxPending_;
+  size_t active_;
+  size_t idle_;
+  OFBool stopping_;
+  std::deque<DcmQueryRetrieveAssociationJob> queue_;
+  /// associations currently served by a worker
+  std::vector<T_ASC_Association *> running_;
+  std::vector<std::thread> workers_;
+  mutable std::mutex mutex_;
+  std::condition_variable wakeup_;
+  /// signalled whenever a worker has finished an association
+  std::condition_variable finished_;
+};
+
+
+void DcmQueryRetrieveAssociationPoolPrivate::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    ++idle_;
+    wakeup_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    --idle_;
+
+    // serve remaining associations even when stopping, they are already acknowledged
+    if (queue_.empty()) break;
+
+    DcmQueryRetrieveAssociationJob job = queue_.front();
+    queue_.pop_front();
+    ++active_;
+    running_.push_back(job.assoc);
+    lock.unlock();
+
+    OFCondition cond = job.handler(job.callbackData, job.assoc);
+    if (cond.bad())
+    {
+      OFString temp_str;
+      DCMQRDB_DEBUG("Association worker finished: " << DimseCondition::dump(temp_str, cond));
+    }
+
+    lock.lock();
+    --active_;
+    // the handler has destroyed the association, only the pointer is compared
+    running_.erase(std::find(running_.begin(), running_.end(), job.assoc));
+    finished_.notify_all();
+  }
+}
+
+
+DcmQueryRetrieveAssociationPool::DcmQueryRetrieveAssociationPool(size_t maxWorkers, size_t maxPending)
+: d(new DcmQueryRetrieveAssociationPoolPrivate(maxWorkers, maxPending))
+{
+}
+
+
+DcmQueryRetrieveAssociationPool::~DcmQueryRetrieveAssociationPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(d->mutex_);
+    d->stopping_ = OFTrue;
+  }
+  d->wakeup_.notify_all();
+  for (size_t i = 0; i < d->workers_.size(); ++i)
+  {
+    if (d->workers_[i].joinable()) d->workers_[i].join();
+  }
+  delete d;
+}
+
+
+OFBool DcmQueryRetrieveAssociationPool::submit(
+  T_ASC_Association *assoc,
+  DcmQueryRetrieveAssociationHandler handler,
+  void *callbackData)
+{
+  if (assoc == NULL || handler == NULL) return OFFalse;
+
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  if (d->stopping_) return OFFalse;
+  if (d->maxPending_ > 0 && (d->active_ + d->queue_.size()) >= d->maxPending_) return OFFalse;
+
+  DcmQueryRetrieveAssociationJob job;
+  job.assoc = assoc;
+  job.handler = handler;
+  job.callbackData = callbackData;
+  d->queue_.push_back(job);
+
+  // spawn another worker only if nobody is waiting for work
+  if (d->idle_ < d->queue_.size() && d->workers_.size() < d->maxWorkers_)
+  {
+    d->workers_.push_back(std::thread(&DcmQueryRetrieveAssociationPoolPrivate::run, d));
+  }
+  d->wakeup_.notify_one();
+
+  DCMQRDB_DEBUG("Association queued (active: " << d->active_ << ", queued: " << d->queue_.size()
+      << ", workers: " << d->workers_.size() << ")");
+  return OFTrue;
+}
+
+
+OFBool DcmQueryRetrieveAssociationPool::drain(int timeout)
+{
+  std::unique_lock<std::mutex> lock(d->mutex_);
+  d->stopping_ = OFTrue;
+  d->wakeup_.notify_all();
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout > 0 ? timeout : 0);
+  if (d->finished_.wait_until(lock, deadline, [this] { return d->active_ == 0 && d->queue_.empty(); }))
+    return OFTrue;
+
+  DCMQRDB_WARN("Aborting " << d->active_ + d->queue_.size() << " associations still open after " << timeout << " ms");
+  for (size_t i = 0; i < d->running_.size(); ++i)
+  {
+    DcmTransportConnection *connection = DUL_getTransportConnection(d->running_[i]->DULassociation);
+    if (connection) connection->interrupt();
+  }
+  for (size_t i = 0; i < d->queue_.size(); ++i)
+  {
+    DcmTransportConnection *connection = DUL_getTransportConnection(d->queue_[i].assoc->DULassociation);
+    if (connection) connection->interrupt();
+  }
+  return OFFalse;
+}
+
+
+size_t DcmQueryRetrieveAssociationPool::activeAssociations() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->active_;
+}
+
+
+size_t DcmQueryRetrieveAssociationPool::queuedAssociations() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->queue_.size();
+}
+
+
+size_t DcmQueryRetrieveAssociationPool::workerThreads() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->workers_.size();
+}
+
+
+OFBool DcmQueryRetrieveAssociationPool::isSaturated() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return (d->maxPending_ > 0) && ((d->active_ + d->queue_.size()) >= d->maxPending_);
+}
@@ -22,6 +22,7 @@
 #include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
 #include "dcmtk/dcmqrdb/dcmqrptb.h"
 #include "dcmtk/dcmqrdb/dcmqropt.h"
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"
 
 /** helper class that describes entries in the process slot table. Internal use only.
  */
@@ -35,6 +36,7 @@ public:
    *  @param processId process ID of child process
    *  @param startTime time the child process was started
    *  @param hasStorageAbility true if the child process is allowed to store
+   *  @param admitted true if the association holds an admission of the peer limits
    */
   DcmQueryRetrieveProcessSlot(
     const char *peerName,
@@ -42,7 +44,8 @@ public:
     const char *calledAETitle,
     int processId,
     time_t startTime,
-    OFBool hasStorageAbility);
+    OFBool hasStorageAbility,
+    OFBool admitted);
 
   /// destructor
   virtual ~DcmQueryRetrieveProcessSlot() {}
@@ -59,6 +62,14 @@ public:
   OFBool isProcessWithWriteAccess(
     const char *calledAETitle) const;
 
+  /** release the admission of the association served by the child process, if it holds one
+   *  @param config configuration that admitted the association
+   */
+  void releaseAdmission(const DcmQueryRetrieveConfig *config) const
+  {
+    if (admitted_ && config) config->associationReleased(callingAETitle_.c_str(), peerName_.c_str());
+  }
+
 private:
 
     /// hostname or IP address of peer system
@@ -78,6 +89,9 @@ private:
 
     /// true if the child process is allowed to store
     OFBool   hasStorageAbility_;
+
+    /// true if the association holds an admission of the peer limits until the child is reaped
+    OFBool   admitted_;
 };
 
 
@@ -87,13 +101,15 @@ DcmQueryRetrieveProcessSlot::DcmQueryRetrieveProcessSlot(
       const char *calledAETitle,
       int processId,
       time_t startTime,
-      OFBool hasStorageAbility)
+      OFBool hasStorageAbility,
+      OFBool admitted)
 : peerName_()
 , callingAETitle_()
 , calledAETitle_()
 , processId_(processId)
 , startTime_(startTime)
 , hasStorageAbility_(hasStorageAbility)
+, admitted_(admitted)
 {
   if (peerName) peerName_ = peerName;
   if (callingAETitle) callingAETitle_ = callingAETitle;
@@ -121,7 +137,7 @@ DcmQueryRetrieveProcessTable::~DcmQueryRetrieveProcessTable()
   }
 }
 
-void DcmQueryRetrieveProcessTable::addProcessToTable(int pid, T_ASC_Association * assoc)
+void DcmQueryRetrieveProcessTable::addProcessToTable(int pid, T_ASC_Association * assoc, OFBool admitted)
 {
     DIC_NODENAME peerName;
     DIC_AE       callingAETitle;
@@ -141,13 +157,13 @@ void DcmQueryRetrieveProcessTable::addProcessToTable(int pid, T_ASC_Association
     }
 
     DcmQueryRetrieveProcessSlot *slot = new DcmQueryRetrieveProcessSlot(
-      peerName, callingAETitle, calledAETitle, pid, time(NULL), hasStorageAbility);
+      peerName, callingAETitle, calledAETitle, pid, time(NULL), hasStorageAbility, admitted);
 
     /* add to start of list */
     table_.push_front(slot);
 }
 
-void DcmQueryRetrieveProcessTable::removeProcessFromTable(int pid)
+void DcmQueryRetrieveProcessTable::removeProcessFromTable(int pid, const DcmQueryRetrieveConfig *config)
 {
   OFListIterator(DcmQueryRetrieveProcessSlot *) first = table_.begin();
   OFListIterator(DcmQueryRetrieveProcessSlot *) last = table_.end();
@@ -155,6 +171,7 @@ void DcmQueryRetrieveProcessTable::removeProcessFromTable(int pid)
   {
     if ((*first)->matchesPID(pid))
     {
+      (*first)->releaseAdmission(config);
       delete (*first);
       table_.erase(first);
       return;
@@ -176,7 +193,7 @@ OFBool DcmQueryRetrieveProcessTable::haveProcessWithWriteAccess(const char *call
 }
 
 
-void DcmQueryRetrieveProcessTable::cleanChildren()
+void DcmQueryRetrieveProcessTable::cleanChildren(const DcmQueryRetrieveConfig *config)
 {
 #if defined(HAVE_WAITPID) || defined(HAVE_WAIT3)
 
@@ -217,7 +234,7 @@ void DcmQueryRetrieveProcessTable::cleanChildren()
         DCMQRDB_INFO("Cleaned up after child (" << child << ")");
 
         /* Remove Entry from Process Table */
-        removeProcessFromTable(child);
+        removeProcessFromTable(child, config);
       }
     }
 #else
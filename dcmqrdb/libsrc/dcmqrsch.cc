@@ -0,0 +1,183 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveScheduler
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/** state of the scheduler shared by all tickets. Internal use only.
+ */
+struct DcmQueryRetrieveSchedulerState
+{
+  DcmQueryRetrieveSchedulerState()
+  : slots(0)
+  , running(0)
+  , virtualTime(0)
+  , nextSerial(0)
+  {
+    weights[DcmQueryRetrieveScheduler::PC_High] = DcmQueryRetrieveScheduler::defaultHighWeight;
+    weights[DcmQueryRetrieveScheduler::PC_Medium] = DcmQueryRetrieveScheduler::defaultMediumWeight;
+    weights[DcmQueryRetrieveScheduler::PC_Low] = DcmQueryRetrieveScheduler::defaultLowWeight;
+    for (size_t i = 0; i < DcmQueryRetrieveScheduler::PC_Count; ++i) pass[i] = 0;
+  }
+
+  /** returns the class with waiting units the next slot goes to, PC_Count if none
+   *  is waiting. Expects mutex to be locked
+   */
+  DcmQueryRetrieveScheduler::PriorityClass next() const
+  {
+    DcmQueryRetrieveScheduler::PriorityClass result = DcmQueryRetrieveScheduler::PC_Count;
+    for (size_t i = 0; i < DcmQueryRetrieveScheduler::PC_Count; ++i) {
+      /* on equal virtual times the more urgent class goes first */
+      if (!queues[i].empty() && (result == DcmQueryRetrieveScheduler::PC_Count || pass[i] < pass[result]))
+        result = OFstatic_cast(DcmQueryRetrieveScheduler::PriorityClass, i);
+    }
+    return result;
+  }
+
+  /// slots, 0 for no limit
+  size_t slots;
+
+  /// units holding a slot
+  size_t running;
+
+  unsigned weights[DcmQueryRetrieveScheduler::PC_Count];
+
+  /// virtual time of each class, advanced by 1/weight with each grant
+  double pass[DcmQueryRetrieveScheduler::PC_Count];
+
+  /// virtual time of the last grant, an idle class resumes from here
+  double virtualTime;
+
+  /// serial numbers of the waiting units of each class, in order of arrival
+  std::deque<Uint64> queues[DcmQueryRetrieveScheduler::PC_Count];
+  Uint64 nextSerial;
+
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+static DcmQueryRetrieveSchedulerState& schedulerState()
+{
+  static DcmQueryRetrieveSchedulerState state;
+  return state;
+}
+
+static std::atomic<DcmQueryRetrieveScheduler::TimingCallback> schedulerTimingCallback(NULL);
+
+
+DcmQueryRetrieveScheduler::Ticket::Ticket(PriorityClass priorityClass, const char *stage)
+: class_(priorityClass < PC_Count ? priorityClass : PC_Medium)
+, stage_(stage)
+, waitSeconds_(0)
+, timer_()
+{
+  DcmQueryRetrieveSchedulerState& state = schedulerState();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  std::deque<Uint64>& queue = state.queues[class_];
+  if (queue.empty()) state.pass[class_] = std::max(state.pass[class_], state.virtualTime);
+  if (state.slots > 0 && (state.running >= state.slots || state.next() != PC_Count)) {
+    /* all slots taken or others waiting for them */
+    const Uint64 serial = state.nextSerial++;
+    queue.push_back(serial);
+    state.cond.wait(lock, [&state, &queue, serial, this] {
+      return state.slots == 0 || (state.running < state.slots && state.next() == class_ && queue.front() == serial);
+    });
+    queue.pop_front();
+  }
+  state.running++;
+  state.virtualTime = state.pass[class_];
+  state.pass[class_] += 1.0 / state.weights[class_];
+  /* the next waiting unit may take a slot that is still free */
+  if (state.next() != PC_Count) state.cond.notify_all();
+  waitSeconds_ = timer_.getDiff();
+  timer_.reset();
+}
+
+
+DcmQueryRetrieveScheduler::Ticket::~Ticket()
+{
+  DcmQueryRetrieveSchedulerState& state = schedulerState();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.running--;
+    if (state.next() != PC_Count) state.cond.notify_all();
+  }
+  TimingCallback callback = schedulerTimingCallback.load();
+  if (callback) callback(class_, stage_, waitSeconds_, timer_.getDiff());
+}
+
+
+void DcmQueryRetrieveScheduler::configure(size_t slots, unsigned high, unsigned medium, unsigned low)
+{
+  DcmQueryRetrieveSchedulerState& state = schedulerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.slots = slots;
+  state.weights[PC_High] = std::max(high, 1U);
+  state.weights[PC_Medium] = std::max(medium, 1U);
+  state.weights[PC_Low] = std::max(low, 1U);
+  state.cond.notify_all();
+}
+
+
+void DcmQueryRetrieveScheduler::setTimingCallback(TimingCallback callback)
+{
+  schedulerTimingCallback.store(callback);
+}
+
+
+DcmQueryRetrieveScheduler::PriorityClass DcmQueryRetrieveScheduler::classOf(T_DIMSE_Priority priority)
+{
+  switch (priority)
+  {
+    case DIMSE_PRIORITY_HIGH:
+      return PC_High;
+    case DIMSE_PRIORITY_LOW:
+      return PC_Low;
+    default:
+      return PC_Medium;
+  }
+}
+
+
+const char *DcmQueryRetrieveScheduler::name(PriorityClass priorityClass)
+{
+  switch (priorityClass)
+  {
+    case PC_High:
+      return "high";
+    case PC_Low:
+      return "low";
+    default:
+      return "medium";
+  }
+}
+
+
+size_t DcmQueryRetrieveScheduler::waiting(PriorityClass priorityClass)
+{
+  DcmQueryRetrieveSchedulerState& state = schedulerState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  return priorityClass < PC_Count ? state.queues[priorityClass].size() : 0;
+}
@@ -30,9 +30,16 @@
 #include "dcmtk/dcmqrdb/dcmqrcbm.h"    /* for class DcmQueryRetrieveMoveContext */
 #include "dcmtk/dcmqrdb/dcmqrcbg.h"    /* for class DcmQueryRetrieveGetContext */
 #include "dcmtk/dcmqrdb/dcmqrcbs.h"    /* for class DcmQueryRetrieveStoreContext */
+#include "dcmtk/dcmqrdb/dcmqrtcc.h"    /* for class DcmQueryRetrieveTranscodeCache */
+#include "dcmtk/dcmqrdb/dcmqrdcq.h"    /* for class DcmQueryRetrieveCompressionQueue */
+#include "dcmtk/ofstd/oftimer.h"       /* for class OFTimer */
+#include "dcmtk/ofstd/oftrace.h"       /* for class OFTraceSpan */
+#include "dcmtk/dcmnet/diutil.h"       /* for DU_cfindStatusString */
+
+#include <atomic>
+#include <set>
+#include <string>
 
-#include <thread>
-#include <future>
 
 static void findCallback(
   /* in */
@@ -49,6 +56,57 @@ static void findCallback(
 }
 
 
+/* matches of a Modality Worklist query, sent one per pending response */
+struct DcmQueryRetrieveWorklistContext
+{
+  DcmQueryRetrieveWorklistContext(const DcmQueryRetrieveOptions& options) : options_(options), matches(), next(0) {}
+
+  ~DcmQueryRetrieveWorklistContext()
+  {
+    for (; next < matches.size(); ++next) delete matches[next];
+  }
+
+  const DcmQueryRetrieveOptions& options_;
+  std::vector<DcmDataset*> matches;
+  size_t next;
+};
+
+static void worklistFindCallback(
+  /* in */
+  void *callbackData,
+  OFBool cancelled, T_DIMSE_C_FindRQ * /* request */,
+  DcmDataset *requestIdentifiers, int responseCount,
+  /* out */
+  T_DIMSE_C_FindRSP *response,
+  DcmDataset **responseIdentifiers,
+  DcmDataset **stDetail)
+{
+  DcmQueryRetrieveWorklistContext *context = OFstatic_cast(DcmQueryRetrieveWorklistContext *, callbackData);
+  if (responseCount == 1 && requestIdentifiers != NULL)
+  {
+    DCMQRDB_INFO("Worklist Find SCP Request Identifiers:" << OFendl << DcmObject::PrintHelper(*requestIdentifiers));
+    context->options_.worklistFind_(*requestIdentifiers, context->matches);
+  }
+  *stDetail = NULL;
+  if (cancelled)
+  {
+    response->DimseStatus = STATUS_FIND_Cancel_MatchingTerminatedDueToCancelRequest;
+  }
+  else if (context->next < context->matches.size())
+  {
+    /* handed over to DIMSE_findProvider, which deletes it once sent */
+    *responseIdentifiers = context->matches[context->next++];
+    response->DimseStatus = STATUS_Pending;
+  }
+  else
+  {
+    response->DimseStatus = STATUS_Success;
+  }
+  DCMQRDB_INFO("Worklist Find SCP Response " << responseCount << " [status: "
+          << DU_cfindStatusString(response->DimseStatus) << "]");
+}
+
+
 static void getCallback(
   /* in */
   void *callbackData,
@@ -88,9 +146,35 @@ static void storeCallback(
   T_DIMSE_C_StoreRSP *rsp,            /* final store response */
   DcmDataset **stDetail)
 {
+    OFstatic_cast(DcmQueryRetrieveStoreContext*, callbackData)->measureReceive(progress);
     if (progress->state == DIMSE_StoreEnd) {
         DcmQueryRetrieveStoreContext* context = OFstatic_cast(DcmQueryRetrieveStoreContext*, callbackData);
 
+        // resent instance received into the null device, the stored file stays as it is
+        if (context->isDuplicate())
+        {
+            DCMQRDB_INFO("Instance already stored, not writing it again: " << req->AffectedSOPInstanceUID);
+            context->setStatus(rsp->DimseStatus);
+            return;
+        }
+
+        // received as is into a file, only the header is parsed for the storage location and the index
+        DcmFileFormat header;
+        DcmDataset *headerDataSet = NULL;
+        if (imageDataSet == NULL || *imageDataSet == NULL)
+        {
+            if (rsp->DimseStatus != STATUS_Success || header.loadFileUntilTag(imageFileName, EXS_Unknown,
+                EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData).bad())
+            {
+                DCMQRDB_ERROR("Bad image file: " << imageFileName);
+                if (rsp->DimseStatus == STATUS_Success) rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+                context->setStatus(rsp->DimseStatus);
+                return;
+            }
+            headerDataSet = header.getDataset();
+            imageDataSet = &headerDataSet;
+            context->setReceivedFile(imageFileName);
+        }
 
         OFString studyInstanceUID;
         OFString sopInstanceUID;
@@ -130,12 +214,27 @@ DcmQueryRetrieveSCP::DcmQueryRetrieveSCP(
   const DcmAssociationConfiguration& associationConfiguration)
 : config_(&config)
 , processtable_()
+, workerPool_(NULL)
+, transcodeCache_(NULL)
+, compressionQueue_(NULL)
 , dbCheckFindIdentifier_(OFFalse)
 , dbCheckMoveIdentifier_(OFFalse)
 , factory_(factory)
 , options_(options)
 , associationConfiguration_(associationConfiguration)
 {
+  if (options_.transcodeCacheSize_ > 0 && !options_.transcodeCacheDirectory_.empty())
+    transcodeCache_ = new DcmQueryRetrieveTranscodeCache(options_.transcodeCacheDirectory_, options_.transcodeCacheSize_);
+  if (options_.compressionThreads_ > 0)
+    compressionQueue_ = new DcmQueryRetrieveCompressionQueue(options_, options_.compressionThreads_);
+}
+
+
+DcmQueryRetrieveSCP::~DcmQueryRetrieveSCP()
+{
+  delete workerPool_;
+  delete transcodeCache_;
+  delete compressionQueue_;
 }
 
 
@@ -179,28 +278,40 @@ OFCondition DcmQueryRetrieveSCP::dispatch(T_ASC_Association *assoc, OFBool corre
         while (cond.good() && (firstLoop || options_.keepDBHandleDuringAssociation_) )
         {
             firstLoop = OFFalse;
-            cond = DIMSE_receiveCommand(assoc, DIMSE_BLOCKING, 0, &presID, &msg, NULL);
+            cond = DIMSE_receiveCommand(assoc, options_.idle_timeout_ > 0 ? DIMSE_NONBLOCKING : DIMSE_BLOCKING,
+                options_.idle_timeout_, &presID, &msg, NULL);
 
             /* did peer release, abort, or do we have a valid message ? */
             if (cond.good())
             {
                 /* process command */
+                OFTimer timer;
+                const char *operation = NULL;
                 switch (msg.CommandField) {
                 case DIMSE_C_ECHO_RQ:
+                    operation = "echo";
                     cond = echoSCP(assoc, &msg.msg.CEchoRQ, presID);
                     break;
                 case DIMSE_C_STORE_RQ:
+                    operation = "store";
                     cond = storeSCP(assoc, &msg.msg.CStoreRQ, presID, *dbHandle, correctUIDPadding);
                     break;
                 case DIMSE_C_FIND_RQ:
+                    operation = "find";
                     cond = findSCP(assoc, &msg.msg.CFindRQ, presID, *dbHandle);
                     break;
                 case DIMSE_C_MOVE_RQ:
+                    operation = "move";
                     cond = moveSCP(assoc, &msg.msg.CMoveRQ, presID, *dbHandle);
                     break;
                 case DIMSE_C_GET_RQ:
+                    operation = "get";
                     cond = getSCP(assoc, &msg.msg.CGetRQ, presID, *dbHandle);
                     break;
+                case DIMSE_N_ACTION_RQ:
+                    operation = "commit";
+                    cond = actionSCP(assoc, &msg.msg.NActionRQ, presID, *dbHandle);
+                    break;
                 case DIMSE_C_CANCEL_RQ:
                     /* This is a late cancel request, just ignore it */
                     DCMQRDB_INFO("dispatch: late C-CANCEL-RQ, ignoring");
@@ -212,11 +323,18 @@ OFCondition DcmQueryRetrieveSCP::dispatch(T_ASC_Association *assoc, OFBool corre
                             (unsigned)msg.CommandField);
                     /* the condition will be returned, the caller will abort the association. */
                 }
+                if (operation && options_.operationTiming_)
+                    options_.operationTiming_(operation, timer.getDiff(), cond.good());
             }
             else if ((cond == DUL_PEERREQUESTEDRELEASE)||(cond == DUL_PEERABORTEDASSOCIATION))
             {
                 // association gone
             }
+            else if (cond == DIMSE_NODATAAVAILABLE)
+            {
+                // the caller aborts the association, its worker serves live peers again
+                DCMQRDB_INFO("dispatch: no request within " << options_.idle_timeout_ << " seconds, aborting idle association");
+            }
             else
             {
                 // the condition will be returned, the caller will abort the association.
@@ -243,8 +361,12 @@ OFCondition DcmQueryRetrieveSCP::handleAssociation(T_ASC_Association * assoc, OF
     ASC_getPresentationAddresses(assoc->params, peerHostName, sizeof(peerHostName), NULL, 0);
     ASC_getAPTitles(assoc->params, peerAETitle, sizeof(peerAETitle), myAETitle, sizeof(myAETitle), NULL, 0);
 
-    /* now do the real work */
+    /* now do the real work, the spans recorded meanwhile are attributed to the association */
+    OFTraceContext context(OFTrace::nextAssociation());
+    OFTimer timer;
     cond = dispatch(assoc, correctUIDPadding);
+    if (options_.operationTiming_)
+        options_.operationTiming_("association", timer.getDiff(), cond == DUL_PEERREQUESTEDRELEASE);
 
     /* clean up on association termination */
     if (cond == DUL_PEERREQUESTEDRELEASE) {
@@ -272,6 +394,19 @@ OFCondition DcmQueryRetrieveSCP::handleAssociation(T_ASC_Association * assoc, OF
 }
 
 
+OFCondition DcmQueryRetrieveSCP::associationWorker(void *callbackData, T_ASC_Association *assoc)
+{
+    DcmQueryRetrieveSCP *scp = OFstatic_cast(DcmQueryRetrieveSCP *, callbackData);
+    /* the association is gone once handled, keep the peer for the limits */
+    const OFString callingAETitle = assoc->params->DULparams.callingAPTitle;
+    const OFString callingHost = assoc->params->DULparams.callingPresentationAddress;
+    scp->config_->associationStarted(callingAETitle.c_str(), callingHost.c_str());
+    OFCondition cond = scp->handleAssociation(assoc, scp->options_.correctUIDPadding_);
+    scp->config_->associationReleased(callingAETitle.c_str(), callingHost.c_str());
+    return cond;
+}
+
+
 OFCondition DcmQueryRetrieveSCP::echoSCP(T_ASC_Association * assoc, T_DIMSE_C_EchoRQ * req,
         T_ASC_PresentationContextID presId)
 {
@@ -296,6 +431,7 @@ OFCondition DcmQueryRetrieveSCP::findSCP(T_ASC_Association * assoc, T_DIMSE_C_Fi
 
 {
     OFCondition cond = EC_Normal;
+    OFTraceSpan span("qr.find");
     DcmQueryRetrieveFindContext context(dbHandle, options_, STATUS_Pending, config_->getCharacterSetOptions());
 
     DIC_AE aeTitle;
@@ -306,8 +442,18 @@ OFCondition DcmQueryRetrieveSCP::findSCP(T_ASC_Association * assoc, T_DIMSE_C_Fi
     OFString temp_str;
     DCMQRDB_INFO("Received Find SCP:" << OFendl << DIMSE_dumpMessage(temp_str, *request, DIMSE_INCOMING));
 
-    cond = DIMSE_findProvider(assoc, presID, request,
-        findCallback, &context, options_.blockMode_, options_.dimse_timeout_);
+    if (options_.worklistFind_ && 0 == strcmp(request->AffectedSOPClassUID, UID_FINDModalityWorklistInformationModel))
+    {
+        /* the worklist is not part of the index, it is answered by its provider */
+        DcmQueryRetrieveWorklistContext worklist(options_);
+        cond = DIMSE_findProvider(assoc, presID, request,
+            worklistFindCallback, &worklist, options_.blockMode_, options_.dimse_timeout_);
+    }
+    else
+    {
+        cond = DIMSE_findProvider(assoc, presID, request,
+            findCallback, &context, options_.blockMode_, options_.dimse_timeout_);
+    }
     if (cond.bad()) {
         DCMQRDB_ERROR("Find SCP Failed: " << DimseCondition::dump(temp_str, cond));
     }
@@ -315,11 +461,132 @@ OFCondition DcmQueryRetrieveSCP::findSCP(T_ASC_Association * assoc, T_DIMSE_C_Fi
 }
 
 
+OFCondition DcmQueryRetrieveSCP::actionSCP(T_ASC_Association * assoc, T_DIMSE_N_ActionRQ * request,
+        T_ASC_PresentationContextID presID,
+        DcmQueryRetrieveDatabaseHandle& dbHandle)
+{
+    OFCondition cond = EC_Normal;
+    OFTraceSpan span("qr.commit");
+    OFString temp_str;
+    DCMQRDB_INFO("Received Action SCP:" << OFendl << DIMSE_dumpMessage(temp_str, *request, DIMSE_INCOMING));
+
+    DcmDataset *actionInfo = NULL;
+    if (request->DataSetType != DIMSE_DATASET_NULL)
+    {
+        T_ASC_PresentationContextID dataPresID = presID;
+        cond = DIMSE_receiveDataSetInMemory(assoc, options_.blockMode_, options_.dimse_timeout_,
+            &dataPresID, &actionInfo, NULL, NULL);
+        if (cond.bad()) {
+            DCMQRDB_ERROR("Action SCP Failed: " << DimseCondition::dump(temp_str, cond));
+            return cond;
+        }
+    }
+
+    T_DIMSE_Message rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.CommandField = DIMSE_N_ACTION_RSP;
+    T_DIMSE_N_ActionRSP& response = rsp.msg.NActionRSP;
+    response.MessageIDBeingRespondedTo = request->MessageID;
+    OFStandard::strlcpy(response.AffectedSOPClassUID, request->RequestedSOPClassUID, sizeof(response.AffectedSOPClassUID));
+    OFStandard::strlcpy(response.AffectedSOPInstanceUID, request->RequestedSOPInstanceUID, sizeof(response.AffectedSOPInstanceUID));
+    response.ActionTypeID = request->ActionTypeID;
+    response.DataSetType = DIMSE_DATASET_NULL;
+    response.opts = O_NACTION_AFFECTEDSOPCLASSUID | O_NACTION_AFFECTEDSOPINSTANCEUID | O_NACTION_ACTIONTYPEID;
+    response.DimseStatus = STATUS_Success;
+
+    DcmDataset eventInfo;
+    OFBool failures = OFFalse;
+    OFString transactionUID;
+    if (!options_.storageCommitmentReport_ || 0 != strcmp(request->RequestedSOPClassUID, UID_StorageCommitmentPushModelSOPClass))
+    {
+        response.DimseStatus = STATUS_N_NoSuchSOPClass;
+    }
+    else if (0 != strcmp(request->RequestedSOPInstanceUID, UID_StorageCommitmentPushModelSOPInstance))
+    {
+        response.DimseStatus = STATUS_N_NoSuchObjectInstance;
+    }
+    else if (request->ActionTypeID != 1)
+    {
+        response.DimseStatus = STATUS_N_NoSuchAction;
+    }
+    else if (actionInfo == NULL || actionInfo->findAndGetOFString(DCM_TransactionUID, transactionUID).bad() || transactionUID.empty())
+    {
+        response.DimseStatus = STATUS_N_MissingAttribute;
+    }
+    else
+    {
+        /* all instances are looked up at once instead of one query each */
+        OFList<OFString> classes;
+        OFList<OFString> instances;
+        DcmItem *item = NULL;
+        for (unsigned long i = 0; actionInfo->findAndGetSequenceItem(DCM_ReferencedSOPSequence, item, OFstatic_cast(signed long, i)).good(); ++i)
+        {
+            OFString sopClass;
+            OFString sopInstance;
+            item->findAndGetOFString(DCM_ReferencedSOPClassUID, sopClass);
+            item->findAndGetOFString(DCM_ReferencedSOPInstanceUID, sopInstance);
+            classes.push_back(sopClass);
+            instances.push_back(sopInstance);
+        }
+        OFList<OFString> storedList;
+        dbHandle.storedInstances(instances, storedList);
+        std::set<std::string> stored;
+        for (OFListIterator(OFString) it = storedList.begin(); it != storedList.end(); ++it)
+            stored.insert((*it).c_str());
+
+        eventInfo.putAndInsertOFStringArray(DCM_TransactionUID, transactionUID);
+        size_t committed = 0;
+        OFListIterator(OFString) sopClass = classes.begin();
+        for (OFListIterator(OFString) sopInstance = instances.begin(); sopInstance != instances.end(); ++sopInstance, ++sopClass)
+        {
+            const OFBool isStored = stored.count((*sopInstance).c_str()) > 0;
+            DcmItem *reference = NULL;
+            if (eventInfo.findOrCreateSequenceItem(isStored ? DCM_ReferencedSOPSequence : DCM_FailedSOPSequence, reference, -2).good())
+            {
+                reference->putAndInsertOFStringArray(DCM_ReferencedSOPClassUID, *sopClass);
+                reference->putAndInsertOFStringArray(DCM_ReferencedSOPInstanceUID, *sopInstance);
+                if (!isStored) reference->putAndInsertUint16(DCM_FailureReason, STATUS_N_NoSuchObjectInstance);
+            }
+            if (isStored) ++committed; else failures = OFTrue;
+        }
+        DCMQRDB_INFO("Storage Commitment " << transactionUID << ": " << committed << " of " << instances.size() << " instances committed");
+    }
+    delete actionInfo;
+
+    cond = DIMSE_sendMessageUsingMemoryData(assoc, presID, &rsp, NULL, NULL, NULL, NULL);
+    if (cond.bad()) {
+        DCMQRDB_ERROR("Action SCP Failed: " << DimseCondition::dump(temp_str, cond));
+        return cond;
+    }
+
+    /* the report is owed once the request is accepted, it is sent on an association of its own */
+    if (response.DimseStatus == STATUS_Success)
+    {
+        DIC_AE callingTitle;
+        callingTitle[0] = '\0';
+        ASC_getAPTitles(assoc->params, callingTitle, sizeof(callingTitle), NULL, 0, NULL, 0);
+        options_.storageCommitmentReport_(callingTitle, eventInfo, failures ? 2 : 1);
+    }
+    return cond;
+}
+
+
+T_DIMSE_Priority DcmQueryRetrieveSCP::schedulingPriority(T_ASC_Association * assoc, T_DIMSE_Priority requested) const
+{
+    if (config_ == NULL) return requested;
+    DIC_AE callingTitle;
+    callingTitle[0] = '\0';
+    ASC_getAPTitles(assoc->params, callingTitle, sizeof(callingTitle), NULL, 0, NULL, 0);
+    return config_->priorityForAETitle(callingTitle, requested);
+}
+
+
 OFCondition DcmQueryRetrieveSCP::getSCP(T_ASC_Association * assoc, T_DIMSE_C_GetRQ * request,
         T_ASC_PresentationContextID presID, DcmQueryRetrieveDatabaseHandle& dbHandle)
 {
     OFCondition cond = EC_Normal;
-    DcmQueryRetrieveGetContext context(dbHandle, options_, STATUS_Pending, assoc, request->MessageID, request->Priority, presID);
+    OFTraceSpan span("qr.get");
+    DcmQueryRetrieveGetContext context(dbHandle, options_, STATUS_Pending, assoc, request->MessageID, schedulingPriority(assoc, request->Priority), presID);
 
     DIC_AE aeTitle;
     aeTitle[0] = '\0';
@@ -342,12 +609,14 @@ OFCondition DcmQueryRetrieveSCP::moveSCP(T_ASC_Association * assoc, T_DIMSE_C_Mo
         T_ASC_PresentationContextID presID, DcmQueryRetrieveDatabaseHandle& dbHandle)
 {
     OFCondition cond = EC_Normal;
-    DcmQueryRetrieveMoveContext context(dbHandle, options_, associationConfiguration_, config_, STATUS_Pending, assoc, request->MessageID, request->Priority);
+    OFTraceSpan span("qr.move");
+    DcmQueryRetrieveMoveContext context(dbHandle, options_, associationConfiguration_, config_, STATUS_Pending, assoc, request->MessageID, schedulingPriority(assoc, request->Priority));
 
     DIC_AE aeTitle;
     aeTitle[0] = '\0';
     ASC_getAPTitles(assoc->params, NULL, 0, aeTitle, sizeof(aeTitle), NULL, 0);
     context.setOurAETitle(aeTitle);
+    context.setTranscodeCache(transcodeCache_);
 
     OFString temp_str;
     DCMQRDB_INFO("Received Move SCP:" << OFendl << DIMSE_dumpMessage(temp_str, *request, DIMSE_INCOMING));
@@ -361,6 +630,17 @@ OFCondition DcmQueryRetrieveSCP::moveSCP(T_ASC_Association * assoc, T_DIMSE_C_Mo
 }
 
 
+OFBool DcmQueryRetrieveSCP::storesAsReceived(T_ASC_Association * assoc, T_ASC_PresentationContextID presId) const
+{
+    if (options_.bitPreserving_ || options_.writeTransferSyntax_ == EXS_Unknown || compressionQueue_)
+        return OFTrue;
+    T_ASC_PresentationContext pc;
+    if (ASC_findAcceptedPresentationContext(assoc->params, presId, &pc).bad())
+        return OFFalse;
+    return DcmXfer(pc.acceptedTransferSyntax).getXfer() == options_.writeTransferSyntax_;
+}
+
+
 OFCondition DcmQueryRetrieveSCP::storeSCP(T_ASC_Association * assoc, T_DIMSE_C_StoreRQ * request,
              T_ASC_PresentationContextID presId,
              DcmQueryRetrieveDatabaseHandle& dbHandle,
@@ -369,9 +649,13 @@ OFCondition DcmQueryRetrieveSCP::storeSCP(T_ASC_Association * assoc, T_DIMSE_C_S
     OFCondition cond = EC_Normal;
     OFCondition dbcond = EC_Normal;
     char imageFileName[MAXPATHLEN+1];
+    OFBool receiveIntoFile = OFFalse;
     DcmFileFormat dcmff;
+    OFTraceContext traceContext(0, request->AffectedSOPInstanceUID);
+    OFTraceSpan span("qr.store");
 
     DcmQueryRetrieveStoreContext context(dbHandle, options_, STATUS_Success, &dcmff, correctUIDPadding);
+    context.setCompressionQueue(compressionQueue_);
 
     OFString temp_str;
     DCMQRDB_INFO("Received Store SCP:" << OFendl << DIMSE_dumpMessage(temp_str, *request, DIMSE_INCOMING));
@@ -394,6 +678,23 @@ OFCondition DcmQueryRetrieveSCP::storeSCP(T_ASC_Association * assoc, T_DIMSE_C_S
             OFStandard::strlcpy(imageFileName, NULL_DEVICE_NAME, sizeof(imageFileName));
             /* callback will send back out of resources status */
             context.setStatus(STATUS_STORE_Refused_OutOfResources);
+        } else if (options_.skipDuplicates_ && dbHandle.isInstanceStored(request->AffectedSOPInstanceUID)) {
+            /* the byte stream of an instance already stored is discarded as received,
+             * without parsing it, and the C-STORE acknowledged */
+            OFStandard::strlcpy(imageFileName, NULL_DEVICE_NAME, sizeof(imageFileName));
+            receiveIntoFile = OFTrue;
+            context.setDuplicate(OFTrue);
+        } else if (storesAsReceived(assoc, presId)) {
+            /* the byte stream is written as received, without decoding and encoding the dataset.
+             * The storage location depends on the header, so it is received into a hidden file
+             * of the storage area and moved in place by the callback */
+            static std::atomic<unsigned long> received(0);
+            char name[64];
+            sprintf(name, ".receiving-%ld-%lu", OFStandard::getProcessID(), ++received);
+            OFString path;
+            OFStandard::combineDirAndFilename(path, config_->getStorageArea("any"), name, OFTrue);
+            OFStandard::strlcpy(imageFileName, path.c_str(), sizeof(imageFileName));
+            receiveIntoFile = OFTrue;
         }
     }
 
@@ -432,7 +733,7 @@ OFCondition DcmQueryRetrieveSCP::storeSCP(T_ASC_Association * assoc, T_DIMSE_C_S
 
     /* we must still retrieve the data set even if some error has occurred */
 
-    if (options_.bitPreserving_) { /* the bypass option can be set on the command line */
+    if (receiveIntoFile) {
         cond = DIMSE_storeProvider(assoc, presId, request, imageFileName, (int)options_.useMetaheader_,
                                    NULL, storeCallback,
                                    (void*)&context, options_.blockMode_, options_.dimse_timeout_);
@@ -445,6 +746,10 @@ OFCondition DcmQueryRetrieveSCP::storeSCP(T_ASC_Association * assoc, T_DIMSE_C_S
     if (cond.bad()) {
         DCMQRDB_ERROR("Store SCP Failed: " << DimseCondition::dump(temp_str, cond));
     }
+    else if (assoc && assoc->params && context.getReceivedBytes() > 0) {
+        config_->transferCompleted(assoc->params->DULparams.callingAPTitle, assoc->params->DULparams.callingPresentationAddress,
+            context.getReceivedBytes(), context.getReceiveSeconds());
+    }
     if (!options_.ignoreStoreData_ && (cond.bad() || (context.getStatus() != STATUS_Success)))
     {
       /* remove file */
@@ -575,6 +880,49 @@ OFCondition DcmQueryRetrieveSCP::refuseAssociation(T_ASC_Association ** assoc, C
 }
 
 
+/* the first transfer syntax proposed in pc of the lossless ones for images, deflate for other
+ * objects, or of the uncompressed ones, NULL if none was proposed
+ */
+static const char *preferredTransferSyntax(const T_ASC_PresentationContext& pc, OFBool compressed)
+{
+    static const char *lossless[] = {
+        UID_JPEGLSLosslessTransferSyntax,
+        UID_JPEG2000LosslessOnlyTransferSyntax,
+        UID_JPEGProcess14SV1TransferSyntax,
+        UID_RLELosslessTransferSyntax
+    };
+    static const char *uncompressed[] = {
+        UID_LittleEndianExplicitTransferSyntax,
+        UID_BigEndianExplicitTransferSyntax,
+        UID_LittleEndianImplicitTransferSyntax
+    };
+    const char **syntaxes = uncompressed;
+    size_t count = sizeof(uncompressed) / sizeof(uncompressed[0]);
+    if (compressed && dcmIsImageStorageSOPClassUID(pc.abstractSyntax))
+    {
+        syntaxes = lossless;
+        count = sizeof(lossless) / sizeof(lossless[0]);
+    }
+    else if (compressed)
+    {
+#ifdef WITH_ZLIB
+        static const char *deflated[] = { UID_DeflatedExplicitVRLittleEndianTransferSyntax };
+        syntaxes = deflated;
+        count = 1;
+#else
+        return NULL;
+#endif
+    }
+    for (size_t k = 0; k < count; k++)
+    {
+        for (int j = 0; j < (int)pc.transferSyntaxCount; j++)
+        {
+            if (strcmp(pc.proposedTransferSyntaxes[j], syntaxes[k]) == 0) return syntaxes[k];
+        }
+    }
+    return NULL;
+}
+
 OFCondition DcmQueryRetrieveSCP::negotiateAssociation(T_ASC_Association * assoc)
 {
     OFCondition cond = EC_Normal;
@@ -596,6 +944,8 @@ OFCondition DcmQueryRetrieveSCP::negotiateAssociation(T_ASC_Association * assoc)
 
     const char* transferSyntaxes[] = { NULL, NULL, NULL, NULL };
     int numTransferSyntaxes = 0;
+    /* non-image objects are accepted deflated when proposed, unless a transfer syntax is configured */
+    OFBool acceptDeflated = OFFalse;
 
     switch (options_.networkTransferSyntax_)
     {
@@ -781,6 +1131,9 @@ OFCondition DcmQueryRetrieveSCP::negotiateAssociation(T_ASC_Association * assoc)
         }
         transferSyntaxes[2] = UID_LittleEndianImplicitTransferSyntax;
         numTransferSyntaxes = 3;
+#ifdef WITH_ZLIB
+        acceptDeflated = OFTrue;
+#endif
         break;
     }
 
@@ -798,6 +1151,8 @@ OFCondition DcmQueryRetrieveSCP::negotiateAssociation(T_ASC_Association * assoc)
         UID_FINDStudyRootQueryRetrieveInformationModel,
         UID_MOVEStudyRootQueryRetrieveInformationModel,
         UID_GETStudyRootQueryRetrieveInformationModel,
+        UID_FINDModalityWorklistInformationModel,
+        UID_StorageCommitmentPushModelSOPClass,
         UID_PrivateShutdownSOPClass
     };
 
@@ -842,6 +1197,14 @@ OFCondition DcmQueryRetrieveSCP::negotiateAssociation(T_ASC_Association * assoc)
         {
           if (options_.supportStudyRoot_ && (! options_.disableGetSupport_)) selectedNonStorageSyntaxes[numberOfSelectedNonStorageSyntaxes++] = nonStorageSyntaxes[i];
         }
+        else if (0 == strcmp(nonStorageSyntaxes[i], UID_FINDModalityWorklistInformationModel))
+        {
+          if (options_.worklistFind_) selectedNonStorageSyntaxes[numberOfSelectedNonStorageSyntaxes++] = nonStorageSyntaxes[i];
+        }
+        else if (0 == strcmp(nonStorageSyntaxes[i], UID_StorageCommitmentPushModelSOPClass))
+        {
+          if (options_.storageCommitmentReport_) selectedNonStorageSyntaxes[numberOfSelectedNonStorageSyntaxes++] = nonStorageSyntaxes[i];
+        }
         else if (0 == strcmp(nonStorageSyntaxes[i], UID_PrivateShutdownSOPClass))
         {
           if (options_.allowShutdown_) selectedNonStorageSyntaxes[numberOfSelectedNonStorageSyntaxes++] = nonStorageSyntaxes[i];
@@ -903,6 +1266,58 @@ OFCondition DcmQueryRetrieveSCP::negotiateAssociation(T_ASC_Association * assoc)
           }
         } /* for */
       } /* else */
+
+      if (acceptDeflated)
+      {
+        /* structured reports, RT structure sets, encapsulated documents and the like
+         * shrink most with deflate, so it overrides the transfer syntax accepted above
+         */
+        T_ASC_PresentationContext pc;
+        int npc = ASC_countPresentationContexts(assoc->params);
+        for (i = 0; i < npc; i++)
+        {
+          ASC_getPresentationContext(assoc->params, i, &pc);
+          if (!dcmIsaStorageSOPClassUID(pc.abstractSyntax) || dcmIsImageStorageSOPClassUID(pc.abstractSyntax))
+            continue;
+          for (int j = 0; j < (int)pc.transferSyntaxCount; j++)
+          {
+            if (strcmp(pc.proposedTransferSyntaxes[j], UID_DeflatedExplicitVRLittleEndianTransferSyntax) == 0)
+            {
+              cond = ASC_acceptPresentationContext(assoc->params, pc.presentationContextID,
+                UID_DeflatedExplicitVRLittleEndianTransferSyntax,
+                options_.disableGetSupport_ ? ASC_SC_ROLE_DEFAULT : pc.proposedRole);
+              if (cond.bad()) return cond;
+              break;
+            }
+          }
+        }
+      }
+
+      /* the configuration may prefer compressed or uncompressed transfer syntaxes
+       * on the link to the calling peer, e.g. measured on earlier transfers
+       */
+      DIC_AE callingAETitle;
+      DIC_NODENAME callingHostName;
+      ASC_getAPTitles(assoc->params, callingAETitle, sizeof(callingAETitle), NULL, 0, NULL, 0);
+      ASC_getPresentationAddresses(assoc->params, callingHostName, sizeof(callingHostName), NULL, 0);
+      T_ASC_PresentationContext pc;
+      int npc = ASC_countPresentationContexts(assoc->params);
+      for (i = 0; i < npc; i++)
+      {
+        ASC_getPresentationContext(assoc->params, i, &pc);
+        if (pc.resultReason != ASC_P_ACCEPTANCE || pc.acceptedTransferSyntax[0] == '\0' || !dcmIsaStorageSOPClassUID(pc.abstractSyntax))
+          continue;
+        int compressed = config_->preferCompressed(callingAETitle, callingHostName, pc.abstractSyntax);
+        if (compressed < 0)
+          continue;
+        const char *preferred = preferredTransferSyntax(pc, compressed > 0);
+        if (preferred != NULL && strcmp(preferred, pc.acceptedTransferSyntax) != 0)
+        {
+          cond = ASC_acceptPresentationContext(assoc->params, pc.presentationContextID, preferred,
+            options_.disableGetSupport_ ? ASC_SC_ROLE_DEFAULT : pc.proposedRole);
+          if (cond.bad()) return cond;
+        }
+      }
     }
     else
     {
@@ -979,6 +1394,38 @@ OFCondition DcmQueryRetrieveSCP::negotiateAssociation(T_ASC_Association * assoc)
         }
     }
 
+    /*
+     * Grant an asynchronous operations window if the requestor proposed one.
+     * The requests are still performed one at a time, the C-STORE sub-operations
+     * of a C-GET are sent up to the number the requestor performs asynchronously.
+     * While they stream, only their responses and a C-CANCEL are expected on the
+     * association, so a requestor that may send a C-GET gets one outstanding
+     * request and cannot pipeline another request behind it.
+     */
+    if (options_.asyncOperationsWindow_ > 1)
+    {
+        unsigned short invoked = 1;
+        unsigned short performed = 1;
+        ASC_getAsyncOperationsWindow(assoc->params, &invoked, &performed);
+        if (options_.disableGetSupport_) performed = 1;
+        else if (ASC_findAcceptedPresentationContextID(assoc, UID_GETPatientRootQueryRetrieveInformationModel) ||
+                 ASC_findAcceptedPresentationContextID(assoc, UID_GETStudyRootQueryRetrieveInformationModel) ||
+                 ASC_findAcceptedPresentationContextID(assoc, UID_RETIRED_GETPatientStudyOnlyQueryRetrieveInformationModel))
+        {
+            invoked = 1;
+        }
+        if (invoked != 1 || performed != 1)
+        {
+            /* 0 means unlimited, never exceed the configured window */
+            const unsigned short limit = OFstatic_cast(unsigned short, options_.asyncOperationsWindow_);
+            const unsigned short grantedInvoked = (invoked == 0 || invoked > limit) ? limit : invoked;
+            const unsigned short grantedPerformed = (performed == 0 || performed > limit) ? limit : performed;
+            DCMQRDB_DEBUG("Granting asynchronous operations window: " << grantedInvoked << " outstanding requests, "
+                << grantedPerformed << " outstanding C-GET sub-operations");
+            ASC_setAsyncOperationsWindow(assoc->params, grantedInvoked, grantedPerformed);
+        }
+    }
+
     return cond;
 }
 
@@ -994,6 +1441,10 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
     char                buf[BUFSIZ];
     int timeout;
     OFBool go_cleanup = OFFalse;
+    /* admitted by the limits of the peer and not yet handed to a worker thread */
+    OFBool admitted = OFFalse;
+    OFString callingAETitle;
+    OFString callingHost;
 
     if (options_.singleProcess_) timeout = 1000;
     else
@@ -1008,7 +1459,7 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
 
     if (ASC_associationWaiting(theNet, timeout))
     {
-        cond = ASC_receiveAssociation(theNet, &assoc, (int)options_.maxPDU_);
+        cond = ASC_receiveAssociation(theNet, &assoc, (int)options_.maxPDU_, NULL, NULL, options_.secureConnection_);
         if (cond.bad())
         {
           DCMQRDB_INFO("Failed to receive association: " << DimseCondition::dump(temp_str, cond));
@@ -1024,6 +1475,20 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
 
         DCMQRDB_DEBUG("Parameters:" << OFendl << ASC_dumpParameters(temp_str, assoc->params, ASC_ASSOC_RQ));
 
+        /* peers over their rate or concurrency limits are refused before any negotiation */
+        callingAETitle = assoc->params->DULparams.callingAPTitle;
+        callingHost = assoc->params->DULparams.callingPresentationAddress;
+        if (! config_->admitAssociation(callingAETitle.c_str(), callingHost.c_str()))
+        {
+            DCMQRDB_INFO("Refusing Association (limits of peer exceeded)");
+            cond = refuseAssociation(&assoc, CTN_TooManyAssociations);
+            go_cleanup = OFTrue;
+        }
+        else admitted = OFTrue;
+    }
+
+    if (! go_cleanup)
+    {
         if (options_.refuse_)
         {
             DCMQRDB_INFO("Refusing Association (forced via command line)");
@@ -1077,7 +1542,7 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
     if (! go_cleanup)
     {
         // too many concurrent associations ??
-        if (processtable_.countChildProcesses() >= OFstatic_cast(size_t, options_.maxAssociations_))
+        if (activeAssociations() + queuedAssociations() >= OFstatic_cast(size_t, options_.maxAssociations_))
         {
             cond = refuseAssociation(&assoc, CTN_TooManyAssociations);
             go_cleanup = OFTrue;
@@ -1109,8 +1574,27 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
 
         if (options_.singleProcess_)
         {
-            /* don't spawn a sub-process to handle the association */
-            std::async(std::launch::async, &DcmQueryRetrieveSCP::handleAssociation, this, assoc, options_.correctUIDPadding_);
+            /* don't spawn a sub-process, hand the association over to a worker thread */
+            if (workerPool_ == NULL)
+            {
+                size_t maxWorkers = OFstatic_cast(size_t, options_.maxWorkerThreads_ > 0 ? options_.maxWorkerThreads_ : options_.maxAssociations_);
+                workerPool_ = new DcmQueryRetrieveAssociationPool(maxWorkers, OFstatic_cast(size_t, options_.maxAssociations_));
+            }
+            if (!workerPool_->submit(assoc, &DcmQueryRetrieveSCP::associationWorker, this))
+            {
+                /* the association is already acknowledged, so we can only abort it */
+                DCMQRDB_WARN("Worker pool saturated, aborting association");
+                ASC_abortAssociation(assoc);
+                ASC_dropAssociation(assoc);
+                ASC_destroyAssociation(&assoc);
+            }
+            else
+            {
+                /* associationWorker() releases it */
+                admitted = OFFalse;
+                DCMQRDB_DEBUG("Associations active: " << workerPool_->activeAssociations()
+                    << ", queued: " << workerPool_->queuedAssociations());
+            }
         }
 #ifdef HAVE_FORK
         else
@@ -1126,8 +1610,11 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
             }
             else if (pid > 0)
             {
-                /* parent process, note process in table */
-                processtable_.addProcessToTable(pid, assoc);
+                /* parent process, note process in table. The admission is held
+                 * until the child is reaped in cleanChildren()
+                 */
+                processtable_.addProcessToTable(pid, assoc, admitted);
+                admitted = OFFalse;
             }
             else
             {
@@ -1141,6 +1628,7 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
     }
 
     // cleanup code
+    if (admitted) config_->associationReleased(callingAETitle.c_str(), callingHost.c_str());
     OFCondition oldcond = cond;    /* store condition flag for later use */
     if (!options_.singleProcess_ && (cond != ASC_SHUTDOWNAPPLICATION))
     {
@@ -1164,7 +1652,27 @@ OFCondition DcmQueryRetrieveSCP::waitForAssociation(T_ASC_Network * theNet)
 
 void DcmQueryRetrieveSCP::cleanChildren()
 {
-  processtable_.cleanChildren();
+  processtable_.cleanChildren(config_);
+}
+
+
+size_t DcmQueryRetrieveSCP::activeAssociations() const
+{
+  if (options_.singleProcess_)
+    return workerPool_ ? workerPool_->activeAssociations() : 0;
+  return processtable_.countChildProcesses();
+}
+
+
+size_t DcmQueryRetrieveSCP::queuedAssociations() const
+{
+  return workerPool_ ? workerPool_->queuedAssociations() : 0;
+}
+
+
+OFBool DcmQueryRetrieveSCP::drainAssociations(int timeout)
+{
+  return workerPool_ ? workerPool_->drain(timeout) : OFTrue;
 }
 
 
@@ -0,0 +1,320 @@
+/*
+ *
+ *  Copyright (C) 1993-2019, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: C-STORE sub-operations of the C-MOVE and C-GET contexts (internal)
+ *
+ */
+
+#ifndef DCMQRSUB_H
+#define DCMQRSUB_H
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/assoc.h"
+#include "dcmtk/dcmqrdb/dcmqropt.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
+#include "dcmtk/dcmqrdb/qrdefine.h"
+#include "dcmtk/ofstd/oftimer.h"
+#include "dcmtk/ofstd/oftrace.h"
+
+BEGIN_EXTERN_C
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>       /* for posix_fadvise */
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+END_EXTERN_C
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/** helper class describing a queued C-STORE sub-operation. Internal use only.
+ */
+struct DcmQueryRetrieveMoveJob
+{
+  std::string sopClass;
+  std::string sopInstance;
+  std::string filename;
+};
+
+/** C-STORE sub-operation sent on a sub-association, or on the association of a
+ *  C-GET, whose response is outstanding. Internal use only.
+ */
+struct DcmQueryRetrieveMoveSubOp
+{
+  DIC_US msgId;
+  std::string sopInstance;
+  /// file that was sent, a transcode cache entry to be released if cached is set
+  std::string sendFile;
+  OFBool cached;
+#ifdef LOCK_IMAGE_FILES
+  int lockfd;
+#endif
+};
+
+/** C-STORE sub-operations awaiting their response on one association, up to the
+ *  asynchronous operations window granted by the move destination, or to the one
+ *  granted to the C-GET requestor. Internal use only.
+ */
+class DcmQueryRetrieveMoveSubOps
+{
+public:
+  DcmQueryRetrieveMoveSubOps(T_ASC_Association *assoc, int maxOperations)
+  : window_(1)
+  , completed_(0)
+  {
+    unsigned short granted = 1;
+    if (maxOperations > 1 && ASC_getAsyncOperationsWindow(assoc->params, &granted, NULL).good()) {
+      /* 0 means unlimited, never exceed what was proposed */
+      window_ = (granted == 0 || granted > maxOperations) ? OFstatic_cast(size_t, maxOperations) : granted;
+      DCMQRDB_DEBUG("Move SCP: up to " << window_ << " outstanding sub-operations on the sub-association");
+    }
+  }
+
+  explicit DcmQueryRetrieveMoveSubOps(size_t window)
+  : window_(window > 1 ? window : 1)
+  , completed_(0)
+  {
+  }
+
+  /// number of sub-operations that may be outstanding
+  size_t window_;
+  std::deque<DcmQueryRetrieveMoveSubOp> pending_;
+
+  /// sub-operations whose response was received (or which failed) since it was last reset
+  size_t completed_;
+};
+
+/** read-ahead stage of C-MOVE and C-GET sub-operations performed serially. Jobs are fetched
+ *  from the database ahead of the sub-operation being sent and their files are read
+ *  by an I/O thread, so that disk and network latency overlap. The number of files
+ *  read ahead, which are also announced to the kernel to be read in parallel,
+ *  follows the ratio of the measured read and send times. Internal use only.
+ */
+class DcmQueryRetrieveMovePrefetch
+{
+public:
+  DcmQueryRetrieveMovePrefetch(size_t maxDepth, const std::function<OFBool(const char *)>& fetchFile,
+    DcmQueryRetrieveScheduler::PriorityClass priorityClass, const char *spanName = "move.readAhead")
+  : exhausted_(OFFalse)
+  , fetchFile_(fetchFile)
+  , priorityClass_(priorityClass)
+  , spanName_(spanName)
+  , association_(OFTraceContext::association())
+  , maxDepth_(maxDepth)
+  , depth_(1)
+  , read_(0)
+  , advised_(0)
+  , readTime_(0)
+  , sendTime_(0)
+  , stopping_(OFFalse)
+  {
+    thread_ = std::thread(&DcmQueryRetrieveMovePrefetch::run, this);
+  }
+
+  ~DcmQueryRetrieveMovePrefetch()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = OFTrue;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+
+  /// number of jobs to be fetched ahead of the sub-operation being sent
+  size_t depth()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return depth_;
+  }
+
+  /// number of jobs fetched but not sent yet
+  size_t queued()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.size();
+  }
+
+  /// adds a job fetched from the database, its file is read by the I/O thread
+  void push(const DcmQueryRetrieveMoveJob& job)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+    cond_.notify_all();
+  }
+
+  /// removes the next job once its file has been read, returns false if there is none
+  OFBool pop(DcmQueryRetrieveMoveJob& job)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (jobs_.empty()) return OFFalse;
+    cond_.wait(lock, [this] { return read_ > 0; });
+    job = jobs_.front();
+    jobs_.pop_front();
+    read_--;
+    if (advised_ > 0) advised_--;
+    return OFTrue;
+  }
+
+  /// adapts the depth to the time the sub-operation of the last job took
+  void sent(double seconds)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sendTime_ = average(sendTime_, seconds);
+    adapt();
+  }
+
+  /// removes the jobs not sent yet, returns their number
+  size_t clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t count = jobs_.size();
+    jobs_.clear();
+    read_ = 0;
+    advised_ = 0;
+    return count;
+  }
+
+  /// set once the database has returned its last job, only used by the provider thread
+  OFBool exhausted_;
+
+private:
+  static double average(double avg, double sample)
+  {
+    return avg > 0 ? 0.75 * avg + 0.25 * sample : sample;
+  }
+
+  void adapt()
+  {
+    /* a disk slower than the network needs more reads in flight to keep up,
+     * otherwise one file ahead hides the read
+     */
+    if (readTime_ > 0 && sendTime_ > 0) {
+      const size_t ratio = OFstatic_cast(size_t, ceil(readTime_ / sendTime_));
+      depth_ = std::max<size_t>(std::min(ratio + 1, maxDepth_), 1);
+    }
+  }
+
+  void readFile(const std::string& filename, std::vector<char>& buffer)
+  {
+    /* files kept in another store are fetched here, ahead of the sub-operation */
+    if (fetchFile_ && !fetchFile_(DcmQueryRetrievePackFile::container(filename.c_str()).c_str())) return;
+    /* an instance in a pack file is read from its offset only */
+    if (DcmQueryRetrievePackFile::isMember(filename.c_str())) {
+      std::vector<char> bytes;
+      DcmQueryRetrievePackFile::read(filename.c_str(), bytes);
+      return;
+    }
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (f == NULL) return; /* the sub-operation reports the error */
+    while (fread(&buffer[0], 1, buffer.size(), f) == buffer.size()) {}
+    fclose(f);
+  }
+
+  void run()
+  {
+    OFTraceContext context(association_);
+    std::vector<char> buffer(1024 * 1024);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      if (read_ >= jobs_.size()) {
+        cond_.wait(lock);
+        continue;
+      }
+      const std::string filename = jobs_[read_].filename;
+      const std::string sopInstance = jobs_[read_].sopInstance;
+      std::vector<std::string> ahead;
+#ifdef POSIX_FADV_WILLNEED
+      advised_ = std::max(advised_, read_ + 1);
+      for (; advised_ < jobs_.size() && advised_ < read_ + depth_; ++advised_) {
+        ahead.push_back(jobs_[advised_].filename);
+      }
+#endif
+      lock.unlock();
+
+#ifdef POSIX_FADV_WILLNEED
+      for (size_t i = 0; i < ahead.size(); ++i) {
+        OFString file(ahead[i].c_str());
+        offile_off_t offset = 0;
+        offile_off_t length = 0;
+        DcmQueryRetrievePackFile::parseMember(ahead[i].c_str(), file, offset, length);
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd >= 0) {
+          posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+          close(fd);
+        }
+      }
+#endif
+      OFTimer timer;
+      {
+        OFTraceContext instance(0, sopInstance.c_str());
+        OFTraceSpan span(spanName_);
+        DcmQueryRetrieveScheduler::Ticket ticket(priorityClass_, "readAhead");
+        readFile(filename, buffer);
+      }
+      const double seconds = timer.getDiff();
+
+      lock.lock();
+      readTime_ = average(readTime_, seconds);
+      adapt();
+      /* the jobs may have been cleared while the file was read */
+      if (read_ < jobs_.size()) read_++;
+      cond_.notify_all();
+    }
+  }
+
+  /// hook of the options making sure a file is on local disk
+  std::function<OFBool(const char *)> fetchFile_;
+
+  /// class the reads are scheduled in, the one of the C-MOVE or C-GET
+  DcmQueryRetrieveScheduler::PriorityClass priorityClass_;
+
+  /// name of the trace spans of the reads
+  const char *spanName_;
+
+  /// association of the request, for the trace spans of the I/O thread
+  Uint64 association_;
+
+  size_t maxDepth_;
+  size_t depth_;
+  std::deque<DcmQueryRetrieveMoveJob> jobs_;
+
+  /// number of jobs at the front of the queue whose file has been read
+  size_t read_;
+
+  /// number of jobs at the front of the queue announced to the kernel
+  size_t advised_;
+
+  /// moving averages of the seconds needed to read and to send a file
+  double readTime_;
+  double sendTime_;
+
+  OFBool stopping_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,309 @@
+/*
+ *
+ *  Copyright (C) 1993-2018, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  dcmqrdb
+ *
+ *  Purpose: class DcmQueryRetrieveTranscodeCache
+ *
+ */
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmqrdb/dcmqrtcc.h"
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"    /* for DCMQRDB_ logging macros */
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcerror.h"
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/oflist.h"
+#include "dcmtk/ofstd/oftrace.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <string>
+
+#define DCMQRTCC_EXTENSION ".dcm"
+#define DCMQRTCC_TEMP_EXTENSION ".tmp"
+
+/** helper class describing a cached file. Internal use only.
+ */
+struct DcmQueryRetrieveTranscodeCacheEntry
+{
+  DcmQueryRetrieveTranscodeCacheEntry()
+  : size(0)
+  , pins(0)
+  , pending(OFTrue)
+  , lru()
+  {
+  }
+
+  /// size of the cached file in bytes
+  size_t size;
+
+  /// number of callers currently sending the file
+  size_t pins;
+
+  /// true while the file is being transcoded
+  OFBool pending;
+
+  /// position in the LRU list
+  std::list<std::string>::iterator lru;
+};
+
+/** private implementation of DcmQueryRetrieveTranscodeCache. Internal use only.
+ */
+class DcmQueryRetrieveTranscodeCachePrivate
+{
+public:
+  DcmQueryRetrieveTranscodeCachePrivate(const OFString& directory, size_t maxSize)
+  : directory_(directory)
+  , maxSize_(maxSize)
+  , size_(0)
+  , hits_(0)
+  , misses_(0)
+  , evictions_(0)
+  {
+  }
+
+  /// returns the name of the cached file for a key
+  OFString filename(const std::string& key, const char *extension) const
+  {
+    OFString result = directory_;
+    result += PATH_SEPARATOR;
+    result += key.c_str();
+    result += extension;
+    return result;
+  }
+
+  /// adds the files found in the cache directory to the index
+  void scan();
+
+  /// deletes unpinned entries, least recently used first, until the cache fits its limit
+  void evict();
+
+  OFString directory_;
+  size_t maxSize_;
+  size_t size_;
+  size_t hits_;
+  size_t misses_;
+  size_t evictions_;
+
+  /// entries by key, the key is "<SOP Instance UID>_<transfer syntax UID>"
+  std::map<std::string, DcmQueryRetrieveTranscodeCacheEntry> index_;
+
+  /// keys, most recently used first
+  std::list<std::string> lru_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable transcoded_;
+};
+
+
+void DcmQueryRetrieveTranscodeCachePrivate::scan()
+{
+  OFList<OFString> files;
+  OFStandard::searchDirectoryRecursively(directory_, files, "", "", OFFalse);
+
+  const size_t extLen = strlen(DCMQRTCC_EXTENSION);
+  for (OFListIterator(OFString) it = files.begin(); it != files.end(); ++it)
+  {
+    OFString name;
+    OFStandard::getFilenameFromPath(name, *it);
+    if (name.size() > extLen && name.compare(name.size() - extLen, extLen, DCMQRTCC_EXTENSION) == 0)
+    {
+      std::string key(name.c_str(), name.size() - extLen);
+      DcmQueryRetrieveTranscodeCacheEntry& entry = index_[key];
+      entry.size = OFStandard::getFileSize(*it);
+      entry.pending = OFFalse;
+      lru_.push_back(key);
+      entry.lru = --lru_.end();
+      size_ += entry.size;
+    }
+    else
+    {
+      // left over by a transcoding that did not complete
+      OFStandard::deleteFile(*it);
+    }
+  }
+  DCMQRDB_DEBUG("Transcode cache: " << index_.size() << " files (" << size_ << " bytes) found in " << directory_);
+  evict();
+}
+
+
+void DcmQueryRetrieveTranscodeCachePrivate::evict()
+{
+  std::list<std::string>::iterator it = lru_.end();
+  while (size_ > maxSize_ && it != lru_.begin())
+  {
+    --it;
+    std::map<std::string, DcmQueryRetrieveTranscodeCacheEntry>::iterator entry = index_.find(*it);
+    if (entry->second.pins > 0 || entry->second.pending) continue;
+
+    OFStandard::deleteFile(filename(*it, DCMQRTCC_EXTENSION));
+    size_ -= entry->second.size;
+    ++evictions_;
+    index_.erase(entry);
+    it = lru_.erase(it);
+  }
+}
+
+
+DcmQueryRetrieveTranscodeCache::DcmQueryRetrieveTranscodeCache(const OFString& directory, size_t maxSize)
+: d(new DcmQueryRetrieveTranscodeCachePrivate(directory, maxSize))
+{
+  OFCondition cond = OFStandard::createDirectory(directory, "");
+  if (cond.bad())
+    DCMQRDB_WARN("Transcode cache: cannot create directory " << directory << ": " << cond.text());
+  else
+    d->scan();
+}
+
+
+DcmQueryRetrieveTranscodeCache::~DcmQueryRetrieveTranscodeCache()
+{
+  delete d;
+}
+
+
+OFCondition DcmQueryRetrieveTranscodeCache::acquire(
+  const char *sopInstanceUID,
+  const char *sourceFile,
+  E_TransferSyntax xfer,
+  OFString& cachedFile)
+{
+  if (sopInstanceUID == NULL || sourceFile == NULL) return EC_IllegalCall;
+
+  DcmXfer xferSyn(xfer);
+  std::string key(sopInstanceUID);
+  key += '_';
+  key += xferSyn.getXferID();
+  cachedFile = d->filename(key, DCMQRTCC_EXTENSION);
+
+  std::unique_lock<std::mutex> lock(d->mutex_);
+  std::map<std::string, DcmQueryRetrieveTranscodeCacheEntry>::iterator it;
+  while ((it = d->index_.find(key)) != d->index_.end() && it->second.pending)
+  {
+    // another association is transcoding the same instance
+    d->transcoded_.wait(lock);
+  }
+
+  if (it != d->index_.end())
+  {
+    ++d->hits_;
+    ++it->second.pins;
+    d->lru_.splice(d->lru_.begin(), d->lru_, it->second.lru);
+    return EC_Normal;
+  }
+
+  ++d->misses_;
+  DcmQueryRetrieveTranscodeCacheEntry& entry = d->index_[key];
+  d->lru_.push_front(key);
+  entry.lru = d->lru_.begin();
+  lock.unlock();
+
+  OFTraceSpan span("transcodeCache.convert");
+  DcmFileFormat fileformat;
+  OFCondition cond = fileformat.loadFile(sourceFile);
+  if (cond.good())
+  {
+    DcmDataset *dataset = fileformat.getDataset();
+    dataset->chooseRepresentation(xfer, NULL);
+    if (!dataset->canWriteXfer(xfer))
+      cond = EC_CannotChangeRepresentation;
+  }
+  const OFString tempFile = d->filename(key, DCMQRTCC_TEMP_EXTENSION);
+  if (cond.good())
+    cond = fileformat.saveFile(tempFile, xfer);
+  if (cond.good() && !OFStandard::renameFile(tempFile, cachedFile))
+    cond = EC_InvalidFilename;
+  size_t size = 0;
+  if (cond.good())
+    size = OFStandard::getFileSize(cachedFile);
+  else
+    OFStandard::deleteFile(tempFile);
+
+  lock.lock();
+  it = d->index_.find(key);
+  if (cond.good())
+  {
+    it->second.pending = OFFalse;
+    it->second.pins = 1;
+    it->second.size = size;
+    d->size_ += size;
+    d->evict();
+  }
+  else
+  {
+    DCMQRDB_WARN("Transcode cache: cannot convert " << sourceFile << " to "
+      << xferSyn.getXferName() << ": " << cond.text());
+    d->lru_.erase(it->second.lru);
+    d->index_.erase(it);
+  }
+  d->transcoded_.notify_all();
+  return cond;
+}
+
+
+void DcmQueryRetrieveTranscodeCache::release(const OFString& cachedFile)
+{
+  OFString name;
+  OFStandard::getFilenameFromPath(name, cachedFile);
+  const size_t extLen = strlen(DCMQRTCC_EXTENSION);
+  if (name.size() <= extLen) return;
+  std::string key(name.c_str(), name.size() - extLen);
+
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  std::map<std::string, DcmQueryRetrieveTranscodeCacheEntry>::iterator it = d->index_.find(key);
+  if (it != d->index_.end() && it->second.pins > 0)
+  {
+    --it->second.pins;
+    // entries added while all others were pinned may have left the cache above its limit
+    d->evict();
+  }
+}
+
+
+size_t DcmQueryRetrieveTranscodeCache::hits() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->hits_;
+}
+
+
+size_t DcmQueryRetrieveTranscodeCache::misses() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->misses_;
+}
+
+
+size_t DcmQueryRetrieveTranscodeCache::evictions() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->evictions_;
+}
+
+
+size_t DcmQueryRetrieveTranscodeCache::size() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->size_;
+}
+
+
+size_t DcmQueryRetrieveTranscodeCache::entries() const
+{
+  std::lock_guard<std::mutex> lock(d->mutex_);
+  return d->index_.size();
+}
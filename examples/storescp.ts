@@ -23,15 +23,17 @@ const scpOptions: storeScpOptions = {
     verbose: true,
     storeOnly: true, // do not provide FindSCP and MoveSCP (requires db) only StoreSCP
     writeFile: false, // do not write file to disk, send via buffer as base64 in response (only taken into account when storeOnly is true)
+    binaryBuffer: true, // send the buffer as second callback argument instead of base64 in the response (only taken into account when writeFile is false)
+    maxAssociations: 128, // maximum number of concurrently served (or queued) associations
 };
 
 // starting the store scp for this example to actually receive anything from the move
-startStoreScp(scpOptions, (result) => {
+startStoreScp(scpOptions, (result, buffer) => {
     const msg = JSON.parse(result);
 
     // retrieve and store the image 
     if (msg.message === 'BUFFER_STORAGE') {
-        let buff = Buffer.from(msg.container.base64, 'base64');
+        let buff = buffer ? buffer : Buffer.from(msg.container.base64, 'base64');
         const directory = `${scpOptions.storagePath}/${msg.container.StudyInstanceUID}`;
         const filepath = `${directory}/${msg.container.SOPInstanceUID}.dcm`;
         if (!fs.existsSync(directory)) {
@@ -1,39 +1,326 @@
+import { Readable } from "stream";
 export interface Node {
     aet: string;
     ip: string;
-    port: string;
+    port: number;
+    compression?: 'auto' | 'compressed' | 'uncompressed';
+    priority?: Priority;
+}
+export declare type Priority = 'high' | 'medium' | 'low';
+export interface RateLimit {
+    associationsPerSecond?: number;
+    burst?: number;
+    concurrentAssociations?: number;
+    bytesPerSecond?: number;
+}
+export interface IndexTuning {
+    cacheSize?: number;
+    mmapSize?: number;
+    pageSize?: number;
+    journalMode?: "wal" | "truncate" | "delete";
+    synchronous?: "off" | "normal" | "full" | "extra";
+    tempStore?: "default" | "file" | "memory";
 }
 export interface KeyValue {
     key: string;
     value: string;
 }
-interface scuOptions {
+export interface AbortSignalLike {
+    readonly aborted: boolean;
+    addEventListener(type: "abort", listener: () => void): void;
+    removeEventListener(type: "abort", listener: () => void): void;
+}
+export interface Cancellable {
+    signal?: AbortSignalLike;
+}
+interface scuOptions extends Cancellable {
     source: Node;
     target: Node;
     verbose?: boolean;
+    nativeResult?: boolean;
+    reuseAssociation?: boolean;
+    associationIdleTimeout?: number;
+    priority?: Priority;
+    maxPdu?: number;
+    socketBufferSize?: number;
+    tcpNoDelay?: boolean;
+    tcpKeepAlive?: number;
+    tcpKeepAliveInterval?: number;
+    acseTimeout?: number;
+    dimseTimeout?: number;
+    tls?: boolean;
+    tlsCertificate?: string;
+    tlsPrivateKey?: string;
+    tlsCaCertificates?: string;
+    tlsCiphers?: string;
+    tlsVerifyPeer?: boolean;
+    tlsServerName?: string;
 }
-interface scpOptions {
+interface scpOptions extends Cancellable {
     source: Node;
     peers: Node[];
     verbose?: boolean;
+    nativeResult?: boolean;
+    maxPdu?: number;
+    socketBufferSize?: number;
+    tcpNoDelay?: boolean;
+    tcpKeepAlive?: number;
+    tcpKeepAliveInterval?: number;
+    acseTimeout?: number;
+    dimseTimeout?: number;
+    associationIdleTimeout?: number;
+    tls?: boolean;
+    tlsCertificate?: string;
+    tlsPrivateKey?: string;
+    tlsCaCertificates?: string;
+    tlsCiphers?: string;
+    tlsVerifyPeer?: boolean;
+    ioUring?: boolean;
+    eventBatchSize?: number;
+    eventFlushInterval?: number;
+}
+export declare type Result = any;
+export interface Request {
+    cancel(): void;
 }
 export interface echoScuOptions extends scuOptions {
 }
+export interface echoManyOptions extends Omit<scuOptions, 'target' | 'reuseAssociation' | 'associationIdleTimeout'> {
+    peers: Node[];
+}
 export interface findScuOptions extends scuOptions {
+    netTransferPrefer?: string;
+    tags: KeyValue[];
+    charset?: string;
+    chunkSize?: number;
+    maxResults?: number;
+    cacheTtl?: number;
+    findCacheSize?: number;
+}
+export interface findScuBatchOptions extends scuOptions {
+    queries: KeyValue[][];
+    charset?: string;
+    maxResults?: number;
+    parallelism?: number;
+}
+export interface findScuFederatedOptions extends Omit<scuOptions, 'target' | 'reuseAssociation'> {
+    peers: Node[];
     tags: KeyValue[];
+    charset?: string;
+    maxResults?: number;
+    deadline?: number;
 }
 export interface getScuOptions extends scuOptions {
     netTransferPrefer?: string;
     tags: KeyValue[];
+    storagePath?: string;
+    storageTransferSyntaxes?: string[];
+    storageMode?: 'disk' | 'memory';
+    compressionCpuBudget?: number;
 }
 export interface moveScuOptions extends scuOptions {
     tags: KeyValue[];
     destination: string;
     netTransferPrefer?: string;
 }
+export interface PrefetchJob {
+    patientId: string;
+    tags?: KeyValue[];
+    peer?: Node;
+    priority?: Priority;
+}
+export interface prefetchOptions extends scuOptions {
+    jobs: PrefetchJob[];
+    destination?: string;
+    storagePath?: string;
+    peerAssociations?: number;
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+}
 export interface storeScuOptions extends scuOptions {
-    sourcePath: string;
+    sourcePath?: string;
+    datasets?: (Buffer | string)[];
+    jsonDatasets?: (Buffer | string)[];
+    bulkData?: { [uri: string]: Buffer };
+    manifestPath?: string;
     netTransferPropose?: string;
+    parallelism?: number;
+    asyncOperations?: number;
+}
+export interface loadTestOptions extends scuOptions {
+    sourcePath?: string;
+    width?: number;
+    height?: number;
+    parallelism?: number;
+    rate?: number;
+    duration?: number;
+    maxRequests?: number;
+}
+export interface generateDatasetsOptions extends Cancellable {
+    storagePath: string;
+    writeFile?: boolean;
+    pixelData?: boolean;
+    patients: number;
+    studiesPerPatient?: number;
+    seriesPerStudy?: number;
+    instancesPerSeries?: number;
+    modalities?: string[];
+    seed?: number;
+    parallelism?: number;
+    indexShards?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface tierOptions extends Cancellable {
+    storagePath: string;
+    coldPath: string;
+    tierAfterDays?: number;
+    writeTransfer?: string;
+    parallelism?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface queryIndexOptions extends Cancellable {
+    storagePath: string;
+    tags: KeyValue[];
+    maxResults?: number;
+    pageSize?: number;
+    pageToken?: string;
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface retrieveMetadataOptions extends Cancellable {
+    storagePath: string;
+    tags: KeyValue[];
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface PixelStats {
+    StudyInstanceUID: string;
+    SeriesInstanceUID: string;
+    SOPInstanceUID: string;
+    minimum: number;
+    maximum: number;
+    low: number;
+    high: number;
+    windowCenter: number;
+    windowWidth: number;
+    histogram: number[];
+}
+export interface watchIndexOptions extends Cancellable {
+    storagePath: string;
+    changeToken?: string;
+    indexShards?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface maintainIndexOptions extends Cancellable {
+    storagePath: string;
+    coldPath?: string;
+    storageBackend?: "local" | "s3";
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface retrieveFramesOptions extends Cancellable {
+    storagePath: string;
+    tags: KeyValue[];
+    frame?: number;
+    frames?: number[];
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface exportStudyOptions extends Cancellable {
+    storagePath: string;
+    tags: KeyValue[];
+    format?: "zip" | "tar";
+    writeTransfer?: string;
+    lossyQuality?: number;
+    chunkSize?: number;
+    highWaterMark?: number;
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+}
+export interface createDicomdirOptions extends Cancellable {
+    storagePath: string;
+    tags: KeyValue[];
+    destination: string;
+    profile?: string;
+    fileSetId?: string;
+    writeTransfer?: string;
+    lossyQuality?: number;
+    parallelism?: number;
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface reindexOptions extends Cancellable {
+    storagePath: string;
+    parallelism?: number;
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface importJsonOptions extends Cancellable {
+    storagePath: string;
+    jsonDatasets: (Buffer | string)[];
+    bulkData?: { [uri: string]: Buffer };
+    parallelism?: number;
+    indexShards?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface convertMultiframeOptions extends Cancellable {
+    storagePath: string;
+    sourcePaths?: string[];
+    sourcePath?: string;
+    format?: "classic" | "enhanced";
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface buildPyramidOptions extends Cancellable {
+    storagePath: string;
+    sourcePaths?: string[];
+    sourcePath?: string;
+    writeTransfer?: string;
+    lossyQuality?: number;
+    parallelism?: number;
+    j2kThreads?: number;
+    j2kLayers?: number;
+    j2kProgression?: string;
+    indexShards?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface LoadTestResult {
+    sent: number;
+    failed: number;
+    associationFailures: number;
+    duration: number;
+    throughput: number;
+    bytesPerSecond: number;
+    latency: { mean: number, p50: number, p90: number, p99: number, max: number };
+    errors: { [reason: string]: number };
 }
 export interface storeScpOptions extends scpOptions {
     storagePath?: string;
@@ -41,25 +328,327 @@ export interface storeScpOptions extends scpOptions {
     netTransferPropose?: string;
     writeTransfer?: string;
     permissive?: boolean;
+    storeOnly?: boolean;
+    writeFile?: boolean;
+    streamToFile?: boolean;
+    writeDurability?: "queued" | "write" | "fsync";
+    arenaAllocation?: boolean;
+    eventTags?: string[];
+    writeThreads?: number;
+    storageShardDigits?: number;
+    eventLoopThreads?: number;
+    poolThreads?: number;
+    poolQueueSize?: number;
+    maxInFlightSize?: number;
+    maxInFlightMessages?: number;
+    inFlightPolicy?: "delay" | "refuse";
+    seriesQuietPeriod?: number;
+    seriesComplete?: "release" | "quiet";
+    seriesEventsOnly?: boolean;
+    forwardRules?: { destination: Node; callingAet?: string; modality?: string; sopClass?: string; format?: "classic" }[];
+    storeRules?: {
+        callingAet?: string;
+        calledAet?: string;
+        callingHost?: string;
+        sopClass?: string;
+        tags?: KeyValue[];
+        action?: "accept" | "reject";
+        storagePath?: string;
+    }[];
+    forwardQueuePath?: string;
+    forwardAssociations?: number;
+    proxyDestinations?: Node[];
+    proxySpill?: boolean;
+    binaryBuffer?: boolean;
+    maxAssociations?: number;
+    ingestBatchSize?: number;
+    ingestMaxDelay?: number;
+    ingestDurability?: "commit" | "queued";
+    indexShards?: number;
+    indexBackend?: "sqlite" | "postgresql";
+    indexConnection?: string;
+    indexTuning?: IndexTuning;
+    storageBackend?: "local" | "s3";
+    storageUrl?: string;
+    storageRegion?: string;
+    storageAccessKey?: string;
+    storageSecretKey?: string;
+    storageCacheSize?: number;
+    clusterNode?: string;
+    clusterHost?: string;
+    clusterHeartbeat?: number;
+    coldPath?: string;
+    skipDuplicates?: boolean;
+    linkDuplicates?: boolean;
+    packSeries?: boolean;
+    seriesMetadata?: boolean;
+    pixelHashes?: boolean;
+    pixelStats?: boolean;
+    worklist?: boolean;
+    storageCommitment?: boolean;
+    warmStart?: boolean;
+    j2kThreads?: number;
+    j2kLayers?: number;
+    j2kProgression?: string;
+    extendedOffsetTable?: boolean;
+    largeObjectSize?: number;
+    directWriteSize?: number;
+    compressionCpuBudget?: number;
+    transcodeCacheSize?: number;
+    transcodeCachePath?: string;
+    compressThreads?: number;
+    fileMapCacheSize?: number;
+    bufferPoolSize?: number;
+    moveAssociations?: number;
+    moveReadAhead?: number;
+    findReadAhead?: number;
+    moveOrder?: "location" | "instance" | "database";
+    prioritySlots?: number;
+    aeLimits?: RateLimit;
+    ipLimits?: RateLimit;
+    asyncOperations?: number;
 }
 export interface shutdownScuOptions extends scuOptions {
 }
-export interface parseOptions {
+export interface parseOptions extends Cancellable {
+    sourcePath: string;
+    verbose?: boolean;
+    nativeResult?: boolean;
+    stopAtTag?: string;
+    includeTags?: string[];
+    compact?: boolean;
+    arenaAllocation?: boolean;
+    bulkDataURI?: string;
+}
+export interface parseDirectoryOptions extends Cancellable {
+    sourcePath?: string;
+    sourcePaths?: string[];
+    verbose?: boolean;
+    nativeResult?: boolean;
+    parallelism?: number;
+    chunkSize?: number;
+    stopAtTag?: string;
+    includeTags?: string[];
+    bulkDataURI?: string;
+}
+export interface decodeFrameOptions extends Cancellable {
+    sourcePath: string;
+    frame?: number;
+    reduce?: number;
+    region?: number[];
+    j2kThreads?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface getFrameOptions extends Cancellable {
     sourcePath: string;
+    frame?: number;
+    frames?: number[];
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface getBulkDataRangeOptions extends Cancellable {
+    sourcePath: string;
+    tag?: string;
+    offset?: number;
+    length?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface renderFrameOptions extends Cancellable {
+    sourcePath?: string;
+    sourcePaths?: string[];
+    frame?: number;
+    frames?: number[];
+    width?: number;
+    height?: number;
+    window?: number[];
+    format?: "raw" | "jpeg" | "png";
+    lossyQuality?: number;
+    parallelism?: number;
     verbose?: boolean;
+    nativeResult?: boolean;
 }
-export interface recompressOptions {
+export interface recompressOptions extends Cancellable {
     sourcePath: string;
     storagePath: string;
     writeTransfer?: string;
+    lossyQuality?: number;
+    enableRecompression?: boolean;
+    manifestPath?: string;
+    parallelism?: number;
+    j2kThreads?: number;
+    j2kLayers?: number;
+    j2kProgression?: string;
+    restartRows?: number;
+    extendedOffsetTable?: boolean;
+    largeObjectSize?: number;
+    directWriteSize?: number;
     verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface AnonymizeRule {
+    tag: string;
+    action: "remove" | "empty" | "replace" | "remapUID";
+    value?: string;
+}
+export interface anonymizeOptions extends Cancellable {
+    sourcePath: string;
+    storagePath: string;
+    rules?: AnonymizeRule[];
+    removePrivateTags?: boolean;
+    uidRoot?: string;
+    uidMapPath?: string;
+    parallelism?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface verifyOptions extends Cancellable {
+    storagePath?: string;
+    sourcePath?: string;
+    indexShards?: number;
+    parallelism?: number;
+    verbose?: boolean;
+    nativeResult?: boolean;
+}
+export interface StreamEvent {
+    result: Result;
+    buffer?: Buffer;
+}
+export interface ResultStream extends Request {
+    next(): Promise<{ value: StreamEvent | undefined, done: boolean }>;
+    return(): Promise<{ value: StreamEvent | undefined, done: boolean }>;
+}
+export declare function echoScu(options: echoScuOptions, callback: (result: Result) => void): Request;
+export declare function echoMany(options: echoManyOptions, callback: (result: Result) => void): Request;
+export declare function findScu(options: findScuOptions, callback: (result: Result) => void): Request;
+export declare function findScuBatch(options: findScuBatchOptions, callback: (result: Result) => void): Request;
+export declare function findScuFederated(options: findScuFederatedOptions, callback: (result: Result) => void): Request;
+export declare function getScu(options: getScuOptions, callback: (result: Result) => void): Request;
+export declare function moveScu(options: moveScuOptions, callback: (result: Result) => void): Request;
+export declare function prefetch(options: prefetchOptions, callback: (result: Result) => void): Request;
+export declare function storeScu(options: storeScuOptions, callback: (result: Result) => void): Request;
+export declare function loadTest(options: loadTestOptions, callback: (result: Result) => void): Request;
+export declare function generateDatasets(options: generateDatasetsOptions, callback: (result: Result) => void): Request;
+export declare function importJson(options: importJsonOptions, callback: (result: Result) => void): Request;
+export declare function convertMultiframe(options: convertMultiframeOptions, callback: (result: Result) => void): Request;
+export declare function buildPyramid(options: buildPyramidOptions, callback: (result: Result) => void): Request;
+export declare function reindex(options: reindexOptions, callback: (result: Result) => void): Request;
+export declare function tier(options: tierOptions, callback: (result: Result) => void): Request;
+export declare function queryIndex(options: queryIndexOptions, callback: (result: Result) => void): Request;
+export declare function retrieveMetadata(options: retrieveMetadataOptions, callback: (result: Result) => void): Request;
+export declare function retrievePixelStats(options: retrieveMetadataOptions, callback: (result: Result) => void): Request;
+export declare function retrieveFrames(options: retrieveFramesOptions, callback: (result: Result, buffer?: Buffer) => void): Request;
+export declare function exportStudy(options: exportStudyOptions): Readable;
+export declare function createDicomdir(options: createDicomdirOptions, callback: (result: Result) => void): Request;
+export declare function watchIndex(options: watchIndexOptions, callback: (result: Result) => void): Request;
+export declare function maintainIndex(options: maintainIndexOptions, callback: (result: Result) => void): Request;
+export interface ScpHandle extends Request {
+    stop(drainTimeout?: number): void;
+    setPeers(peers: Node[]): number;
+}
+export declare function startStoreScp(options: storeScpOptions, callback: (result: Result, buffer?: Buffer) => void): ScpHandle;
+export declare function stopScp(handle: ScpHandle, drainTimeout?: number): void;
+export declare function setScpPeers(handle: ScpHandle, peers: Node[]): number;
+export declare function shutdownScu(options: shutdownScuOptions, callback: (result: Result) => void): Request;
+export declare function parseFile(options: parseOptions, callback: (result: Result) => void): Request;
+export declare function parseDirectory(options: parseDirectoryOptions, callback: (result: Result) => void): Request;
+export declare function decodeFrame(options: decodeFrameOptions, callback: (result: Result, buffer?: Buffer) => void): Request;
+export declare function getFrame(options: getFrameOptions, callback: (result: Result, buffer?: Buffer) => void): Request;
+export declare function getBulkDataRange(options: getBulkDataRangeOptions, callback: (result: Result, buffer?: Buffer) => void): Request;
+export declare function renderFrame(options: renderFrameOptions, callback: (result: Result, buffer?: Buffer) => void): Request;
+export declare function recompress(options: recompressOptions, callback: (result: Result) => void): Request;
+export declare function anonymize(options: anonymizeOptions, callback: (result: Result) => void): Request;
+export declare function verify(options: verifyOptions, callback: (result: Result) => void): Request;
+export declare class Association {
+    private source;
+    private target;
+    private idleTimeout?;
+    constructor(source: Node, target: Node, idleTimeout?: number | undefined);
+    echo(options: Partial<echoScuOptions>, callback: (result: Result) => void): Request;
+    find(options: Partial<findScuOptions>, callback: (result: Result) => void): Request;
+    move(options: Partial<moveScuOptions>, callback: (result: Result) => void): Request;
+    prewarm(count?: number, callback?: (negotiated: number, error: string | null) => void): void;
+    close(): void;
+    private options;
+}
+export declare type Operation = "echo" | "find" | "get" | "move" | "store" | "scp" | "shutdown" | "parse" | "recompress" | "anonymize" | "render" | "loadtest" | "generate" | "reindex" | "tier" | "index" | "verify" | "watch" | "media";
+export declare function setConcurrency(operation: Operation, limit: number): void;
+export declare function setPlacement(operation: Operation | "association", policy: "none" | "spread" | `node:${number}`): void;
+export declare function setZeroCopySend(enabled: boolean): void;
+export declare function setFrameThreads(threads: number): void;
+export declare function setDeflateLevel(level: number): void;
+export declare function closeAssociations(): void;
+export declare function prewarmAssociations(options: echoScuOptions, count?: number, callback?: (negotiated: number, error: string | null) => void): void;
+export declare function setHostCache(ttl: number): void;
+export declare function findCacheStats(): { hits: number, joined: number, misses: number, entries: number };
+export declare function clearFindCache(): void;
+export declare function setParseCache(size: number): void;
+export declare function parseCacheStats(): { hits: number, misses: number, entries: number, bytes: number };
+export declare function clearParseCache(): void;
+export interface WorklistItem {
+    accessionNumber?: string;
+    patientName?: string;
+    patientID?: string;
+    patientBirthDate?: string;
+    patientSex?: string;
+    studyInstanceUID?: string;
+    requestedProcedureID?: string;
+    requestedProcedureDescription?: string;
+    referringPhysicianName?: string;
+    modality?: string;
+    scheduledStationAETitle?: string;
+    scheduledStationName?: string;
+    scheduledProcedureStepStartDate?: string;
+    scheduledProcedureStepStartTime?: string;
+    scheduledPerformingPhysicianName?: string;
+    scheduledProcedureStepDescription?: string;
+    scheduledProcedureStepID?: string;
+}
+export declare function upsertWorklist(items: WorklistItem[]): number;
+export declare function removeWorklist(items: WorklistItem[]): number;
+export declare function clearWorklist(): void;
+export interface MetricSeries {
+    name: string,
+    labels: { [label: string]: string },
+}
+export interface MetricHistogram extends MetricSeries {
+    count: number,
+    sum: number,
+    max: number,
+    p50: number,
+    p90: number,
+    p99: number,
+    buckets: [number, number][],
+}
+export interface Metrics {
+    counters: (MetricSeries & { value: number })[],
+    gauges: (MetricSeries & { value: number })[],
+    histograms: MetricHistogram[],
+}
+export declare function getMetrics(): Metrics;
+export declare function setTracing(spansPerThread: number): void;
+export declare function getTrace(format?: "chrome" | "otlp", serviceName?: string): any;
+export interface LogRecord {
+    time: number,
+    level: "FATAL" | "ERROR" | "WARN" | "INFO" | "DEBUG" | "TRACE",
+    logger: string,
+    message: string,
+    thread: string,
+}
+export interface LoggingOptions {
+    queueSize?: number;
+    batchSize?: number;
+    flushInterval?: number;
 }
-export declare function echoScu(options: echoScuOptions, callback: (result: string) => void): void;
-export declare function findScu(options: findScuOptions, callback: (result: string) => void): void;
-export declare function getScu(options: getScuOptions, callback: (result: string) => void): void;
-export declare function moveScu(options: moveScuOptions, callback: (result: string) => void): void;
-export declare function storeScu(options: storeScuOptions, callback: (result: string) => void): void;
-export declare function startStoreScp(options: storeScpOptions, callback: (result: string) => void): void;
-export declare function shutdownScu(options: shutdownScuOptions, callback: (result: string) => void): void;
-export declare function parseFile(options: parseOptions, callback: (result: string) => void): void;
+export declare function setLogging(options?: LoggingOptions, sink?: (records: LogRecord[]) => void): void;
+export declare function prometheusMetrics(prefix?: string): string;
+export declare function findScuStream(options: findScuOptions, highWaterMark?: number): ResultStream;
+export declare function findScuBatchStream(options: findScuBatchOptions, highWaterMark?: number): ResultStream;
+export declare function findScuFederatedStream(options: findScuFederatedOptions, highWaterMark?: number): ResultStream;
+export declare function getScuStream(options: getScuOptions, highWaterMark?: number): ResultStream;
+export declare function moveScuStream(options: moveScuOptions, highWaterMark?: number): ResultStream;
+export declare function storeScuStream(options: storeScuOptions, highWaterMark?: number): ResultStream;
+export declare function startStoreScpStream(options: storeScpOptions, highWaterMark?: number): ResultStream;
+export declare function parseDirectoryStream(options: parseDirectoryOptions, highWaterMark?: number): ResultStream;
 export {};
@@ -1,49 +1,482 @@
 "use strict";
-exports.__esModule = true;
-exports.recompress = exports.parseFile = exports.shutdownScu = exports.startStoreScp = exports.storeScu = exports.moveScu = exports.getScu = exports.findScu = exports.echoScu = void 0;
-var addon = require('bindings')('dcmtk.node');
-;
-;
-;
-;
-;
-;
-;
-;
-;
+Object.defineProperty(exports, "__esModule", { value: true });
+exports.parseDirectoryStream = exports.startStoreScpStream = exports.storeScuStream = exports.moveScuStream = exports.getScuStream = exports.findScuFederatedStream = exports.findScuBatchStream = exports.findScuStream = exports.prometheusMetrics = exports.setLogging = exports.getTrace = exports.setTracing = exports.getMetrics = exports.clearWorklist = exports.removeWorklist = exports.upsertWorklist = exports.clearParseCache = exports.parseCacheStats = exports.setParseCache = exports.clearFindCache = exports.findCacheStats = exports.setHostCache = exports.prewarmAssociations = exports.closeAssociations = exports.setDeflateLevel = exports.setFrameThreads = exports.setZeroCopySend = exports.setPlacement = exports.setConcurrency = exports.Association = exports.verify = exports.anonymize = exports.recompress = exports.renderFrame = exports.getBulkDataRange = exports.getFrame = exports.decodeFrame = exports.parseDirectory = exports.parseFile = exports.shutdownScu = exports.setScpPeers = exports.stopScp = exports.startStoreScp = exports.maintainIndex = exports.watchIndex = exports.createDicomdir = exports.exportStudy = exports.retrieveFrames = exports.retrievePixelStats = exports.retrieveMetadata = exports.queryIndex = exports.tier = exports.reindex = exports.buildPyramid = exports.convertMultiframe = exports.importJson = exports.generateDatasets = exports.loadTest = exports.storeScu = exports.prefetch = exports.moveScu = exports.getScu = exports.findScuFederated = exports.findScuBatch = exports.findScu = exports.echoMany = exports.echoScu = void 0;
+var stream_1 = require("stream");
+const addon = require('bindings')('dcmtk.node');
+function isFinal(result) {
+    if (Array.isArray(result)) return false;
+    if (typeof result === 'string') return result.indexOf('{"code":1,') !== 0;
+    return result.code !== 1;
+}
+function cancellable(start, options, callback, abort = (request)=>request.cancel()) {
+    const signal = options.signal;
+    if (!signal) return start(options, callback);
+    let request;
+    const onAbort = ()=>{
+        if (request) abort(request);
+    };
+    request = start(options, (result, buffer)=>{
+        if (isFinal(result)) signal.removeEventListener("abort", onAbort);
+        callback(result, buffer);
+    });
+    if (signal.aborted) {
+        abort(request);
+    } else {
+        signal.addEventListener("abort", onAbort);
+    }
+    return request;
+}
+function stream(fn, options, highWaterMark) {
+    const events = [];
+    const waiting = [];
+    let finished = false;
+    let closed = false;
+    const request = {};
+    for(const key in options)request[key] = options[key];
+    request.nativeResult = true;
+    const signal = options.signal;
+    const onAbort = ()=>control.cancel();
+    const onEvent = (result, buffer)=>{
+        const pending = result.code === 1;
+        if (!pending) {
+            finished = true;
+            if (signal) signal.removeEventListener("abort", onAbort);
+        }
+        if (closed) return;
+        const resolve = waiting.shift();
+        if (resolve) {
+            resolve({
+                value: {
+                    result,
+                    buffer
+                },
+                done: false
+            });
+            if (pending) acknowledge(1);
+        } else {
+            events.push({
+                result,
+                buffer
+            });
+        }
+        if (finished) {
+            while(waiting.length > 0)waiting.shift()({
+                value: undefined,
+                done: true
+            });
+        }
+    };
+    const control = fn(request, (result, buffer)=>{
+        if (Array.isArray(result)) {
+            result.forEach((item)=>onEvent(item));
+        } else {
+            onEvent(result, buffer);
+        }
+    }, highWaterMark);
+    const acknowledge = control.acknowledge;
+    if (signal && signal.aborted) {
+        control.cancel();
+    } else if (signal) {
+        signal.addEventListener("abort", onAbort);
+    }
+    const result = {
+        next () {
+            const event = events.shift();
+            if (event) {
+                if (event.result.code === 1) acknowledge(1);
+                return Promise.resolve({
+                    value: event,
+                    done: false
+                });
+            }
+            if (finished || closed) return Promise.resolve({
+                value: undefined,
+                done: true
+            });
+            return new Promise((resolve)=>waiting.push(resolve));
+        },
+        return () {
+            closed = true;
+            events.length = 0;
+            acknowledge(-1);
+            while(waiting.length > 0)waiting.shift()({
+                value: undefined,
+                done: true
+            });
+            return Promise.resolve({
+                value: undefined,
+                done: true
+            });
+        },
+        cancel () {
+            control.cancel();
+        }
+    };
+    const asyncIterator = Symbol.asyncIterator || Symbol.for('Symbol.asyncIterator');
+    result[asyncIterator] = ()=>result;
+    return result;
+}
 function echoScu(options, callback) {
-    addon.echoScu(JSON.stringify(options), callback);
+    return cancellable(addon.echoScu, options, callback);
 }
 exports.echoScu = echoScu;
+function echoMany(options, callback) {
+    return cancellable(addon.echoMany, options, callback);
+}
+exports.echoMany = echoMany;
 function findScu(options, callback) {
-    addon.findScu(JSON.stringify(options), callback);
+    return cancellable(addon.findScu, options, callback);
 }
 exports.findScu = findScu;
+function findScuBatch(options, callback) {
+    return cancellable(addon.findScuBatch, options, callback);
+}
+exports.findScuBatch = findScuBatch;
+function findScuFederated(options, callback) {
+    return cancellable(addon.findScuFederated, options, callback);
+}
+exports.findScuFederated = findScuFederated;
 function getScu(options, callback) {
-    addon.getScu(JSON.stringify(options), callback);
+    return cancellable(addon.getScu, options, callback);
 }
 exports.getScu = getScu;
 function moveScu(options, callback) {
-    addon.moveScu(JSON.stringify(options), callback);
+    return cancellable(addon.moveScu, options, callback);
 }
 exports.moveScu = moveScu;
+function prefetch(options, callback) {
+    return cancellable(addon.prefetch, options, callback);
+}
+exports.prefetch = prefetch;
 function storeScu(options, callback) {
-    addon.storeScu(JSON.stringify(options), callback);
+    return cancellable(addon.storeScu, options, callback);
 }
 exports.storeScu = storeScu;
+function loadTest(options, callback) {
+    return cancellable(addon.loadTest, options, callback);
+}
+exports.loadTest = loadTest;
+function generateDatasets(options, callback) {
+    return cancellable(addon.generateDatasets, options, callback);
+}
+exports.generateDatasets = generateDatasets;
+function importJson(options, callback) {
+    return cancellable(addon.importJson, options, callback);
+}
+exports.importJson = importJson;
+function convertMultiframe(options, callback) {
+    return cancellable(addon.convertMultiframe, options, callback);
+}
+exports.convertMultiframe = convertMultiframe;
+function buildPyramid(options, callback) {
+    return cancellable(addon.buildPyramid, options, callback);
+}
+exports.buildPyramid = buildPyramid;
+function reindex(options, callback) {
+    return cancellable(addon.reindex, options, callback);
+}
+exports.reindex = reindex;
+function tier(options, callback) {
+    return cancellable(addon.tier, options, callback);
+}
+exports.tier = tier;
+function queryIndex(options, callback) {
+    return cancellable(addon.queryIndex, options, callback);
+}
+exports.queryIndex = queryIndex;
+function retrieveMetadata(options, callback) {
+    return cancellable(addon.retrieveMetadata, options, callback);
+}
+exports.retrieveMetadata = retrieveMetadata;
+function retrievePixelStats(options, callback) {
+    return cancellable(addon.retrievePixelStats, options, callback);
+}
+exports.retrievePixelStats = retrievePixelStats;
+function retrieveFrames(options, callback) {
+    return cancellable(addon.retrieveFrames, options, callback);
+}
+exports.retrieveFrames = retrieveFrames;
+function exportStudy(options) {
+    const events = stream(addon.exportStudy, options, options.highWaterMark || 4);
+    const pull = ()=>{
+        events.next().then(({ value, done })=>{
+            if (done || !value) {
+                readable.push(null);
+            } else if (value.result.code === 1) {
+                if (value.buffer) readable.push(value.buffer);
+                else pull();
+            } else if (value.result.code === 2) {
+                readable.destroy(new Error(value.result.message));
+            } else {
+                readable.emit("summary", value.result.container);
+                readable.push(null);
+            }
+        });
+    };
+    const readable = new stream_1.Readable({
+        read: pull,
+        destroy (error, callback) {
+            events.cancel();
+            events.return();
+            callback(error);
+        }
+    });
+    return readable;
+}
+exports.exportStudy = exportStudy;
+function createDicomdir(options, callback) {
+    return cancellable(addon.createDicomdir, options, callback);
+}
+exports.createDicomdir = createDicomdir;
+function watchIndex(options, callback) {
+    return cancellable(addon.watchIndex, options, callback);
+}
+exports.watchIndex = watchIndex;
+function maintainIndex(options, callback) {
+    return cancellable(addon.maintainIndex, options, callback);
+}
+exports.maintainIndex = maintainIndex;
 function startStoreScp(options, callback) {
-    addon.startScp(JSON.stringify(options), callback);
+    return cancellable(addon.startScp, options, callback, (handle)=>handle.stop());
 }
 exports.startStoreScp = startStoreScp;
+function stopScp(handle, drainTimeout = 10000) {
+    handle.stop(drainTimeout);
+}
+exports.stopScp = stopScp;
+function setScpPeers(handle, peers) {
+    return handle.setPeers(peers);
+}
+exports.setScpPeers = setScpPeers;
 function shutdownScu(options, callback) {
-    addon.shutdownScu(JSON.stringify(options), callback);
+    return cancellable(addon.shutdownScu, options, callback);
 }
 exports.shutdownScu = shutdownScu;
 function parseFile(options, callback) {
-    addon.parseFile(JSON.stringify(options), callback);
+    return cancellable(addon.parseFile, options, callback);
 }
 exports.parseFile = parseFile;
+function parseDirectory(options, callback) {
+    return cancellable(addon.parseDirectory, options, callback);
+}
+exports.parseDirectory = parseDirectory;
+function decodeFrame(options, callback) {
+    return cancellable(addon.decodeFrame, options, callback);
+}
+exports.decodeFrame = decodeFrame;
+function getFrame(options, callback) {
+    return cancellable(addon.getFrame, options, callback);
+}
+exports.getFrame = getFrame;
+function getBulkDataRange(options, callback) {
+    return cancellable(addon.getBulkDataRange, options, callback);
+}
+exports.getBulkDataRange = getBulkDataRange;
+function renderFrame(options, callback) {
+    return cancellable(addon.renderFrame, options, callback);
+}
+exports.renderFrame = renderFrame;
 function recompress(options, callback) {
-    addon.recompress(JSON.stringify(options), callback);
+    return cancellable(addon.recompress, options, callback);
 }
 exports.recompress = recompress;
+function anonymize(options, callback) {
+    return cancellable(addon.anonymize, options, callback);
+}
+exports.anonymize = anonymize;
+function verify(options, callback) {
+    return cancellable(addon.verify, options, callback);
+}
+exports.verify = verify;
+class Association {
+    constructor(source, target, idleTimeout){
+        this.source = source;
+        this.target = target;
+        this.idleTimeout = idleTimeout;
+    }
+    echo(options, callback) {
+        return cancellable(addon.echoScu, this.options(options), callback);
+    }
+    find(options, callback) {
+        return cancellable(addon.findScu, this.options(options), callback);
+    }
+    move(options, callback) {
+        return cancellable(addon.moveScu, this.options(options), callback);
+    }
+    prewarm(count = 1, callback) {
+        prewarmAssociations(this.options({}), count, callback);
+    }
+    close() {
+        addon.closeAssociations({
+            target: this.target
+        });
+    }
+    options(options) {
+        const request = {};
+        for(const key in options)request[key] = options[key];
+        request.source = this.source;
+        request.target = this.target;
+        request.reuseAssociation = true;
+        if (this.idleTimeout !== undefined) request.associationIdleTimeout = this.idleTimeout;
+        return request;
+    }
+}
+exports.Association = Association;
+function setConcurrency(operation, limit) {
+    addon.setConcurrency(operation, limit);
+}
+exports.setConcurrency = setConcurrency;
+function setPlacement(operation, policy) {
+    addon.setPlacement(operation, policy);
+}
+exports.setPlacement = setPlacement;
+function setZeroCopySend(enabled) {
+    addon.setZeroCopySend(enabled);
+}
+exports.setZeroCopySend = setZeroCopySend;
+function setFrameThreads(threads) {
+    addon.setFrameThreads(threads);
+}
+exports.setFrameThreads = setFrameThreads;
+function setDeflateLevel(level) {
+    addon.setDeflateLevel(level);
+}
+exports.setDeflateLevel = setDeflateLevel;
+function closeAssociations() {
+    addon.closeAssociations();
+}
+exports.closeAssociations = closeAssociations;
+function prewarmAssociations(options, count = 1, callback) {
+    addon.prewarmAssociations(options, count, callback);
+}
+exports.prewarmAssociations = prewarmAssociations;
+function setHostCache(ttl) {
+    addon.setHostCache(ttl);
+}
+exports.setHostCache = setHostCache;
+function findCacheStats() {
+    return addon.findCacheStats();
+}
+exports.findCacheStats = findCacheStats;
+function clearFindCache() {
+    addon.clearFindCache();
+}
+exports.clearFindCache = clearFindCache;
+function setParseCache(size) {
+    addon.setParseCache(size);
+}
+exports.setParseCache = setParseCache;
+function parseCacheStats() {
+    return addon.parseCacheStats();
+}
+exports.parseCacheStats = parseCacheStats;
+function clearParseCache() {
+    addon.clearParseCache();
+}
+exports.clearParseCache = clearParseCache;
+function upsertWorklist(items) {
+    return addon.upsertWorklist(items);
+}
+exports.upsertWorklist = upsertWorklist;
+function removeWorklist(items) {
+    return addon.removeWorklist(items);
+}
+exports.removeWorklist = removeWorklist;
+function clearWorklist() {
+    addon.clearWorklist();
+}
+exports.clearWorklist = clearWorklist;
+function getMetrics() {
+    return JSON.parse(addon.getMetrics());
+}
+exports.getMetrics = getMetrics;
+function setTracing(spansPerThread) {
+    addon.setTracing(spansPerThread);
+}
+exports.setTracing = setTracing;
+function getTrace(format = "chrome", serviceName = "dcmtk") {
+    return JSON.parse(addon.getTrace(format, serviceName));
+}
+exports.getTrace = getTrace;
+function setLogging(options = {}, sink) {
+    addon.setLogging(options, sink);
+}
+exports.setLogging = setLogging;
+function prometheusMetrics(prefix = "dcmtk_") {
+    const metrics = getMetrics();
+    const labels = (series, extra = {})=>{
+        const all = {
+            ...series.labels,
+            ...extra
+        };
+        const keys = Object.keys(all);
+        if (keys.length === 0) {
+            return "";
+        }
+        return "{" + keys.map((k)=>`${k}="${all[k].replace(/\\/g, "\\\\").replace(/"/g, '\\"').replace(/\n/g, "\\n")}"`).join(",") + "}";
+    };
+    const lines = [];
+    const typed = {};
+    const type = (name, kind)=>{
+        if (!typed[name]) {
+            typed[name] = true;
+            lines.push(`# TYPE ${name} ${kind}`);
+        }
+    };
+    for (const c of metrics.counters){
+        type(prefix + c.name, "counter");
+        lines.push(`${prefix}${c.name}${labels(c)} ${c.value}`);
+    }
+    for (const g of metrics.gauges){
+        type(prefix + g.name, "gauge");
+        lines.push(`${prefix}${g.name}${labels(g)} ${g.value}`);
+    }
+    for (const h of metrics.histograms){
+        const name = prefix + h.name;
+        type(name, "histogram");
+        for (const [le, count] of h.buckets){
+            lines.push(`${name}_bucket${labels(h, {
+                le: String(le)
+            })} ${count}`);
+        }
+        lines.push(`${name}_bucket${labels(h, {
+            le: "+Inf"
+        })} ${h.count}`);
+        lines.push(`${name}_sum${labels(h)} ${h.sum}`);
+        lines.push(`${name}_count${labels(h)} ${h.count}`);
+    }
+    return lines.join("\n") + "\n";
+}
+exports.prometheusMetrics = prometheusMetrics;
+function findScuStream(options, highWaterMark = 16) {
+    return stream(addon.findScu, options, highWaterMark);
+}
+exports.findScuStream = findScuStream;
+function findScuBatchStream(options, highWaterMark = 16) {
+    return stream(addon.findScuBatch, options, highWaterMark);
+}
+exports.findScuBatchStream = findScuBatchStream;
+function findScuFederatedStream(options, highWaterMark = 16) {
+    return stream(addon.findScuFederated, options, highWaterMark);
+}
+exports.findScuFederatedStream = findScuFederatedStream;
+function getScuStream(options, highWaterMark = 16) {
+    return stream(addon.getScu, options, highWaterMark);
+}
+exports.getScuStream = getScuStream;
+function moveScuStream(options, highWaterMark = 16) {
+    return stream(addon.moveScu, options, highWaterMark);
+}
+exports.moveScuStream = moveScuStream;
+function storeScuStream(options, highWaterMark = 16) {
+    return stream(addon.storeScu, options, highWaterMark);
+}
+exports.storeScuStream = storeScuStream;
+function startStoreScpStream(options, highWaterMark = 16) {
+    return stream(addon.startScp, options, highWaterMark);
+}
+exports.startStoreScpStream = startStoreScpStream;
+function parseDirectoryStream(options, highWaterMark = 16) {
+    return stream(addon.parseDirectory, options, highWaterMark);
+}
+exports.parseDirectoryStream = parseDirectoryStream;
@@ -1,9 +1,48 @@
+import { Readable } from 'stream';
+
 const addon = require('bindings')('dcmtk.node');
 
 export interface Node {
   aet: string;
   ip: string;
   port: number;
+  // transfer syntaxes preferred on the link to the peer, 'auto' decides on the measured bandwidth
+  compression?: 'auto' | 'compressed' | 'uncompressed';
+  // SCP peers: priority class of the C-GET and C-MOVE sub-operations of the peer, instead of the
+  // Priority of each request
+  priority?: Priority;
+};
+
+export type Priority = 'high' | 'medium' | 'low';
+
+// limits of the associations of each calling AE title or IP, unset or 0 is no limit
+export interface RateLimit {
+  // new associations per second, refused as transient beyond a burst of `burst` (defaults to associationsPerSecond)
+  associationsPerSecond?: number;
+  burst?: number;
+  // open associations at a time, further ones are refused as transient
+  concurrentAssociations?: number;
+  // bytes per second sent by C-MOVE sub-operations, senders are paced to it
+  bytesPerSecond?: number;
+};
+
+// PRAGMAs of the SQLite index connections of the process, unset keeps the defaults. For high throughput
+// on a large index that fits in RAM, e.g. { cacheSize: 256, mmapSize: 16384, tempStore: "memory" }: the
+// pages are then read through the page cache of the OS instead of being copied into every connection,
+// and synchronous "off" trades the last commits on power loss for fewer fsyncs
+export interface IndexTuning {
+  // MB of page cache of each connection, readers included (default 2)
+  cacheSize?: number;
+  // MB of each index file read through mmap, up to 64 GB on 64-bit builds (default 0, none)
+  mmapSize?: number;
+  // bytes per page of new indexes, a power of two from 512 to 65536 (default 4096)
+  pageSize?: number;
+  // only "wal" (default) lets queries read while associations are storing
+  journalMode?: "wal" | "truncate" | "delete";
+  // "normal" (default) may lose the last commits on power loss in WAL mode, never the consistency
+  synchronous?: "off" | "normal" | "full" | "extra";
+  // where sorts keep temporary tables and indexes
+  tempStore?: "default" | "file" | "memory";
 };
 
 export interface KeyValue {
@@ -11,31 +50,210 @@ export interface KeyValue {
   value: string;
 }
 
-interface scuOptions {
+// the part of an AbortSignal the requests use, e.g. AbortController.signal
+export interface AbortSignalLike {
+  readonly aborted: boolean;
+  addEventListener(type: "abort", listener: () => void): void;
+  removeEventListener(type: "abort", listener: () => void): void;
+}
+
+// a request whose signal aborts is cancelled as by Request.cancel() (an SCP is stopped), one whose
+// signal aborted already is cancelled before it starts
+export interface Cancellable {
+  signal?: AbortSignalLike;
+}
+
+interface scuOptions extends Cancellable {
   source: Node;
   target: Node;
   verbose?: boolean;
+  nativeResult?: boolean;
+  // echo, find and move keep their association open for later requests to the same peer
+  reuseAssociation?: boolean;
+  // ms an unused pooled association is kept open, defaults to 30000
+  associationIdleTimeout?: number;
+  // Priority of the C-FIND, C-GET, C-MOVE and C-STORE requests, also orders the requests waiting for
+  // their operation's concurrency limit, defaults to 'medium'
+  priority?: Priority;
+  // largest PDU in bytes accepted from the peer, 4096 to 131072, defaults to 16384
+  maxPdu?: number;
+  // SO_SNDBUF/SO_RCVBUF in bytes, defaults to the TCP_BUFFER_LENGTH environment variable or the system default
+  socketBufferSize?: number;
+  // disable the Nagle algorithm, defaults to the TCP_NODELAY environment variable
+  tcpNoDelay?: boolean;
+  // seconds without traffic before TCP keepalive probes are sent, so that pooled associations to a
+  // peer that vanished fail instead of hanging. 0 (default) disables keepalive
+  tcpKeepAlive?: number;
+  // seconds between keepalive probes, the connection fails after 4 unanswered ones, defaults to 15
+  tcpKeepAliveInterval?: number;
+  // seconds to wait for association negotiation and release, defaults to 30
+  acseTimeout?: number;
+  // seconds to wait for each DIMSE message from the peer, defaults to 60, 0 waits forever
+  dimseTimeout?: number;
+  // DICOM over TLS, needs a build with --CDDCMTK_TLS=ON
+  tls?: boolean;
+  // PEM certificate (chain) and private key presented to the peer, the key defaults to the certificate file
+  tlsCertificate?: string;
+  tlsPrivateKey?: string;
+  // PEM file or hashed directory of trusted CA certificates, defaults to the system store
+  tlsCaCertificates?: string;
+  // OpenSSL cipher list for TLS 1.2, defaults to ECDHE with AES-GCM first
+  tlsCiphers?: string;
+  // verify the certificate of the peer against the CA certificates, defaults to true
+  tlsVerifyPeer?: boolean;
+  // host name sent as SNI and, with tlsVerifyPeer, matched against the certificate of the peer, defaults
+  // to the ip of the target. Addresses are matched against the IP entries of the certificate, without SNI
+  tlsServerName?: string;
 }
 
-interface scpOptions {
+interface scpOptions extends Cancellable {
   source: Node;
   peers: Node[];
   verbose?: boolean;
+  nativeResult?: boolean;
+  // largest PDU in bytes accepted from peers and on C-MOVE sub-associations, 4096 to 131072, defaults to 16384
+  maxPdu?: number;
+  // SO_SNDBUF/SO_RCVBUF in bytes, defaults to the TCP_BUFFER_LENGTH environment variable or the system default
+  socketBufferSize?: number;
+  // disable the Nagle algorithm, defaults to the TCP_NODELAY environment variable
+  tcpNoDelay?: boolean;
+  // seconds without traffic before TCP keepalive probes are sent to a peer, also on C-MOVE
+  // sub-associations. 0 (default) disables keepalive
+  tcpKeepAlive?: number;
+  // seconds between keepalive probes, the connection fails after 4 unanswered ones, defaults to 15
+  tcpKeepAliveInterval?: number;
+  // seconds to wait for association negotiation and release, also on C-MOVE sub-associations, defaults to 30
+  acseTimeout?: number;
+  // seconds a peer may stay silent within and between DIMSE messages before its association is aborted,
+  // defaults to 0 which waits forever
+  dimseTimeout?: number;
+  // ms an association may wait for its next request before it is aborted, also while dimseTimeout
+  // waits forever. 0 (default) keeps idle associations open
+  associationIdleTimeout?: number;
+  // DICOM over TLS for accepted associations and C-MOVE sub-associations, needs a build with --CDDCMTK_TLS=ON
+  tls?: boolean;
+  // PEM certificate (chain) and private key of the SCP, required with tls, the key defaults to the certificate file
+  tlsCertificate?: string;
+  tlsPrivateKey?: string;
+  // PEM file or hashed directory of trusted CA certificates, defaults to the system store
+  tlsCaCertificates?: string;
+  // OpenSSL cipher list for TLS 1.2, defaults to ECDHE with AES-GCM first
+  tlsCiphers?: string;
+  // require and verify client certificates against the CA certificates, defaults to true
+  tlsVerifyPeer?: boolean;
+  // read and write unencrypted associations and C-MOVE sub-associations through io_uring on Linux,
+  // falls back to socket calls where rings are not permitted, defaults to false
+  ioUring?: boolean;
+  // deliver progress results as arrays of up to eventBatchSize results per callback, results with a
+  // buffer still arrive on their own. Partial batches are flushed every eventFlushInterval ms (default 20)
+  eventBatchSize?: number;
+  eventFlushInterval?: number;
+}
+
+// results are JSON text, or already parsed objects when nativeResult is set
+export type Result = any;
+
+// a running request, cancel() sends a C-CANCEL for C-FIND, C-GET and C-MOVE with the next pending
+// response, stops C-STORE after the current instance and requests working through files after the
+// current ones. A request still waiting for its lane does not start. The callback still gets the
+// final result
+export interface Request {
+  cancel(): void;
+}
+
+// progress results have code 1, as JSON text they start with it
+function isFinal(result: Result): boolean {
+  if (Array.isArray(result)) return false;
+  if (typeof result === 'string') return result.indexOf('{"code":1,') !== 0;
+  return result.code !== 1;
+}
+
+// starts the request and cancels it with abort once options.signal aborts, the signal is let go
+// with the final result
+function cancellable<R extends Request>(start: (options: any, callback: (result: Result, buffer?: Buffer) => void) => R, options: Cancellable,
+                                        callback: (result: Result, buffer?: Buffer) => void, abort: (request: R) => void = (request) => request.cancel()): R {
+  const signal = options.signal;
+  if (!signal) return start(options, callback);
+  let request: R | undefined;
+  const onAbort = () => {
+    if (request) abort(request);
+  };
+  request = start(options, (result: Result, buffer?: Buffer) => {
+    if (isFinal(result)) signal.removeEventListener("abort", onAbort);
+    callback(result, buffer);
+  });
+  if (signal.aborted) {
+    abort(request);
+  } else {
+    signal.addEventListener("abort", onAbort);
+  }
+  return request;
 }
 
 export interface echoScuOptions extends scuOptions {
 };
 
+export interface echoManyOptions extends Omit<scuOptions, 'target' | 'reuseAssociation' | 'associationIdleTimeout'> {
+  // the peers probed at once, each result holds { aet, ip, port, status, dimseStatus, connect,
+  // associate, echo, total, error }
+  peers: Node[];
+};
+
 export interface findScuOptions extends scuOptions {
   netTransferPrefer?: string;
   tags: KeyValue[];
   charset?: string;
+  // responses per FIND_RESULTS progress message (a DICOMJSON array) sent as they arrive, the final
+  // result then only holds { results }. Without it all responses come with the final result
+  chunkSize?: number;
+  // responses accepted before the query is stopped with a C-CANCEL
+  maxResults?: number;
+  // ms the result of an identical earlier query to the same peer is reused, identical queries
+  // running concurrently are sent once. 0 (default) always queries the peer
+  cacheTtl?: number;
+  // results kept in the process wide C-FIND cache, defaults to 256
+  findCacheSize?: number;
+};
+
+export interface findScuBatchOptions extends scuOptions {
+  // the attributes of each query, the responses come as FIND_RESULTS progress messages holding
+  // { query, results } with the index of the query, failed queries as FIND_FAILED { query, error }
+  queries: KeyValue[][];
+  charset?: string;
+  // responses accepted per query before it is stopped with a C-CANCEL
+  maxResults?: number;
+  // associations the queries are spread over, defaults to 1
+  parallelism?: number;
+};
+
+export interface findScuFederatedOptions extends Omit<scuOptions, 'target' | 'reuseAssociation'> {
+  // the peers queried at once, each on a pooled association. Responses are merged on PatientID,
+  // StudyInstanceUID, SeriesInstanceUID or SOPInstanceUID by QueryRetrieveLevel (default STUDY), the
+  // first peer returning a key wins. New responses come as FIND_RESULTS progress messages holding
+  // { peer, results } with the index of the peer, failed peers as FIND_FAILED { peer, error }
+  peers: Node[];
+  tags: KeyValue[];
+  charset?: string;
+  // responses accepted per peer before its query is stopped with a C-CANCEL
+  maxResults?: number;
+  // ms after which the result is returned without the peers that have not answered yet, their
+  // queries are cancelled. 0 (default) waits for all peers
+  deadline?: number;
 };
 
 export interface getScuOptions extends scuOptions {
   netTransferPrefer?: string;
   tags: KeyValue[];
   storagePath?: string;
+  // transfer syntax UIDs accepted for the retrieved instances in order of preference, e.g. JPEG 2000
+  // or JPEG-LS to avoid decompression by the peer, uncompressed ones are added as fallback
+  storageTransferSyntaxes?: string[];
+  // "disk" (default) writes the instances to storagePath, "memory" hands each one to the callback as
+  // a Buffer with a BUFFER_STORAGE progress message
+  storageMode?: 'disk' | 'memory';
+  // cores that may be spent compressing transfers, compressed transfer syntaxes are preferred on links
+  // slower than what they can compress, applies to all later requests until changed
+  compressionCpuBudget?: number;
 };
 
 export interface moveScuOptions extends scuOptions {
@@ -44,11 +262,326 @@ export interface moveScuOptions extends scuOptions {
   netTransferPrefer?: string;
 };
 
+export interface PrefetchJob {
+  patientId: string;
+  // further C-FIND keys the priors have to match, e.g. { key: "00080020", value: "20200101-" } or ModalitiesInStudy
+  tags?: KeyValue[];
+  // archive queried and moved from, defaults to the target of the request
+  peer?: Node;
+  priority?: Priority;
+};
+
+export interface prefetchOptions extends scuOptions {
+  jobs: PrefetchJob[];
+  // AE title the studies are moved to, defaults to source.aet
+  destination?: string;
+  // storage area of the destination, the studies its index holds with all their instances are not moved
+  storagePath?: string;
+  // C-FINDs and C-MOVEs running on each peer at a time, on pooled associations (default 2)
+  peerAssociations?: number;
+  // as for startStoreScp()
+  indexShards?: number;
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+};
+
 export interface storeScuOptions extends scuOptions {
-  sourcePath: string;
+  // directory whose DICOM files are sent, unless datasets is set
+  sourcePath?: string;
+  // DICOM files or bare datasets in memory, sent without writing them to disk. The bytes are copied
+  // when the request starts, strings are taken as base64
+  datasets?: (Buffer | string)[];
+  // DICOM JSON texts, each one dataset or an array of them, built into datasets natively and sent
+  // like datasets. Strings are taken as the JSON itself
+  jsonDatasets?: (Buffer | string)[];
+  // bytes of the BulkDataURIs in jsonDatasets, e.g. those parseFile() with bulkDataURI refers to
+  bulkData?: { [uri: string]: Buffer };
+  // JSON manifest of the SOP class, instance and transfer syntax of the files sent, updated for the
+  // files below sourcePath and used to plan the associations without reading unchanged files first.
+  // Without sourcePath the files of the manifest are sent, e.g. one written from the index
+  manifestPath?: string;
   netTransferPropose?: string;
+  // number of associations sending in parallel, 1 sends over a single association
+  parallelism?: number;
+  // C-STORE requests sent before waiting for a response, only used if the peer grants an
+  // asynchronous operations window, 1 waits for each response
+  asyncOperations?: number;
+};
+
+export interface loadTestOptions extends scuOptions {
+  // files sent over and over as stored, e.g. a sample of each modality, synthetic CT images if not set
+  sourcePath?: string;
+  // columns and rows of the synthetic images, default to 512
+  width?: number;
+  height?: number;
+  // associations sending at the same time, each waits for the response of its request, defaults to 1
+  parallelism?: number;
+  // C-STORE requests per second over all associations, 0 (default) sends as fast as the peer responds.
+  // Latencies count from the time a request was due, so a peer falling behind shows in the percentiles
+  rate?: number;
+  // seconds the test runs, defaults to 10 unless maxRequests is set
+  duration?: number;
+  // C-STORE requests sent at most
+  maxRequests?: number;
 };
 
+export interface generateDatasetsOptions extends Cancellable {
+  // storage area the index (image.db) and the files are written to, created if missing
+  storagePath: string;
+  // also write the files as <storagePath>/<StudyInstanceUID>/<SOPInstanceUID>.dcm, defaults to true
+  writeFile?: boolean;
+  // include pixel data in the files, of the usual size and depth of each modality
+  pixelData?: boolean;
+  patients: number;
+  // the counts are drawn from the distribution of each modality if not set
+  studiesPerPatient?: number;
+  seriesPerStudy?: number;
+  instancesPerSeries?: number;
+  // modalities the studies are drawn from by their usual share, any of CT, MR, CR, DX, US, MG and PT (default all)
+  modalities?: string[];
+  // the same seed generates the same patients, names and dates, the UIDs are new on every run
+  seed?: number;
+  // threads generating patients, defaults to the number of cores
+  parallelism?: number;
+  // split a new index into this many SQLite files by StudyInstanceUID (default 1)
+  indexShards?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface tierOptions extends Cancellable {
+  // storage area whose idle studies are migrated, its index keeps the paths of the hot tier
+  storagePath: string;
+  // cold tier, the files keep their path relative to storagePath
+  coldPath: string;
+  // days without stores or retrievals before a study is migrated (default 0, all studies)
+  tierAfterDays?: number;
+  // transfer syntax of the cold files, e.g. JPEG-LS lossless "1.2.840.10008.1.2.4.80", default as stored
+  writeTransfer?: string;
+  // threads migrating files, defaults to the number of cores
+  parallelism?: number;
+  // as for startStoreScp()
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface queryIndexOptions extends Cancellable {
+  // storage area whose index is queried, without an association to its SCP
+  storagePath: string;
+  // matching and return keys as for findScu(), QueryRetrieveLevel 0008,0052 defaults to STUDY
+  tags: KeyValue[];
+  // stop after this many matches
+  maxResults?: number;
+  // matches per page, the result is { results, pageToken } with the token of the next page if there may be one
+  pageSize?: number;
+  // pageToken of the previous result to continue after, the query must be the same
+  pageToken?: string;
+  // as for startStoreScp()
+  indexShards?: number;
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface retrieveMetadataOptions extends Cancellable {
+  storagePath: string;
+  // StudyInstanceUID, SeriesInstanceUID or SOPInstanceUID with a value, further keys narrow the match
+  tags: KeyValue[];
+  // as for startStoreScp()
+  indexShards?: number;
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface PixelStats {
+  StudyInstanceUID: string;
+  SeriesInstanceUID: string;
+  SOPInstanceUID: string;
+  // in modality units, i.e. with RescaleSlope and RescaleIntercept applied
+  minimum: number;
+  maximum: number;
+  // the values 0.5% of the pixels are below and above, the bounds of the window preset
+  low: number;
+  high: number;
+  windowCenter: number;
+  windowWidth: number;
+  // pixel counts of 64 equally wide bins from minimum to maximum
+  histogram: number[];
+}
+
+export interface watchIndexOptions extends Cancellable {
+  // storage area whose index is followed
+  storagePath: string;
+  // changeToken of an earlier result to continue after, without it only changes from now on are sent
+  changeToken?: string;
+  // as for startStoreScp()
+  indexShards?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface maintainIndexOptions extends Cancellable {
+  // storage area whose index is pruned and compacted, the SCP may keep storing to it
+  storagePath: string;
+  // cold tier of tier(), must be given if the storage area has one, else the migrated instances are pruned
+  coldPath?: string;
+  // as for startStoreScp(), instances in an object store are not pruned
+  storageBackend?: "local" | "s3";
+  indexShards?: number;
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface retrieveFramesOptions extends Cancellable {
+  storagePath: string;
+  // keys matching exactly one instance, e.g. its SOPInstanceUID
+  tags: KeyValue[];
+  // frame number, starting with 0
+  frame?: number;
+  // several frames, overrides frame
+  frames?: number[];
+  // as for startStoreScp()
+  indexShards?: number;
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface exportStudyOptions extends Cancellable {
+  storagePath: string;
+  // keys of the instances exported, a StudyInstanceUID, SeriesInstanceUID or SOPInstanceUID
+  tags: KeyValue[];
+  // "zip" (default, entries stored without compression) or "tar"
+  format?: "zip" | "tar";
+  // transfer syntax the instances are exported in, encoded on the fly, without it they are copied as stored
+  writeTransfer?: string;
+  lossyQuality?: number;
+  // bytes per chunk of the archive, 1 MB by default
+  chunkSize?: number;
+  // chunks produced ahead of the reader, 4 by default
+  highWaterMark?: number;
+  // as for startStoreScp()
+  indexShards?: number;
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+}
+
+export interface createDicomdirOptions extends Cancellable {
+  storagePath: string;
+  // keys of the instances written, a StudyInstanceUID, SeriesInstanceUID or SOPInstanceUID
+  tags: KeyValue[];
+  // directory the DICOMDIR and the DICOM folder are written to, created if missing, must not hold a DICOMDIR
+  destination: string;
+  // application profile of the media, "general" (default, uncompressed), "dvd-jpeg", "dvd-j2k", "usb-jpeg",
+  // "usb-j2k", "bd-jpeg", "bd-j2k" or "mime"
+  profile?: string;
+  // File-set ID of the DICOMDIR, up to 16 characters, "EXPORT" by default
+  fileSetId?: string;
+  // transfer syntax the files are written in, Explicit VR Little Endian for the general profile,
+  // as stored for the others
+  writeTransfer?: string;
+  lossyQuality?: number;
+  // files copied at a time, the number of cores by default
+  parallelism?: number;
+  // as for startStoreScp()
+  indexShards?: number;
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface reindexOptions extends Cancellable {
+  // storage area whose files are added to its index, already indexed instances are kept
+  storagePath: string;
+  // threads listing directories and parsing headers, defaults to the number of cores
+  parallelism?: number;
+  // split a new index into this many SQLite files by StudyInstanceUID (default 1)
+  indexShards?: number;
+  // as for startStoreScp()
+  indexBackend?: "sqlite" | "postgresql";
+  indexConnection?: string;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface importJsonOptions extends Cancellable {
+  // storage area the files are written to as <storagePath>/<StudyInstanceUID>/<SOPInstanceUID>.dcm
+  // and indexed, created if missing
+  storagePath: string;
+  // DICOM JSON texts, each one dataset or an array of them, e.g. DICOMweb metadata responses
+  jsonDatasets: (Buffer | string)[];
+  // bytes of the BulkDataURIs in jsonDatasets
+  bulkData?: { [uri: string]: Buffer };
+  // threads building datasets, defaults to the number of cores
+  parallelism?: number;
+  // split a new index into this many SQLite files by StudyInstanceUID (default 1)
+  indexShards?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface convertMultiframeOptions extends Cancellable {
+  // directory the converted instances are written to as <SOPInstanceUID>.dcm, created if missing
+  storagePath: string;
+  // enhanced images to split, or the classic images of one series to merge
+  sourcePaths?: string[];
+  sourcePath?: string;
+  // "classic" (default) splits each enhanced CT, MR or PET image into an image per frame, "enhanced"
+  // merges classic CT, MR or PET images into one Legacy Converted Enhanced image
+  format?: "classic" | "enhanced";
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface buildPyramidOptions extends Cancellable {
+  // storage area the levels are written to as <storagePath>/<StudyInstanceUID>/<SOPInstanceUID>.dcm
+  // and indexed
+  storagePath: string;
+  // the instances of a VL Whole Slide Microscopy series, e.g. the Filepaths of a SERIES_COMPLETE event
+  sourcePaths?: string[];
+  sourcePath?: string;
+  // encapsulated transfer syntax of the levels, JPEG baseline (1.2.840.10008.1.2.4.50) by default
+  writeTransfer?: string;
+  lossyQuality?: number;
+  // threads decoding, filtering and encoding tiles, defaults to the number of cores
+  parallelism?: number;
+  // as for recompress()
+  j2kThreads?: number;
+  j2kLayers?: number;
+  j2kProgression?: string;
+  // split a new index into this many SQLite files by StudyInstanceUID (default 1)
+  indexShards?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+// the final result of a load test
+export interface LoadTestResult {
+  sent: number;
+  failed: number;
+  // failed association attempts, the association is given up after 10 in a row
+  associationFailures: number;
+  // seconds
+  duration: number;
+  // successful C-STORE requests per second
+  throughput: number;
+  bytesPerSecond: number;
+  // seconds per C-STORE request
+  latency: { mean: number, p50: number, p90: number, p99: number, max: number };
+  // number of failures per response status or error
+  errors: { [reason: string]: number };
+}
+
 export interface storeScpOptions extends scpOptions {
   storagePath?: string;
   netTransferPrefer?: string;
@@ -57,58 +590,971 @@ export interface storeScpOptions extends scpOptions {
   permissive?: boolean;
   storeOnly?: boolean;
   writeFile?: boolean;
+  // with storeOnly, write files exactly as received instead of parsing and re-encoding them
+  streamToFile?: boolean;
+  // with storeOnly, when a C-STORE is acknowledged: once queued for writing, once written (default) or once synced to disk
+  writeDurability?: "queued" | "write" | "fsync";
+  // allocate the attributes of each received dataset from one memory arena, freed at once
+  arenaAllocation?: boolean;
+  // with storeOnly, attributes ("GGGGEEEE") included in FILE_STORAGE and BUFFER_STORAGE events as DICOM JSON
+  // under Attributes, saves loading the file again just to read them
+  eventTags?: string[];
+  // with storeOnly, number of threads writing received files
+  writeThreads?: number;
+  // with storeOnly, spread study directories over subdirectories named after this many hex digits of a UID hash
+  storageShardDigits?: number;
+  // with storeOnly, threads processing associations with pending data while idle ones wait in a poll set,
+  // defaults to 4, 0 serves one association at a time
+  eventLoopThreads?: number;
+  // with storeOnly, serve each association on a thread of its own instead of the event loop,
+  // up to poolThreads at a time while poolQueueSize more wait for a free thread (default 0)
+  poolThreads?: number;
+  poolQueueSize?: number;
+  // with storeOnly, MB and number of storage events sent to JS and not yet delivered to the callback
+  // above which C-STOREs are delayed or refused (inFlightPolicy), 0 is no limit
+  maxInFlightSize?: number;
+  maxInFlightMessages?: number;
+  inFlightPolicy?: "delay" | "refuse";
+  // with storeOnly and writeFile, ms without instances of a series after which a SERIES_COMPLETE event lists
+  // its instances, 0 (default) sends none. With seriesComplete "release" (default) a series is also complete
+  // once the associations that delivered it ended, with "quiet" only once it was quiet
+  seriesQuietPeriod?: number;
+  seriesComplete?: "release" | "quiet";
+  // with seriesQuietPeriod, send no FILE_STORAGE event per instance
+  seriesEventsOnly?: boolean;
+  // with storeOnly, instances matching a rule are queued on disk for its destination before they are
+  // acknowledged and sent on from there, callingAet, modality and sopClass left out match any. With format
+  // "classic" enhanced CT, MR and PET images are split into classic images for the destination
+  forwardRules?: { destination: Node; callingAet?: string; modality?: string; sopClass?: string; format?: "classic" }[];
+  // with storeOnly, the first rule whose conditions all match accepts or rejects an association or instance,
+  // conditions left out match any and values may contain * and ? wildcards. Accepted instances are stored
+  // below the rule's storagePath if set, instances no rule matches are accepted
+  storeRules?: {
+    callingAet?: string;
+    calledAet?: string;
+    callingHost?: string;
+    sopClass?: string;
+    // attributes of the instance, multiple values separated by backslashes
+    tags?: KeyValue[];
+    action?: "accept" | "reject";
+    storagePath?: string;
+  }[];
+  // directory of the forwarding queue, defaults to .forward below storagePath
+  forwardQueuePath?: string;
+  // associations per forwarding destination (default 1)
+  forwardAssociations?: number;
+  // with storeOnly, relay each C-STORE to these destinations while it is received instead of storing it,
+  // answered once they answered; proxySpill queues instances a destination fails to take like forwardRules
+  proxyDestinations?: Node[];
+  proxySpill?: boolean;
+  binaryBuffer?: boolean;
+  maxAssociations?: number;
+  ingestBatchSize?: number;
+  ingestMaxDelay?: number;
+  ingestDurability?: "commit" | "queued";
+  // split a new index into this many SQLite files by StudyInstanceUID, each with its own writer (default 1)
+  indexShards?: number;
+  // where the index is kept, "postgresql" needs a build with DCMTK_POSTGRESQL (default "sqlite")
+  indexBackend?: "sqlite" | "postgresql";
+  // libpq connection string of the postgresql backend, e.g. "host=db dbname=pacs user=scp"
+  indexConnection?: string;
+  // SQLite engine settings, see IndexTuning
+  indexTuning?: IndexTuning;
+  // where the stored files are kept, "s3" needs a build with DCMTK_OBJECT_STORAGE (default "local")
+  storageBackend?: "local" | "s3";
+  // endpoint and bucket of the s3 backend, path style, e.g. "https://minio:9000/pacs/archive"
+  storageUrl?: string;
+  // signing region of the s3 backend (default "us-east-1")
+  storageRegion?: string;
+  // credentials of the s3 backend, default to AWS_ACCESS_KEY_ID and AWS_SECRET_ACCESS_KEY, requests
+  // are not signed without an access key
+  storageAccessKey?: string;
+  storageSecretKey?: string;
+  // size in MB of the local files kept as a read-through cache of the s3 backend, 0 keeps all
+  storageCacheSize?: number;
+  // name of this SCP in the cluster of the SCPs sharing indexBackend, C-MOVEs of instances stored
+  // by another live node are forwarded to it (not for storeOnly)
+  clusterNode?: string;
+  // address the other nodes forward to, defaults to the host name
+  clusterHost?: string;
+  // seconds between the announcements of the node in the index (default 5), nodes missing 3 are gone
+  clusterHeartbeat?: number;
+  // cold tier of storagePath filled by tier(), its files are recalled for C-MOVE, C-GET and frames
+  coldPath?: string;
+  // acknowledge C-STOREs of instances already in the index with their file present without receiving
+  // them to disk or indexing them again, corrections resent with the same SOP Instance UID are dropped
+  skipDuplicates?: boolean;
+  // replace stored files byte identical to one of the last 100000 stored by hard links to it
+  linkDuplicates?: boolean;
+  // append the instances of a series to one pack file in the study directory instead of writing a file
+  // per instance, the index keeps their offsets. Not with compressThreads or the s3 storage backend
+  packSeries?: boolean;
+  // keep the headers of each series, without bulk data, in one compressed file next to the index as
+  // instances are indexed, retrieveMetadata() then reads a study without opening its instance files
+  seriesMetadata?: boolean;
+  // record the CRC-32C of the pixel data of each instance as stored in the index, verify() later rehashes
+  // the files and reports those whose pixel data changed. SQLite index only
+  pixelHashes?: boolean;
+  // record the range, a 64 bin histogram and a window preset of the pixel values of each grayscale instance
+  // in the index as it is stored, retrievePixelStats() returns them. SQLite index only
+  pixelStats?: boolean;
+  // answer C-FIND requests of the Modality Worklist Information Model from the items of upsertWorklist()
+  worklist?: boolean;
+  // accept Storage Commitment requests from the peers and send them the reports on an association of
+  // its own, the requested instances are checked against the index with one lookup per request
+  storageCommitment?: boolean;
+  // write the studies queried and retrieved most often to storagePath/.warm-start.json when stopped
+  // and warm the index and metadata caches from it in the background when started. Not with storeOnly
+  warmStart?: boolean;
+  // OpenJPEG threads per JPEG 2000 frame, 0 for single threaded coding
+  j2kThreads?: number;
+  // quality layers of the JPEG 2000 code-streams written, 1 for a single layer
+  j2kLayers?: number;
+  // packet order of the JPEG 2000 code-streams written: "lrcp", "rlcp", "rpcl", "pcrl" or "cprl"
+  j2kProgression?: string;
+  // write the Extended Offset Table instead of the Basic Offset Table when compressing multi-frame
+  // images, the setting applies to all later requests until changed
+  extendedOffsetTable?: boolean;
+  // MB from which written files are preallocated and written in 4 MB blocks (largeObjectSize) and bypass
+  // the page cache (directWriteSize), 0 disables it, the settings apply to all later requests until changed
+  largeObjectSize?: number;
+  directWriteSize?: number;
+  // cores that may be spent compressing transfers, compressed transfer syntaxes are preferred on links
+  // slower than what they can compress, applies to all later requests until changed
+  compressionCpuBudget?: number;
+  // size in MB of the cache of instances transcoded for C-MOVE sub-operations, 0 disables it
+  transcodeCacheSize?: number;
+  // directory of the transcode cache, defaults to storagePath/.transcode-cache
+  transcodeCachePath?: string;
+  // threads converting received files to writeTransfer at low priority after the C-STORE response,
+  // files are replaced atomically once converted, 0 converts before the response
+  compressThreads?: number;
+  // number of recently read files kept memory mapped for repeated retrievals, 0 disables it
+  fileMapCacheSize?: number;
+  // size in MB of the serialization buffers kept for reuse by binaryBuffer storage, 0 frees each one
+  bufferPoolSize?: number;
+  // parallel associations opened to a C-MOVE destination, 1 sends serially
+  moveAssociations?: number;
+  // with serial C-MOVE and with C-GET sub-operations, most files read ahead of the one being sent, the depth follows
+  // the measured disk and network speed, defaults to 8, 0 reads each file when it is sent
+  moveReadAhead?: number;
+  // C-FIND responses read from the index by a thread of their own ahead of the one being sent, once a query
+  // has a second match. Defaults to 32, 0 reads each response when it is sent
+  findReadAhead?: number;
+  // order of C-MOVE sub-operations: by directory and inode so files are read sequentially (default),
+  // by InstanceNumber within each series, or as returned by the database
+  moveOrder?: "location" | "instance" | "database";
+  // C-GET/C-MOVE sub-operations, files read ahead and background compressions running at a time in the
+  // process, shared weighted fair 8:4:1 by the high, medium and low priority classes. Defaults to 0, no limit
+  prioritySlots?: number;
+  // limits per calling AE title and per IP, checked before an association is negotiated
+  aeLimits?: RateLimit;
+  ipLimits?: RateLimit;
+  // C-STORE requests outstanding per association, granted to incoming SCUs, also for the sub-operations
+  // of their C-GETs, and proposed for C-MOVE sub-associations, 1 waits for each response
+  asyncOperations?: number;
 };
 
 export interface shutdownScuOptions extends scuOptions {
 };
 
-export interface parseOptions {
+export interface parseOptions extends Cancellable {
   sourcePath: string;
   verbose?: boolean;
+  nativeResult?: boolean;
+  // stop reading at this attribute ("GGGGEEEE", e.g. "7FE00010" for the pixel data), it is not included
+  stopAtTag?: string;
+  // top level attributes ("GGGGEEEE") to output, all by default
+  includeTags?: string[];
+  // JSON without indentation and line breaks
+  compact?: boolean;
+  // allocate the attributes of the parsed dataset from one memory arena, freed at once
+  arenaAllocation?: boolean;
+  // binary values are written as BulkDataURI of this prefix followed by the tag ("GGGGEEEE")
+  // instead of InlineBinary, and are not read from the file
+  bulkDataURI?: string;
 }
 
-export interface recompressOptions {
+export interface parseDirectoryOptions extends Cancellable {
+  // a directory or file, directories are walked recursively
+  sourcePath?: string;
+  // further directories or files
+  sourcePaths?: string[];
+  verbose?: boolean;
+  nativeResult?: boolean;
+  // threads walking the directories and parsing files, defaults to the number of cores
+  parallelism?: number;
+  // results per PARSE_RESULTS progress message, an array of { Filepath, Dataset }, defaults to 100
+  chunkSize?: number;
+  stopAtTag?: string;
+  includeTags?: string[];
+  bulkDataURI?: string;
+}
+
+export interface decodeFrameOptions extends Cancellable {
+  // a JPEG 2000 compressed file
+  sourcePath: string;
+  // frame number, starting with 0
+  frame?: number;
+  // number of resolution levels to skip, each one halves width and height
+  reduce?: number;
+  // [left, top, width, height] in full resolution pixels, the whole frame by default
+  region?: number[];
+  // OpenJPEG threads, 0 for single threaded decoding
+  j2kThreads?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface getFrameOptions extends Cancellable {
+  sourcePath: string;
+  // frame number, starting with 0
+  frame?: number;
+  // several frames, overrides frame
+  frames?: number[];
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface getBulkDataRangeOptions extends Cancellable {
+  sourcePath: string;
+  // top level attribute ("GGGGEEEE") with bulk data, the pixel data by default
+  tag?: string;
+  // first byte of the value, fragments of encapsulated pixel data count back to back
+  offset?: number;
+  // bytes read, the rest of the value by default
+  length?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface renderFrameOptions extends Cancellable {
+  sourcePath?: string;
+  // further files, the same frames are rendered for each file
+  sourcePaths?: string[];
+  // frame number, starting with 0
+  frame?: number;
+  // several frames per file, overrides frame
+  frames?: number[];
+  // bounding box of the rendered image, the aspect ratio is kept. With only one of them set
+  // the other one follows from the pixel aspect ratio, the original size by default
+  width?: number;
+  height?: number;
+  // [center, width] for monochrome images, the first window of the image or min/max by default
+  window?: number[];
+  // "raw" 8 bit pixels (default, color interleaved), "jpeg" or "png" (if built with libpng)
+  format?: "raw" | "jpeg" | "png";
+  // JPEG quality 1..100
+  lossyQuality?: number;
+  // number of files rendered in parallel, defaults to the number of cores
+  parallelism?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+}
+
+export interface recompressOptions extends Cancellable {
   sourcePath: string;
   storagePath: string;
   writeTransfer?: string;
   lossyQuality?: number;
   enableRecompression?: boolean;
+  // manifest of converted files, unchanged inputs are skipped when recompressing again with the same settings
+  manifestPath?: string;
+  // number of transcoding threads, defaults to the number of cores
+  parallelism?: number;
+  // OpenJPEG threads per JPEG 2000 frame, 0 for single threaded coding
+  j2kThreads?: number;
+  // quality layers of the JPEG 2000 code-streams written, 1 for a single layer
+  j2kLayers?: number;
+  // packet order of the JPEG 2000 code-streams written: "lrcp", "rlcp", "rpcl", "pcrl" or "cprl"
+  j2kProgression?: string;
+  // image rows per restart interval of lossless JPEG output, 0 for none. Restart intervals let
+  // the threads of setFrameThreads() decode a frame in parallel
+  restartRows?: number;
+  // write the Extended Offset Table instead of the Basic Offset Table when compressing multi-frame
+  // images, the setting applies to all later requests until changed
+  extendedOffsetTable?: boolean;
+  // MB from which written files are preallocated and written in 4 MB blocks (largeObjectSize) and bypass
+  // the page cache (directWriteSize), 0 disables it, the settings apply to all later requests until changed
+  largeObjectSize?: number;
+  directWriteSize?: number;
   verbose?: boolean;
+  nativeResult?: boolean;
 };
 
+// what anonymize() does to an attribute wherever it occurs, also in the items of sequences
+export interface AnonymizeRule {
+  // "GGGGEEEE"
+  tag: string;
+  // "remove", "empty", "replace" with value, or "remapUID" to the same new UID in every file
+  action: "remove" | "empty" | "replace" | "remapUID";
+  value?: string;
+}
+
+export interface anonymizeOptions extends Cancellable {
+  // file or directory of the DICOM files to anonymize
+  sourcePath: string;
+  // directory the anonymized files are written to, named by their new SOPInstanceUID
+  storagePath: string;
+  // the profile applied, defaults to a subset of the Basic Application Level Confidentiality Profile
+  // that also removes private attributes
+  rules?: AnonymizeRule[];
+  // remove all private attributes, implied without rules
+  removePrivateTags?: boolean;
+  // prefix of the UIDs generated by remapUID, defaults to the DCMTK site root
+  uidRoot?: string;
+  // JSON file of the UIDs remapped by earlier requests, the new ones are added, so later batches
+  // of a study get the same UIDs
+  uidMapPath?: string;
+  // number of transforming threads, defaults to the number of cores
+  parallelism?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+};
+
+export interface verifyOptions extends Cancellable {
+  // storage area whose instances are rehashed and compared to the hashes recorded by an scp with pixelHashes
+  storagePath?: string;
+  // without storagePath, file or directory of the DICOM files to hash
+  sourcePath?: string;
+  indexShards?: number;
+  // number of hashing threads, defaults to the number of cores
+  parallelism?: number;
+  verbose?: boolean;
+  nativeResult?: boolean;
+};
+
+// a progress or final result of a streamed request, buffer is set for binary storage callbacks
+export interface StreamEvent {
+  result: Result;
+  buffer?: Buffer;
+}
+
+// pull based view on a request, usable with for await
+export interface ResultStream extends Request {
+  next(): Promise<{ value: StreamEvent | undefined, done: boolean }>;
+  return(): Promise<{ value: StreamEvent | undefined, done: boolean }>;
+}
+
+// the native side stops producing once highWaterMark events are waiting for the consumer,
+// events are acknowledged when they are pulled
+function stream(fn: (options: any, callback: (result: Result, buffer?: Buffer) => void, highWaterMark: number) => { acknowledge: (count: number) => void, cancel: () => void },
+                options: any, highWaterMark: number): ResultStream {
+  const events: StreamEvent[] = [];
+  const waiting: ((item: { value: StreamEvent | undefined, done: boolean }) => void)[] = [];
+  let finished = false;
+  let closed = false;
+
+  const request: any = {};
+  for (const key in options) request[key] = options[key];
+  request.nativeResult = true;
+
+  // an aborted signal cancels the request like cancel() does, the final result ends the stream
+  const signal: AbortSignalLike | undefined = options.signal;
+  const onAbort = () => control.cancel();
+
+  const onEvent = (result: Result, buffer?: Buffer) => {
+    // pending results are progress, anything else is the final result of the request
+    const pending = result.code === 1;
+    if (!pending) {
+      finished = true;
+      if (signal) signal.removeEventListener("abort", onAbort);
+    }
+    if (closed) return;
+    const resolve = waiting.shift();
+    if (resolve) {
+      resolve({ value: { result, buffer }, done: false });
+      if (pending) acknowledge(1);
+    } else {
+      events.push({ result, buffer });
+    }
+    if (finished) {
+      while (waiting.length > 0) waiting.shift()!({ value: undefined, done: true });
+    }
+  };
+
+  // batched results are streamed one by one
+  const control = fn(request, (result: Result, buffer?: Buffer) => {
+    if (Array.isArray(result)) {
+      result.forEach((item) => onEvent(item));
+    } else {
+      onEvent(result, buffer);
+    }
+  }, highWaterMark);
+  const acknowledge = control.acknowledge;
+  if (signal && signal.aborted) {
+    control.cancel();
+  } else if (signal) {
+    signal.addEventListener("abort", onAbort);
+  }
+
+  const result: ResultStream = {
+    next() {
+      const event = events.shift();
+      if (event) {
+        if (event.result.code === 1) acknowledge(1);
+        return Promise.resolve({ value: event, done: false });
+      }
+      if (finished || closed) return Promise.resolve({ value: undefined, done: true });
+      return new Promise((resolve) => waiting.push(resolve));
+    },
+    return() {
+      // let the native side run to completion without waiting for us
+      closed = true;
+      events.length = 0;
+      acknowledge(-1);
+      while (waiting.length > 0) waiting.shift()!({ value: undefined, done: true });
+      return Promise.resolve({ value: undefined, done: true });
+    },
+    // the final result of the request still ends the stream, as with an aborted options.signal
+    cancel() {
+      control.cancel();
+    },
+  };
+  const asyncIterator = (Symbol as any).asyncIterator || Symbol.for('Symbol.asyncIterator');
+  (result as any)[asyncIterator] = () => result;
+  return result;
+}
+
+export function echoScu(options: echoScuOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.echoScu, options, callback);
+}
+
+// C-ECHO of all peers at once from one native thread, for health checks of many peers. The result
+// is { peers, reachable, unreachable, elapsed }, each peer with its status ("ok", "failed", "rejected",
+// "aborted", "unreachable" or "timeout") and the ms of the connect, the association negotiation and
+// the C-ECHO (-1 if not reached). Plain TCP only
+export function echoMany(options: echoManyOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.echoMany, options, callback);
+}
+
+export function findScu(options: findScuOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.findScu, options, callback);
+}
+
+export function findScuBatch(options: findScuBatchOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.findScuBatch, options, callback);
+}
+
+// one query to many peers at once, merged and deduplicated. The result is { peers, results, duplicates,
+// answered, elapsed }, each peer with its status ("ok", "failed" or "timeout") and the number of
+// unique and duplicate responses it returned
+export function findScuFederated(options: findScuFederatedOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.findScuFederated, options, callback);
+}
+
+export function getScu(options: getScuOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.getScu, options, callback);
+}
+
+export function moveScu(options: moveScuOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.moveScu, options, callback);
+}
+
+// queries the studies of each job and moves those not held locally yet. Each study comes as PREFETCH_STUDY
+// { job, PatientID, StudyInstanceUID, status: "moved" | "present" | "failed" | "cancelled", instances?,
+// localInstances?, completed?, failed?, warning?, elapsed?, error? }, a job whose C-FIND failed as
+// PREFETCH_FAILED { job, PatientID, error }, progress at most once a second as PREFETCH_PROGRESS
+// { jobs, queried, studies, present, moved, failed, instances, elapsed }. The final result holds
+// { jobs, studies, present, moved, failed, instances, elapsed }
+export function prefetch(options: prefetchOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.prefetch, options, callback);
+}
+
+export function storeScu(options: storeScuOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.storeScu, options, callback);
+}
+
+// sends C-STORE requests to an SCP for qualification and capacity tests, progress comes once a
+// second as LOAD_PROGRESS { elapsed, sent, failed, throughput, errors } with the counts of that
+// second, the final result holds a LoadTestResult
+export function loadTest(options: loadTestOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.loadTest, options, callback);
+}
+
+// fills a storage area with synthetic patients for benchmarks and tests, progress comes at most once
+// a second as GENERATE_PROGRESS { patients, instances, elapsed }, the final result holds
+// { patients, instances, failed, elapsed, instancesPerSecond }
+export function generateDatasets(options: generateDatasetsOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.generateDatasets, options, callback);
+}
+
+// writes DICOM JSON datasets to a storage area and indexes them, progress comes at most once a second
+// as IMPORT_PROGRESS { texts, instances, elapsed }, the final result holds
+// { instances, invalid, failed, elapsed, instancesPerSecond }
+export function importJson(options: importJsonOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.importJson, options, callback);
+}
+
+// converts between enhanced multi-frame and classic single frame images, progress comes at most once a
+// second as CONVERT_PROGRESS { files, instances, elapsed }, the final result holds
+// { instances: [{ SOPInstanceUID, Filepath }], skipped: [{ Filepath, reason }], elapsed }
+export function convertMultiframe(options: convertMultiframeOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.convertMultiframe, options, callback);
+}
+
+// builds the lower resolution levels missing from a whole slide image series, progress comes at most
+// once a second as PYRAMID_PROGRESS { tiles, totalTiles, elapsed }, the final result holds
+// { levels: [{ SOPInstanceUID, Filepath, columns, rows, frames }], skipped, failed, elapsed }, skipped
+// telling why no level was built
+export function buildPyramid(options: buildPyramidOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.buildPyramid, options, callback);
+}
+
+// indexes the files already in a storage area, progress comes at most once a second as
+// REINDEX_PROGRESS { files, instances, elapsed }, the final result holds
+// { files, instances, failed, elapsed, instancesPerSecond }
+export function reindex(options: reindexOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.reindex, options, callback);
+}
+
+// migrates the studies idle for tierAfterDays to the cold tier, progress comes at most once a second
+// as TIER_PROGRESS { studies, instances, total, elapsed }, the final result holds
+// { studies, instances, failed, hotBytes, coldBytes, elapsed }
+export function tier(options: tierOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.tier, options, callback);
+}
+
+// the matches of the index of a storage area as an array of DICOM JSON objects, the same as findScu()
+// against its SCP returns but without association, DIMSE encoding and the SCP itself
+export function queryIndex(options: queryIndexOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.queryIndex, options, callback);
+}
+
+// the attributes of the matching instances up to the pixel data, an array of DICOM JSON objects
+export function retrieveMetadata(options: retrieveMetadataOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.retrieveMetadata, options, callback);
+}
+
+// the PixelStats of the matching instances recorded by an scp with pixelStats, in the options of
+// retrieveMetadata(). Instances stored without statistics, e.g. color images, are left out
+export function retrievePixelStats(options: retrieveMetadataOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.retrievePixelStats, options, callback);
+}
+
+// the frames of the matching instance as getFrame() passes them, with FRAME results
+export function retrieveFrames(options: retrieveFramesOptions, callback: (result: Result, buffer?: Buffer) => void): Request {
+  return cancellable(addon.retrieveFrames, options, callback);
+}
+
+// the matching instances as one ZIP or tar archive named <StudyInstanceUID>/<SeriesInstanceUID>/<SOPInstanceUID>.dcm,
+// read while it is written. The stream emits "summary" with { format, instances, skipped, transcoded, bytes, elapsed }
+// before it ends and fails with the error of the request, destroying it cancels the export
+export function exportStudy(options: exportStudyOptions): Readable {
+  const events = stream(addon.exportStudy, options, options.highWaterMark || 4);
+  const pull = (): void => {
+    events.next().then(({ value, done }) => {
+      if (done || !value) {
+        readable.push(null);
+      } else if (value.result.code === 1) {
+        if (value.buffer) readable.push(value.buffer); else pull();
+      } else if (value.result.code === 2) {
+        readable.destroy(new Error(value.result.message));
+      } else {
+        readable.emit("summary", value.result.container);
+        readable.push(null);
+      }
+    });
+  };
+  const readable = new Readable({
+    read: pull,
+    destroy(error, callback) {
+      events.cancel();
+      events.return();
+      callback(error);
+    },
+  });
+  return readable;
+}
+
+// writes the matching instances to destination as DICOM media with a DICOMDIR. Progress comes at most once
+// a second as DICOMDIR_PROGRESS { copied, total, bytes }, the final result holds
+// { dicomdir, instances, skipped, rejected, transcoded, bytes, elapsed }
+export function createDicomdir(options: createDicomdirOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.createDicomdir, options, callback);
+}
+
+// the studies, series and instances added to the index until cancelled, as INDEX_CHANGES results
+// { changes: [{ level, action: "created" | "updated", StudyInstanceUID, SeriesInstanceUID?, SOPInstanceUID?, time }], changeToken }
+export function watchIndex(options: watchIndexOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.watchIndex, options, callback);
+}
+
+// removes the instances whose files are gone from the index, then returns its free pages to the file
+// system and refreshes its statistics. Progress comes at most once a second as MAINTENANCE_PROGRESS
+// { shard, shards, checked, removed, freedPages, elapsed }, the final result holds
+// { checked, missing, removed, freedPages, elapsed }
+export function maintainIndex(options: maintainIndexOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.maintainIndex, options, callback);
+}
+
+// a running SCP, see stopScp() and setScpPeers()
+export interface ScpHandle extends Request {
+  stop(drainTimeout?: number): void;
+  setPeers(peers: Node[]): number;
+}
+
+export function startStoreScp(options: storeScpOptions, callback: (result: Result, buffer?: Buffer) => void): ScpHandle {
+  return cancellable(addon.startScp, options, callback, (handle: ScpHandle) => handle.stop());
+}
+
+// stops accepting associations, gives open ones drainTimeout ms to finish before their connections are
+// interrupted and flushes queued file writes and index inserts. The callback of startStoreScp then gets
+// the final result { stopped, drained }, drained is false if associations had to be interrupted
+export function stopScp(handle: ScpHandle, drainTimeout: number = 10000) {
+  handle.stop(drainTimeout);
+}
+
+// replaces the peers of a running SCP, associations negotiated and C-MOVE destinations looked up
+// afterwards see the new peers. Returns the number of AE titles, of peers with the same AE title the
+// first one counts
+export function setScpPeers(handle: ScpHandle, peers: Node[]): number {
+  return handle.setPeers(peers);
+}
+
+export function shutdownScu(options: shutdownScuOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.shutdownScu, options, callback);
+}
+
+export function parseFile(options: parseOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.parseFile, options, callback);
+}
+
+// the final result holds the number of parsed files and of files that could not be parsed
+export function parseDirectory(options: parseDirectoryOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.parseDirectory, options, callback);
+}
+
+// the pixels are passed color-by-pixel to the buffer callback, 1 byte per sample up to 8 bits,
+// 2 bytes in native byte order otherwise. The result holds Columns, Rows, SamplesPerPixel and BitsAllocated
+export function decodeFrame(options: decodeFrameOptions, callback: (result: Result, buffer?: Buffer) => void): Request {
+  return cancellable(addon.decodeFrame, options, callback);
+}
+
+// each frame is passed as stored in the file with a FRAME result, compressed frames as their
+// fragments back to back. Only the bytes of the requested frames are read from the file
+export function getFrame(options: getFrameOptions, callback: (result: Result, buffer?: Buffer) => void): Request {
+  return cancellable(addon.getFrame, options, callback);
+}
+
+// the bytes of a range of a value are passed as stored with a BULK_DATA_RANGE result holding offset,
+// length, totalLength and TransferSyntaxUID, e.g. a part of the bit stream of an MPEG-2, MPEG-4 or HEVC video
+export function getBulkDataRange(options: getBulkDataRangeOptions, callback: (result: Result, buffer?: Buffer) => void): Request {
+  return cancellable(addon.getBulkDataRange, options, callback);
+}
+
+// each rendered frame is passed with a RENDERED_FRAME result, the final result holds the totals
+export function renderFrame(options: renderFrameOptions, callback: (result: Result, buffer?: Buffer) => void): Request {
+  return cancellable(addon.renderFrame, options, callback);
+}
+
+export function recompress(options: recompressOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.recompress, options, callback);
+}
+
+// applies the rules to the files of sourcePath and writes them to storagePath, progress comes at most
+// once a second as ANONYMIZE_PROGRESS { files, anonymized, elapsed }, the final result holds
+// { files, anonymized, failed, uids, elapsed, filesPerSecond }
+export function anonymize(options: anonymizeOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.anonymize, options, callback);
+}
+
+// hashes the pixel data of files as stored with CRC-32C. For a storagePath each instance whose hash
+// differs from the recorded one comes as VERIFY_MISMATCH { file, sopInstanceUID, expected, hash },
+// progress at most once a second as VERIFY_PROGRESS { instances, checked, mismatched, elapsed } and
+// the final result holds { instances, verified, mismatched, failed, skipped, elapsed, filesPerSecond }.
+// For a sourcePath each file comes as PIXEL_HASH { file, sopInstanceUID, hash } and the final result
+// holds { files, hashed, failed, elapsed, filesPerSecond }. Unreadable files come as VERIFY_FAILED
+// or PIXEL_HASH_FAILED { file, sopInstanceUID, error }
+export function verify(options: verifyOptions, callback: (result: Result) => void): Request {
+  return cancellable(addon.verify, options, callback);
+}
+
+// requests to one peer sharing pooled associations, the handshake is only done for the first one
+export class Association {
+  constructor(private source: Node, private target: Node, private idleTimeout?: number) {}
+
+  echo(options: Partial<echoScuOptions>, callback: (result: Result) => void): Request {
+    return cancellable(addon.echoScu, this.options(options), callback);
+  }
+
+  find(options: Partial<findScuOptions>, callback: (result: Result) => void): Request {
+    return cancellable(addon.findScu, this.options(options), callback);
+  }
+
+  move(options: Partial<moveScuOptions>, callback: (result: Result) => void): Request {
+    return cancellable(addon.moveScu, this.options(options), callback);
+  }
+
+  // negotiates associations to the peer until count are idle, e.g. just before a scheduled prefetch
+  prewarm(count: number = 1, callback?: (negotiated: number, error: string | null) => void) {
+    prewarmAssociations(this.options({}), count, callback);
+  }
+
+  // releases the idle associations to the peer
+  close() {
+    addon.closeAssociations({ target: this.target });
+  }
+
+  private options(options: any): any {
+    const request: any = {};
+    for (const key in options) request[key] = options[key];
+    request.source = this.source;
+    request.target = this.target;
+    request.reuseAssociation = true;
+    if (this.idleTimeout !== undefined) request.associationIdleTimeout = this.idleTimeout;
+    return request;
+  }
+}
+
+export type Operation = "echo" | "find" | "get" | "move" | "store" | "scp" | "shutdown" | "parse" | "recompress" | "anonymize" | "render" | "loadtest" | "generate" | "reindex" | "tier" | "index" | "verify" | "watch" | "media";
+
+// requests run on native threads instead of the libuv threadpool, at most limit requests
+// of an operation run at the same time, zero for no limit
+export function setConcurrency(operation: Operation, limit: number) {
+  addon.setConcurrency(operation, limit);
+}
+
+// places the threads of an operation, or of the SCP associations, on the NUMA nodes: "spread"
+// binds each thread to the node with the fewest threads of the operation, "node:<n>" all to node n.
+// Applies to threads started afterwards, throws if the node does not exist
+export function setPlacement(operation: Operation | "association", policy: "none" | "spread" | `node:${number}`) {
+  addon.setPlacement(operation, policy);
+}
+
+// C-STORE requests and C-MOVE sub-operations of all requests and SCPs of the process send files already
+// in the negotiated transfer syntax as stored instead of parsing and encoding them again (default false)
+export function setZeroCopySend(enabled: boolean) {
+  addon.setZeroCopySend(enabled);
+}
+
+// threads of all requests and SCPs of the process coding the frames of multi-frame JPEG-LS, RLE and
+// lossless JPEG images, decoding the restart intervals of lossless JPEG frames and coding the segments
+// of RLE frames, 0 (default) for serial coding
+export function setFrameThreads(threads: number) {
+  addon.setFrameThreads(threads);
+}
+
+// zlib level 0 to 9 of the data sets all requests and SCPs of the process write or send in Deflated
+// Explicit VR Little Endian, 1 is fastest and 9 smallest (default 6)
+export function setDeflateLevel(level: number) {
+  addon.setDeflateLevel(level);
+}
+
+export function closeAssociations() {
+  addon.closeAssociations();
+}
+
+// negotiates associations from options.source to options.target with the network options of the request
+// and parks them for requests with reuseAssociation until count (at most 4) are idle. The callback gets
+// the number negotiated and the error that stopped it
+export function prewarmAssociations(options: echoScuOptions, count: number = 1, callback?: (negotiated: number, error: string | null) => void) {
+  addon.prewarmAssociations(options, count, callback);
+}
+
+// seconds the addresses of peers given by host name are cached (default 60), 0 resolves the host of
+// every association again. Also drops the cached addresses
+export function setHostCache(ttl: number) {
+  addon.setHostCache(ttl);
+}
+
+// counters of the C-FIND result cache: queries answered from it, by a concurrent identical query
+// and by the peer, and the number of cached results
+export function findCacheStats(): { hits: number, joined: number, misses: number, entries: number } {
+  return addon.findCacheStats();
+}
+
+export function clearFindCache() {
+  addon.clearFindCache();
+}
+
+// keeps the JSON of up to size MB of parsed files for parseFile() and parseDirectory() of the same
+// files with the same options, while their size and modification time are unchanged. 0 (default)
+// disables the cache and drops the cached JSON
+export function setParseCache(size: number) {
+  addon.setParseCache(size);
+}
+
+// counters of the parse cache: parses answered from it and not, the number and bytes of cached results
+export function parseCacheStats(): { hits: number, misses: number, entries: number, bytes: number } {
+  return addon.parseCacheStats();
+}
+
+export function clearParseCache() {
+  addon.clearParseCache();
+}
+
+// a scheduled procedure step of the worklist, identified by accessionNumber and scheduledProcedureStepID.
+// Dates are YYYYMMDD, times HHMMSS, names in DICOM PN format
+export interface WorklistItem {
+  accessionNumber?: string;
+  patientName?: string;
+  patientID?: string;
+  patientBirthDate?: string;
+  patientSex?: string;
+  studyInstanceUID?: string;
+  requestedProcedureID?: string;
+  requestedProcedureDescription?: string;
+  referringPhysicianName?: string;
+  modality?: string;
+  scheduledStationAETitle?: string;
+  scheduledStationName?: string;
+  scheduledProcedureStepStartDate?: string;
+  scheduledProcedureStepStartTime?: string;
+  scheduledPerformingPhysicianName?: string;
+  scheduledProcedureStepDescription?: string;
+  scheduledProcedureStepID?: string;
+}
+
+// adds items to the worklist served by SCPs started with worklist: true, or replaces those with the
+// same identity. Returns the number of items
+export function upsertWorklist(items: WorklistItem[]): number {
+  return addon.upsertWorklist(items);
+}
+
+// removes the items with the identity of those given, returns the number of items left
+export function removeWorklist(items: WorklistItem[]): number {
+  return addon.removeWorklist(items);
+}
+
+export function clearWorklist() {
+  addon.clearWorklist();
+}
+
+export interface MetricSeries {
+  name: string,
+  labels: { [label: string]: string },
+}
+
+export interface MetricHistogram extends MetricSeries {
+  count: number,
+  // sum and maximum in seconds
+  sum: number,
+  max: number,
+  // upper bounds of the buckets holding the median, 90th and 99th percentile
+  p50: number,
+  p90: number,
+  p99: number,
+  // cumulative counts of the non-empty buckets as [upper bound in seconds, count]
+  buckets: [number, number][],
+}
+
+export interface Metrics {
+  counters: (MetricSeries & { value: number })[],
+  gauges: (MetricSeries & { value: number })[],
+  histograms: MetricHistogram[],
+}
+
+// process wide counters, gauges and latency histograms: queue wait and execution time per operation,
+// SCP operations and associations, index inserts, codec times per transfer syntax and network traffic
+export function getMetrics(): Metrics {
+  return JSON.parse(addon.getMetrics());
+}
+
+// records trace spans of the hot paths (SQL, file loading, transcoding, DIMSE send and receive) into
+// per-thread ring buffers of spansPerThread spans, 0 disables tracing
+export function setTracing(spansPerThread: number) {
+  addon.setTracing(spansPerThread);
+}
+
+// the spans recorded since the last call, as Chrome trace (chrome://tracing, Perfetto) or as an
+// OTLP/JSON export request to POST to a collector's /v1/traces endpoint
+export function getTrace(format: "chrome" | "otlp" = "chrome", serviceName: string = "dcmtk"): any {
+  return JSON.parse(addon.getTrace(format, serviceName));
+}
+
+export interface LogRecord {
+  // ms since the epoch
+  time: number,
+  level: "FATAL" | "ERROR" | "WARN" | "INFO" | "DEBUG" | "TRACE",
+  logger: string,
+  message: string,
+  thread: string,
+}
+
+export interface LoggingOptions {
+  // records queued for a logging thread writing to stderr, 0 (default) writes on the calling thread
+  queueSize?: number;
+  // records per sink call (default 100)
+  batchSize?: number;
+  // ms after which a partial batch is handed to the sink (default 100)
+  flushInterval?: number;
+}
+
+// configures the process wide DCMTK log output: stderr, queued for a thread of its own so debug
+// output of one association doesn't stall the others, or batches of records for sink
+export function setLogging(options: LoggingOptions = {}, sink?: (records: LogRecord[]) => void) {
+  addon.setLogging(options, sink);
+}
 
-export function echoScu(options: echoScuOptions, callback: (result: string) => void) {
-  addon.echoScu(JSON.stringify(options), callback);
+// getMetrics() in the Prometheus text exposition format, names are prefixed with prefix
+export function prometheusMetrics(prefix: string = "dcmtk_"): string {
+  const metrics = getMetrics();
+  const labels = (series: MetricSeries, extra: { [label: string]: string } = {}) => {
+    const all: { [label: string]: string } = { ...series.labels, ...extra };
+    const keys = Object.keys(all);
+    if (keys.length === 0) {
+      return "";
+    }
+    return "{" + keys.map((k) => `${k}="${all[k].replace(/\\/g, "\\\\").replace(/"/g, '\\"').replace(/\n/g, "\\n")}"`).join(",") + "}";
+  };
+  const lines: string[] = [];
+  const typed: { [name: string]: boolean } = {};
+  const type = (name: string, kind: string) => {
+    if (!typed[name]) {
+      typed[name] = true;
+      lines.push(`# TYPE ${name} ${kind}`);
+    }
+  };
+  for (const c of metrics.counters) {
+    type(prefix + c.name, "counter");
+    lines.push(`${prefix}${c.name}${labels(c)} ${c.value}`);
+  }
+  for (const g of metrics.gauges) {
+    type(prefix + g.name, "gauge");
+    lines.push(`${prefix}${g.name}${labels(g)} ${g.value}`);
+  }
+  for (const h of metrics.histograms) {
+    const name = prefix + h.name;
+    type(name, "histogram");
+    for (const [le, count] of h.buckets) {
+      lines.push(`${name}_bucket${labels(h, { le: String(le) })} ${count}`);
+    }
+    lines.push(`${name}_bucket${labels(h, { le: "+Inf" })} ${h.count}`);
+    lines.push(`${name}_sum${labels(h)} ${h.sum}`);
+    lines.push(`${name}_count${labels(h)} ${h.count}`);
+  }
+  return lines.join("\n") + "\n";
 }
 
-export function findScu(options: findScuOptions, callback: (result: string) => void) {
-  addon.findScu(JSON.stringify(options), callback);
+export function findScuStream(options: findScuOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.findScu, options, highWaterMark);
 }
 
-export function getScu(options: getScuOptions, callback: (result: string) => void) {
-  addon.getScu(JSON.stringify(options), callback);
+export function findScuBatchStream(options: findScuBatchOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.findScuBatch, options, highWaterMark);
 }
 
-export function moveScu(options: moveScuOptions, callback: (result: string) => void) {
-  addon.moveScu(JSON.stringify(options), callback);
+export function findScuFederatedStream(options: findScuFederatedOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.findScuFederated, options, highWaterMark);
 }
 
-export function storeScu(options: storeScuOptions, callback: (result: string) => void) {
-  addon.storeScu(JSON.stringify(options), callback);
+export function getScuStream(options: getScuOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.getScu, options, highWaterMark);
 }
 
-export function startStoreScp(options: storeScpOptions, callback: (result: string) => void) {
-  addon.startScp(JSON.stringify(options), callback);
+export function moveScuStream(options: moveScuOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.moveScu, options, highWaterMark);
 }
 
-export function shutdownScu(options: shutdownScuOptions, callback: (result: string) => void) {
-  addon.shutdownScu(JSON.stringify(options), callback);
+export function storeScuStream(options: storeScuOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.storeScu, options, highWaterMark);
 }
 
-export function parseFile(options: parseOptions, callback: (result: string) => void) {
-  addon.parseFile(JSON.stringify(options), callback);
+export function startStoreScpStream(options: storeScpOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.startScp, options, highWaterMark);
 }
 
-export function recompress(options: recompressOptions, callback: (result: string) => void) {
-  addon.recompress(JSON.stringify(options), callback);
+export function parseDirectoryStream(options: parseDirectoryOptions, highWaterMark: number = 16): ResultStream {
+  return stream(addon.parseDirectory, options, highWaterMark);
 }
@@ -107,6 +107,21 @@ class DCMTK_LOG4CPLUS_EXPORT OFLog
      */
     static void configure(OFLogger::LogLevel level = OFLogger::WARN_LOG_LEVEL);
 
+    /** set the verbosity of the calling thread only. The thread logs all
+     *  messages at or above this level, other threads and messages below it
+     *  keep the level of their logger.
+     *  @param level the verbosity of this thread, OFF_LOG_LEVEL to use the
+     *    levels of the loggers only
+     *  @return the previous verbosity of this thread
+     */
+    static OFLogger::LogLevel setThreadLogLevel(OFLogger::LogLevel level);
+
+    /** get the verbosity of the calling thread, e.g. to pass it on to a
+     *  thread doing work on behalf of this one
+     *  @return the level set by setThreadLogLevel(), OFF_LOG_LEVEL if none
+     */
+    static OFLogger::LogLevel getThreadLogLevel();
+
     /** handle the command line options used for logging
      *  @param cmd the command line whose options are handled
      *  @param app the console application which is used for console output and error checking
@@ -88,6 +88,21 @@ namespace log4cplus {
              */
             virtual bool isEnabledFor(LogLevel ll) const;
 
+            /**
+             * Set the LogLevel from which on the calling thread logs
+             * regardless of the level of the logger, e.g. to enable debug
+             * output for one request only. OFF_LOG_LEVEL disables this.
+             *
+             * @return the previous LogLevel of the calling thread.
+             */
+            static LogLevel setThreadLogLevel(LogLevel ll);
+
+            /**
+             * @return the LogLevel of the calling thread, OFF_LOG_LEVEL if
+             *         none has been set.
+             */
+            static LogLevel getThreadLogLevel();
+
             /**
              * This generic form is intended to be used by wrappers. 
              */
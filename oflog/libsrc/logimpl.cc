@@ -88,16 +88,45 @@ LoggerImpl::closeNestedAppenders()
 }
 
 
+namespace
+{
+
+// level from which on the calling thread logs, see setThreadLogLevel()
+thread_local LogLevel threadLogLevel = OFF_LOG_LEVEL;
+
+} // namespace
+
+
 bool 
 LoggerImpl::isEnabledFor(LogLevel loglevel) const
 {
     if(hierarchy.disableValue >= loglevel) {
         return false;
     }
+    // a single comparison for threads without a level of their own
+    if(loglevel >= threadLogLevel) {
+        return true;
+    }
     return loglevel >= getChainedLogLevel();
 }
 
 
+LogLevel
+LoggerImpl::setThreadLogLevel(LogLevel ll)
+{
+    LogLevel previous = threadLogLevel;
+    threadLogLevel = ll;
+    return previous;
+}
+
+
+LogLevel
+LoggerImpl::getThreadLogLevel()
+{
+    return threadLogLevel;
+}
+
+
 void 
 LoggerImpl::log(LogLevel loglevel, 
                 const log4cplus::tstring& message,
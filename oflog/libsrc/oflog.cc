@@ -33,6 +33,7 @@
 #include "dcmtk/oflog/helpers/socket.h"
 #include "dcmtk/oflog/helpers/strhelp.h"
 #include "dcmtk/oflog/internal/internal.h"
+#include "dcmtk/oflog/spi/logimpl.h"
 
 OFunique_ptr<dcmtk::log4cplus::helpers::Properties> OFLog::configProperties_;
 
@@ -151,6 +152,16 @@ void OFLog::configure(OFLogger::LogLevel level)
     configureLogger(level);
 }
 
+OFLogger::LogLevel OFLog::setThreadLogLevel(OFLogger::LogLevel level)
+{
+    return OFstatic_cast(OFLogger::LogLevel, dcmtk::log4cplus::spi::LoggerImpl::setThreadLogLevel(level));
+}
+
+OFLogger::LogLevel OFLog::getThreadLogLevel()
+{
+    return OFstatic_cast(OFLogger::LogLevel, dcmtk::log4cplus::spi::LoggerImpl::getThreadLogLevel());
+}
+
 void OFLog::configureFromCommandLine(OFCommandLine &cmd,
                                      OFConsoleApplication &app,
                                      OFLogger::LogLevel defaultLevel)
@@ -26,6 +26,7 @@
 
 
 #include "dcmtk/ofstd/ofdefine.h"
+#include "dcmtk/ofstd/oftypes.h"
 
 
 /** general-purpose 32-bit CRC algorithm.
@@ -78,4 +79,54 @@ private:
   unsigned int value;
 };
 
+
+/** 32-bit CRC with the Castagnoli polynomial (CRC-32C, as used by iSCSI and ext4).
+ *  Computed with the CRC32 instructions of SSE 4.2 or ARMv8 where the CPU has
+ *  them and with slicing-by-8 tables otherwise, so large blocks are hashed at
+ *  memory speed. Unlike OFCRC32 the value is pre- and post-conditioned, so the
+ *  result matches other CRC-32C implementations.
+ */
+class DCMTK_OFSTD_EXPORT OFCRC32C
+{
+public:
+
+  /// constructor
+  OFCRC32C()
+  : value(0)
+  {
+  }
+
+  /// reset object to initial state (CRC of an empty block)
+  void reset()
+  {
+    value=0;
+  }
+
+  /** add block of raw data to CRC
+   *  @param ptr pointer to raw data
+   *  @param size length of raw data block in bytes
+   */
+  void addBlock(const void *ptr, unsigned long size);
+
+  /// returns the CRC of the blocks added so far as unsigned int
+  unsigned int getCRC32() const
+  {
+    return value;
+  }
+
+  /** compute CRC for given block of data using a temporary CRC object
+   *  @param ptr pointer to raw data
+   *  @param size length of raw data block in bytes
+   *  @return CRC-32C as unsigned int
+   */
+  static unsigned int compute(const void *ptr, unsigned long size);
+
+  /// returns true if addBlock() uses CRC32 instructions of the CPU
+  static OFBool hardwareAccelerated();
+
+private:
+  /// current CRC
+  unsigned int value;
+};
+
 #endif
@@ -0,0 +1,190 @@
+/*
+ *
+ *  Copyright (C) 2024, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  ofstd
+ *
+ *  Purpose: Scoped trace spans recorded into per-thread buffers (Header)
+ *
+ */
+
+
+#ifndef OFTRACE_H
+#define OFTRACE_H
+
+#include "dcmtk/config/osconfig.h"
+
+#include "dcmtk/ofstd/ofdefine.h"
+#include "dcmtk/ofstd/oftypes.h"
+#include "dcmtk/ofstd/ofvector.h"
+
+#include <atomic>
+
+
+/** a finished span as recorded by OFTraceSpan
+ */
+struct DCMTK_OFSTD_EXPORT OFTraceEvent
+{
+  /// name of the span, a string literal
+  const char *name;
+
+  /// start in nanoseconds since the epoch
+  Uint64 start;
+
+  /// duration in nanoseconds
+  Uint64 duration;
+
+  /// number of the recording thread, 1 for the first thread that recorded a span
+  Uint32 thread;
+
+  /// association served by the thread (see OFTraceContext), 0 if none
+  Uint64 association;
+
+  /// SOP Instance UID processed by the thread (see OFTraceContext), empty if none
+  char instance[65];
+};
+
+
+/** process wide switch and buffers of the trace spans. Each thread records
+ *  into a ring buffer of its own, so recording a span takes an uncontended
+ *  lock only; with tracing disabled a span costs a relaxed atomic load.
+ *  Once a buffer is full, the oldest spans of that thread are dropped.
+ */
+class DCMTK_OFSTD_EXPORT OFTrace
+{
+public:
+
+  /** enables tracing with a ring buffer of the given number of spans per
+   *  thread, 0 disables tracing. Spans recorded so far are kept until
+   *  drained.
+   *  @param eventsPerThread capacity of each thread's buffer
+   */
+  static void enable(size_t eventsPerThread);
+
+  /** checks whether spans are recorded
+   *  @return OFTrue if tracing is enabled
+   */
+  static OFBool enabled()
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /** returns the current time as used for spans
+   *  @return nanoseconds since the epoch
+   */
+  static Uint64 now();
+
+  /** returns a new association number for OFTraceContext, unique in the process
+   *  @return association number, never 0
+   */
+  static Uint64 nextAssociation();
+
+  /** records a span of the current thread with the thread's context
+   *  @param name name of the span, must be a string literal
+   *  @param start start as returned by now()
+   *  @param end end as returned by now()
+   */
+  static void record(const char *name, Uint64 start, Uint64 end);
+
+  /** moves the recorded spans of all threads out of their buffers, the
+   *  spans of each thread in the order they ended
+   *  @param events receives the spans, existing entries are kept
+   *  @return number of spans dropped since the last call because a buffer was full
+   */
+  static size_t drain(OFVector<OFTraceEvent>& events);
+
+private:
+
+  /// OFTrue if spans are recorded
+  static std::atomic<bool> enabled_;
+};
+
+
+/** scope in which all spans recorded by the current thread are attributed to
+ *  an association and/or a SOP instance. Scopes may be nested, the innermost
+ *  value of each attribute is used. A scope must be destroyed by the thread
+ *  that created it.
+ */
+class DCMTK_OFSTD_EXPORT OFTraceContext
+{
+public:
+
+  /** constructor, sets the context of this thread
+   *  @param association association number from OFTrace::nextAssociation(),
+   *    0 keeps the current one
+   *  @param instance SOP Instance UID, NULL keeps the current one. Must stay
+   *    valid for the lifetime of the scope.
+   */
+  OFTraceContext(Uint64 association, const char *instance = NULL);
+
+  /// destructor, restores the previous context of this thread
+  ~OFTraceContext();
+
+  /** returns the association of the current thread
+   *  @return association number, 0 if none
+   */
+  static Uint64 association();
+
+private:
+
+  /// private undefined copy constructor
+  OFTraceContext(const OFTraceContext&);
+
+  /// private undefined copy assignment operator
+  OFTraceContext& operator=(const OFTraceContext&);
+
+  /// association of the enclosing scope
+  Uint64 previousAssociation_;
+
+  /// SOP instance of the enclosing scope
+  const char *previousInstance_;
+};
+
+
+/** records the time from construction to destruction as a span of the
+ *  current thread if tracing is enabled at construction
+ */
+class OFTraceSpan
+{
+public:
+
+  /** constructor, starts the span
+   *  @param name name of the span, must be a string literal
+   */
+  explicit OFTraceSpan(const char *name)
+  : name_(OFTrace::enabled() ? name : NULL)
+  , start_(name_ ? OFTrace::now() : 0)
+  {
+  }
+
+  /// destructor, records the span
+  ~OFTraceSpan()
+  {
+    if (name_) OFTrace::record(name_, start_, OFTrace::now());
+  }
+
+private:
+
+  /// private undefined copy constructor
+  OFTraceSpan(const OFTraceSpan&);
+
+  /// private undefined copy assignment operator
+  OFTraceSpan& operator=(const OFTraceSpan&);
+
+  /// name of the span, NULL if tracing was disabled
+  const char *name_;
+
+  /// start of the span
+  Uint64 start_;
+};
+
+#endif
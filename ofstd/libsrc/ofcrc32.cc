@@ -26,6 +26,18 @@
 #include "dcmtk/ofstd/ofcrc32.h"
 #include "dcmtk/ofstd/ofcast.h"
 
+#include <cstring>
+
+// the CRC32 instructions of SSE 4.2 are checked for at run time, those of
+// ARMv8 are used when the compiler targets a CPU that has them
+#if defined(__GNUC__) && defined(__x86_64__)
+#define OFCRC32C_SSE42
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define OFCRC32C_ARMV8
+#include <arm_acle.h>
+#endif
+
 void OFCRC32::addBlock(const void *ptr, unsigned long size)
 {
   const unsigned char *p= OFstatic_cast(const unsigned char *, ptr);
@@ -97,3 +109,112 @@ const unsigned int OFCRC32::crctab[256] =
   0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
   0x2d02ef8dL
 };
+
+
+namespace
+{
+
+// slicing-by-8 tables of the reflected Castagnoli polynomial, built on first use
+struct OFCRC32CTables
+{
+  OFCRC32CTables()
+  {
+    for (unsigned int i = 0; i < 256; i++)
+    {
+      unsigned int crc = i;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc & 1) ? (crc >> 1) ^ 0x82f63b78U : crc >> 1;
+      table[0][i] = crc;
+    }
+    for (unsigned int i = 0; i < 256; i++)
+      for (int t = 1; t < 8; t++)
+        table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xff];
+  }
+
+  unsigned int table[8][256];
+};
+
+unsigned int crc32cSoftware(unsigned int crc, const unsigned char *p, unsigned long size)
+{
+  static const OFCRC32CTables tables;
+  const unsigned int (*t)[256] = tables.table;
+  for (; size >= 8; p += 8, size -= 8)
+  {
+    // the tables are indexed little endian first, whatever the host order
+    const unsigned int lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (OFstatic_cast(unsigned int, p[3]) << 24));
+    const unsigned int hi = p[4] | (p[5] << 8) | (p[6] << 16) | (OFstatic_cast(unsigned int, p[7]) << 24);
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+  }
+  for (; size > 0; p++, size--)
+    crc = t[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(OFCRC32C_SSE42)
+__attribute__((target("sse4.2")))
+unsigned int crc32cSSE42(unsigned int crc, const unsigned char *p, unsigned long size)
+{
+  unsigned long long crc64 = crc;
+  for (; size >= 8; p += 8, size -= 8)
+  {
+    unsigned long long word;
+    memcpy(&word, p, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = OFstatic_cast(unsigned int, crc64);
+  for (; size > 0; p++, size--)
+    crc = _mm_crc32_u8(crc, *p);
+  return crc;
+}
+#elif defined(OFCRC32C_ARMV8)
+unsigned int crc32cARMv8(unsigned int crc, const unsigned char *p, unsigned long size)
+{
+  for (; size >= 8; p += 8, size -= 8)
+  {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    crc = __crc32cd(crc, word);
+  }
+  for (; size > 0; p++, size--)
+    crc = __crc32cb(crc, *p);
+  return crc;
+}
+#endif
+
+}
+
+
+void OFCRC32C::addBlock(const void *ptr, unsigned long size)
+{
+  const unsigned char *p = OFstatic_cast(const unsigned char *, ptr);
+  const unsigned int crc = ~value;
+#if defined(OFCRC32C_SSE42)
+  value = ~(hardwareAccelerated() ? crc32cSSE42(crc, p, size) : crc32cSoftware(crc, p, size));
+#elif defined(OFCRC32C_ARMV8)
+  value = ~crc32cARMv8(crc, p, size);
+#else
+  value = ~crc32cSoftware(crc, p, size);
+#endif
+}
+
+
+unsigned int OFCRC32C::compute(const void *ptr, unsigned long size)
+{
+  OFCRC32C crc;
+  crc.addBlock(ptr, size);
+  return crc.getCRC32();
+}
+
+
+OFBool OFCRC32C::hardwareAccelerated()
+{
+#if defined(OFCRC32C_SSE42)
+  static const OFBool sse42 = __builtin_cpu_supports("sse4.2") ? OFTrue : OFFalse;
+  return sse42;
+#elif defined(OFCRC32C_ARMV8)
+  return OFTrue;
+#else
+  return OFFalse;
+#endif
+}
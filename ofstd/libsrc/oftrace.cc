@@ -0,0 +1,183 @@
+/*
+ *
+ *  Copyright (C) 2024, OFFIS e.V.
+ *  All rights reserved.  See COPYRIGHT file for details.
+ *
+ *  This software and supporting documentation were developed by
+ *
+ *    OFFIS e.V.
+ *    R&D Division Health
+ *    Escherweg 2
+ *    D-26121 Oldenburg, Germany
+ *
+ *
+ *  Module:  ofstd
+ *
+ *  Purpose: Scoped trace spans recorded into per-thread buffers (Source)
+ *
+ */
+
+
+#include "dcmtk/config/osconfig.h"
+
+#include "dcmtk/ofstd/oftrace.h"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+/* ring buffer of the spans of one thread */
+struct OFTraceBuffer
+{
+  OFTraceBuffer(Uint32 id) : next(0), dropped(0), thread(id), finished(OFFalse) {}
+
+  std::mutex mutex;
+  std::vector<OFTraceEvent> events;
+  /* position of the oldest span once the buffer is full */
+  size_t next;
+  size_t dropped;
+  Uint32 thread;
+  /* the thread has ended, the buffer is removed once drained */
+  OFBool finished;
+};
+
+/* registers the buffer of a thread on first use and marks it finished once the thread ends */
+struct OFTraceThreadBuffer
+{
+  ~OFTraceThreadBuffer()
+  {
+    if (buffer)
+    {
+      std::lock_guard<std::mutex> lock(buffer->mutex);
+      buffer->finished = OFTrue;
+    }
+  }
+
+  std::shared_ptr<OFTraceBuffer> buffer;
+};
+
+std::atomic<bool> OFTrace::enabled_(false);
+
+static std::mutex traceMutex;
+static std::vector<std::shared_ptr<OFTraceBuffer> > traceBuffers;
+static std::atomic<size_t> traceCapacity(0);
+static std::atomic<Uint32> traceThreads(0);
+static std::atomic<Uint64> traceAssociations(0);
+
+/* context and buffer of each thread */
+static thread_local Uint64 currentAssociation = 0;
+static thread_local const char *currentInstance = NULL;
+static thread_local OFTraceThreadBuffer currentBuffer;
+
+
+void OFTrace::enable(size_t eventsPerThread)
+{
+  traceCapacity = eventsPerThread;
+  enabled_ = eventsPerThread > 0;
+}
+
+
+Uint64 OFTrace::now()
+{
+  return OFstatic_cast(Uint64, std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+
+Uint64 OFTrace::nextAssociation()
+{
+  return ++traceAssociations;
+}
+
+
+void OFTrace::record(const char *name, Uint64 start, Uint64 end)
+{
+  const size_t capacity = traceCapacity.load();
+  if (capacity == 0) return;
+  if (!currentBuffer.buffer)
+  {
+    currentBuffer.buffer = std::make_shared<OFTraceBuffer>(++traceThreads);
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceBuffers.push_back(currentBuffer.buffer);
+  }
+
+  OFTraceEvent event;
+  event.name = name;
+  event.start = start;
+  event.duration = end > start ? end - start : 0;
+  event.thread = currentBuffer.buffer->thread;
+  event.association = currentAssociation;
+  event.instance[0] = '\0';
+  if (currentInstance)
+  {
+    strncpy(event.instance, currentInstance, sizeof(event.instance) - 1);
+    event.instance[sizeof(event.instance) - 1] = '\0';
+  }
+
+  OFTraceBuffer& buffer = *currentBuffer.buffer;
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.events.size() < capacity)
+  {
+    buffer.events.push_back(event);
+  }
+  else
+  {
+    /* overwrite the oldest span */
+    if (buffer.next >= buffer.events.size()) buffer.next = 0;
+    buffer.events[buffer.next++] = event;
+    ++buffer.dropped;
+  }
+}
+
+
+size_t OFTrace::drain(OFVector<OFTraceEvent>& events)
+{
+  size_t dropped = 0;
+  std::lock_guard<std::mutex> lock(traceMutex);
+  std::vector<std::shared_ptr<OFTraceBuffer> >::iterator it = traceBuffers.begin();
+  while (it != traceBuffers.end())
+  {
+    OFTraceBuffer& buffer = **it;
+    std::unique_lock<std::mutex> bufferLock(buffer.mutex);
+    const size_t count = buffer.events.size();
+    const size_t oldest = buffer.next < count ? buffer.next : 0;
+    for (size_t i = 0; i < count; ++i)
+      events.push_back(buffer.events[(oldest + i) % count]);
+    dropped += buffer.dropped;
+    buffer.events.clear();
+    buffer.next = 0;
+    buffer.dropped = 0;
+    const OFBool finished = buffer.finished;
+    bufferLock.unlock();
+    if (finished)
+      it = traceBuffers.erase(it);
+    else
+      ++it;
+  }
+  return dropped;
+}
+
+
+OFTraceContext::OFTraceContext(Uint64 association, const char *instance)
+: previousAssociation_(currentAssociation)
+, previousInstance_(currentInstance)
+{
+  if (association) currentAssociation = association;
+  if (instance) currentInstance = instance;
+}
+
+
+OFTraceContext::~OFTraceContext()
+{
+  currentAssociation = previousAssociation_;
+  currentInstance = previousInstance_;
+}
+
+
+Uint64 OFTraceContext::association()
+{
+  return currentAssociation;
+}
@@ -5,116 +5,685 @@
 #include "GetAsyncWorker.h"
 #include "MoveAsyncWorker.h"
 #include "StoreAsyncWorker.h"
+#include "LoadTestAsyncWorker.h"
+#include "GenerateAsyncWorker.h"
+#include "ReindexAsyncWorker.h"
+#include "ImportJsonAsyncWorker.h"
+#include "PyramidAsyncWorker.h"
+#include "MultiframeAsyncWorker.h"
+#include "TierAsyncWorker.h"
+#include "MaintainAsyncWorker.h"
+#include "PrefetchAsyncWorker.h"
 #include "ServerAsyncWorker.h"
 #include "ParseAsyncWorker.h"
+#include "ParseDirectoryAsyncWorker.h"
+#include "DecodeFrameAsyncWorker.h"
+#include "RenderFrameAsyncWorker.h"
+#include "GetFrameAsyncWorker.h"
+#include "BulkDataRangeAsyncWorker.h"
+#include "IndexAsyncWorker.h"
 #include "CompressAsyncWorker.h"
+#include "AnonymizeAsyncWorker.h"
+#include "VerifyAsyncWorker.h"
 #include "ShutdownAsyncWorker.h"
+#include "AssociationPool.h"
+#include "DimseExecutor.h"
+#include "CpuPlacement.h"
+#include "FindCache.h"
+#include "ParseCache.h"
+#include "HostCache.h"
+#include "Worklist.h"
+#include "Metrics.h"
+#include "TraceExport.h"
+#include "Logging.h"
 
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftrace.h"
+#include "dcmtk/oflog/oflog.h"
+
+#include <algorithm>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 using namespace Napi;
 
+// options are read natively when passed as object, JSON text is still accepted.
+// Sets the cancel function of the request in result, an optional high-water mark
+// enables backpressure and adds the acknowledge function.
+template <class T>
+T* CreateWorker(const CallbackInfo& info, Function& cb, Object& result) {
+    const Value& options = info[0];
+    T* worker = NULL;
+    if (options.IsObject()) {
+        worker = new T(std::string(), cb);
+        worker->SetInput(BaseAsyncWorker::ParseInput(options.As<Object>()));
+    }
+    else {
+        worker = new T(options.As<String>().Utf8Value(), cb);
+    }
+    if (info.Length() > 2 && info[2].IsNumber()) {
+        result.Set("acknowledge", worker->EnableFlowControl(info.Env(), info[2].As<Number>().Uint32Value()));
+    }
+    result.Set("cancel", worker->CancelFunction(info.Env()));
+    return worker;
+}
+
+// returns the object with the functions of CreateWorker(), the worker runs on the executor
+// lane of its operation
+template <class T>
+Value QueueWorker(const CallbackInfo& info, Function& cb, const char* operation) {
+    Object result = Object::New(info.Env());
+    CreateWorker<T>(info, cb, result)->Queue(operation);
+    return result;
+}
+
 Value DoEcho(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new EchoAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    return QueueWorker<EchoAsyncWorker>(info, cb, "echo");
+}
+
+Value DoEchoMany(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<EchoManyAsyncWorker>(info, cb, "echo");
 }
 
 Value DoFind(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new FindAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    return QueueWorker<FindAsyncWorker>(info, cb, "find");
+}
+
+Value DoFindBatch(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<FindBatchAsyncWorker>(info, cb, "find");
+}
+
+Value DoFindFederated(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<FindFederatedAsyncWorker>(info, cb, "find");
 }
 
 Value DoGet(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new GetAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    return QueueWorker<GetAsyncWorker>(info, cb, "get");
 }
 
 Value DoMove(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new MoveAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    return QueueWorker<MoveAsyncWorker>(info, cb, "move");
 }
 
 Value DoStore(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new StoreAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    return QueueWorker<StoreAsyncWorker>(info, cb, "store");
 }
 
 Value DoParse(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new ParseAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    return QueueWorker<ParseAsyncWorker>(info, cb, "parse");
+}
+
+Value DoParseDirectory(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<ParseDirectoryAsyncWorker>(info, cb, "parse");
+}
+
+Value DoDecodeFrame(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<DecodeFrameAsyncWorker>(info, cb, "parse");
+}
+
+Value DoGetFrame(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<GetFrameAsyncWorker>(info, cb, "parse");
+}
+
+Value DoGetBulkDataRange(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<BulkDataRangeAsyncWorker>(info, cb, "parse");
+}
+
+Value DoRenderFrame(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<RenderFrameAsyncWorker>(info, cb, "render");
 }
 
 Value DoCompress(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new CompressAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    return QueueWorker<CompressAsyncWorker>(info, cb, "recompress");
+}
+
+Value DoAnonymize(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<AnonymizeAsyncWorker>(info, cb, "anonymize");
+}
+
+Value DoVerify(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<VerifyAsyncWorker>(info, cb, "verify");
+}
+
+Value DoLoadTest(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<LoadTestAsyncWorker>(info, cb, "loadtest");
+}
+
+Value DoGenerate(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<GenerateAsyncWorker>(info, cb, "generate");
 }
 
+Value DoReindex(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<ReindexAsyncWorker>(info, cb, "reindex");
+}
+
+Value DoImportJson(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<ImportJsonAsyncWorker>(info, cb, "reindex");
+}
+
+Value DoBuildPyramid(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<PyramidAsyncWorker>(info, cb, "recompress");
+}
+
+Value DoConvertMultiframe(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<MultiframeAsyncWorker>(info, cb, "recompress");
+}
+
+Value DoTier(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<TierAsyncWorker>(info, cb, "tier");
+}
+
+Value DoQueryIndex(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<QueryIndexAsyncWorker>(info, cb, "index");
+}
+
+Value DoRetrieveMetadata(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<RetrieveMetadataAsyncWorker>(info, cb, "index");
+}
+
+Value DoRetrievePixelStats(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<RetrievePixelStatsAsyncWorker>(info, cb, "index");
+}
+
+Value DoRetrieveFrames(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<RetrieveFramesAsyncWorker>(info, cb, "index");
+}
+
+Value DoExportStudy(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<ExportStudyAsyncWorker>(info, cb, "index");
+}
+
+Value DoCreateDicomdir(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<CreateDicomdirAsyncWorker>(info, cb, "media");
+}
+
+Value DoWatchIndex(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<WatchIndexAsyncWorker>(info, cb, "watch");
+}
+
+Value DoMaintainIndex(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<MaintainAsyncWorker>(info, cb, "reindex");
+}
+
+Value DoPrefetch(const CallbackInfo& info) {
+    Function cb = info[1].As<Function>();
+
+    return QueueWorker<PrefetchAsyncWorker>(info, cb, "prefetch");
+}
+
+// the result has stop and setPeers functions as well
 Value StartScp(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new ServerAsyncWorker(input, cb);
-    worker->Queue();
-    return info.Env().Undefined();
+    Object result = Object::New(info.Env());
+    ServerAsyncWorker* worker = CreateWorker<ServerAsyncWorker>(info, cb, result);
+    result.Set("stop", worker->StopFunction(info.Env()));
+    result.Set("setPeers", worker->PeersFunction(info.Env()));
+    worker->Queue("scp");
+    return result;
 }
 
 Value DoShutdown(const CallbackInfo& info) {
-    std::string input = info[0].As<String>().Utf8Value();
     Function cb = info[1].As<Function>();
 
-    auto worker = new ShutdownAsyncWorker(input, cb);
-    worker->Queue();
+    return QueueWorker<ShutdownAsyncWorker>(info, cb, "shutdown");
+}
+
+// releases idle pooled associations to the target of the options, all of them without target
+Value CloseAssociations(const CallbackInfo& info) {
+    ns::sIdent target;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        target = BaseAsyncWorker::ParseInput(info[0].As<Object>()).target;
+    }
+    // releasing waits for the peers, keep that off the main thread
+    std::thread([target]() { AssociationPool::close(target); }).detach();
     return info.Env().Undefined();
 }
 
+// negotiates associations to the target of the options and parks them in the pool ahead of demand,
+// the optional callback gets the number negotiated and the error that stopped it, if any
+Value PrewarmAssociations(const CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        TypeError::New(env, "options expected").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    ns::sInput in = BaseAsyncWorker::ParseInput(info[0].As<Object>());
+    size_t count = info.Length() > 1 && info[1].IsNumber() ? info[1].As<Number>().Uint32Value() : 1;
+    std::shared_ptr<ThreadSafeFunction> done;
+    if (info.Length() > 2 && info[2].IsFunction()) {
+        done.reset(new ThreadSafeFunction(ThreadSafeFunction::New(env, info[2].As<Function>(), "dcmtk prewarm", 0, 1)),
+            [](ThreadSafeFunction* function) { function->Release(); delete function; });
+    }
+    AssociationPool::configure(in.associationIdleTimeout);
+    // negotiating waits for the peer, keep that off the main thread
+    std::thread([in, count, done]() {
+        OFCondition cond;
+        size_t negotiated = AssociationPool::prewarm(in.source, in.target, in.network, count, cond);
+        if (done) {
+            std::string error = cond.bad() ? cond.text() : "";
+            done->BlockingCall([negotiated, error](Napi::Env env, Function callback) {
+                callback.Call({Number::New(env, static_cast<double>(negotiated)), error.empty() ? env.Null() : String::New(env, error)});
+            });
+        }
+    }).detach();
+    return env.Undefined();
+}
+
+// seconds the addresses of peers are cached, 0 looks up every association again
+Value SetHostCache(const CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        TypeError::New(info.Env(), "ttl expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    HostCache::configure(info[0].As<Number>().Int32Value());
+    HostCache::clear();
+    return info.Env().Undefined();
+}
+
+// limits the number of concurrently running requests of an operation, zero for no limit
+Value SetConcurrency(const CallbackInfo& info) {
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsNumber()) {
+        TypeError::New(info.Env(), "operation and limit expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    DimseExecutor::setConcurrency(info[0].As<String>().Utf8Value(), info[1].As<Number>().Uint32Value());
+    return info.Env().Undefined();
+}
+
+// sends files already in the negotiated transfer syntax as stored, for all requests and SCPs of the process
+Value SetZeroCopySend(const CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsBoolean()) {
+        TypeError::New(info.Env(), "enabled expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    ns::setZeroCopySend(info[0].As<Boolean>().Value());
+    return info.Env().Undefined();
+}
+
+// threads coding the frames of multi-frame images and the restart intervals of lossless JPEG frames,
+// for all requests and SCPs of the process
+Value SetFrameThreads(const CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        TypeError::New(info.Env(), "threads expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    const int64_t threads = info[0].As<Number>().Int64Value();
+    ns::setFrameThreads(static_cast<Uint16>(std::min<int64_t>(std::max<int64_t>(threads, 0), 1024)));
+    return info.Env().Undefined();
+}
+
+// zlib level 0..9 of data sets written or sent deflated, for all requests and SCPs of the process
+Value SetDeflateLevel(const CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        TypeError::New(info.Env(), "level expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    ns::setDeflateLevel(info[0].As<Number>().Int32Value());
+    return info.Env().Undefined();
+}
+
+// places the threads of an operation on the NUMA nodes: "none", "spread" or "node:<n>"
+Value SetPlacement(const CallbackInfo& info) {
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+        TypeError::New(info.Env(), "operation and policy expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    if (!CpuPlacement::setPolicy(info[0].As<String>().Utf8Value(), info[1].As<String>().Utf8Value())) {
+        Error::New(info.Env(), "unknown placement policy or node: " + info[1].As<String>().Utf8Value()).ThrowAsJavaScriptException();
+    }
+    return info.Env().Undefined();
+}
+
+// counters of the C-FIND result cache
+Value FindCacheStats(const CallbackInfo& info) {
+    Object stats = Object::New(info.Env());
+    stats.Set("hits", Number::New(info.Env(), static_cast<double>(FindCache::hits())));
+    stats.Set("joined", Number::New(info.Env(), static_cast<double>(FindCache::joined())));
+    stats.Set("misses", Number::New(info.Env(), static_cast<double>(FindCache::misses())));
+    stats.Set("entries", Number::New(info.Env(), static_cast<double>(FindCache::entries())));
+    return stats;
+}
+
+// drops the cached C-FIND results
+Value ClearFindCache(const CallbackInfo& info) {
+    FindCache::clear();
+    return info.Env().Undefined();
+}
+
+// limits the JSON of parsed files kept in the parse cache to size MB, 0 disables it
+Value SetParseCache(const CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        TypeError::New(info.Env(), "size expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    const double size = info[0].As<Number>().DoubleValue();
+    ParseCache::configure(size > 0 ? static_cast<size_t>(size * 1024 * 1024) : 0);
+    return info.Env().Undefined();
+}
+
+// counters of the parse cache
+Value ParseCacheStats(const CallbackInfo& info) {
+    Object stats = Object::New(info.Env());
+    stats.Set("hits", Number::New(info.Env(), static_cast<double>(ParseCache::hits())));
+    stats.Set("misses", Number::New(info.Env(), static_cast<double>(ParseCache::misses())));
+    stats.Set("entries", Number::New(info.Env(), static_cast<double>(ParseCache::entries())));
+    stats.Set("bytes", Number::New(info.Env(), static_cast<double>(ParseCache::bytes())));
+    return stats;
+}
+
+// drops the cached JSON of parsed files
+Value ClearParseCache(const CallbackInfo& info) {
+    ParseCache::clear();
+    return info.Env().Undefined();
+}
+
+// worklist items from an array of objects with the properties named by Worklist::fieldName()
+bool ToWorklistItems(const CallbackInfo& info, std::vector<Worklist::Item>& items) {
+    if (info.Length() < 1 || !info[0].IsArray()) {
+        TypeError::New(info.Env(), "array of worklist items expected").ThrowAsJavaScriptException();
+        return false;
+    }
+    Array list = info[0].As<Array>();
+    for (uint32_t i = 0; i < list.Length(); ++i) {
+        Value value = list.Get(i);
+        if (!value.IsObject()) {
+            TypeError::New(info.Env(), "worklist item is not an object").ThrowAsJavaScriptException();
+            return false;
+        }
+        Object object = value.As<Object>();
+        Worklist::Item item;
+        for (size_t f = 0; f < Worklist::FIELD_COUNT; ++f) {
+            Value field = object.Get(Worklist::fieldName(f));
+            if (field.IsString()) {
+                item[f] = field.As<String>().Utf8Value();
+            }
+        }
+        items.push_back(item);
+    }
+    return true;
+}
+
+// adds or replaces worklist items, the SCPs see them from their next query on
+Value UpsertWorklist(const CallbackInfo& info) {
+    std::vector<Worklist::Item> items;
+    if (!ToWorklistItems(info, items)) {
+        return info.Env().Undefined();
+    }
+    return Number::New(info.Env(), static_cast<double>(Worklist::upsert(items)));
+}
+
+Value RemoveWorklist(const CallbackInfo& info) {
+    std::vector<Worklist::Item> items;
+    if (!ToWorklistItems(info, items)) {
+        return info.Env().Undefined();
+    }
+    return Number::New(info.Env(), static_cast<double>(Worklist::remove(items)));
+}
+
+Value ClearWorklist(const CallbackInfo& info) {
+    Worklist::clear();
+    return info.Env().Undefined();
+}
+
+// counters, gauges and latency histograms of the native side as JSON text
+Value GetMetrics(const CallbackInfo& info) {
+    return String::New(info.Env(), Metrics::snapshot().dump());
+}
+
+// records trace spans into per-thread buffers of that many spans, zero disables tracing
+Value SetTracing(const CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsNumber()) {
+        TypeError::New(info.Env(), "number of spans per thread expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    OFTrace::enable(info[0].As<Number>().Uint32Value());
+    return info.Env().Undefined();
+}
+
+// the spans recorded since the last call as JSON text, in Chrome trace or OTLP format
+Value GetTrace(const CallbackInfo& info) {
+    std::string format = info.Length() > 0 && info[0].IsString() ? info[0].As<String>().Utf8Value() : "chrome";
+    if (format == "otlp") {
+        std::string service = info.Length() > 1 && info[1].IsString() ? info[1].As<String>().Utf8Value() : "dcmtk";
+        return String::New(info.Env(), TraceExport::otlp(service).dump());
+    }
+    if (format != "chrome") {
+        TypeError::New(info.Env(), "format chrome or otlp expected").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    return String::New(info.Env(), TraceExport::chrome().dump());
+}
+
+// writes DCMTK's log records to stderr through a queue of options.queueSize records, or hands them in
+// batches of options.batchSize records at least every options.flushInterval ms to the sink function
+Value SetLogging(const CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Object options = info.Length() > 0 && info[0].IsObject() ? info[0].As<Object>() : Object::New(env);
+    auto number = [&options](const char* key, uint32_t fallback) {
+        Value value = options.Get(key);
+        return value.IsNumber() ? value.As<Number>().Uint32Value() : fallback;
+    };
+
+    Logging::Sink sink;
+    if (info.Length() > 1 && info[1].IsFunction()) {
+        // released with the sink once it is replaced, doesn't keep the process alive
+        std::shared_ptr<ThreadSafeFunction> deliver(new ThreadSafeFunction(ThreadSafeFunction::New(env, info[1].As<Function>(), "dcmtk log", 0, 1)),
+            [](ThreadSafeFunction* function) { function->Release(); delete function; });
+        deliver->Unref(env);
+        sink = [deliver](std::vector<Logging::sRecord>& records) {
+            std::shared_ptr<std::vector<Logging::sRecord>> batch = std::make_shared<std::vector<Logging::sRecord>>();
+            batch->swap(records);
+            deliver->NonBlockingCall([batch](Napi::Env env, Function callback) {
+                Array array = Array::New(env, batch->size());
+                for (size_t i = 0; i < batch->size(); ++i) {
+                    const Logging::sRecord& record = (*batch)[i];
+                    Object entry = Object::New(env);
+                    entry.Set("time", Number::New(env, record.time));
+                    entry.Set("level", String::New(env, record.level));
+                    entry.Set("logger", String::New(env, record.logger));
+                    entry.Set("message", String::New(env, record.message));
+                    entry.Set("thread", String::New(env, record.thread));
+                    array.Set(static_cast<uint32_t>(i), entry);
+                }
+                callback.Call({array});
+            });
+        };
+    }
+    Logging::configure(number("queueSize", 0), sink, number("batchSize", 100), static_cast<int>(number("flushInterval", 100)));
+    return env.Undefined();
+}
 
 Object Init(Env env, Object exports) {
+    // Init runs for the main thread and each worker_thread loading the addon, the process wide
+    // settings are made once so a new worker_thread does not reset those changed since
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        // warnings and errors, verbose requests log debug output on their own threads
+        OFLog::configure(OFLogger::WARN_LOG_LEVEL);
+        // codecs are registered once for all workers before any of them is constructed
+        ns::registerCodecs();
+        // host names of peers are resolved once a minute instead of on every association
+        HostCache::configure(HostCache::defaultTtl);
+    });
+    // the requests of this environment are stopped when it is torn down
+    RequestRegistry::of(env);
+
     exports.Set(String::New(env, "echoScu"),
                 Function::New(env, DoEcho));
+    exports.Set(String::New(env, "echoMany"),
+                Function::New(env, DoEchoMany));
     exports.Set(String::New(env, "findScu"),
                 Function::New(env, DoFind));
+    exports.Set(String::New(env, "findScuBatch"),
+                Function::New(env, DoFindBatch));
+    exports.Set(String::New(env, "findScuFederated"),
+                Function::New(env, DoFindFederated));
     exports.Set(String::New(env, "getScu"),
                 Function::New(env, DoGet));
     exports.Set(String::New(env, "moveScu"),
                 Function::New(env, DoMove));
     exports.Set(String::New(env, "storeScu"),
                 Function::New(env, DoStore));
+    exports.Set(String::New(env, "loadTest"),
+                Function::New(env, DoLoadTest));
+    exports.Set(String::New(env, "generateDatasets"),
+                Function::New(env, DoGenerate));
+    exports.Set(String::New(env, "reindex"),
+                Function::New(env, DoReindex));
+    exports.Set(String::New(env, "importJson"),
+                Function::New(env, DoImportJson));
+    exports.Set(String::New(env, "buildPyramid"),
+                Function::New(env, DoBuildPyramid));
+    exports.Set(String::New(env, "convertMultiframe"),
+                Function::New(env, DoConvertMultiframe));
+    exports.Set(String::New(env, "tier"),
+                Function::New(env, DoTier));
+    exports.Set(String::New(env, "queryIndex"),
+                Function::New(env, DoQueryIndex));
+    exports.Set(String::New(env, "retrieveMetadata"),
+                Function::New(env, DoRetrieveMetadata));
+    exports.Set(String::New(env, "retrievePixelStats"),
+                Function::New(env, DoRetrievePixelStats));
+    exports.Set(String::New(env, "retrieveFrames"),
+                Function::New(env, DoRetrieveFrames));
+    exports.Set(String::New(env, "exportStudy"),
+                Function::New(env, DoExportStudy));
+    exports.Set(String::New(env, "createDicomdir"),
+                Function::New(env, DoCreateDicomdir));
+    exports.Set(String::New(env, "watchIndex"),
+                Function::New(env, DoWatchIndex));
+    exports.Set(String::New(env, "maintainIndex"),
+                Function::New(env, DoMaintainIndex));
+    exports.Set(String::New(env, "prefetch"),
+                Function::New(env, DoPrefetch));
     exports.Set(String::New(env, "startScp"),
                 Function::New(env, StartScp));
     exports.Set(String::New(env, "shutdownScu"),
                 Function::New(env, DoShutdown));
     exports.Set(String::New(env, "parseFile"),
                 Function::New(env, DoParse));
+    exports.Set(String::New(env, "parseDirectory"),
+                Function::New(env, DoParseDirectory));
+    exports.Set(String::New(env, "decodeFrame"),
+                Function::New(env, DoDecodeFrame));
+    exports.Set(String::New(env, "getFrame"),
+                Function::New(env, DoGetFrame));
+    exports.Set(String::New(env, "getBulkDataRange"),
+                Function::New(env, DoGetBulkDataRange));
+    exports.Set(String::New(env, "renderFrame"),
+                Function::New(env, DoRenderFrame));
     exports.Set(String::New(env, "recompress"),
                 Function::New(env, DoCompress));
+    exports.Set(String::New(env, "anonymize"),
+                Function::New(env, DoAnonymize));
+    exports.Set(String::New(env, "verify"),
+                Function::New(env, DoVerify));
+    exports.Set(String::New(env, "closeAssociations"),
+                Function::New(env, CloseAssociations));
+    exports.Set(String::New(env, "prewarmAssociations"),
+                Function::New(env, PrewarmAssociations));
+    exports.Set(String::New(env, "setHostCache"),
+                Function::New(env, SetHostCache));
+    exports.Set(String::New(env, "setConcurrency"),
+                Function::New(env, SetConcurrency));
+    exports.Set(String::New(env, "setPlacement"),
+                Function::New(env, SetPlacement));
+    exports.Set(String::New(env, "setZeroCopySend"),
+                Function::New(env, SetZeroCopySend));
+    exports.Set(String::New(env, "setFrameThreads"),
+                Function::New(env, SetFrameThreads));
+    exports.Set(String::New(env, "setDeflateLevel"),
+                Function::New(env, SetDeflateLevel));
+    exports.Set(String::New(env, "findCacheStats"),
+                Function::New(env, FindCacheStats));
+    exports.Set(String::New(env, "clearFindCache"),
+                Function::New(env, ClearFindCache));
+    exports.Set(String::New(env, "setParseCache"),
+                Function::New(env, SetParseCache));
+    exports.Set(String::New(env, "parseCacheStats"),
+                Function::New(env, ParseCacheStats));
+    exports.Set(String::New(env, "clearParseCache"),
+                Function::New(env, ClearParseCache));
+    exports.Set(String::New(env, "upsertWorklist"),
+                Function::New(env, UpsertWorklist));
+    exports.Set(String::New(env, "removeWorklist"),
+                Function::New(env, RemoveWorklist));
+    exports.Set(String::New(env, "clearWorklist"),
+                Function::New(env, ClearWorklist));
+    exports.Set(String::New(env, "getMetrics"),
+                Function::New(env, GetMetrics));
+    exports.Set(String::New(env, "setTracing"),
+                Function::New(env, SetTracing));
+    exports.Set(String::New(env, "getTrace"),
+                Function::New(env, GetTrace));
+    exports.Set(String::New(env, "setLogging"),
+                Function::New(env, SetLogging));
     return exports;
 }
 
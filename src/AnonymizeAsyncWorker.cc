@@ -0,0 +1,495 @@
+#include "AnonymizeAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdatutl.h"
+#include "dcmtk/dcmdata/dcsequen.h"
+#include "dcmtk/dcmdata/dcuid.h"
+
+namespace
+{
+
+enum eAction { REMOVE, EMPTY, REPLACE, REMAP_UID };
+
+struct sRule {
+    eAction action;
+    std::string value;
+};
+
+// the rules by tag (group << 16 | element), looked up once for each attribute of a dataset
+struct sProfile {
+    sProfile() : removePrivate(false) {}
+    std::unordered_map<Uint32, sRule> rules;
+    bool removePrivate;
+};
+
+// used without rules, a subset of the Basic Application Level Confidentiality Profile of PS3.15:
+// identifying attributes are emptied or removed and the UIDs of the instances and their
+// references remapped. Private attributes are removed as well
+const char* const defaultProfile[][2] = {
+    { "00100010", "empty" },    // PatientName
+    { "00100020", "empty" },    // PatientID
+    { "00100030", "empty" },    // PatientBirthDate
+    { "00100040", "empty" },    // PatientSex
+    { "00080020", "empty" },    // StudyDate
+    { "00080030", "empty" },    // StudyTime
+    { "00080050", "empty" },    // AccessionNumber
+    { "00080090", "empty" },    // ReferringPhysicianName
+    { "00200010", "empty" },    // StudyID
+    { "00100032", "remove" },   // PatientBirthTime
+    { "00101000", "remove" },   // OtherPatientIDs
+    { "00101001", "remove" },   // OtherPatientNames
+    { "00101040", "remove" },   // PatientAddress
+    { "00102154", "remove" },   // PatientTelephoneNumbers
+    { "00102160", "remove" },   // EthnicGroup
+    { "001021b0", "remove" },   // AdditionalPatientHistory
+    { "00104000", "remove" },   // PatientComments
+    { "00080080", "remove" },   // InstitutionName
+    { "00080081", "remove" },   // InstitutionAddress
+    { "00081010", "remove" },   // StationName
+    { "00081040", "remove" },   // InstitutionalDepartmentName
+    { "00081048", "remove" },   // PhysiciansOfRecord
+    { "00081050", "remove" },   // PerformingPhysicianName
+    { "00081060", "remove" },   // NameOfPhysiciansReadingStudy
+    { "00081070", "remove" },   // OperatorsName
+    { "00181000", "remove" },   // DeviceSerialNumber
+    { "00321032", "remove" },   // RequestingPhysician
+    { "00080018", "remapUID" }, // SOPInstanceUID
+    { "0020000d", "remapUID" }, // StudyInstanceUID
+    { "0020000e", "remapUID" }, // SeriesInstanceUID
+    { "00200052", "remapUID" }, // FrameOfReferenceUID
+    { "00200200", "remapUID" }, // SynchronizationFrameOfReferenceUID
+    { "00081155", "remapUID" }, // ReferencedSOPInstanceUID
+    { "00083010", "remapUID" }, // IrradiationEventUID
+    { "00880140", "remapUID" }, // StorageMediaFileSetUID
+    { "30060024", "remapUID" }  // ReferencedFrameOfReferenceUID
+};
+
+// adds a rule to the profile, false if the tag or the action is not valid
+bool compileRule(sProfile& profile, const std::string& tag, const std::string& action, const std::string& value)
+{
+    if (tag.size() != 8 || tag.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        return false;
+    }
+    sRule rule;
+    if (action == "remove") rule.action = REMOVE;
+    else if (action == "empty") rule.action = EMPTY;
+    else if (action == "replace") rule.action = REPLACE;
+    else if (action == "remapUID") rule.action = REMAP_UID;
+    else return false;
+    rule.value = value;
+    profile.rules[static_cast<Uint32>(std::stoul(tag, nullptr, 16))] = rule;
+    return true;
+}
+
+// original UIDs and those they are replaced by, split into shards locked on their own so the
+// transforming threads rarely wait for each other
+class UidMap
+{
+public:
+    explicit UidMap(const std::string& root) : _root(root.empty() ? SITE_INSTANCE_UID_ROOT : root) {}
+
+    // the UID replacing uid, generated on its first use
+    std::string remap(const std::string& uid)
+    {
+        sShard& shard = _shards[std::hash<std::string>()(uid) % shardCount];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::unordered_map<std::string, std::string>::const_iterator it = shard.uids.find(uid);
+        if (it != shard.uids.end()) {
+            return it->second;
+        }
+        char generated[100];
+        dcmGenerateUniqueIdentifier(generated, _root.c_str());
+        shard.uids[uid] = generated;
+        return generated;
+    }
+
+    size_t size()
+    {
+        size_t count = 0;
+        for (sShard& shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            count += shard.uids.size();
+        }
+        return count;
+    }
+
+    // adds the UIDs of a file written by save(), a missing file is an empty map
+    bool load(const std::string& path)
+    {
+        std::ifstream stream(path.c_str());
+        if (!stream) {
+            return true;
+        }
+        json uids = json::parse(stream, nullptr, false);
+        if (!uids.is_object()) {
+            return false;
+        }
+        for (json::const_iterator it = uids.begin(); it != uids.end(); ++it) {
+            if (it.value().is_string()) {
+                _shards[std::hash<std::string>()(it.key()) % shardCount].uids[it.key()] = it.value().get<std::string>();
+            }
+        }
+        return true;
+    }
+
+    // replaces the file atomically, a crash leaves the previous version
+    bool save(const std::string& path)
+    {
+        json uids = json::object();
+        for (sShard& shard : _shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const std::pair<const std::string, std::string>& entry : shard.uids) {
+                uids[entry.first] = entry.second;
+            }
+        }
+        const std::string tmpPath = path + "_";
+        {
+            std::ofstream stream(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+            stream << uids.dump();
+            if (!stream) {
+                return false;
+            }
+        }
+        OFStandard::deleteFile(OFFilename(path.c_str()));
+        return OFStandard::renameFile(OFFilename(tmpPath.c_str()), OFFilename(path.c_str()));
+    }
+
+private:
+    static const size_t shardCount = 16;
+
+    struct sShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::string> uids;
+    };
+
+    std::string _root;
+    sShard _shards[shardCount];
+};
+
+// applies the profile to the attributes of item and of the items of its sequences
+void apply(DcmItem& item, const sProfile& profile, UidMap& uids)
+{
+    std::vector<DcmElement*> removed;
+    for (DcmObject* obj = item.nextInContainer(NULL); obj != NULL; obj = item.nextInContainer(obj)) {
+        DcmElement* elem = OFstatic_cast(DcmElement*, obj);
+        const DcmTagKey tag = elem->getTag().getXTag();
+        if (profile.removePrivate && tag.isPrivate()) {
+            removed.push_back(elem);
+            continue;
+        }
+        std::unordered_map<Uint32, sRule>::const_iterator rule =
+            profile.rules.find((static_cast<Uint32>(tag.getGroup()) << 16) | tag.getElement());
+        if (rule != profile.rules.end()) {
+            switch (rule->second.action) {
+            case REMOVE:
+                removed.push_back(elem);
+                continue;
+            case EMPTY:
+                elem->clear();
+                continue;
+            case REPLACE:
+                if (elem->putString(rule->second.value.c_str()).bad()) {
+                    DCMNET_DEBUG("cannot replace the value of " << tag << ", emptied");
+                    elem->clear();
+                }
+                continue;
+            case REMAP_UID:
+                if (elem->getVR() == EVR_UI) {
+                    OFString value;
+                    elem->getOFStringArray(value);
+                    // each value of a multi-valued UID is remapped on its own
+                    std::string remapped;
+                    size_t begin = 0;
+                    while (!value.empty()) {
+                        const size_t end = value.find('\\', begin);
+                        const std::string single(value.substr(begin, end == OFString_npos ? OFString_npos : end - begin).c_str());
+                        if (!single.empty()) {
+                            remapped += uids.remap(single);
+                        }
+                        if (end == OFString_npos) {
+                            break;
+                        }
+                        remapped += '\\';
+                        begin = end + 1;
+                    }
+                    elem->putString(remapped.c_str());
+                }
+                continue;
+            }
+        }
+        if (elem->ident() == EVR_SQ) {
+            DcmSequenceOfItems* sequence = OFstatic_cast(DcmSequenceOfItems*, elem);
+            for (unsigned long i = 0; i < sequence->card(); ++i) {
+                apply(*sequence->getItem(i), profile, uids);
+            }
+        }
+    }
+    for (DcmElement* elem : removed) {
+        delete item.remove(elem);
+    }
+}
+
+// one file passing the read, transform and write stages
+struct sAnonymizeItem {
+    sAnonymizeItem() : ok(false) {}
+    OFFilename infile;
+    OFFilename outfile;
+    std::shared_ptr<DcmFileFormat> dfile;
+    bool ok;
+};
+
+// queue between two pipeline stages, producers block while it is full
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : m_capacity(std::max<size_t>(capacity, 1)), m_closed(false) {}
+
+    void push(const T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_items.size() < m_capacity; });
+        m_items.push_back(item);
+        m_notEmpty.notify_one();
+    }
+
+    // returns false once the queue is closed and drained
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+            return false;
+        item = m_items.front();
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+private:
+    size_t m_capacity;
+    bool m_closed;
+    std::deque<T> m_items;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+};
+
+void load(sAnonymizeItem& item)
+{
+    item.dfile = std::make_shared<DcmFileFormat>();
+    if (!DcmDataUtil::isDicomFile(item.infile) ||
+        item.dfile->loadFile(item.infile, EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect).bad()) {
+        DCMNET_WARN("Failed loading file: " << item.infile.getCharPointer());
+        item.dfile.reset();
+        return;
+    }
+    item.ok = true;
+}
+
+void transform(sAnonymizeItem& item, const sProfile& profile, UidMap& uids, const OFString& storePath)
+{
+    DcmDataset* dataset = item.dfile->getDataset();
+    item.ok = false;
+    apply(*dataset, profile, uids);
+    dataset->putAndInsertString(DCM_PatientIdentityRemoved, "YES");
+    OFString sopInstanceUID;
+    if (dataset->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID).bad() || sopInstanceUID.empty()) {
+        DCMNET_WARN("No SOPInstanceUID left in file: " << item.infile.getCharPointer());
+        return;
+    }
+    OFString outfile;
+    OFStandard::combineDirAndFilename(outfile, storePath, sopInstanceUID, OFTrue);
+    item.outfile = outfile;
+    item.ok = true;
+}
+
+void write(sAnonymizeItem& item)
+{
+    // the meta header is updated to the remapped SOP Instance UID
+    DcmDataset* dataset = item.dfile->getDataset();
+    if (item.dfile->saveFile(item.outfile, dataset->getOriginalXfer(), EET_UndefinedLength, EGL_recalcGL,
+            EPD_noChange, 0, 0, EWM_updateMeta).bad()) {
+        DCMNET_WARN("Failed writing file to: " << item.outfile.getCharPointer());
+        item.ok = false;
+    }
+}
+
+}
+
+AnonymizeAsyncWorker::AnonymizeAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void AnonymizeAsyncWorker::Execute(const ExecutionProgress& progress)
+{
+    ns::sInput in = GetInput();
+    EnableVerboseLogging(in.verbose);
+
+    if (in.sourcePath.empty()) {
+        SetErrorJson("No source path set");
+        return;
+    }
+    if (in.storagePath.empty()) {
+        SetErrorJson("No target path set");
+        return;
+    }
+
+    sProfile profile;
+    profile.removePrivate = in.removePrivateTags || in.anonymizeRules.empty();
+    if (in.anonymizeRules.empty()) {
+        for (const auto& rule : defaultProfile) {
+            compileRule(profile, rule[0], rule[1], std::string());
+        }
+    }
+    for (const ns::sAnonymizeRule& rule : in.anonymizeRules) {
+        if (!compileRule(profile, rule.tag, rule.action, rule.value)) {
+            SetErrorJson("Invalid anonymize rule: " + rule.tag + " " + rule.action);
+            return;
+        }
+    }
+
+    UidMap uids(in.uidRoot);
+    if (!in.uidMapPath.empty() && !uids.load(in.uidMapPath)) {
+        SetErrorJson("Invalid UID map: " + in.uidMapPath);
+        return;
+    }
+
+    OFList<OFFilename> fileNameList;
+    const OFFilename sourcePath(in.sourcePath.c_str());
+    if (OFStandard::dirExists(sourcePath)) {
+        OFStandard::searchDirectoryRecursively(sourcePath, fileNameList, OFFilename(), OFFilename(), OFTrue);
+    }
+    else if (OFStandard::fileExists(sourcePath)) {
+        fileNameList.push_back(sourcePath);
+    }
+    if (fileNameList.empty()) {
+        SetErrorJson("Invalid source path set, no DICOM files found");
+        return;
+    }
+    const OFFilename storagePath(in.storagePath.c_str());
+    if (!OFStandard::dirExists(storagePath) && OFStandard::createDirectory(storagePath, OFFilename()).bad()) {
+        SetErrorJson("Cannot create the target path " + in.storagePath);
+        return;
+    }
+
+    // read -> transform (parallel) -> write, the queues bound the number of datasets in memory
+    const size_t threads = in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    BoundedQueue<sAnonymizeItem> loaded(2 * threads);
+    BoundedQueue<sAnonymizeItem> transformed(2 * threads);
+    DCMNET_INFO("anonymizing " << fileNameList.size() << " files using " << threads << " threads");
+
+    std::thread reader([&]() {
+        for (OFListIterator(OFFilename) iter = fileNameList.begin(); iter != fileNameList.end() && !Cancelled(); ++iter) {
+            sAnonymizeItem item;
+            item.infile = *iter;
+            load(item);
+            loaded.push(item);
+        }
+        loaded.close();
+    });
+
+    const OFString storePath(in.storagePath.c_str());
+    std::atomic<size_t> runningTransformers(threads);
+    std::vector<std::thread> transformers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t i = 0; i < threads; ++i) {
+        transformers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            sAnonymizeItem item;
+            while (loaded.pop(item)) {
+                if (item.ok) {
+                    transform(item, profile, uids, storePath);
+                }
+                transformed.push(item);
+                item = sAnonymizeItem();
+            }
+            if (--runningTransformers == 0) {
+                transformed.close();
+            }
+        }));
+    }
+
+    // the writer stage runs here, progress at most once a second
+    size_t files = 0;
+    size_t anonymized = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    sAnonymizeItem item;
+    while (transformed.pop(item)) {
+        if (item.ok) {
+            write(item);
+        }
+        if (item.ok) {
+            ++anonymized;
+        }
+        ++files;
+        item = sAnonymizeItem();
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            json v = json::object();
+            v["files"] = files;
+            v["anonymized"] = anonymized;
+            v["elapsed"] = std::chrono::duration<double>(now - start).count();
+            SendResponse(ns::createResponse(ns::PENDING, "ANONYMIZE_PROGRESS", v), progress);
+        }
+    }
+    reader.join();
+    for (std::thread& transformer : transformers) {
+        transformer.join();
+    }
+
+    // also after a cancelled request, the files written keep their UIDs in later requests
+    if (!in.uidMapPath.empty() && !uids.save(in.uidMapPath)) {
+        DCMNET_WARN("failed writing UID map: " << in.uidMapPath);
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DCMNET_INFO("anonymized " << anonymized << " of " << files << " files in " << elapsed << " s");
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    if (anonymized == 0) {
+        SetErrorJson("Invalid source path set, no DICOM files found");
+        return;
+    }
+    json v = json::object();
+    v["files"] = files;
+    v["anonymized"] = anonymized;
+    v["failed"] = files - anonymized;
+    v["uids"] = uids.size();
+    v["elapsed"] = elapsed;
+    v["filesPerSecond"] = elapsed > 0 ? static_cast<double>(anonymized) / elapsed : 0;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
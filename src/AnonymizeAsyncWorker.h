@@ -0,0 +1,16 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// de-identifies the DICOM files below sourcePath into storagePath: files are read, the rules of the
+// profile applied to their datasets on a pool of threads and the results written, without a round
+// trip through JSON. UIDs are remapped consistently over all files of the request
+class AnonymizeAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        AnonymizeAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,429 @@
+#include "ArchiveWriter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "BufferPool.h"
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+
+const Uint32 zipLocalHeader = 0x04034b50;
+const Uint32 zipDataDescriptor = 0x08074b50;
+const Uint32 zipCentralHeader = 0x02014b50;
+const Uint32 zipEnd = 0x06054b50;
+const Uint32 zip64End = 0x06064b50;
+const Uint32 zip64Locator = 0x07064b50;
+
+// sizes and CRC follow the data, names are UTF-8
+const Uint16 zipFlags = 0x0008 | 0x0800;
+const Uint16 zipVersion = 20;
+const Uint16 zip64Version = 45;
+const Uint32 zip32Max = 0xffffffffUL;
+
+const size_t tarBlock = 512;
+// 11 octal digits
+const Uint64 tarOctalMax = 077777777777ULL;
+
+#ifndef WITH_ZLIB
+std::vector<Uint32> crc32Table()
+{
+    std::vector<Uint32> table(256);
+    for (Uint32 n = 0; n < 256; ++n) {
+        Uint32 c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+    return table;
+}
+
+// the CRC-32 of ZIP, table driven
+Uint32 crc32Update(Uint32 crc, const unsigned char* data, size_t length)
+{
+    static const std::vector<Uint32> table = crc32Table();
+    crc = crc ^ 0xffffffffUL;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffUL;
+}
+#endif
+
+Uint32 crcUpdate(Uint32 crc, const void* data, size_t length)
+{
+#ifdef WITH_ZLIB
+    const Bytef* bytes = static_cast<const Bytef*>(data);
+    // zlib takes uInt lengths
+    while (length > 0) {
+        const uInt block = static_cast<uInt>(std::min<size_t>(length, 1u << 30));
+        crc = static_cast<Uint32>(crc32(crc, bytes, block));
+        bytes += block;
+        length -= block;
+    }
+    return crc;
+#else
+    return crc32Update(crc, static_cast<const unsigned char*>(data), length);
+#endif
+}
+
+// little endian fields of ZIP records
+void put16(std::vector<unsigned char>& out, Uint16 value)
+{
+    out.push_back(static_cast<unsigned char>(value));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+void put32(std::vector<unsigned char>& out, Uint32 value)
+{
+    put16(out, static_cast<Uint16>(value));
+    put16(out, static_cast<Uint16>(value >> 16));
+}
+
+void put64(std::vector<unsigned char>& out, Uint64 value)
+{
+    put32(out, static_cast<Uint32>(value));
+    put32(out, static_cast<Uint32>(value >> 32));
+}
+
+Uint32 cap32(Uint64 value)
+{
+    return value >= zip32Max ? zip32Max : static_cast<Uint32>(value);
+}
+
+// MS-DOS time and date of t in local time, 1980-01-01 for earlier times
+void dosTimeDate(time_t t, Uint16& dosTime, Uint16& dosDate)
+{
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &t);
+#else
+    localtime_r(&t, &local);
+#endif
+    if (local.tm_year < 80) {
+        dosTime = 0;
+        dosDate = (1 << 5) | 1;
+        return;
+    }
+    dosTime = static_cast<Uint16>((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+    dosDate = static_cast<Uint16>(((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+}
+
+// an octal tar field of width bytes, NUL terminated
+void putOctal(unsigned char* field, size_t width, Uint64 value)
+{
+    field[width - 1] = '\0';
+    for (size_t i = width - 1; i > 0; --i) {
+        field[i - 1] = static_cast<unsigned char>('0' + (value & 7));
+        value >>= 3;
+    }
+}
+
+}
+
+ArchiveWriter::ArchiveWriter(eFormat format, size_t chunkSize, const ChunkFunction& emit)
+    : m_format(format), m_chunkSize(chunkSize > 0 ? chunkSize : defaultChunkSize), m_emit(emit),
+      m_chunk(NULL), m_chunkUsed(0), m_stopped(false), m_offset(0), m_inEntry(false), m_entryWritten(0), m_crc(0)
+{
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+    if (m_chunk != NULL) {
+        BufferPool::release(m_chunk);
+    }
+}
+
+bool ArchiveWriter::parseFormat(const std::string& name, eFormat& format)
+{
+    if (name.empty() || name == "zip") {
+        format = ZIP;
+        return true;
+    }
+    if (name == "tar") {
+        format = TAR;
+        return true;
+    }
+    return false;
+}
+
+bool ArchiveWriter::beginEntry(const std::string& name, Uint64 size, time_t modified, std::string& error)
+{
+    if (m_stopped) {
+        error = "Archive output stopped";
+        return false;
+    }
+    sEntry entry;
+    entry.name = name;
+    entry.size = size;
+    entry.offset = m_offset;
+    entry.crc = 0;
+    dosTimeDate(modified, entry.dosTime, entry.dosDate);
+    entry.zip64 = size >= zip32Max;
+    if (m_format == ZIP ? !writeZipHeader(entry) : !writeTarHeader(entry, modified, error)) {
+        if (error.empty()) {
+            error = "Archive output stopped";
+        }
+        return false;
+    }
+    m_entries.push_back(entry);
+    m_inEntry = true;
+    m_entryWritten = 0;
+    m_crc = 0;
+    return true;
+}
+
+bool ArchiveWriter::write(const void* data, size_t length)
+{
+    if (m_format == ZIP) {
+        m_crc = crcUpdate(m_crc, data, length);
+    }
+    m_entryWritten += length;
+    return append(data, length);
+}
+
+bool ArchiveWriter::endEntry(std::string& error)
+{
+    if (!m_inEntry) {
+        return true;
+    }
+    m_inEntry = false;
+    sEntry& entry = m_entries.back();
+    if (m_entryWritten != entry.size) {
+        error = entry.name + ": " + std::to_string(m_entryWritten) + " bytes written instead of " + std::to_string(entry.size);
+        return false;
+    }
+    entry.crc = m_crc;
+    if (m_format == ZIP) {
+        return writeZipDescriptor(entry);
+    }
+    // the data is padded to whole blocks
+    static const unsigned char zeros[tarBlock] = { 0 };
+    const size_t tail = static_cast<size_t>(entry.size % tarBlock);
+    return tail == 0 || append(zeros, tarBlock - tail);
+}
+
+bool ArchiveWriter::finish(std::string& error)
+{
+    if (m_inEntry && !endEntry(error)) {
+        return false;
+    }
+    bool ok = true;
+    if (m_format == ZIP) {
+        ok = writeZipDirectory();
+    }
+    else {
+        // two zero blocks end a tar archive
+        static const unsigned char zeros[2 * tarBlock] = { 0 };
+        ok = append(zeros, sizeof(zeros));
+    }
+    if (!ok || (m_chunkUsed > 0 && !emitChunk())) {
+        error = "Archive output stopped";
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveWriter::append(const void* data, size_t length)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    while (length > 0 && !m_stopped) {
+        if (m_chunk == NULL) {
+            m_chunk = BufferPool::acquire(m_chunkSize);
+            m_chunkUsed = 0;
+        }
+        const size_t n = std::min(length, m_chunkSize - m_chunkUsed);
+        memcpy(m_chunk + m_chunkUsed, bytes, n);
+        m_chunkUsed += n;
+        m_offset += n;
+        bytes += n;
+        length -= n;
+        if (m_chunkUsed == m_chunkSize) {
+            emitChunk();
+        }
+    }
+    return !m_stopped;
+}
+
+bool ArchiveWriter::emitChunk()
+{
+    unsigned char* chunk = m_chunk;
+    const size_t length = m_chunkUsed;
+    m_chunk = NULL;
+    m_chunkUsed = 0;
+    if (!m_emit(chunk, length)) {
+        m_stopped = true;
+    }
+    return !m_stopped;
+}
+
+bool ArchiveWriter::writeZipHeader(const sEntry& entry)
+{
+    std::vector<unsigned char> header;
+    header.reserve(30 + entry.name.size() + 20);
+    put32(header, zipLocalHeader);
+    put16(header, entry.zip64 ? zip64Version : zipVersion);
+    put16(header, zipFlags);
+    put16(header, 0 /* stored */);
+    put16(header, entry.dosTime);
+    put16(header, entry.dosDate);
+    // CRC and sizes come with the data descriptor, ZIP64 entries say so with all ones
+    put32(header, 0);
+    put32(header, entry.zip64 ? zip32Max : 0);
+    put32(header, entry.zip64 ? zip32Max : 0);
+    put16(header, static_cast<Uint16>(entry.name.size()));
+    put16(header, entry.zip64 ? 20 : 0);
+    header.insert(header.end(), entry.name.begin(), entry.name.end());
+    if (entry.zip64) {
+        put16(header, 0x0001);
+        put16(header, 16);
+        put64(header, 0);
+        put64(header, 0);
+    }
+    return append(&header[0], header.size());
+}
+
+bool ArchiveWriter::writeZipDescriptor(const sEntry& entry)
+{
+    std::vector<unsigned char> descriptor;
+    put32(descriptor, zipDataDescriptor);
+    put32(descriptor, entry.crc);
+    if (entry.zip64) {
+        put64(descriptor, entry.size);
+        put64(descriptor, entry.size);
+    }
+    else {
+        put32(descriptor, static_cast<Uint32>(entry.size));
+        put32(descriptor, static_cast<Uint32>(entry.size));
+    }
+    return append(&descriptor[0], descriptor.size());
+}
+
+bool ArchiveWriter::writeZipDirectory()
+{
+    const Uint64 directoryOffset = m_offset;
+    std::vector<unsigned char> record;
+    for (const sEntry& entry : m_entries) {
+        record.clear();
+        const bool largeSize = entry.size >= zip32Max;
+        const bool largeOffset = entry.offset >= zip32Max;
+        const Uint16 extra = static_cast<Uint16>((largeSize ? 16 : 0) + (largeOffset ? 8 : 0));
+        put32(record, zipCentralHeader);
+        put16(record, zip64Version);
+        put16(record, entry.zip64 || largeOffset ? zip64Version : zipVersion);
+        put16(record, zipFlags);
+        put16(record, 0);
+        put16(record, entry.dosTime);
+        put16(record, entry.dosDate);
+        put32(record, entry.crc);
+        put32(record, cap32(entry.size));
+        put32(record, cap32(entry.size));
+        put16(record, static_cast<Uint16>(entry.name.size()));
+        put16(record, static_cast<Uint16>(extra > 0 ? extra + 4 : 0));
+        put16(record, 0 /* comment */);
+        put16(record, 0 /* disk */);
+        put16(record, 0 /* internal attributes */);
+        put32(record, 0 /* external attributes */);
+        put32(record, cap32(entry.offset));
+        record.insert(record.end(), entry.name.begin(), entry.name.end());
+        if (extra > 0) {
+            put16(record, 0x0001);
+            put16(record, extra);
+            if (largeSize) {
+                put64(record, entry.size);
+                put64(record, entry.size);
+            }
+            if (largeOffset) {
+                put64(record, entry.offset);
+            }
+        }
+        if (!append(&record[0], record.size())) {
+            return false;
+        }
+    }
+    const Uint64 directorySize = m_offset - directoryOffset;
+    const Uint64 count = m_entries.size();
+
+    record.clear();
+    if (count >= 0xffff || directoryOffset >= zip32Max || directorySize >= zip32Max) {
+        const Uint64 recordOffset = m_offset;
+        put32(record, zip64End);
+        put64(record, 44);
+        put16(record, zip64Version);
+        put16(record, zip64Version);
+        put32(record, 0);
+        put32(record, 0);
+        put64(record, count);
+        put64(record, count);
+        put64(record, directorySize);
+        put64(record, directoryOffset);
+        put32(record, zip64Locator);
+        put32(record, 0);
+        put64(record, recordOffset);
+        put32(record, 1);
+    }
+    put32(record, zipEnd);
+    put16(record, 0);
+    put16(record, 0);
+    put16(record, static_cast<Uint16>(std::min<Uint64>(count, 0xffff)));
+    put16(record, static_cast<Uint16>(std::min<Uint64>(count, 0xffff)));
+    put32(record, cap32(directorySize));
+    put32(record, cap32(directoryOffset));
+    put16(record, 0 /* comment */);
+    return append(&record[0], record.size());
+}
+
+bool ArchiveWriter::writeTarHeader(const sEntry& entry, time_t modified, std::string& error)
+{
+    // names longer than the name field are split at a '/' into prefix and name
+    std::string prefix;
+    std::string name = entry.name;
+    if (name.size() > 100) {
+        size_t split = name.find('/', name.size() - 101);
+        if (split == std::string::npos || split > 155 || split == 0) {
+            error = entry.name + ": name too long for a tar archive";
+            return false;
+        }
+        prefix = name.substr(0, split);
+        name = name.substr(split + 1);
+    }
+
+    unsigned char header[tarBlock];
+    memset(header, 0, sizeof(header));
+    memcpy(header, name.data(), name.size());
+    putOctal(header + 100, 8, 0644);
+    putOctal(header + 108, 8, 0);
+    putOctal(header + 116, 8, 0);
+    if (entry.size <= tarOctalMax) {
+        putOctal(header + 124, 12, entry.size);
+    }
+    else {
+        // base-256, big endian with the high bit of the first byte set
+        Uint64 size = entry.size;
+        for (size_t i = 11; i > 0; --i) {
+            header[124 + i] = static_cast<unsigned char>(size & 0xff);
+            size >>= 8;
+        }
+        header[124] = 0x80;
+    }
+    putOctal(header + 136, 12, modified > 0 ? static_cast<Uint64>(modified) : 0);
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    memcpy(header + 345, prefix.data(), prefix.size());
+
+    // the checksum is taken with its own field set to spaces
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < tarBlock; ++i) {
+        checksum += header[i];
+    }
+    putOctal(header + 148, 7, checksum);
+    header[155] = ' ';
+    return append(header, sizeof(header));
+}
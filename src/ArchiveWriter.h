@@ -0,0 +1,91 @@
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftypes.h"
+
+// Writes a ZIP archive of stored (uncompressed) entries or a ustar archive front to back, without
+// seeking, and hands it over in chunks as they fill up, so an archive is streamed while it is
+// produced and never staged on disk. ZIP entries carry their CRC and sizes in a data descriptor after
+// their data and switch to ZIP64 records for entries, offsets and entry counts beyond the 32 and
+// 16 bit fields. Tar entries larger than the octal size field holds use the base-256 encoding of
+// GNU tar. The size of each entry has to be known when it is begun.
+class ArchiveWriter
+{
+public:
+    enum eFormat {
+        ZIP,
+        TAR
+    };
+
+    // called with each full chunk (allocated with BufferPool::acquire()), ownership is transferred.
+    // Returns false to stop writing, e.g. once the request is cancelled
+    typedef std::function<bool(unsigned char* chunk, size_t length)> ChunkFunction;
+
+    // chunks of chunkSize bytes, the last one may be shorter
+    ArchiveWriter(eFormat format, size_t chunkSize, const ChunkFunction& emit);
+
+    ~ArchiveWriter();
+
+    // "zip" (the default if empty) or "tar", false for anything else
+    static bool parseFormat(const std::string& name, eFormat& format);
+
+    // starts an entry of size bytes named name, with '/' between directories. False with error set
+    // if the name does not fit the format or the output was stopped
+    bool beginEntry(const std::string& name, Uint64 size, time_t modified, std::string& error);
+
+    // adds data to the current entry, false once the output was stopped
+    bool write(const void* data, size_t length);
+
+    // ends the current entry, false with error set if its size differs from the one announced
+    bool endEntry(std::string& error);
+
+    // writes the end of the archive and hands over the last chunk
+    bool finish(std::string& error);
+
+    // bytes of the archive written so far
+    Uint64 bytesWritten() const { return m_offset; }
+
+    size_t entries() const { return m_entries.size(); }
+
+    // bytes per chunk if none is given
+    static const size_t defaultChunkSize = 1024 * 1024;
+
+private:
+    struct sEntry {
+        std::string name;
+        Uint64 size;
+        Uint64 offset;
+        Uint32 crc;
+        Uint16 dosTime;
+        Uint16 dosDate;
+        bool zip64;
+    };
+
+    // appends to the chunk, handing over full ones
+    bool append(const void* data, size_t length);
+
+    bool emitChunk();
+
+    bool writeZipHeader(const sEntry& entry);
+    bool writeZipDescriptor(const sEntry& entry);
+    bool writeZipDirectory();
+    bool writeTarHeader(const sEntry& entry, time_t modified, std::string& error);
+
+    eFormat m_format;
+    size_t m_chunkSize;
+    ChunkFunction m_emit;
+    unsigned char* m_chunk;
+    size_t m_chunkUsed;
+    bool m_stopped;
+    Uint64 m_offset;
+    // the entry being written and the bytes of it written so far
+    bool m_inEntry;
+    Uint64 m_entryWritten;
+    Uint32 m_crc;
+    std::vector<sEntry> m_entries;
+};
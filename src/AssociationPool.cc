@@ -0,0 +1,301 @@
+#include "AssociationPool.h"
+#include "TlsTransport.h"
+
+#include "dcmtk/config/osconfig.h"  /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/diutil.h"
+
+#include <algorithm>
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+namespace {
+
+    struct sIdleAssociation {
+        CancellableSCU* scu;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::mutex poolMutex;
+    std::condition_variable poolChanged;
+    std::map<std::string, std::deque<sIdleAssociation> > idleAssociations;
+    std::map<const CancellableSCU*, std::string> activeAssociations;
+    int idleTimeoutMs = AssociationPool::defaultIdleTimeout;
+    bool reaperStarted = false;
+
+    std::string poolKey(const ns::sIdent& source, const ns::sIdent& target, const ns::sNetworkOptions& network, AssociationPool::eContexts contexts)
+    {
+        std::ostringstream key;
+        key << source.aet << "|" << target.aet << "@" << target.ip << ":" << target.port
+            << "#" << network.maxReceivePDU() << "," << network.socketBufferSize << "," << network.tcpNoDelay
+            << "," << network.tcpKeepAlive << "," << network.tcpKeepAliveInterval;
+        // plain and TLS associations, or TLS ones with other credentials, are not interchangeable
+        if (network.tls) {
+            key << ",tls:" << network.tlsCertificate << "," << network.tlsCaCertificates << "," << network.tlsVerifyPeer
+                << "," << network.tlsServerName;
+        }
+        key << ",contexts:" << contexts;
+        return key.str();
+    }
+
+    std::string targetKey(const ns::sIdent& target)
+    {
+        std::ostringstream key;
+        key << "|" << target.aet << "@" << target.ip << ":" << target.port << "#";
+        return key.str();
+    }
+
+    void closeAssociation(CancellableSCU* scu)
+    {
+        if (scu->isConnected()) {
+            scu->releaseAssociation();
+        }
+        delete scu;
+    }
+
+    // releases expired idle associations, lives as long as the process
+    void reap()
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        while (true) {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point next = now + std::chrono::milliseconds(AssociationPool::defaultIdleTimeout);
+            std::vector<CancellableSCU*> expired;
+            for (auto& entry : idleAssociations) {
+                std::deque<sIdleAssociation>& idle = entry.second;
+                while (!idle.empty() && idle.front().expires <= now) {
+                    expired.push_back(idle.front().scu);
+                    idle.pop_front();
+                }
+                if (!idle.empty() && idle.front().expires < next) {
+                    next = idle.front().expires;
+                }
+            }
+
+            if (!expired.empty()) {
+                lock.unlock();
+                for (CancellableSCU* scu : expired) {
+                    closeAssociation(scu);
+                }
+                DCMNET_DEBUG("Released " << expired.size() << " idle associations");
+                lock.lock();
+                continue;
+            }
+            poolChanged.wait_until(lock, next);
+        }
+    }
+
+    // the DIMSE timeout is one of the request, not of the association
+    void applyTimeouts(CancellableSCU* scu, const ns::sNetworkOptions& network)
+    {
+        scu->setDIMSEBlockingMode(network.dimseBlockMode());
+        scu->setDIMSETimeout(OFstatic_cast(Uint32, network.dimseTimeoutSeconds()));
+    }
+
+    CancellableSCU* negotiate(const ns::sIdent& source, const ns::sIdent& target, const ns::sNetworkOptions& network,
+        AssociationPool::eContexts contexts, OFCondition& cond)
+    {
+        OFList<OFString> syntaxes;
+        syntaxes.push_back(UID_LittleEndianExplicitTransferSyntax);
+        syntaxes.push_back(UID_BigEndianExplicitTransferSyntax);
+        syntaxes.push_back(UID_LittleEndianImplicitTransferSyntax);
+
+        CancellableSCU* scu = new CancellableSCU();
+        scu->setMaxReceivePDULength(network.maxReceivePDU());
+        scu->setTCPSocketOptions(network.socketBufferSize, network.tcpNoDelay);
+        scu->setTCPKeepAlive(network.tcpKeepAlive, network.keepAliveIntervalSeconds(), ns::sNetworkOptions::keepAliveProbes);
+        scu->setACSETimeout(OFstatic_cast(Uint32, network.acseTimeoutSeconds()));
+        scu->setAETitle(source.aet.c_str());
+        scu->setPeerHostName(target.ip.c_str());
+        scu->setPeerPort(target.port);
+        scu->setPeerAETitle(target.aet.c_str());
+
+        scu->addPresentationContext(UID_VerificationSOPClass, syntaxes);
+        if (contexts == AssociationPool::STORAGE_COMMITMENT) {
+            // the N-EVENT-REPORT is sent by the SCP of the SOP class on an association it requests
+            scu->addPresentationContext(UID_StorageCommitmentPushModelSOPClass, syntaxes, ASC_SC_ROLE_SCP);
+        }
+        else {
+            scu->addPresentationContext(UID_FINDStudyRootQueryRetrieveInformationModel, syntaxes);
+            scu->addPresentationContext(UID_MOVEStudyRootQueryRetrieveInformationModel, syntaxes);
+        }
+
+        cond = TlsTransport::secure(*scu, network);
+        if (cond.good()) {
+            cond = scu->initNetwork();
+        }
+        if (cond.good()) {
+            cond = scu->negotiateAssociation();
+        }
+        if (cond.bad()) {
+            delete scu;
+            return NULL;
+        }
+        return scu;
+    }
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+CancellableSCU* AssociationPool::acquire(const ns::sIdent& source, const ns::sIdent& target, const ns::sNetworkOptions& network, OFCondition& cond, bool& reused,
+    eContexts contexts)
+{
+    std::string key = poolKey(source, target, network, contexts);
+    std::vector<CancellableSCU*> closed;
+    CancellableSCU* found = NULL;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        std::deque<sIdleAssociation>& idle = idleAssociations[key];
+        // most recently used first, it is the least likely to be closed by the peer. Anything the peer
+        // sent on an idle association is a release, an abort or the end of the connection
+        while (!idle.empty() && found == NULL) {
+            CancellableSCU* scu = idle.back().scu;
+            idle.pop_back();
+            if (scu->isConnected() && !scu->isDataWaiting()) {
+                activeAssociations[scu] = key;
+                found = scu;
+            }
+            else {
+                closed.push_back(scu);
+            }
+        }
+    }
+    for (CancellableSCU* scu : closed) {
+        if (scu->isConnected()) {
+            scu->abortAssociation();
+        }
+        delete scu;
+    }
+    if (found != NULL) {
+        reused = true;
+        cond = EC_Normal;
+        applyTimeouts(found, network);
+        return found;
+    }
+
+    reused = false;
+    CancellableSCU* scu = negotiate(source, target, network, contexts, cond);
+    if (scu != NULL) {
+        applyTimeouts(scu, network);
+        std::lock_guard<std::mutex> lock(poolMutex);
+        activeAssociations[scu] = key;
+    }
+    return scu;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void AssociationPool::release(CancellableSCU* scu, bool reusable)
+{
+    if (scu == NULL) {
+        return;
+    }
+    scu->setCancelFlag(NULL);
+    CancellableSCU* dropped = NULL;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        std::map<const CancellableSCU*, std::string>::iterator it = activeAssociations.find(scu);
+        std::string key = it != activeAssociations.end() ? it->second : std::string();
+        if (it != activeAssociations.end()) {
+            activeAssociations.erase(it);
+        }
+
+        if (!reusable || key.empty() || !scu->isConnected()) {
+            dropped = scu;
+        }
+        else {
+            std::deque<sIdleAssociation>& idle = idleAssociations[key];
+            idle.push_back({scu, std::chrono::steady_clock::now() + std::chrono::milliseconds(idleTimeoutMs)});
+            if (idle.size() > maxIdleAssociations) {
+                dropped = idle.front().scu;
+                idle.pop_front();
+            }
+            if (!reaperStarted) {
+                reaperStarted = true;
+                std::thread(reap).detach();
+            }
+            poolChanged.notify_one();
+        }
+    }
+
+    if (dropped != NULL) {
+        if (dropped->isConnected()) {
+            dropped->abortAssociation();
+        }
+        delete dropped;
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+size_t AssociationPool::prewarm(const ns::sIdent& source, const ns::sIdent& target, const ns::sNetworkOptions& network, size_t count, OFCondition& cond,
+    eContexts contexts)
+{
+    std::string key = poolKey(source, target, network, contexts);
+    size_t idle = 0;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        idle = idleAssociations[key].size();
+    }
+    cond = EC_Normal;
+    size_t negotiated = 0;
+    for (; idle + negotiated < std::min(count, maxIdleAssociations); ++negotiated) {
+        CancellableSCU* scu = negotiate(source, target, network, contexts, cond);
+        if (scu == NULL) {
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            activeAssociations[scu] = key;
+        }
+        // parked like an association that was used
+        release(scu, true);
+    }
+    DCMNET_DEBUG("Prewarmed " << negotiated << " associations to " << target.aet << "@" << target.ip << ":" << target.port);
+    return negotiated;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void AssociationPool::configure(int idleTimeout)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    idleTimeoutMs = idleTimeout > 0 ? idleTimeout : defaultIdleTimeout;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void AssociationPool::close(const ns::sIdent& target)
+{
+    std::vector<CancellableSCU*> closing;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        std::string peer = targetKey(target);
+        for (auto& entry : idleAssociations) {
+            // all network options of the peer
+            bool matches = entry.first.find(peer) != std::string::npos;
+            if (!target.valid() || matches) {
+                for (auto& association : entry.second) {
+                    closing.push_back(association.scu);
+                }
+                entry.second.clear();
+            }
+        }
+    }
+    for (CancellableSCU* scu : closing) {
+        closeAssociation(scu);
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool AssociationPool::isConnectionLost(const OFCondition& cond)
+{
+    return cond == DUL_PEERABORTEDASSOCIATION || cond == DUL_PEERREQUESTEDRELEASE || cond == DUL_NETWORKCLOSED
+        || cond == DIMSE_SENDFAILED || cond == DIMSE_RECEIVEFAILED || cond == DIMSE_ILLEGALASSOCIATION;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Utils.h"
+#include "CancellableSCU.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+
+// Process wide pool of negotiated SCU associations, idle ones are kept per
+// (calling AE, called AE, host, port, network options) so repeated C-ECHO/C-FIND/C-MOVE
+// requests to the same peer skip the association handshake.
+// Pooled associations propose Verification and, depending on what they are used for, Study Root
+// C-FIND and Study Root C-MOVE or the Storage Commitment Push Model in the SCP role.
+class AssociationPool
+{
+public:
+    // presentation contexts proposed, associations of each kind are pooled apart
+    enum eContexts { QUERY_RETRIEVE, STORAGE_COMMITMENT };
+
+    // whether run() repeats a request on a fresh association, only ever if the peer cannot have
+    // received it. C-MOVE and C-GET are never repeated, their sub-operations may have started
+    enum eRetry { RETRY_UNSENT, NO_RETRY };
+
+    // hands out an idle association for the peer or negotiates a new one, reused is set
+    // if the association has been used before. Returns NULL on failure, cond holds the error.
+    static CancellableSCU* acquire(const ns::sIdent& source, const ns::sIdent& target, const ns::sNetworkOptions& network, OFCondition& cond, bool& reused,
+        eContexts contexts = QUERY_RETRIEVE);
+
+    // returns an association to the pool, unusable ones are closed and released
+    static void release(CancellableSCU* scu, bool reusable);
+
+    // negotiates associations to the peer until count (at most maxIdleAssociations) are idle, e.g. ahead
+    // of a scheduled prefetch. Returns the number negotiated, cond holds the error that stopped it
+    static size_t prewarm(const ns::sIdent& source, const ns::sIdent& target, const ns::sNetworkOptions& network, size_t count, OFCondition& cond,
+        eContexts contexts = QUERY_RETRIEVE);
+
+    // idle associations are released after idleTimeout ms, applies to associations released afterwards
+    static void configure(int idleTimeout);
+
+    // releases all idle associations to the target, all of them if target is not valid
+    static void close(const ns::sIdent& target);
+
+    // runs fn(CancellableSCU&) on a pooled association. Idle associations the peer released or aborted
+    // are not handed out. If a reused association still turns out to be lost before fn sent a complete
+    // message, fn runs once more on a fresh one with RETRY_UNSENT, it must reset what it collected
+    template <class F>
+    static OFCondition run(const ns::sIdent& source, const ns::sIdent& target, const ns::sNetworkOptions& network, F fn,
+        eContexts contexts = QUERY_RETRIEVE, eRetry retry = RETRY_UNSENT)
+    {
+        OFCondition cond;
+        bool reused = false;
+        CancellableSCU* scu = acquire(source, target, network, cond, reused, contexts);
+        if (scu == NULL) {
+            return cond;
+        }
+        const Uint32 sent = scu->getMessagesSent();
+        cond = fn(*scu);
+        if (cond.bad() && reused && retry == RETRY_UNSENT && scu->getMessagesSent() == sent && isConnectionLost(cond)) {
+            release(scu, false);
+            scu = acquire(source, target, network, cond, reused, contexts);
+            if (scu == NULL) {
+                return cond;
+            }
+            cond = fn(*scu);
+        }
+        release(scu, cond.good());
+        return cond;
+    }
+
+    // number of associations kept per peer
+    static const size_t maxIdleAssociations = 4;
+
+    // default for associations which do not configure an idle timeout (ms)
+    static const int defaultIdleTimeout = 30000;
+
+private:
+    static bool isConnectionLost(const OFCondition& cond);
+};
@@ -1,22 +1,342 @@
 #include "BaseAsyncWorker.h"
 
 #include "Utils.h"
+#include "DimseExecutor.h"
+#include "BufferPool.h"
+#include "Metrics.h"
 
 #include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
 #include "dcmtk/oflog/oflog.h"
 
 
-BaseAsyncWorker::BaseAsyncWorker(std::string data, Function &callback) : AsyncProgressQueueWorker<char>(callback),
-                                                                           _input(data)
+namespace {
+
+    // progress messages and the bytes of their buffers waiting for the JS thread
+    Metrics::Gauge& progressQueueMessages() {
+        static Metrics::Gauge& gauge = Metrics::gauge("memory_progress_queue_messages");
+        return gauge;
+    }
+
+    Metrics::Gauge& progressQueueBytes() {
+        static Metrics::Gauge& gauge = Metrics::gauge("memory_progress_queue_bytes");
+        return gauge;
+    }
+
+    // bytes of the pooled buffers owned by JS Buffer objects until they are collected
+    Metrics::Gauge& externalBufferBytes() {
+        static Metrics::Gauge& gauge = Metrics::gauge("memory_js_external_buffer_bytes");
+        return gauge;
+    }
+
+    // hands a pooled buffer to JS, V8 is told about its size so that a burst of large buffers
+    // triggers a collection instead of only counting the small wrapper objects
+    Buffer<unsigned char> externalBuffer(Napi::Env env, unsigned char* data, size_t length) {
+        const int64_t bytes = static_cast<int64_t>(length);
+        MemoryManagement::AdjustExternalMemory(env, bytes);
+        externalBufferBytes().add(bytes);
+        return Buffer<unsigned char>::New(env, data, length, [bytes](Napi::Env finalizeEnv, unsigned char* buffer) {
+            BufferPool::release(buffer);
+            externalBufferBytes().add(-bytes);
+            MemoryManagement::AdjustExternalMemory(finalizeEnv, -bytes);
+        });
+    }
+
+    std::string toString(const Object& in, const char* key) {
+        Value value = in.Get(key);
+        if (value.IsString()) {
+            return value.As<String>().Utf8Value();
+        }
+        return "";
+    }
+
+    // same semantics as ns::toInt, numbers or numeric strings, -1 otherwise
+    int toInt(const Object& in, const char* key) {
+        Value value = in.Get(key);
+        if (value.IsNumber()) {
+            return value.As<Number>().Int32Value();
+        }
+        if (value.IsString()) {
+            try {
+                return std::stoi(value.As<String>().Utf8Value());
+            }
+            catch (std::exception&) {
+                // no error log on purpose
+            }
+        }
+        return -1;
+    }
+
+    // as toInt for offsets and lengths beyond 2 GB
+    long long toInt64(const Object& in, const char* key) {
+        Value value = in.Get(key);
+        if (value.IsNumber()) {
+            return value.As<Number>().Int64Value();
+        }
+        if (value.IsString()) {
+            try {
+                return std::stoll(value.As<String>().Utf8Value());
+            }
+            catch (std::exception&) {
+                // no error log on purpose
+            }
+        }
+        return -1;
+    }
+
+    void toBool(const Object& in, const char* key, bool& target) {
+        Value value = in.Get(key);
+        if (value.IsBoolean()) {
+            target = value.As<Boolean>().Value();
+        }
+    }
+
+    Napi::Value toValue(Napi::Env env, const nlohmann::json& j) {
+        switch (j.type()) {
+        case nlohmann::json::value_t::object: {
+            Object obj = Object::New(env);
+            for (auto it = j.begin(); it != j.end(); ++it) {
+                obj.Set(it.key(), toValue(env, it.value()));
+            }
+            return obj;
+        }
+        case nlohmann::json::value_t::array: {
+            Array arr = Array::New(env, j.size());
+            for (size_t i = 0; i < j.size(); ++i) {
+                arr.Set(static_cast<uint32_t>(i), toValue(env, j[i]));
+            }
+            return arr;
+        }
+        case nlohmann::json::value_t::string:
+            return String::New(env, j.get_ref<const std::string&>());
+        case nlohmann::json::value_t::boolean:
+            return Boolean::New(env, j.get<bool>());
+        case nlohmann::json::value_t::number_integer:
+        case nlohmann::json::value_t::number_unsigned:
+        case nlohmann::json::value_t::number_float:
+            return Number::New(env, j.get<double>());
+        default:
+            return env.Null();
+        }
+    }
+
+    // [{ key, value }] as tags, entries which are no objects are skipped
+    std::vector<ns::sTag> toTags(const Value& value) {
+        std::vector<ns::sTag> tags;
+        if (value.IsArray()) {
+            Array list = value.As<Array>();
+            for (uint32_t i = 0; i < list.Length(); ++i) {
+                Value item = list.Get(i);
+                if (item.IsObject()) {
+                    ns::sTag tag;
+                    tag.key = toString(item.As<Object>(), "key");
+                    tag.value = toString(item.As<Object>(), "value");
+                    tags.push_back(tag);
+                }
+            }
+        }
+        return tags;
+    }
+
+    std::vector<std::string> toStringList(const Object& in, const char* key) {
+        std::vector<std::string> list;
+        Value value = in.Get(key);
+        if (value.IsArray()) {
+            Array items = value.As<Array>();
+            for (uint32_t i = 0; i < items.Length(); ++i) {
+                Value item = items.Get(i);
+                if (item.IsString()) {
+                    list.push_back(item.As<String>().Utf8Value());
+                }
+            }
+        }
+        return list;
+    }
+
+    std::vector<int> toIntList(const Object& in, const char* key) {
+        std::vector<int> list;
+        Value value = in.Get(key);
+        if (value.IsArray()) {
+            Array items = value.As<Array>();
+            for (uint32_t i = 0; i < items.Length(); ++i) {
+                Value item = items.Get(i);
+                if (item.IsNumber()) {
+                    list.push_back(item.As<Number>().Int32Value());
+                }
+            }
+        }
+        return list;
+    }
+
+    std::vector<double> toDoubleList(const Object& in, const char* key) {
+        std::vector<double> list;
+        Value value = in.Get(key);
+        if (value.IsArray()) {
+            Array items = value.As<Array>();
+            for (uint32_t i = 0; i < items.Length(); ++i) {
+                Value item = items.Get(i);
+                if (item.IsNumber()) {
+                    list.push_back(item.As<Number>().DoubleValue());
+                }
+            }
+        }
+        return list;
+    }
+
+    ns::sIdent toIdent(const Object& in, const char* key) {
+        ns::sIdent ident;
+        Value value = in.Get(key);
+        if (value.IsObject()) {
+            Object obj = value.As<Object>();
+            ident.aet = toString(obj, "aet");
+            ident.ip = toString(obj, "ip");
+            ident.port = toInt(obj, "port");
+            ident.compression = toString(obj, "compression");
+            ident.priority = toString(obj, "priority");
+        }
+        return ident;
+    }
+
+    ns::sRateLimit toRateLimit(const Object& in, const char* key) {
+        ns::sRateLimit limit;
+        Value value = in.Get(key);
+        if (value.IsObject()) {
+            Object obj = value.As<Object>();
+            limit.associationsPerSecond = toInt(obj, "associationsPerSecond");
+            limit.burst = toInt(obj, "burst");
+            limit.concurrentAssociations = toInt(obj, "concurrentAssociations");
+            limit.bytesPerSecond = toInt(obj, "bytesPerSecond");
+        }
+        return limit;
+    }
+
+    ns::sIndexTuning toIndexTuning(const Object& in, const char* key) {
+        ns::sIndexTuning tuning;
+        Value value = in.Get(key);
+        if (value.IsObject()) {
+            Object obj = value.As<Object>();
+            tuning.cacheSize = toInt(obj, "cacheSize");
+            tuning.mmapSize = toInt(obj, "mmapSize");
+            tuning.pageSize = toInt(obj, "pageSize");
+            tuning.journalMode = toString(obj, "journalMode");
+            tuning.synchronous = toString(obj, "synchronous");
+            tuning.tempStore = toString(obj, "tempStore");
+        }
+        return tuning;
+    }
+
+}
+
+BaseAsyncWorker::BaseAsyncWorker(std::string data, Function &callback) : _input(data),
+                                                                           _hasNativeInput(false),
+                                                                           _nativeResult(false),
+                                                                           _env(callback.Env()),
+                                                                           _callback(Persistent(callback)),
+                                                                           _cancelRequested(std::make_shared<std::atomic<bool>>(false)),
+                                                                           _batchSize(1),
+                                                                           _flushInterval(0),
+                                                                           _deliveryPending(false),
+                                                                           _stopFlusher(false),
+                                                                           _verbose(false),
+                                                                           _inFlightBytes(0),
+                                                                           _inFlightMessages(0),
+                                                                           _maxInFlightBytes(0),
+                                                                           _maxInFlightMessages(0)
+{
+}
+
+BaseAsyncWorker::~BaseAsyncWorker()
+{
+        if (_registry) {
+            _registry->remove(this);
+        }
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        for (auto& message : _queuedMessages) {
+            BufferPool::release(message.data);
+            Dequeued(message.bytes);
+        }
+        _queuedMessages.clear();
+}
+
+void BaseAsyncWorker::Queue(const std::string& operation)
+{
+    // unlimited queue, the executing thread never blocks on delivery
+    _deliver = ThreadSafeFunction::New(_env, _callback.Value(), "dcmtk", 0, 1);
+    _operation = operation;
+    // options given as JSON text are only parsed on the executor thread, they queue at medium priority
+    const DimseExecutor::Priority priority = DcmQueryRetrieveScheduler::classOf(ns::dimsePriority(_hasNativeInput ? _nativeInput.priority : std::string()));
+    _priority = DcmQueryRetrieveScheduler::name(priority);
+    _queued = std::chrono::steady_clock::now();
+    _registry = RequestRegistry::of(_env);
+    _registry->add(this);
+    DimseExecutor::submit(operation, [this]() { Run(); }, priority);
+}
+
+void BaseAsyncWorker::Run()
+{
+    const Metrics::Labels labels = {{"operation", _operation}, {"priority", _priority}};
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    Metrics::histogram("operation_queue_seconds", labels).record(std::chrono::duration<double>(started - _queued).count());
+
+    // a request cancelled while it waited for its lane is not started at all
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+    }
+    else {
+        Execute(ExecutionProgress(this));
+    }
+    StopFlusher();
+    if (_verbose) {
+        // executor threads are reused
+        OFLog::setThreadLogLevel(OFLogger::OFF_LOG_LEVEL);
+    }
+
+    Metrics::histogram("operation_seconds", labels).record(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+    Metrics::counter("operations_total", {{"operation", _operation}, {"result", _error.empty() ? "success" : "failure"}}).add();
+
+    // deliveries keep their order, the result follows the last progress message.
+    // The worker is gone once the result is delivered, so only the copy is used afterwards.
+    ThreadSafeFunction deliver = _deliver;
+    deliver.BlockingCall([this](Napi::Env /*env*/, Function /*callback*/) {
+        if (_batchSize > 1) {
+            // the last partial batch
+            HandleScope scope(Env());
+            DeliverBatches();
+        }
+        OnOK();
+        delete this;
+    });
+    deliver.Release();
+}
+
+void BaseAsyncWorker::ExecutionProgress::Send(const char* data, size_t count) const
+{
+    BaseAsyncWorker* worker = _worker;
+    std::string message(data, count);
+    worker->Enqueued(count);
+    worker->_deliver.BlockingCall([worker, message](Napi::Env /*env*/, Function /*callback*/) {
+        worker->Dequeued(message.size());
+        worker->OnProgress(message.data(), message.size());
+    });
+}
+
+void BaseAsyncWorker::ExecutionProgress::Signal() const
 {
-        // disable verbose logging
-        OFLog::configure(OFLogger::WARN_LOG_LEVEL);
+    BaseAsyncWorker* worker = _worker;
+    worker->_deliver.BlockingCall([worker](Napi::Env /*env*/, Function /*callback*/) {
+        worker->OnProgress(NULL, 0);
+    });
 }
 
 void BaseAsyncWorker::OnOK()
 {
         HandleScope scope(Env());
-        std::string msg = ns::createJsonResponse(ns::SUCCESS, "request succeeded", _jsonOutput);
+        if (_nativeResult) {
+            nlohmann::json response = _error.empty() ? ns::createResponse(ns::SUCCESS, "request succeeded", std::move(_jsonOutput))
+                : nlohmann::json::parse(_error);
+            Callback().Call({toValue(Env(), response)});
+            return;
+        }
+        std::string msg = ns::createJsonResponse(ns::SUCCESS, "request succeeded", std::move(_jsonOutput));
         if (_error.length() > 0) msg = _error;
         String o = String::New(Env(), msg);
         Callback().Call({o});
@@ -25,10 +345,633 @@ void BaseAsyncWorker::OnOK()
 void BaseAsyncWorker::OnProgress(const char *data, size_t size)
 {
         HandleScope scope(Env());
+
+        // an empty progress message (Signal) tells us that a queued message is waiting
+        if (size == 0 && _batchSize > 1) {
+            DeliverBatches();
+            return;
+        }
+        if (size == 0) {
+            sQueuedMessage message;
+            {
+                std::lock_guard<std::mutex> lock(_queueMutex);
+                if (_queuedMessages.empty()) return;
+                message = _queuedMessages.front();
+                _queuedMessages.pop_front();
+            }
+            Dequeued(message.bytes);
+            Napi::Value o = _nativeResult ? toValue(Env(), message.response)
+                : static_cast<Napi::Value>(String::New(Env(), ns::dumpResponse(message.response)));
+            if (message.data == NULL) {
+                Callback().Call({o});
+                return;
+            }
+            Buffer<unsigned char> b = externalBuffer(Env(), message.data, message.length);
+            Callback().Call({o, b});
+            return;
+        }
+
         String o = String::New(Env(), data, size);
         Callback().Call({o});
 }
 
+void BaseAsyncWorker::DeliverBatches()
+{
+    std::deque<sQueuedMessage> messages;
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        messages.swap(_queuedMessages);
+        _deliveryPending = false;
+    }
+    while (!messages.empty()) {
+        Array batch = Array::New(Env());
+        while (!messages.empty() && batch.Length() < _batchSize) {
+            sQueuedMessage message = messages.front();
+            Napi::Value o = _nativeResult ? toValue(Env(), message.response)
+                : static_cast<Napi::Value>(String::New(Env(), ns::dumpResponse(message.response)));
+            if (message.data != NULL) {
+                // buffers are not batched, everything before them is delivered first
+                if (batch.Length() > 0) break;
+                messages.pop_front();
+                Dequeued(message.bytes);
+                Buffer<unsigned char> b = externalBuffer(Env(), message.data, message.length);
+                Callback().Call({o, b});
+                continue;
+            }
+            messages.pop_front();
+            Dequeued(message.bytes);
+            batch.Set(batch.Length(), o);
+        }
+        if (batch.Length() > 0) {
+            Callback().Call({batch});
+        }
+    }
+}
+
+void BaseAsyncWorker::Enqueued(size_t bytes)
+{
+    progressQueueMessages().add(1);
+    progressQueueBytes().add(static_cast<int64_t>(bytes));
+    std::lock_guard<std::mutex> lock(_inFlightMutex);
+    _inFlightBytes += bytes;
+    ++_inFlightMessages;
+}
+
+void BaseAsyncWorker::Dequeued(size_t bytes)
+{
+    progressQueueMessages().add(-1);
+    progressQueueBytes().add(-static_cast<int64_t>(bytes));
+    std::lock_guard<std::mutex> lock(_inFlightMutex);
+    _inFlightBytes -= bytes;
+    --_inFlightMessages;
+    _inFlightChanged.notify_all();
+}
+
+void BaseAsyncWorker::SetInFlightBudget(size_t maxBytes, size_t maxMessages)
+{
+    std::lock_guard<std::mutex> lock(_inFlightMutex);
+    _maxInFlightBytes = maxBytes;
+    _maxInFlightMessages = maxMessages;
+    _inFlightChanged.notify_all();
+}
+
+bool BaseAsyncWorker::AdmitInFlight(size_t bytes, bool wait)
+{
+    std::unique_lock<std::mutex> lock(_inFlightMutex);
+    auto fits = [this, bytes]() {
+        return _inFlightMessages == 0 ||
+            ((_maxInFlightBytes == 0 || _inFlightBytes + bytes <= _maxInFlightBytes) &&
+             (_maxInFlightMessages == 0 || _inFlightMessages < _maxInFlightMessages));
+    };
+    if (!wait) {
+        return fits();
+    }
+    // cancellation is not signalled through the condition, it is polled
+    while (!fits()) {
+        if (Cancelled()) {
+            return false;
+        }
+        _inFlightChanged.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    return true;
+}
+
+void BaseAsyncWorker::QueueMessage(const sQueuedMessage& message, const ExecutionProgress& progress)
+{
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _queuedMessages.push_back(message);
+        Enqueued(message.bytes);
+        if (_batchSize > 1) {
+            if (!_flusher.joinable() && !_stopFlusher) {
+                _flusher = std::thread([this]() { Flush(); });
+            }
+            // a full batch goes out right away, the flusher takes care of the rest
+            if (_deliveryPending || _queuedMessages.size() < _batchSize) return;
+            _deliveryPending = true;
+        }
+    }
+    progress.Signal();
+}
+
+void BaseAsyncWorker::Flush()
+{
+    std::unique_lock<std::mutex> lock(_queueMutex);
+    while (!_stopFlusher) {
+        _flushChanged.wait_for(lock, _flushInterval);
+        if (_stopFlusher || _deliveryPending || _queuedMessages.empty()) continue;
+        _deliveryPending = true;
+        lock.unlock();
+        ExecutionProgress(this).Signal();
+        lock.lock();
+    }
+}
+
+void BaseAsyncWorker::StopFlusher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _stopFlusher = true;
+    }
+    _flushChanged.notify_all();
+    if (_flusher.joinable()) {
+        _flusher.join();
+    }
+}
+
+namespace {
+    // instance data of the addon in an environment, destroyed when it is torn down
+    struct sEnvironmentData {
+        sEnvironmentData() : requests(std::make_shared<RequestRegistry>()) {}
+        ~sEnvironmentData() { requests->close(); }
+        std::shared_ptr<RequestRegistry> requests;
+    };
+}
+
+std::shared_ptr<RequestRegistry> RequestRegistry::of(Napi::Env env)
+{
+    sEnvironmentData* data = env.GetInstanceData<sEnvironmentData>();
+    if (data == NULL) {
+        data = new sEnvironmentData();
+        env.SetInstanceData(data);
+    }
+    return data->requests;
+}
+
+void RequestRegistry::add(BaseAsyncWorker* worker)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed) {
+        worker->Abandon();
+        return;
+    }
+    _workers.insert(worker);
+}
+
+void RequestRegistry::remove(BaseAsyncWorker* worker)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _workers.erase(worker);
+}
+
+void RequestRegistry::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    for (BaseAsyncWorker* worker : _workers) {
+        worker->Abandon();
+    }
+}
+
+void FlowControl::acquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _consumed.wait(lock, [this] { return _cancelled || _pending < _limit; });
+    ++_pending;
+}
+
+void FlowControl::release(size_t count)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = count < _pending ? _pending - count : 0;
+    }
+    _consumed.notify_all();
+}
+
+void FlowControl::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cancelled = true;
+    }
+    _consumed.notify_all();
+}
+
+Function BaseAsyncWorker::EnableFlowControl(Napi::Env env, size_t highWaterMark)
+{
+    std::shared_ptr<FlowControl> flowControl = std::make_shared<FlowControl>(highWaterMark > 0 ? highWaterMark : 1);
+    _flowControl = flowControl;
+    return Function::New(env, [flowControl](const CallbackInfo& info) -> Napi::Value {
+        double count = info.Length() > 0 && info[0].IsNumber() ? info[0].As<Number>().DoubleValue() : 1;
+        if (count < 0) {
+            flowControl->cancel();
+        }
+        else {
+            flowControl->release(static_cast<size_t>(count));
+        }
+        return info.Env().Undefined();
+    }, "acknowledge");
+}
+
+Function BaseAsyncWorker::CancelFunction(Napi::Env env)
+{
+    std::shared_ptr<std::atomic<bool>> cancelRequested = _cancelRequested;
+    std::shared_ptr<FlowControl> flowControl = _flowControl;
+    return Function::New(env, [cancelRequested, flowControl](const CallbackInfo& info) -> Napi::Value {
+        *cancelRequested = true;
+        if (flowControl) {
+            flowControl->cancel();
+        }
+        return info.Env().Undefined();
+    }, "cancel");
+}
+
+void BaseAsyncWorker::Abandon()
+{
+    *_cancelRequested = true;
+    if (_flowControl) {
+        _flowControl->cancel();
+    }
+}
+
+void BaseAsyncWorker::SendResponse(const nlohmann::json& response, const ExecutionProgress& progress, size_t payloadBytes)
+{
+    if (_flowControl) _flowControl->acquire();
+    if (!_nativeResult && _batchSize <= 1) {
+        std::string msg = ns::dumpResponse(response);
+        progress.Send(msg.c_str(), msg.length());
+        return;
+    }
+    QueueMessage({response, NULL, 0, payloadBytes}, progress);
+}
+
+void BaseAsyncWorker::SendBuffer(const nlohmann::json& response, unsigned char* data, size_t length, const ExecutionProgress& progress)
+{
+    if (_flowControl) _flowControl->acquire();
+    QueueMessage({response, data, length, length}, progress);
+}
+
+void BaseAsyncWorker::SetInput(const ns::sInput& input)
+{
+    _nativeInput = input;
+    _hasNativeInput = true;
+}
+
+ns::sInput BaseAsyncWorker::GetInput()
+{
+    ns::sInput in = _hasNativeInput ? _nativeInput : ns::parseInputJson(_input);
+    _nativeResult = in.nativeResult;
+    if (in.eventBatchSize > 1) {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _batchSize = static_cast<size_t>(in.eventBatchSize);
+        _flushInterval = std::chrono::milliseconds(in.eventFlushInterval > 0 ? in.eventFlushInterval : 20);
+    }
+    return in;
+}
+
+ns::sInput BaseAsyncWorker::ParseInput(const Object& options)
+{
+    ns::sInput in;
+    Value source = options.Get("source");
+    if (source.IsObject()) {
+        in.source = toIdent(options, "source");
+    }
+    Value target = options.Get("target");
+    if (target.IsObject()) {
+        in.target = toIdent(options, "target");
+    }
+    in.destination = toString(options, "destination");
+    in.storagePath = toString(options, "storagePath");
+    in.sourcePath = toString(options, "sourcePath");
+    in.netTransferPrefer = toString(options, "netTransferPrefer");
+    in.netTransferPropose = toString(options, "netTransferPropose");
+    in.writeTransfer = toString(options, "writeTransfer");
+    in.bulkDataTag = toString(options, "tag");
+    in.charset = toString(options, "charset");
+    in.pageToken = toString(options, "pageToken");
+    in.changeToken = toString(options, "changeToken");
+    in.ingestDurability = toString(options, "ingestDurability");
+    in.writeDurability = toString(options, "writeDurability");
+    in.inFlightPolicy = toString(options, "inFlightPolicy");
+    in.seriesComplete = toString(options, "seriesComplete");
+    in.indexBackend = toString(options, "indexBackend");
+    in.indexConnection = toString(options, "indexConnection");
+    in.storageBackend = toString(options, "storageBackend");
+    in.storageUrl = toString(options, "storageUrl");
+    in.storageRegion = toString(options, "storageRegion");
+    in.storageAccessKey = toString(options, "storageAccessKey");
+    in.storageSecretKey = toString(options, "storageSecretKey");
+    in.clusterNode = toString(options, "clusterNode");
+    in.clusterHost = toString(options, "clusterHost");
+    in.moveOrder = toString(options, "moveOrder");
+    in.priority = toString(options, "priority");
+    in.stopAtTag = toString(options, "stopAtTag");
+    in.bulkDataURI = toString(options, "bulkDataURI");
+    in.format = toString(options, "format");
+    in.storageMode = toString(options, "storageMode");
+    in.profile = toString(options, "profile");
+    in.fileSetId = toString(options, "fileSetId");
+
+    in.tags = toTags(options.Get("tags"));
+    Value queries = options.Get("queries");
+    if (queries.IsArray()) {
+        Array list = queries.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            in.queries.push_back(toTags(list.Get(i)));
+        }
+    }
+
+    Value peers = options.Get("peers");
+    if (peers.IsArray()) {
+        Array list = peers.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsObject()) {
+                ns::sIdent peer;
+                peer.aet = toString(item.As<Object>(), "aet");
+                peer.ip = toString(item.As<Object>(), "ip");
+                peer.port = toInt(item.As<Object>(), "port");
+                peer.compression = toString(item.As<Object>(), "compression");
+                peer.priority = toString(item.As<Object>(), "priority");
+                in.peers.push_back(peer);
+            }
+        }
+    }
+
+    Value rules = options.Get("forwardRules");
+    if (rules.IsArray()) {
+        Array list = rules.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsObject()) {
+                ns::sForwardRule rule;
+                rule.callingAet = toString(item.As<Object>(), "callingAet");
+                rule.modality = toString(item.As<Object>(), "modality");
+                rule.sopClass = toString(item.As<Object>(), "sopClass");
+                rule.destination = toIdent(item.As<Object>(), "destination");
+                rule.format = toString(item.As<Object>(), "format");
+                in.forwardRules.push_back(rule);
+            }
+        }
+    }
+
+    Value storeRules = options.Get("storeRules");
+    if (storeRules.IsArray()) {
+        Array list = storeRules.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsObject()) {
+                ns::sStoreRule rule;
+                rule.callingAet = toString(item.As<Object>(), "callingAet");
+                rule.calledAet = toString(item.As<Object>(), "calledAet");
+                rule.callingHost = toString(item.As<Object>(), "callingHost");
+                rule.sopClass = toString(item.As<Object>(), "sopClass");
+                rule.tags = toTags(item.As<Object>().Get("tags"));
+                rule.action = toString(item.As<Object>(), "action");
+                rule.storagePath = toString(item.As<Object>(), "storagePath");
+                in.storeRules.push_back(rule);
+            }
+        }
+    }
+
+    Value jobs = options.Get("jobs");
+    if (jobs.IsArray()) {
+        Array list = jobs.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsObject()) {
+                ns::sPrefetchJob job;
+                job.patientId = toString(item.As<Object>(), "patientId");
+                job.tags = toTags(item.As<Object>().Get("tags"));
+                job.peer = toIdent(item.As<Object>(), "peer");
+                job.priority = toString(item.As<Object>(), "priority");
+                in.jobs.push_back(job);
+            }
+        }
+    }
+
+    Value anonymizeRules = options.Get("rules");
+    if (anonymizeRules.IsArray()) {
+        Array list = anonymizeRules.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsObject()) {
+                ns::sAnonymizeRule rule;
+                rule.tag = toString(item.As<Object>(), "tag");
+                rule.action = toString(item.As<Object>(), "action");
+                rule.value = toString(item.As<Object>(), "value");
+                in.anonymizeRules.push_back(rule);
+            }
+        }
+    }
+    in.uidRoot = toString(options, "uidRoot");
+    in.uidMapPath = toString(options, "uidMapPath");
+
+    Value destinations = options.Get("proxyDestinations");
+    if (destinations.IsArray()) {
+        Array list = destinations.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsObject()) {
+                ns::sIdent destination;
+                destination.aet = toString(item.As<Object>(), "aet");
+                destination.ip = toString(item.As<Object>(), "ip");
+                destination.port = toInt(item.As<Object>(), "port");
+                in.proxyDestinations.push_back(destination);
+            }
+        }
+    }
+
+    in.eventTags = toStringList(options, "eventTags");
+    in.includeTags = toStringList(options, "includeTags");
+    in.sourcePaths = toStringList(options, "sourcePaths");
+    Value datasets = options.Get("datasets");
+    if (datasets.IsArray()) {
+        // the bytes are copied, the Buffers may change once the call returns
+        Array list = datasets.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsBuffer()) {
+                Buffer<char> buffer = item.As<Buffer<char> >();
+                in.datasets.push_back(std::string(buffer.Data(), buffer.Length()));
+            }
+            else if (item.IsString()) {
+                try {
+                    in.datasets.push_back(base64_decode(item.As<String>().Utf8Value()));
+                }
+                catch (...) {
+                    in.datasets.push_back(std::string());
+                }
+            }
+        }
+    }
+    Value jsonDatasets = options.Get("jsonDatasets");
+    if (jsonDatasets.IsArray()) {
+        Array list = jsonDatasets.As<Array>();
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value item = list.Get(i);
+            if (item.IsBuffer()) {
+                Buffer<char> buffer = item.As<Buffer<char> >();
+                in.jsonDatasets.push_back(std::string(buffer.Data(), buffer.Length()));
+            }
+            else if (item.IsString()) {
+                in.jsonDatasets.push_back(item.As<String>().Utf8Value());
+            }
+        }
+    }
+    Value bulkData = options.Get("bulkData");
+    if (bulkData.IsObject()) {
+        Object map = bulkData.As<Object>();
+        Array uris = map.GetPropertyNames();
+        for (uint32_t i = 0; i < uris.Length(); ++i) {
+            const std::string uri = uris.Get(i).As<String>().Utf8Value();
+            Value item = map.Get(uri);
+            if (item.IsBuffer()) {
+                Buffer<char> buffer = item.As<Buffer<char> >();
+                in.bulkData[uri] = std::string(buffer.Data(), buffer.Length());
+            }
+        }
+    }
+    in.modalities = toStringList(options, "modalities");
+    in.storageTransferSyntaxes = toStringList(options, "storageTransferSyntaxes");
+    in.region = toIntList(options, "region");
+    in.frames = toIntList(options, "frames");
+    in.window = toDoubleList(options, "window");
+
+    toBool(options, "permissive", in.permissive);
+    toBool(options, "verbose", in.verbose);
+    toBool(options, "storeOnly", in.storeOnly);
+    toBool(options, "writeFile", in.writeFile);
+    toBool(options, "binaryBuffer", in.binaryBuffer);
+    toBool(options, "nativeResult", in.nativeResult);
+    toBool(options, "enableRecompression", in.enableRecompression);
+    toBool(options, "reuseAssociation", in.reuseAssociation);
+    toBool(options, "streamToFile", in.streamToFile);
+    toBool(options, "compact", in.compact);
+    toBool(options, "arenaAllocation", in.arenaAllocation);
+    toBool(options, "pixelData", in.pixelData);
+    toBool(options, "skipDuplicates", in.skipDuplicates);
+    toBool(options, "linkDuplicates", in.linkDuplicates);
+    toBool(options, "packSeries", in.packSeries);
+    toBool(options, "proxySpill", in.proxySpill);
+    toBool(options, "seriesEventsOnly", in.seriesEventsOnly);
+    toBool(options, "seriesMetadata", in.seriesMetadata);
+    toBool(options, "pixelHashes", in.pixelHashes);
+    toBool(options, "pixelStats", in.pixelStats);
+    toBool(options, "worklist", in.worklist);
+    toBool(options, "storageCommitment", in.storageCommitment);
+    toBool(options, "warmStart", in.warmStart);
+    toBool(options, "removePrivateTags", in.removePrivateTags);
+    in.lossyQuality = toInt(options, "lossyQuality");
+    in.maxAssociations = toInt(options, "maxAssociations");
+    in.ingestBatchSize = toInt(options, "ingestBatchSize");
+    in.ingestMaxDelay = toInt(options, "ingestMaxDelay");
+    in.indexShards = toInt(options, "indexShards");
+    in.associationIdleTimeout = toInt(options, "associationIdleTimeout");
+    in.parallelism = toInt(options, "parallelism");
+    in.j2kThreads = toInt(options, "j2kThreads");
+    in.j2kLayers = toInt(options, "j2kLayers");
+    in.j2kProgression = toString(options, "j2kProgression");
+    in.restartRows = toInt(options, "restartRows");
+    in.transcodeCacheSize = toInt(options, "transcodeCacheSize");
+    in.transcodeCachePath = toString(options, "transcodeCachePath");
+    in.compressThreads = toInt(options, "compressThreads");
+    in.storageCacheSize = toInt(options, "storageCacheSize");
+    in.tierAfterDays = toInt(options, "tierAfterDays");
+    in.coldPath = toString(options, "coldPath");
+    in.fileMapCacheSize = toInt(options, "fileMapCacheSize");
+    in.bufferPoolSize = toInt(options, "bufferPoolSize");
+    in.maxInFlightSize = toInt(options, "maxInFlightSize");
+    in.maxInFlightMessages = toInt(options, "maxInFlightMessages");
+    in.manifestPath = toString(options, "manifestPath");
+    in.moveAssociations = toInt(options, "moveAssociations");
+    in.forwardQueuePath = toString(options, "forwardQueuePath");
+    in.forwardAssociations = toInt(options, "forwardAssociations");
+    in.peerAssociations = toInt(options, "peerAssociations");
+    in.moveReadAhead = toInt(options, "moveReadAhead");
+    in.findReadAhead = toInt(options, "findReadAhead");
+    in.prioritySlots = toInt(options, "prioritySlots");
+    in.asyncOperations = toInt(options, "asyncOperations");
+    in.writeThreads = toInt(options, "writeThreads");
+    in.storageShardDigits = toInt(options, "storageShardDigits");
+    in.eventLoopThreads = toInt(options, "eventLoopThreads");
+    in.eventBatchSize = toInt(options, "eventBatchSize");
+    in.eventFlushInterval = toInt(options, "eventFlushInterval");
+    in.seriesQuietPeriod = toInt(options, "seriesQuietPeriod");
+    in.chunkSize = toInt(options, "chunkSize");
+    in.maxResults = toInt(options, "maxResults");
+    in.pageSize = toInt(options, "pageSize");
+    in.cacheTtl = toInt(options, "cacheTtl");
+    in.findCacheSize = toInt(options, "findCacheSize");
+    in.deadline = toInt(options, "deadline");
+    in.rate = toInt(options, "rate");
+    in.duration = toInt(options, "duration");
+    in.maxRequests = toInt(options, "maxRequests");
+    in.patients = toInt(options, "patients");
+    in.studiesPerPatient = toInt(options, "studiesPerPatient");
+    in.seriesPerStudy = toInt(options, "seriesPerStudy");
+    in.instancesPerSeries = toInt(options, "instancesPerSeries");
+    in.seed = toInt(options, "seed");
+    in.frame = toInt(options, "frame");
+    in.reduce = toInt(options, "reduce");
+    in.offset = toInt64(options, "offset");
+    in.length = toInt64(options, "length");
+    in.width = toInt(options, "width");
+    in.height = toInt(options, "height");
+    in.poolThreads = toInt(options, "poolThreads");
+    in.poolQueueSize = toInt(options, "poolQueueSize");
+    in.aeLimits = toRateLimit(options, "aeLimits");
+    in.ipLimits = toRateLimit(options, "ipLimits");
+    in.indexTuning = toIndexTuning(options, "indexTuning");
+    in.network.maxPdu = toInt(options, "maxPdu");
+    in.network.socketBufferSize = toInt(options, "socketBufferSize");
+    Value extendedOffsetTable = options.Get("extendedOffsetTable");
+    if (extendedOffsetTable.IsBoolean()) {
+        in.extendedOffsetTable = extendedOffsetTable.As<Boolean>().Value() ? 1 : 0;
+    }
+    in.largeObjectSize = toInt(options, "largeObjectSize");
+    in.directWriteSize = toInt(options, "directWriteSize");
+    in.compressionCpuBudget = toInt(options, "compressionCpuBudget");
+    in.clusterHeartbeat = toInt(options, "clusterHeartbeat");
+    in.network.tcpKeepAlive = toInt(options, "tcpKeepAlive");
+    in.network.tcpKeepAliveInterval = toInt(options, "tcpKeepAliveInterval");
+    in.network.acseTimeout = toInt(options, "acseTimeout");
+    Value dimseTimeout = options.Get("dimseTimeout");
+    if (dimseTimeout.IsNumber()) {
+        in.network.dimseTimeout = dimseTimeout.As<Number>().Int32Value();
+    }
+    Value tcpNoDelay = options.Get("tcpNoDelay");
+    if (tcpNoDelay.IsBoolean()) {
+        in.network.tcpNoDelay = tcpNoDelay.As<Boolean>().Value() ? 1 : 0;
+    }
+    toBool(options, "tls", in.network.tls);
+    in.network.tlsCertificate = toString(options, "tlsCertificate");
+    in.network.tlsPrivateKey = toString(options, "tlsPrivateKey");
+    in.network.tlsCaCertificates = toString(options, "tlsCaCertificates");
+    in.network.tlsCiphers = toString(options, "tlsCiphers");
+    Value tlsVerifyPeer = options.Get("tlsVerifyPeer");
+    if (tlsVerifyPeer.IsBoolean()) {
+        in.network.tlsVerifyPeer = tlsVerifyPeer.As<Boolean>().Value() ? 1 : 0;
+    }
+    in.network.tlsServerName = toString(options, "tlsServerName");
+    if (in.network.tlsServerName.empty()) {
+        in.network.tlsServerName = in.target.ip;
+    }
+    toBool(options, "ioUring", in.network.ioUring);
+    return in;
+}
+
 void BaseAsyncWorker::SetErrorJson(const std::string& message)
 {
        _error =  ns::createJsonResponse(ns::FAILURE, message);
@@ -37,15 +980,14 @@ void BaseAsyncWorker::SetErrorJson(const std::string& message)
 
 void BaseAsyncWorker::SendInfo(const std::string& msg, const ExecutionProgress& progress, ns::eStatus status)
 {
-    std::string msg2 = ns::createJsonResponse(status, msg);
-    progress.Send(msg2.c_str(), msg2.length());
+    SendResponse(ns::createResponse(status, msg), progress);
 }
 
 void BaseAsyncWorker::EnableVerboseLogging(bool enabled)
 {
-    if (enabled) {
-        OFLog::configure(OFLogger::DEBUG_LOG_LEVEL);
-    } else {
-        OFLog::configure(OFLogger::WARN_LOG_LEVEL);
+    // debug output of this request only, other requests and the SCPs keep logging warnings
+    if (enabled && !_verbose) {
+        _verbose = true;
+        OFLog::setThreadLogLevel(OFLogger::DEBUG_LOG_LEVEL);
     }
 }
@@ -2,21 +2,143 @@
 
 #include <napi.h>
 #include <iostream>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <set>
 
 #include "json.h"
 #include "Utils.h"
 
 using namespace Napi;
 
-class BaseAsyncWorker : public AsyncProgressQueueWorker<char>
+// bounds the number of progress messages handed to JS but not yet consumed,
+// shared with the acknowledge function returned to JS which may outlive the worker
+class FlowControl
 {
     public:
+        explicit FlowControl(size_t limit) : _limit(limit), _pending(0), _cancelled(false) {}
+
+        // blocks the worker thread until the consumer caught up
+        void acquire();
+
+        // called from JS when count messages have been consumed
+        void release(size_t count);
+
+        // lifts the limit for good, e.g. when the consumer went away
+        void cancel();
+
+    private:
+        size_t _limit;
+        size_t _pending;
+        bool _cancelled;
+        std::mutex _mutex;
+        std::condition_variable _consumed;
+};
+
+class BaseAsyncWorker;
+
+// the requests started from one JS environment, the main thread or a worker_thread. Those still
+// running when the environment is torn down are abandoned, their results cannot be delivered anymore.
+// Shared by the workers, which may outlive the environment
+class RequestRegistry
+{
+    public:
+        RequestRegistry() : _closed(false) {}
+
+        // the registry of env, created with the instance data of the addon on first use
+        static std::shared_ptr<RequestRegistry> of(Napi::Env env);
+
+        void add(BaseAsyncWorker* worker);
+
+        void remove(BaseAsyncWorker* worker);
+
+        // abandons the registered requests and those added from now on
+        void close();
+
+    private:
+        std::mutex _mutex;
+        std::set<BaseAsyncWorker*> _workers;
+        bool _closed;
+};
+
+// Runs Execute on the native DimseExecutor instead of the libuv threadpool, progress and
+// results are handed to the JS thread through a thread safe function
+class BaseAsyncWorker
+{
+    public:
+        // same interface as AsyncProgressQueueWorker<char>::ExecutionProgress, may be used from any thread
+        class ExecutionProgress
+        {
+            public:
+                void Send(const char* data, size_t count) const;
+
+                // announces a queued message without payload
+                void Signal() const;
+
+            private:
+                friend class BaseAsyncWorker;
+                explicit ExecutionProgress(BaseAsyncWorker* worker) : _worker(worker) {}
+                BaseAsyncWorker* _worker;
+        };
+
         BaseAsyncWorker(std::string data, Function &callback);
 
+        virtual ~BaseAsyncWorker();
+
+        // queues the request on the executor lane of the operation, the worker deletes itself
+        // once the result has been delivered
+        void Queue(const std::string& operation);
+
+        virtual void Execute(const ExecutionProgress& progress) = 0;
+
         virtual void OnOK();
         
         virtual void OnProgress(const char *data, size_t size);
 
+        Napi::Env Env() const { return _env; }
+
+        FunctionReference& Callback() { return _callback; }
+
+        // sends a progress response, as JS object in native result mode or as JSON text otherwise.
+        // With eventBatchSize, JS receives arrays of up to that many responses. payloadBytes is the
+        // size of large strings in the response, counted in flight while it waits as JSON
+        void SendResponse(const nlohmann::json& response, const ExecutionProgress& progress, size_t payloadBytes = 0);
+
+        // hands data (allocated with BufferPool::acquire()) to JS as an external buffer, ownership is transferred
+        void SendBuffer(const nlohmann::json& response, unsigned char* data, size_t length, const ExecutionProgress& progress);
+
+        // options read natively from a JS object, takes precedence over the JSON input
+        void SetInput(const ns::sInput& input);
+
+        // reads the options object on the main thread, mirrors ns::parseInputJson
+        static ns::sInput ParseInput(const Object& options);
+
+        // bounds the progress messages in flight, returns the function JS calls with the
+        // number of consumed messages (or a negative number to lift the limit)
+        Function EnableFlowControl(Napi::Env env, size_t highWaterMark);
+
+        // limits the bytes and messages in flight to JS, i.e. sent and not yet delivered to the
+        // callback, 0 is no limit
+        void SetInFlightBudget(size_t maxBytes, size_t maxMessages);
+
+        // true if a message of bytes fits into the in-flight budget. With wait, blocks until it
+        // does or the request is cancelled. A message always fits while nothing is in flight;
+        // concurrent senders may overshoot the budget by one message each
+        bool AdmitInFlight(size_t bytes, bool wait);
+
+        // returns the function JS calls to cancel the request, SCU workers check Cancelled() whenever
+        // a response arrives and stop with a C-CANCEL or after the current C-STORE. Lifts the
+        // flow control limit so a blocked worker gets to see the request
+        Function CancelFunction(Napi::Env env);
+
+        // stops the request from any thread as its environment is torn down, like a cancel from JS
+        virtual void Abandon();
+
     protected:
 
         void SetErrorJson(const std::string& message);
@@ -25,7 +147,86 @@ class BaseAsyncWorker : public AsyncProgressQueueWorker<char>
 
         void EnableVerboseLogging(bool enabled);
 
+        // options of the request, either set natively or parsed from the JSON input,
+        // also selects the result mode
+        ns::sInput GetInput();
+
+        // true if results are handed to JS as objects instead of JSON text
+        bool NativeResult() const { return _nativeResult; }
+
+        bool Cancelled() const { return _cancelRequested->load(); }
+
+        // stays valid as long as the worker
+        const std::atomic<bool>* CancelFlag() const { return _cancelRequested.get(); }
+
         std::string _input;
+        ns::sInput _nativeInput;
+        bool _hasNativeInput;
+        bool _nativeResult;
         nlohmann::json _jsonOutput;
         std::string _error;
+
+    private:
+
+        void Run();
+
+        // messages handed over through Signal(), data is NULL if there is no buffer attached
+        struct sQueuedMessage {
+            nlohmann::json response;
+            unsigned char* data;
+            size_t length;
+            // counted against the in-flight budget
+            size_t bytes;
+        };
+
+        // accounts a message handed to the JS thread and one delivered to the callback
+        void Enqueued(size_t bytes);
+        void Dequeued(size_t bytes);
+
+        // queues a message and signals JS, in batched mode only once a batch is full
+        void QueueMessage(const sQueuedMessage& message, const ExecutionProgress& progress);
+
+        // hands all queued messages to JS, up to _batchSize per callback, on the JS thread
+        void DeliverBatches();
+
+        // signals partial batches every _flushInterval until stopped
+        void Flush();
+
+        void StopFlusher();
+
+        // executor lane, priority class and submission time, for the queue wait and execution time metrics
+        std::string _operation;
+        std::string _priority;
+        std::chrono::steady_clock::time_point _queued;
+
+        Napi::Env _env;
+        FunctionReference _callback;
+        ThreadSafeFunction _deliver;
+
+        std::deque<sQueuedMessage> _queuedMessages;
+        std::mutex _queueMutex;
+        std::shared_ptr<FlowControl> _flowControl;
+        // shared with the cancel function returned to JS which may outlive the worker
+        std::shared_ptr<std::atomic<bool>> _cancelRequested;
+        // of the environment that queued the request
+        std::shared_ptr<RequestRegistry> _registry;
+
+        // more than one message per callback, set from sInput::eventBatchSize
+        size_t _batchSize;
+        std::chrono::milliseconds _flushInterval;
+        // a Signal() is on its way to JS, guarded by _queueMutex like the flusher state
+        bool _deliveryPending;
+        bool _stopFlusher;
+        // EnableVerboseLogging() set the log level of the executing thread
+        bool _verbose;
+        std::condition_variable _flushChanged;
+        std::thread _flusher;
+
+        // messages sent and not yet delivered, and the budget of SetInFlightBudget()
+        std::mutex _inFlightMutex;
+        std::condition_variable _inFlightChanged;
+        size_t _inFlightBytes;
+        size_t _inFlightMessages;
+        size_t _maxInFlightBytes;
+        size_t _maxInFlightMessages;
 };
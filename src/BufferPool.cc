@@ -0,0 +1,185 @@
+#include "BufferPool.h"
+#include "CpuPlacement.h"
+
+#include <cstring>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+#ifdef __GLIBC__
+#include <malloc.h> /* for malloc_trim() */
+#endif
+
+namespace {
+
+    // every buffer is preceded by its capacity and node, so release() needs no length
+    const size_t headerSize = 16;
+    const size_t nodeOffset = 8;
+
+    struct sIdleBuffer {
+        unsigned char* block;
+        std::chrono::steady_clock::time_point released;
+    };
+
+    std::mutex poolMutex;
+    // by node and capacity
+    std::map<std::pair<int, size_t>, std::vector<sIdleBuffer> > idleBuffers;
+    size_t maxBytes = 0;
+    size_t idleBytes = 0;
+    size_t busyBytes = 0;
+    size_t hitCount = 0;
+    size_t missCount = 0;
+
+    // quarter steps between powers of two waste at most a fifth of a buffer
+    size_t capacityFor(size_t length)
+    {
+        size_t power = BufferPool::minBufferSize;
+        if (length <= power) {
+            return power;
+        }
+        while (power * 2 < length) {
+            power *= 2;
+        }
+        const size_t step = power / 4;
+        return power + (length - power + step - 1) / step * step;
+    }
+
+    size_t capacityOf(const unsigned char* block)
+    {
+        size_t capacity;
+        memcpy(&capacity, block, sizeof(capacity));
+        return capacity;
+    }
+
+    // the node of the thread that allocated the buffer, where its pages were touched first
+    int nodeOf(const unsigned char* block)
+    {
+        int node;
+        memcpy(&node, block + nodeOffset, sizeof(node));
+        return node;
+    }
+
+    // moves idle buffers released before expiry, or all above the limit, to freed, the pool lock is held
+    void collect(std::chrono::steady_clock::time_point expiry, std::vector<unsigned char*>& freed)
+    {
+        for (auto it = idleBuffers.begin(); it != idleBuffers.end();) {
+            std::vector<sIdleBuffer>& buffers = it->second;
+            // buffers are reused from the back, the oldest ones are at the front
+            size_t expired = 0;
+            while (expired < buffers.size() && (buffers[expired].released < expiry || idleBytes > maxBytes)) {
+                freed.push_back(buffers[expired].block);
+                idleBytes -= it->first.second;
+                ++expired;
+            }
+            buffers.erase(buffers.begin(), buffers.begin() + expired);
+            it = buffers.empty() ? idleBuffers.erase(it) : ++it;
+        }
+    }
+
+    void freeBlocks(const std::vector<unsigned char*>& freed, bool trim)
+    {
+        for (unsigned char* block : freed) {
+            delete[] block;
+        }
+#ifdef __GLIBC__
+        // large blocks below the mmap threshold would otherwise stay in the heap
+        if (trim && !freed.empty()) {
+            malloc_trim(0);
+        }
+#else
+        (void)trim;
+#endif
+    }
+
+} // namespace
+
+const size_t BufferPool::minBufferSize;
+const int BufferPool::idleTimeout;
+
+unsigned char* BufferPool::acquire(size_t length)
+{
+    const size_t capacity = capacityFor(length);
+    // idle buffers of other nodes are left alone, a new one is local to the node that fills it
+    const int node = CpuPlacement::currentNode();
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        auto it = idleBuffers.find(std::make_pair(node, capacity));
+        if (it != idleBuffers.end()) {
+            unsigned char* block = it->second.back().block;
+            it->second.pop_back();
+            if (it->second.empty()) {
+                idleBuffers.erase(it);
+            }
+            idleBytes -= capacity;
+            busyBytes += capacity;
+            ++hitCount;
+            return block + headerSize;
+        }
+        ++missCount;
+        busyBytes += capacity;
+    }
+    unsigned char* block = new unsigned char[headerSize + capacity];
+    memcpy(block, &capacity, sizeof(capacity));
+    memcpy(block + nodeOffset, &node, sizeof(node));
+    return block + headerSize;
+}
+
+void BufferPool::release(unsigned char* data)
+{
+    if (data == NULL) {
+        return;
+    }
+    unsigned char* block = data - headerSize;
+    const size_t capacity = capacityOf(block);
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::vector<unsigned char*> freed;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        busyBytes -= capacity;
+        collect(now - std::chrono::milliseconds(idleTimeout), freed);
+        if (idleBytes + capacity <= maxBytes) {
+            idleBuffers[std::make_pair(nodeOf(block), capacity)].push_back({block, now});
+            idleBytes += capacity;
+            block = NULL;
+        }
+    }
+    // only expired buffers trim the heap, a buffer over the limit is just freed
+    freeBlocks(freed, true);
+    delete[] block;
+}
+
+void BufferPool::configure(size_t maxPooledBytes)
+{
+    std::vector<unsigned char*> freed;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        maxBytes = maxPooledBytes;
+        collect(std::chrono::steady_clock::time_point::min(), freed);
+    }
+    freeBlocks(freed, true);
+}
+
+size_t BufferPool::hits()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return hitCount;
+}
+
+size_t BufferPool::misses()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return missCount;
+}
+
+size_t BufferPool::pooledBytes()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return idleBytes;
+}
+
+size_t BufferPool::inUseBytes()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return busyBytes;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+// Process wide pool of serialization buffers for the in-memory store paths (BUFFER_STORAGE,
+// recompression to memory). Buffers are rounded up to size classes in quarter steps between
+// powers of two, starting at 64 KB, and released ones are kept for reuse by later instances
+// and associations up to a total of maxPooledBytes. Pooled buffers unused for idleTimeout
+// ms are freed and the heap is trimmed, so a burst does not pin its memory forever. Idle buffers
+// are kept per NUMA node and reused on the node that allocated them.
+class BufferPool
+{
+public:
+    // returns a buffer of at least length bytes, to be given back with release()
+    static unsigned char* acquire(size_t length);
+
+    // gives a buffer from acquire() back, it is pooled if it fits under the limit and freed otherwise
+    static void release(unsigned char* data);
+
+    // limits the bytes kept in idle buffers, 0 (the default) frees every released buffer
+    static void configure(size_t maxPooledBytes);
+
+    // number of acquire() calls served from the pool and from the heap
+    static size_t hits();
+    static size_t misses();
+
+    // bytes currently held in idle buffers
+    static size_t pooledBytes();
+
+    // bytes of the buffers handed out and not released yet, by capacity
+    static size_t inUseBytes();
+
+    // smallest size class (bytes)
+    static const size_t minBufferSize = 64 * 1024;
+
+    // idle buffers are freed after this time (ms)
+    static const int idleTimeout = 30000;
+};
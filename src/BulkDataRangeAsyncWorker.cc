@@ -0,0 +1,76 @@
+#include "BulkDataRangeAsyncWorker.h"
+
+#include <algorithm>
+
+#include "Utils.h"
+#include "BufferPool.h"
+#include "FrameIndex.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+
+#include "json.h"
+
+using json = nlohmann::json;
+
+BulkDataRangeAsyncWorker::BulkDataRangeAsyncWorker(std::string data, Function &callback)
+    : BaseAsyncWorker(data, callback) {
+}
+
+void BulkDataRangeAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.sourcePath.empty()) {
+        SetErrorJson("No source path set");
+        return;
+    }
+    DcmTagKey tag = DCM_PixelData;
+    if (!in.bulkDataTag.empty()) {
+        if (in.bulkDataTag.size() != 8 || in.bulkDataTag.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            SetErrorJson("Invalid tag " + in.bulkDataTag);
+            return;
+        }
+        tag = ns::toElement(in.bulkDataTag, "").xtag;
+    }
+
+    std::string error;
+    std::shared_ptr<const FrameIndex> index = FrameIndex::get(in.sourcePath, tag, error);
+    if (!index) {
+        SetErrorJson("Cannot index bulk data: " + error);
+        return;
+    }
+
+    const Uint64 total = index->streamLength();
+    const Uint64 offset = in.offset > 0 ? static_cast<Uint64>(in.offset) : 0;
+    if (offset > total) {
+        SetErrorJson("Offset beyond the end of the value");
+        return;
+    }
+    const Uint64 rest = total - offset;
+    const size_t length = static_cast<size_t>(in.length >= 0 ? std::min<Uint64>(static_cast<Uint64>(in.length), rest) : rest);
+
+    // the buffer is handed to JavaScript, it has to come from the pool
+    unsigned char *buffer = BufferPool::acquire(length);
+    OFCondition status = index->readRange(offset, length, buffer);
+    if (status.bad()) {
+        BufferPool::release(buffer);
+        SetErrorJson(std::string("Cannot read bulk data: ") + status.text());
+        return;
+    }
+
+    const DcmXfer xfer(index->transferSyntax());
+    json v = json::object();
+    v["Filepath"] = in.sourcePath;
+    v["offset"] = offset;
+    v["length"] = length;
+    v["totalLength"] = total;
+    v["TransferSyntaxUID"] = xfer.getXferID();
+    v["encapsulated"] = index->encapsulated();
+    SendBuffer(ns::createResponse(ns::PENDING, "BULK_DATA_RANGE", v), buffer, length, progress);
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// reads a byte range of the value of a top level element as stored, e.g. of the video stream in the
+// fragments of MPEG-2, MPEG-4 or HEVC pixel data. Only the bytes of the range are read, located by
+// a cached FrameIndex
+class BulkDataRangeAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        BulkDataRangeAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
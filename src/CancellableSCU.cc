@@ -0,0 +1,46 @@
+#include "CancellableSCU.h"
+
+#include "dcmtk/dcmnet/diutil.h"
+
+void CancellableSCU::setCancelFlag(const std::atomic<bool>* cancelled)
+{
+    m_cancelled = cancelled;
+    m_cancelSent = false;
+    m_stopRequested = false;
+    m_findResponseHandler = nullptr;
+    m_moveResponseHandler = nullptr;
+}
+
+OFCondition CancellableSCU::cancelIfRequested(const T_ASC_PresentationContextID presID)
+{
+    if (m_cancelSent || (!m_stopRequested && (m_cancelled == NULL || !m_cancelled->load()))) {
+        return EC_Normal;
+    }
+    m_cancelSent = true;
+    DCMNET_INFO((m_stopRequested ? "Enough responses received" : "Request cancelled") << ", waiting for the final response");
+    return sendCANCELRequest(presID);
+}
+
+OFCondition CancellableSCU::handleFINDResponse(const T_ASC_PresentationContextID presID, QRResponse* response, OFBool& waitForNextResponse)
+{
+    OFCondition cond = DcmSCU::handleFINDResponse(presID, response, waitForNextResponse);
+    if (cond.good() && waitForNextResponse && m_findResponseHandler && response->m_dataset != NULL && !m_cancelSent) {
+        m_stopRequested = !m_findResponseHandler(response->m_dataset);
+    }
+    return cond.good() && waitForNextResponse ? cancelIfRequested(presID) : cond;
+}
+
+OFCondition CancellableSCU::handleMOVEResponse(const T_ASC_PresentationContextID presID, RetrieveResponse* response, OFBool& waitForNextResponse)
+{
+    OFCondition cond = DcmSCU::handleMOVEResponse(presID, response, waitForNextResponse);
+    if (cond.good() && m_moveResponseHandler) {
+        m_moveResponseHandler(*response);
+    }
+    return cond.good() && waitForNextResponse ? cancelIfRequested(presID) : cond;
+}
+
+OFCondition CancellableSCU::handleCGETResponse(const T_ASC_PresentationContextID presID, RetrieveResponse* response, OFBool& continueCGETSession)
+{
+    OFCondition cond = DcmSCU::handleCGETResponse(presID, response, continueCGETSession);
+    return cond.good() && continueCGETSession ? cancelIfRequested(presID) : cond;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/scu.h"
+
+// DcmSCU that answers a cancel request of the JS side with a C-CANCEL for the running C-FIND,
+// C-GET or C-MOVE. The flag is checked whenever a pending response arrives, the request then
+// ends with the final response of the peer (or the DIMSE timeout)
+class CancellableSCU : public DcmSCU
+{
+public:
+    CancellableSCU() : m_cancelled(NULL), m_cancelSent(false), m_stopRequested(false) {}
+
+    // flag of the request running on the association, NULL if it cannot be cancelled.
+    // Starts a new request, the response handlers are reset
+    void setCancelFlag(const std::atomic<bool>* cancelled);
+
+    // called with the identifiers of each pending C-FIND response, returning false cancels the request
+    void setFindResponseHandler(const std::function<bool(DcmDataset*)>& handler) { m_findResponseHandler = handler; }
+
+    // called with each C-MOVE response, the last one carries the final status
+    void setMoveResponseHandler(const std::function<void(const RetrieveResponse&)>& handler) { m_moveResponseHandler = handler; }
+
+    // true once a C-CANCEL has been sent for the current request
+    bool cancelSent() const { return m_cancelSent; }
+
+protected:
+    virtual OFCondition handleFINDResponse(const T_ASC_PresentationContextID presID, QRResponse* response, OFBool& waitForNextResponse);
+
+    virtual OFCondition handleMOVEResponse(const T_ASC_PresentationContextID presID, RetrieveResponse* response, OFBool& waitForNextResponse);
+
+    virtual OFCondition handleCGETResponse(const T_ASC_PresentationContextID presID, RetrieveResponse* response, OFBool& continueCGETSession);
+
+private:
+    // sends the C-CANCEL once the flag is set, at most once per request
+    OFCondition cancelIfRequested(const T_ASC_PresentationContextID presID);
+
+    const std::atomic<bool>* m_cancelled;
+    bool m_cancelSent;
+    bool m_stopRequested;
+    std::function<bool(DcmDataset*)> m_findResponseHandler;
+    std::function<void(const RetrieveResponse&)> m_moveResponseHandler;
+};
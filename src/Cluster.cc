@@ -0,0 +1,175 @@
+#include "Cluster.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "dcmtk/dcmnet/diutil.h"
+
+#include "Metrics.h"
+
+namespace
+{
+
+std::mutex clusterMutex;
+std::condition_variable stopRequested;
+std::thread heartbeatThread;
+bool joined = false;
+bool stopping = false;
+DcmClusterNode self;
+std::vector<DcmClusterNode> live;
+
+// true if path is root or below it
+bool isBelow(const std::string& path, const std::string& root)
+{
+    if (root.empty() || path.compare(0, root.size(), root) != 0) {
+        return false;
+    }
+    if (path.size() == root.size()) {
+        return true;
+    }
+    const char separator = root[root.size() - 1] == '/' || root[root.size() - 1] == '\\' ? root[root.size() - 1] : path[root.size()];
+    return separator == '/' || separator == '\\';
+}
+
+// announces node and reads the live nodes, false if the index keeps no membership
+bool beat(const DcmClusterNode& node, int heartbeat, std::vector<DcmClusterNode>& nodes)
+{
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(OFFilename(node.storagePath.c_str()));
+    if (db == NULL) {
+        return false;
+    }
+    const bool announced = db->announceNode(node);
+    if (announced && node.heartbeat > 0) {
+        nodes = db->clusterNodes(node.heartbeat - static_cast<long long>(heartbeat) * Cluster::missedHeartbeats);
+    }
+    DcmIndexDatabasePool::release(db);
+    return announced;
+}
+
+// logs the nodes that joined or left since the previous heartbeat
+void update(const std::vector<DcmClusterNode>& nodes)
+{
+    std::set<std::string> before;
+    std::set<std::string> after;
+    {
+        std::lock_guard<std::mutex> lock(clusterMutex);
+        for (const DcmClusterNode& node : live) {
+            before.insert(node.name);
+        }
+        live = nodes;
+    }
+    for (const DcmClusterNode& node : nodes) {
+        after.insert(node.name);
+        if (before.count(node.name) == 0) {
+            DCMNET_INFO("cluster: node " << node.name << " (" << node.aeTitle << "@" << node.host << ":" << node.port
+                << ", " << node.storagePath << ") joined");
+        }
+    }
+    for (const std::string& name : before) {
+        if (after.count(name) == 0) {
+            DCMNET_INFO("cluster: node " << name << " left");
+        }
+    }
+    Metrics::gauge("cluster_nodes").set(static_cast<int64_t>(nodes.size()));
+}
+
+}
+
+bool Cluster::join(const DcmClusterNode& node, int heartbeat)
+{
+    leave();
+    heartbeat = heartbeat > 0 ? heartbeat : defaultHeartbeat;
+
+    DcmClusterNode announced = node;
+    announced.heartbeat = static_cast<long long>(time(NULL));
+    std::vector<DcmClusterNode> nodes;
+    if (!beat(announced, heartbeat, nodes)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(clusterMutex);
+        self = announced;
+        joined = true;
+        stopping = false;
+    }
+    update(nodes);
+
+    heartbeatThread = std::thread([announced, heartbeat]() mutable {
+        std::unique_lock<std::mutex> lock(clusterMutex);
+        while (!stopRequested.wait_for(lock, std::chrono::seconds(heartbeat), [] { return stopping; })) {
+            lock.unlock();
+            announced.heartbeat = static_cast<long long>(time(NULL));
+            std::vector<DcmClusterNode> nodes;
+            if (beat(announced, heartbeat, nodes)) {
+                update(nodes);
+            }
+            else {
+                DCMNET_WARN("cluster: heartbeat of node " << announced.name << " failed");
+            }
+            lock.lock();
+        }
+    });
+    return true;
+}
+
+void Cluster::leave()
+{
+    DcmClusterNode node;
+    {
+        std::lock_guard<std::mutex> lock(clusterMutex);
+        if (!joined) {
+            return;
+        }
+        joined = false;
+        stopping = true;
+        node = self;
+    }
+    stopRequested.notify_all();
+    if (heartbeatThread.joinable()) {
+        heartbeatThread.join();
+    }
+
+    // the other nodes stop forwarding to this one with their next heartbeat
+    node.heartbeat = 0;
+    std::vector<DcmClusterNode> nodes;
+    beat(node, defaultHeartbeat, nodes);
+    {
+        std::lock_guard<std::mutex> lock(clusterMutex);
+        live.clear();
+    }
+    Metrics::gauge("cluster_nodes").set(0);
+    DCMNET_INFO("cluster: node " << node.name << " left");
+}
+
+bool Cluster::isJoined()
+{
+    std::lock_guard<std::mutex> lock(clusterMutex);
+    return joined;
+}
+
+std::vector<DcmClusterNode> Cluster::nodes()
+{
+    std::lock_guard<std::mutex> lock(clusterMutex);
+    return live;
+}
+
+bool Cluster::ownerOf(const std::string& filename, DcmClusterNode& node)
+{
+    std::lock_guard<std::mutex> lock(clusterMutex);
+    if (!joined || isBelow(filename, self.storagePath)) {
+        return false;
+    }
+    // the most specific storage path wins, e.g. of nodes with nested storage areas
+    size_t longest = 0;
+    for (const DcmClusterNode& other : live) {
+        if (other.name != self.name && other.storagePath.size() > longest && isBelow(filename, other.storagePath)) {
+            node = other;
+            longest = other.storagePath.size();
+        }
+    }
+    return longest > 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dcmidxdb.h"
+
+// Membership of the SCPs sharing an index, i.e. a PostgreSQL server or an SQLite index on a shared
+// volume. Each node announces its name, AE title, address and storage path in the index on every
+// heartbeat, nodes not heard of for missedHeartbeats heartbeats are gone. The files of a node are
+// below its storage path: a C-MOVE matching instances that another live node holds there, and that
+// cannot be read locally, is forwarded to that node, which sends them to the move destination
+// itself. Nodes sharing their storage, e.g. in the same object store, serve every instance.
+class Cluster
+{
+public:
+    // announces self in the index of its storage path every heartbeat seconds until leave(),
+    // false if the index backend keeps no membership
+    static bool join(const DcmClusterNode& self, int heartbeat);
+
+    // announces that this node left and stops the heartbeat
+    static void leave();
+
+    // true between join() and leave()
+    static bool isJoined();
+
+    // the live nodes as of the last heartbeat, including this one
+    static std::vector<DcmClusterNode> nodes();
+
+    // the live node other than this one that holds filename below its storage path, false for
+    // files of this node or of nodes that are gone
+    static bool ownerOf(const std::string& filename, DcmClusterNode& node);
+
+    // seconds between the announcements by default
+    static const int defaultHeartbeat = 5;
+
+    // a node missing this many heartbeats in a row is gone
+    static const int missedHeartbeats = 3;
+};
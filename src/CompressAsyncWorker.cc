@@ -6,6 +6,7 @@
 #include <sstream>
 
 #include "Utils.h"
+#include "DirectoryScanner.h"
 
 #include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
 
@@ -28,13 +29,28 @@
 #include "dcmtk/dcmdata/dcvrui.h"
 #include "dcmtk/dcmdata/dcmetinf.h"
 #include "dcmtk/dcmdata/dcdeftag.h"
-#include "dcmtk/dcmjpeg/djrplol.h"  /* for DJ_RPLossless */
-#include "dcmtk/dcmjpeg/djrploss.h" /* for DJ_RPLossy */
+#include "dcmtk/dcmdata/dcdatutl.h"
+#include "dcmtk/ofstd/ofcrc32.h"
 
 #ifdef WITH_ZLIB
 #include <zlib.h>
 #endif
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "json.h"
+
+using json = nlohmann::json;
+
 namespace
 {
   E_TransferSyntax lookForXfer(DcmMetaInfo *metainfo)
@@ -69,6 +85,26 @@ namespace
     return newxfer;
   }
 
+  // multi-frame images above this uncompressed size (bytes) are compressed one frame at a time,
+  // smaller ones at once so the codecs can spread the frames over threads
+  const double frameByFrameThreshold = 256.0 * 1024 * 1024;
+
+  bool isLargeMultiFrame(DcmDataset *dataset)
+  {
+    Sint32 frames = 1;
+    Uint16 rows = 0;
+    Uint16 columns = 0;
+    Uint16 samplesPerPixel = 1;
+    Uint16 bitsAllocated = 0;
+    dataset->findAndGetSint32(DCM_NumberOfFrames, frames);
+    dataset->findAndGetUint16(DCM_Rows, rows);
+    dataset->findAndGetUint16(DCM_Columns, columns);
+    dataset->findAndGetUint16(DCM_SamplesPerPixel, samplesPerPixel);
+    dataset->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+    const double size = static_cast<double>(rows) * columns * samplesPerPixel * ((bitsAllocated + 7) / 8) * frames;
+    return frames > 1 && size > frameByFrameThreshold;
+  }
+
   OFFilename convertToOsPath(OFFilename fpath)
   {
     std::string fullPath(fpath.getCharPointer());
@@ -79,19 +115,189 @@ namespace
 #endif
     return OFFilename(fullPath.c_str());
   }
+
+  // size and modification time of a file, false if it cannot be accessed
+  bool fileStatus(const OFFilename &fname, long long &size, long long &mtime)
+  {
+#ifdef HAVE_WINDOWS_H
+    struct _stati64 st;
+    if (_stati64(fname.getCharPointer(), &st) != 0)
+      return false;
+#else
+    struct stat st;
+    if (stat(fname.getCharPointer(), &st) != 0)
+      return false;
+#endif
+    size = static_cast<long long>(st.st_size);
+    mtime = static_cast<long long>(st.st_mtime);
+    return true;
+  }
+
+  // CRC32 of the file content, 0 if the file cannot be read
+  unsigned int fileChecksum(const OFFilename &fname)
+  {
+    OFFile file;
+    if (!file.fopen(fname, "rb"))
+      return 0;
+    OFCRC32 crc;
+    char buf[65536];
+    size_t len;
+    while ((len = file.fread(buf, 1, sizeof(buf))) > 0)
+      crc.addBlock(buf, static_cast<unsigned long>(len));
+    file.fclose();
+    return crc.getCRC32();
+  }
+
+  // persistent record of the files converted by earlier runs with the same settings,
+  // inputs whose size and modification time did not change are skipped without loading them
+  class RecompressManifest
+  {
+  public:
+    RecompressManifest(const std::string &path, const std::string &settings)
+      : m_path(path), m_settings(settings), m_entries(json::object()), m_pending(0)
+    {
+      std::ifstream stream(m_path.c_str());
+      if (!stream)
+        return;
+      json manifest = json::parse(stream, nullptr, false);
+      if (!manifest.is_object() || !manifest.contains("settings") || !manifest.contains("files"))
+      {
+        DCMNET_WARN("ignoring invalid recompression manifest: " << m_path);
+        return;
+      }
+      // a different transfer syntax or quality invalidates all entries
+      if (manifest["settings"] != m_settings)
+      {
+        DCMNET_INFO("recompression settings changed, ignoring manifest: " << m_path);
+        return;
+      }
+      m_entries = manifest["files"];
+      DCMNET_INFO("recompression manifest: " << m_entries.size() << " files");
+    }
+
+    bool unchanged(const OFFilename &infile, long long size, long long mtime) const
+    {
+      json::const_iterator it = m_entries.find(infile.getCharPointer());
+      if (it == m_entries.end())
+        return false;
+      const json &entry = *it;
+      if (entry.value("size", -1LL) != size || entry.value("mtime", -1LL) != mtime)
+        return false;
+      // the output must not have been removed or replaced either
+      long long outSize = 0, outMtime = 0;
+      const std::string output = entry.value("output", std::string());
+      return fileStatus(OFFilename(output.c_str()), outSize, outMtime) &&
+             entry.value("outputSize", -1LL) == outSize && entry.value("outputMtime", -1LL) == outMtime;
+    }
+
+    void record(const OFFilename &infile, const OFFilename &outfile, E_TransferSyntax xfer)
+    {
+      long long size = 0, mtime = 0, outSize = 0, outMtime = 0;
+      if (!fileStatus(infile, size, mtime) || !fileStatus(outfile, outSize, outMtime))
+        return;
+      json entry = json::object();
+      entry["size"] = size;
+      entry["mtime"] = mtime;
+      entry["xfer"] = DcmXfer(xfer).getXferID();
+      entry["output"] = outfile.getCharPointer();
+      entry["outputSize"] = outSize;
+      entry["outputMtime"] = outMtime;
+      entry["outputCrc32"] = fileChecksum(outfile);
+      m_entries[infile.getCharPointer()] = entry;
+      // saved from time to time, an interrupted run keeps most of its progress
+      if (++m_pending >= 1000)
+        save();
+    }
+
+    void save()
+    {
+      if (m_pending == 0)
+        return;
+      json manifest = json::object();
+      manifest["settings"] = m_settings;
+      manifest["files"] = m_entries;
+      const std::string tmpPath = m_path + "_";
+      {
+        std::ofstream stream(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+        stream << manifest.dump();
+        if (!stream)
+        {
+          DCMNET_WARN("failed writing recompression manifest: " << tmpPath);
+          return;
+        }
+      }
+      OFStandard::deleteFile(OFFilename(m_path.c_str()));
+      if (!OFStandard::renameFile(OFFilename(tmpPath.c_str()), OFFilename(m_path.c_str())))
+      {
+        DCMNET_WARN("failed renaming recompression manifest: " << tmpPath);
+        return;
+      }
+      m_pending = 0;
+    }
+
+  private:
+    std::string m_path;
+    std::string m_settings;
+    json m_entries;
+    size_t m_pending;
+  };
+
+  // queue between two pipeline stages, producers block while it is full
+  template <class T>
+  class BoundedQueue
+  {
+  public:
+    explicit BoundedQueue(size_t capacity) : m_capacity(std::max<size_t>(capacity, 1)), m_closed(false) {}
+
+    void push(const T &item)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_notFull.wait(lock, [this] { return m_items.size() < m_capacity; });
+      m_items.push_back(item);
+      m_notEmpty.notify_one();
+    }
+
+    // returns false once the queue is closed and drained
+    bool pop(T &item)
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+      if (m_items.empty())
+        return false;
+      item = m_items.front();
+      m_items.pop_front();
+      m_notFull.notify_one();
+      return true;
+    }
+
+    void close()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+      m_notEmpty.notify_all();
+    }
+
+  private:
+    size_t m_capacity;
+    bool m_closed;
+    std::deque<T> m_items;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+  };
 }
 
 CompressAsyncWorker::CompressAsyncWorker(std::string data, Function &callback)
     : BaseAsyncWorker(data, callback)
 {
-  ns::registerCodecs();
 }
 
 void CompressAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-  ns::sInput in = ns::parseInputJson(_input);
+  ns::sInput in = GetInput();
 
   EnableVerboseLogging(in.verbose);
+  ns::applyCodecSettings(in);
 
   if (in.sourcePath.empty())
   {
@@ -108,83 +314,139 @@ void CompressAsyncWorker::Execute(const ExecutionProgress &progress)
   DcmXfer writeTrans = in.writeTransfer.empty() ? DcmXfer(EXS_LittleEndianImplicit) : DcmXfer(in.writeTransfer.c_str());
   DCMNET_INFO("write transfer syntax: " << writeTrans.getXferName());
 
-  OFList<OFFilename> inputFiles;
-  OFList<OFFilename> fileNameList;
-
-  /* create list of input files */
-  DCMNET_INFO("determining input files ...");
-
-  OFFilename sourcePath(in.sourcePath.c_str());
-
-  if (OFStandard::dirExists(sourcePath))
-  {
-    OFStandard::searchDirectoryRecursively(sourcePath, inputFiles,
-                                           OFFilename() /*Pattern */, OFFilename() /*dirPrefix*/, OFTrue);
-  }
-  else if (OFStandard::fileExists(sourcePath))
-  {
-    inputFiles.push_back(sourcePath);
-  }
-
-  /* check whether there are any input files at all */
-  if (inputFiles.empty())
+  // incremental mode, files converted by an earlier run with the same settings are skipped
+  std::unique_ptr<RecompressManifest> manifest;
+  if (!in.manifestPath.empty())
   {
-    SetErrorJson("Invalid source path set, no DICOM files found");
-    return;
+    std::ostringstream settings;
+    settings << writeTrans.getXferID() << ";" << in.lossyQuality << ";" << in.enableRecompression << ";" << in.storagePath;
+    if (in.restartRows > 0) settings << ";" << in.restartRows;
+    manifest.reset(new RecompressManifest(in.manifestPath, settings.str()));
   }
-
-  /* check input files */
-  OFString errormsg;
-  OFBool ignoreName;
-  OFListIterator(OFFilename) if_iter = inputFiles.begin();
-  OFListIterator(OFFilename) if_last = inputFiles.end();
-
-  DCMNET_INFO("checking input files ...");
-  /* iterate over all input filenames */
-  while (if_iter != if_last)
-  {
-    ignoreName = OFFalse;
-    const OFFilename &currentFilename = (*if_iter);
-    if (OFStandard::fileExists(currentFilename))
+  std::atomic<size_t> unchangedFiles(0);
+
+  // list -> read -> transcode (parallel) -> write, the queues bound the number of datasets in memory
+  size_t threads = in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  BoundedQueue<sRecompressItem> loaded(2 * threads);
+  BoundedQueue<sRecompressItem> transcoded(2 * threads);
+  DCMNET_INFO("recompressing files using " << threads << " threads");
+
+  // files are checked and read by the threads listing the directories as soon as they are found,
+  // so recompression starts before the whole tree is listed
+  std::atomic<size_t> fileCount(0);
+  std::atomic<bool> listed(false);
+  const OFFilename sourcePath(in.sourcePath.c_str());
+  auto check = [this, &manifest, &unchangedFiles, &fileCount, &loaded](const OFFilename &currentFilename) {
+    long long size = 0, mtime = 0;
+    if (!fileStatus(currentFilename, size, mtime))
+    {
+      DCMNET_WARN("cannot access file: " << currentFilename.getCharPointer() << ", ignoring file");
+      return;
+    }
+    if (manifest && manifest->unchanged(currentFilename, size, mtime))
+    {
+      ++unchangedFiles;
+      return;
+    }
+    if (!isDicomFile(currentFilename) || Cancelled())
+    {
+      return;
+    }
+    sRecompressItem item;
+    item.infile = currentFilename;
+    load(item);
+    ++fileCount;
+    loaded.push(item);
+  };
+
+  // a cancelled request stops reading, the files already read are still written
+  DCMNET_INFO("determining input files ...");
+  std::thread reader([this, &loaded, &listed, &sourcePath, &check, threads]() {
+    if (OFStandard::dirExists(sourcePath))
+    {
+      DirectoryScanner::scan(sourcePath, threads, check, [this]() { return Cancelled(); });
+    }
+    else if (OFStandard::fileExists(sourcePath))
     {
-      if (!isDicomFile(currentFilename))
+      check(sourcePath);
+    }
+    listed = true;
+    loaded.close();
+  });
+
+  const OFString storePath(in.storagePath.c_str());
+  const E_TransferSyntax prefXfer = writeTrans.getXfer();
+  const ns::sRepresentationParameters repParams(in.lossyQuality, in.restartRows);
+  std::atomic<size_t> runningTranscoders(threads);
+  std::vector<std::thread> transcoders;
+  const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+  for (size_t i = 0; i < threads; ++i)
+  {
+    transcoders.push_back(std::thread([&, storePath, prefXfer]() {
+      OFLog::setThreadLogLevel(logLevel);
+      sRecompressItem item;
+      while (loaded.pop(item))
       {
-        ignoreName = OFTrue;
+        if (item.ok)
+        {
+          transcode(item, storePath, prefXfer, repParams, in.enableRecompression);
+        }
+        transcoded.push(item);
+        item = sRecompressItem();
       }
-
-      if (!ignoreName)
+      if (--runningTranscoders == 0)
       {
-        fileNameList.push_back(currentFilename);
+        transcoded.close();
       }
-    }
-    else
-    {
-      errormsg = "cannot access file: ";
-      errormsg += OFString(currentFilename.getCharPointer());
-      DCMNET_WARN(errormsg << ", ignoring file");
-    }
-    ++if_iter;
+    }));
   }
 
-  OFListIterator(OFFilename) iter = fileNameList.begin();
-  OFListIterator(OFFilename) enditer = fileNameList.end();
-
-  float fileCount = static_cast<float>(fileNameList.size());
-  float count = 0;
+  // the writer stage runs here, progress is reported whenever the percentage of the files found so far
+  // changes, once all are found
+  size_t count = 0;
+  int lastProgress = -1;
   bool validFileFound = false;
-  while ((iter != enditer))
+  sRecompressItem item;
+  while (transcoded.pop(item))
   {
-    if (recompress(*iter, OFString(in.storagePath.c_str()), writeTrans.getXfer(), in.lossyQuality, in.enableRecompression))
+    if (item.ok)
     {
-      validFileFound = true;
+      write(item);
+      if (item.ok && manifest)
+        manifest->record(item.infile, item.skipWrite ? item.infile : item.outfile, item.writeXfer);
     }
-    ++iter;
+    validFileFound = validFileFound || item.ok;
+    item = sRecompressItem();
     ++count;
-    int progress = (int)(count / fileCount * 100.0f);
-    DCMNET_INFO("Compress progress: " << progress);
+    if (!listed)
+      continue;
+    int percent = static_cast<int>(count * 100 / std::max<size_t>(fileCount, 1));
+    if (percent != lastProgress)
+    {
+      lastProgress = percent;
+      DCMNET_INFO("Compress progress: " << percent);
+      SendInfo(std::string("Compress progress: ") + std::to_string(percent), progress);
+    }
+  }
+
+  reader.join();
+  for (std::thread &transcoder : transcoders)
+  {
+    transcoder.join();
   }
+  if (manifest)
+    DCMNET_INFO("skipped " << unchangedFiles << " unchanged files");
 
-  if (!validFileFound)
+  if (manifest)
+    manifest->save();
+
+  if (Cancelled())
+  {
+    SetErrorJson("Request cancelled");
+    return;
+  }
+
+  if (!validFileFound && unchangedFiles == 0)
   {
     SetErrorJson("Invalid source path set, no DICOM files found");
   }
@@ -192,19 +454,27 @@ void CompressAsyncWorker::Execute(const ExecutionProgress &progress)
 
 OFBool CompressAsyncWorker::isDicomFile(const OFFilename &fname)
 {
-  // TODO: implement
-  return OFTrue;
+  return DcmDataUtil::isDicomFile(fname);
 }
 
-OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString &storePath, E_TransferSyntax _prefXfer, int quality, bool enableRecompression)
+void CompressAsyncWorker::load(sRecompressItem &item)
 {
-  DcmFileFormat dfile;
-  OFCondition status = dfile.loadFile(infile, EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect);
+  item.dfile = std::make_shared<DcmFileFormat>();
+  OFCondition status = item.dfile->loadFile(item.infile, EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect);
   if (status.bad())
   {
-    DCMNET_WARN("Failed loading file: " << infile.getCharPointer());
-    return OFFalse;
+    DCMNET_WARN("Failed loading file: " << item.infile.getCharPointer());
+    item.dfile.reset();
+    return;
   }
+  item.ok = true;
+}
+
+void CompressAsyncWorker::transcode(sRecompressItem &item, const OFString &storePath, E_TransferSyntax _prefXfer, const ns::sRepresentationParameters &repParams, bool enableRecompression)
+{
+  const OFFilename &infile = item.infile;
+  DcmFileFormat &dfile = *item.dfile;
+  item.ok = false;
 
   char sopClassUID[128];
   char sopInstanceUID[128];
@@ -212,7 +482,7 @@ OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString
   if (!found)
   {
     DCMNET_WARN("Failed reading SOPInstanceUid in file: " << infile.getCharPointer());
-    return OFFalse;
+    return;
   }
   OFFilename outfile(storePath + OFString("/") + OFString(sopInstanceUID));
   DCMNET_INFO("output: " << outfile.getCharPointer());
@@ -230,12 +500,15 @@ OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString
   if (!enableRecompression) 
   {
         DCMIMGLE_INFO("Recompressing files is disabled");
+    // deflate is the compression of non-image objects, the pixel data of images is still worth coding
+    OFString sopClassUID;
+    dfile.getMetaInfo()->findAndGetOFString(DCM_MediaStorageSOPClassUID, sopClassUID);
     if (originalXfer != EXS_Unknown &&
         originalXfer != EXS_LittleEndianImplicit &&
         originalXfer != EXS_BigEndianImplicit &&
         originalXfer != EXS_LittleEndianExplicit &&
         originalXfer != EXS_BigEndianExplicit &&
-        originalXfer != EXS_DeflatedLittleEndianExplicit) 
+        (originalXfer != EXS_DeflatedLittleEndianExplicit || !dcmIsImageStorageSOPClassUID(sopClassUID.c_str())))
         {
           DCMNET_INFO("File is compressed, not recompressing...");
           prefXfer = originalXfer;
@@ -249,33 +522,21 @@ OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString
     if (originalXfer == prefXfer)
     {
       DCMNET_INFO("file has correct Xfer already skipping...");
-      return OFTrue;
+      item.writeXfer = prefXfer;
+      item.skipWrite = true;
+      item.ok = true;
+      return;
     }
   }
 
-  // set quality factor
-  DcmXfer xfer(prefXfer);
-
-  // create RepresentationParameter
-  DJ_RPLossless rp_lossless(6, 0);
-  DJ_RPLossy rp_lossy(quality);
-
-  const DcmRepresentationParameter *rp = NULL;
-
-  if (xfer.getXfer() == EXS_JPEGProcess14SV1 || xfer.getXfer() == EXS_JPEGProcess14)
-  {
-    rp = &rp_lossless;
-  }
-  else if (xfer.getXfer() == EXS_JPEGProcess1 || xfer.getXfer() == EXS_JPEGProcess2_4)
-  {
-    rp = &rp_lossy;
-  }
-
+  const DcmRepresentationParameter *rp = repParams.get(prefXfer);
   if (rp)
-    DCMNET_INFO("Compression quality: " << quality);
+    DCMNET_INFO("Compression quality: " << repParams.lossy.getQuality());
 
-  // check if conversion is possible
-  OFCondition cond = dfile.chooseRepresentation(prefXfer, rp);
+  // check if conversion is possible, large multi-frame images never get decompressed completely
+  DcmDataset *dataset = dfile.getDataset();
+  OFCondition cond = isLargeMultiFrame(dataset) ? dataset->chooseRepresentationFrameByFrame(prefXfer, rp)
+    : dfile.chooseRepresentation(prefXfer, rp);
   if (cond.bad() || !dfile.canWriteXfer(prefXfer))
   {
     DCMNET_WARN("Failed compressing file: " << infile.getCharPointer() << " keeping original");
@@ -284,19 +545,40 @@ OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString
 
   if (cond.bad()) {
       DCMNET_WARN("Something went wrong");
-      return OFFalse;
+      return;
+  }
+
+  item.outfile = outfile;
+  item.writeXfer = prefXfer;
+  item.sameFile = isSameFile;
+  item.ok = true;
+}
+
+void CompressAsyncWorker::write(sRecompressItem &item)
+{
+  const OFFilename &outfile = item.outfile;
+  const E_TransferSyntax prefXfer = item.writeXfer;
+  DcmFileFormat &dfile = *item.dfile;
+  OFCondition cond;
+  item.ok = false;
+
+  if (item.skipWrite)
+  {
+    item.ok = true;
+    return;
   }
 
   // just save the file if output is different
-  if (!isSameFile)
+  if (!item.sameFile)
   {
     cond = dfile.saveFile(outfile, prefXfer);
     if (cond.bad())
     {
       DCMNET_WARN("Failed writing file to: " << outfile.getCharPointer());
-      return OFFalse;
+      return;
     }
-    return OFTrue;
+    item.ok = true;
+    return;
   }
 
   // write to temp file
@@ -306,7 +588,7 @@ OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString
   if (cond.bad())
   {
     DCMNET_WARN("Failed writing file to: " << tmpFile.getCharPointer());
-    return OFFalse;
+    return;
   }
 
   // delete original
@@ -315,7 +597,7 @@ OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString
   if (!success)
   {
     DCMNET_WARN("Failed deleting original file: " << outfile.getCharPointer());
-    return OFFalse;
+    return;
   }
 
   // rename to original
@@ -324,8 +606,8 @@ OFBool CompressAsyncWorker::recompress(const OFFilename &infile, const OFString
   if (!success)
   {
     DCMNET_WARN("Failed remaing file: " << tmpFile.getCharPointer() << " to: " << outfile.getCharPointer());
-    return OFFalse;
+    return;
   }
 
-  return OFTrue;
+  item.ok = true;
 }
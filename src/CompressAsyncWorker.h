@@ -9,6 +9,8 @@
 #include "dcmtk/dcmdata/dcxfer.h"
 #include "dcmtk/dcmdata/dcfilefo.h"
 
+#include <memory>
+
 using namespace Napi;
 
 class CompressAsyncWorker : public BaseAsyncWorker
@@ -19,6 +21,26 @@ class CompressAsyncWorker : public BaseAsyncWorker
         void Execute(const ExecutionProgress& progress);
 
     protected:
+        // one file passing the read, transcode and write stages
+        struct sRecompressItem {
+            sRecompressItem() : writeXfer(EXS_Unknown), sameFile(false), skipWrite(false), ok(false) {}
+            OFFilename infile;
+            OFFilename outfile;
+            std::shared_ptr<DcmFileFormat> dfile;
+            E_TransferSyntax writeXfer;
+            bool sameFile;
+            bool skipWrite;
+            bool ok;
+        };
+
         OFBool isDicomFile( const OFFilename &fname );
-        OFBool recompress(const OFFilename& infile, const OFString& storePath, E_TransferSyntax prefXfer, int quality, bool enableRecompression);
+
+        // reader stage, I/O bound
+        static void load(sRecompressItem& item);
+
+        // transcoding stage, CPU bound, runs on several threads
+        static void transcode(sRecompressItem& item, const OFString& storePath, E_TransferSyntax prefXfer, const ns::sRepresentationParameters& repParams, bool enableRecompression);
+
+        // writer stage, I/O bound
+        static void write(sRecompressItem& item);
 };
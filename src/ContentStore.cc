@@ -0,0 +1,208 @@
+#include "ContentStore.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_WINDOWS_H
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#include "Metrics.h"
+
+namespace
+{
+
+// FNV-1a of the file content and its size, false if it cannot be read
+bool hashFile(const std::string& path, Uint64& hash, Uint64& size)
+{
+    OFFile file;
+    if (!file.fopen(path.c_str(), "rb")) {
+        return false;
+    }
+    hash = 14695981039346656037ULL;
+    size = 0;
+    std::vector<unsigned char> buffer(1024 * 1024);
+    size_t length;
+    while ((length = file.fread(&buffer[0], 1, buffer.size())) > 0) {
+        for (size_t i = 0; i < length; ++i) {
+            hash = (hash ^ buffer[i]) * 1099511628211ULL;
+        }
+        size += length;
+    }
+    return file.error() == 0;
+}
+
+// byte by byte, a hash collision must not link different files
+bool sameContent(const std::string& a, const std::string& b)
+{
+    OFFile first;
+    OFFile second;
+    if (!first.fopen(a.c_str(), "rb") || !second.fopen(b.c_str(), "rb")) {
+        return false;
+    }
+    std::vector<char> bufferA(1024 * 1024);
+    std::vector<char> bufferB(bufferA.size());
+    while (true) {
+        const size_t lengthA = first.fread(&bufferA[0], 1, bufferA.size());
+        const size_t lengthB = second.fread(&bufferB[0], 1, bufferB.size());
+        if (lengthA != lengthB || memcmp(&bufferA[0], &bufferB[0], lengthA) != 0) {
+            return false;
+        }
+        if (lengthA == 0) {
+            return first.error() == 0 && second.error() == 0;
+        }
+    }
+}
+
+bool sameFile(const std::string& a, const std::string& b)
+{
+#ifdef HAVE_WINDOWS_H
+    // no inode numbers from stat, the byte comparison finds nothing to free
+    (void)a; (void)b;
+    return false;
+#else
+    struct stat stA;
+    struct stat stB;
+    return stat(a.c_str(), &stA) == 0 && stat(b.c_str(), &stB) == 0 && stA.st_dev == stB.st_dev && stA.st_ino == stB.st_ino;
+#endif
+}
+
+bool hardLink(const std::string& existing, const std::string& link)
+{
+#ifdef HAVE_WINDOWS_H
+    return CreateHardLinkA(link.c_str(), existing.c_str(), NULL) != 0;
+#else
+    return ::link(existing.c_str(), link.c_str()) == 0;
+#endif
+}
+
+// hidden file next to path, a reindex never picks it up
+std::string temporaryFile(const std::string& path)
+{
+    OFString directory;
+    OFString name;
+    OFStandard::getDirNameFromPath(directory, path.c_str(), OFFalse);
+    OFStandard::getFilenameFromPath(name, path.c_str());
+    std::string result = directory.c_str();
+    if (!result.empty()) {
+        result += PATH_SEPARATOR;
+    }
+    return result + "." + name.c_str() + ".link";
+}
+
+typedef std::pair<Uint64, Uint64> ContentKey;
+
+struct sContent {
+    std::string path;
+    std::list<ContentKey>::iterator lru;
+};
+
+std::mutex storeMutex;
+size_t maxEntries = 0;
+// content of recently stored files, most recently stored first
+std::map<ContentKey, sContent> contents;
+std::list<ContentKey> contentLru;
+std::atomic<size_t> linkedFiles(0);
+
+// remembers the file with this content, storeMutex is held
+void remember(const ContentKey& key, const std::string& path)
+{
+    std::map<ContentKey, sContent>::iterator it = contents.find(key);
+    if (it != contents.end()) {
+        contentLru.splice(contentLru.begin(), contentLru, it->second.lru);
+        it->second.path = path;
+        return;
+    }
+    contentLru.push_front(key);
+    sContent& content = contents[key];
+    content.path = path;
+    content.lru = contentLru.begin();
+    while (contents.size() > maxEntries && !contentLru.empty()) {
+        contents.erase(contentLru.back());
+        contentLru.pop_back();
+    }
+}
+
+}
+
+void ContentStore::configure(size_t maxFiles)
+{
+    std::lock_guard<std::mutex> lock(storeMutex);
+    maxEntries = maxFiles;
+    while (contents.size() > maxEntries && !contentLru.empty()) {
+        contents.erase(contentLru.back());
+        contentLru.pop_back();
+    }
+}
+
+bool ContentStore::isEnabled()
+{
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return maxEntries > 0;
+}
+
+void ContentStore::deduplicate(const std::string& path)
+{
+    Uint64 hash = 0;
+    Uint64 size = 0;
+    if (!isEnabled() || !hashFile(path, hash, size) || size == 0) {
+        return;
+    }
+    const ContentKey key(hash, size);
+    std::string candidate;
+    {
+        std::lock_guard<std::mutex> lock(storeMutex);
+        std::map<ContentKey, sContent>::iterator it = contents.find(key);
+        if (it != contents.end()) {
+            candidate = it->second.path;
+        }
+        // the new file is the one kept if it cannot be linked, later copies link to it
+        remember(key, path);
+    }
+    if (candidate.empty() || candidate == path || sameFile(candidate, path)) {
+        Metrics::counter("storage_dedup_total", {{"result", "unique"}}).add();
+        return;
+    }
+
+    // the link pins the content compared below, even if the candidate is replaced meanwhile
+    const std::string temporary = temporaryFile(path);
+    OFStandard::deleteFile(temporary.c_str());
+    if (!hardLink(candidate, temporary)) {
+        // another file system or a file gone since, the new file is kept
+        DCMNET_DEBUG("cannot link " << path << " to " << candidate);
+        Metrics::counter("storage_dedup_total", {{"result", "unique"}}).add();
+        return;
+    }
+    bool linked = sameContent(temporary, path);
+#ifdef HAVE_WINDOWS_H
+    linked = linked && OFStandard::deleteFile(path.c_str());
+#endif
+    linked = linked && OFStandard::renameFile(temporary.c_str(), path.c_str());
+    if (!linked) {
+        OFStandard::deleteFile(temporary.c_str());
+        Metrics::counter("storage_dedup_total", {{"result", "unique"}}).add();
+        return;
+    }
+    ++linkedFiles;
+    Metrics::counter("storage_dedup_total", {{"result", "linked"}}).add();
+    Metrics::counter("storage_dedup_bytes_total").add(size);
+    DCMNET_DEBUG("stored " << path << " as a hard link to " << candidate);
+}
+
+size_t ContentStore::linked()
+{
+    return linkedFiles;
+}
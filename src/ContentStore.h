@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+// Hard links between stored files with identical content, e.g. the same instance routed to the
+// storage areas of several SCPs on one file system. The content hashes of recently stored files
+// are kept in memory, a newly stored file whose hash, size and bytes match one of them becomes a
+// hard link to it and its own blocks are freed. Files are replaced but never written in place, so
+// the linked paths cannot change each other.
+class ContentStore
+{
+public:
+    // remembers up to maxFiles files, 0 disables linking
+    static void configure(size_t maxFiles);
+
+    // true once configured with a non zero size
+    static bool isEnabled();
+
+    // links path to an earlier file with the same content, otherwise remembers it. Files which
+    // cannot be read or linked are kept as they are
+    static void deduplicate(const std::string& path);
+
+    // number of files replaced by hard links by this process
+    static size_t linked();
+
+    // default number of files remembered
+    static const size_t defaultFiles = 100000;
+};
@@ -0,0 +1,297 @@
+#include "CpuPlacement.h"
+#include "Metrics.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#define HAVE_CPU_AFFINITY
+#endif
+
+namespace {
+
+    struct sNode {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    struct sTopology {
+        std::vector<sNode> nodes;
+        // node id by CPU number, -1 for CPUs the process may not use
+        std::vector<int> nodeOfCpu;
+#ifdef HAVE_CPU_AFFINITY
+        cpu_set_t process;
+#endif
+    };
+
+    enum ePolicy { PL_NONE, PL_SPREAD, PL_NODE };
+
+    struct sPolicy {
+        sPolicy() : kind(PL_NONE), node(-1) {}
+        ePolicy kind;
+        int node;
+    };
+
+    // the operation and node of a thread between enter() and leave()
+    struct sPlacement {
+        sPlacement() : entered(false), node(-1) {}
+        bool entered;
+        std::string operation;
+        int node;
+    };
+
+    std::mutex placementMutex;
+    std::map<std::string, sPolicy> policies;
+    // threads per node of each operation, of those assigned
+    std::map<std::string, std::map<int, size_t> > threads;
+    thread_local sPlacement current;
+
+    // numbers of a sysfs list like "0-3,8-11", empty if it cannot be read
+    std::vector<int> readList(const std::string& path)
+    {
+        std::vector<int> numbers;
+        std::ifstream file(path.c_str());
+        std::string list;
+        if (!std::getline(file, list)) {
+            return numbers;
+        }
+        std::istringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            if (range.empty()) {
+                continue;
+            }
+            const size_t dash = range.find('-');
+            const int first = atoi(range.c_str());
+            const int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+            for (int n = first; n <= last; ++n) {
+                numbers.push_back(n);
+            }
+        }
+        return numbers;
+    }
+
+    sTopology readTopology()
+    {
+        sTopology topology;
+#ifdef HAVE_CPU_AFFINITY
+        CPU_ZERO(&topology.process);
+        if (sched_getaffinity(0, sizeof(topology.process), &topology.process) == 0) {
+            for (int id : readList("/sys/devices/system/node/online")) {
+                sNode node;
+                node.id = id;
+                for (int cpu : readList("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist")) {
+                    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &topology.process)) {
+                        node.cpus.push_back(cpu);
+                    }
+                }
+                // memory only nodes and those of a cpuset the process is not in
+                if (!node.cpus.empty()) {
+                    topology.nodes.push_back(node);
+                }
+            }
+        }
+#endif
+        if (topology.nodes.empty()) {
+            topology.nodes.push_back(sNode());
+            topology.nodes.back().id = 0;
+        }
+        for (const sNode& node : topology.nodes) {
+            for (int cpu : node.cpus) {
+                if (topology.nodeOfCpu.size() <= static_cast<size_t>(cpu)) {
+                    topology.nodeOfCpu.resize(cpu + 1, -1);
+                }
+                topology.nodeOfCpu[cpu] = node.id;
+            }
+            Metrics::gauge("numa_node_cpus", {{"node", std::to_string(node.id)}}).set(static_cast<int64_t>(node.cpus.size()));
+        }
+        Metrics::gauge("numa_nodes").set(static_cast<int64_t>(topology.nodes.size()));
+        return topology;
+    }
+
+    const sTopology& topology()
+    {
+        static const sTopology instance = readTopology();
+        return instance;
+    }
+
+    const sNode* findNode(int id)
+    {
+        for (const sNode& node : topology().nodes) {
+            if (node.id == id) {
+                return &node;
+            }
+        }
+        return NULL;
+    }
+
+    // expects placementMutex to be locked
+    void count(const std::string& operation, int node, bool added)
+    {
+        size_t& n = threads[operation][node];
+        if (added) {
+            ++n;
+        }
+        else if (n > 0) {
+            --n;
+        }
+        Metrics::gauge("placement_threads", {{"operation", operation}, {"node", std::to_string(node)}}).set(static_cast<int64_t>(n));
+    }
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool CpuPlacement::setPolicy(const std::string& operation, const std::string& policy)
+{
+    sPolicy p;
+    if (policy == "spread") {
+        p.kind = PL_SPREAD;
+    }
+    else if (policy.compare(0, 5, "node:") == 0 && policy.size() > 5) {
+        char* end = NULL;
+        const long id = strtol(policy.c_str() + 5, &end, 10);
+        if (*end != '\0' || findNode(static_cast<int>(id)) == NULL) {
+            return false;
+        }
+        p.kind = PL_NODE;
+        p.node = static_cast<int>(id);
+    }
+    else if (policy != "none") {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(placementMutex);
+    policies[operation] = p;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::string CpuPlacement::policy(const std::string& operation)
+{
+    std::lock_guard<std::mutex> lock(placementMutex);
+    std::map<std::string, sPolicy>::const_iterator it = policies.find(operation);
+    if (it == policies.end() || it->second.kind == PL_NONE) {
+        return "none";
+    }
+    return it->second.kind == PL_SPREAD ? "spread" : "node:" + std::to_string(it->second.node);
+}
+
+//--------------------------------------------------------------------------------------------
+
+size_t CpuPlacement::nodes()
+{
+    return topology().nodes.size();
+}
+
+//--------------------------------------------------------------------------------------------
+
+int CpuPlacement::currentNode()
+{
+    const sTopology& t = topology();
+    if (t.nodes.size() == 1) {
+        return t.nodes[0].id;
+    }
+#ifdef HAVE_CPU_AFFINITY
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && static_cast<size_t>(cpu) < t.nodeOfCpu.size()) {
+        return t.nodeOfCpu[cpu];
+    }
+#endif
+    return -1;
+}
+
+//--------------------------------------------------------------------------------------------
+
+int CpuPlacement::assign(const std::string& operation)
+{
+    const sTopology& t = topology();
+    std::lock_guard<std::mutex> lock(placementMutex);
+    std::map<std::string, sPolicy>::const_iterator it = policies.find(operation);
+    if (it == policies.end() || it->second.kind == PL_NONE) {
+        return -1;
+    }
+    int node = it->second.node;
+    if (it->second.kind == PL_SPREAD) {
+        // the first node with the fewest threads, so a lane fills the nodes evenly
+        std::map<int, size_t>& used = threads[operation];
+        node = t.nodes[0].id;
+        for (const sNode& n : t.nodes) {
+            if (used[n.id] < used[node]) {
+                node = n.id;
+            }
+        }
+    }
+    count(operation, node, true);
+    Metrics::counter("placement_assignments_total", {{"operation", operation}, {"node", std::to_string(node)}}).add();
+    return node;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void CpuPlacement::release(const std::string& operation, int node)
+{
+    if (node < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(placementMutex);
+    count(operation, node, false);
+}
+
+//--------------------------------------------------------------------------------------------
+
+void CpuPlacement::bind(int node)
+{
+#ifdef HAVE_CPU_AFFINITY
+    const sTopology& t = topology();
+    cpu_set_t cpus = t.process;
+    if (node >= 0) {
+        const sNode* n = findNode(node);
+        if (n == NULL || n->cpus.empty()) {
+            return;
+        }
+        CPU_ZERO(&cpus);
+        for (int cpu : n->cpus) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        Metrics::counter("placement_bind_failures_total").add();
+    }
+#else
+    (void)node;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------
+
+int CpuPlacement::enter(const std::string& operation)
+{
+    leave();
+    const int node = assign(operation);
+    if (node >= 0) {
+        bind(node);
+        current.entered = true;
+        current.operation = operation;
+        current.node = node;
+    }
+    return node;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void CpuPlacement::leave()
+{
+    if (!current.entered) {
+        return;
+    }
+    release(current.operation, current.node);
+    bind(-1);
+    current = sPlacement();
+}
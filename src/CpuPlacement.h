@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+
+// Places the native threads of an operation on the NUMA nodes of the machine, so codec, association
+// and index threads do not migrate between sockets and the memory they allocate stays local: Linux
+// allocates a page on the node of the thread that touches it first, so the datasets and buffers a
+// bound thread fills come from its node. The nodes are read from sysfs, restricted to the CPUs the
+// process may run on. Policies are set per operation, the executor lanes and "association" for the
+// threads serving the associations of the SCPs: "none" leaves the threads to the scheduler (the
+// default), "spread" binds each thread to the node with the fewest threads of the operation, which
+// makes its threads one pool per node, "node:<n>" binds them all to node n. Without NUMA, or on other systems than Linux, there is a single node and
+// binding does nothing.
+class CpuPlacement
+{
+public:
+    // sets the policy of the threads of operation started afterwards, false if it is unknown or
+    // names a node that does not exist
+    static bool setPolicy(const std::string& operation, const std::string& policy);
+
+    static std::string policy(const std::string& operation);
+
+    // number of nodes with CPUs the process may use, at least 1
+    static size_t nodes();
+
+    // node of the CPU the calling thread runs on, -1 if unknown
+    static int currentNode();
+
+    // picks the node of a new thread of operation and counts it until release(), -1 if the thread
+    // is not to be bound
+    static int assign(const std::string& operation);
+
+    static void release(const std::string& operation, int node);
+
+    // restricts the calling thread to the CPUs of node, -1 restores the CPUs of the process
+    static void bind(int node);
+
+    // assigns and binds the calling thread for operation until leave(), returns the node or -1
+    static int enter(const std::string& operation);
+
+    // releases the node of enter() and unbinds the calling thread, nothing if it did not enter
+    static void leave();
+
+    // places the calling thread for its lifetime
+    class Scope
+    {
+    public:
+        explicit Scope(const std::string& operation) { enter(operation); }
+        ~Scope() { leave(); }
+
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+};
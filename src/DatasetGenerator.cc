@@ -0,0 +1,295 @@
+#include "DatasetGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcmetinf.h"
+#include "dcmtk/dcmdata/dcuid.h"
+
+namespace
+{
+
+struct sModality
+{
+    const char* modality;
+    const char* sopClass;
+    // share of all studies
+    unsigned weight;
+    unsigned minSeries;
+    unsigned maxSeries;
+    unsigned minInstances;
+    unsigned maxInstances;
+    Uint16 rows;
+    Uint16 columns;
+    Uint16 bitsStored;
+    Uint16 samplesPerPixel;
+    const char* photometric;
+    std::vector<const char*> studyDescriptions;
+    // the body part of each study description
+    std::vector<const char*> bodyParts;
+    std::vector<const char*> seriesDescriptions;
+};
+
+const std::vector<sModality>& modalityTable()
+{
+    static const std::vector<sModality> table = {
+        {"CT", UID_CTImageStorage, 30, 2, 6, 40, 400, 512, 512, 12, 1, "MONOCHROME2",
+            {"CT CHEST W CONTRAST", "CT ABDOMEN PELVIS W CONTRAST", "CT HEAD WO CONTRAST", "CT SPINE LUMBAR"},
+            {"CHEST", "ABDOMEN", "HEAD", "LSPINE"},
+            {"SCOUT", "AXIAL 5MM", "AXIAL 1MM", "CORONAL MPR", "SAGITTAL MPR", "DOSE REPORT"}},
+        {"MR", UID_MRImageStorage, 20, 4, 12, 20, 200, 256, 256, 12, 1, "MONOCHROME2",
+            {"MRI BRAIN W WO CONTRAST", "MRI KNEE WO CONTRAST", "MRI LUMBAR SPINE", "MRI SHOULDER"},
+            {"HEAD", "KNEE", "LSPINE", "SHOULDER"},
+            {"LOCALIZER", "T1 SAG", "T2 AX", "FLAIR AX", "DWI", "T1 POST GD", "PD FS COR"}},
+        {"CR", UID_ComputedRadiographyImageStorage, 12, 1, 2, 1, 2, 2500, 2048, 12, 1, "MONOCHROME1",
+            {"XR CHEST 2 VIEWS", "XR HAND 3 VIEWS", "XR KNEE 2 VIEWS"},
+            {"CHEST", "HAND", "KNEE"},
+            {"PA", "LAT", "AP", "OBLIQUE"}},
+        {"DX", UID_DigitalXRayImageStorageForPresentation, 15, 1, 3, 1, 2, 3000, 2500, 14, 1, "MONOCHROME2",
+            {"XR CHEST PA LAT", "XR PELVIS AP", "XR FOOT 3 VIEWS", "XR CERVICAL SPINE"},
+            {"CHEST", "PELVIS", "FOOT", "CSPINE"},
+            {"PA", "LAT", "AP", "OBLIQUE"}},
+        {"US", UID_UltrasoundImageStorage, 10, 1, 1, 10, 60, 480, 640, 8, 3, "RGB",
+            {"US ABDOMEN COMPLETE", "US PELVIS TRANSVAGINAL", "US THYROID", "US CAROTID DOPPLER"},
+            {"ABDOMEN", "PELVIS", "NECK", "NECK"},
+            {"ABDOMEN", "DOPPLER", "MEASUREMENTS"}},
+        {"MG", UID_DigitalMammographyXRayImageStorageForPresentation, 8, 1, 4, 1, 2, 3328, 2560, 12, 1, "MONOCHROME2",
+            {"MAMMO SCREENING BILATERAL", "MAMMO DIAGNOSTIC LEFT", "MAMMO DIAGNOSTIC RIGHT"},
+            {"BREAST", "BREAST", "BREAST"},
+            {"L CC", "L MLO", "R CC", "R MLO"}},
+        {"PT", UID_PositronEmissionTomographyImageStorage, 5, 2, 3, 100, 300, 128, 128, 16, 1, "MONOCHROME2",
+            {"PET CT WHOLE BODY FDG", "PET CT SKULL BASE TO THIGH"},
+            {"WHOLEBODY", "WHOLEBODY"},
+            {"PET AC", "PET NAC", "PET MIP"}}
+    };
+    return table;
+}
+
+// name frequencies are heavily skewed in real archives, a few names make up many patients
+const char* familyNames[] = {
+    "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller", "Davis", "Martinez", "Wilson",
+    "Anderson", "Taylor", "Thomas", "Moore", "Jackson", "Martin", "Lee", "Thompson", "White", "Harris",
+    "Clark", "Lewis", "Walker", "Hall", "Young", "King", "Wright", "Scott", "Green", "Baker",
+    "Adams", "Nelson", "Hill", "Campbell", "Mitchell", "Roberts", "Carter", "Phillips", "Evans", "Turner"
+};
+// ISO_IR 100 encoded, names with these come with the Latin-1 character set
+const char* latin1FamilyNames[] = { "M\xfcller", "Sch\xe4" "fer", "J\xe4ger", "Gonz\xe1lez", "L\xf3pez", "Fran\xe7ois", "S\xf8rensen" };
+const char* femaleNames[] = { "Mary", "Patricia", "Jennifer", "Linda", "Elizabeth", "Barbara", "Susan", "Jessica", "Sarah", "Karen", "Anna", "Maria" };
+const char* maleNames[] = { "James", "Robert", "John", "Michael", "David", "William", "Richard", "Joseph", "Thomas", "Charles", "Peter", "Daniel" };
+const char* institutions[] = { "GENERAL HOSPITAL", "UNIVERSITY MEDICAL CENTER", "CITY IMAGING CENTER", "CHILDRENS HOSPITAL" };
+const char* manufacturers[] = { "SIEMENS", "GE MEDICAL SYSTEMS", "Philips", "CANON_MEC", "FUJIFILM Corporation" };
+const char* physicians[] = { "House^Gregory", "Grey^Meredith", "Ross^Doug", "Quinn^Michaela", "Kildare^James" };
+
+template <size_t N>
+const char* pick(std::mt19937_64& rng, const char* (&list)[N], bool skewed = false)
+{
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    size_t i = static_cast<size_t>((skewed ? u * u : u) * N);
+    return list[std::min(i, N - 1)];
+}
+
+const char* pick(std::mt19937_64& rng, const std::vector<const char*>& list)
+{
+    return list[std::uniform_int_distribution<size_t>(0, list.size() - 1)(rng)];
+}
+
+unsigned between(std::mt19937_64& rng, unsigned low, unsigned high)
+{
+    return std::uniform_int_distribution<unsigned>(low, std::max(low, high))(rng);
+}
+
+// YYYYMMDD of the given day since 1970-01-01
+std::string dicomDate(long days)
+{
+    days += 719468;
+    const long era = (days >= 0 ? days : days - 146096) / 146097;
+    const long doe = days - era * 146097;
+    const long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const long mp = (5 * doy + 2) / 153;
+    const long day = doy - (153 * mp + 2) / 5 + 1;
+    const long month = mp < 10 ? mp + 3 : mp - 9;
+    const long year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+    char buffer[16];
+    OFStandard::snprintf(buffer, sizeof(buffer), "%04ld%02ld%02ld", year, month, day);
+    return buffer;
+}
+
+// studies of the ten years up to 2024-12-31, patients born 1930 to 2020 with more elderly ones
+const long lastStudyDay = 20088;
+
+std::string dicomTime(std::mt19937_64& rng)
+{
+    // most studies are done during the day shift
+    std::normal_distribution<double> hours(12.5, 3.0);
+    double h = std::min(std::max(hours(rng), 0.0), 23.99);
+    char buffer[16];
+    const int seconds = static_cast<int>(h * 3600);
+    OFStandard::snprintf(buffer, sizeof(buffer), "%02d%02d%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+    return buffer;
+}
+
+// gradient with noise, so compressing codecs and peers see realistic entropy
+void putPixelData(DcmDataset& dataset, const sModality& m, std::mt19937_64& rng)
+{
+    const size_t samples = static_cast<size_t>(m.rows) * m.columns * m.samplesPerPixel;
+    const Uint16 maxValue = static_cast<Uint16>((1u << m.bitsStored) - 1);
+    Uint32 noise = static_cast<Uint32>(rng());
+    if (m.bitsStored <= 8) {
+        std::vector<Uint8> pixels(samples);
+        for (size_t i = 0; i < samples; ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            const size_t pixel = i / m.samplesPerPixel;
+            pixels[i] = static_cast<Uint8>(((pixel % m.columns + pixel / m.columns) * maxValue / (m.rows + m.columns) + (noise >> 29)) & maxValue);
+        }
+        dataset.putAndInsertUint8Array(DCM_PixelData, pixels.data(), static_cast<unsigned long>(pixels.size()));
+    }
+    else {
+        std::vector<Uint16> pixels(samples);
+        for (size_t i = 0; i < samples; ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            pixels[i] = static_cast<Uint16>(((i % m.columns + i / m.columns) * maxValue / (m.rows + m.columns) + (noise >> 26)) & maxValue);
+        }
+        dataset.putAndInsertUint16Array(DCM_PixelData, pixels.data(), static_cast<unsigned long>(pixels.size()));
+    }
+}
+
+std::string uid(const char* root)
+{
+    char buffer[100];
+    return dcmGenerateUniqueIdentifier(buffer, root);
+}
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+DatasetGenerator::DatasetGenerator(const sOptions& options) : _options(options)
+{
+    const std::vector<sModality>& table = modalityTable();
+    unsigned total = 0;
+    for (size_t i = 0; i < table.size(); ++i) {
+        if (!options.modalities.empty() && std::find(options.modalities.begin(), options.modalities.end(), table[i].modality) == options.modalities.end()) {
+            continue;
+        }
+        total += table[i].weight;
+        _modalities.push_back(i);
+        _weights.push_back(total);
+    }
+}
+
+std::vector<std::string> DatasetGenerator::knownModalities()
+{
+    std::vector<std::string> result;
+    for (const sModality& m : modalityTable()) {
+        result.push_back(m.modality);
+    }
+    return result;
+}
+
+bool DatasetGenerator::generatePatient(size_t patient, const std::function<bool(DcmFileFormat&)>& sink) const
+{
+    if (_modalities.empty()) {
+        return false;
+    }
+    std::mt19937_64 rng(_options.seed * 0x9e3779b97f4a7c15ULL + patient);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    const bool female = uniform(rng) < 0.52;
+    const bool latin1 = uniform(rng) < 0.05;
+    const std::string patientName = std::string(latin1 ? pick(rng, latin1FamilyNames) : pick(rng, familyNames, true)) + "^" + pick(rng, female ? femaleNames : maleNames, true);
+    const std::string patientID = "SYN" + std::to_string(_options.seed) + "-" + std::to_string(patient);
+    // ages skew towards the elderly, who make up most of the imaging
+    const long birthDay = -14610 + static_cast<long>((1 - std::sqrt(uniform(rng))) * 33000);
+    const std::string birthDate = dicomDate(birthDay);
+    const char* institution = pick(rng, institutions);
+
+    // most patients have one or two studies, a few have many
+    const size_t studies = _options.studiesPerPatient > 0 ? _options.studiesPerPatient : 1 + std::min<size_t>(std::geometric_distribution<size_t>(0.5)(rng), 9);
+    for (size_t st = 0; st < studies; ++st) {
+        const unsigned draw = std::uniform_int_distribution<unsigned>(0, _weights.back() - 1)(rng);
+        const sModality& m = modalityTable()[_modalities[std::upper_bound(_weights.begin(), _weights.end(), draw) - _weights.begin()]];
+        const size_t description = std::uniform_int_distribution<size_t>(0, m.studyDescriptions.size() - 1)(rng);
+        const long studyDay = std::max(birthDay, lastStudyDay - static_cast<long>(uniform(rng) * 3652));
+        const std::string studyDate = dicomDate(studyDay);
+        const std::string studyTime = dicomTime(rng);
+        const std::string studyUID = uid(SITE_STUDY_UID_ROOT);
+        const std::string accession = "ACC" + std::to_string(100000000 + rng() % 900000000);
+        const std::string physician = pick(rng, physicians);
+        const char* manufacturer = pick(rng, manufacturers);
+        const int age = static_cast<int>((studyDay - birthDay) / 365);
+
+        const size_t series = _options.seriesPerStudy > 0 ? _options.seriesPerStudy : between(rng, m.minSeries, m.maxSeries);
+        for (size_t se = 0; se < series; ++se) {
+            DcmFileFormat file;
+            DcmDataset& d = *file.getDataset();
+            if (latin1) {
+                d.putAndInsertString(DCM_SpecificCharacterSet, "ISO_IR 100");
+            }
+            d.putAndInsertString(DCM_SOPClassUID, m.sopClass);
+            d.putAndInsertString(DCM_PatientName, patientName.c_str());
+            d.putAndInsertString(DCM_PatientID, patientID.c_str());
+            d.putAndInsertString(DCM_IssuerOfPatientID, "SYNTHETIC");
+            d.putAndInsertString(DCM_PatientBirthDate, birthDate.c_str());
+            d.putAndInsertString(DCM_PatientSex, female ? "F" : "M");
+            d.putAndInsertString(DCM_PatientAge, (std::string(age < 100 ? (age < 10 ? "00" : "0") : "") + std::to_string(age) + "Y").c_str());
+            d.putAndInsertString(DCM_StudyInstanceUID, studyUID.c_str());
+            d.putAndInsertString(DCM_StudyDate, studyDate.c_str());
+            d.putAndInsertString(DCM_StudyTime, studyTime.c_str());
+            d.putAndInsertString(DCM_StudyID, std::to_string(st + 1).c_str());
+            d.putAndInsertString(DCM_AccessionNumber, accession.c_str());
+            d.putAndInsertString(DCM_StudyDescription, m.studyDescriptions[description]);
+            d.putAndInsertString(DCM_ReferringPhysicianName, physician.c_str());
+            d.putAndInsertString(DCM_InstitutionName, institution);
+            d.putAndInsertString(DCM_Manufacturer, manufacturer);
+            d.putAndInsertString(DCM_Modality, m.modality);
+            d.putAndInsertString(DCM_SeriesInstanceUID, uid(SITE_SERIES_UID_ROOT).c_str());
+            d.putAndInsertString(DCM_SeriesNumber, std::to_string(se + 1).c_str());
+            d.putAndInsertString(DCM_SeriesDate, studyDate.c_str());
+            d.putAndInsertString(DCM_SeriesDescription, m.seriesDescriptions[se % m.seriesDescriptions.size()]);
+            d.putAndInsertString(DCM_BodyPartExamined, m.bodyParts[description]);
+            if (std::string(m.modality) == "MG") {
+                d.putAndInsertString(DCM_ImageLaterality, m.seriesDescriptions[se % m.seriesDescriptions.size()][0] == 'L' ? "L" : "R");
+            }
+            d.putAndInsertUint16(DCM_SamplesPerPixel, m.samplesPerPixel);
+            d.putAndInsertString(DCM_PhotometricInterpretation, m.photometric);
+            d.putAndInsertUint16(DCM_Rows, m.rows);
+            d.putAndInsertUint16(DCM_Columns, m.columns);
+            d.putAndInsertUint16(DCM_BitsAllocated, m.bitsStored <= 8 ? 8 : 16);
+            d.putAndInsertUint16(DCM_BitsStored, m.bitsStored);
+            d.putAndInsertUint16(DCM_HighBit, static_cast<Uint16>(m.bitsStored - 1));
+            d.putAndInsertUint16(DCM_PixelRepresentation, 0);
+            if (m.samplesPerPixel > 1) {
+                d.putAndInsertUint16(DCM_PlanarConfiguration, 0);
+            }
+            if (_options.pixelData) {
+                putPixelData(d, m, rng);
+            }
+            file.getMetaInfo()->putAndInsertString(DCM_MediaStorageSOPClassUID, m.sopClass);
+
+            const size_t instances = _options.instancesPerSeries > 0 ? _options.instancesPerSeries : between(rng, m.minInstances, m.maxInstances);
+            const double sliceThickness = m.maxInstances > 2 ? (between(rng, 0, 1) ? 1.0 : 5.0) : 0;
+            for (size_t in = 0; in < instances; ++in) {
+                const std::string sopInstanceUID = uid(SITE_INSTANCE_UID_ROOT);
+                d.putAndInsertString(DCM_SOPInstanceUID, sopInstanceUID.c_str());
+                d.putAndInsertString(DCM_InstanceNumber, std::to_string(in + 1).c_str());
+                if (sliceThickness > 0) {
+                    const std::string location = std::to_string(static_cast<double>(in) * sliceThickness);
+                    d.putAndInsertString(DCM_SliceLocation, location.c_str());
+                    d.putAndInsertString(DCM_ImagePositionPatient, ("-250\\-250\\" + location).c_str());
+                }
+                file.getMetaInfo()->putAndInsertString(DCM_MediaStorageSOPInstanceUID, sopInstanceUID.c_str());
+                if (!sink(file)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
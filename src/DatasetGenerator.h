@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class DcmFileFormat;
+
+// Synthetic patients with studies, series and instances of the common modalities, without PHI.
+// Series and instance counts, image sizes, dates, names and descriptions follow per-modality
+// distributions, so indexes and queries built from them behave like those of a real archive.
+// The attributes of a patient only depend on the seed and the patient index, the UIDs are new
+// for every call. Pixel data is optional and kept out of the way of index-only use.
+class DatasetGenerator
+{
+public:
+    struct sOptions
+    {
+        sOptions() : patients(1), studiesPerPatient(0), seriesPerStudy(0), instancesPerSeries(0), seed(1), pixelData(false) {}
+        size_t patients;
+        // 0 draws the counts from the distribution of the modality
+        size_t studiesPerPatient;
+        size_t seriesPerStudy;
+        size_t instancesPerSeries;
+        uint64_t seed;
+        // modalities the studies are drawn from by their usual share, e.g. "CT" or "MG", all if empty
+        std::vector<std::string> modalities;
+        bool pixelData;
+    };
+
+    explicit DatasetGenerator(const sOptions& options);
+
+    // hands each instance of the patient to sink, the file is reused for the next instance of the
+    // series. Stops and returns false once the sink returns false
+    bool generatePatient(size_t patient, const std::function<bool(DcmFileFormat&)>& sink) const;
+
+    // false if none of the requested modalities is known
+    bool valid() const { return !_modalities.empty(); }
+
+    static std::vector<std::string> knownModalities();
+
+private:
+    sOptions _options;
+    // indexes into the modality table and the summed weights up to each of them
+    std::vector<size_t> _modalities;
+    std::vector<unsigned> _weights;
+};
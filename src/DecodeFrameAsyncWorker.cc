@@ -0,0 +1,105 @@
+#include "DecodeFrameAsyncWorker.h"
+
+#include "Utils.h"
+#include "BufferPool.h"
+#include "FrameIndex.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+
+#define INCLUDE_CSTRING
+#include "dcmtk/ofstd/ofstdinc.h"
+
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmj2k/djcodecd.h"
+#include "dcmtk/dcmj2k/djcparam.h"
+
+#include "json.h"
+
+using json = nlohmann::json;
+
+DecodeFrameAsyncWorker::DecodeFrameAsyncWorker(std::string data, Function &callback)
+    : BaseAsyncWorker(data, callback) {
+}
+
+void DecodeFrameAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.sourcePath.empty()) {
+        SetErrorJson("No source path set");
+        return;
+    }
+
+    // region is [left, top, width, height] in full resolution pixels, the whole frame if not set
+    Uint16 region[4] = { 0, 0, 0, 0 };
+    if (!in.region.empty()) {
+        if (in.region.size() != 4) {
+            SetErrorJson("Invalid region, [left, top, width, height] expected");
+            return;
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            if (in.region[i] < 0 || in.region[i] > 0xFFFF) {
+                SetErrorJson("Invalid region, [left, top, width, height] expected");
+                return;
+            }
+            region[i] = static_cast<Uint16>(in.region[i]);
+        }
+    }
+
+    // with a frame index only the fragments of the frame are read
+    Uint32 frame = static_cast<Uint32>(in.frame > 0 ? in.frame : 0);
+    std::string error;
+    std::shared_ptr<const FrameIndex> index = FrameIndex::get(in.sourcePath, error);
+    DcmFileFormat dfile;
+    OFCondition status;
+    if (index && frame < index->frames()) {
+        status = index->loadFrame(frame, dfile);
+        frame = 0;
+    }
+    else {
+        status = dfile.loadFile(OFFilename(in.sourcePath.c_str()));
+    }
+    if (status.bad()) {
+        SetErrorJson("Invalid source path set, no DICOM files found");
+        return;
+    }
+
+    DcmDataset *dataset = dfile.getDataset();
+    const DJPEG2KCodecParameter cp(EJ2KUC_default, EJ2KPC_restore, OFFalse, static_cast<Uint16>(in.j2kThreads > 0 ? in.j2kThreads : 0));
+    Uint8 *pixels = NULL;
+    size_t length = 0;
+    Uint16 columns = 0;
+    Uint16 rows = 0;
+    Uint16 bytesPerSample = 0;
+    status = DJPEG2KDecoderBase::decodeFrameRegion(dataset, frame,
+        static_cast<Uint32>(in.reduce > 0 ? in.reduce : 0), region[0], region[1], region[2], region[3],
+        &cp, pixels, length, columns, rows, bytesPerSample);
+    if (status.bad()) {
+        SetErrorJson(std::string("Cannot decode frame: ") + status.text());
+        return;
+    }
+
+    Uint16 samplesPerPixel = 1;
+    OFString photometricInterpretation;
+    dataset->findAndGetUint16(DCM_SamplesPerPixel, samplesPerPixel);
+    dataset->findAndGetOFString(DCM_PhotometricInterpretation, photometricInterpretation);
+
+    // the buffer is handed to JavaScript, it has to come from the pool
+    unsigned char *buffer = BufferPool::acquire(length);
+    memcpy(buffer, pixels, length);
+    delete[] pixels;
+
+    json v = json::object();
+    v["Columns"] = columns;
+    v["Rows"] = rows;
+    v["SamplesPerPixel"] = samplesPerPixel;
+    v["BitsAllocated"] = 8 * bytesPerSample;
+    v["PhotometricInterpretation"] = photometricInterpretation.c_str();
+    v["length"] = length;
+    SendBuffer(ns::createResponse(ns::PENDING, "DECODED_FRAME", v), buffer, length, progress);
+
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
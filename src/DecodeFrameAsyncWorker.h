@@ -0,0 +1,13 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+class DecodeFrameAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        DecodeFrameAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,550 @@
+#include "DicomJsonReader.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "json.h"
+#include "base64.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcelem.h"
+#include "dcmtk/dcmdata/dcitem.h"
+#include "dcmtk/dcmdata/dcsequen.h"
+#include "dcmtk/dcmdata/dcswap.h"
+#include "dcmtk/dcmdata/dcvr.h"
+
+namespace
+{
+
+// "GGGGEEEE" as a tag, false for anything else
+bool parseTag(const std::string& key, DcmTagKey& tag)
+{
+    if (key.size() != 8) {
+        return false;
+    }
+    unsigned int value = 0;
+    for (char c : key) {
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= static_cast<unsigned int>(c - '0');
+        else if (c >= 'A' && c <= 'F') value |= static_cast<unsigned int>(c - 'A' + 10);
+        else if (c >= 'a' && c <= 'f') value |= static_cast<unsigned int>(c - 'a' + 10);
+        else return false;
+    }
+    tag.set(static_cast<Uint16>(value >> 16), static_cast<Uint16>(value & 0xffff));
+    return true;
+}
+
+bool isAscii(const std::string& value)
+{
+    for (char c : value) {
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// little endian values of bulk data in host order
+template <class T>
+std::vector<T> hostValues(const char* data, size_t length)
+{
+    std::vector<T> values(length / sizeof(T));
+    if (!values.empty()) {
+        memcpy(&values[0], data, values.size() * sizeof(T));
+        swapIfNecessary(gLocalByteOrder, EBO_LittleEndian, &values[0], OFstatic_cast(Uint32, values.size() * sizeof(T)), sizeof(T));
+    }
+    return values;
+}
+
+// JSON values of the binary VRs as an array, false if one is not a number
+template <class T>
+bool numericValues(const std::vector<std::string>& strings, bool floating, std::vector<T>& values)
+{
+    values.resize(strings.size());
+    for (size_t i = 0; i < strings.size(); ++i) {
+        const char* begin = strings[i].c_str();
+        char* end = NULL;
+        if (floating) {
+            values[i] = static_cast<T>(strtod(begin, &end));
+        }
+        else if (begin[0] == '-') {
+            values[i] = static_cast<T>(strtoll(begin, &end, 10));
+        }
+        else {
+            values[i] = static_cast<T>(strtoull(begin, &end, 10));
+        }
+        if (end == begin || *end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// receives the SAX events of the parser. The frames track where in the JSON the parser is, the
+// attributes being read are kept on a stack of their own, reused from one attribute to the next
+class DatasetBuilder : public nlohmann::json_sax<json>
+{
+public:
+    DatasetBuilder(const DicomJsonReader::BulkDataFunction& bulkData, const DicomJsonReader::DatasetFunction& found)
+        : m_bulkData(bulkData), m_found(found), m_depth(0), m_nonAscii(false), m_stopped(false)
+    {
+        m_frames.push_back(FRAME_ROOT);
+    }
+
+    const std::string& error() const { return m_error; }
+
+    bool stopped() const { return m_stopped; }
+
+    bool null()
+    {
+        switch (m_frames.back()) {
+        case FRAME_VALUES:
+            attribute().values.push_back(std::string());
+            return true;
+        case FRAME_ATTRIBUTE:
+        case FRAME_PERSON_NAME:
+            return true;
+        default:
+            return fail("unexpected null");
+        }
+    }
+
+    bool boolean(bool)
+    {
+        return fail("unexpected boolean");
+    }
+
+    bool number_integer(number_integer_t val)
+    {
+        return number(std::to_string(val));
+    }
+
+    bool number_unsigned(number_unsigned_t val)
+    {
+        return number(std::to_string(val));
+    }
+
+    bool number_float(number_float_t, const string_t& s)
+    {
+        // the text as written, DS values keep their precision
+        return number(s);
+    }
+
+    bool string(string_t& val)
+    {
+        switch (m_frames.back()) {
+        case FRAME_ATTRIBUTE: {
+            sAttribute& a = attribute();
+            if (a.field == FIELD_VR) a.vr.swap(val);
+            else if (a.field == FIELD_INLINE_BINARY) a.inlineBinary.swap(val);
+            else if (a.field == FIELD_BULK_DATA) a.bulkDataURI.swap(val);
+            return true;
+        }
+        case FRAME_VALUES:
+            m_nonAscii = m_nonAscii || !isAscii(val);
+            attribute().values.push_back(std::string());
+            attribute().values.back().swap(val);
+            return true;
+        case FRAME_PERSON_NAME: {
+            sAttribute& a = attribute();
+            if (a.nameGroup >= 0) {
+                m_nonAscii = m_nonAscii || !isAscii(val);
+                a.nameGroups[a.nameGroup].swap(val);
+            }
+            return true;
+        }
+        default:
+            return fail("unexpected string");
+        }
+    }
+
+    bool start_object(std::size_t)
+    {
+        switch (m_frames.back()) {
+        case FRAME_ROOT:
+        case FRAME_ROOT_ARRAY:
+            m_dataset.reset(new DcmDataset());
+            m_nonAscii = false;
+            m_items.push_back(m_dataset.get());
+            m_frames.push_back(FRAME_ITEM);
+            return true;
+        case FRAME_ITEM:
+            pushAttribute();
+            m_frames.push_back(FRAME_ATTRIBUTE);
+            return true;
+        case FRAME_VALUES:
+            // a sequence item or a person name, told apart by the first key
+            m_frames.push_back(FRAME_VALUE_OBJECT);
+            return true;
+        default:
+            return fail("unexpected object");
+        }
+    }
+
+    bool key(string_t& val)
+    {
+        switch (m_frames.back()) {
+        case FRAME_ITEM:
+            if (!parseTag(val, m_tag)) {
+                return fail("invalid tag " + val);
+            }
+            return true;
+        case FRAME_ATTRIBUTE: {
+            sAttribute& a = attribute();
+            if (val == "vr") a.field = FIELD_VR;
+            else if (val == "Value") a.field = FIELD_VALUE;
+            else if (val == "InlineBinary") a.field = FIELD_INLINE_BINARY;
+            else if (val == "BulkDataURI") a.field = FIELD_BULK_DATA;
+            else a.field = FIELD_OTHER;
+            return true;
+        }
+        case FRAME_VALUE_OBJECT:
+            if (parseTag(val, m_tag)) {
+                DcmItem* item = new DcmItem();
+                attribute().items.push_back(std::unique_ptr<DcmItem>(item));
+                m_items.push_back(item);
+                m_frames.back() = FRAME_ITEM;
+                return true;
+            }
+            m_frames.back() = FRAME_PERSON_NAME;
+            return personNameGroup(val);
+        case FRAME_PERSON_NAME:
+            return personNameGroup(val);
+        default:
+            return fail("unexpected key " + val);
+        }
+    }
+
+    bool end_object()
+    {
+        switch (m_frames.back()) {
+        case FRAME_ATTRIBUTE: {
+            m_frames.pop_back();
+            const bool added = addAttribute(m_items.back(), attribute());
+            --m_depth;
+            return added;
+        }
+        case FRAME_ITEM:
+            m_items.pop_back();
+            m_frames.pop_back();
+            if (m_frames.back() == FRAME_ROOT || m_frames.back() == FRAME_ROOT_ARRAY) {
+                if (m_nonAscii) {
+                    m_dataset->putAndInsertString(DCM_SpecificCharacterSet, "ISO_IR 192");
+                }
+                // sent and written as Explicit VR Little Endian, like a dataset read from a file
+                m_dataset->updateOriginalXfer();
+                if (!m_found(m_dataset.release())) {
+                    m_stopped = true;
+                    return false;
+                }
+            }
+            return true;
+        case FRAME_PERSON_NAME: {
+            // Alphabetic=Ideographic=Phonetic, without trailing empty groups
+            sAttribute& a = attribute();
+            std::string name = a.nameGroups[0];
+            if (!a.nameGroups[1].empty() || !a.nameGroups[2].empty()) name += "=" + a.nameGroups[1];
+            if (!a.nameGroups[2].empty()) name += "=" + a.nameGroups[2];
+            a.values.push_back(name);
+            for (std::string& group : a.nameGroups) group.clear();
+            m_frames.pop_back();
+            return true;
+        }
+        case FRAME_VALUE_OBJECT: {
+            // {} is an empty item, or an empty name in a PN attribute
+            sAttribute& a = attribute();
+            if (a.vr == "PN") a.values.push_back(std::string());
+            else a.items.push_back(std::unique_ptr<DcmItem>(new DcmItem()));
+            m_frames.pop_back();
+            return true;
+        }
+        default:
+            return fail("unexpected end of object");
+        }
+    }
+
+    bool start_array(std::size_t)
+    {
+        if (m_frames.back() == FRAME_ATTRIBUTE && attribute().field == FIELD_VALUE) {
+            m_frames.push_back(FRAME_VALUES);
+            return true;
+        }
+        if (m_frames.back() == FRAME_ROOT && m_frames.size() == 1) {
+            m_frames.push_back(FRAME_ROOT_ARRAY);
+            return true;
+        }
+        return fail("unexpected array");
+    }
+
+    bool end_array()
+    {
+        m_frames.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex)
+    {
+        m_error = ex.what();
+        return false;
+    }
+
+private:
+    enum eFrame {
+        // outside of any dataset
+        FRAME_ROOT,
+        // in an array of datasets
+        FRAME_ROOT_ARRAY,
+        // in a dataset or item, the keys are tags
+        FRAME_ITEM,
+        // in the object of an attribute
+        FRAME_ATTRIBUTE,
+        // in the Value array of an attribute
+        FRAME_VALUES,
+        // in an object of the Value array before its first key
+        FRAME_VALUE_OBJECT,
+        FRAME_PERSON_NAME
+    };
+
+    enum eField {
+        FIELD_OTHER,
+        FIELD_VR,
+        FIELD_VALUE,
+        FIELD_INLINE_BINARY,
+        FIELD_BULK_DATA
+    };
+
+    struct sAttribute {
+        DcmTagKey tag;
+        std::string vr;
+        eField field;
+        std::vector<std::string> values;
+        std::string inlineBinary;
+        std::string bulkDataURI;
+        std::vector<std::unique_ptr<DcmItem> > items;
+        std::string nameGroups[3];
+        int nameGroup;
+    };
+
+    sAttribute& attribute() { return m_attributes[m_depth - 1]; }
+
+    void pushAttribute()
+    {
+        if (m_attributes.size() <= m_depth) {
+            m_attributes.resize(m_depth + 1);
+        }
+        sAttribute& a = m_attributes[m_depth++];
+        a.tag = m_tag;
+        a.vr.clear();
+        a.field = FIELD_OTHER;
+        a.values.clear();
+        a.inlineBinary.clear();
+        a.bulkDataURI.clear();
+        a.items.clear();
+        a.nameGroup = -1;
+    }
+
+    bool personNameGroup(const std::string& key)
+    {
+        sAttribute& a = attribute();
+        a.nameGroup = key == "Alphabetic" ? 0 : key == "Ideographic" ? 1 : key == "Phonetic" ? 2 : -1;
+        return true;
+    }
+
+    bool number(const std::string& text)
+    {
+        if (m_frames.back() != FRAME_VALUES) {
+            return fail("unexpected number");
+        }
+        attribute().values.push_back(text);
+        return true;
+    }
+
+    bool fail(const std::string& message)
+    {
+        m_error = message;
+        return false;
+    }
+
+    bool failAttribute(const DcmTagKey& tag, const std::string& message)
+    {
+        m_error = std::string("attribute ") + tag.toString().c_str() + ": " + message;
+        return false;
+    }
+
+    // the element of a complete attribute, inserted into item
+    bool addAttribute(DcmItem* item, sAttribute& a)
+    {
+        // the meta information and group lengths are written with the file
+        if (a.tag.getGroup() == 0x0002 || a.tag.getElement() == 0x0000) {
+            return true;
+        }
+        DcmTag tag(a.tag);
+        if (!a.vr.empty()) {
+            const DcmVR vr(a.vr.c_str());
+            if (!vr.isStandard()) {
+                return failAttribute(a.tag, "unknown VR " + a.vr);
+            }
+            tag.setVR(vr);
+        }
+        DcmElement* element = NULL;
+        if (DcmItem::newDicomElementWithVR(element, tag).bad() || element == NULL) {
+            return failAttribute(a.tag, "cannot create element");
+        }
+        std::unique_ptr<DcmElement> owner(element);
+        OFCondition cond = EC_Normal;
+        const DcmEVR evr = tag.getEVR();
+        if (evr == EVR_SQ) {
+            DcmSequenceOfItems* sequence = static_cast<DcmSequenceOfItems*>(element);
+            for (std::unique_ptr<DcmItem>& child : a.items) {
+                if (sequence->append(child.get()).good()) {
+                    child.release();
+                }
+            }
+        }
+        else if (!a.bulkDataURI.empty() || !a.inlineBinary.empty()) {
+            std::string decoded;
+            const char* data = NULL;
+            size_t length = 0;
+            if (!a.bulkDataURI.empty()) {
+                if (!m_bulkData || !m_bulkData(a.bulkDataURI, data, length)) {
+                    return failAttribute(a.tag, "no bulk data for " + a.bulkDataURI);
+                }
+            }
+            else {
+                try {
+                    decoded = base64_decode(a.inlineBinary);
+                }
+                catch (...) {
+                    return failAttribute(a.tag, "invalid InlineBinary");
+                }
+                data = decoded.data();
+                length = decoded.size();
+            }
+            cond = putBinary(element, evr, data, length);
+        }
+        else if (!a.values.empty()) {
+            cond = putValues(element, evr, a.values);
+        }
+        if (cond.bad()) {
+            return failAttribute(a.tag, cond.text());
+        }
+        if (item->insert(owner.get(), OFTrue).bad()) {
+            return failAttribute(a.tag, "cannot insert element");
+        }
+        owner.release();
+        return true;
+    }
+
+    static OFCondition putBinary(DcmElement* element, DcmEVR evr, const char* data, size_t length)
+    {
+        if (length == 0) {
+            return EC_Normal;
+        }
+        switch (evr) {
+        case EVR_OW:
+        case EVR_US:
+            return element->putUint16Array(&hostValues<Uint16>(data, length)[0], OFstatic_cast(unsigned long, length / 2));
+        case EVR_SS:
+            return element->putSint16Array(&hostValues<Sint16>(data, length)[0], OFstatic_cast(unsigned long, length / 2));
+        case EVR_OL:
+        case EVR_UL:
+            return element->putUint32Array(&hostValues<Uint32>(data, length)[0], OFstatic_cast(unsigned long, length / 4));
+        case EVR_SL:
+            return element->putSint32Array(&hostValues<Sint32>(data, length)[0], OFstatic_cast(unsigned long, length / 4));
+        case EVR_OF:
+        case EVR_FL:
+            return element->putFloat32Array(&hostValues<Float32>(data, length)[0], OFstatic_cast(unsigned long, length / 4));
+        case EVR_OD:
+        case EVR_FD:
+            return element->putFloat64Array(&hostValues<Float64>(data, length)[0], OFstatic_cast(unsigned long, length / 8));
+        case EVR_OB:
+        case EVR_UN:
+            return element->putUint8Array(reinterpret_cast<const Uint8*>(data), OFstatic_cast(unsigned long, length));
+        default:
+            return EC_InvalidVR;
+        }
+    }
+
+    static OFCondition putValues(DcmElement* element, DcmEVR evr, const std::vector<std::string>& values)
+    {
+        const OFCondition notNumeric = EC_InvalidValue;
+        switch (evr) {
+        case EVR_US: {
+            std::vector<Uint16> v;
+            return numericValues(values, false, v) ? element->putUint16Array(&v[0], OFstatic_cast(unsigned long, v.size())) : notNumeric;
+        }
+        case EVR_SS: {
+            std::vector<Sint16> v;
+            return numericValues(values, false, v) ? element->putSint16Array(&v[0], OFstatic_cast(unsigned long, v.size())) : notNumeric;
+        }
+        case EVR_UL: {
+            std::vector<Uint32> v;
+            return numericValues(values, false, v) ? element->putUint32Array(&v[0], OFstatic_cast(unsigned long, v.size())) : notNumeric;
+        }
+        case EVR_SL: {
+            std::vector<Sint32> v;
+            return numericValues(values, false, v) ? element->putSint32Array(&v[0], OFstatic_cast(unsigned long, v.size())) : notNumeric;
+        }
+        case EVR_FL: {
+            std::vector<Float32> v;
+            return numericValues(values, true, v) ? element->putFloat32Array(&v[0], OFstatic_cast(unsigned long, v.size())) : notNumeric;
+        }
+        case EVR_FD: {
+            std::vector<Float64> v;
+            return numericValues(values, true, v) ? element->putFloat64Array(&v[0], OFstatic_cast(unsigned long, v.size())) : notNumeric;
+        }
+        case EVR_AT: {
+            DcmTagKey tag;
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (!parseTag(values[i], tag)) {
+                    return EC_InvalidValue;
+                }
+                OFCondition cond = element->putTagVal(tag, OFstatic_cast(unsigned long, i));
+                if (cond.bad()) {
+                    return cond;
+                }
+            }
+            return EC_Normal;
+        }
+        default: {
+            // the string VRs, UV and SV take the values as one backslash separated string
+            std::string joined;
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (i > 0) joined += '\\';
+                joined += values[i];
+            }
+            return element->putString(joined.c_str(), OFstatic_cast(Uint32, joined.size()));
+        }
+        }
+    }
+
+    const DicomJsonReader::BulkDataFunction& m_bulkData;
+    const DicomJsonReader::DatasetFunction& m_found;
+    std::vector<eFrame> m_frames;
+    std::deque<sAttribute> m_attributes;
+    size_t m_depth;
+    // the dataset being read and its items, innermost last
+    std::unique_ptr<DcmDataset> m_dataset;
+    std::vector<DcmItem*> m_items;
+    DcmTagKey m_tag;
+    bool m_nonAscii;
+    bool m_stopped;
+    std::string m_error;
+};
+
+}
+
+bool DicomJsonReader::read(const char* data, size_t length, const BulkDataFunction& bulkData, const DatasetFunction& found, std::string& error)
+{
+    DatasetBuilder builder(bulkData, found);
+    if (json::sax_parse(nlohmann::detail::input_adapter(data, length), &builder) || builder.stopped()) {
+        return true;
+    }
+    error = builder.error().empty() ? "invalid DICOM JSON" : builder.error();
+    return false;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcdatset.h"
+
+// Builds datasets from the DICOM JSON model (PS3.18 F.2) while the text is parsed, attribute by
+// attribute from the SAX events of the parser, without building a JSON document first. Values are
+// put into the elements in their binary form where the VR has one, InlineBinary is decoded and a
+// BulkDataURI is resolved by the caller, e.g. to the Buffers passed along with the JSON. Strings in
+// JSON are UTF-8, datasets with other than ASCII characters get the Specific Character Set
+// ISO_IR 192. Bulk data is taken as native little endian values, encapsulated pixel data cannot be
+// expressed in JSON, so the datasets come in Explicit VR Little Endian.
+class DicomJsonReader
+{
+public:
+    // the bytes of a BulkDataURI, false if the URI is unknown
+    typedef std::function<bool(const std::string& uri, const char*& data, size_t& length)> BulkDataFunction;
+
+    // called with each dataset read, ownership is transferred. Returns false to stop reading
+    typedef std::function<bool(DcmDataset* dataset)> DatasetFunction;
+
+    // reads one dataset object or an array of them, as DICOMweb metadata responses hold. False with
+    // error set on a JSON syntax error or an invalid attribute, the datasets before it were handed
+    // over already
+    static bool read(const char* data, size_t length, const BulkDataFunction& bulkData, const DatasetFunction& found, std::string& error);
+};
@@ -0,0 +1,134 @@
+#include "DimseExecutor.h"
+#include "CpuPlacement.h"
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+
+namespace {
+
+    const unsigned weights[DcmQueryRetrieveScheduler::PC_Count] = {
+        DcmQueryRetrieveScheduler::defaultHighWeight, DcmQueryRetrieveScheduler::defaultMediumWeight, DcmQueryRetrieveScheduler::defaultLowWeight
+    };
+
+    struct sLane {
+        sLane() : limit(DimseExecutor::defaultConcurrency), running(0), virtualTime(0) {
+            for (double& p : pass) p = 0;
+        }
+        size_t limit;
+        size_t running;
+        // per priority class, a job of the class with the smallest virtual time starts next
+        std::deque< std::function<void()> > jobs[DcmQueryRetrieveScheduler::PC_Count];
+        double pass[DcmQueryRetrieveScheduler::PC_Count];
+        double virtualTime;
+
+        size_t queued() const {
+            size_t count = 0;
+            for (const auto& queue : jobs) count += queue.size();
+            return count;
+        }
+
+        void push(const std::function<void()>& job, DimseExecutor::Priority priority) {
+            // an idle class does not save up starts
+            if (jobs[priority].empty()) pass[priority] = std::max(pass[priority], virtualTime);
+            jobs[priority].push_back(job);
+        }
+
+        // false if no job is queued
+        bool pop(std::function<void()>& job) {
+            int next = -1;
+            for (int i = 0; i < DcmQueryRetrieveScheduler::PC_Count; ++i) {
+                if (!jobs[i].empty() && (next < 0 || pass[i] < pass[next])) next = i;
+            }
+            if (next < 0) return false;
+            job = jobs[next].front();
+            jobs[next].pop_front();
+            virtualTime = pass[next];
+            pass[next] += 1.0 / weights[next];
+            return true;
+        }
+    };
+
+    std::mutex executorMutex;
+    std::map<std::string, sLane> lanes;
+
+    size_t defaultLimit(const std::string& operation)
+    {
+        // file operations are bound by the CPU, not by the peer
+        size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        if (operation == "parse" || operation == "recompress" || operation == "anonymize" || operation == "render") return cores;
+        if (operation == "find") return 8;
+        if (operation == "scp" || operation == "shutdown" || operation == "watch") return 0;
+        return DimseExecutor::defaultConcurrency;
+    }
+
+    // expects executorMutex to be locked
+    sLane& lane(const std::string& operation)
+    {
+        std::map<std::string, sLane>::iterator it = lanes.find(operation);
+        if (it == lanes.end()) {
+            it = lanes.insert(std::make_pair(operation, sLane())).first;
+            it->second.limit = defaultLimit(operation);
+        }
+        return it->second;
+    }
+
+    // runs queued jobs of the operation until there are none left or the limit was lowered
+    void drain(std::string operation)
+    {
+        // the jobs of the thread run on the node its placement policy assigns, with their memory
+        CpuPlacement::Scope placement(operation);
+        std::unique_lock<std::mutex> lock(executorMutex);
+        while (true) {
+            sLane& l = lane(operation);
+            std::function<void()> job;
+            if ((l.limit > 0 && l.running > l.limit) || !l.pop(job)) {
+                --l.running;
+                return;
+            }
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+    }
+
+    // starts up to count threads for queued jobs, expects executorMutex to be locked
+    void spawn(const std::string& operation, sLane& l, size_t count)
+    {
+        for (size_t i = 0; i < count && (l.limit == 0 || l.running < l.limit); ++i) {
+            ++l.running;
+            std::thread(drain, operation).detach();
+        }
+    }
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DimseExecutor::submit(const std::string& operation, const std::function<void()>& job, Priority priority)
+{
+    std::lock_guard<std::mutex> lock(executorMutex);
+    sLane& l = lane(operation);
+    l.push(job, priority < DcmQueryRetrieveScheduler::PC_Count ? priority : DcmQueryRetrieveScheduler::PC_Medium);
+    spawn(operation, l, 1);
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DimseExecutor::setConcurrency(const std::string& operation, size_t limit)
+{
+    std::lock_guard<std::mutex> lock(executorMutex);
+    sLane& l = lane(operation);
+    l.limit = limit;
+    spawn(operation, l, l.queued());
+}
+
+//--------------------------------------------------------------------------------------------
+
+size_t DimseExecutor::concurrency(const std::string& operation)
+{
+    std::lock_guard<std::mutex> lock(executorMutex);
+    return lane(operation).limit;
+}
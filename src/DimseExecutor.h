@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <functional>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
+
+// Native executor for worker requests, keeps blocking DIMSE calls off the libuv threadpool
+// that Node shares with fs and crypto. Requests are queued per operation ("echo", "find",
+// "get", "move", "store", "scp", "shutdown", "parse", "recompress", "anonymize", "render", "loadtest", "generate",
+// "reindex", "tier", "index", "verify", "watch", "prefetch", "media"), each operation runs at most its concurrency limit of requests at a time. A limit of
+// zero means no limit, this is the default for "scp" and "watch" since their workers run until stopped.
+// Requests waiting for their operation are started weighted fair by priority class, with the
+// weights of DcmQueryRetrieveScheduler, so an interactive retrieve overtakes a queued migration.
+// The threads of an operation are placed on the NUMA nodes by the CpuPlacement policy of its name.
+class DimseExecutor
+{
+public:
+    typedef DcmQueryRetrieveScheduler::PriorityClass Priority;
+
+    static void submit(const std::string& operation, const std::function<void()>& job, Priority priority = DcmQueryRetrieveScheduler::PC_Medium);
+
+    // applies to requests started afterwards, running requests are not interrupted
+    static void setConcurrency(const std::string& operation, size_t limit);
+
+    static size_t concurrency(const std::string& operation);
+
+    // limit of operations without explicit default
+    static const size_t defaultConcurrency = 4;
+};
@@ -0,0 +1,202 @@
+#include "DirectoryScanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_WINDOWS_H
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+namespace
+{
+
+enum eEntryType {
+    ENTRY_FILE,
+    ENTRY_DIRECTORY,
+    ENTRY_OTHER
+};
+
+std::string joinPath(const std::string& directory, const char* name)
+{
+    if (directory.empty() || directory == ".") {
+        return name;
+    }
+    const char last = directory[directory.size() - 1];
+    if (last == PATH_SEPARATOR || last == '/') {
+        return directory + name;
+    }
+    return directory + PATH_SEPARATOR + name;
+}
+
+// what path is once links are followed, for entries whose type the directory does not tell
+eEntryType statType(const std::string& path)
+{
+#ifdef HAVE_WINDOWS_H
+    struct _stati64 st;
+    if (_stati64(path.c_str(), &st) != 0)
+        return ENTRY_OTHER;
+    return (st.st_mode & _S_IFDIR) ? ENTRY_DIRECTORY : (st.st_mode & _S_IFREG) ? ENTRY_FILE : ENTRY_OTHER;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return ENTRY_OTHER;
+    return S_ISDIR(st.st_mode) ? ENTRY_DIRECTORY : S_ISREG(st.st_mode) ? ENTRY_FILE : ENTRY_OTHER;
+#endif
+}
+
+// reads one directory, adding its files and subdirectories, false if it cannot be opened
+bool readDirectory(const std::string& directory, std::vector<std::string>& files, std::vector<std::string>& subdirectories)
+{
+#ifdef HAVE_WINDOWS_H
+    WIN32_FIND_DATAA data;
+    HANDLE handle = FindFirstFileExA(joinPath(directory, "*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    do {
+        if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0)
+            continue;
+        std::string path = joinPath(directory, data.cFileName);
+        eEntryType type = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? ENTRY_DIRECTORY : ENTRY_FILE;
+        // reparse points may be links to either
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+            type = statType(path);
+        if (type == ENTRY_DIRECTORY)
+            subdirectories.push_back(path);
+        else if (type == ENTRY_FILE)
+            files.push_back(path);
+    } while (FindNextFileA(handle, &data));
+    FindClose(handle);
+#else
+    DIR* dir = opendir(directory.empty() ? "." : directory.c_str());
+    if (dir == NULL)
+        return false;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        std::string path = joinPath(directory, entry->d_name);
+        eEntryType type;
+#ifdef _DIRENT_HAVE_D_TYPE
+        switch (entry->d_type)
+        {
+        case DT_REG:
+            type = ENTRY_FILE;
+            break;
+        case DT_DIR:
+            type = ENTRY_DIRECTORY;
+            break;
+        case DT_LNK:
+        case DT_UNKNOWN:
+            type = statType(path);
+            break;
+        default:
+            type = ENTRY_OTHER;
+            break;
+        }
+#else
+        type = statType(path);
+#endif
+        if (type == ENTRY_DIRECTORY)
+            subdirectories.push_back(path);
+        else if (type == ENTRY_FILE)
+            files.push_back(path);
+    }
+    closedir(dir);
+#endif
+    return true;
+}
+
+}
+
+size_t DirectoryScanner::scan(const OFFilename& directory, size_t threads, const FileFunction& found, const std::function<bool()>& cancelled)
+{
+    // directories waiting to be read, the walk is over once none is left and none is being read
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::string> pending(1, std::string(directory.getCharPointer()));
+    size_t reading = 0;
+    std::atomic<size_t> fileCount(0);
+    std::atomic<size_t> directoryCount(0);
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+
+    auto walk = [&]() {
+        OFLog::setThreadLogLevel(logLevel);
+        std::vector<std::string> files;
+        std::vector<std::string> subdirectories;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [&] { return !pending.empty() || reading == 0; });
+            if (pending.empty() || (cancelled && cancelled())) {
+                break;
+            }
+            // depth first, which keeps the queue short and the files of a series together
+            const std::string current = pending.back();
+            pending.pop_back();
+            ++reading;
+            lock.unlock();
+
+            files.clear();
+            subdirectories.clear();
+            if (!readDirectory(current, files, subdirectories)) {
+                DCMNET_WARN("cannot read directory " << current << ", ignoring it");
+            }
+            ++directoryCount;
+            lock.lock();
+            pending.insert(pending.end(), subdirectories.begin(), subdirectories.end());
+            lock.unlock();
+            changed.notify_all();
+
+            std::sort(files.begin(), files.end());
+            for (const std::string& file : files) {
+                found(OFFilename(file.c_str()));
+            }
+            fileCount += files.size();
+
+            lock.lock();
+            --reading;
+        }
+        // the last reader wakes up the others to let them end
+        lock.unlock();
+        changed.notify_all();
+    };
+
+    std::vector<std::thread> walkers;
+    for (size_t t = 1; t < std::max<size_t>(threads, 1); ++t) {
+        walkers.push_back(std::thread(walk));
+    }
+    walk();
+    for (std::thread& walker : walkers) {
+        walker.join();
+    }
+    DCMNET_DEBUG("found " << fileCount << " files in " << directoryCount << " directories below " << directory.getCharPointer());
+    return fileCount;
+}
+
+size_t DirectoryScanner::list(const OFFilename& directory, size_t threads, OFList<OFFilename>& files)
+{
+    std::mutex mutex;
+    std::vector<std::string> found;
+    scan(directory, threads, [&mutex, &found](const OFFilename& file) {
+        std::lock_guard<std::mutex> lock(mutex);
+        found.push_back(file.getCharPointer());
+    });
+    std::sort(found.begin(), found.end());
+    for (const std::string& file : found) {
+        files.push_back(OFFilename(file.c_str()));
+    }
+    return found.size();
+}
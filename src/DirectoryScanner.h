@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/ofstd/oflist.h"
+
+// Walks a directory tree on a pool of threads and hands each file over as soon as its directory is
+// read, so processing starts with the first files instead of once the whole tree is listed. On POSIX
+// systems the entry type readdir() reports saves a stat per entry, which is only needed for symbolic
+// links and file systems that report no type; on Windows FindFirstFileEx() fetches the entries in
+// large batches without their short names. Like OFStandard::searchDirectoryRecursively(), links are
+// followed and "." and ".." skipped, files are named by their path below the directory given.
+class DirectoryScanner
+{
+public:
+    // called for each file, by the thread that read its directory, concurrently for files of
+    // different directories
+    typedef std::function<void(const OFFilename& file)> FileFunction;
+
+    // calls found for each file below directory, read by up to threads threads. Stops reading
+    // directories once cancelled returns true, returns the number of files found
+    static size_t scan(const OFFilename& directory, size_t threads, const FileFunction& found,
+        const std::function<bool()>& cancelled = std::function<bool()>());
+
+    // adds the files below directory to files, sorted by path
+    static size_t list(const OFFilename& directory, size_t threads, OFList<OFFilename>& files);
+};
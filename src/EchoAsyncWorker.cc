@@ -1,11 +1,15 @@
 #include "EchoAsyncWorker.h"
 
+#include <chrono>
 #include <iostream>
 #include <list>
 #include <memory>
 #include <sstream>
 
 #include "Utils.h"
+#include "AssociationPool.h"
+#include "EchoProbe.h"
+#include "TlsTransport.h"
 #include "json.h"
 
 using json = nlohmann::json;
@@ -66,6 +70,9 @@ const char *transferSyntaxes[] = {
     UID_JPEG2000TransferSyntax,
     UID_JPEG2000Part2MulticomponentImageCompressionLosslessOnlyTransferSyntax,
     UID_JPEG2000Part2MulticomponentImageCompressionTransferSyntax,
+    UID_HTJ2KLosslessTransferSyntax,
+    UID_HTJ2KLosslessRPCLTransferSyntax,
+    UID_HTJ2KTransferSyntax,
     UID_MPEG2MainProfileAtMainLevelTransferSyntax,
     UID_MPEG2MainProfileAtHighLevelTransferSyntax,
     UID_MPEG4HighProfileLevel4_1TransferSyntax,
@@ -76,13 +83,15 @@ const char *transferSyntaxes[] = {
     UID_HEVCMainProfileLevel5_1TransferSyntax,
     UID_HEVCMain10ProfileLevel5_1TransferSyntax};
 
-OFCondition echoSCU(T_ASC_Association *assoc)
+OFCondition echoSCU(T_ASC_Association *assoc, T_DIMSE_BlockingMode blockMode, int timeout)
 /*
      * This function will send a C-ECHO-RQ over the network to another DICOM application
      * and handle the response.
      *
      * Parameters:
-     *   assoc - [in] The association (network connection to another DICOM application).
+     *   assoc     - [in] The association (network connection to another DICOM application).
+     *   blockMode - [in] The blocking mode for receiving the response.
+     *   timeout   - [in] Seconds to wait for the response in non-blocking mode.
      */
 {
     DIC_US msgId = assoc->nextMsgID++;
@@ -93,7 +102,7 @@ OFCondition echoSCU(T_ASC_Association *assoc)
     // OFLOG_INFO(echoscuLogger, "Sending Echo Request (MsgID " << msgId << ")");
 
     /* send C-ECHO-RQ and handle response */
-    OFCondition cond = DIMSE_echoUser(assoc, msgId, DIMSE_BLOCKING, 0, &status, &statusDetail);
+    OFCondition cond = DIMSE_echoUser(assoc, msgId, blockMode, timeout, &status, &statusDetail);
 
     /* depending on if a response was received, dump some information */
     if (cond.good())
@@ -110,7 +119,7 @@ OFCondition echoSCU(T_ASC_Association *assoc)
     return cond;
 }
 
-OFCondition cecho(T_ASC_Association *assoc, unsigned long num_repeat)
+OFCondition cecho(T_ASC_Association *assoc, unsigned long num_repeat, T_DIMSE_BlockingMode blockMode, int timeout)
 /*
      * This function will send num_repeat C-ECHO-RQ messages to the DICOM application
      * this application is connected with and handle corresponding C-ECHO-RSP messages.
@@ -118,6 +127,8 @@ OFCondition cecho(T_ASC_Association *assoc, unsigned long num_repeat)
      * Parameters:
      *   assoc      - [in] The association (network connection to another DICOM application).
      *   num_repeat - [in] The amount of C-ECHO-RQ messages which shall be sent.
+     *   blockMode  - [in] The blocking mode for receiving the responses.
+     *   timeout    - [in] Seconds to wait for each response in non-blocking mode.
      */
 {
     OFCondition cond = EC_Normal;
@@ -126,7 +137,7 @@ OFCondition cecho(T_ASC_Association *assoc, unsigned long num_repeat)
     /* as long as no error occurred and the counter does not equal 0 */
     /* send an C-ECHO-RQ and handle the response */
     while (cond.good() && n--)
-        cond = echoSCU(assoc);
+        cond = echoSCU(assoc, blockMode, timeout);
 
     return cond;
 }
@@ -138,7 +149,7 @@ EchoAsyncWorker::EchoAsyncWorker(std::string data, Function &callback)
 
 void EchoAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-    ns::sInput in = ns::parseInputJson(_input);
+    ns::sInput in = GetInput();
 
     EnableVerboseLogging(in.verbose);
 
@@ -154,6 +165,20 @@ void EchoAsyncWorker::Execute(const ExecutionProgress &progress)
         return;
     }
 
+    if (in.reuseAssociation)
+    {
+        // echo on a pooled association, doubles as keep alive for idle ones
+        AssociationPool::configure(in.associationIdleTimeout);
+        OFCondition cond = AssociationPool::run(in.source, in.target, in.network, [](DcmSCU &scu) -> OFCondition {
+            return scu.sendECHORequest(0);
+        });
+        if (cond.bad())
+        {
+            SetErrorJson(std::string("Echo SCU Failed: ") + cond.text());
+        }
+        return;
+    }
+
     OFOStringStream optStream;
     int result = EXITCODE_NO_ERROR;
 
@@ -162,14 +187,14 @@ void EchoAsyncWorker::Execute(const ExecutionProgress &progress)
     const char *opt_peerTitle = in.target.aet.c_str();
     const char *opt_ourTitle = in.source.aet.c_str();
 
-    OFCmdUnsignedInt opt_maxReceivePDULength = ASC_DEFAULTMAXPDU;
+    OFCmdUnsignedInt opt_maxReceivePDULength = in.network.maxReceivePDU();
     OFCmdUnsignedInt opt_repeatCount = 1;
     OFBool opt_abortAssociation = OFFalse;
     OFCmdUnsignedInt opt_numXferSyntaxes = 1;
     OFCmdUnsignedInt opt_numPresentationCtx = 1;
     OFCmdUnsignedInt maxXferSyntaxes =
         OFstatic_cast(OFCmdUnsignedInt, (DIM_OF(transferSyntaxes)));
-    int opt_acse_timeout = 30;
+    int opt_acse_timeout = in.network.acseTimeoutSeconds();
 
     T_ASC_Network *net;
     T_ASC_Parameters *params;
@@ -186,6 +211,13 @@ void EchoAsyncWorker::Execute(const ExecutionProgress &progress)
         SetErrorJson(cond.text());
         return;
     }
+    ASC_setTCPSocketOptions(net, in.network.socketBufferSize, in.network.tcpNoDelay);
+    cond = TlsTransport::secure(net, false, in.network);
+    if (cond.bad())
+    {
+        SetErrorJson(cond.text());
+        return;
+    }
 
     /* initialize association parameters, i.e. create an instance of T_ASC_Parameters*. */
     cond = ASC_createAssociationParameters(&params, opt_maxReceivePDULength);
@@ -203,6 +235,7 @@ void EchoAsyncWorker::Execute(const ExecutionProgress &progress)
     /* corresponding values into the association parameters.*/
     sprintf(peerHost, "%s:%d", opt_peer, OFstatic_cast(int, opt_port));
     ASC_setPresentationAddresses(params, OFStandard::getHostName().c_str(), peerHost);
+    ASC_setTransportLayerType(params, in.network.tls);
 
     /* Set the presentation contexts which will be negotiated */
     /* when the network connection will be established */
@@ -255,7 +288,7 @@ void EchoAsyncWorker::Execute(const ExecutionProgress &progress)
 
     /* do the real work, i.e. send a number of C-ECHO-RQ messages to the DICOM application */
     /* this application is connected with and handle corresponding C-ECHO-RSP messages. */
-    cond = cecho(assoc, opt_repeatCount);
+    cond = cecho(assoc, opt_repeatCount, in.network.dimseBlockMode(), in.network.dimseTimeoutSeconds());
 
     /* tear down association, i.e. terminate network connection to SCP */
     if (cond == EC_Normal)
@@ -327,3 +360,72 @@ void EchoAsyncWorker::Execute(const ExecutionProgress &progress)
 
     OFStandard::shutdownNetwork();
 }
+
+EchoManyAsyncWorker::EchoManyAsyncWorker(std::string data, Function &callback)
+    : BaseAsyncWorker(data, callback) {}
+
+void EchoManyAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (!in.source.valid())
+    {
+        SetErrorJson("Source not set");
+        return;
+    }
+
+    if (in.peers.empty())
+    {
+        SetErrorJson("Peers not set");
+        return;
+    }
+
+    if (in.network.tls)
+    {
+        // the probes write the PDUs to plain sockets
+        SetErrorJson("TLS peers are probed with echoScu");
+        return;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<EchoProbe::sResult> results = EchoProbe::run(in.source, in.peers, in.network, CancelFlag());
+    if (Cancelled())
+    {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+
+    json peers = json::array();
+    size_t reachable = 0;
+    for (const EchoProbe::sResult &result : results)
+    {
+        json v = json::object();
+        v["aet"] = result.peer.aet;
+        v["ip"] = result.peer.ip;
+        v["port"] = result.peer.port;
+        v["status"] = EchoProbe::name(result.status);
+        v["dimseStatus"] = result.dimseStatus;
+        v["connect"] = result.connect;
+        v["associate"] = result.associate;
+        v["echo"] = result.echo;
+        v["total"] = result.total;
+        if (!result.error.empty())
+        {
+            v["error"] = result.error;
+        }
+        if (result.status == EchoProbe::OK)
+        {
+            ++reachable;
+        }
+        peers.push_back(v);
+    }
+
+    json v = json::object();
+    v["peers"] = peers;
+    v["reachable"] = reachable;
+    v["unreachable"] = results.size() - reachable;
+    v["elapsed"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -12,3 +12,12 @@ class EchoAsyncWorker : public BaseAsyncWorker
         void Execute(const ExecutionProgress& progress);
 
 };
+
+// C-ECHO of all peers at once from one thread, returns their latencies
+class EchoManyAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        EchoManyAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
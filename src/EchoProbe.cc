@@ -0,0 +1,593 @@
+#include "EchoProbe.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmnet/dul.h"
+#include "dcmtk/dcmnet/dntypes.h"
+#include "dcmtk/ofstd/ofsockad.h"
+#include "dcmtk/ofstd/ofstd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+// PDU types of PS3.8 9.3
+const unsigned char PDU_ASSOCIATE_RQ = 0x01;
+const unsigned char PDU_ASSOCIATE_AC = 0x02;
+const unsigned char PDU_ASSOCIATE_RJ = 0x03;
+const unsigned char PDU_DATA_TF = 0x04;
+const unsigned char PDU_RELEASE_RQ = 0x05;
+const unsigned char PDU_RELEASE_RP = 0x06;
+const unsigned char PDU_ABORT = 0x07;
+
+// the only presentation context proposed
+const unsigned char verificationContext = 1;
+
+// bytes of the PDU header and of the fixed fields of an A-ASSOCIATE-AC before its items
+const size_t pduHeaderLength = 6;
+const size_t associateFixedLength = 68;
+
+// longest PDU accepted from a peer, an A-ASSOCIATE-AC or C-ECHO-RSP is a few hundred bytes
+const size_t maxPduLength = 1024 * 1024;
+
+enum eState { CONNECTING, ASSOCIATING, ECHOING, RELEASING, DONE };
+
+struct sProbe {
+    sProbe() : socket(DCMNET_INVALID_SOCKET), state(DONE) {}
+    EchoProbe::sResult result;
+    DcmNativeSocketType socket;
+    eState state;
+    Clock::time_point deadline;
+    Clock::time_point connected;
+    Clock::time_point associated;
+    std::string out;    // bytes still to be sent
+    std::string in;     // bytes received, not yet a complete PDU
+    std::string command;    // command fragments of the C-ECHO-RSP
+};
+
+void put16(std::string& s, size_t value)
+{
+    s += static_cast<char>((value >> 8) & 0xff);
+    s += static_cast<char>(value & 0xff);
+}
+
+void put32(std::string& s, size_t value)
+{
+    put16(s, (value >> 16) & 0xffff);
+    put16(s, value & 0xffff);
+}
+
+void putLE16(std::string& s, size_t value)
+{
+    s += static_cast<char>(value & 0xff);
+    s += static_cast<char>((value >> 8) & 0xff);
+}
+
+void putLE32(std::string& s, size_t value)
+{
+    putLE16(s, value & 0xffff);
+    putLE16(s, (value >> 16) & 0xffff);
+}
+
+size_t get16(const std::string& s, size_t at)
+{
+    return (static_cast<unsigned char>(s[at]) << 8) | static_cast<unsigned char>(s[at + 1]);
+}
+
+size_t get32(const std::string& s, size_t at)
+{
+    return (get16(s, at) << 16) | get16(s, at + 2);
+}
+
+size_t getLE16(const std::string& s, size_t at)
+{
+    return static_cast<unsigned char>(s[at]) | (static_cast<unsigned char>(s[at + 1]) << 8);
+}
+
+size_t getLE32(const std::string& s, size_t at)
+{
+    return getLE16(s, at) | (getLE16(s, at + 2) << 16);
+}
+
+std::string pdu(unsigned char type, const std::string& body)
+{
+    std::string s;
+    s += static_cast<char>(type);
+    s += '\0';
+    put32(s, body.size());
+    return s + body;
+}
+
+void item(std::string& s, unsigned char type, const std::string& value)
+{
+    s += static_cast<char>(type);
+    s += '\0';
+    put16(s, value.size());
+    s += value;
+}
+
+// command element of group 0000 in Implicit VR Little Endian
+void element(std::string& s, size_t tagElement, const std::string& value)
+{
+    putLE16(s, 0x0000);
+    putLE16(s, tagElement);
+    putLE32(s, value.size());
+    s += value;
+}
+
+std::string aeTitle(const std::string& aet)
+{
+    std::string s = aet.substr(0, 16);
+    s.resize(16, ' ');
+    return s;
+}
+
+std::string associateRequest(const ns::sIdent& source, const ns::sIdent& target, size_t maxPdu)
+{
+    std::string context;
+    context += static_cast<char>(verificationContext);
+    context.append(3, '\0');
+    item(context, 0x30, UID_VerificationSOPClass);
+    item(context, 0x40, UID_LittleEndianImplicitTransferSyntax);
+
+    std::string maxLength;
+    put32(maxLength, maxPdu);
+    std::string user;
+    item(user, 0x51, maxLength);
+    item(user, 0x52, OFFIS_IMPLEMENTATION_CLASS_UID);
+    item(user, 0x55, OFFIS_DTK_IMPLEMENTATION_VERSION_NAME);
+
+    std::string body;
+    put16(body, 0x0001);    // protocol version
+    put16(body, 0);
+    body += aeTitle(target.aet);
+    body += aeTitle(source.aet);
+    body.append(32, '\0');
+    item(body, 0x10, UID_StandardApplicationContext);
+    item(body, 0x20, context);
+    item(body, 0x50, user);
+    return pdu(PDU_ASSOCIATE_RQ, body);
+}
+
+std::string echoRequest()
+{
+    std::string sopClass = UID_VerificationSOPClass;
+    if (sopClass.size() % 2 != 0) {
+        sopClass += '\0';
+    }
+    std::string value;
+    std::string elements;
+    element(elements, 0x0002, sopClass);
+    value.clear();
+    putLE16(value, 0x0030);     // C-ECHO-RQ
+    element(elements, 0x0100, value);
+    value.clear();
+    putLE16(value, 1);          // message ID
+    element(elements, 0x0110, value);
+    value.clear();
+    putLE16(value, 0x0101);     // no data set
+    element(elements, 0x0800, value);
+
+    std::string groupLength;
+    putLE32(groupLength, elements.size());
+    std::string command;
+    element(command, 0x0000, groupLength);
+    command += elements;
+
+    std::string pdv;
+    put32(pdv, command.size() + 2);
+    pdv += static_cast<char>(verificationContext);
+    pdv += static_cast<char>(0x03);     // last fragment of a command
+    pdv += command;
+    return pdu(PDU_DATA_TF, pdv);
+}
+
+std::string releaseRequest()
+{
+    return pdu(PDU_RELEASE_RQ, std::string(4, '\0'));
+}
+
+// Status (0000,0900) of a command, false if it has none
+bool commandStatus(const std::string& command, unsigned short& status)
+{
+    for (size_t at = 0; at + 8 <= command.size();) {
+        size_t tagGroup = getLE16(command, at);
+        size_t tagElement = getLE16(command, at + 2);
+        size_t length = getLE32(command, at + 4);
+        if (tagGroup == 0x0000 && tagElement == 0x0900 && length == 2 && at + 10 <= command.size()) {
+            status = static_cast<unsigned short>(getLE16(command, at + 8));
+            return true;
+        }
+        if (length > command.size()) {
+            break;
+        }
+        at += 8 + length;
+    }
+    return false;
+}
+
+double elapsedMs(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+std::string socketError(int code)
+{
+    char buffer[256];
+    return OFStandard::strerror(code, buffer, sizeof(buffer));
+}
+
+int lastSocketError()
+{
+#ifdef _WIN32
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+bool wouldBlock(int code)
+{
+#ifdef _WIN32
+    return code == WSAEWOULDBLOCK || code == WSAEINPROGRESS;
+#else
+    return code == EAGAIN || code == EWOULDBLOCK || code == EINPROGRESS || code == EINTR;
+#endif
+}
+
+void closeSocket(sProbe& probe)
+{
+    if (probe.socket != DCMNET_INVALID_SOCKET) {
+#ifdef _WIN32
+        closesocket(probe.socket);
+#else
+        close(probe.socket);
+#endif
+        probe.socket = DCMNET_INVALID_SOCKET;
+    }
+    probe.state = DONE;
+}
+
+void fail(sProbe& probe, EchoProbe::eStatus status, const std::string& error)
+{
+    probe.result.status = status;
+    probe.result.error = error;
+    closeSocket(probe);
+}
+
+// the address of the peer, like DUL resolves it
+bool resolve(const std::string& host, int port, OFSockAddr& address)
+{
+    unsigned long numeric = inet_addr(host.c_str());
+    if (numeric != INADDR_NONE) {
+        address.setFamily(AF_INET);
+        address.getSockaddr_in()->sin_addr.s_addr = numeric;
+    }
+    else {
+        DUL_HostResolver resolver = dcmHostResolver.get();
+        if (resolver) {
+            resolver(host.c_str(), address);
+        }
+        else {
+            OFStandard::getAddressByHostname(host.c_str(), address);
+        }
+        if (address.getFamily() == 0) {
+            return false;
+        }
+    }
+    address.setPort(htons(static_cast<unsigned short>(port)));
+    return true;
+}
+
+void start(sProbe& probe, const ns::sNetworkOptions& network, Clock::time_point now)
+{
+    const ns::sIdent& peer = probe.result.peer;
+    probe.deadline = now + std::chrono::seconds(network.acseTimeoutSeconds());
+    OFSockAddr address;
+    if (!peer.valid()) {
+        fail(probe, EchoProbe::UNREACHABLE, "target not set");
+        return;
+    }
+    if (!resolve(peer.ip, peer.port, address)) {
+        fail(probe, EchoProbe::UNREACHABLE, "unknown host " + peer.ip);
+        return;
+    }
+    probe.socket = socket(address.getFamily(), SOCK_STREAM, 0);
+    if (probe.socket == DCMNET_INVALID_SOCKET) {
+        fail(probe, EchoProbe::UNREACHABLE, socketError(lastSocketError()));
+        return;
+    }
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(probe.socket, FIONBIO, &nonBlocking);
+#else
+    fcntl(probe.socket, F_SETFL, fcntl(probe.socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    probe.state = CONNECTING;
+    if (connect(probe.socket, address.getSockaddr(), address.size()) != 0) {
+        int code = lastSocketError();
+        if (!wouldBlock(code)) {
+            fail(probe, EchoProbe::UNREACHABLE, socketError(code));
+        }
+    }
+}
+
+// sends what is pending, false if the connection broke
+bool flush(sProbe& probe)
+{
+    while (!probe.out.empty()) {
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        long sent = send(probe.socket, probe.out.data(), static_cast<int>(probe.out.size()), flags);
+        if (sent < 0) {
+            return wouldBlock(lastSocketError());
+        }
+        probe.out.erase(0, static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+void release(sProbe& probe, const ns::sNetworkOptions& network, Clock::time_point now)
+{
+    probe.out += releaseRequest();
+    probe.state = RELEASING;
+    probe.deadline = now + std::chrono::seconds(network.acseTimeoutSeconds());
+}
+
+void handleAssociateResponse(sProbe& probe, unsigned char type, const std::string& body, const ns::sNetworkOptions& network,
+    Clock::time_point now)
+{
+    if (type == PDU_ASSOCIATE_RJ && body.size() >= 4) {
+        std::ostringstream error;
+        error << "association rejected, result " << static_cast<int>(static_cast<unsigned char>(body[1]))
+              << ", source " << static_cast<int>(static_cast<unsigned char>(body[2]))
+              << ", reason " << static_cast<int>(static_cast<unsigned char>(body[3]));
+        fail(probe, EchoProbe::REJECTED, error.str());
+        return;
+    }
+    if (type != PDU_ASSOCIATE_AC) {
+        fail(probe, EchoProbe::ABORTED, type == PDU_ABORT ? "association aborted" : "unexpected PDU");
+        return;
+    }
+    probe.associated = now;
+    probe.result.associate = elapsedMs(probe.connected, now);
+    bool accepted = false;
+    for (size_t at = associateFixedLength; at + 4 <= body.size();) {
+        size_t length = get16(body, at + 2);
+        if (static_cast<unsigned char>(body[at]) == 0x21 && length >= 4 && at + 8 <= body.size()) {
+            accepted = accepted || (static_cast<unsigned char>(body[at + 4]) == verificationContext && body[at + 6] == 0);
+        }
+        at += 4 + length;
+    }
+    if (!accepted) {
+        probe.result.status = EchoProbe::REJECTED;
+        probe.result.error = "Verification not accepted";
+        release(probe, network, now);
+        return;
+    }
+    probe.out += echoRequest();
+    probe.state = ECHOING;
+    probe.deadline = now + std::chrono::seconds(network.dimseTimeoutSeconds() > 0 ? network.dimseTimeoutSeconds() : network.acseTimeoutSeconds());
+}
+
+void handleEchoResponse(sProbe& probe, unsigned char type, const std::string& body, const ns::sNetworkOptions& network,
+    Clock::time_point started, Clock::time_point now)
+{
+    if (type != PDU_DATA_TF) {
+        fail(probe, EchoProbe::ABORTED, type == PDU_ABORT ? "association aborted" : "unexpected PDU");
+        return;
+    }
+    for (size_t at = 0; at + 6 <= body.size();) {
+        size_t length = get32(body, at);
+        if (length < 2 || at + 4 + length > body.size()) {
+            fail(probe, EchoProbe::ABORTED, "malformed PDV");
+            return;
+        }
+        unsigned char control = static_cast<unsigned char>(body[at + 5]);
+        if (control & 0x01) {
+            probe.command.append(body, at + 6, length - 2);
+            if (control & 0x02) {
+                unsigned short status = 0;
+                if (!commandStatus(probe.command, status)) {
+                    fail(probe, EchoProbe::ABORTED, "C-ECHO-RSP without status");
+                    return;
+                }
+                probe.result.echo = elapsedMs(probe.associated, now);
+                probe.result.total = elapsedMs(started, now);
+                probe.result.dimseStatus = status;
+                probe.result.status = status == 0 ? EchoProbe::OK : EchoProbe::FAILED;
+                release(probe, network, now);
+                return;
+            }
+        }
+        at += 4 + length;
+    }
+}
+
+// reads what arrived and handles complete PDUs
+void receive(sProbe& probe, const ns::sNetworkOptions& network, Clock::time_point started, Clock::time_point now)
+{
+    char buffer[4096];
+    while (probe.state != DONE) {
+        long received = recv(probe.socket, buffer, sizeof(buffer), 0);
+        if (received < 0 && wouldBlock(lastSocketError())) {
+            break;
+        }
+        if (received <= 0) {
+            if (probe.state == RELEASING) {
+                closeSocket(probe);
+            }
+            else {
+                fail(probe, EchoProbe::ABORTED, "connection closed by peer");
+            }
+            return;
+        }
+        probe.in.append(buffer, static_cast<size_t>(received));
+        while (probe.state != DONE && probe.in.size() >= pduHeaderLength) {
+            size_t length = get32(probe.in, 2);
+            if (length > maxPduLength) {
+                fail(probe, EchoProbe::ABORTED, "PDU too large");
+                return;
+            }
+            if (probe.in.size() < pduHeaderLength + length) {
+                break;
+            }
+            unsigned char type = static_cast<unsigned char>(probe.in[0]);
+            std::string body = probe.in.substr(pduHeaderLength, length);
+            probe.in.erase(0, pduHeaderLength + length);
+            if (probe.state == ASSOCIATING) {
+                handleAssociateResponse(probe, type, body, network, now);
+            }
+            else if (probe.state == ECHOING) {
+                handleEchoResponse(probe, type, body, network, started, now);
+            }
+            else if (type == PDU_RELEASE_RP || type == PDU_ABORT) {
+                closeSocket(probe);
+            }
+        }
+    }
+}
+
+}
+
+std::vector<EchoProbe::sResult> EchoProbe::run(const ns::sIdent& source, const std::vector<ns::sIdent>& peers, const ns::sNetworkOptions& network,
+    const std::atomic<bool>* cancel)
+{
+    OFStandard::initializeNetwork();
+    const Clock::time_point started = Clock::now();
+    std::vector<sProbe> probes(peers.size());
+    for (size_t i = 0; i < peers.size(); ++i) {
+        probes[i].result.peer = peers[i];
+        start(probes[i], network, started);
+    }
+
+    std::vector<struct pollfd> fds;
+    std::vector<size_t> polled;
+    while (true) {
+        Clock::time_point now = Clock::now();
+        fds.clear();
+        polled.clear();
+        int wait = pollInterval;
+        for (size_t i = 0; i < probes.size(); ++i) {
+            sProbe& probe = probes[i];
+            if (probe.state == DONE) {
+                continue;
+            }
+            if (now >= probe.deadline) {
+                if (probe.state != RELEASING) {
+                    fail(probe, TIMEOUT, probe.state == CONNECTING ? "no connection within the ACSE timeout" :
+                        probe.state == ASSOCIATING ? "no A-ASSOCIATE-AC within the ACSE timeout" : "no C-ECHO-RSP within the DIMSE timeout");
+                }
+                closeSocket(probe);
+                continue;
+            }
+            struct pollfd pfd;
+            pfd.fd = probe.socket;
+            pfd.events = POLLIN;
+            if (probe.state == CONNECTING || !probe.out.empty()) {
+                pfd.events |= POLLOUT;
+            }
+            pfd.revents = 0;
+            fds.push_back(pfd);
+            polled.push_back(i);
+            wait = std::min(wait, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(probe.deadline - now).count()) + 1);
+        }
+        if (fds.empty()) {
+            break;
+        }
+        if (cancel != NULL && cancel->load()) {
+            for (size_t i : polled) {
+                fail(probes[i], TIMEOUT, "cancelled");
+            }
+            break;
+        }
+
+#ifdef _WIN32
+        int found = WSAPoll(&fds[0], static_cast<ULONG>(fds.size()), wait);
+#else
+        int found = ::poll(&fds[0], static_cast<nfds_t>(fds.size()), wait);
+#endif
+        if (found <= 0) {
+            continue;
+        }
+        now = Clock::now();
+        for (size_t k = 0; k < fds.size(); ++k) {
+            sProbe& probe = probes[polled[k]];
+            if (fds[k].revents == 0) {
+                continue;
+            }
+            if (probe.state == CONNECTING) {
+                int code = 0;
+                socklen_t length = sizeof(code);
+                getsockopt(probe.socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&code), &length);
+                if (code != 0) {
+                    fail(probe, UNREACHABLE, socketError(code));
+                    continue;
+                }
+                probe.connected = now;
+                probe.result.connect = elapsedMs(started, now);
+                probe.out += associateRequest(source, probe.result.peer, network.maxReceivePDU());
+                probe.state = ASSOCIATING;
+            }
+            if (fds[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+                receive(probe, network, started, now);
+            }
+            if (probe.state != DONE && !flush(probe)) {
+                if (probe.state == RELEASING) {
+                    closeSocket(probe);
+                }
+                else {
+                    fail(probe, ABORTED, "connection closed by peer");
+                }
+            }
+        }
+    }
+
+    std::vector<sResult> results;
+    results.reserve(probes.size());
+    for (sProbe& probe : probes) {
+        closeSocket(probe);
+        results.push_back(probe.result);
+    }
+    OFStandard::shutdownNetwork();
+    return results;
+}
+
+const char* EchoProbe::name(eStatus status)
+{
+    switch (status) {
+        case OK:
+            return "ok";
+        case FAILED:
+            return "failed";
+        case REJECTED:
+            return "rejected";
+        case ABORTED:
+            return "aborted";
+        case UNREACHABLE:
+            return "unreachable";
+        default:
+            return "timeout";
+    }
+}
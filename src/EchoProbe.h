@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+// C-ECHO of many peers at once from a single thread, for health sweeps. Each peer gets a non-blocking
+// connect and a small state machine: A-ASSOCIATE-RQ proposing Verification, C-ECHO-RQ, A-RELEASE-RQ.
+// The PDUs are few and fixed, so they are written and read here directly and one poll() waits for all
+// sockets, instead of a thread blocked in DUL per peer. A sweep takes about as long as the slowest
+// peer that answers or the timeout, whichever is shorter. Plain TCP only.
+class EchoProbe
+{
+public:
+    enum eStatus {
+        OK,             // C-ECHO-RSP with status Success
+        FAILED,         // C-ECHO-RSP with another status
+        REJECTED,       // association rejected or Verification not accepted
+        ABORTED,        // A-ABORT or a malformed PDU from the peer
+        UNREACHABLE,    // unknown host or connection refused
+        TIMEOUT         // no answer within the timeout
+    };
+
+    struct sResult {
+        sResult() : status(TIMEOUT), dimseStatus(0), connect(-1), associate(-1), echo(-1), total(-1) {}
+        ns::sIdent peer;
+        eStatus status;
+        unsigned short dimseStatus;
+        // ms of the connect, the A-ASSOCIATE round trip and the C-ECHO round trip, and from the start of
+        // the sweep to the C-ECHO-RSP, -1 if not reached
+        double connect;
+        double associate;
+        double echo;
+        double total;
+        std::string error;
+    };
+
+    // connecting and negotiating the association with each peer may take acseTimeout seconds, the
+    // C-ECHO-RSP dimseTimeout seconds more. Returns once every peer answered or timed out, or cancel is
+    // set, with the results in order of the peers
+    static std::vector<sResult> run(const ns::sIdent& source, const std::vector<ns::sIdent>& peers, const ns::sNetworkOptions& network,
+        const std::atomic<bool>* cancel = NULL);
+
+    // "ok", "failed", "rejected", "aborted", "unreachable" or "timeout"
+    static const char* name(eStatus status);
+
+    // upper bound of a poll, cancel is checked in between
+    static const int pollInterval = 100;
+};
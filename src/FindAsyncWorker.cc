@@ -2,6 +2,9 @@
 
 #include "json.h"
 #include "Utils.h"
+#include "AssociationPool.h"
+#include "FindCache.h"
+#include "TlsTransport.h"
 
 #include <iostream>
 #include <sstream>
@@ -9,6 +12,14 @@
 #include <list>
 #include <iomanip>
 #include <vector>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <set>
 
 using json = nlohmann::json;
 
@@ -19,6 +30,8 @@ using json = nlohmann::json;
 #include "dcmtk/dcmdata/dcdict.h"
 #include "dcmtk/dcmdata/dcostrmz.h"
 #include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcpath.h"
+#include "dcmtk/dcmdata/dcproj.h"
 
 #ifdef WITH_ZLIB
 #include <zlib.h>
@@ -29,37 +42,19 @@ using json = nlohmann::json;
 
 namespace
 {
-std::vector<std::string> split(const std::string& s, char delimiter)
+std::vector<std::string> split(const char* s, size_t length, char delimiter)
 {
     std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(s);
-    while (std::getline(tokenStream, token, delimiter))
+    const char* end = s + length;
+    while (s != end)
     {
-        tokens.push_back(token);
+        const char* next = std::find(s, end, delimiter);
+        tokens.push_back(std::string(s, next));
+        s = next == end ? end : next + 1;
     }
     return tokens;
 }
 
-std::string to_utf8(std::string str)
-{
-    std::string strOut;
-    for (std::string::iterator it = str.begin(); it != str.end(); ++it)
-    {
-        uint8_t ch = *it;
-        if (ch < 0x80)
-        {
-            strOut.push_back(ch);
-        }
-        else
-        {
-            strOut.push_back(0xc0 | ch >> 6);
-            strOut.push_back(0x80 | (ch & 0x3f));
-        }
-    }
-    return strOut;
-}
-
 std::string str_toupper(std::string s)
 {
     std::transform(s.begin(), s.end(), s.begin(),
@@ -75,11 +70,71 @@ std::string int_to_hex(uint16_t i)
     return str_toupper(stream.str());
 }
 
+// DICOM JSON of the attributes of one response
+json toDicomJson(const ns::DicomResponse &obj)
+{
+    json v = json::object();
+    for (size_t e = 0; e < obj.size(); ++e)
+    {
+        const char *value = obj.value(e);
+        const size_t length = obj.length(e);
+        std::string keyName = int_to_hex(obj.tag(e).getGroup()) + int_to_hex(obj.tag(e).getElement());
+        DcmTag t(obj.tag(e));
+        std::string vr = std::string(t.getVR().getVRName());
+        json jsonValue = json::array();
+        if (vr == "PN") {
+            json j;
+            j["Alphabetic"] = std::string(value, length);
+            jsonValue.push_back(j);
+        }
+        else if (vr == "IS" || vr == "SL" || vr == "SS" || vr == "UL" || vr == "US") {
+            if (length == 0) {
+                jsonValue.push_back(nullptr);
+            }
+            else {
+                std::vector<std::string> splitValue = split(value, length, '\\');
+                for (auto i : splitValue) {
+                    try {
+                        jsonValue.push_back(std::stoi(i));
+                    }
+                    catch (...) {
+                        jsonValue.push_back(nullptr);
+                    }
+                }
+            }
+        }
+        else if (vr == "DS" || vr == "FL" || vr == "FD") {
+            if (length == 0) {
+                jsonValue.push_back(nullptr);
+            }
+            else {
+                std::vector<std::string> splitValue = split(value, length, '\\');
+                for (auto i : splitValue) {
+                    try {
+                        jsonValue.push_back(std::stof(i));
+                    }
+                    catch (...) {
+                        jsonValue.push_back(nullptr);
+                    }
+                }
+            }
+        }
+        else {
+            jsonValue = split(value, length, '\\');
+        }
+
+        v[keyName]["vr"] = vr;
+        if (!(jsonValue.size() == 1 &&  jsonValue[0] == nullptr)) {
+            v[keyName]["Value"] = jsonValue;
+        }
+    }
+    return v;
+}
 
 class FindScuCallback : public DcmFindSCUCallback
 {
 public:
-    FindScuCallback(const ns::DicomObject &rqContainer, std::list<ns::DicomObject> *rspContainer);
+    FindScuCallback(const ns::DicomObject &rqContainer, std::vector<ns::DicomResponse> *rspContainer);
 
     ~FindScuCallback() {}
 
@@ -89,16 +144,48 @@ public:
         T_DIMSE_C_FindRSP *rsp,
         DcmDataset *responseIdentifiers);
 
+    // converts the requested attributes of one response, returns false once maxResults
+    // responses have been accepted, further ones are dropped
+    bool addResponse(DcmDataset *responseIdentifiers);
+
+    // responses accepted so far
+    size_t accepted() const { return m_accepted; }
+
+    // starts over for a repeated request
+    void reset() { m_accepted = 0; m_cancelSent = false; }
+
+    // only the requested attributes are read from the responses
+    const DcmReadProjection *responseProjection() const { return &m_projection; }
+
     std::string charset;
 
+    // a C-CANCEL is sent with the next response once the flag is set
+    const std::atomic<bool> *cancelled;
+
+    // responses accepted before a C-CANCEL is sent, 0 accepts all
+    size_t maxResults;
+
+    // number of collected responses for which sendChunk is called, 0 keeps all of them
+    size_t chunkSize;
+
+    // hands the collected responses to JS and clears the container
+    std::function<void()> sendChunk;
+
 private:
     ns::DicomObject m_requestContainer;
-    std::list<ns::DicomObject> *m_responseContainer;
+    DcmReadProjection m_projection;
+    std::vector<ns::DicomResponse> *m_responseContainer;
+    bool m_cancelSent;
+    size_t m_accepted;
 };
 
-FindScuCallback::FindScuCallback(const ns::DicomObject &rqContainer, std::list<ns::DicomObject> *rspContainer)
-    : m_requestContainer(rqContainer), m_responseContainer(rspContainer)
+FindScuCallback::FindScuCallback(const ns::DicomObject &rqContainer, std::vector<ns::DicomResponse> *rspContainer)
+    : cancelled(NULL), maxResults(0), chunkSize(0), m_requestContainer(rqContainer), m_responseContainer(rspContainer), m_cancelSent(false), m_accepted(0)
 {
+    for (const ns::DicomElement &element : m_requestContainer)
+    {
+        m_projection.addTag(element.xtag);
+    }
 }
 
 void FindScuCallback::callback(T_DIMSE_C_FindRQ *request, int &responseCount, T_DIMSE_C_FindRSP *rsp, DcmDataset *responseIdentifiers)
@@ -122,39 +209,197 @@ void FindScuCallback::callback(T_DIMSE_C_FindRQ *request, int &responseCount, T_
         OFLOG_INFO(rspLogger, DcmObject::PrintHelper(*responseIdentifiers));
     }
 
+    const bool more = addResponse(responseIdentifiers);
+
+    if (!m_cancelSent && (!more || (cancelled != NULL && cancelled->load())))
+    {
+        m_cancelSent = true;
+        DCMNET_INFO((more ? "Request cancelled" : "Enough responses received") << ", sending C-CANCEL");
+        OFCondition cond = DIMSE_sendCancelRequest(assoc_, presId_, request->MessageID);
+        if (cond.bad())
+        {
+            DCMNET_WARN("Cannot send C-CANCEL: " << cond.text());
+        }
+    }
+}
+
+bool FindScuCallback::addResponse(DcmDataset *responseIdentifiers)
+{
+    if (maxResults > 0 && m_accepted >= maxResults)
+    {
+        return false;
+    }
+
     // convert characterset if requested
     bool useSimpleUtf8Convert = true;
+    // values converted from Latin-1 by the simple conversion, their character set is UTF-8 afterwards
+    bool latin1Converted = false;
 #if DCMTK_ENABLE_CHARSET_CONVERSION == DCMTK_CHARSET_CONVERSION_ICONV
       OFString sourceCharset;
       responseIdentifiers->findAndGetOFStringArray(DCM_SpecificCharacterSet, sourceCharset, OFFalse);
       if (sourceCharset.empty() && !charset.empty()) {
         sourceCharset = OFString(charset.c_str());
       }
-      if (!sourceCharset.empty()) {
+      // Latin-1 is converted by the simple conversion, UTF-8 needs none
+      if (sourceCharset == "ISO_IR 192") {
+          useSimpleUtf8Convert = false;
+      }
+      else if (sourceCharset == "ISO_IR 100") {
+          latin1Converted = true;
+      }
+      else if (!sourceCharset.empty()) {
           if (responseIdentifiers->convertCharacterSet(sourceCharset, OFString("ISO_IR 192")).bad()) {
-              OFLOG_WARN(rspLogger, "failed to convert " << sourceCharset << " to ISO_IR 192");
+              DCMNET_WARN("failed to convert " << sourceCharset << " to ISO_IR 192");
           } else {
             useSimpleUtf8Convert = false;
           }
       }
 #endif
 
-    ns::DicomObject responseItem;
+    // the values are converted straight into the string of the response
+    m_responseContainer->push_back(ns::DicomResponse());
+    ns::DicomResponse &responseItem = m_responseContainer->back();
+    responseItem.reserve(m_requestContainer.size());
+    OFString value;
     for (const ns::DicomElement &element : m_requestContainer)
     {
-        OFString value;
+        if (latin1Converted && element.xtag == DCM_SpecificCharacterSet) {
+            static const char utf8[] = "ISO_IR 192";
+            responseItem.add(element.xtag, utf8, sizeof(utf8) - 1, false);
+            continue;
+        }
         // TODO: use correct method depending on VR type 
         OFCondition status = responseIdentifiers->findAndGetOFStringArray(element.xtag, value);
         if (status.good()) {
-            ns::DicomElement cp;
-            cp.xtag = element.xtag;
-            cp.value = useSimpleUtf8Convert ? to_utf8(value.c_str()) : std::string(value.c_str());
-            responseItem.push_back(cp);
+            responseItem.add(element.xtag, value.c_str(), strlen(value.c_str()), useSimpleUtf8Convert);
+        }
+    }
+    ++m_accepted;
+    if (chunkSize > 0 && m_responseContainer->size() >= chunkSize && sendChunk)
+    {
+        sendChunk();
+    }
+    return maxResults == 0 || m_accepted < maxResults;
+}
+
+void applyOverrideKeys(DcmDataset *dataset, const OFList<OFString> &overrideKeys)
+{
+    /* replace specific keys by those in overrideKeys */
+    OFListConstIterator(OFString) path = overrideKeys.begin();
+    OFListConstIterator(OFString) endOfList = overrideKeys.end();
+    DcmPathProcessor proc;
+    proc.setItemWildcardSupport(OFFalse);
+    proc.checkPrivateReservations(OFFalse);
+    OFCondition cond;
+    while (path != endOfList)
+    {
+        cond = proc.applyPathWithValue(dataset, *path);
+        if (cond.bad())
+        {
+            DCMNET_WARN("Bad override key: " << cond.text());
         }
+        path++;
     }
-    m_responseContainer->push_back(responseItem);
 }
 
+// identifies identical queries: calling and called peer, query model, the attributes sorted by
+// tag and the options changing the result
+std::string cacheKey(const ns::sInput &in, const char *queryModel, const ns::DicomObject &queryAttributes)
+{
+    std::vector<std::pair<DcmTagKey, std::string> > attributes;
+    for (const ns::DicomElement &element : queryAttributes)
+    {
+        attributes.push_back(std::make_pair(element.xtag, element.value));
+    }
+    std::stable_sort(attributes.begin(), attributes.end(),
+        [](const std::pair<DcmTagKey, std::string> &a, const std::pair<DcmTagKey, std::string> &b) { return a.first < b.first; });
+
+    std::ostringstream key;
+    key << in.source.aet << '\n' << in.target.aet << '@' << in.target.ip << ':' << in.target.port << '\n'
+        << queryModel << '\n' << in.charset << '\n' << in.maxResults;
+    for (const std::pair<DcmTagKey, std::string> &attribute : attributes)
+    {
+        key << '\n' << attribute.first.toString() << '=' << attribute.second;
+    }
+    return key.str();
+}
+
+// attribute the responses of the query level are merged on, studies unless the level says otherwise
+DcmTagKey mergeKey(const ns::DicomObject &queryAttributes)
+{
+    for (const ns::DicomElement &element : queryAttributes)
+    {
+        if (element.xtag == DCM_QueryRetrieveLevel)
+        {
+            if (element.value == "PATIENT") return DCM_PatientID;
+            if (element.value == "SERIES") return DCM_SeriesInstanceUID;
+            if (element.value == "IMAGE") return DCM_SOPInstanceUID;
+        }
+    }
+    return DCM_StudyInstanceUID;
+}
+
+// a federated query, shared with the threads querying the peers since these outlive the request
+// when the deadline passes first
+struct sFederation
+{
+    explicit sFederation(size_t peers)
+        : stop(false), fresh(peers, json::array()), results(peers, 0), duplicates(peers, 0), errors(peers), done(peers, false), finished(0)
+    {
+    }
+
+    // adds a response of a peer unless another peer returned the same key value before, responses
+    // without a value are all kept
+    void merge(size_t peer, const ns::DicomResponse &response, const DcmTagKey &key)
+    {
+        std::string value;
+        for (size_t e = 0; e < response.size(); ++e)
+        {
+            if (response.tag(e) == key)
+            {
+                value.assign(response.value(e), response.length(e));
+                break;
+            }
+        }
+        json converted = toDicomJson(response);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!value.empty() && !seen.insert(value).second)
+        {
+            ++duplicates[peer];
+            return;
+        }
+        fresh[peer].push_back(std::move(converted));
+        ++results[peer];
+        changed.notify_all();
+    }
+
+    void finish(size_t peer, const OFCondition &cond)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cond.bad())
+        {
+            errors[peer] = cond.text();
+        }
+        done[peer] = true;
+        ++finished;
+        changed.notify_all();
+    }
+
+    // set once the request returns, peers still running get a C-CANCEL with their next response
+    std::atomic<bool> stop;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::set<std::string> seen;
+    // responses merged and not sent yet, unique and duplicate responses, error and completion per peer
+    std::vector<json> fresh;
+    std::vector<size_t> results;
+    std::vector<size_t> duplicates;
+    std::vector<std::string> errors;
+    std::vector<bool> done;
+    size_t finished;
+};
+
 } // namespace
 
 FindAsyncWorker::FindAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
@@ -163,7 +408,7 @@ FindAsyncWorker::FindAsyncWorker(std::string data, Function &callback) : BaseAsy
 
 void FindAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-    ns::sInput in = ns::parseInputJson(_input);
+    ns::sInput in = GetInput();
 
     EnableVerboseLogging(in.verbose);
 
@@ -204,115 +449,514 @@ void FindAsyncWorker::Execute(const ExecutionProgress &progress)
     DcmXfer netTransPrefer = in.netTransferPrefer.empty() ? DcmXfer(EXS_Unknown) : DcmXfer(in.netTransferPrefer.c_str());
     E_TransferSyntax pref_find_networkTransferSyntax = netTransPrefer.getXfer();
 
-    OFStandard::initializeNetwork();
-
     // enabled or disable removal of trailing padding
     dcmEnableAutomaticInputDataCorrection.set(OFTrue);
 
-    // declare findSCU handler and initialize network
-    DcmFindSCU findscu;
-    OFCondition cond = findscu.initializeNetwork(30);
-    if (cond.bad())
+    std::vector<ns::DicomResponse> result;
+    FindScuCallback callback(queryAttributes, &result);
+    callback.charset = in.charset;
+    callback.cancelled = CancelFlag();
+    callback.maxResults = in.maxResults > 0 ? static_cast<size_t>(in.maxResults) : 0;
+    // with a chunk size the responses are sent as FIND_RESULTS progress messages as they arrive
+    callback.chunkSize = in.chunkSize > 0 ? static_cast<size_t>(in.chunkSize) : 0;
+    // streamed results are collected as well if they are cached
+    const bool caching = in.cacheTtl > 0;
+    json collected = json::array();
+    callback.sendChunk = [&]() {
+        json chunk = json::array();
+        for (const ns::DicomResponse &obj : result)
+        {
+            chunk.push_back(toDicomJson(obj));
+        }
+        result.clear();
+        if (caching)
+        {
+            collected.insert(collected.end(), chunk.begin(), chunk.end());
+        }
+        SendResponse(ns::createResponse(ns::PENDING, "FIND_RESULTS", chunk), progress);
+    };
+
+    // runs the query, the DICOM JSON array of the responses or NULL on failure
+    FindCache::Query runQuery = [&](bool &cacheable) -> FindCache::Result {
+        OFCondition cond;
+        if (in.reuseAssociation)
+        {
+            // run the query on a pooled association, the handshake is skipped for repeated queries
+            AssociationPool::configure(in.associationIdleTimeout);
+            cond = AssociationPool::run(in.source, in.target, in.network, [&](CancellableSCU &scu) -> OFCondition {
+                // a lost connection of a reused association shows up before any response was handed on
+                result.clear();
+                callback.reset();
+                scu.setCancelFlag(CancelFlag());
+                scu.setPriority(ns::dimsePriority(in.priority));
+                scu.setFindResponseHandler([&](DcmDataset *responseIdentifiers) { return callback.addResponse(responseIdentifiers); });
+                T_ASC_PresentationContextID pcid = scu.findPresentationContextID(UID_FINDStudyRootQueryRetrieveInformationModel, "");
+                if (pcid == 0)
+                {
+                    return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
+                }
+                DcmDataset query;
+                applyOverrideKeys(&query, overrideKeys);
+                // the responses are converted by the handler as they arrive
+                return scu.sendFINDRequest(pcid, &query, NULL);
+            });
+            if (cond.bad())
+            {
+                SetErrorJson(std::string("Find SCU Failed: ") + cond.text());
+                return FindCache::Result();
+            }
+        }
+        else
+        {
+            OFStandard::initializeNetwork();
+
+            // declare findSCU handler and initialize network
+            DcmFindSCU findscu;
+            cond = findscu.initializeNetwork(in.network.acseTimeoutSeconds());
+            if (cond.bad())
+            {
+                SetErrorJson(cond.text());
+                return FindCache::Result();
+            }
+            findscu.setTCPSocketOptions(in.network.socketBufferSize, in.network.tcpNoDelay);
+            cond = TlsTransport::secure(findscu, in.network);
+            if (cond.bad())
+            {
+                findscu.dropNetwork();
+                SetErrorJson(cond.text());
+                return FindCache::Result();
+            }
+
+            // do the main work: negotiate network association, perform C-FIND transaction,
+            // process results, and finally tear down the association.
+            cond = findscu.performQuery(
+                in.target.ip.c_str(),
+                in.target.port,
+                in.source.aet.c_str(),
+                in.target.aet.c_str(),
+                UID_FINDStudyRootQueryRetrieveInformationModel,
+                pref_find_networkTransferSyntax,
+                in.network.dimseBlockMode(),
+                in.network.dimseTimeoutSeconds(),
+                in.network.maxReceivePDU(),
+                in.network.tls,
+                false,
+                1,
+                FEM_none,
+                0,
+                &overrideKeys,
+                &callback,
+                NULL,
+                NULL,
+                NULL);
+
+            // destroy network structure
+            OFCondition dropCond = findscu.dropNetwork();
+            OFStandard::shutdownNetwork();
+
+            // a timed out or aborted query is an error, the responses received so far are dropped
+            if (cond.bad())
+            {
+                SetErrorJson(std::string("Find SCU Failed: ") + cond.text());
+                return FindCache::Result();
+            }
+            if (dropCond.bad())
+            {
+                SetErrorJson(dropCond.text());
+                cacheable = false;
+            }
+        }
+
+        // a cancelled query returns an arbitrary part of the responses
+        cacheable = cacheable && !Cancelled();
+        if (callback.chunkSize > 0)
+        {
+            if (!result.empty())
+            {
+                callback.sendChunk();
+            }
+            return std::make_shared<const json>(std::move(collected));
+        }
+
+        // convert result
+        json outJson = json::array();
+        for (const ns::DicomResponse &obj : result)
+        {
+            outJson.push_back(toDicomJson(obj));
+        }
+        return std::make_shared<const json>(std::move(outJson));
+    };
+
+    FindCache::Result output;
+    bool cached = false;
+    if (caching)
+    {
+        if (in.findCacheSize > 0)
+        {
+            FindCache::configure(static_cast<size_t>(in.findCacheSize));
+        }
+        output = FindCache::get(cacheKey(in, UID_FINDStudyRootQueryRetrieveInformationModel, queryAttributes), in.cacheTtl, runQuery, cached);
+        DCMNET_DEBUG("C-FIND result " << (cached ? "taken from the cache" : "queried"));
+    }
+    else
+    {
+        bool cacheable = false;
+        output = runQuery(cacheable);
+    }
+    if (!output)
     {
-        SetErrorJson(cond.text());
         return;
     }
 
-    std::list<ns::DicomObject> result;
-    FindScuCallback callback(queryAttributes, &result);
-    callback.charset = in.charset;
-
-    // do the main work: negotiate network association, perform C-FIND transaction,
-    // process results, and finally tear down the association.
-    cond = findscu.performQuery(
-        in.target.ip.c_str(),
-        in.target.port,
-        in.source.aet.c_str(),
-        in.target.aet.c_str(),
-        UID_FINDStudyRootQueryRetrieveInformationModel,
-        pref_find_networkTransferSyntax,
-        DIMSE_BLOCKING,
-        30,
-        ASC_DEFAULTMAXPDU,
-        false,
-        false,
-        1,
-        FEM_none,
-        0,
-        &overrideKeys,
-        &callback,
-        NULL,
-        NULL,
-        NULL);
-
-    // destroy network structure
-    cond = findscu.dropNetwork();
-    if (cond.bad())
-    {
-        SetErrorJson(cond.text());
-    }
-
-    OFStandard::shutdownNetwork();
-
-    // convert result
-    json outJson = json::array();
-    for (const ns::DicomObject &obj : result)
+    if (callback.chunkSize > 0)
     {
-        json v = json::object();
-        for (const ns::DicomElement &elm : obj)
+        size_t results = callback.accepted();
+        if (cached)
         {
-            std::string value = elm.value;
-            std::string keyName = int_to_hex(elm.xtag.getGroup()) + int_to_hex(elm.xtag.getElement());
-            DcmTag t(elm.xtag);
-            std::string vr = std::string(t.getVR().getVRName());
-            json jsonValue = json::array();
-            if (vr == "PN") {
-                json j;
-                j["Alphabetic"] = value;
-                jsonValue.push_back(j);
+            // a cached result is streamed in chunks as if it had just been received
+            results = output->size();
+            for (size_t first = 0; first < results; first += callback.chunkSize)
+            {
+                const size_t last = std::min(first + callback.chunkSize, results);
+                json chunk(output->begin() + first, output->begin() + last);
+                SendResponse(ns::createResponse(ns::PENDING, "FIND_RESULTS", chunk), progress);
             }
-            else if (vr == "IS" || vr == "SL" || vr == "SS" || vr == "UL" || vr == "US") {
-                if (value.length() == 0) {
-                    jsonValue.push_back(nullptr);
+        }
+        json totals = json::object();
+        totals["results"] = results;
+        _jsonOutput = NativeResult() ? totals : json(totals.dump());
+        return;
+    }
+
+    // the container holds DICOM JSON text unless results are handed over as objects, it stays null without matches
+    if (!output->empty())
+    {
+        _jsonOutput = NativeResult() ? *output : json(output->dump());
+    }
+}
+
+FindBatchAsyncWorker::FindBatchAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void FindBatchAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.queries.empty())
+    {
+        SetErrorJson("Queries not set");
+        return;
+    }
+
+    if (!in.source.valid())
+    {
+        SetErrorJson("Source not set");
+        return;
+    }
+
+    if (!in.target.valid())
+    {
+        SetErrorJson("Target not set");
+        return;
+    }
+
+    // enabled or disable removal of trailing padding
+    dcmEnableAutomaticInputDataCorrection.set(OFTrue);
+
+    // the queries are claimed one by one, each thread keeps reusing its pooled association
+    AssociationPool::configure(in.associationIdleTimeout);
+    const size_t threads = std::min(in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : 1, in.queries.size());
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> succeeded(0);
+    std::atomic<size_t> failed(0);
+    std::vector<std::thread> workers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            for (size_t q = next++; q < in.queries.size() && !Cancelled(); q = next++)
+            {
+                ns::DicomObject queryAttributes;
+                for (const ns::sTag &tag : in.queries[q])
+                {
+                    queryAttributes.push_back(ns::toElement(tag.key, tag.value));
+                }
+                OFList<OFString> overrideKeys;
+                for (const ns::DicomElement &element : queryAttributes)
+                {
+                    overrideKeys.push_back(ns::convertElement(element));
                 }
-                else {
-                    std::vector<std::string> splitValue = split(value, '\\');
-                    for (auto i : splitValue) {
-                        try {
-                            jsonValue.push_back(std::stoi(i));
-                        }
-                        catch (...) {
-                            jsonValue.push_back(nullptr);
-                        }
+
+                std::vector<ns::DicomResponse> result;
+                FindScuCallback callback(queryAttributes, &result);
+                callback.charset = in.charset;
+                callback.maxResults = in.maxResults > 0 ? static_cast<size_t>(in.maxResults) : 0;
+                OFCondition cond = AssociationPool::run(in.source, in.target, in.network, [&](CancellableSCU &scu) -> OFCondition {
+                    result.clear();
+                    callback.reset();
+                    scu.setCancelFlag(CancelFlag());
+                    scu.setPriority(ns::dimsePriority(in.priority));
+                    scu.setFindResponseHandler([&](DcmDataset *responseIdentifiers) { return callback.addResponse(responseIdentifiers); });
+                    T_ASC_PresentationContextID pcid = scu.findPresentationContextID(UID_FINDStudyRootQueryRetrieveInformationModel, "");
+                    if (pcid == 0)
+                    {
+                        return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
                     }
+                    DcmDataset query;
+                    applyOverrideKeys(&query, overrideKeys);
+                    return scu.sendFINDRequest(pcid, &query, NULL);
+                });
+
+                json v = json::object();
+                v["query"] = q;
+                if (cond.bad())
+                {
+                    ++failed;
+                    DCMNET_WARN("query " << q << " failed: " << cond.text());
+                    v["error"] = cond.text();
+                    SendResponse(ns::createResponse(ns::PENDING, "FIND_FAILED", v), progress);
+                    continue;
                 }
-            }
-            else if (vr == "DS" || vr == "FL" || vr == "FD") {
-                if (value.length() == 0) {
-                    jsonValue.push_back(nullptr);
+                ++succeeded;
+                json results = json::array();
+                for (const ns::DicomResponse &obj : result)
+                {
+                    results.push_back(toDicomJson(obj));
                 }
-                else {
-                    std::vector<std::string> splitValue = split(value, '\\');
-                    for (auto i : splitValue) {
-                        try {
-                            jsonValue.push_back(std::stof(i));
-                        }
-                        catch (...) {
-                            jsonValue.push_back(nullptr);
-                        }
+                v["results"] = results;
+                SendResponse(ns::createResponse(ns::PENDING, "FIND_RESULTS", v), progress);
+            }
+        }));
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    if (Cancelled())
+    {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    if (succeeded == 0)
+    {
+        SetErrorJson("Find SCU Failed: no query succeeded");
+        return;
+    }
+    json totals = json::object();
+    totals["queries"] = in.queries.size();
+    totals["succeeded"] = succeeded.load();
+    totals["failed"] = failed.load();
+    _jsonOutput = NativeResult() ? totals : json(totals.dump());
+}
+
+FindFederatedAsyncWorker::FindFederatedAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void FindFederatedAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.tags.empty())
+    {
+        SetErrorJson("Tags not set");
+        return;
+    }
+
+    if (!in.source.valid())
+    {
+        SetErrorJson("Source not set");
+        return;
+    }
+
+    if (in.peers.empty() || std::find_if(in.peers.begin(), in.peers.end(), [](const ns::sIdent &peer) { return !peer.valid(); }) != in.peers.end())
+    {
+        SetErrorJson("Peers not set");
+        return;
+    }
+
+    ns::DicomObject queryAttributes;
+    for (const ns::sTag &tag : in.tags)
+    {
+        queryAttributes.push_back(ns::toElement(tag.key, tag.value));
+    }
+    // the key the responses are merged on is requested from all peers
+    const DcmTagKey key = mergeKey(queryAttributes);
+    if (std::find_if(queryAttributes.begin(), queryAttributes.end(), [&](const ns::DicomElement &element) { return element.xtag == key; }) == queryAttributes.end())
+    {
+        queryAttributes.push_back(ns::toElement(int_to_hex(key.getGroup()) + int_to_hex(key.getElement()), ""));
+    }
+    OFList<OFString> overrideKeys;
+    for (const ns::DicomElement &element : queryAttributes)
+    {
+        overrideKeys.push_back(ns::convertElement(element));
+    }
+
+    // enabled or disable removal of trailing padding
+    dcmEnableAutomaticInputDataCorrection.set(OFTrue);
+
+    // one thread per peer on its pooled association, the request only waits for them until the deadline
+    AssociationPool::configure(in.associationIdleTimeout);
+    const size_t peers = in.peers.size();
+    std::shared_ptr<sFederation> state = std::make_shared<sFederation>(peers);
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    const size_t maxResults = in.maxResults > 0 ? static_cast<size_t>(in.maxResults) : 0;
+    const auto started = std::chrono::steady_clock::now();
+    for (size_t p = 0; p < peers; ++p)
+    {
+        const ns::sIdent source = in.source;
+        const ns::sIdent peer = in.peers[p];
+        const ns::sNetworkOptions network = in.network;
+        const T_DIMSE_Priority priority = ns::dimsePriority(in.priority);
+        const std::string charset = in.charset;
+        std::thread([state, p, source, peer, network, priority, charset, maxResults, queryAttributes, overrideKeys, key, logLevel]() {
+            OFLog::setThreadLogLevel(logLevel);
+            std::vector<ns::DicomResponse> result;
+            FindScuCallback callback(queryAttributes, &result);
+            callback.charset = charset;
+            callback.maxResults = maxResults;
+            OFCondition cond = AssociationPool::run(source, peer, network, [&](CancellableSCU &scu) -> OFCondition {
+                // responses of a failed first attempt are merged already, their repetitions are duplicates
+                callback.reset();
+                scu.setCancelFlag(&state->stop);
+                scu.setPriority(priority);
+                scu.setFindResponseHandler([&](DcmDataset *responseIdentifiers) {
+                    const bool more = callback.addResponse(responseIdentifiers);
+                    for (const ns::DicomResponse &response : result)
+                    {
+                        state->merge(p, response, key);
                     }
+                    result.clear();
+                    return more;
+                });
+                T_ASC_PresentationContextID pcid = scu.findPresentationContextID(UID_FINDStudyRootQueryRetrieveInformationModel, "");
+                if (pcid == 0)
+                {
+                    return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
                 }
+                DcmDataset query;
+                applyOverrideKeys(&query, overrideKeys);
+                return scu.sendFINDRequest(pcid, &query, NULL);
+            });
+            if (cond.bad())
+            {
+                DCMNET_WARN("federated C-FIND: " << peer.aet << " failed: " << cond.text());
             }
-            else {
-                jsonValue = split(value, '\\');
-            }
+            state->finish(p, cond);
+        }).detach();
+    }
 
-            v[keyName]["vr"] = vr;
-            if (!(jsonValue.size() == 1 &&  jsonValue[0] == nullptr)) {
-                v[keyName]["Value"] = jsonValue;
+    // the merged responses are handed on as they arrive until all peers answered or the deadline passed
+    const bool bounded = in.deadline > 0;
+    const auto deadline = started + std::chrono::milliseconds(in.deadline);
+    std::vector<bool> reported(peers, false);
+    bool expired = false;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true)
+    {
+        const bool all = state->finished == peers;
+        std::vector<json> messages;
+        for (size_t p = 0; p < peers; ++p)
+        {
+            if (!state->fresh[p].empty())
+            {
+                json v = json::object();
+                v["peer"] = p;
+                v["results"] = std::move(state->fresh[p]);
+                state->fresh[p] = json::array();
+                messages.push_back(ns::createResponse(ns::PENDING, "FIND_RESULTS", v));
+            }
+            if (state->done[p] && !reported[p] && !state->errors[p].empty())
+            {
+                json v = json::object();
+                v["peer"] = p;
+                v["error"] = state->errors[p];
+                messages.push_back(ns::createResponse(ns::PENDING, "FIND_FAILED", v));
+            }
+            reported[p] = state->done[p];
+        }
+        if (!messages.empty())
+        {
+            lock.unlock();
+            for (const json &message : messages)
+            {
+                SendResponse(message, progress);
             }
+            lock.lock();
+            continue;
+        }
+        if (all || Cancelled())
+        {
+            break;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (bounded && now >= deadline)
+        {
+            expired = true;
+            break;
+        }
+        // the cancel flag is polled
+        const auto wake = now + std::chrono::milliseconds(100);
+        state->changed.wait_until(lock, bounded && deadline < wake ? deadline : wake);
+    }
+    state->stop = true;
+
+    if (Cancelled())
+    {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+
+    json list = json::array();
+    size_t results = 0;
+    size_t duplicates = 0;
+    size_t answered = 0;
+    for (size_t p = 0; p < peers; ++p)
+    {
+        json v = json::object();
+        v["aet"] = in.peers[p].aet;
+        v["ip"] = in.peers[p].ip;
+        v["port"] = in.peers[p].port;
+        v["status"] = !state->done[p] ? "timeout" : state->errors[p].empty() ? "ok" : "failed";
+        v["results"] = state->results[p];
+        v["duplicates"] = state->duplicates[p];
+        if (!state->errors[p].empty())
+        {
+            v["error"] = state->errors[p];
+        }
+        if (state->done[p] && state->errors[p].empty())
+        {
+            ++answered;
         }
-        outJson.push_back(v);
-        _jsonOutput = outJson.dump();
+        results += state->results[p];
+        duplicates += state->duplicates[p];
+        list.push_back(v);
+    }
+    const size_t unanswered = peers - state->finished;
+    lock.unlock();
+
+    if (expired)
+    {
+        DCMNET_WARN("federated C-FIND: deadline passed, " << unanswered << " of " << peers << " peers have not answered");
     }
+    else if (answered == 0)
+    {
+        SetErrorJson("Find SCU Failed: no peer answered");
+        return;
+    }
+
+    json totals = json::object();
+    totals["peers"] = list;
+    totals["results"] = results;
+    totals["duplicates"] = duplicates;
+    totals["answered"] = answered;
+    totals["elapsed"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    _jsonOutput = NativeResult() ? totals : json(totals.dump());
 }
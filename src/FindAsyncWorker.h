@@ -11,3 +11,24 @@ class FindAsyncWorker : public BaseAsyncWorker
 
         void Execute(const ExecutionProgress& progress);
 };
+
+// runs a list of queries over up to parallelism pooled associations, the responses of each query are
+// sent as one FIND_RESULTS progress message holding the index of the query
+class FindBatchAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        FindBatchAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
+
+// runs one query on all peers at once and merges the responses by the unique key of the query level,
+// the new responses of each peer are sent as FIND_RESULTS progress messages holding the index of the
+// peer. Peers that have not answered by the deadline are left behind
+class FindFederatedAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        FindFederatedAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,157 @@
+#include "FindCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct sCacheEntry {
+    FindCache::Result result;
+    Clock::time_point produced;
+    std::list<std::string>::iterator lru;
+};
+
+// a running query, waiters are woken once it is done
+struct sFlight {
+    sFlight() : done(false) {}
+    bool done;
+    FindCache::Result result;
+};
+
+std::mutex cacheMutex;
+std::condition_variable flightDone;
+std::map<std::string, sCacheEntry> cache;
+std::map<std::string, std::shared_ptr<sFlight>> flights;
+// keys, most recently used first
+std::list<std::string> cacheLru;
+size_t cacheMaxEntries = FindCache::defaultMaxEntries;
+std::atomic<size_t> cacheHits(0);
+std::atomic<size_t> cacheJoined(0);
+std::atomic<size_t> cacheMisses(0);
+
+// drops the least recently used results beyond the limit, cacheMutex is held
+void evict()
+{
+    while (cache.size() > cacheMaxEntries) {
+        cache.erase(cacheLru.back());
+        cacheLru.pop_back();
+    }
+}
+
+// stores a result, cacheMutex is held
+void insert(const std::string& key, const FindCache::Result& result, Clock::time_point produced)
+{
+    if (cacheMaxEntries == 0) {
+        return;
+    }
+    std::map<std::string, sCacheEntry>::iterator it = cache.find(key);
+    if (it == cache.end()) {
+        cacheLru.push_front(key);
+        it = cache.insert(std::make_pair(key, sCacheEntry())).first;
+        it->second.lru = cacheLru.begin();
+    }
+    else {
+        cacheLru.splice(cacheLru.begin(), cacheLru, it->second.lru);
+    }
+    it->second.result = result;
+    it->second.produced = produced;
+    evict();
+}
+
+}
+
+FindCache::Result FindCache::get(const std::string& key, int ttl, const Query& query, bool& hit)
+{
+    const Clock::duration maxAge = std::chrono::milliseconds(ttl > 0 ? ttl : 0);
+    std::shared_ptr<sFlight> flight = std::make_shared<sFlight>();
+    {
+        std::unique_lock<std::mutex> lock(cacheMutex);
+        std::map<std::string, sCacheEntry>::iterator it = cache.find(key);
+        if (it != cache.end() && Clock::now() - it->second.produced < maxAge) {
+            ++cacheHits;
+            cacheLru.splice(cacheLru.begin(), cacheLru, it->second.lru);
+            hit = true;
+            return it->second.result;
+        }
+
+        // if the running query fails or is cancelled, the next waiter runs it again
+        std::map<std::string, std::shared_ptr<sFlight>>::iterator running;
+        while ((running = flights.find(key)) != flights.end()) {
+            std::shared_ptr<sFlight> other = running->second;
+            flightDone.wait(lock, [&other] { return other->done; });
+            if (other->result) {
+                ++cacheJoined;
+                hit = true;
+                return other->result;
+            }
+        }
+        flights[key] = flight;
+    }
+
+    ++cacheMisses;
+    hit = false;
+    bool cacheable = true;
+    Result result;
+    // waiters must not be left behind if the query throws
+    struct sLand {
+        sLand(const std::string& k, const std::shared_ptr<sFlight>& f) : key(k), flight(f) {}
+        ~sLand() {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            flight->done = true;
+            flights.erase(key);
+            flightDone.notify_all();
+        }
+        const std::string& key;
+        std::shared_ptr<sFlight> flight;
+    } land(key, flight);
+
+    result = query(cacheable);
+    if (result && cacheable) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        insert(key, result, Clock::now());
+        flight->result = result;
+    }
+    return result;
+}
+
+void FindCache::configure(size_t maxEntries)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheMaxEntries = maxEntries;
+    evict();
+}
+
+void FindCache::clear()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.clear();
+    cacheLru.clear();
+}
+
+size_t FindCache::hits()
+{
+    return cacheHits;
+}
+
+size_t FindCache::joined()
+{
+    return cacheJoined;
+}
+
+size_t FindCache::misses()
+{
+    return cacheMisses;
+}
+
+size_t FindCache::entries()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cache.size();
+}
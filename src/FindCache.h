@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "json.h"
+
+// Results of C-FIND queries kept for later identical queries, which polling clients send every few
+// seconds. Entries are keyed by a string describing peer, query model and query attributes, each
+// caller decides how old a result it accepts. Concurrent identical queries are run once, the others
+// wait for the result of the running one. The cache is process wide, least recently used entries
+// are dropped beyond the limit.
+class FindCache
+{
+public:
+    // DICOM JSON array of the responses
+    typedef std::shared_ptr<const nlohmann::json> Result;
+
+    // runs the query, NULL on failure. A result is only cached if cacheable is left set
+    typedef std::function<Result(bool& cacheable)> Query;
+
+    // returns a result of key at most ttl ms old or runs query to produce it. hit is set if the result
+    // comes from the cache or from a concurrent query, if that one fails query is run as well
+    static Result get(const std::string& key, int ttl, const Query& query, bool& hit);
+
+    // limits the number of cached results, 0 disables the cache (running queries are still shared)
+    static void configure(size_t maxEntries);
+
+    // drops all cached results
+    static void clear();
+
+    // number of get() calls answered from the cache, by a concurrent query and by running the query
+    static size_t hits();
+    static size_t joined();
+    static size_t misses();
+
+    // number of cached results
+    static size_t entries();
+
+    // default limit of cached results
+    static const size_t defaultMaxEntries = 256;
+};
@@ -0,0 +1,590 @@
+#include "Forwarder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcmetinf.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmnet/scu.h"
+
+#include "Metrics.h"
+#include "MultiframeConverter.h"
+#include "TlsTransport.h"
+
+namespace
+{
+
+// an instance queued for a destination
+struct sEntry {
+    std::string path;
+    // the received dataset while it is sent from memory, NULL otherwise
+    std::shared_ptr<DcmFileFormat> dataset;
+    // empty for files queued by an earlier run until their header was read
+    std::string sopClass;
+    std::string xfer;
+};
+
+enum eResult {
+    SENT,
+    RETRY,      // the destination is not reachable or out of resources
+    REJECTED    // the destination does not take the instance
+};
+
+struct sDestination {
+    ns::sIdent peer;
+    std::string name;           // AE@host:port
+    std::string directory;
+    std::deque<sEntry> entries;
+    size_t inMemory;
+    int failures;               // attempts in a row that were retried
+    std::chrono::steady_clock::time_point retryAt;
+    std::vector<std::thread> senders;
+};
+
+std::mutex forwardMutex;
+std::condition_variable forwardChanged;
+bool configured = false;
+bool stopping = false;
+std::vector<Forwarder::sRule> forwardRules;
+// destination of each rule
+std::vector<sDestination*> ruleDestinations;
+std::vector<std::unique_ptr<sDestination> > destinations;
+ns::sIdent forwardSource;
+ns::sNetworkOptions forwardNetwork;
+std::atomic<unsigned> sequence(0);
+
+// presentation contexts proposed at most, as by DcmSCU
+const size_t maxPresentationContexts = 128;
+
+bool hardLink(const std::string& existing, const std::string& link)
+{
+#ifdef HAVE_WINDOWS_H
+    return CreateHardLinkA(link.c_str(), existing.c_str(), NULL) != 0;
+#else
+    return ::link(existing.c_str(), link.c_str()) == 0;
+#endif
+}
+
+std::string directoryName(const ns::sIdent& peer)
+{
+    std::string name = peer.aet + "_" + peer.ip + "_" + std::to_string(peer.port);
+    for (char& c : name) {
+        if (!isalnum(OFstatic_cast(unsigned char, c)) && c != '.' && c != '-') {
+            c = '_';
+        }
+    }
+    return name;
+}
+
+// names sort in the order the instances were queued, also across restarts
+std::string entryName()
+{
+    const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    char name[64];
+    OFStandard::snprintf(name, sizeof(name), "%013lld-%06u.dcm", ms, sequence++ % 1000000);
+    return name;
+}
+
+void updateQueued(const sDestination& d)
+{
+    Metrics::gauge("forward_queued", {{"destination", d.name}}).set(static_cast<int64_t>(d.entries.size()));
+}
+
+// SOP class and transfer syntax of a queued file from its meta header
+bool readHeader(sEntry& entry)
+{
+    DcmFileFormat file;
+    if (file.loadFile(entry.path.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_metaOnly).bad()) {
+        return false;
+    }
+    OFString sopClass;
+    OFString xfer;
+    file.getMetaInfo()->findAndGetOFString(DCM_MediaStorageSOPClassUID, sopClass);
+    file.getMetaInfo()->findAndGetOFString(DCM_TransferSyntaxUID, xfer);
+    entry.sopClass = sopClass.c_str();
+    entry.xfer = xfer.c_str();
+    return !entry.sopClass.empty() && !entry.xfer.empty();
+}
+
+// one association to a destination, renegotiated for SOP classes and transfer syntaxes not proposed yet
+class Sender
+{
+public:
+    explicit Sender(sDestination* destination) : m_destination(destination) {}
+
+    bool connected() const { return m_scu && m_scu->isConnected(); }
+
+    void release()
+    {
+        if (connected()) {
+            m_scu->releaseAssociation();
+        }
+        m_scu.reset();
+    }
+
+    eResult send(sEntry& entry)
+    {
+        if (entry.sopClass.empty() && !readHeader(entry)) {
+            DCMNET_ERROR("forward: cannot read " << entry.path);
+            return REJECTED;
+        }
+        const std::pair<std::string, std::string> context(entry.sopClass, entry.xfer);
+        if (!connected() || m_proposed.count(context) == 0) {
+            OFCondition cond = negotiate(context);
+            if (cond.bad()) {
+                DCMNET_WARN("forward: cannot negotiate an association with " << m_destination->name << ": " << cond.text());
+                return RETRY;
+            }
+        }
+        const T_ASC_PresentationContextID pcid = m_scu->findAnyPresentationContextID(entry.sopClass.c_str(), entry.xfer.c_str());
+        if (pcid == 0) {
+            DCMNET_ERROR("forward: " << m_destination->name << " accepts no presentation context for " << entry.sopClass);
+            return REJECTED;
+        }
+
+        Uint16 status = 0;
+        OFCondition cond = entry.dataset ? m_scu->sendSTORERequest(pcid, OFFilename(), entry.dataset->getDataset(), status)
+            : m_scu->sendSTORERequest(pcid, OFFilename(entry.path.c_str()), NULL, status);
+        if (cond.bad()) {
+            // the association is not usable any more, the instance is sent again on a new one
+            DCMNET_WARN("forward: cannot send to " << m_destination->name << ": " << cond.text());
+            m_scu.reset();
+            return RETRY;
+        }
+        if (status == STATUS_Success || DICOM_WARNING_STATUS(status)) {
+            return SENT;
+        }
+        DCMNET_WARN("forward: " << m_destination->name << " answered " << DU_cstoreStatusString(status) << " for " << entry.path);
+        // out of resources, 0xA7xx
+        return (status & 0xff00) == STATUS_STORE_Refused_OutOfResources ? RETRY : REJECTED;
+    }
+
+private:
+    OFCondition negotiate(const std::pair<std::string, std::string>& context)
+    {
+        release();
+        // one uncompressed context per SOP class and one per compressed transfer syntax in use
+        m_proposed.insert(context);
+        std::set<std::string> sopClasses;
+        for (const std::pair<std::string, std::string>& pc : m_proposed) {
+            sopClasses.insert(pc.first);
+        }
+        if (m_proposed.size() + sopClasses.size() > maxPresentationContexts) {
+            m_proposed.clear();
+            m_proposed.insert(context);
+            sopClasses.clear();
+            sopClasses.insert(context.first);
+        }
+
+        const ns::sIdent& peer = m_destination->peer;
+        m_scu.reset(new DcmSCU());
+        m_scu->setPeerHostName(peer.ip.c_str());
+        m_scu->setPeerPort(OFstatic_cast(Uint16, peer.port));
+        m_scu->setPeerAETitle(peer.aet.c_str());
+        m_scu->setAETitle(forwardSource.aet.c_str());
+        m_scu->setMaxReceivePDULength(forwardNetwork.maxReceivePDU());
+        m_scu->setTCPSocketOptions(forwardNetwork.socketBufferSize, forwardNetwork.tcpNoDelay);
+        m_scu->setACSETimeout(OFstatic_cast(Uint32, forwardNetwork.acseTimeoutSeconds()));
+        m_scu->setDIMSETimeout(OFstatic_cast(Uint32, forwardNetwork.dimseTimeoutSeconds()));
+        m_scu->setDIMSEBlockingMode(forwardNetwork.dimseBlockMode());
+        m_scu->setDatasetConversionMode(OFTrue);
+
+        OFList<OFString> uncompressed;
+        uncompressed.push_back(UID_LittleEndianExplicitTransferSyntax);
+        uncompressed.push_back(UID_LittleEndianImplicitTransferSyntax);
+        OFList<OFString> deflated;
+        deflated.push_back(UID_DeflatedExplicitVRLittleEndianTransferSyntax);
+        deflated.push_back(UID_LittleEndianExplicitTransferSyntax);
+        deflated.push_back(UID_LittleEndianImplicitTransferSyntax);
+        for (const std::string& sopClass : sopClasses) {
+            m_scu->addPresentationContext(sopClass.c_str(), ns::preferDeflate(sopClass.c_str()) ? deflated : uncompressed);
+        }
+        for (const std::pair<std::string, std::string>& pc : m_proposed) {
+            if (DcmXfer(pc.second.c_str()).isEncapsulated()) {
+                OFList<OFString> xfers;
+                xfers.push_back(pc.second.c_str());
+                m_scu->addPresentationContext(pc.first.c_str(), xfers);
+            }
+        }
+
+        // the certificate of each destination has to match its own address
+        ns::sNetworkOptions network = forwardNetwork;
+        network.tlsServerName = peer.ip;
+        OFCondition cond = TlsTransport::secure(*m_scu, network);
+        if (cond.good()) {
+            cond = m_scu->initNetwork();
+        }
+        if (cond.good()) {
+            cond = m_scu->negotiateAssociation();
+        }
+        if (cond.bad()) {
+            m_scu.reset();
+        }
+        return cond;
+    }
+
+    sDestination* m_destination;
+    std::unique_ptr<DcmSCU> m_scu;
+    // SOP class and transfer syntax of the instances sent over the associations so far
+    std::set<std::pair<std::string, std::string> > m_proposed;
+};
+
+void runSender(sDestination* d, OFLogger::LogLevel logLevel)
+{
+    OFLog::setThreadLogLevel(logLevel);
+    Sender sender(d);
+    std::chrono::steady_clock::time_point lastUsed = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(forwardMutex);
+    while (!stopping) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (d->entries.empty() || now < d->retryAt) {
+            if (d->entries.empty() && sender.connected() && now - lastUsed >= std::chrono::seconds(Forwarder::idleTimeout)) {
+                lock.unlock();
+                sender.release();
+                lock.lock();
+                continue;
+            }
+            forwardChanged.wait_until(lock, d->entries.empty() ? now + std::chrono::seconds(Forwarder::idleTimeout) : d->retryAt);
+            continue;
+        }
+
+        sEntry entry = d->entries.front();
+        d->entries.pop_front();
+        if (entry.dataset) {
+            d->inMemory--;
+        }
+        lock.unlock();
+
+        const eResult result = sender.send(entry);
+        lastUsed = std::chrono::steady_clock::now();
+        if (result == SENT) {
+            OFStandard::deleteFile(entry.path.c_str());
+            Metrics::counter("forward_sent_total", {{"destination", d->name}}).add();
+        }
+        else if (result == REJECTED) {
+            OFString name;
+            OFString failed;
+            OFStandard::getFilenameFromPath(name, entry.path.c_str());
+            OFStandard::combineDirAndFilename(failed, OFString((d->directory + "/failed").c_str()), name, OFTrue);
+            if (!OFStandard::renameFile(entry.path.c_str(), failed)) {
+                OFStandard::deleteFile(entry.path.c_str());
+            }
+            DCMNET_ERROR("forward: " << d->name << " did not take " << entry.path << ", kept as " << failed);
+            Metrics::counter("forward_failed_total", {{"destination", d->name}}).add();
+        }
+
+        lock.lock();
+        if (result == RETRY) {
+            // the instance is the next one again, once the backoff is over
+            d->entries.push_front(entry);
+            if (entry.dataset) {
+                d->inMemory++;
+            }
+            const int backoff = std::min(Forwarder::minBackoff << std::min(d->failures, 16), Forwarder::maxBackoff);
+            d->failures++;
+            d->retryAt = std::chrono::steady_clock::now() + std::chrono::seconds(backoff);
+            DCMNET_WARN("forward: retrying " << d->name << " in " << backoff << " s, " << d->entries.size() << " instances queued");
+            Metrics::counter("forward_retries_total", {{"destination", d->name}}).add();
+        }
+        else {
+            d->failures = 0;
+        }
+        updateQueued(*d);
+    }
+    lock.unlock();
+    sender.release();
+}
+
+// the files left by an earlier run, in the order they were queued
+void loadQueue(sDestination& d)
+{
+    OFList<OFString> files;
+    OFStandard::searchDirectoryRecursively(d.directory.c_str(), files, "*", "", OFFalse);
+    std::vector<std::string> paths;
+    for (const OFString& file : files) {
+        const std::string path(file.c_str());
+        if (path.find("/failed/") != std::string::npos || path.find("\\failed\\") != std::string::npos) {
+            continue;
+        }
+        if (path.size() > 5 && path.compare(path.size() - 5, 5, ".part") == 0) {
+            OFStandard::deleteFile(file);
+        }
+        else if (path.size() > 4 && path.compare(path.size() - 4, 4, ".dcm") == 0) {
+            paths.push_back(path);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const std::string& path : paths) {
+        sEntry entry;
+        entry.path = path;
+        d.entries.push_back(entry);
+    }
+    if (!paths.empty()) {
+        DCMNET_INFO("forward: " << paths.size() << " instances still queued for " << d.name);
+    }
+}
+
+// the destination with the queue of peer, NULL if there is none
+sDestination* findDestination(const ns::sIdent& peer)
+{
+    const std::string name = directoryName(peer);
+    for (const std::unique_ptr<sDestination>& d : destinations) {
+        if (directoryName(d->peer) == name) {
+            return d.get();
+        }
+    }
+    return NULL;
+}
+
+bool matches(const std::string& pattern, const std::string& value)
+{
+    return pattern.empty() || pattern == value;
+}
+
+}
+
+bool Forwarder::configure(const std::string& queueDirectory, const std::vector<sRule>& rules, const std::vector<ns::sIdent>& spillTo,
+    const ns::sIdent& source, const ns::sNetworkOptions& network, size_t associations)
+{
+    stop();
+    if (rules.empty() && spillTo.empty()) {
+        return true;
+    }
+    if (!OFStandard::dirExists(queueDirectory.c_str()) && OFStandard::createDirectory(queueDirectory.c_str(), "").bad()) {
+        DCMNET_ERROR("forward: cannot create queue directory " << queueDirectory);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(forwardMutex);
+    forwardRules = rules;
+    forwardSource = source;
+    forwardNetwork = network;
+    ruleDestinations.clear();
+    destinations.clear();
+    std::vector<ns::sIdent> peers = spillTo;
+    for (const sRule& rule : rules) {
+        peers.push_back(rule.destination);
+    }
+    for (const ns::sIdent& peer : peers) {
+        if (findDestination(peer) == NULL) {
+            sDestination* d = new sDestination();
+            destinations.push_back(std::unique_ptr<sDestination>(d));
+            d->peer = peer;
+            d->name = peer.aet + "@" + peer.ip + ":" + std::to_string(peer.port);
+            d->directory = queueDirectory + "/" + directoryName(peer);
+            d->inMemory = 0;
+            d->failures = 0;
+            d->retryAt = std::chrono::steady_clock::now();
+            OFStandard::createDirectory((d->directory + "/failed").c_str(), queueDirectory.c_str());
+            loadQueue(*d);
+            updateQueued(*d);
+        }
+    }
+    for (const sRule& rule : rules) {
+        ruleDestinations.push_back(findDestination(rule.destination));
+    }
+
+    stopping = false;
+    configured = true;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (const std::unique_ptr<sDestination>& d : destinations) {
+        for (size_t i = 0; i < std::max<size_t>(associations, 1); ++i) {
+            d->senders.push_back(std::thread(runSender, d.get(), logLevel));
+        }
+        DCMNET_INFO("forward: instances queued below " << d->directory << " are sent to " << d->name);
+    }
+    return true;
+}
+
+void Forwarder::stop()
+{
+    std::vector<std::thread> senders;
+    {
+        std::lock_guard<std::mutex> lock(forwardMutex);
+        if (!configured) {
+            return;
+        }
+        stopping = true;
+        configured = false;
+        for (const std::unique_ptr<sDestination>& d : destinations) {
+            for (std::thread& sender : d->senders) {
+                senders.push_back(std::move(sender));
+            }
+            d->senders.clear();
+        }
+    }
+    forwardChanged.notify_all();
+    for (std::thread& sender : senders) {
+        sender.join();
+    }
+}
+
+bool Forwarder::isConfigured()
+{
+    std::lock_guard<std::mutex> lock(forwardMutex);
+    return configured;
+}
+
+bool Forwarder::enqueue(const std::string& callingAet, const std::string& sopClass, const std::string& modality,
+    E_TransferSyntax xfer, const std::string& file, const std::shared_ptr<DcmFileFormat>& dataset, bool shareDataset)
+{
+    std::vector<sDestination*> targets;
+    // destinations getting the frames of an enhanced image as classic images, split from a queued file
+    std::vector<sDestination*> splitTargets;
+    {
+        std::lock_guard<std::mutex> lock(forwardMutex);
+        if (!configured) {
+            return true;
+        }
+        for (size_t i = 0; i < forwardRules.size(); ++i) {
+            const sRule& rule = forwardRules[i];
+            sDestination* d = ruleDestinations[i];
+            if (matches(rule.callingAet, callingAet) && matches(rule.modality, modality) && matches(rule.sopClass, sopClass)
+                && std::find(targets.begin(), targets.end(), d) == targets.end()
+                && std::find(splitTargets.begin(), splitTargets.end(), d) == splitTargets.end()) {
+                (rule.format == "classic" && MultiframeConverter::classicSOPClass(sopClass) != NULL ? splitTargets : targets).push_back(d);
+            }
+        }
+    }
+    if (targets.empty() && splitTargets.empty()) {
+        return true;
+    }
+
+    // the first queued file is written or linked to the stored one, the others are linked to it
+    std::vector<std::pair<sDestination*, sEntry> > entries;
+    std::string source = file;
+    std::string spilled;
+    auto discard = [&]() {
+        for (const std::pair<sDestination*, sEntry>& e : entries) {
+            OFStandard::deleteFile(e.second.path.c_str());
+        }
+        if (!spilled.empty()) {
+            OFStandard::deleteFile(spilled.c_str());
+        }
+    };
+    for (sDestination* d : splitTargets) {
+        if (source.empty() && dataset) {
+            spilled = d->directory + "/" + entryName() + ".part";
+            if (dataset->saveFile(spilled.c_str(), xfer, EET_ExplicitLength, EGL_recalcGL, EPD_withoutPadding, 0, 0, EWM_fileformat).bad()) {
+                DCMNET_ERROR("forward: cannot queue " << spilled);
+                discard();
+                return false;
+            }
+            source = spilled;
+        }
+        // the images are read from the source file while they are written
+        const size_t queued = entries.size();
+        std::string error;
+        const bool split = MultiframeConverter::split(source, [&](DcmFileFormat& image, E_TransferSyntax imageXfer) {
+            sEntry entry;
+            entry.path = d->directory + "/" + entryName();
+            OFString imageSopClass;
+            image.getDataset()->findAndGetOFString(DCM_SOPClassUID, imageSopClass);
+            entry.sopClass = imageSopClass.c_str();
+            entry.xfer = DcmXfer(imageXfer).getXferID();
+            const std::string part = entry.path + ".part";
+            if (image.saveFile(part.c_str(), imageXfer, EET_ExplicitLength, EGL_recalcGL, EPD_withoutPadding, 0, 0, EWM_fileformat).bad()
+                || !OFStandard::renameFile(part.c_str(), entry.path.c_str())) {
+                OFStandard::deleteFile(part.c_str());
+                error = "cannot queue " + entry.path;
+                return false;
+            }
+            entries.push_back(std::make_pair(d, entry));
+            return true;
+        }, error);
+        if (!split) {
+            // the destination gets the image as it is rather than nothing
+            DCMNET_WARN("forward: cannot split " << source << " for " << d->name << ", queueing it unchanged: " << error);
+            for (size_t i = queued; i < entries.size(); ++i) {
+                OFStandard::deleteFile(entries[i].second.path.c_str());
+            }
+            entries.resize(queued);
+            targets.push_back(d);
+        }
+    }
+    const size_t firstTarget = entries.size();
+    for (sDestination* d : targets) {
+        sEntry entry;
+        entry.path = d->directory + "/" + entryName();
+        entry.sopClass = sopClass;
+        entry.xfer = DcmXfer(xfer).getXferID();
+        bool queued = false;
+        if (!source.empty()) {
+            queued = hardLink(source, entry.path) || OFStandard::copyFile(source.c_str(), entry.path.c_str());
+        }
+        else if (dataset) {
+            const std::string part = entry.path + ".part";
+            queued = dataset->saveFile(part.c_str(), xfer, EET_ExplicitLength, EGL_recalcGL, EPD_withoutPadding, 0, 0, EWM_fileformat).good()
+                && OFStandard::renameFile(part.c_str(), entry.path.c_str());
+            if (!queued) {
+                OFStandard::deleteFile(part.c_str());
+            }
+            source = entry.path;
+        }
+        if (!queued) {
+            DCMNET_ERROR("forward: cannot queue " << entry.path);
+            discard();
+            return false;
+        }
+        entries.push_back(std::make_pair(d, entry));
+    }
+    if (!spilled.empty()) {
+        OFStandard::deleteFile(spilled.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(forwardMutex);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        sDestination* d = entries[i].first;
+        // a dataset can only be sent by one destination at a time, the others read the file
+        if (i == firstTarget && shareDataset && dataset && d->inMemory < maxDatasetsInMemory) {
+            entries[i].second.dataset = dataset;
+            d->inMemory++;
+        }
+        d->entries.push_back(entries[i].second);
+        updateQueued(*d);
+    }
+    forwardChanged.notify_all();
+    return true;
+}
+
+bool Forwarder::enqueueFile(const ns::sIdent& destination, const std::string& sopClass, const std::string& xfer, const std::string& file)
+{
+    std::lock_guard<std::mutex> lock(forwardMutex);
+    sDestination* d = configured ? findDestination(destination) : NULL;
+    if (d == NULL) {
+        return false;
+    }
+    sEntry entry;
+    entry.path = d->directory + "/" + entryName();
+    entry.sopClass = sopClass;
+    entry.xfer = xfer;
+    if (!OFStandard::renameFile(file.c_str(), entry.path.c_str())) {
+        DCMNET_ERROR("forward: cannot queue " << entry.path);
+        return false;
+    }
+    d->entries.push_back(entry);
+    updateQueued(*d);
+    forwardChanged.notify_all();
+    return true;
+}
+
+size_t Forwarder::queued()
+{
+    std::lock_guard<std::mutex> lock(forwardMutex);
+    size_t count = 0;
+    for (const std::unique_ptr<sDestination>& d : destinations) {
+        count += d->entries.size();
+    }
+    return count;
+}
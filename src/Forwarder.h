@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcxfer.h"
+
+class DcmFileFormat;
+
+// Store-and-forward routing of the instances received by a store SCP. Each instance matching a rule
+// is queued for the rule's destination as a file in a directory of its own below the queue
+// directory, before the C-STORE is acknowledged, and deleted once the destination accepted it.
+// Each destination is served by its own sender threads over associations kept open while there is
+// work, which are renegotiated when an instance of a SOP class or transfer syntax not proposed yet
+// comes along. A destination that cannot be reached or runs out of resources is retried with
+// exponential backoff, instances it refuses otherwise are moved to the failed subdirectory of its
+// queue. The files left queued by an earlier run are sent first. Instances received into memory are
+// sent from the received dataset while the senders keep up, the queued file only serves a restart.
+class Forwarder
+{
+public:
+    typedef ns::sForwardRule sRule;
+
+    // queues the instances matching the rules below queueDirectory from now on and starts
+    // associations senders per destination, which call themselves source over network. The
+    // destinations in spillTo get a queue as well that only enqueueFile() fills. False if the
+    // queue directory cannot be created
+    static bool configure(const std::string& queueDirectory, const std::vector<sRule>& rules, const std::vector<ns::sIdent>& spillTo,
+        const ns::sIdent& source, const ns::sNetworkOptions& network, size_t associations);
+
+    // stops the senders, the instances not sent yet stay queued for the next start
+    static void stop();
+
+    // true between configure() with rules and stop()
+    static bool isConfigured();
+
+    // queues the instance received from callingAet for each destination it matches, as a link to
+    // file if set, otherwise written from dataset in xfer. With shareDataset the caller no longer
+    // uses dataset and it is sent as it is. False if it matches a rule but could not be queued
+    static bool enqueue(const std::string& callingAet, const std::string& sopClass, const std::string& modality,
+        E_TransferSyntax xfer, const std::string& file, const std::shared_ptr<DcmFileFormat>& dataset, bool shareDataset);
+
+    // moves file, a DICOM file with meta header, into the queue of destination. False if the
+    // destination has no queue or the file cannot be moved
+    static bool enqueueFile(const ns::sIdent& destination, const std::string& sopClass, const std::string& xfer, const std::string& file);
+
+    // instances queued and not sent yet, over all destinations
+    static size_t queued();
+
+    // default number of associations per destination
+    static const size_t defaultAssociations = 1;
+
+    // instances per destination kept in memory, the others are sent from their queued file
+    static const size_t maxDatasetsInMemory = 64;
+
+    // seconds between the attempts to reach a destination, doubled up to maxBackoff
+    static const int minBackoff = 1;
+    static const int maxBackoff = 300;
+
+    // seconds an association without work is kept open
+    static const int idleTimeout = 30;
+};
@@ -0,0 +1,678 @@
+#include "FrameIndex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define INCLUDE_CSTRING
+#include "dcmtk/ofstd/ofstdinc.h"
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmdata/dcpixseq.h"
+#include "dcmtk/dcmdata/dcpxitem.h"
+#include "dcmtk/dcmdata/dcswap.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#include "StorageBackend.h"
+#include "StorageTier.h"
+
+namespace
+{
+
+const Uint32 undefinedLength = 0xFFFFFFFF;
+
+// nesting of sequences and items followed when skipping to the pixel data
+const int maxDepth = 64;
+
+// reads element headers, tags and lengths in the byte order of the transfer syntax
+class HeaderReader
+{
+public:
+    HeaderReader(OFFile& file, bool bigEndian) : m_file(file), m_bigEndian(bigEndian) {}
+
+    bool read(void* data, size_t length) { return m_file.fread(data, 1, length) == length; }
+
+    bool skip(Uint32 length) { return m_file.fseek(static_cast<offile_off_t>(length), SEEK_CUR) == 0; }
+
+    offile_off_t tell() { return m_file.ftell(); }
+
+    bool readUint16(Uint16& value)
+    {
+        Uint8 b[2];
+        if (!read(b, 2)) return false;
+        value = m_bigEndian ? static_cast<Uint16>((b[0] << 8) | b[1]) : static_cast<Uint16>((b[1] << 8) | b[0]);
+        return true;
+    }
+
+    bool readUint32(Uint32& value)
+    {
+        Uint8 b[4];
+        if (!read(b, 4)) return false;
+        value = m_bigEndian
+            ? (static_cast<Uint32>(b[0]) << 24) | (static_cast<Uint32>(b[1]) << 16) | (static_cast<Uint32>(b[2]) << 8) | b[3]
+            : (static_cast<Uint32>(b[3]) << 24) | (static_cast<Uint32>(b[2]) << 16) | (static_cast<Uint32>(b[1]) << 8) | b[0];
+        return true;
+    }
+
+    // reads tag, VR (explicit VR only, "UN" for implicit) and value length of the next element
+    bool readHeader(bool explicitVR, DcmTagKey& tag, char vr[3], Uint32& length)
+    {
+        Uint16 group, element;
+        if (!readUint16(group) || !readUint16(element)) return false;
+        tag.set(group, element);
+        vr[0] = 'U'; vr[1] = 'N'; vr[2] = 0;
+        // items and delimiters have no VR
+        if (group == 0xFFFE || !explicitVR) {
+            return readUint32(length);
+        }
+        if (!read(vr, 2)) return false;
+        if (isLongVR(vr)) {
+            Uint16 reserved;
+            return readUint16(reserved) && readUint32(length);
+        }
+        Uint16 shortLength;
+        if (!readUint16(shortLength)) return false;
+        length = shortLength;
+        return true;
+    }
+
+    // skips the items of a sequence with undefined length up to and including its delimiter
+    bool skipSequence(bool explicitVR, int depth)
+    {
+        if (depth > maxDepth) return false;
+        DcmTagKey tag;
+        char vr[3];
+        Uint32 length;
+        while (readHeader(explicitVR, tag, vr, length)) {
+            if (tag == DCM_SequenceDelimitationItem) {
+                return true;
+            }
+            if (tag != DCM_Item) {
+                return false;
+            }
+            if (length == undefinedLength ? !skipItem(explicitVR, depth + 1) : !skip(length)) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+private:
+    static bool isLongVR(const char vr[2])
+    {
+        static const char* const longVRs[] = { "OB", "OD", "OF", "OL", "OV", "OW", "SQ", "SV", "UC", "UN", "UR", "UT", "UV" };
+        for (const char* longVR : longVRs) {
+            if (vr[0] == longVR[0] && vr[1] == longVR[1]) return true;
+        }
+        return false;
+    }
+
+    // skips the elements of an item with undefined length up to and including its delimiter
+    bool skipItem(bool explicitVR, int depth)
+    {
+        DcmTagKey tag;
+        char vr[3];
+        Uint32 length;
+        while (readHeader(explicitVR, tag, vr, length)) {
+            if (tag == DCM_ItemDelimitationItem) {
+                return true;
+            }
+            if (length != undefinedLength) {
+                if (!skip(length)) return false;
+            }
+            // UN with undefined length is encoded in implicit VR little endian
+            else if (!(strcmp(vr, "UN") == 0 && explicitVR ? HeaderReader(m_file, false).skipSequence(false, depth + 1) : skipSequence(explicitVR, depth + 1))) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    OFFile& m_file;
+    bool m_bigEndian;
+};
+
+// seeks to the value of a top level element, length is undefinedLength if encapsulated
+bool seekElement(OFFile& file, const DcmXfer& xfer, const DcmTagKey& target, Uint32& length, std::string& error)
+{
+    const char* missing = target == DCM_PixelData ? "no pixel data" : "no such element";
+    // the meta header is always explicit VR little endian
+    char magic[4];
+    if (file.fseek(128, SEEK_SET) == 0 && file.fread(magic, 1, 4) == 4 && memcmp(magic, "DICM", 4) == 0) {
+        HeaderReader meta(file, false);
+        DcmTagKey tag;
+        char vr[3];
+        for (;;) {
+            const offile_off_t start = meta.tell();
+            Uint16 group;
+            if (!meta.readUint16(group)) {
+                error = missing;
+                return false;
+            }
+            file.fseek(start, SEEK_SET);
+            if (group != 0x0002) break;
+            if (!meta.readHeader(true, tag, vr, length) || length == undefinedLength || !meta.skip(length)) {
+                error = "invalid meta header";
+                return false;
+            }
+        }
+    }
+    else {
+        file.fseek(0, SEEK_SET);
+    }
+
+    const bool explicitVR = xfer.isExplicitVR() != OFFalse;
+    HeaderReader reader(file, xfer.getByteOrder() == EBO_BigEndian);
+    DcmTagKey tag;
+    char vr[3];
+    while (reader.readHeader(explicitVR, tag, vr, length)) {
+        if (tag == target) {
+            return true;
+        }
+        if (length != undefinedLength) {
+            if (reader.skip(length)) continue;
+        }
+        else if (strcmp(vr, "UN") == 0 && explicitVR ? HeaderReader(file, false).skipSequence(false, 1) : reader.skipSequence(explicitVR, 1)) {
+            continue;
+        }
+        error = "cannot parse the data set";
+        return false;
+    }
+    error = missing;
+    return false;
+}
+
+// MPEG-2, MPEG-4 and HEVC, the fragments of their pixel data hold one bit stream of all frames
+bool isVideo(E_TransferSyntax xfer)
+{
+    return xfer >= EXS_MPEG2MainProfileAtMainLevel && xfer <= EXS_HEVCMain10ProfileLevel5_1;
+}
+
+// first bytes of a JPEG, JPEG-LS, JPEG 2000 codestream or JP2 file, used to find the first
+// fragment of each frame without offset table
+bool isFrameStart(const Uint8 b[4])
+{
+    return (b[0] == 0xFF && b[1] == 0xD8) ||
+           (b[0] == 0xFF && b[1] == 0x4F && b[2] == 0xFF && b[3] == 0x51) ||
+           (b[0] == 0x00 && b[1] == 0x00 && b[2] == 0x00 && b[3] == 0x0C);
+}
+
+// size and modification time of a file, false if it cannot be accessed
+bool fileStatus(const std::string& path, long long& size, long long& mtime)
+{
+#ifdef HAVE_WINDOWS_H
+    struct _stati64 st;
+    if (_stati64(path.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#endif
+    size = static_cast<long long>(st.st_size);
+    mtime = static_cast<long long>(st.st_mtime);
+    return true;
+}
+
+struct sCacheEntry {
+    long long size;
+    long long mtime;
+    std::shared_ptr<const FrameIndex> index;
+    std::list<std::string>::iterator lru;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, sCacheEntry> cache;
+// paths, most recently used first
+std::list<std::string> cacheLru;
+size_t cacheMaxEntries = FrameIndex::defaultMaxEntries;
+std::atomic<size_t> cacheHits(0);
+std::atomic<size_t> cacheMisses(0);
+
+// drops the least recently used indices beyond the limit, cacheMutex is held
+void evict()
+{
+    while (cache.size() > cacheMaxEntries) {
+        cache.erase(cacheLru.back());
+        cacheLru.pop_back();
+    }
+}
+
+}
+
+std::shared_ptr<const FrameIndex> FrameIndex::get(const std::string& path, std::string& error)
+{
+    return get(path, DCM_PixelData, error);
+}
+
+std::shared_ptr<const FrameIndex> FrameIndex::get(const std::string& path, const DcmTagKey& tag, std::string& error)
+{
+    // indices of other elements than the pixel data are cached under the path and the tag
+    const std::string key = tag == DCM_PixelData ? path : path + tag.toString().c_str();
+    long long size = 0;
+    long long mtime = 0;
+    if (!fileStatus(path, size, mtime) && StorageArea::isRemote(path)) {
+        // the local copy was evicted from the storage cache, a known index reads its frames with
+        // ranged requests, otherwise the file is fetched to build one
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            std::map<std::string, sCacheEntry>::iterator it = cache.find(key);
+            if (it != cache.end()) {
+                ++cacheHits;
+                cacheLru.splice(cacheLru.begin(), cacheLru, it->second.lru);
+                return it->second.index;
+            }
+        }
+        if (!StorageArea::fetch(path, error)) {
+            return std::shared_ptr<const FrameIndex>();
+        }
+    }
+    if (!fileStatus(path, size, mtime) && StorageTier::isConfigured()) {
+        // migrated to the cold tier, WADO reads recall it like a retrieval
+        if (!StorageTier::recall(path, error)) {
+            return std::shared_ptr<const FrameIndex>();
+        }
+    }
+    if (!fileStatus(path, size, mtime)) {
+        error = "cannot access file";
+        return std::shared_ptr<const FrameIndex>();
+    }
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        std::map<std::string, sCacheEntry>::iterator it = cache.find(key);
+        if (it != cache.end() && it->second.size == size && it->second.mtime == mtime) {
+            ++cacheHits;
+            cacheLru.splice(cacheLru.begin(), cacheLru, it->second.lru);
+            return it->second.index;
+        }
+    }
+
+    ++cacheMisses;
+    std::shared_ptr<FrameIndex> index(new FrameIndex());
+    if (!index->build(path, tag, error)) {
+        return std::shared_ptr<const FrameIndex>();
+    }
+    index->indexStream();
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::map<std::string, sCacheEntry>::iterator it = cache.find(key);
+    if (it == cache.end()) {
+        cacheLru.push_front(key);
+        it = cache.insert(std::make_pair(key, sCacheEntry())).first;
+        it->second.lru = cacheLru.begin();
+    }
+    else {
+        cacheLru.splice(cacheLru.begin(), cacheLru, it->second.lru);
+    }
+    it->second.size = size;
+    it->second.mtime = mtime;
+    it->second.index = index;
+    evict();
+    return index;
+}
+
+void FrameIndex::configure(size_t maxEntries)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheMaxEntries = maxEntries;
+    evict();
+}
+
+size_t FrameIndex::hits()
+{
+    return cacheHits;
+}
+
+size_t FrameIndex::misses()
+{
+    return cacheMisses;
+}
+
+bool FrameIndex::build(const std::string& path, const DcmTagKey& element, std::string& error)
+{
+    m_path = path;
+
+    // the attributes up to the element, the extended offset table comes right before the pixel data
+    DcmFileFormat dfile;
+    OFCondition status = dfile.loadFileUntilTag(OFFilename(path.c_str()), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, element);
+    if (status.bad()) {
+        error = status.text();
+        return false;
+    }
+    DcmDataset* dataset = dfile.getDataset();
+    m_xfer = dataset->getOriginalXfer();
+    const DcmXfer xfer(m_xfer);
+    if (xfer.getStreamCompression() != ESC_none) {
+        error = "deflated data sets cannot be indexed";
+        return false;
+    }
+    m_encapsulated = element == DCM_PixelData && xfer.isEncapsulated();
+
+    Sint32 numberOfFrames = 1;
+    if (dataset->findAndGetSint32(DCM_NumberOfFrames, numberOfFrames).bad() || numberOfFrames < 1) {
+        numberOfFrames = 1;
+    }
+    const size_t frames = static_cast<size_t>(numberOfFrames);
+
+    OFFile file;
+    if (!file.fopen(path.c_str(), "rb")) {
+        error = "cannot open file";
+        return false;
+    }
+    Uint32 length = 0;
+    if (!seekElement(file, xfer, element, length, error)) {
+        return false;
+    }
+
+    if (element != DCM_PixelData) {
+        if (length == undefinedLength) {
+            error = "element with undefined length";
+            return false;
+        }
+        Fragment fragment = { file.ftell(), length };
+        m_frames.push_back(std::vector<Fragment>(1, fragment));
+        return true;
+    }
+
+    if (!m_encapsulated) {
+        Uint16 rows = 0, columns = 0, samplesPerPixel = 1, bitsAllocated = 0;
+        dataset->findAndGetUint16(DCM_Rows, rows);
+        dataset->findAndGetUint16(DCM_Columns, columns);
+        dataset->findAndGetUint16(DCM_SamplesPerPixel, samplesPerPixel);
+        dataset->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+        const Uint64 frameBits = static_cast<Uint64>(rows) * columns * samplesPerPixel * bitsAllocated;
+        if (length == undefinedLength || frameBits == 0 || (frames > 1 && frameBits % 8 != 0)) {
+            error = "invalid native pixel data";
+            return false;
+        }
+        const size_t frameLength = static_cast<size_t>((frameBits + 7) / 8);
+        if (frames * frameLength > length) {
+            error = "pixel data shorter than the frames";
+            return false;
+        }
+        const offile_off_t start = file.ftell();
+        for (size_t frame = 0; frame < frames; ++frame) {
+            Fragment fragment = { start + static_cast<offile_off_t>(frame * frameLength), frameLength };
+            m_frames.push_back(std::vector<Fragment>(1, fragment));
+        }
+        return true;
+    }
+
+    if (length != undefinedLength) {
+        error = "encapsulated pixel data with defined length";
+        return false;
+    }
+    // items of encapsulated pixel data are always little endian
+    HeaderReader reader(file, false);
+    DcmTagKey tag;
+    char vr[3];
+    std::vector<Uint32> basicOffsets;
+    if (!reader.readHeader(false, tag, vr, length) || tag != DCM_Item || length % 4 != 0) {
+        error = "missing basic offset table";
+        return false;
+    }
+    basicOffsets.resize(length / 4);
+    for (Uint32& offset : basicOffsets) {
+        if (!reader.readUint32(offset)) {
+            error = "invalid basic offset table";
+            return false;
+        }
+    }
+
+    // fragment values and the offsets of their items from the first one
+    std::vector<Fragment> fragments;
+    std::vector<Uint64> itemOffsets;
+    const offile_off_t first = reader.tell();
+    for (;;) {
+        const offile_off_t item = reader.tell();
+        if (!reader.readHeader(false, tag, vr, length)) {
+            error = "missing sequence delimiter";
+            return false;
+        }
+        if (tag == DCM_SequenceDelimitationItem) {
+            break;
+        }
+        if (tag != DCM_Item || length == undefinedLength) {
+            error = "invalid pixel item";
+            return false;
+        }
+        Fragment fragment = { reader.tell(), length };
+        fragments.push_back(fragment);
+        itemOffsets.push_back(static_cast<Uint64>(item - first));
+        if (!reader.skip(length)) {
+            error = "invalid pixel item";
+            return false;
+        }
+    }
+    if (fragments.empty()) {
+        error = "no fragments";
+        return false;
+    }
+    if (isVideo(m_xfer)) {
+        // the frames are in the bit stream, which is the only frame here
+        m_frames.push_back(fragments);
+        DCMNET_DEBUG("Indexed the video stream of " << numberOfFrames << " frames in " << fragments.size() << " fragments of " << path);
+        return true;
+    }
+
+    // index of the first fragment of each frame
+    std::vector<size_t> starts;
+    const Uint64* extendedOffsets = NULL;
+    unsigned long count = 0;
+    const char* source = "";
+    std::vector<Uint64> offsets;
+    if (dataset->findAndGetUint64Array(DCM_ExtendedOffsetTable, extendedOffsets, &count).good() && count == frames) {
+        offsets.assign(extendedOffsets, extendedOffsets + count);
+        source = "extended offset table";
+    }
+    else if (basicOffsets.size() == frames) {
+        offsets.assign(basicOffsets.begin(), basicOffsets.end());
+        source = "basic offset table";
+    }
+    if (!offsets.empty()) {
+        for (Uint64 offset : offsets) {
+            std::vector<Uint64>::const_iterator it = std::lower_bound(itemOffsets.begin(), itemOffsets.end(), offset);
+            if (it == itemOffsets.end() || *it != offset || (!starts.empty() && static_cast<size_t>(it - itemOffsets.begin()) <= starts.back())) {
+                starts.clear();
+                break;
+            }
+            starts.push_back(static_cast<size_t>(it - itemOffsets.begin()));
+        }
+        if (starts.empty() || starts[0] != 0) {
+            DCMNET_WARN("Ignoring invalid " << source << " in " << path);
+            starts.clear();
+        }
+    }
+    if (starts.empty() && frames == 1) {
+        starts.push_back(0);
+        source = "single frame";
+    }
+    else if (starts.empty() && fragments.size() == frames) {
+        for (size_t i = 0; i < frames; ++i) {
+            starts.push_back(i);
+        }
+        source = "one fragment per frame";
+    }
+    else if (starts.empty()) {
+        // codestreams start with a marker, continuation fragments usually do not
+        for (size_t i = 0; i < fragments.size(); ++i) {
+            Uint8 marker[4] = { 0, 0, 0, 0 };
+            if (file.fseek(fragments[i].offset, SEEK_SET) != 0 || file.fread(marker, 1, 4) != 4) {
+                error = "cannot read fragment";
+                return false;
+            }
+            if (i == 0 || isFrameStart(marker)) {
+                starts.push_back(i);
+            }
+        }
+        source = "fragment scan";
+        if (starts.size() != frames) {
+            error = "cannot assign the fragments to the frames";
+            return false;
+        }
+    }
+
+    for (size_t frame = 0; frame < frames; ++frame) {
+        const size_t end = frame + 1 < frames ? starts[frame + 1] : fragments.size();
+        m_frames.push_back(std::vector<Fragment>(fragments.begin() + starts[frame], fragments.begin() + end));
+    }
+    DCMNET_DEBUG("Indexed " << frames << " frames in " << fragments.size() << " fragments of " << path << " from " << source);
+    return true;
+}
+
+size_t FrameIndex::frameLength(size_t frame) const
+{
+    size_t length = 0;
+    for (const Fragment& fragment : m_frames[frame]) {
+        length += fragment.length;
+    }
+    return length;
+}
+
+OFCondition FrameIndex::readFrame(size_t frame, unsigned char* buffer) const
+{
+    if (frame >= m_frames.size()) {
+        return EC_IllegalParameter;
+    }
+    OFFile file;
+    if (!file.fopen(m_path.c_str(), "rb")) {
+        if (!StorageArea::isRemote(m_path)) {
+            return EC_InvalidFilename;
+        }
+        std::string error;
+        for (const Fragment& fragment : m_frames[frame]) {
+            if (!StorageArea::readRange(m_path, static_cast<Uint64>(fragment.offset), fragment.length, buffer, error)) {
+                DCMNET_WARN("cannot read frame " << frame << " of " << m_path << ": " << error);
+                return EC_InvalidStream;
+            }
+            buffer += fragment.length;
+        }
+        return EC_Normal;
+    }
+    for (const Fragment& fragment : m_frames[frame]) {
+        if (file.fseek(fragment.offset, SEEK_SET) != 0 || file.fread(buffer, 1, fragment.length) != fragment.length) {
+            return EC_InvalidStream;
+        }
+        buffer += fragment.length;
+    }
+    return EC_Normal;
+}
+
+void FrameIndex::indexStream()
+{
+    Uint64 offset = 0;
+    for (const std::vector<Fragment>& frame : m_frames) {
+        for (const Fragment& fragment : frame) {
+            m_stream.push_back(fragment);
+            m_streamOffsets.push_back(offset);
+            offset += fragment.length;
+        }
+    }
+    m_streamOffsets.push_back(offset);
+}
+
+OFCondition FrameIndex::readRange(Uint64 offset, size_t length, unsigned char* buffer) const
+{
+    if (offset > streamLength() || length > streamLength() - offset) {
+        return EC_IllegalParameter;
+    }
+    OFFile file;
+    const bool local = file.fopen(m_path.c_str(), "rb") != OFFalse;
+    if (!local && !StorageArea::isRemote(m_path)) {
+        return EC_InvalidFilename;
+    }
+    // the fragment holding offset, then the following ones until length bytes were read
+    size_t i = static_cast<size_t>(std::upper_bound(m_streamOffsets.begin(), m_streamOffsets.end(), offset) - m_streamOffsets.begin()) - 1;
+    std::string error;
+    for (; length > 0 && i < m_stream.size(); ++i) {
+        const Uint64 skip = offset - m_streamOffsets[i];
+        const size_t count = static_cast<size_t>(std::min<Uint64>(m_stream[i].length - skip, length));
+        const offile_off_t start = m_stream[i].offset + static_cast<offile_off_t>(skip);
+        if (local ? file.fseek(start, SEEK_SET) != 0 || file.fread(buffer, 1, count) != count
+                  : !StorageArea::readRange(m_path, static_cast<Uint64>(start), count, buffer, error)) {
+            if (!error.empty()) {
+                DCMNET_WARN("cannot read a byte range of " << m_path << ": " << error);
+            }
+            return EC_InvalidStream;
+        }
+        buffer += count;
+        offset += count;
+        length -= count;
+    }
+    return EC_Normal;
+}
+
+OFCondition FrameIndex::loadFrame(size_t frame, DcmFileFormat& dfile) const
+{
+    if (frame >= m_frames.size()) {
+        return EC_IllegalParameter;
+    }
+    OFCondition status = dfile.loadFileUntilTag(OFFilename(m_path.c_str()), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+    if (status.bad()) {
+        return status;
+    }
+    DcmDataset* dataset = dfile.getDataset();
+    dataset->findAndDeleteElement(DCM_ExtendedOffsetTable);
+    dataset->findAndDeleteElement(DCM_ExtendedOffsetTableLengths);
+    if (dataset->tagExists(DCM_NumberOfFrames)) {
+        dataset->putAndInsertString(DCM_NumberOfFrames, "1");
+    }
+
+    OFFile file;
+    if (!file.fopen(m_path.c_str(), "rb")) {
+        return EC_InvalidFilename;
+    }
+    DcmPixelData* pixelData = new DcmPixelData(DCM_PixelData);
+    if (m_encapsulated) {
+        // empty basic offset table followed by the fragments of the frame
+        DcmPixelSequence* sequence = new DcmPixelSequence(DcmTag(DCM_PixelData, EVR_OB));
+        sequence->insert(new DcmPixelItem(DcmTag(DCM_Item, EVR_OB)));
+        for (const Fragment& fragment : m_frames[frame]) {
+            DcmPixelItem* item = new DcmPixelItem(DcmTag(DCM_Item, EVR_OB));
+            sequence->insert(item);
+            Uint8* data = NULL;
+            status = item->createUint8Array(static_cast<Uint32>(fragment.length), data);
+            if (status.good() && (file.fseek(fragment.offset, SEEK_SET) != 0 || file.fread(data, 1, fragment.length) != fragment.length)) {
+                status = EC_InvalidStream;
+            }
+            if (status.bad()) {
+                delete sequence;
+                delete pixelData;
+                return status;
+            }
+        }
+        pixelData->putOriginalRepresentation(m_xfer, NULL, sequence);
+    }
+    else {
+        const Fragment& fragment = m_frames[frame][0];
+        Uint16 bitsAllocated = 0;
+        dataset->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+        Uint8* data = NULL;
+        if (bitsAllocated > 8 && fragment.length % 2 == 0) {
+            Uint16* words = NULL;
+            status = pixelData->createUint16Array(static_cast<Uint32>(fragment.length / 2), words);
+            data = reinterpret_cast<Uint8*>(words);
+        }
+        else {
+            status = pixelData->createUint8Array(static_cast<Uint32>(fragment.length), data);
+        }
+        if (status.good() && (file.fseek(fragment.offset, SEEK_SET) != 0 || file.fread(data, 1, fragment.length) != fragment.length)) {
+            status = EC_InvalidStream;
+        }
+        if (status.good() && bitsAllocated > 8 && fragment.length % 2 == 0) {
+            status = swapIfNecessary(gLocalByteOrder, DcmXfer(m_xfer).getByteOrder(), data, static_cast<Uint32>(fragment.length), sizeof(Uint16));
+        }
+        if (status.bad()) {
+            delete pixelData;
+            return status;
+        }
+    }
+    return dataset->insert(pixelData, OFTrue);
+}
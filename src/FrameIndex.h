@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/ofstd/offile.h"
+
+// Byte ranges of the frames in the pixel data of a file, so frame k can be read with a few seeks
+// instead of loading and walking the whole pixel sequence. For encapsulated pixel data the fragments
+// of each frame are found from the Extended Offset Table, the Basic Offset Table or, without either
+// of them, from a one time scan of the fragment headers. Indices are kept in a process wide cache
+// keyed by path, size and modification time of the file. The value of the pixel data or of another
+// top level element can also be read as one byte stream at arbitrary offsets, e.g. to serve byte
+// ranges of an MPEG-2, MPEG-4 or HEVC video, whose fragments hold the bit stream, not frames.
+class FrameIndex
+{
+public:
+    // pixel data value bytes at a file offset
+    struct Fragment {
+        offile_off_t offset;
+        size_t length;
+    };
+
+    // returns the cached index of a file or builds it, NULL if the pixel data cannot be indexed,
+    // error holds the reason
+    static std::shared_ptr<const FrameIndex> get(const std::string& path, std::string& error);
+
+    // the same for the value of another top level element with a defined length, e.g. the
+    // Encapsulated Document, indexed as a single native frame
+    static std::shared_ptr<const FrameIndex> get(const std::string& path, const DcmTagKey& tag, std::string& error);
+
+    // limits the number of cached indices, 0 disables the cache
+    static void configure(size_t maxEntries);
+
+    // number of get() calls served from the cache and built from the file
+    static size_t hits();
+    static size_t misses();
+
+    size_t frames() const { return m_frames.size(); }
+
+    bool encapsulated() const { return m_encapsulated; }
+
+    E_TransferSyntax transferSyntax() const { return m_xfer; }
+
+    // fragments of a frame, a single one for native pixel data
+    const std::vector<Fragment>& fragments(size_t frame) const { return m_frames[frame]; }
+
+    // bytes of a frame, the fragment values back to back
+    size_t frameLength(size_t frame) const;
+
+    // reads the bytes of a frame into buffer which holds at least frameLength() bytes
+    OFCondition readFrame(size_t frame, unsigned char* buffer) const;
+
+    // bytes of the value, the fragment values of encapsulated pixel data back to back
+    Uint64 streamLength() const { return m_streamOffsets.empty() ? 0 : m_streamOffsets.back(); }
+
+    // reads length bytes of the value from offset, which must end within streamLength(), into buffer
+    OFCondition readRange(Uint64 offset, size_t length, unsigned char* buffer) const;
+
+    // loads all attributes of the file and replaces the pixel data by the one of the frame,
+    // a single frame image data set that can be decoded or rendered as frame 0
+    OFCondition loadFrame(size_t frame, DcmFileFormat& dfile) const;
+
+    // default limit of cached indices
+    static const size_t defaultMaxEntries = 256;
+
+private:
+    FrameIndex() : m_xfer(EXS_Unknown), m_encapsulated(false) {}
+
+    // reads the data set up to the element and locates the frames, false with error set on failure
+    bool build(const std::string& path, const DcmTagKey& element, std::string& error);
+
+    // the fragments of all frames in stream order
+    void indexStream();
+
+    std::string m_path;
+    E_TransferSyntax m_xfer;
+    bool m_encapsulated;
+    std::vector<std::vector<Fragment>> m_frames;
+    std::vector<Fragment> m_stream;
+    // offset of each fragment of m_stream in the stream and the stream length
+    std::vector<Uint64> m_streamOffsets;
+};
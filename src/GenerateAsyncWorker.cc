@@ -0,0 +1,217 @@
+#include "GenerateAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "DatasetGenerator.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+
+namespace
+{
+
+typedef std::map<DB_FindAttrExt, std::string, DB_FindAttrExtCompare> Attributes;
+
+// instances per index transaction, as the ingest queue commits them
+const size_t batchSize = 1000;
+
+// batches handed from the generating threads to the thread inserting them, bounded so
+// generation waits for a slow index instead of piling up memory
+class BatchQueue
+{
+public:
+    BatchQueue() : _producers(0) {}
+
+    void start(size_t producers) { _producers = producers; }
+
+    void push(std::vector<Attributes>& batch)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]() { return _batches.size() < 4; });
+        _batches.push_back(std::vector<Attributes>());
+        _batches.back().swap(batch);
+        _changed.notify_all();
+    }
+
+    void finished()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        --_producers;
+        _changed.notify_all();
+    }
+
+    // false once all producers finished and all batches were taken
+    bool pop(std::vector<Attributes>& batch)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]() { return !_batches.empty() || _producers == 0; });
+        if (_batches.empty()) {
+            return false;
+        }
+        batch.swap(_batches.front());
+        _batches.pop_front();
+        _changed.notify_all();
+        return true;
+    }
+
+private:
+    std::deque<std::vector<Attributes> > _batches;
+    size_t _producers;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+};
+
+}
+
+GenerateAsyncWorker::GenerateAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void GenerateAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.storagePath.empty()) {
+        SetErrorJson("No storage path set");
+        return;
+    }
+    if (!OFStandard::dirExists(in.storagePath.c_str()) && OFStandard::createDirectory(in.storagePath.c_str(), "").bad()) {
+        SetErrorJson("Cannot create storage path " + in.storagePath);
+        return;
+    }
+
+    DatasetGenerator::sOptions options;
+    options.patients = static_cast<size_t>(std::max(in.patients, 1));
+    options.studiesPerPatient = static_cast<size_t>(std::max(in.studiesPerPatient, 0));
+    options.seriesPerStudy = static_cast<size_t>(std::max(in.seriesPerStudy, 0));
+    options.instancesPerSeries = static_cast<size_t>(std::max(in.instancesPerSeries, 0));
+    options.seed = static_cast<uint64_t>(std::max(in.seed, 0));
+    options.modalities = in.modalities;
+    options.pixelData = in.pixelData;
+    const DatasetGenerator generator(options);
+    if (!generator.valid()) {
+        SetErrorJson("No known modality set");
+        return;
+    }
+
+    DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(in.storagePath.c_str());
+    if (db == NULL || !db->isInitialized()) {
+        DcmIndexDatabasePool::release(db);
+        SetErrorJson("Cannot open the index of " + in.storagePath);
+        return;
+    }
+
+    const size_t threads = in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    DCMNET_INFO("generating " << options.patients << " patients into " << in.storagePath << " using " << threads << " threads");
+
+    std::atomic<size_t> nextPatient(0);
+    std::atomic<size_t> patients(0);
+    std::atomic<size_t> generated(0);
+    std::atomic<size_t> writeFailures(0);
+    BatchQueue queue;
+    queue.start(threads);
+    std::vector<std::thread> workers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            std::vector<Attributes> batch;
+            OFString studyUID;
+            OFString sopInstanceUID;
+            OFString directory;
+            OFString filename;
+            // the layout of the storage SCP, <storagePath>/<StudyInstanceUID>/<SOPInstanceUID>.dcm
+            auto sink = [&](DcmFileFormat& file) -> bool {
+                DcmDataset* dataset = file.getDataset();
+                dataset->findAndGetOFString(DCM_StudyInstanceUID, studyUID);
+                dataset->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
+                OFStandard::combineDirAndFilename(directory, in.storagePath.c_str(), studyUID, OFTrue);
+                OFStandard::combineDirAndFilename(filename, directory, sopInstanceUID + ".dcm", OFTrue);
+                if (in.writeFile) {
+                    if (!OFStandard::dirExists(directory)) {
+                        OFStandard::createDirectory(directory, in.storagePath.c_str());
+                    }
+                    if (file.saveFile(filename.c_str(), EXS_LittleEndianExplicit).bad()) {
+                        ++writeFailures;
+                        return !Cancelled();
+                    }
+                }
+                batch.push_back(Attributes());
+                db->extractMetaData(dataset, filename, batch.back());
+                ++generated;
+                if (batch.size() >= batchSize) {
+                    queue.push(batch);
+                }
+                return !Cancelled();
+            };
+            for (size_t p = nextPatient++; p < options.patients && !Cancelled(); p = nextPatient++) {
+                if (generator.generatePatient(p, sink)) {
+                    ++patients;
+                }
+            }
+            if (!batch.empty()) {
+                queue.push(batch);
+            }
+            queue.finished();
+        }));
+    }
+
+    // the index is written by this thread only, progress at most once a second
+    size_t inserted = 0;
+    size_t insertFailures = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    std::vector<Attributes> batch;
+    while (queue.pop(batch)) {
+        for (bool ok : db->insertBatch(batch)) {
+            ok ? ++inserted : ++insertFailures;
+        }
+        batch.clear();
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            json v = json::object();
+            v["patients"] = static_cast<size_t>(patients);
+            v["instances"] = inserted;
+            v["elapsed"] = std::chrono::duration<double>(now - start).count();
+            SendResponse(ns::createResponse(ns::PENDING, "GENERATE_PROGRESS", v), progress);
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    DcmIndexDatabasePool::release(db);
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DCMNET_INFO("generated " << generated << " instances of " << patients << " patients in " << elapsed << " s");
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    json v = json::object();
+    v["patients"] = static_cast<size_t>(patients);
+    v["instances"] = inserted;
+    v["failed"] = insertFailures + writeFailures;
+    v["elapsed"] = elapsed;
+    v["instancesPerSecond"] = elapsed > 0 ? static_cast<double>(inserted) / elapsed : 0;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
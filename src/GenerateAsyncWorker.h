@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// generates synthetic patients on a pool of threads and inserts their instances into the index
+// of storagePath in batches, optionally writing the files as the storage SCP lays them out
+class GenerateAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        GenerateAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -4,9 +4,15 @@
 #include <sstream>
 #include <memory>
 #include <list>
+#include <vector>
+#include <algorithm>
 
 #include "json.h"
 #include "Utils.h"
+#include "CancellableSCU.h"
+#include "BufferPool.h"
+#include "TlsTransport.h"
+#include "TransferPolicy.h"
 
 using json = nlohmann::json;
 
@@ -18,6 +24,9 @@ using json = nlohmann::json;
 #include "dcmtk/dcmdata/dcuid.h"    /* for dcmtk version name */
 #include "dcmtk/dcmdata/dcpath.h"   /* for DcmPathProcessor */
 #include "dcmtk/dcmdata/dcostrmz.h" /* for dcmZlibCompressionLevel */
+#include "dcmtk/dcmdata/dcostrmb.h" /* for DcmOutputBufferStream */
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
 
 
 #ifdef WITH_ZLIB
@@ -108,35 +117,117 @@ namespace
         }
     }
 
+    // the configured transfer syntaxes in order of preference, followed by the uncompressed ones
+    void prepareStorageTS(const std::vector<std::string> &preferred, E_TransferSyntax ts, OFList<OFString> &syntaxes)
+    {
+        for (const std::string &uid : preferred)
+        {
+            if (DcmXfer(uid.c_str()).getXfer() == EXS_Unknown)
+            {
+                DCMNET_WARN("unknown transfer syntax " << uid << ", ignoring it");
+                continue;
+            }
+            syntaxes.push_back(uid.c_str());
+        }
+        OFList<OFString> uncompressed;
+        prepareTS(ts, uncompressed);
+        for (const OFString &uid : uncompressed)
+        {
+            if (std::find(preferred.begin(), preferred.end(), uid.c_str()) == preferred.end())
+            {
+                syntaxes.push_back(uid);
+            }
+        }
+    }
+
+    // C-GET SCU that hands the received instances to JS as buffers instead of writing them to disk
+    class MemoryGetSCU : public CancellableSCU
+    {
+        public:
+
+            MemoryGetSCU(BaseAsyncWorker* worker, const BaseAsyncWorker::ExecutionProgress& progress): _worker(worker), _progress(progress) {
+
+            }
+
+        protected:
+
+            virtual OFCondition handleSTORERequest(const T_ASC_PresentationContextID /* presID */,
+                                                   DcmDataset *incomingObject,
+                                                   OFBool & /* continueCGETSession */,
+                                                   Uint16 &cStoreReturnStatus)
+            {
+                if (incomingObject == NULL)
+                {
+                    return DIMSE_NULLKEY;
+                }
+                // the instance is passed on in the transfer syntax it was received in
+                DcmFileFormat dcmff(incomingObject, OFFalse /* do not copy but take ownership */);
+                const E_TransferSyntax xfer = incomingObject->getOriginalXfer();
+                OFString sopInstanceUID;
+                incomingObject->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
+
+                OFCondition cond = dcmff.validateMetaInfo(xfer, EWM_fileformat);
+                dcmff.removeInvalidGroups();
+                const Uint32 length = dcmff.calcElementLength(xfer, EET_ExplicitLength);
+                unsigned char* buffer = BufferPool::acquire(length);
+                if (cond.good())
+                {
+                    DcmOutputBufferStream buffStream(buffer, length);
+                    dcmff.transferInit();
+                    cond = dcmff.write(buffStream, xfer, EET_ExplicitLength, NULL, EGL_recalcGL, EPD_noChange, 0, 0, EWM_fileformat);
+                    dcmff.transferEnd();
+                }
+                if (cond.bad())
+                {
+                    DCMNET_ERROR("cannot serialize received instance " << sopInstanceUID << ": " << cond.text());
+                    BufferPool::release(buffer);
+                    cStoreReturnStatus = STATUS_STORE_Refused_OutOfResources;
+                    return cond;
+                }
+
+                json v = json::object();
+                v["SOPInstanceUID"] = sopInstanceUID.c_str();
+                v["TransferSyntaxUID"] = DcmXfer(xfer).getXferID();
+                v["length"] = length;
+                _worker->SendBuffer(ns::createResponse(ns::PENDING, "BUFFER_STORAGE", v), buffer, length, _progress);
+                cStoreReturnStatus = STATUS_Success;
+                return EC_Normal;
+            }
+
+        private:
+            BaseAsyncWorker* _worker;
+            BaseAsyncWorker::ExecutionProgress _progress;
+    };
+
     class NanNotifier : public DcmNotifier 
     {
         public:
 
-            NanNotifier(const AsyncProgressQueueWorker<char>::ExecutionProgress& progress): _progress(progress) {
+            NanNotifier(BaseAsyncWorker* worker, const BaseAsyncWorker::ExecutionProgress& progress): _worker(worker), _progress(progress) {
 
             }
             inline void sendMessage(const OFString& msg, const OFString& container) {
                  json v = json::object();
                  v["SOPInstanceUID"] = container.c_str();
-                std::string msg2 = ns::createJsonResponse(ns::PENDING, msg.c_str(), v);
-                _progress.Send(msg2.c_str(), msg2.length());
+                _worker->SendResponse(ns::createResponse(ns::PENDING, msg.c_str(), v), _progress);
             }
         private:
-            AsyncProgressQueueWorker<char>::ExecutionProgress _progress;
+            BaseAsyncWorker* _worker;
+            BaseAsyncWorker::ExecutionProgress _progress;
 
     };
 } // namespace
 
 GetAsyncWorker::GetAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
 {
-    ns::registerCodecs();
 }
 
 void GetAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-    ns::sInput in = ns::parseInputJson(_input);
+    ns::sInput in = GetInput();
 
     EnableVerboseLogging(in.verbose);
+    TransferPolicy::setCpuBudget(in.compressionCpuBudget);
 
     if (in.tags.empty())
     {
@@ -161,7 +252,14 @@ void GetAsyncWorker::Execute(const ExecutionProgress &progress)
         in.destination = in.source.aet;
     }
 
-    if (in.storagePath.empty())
+    const bool inMemory = in.storageMode == "memory";
+    if (!in.storageMode.empty() && !inMemory && in.storageMode != "disk")
+    {
+        SetErrorJson("Invalid storage mode, disk or memory expected");
+        return;
+    }
+
+    if (in.storagePath.empty() && !inMemory)
     {
         in.storagePath = "./data";
         SendInfo("storage path not set, defaulting to " + in.storagePath, progress);
@@ -170,7 +268,7 @@ void GetAsyncWorker::Execute(const ExecutionProgress &progress)
     DcmXfer netTransPrefer = in.netTransferPrefer.empty() ? DcmXfer(EXS_Unknown) : DcmXfer(in.netTransferPrefer.c_str());
     DCMNET_INFO("preferred (accepted) network transfer syntax for incoming associations: " << netTransPrefer.getXferName());
 
-    OFCmdUnsignedInt opt_maxPDU = ASC_DEFAULTMAXPDU;
+    OFCmdUnsignedInt opt_maxPDU = in.network.maxReceivePDU();
     E_TransferSyntax opt_store_networkTransferSyntax = netTransPrefer.getXfer();
     E_TransferSyntax opt_get_networkTransferSyntax = EXS_Unknown;
     DcmStorageMode opt_storageMode = DCMSCU_STORAGE_DISK;
@@ -178,9 +276,9 @@ void GetAsyncWorker::Execute(const ExecutionProgress &progress)
     OFBool opt_abortAssociation = OFFalse;
     OFCmdUnsignedInt opt_repeatCount = 1;
     QueryModel opt_queryModel = QMPatientRoot;
-    T_DIMSE_BlockingMode opt_blockMode = DIMSE_BLOCKING;
-    int opt_dimse_timeout = 0;
-    int opt_acse_timeout = 30;
+    T_DIMSE_BlockingMode opt_blockMode = in.network.dimseBlockMode();
+    int opt_dimse_timeout = in.network.dimseTimeoutSeconds();
+    int opt_acse_timeout = in.network.acseTimeoutSeconds();
     OFString opt_outputDirectory = in.storagePath.c_str();
 
     ns::DicomObject queryAttributes;
@@ -200,10 +298,15 @@ void GetAsyncWorker::Execute(const ExecutionProgress &progress)
     /* setup SCU */
     OFList<OFString> syntaxes;
     prepareTS(opt_get_networkTransferSyntax, syntaxes);
-    NanNotifier notifier(progress);
-    DcmSCU scu;
+    NanNotifier notifier(this, progress);
+    MemoryGetSCU memoryScu(this, progress);
+    CancellableSCU diskScu;
+    CancellableSCU &scu = inMemory ? memoryScu : diskScu;
+    scu.setCancelFlag(CancelFlag());
+    scu.setPriority(ns::dimsePriority(in.priority));
     scu.setNotifier(&notifier);
     scu.setMaxReceivePDULength(opt_maxPDU);
+    scu.setTCPSocketOptions(in.network.socketBufferSize, in.network.tcpNoDelay);
     scu.setACSETimeout(opt_acse_timeout);
     scu.setDIMSEBlockingMode(opt_blockMode);
     scu.setDIMSETimeout(opt_dimse_timeout);
@@ -218,23 +321,72 @@ void GetAsyncWorker::Execute(const ExecutionProgress &progress)
    */
     scu.addPresentationContext(querySyntax[opt_queryModel], syntaxes);
 
-    /* add storage presentation contexts (long list of storage SOP classes, uncompressed) */
+    /* add storage presentation contexts (long list of storage SOP classes), the configured
+     * compressed transfer syntaxes are proposed before the uncompressed ones
+     */
     syntaxes.clear();
-    prepareTS(opt_store_networkTransferSyntax, syntaxes);
+    prepareStorageTS(in.storageTransferSyntaxes, opt_store_networkTransferSyntax, syntaxes);
+    /* non-image objects are proposed deflated first, image codecs do not apply to them */
+    OFList<OFString> deflatedSyntaxes;
+    deflatedSyntaxes.push_back(UID_DeflatedExplicitVRLittleEndianTransferSyntax);
+    for (const OFString &uid : syntaxes)
+    {
+        if (uid != UID_DeflatedExplicitVRLittleEndianTransferSyntax)
+        {
+            deflatedSyntaxes.push_back(uid);
+        }
+    }
+    /* the transfer policy may prefer lossless compressed or uncompressed transfer syntaxes on the
+     * link to the peer, measured on earlier transfers or configured for it
+     */
+    OFList<OFString> losslessSyntaxes;
+    OFList<OFString> uncompressedSyntaxes;
+    if (syntaxes.empty() || !DcmXfer(syntaxes.front().c_str()).isEncapsulated())
+    {
+        losslessSyntaxes.push_back(UID_JPEGLSLosslessTransferSyntax);
+    }
+    for (const OFString &uid : syntaxes)
+    {
+        losslessSyntaxes.push_back(uid);
+        if (DcmXfer(uid.c_str()).isNotEncapsulated() && uid != UID_DeflatedExplicitVRLittleEndianTransferSyntax)
+        {
+            uncompressedSyntaxes.push_back(uid);
+        }
+    }
+    const TransferPolicy::eChoice compression = TransferPolicy::parse(in.target.compression);
     for (Uint16 j = 0; j < numberOfDcmLongSCUStorageSOPClassUIDs; j++)
     {
-        scu.addPresentationContext(dcmLongSCUStorageSOPClassUIDs[j], syntaxes, ASC_SC_ROLE_SCP);
+        const char *sopClass = dcmLongSCUStorageSOPClassUIDs[j];
+        const bool image = dcmIsImageStorageSOPClassUID(sopClass);
+        switch (TransferPolicy::decide(in.target.ip, in.target.aet, sopClass, compression))
+        {
+        case TransferPolicy::COMPRESSED:
+            scu.addPresentationContext(sopClass, image ? losslessSyntaxes : ns::preferDeflate(sopClass) ? deflatedSyntaxes : syntaxes, ASC_SC_ROLE_SCP);
+            break;
+        case TransferPolicy::UNCOMPRESSED:
+            scu.addPresentationContext(sopClass, uncompressedSyntaxes, ASC_SC_ROLE_SCP);
+            break;
+        default:
+            scu.addPresentationContext(sopClass, ns::preferDeflate(sopClass) ? deflatedSyntaxes : syntaxes, ASC_SC_ROLE_SCP);
+            break;
+        }
     }
 
-    /* set the storage mode */
+    /* set the storage mode, in memory mode the instances are received as for disk storage */
     scu.setStorageMode(opt_storageMode);
-    if (opt_storageMode != DCMSCU_STORAGE_IGNORE)
+    if (opt_storageMode != DCMSCU_STORAGE_IGNORE && !inMemory)
     {
         scu.setStorageDir(opt_outputDirectory);
     }
 
     /* initialize network and negotiate association */
-    OFCondition cond = scu.initNetwork();
+    OFCondition cond = TlsTransport::secure(scu, in.network);
+    if (cond.bad())
+    {
+        SetErrorJson(cond.text());
+        return;
+    }
+    cond = scu.initNetwork();
     if (cond.bad())
     {
         SetErrorJson(cond.text());
@@ -0,0 +1,80 @@
+#include "GetFrameAsyncWorker.h"
+
+#include "Utils.h"
+#include "BufferPool.h"
+#include "FrameIndex.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+
+#include "dcmtk/dcmdata/dcxfer.h"
+
+#include "json.h"
+
+using json = nlohmann::json;
+
+GetFrameAsyncWorker::GetFrameAsyncWorker(std::string data, Function &callback)
+    : BaseAsyncWorker(data, callback) {
+}
+
+void GetFrameAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.sourcePath.empty()) {
+        SetErrorJson("No source path set");
+        return;
+    }
+
+    std::string error;
+    std::shared_ptr<const FrameIndex> index = FrameIndex::get(in.sourcePath, error);
+    if (!index) {
+        SetErrorJson("Cannot index pixel data: " + error);
+        return;
+    }
+
+    std::vector<size_t> frames;
+    for (int frame : in.frames) {
+        if (frame < 0 || static_cast<size_t>(frame) >= index->frames()) {
+            SetErrorJson("Invalid frame number");
+            return;
+        }
+        frames.push_back(static_cast<size_t>(frame));
+    }
+    if (frames.empty()) {
+        const size_t frame = static_cast<size_t>(in.frame > 0 ? in.frame : 0);
+        if (frame >= index->frames()) {
+            SetErrorJson("Invalid frame number");
+            return;
+        }
+        frames.push_back(frame);
+    }
+
+    const DcmXfer xfer(index->transferSyntax());
+    for (size_t frame : frames) {
+        const size_t length = index->frameLength(frame);
+        // the buffer is handed to JavaScript, it has to come from the pool
+        unsigned char *buffer = BufferPool::acquire(length);
+        OFCondition status = index->readFrame(frame, buffer);
+        if (status.bad()) {
+            BufferPool::release(buffer);
+            SetErrorJson(std::string("Cannot read frame: ") + status.text());
+            return;
+        }
+        json v = json::object();
+        v["Filepath"] = in.sourcePath;
+        v["frame"] = frame;
+        v["TransferSyntaxUID"] = xfer.getXferID();
+        v["fragments"] = index->fragments(frame).size();
+        v["length"] = length;
+        SendBuffer(ns::createResponse(ns::PENDING, "FRAME", v), buffer, length, progress);
+    }
+
+    json v = json::object();
+    v["frames"] = frames.size();
+    v["NumberOfFrames"] = index->frames();
+    v["TransferSyntaxUID"] = xfer.getXferID();
+    v["encapsulated"] = index->encapsulated();
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
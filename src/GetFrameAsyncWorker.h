@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// reads frames of a file as stored, the fragments of compressed frames back to back.
+// Only the bytes of the requested frames are read, located by a cached FrameIndex
+class GetFrameAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        GetFrameAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,467 @@
+#include "GpuCodec.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/diutil.h"
+
+#ifdef WITH_NVJPEG
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cuda_runtime_api.h>
+#include <nvjpeg.h>
+#ifdef WITH_NVJPEG2K
+#include <nvjpeg2k.h>
+#endif
+
+#include "Metrics.h"
+
+#include "dcmtk/dcmdata/dccodec.h"
+#include "dcmtk/dcmjpeg/djcparam.h"
+#include "dcmtk/dcmjpeg/djdecabs.h"
+#include "dcmtk/dcmjpeg/djdecbas.h"
+#include "dcmtk/dcmjpeg/djdijg8.h"
+#include "dcmtk/dcmjpeg/djutils.h"
+#include "dcmtk/dcmj2k/djcodecd.h"
+
+namespace
+{
+
+// a frame handed to the device thread by a decoding thread, which waits until done is set
+struct Frame
+{
+    Frame() : j2k(false), data(NULL), length(0), columns(0), rows(0), samples(0), bytesPerSample(1), planar(false),
+        buffer(NULL), done(false), decoded(false) {}
+    bool j2k;
+    const unsigned char* data;
+    size_t length;
+    unsigned int columns;
+    unsigned int rows;
+    unsigned int samples;
+    unsigned int bytesPerSample;
+    // JPEG 2000 only, color-by-plane output
+    bool planar;
+    unsigned char* buffer;
+    bool done;
+    bool decoded;
+};
+
+// the handles of the device, used by its thread only
+class Device
+{
+public:
+    // the device of the process, NULL if there is none or nvJPEG cannot be initialized
+    static Device* instance()
+    {
+        static Device* device = create();
+        return device;
+    }
+
+    // decodes the frame on the device thread, false if it could not
+    bool decode(Frame& frame)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _queue.push_back(&frame);
+        _queued.notify_one();
+        _finished.wait(lock, [&frame]() { return frame.done; });
+        return frame.decoded;
+    }
+
+private:
+    Device() : _jpeg(NULL), _state(NULL), _stream(NULL), _deviceBuffer(NULL), _deviceSize(0)
+#ifdef WITH_NVJPEG2K
+        , _j2k(NULL), _j2kState(NULL), _j2kStream(NULL)
+#endif
+    {}
+
+    static Device* create()
+    {
+        int devices = 0;
+        if (cudaGetDeviceCount(&devices) != cudaSuccess || devices == 0) {
+            return NULL;
+        }
+        Device* device = new Device();
+        if (nvjpegCreateSimple(&device->_jpeg) != NVJPEG_STATUS_SUCCESS ||
+            nvjpegJpegStateCreate(device->_jpeg, &device->_state) != NVJPEG_STATUS_SUCCESS ||
+            cudaStreamCreateWithFlags(&device->_stream, cudaStreamNonBlocking) != cudaSuccess) {
+            DCMNET_WARN("nvJPEG cannot be initialized, frames are decoded on the CPU");
+            delete device;
+            return NULL;
+        }
+#ifdef WITH_NVJPEG2K
+        if (nvjpeg2kCreateSimple(&device->_j2k) != NVJPEG2K_STATUS_SUCCESS ||
+            nvjpeg2kDecodeStateCreate(device->_j2k, &device->_j2kState) != NVJPEG2K_STATUS_SUCCESS ||
+            nvjpeg2kStreamCreate(&device->_j2kStream) != NVJPEG2K_STATUS_SUCCESS) {
+            DCMNET_WARN("nvJPEG 2000 cannot be initialized, JPEG 2000 frames are decoded on the CPU");
+            device->_j2k = NULL;
+        }
+#endif
+        // lives as long as the process
+        std::thread(&Device::run, device).detach();
+        return device;
+    }
+
+    void run()
+    {
+        for (;;) {
+            std::vector<Frame*> frames;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _queued.wait(lock, [this]() { return !_queue.empty(); });
+                // the frames queued while the device was busy make the next batch
+                while (!_queue.empty() && frames.size() < GpuCodec::maxBatch) {
+                    frames.push_back(_queue.front());
+                    _queue.pop_front();
+                }
+            }
+            std::vector<Frame*> gray;
+            std::vector<Frame*> color;
+            for (Frame* frame : frames) {
+                if (frame->j2k) {
+                    frame->decoded = decodeJ2K(*frame);
+                } else if (frame->samples == 1) {
+                    gray.push_back(frame);
+                } else {
+                    color.push_back(frame);
+                }
+            }
+            decodeBatch(gray, NVJPEG_OUTPUT_Y);
+            decodeBatch(color, NVJPEG_OUTPUT_RGBI);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (Frame* frame : frames) {
+                    frame->done = true;
+                }
+            }
+            _finished.notify_all();
+        }
+    }
+
+    // device memory for size bytes, grown as needed
+    unsigned char* reserve(size_t size)
+    {
+        if (size > _deviceSize) {
+            cudaFree(_deviceBuffer);
+            _deviceBuffer = NULL;
+            _deviceSize = 0;
+            if (cudaMalloc(OFreinterpret_cast(void**, &_deviceBuffer), size) != cudaSuccess) {
+                _deviceBuffer = NULL;
+                return NULL;
+            }
+            _deviceSize = size;
+        }
+        return _deviceBuffer;
+    }
+
+    void decodeBatch(const std::vector<Frame*>& frames, nvjpegOutputFormat_t format)
+    {
+        if (frames.empty()) {
+            return;
+        }
+        std::vector<const unsigned char*> data;
+        std::vector<size_t> lengths;
+        std::vector<nvjpegImage_t> images(frames.size());
+        size_t total = 0;
+        for (const Frame* frame : frames) {
+            data.push_back(frame->data);
+            lengths.push_back(frame->length);
+            total += size_t(frame->columns) * frame->rows * frame->samples;
+        }
+        unsigned char* output = reserve(total);
+        if (output == NULL ||
+            nvjpegDecodeBatchedInitialize(_jpeg, _state, OFstatic_cast(int, frames.size()), 1, format) != NVJPEG_STATUS_SUCCESS) {
+            return;
+        }
+        for (size_t i = 0; i < frames.size(); ++i) {
+            memset(&images[i], 0, sizeof(nvjpegImage_t));
+            images[i].channel[0] = output;
+            images[i].pitch[0] = frames[i]->columns * frames[i]->samples;
+            output += size_t(frames[i]->columns) * frames[i]->rows * frames[i]->samples;
+        }
+        if (nvjpegDecodeBatched(_jpeg, _state, &data[0], &lengths[0], &images[0], _stream) != NVJPEG_STATUS_SUCCESS) {
+            return;
+        }
+        bool copied = true;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            copied = copied && cudaMemcpyAsync(frames[i]->buffer, images[i].channel[0],
+                size_t(frames[i]->columns) * frames[i]->rows * frames[i]->samples, cudaMemcpyDeviceToHost, _stream) == cudaSuccess;
+        }
+        if (cudaStreamSynchronize(_stream) == cudaSuccess && copied) {
+            for (Frame* frame : frames) {
+                frame->decoded = true;
+            }
+        }
+    }
+
+    bool decodeJ2K(Frame& frame)
+    {
+#ifdef WITH_NVJPEG2K
+        if (_j2k == NULL ||
+            nvjpeg2kStreamParse(_j2k, frame.data, frame.length, 0, 0, _j2kStream) != NVJPEG2K_STATUS_SUCCESS) {
+            return false;
+        }
+        nvjpeg2kImageInfo_t info;
+        if (nvjpeg2kStreamGetImageInfo(_j2kStream, &info) != NVJPEG2K_STATUS_SUCCESS ||
+            info.image_width != frame.columns || info.image_height != frame.rows || info.num_components != frame.samples) {
+            return false;
+        }
+        // the sample size of the frame must match the precision of every component, as OpenJPEG would
+        // write it, signed samples and subsampled components are left to OpenJPEG
+        for (unsigned int c = 0; c < info.num_components; ++c) {
+            nvjpeg2kImageComponentInfo_t component;
+            if (nvjpeg2kStreamGetImageComponentInfo(_j2kStream, &component, c) != NVJPEG2K_STATUS_SUCCESS ||
+                component.component_width != frame.columns || component.component_height != frame.rows ||
+                component.sgn != 0 || component.precision > 16 || (component.precision > 8) != (frame.bytesPerSample == 2) ||
+                (frame.samples > 1 && component.precision > 8)) {
+                return false;
+            }
+        }
+        const size_t plane = size_t(frame.columns) * frame.rows * frame.bytesPerSample;
+        unsigned char* output = reserve(plane * frame.samples);
+        if (output == NULL) {
+            return false;
+        }
+        std::vector<void*> planes(frame.samples);
+        std::vector<size_t> pitches(frame.samples, size_t(frame.columns) * frame.bytesPerSample);
+        for (unsigned int c = 0; c < frame.samples; ++c) {
+            planes[c] = output + c * plane;
+        }
+        nvjpeg2kImage_t image;
+        image.pixel_data = &planes[0];
+        image.pitch_in_bytes = &pitches[0];
+        image.pixel_type = frame.bytesPerSample == 2 ? NVJPEG2K_UINT16 : NVJPEG2K_UINT8;
+        image.num_components = frame.samples;
+        if (nvjpeg2kDecode(_j2k, _j2kState, _j2kStream, &image, _stream) != NVJPEG2K_STATUS_SUCCESS) {
+            return false;
+        }
+        if (frame.samples == 1 || frame.planar) {
+            // the planes are laid out as DICOM expects them already
+            return cudaMemcpyAsync(frame.buffer, output, plane * frame.samples, cudaMemcpyDeviceToHost, _stream) == cudaSuccess &&
+                cudaStreamSynchronize(_stream) == cudaSuccess;
+        }
+        _planes.resize(plane * frame.samples);
+        if (cudaMemcpyAsync(&_planes[0], output, _planes.size(), cudaMemcpyDeviceToHost, _stream) != cudaSuccess ||
+            cudaStreamSynchronize(_stream) != cudaSuccess) {
+            return false;
+        }
+        // color-by-pixel, the components are 8 bit
+        for (size_t i = 0; i < plane; ++i) {
+            for (unsigned int c = 0; c < frame.samples; ++c) {
+                frame.buffer[i * frame.samples + c] = _planes[c * plane + i];
+            }
+        }
+        return true;
+#else
+        (void)frame;
+        return false;
+#endif
+    }
+
+    nvjpegHandle_t _jpeg;
+    nvjpegJpegState_t _state;
+    cudaStream_t _stream;
+    unsigned char* _deviceBuffer;
+    size_t _deviceSize;
+#ifdef WITH_NVJPEG2K
+    nvjpeg2kHandle_t _j2k;
+    nvjpeg2kDecodeState_t _j2kState;
+    nvjpeg2kStream_t _j2kStream;
+    // the components of a color-by-pixel frame before they are interleaved
+    std::vector<unsigned char> _planes;
+#endif
+
+    std::mutex _mutex;
+    std::condition_variable _queued;
+    std::condition_variable _finished;
+    std::deque<Frame*> _queue;
+};
+
+void count(const char* codec, bool decoded)
+{
+    Metrics::counter("gpu_frames_total", {{"codec", codec}, {"result", decoded ? "gpu" : "cpu"}}).add();
+}
+
+// collects the fragments of a frame and decodes it on the GPU once its EOI marker has arrived, or
+// with IJG if the GPU cannot take it. The color model is the one IJG gives with the default
+// EDC_photometricInterpretation: RGB for YCbCr frames, unknown, i.e. unchanged, for grayscale ones
+class GpuJpegDecoder : public DJDecoder
+{
+public:
+    GpuJpegDecoder(const DJCodecParameter& cp, OFBool isYBR) : _cpu(cp, isYBR), _isYBR(isYBR), _gpu(false) {}
+
+    virtual OFCondition init()
+    {
+        _data.clear();
+        _gpu = false;
+        return EC_Normal;
+    }
+
+    virtual OFCondition decode(Uint8* compressedFrameBuffer, Uint32 compressedFrameBufferSize,
+        Uint8* uncompressedFrameBuffer, Uint32 uncompressedFrameBufferSize, OFBool isSigned)
+    {
+        _data.insert(_data.end(), compressedFrameBuffer, compressedFrameBuffer + compressedFrameBufferSize);
+        size_t length = _data.size();
+        while (length > 0 && _data[length - 1] == 0) {
+            --length;
+        }
+        if (length < 2 || _data[length - 2] != 0xFF || _data[length - 1] != 0xD9) {
+            return EJ_Suspension;
+        }
+
+        Device* device = Device::instance();
+        int components = 0;
+        nvjpegChromaSubsampling_t subsampling;
+        int widths[NVJPEG_MAX_COMPONENT];
+        int heights[NVJPEG_MAX_COMPONENT];
+        if (device != NULL && !isSigned && nvjpegGetImageInfo(jpegHandle(), &_data[0], length, &components, &subsampling, widths, heights) == NVJPEG_STATUS_SUCCESS &&
+            ((components == 1 && !_isYBR) || (components == 3 && _isYBR)) &&
+            size_t(widths[0]) * heights[0] * components <= uncompressedFrameBufferSize) {
+            Frame frame;
+            frame.data = &_data[0];
+            frame.length = length;
+            frame.columns = widths[0];
+            frame.rows = heights[0];
+            frame.samples = components;
+            frame.buffer = uncompressedFrameBuffer;
+            _gpu = device->decode(frame);
+        }
+        count("jpeg", _gpu);
+        if (_gpu) {
+            return EC_Normal;
+        }
+        OFCondition result = _cpu.init();
+        if (result.good()) {
+            result = _cpu.decode(&_data[0], OFstatic_cast(Uint32, _data.size()), uncompressedFrameBuffer, uncompressedFrameBufferSize, isSigned);
+        }
+        return result;
+    }
+
+    virtual Uint16 bytesPerSample() const
+    {
+        return OFstatic_cast(Uint16, sizeof(Uint8));
+    }
+
+    virtual EP_Interpretation getDecompressedColorModel() const
+    {
+        if (_gpu) {
+            return _isYBR ? EPI_RGB : EPI_Unknown;
+        }
+        return _cpu.getDecompressedColorModel();
+    }
+
+private:
+    // handle for reading headers, nvjpegGetImageInfo() is thread safe
+    static nvjpegHandle_t jpegHandle()
+    {
+        static nvjpegHandle_t handle = []() {
+            nvjpegHandle_t h = NULL;
+            if (nvjpegCreateSimple(&h) != NVJPEG_STATUS_SUCCESS) {
+                h = NULL;
+            }
+            return h;
+        }();
+        return handle;
+    }
+
+    DJDecompressIJG8Bit _cpu;
+    OFBool _isYBR;
+    std::vector<Uint8> _data;
+    bool _gpu;
+};
+
+class GpuDecoderBaseline : public DJDecoderBaseline
+{
+private:
+    virtual DJDecoder* createDecoderInstance(const DcmRepresentationParameter* /* toRepParam */,
+        const DJCodecParameter* cp, Uint8 /* bitsPerSample */, OFBool isYBR) const
+    {
+        return new GpuJpegDecoder(*cp, isYBR);
+    }
+};
+
+#ifdef WITH_NVJPEG2K
+OFBool decodeJ2KFrame(const Uint8* codeStream, size_t length, Uint16 columns, Uint16 rows, Uint16 samplesPerPixel,
+    Uint16 bytesPerSample, Uint16 planarConfiguration, void* buffer, Uint32 bufSize)
+{
+    bool decoded = false;
+    Device* device = Device::instance();
+    if (device != NULL && (samplesPerPixel == 1 || samplesPerPixel == 3) && (bytesPerSample == 1 || bytesPerSample == 2) &&
+        size_t(columns) * rows * samplesPerPixel * bytesPerSample <= bufSize) {
+        Frame frame;
+        frame.j2k = true;
+        frame.data = codeStream;
+        frame.length = length;
+        frame.columns = columns;
+        frame.rows = rows;
+        frame.samples = samplesPerPixel;
+        frame.bytesPerSample = bytesPerSample;
+        frame.planar = planarConfiguration == 1;
+        frame.buffer = OFstatic_cast(unsigned char*, buffer);
+        decoded = device->decode(frame);
+    }
+    count("jpeg2000", decoded);
+    return decoded;
+}
+#endif
+
+DJCodecParameter* parameters = NULL;
+GpuDecoderBaseline* baseline = NULL;
+
+}
+
+bool GpuCodec::registerCodecs()
+{
+    if (baseline != NULL) {
+        return true;
+    }
+    if (Device::instance() == NULL) {
+        return false;
+    }
+    // the defaults DJDecoderRegistration::registerCodecs() is called with
+    parameters = new DJCodecParameter(ECC_lossyYCbCr, EDC_photometricInterpretation, EUC_default, EPC_default);
+    baseline = new GpuDecoderBaseline();
+    DcmCodecList::registerCodec(baseline, NULL, parameters);
+#ifdef WITH_NVJPEG2K
+    DJPEG2KDecoderBase::setFrameDecoder(decodeJ2KFrame);
+#endif
+#ifdef WITH_NVJPEG2K
+    DCMNET_INFO("baseline JPEG and JPEG 2000 frames are decoded on the GPU");
+#else
+    DCMNET_INFO("baseline JPEG frames are decoded on the GPU");
+#endif
+    return true;
+}
+
+bool GpuCodec::isAvailable()
+{
+    return baseline != NULL;
+}
+
+void GpuCodec::setNumThreads(unsigned short threads)
+{
+    if (parameters != NULL) {
+        parameters->setNumThreads(threads);
+    }
+}
+
+#else
+
+bool GpuCodec::registerCodecs()
+{
+    return false;
+}
+
+bool GpuCodec::isAvailable()
+{
+    return false;
+}
+
+void GpuCodec::setNumThreads(unsigned short /* threads */)
+{
+}
+
+#endif
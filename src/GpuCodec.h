@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+// Decode of baseline JPEG and JPEG 2000 frames on an NVIDIA GPU, when the addon is built with
+// nvJPEG (and nvJPEG 2000 for JPEG 2000). The baseline decoder is registered with DcmCodecList
+// ahead of the IJG one and the JPEG 2000 frames reach the GPU through the frame decoder of dcmj2k.
+// Frames of all requests go to one device thread, which decodes the JPEG frames queued while the
+// device was busy as one batch. Frames the GPU cannot take, e.g. signed, 12 bit or RGB coded ones,
+// and those it fails on are decoded on the CPU as before.
+class GpuCodec
+{
+public:
+    // registers the GPU decoders, called by ns::registerCodecs() before the CPU codecs are
+    // registered. False if the addon is built without nvJPEG or no device is found, nothing is
+    // registered then
+    static bool registerCodecs();
+
+    // true if the GPU decoders are registered
+    static bool isAvailable();
+
+    // threads decoding the restart intervals of a baseline frame on the CPU, see ns::setFrameThreads()
+    static void setNumThreads(unsigned short threads);
+
+    // frames of one nvjpegDecodeBatched() call
+    static const size_t maxBatch = 32;
+};
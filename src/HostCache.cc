@@ -0,0 +1,127 @@
+#include "HostCache.h"
+#include "Metrics.h"
+
+#include "dcmtk/dcmnet/dul.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/ofstd/ofstd.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct sHostEntry {
+    OFSockAddr address;     // cleared for an unknown host
+    Clock::time_point expires;
+};
+
+// a running lookup, waiters are woken once it is done
+struct sLookup {
+    sLookup() : done(false) {}
+    bool done;
+};
+
+std::mutex hostMutex;
+std::condition_variable lookupDone;
+std::map<std::string, sHostEntry> hosts;
+std::map<std::string, std::shared_ptr<sLookup>> lookups;
+int hostTtl = 0;
+
+// stores the address of a host, hostMutex is held
+void insert(const std::string& name, const OFSockAddr& address, Clock::time_point expires)
+{
+    if (hosts.size() >= HostCache::maxEntries && hosts.find(name) == hosts.end()) {
+        const Clock::time_point now = Clock::now();
+        for (std::map<std::string, sHostEntry>::iterator it = hosts.begin(); it != hosts.end();) {
+            it = it->second.expires <= now ? hosts.erase(it) : std::next(it);
+        }
+        if (hosts.size() >= HostCache::maxEntries) {
+            return;
+        }
+    }
+    sHostEntry& entry = hosts[name];
+    entry.address = address;
+    entry.expires = expires;
+}
+
+}
+
+void HostCache::configure(int ttl)
+{
+    {
+        std::lock_guard<std::mutex> lock(hostMutex);
+        hostTtl = ttl > 0 ? ttl : 0;
+        if (hostTtl == 0) {
+            hosts.clear();
+        }
+    }
+    dcmHostResolver.set(ttl > 0 ? &HostCache::resolve : NULL);
+}
+
+void HostCache::resolve(const char* name, OFSockAddr& result)
+{
+    const std::string key(name != NULL ? name : "");
+    std::shared_ptr<sLookup> lookup = std::make_shared<sLookup>();
+    {
+        std::unique_lock<std::mutex> lock(hostMutex);
+        while (true) {
+            std::map<std::string, sHostEntry>::iterator it = hosts.find(key);
+            if (it != hosts.end() && Clock::now() < it->second.expires) {
+                Metrics::counter("host_lookups_total", {{"result", "hit"}}).add();
+                result = it->second.address;
+                return;
+            }
+            std::map<std::string, std::shared_ptr<sLookup>>::iterator running = lookups.find(key);
+            if (running == lookups.end()) {
+                break;
+            }
+            // the address is cached once the running lookup is done
+            std::shared_ptr<sLookup> other = running->second;
+            lookupDone.wait(lock, [&other] { return other->done; });
+        }
+        lookups[key] = lookup;
+    }
+
+    Metrics::counter("host_lookups_total", {{"result", "miss"}}).add();
+    const Clock::time_point started = Clock::now();
+    OFStandard::getAddressByHostname(name, result);
+    const Clock::time_point now = Clock::now();
+    Metrics::histogram("host_lookup_seconds").record(std::chrono::duration<double>(now - started).count());
+
+    std::lock_guard<std::mutex> lock(hostMutex);
+    std::map<std::string, sHostEntry>::iterator it = hosts.find(key);
+    if (result.getFamily() != 0) {
+        insert(key, result, now + std::chrono::seconds(hostTtl));
+    }
+    else if (it != hosts.end() && it->second.address.getFamily() != 0) {
+        // DNS failed, the last address of the host is more likely right than none
+        DCMNET_WARN("cannot resolve " << key << ", using its last address");
+        result = it->second.address;
+        it->second.expires = now + std::chrono::seconds(negativeTtl);
+    }
+    else {
+        insert(key, result, now + std::chrono::seconds(negativeTtl));
+    }
+    lookup->done = true;
+    lookups.erase(key);
+    lookupDone.notify_all();
+}
+
+void HostCache::clear()
+{
+    std::lock_guard<std::mutex> lock(hostMutex);
+    hosts.clear();
+}
+
+size_t HostCache::entries()
+{
+    std::lock_guard<std::mutex> lock(hostMutex);
+    return hosts.size();
+}
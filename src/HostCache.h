@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofsockad.h"
+
+// Addresses of the peers associations are requested with. DUL looks up the host name of every
+// association it requests with a blocking getaddrinfo(), so a slow DNS server delays each C-FIND
+// and C-MOVE by its response time. Installed as dcmHostResolver of dcmnet, the cache answers
+// lookups of a host for ttl seconds. Concurrent lookups of a host wait for the running one, an
+// unknown host is remembered for negativeTtl seconds, and if DNS fails for a host resolved before
+// its last address is used on. The cache is process wide.
+class HostCache
+{
+public:
+    // caches addresses for ttl seconds, 0 removes the cache and DUL looks up every association again
+    static void configure(int ttl);
+
+    // dcmHostResolver: the address of name, result is cleared if the host is unknown
+    static void resolve(const char* name, OFSockAddr& result);
+
+    // drops all addresses
+    static void clear();
+
+    // number of cached hosts
+    static size_t entries();
+
+    // ttl installed with the addon
+    static const int defaultTtl = 60;
+    static const int negativeTtl = 5;
+    // hosts cached, expired ones are dropped beyond it
+    static const size_t maxEntries = 1024;
+};
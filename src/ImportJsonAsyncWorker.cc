@@ -0,0 +1,222 @@
+#include "ImportJsonAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "DicomJsonReader.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+
+namespace
+{
+
+typedef std::map<DB_FindAttrExt, std::string, DB_FindAttrExtCompare> Attributes;
+
+// instances per index transaction, as the ingest queue commits them
+const size_t batchSize = 1000;
+
+// batches handed from the reading threads to the thread inserting them, bounded so reading
+// waits for a slow index instead of piling up memory
+class BatchQueue
+{
+public:
+    BatchQueue() : _producers(0) {}
+
+    void start(size_t producers) { _producers = producers; }
+
+    void push(std::vector<Attributes>& batch)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]() { return _batches.size() < 4; });
+        _batches.push_back(std::vector<Attributes>());
+        _batches.back().swap(batch);
+        _changed.notify_all();
+    }
+
+    void finished()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        --_producers;
+        _changed.notify_all();
+    }
+
+    // false once all producers finished and all batches were taken
+    bool pop(std::vector<Attributes>& batch)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]() { return !_batches.empty() || _producers == 0; });
+        if (_batches.empty()) {
+            return false;
+        }
+        batch.swap(_batches.front());
+        _batches.pop_front();
+        _changed.notify_all();
+        return true;
+    }
+
+private:
+    std::deque<std::vector<Attributes> > _batches;
+    size_t _producers;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+};
+
+}
+
+ImportJsonAsyncWorker::ImportJsonAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void ImportJsonAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.storagePath.empty()) {
+        SetErrorJson("No storage path set");
+        return;
+    }
+    if (in.jsonDatasets.empty()) {
+        SetErrorJson("No DICOM JSON datasets set");
+        return;
+    }
+    if (!OFStandard::dirExists(in.storagePath.c_str()) && OFStandard::createDirectory(in.storagePath.c_str(), "").bad()) {
+        SetErrorJson("Cannot create storage path " + in.storagePath);
+        return;
+    }
+
+    DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(in.storagePath.c_str());
+    if (db == NULL || !db->isInitialized()) {
+        DcmIndexDatabasePool::release(db);
+        SetErrorJson("Cannot open the index of " + in.storagePath);
+        return;
+    }
+
+    const DicomJsonReader::BulkDataFunction resolve = [&in](const std::string& uri, const char*& data, size_t& length) {
+        std::map<std::string, std::string>::const_iterator it = in.bulkData.find(uri);
+        if (it == in.bulkData.end()) {
+            return false;
+        }
+        data = it->second.data();
+        length = it->second.size();
+        return true;
+    };
+
+    const size_t threads = std::min<size_t>(in.parallelism > 0 ? static_cast<size_t>(in.parallelism)
+        : std::max<size_t>(std::thread::hardware_concurrency(), 1), in.jsonDatasets.size());
+    DCMNET_INFO("importing " << in.jsonDatasets.size() << " DICOM JSON texts into " << in.storagePath << " using " << threads << " threads");
+
+    std::atomic<size_t> nextText(0);
+    std::atomic<size_t> invalid(0);
+    std::atomic<size_t> writeFailures(0);
+    BatchQueue queue;
+    queue.start(threads);
+    std::vector<std::thread> workers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            std::vector<Attributes> batch;
+            OFString studyUID;
+            OFString sopInstanceUID;
+            OFString directory;
+            OFString filename;
+            std::string error;
+            // the layout of the storage SCP, <storagePath>/<StudyInstanceUID>/<SOPInstanceUID>.dcm
+            auto sink = [&](DcmDataset* dataset) -> bool {
+                DcmFileFormat file(dataset, OFFalse);
+                if (dataset->findAndGetOFString(DCM_StudyInstanceUID, studyUID).bad() || studyUID.empty()
+                    || dataset->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID).bad() || sopInstanceUID.empty()
+                    || !dataset->tagExistsWithValue(DCM_SOPClassUID)) {
+                    DCMNET_WARN("DICOM JSON dataset without SOP Class, SOP Instance or Study Instance UID, ignoring it");
+                    ++invalid;
+                    return !Cancelled();
+                }
+                OFStandard::combineDirAndFilename(directory, in.storagePath.c_str(), studyUID, OFTrue);
+                OFStandard::combineDirAndFilename(filename, directory, sopInstanceUID + ".dcm", OFTrue);
+                if (!OFStandard::dirExists(directory)) {
+                    OFStandard::createDirectory(directory, in.storagePath.c_str());
+                }
+                if (file.saveFile(filename.c_str(), EXS_LittleEndianExplicit).bad()) {
+                    ++writeFailures;
+                    return !Cancelled();
+                }
+                batch.push_back(Attributes());
+                db->extractMetaData(dataset, filename, batch.back());
+                if (batch.size() >= batchSize) {
+                    queue.push(batch);
+                }
+                return !Cancelled();
+            };
+            for (size_t i = nextText++; i < in.jsonDatasets.size() && !Cancelled(); i = nextText++) {
+                if (!DicomJsonReader::read(in.jsonDatasets[i].data(), in.jsonDatasets[i].size(), resolve, sink, error)) {
+                    DCMNET_WARN("bad DICOM JSON " << i << ", ignoring the rest of it: " << error);
+                    ++invalid;
+                }
+                std::string().swap(in.jsonDatasets[i]);
+            }
+            if (!batch.empty()) {
+                queue.push(batch);
+            }
+            queue.finished();
+        }));
+    }
+
+    // the index is written by this thread only, progress at most once a second
+    size_t inserted = 0;
+    size_t insertFailures = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    std::vector<Attributes> batch;
+    while (queue.pop(batch)) {
+        for (bool ok : db->insertBatch(batch)) {
+            ok ? ++inserted : ++insertFailures;
+        }
+        batch.clear();
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            json v = json::object();
+            v["texts"] = std::min(static_cast<size_t>(nextText), in.jsonDatasets.size());
+            v["instances"] = inserted;
+            v["elapsed"] = std::chrono::duration<double>(now - start).count();
+            SendResponse(ns::createResponse(ns::PENDING, "IMPORT_PROGRESS", v), progress);
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    DcmIndexDatabasePool::release(db);
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DCMNET_INFO("imported " << inserted << " instances from DICOM JSON in " << elapsed << " s");
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    json v = json::object();
+    v["instances"] = inserted;
+    v["invalid"] = static_cast<size_t>(invalid);
+    v["failed"] = insertFailures + writeFailures;
+    v["elapsed"] = elapsed;
+    v["instancesPerSecond"] = elapsed > 0 ? static_cast<double>(inserted) / elapsed : 0;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
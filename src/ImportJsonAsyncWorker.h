@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// builds instances from DICOM JSON texts and their bulk data on a pool of threads, writes them as
+// the storage SCP lays them out below storagePath and inserts them into its index in batches
+class ImportJsonAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        ImportJsonAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,1247 @@
+#include "IndexAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "ArchiveWriter.h"
+#include "BufferPool.h"
+#include "FrameIndex.h"
+#include "Metrics.h"
+#include "SeriesMetadata.h"
+#include "StorageBackend.h"
+#include "StorageTier.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/dcmdata/dcddirif.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcjson.h"
+#include "dcmtk/dcmdata/dcmetinf.h"
+#include "dcmtk/dcmdata/dcostrmb.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+#include "dcmtk/dcmqrdb/dcmqridx.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// a reading connection to the index of the storage area of in, NULL with error set
+DcmIndexDatabase* openIndex(const ns::sInput& in, std::string& error)
+{
+    if (in.storagePath.empty()) {
+        error = "No storage path set";
+        return NULL;
+    }
+    if (!OFStandard::dirExists(in.storagePath.c_str())) {
+        error = "Specified storage path does not exist: " + in.storagePath;
+        return NULL;
+    }
+    if (!DcmIndexDatabasePool::configure(in.indexBackend == "postgresql" ?
+            DcmIndexDatabasePool::POSTGRESQL : DcmIndexDatabasePool::SQLITE, in.indexConnection)) {
+        error = "Index backend not available in this build: " + in.indexBackend;
+        return NULL;
+    }
+    DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquireReader(in.storagePath.c_str());
+    if (db == NULL || !db->isInitialized()) {
+        DcmIndexDatabasePool::release(db);
+        error = "Cannot open the index of " + in.storagePath;
+        return NULL;
+    }
+    return db;
+}
+
+// the find request of the tags, their QueryRetrieveLevel (STUDY if not set) goes to level.
+// False for an unknown level
+bool findRequest(const std::vector<ns::sTag>& tags, std::list<DcmSmallDcmElm>& request, DB_LEVEL& level)
+{
+    level = STUDY_LEVEL;
+    for (const ns::sTag& tag : tags) {
+        const ns::DicomElement el = ns::toElement(tag.key, tag.value);
+        if (el.xtag != DCM_QueryRetrieveLevel) {
+            request.push_back(DcmSmallDcmElm(el.xtag, el.value));
+        }
+        else if (el.value == PATIENT_LEVEL_STRING) {
+            level = PATIENT_LEVEL;
+        }
+        else if (el.value == SERIE_LEVEL_STRING) {
+            level = SERIE_LEVEL;
+        }
+        else if (el.value == IMAGE_LEVEL_STRING) {
+            level = IMAGE_LEVEL;
+        }
+        else if (!el.value.empty() && el.value != STUDY_LEVEL_STRING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// an instance found in the index
+struct sInstance
+{
+    std::string study;
+    std::string series;
+    std::string sop;
+    std::string file;
+};
+
+// the instances matching the tags, each of them has to be matched by a unique key so that a
+// request never walks the whole index. With rows, every indexed attribute of each instance and the
+// levels above it goes there too
+bool indexedInstances(DcmIndexDatabase* db, const std::vector<ns::sTag>& tags, std::vector<sInstance>& instances, std::string& error,
+    std::vector<std::list<DcmSmallDcmElm> >* rows = NULL)
+{
+    std::list<DcmSmallDcmElm> request;
+    DB_LEVEL level = IMAGE_LEVEL;
+    findRequest(tags, request, level);
+    bool unique = false;
+    const DcmTagKey keys[] = { DCM_StudyInstanceUID, DCM_SeriesInstanceUID, DCM_SOPInstanceUID, DCM_PrivateFileName };
+    for (const DcmTagKey& key : keys) {
+        bool requested = false;
+        for (const DcmSmallDcmElm& el : request) {
+            if (el.XTag() == key) {
+                requested = true;
+                unique = unique || !el.valueField().empty();
+            }
+        }
+        if (!requested) {
+            request.push_back(DcmSmallDcmElm(key, ""));
+        }
+    }
+    if (!unique) {
+        error = "StudyInstanceUID, SeriesInstanceUID or SOPInstanceUID required";
+        return false;
+    }
+    if (rows != NULL) {
+        for (const DB_FindAttrExt& attribute : DcmIndexDatabase::indexedAttributes()) {
+            bool requested = DcmIndexDatabase::isAggregateAttribute(attribute.tag);
+            for (const DcmSmallDcmElm& el : request) {
+                requested = requested || el.XTag() == attribute.tag;
+            }
+            if (!requested) {
+                request.push_back(DcmSmallDcmElm(attribute.tag, ""));
+            }
+        }
+    }
+    DcmIndexFindCursor* cursor = db->openFind(request, IMAGE_LEVEL);
+    if (cursor == NULL) {
+        error = "Cannot query the index";
+        return false;
+    }
+    std::list<DcmSmallDcmElm> row;
+    while (cursor->next(row)) {
+        sInstance instance;
+        for (const DcmSmallDcmElm& el : row) {
+            if (el.XTag() == DCM_StudyInstanceUID) {
+                instance.study = el.valueField();
+            }
+            else if (el.XTag() == DCM_SeriesInstanceUID) {
+                instance.series = el.valueField();
+            }
+            else if (el.XTag() == DCM_SOPInstanceUID) {
+                instance.sop = el.valueField();
+            }
+            else if (el.XTag() == DCM_PrivateFileName) {
+                instance.file = el.valueField();
+            }
+        }
+        if (!instance.file.empty()) {
+            instances.push_back(instance);
+            if (rows != NULL) {
+                rows->push_back(row);
+            }
+        }
+    }
+    delete cursor;
+    return true;
+}
+
+// the DICOM JSON of the attributes of an item, NULL if it cannot be converted
+json toDicomJson(DcmItem& item)
+{
+    std::ostringstream stream;
+    DcmJsonFormatCompact format(OFFalse);
+    stream << "{";
+    OFCondition cond = item.writeJson(stream, format);
+    stream << "}";
+    if (cond.bad()) {
+        DCMNET_WARN("cannot convert attributes to DICOM JSON: " << cond.text());
+        return json();
+    }
+    return json::parse(stream.str(), nullptr, false);
+}
+
+// a match of the index as DICOM JSON, the values are UTF-8 already
+json matchToDicomJson(const std::list<DcmSmallDcmElm>& row, const char* level)
+{
+    DcmDataset match;
+    for (const DcmSmallDcmElm& el : row) {
+        if (el.XTag() == DCM_PrivateFileName) {
+            continue;
+        }
+        DcmElement* element = DcmItem::newDicomElement(DcmTag(el.XTag()));
+        if (element == NULL) {
+            continue;
+        }
+        if (!el.valueField().empty()) {
+            element->putString(el.valueField().c_str());
+        }
+        match.insert(element, OFTrue /*replaceOld*/);
+    }
+    match.putAndInsertString(DCM_QueryRetrieveLevel, level);
+    return toDicomJson(match);
+}
+
+// "<seq of shard 0>.<seq of shard 1>..." of a change log position, false if malformed
+bool parseChangeToken(const std::string& token, std::vector<long long>& position)
+{
+    position.clear();
+    std::istringstream stream(token);
+    std::string part;
+    while (std::getline(stream, part, '.')) {
+        char* end = NULL;
+        const long long seq = std::strtoll(part.c_str(), &end, 10);
+        if (part.empty() || *end != '\0' || seq < 0) {
+            return false;
+        }
+        position.push_back(seq);
+    }
+    return !position.empty();
+}
+
+std::string changeToken(const std::vector<long long>& position)
+{
+    std::string token;
+    for (size_t s = 0; s < position.size(); ++s) {
+        token += (s > 0 ? "." : "") + std::to_string(position[s]);
+    }
+    return token;
+}
+
+// brings the file or pack of an indexed instance to local disk, from the cold tier or the storage backend
+bool fetchLocal(const std::string& file, std::string& error)
+{
+    const std::string container = DcmQueryRetrievePackFile::container(file.c_str()).c_str();
+    return StorageTier::recall(container, error) && StorageArea::fetch(container, error);
+}
+
+// the header of an indexed instance up to the pixel data, from its file or its pack, which
+// are fetched to local disk first
+OFCondition loadHeader(const std::string& file, DcmFileFormat& fileformat, std::string& error)
+{
+    if (!fetchLocal(file, error)) {
+        return EC_InvalidFilename;
+    }
+    if (DcmQueryRetrievePackFile::isMember(file.c_str())) {
+        return DcmQueryRetrievePackFile::load(file.c_str(), fileformat, DCM_PixelData);
+    }
+    return fileformat.loadFileUntilTag(file.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength,
+        ERM_autoDetect, DCM_PixelData);
+}
+
+// the bytes of an indexed instance as stored: its whole file, or its record in a pack
+bool storedRange(const std::string& file, std::string& path, offile_off_t& offset, Uint64& length)
+{
+    if (DcmQueryRetrievePackFile::isMember(file.c_str())) {
+        OFString packFile;
+        offile_off_t size = 0;
+        if (!DcmQueryRetrievePackFile::parseMember(file.c_str(), packFile, offset, size)) {
+            return false;
+        }
+        path = packFile.c_str();
+        length = static_cast<Uint64>(size);
+        return true;
+    }
+    if (!OFStandard::fileExists(file.c_str())) {
+        return false;
+    }
+    path = file;
+    offset = 0;
+    length = OFStandard::getFileSize(file.c_str());
+    return true;
+}
+
+// the instance in xfer, serialized to a buffer from BufferPool::acquire(). Instances that cannot be
+// encoded in xfer keep their transfer syntax, which goes to xfer
+OFCondition transcodeInstance(const std::string& file, E_TransferSyntax& xfer, const ns::sRepresentationParameters& repParams,
+    unsigned char*& buffer, size_t& length)
+{
+    DcmFileFormat fileformat;
+    OFCondition cond = DcmQueryRetrievePackFile::isMember(file.c_str()) ? DcmQueryRetrievePackFile::load(file.c_str(), fileformat)
+        : fileformat.loadFile(file.c_str());
+    if (cond.bad()) {
+        return cond;
+    }
+    DcmDataset* dataset = fileformat.getDataset();
+    const E_TransferSyntax original = dataset->getOriginalXfer();
+    cond = dataset->chooseRepresentation(xfer, repParams.get(xfer));
+    if (cond.bad() || !dataset->canWriteXfer(xfer)) {
+        DCMNET_WARN("cannot encode " << file << " in " << DcmXfer(xfer).getXferName() << ", exporting it as stored");
+        xfer = original;
+        cond = dataset->chooseRepresentation(xfer, NULL);
+        if (cond.bad()) {
+            return cond;
+        }
+    }
+    fileformat.validateMetaInfo(xfer, EWM_fileformat);
+    fileformat.removeInvalidGroups();
+    length = fileformat.calcElementLength(xfer, EET_ExplicitLength);
+    buffer = BufferPool::acquire(length);
+    DcmOutputBufferStream stream(buffer, length);
+    fileformat.transferInit();
+    cond = fileformat.write(stream, xfer, EET_ExplicitLength, NULL, EGL_recalcGL, EPD_noChange, 0, 0, EWM_fileformat);
+    fileformat.transferEnd();
+    if (cond.bad()) {
+        BufferPool::release(buffer);
+        buffer = NULL;
+    }
+    return cond;
+}
+
+// the transfer syntax an indexed instance is stored in, from its file meta information
+E_TransferSyntax storedTransferSyntax(const std::string& file)
+{
+    DcmFileFormat fileformat;
+    // parsing stops at the first attribute of the dataset
+    const DcmTagKey firstTag(0x0008, 0x0000);
+    OFCondition cond = DcmQueryRetrievePackFile::isMember(file.c_str()) ? DcmQueryRetrievePackFile::load(file.c_str(), fileformat, firstTag)
+        : fileformat.loadFileUntilTag(file.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, firstTag);
+    OFString uid;
+    if (cond.bad() || fileformat.getMetaInfo()->findAndGetOFString(DCM_TransferSyntaxUID, uid).bad()) {
+        return EXS_Unknown;
+    }
+    return DcmXfer(uid.c_str()).getXfer();
+}
+
+// copies length bytes at offset of source to the new file target, within the kernel where the file
+// system lets it, e.g. as a reflink, else through block
+bool copyRange(const std::string& source, offile_off_t offset, Uint64 length, const std::string& target, std::vector<unsigned char>& block)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+    int in = open(source.c_str(), O_RDONLY);
+    int out = in < 0 ? -1 : open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (in >= 0 && out >= 0) {
+        loff_t position = offset;
+        Uint64 remaining = length;
+        bool failed = false;
+        while (remaining > 0) {
+            const ssize_t n = copy_file_range(in, &position, out, NULL, static_cast<size_t>(std::min<Uint64>(remaining, 1ULL << 30)), 0);
+            if (n <= 0) {
+                failed = true;
+                break;
+            }
+            remaining -= static_cast<Uint64>(n);
+        }
+        close(in);
+        const bool closed = close(out) == 0;
+        // file systems without support fail the first call, those are copied through user space
+        if (!failed || remaining != length) {
+            return !failed && closed;
+        }
+    }
+    else if (in >= 0) {
+        close(in);
+    }
+#endif
+    OFFile from;
+    OFFile to;
+    if (!from.fopen(source.c_str(), "rb") || from.fseek(offset, SEEK_SET) != 0 || !to.fopen(target.c_str(), "wb")) {
+        return false;
+    }
+    Uint64 remaining = length;
+    while (remaining > 0) {
+        const size_t n = from.fread(&block[0], 1, static_cast<size_t>(std::min<Uint64>(remaining, block.size())));
+        if (n == 0 || to.fwrite(&block[0], 1, n) != n) {
+            return false;
+        }
+        remaining -= n;
+    }
+    return to.fclose() == 0;
+}
+
+// the application profile of a DICOMDIR by its name in the options, false for unknown names
+bool mediaProfile(const std::string& name, DicomDirInterface::E_ApplicationProfile& profile)
+{
+    static const struct {
+        const char* name;
+        DicomDirInterface::E_ApplicationProfile profile;
+    } profiles[] = {
+        { "general", DicomDirInterface::AP_GeneralPurpose },
+        { "dvd-jpeg", DicomDirInterface::AP_GeneralPurposeDVDJPEG },
+        { "dvd-j2k", DicomDirInterface::AP_GeneralPurposeDVDJPEG2000 },
+        { "usb-jpeg", DicomDirInterface::AP_USBandFlashJPEG },
+        { "usb-j2k", DicomDirInterface::AP_USBandFlashJPEG2000 },
+        { "bd-jpeg", DicomDirInterface::AP_GeneralPurposeBDJPEG },
+        { "bd-j2k", DicomDirInterface::AP_GeneralPurposeBDJPEG2000 },
+        { "mime", DicomDirInterface::AP_GeneralPurposeMIME }
+    };
+    if (name.empty()) {
+        profile = DicomDirInterface::AP_GeneralPurpose;
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); ++i) {
+        if (name == profiles[i].name) {
+            profile = profiles[i].profile;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the file meta information and the attributes the DICOMDIR records of an instance take from it, as
+// the index holds them. The values of the index are UTF-8
+void recordAttributes(const std::list<DcmSmallDcmElm>& row, E_TransferSyntax xfer, DcmFileFormat& fileformat)
+{
+    DcmDataset* dataset = fileformat.getDataset();
+    dataset->putAndInsertString(DCM_SpecificCharacterSet, "ISO_IR 192");
+    for (const DcmSmallDcmElm& el : row) {
+        if (el.XTag() == DCM_PrivateFileName || el.valueField().empty() || DcmIndexDatabase::isAggregateAttribute(el.XTag())) {
+            continue;
+        }
+        DcmElement* element = DcmItem::newDicomElement(DcmTag(el.XTag()));
+        if (element == NULL) {
+            continue;
+        }
+        element->putString(el.valueField().c_str());
+        dataset->insert(element, OFTrue /*replaceOld*/);
+    }
+    OFString sopClass;
+    OFString sopInstance;
+    dataset->findAndGetOFString(DCM_SOPClassUID, sopClass);
+    dataset->findAndGetOFString(DCM_SOPInstanceUID, sopInstance);
+    DcmMetaInfo* metainfo = fileformat.getMetaInfo();
+    metainfo->putAndInsertString(DCM_MediaStorageSOPClassUID, sopClass.c_str());
+    metainfo->putAndInsertString(DCM_MediaStorageSOPInstanceUID, sopInstance.c_str());
+    metainfo->putAndInsertString(DCM_TransferSyntaxUID, DcmXfer(xfer).getXferID());
+}
+
+}
+
+QueryIndexAsyncWorker::QueryIndexAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void QueryIndexAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    std::list<DcmSmallDcmElm> request;
+    DB_LEVEL level = STUDY_LEVEL;
+    if (!findRequest(in.tags, request, level)) {
+        SetErrorJson("Invalid QueryRetrieveLevel");
+        return;
+    }
+    if (request.empty()) {
+        SetErrorJson("No tags set");
+        return;
+    }
+
+    std::string error;
+    DcmIndexDatabase* db = openIndex(in, error);
+    if (db == NULL) {
+        SetErrorJson(error);
+        return;
+    }
+
+    const char* levels[] = { PATIENT_LEVEL_STRING, STUDY_LEVEL_STRING, SERIE_LEVEL_STRING, IMAGE_LEVEL_STRING };
+    const size_t maxResults = in.maxResults > 0 ? static_cast<size_t>(in.maxResults) : 0;
+    const size_t pageSize = in.pageSize > 0 ? static_cast<size_t>(in.pageSize) : 0;
+    json v = json::array();
+    DcmIndexFindCursor* cursor = pageSize > 0 ? db->openFindPage(request, level, pageSize, in.pageToken) : db->openFind(request, level);
+    if (cursor == NULL) {
+        DcmIndexDatabasePool::release(db);
+        SetErrorJson(pageSize > 0 ? "Cannot page the index of " + in.storagePath + " with this token" : "Cannot query the index of " + in.storagePath);
+        return;
+    }
+    std::list<DcmSmallDcmElm> row;
+    size_t rows = 0;
+    while ((maxResults == 0 || v.size() < maxResults) && !Cancelled() && cursor->next(row)) {
+        ++rows;
+        json match = matchToDicomJson(row, levels[level]);
+        if (!match.is_null()) {
+            v.push_back(match);
+        }
+    }
+    // a full page may be followed by more
+    const std::string next = rows == pageSize ? cursor->position() : std::string();
+    delete cursor;
+    DcmIndexDatabasePool::release(db);
+
+    if (pageSize > 0) {
+        json page = json::object();
+        page["results"] = v;
+        if (!next.empty()) {
+            page["pageToken"] = next;
+        }
+        v = page;
+    }
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
+
+RetrieveMetadataAsyncWorker::RetrieveMetadataAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void RetrieveMetadataAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    std::string error;
+    DcmIndexDatabase* db = openIndex(in, error);
+    if (db == NULL) {
+        SetErrorJson(error);
+        return;
+    }
+    std::vector<sInstance> instances;
+    const bool found = indexedInstances(db, in.tags, instances, error);
+    DcmIndexDatabasePool::release(db);
+    if (!found) {
+        SetErrorJson(error);
+        return;
+    }
+
+    // the index decides which instances are returned, the metadata of their series is read once
+    // and the instances missing there are read from their files. The DICOM JSON is joined as text
+    std::string text = "[";
+    size_t cached = 0;
+    size_t read = 0;
+    std::map<std::string, std::string> series;
+    std::string currentSeries;
+    for (const sInstance& instance : instances) {
+        if (Cancelled()) {
+            break;
+        }
+        if (instance.series != currentSeries) {
+            currentSeries = instance.series;
+            series.clear();
+            SeriesMetadata::read(in.storagePath, instance.study, instance.series, series);
+        }
+        std::string metadata;
+        std::map<std::string, std::string>::const_iterator it = series.find(instance.sop);
+        if (it != series.end()) {
+            metadata = it->second;
+            ++cached;
+        }
+        else {
+            DcmFileFormat fileformat;
+            OFCondition cond = loadHeader(instance.file, fileformat, error);
+            if (cond.bad()) {
+                DCMNET_WARN("cannot read " << instance.file << ": " << (error.empty() ? cond.text() : error));
+                error.clear();
+                continue;
+            }
+            DcmDataset* dataset = fileformat.getDataset();
+#ifdef DCMTK_ENABLE_CHARSET_CONVERSION
+            dataset->convertToUTF8();
+#endif
+            if (!SeriesMetadata::toJson(dataset, metadata)) {
+                DCMNET_WARN("cannot convert the attributes of " << instance.file << " to DICOM JSON");
+                continue;
+            }
+            ++read;
+        }
+        if (text.size() > 1) {
+            text += ",";
+        }
+        text += metadata;
+    }
+    text += "]";
+    Metrics::counter("metadata_instances_total", {{"source", "cache"}}).add(cached);
+    Metrics::counter("metadata_instances_total", {{"source", "file"}}).add(read);
+
+    if (NativeResult()) {
+        _jsonOutput = json::parse(text, nullptr, false);
+    }
+    else {
+        _jsonOutput = json(text);
+    }
+}
+
+RetrievePixelStatsAsyncWorker::RetrievePixelStatsAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void RetrievePixelStatsAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    std::string error;
+    DcmIndexDatabase* db = openIndex(in, error);
+    if (db == NULL) {
+        SetErrorJson(error);
+        return;
+    }
+    std::vector<sInstance> instances;
+    const bool found = indexedInstances(db, in.tags, instances, error);
+    std::vector<std::string> uids;
+    for (const sInstance& instance : instances) {
+        uids.push_back(instance.sop);
+    }
+    const std::map<std::string, DcmPixelStats> stats = found ? db->pixelStats(uids) : std::map<std::string, DcmPixelStats>();
+    DcmIndexDatabasePool::release(db);
+    if (!found) {
+        SetErrorJson(error);
+        return;
+    }
+
+    // in the order of the index, instances stored without statistics are left out
+    json v = json::array();
+    for (const sInstance& instance : instances) {
+        std::map<std::string, DcmPixelStats>::const_iterator it = stats.find(instance.sop);
+        if (it == stats.end()) {
+            continue;
+        }
+        json item = json::object();
+        item["StudyInstanceUID"] = instance.study;
+        item["SeriesInstanceUID"] = instance.series;
+        item["SOPInstanceUID"] = instance.sop;
+        item["minimum"] = it->second.minimum;
+        item["maximum"] = it->second.maximum;
+        item["low"] = it->second.low;
+        item["high"] = it->second.high;
+        item["windowCenter"] = it->second.windowCenter;
+        item["windowWidth"] = it->second.windowWidth;
+        item["histogram"] = it->second.histogram;
+        v.push_back(item);
+    }
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
+
+RetrieveFramesAsyncWorker::RetrieveFramesAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void RetrieveFramesAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    std::string error;
+    DcmIndexDatabase* db = openIndex(in, error);
+    if (db == NULL) {
+        SetErrorJson(error);
+        return;
+    }
+    std::vector<sInstance> instances;
+    const bool found = indexedInstances(db, in.tags, instances, error);
+    DcmIndexDatabasePool::release(db);
+    if (!found) {
+        SetErrorJson(error);
+        return;
+    }
+    if (instances.size() != 1) {
+        SetErrorJson(instances.empty() ? "No matching instance" : "More than one matching instance");
+        return;
+    }
+
+    // the frame index fetches and recalls the file itself
+    std::shared_ptr<const FrameIndex> index = FrameIndex::get(instances.front().file, error);
+    if (!index) {
+        SetErrorJson("Cannot index pixel data: " + error);
+        return;
+    }
+
+    std::vector<size_t> frames;
+    for (int frame : in.frames) {
+        if (frame < 0 || static_cast<size_t>(frame) >= index->frames()) {
+            SetErrorJson("Invalid frame number");
+            return;
+        }
+        frames.push_back(static_cast<size_t>(frame));
+    }
+    if (frames.empty()) {
+        const size_t frame = static_cast<size_t>(in.frame > 0 ? in.frame : 0);
+        if (frame >= index->frames()) {
+            SetErrorJson("Invalid frame number");
+            return;
+        }
+        frames.push_back(frame);
+    }
+
+    const DcmXfer xfer(index->transferSyntax());
+    for (size_t frame : frames) {
+        if (Cancelled()) {
+            break;
+        }
+        const size_t length = index->frameLength(frame);
+        // the buffer is handed to JavaScript, it has to come from the pool
+        unsigned char *buffer = BufferPool::acquire(length);
+        OFCondition status = index->readFrame(frame, buffer);
+        if (status.bad()) {
+            BufferPool::release(buffer);
+            SetErrorJson(std::string("Cannot read frame: ") + status.text());
+            return;
+        }
+        json v = json::object();
+        v["frame"] = frame;
+        v["TransferSyntaxUID"] = xfer.getXferID();
+        v["fragments"] = index->fragments(frame).size();
+        v["length"] = length;
+        SendBuffer(ns::createResponse(ns::PENDING, "FRAME", v), buffer, length, progress);
+    }
+
+    json v = json::object();
+    v["frames"] = frames.size();
+    v["NumberOfFrames"] = index->frames();
+    v["TransferSyntaxUID"] = xfer.getXferID();
+    v["encapsulated"] = index->encapsulated();
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
+
+ExportStudyAsyncWorker::ExportStudyAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void ExportStudyAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    ArchiveWriter::eFormat format = ArchiveWriter::ZIP;
+    if (!ArchiveWriter::parseFormat(in.format, format)) {
+        SetErrorJson("Unknown archive format: " + in.format);
+        return;
+    }
+    const E_TransferSyntax writeXfer = in.writeTransfer.empty() ? EXS_Unknown : DcmXfer(in.writeTransfer.c_str()).getXfer();
+    if (!in.writeTransfer.empty() && writeXfer == EXS_Unknown) {
+        SetErrorJson("Unknown transfer syntax: " + in.writeTransfer);
+        return;
+    }
+
+    std::string error;
+    DcmIndexDatabase* db = openIndex(in, error);
+    if (db == NULL) {
+        SetErrorJson(error);
+        return;
+    }
+    std::vector<sInstance> instances;
+    const bool found = indexedInstances(db, in.tags, instances, error);
+    DcmIndexDatabasePool::release(db);
+    if (!found) {
+        SetErrorJson(error);
+        return;
+    }
+    if (instances.empty()) {
+        SetErrorJson("No matching instance");
+        return;
+    }
+
+    // the instances of a series follow each other, in the order of the index, and those on the cold
+    // tier are recalled ahead of the archive reaching them
+    std::stable_sort(instances.begin(), instances.end(), [](const sInstance& a, const sInstance& b) {
+        return a.study != b.study ? a.study < b.study : a.series < b.series;
+    });
+    std::vector<std::string> containers;
+    for (const sInstance& instance : instances) {
+        containers.push_back(DcmQueryRetrievePackFile::container(instance.file.c_str()).c_str());
+    }
+    StorageTier::prefetch(containers);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const time_t now = time(NULL);
+    size_t chunkSize = ArchiveWriter::defaultChunkSize;
+    if (in.chunkSize > 0) {
+        chunkSize = static_cast<size_t>(in.chunkSize) < BufferPool::minBufferSize ? BufferPool::minBufferSize : static_cast<size_t>(in.chunkSize);
+    }
+    ArchiveWriter archive(format, chunkSize, [this, &progress](unsigned char* chunk, size_t length) {
+        if (Cancelled()) {
+            BufferPool::release(chunk);
+            return false;
+        }
+        json v = json::object();
+        v["length"] = length;
+        SendBuffer(ns::createResponse(ns::PENDING, "EXPORT_DATA", v), chunk, length, progress);
+        return true;
+    });
+    const ns::sRepresentationParameters repParams(in.lossyQuality, in.restartRows);
+
+    size_t skipped = 0;
+    size_t transcoded = 0;
+    std::vector<unsigned char> block(readBlockSize);
+    for (const sInstance& instance : instances) {
+        if (Cancelled()) {
+            break;
+        }
+        const std::string name = instance.study + "/" + instance.series + "/" + instance.sop + ".dcm";
+        if (!fetchLocal(instance.file, error)) {
+            DCMNET_WARN("cannot export " << instance.file << ": " << error);
+            error.clear();
+            ++skipped;
+            continue;
+        }
+
+        // only instances in another transfer syntax are decoded, the others are copied as stored
+        E_TransferSyntax xfer = writeXfer;
+        if (writeXfer != EXS_Unknown) {
+            DcmFileFormat header;
+            if (loadHeader(instance.file, header, error).good() && header.getDataset()->getOriginalXfer() == writeXfer) {
+                xfer = EXS_Unknown;
+            }
+            error.clear();
+        }
+        if (xfer != EXS_Unknown) {
+            unsigned char* buffer = NULL;
+            size_t length = 0;
+            OFCondition cond = transcodeInstance(instance.file, xfer, repParams, buffer, length);
+            if (cond.bad()) {
+                DCMNET_WARN("cannot export " << instance.file << ": " << cond.text());
+                ++skipped;
+                continue;
+            }
+            const bool written = archive.beginEntry(name, length, now, error) && archive.write(buffer, length) && archive.endEntry(error);
+            BufferPool::release(buffer);
+            if (!written) {
+                break;
+            }
+            if (xfer == writeXfer) {
+                ++transcoded;
+            }
+            continue;
+        }
+
+        std::string path;
+        offile_off_t offset = 0;
+        Uint64 length = 0;
+        OFFile file;
+        if (!storedRange(instance.file, path, offset, length) || !file.fopen(path.c_str(), "rb") || file.fseek(offset, SEEK_SET) != 0) {
+            DCMNET_WARN("cannot export " << instance.file << ": cannot open " << (path.empty() ? instance.file : path));
+            ++skipped;
+            continue;
+        }
+        if (!archive.beginEntry(name, length, now, error)) {
+            break;
+        }
+        Uint64 remaining = length;
+        while (remaining > 0) {
+            const size_t n = file.fread(&block[0], 1, static_cast<size_t>(std::min<Uint64>(remaining, block.size())));
+            if (n == 0) {
+                break;
+            }
+            if (!archive.write(&block[0], n)) {
+                break;
+            }
+            remaining -= n;
+        }
+        file.fclose();
+        // an entry cut short leaves the archive broken, the request fails
+        if (!archive.endEntry(error)) {
+            break;
+        }
+    }
+    if (error.empty() && !Cancelled()) {
+        archive.finish(error);
+    }
+    if (Cancelled()) {
+        SetErrorJson("Export cancelled");
+        return;
+    }
+    if (!error.empty()) {
+        SetErrorJson("Cannot export: " + error);
+        return;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Metrics::counter("index_export_instances_total", {{"format", format == ArchiveWriter::ZIP ? "zip" : "tar"}}).add(archive.entries());
+    Metrics::counter("index_export_bytes_total", {{"format", format == ArchiveWriter::ZIP ? "zip" : "tar"}}).add(archive.bytesWritten());
+    json v = json::object();
+    v["format"] = format == ArchiveWriter::ZIP ? "zip" : "tar";
+    v["instances"] = archive.entries();
+    v["skipped"] = skipped;
+    v["transcoded"] = transcoded;
+    v["bytes"] = archive.bytesWritten();
+    v["elapsed"] = elapsed;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
+
+CreateDicomdirAsyncWorker::CreateDicomdirAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void CreateDicomdirAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    DicomDirInterface::E_ApplicationProfile profile = DicomDirInterface::AP_GeneralPurpose;
+    if (!mediaProfile(in.profile, profile)) {
+        SetErrorJson("Unknown application profile: " + in.profile);
+        return;
+    }
+    // the general purpose profile takes uncompressed instances only, the others the stored ones as well
+    E_TransferSyntax writeXfer = profile == DicomDirInterface::AP_GeneralPurpose ? EXS_LittleEndianExplicit : EXS_Unknown;
+    if (!in.writeTransfer.empty()) {
+        writeXfer = DcmXfer(in.writeTransfer.c_str()).getXfer();
+        if (writeXfer == EXS_Unknown) {
+            SetErrorJson("Unknown transfer syntax: " + in.writeTransfer);
+            return;
+        }
+    }
+    if (in.destination.empty()) {
+        SetErrorJson("No destination set");
+        return;
+    }
+    if (!OFStandard::dirExists(in.destination.c_str()) && OFStandard::createDirectory(in.destination.c_str(), OFFilename()).bad()) {
+        SetErrorJson("Cannot create destination " + in.destination);
+        return;
+    }
+    OFFilename dicomdirFile;
+    OFStandard::combineDirAndFilename(dicomdirFile, in.destination.c_str(), "DICOMDIR");
+    if (OFStandard::fileExists(dicomdirFile)) {
+        SetErrorJson("Destination holds a DICOMDIR already: " + in.destination);
+        return;
+    }
+
+    std::string error;
+    DcmIndexDatabase* db = openIndex(in, error);
+    if (db == NULL) {
+        SetErrorJson(error);
+        return;
+    }
+    std::vector<sInstance> instances;
+    std::vector<std::list<DcmSmallDcmElm> > rows;
+    const bool found = indexedInstances(db, in.tags, instances, error, &rows);
+    DcmIndexDatabasePool::release(db);
+    if (!found) {
+        SetErrorJson(error);
+        return;
+    }
+    if (instances.empty()) {
+        SetErrorJson("No matching instance");
+        return;
+    }
+
+    // the media layout DICOM/PAT00001/STU00001/SER00001/IMG00001, by patient, study and series in
+    // the order of the index. Names are numbered per directory, the index attributes of each file
+    // travel with it
+    std::vector<std::string> patients(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        for (const DcmSmallDcmElm& el : rows[i]) {
+            if (el.XTag() == DCM_PatientID) {
+                patients[i] = el.valueField();
+            }
+        }
+    }
+    std::vector<size_t> order(instances.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (patients[a] != patients[b]) {
+            return patients[a] < patients[b];
+        }
+        return instances[a].study != instances[b].study ? instances[a].study < instances[b].study : instances[a].series < instances[b].series;
+    });
+
+    struct sMediaFile {
+        size_t instance;
+        std::string name;
+        bool copied;
+        bool transcoded;
+        E_TransferSyntax xfer;
+    };
+    std::vector<sMediaFile> files;
+    std::vector<std::string> containers;
+    size_t patient = 0, study = 0, series = 0, image = 0;
+    std::string directory;
+    for (size_t k = 0; k < order.size(); ++k) {
+        const size_t i = order[k];
+        const bool newPatient = k == 0 || patients[i] != patients[order[k - 1]];
+        const bool newStudy = newPatient || instances[i].study != instances[order[k - 1]].study;
+        const bool newSeries = newStudy || instances[i].series != instances[order[k - 1]].series;
+        if (newPatient) {
+            ++patient;
+            study = 0;
+        }
+        if (newStudy) {
+            ++study;
+            series = 0;
+        }
+        if (newSeries) {
+            ++series;
+            image = 0;
+            char path[64];
+            snprintf(path, sizeof(path), "DICOM%cPAT%05u%cSTU%05u%cSER%05u", PATH_SEPARATOR, static_cast<unsigned>(patient),
+                PATH_SEPARATOR, static_cast<unsigned>(study), PATH_SEPARATOR, static_cast<unsigned>(series));
+            directory = path;
+            if (OFStandard::createDirectory(OFFilename((in.destination + PATH_SEPARATOR + directory).c_str()), OFFilename(in.destination.c_str())).bad()) {
+                SetErrorJson("Cannot create directory " + directory + " in " + in.destination);
+                return;
+            }
+        }
+        char name[16];
+        snprintf(name, sizeof(name), "IMG%05u", static_cast<unsigned>(++image));
+        sMediaFile file;
+        file.instance = i;
+        file.name = directory + PATH_SEPARATOR + name;
+        file.copied = false;
+        file.transcoded = false;
+        file.xfer = EXS_Unknown;
+        files.push_back(file);
+        containers.push_back(DcmQueryRetrievePackFile::container(instances[i].file.c_str()).c_str());
+    }
+    StorageTier::prefetch(containers);
+
+    // the files are copied or transcoded by a pool of threads, the DICOMDIR is built afterwards in
+    // one pass over them
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const ns::sRepresentationParameters repParams(in.lossyQuality, in.restartRows);
+    const size_t threads = std::min<size_t>(in.parallelism > 0 ? static_cast<size_t>(in.parallelism)
+        : std::max<size_t>(std::thread::hardware_concurrency(), 1), files.size());
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> done(0);
+    std::atomic<unsigned long long> bytes(0);
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t running = threads;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+
+    auto copy = [&]() {
+        OFLog::setThreadLogLevel(logLevel);
+        std::vector<unsigned char> block(readBlockSize);
+        std::string error;
+        size_t f;
+        while (!Cancelled() && (f = next++) < files.size()) {
+            sMediaFile& file = files[f];
+            const std::string& source = instances[file.instance].file;
+            const std::string target = in.destination + PATH_SEPARATOR + file.name;
+            if (!fetchLocal(source, error)) {
+                DCMNET_WARN("cannot copy " << source << " to media: " << error);
+                error.clear();
+                ++done;
+                continue;
+            }
+            const E_TransferSyntax stored = storedTransferSyntax(source);
+            if (writeXfer != EXS_Unknown && stored != writeXfer) {
+                E_TransferSyntax xfer = writeXfer;
+                unsigned char* buffer = NULL;
+                size_t length = 0;
+                OFCondition cond = transcodeInstance(source, xfer, repParams, buffer, length);
+                OFFile out;
+                if (cond.good() && out.fopen(target.c_str(), "wb") && out.fwrite(buffer, 1, length) == length && out.fclose() == 0) {
+                    file.copied = true;
+                    file.transcoded = xfer == writeXfer;
+                    file.xfer = xfer;
+                    bytes += length;
+                }
+                else {
+                    DCMNET_WARN("cannot write " << source << " to media: " << (cond.bad() ? cond.text() : target.c_str()));
+                }
+                if (buffer != NULL) {
+                    BufferPool::release(buffer);
+                }
+            }
+            else {
+                std::string path;
+                offile_off_t offset = 0;
+                Uint64 length = 0;
+                if (storedRange(source, path, offset, length) && copyRange(path, offset, length, target, block)) {
+                    file.copied = true;
+                    file.xfer = stored;
+                    bytes += length;
+                }
+                else {
+                    DCMNET_WARN("cannot copy " << source << " to " << target);
+                }
+            }
+            ++done;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        --running;
+        finished.notify_all();
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.push_back(std::thread(copy));
+    }
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (finished.wait_for(lock, std::chrono::seconds(1), [&] { return running == 0; })) {
+                break;
+            }
+        }
+        json v = json::object();
+        v["copied"] = done.load();
+        v["total"] = files.size();
+        v["bytes"] = bytes.load();
+        SendResponse(ns::createResponse(ns::PENDING, "DICOMDIR_PROGRESS", v), progress);
+    }
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+    if (Cancelled()) {
+        SetErrorJson("DICOMDIR creation cancelled, the files copied so far are left in " + in.destination);
+        return;
+    }
+
+    // image records come from the attributes of the index, other objects need records of their own
+    // kind and are read from the media
+    DicomDirInterface dicomdir;
+    dicomdir.enableInventMode(OFTrue);
+    dicomdir.disableBackupMode();
+    OFCondition cond = dicomdir.createNewDicomDir(profile, dicomdirFile, in.fileSetId.empty() ? "EXPORT" : in.fileSetId.c_str());
+    if (cond.bad()) {
+        SetErrorJson(std::string("Cannot create DICOMDIR: ") + cond.text());
+        return;
+    }
+    const OFFilename mediaRoot(in.destination.c_str());
+    size_t added = 0, skipped = 0, rejected = 0, transcoded = 0, fromIndex = 0;
+    for (const sMediaFile& file : files) {
+        if (!file.copied) {
+            ++skipped;
+            continue;
+        }
+        const OFFilename name(file.name.c_str());
+        cond = EC_IllegalCall;
+        const std::list<DcmSmallDcmElm>& row = rows[file.instance];
+        OFString sopClass;
+        for (const DcmSmallDcmElm& el : row) {
+            if (el.XTag() == DCM_SOPClassUID) {
+                sopClass = el.valueField().c_str();
+            }
+        }
+        if (file.xfer != EXS_Unknown && dcmIsImageStorageSOPClassUID(sopClass.c_str())) {
+            DcmFileFormat fileformat;
+            recordAttributes(row, file.xfer, fileformat);
+            cond = dicomdir.addDicomFile(name, fileformat, mediaRoot);
+            if (cond.good()) {
+                ++fromIndex;
+            }
+        }
+        if (cond.bad()) {
+            cond = dicomdir.addDicomFile(name, mediaRoot);
+        }
+        if (cond.bad()) {
+            DCMNET_WARN("instance " << instances[file.instance].sop << " does not conform to the " << DicomDirInterface::getProfileName(profile)
+                << " profile, leaving it out: " << cond.text());
+            OFStandard::deleteFile(OFFilename((in.destination + PATH_SEPARATOR + file.name).c_str()));
+            ++rejected;
+            continue;
+        }
+        ++added;
+        if (file.transcoded) {
+            ++transcoded;
+        }
+    }
+    cond = dicomdir.writeDicomDir();
+    if (cond.bad()) {
+        SetErrorJson(std::string("Cannot write DICOMDIR: ") + cond.text());
+        return;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Metrics::counter("dicomdir_instances_total", {{"source", "index"}}).add(fromIndex);
+    Metrics::counter("dicomdir_instances_total", {{"source", "file"}}).add(added - fromIndex);
+    json v = json::object();
+    v["dicomdir"] = dicomdirFile.getCharPointer();
+    v["instances"] = added;
+    v["skipped"] = skipped;
+    v["rejected"] = rejected;
+    v["transcoded"] = transcoded;
+    v["bytes"] = bytes.load();
+    v["elapsed"] = elapsed;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
+
+WatchIndexAsyncWorker::WatchIndexAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void WatchIndexAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    std::string error;
+    DcmIndexDatabase* db = openIndex(in, error);
+    if (db == NULL) {
+        SetErrorJson(error);
+        return;
+    }
+    std::vector<long long> position;
+    if (in.changeToken.empty()) {
+        position = db->changeLogEnd();
+    }
+    else if (!parseChangeToken(in.changeToken, position)) {
+        DcmIndexDatabasePool::release(db);
+        SetErrorJson("Invalid change token: " + in.changeToken);
+        return;
+    }
+
+    const char* levels[] = { PATIENT_LEVEL_STRING, STUDY_LEVEL_STRING, SERIE_LEVEL_STRING, IMAGE_LEVEL_STRING };
+    const std::string storagePath = db->storagePath();
+    while (!Cancelled()) {
+        // the commits counted before the read are in it
+        const unsigned long long commits = DcmIndexIngestQueue::commits(storagePath);
+        std::vector<DcmIndexChange> changes = db->changesSince(position, batchSize);
+        if (!changes.empty()) {
+            json v = json::object();
+            json list = json::array();
+            for (const DcmIndexChange& change : changes) {
+                json c = json::object();
+                c["level"] = levels[change.level];
+                c["action"] = change.action == DcmIndexChange::CREATED ? "created" : "updated";
+                c["StudyInstanceUID"] = change.studyInstanceUID;
+                if (change.level >= SERIE_LEVEL) {
+                    c["SeriesInstanceUID"] = change.seriesInstanceUID;
+                }
+                if (change.level >= IMAGE_LEVEL) {
+                    c["SOPInstanceUID"] = change.sopInstanceUID;
+                }
+                c["time"] = change.time;
+                list.push_back(c);
+            }
+            v["changes"] = list;
+            v["changeToken"] = changeToken(position);
+            SendResponse(ns::createResponse(ns::PENDING, "INDEX_CHANGES", v), progress);
+            continue;
+        }
+        // woken by the next commit of this process, cancel is checked every 100 ms
+        const std::chrono::steady_clock::time_point polled = std::chrono::steady_clock::now();
+        while (!Cancelled() && DcmIndexIngestQueue::waitForCommit(storagePath, commits, 100) == commits
+               && std::chrono::steady_clock::now() - polled < std::chrono::milliseconds(pollInterval)) {
+        }
+    }
+    DcmIndexDatabasePool::release(db);
+
+    // cancelling is how a watch ends, the token continues after the last batch sent
+    json v = json::object();
+    v["changeToken"] = changeToken(position);
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
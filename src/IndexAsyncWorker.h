@@ -0,0 +1,90 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// queries the index of a storage area in process, without an association to its SCP. The
+// matches at the level of the QueryRetrieveLevel tag (STUDY by default) are returned as DICOM JSON
+class QueryIndexAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        QueryIndexAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
+
+// the headers of the indexed instances matching the tags, up to the pixel data, as DICOM JSON
+class RetrieveMetadataAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        RetrieveMetadataAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
+
+// the pixel statistics the SCP recorded for the indexed instances matching the tags, see PixelStats
+class RetrievePixelStatsAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        RetrievePixelStatsAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
+
+// frames of the indexed instance matching the tags, sent as stored like getFrame()
+class RetrieveFramesAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        RetrieveFramesAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
+
+// the indexed instances matching the tags as one ZIP (stored, not compressed) or tar archive, sent
+// in EXPORT_DATA buffers while it is written, without staging it on disk. Entries are named
+// <StudyInstanceUID>/<SeriesInstanceUID>/<SOPInstanceUID>.dcm, grouped by series and copied as stored
+// unless writeTransfer asks for another transfer syntax. Unreadable instances are left out
+class ExportStudyAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        ExportStudyAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+
+        // bytes read from a file at a time
+        static const size_t readBlockSize = 1024 * 1024;
+};
+
+// a DICOMDIR with the indexed instances matching the tags below destination, for CD, DVD or USB
+// media. The files are copied, or transcoded where the profile needs it, by a pool of threads into
+// DICOM/PAT00001/STU00001/SER00001/IMG00001, then the records of the images are built from the
+// attributes the index holds, without parsing the files again, and the DICOMDIR is written in one pass
+class CreateDicomdirAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        CreateDicomdirAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+
+        // bytes copied at a time where the kernel cannot copy
+        static const size_t readBlockSize = 1024 * 1024;
+};
+
+// follows the change log of the index of a storage area until cancelled: the studies, series and
+// instances added are sent in batches with the changeToken after them, instead of polling with
+// C-FINDs. Commits of an SCP in this process are seen at once, those of other processes on the
+// storage area within pollInterval
+class WatchIndexAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        WatchIndexAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+
+        // ms between reads of the change log while no commit is seen
+        static const int pollInterval = 1000;
+
+        // instances per batch
+        static const size_t batchSize = 500;
+};
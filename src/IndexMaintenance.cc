@@ -0,0 +1,133 @@
+#include "IndexMaintenance.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "StorageBackend.h"
+#include "StorageTier.h"
+#include "Metrics.h"
+#include "dcmidxdb.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+
+namespace
+{
+
+// start of the last scheduled pass of each storage area and whether it is still running
+std::mutex scheduledMutex;
+std::map<std::string, std::pair<std::chrono::steady_clock::time_point, bool> > scheduled;
+
+}
+
+bool IndexMaintenance::isStored(const std::string& file)
+{
+    if (file.empty()) {
+        return false;
+    }
+    const OFString container = DcmQueryRetrievePackFile::container(file.c_str());
+    return OFStandard::fileExists(container) || StorageArea::isRemote(container.c_str()) || StorageTier::isCold(container.c_str());
+}
+
+bool IndexMaintenance::run(const std::string& storagePath, bool prune, sProgress& progress, std::string& error,
+    const std::function<void(const sProgress&)>& report, const std::atomic<bool>* cancel)
+{
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(storagePath.c_str());
+    if (db == NULL || !db->isInitialized()) {
+        DcmIndexDatabasePool::release(db);
+        error = "Cannot open the index of " + storagePath;
+        return false;
+    }
+
+    progress.shards = db->shardCount();
+    // a storage area that is not mounted looks as if all its files were deleted, nothing is removed
+    // unless some file of the index is found
+    bool indexed = false;
+    bool found = false;
+    for (size_t shard = 0; shard < progress.shards && prune && !found; ++shard) {
+        long long after = 0;
+        bool more = true;
+        while (more && !found && (cancel == NULL || !cancel->load())) {
+            std::vector< std::pair<long long, std::string> > files;
+            more = db->scanInstances(shard, after, batchSize, files);
+            indexed = indexed || !files.empty();
+            for (size_t i = 0; i < files.size() && !found; ++i) {
+                found = isStored(files[i].second);
+            }
+        }
+    }
+    if (indexed && !found && (cancel == NULL || !cancel->load())) {
+        DcmIndexDatabasePool::release(db);
+        error = "None of the indexed files of " + storagePath + " found, is it mounted?";
+        return false;
+    }
+
+    for (size_t shard = 0; shard < progress.shards; ++shard) {
+        progress.shard = shard;
+        long long after = 0;
+        bool more = true;
+        while (prune && more && (cancel == NULL || !cancel->load())) {
+            std::vector< std::pair<long long, std::string> > files;
+            more = db->scanInstances(shard, after, batchSize, files);
+            std::vector<long long> missing;
+            for (const auto& file : files) {
+                if (!isStored(file.second)) {
+                    missing.push_back(file.first);
+                }
+            }
+            progress.checked += files.size();
+            progress.missing += missing.size();
+            if (!missing.empty()) {
+                const size_t removed = db->removeInstances(shard, missing);
+                progress.removed += removed;
+                Metrics::counter("db_pruned_instances_total").add(removed);
+            }
+            if (report) {
+                report(progress);
+            }
+        }
+        // steps until one has nothing left to free, the last one refreshes the statistics
+        while (cancel == NULL || !cancel->load()) {
+            const size_t freed = db->compact(shard, stepBudget);
+            progress.freedPages += freed;
+            if (report) {
+                report(progress);
+            }
+            if (freed == 0) {
+                break;
+            }
+        }
+    }
+    DcmIndexDatabasePool::release(db);
+    DCMNET_INFO("index maintenance of " << storagePath << ": checked " << progress.checked << " instances, removed "
+        << progress.removed << ", freed " << progress.freedPages << " pages");
+    return true;
+}
+
+void IndexMaintenance::schedule(const std::string& storagePath)
+{
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(scheduledMutex);
+        std::map<std::string, std::pair<std::chrono::steady_clock::time_point, bool> >::iterator it = scheduled.find(storagePath);
+        if (it != scheduled.end() && (it->second.second || now - it->second.first < std::chrono::seconds(scheduleInterval))) {
+            return;
+        }
+        scheduled[storagePath] = std::make_pair(now, true);
+    }
+    std::thread([storagePath]() {
+        sProgress progress;
+        std::string error;
+        if (!run(storagePath, true, progress, error)) {
+            DCMNET_WARN("index maintenance of " << storagePath << " stopped: " << error);
+        }
+        std::lock_guard<std::mutex> lock(scheduledMutex);
+        scheduled[storagePath].second = false;
+    }).detach();
+}
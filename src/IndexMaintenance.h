@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+// Maintenance of the index of a storage area while the SCP keeps ingesting. A pass walks the
+// instances of each shard in id order, batchSize at a time, and checks their files outside of any
+// transaction: instances whose file is neither on disk nor on the cold tier nor in the object store
+// are removed with the series, studies and patients left empty, one short transaction per batch.
+// Then the freed pages of the shard are returned to the file system and the statistics of the query
+// planner refreshed, in steps of stepBudget ms. The ingest writers wait for one step at most.
+class IndexMaintenance
+{
+public:
+    struct sProgress {
+        sProgress() : shards(0), shard(0), checked(0), missing(0), removed(0), freedPages(0) {}
+        size_t shards;
+        // shard being walked
+        size_t shard;
+        // instances whose files were checked, found missing and removed from the index
+        size_t checked;
+        size_t missing;
+        size_t removed;
+        // pages returned to the file system
+        size_t freedPages;
+    };
+
+    // one pass over the index of storagePath, without prune only the compaction. report is called
+    // after every batch and step. Nothing is removed from an index none of whose files is found, the
+    // storage area is likely not mounted then. False with error in that case or if the index cannot
+    // be opened
+    static bool run(const std::string& storagePath, bool prune, sProgress& progress, std::string& error,
+        const std::function<void(const sProgress&)>& report = std::function<void(const sProgress&)>(),
+        const std::atomic<bool>* cancel = NULL);
+
+    // a pass on a thread of its own, unless one is running for the storage area already or the last
+    // one started less than scheduleInterval seconds ago
+    static void schedule(const std::string& storagePath);
+
+    // true if the file of an indexed instance is still kept somewhere
+    static bool isStored(const std::string& file);
+
+    static const size_t batchSize = 500;
+
+    // ms of a compaction step
+    static const int stepBudget = 50;
+
+    static const int scheduleInterval = 3600;
+};
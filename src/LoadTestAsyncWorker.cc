@@ -0,0 +1,357 @@
+#include "LoadTestAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "TlsTransport.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h"   /* make sure OS specific configuration is included first */
+
+#include "dcmtk/ofstd/ofstd.h"       /* for OFStandard functions */
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmdata/dcdatutl.h"  /* for DcmDataUtil */
+#include "dcmtk/dcmnet/scu.h"        /* for DcmSCU */
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct sLoadFile
+    {
+        OFFilename file;
+        OFString sopClass;
+        OFString xfer;
+        size_t size;
+    };
+
+    // outcome of the requests of one association
+    struct sSenderResult
+    {
+        sSenderResult() : bytes(0) {}
+        std::vector<double> latencies;
+        std::map<std::string, size_t> errors;
+        size_t bytes;
+    };
+
+    // a 16 bit CT image with noise, so compressing peers see realistic entropy
+    std::unique_ptr<DcmDataset> syntheticImage(Uint16 rows, Uint16 columns)
+    {
+        std::unique_ptr<DcmDataset> dataset(new DcmDataset());
+        char uid[100];
+        dataset->putAndInsertString(DCM_SOPClassUID, UID_CTImageStorage);
+        dataset->putAndInsertString(DCM_StudyInstanceUID, dcmGenerateUniqueIdentifier(uid, SITE_STUDY_UID_ROOT));
+        dataset->putAndInsertString(DCM_SeriesInstanceUID, dcmGenerateUniqueIdentifier(uid, SITE_SERIES_UID_ROOT));
+        dataset->putAndInsertString(DCM_PatientID, "LOADTEST");
+        dataset->putAndInsertString(DCM_PatientName, "Load^Test");
+        dataset->putAndInsertString(DCM_StudyDescription, "LOAD TEST");
+        dataset->putAndInsertString(DCM_Modality, "CT");
+        dataset->putAndInsertUint16(DCM_SamplesPerPixel, 1);
+        dataset->putAndInsertString(DCM_PhotometricInterpretation, "MONOCHROME2");
+        dataset->putAndInsertUint16(DCM_Rows, rows);
+        dataset->putAndInsertUint16(DCM_Columns, columns);
+        dataset->putAndInsertUint16(DCM_BitsAllocated, 16);
+        dataset->putAndInsertUint16(DCM_BitsStored, 12);
+        dataset->putAndInsertUint16(DCM_HighBit, 11);
+        dataset->putAndInsertUint16(DCM_PixelRepresentation, 0);
+        std::vector<Uint16> pixels(static_cast<size_t>(rows) * columns);
+        Uint32 noise = 1;
+        for (size_t i = 0; i < pixels.size(); ++i)
+        {
+            noise = noise * 1664525u + 1013904223u;
+            pixels[i] = static_cast<Uint16>(((i % columns + i / columns) * 2048 / (rows + columns) + (noise >> 28)) & 0x0fff);
+        }
+        dataset->putAndInsertUint16Array(DCM_PixelData, pixels.data(), static_cast<unsigned long>(pixels.size()));
+        return dataset;
+    }
+
+    double percentile(const std::vector<double>& sorted, double q)
+    {
+        if (sorted.empty()) return 0;
+        size_t rank = static_cast<size_t>(q * static_cast<double>(sorted.size()) + 0.5);
+        return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+    }
+}
+
+LoadTestAsyncWorker::LoadTestAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void LoadTestAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (!in.valid())
+    {
+        SetErrorJson(in.source.valid() ? "Target not set" : "Source not set");
+        return;
+    }
+
+    // replayed files are sent as stored, reading them again for each request like a modality does
+    std::vector<sLoadFile> files;
+    std::set<OFString> sopClasses;
+    std::set<std::pair<OFString, OFString> > encapsulated;  // sop class, transfer syntax
+    if (!in.sourcePath.empty())
+    {
+        OFList<OFFilename> inputFiles;
+        OFStandard::searchDirectoryRecursively(in.sourcePath.c_str(), inputFiles, OFFilename(), OFFilename(), OFTrue);
+        for (OFListIterator(OFFilename) it = inputFiles.begin(); it != inputFiles.end(); ++it)
+        {
+            sLoadFile item;
+            OFString sopInstance;
+            item.file = *it;
+            if (!DcmDataUtil::isDicomFile(item.file) || DcmDataUtil::getSOPInstanceFromFile(item.file, item.sopClass, sopInstance, item.xfer, ERM_metaOnly).bad())
+            {
+                DCMNET_WARN("bad DICOM file: " << item.file << ", ignoring file");
+                continue;
+            }
+            item.size = OFstatic_cast(size_t, OFStandard::getFileSize(item.file));
+            files.push_back(item);
+            sopClasses.insert(item.sopClass);
+            if (DcmXfer(item.xfer.c_str()).isEncapsulated())
+            {
+                encapsulated.insert(std::make_pair(item.sopClass, item.xfer));
+            }
+        }
+        if (files.empty())
+        {
+            SetErrorJson("Invalid source path set, no DICOM files found");
+            return;
+        }
+    }
+    else
+    {
+        sopClasses.insert(UID_CTImageStorage);
+    }
+
+    const Uint16 rows = OFstatic_cast(Uint16, in.height > 0 ? std::min(in.height, 65535) : 512);
+    const Uint16 columns = OFstatic_cast(Uint16, in.width > 0 ? std::min(in.width, 65535) : 512);
+    const size_t associations = static_cast<size_t>(std::max(in.parallelism, 1));
+    const double rate = static_cast<double>(std::max(in.rate, 0));
+    const uint64_t maxRequests = static_cast<uint64_t>(std::max(in.maxRequests, 0));
+    // runs for 10 seconds unless limited by the number of requests only
+    const int duration = in.duration > 0 ? in.duration : (maxRequests > 0 ? 0 : 10);
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point deadline = duration > 0 ? start + std::chrono::seconds(duration) : Clock::time_point::max();
+
+    DCMNET_INFO("load test with " << associations << " associations, " << (files.empty() ? "synthetic images" : "replaying files")
+        << ", " << (rate > 0 ? std::to_string(in.rate) + " requests per second" : std::string("unthrottled")));
+
+    // request k is due at start + k / rate, its latency counts from then on, so a peer which
+    // falls behind sees its queueing delay in the percentiles instead of a lower request rate
+    std::atomic<uint64_t> next(0);
+    std::atomic<size_t> sent(0);
+    std::atomic<size_t> failed(0);
+    std::atomic<size_t> associationFailures(0);
+    std::atomic<size_t> running(associations);
+    auto claim = [&](uint64_t& k, Clock::time_point& due) -> bool {
+        if (Cancelled()) return false;
+        k = next++;
+        if (maxRequests > 0 && k >= maxRequests) return false;
+        due = rate > 0 ? start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(k) / rate)) : Clock::now();
+        if (due >= deadline) return false;
+        std::this_thread::sleep_until(due);
+        return true;
+    };
+
+    std::vector<sSenderResult> results(associations);
+    std::vector<std::thread> senders;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t a = 0; a < associations; ++a)
+    {
+        senders.push_back(std::thread([&, a]() {
+            OFLog::setThreadLogLevel(logLevel);
+            sSenderResult& result = results[a];
+            std::unique_ptr<DcmDataset> image;
+            size_t imageSize = 0;
+            if (files.empty())
+            {
+                image = syntheticImage(rows, columns);
+                imageSize = image->calcElementLength(EXS_LittleEndianExplicit, EET_ExplicitLength);
+            }
+
+            DcmSCU scu;
+            scu.setPeerHostName(in.target.ip.c_str());
+            scu.setPeerPort(OFstatic_cast(Uint16, in.target.port));
+            scu.setPeerAETitle(in.target.aet.c_str());
+            scu.setAETitle(in.source.aet.c_str());
+            scu.setMaxReceivePDULength(in.network.maxReceivePDU());
+            scu.setTCPSocketOptions(in.network.socketBufferSize, in.network.tcpNoDelay);
+            scu.setACSETimeout(OFstatic_cast(Uint32, in.network.acseTimeoutSeconds()));
+            scu.setDIMSETimeout(OFstatic_cast(Uint32, in.network.dimseTimeoutSeconds()));
+            scu.setDIMSEBlockingMode(in.network.dimseBlockMode());
+            scu.setDatasetConversionMode(OFTrue);
+            OFList<OFString> uncompressed;
+            uncompressed.push_back(UID_LittleEndianExplicitTransferSyntax);
+            uncompressed.push_back(UID_LittleEndianImplicitTransferSyntax);
+            for (const OFString& sopClass : sopClasses)
+            {
+                scu.addPresentationContext(sopClass, uncompressed);
+            }
+            for (const std::pair<OFString, OFString>& pc : encapsulated)
+            {
+                OFList<OFString> xfers;
+                xfers.push_back(pc.second);
+                scu.addPresentationContext(pc.first, xfers);
+            }
+
+            uint64_t k = 0;
+            Clock::time_point due;
+            bool more = true;
+            size_t refused = 0;
+            while (more && !Cancelled() && Clock::now() < deadline)
+            {
+                OFCondition status = TlsTransport::secure(scu, in.network);
+                if (status.good())
+                {
+                    status = scu.initNetwork();
+                }
+                if (status.good())
+                {
+                    status = scu.negotiateAssociation();
+                }
+                if (status.bad())
+                {
+                    // the peer may be restarting, the association is given up after 10 attempts in a row
+                    ++associationFailures;
+                    ++result.errors[std::string("association: ") + status.text()];
+                    DCMNET_ERROR("association " << a << ": cannot negotiate network association: " << status.text());
+                    if (++refused >= 10) break;
+                    std::this_thread::sleep_until(std::min(deadline, Clock::now() + std::chrono::seconds(1)));
+                    continue;
+                }
+                refused = 0;
+                while ((more = claim(k, due)))
+                {
+                    Uint16 rspStatusCode = 0;
+                    size_t bytes = 0;
+                    if (files.empty())
+                    {
+                        char uid[100];
+                        image->putAndInsertString(DCM_SOPInstanceUID, dcmGenerateUniqueIdentifier(uid, SITE_INSTANCE_UID_ROOT));
+                        T_ASC_PresentationContextID pcid = scu.findAnyPresentationContextID(UID_CTImageStorage, UID_LittleEndianExplicitTransferSyntax);
+                        status = pcid == 0 ? DIMSE_NOVALIDPRESENTATIONCONTEXTID : scu.sendSTORERequest(pcid, OFFilename(), image.get(), rspStatusCode);
+                        bytes = imageSize;
+                    }
+                    else
+                    {
+                        const sLoadFile& item = files[k % files.size()];
+                        T_ASC_PresentationContextID pcid = scu.findAnyPresentationContextID(item.sopClass, item.xfer);
+                        status = pcid == 0 ? DIMSE_NOVALIDPRESENTATIONCONTEXTID : scu.sendSTORERequest(pcid, item.file, NULL, rspStatusCode);
+                        bytes = item.size;
+                    }
+                    if (status.good() && (rspStatusCode == STATUS_Success || DICOM_WARNING_STATUS(rspStatusCode)))
+                    {
+                        result.latencies.push_back(std::chrono::duration<double>(Clock::now() - due).count());
+                        result.bytes += bytes;
+                        ++sent;
+                        continue;
+                    }
+                    ++failed;
+                    ++result.errors[status.good() ? DU_cstoreStatusString(rspStatusCode) : status.text()];
+                    if (status == DUL_PEERREQUESTEDRELEASE || status == DUL_PEERABORTEDASSOCIATION || status == DUL_NETWORKCLOSED)
+                    {
+                        scu.closeAssociation(status == DUL_PEERREQUESTEDRELEASE ? DCMSCU_PEER_REQUESTED_RELEASE : DCMSCU_PEER_ABORTED_ASSOCIATION);
+                        break;
+                    }
+                    if (status.bad() && status != DIMSE_NOVALIDPRESENTATIONCONTEXTID)
+                    {
+                        // e.g. a DIMSE timeout, the association is in an unknown state
+                        scu.abortAssociation();
+                        break;
+                    }
+                }
+                if (scu.isConnected())
+                {
+                    scu.releaseAssociation();
+                }
+            }
+            --running;
+        }));
+    }
+
+    // progress once a second with the requests completed in that second
+    size_t lastSent = 0;
+    size_t lastFailed = 0;
+    while (running > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const size_t nowSent = sent;
+        const size_t nowFailed = failed;
+        json v = json::object();
+        v["elapsed"] = std::chrono::duration<double>(Clock::now() - start).count();
+        v["sent"] = nowSent;
+        v["failed"] = nowFailed;
+        v["throughput"] = nowSent - lastSent;
+        v["errors"] = nowFailed - lastFailed;
+        SendResponse(ns::createResponse(ns::PENDING, "LOAD_PROGRESS", v), progress);
+        lastSent = nowSent;
+        lastFailed = nowFailed;
+    }
+    for (std::thread& sender : senders)
+    {
+        sender.join();
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> latencies;
+    std::map<std::string, size_t> errors;
+    size_t bytes = 0;
+    for (sSenderResult& result : results)
+    {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        for (const std::pair<const std::string, size_t>& error : result.errors)
+        {
+            errors[error.first] += error.second;
+        }
+        bytes += result.bytes;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (double latency : latencies)
+    {
+        sum += latency;
+    }
+    DCMNET_INFO("load test sent " << sent << " SOP instances in " << elapsed << " s, " << failed << " failed");
+
+    json latency = json::object();
+    latency["mean"] = latencies.empty() ? 0 : sum / static_cast<double>(latencies.size());
+    latency["p50"] = percentile(latencies, 0.5);
+    latency["p90"] = percentile(latencies, 0.9);
+    latency["p99"] = percentile(latencies, 0.99);
+    latency["max"] = latencies.empty() ? 0 : latencies.back();
+    json v = json::object();
+    v["sent"] = static_cast<size_t>(sent);
+    v["failed"] = static_cast<size_t>(failed);
+    v["associationFailures"] = static_cast<size_t>(associationFailures);
+    v["duration"] = elapsed;
+    v["throughput"] = elapsed > 0 ? static_cast<double>(sent) / elapsed : 0;
+    v["bytesPerSecond"] = elapsed > 0 ? static_cast<double>(bytes) / elapsed : 0;
+    v["latency"] = latency;
+    v["errors"] = errors;
+
+    if (Cancelled())
+    {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    if (sent == 0)
+    {
+        SetErrorJson(failed > 0 || associationFailures > 0 ? "No C-STORE request succeeded" : "No C-STORE request sent");
+        return;
+    }
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// sends C-STORE requests over several associations at a target rate for a given time, either
+// synthetic images or the files below sourcePath over and over, and reports the throughput,
+// the latency percentiles and the errors of the peer
+class LoadTestAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        LoadTestAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,175 @@
+#include "Logging.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/oflog/oflog.h"
+#include "dcmtk/oflog/asyncap.h"
+#include "dcmtk/oflog/consap.h"
+#include "dcmtk/oflog/layout.h"
+#include "dcmtk/oflog/spi/logevent.h"
+
+namespace log4cplus = dcmtk::log4cplus;
+
+namespace
+{
+
+// hands the records to the sink on a thread of its own, appending only takes the queue lock
+class SinkAppender : public log4cplus::Appender
+{
+public:
+    SinkAppender(const Logging::Sink& sink, size_t batchSize, int flushInterval)
+        : _sink(sink), _batchSize(batchSize > 0 ? batchSize : 1), _flushInterval(flushInterval > 0 ? flushInterval : 100),
+          _dropped(0), _stop(false)
+    {
+        _thread = std::thread([this]() { Run(); });
+    }
+
+    virtual ~SinkAppender()
+    {
+        destructorImpl();
+    }
+
+    // delivers the queued records and stops the thread
+    virtual void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_stop) {
+                return;
+            }
+            _stop = true;
+        }
+        _wakeup.notify_one();
+        _thread.join();
+        closed = true;
+    }
+
+protected:
+    virtual void append(const log4cplus::spi::InternalLoggingEvent& event)
+    {
+        const log4cplus::helpers::Time& time = event.getTimestamp();
+        Logging::sRecord record;
+        record.time = static_cast<double>(time.sec()) * 1000 + time.usec() / 1000.0;
+        record.level = log4cplus::getLogLevelManager().toString(event.getLogLevel()).c_str();
+        record.logger = event.getLoggerName().c_str();
+        record.message = event.getMessage().c_str();
+        record.thread = event.getThread().c_str();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_records.size() >= 10 * _batchSize) {
+            ++_dropped;
+            return;
+        }
+        _records.push_back(std::move(record));
+        if (_records.size() == _batchSize) {
+            _wakeup.notify_one();
+        }
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _wakeup.wait_for(lock, std::chrono::milliseconds(_flushInterval), [this]() {
+                return _stop || _records.size() >= _batchSize;
+            });
+            bool stop = _stop;
+            std::vector<Logging::sRecord> records;
+            records.swap(_records);
+            size_t dropped = _dropped;
+            _dropped = 0;
+            lock.unlock();
+
+            if (dropped > 0) {
+                Logging::sRecord warning;
+                warning.time = std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+                warning.level = "WARN";
+                warning.logger = "dcmtk";
+                warning.message = std::to_string(dropped) + " log records dropped, the sink did not keep up";
+                records.insert(records.begin(), warning);
+            }
+            for (size_t i = 0; i < records.size(); i += _batchSize) {
+                std::vector<Logging::sRecord> batch(records.begin() + i, records.begin() + std::min(records.size(), i + _batchSize));
+                _sink(batch);
+            }
+
+            if (stop) {
+                return;
+            }
+            lock.lock();
+        }
+    }
+
+    Logging::Sink _sink;
+    size_t _batchSize;
+    int _flushInterval;
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::vector<Logging::sRecord> _records;
+    size_t _dropped;
+    bool _stop;
+};
+
+// AsyncAppender whose queue thread lets go of it once closed, so a replaced appender is released
+class QueueAppender : public log4cplus::AsyncAppender
+{
+public:
+    QueueAppender(const log4cplus::SharedAppenderPtr& appender, unsigned queueSize)
+        : AsyncAppender(appender, queueSize)
+    {
+    }
+
+    virtual ~QueueAppender()
+    {
+        destructorImpl();
+    }
+
+    virtual void close()
+    {
+        if (closed) {
+            return;
+        }
+        AsyncAppender::close();
+        queue_thread = 0;
+        closed = true;
+    }
+};
+
+std::mutex loggingMutex;
+
+}
+
+void Logging::configure(size_t queueSize, const Sink& sink, size_t batchSize, int flushInterval)
+{
+    std::lock_guard<std::mutex> lock(loggingMutex);
+
+    log4cplus::SharedAppenderPtr appender;
+    if (sink) {
+        // the sink appender never waits for the sink, no queue needed
+        appender = new SinkAppender(sink, batchSize, flushInterval);
+    } else {
+        // same output as set up by oflog
+        appender = new log4cplus::ConsoleAppender(OFTrue /* logToStdErr */, OFTrue /* immediateFlush */);
+        appender->setLayout(OFunique_ptr<log4cplus::Layout>(new log4cplus::PatternLayout("%P: %m%n")));
+        if (queueSize > 0) {
+            appender = new QueueAppender(appender, static_cast<unsigned>(queueSize));
+        }
+    }
+
+    log4cplus::Logger root = log4cplus::Logger::getRoot();
+    log4cplus::SharedAppenderPtrList previous = root.getAllAppenders();
+    root.removeAllAppenders();
+    root.addAppender(appender);
+    // written out by now, a replaced sink delivers its last records
+    for (size_t i = 0; i < previous.size(); ++i) {
+        previous[i]->close();
+    }
+}
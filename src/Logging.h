@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Process wide log output of DCMTK. Verbose requests raise the log level of their own threads only
+// (OFLog::setThreadLogLevel()). Records can be queued for a thread of their own (the oflog
+// AsyncAppender), logging threads then only wait for the queue instead of the console, and can be
+// handed to a sink in batches instead of being written to stderr.
+class Logging
+{
+public:
+    struct sRecord {
+        // ms since the epoch
+        double time;
+        std::string level;
+        std::string logger;
+        std::string message;
+        std::string thread;
+    };
+
+    // receives the records of a batch on the thread of the sink
+    typedef std::function<void(std::vector<sRecord>& records)> Sink;
+
+    // replaces the appenders of the root logger. Without sink the records are written to stderr,
+    // through a queue of queueSize records for an appender thread or on the logging thread if 0.
+    // Otherwise sink receives batches of up to batchSize records at least every flushInterval ms
+    // on a thread of its own. Records beyond 10 batches waiting for the sink are dropped, the next
+    // batch starts with a warning about them
+    static void configure(size_t queueSize, const Sink& sink, size_t batchSize, int flushInterval);
+};
@@ -0,0 +1,87 @@
+#include "MaintainAsyncWorker.h"
+
+#include <chrono>
+
+#include "json.h"
+#include "Utils.h"
+#include "IndexMaintenance.h"
+#include "StorageTier.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+
+MaintainAsyncWorker::MaintainAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void MaintainAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.storagePath.empty()) {
+        SetErrorJson("No storage path set");
+        return;
+    }
+    if (!OFStandard::dirExists(in.storagePath.c_str())) {
+        SetErrorJson("Specified storage path does not exist: " + in.storagePath);
+        return;
+    }
+    if (!in.coldPath.empty() && !OFStandard::dirExists(in.coldPath.c_str())) {
+        SetErrorJson("Specified cold path does not exist: " + in.coldPath);
+        return;
+    }
+    if (!DcmIndexDatabasePool::configure(in.indexBackend == "postgresql" ?
+            DcmIndexDatabasePool::POSTGRESQL : DcmIndexDatabasePool::SQLITE, in.indexConnection)) {
+        SetErrorJson("Index backend not available in this build: " + in.indexBackend);
+        return;
+    }
+    DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    // files migrated to the cold tier are still stored
+    if (!in.coldPath.empty()) {
+        StorageTier::configure(in.storagePath, in.coldPath, StorageTier::defaultThreads);
+    }
+    // the files of an object store are not checked, only the local cache is in the storage area
+    const bool prune = in.storageBackend != "s3";
+
+    // progress at most once a second
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    IndexMaintenance::sProgress state;
+    std::string error;
+    const bool success = IndexMaintenance::run(in.storagePath, prune, state, error, [&](const IndexMaintenance::sProgress& p) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported < std::chrono::seconds(1)) {
+            return;
+        }
+        reported = now;
+        json v = json::object();
+        v["shard"] = p.shard;
+        v["shards"] = p.shards;
+        v["checked"] = p.checked;
+        v["removed"] = p.removed;
+        v["freedPages"] = p.freedPages;
+        v["elapsed"] = std::chrono::duration<double>(now - start).count();
+        SendResponse(ns::createResponse(ns::PENDING, "MAINTENANCE_PROGRESS", v), progress);
+    }, CancelFlag());
+    if (!success) {
+        SetErrorJson(error);
+        return;
+    }
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+
+    json v = json::object();
+    v["checked"] = state.checked;
+    v["missing"] = state.missing;
+    v["removed"] = state.removed;
+    v["freedPages"] = state.freedPages;
+    v["elapsed"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// one pass of IndexMaintenance over the index of a storage area: the instances whose files are gone
+// are removed, the freed pages returned and the planner statistics refreshed, while the SCP keeps
+// storing to it
+class MaintainAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        MaintainAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,217 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcarena.h"
+#include "dcmtk/dcmdata/dccodec.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+#include "dcmtk/dcmnet/dcmtrans.h"
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
+
+#include "BufferPool.h"
+#include "TransferPolicy.h"
+#include "sqlite3.h"
+
+using json = nlohmann::json;
+
+namespace
+{
+
+template <class T>
+struct sSeries {
+    std::string name;
+    Metrics::Labels labels;
+    T value;
+};
+
+template <class T>
+using SeriesMap = std::map<std::string, std::unique_ptr<sSeries<T>>>;
+
+std::mutex metricsMutex;
+SeriesMap<Metrics::Counter> counters;
+SeriesMap<Metrics::Gauge> gauges;
+SeriesMap<Metrics::Histogram> histograms;
+
+// the series of name and labels, created on first use
+template <class T>
+T& series(SeriesMap<T>& map, const std::string& name, const Metrics::Labels& labels)
+{
+    std::string key = name;
+    for (const auto& label : labels) {
+        key += '\0' + label.first + '\0' + label.second;
+    }
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    std::unique_ptr<sSeries<T>>& entry = map[key];
+    if (!entry) {
+        entry.reset(new sSeries<T>());
+        entry->name = name;
+        entry->labels = labels;
+    }
+    return entry->value;
+}
+
+size_t bucketOf(uint64_t micros)
+{
+    if (micros < Metrics::Histogram::subBuckets) {
+        return static_cast<size_t>(micros);
+    }
+    int msb = 63;
+    while ((micros >> msb) == 0) {
+        --msb;
+    }
+    size_t index = 4 * static_cast<size_t>(msb - 1) + ((micros >> (msb - 2)) & 3);
+    return std::min(index, Metrics::Histogram::buckets - 1);
+}
+
+// upper bound of the bucket holding the value of the given rank, at most the maximum
+double quantile(const Metrics::Histogram& histogram, double q)
+{
+    uint64_t count = histogram.count();
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * count + 0.5);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < Metrics::Histogram::buckets; ++i) {
+        seen += histogram.bucket(i);
+        if (seen >= rank && seen > 0) {
+            return std::min(Metrics::Histogram::upperBound(i), histogram.max());
+        }
+    }
+    return histogram.max();
+}
+
+void codecTiming(E_TransferSyntax xfer, OFBool encode, double seconds, Uint32 uncompressedBytes, Uint32 compressedBytes)
+{
+    Metrics::histogram(encode ? "codec_encode_seconds" : "codec_decode_seconds",
+        {{"transferSyntax", DcmXfer(xfer).getXferID()}}).record(seconds);
+    if (encode) {
+        TransferPolicy::recordEncoding(xfer, uncompressedBytes, compressedBytes, seconds);
+    }
+}
+
+void schedulerTiming(DcmQueryRetrieveScheduler::PriorityClass priorityClass, const char* stage, double waitSeconds, double serviceSeconds)
+{
+    const Metrics::Labels labels = {{"priority", DcmQueryRetrieveScheduler::name(priorityClass)}, {"stage", stage}};
+    Metrics::histogram("scheduler_wait_seconds", labels).record(waitSeconds);
+    Metrics::histogram("scheduler_service_seconds", labels).record(serviceSeconds);
+}
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+Metrics::Histogram::Histogram() : _count(0), _sumMicros(0), _maxMicros(0)
+{
+    for (size_t i = 0; i < buckets; ++i) {
+        _buckets[i] = 0;
+    }
+}
+
+void Metrics::Histogram::record(double seconds)
+{
+    uint64_t micros = seconds > 0 ? static_cast<uint64_t>(seconds * 1e6) : 0;
+    ++_buckets[bucketOf(micros)];
+    ++_count;
+    _sumMicros += micros;
+    uint64_t max = _maxMicros.load();
+    while (micros > max && !_maxMicros.compare_exchange_weak(max, micros)) {
+    }
+}
+
+double Metrics::Histogram::upperBound(size_t bucket)
+{
+    if (bucket < subBuckets) {
+        return (bucket + 1) / 1e6;
+    }
+    size_t shift = bucket / 4 - 1;
+    return static_cast<double>((5 + bucket % 4) << shift) / 1e6;
+}
+
+//--------------------------------------------------------------------------------------------
+
+Metrics::Counter& Metrics::counter(const std::string& name, const Labels& labels)
+{
+    return series(counters, name, labels);
+}
+
+Metrics::Gauge& Metrics::gauge(const std::string& name, const Labels& labels)
+{
+    return series(gauges, name, labels);
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string& name, const Labels& labels)
+{
+    return series(histograms, name, labels);
+}
+
+json Metrics::snapshot()
+{
+    json result = json::object();
+    result["counters"] = json::array();
+    result["gauges"] = json::array();
+    result["histograms"] = json::array();
+
+    // the traffic of all DICOM connections is counted by the transport layer
+    result["counters"].push_back({{"name", "network_received_bytes_total"}, {"labels", json::object()}, {"value", DcmTCPConnection::bytesReceived()}});
+    result["counters"].push_back({{"name", "network_sent_bytes_total"}, {"labels", json::object()}, {"value", DcmTCPConnection::bytesSent()}});
+    result["gauges"].push_back({{"name", "network_connections"}, {"labels", json::object()}, {"value", DcmTCPConnection::openConnections()}});
+
+    // memory held by the subsystems that keep their own accounting, the progress queue and the
+    // JS buffers are regular gauges below
+    sqlite3_int64 pageCache = 0;
+    sqlite3_int64 highwater = 0;
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &pageCache, &highwater, 0);
+    result["gauges"].push_back({{"name", "memory_dcmdata_objects"}, {"labels", json::object()}, {"value", DcmArenaScope::liveObjects()}});
+    result["gauges"].push_back({{"name", "memory_dcmdata_object_bytes"}, {"labels", json::object()}, {"value", DcmArenaScope::liveBytes()}});
+    result["gauges"].push_back({{"name", "memory_buffer_pool_bytes"}, {"labels", {{"state", "in_use"}}}, {"value", BufferPool::inUseBytes()}});
+    result["gauges"].push_back({{"name", "memory_buffer_pool_bytes"}, {"labels", {{"state", "idle"}}}, {"value", BufferPool::pooledBytes()}});
+    result["gauges"].push_back({{"name", "memory_sqlite_bytes"}, {"labels", json::object()}, {"value", sqlite3_memory_used()}});
+    result["gauges"].push_back({{"name", "memory_sqlite_page_cache_bytes"}, {"labels", json::object()}, {"value", pageCache}});
+
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    for (const auto& entry : counters) {
+        result["counters"].push_back({{"name", entry.second->name}, {"labels", entry.second->labels}, {"value", entry.second->value.value()}});
+    }
+    for (const auto& entry : gauges) {
+        result["gauges"].push_back({{"name", entry.second->name}, {"labels", entry.second->labels}, {"value", entry.second->value.value()}});
+    }
+    for (const auto& entry : histograms) {
+        const Histogram& histogram = entry.second->value;
+        json buckets = json::array();
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < Histogram::buckets; ++i) {
+            uint64_t count = histogram.bucket(i);
+            if (count > 0) {
+                cumulative += count;
+                buckets.push_back({Histogram::upperBound(i), cumulative});
+            }
+        }
+        json h = json::object();
+        h["name"] = entry.second->name;
+        h["labels"] = entry.second->labels;
+        // buckets are read one by one while recording goes on, the count matches the buckets
+        h["count"] = cumulative;
+        h["sum"] = histogram.sum();
+        h["max"] = histogram.max();
+        h["p50"] = quantile(histogram, 0.5);
+        h["p90"] = quantile(histogram, 0.9);
+        h["p99"] = quantile(histogram, 0.99);
+        h["buckets"] = buckets;
+        result["histograms"].push_back(h);
+    }
+    return result;
+}
+
+void Metrics::enableCodecTiming()
+{
+    DcmCodecList::setTimingCallback(codecTiming);
+}
+
+void Metrics::enableSchedulerTiming()
+{
+    DcmQueryRetrieveScheduler::setTimingCallback(schedulerTiming);
+}
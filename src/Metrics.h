@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "json.h"
+
+// Process wide counters, gauges and latency histograms of the native side, read from JS with
+// getMetrics(). Series are identified by name and labels and live as long as the process, so
+// callers may keep the returned references. Looking a series up takes a lock, recording into it
+// does not.
+class Metrics
+{
+public:
+    typedef std::map<std::string, std::string> Labels;
+
+    class Counter
+    {
+    public:
+        Counter() : _value(0) {}
+        void add(uint64_t value = 1) { _value += value; }
+        uint64_t value() const { return _value.load(); }
+
+    private:
+        std::atomic<uint64_t> _value;
+    };
+
+    class Gauge
+    {
+    public:
+        Gauge() : _value(0) {}
+        void set(int64_t value) { _value = value; }
+        void add(int64_t value) { _value += value; }
+        int64_t value() const { return _value.load(); }
+
+    private:
+        std::atomic<int64_t> _value;
+    };
+
+    // log-linear (HDR style) buckets over microseconds: each power of two is split into four
+    // buckets, which bounds the relative error to 25% from 1 us up to about 12 days
+    class Histogram
+    {
+    public:
+        static const size_t subBuckets = 4;
+        static const size_t buckets = 156;
+
+        Histogram();
+
+        void record(double seconds);
+
+        // upper bound in seconds of the values counted in a bucket
+        static double upperBound(size_t bucket);
+
+        uint64_t count() const { return _count.load(); }
+        // sum and maximum in seconds
+        double sum() const { return _sumMicros.load() / 1e6; }
+        double max() const { return _maxMicros.load() / 1e6; }
+        uint64_t bucket(size_t index) const { return _buckets[index].load(); }
+
+    private:
+        std::atomic<uint64_t> _buckets[buckets];
+        std::atomic<uint64_t> _count;
+        std::atomic<uint64_t> _sumMicros;
+        std::atomic<uint64_t> _maxMicros;
+    };
+
+    // measures the time from construction to destruction into a histogram
+    class Timer
+    {
+    public:
+        explicit Timer(Histogram& histogram) : _histogram(histogram), _start(std::chrono::steady_clock::now()) {}
+        ~Timer() { _histogram.record(std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count()); }
+
+    private:
+        Histogram& _histogram;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    static Counter& counter(const std::string& name, const Labels& labels = Labels());
+    static Gauge& gauge(const std::string& name, const Labels& labels = Labels());
+    static Histogram& histogram(const std::string& name, const Labels& labels = Labels());
+
+    // all series as {counters, gauges, histograms}, each an array of {name, labels, ...}. Histograms
+    // carry count, sum, max, p50/p90/p99 and the cumulative counts of the non-empty buckets as
+    // [upper bound in seconds, count] pairs, ready for the Prometheus text format
+    static nlohmann::json snapshot();
+
+    // records the duration of every encode and decode call of the DCMTK codecs, per transfer syntax
+    static void enableCodecTiming();
+
+    // records the time the C-GET/C-MOVE sub-operations, read-ahead files and background compressions
+    // of the SCPs wait for a slot of the priority scheduler and hold it, per priority class and stage
+    static void enableSchedulerTiming();
+};
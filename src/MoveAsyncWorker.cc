@@ -7,6 +7,8 @@
 
 #include "json.h"
 #include "Utils.h"
+#include "AssociationPool.h"
+#include "TlsTransport.h"
 
 using json = nlohmann::json;
 
@@ -18,6 +20,7 @@ using json = nlohmann::json;
 
 #include "dcmtk/ofstd/ofstd.h"
 #include "dcmtk/ofstd/ofconapp.h"
+#include "dcmtk/ofstd/oftimer.h"
 #include "dcmtk/dcmnet/scu.h"
 #include "dcmtk/dcmnet/dicom.h"
 #include "dcmtk/dcmnet/dimse.h"
@@ -136,7 +139,7 @@ MoveAsyncWorker::MoveAsyncWorker(std::string data, Function &callback) : BaseAsy
 
 void MoveAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-    ns::sInput in = ns::parseInputJson(_input);
+    ns::sInput in = GetInput();
 
     EnableVerboseLogging(in.verbose);
 
@@ -179,14 +182,66 @@ void MoveAsyncWorker::Execute(const ExecutionProgress &progress)
         overrideKeys.push_back(key);
     }
 
+    // pending responses are sent as progress, the counters of the final response are the result
+    OFTimer timer;
+    json result = json::object();
+    auto onResponse = [&](const RetrieveResponse &response) {
+        json v = ns::moveProgress(response.m_numberOfRemainingSubops, response.m_numberOfCompletedSubops,
+            response.m_numberOfFailedSubops, response.m_numberOfWarningSubops, timer.getDiff());
+        if (DICOM_PENDING_STATUS(response.m_status))
+        {
+            SendResponse(ns::createResponse(ns::PENDING, "MOVE_PROGRESS", v), progress);
+        }
+        else
+        {
+            result = std::move(v);
+        }
+    };
+
+    if (in.reuseAssociation)
+    {
+        // run the move on a pooled association, the handshake is skipped for repeated requests
+        AssociationPool::configure(in.associationIdleTimeout);
+        OFCondition cond = AssociationPool::run(in.source, in.target, in.network, [&](CancellableSCU &scu) -> OFCondition {
+            scu.setCancelFlag(CancelFlag());
+            scu.setPriority(ns::dimsePriority(in.priority));
+            scu.setMoveResponseHandler(onResponse);
+            T_ASC_PresentationContextID pcid = scu.findPresentationContextID(UID_MOVEStudyRootQueryRetrieveInformationModel, "");
+            if (pcid == 0)
+            {
+                return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
+            }
+            DcmDataset dset;
+            applyOverrideKeys(&dset, overrideKeys);
+            OFList<RetrieveResponse *> responses;
+            OFCondition status = scu.sendMOVERequest(pcid, in.destination.c_str(), &dset, &responses);
+            for (RetrieveResponse *response : responses)
+            {
+                delete response;
+            }
+            return status;
+        }, AssociationPool::QUERY_RETRIEVE, AssociationPool::NO_RETRY);
+        if (cond.bad())
+        {
+            SetErrorJson("sending move request failed");
+            return;
+        }
+        _jsonOutput = NativeResult() ? result : json(result.dump());
+        return;
+    }
+
     // setup SCU
     OFList<OFString> syntaxes;
     prepareTS(EXS_Unknown, syntaxes);
-    DcmSCU scu;
-    scu.setMaxReceivePDULength(ASC_DEFAULTMAXPDU);
-    scu.setACSETimeout(60);
-    scu.setDIMSEBlockingMode(DIMSE_BLOCKING);
-    scu.setDIMSETimeout(60);
+    CancellableSCU scu;
+    scu.setMaxReceivePDULength(in.network.maxReceivePDU());
+    scu.setTCPSocketOptions(in.network.socketBufferSize, in.network.tcpNoDelay);
+    scu.setACSETimeout(OFstatic_cast(Uint32, in.network.acseTimeoutSeconds()));
+    scu.setDIMSEBlockingMode(in.network.dimseBlockMode());
+    scu.setDIMSETimeout(OFstatic_cast(Uint32, in.network.dimseTimeoutSeconds()));
+    scu.setCancelFlag(CancelFlag());
+    scu.setPriority(ns::dimsePriority(in.priority));
+    scu.setMoveResponseHandler(onResponse);
     scu.setAETitle(in.source.aet.c_str());
     scu.setPeerHostName(in.target.ip.c_str());
     scu.setPeerPort(in.target.port);
@@ -195,7 +250,13 @@ void MoveAsyncWorker::Execute(const ExecutionProgress &progress)
     scu.addPresentationContext(UID_MOVEStudyRootQueryRetrieveInformationModel, syntaxes);
 
     /* initialize network and negotiate association */
-    OFCondition cond = scu.initNetwork();
+    OFCondition cond = TlsTransport::secure(scu, in.network);
+    if (cond.bad())
+    {
+        SetErrorJson(cond.text());
+        return;
+    }
+    cond = scu.initNetwork();
     if (cond.bad())
     {
         SetErrorJson("network initialization failed");
@@ -264,4 +325,5 @@ void MoveAsyncWorker::Execute(const ExecutionProgress &progress)
             return;
         }
     }
+    _jsonOutput = NativeResult() ? result : json(result.dump());
 }
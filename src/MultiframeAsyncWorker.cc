@@ -0,0 +1,116 @@
+#include "MultiframeAsyncWorker.h"
+
+#include <chrono>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "MultiframeConverter.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+
+MultiframeAsyncWorker::MultiframeAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void MultiframeAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.storagePath.empty()) {
+        SetErrorJson("No storage path set");
+        return;
+    }
+    std::vector<std::string> files(in.sourcePaths);
+    if (!in.sourcePath.empty()) {
+        files.push_back(in.sourcePath);
+    }
+    if (files.empty()) {
+        SetErrorJson("No source paths set");
+        return;
+    }
+    const bool merge = in.format == "enhanced";
+    if (!merge && !in.format.empty() && in.format != "classic") {
+        SetErrorJson("Unknown format " + in.format);
+        return;
+    }
+    if (!OFStandard::dirExists(in.storagePath.c_str()) && OFStandard::createDirectory(in.storagePath.c_str(), "").bad()) {
+        SetErrorJson("Cannot create storage path " + in.storagePath);
+        return;
+    }
+
+    // each instance is written as <storagePath>/<SOPInstanceUID>.dcm, progress at most once a second
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    size_t converted = 0;
+    json instances = json::array();
+    const MultiframeConverter::InstanceFunction write = [&](DcmFileFormat& file, E_TransferSyntax xfer) {
+        OFString sopInstanceUID;
+        OFString filename;
+        file.getDataset()->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
+        OFStandard::combineDirAndFilename(filename, in.storagePath.c_str(), sopInstanceUID + ".dcm", OFTrue);
+        if (file.saveFile(filename.c_str(), xfer).bad()) {
+            DCMNET_ERROR("cannot write " << filename);
+            return false;
+        }
+        json v = json::object();
+        v["SOPInstanceUID"] = sopInstanceUID.c_str();
+        v["Filepath"] = filename.c_str();
+        instances.push_back(v);
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            json p = json::object();
+            p["files"] = converted;
+            p["instances"] = instances.size();
+            p["elapsed"] = std::chrono::duration<double>(now - start).count();
+            SendResponse(ns::createResponse(ns::PENDING, "CONVERT_PROGRESS", p), progress);
+        }
+        return !Cancelled();
+    };
+
+    std::string error;
+    json skipped = json::array();
+    if (merge) {
+        if (!MultiframeConverter::merge(files, write, error) && !Cancelled()) {
+            SetErrorJson("Cannot merge the images: " + error);
+            return;
+        }
+        converted = files.size();
+    }
+    else {
+        for (const std::string& file : files) {
+            if (Cancelled()) {
+                break;
+            }
+            // files that are no enhanced images are left alone
+            if (!MultiframeConverter::split(file, write, error) && !Cancelled()) {
+                DCMNET_WARN("not splitting " << file << ": " << error);
+                json v = json::object();
+                v["Filepath"] = file;
+                v["reason"] = error;
+                skipped.push_back(v);
+            }
+            ++converted;
+        }
+    }
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DCMNET_INFO("converted " << converted << " files into " << instances.size() << " instances in " << elapsed << " s");
+
+    json v = json::object();
+    v["instances"] = instances;
+    v["skipped"] = skipped;
+    v["elapsed"] = elapsed;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
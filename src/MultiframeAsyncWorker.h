@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// splits enhanced multi-frame CT, MR and PET images into classic single frame images or merges the
+// classic images of a series into one Legacy Converted Enhanced image, written below storagePath
+class MultiframeAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        MultiframeAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
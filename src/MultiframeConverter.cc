@@ -0,0 +1,587 @@
+#include "MultiframeConverter.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "FrameIndex.h"
+
+#include "dcmtk/dcmdata/dccodec.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcistrma.h"
+#include "dcmtk/dcmdata/dcistrmf.h"
+#include "dcmtk/dcmdata/dcmetinf.h"
+#include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmdata/dcpixseq.h"
+#include "dcmtk/dcmdata/dcpxitem.h"
+#include "dcmtk/dcmdata/dcsequen.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/ofstd/offile.h"
+
+namespace
+{
+
+// bytes of a file, zeros without path
+struct sRange {
+    std::string path;
+    offile_off_t offset;
+    offile_off_t length;
+};
+
+// reads ranges of files back to back, the value of native pixel data whose frames are in several files
+class RangeProducer : public DcmProducer
+{
+public:
+    RangeProducer(const std::vector<sRange>& ranges, offile_off_t start) : m_ranges(ranges), m_position(0), m_open(ranges.size())
+    {
+        m_starts.push_back(0);
+        for (const sRange& range : ranges) {
+            m_starts.push_back(m_starts.back() + range.length);
+        }
+        m_position = std::min(start, m_starts.back());
+    }
+
+    OFBool good() const { return m_status.good(); }
+
+    OFCondition status() const { return m_status; }
+
+    OFBool eos() { return m_position >= m_starts.back(); }
+
+    offile_off_t avail() { return m_status.good() ? m_starts.back() - m_position : 0; }
+
+    offile_off_t read(void* buf, offile_off_t buflen)
+    {
+        Uint8* out = static_cast<Uint8*>(buf);
+        offile_off_t done = 0;
+        buflen = std::min(buflen, avail());
+        size_t i = static_cast<size_t>(std::upper_bound(m_starts.begin(), m_starts.end(), m_position) - m_starts.begin()) - 1;
+        while (done < buflen) {
+            const sRange& range = m_ranges[i];
+            const offile_off_t skip = m_position - m_starts[i];
+            const offile_off_t count = std::min(range.length - skip, buflen - done);
+            if (range.path.empty()) {
+                memset(out + done, 0, static_cast<size_t>(count));
+            }
+            else {
+                if (m_open != i && !(m_file.fclose(), m_file.fopen(range.path.c_str(), "rb"))) {
+                    m_status = EC_InvalidFilename;
+                    break;
+                }
+                m_open = i;
+                if (m_file.fseek(range.offset + skip, SEEK_SET) != 0 || m_file.fread(out + done, 1, static_cast<size_t>(count)) != static_cast<size_t>(count)) {
+                    m_status = EC_InvalidStream;
+                    break;
+                }
+            }
+            done += count;
+            m_position += count;
+            ++i;
+        }
+        return done;
+    }
+
+    offile_off_t skip(offile_off_t skiplen)
+    {
+        const offile_off_t count = std::min(skiplen, avail());
+        m_position += count;
+        return count;
+    }
+
+    void putback(offile_off_t num) { m_position -= std::min(num, m_position); }
+
+private:
+    const std::vector<sRange>& m_ranges;
+    // offset of each range in the value and the value length
+    std::vector<offile_off_t> m_starts;
+    offile_off_t m_position;
+    OFCondition m_status;
+    OFFile m_file;
+    // index of the range m_file has open
+    size_t m_open;
+};
+
+class RangeStreamFactory : public DcmInputStreamFactory
+{
+public:
+    RangeStreamFactory(const std::vector<sRange>& ranges, offile_off_t start) : m_ranges(ranges), m_start(start) {}
+
+    DcmInputStream* create() const;
+
+    DcmInputStreamFactory* clone() const { return new RangeStreamFactory(*this); }
+
+    DcmInputStreamFactoryType ident() const { return DFT_DcmInputFileStreamFactory; }
+
+private:
+    std::vector<sRange> m_ranges;
+    offile_off_t m_start;
+};
+
+class RangeInputStream : public DcmInputStream
+{
+public:
+    RangeInputStream(const std::vector<sRange>& ranges, offile_off_t start)
+        : DcmInputStream(&m_producer), m_ranges(ranges), m_start(start), m_producer(m_ranges, start) {}
+
+    DcmInputStreamFactory* newFactory() const { return new RangeStreamFactory(m_ranges, m_start + tell()); }
+
+private:
+    std::vector<sRange> m_ranges;
+    offile_off_t m_start;
+    RangeProducer m_producer;
+};
+
+DcmInputStream* RangeStreamFactory::create() const
+{
+    return new RangeInputStream(m_ranges, m_start);
+}
+
+// pixel data read from frames, the ranges of each frame, when it is written. Encapsulated pixel data
+// gets an item per range and the basic offset table, native pixel data a value of all ranges
+DcmPixelData* pixelData(DcmItem& dataset, const std::vector<std::vector<sRange>>& frames, E_TransferSyntax xfer, OFCondition& status)
+{
+    const DcmXfer transfer(xfer);
+    DcmPixelData* pixelData = new DcmPixelData(DCM_PixelData);
+    if (transfer.isEncapsulated()) {
+        DcmPixelSequence* sequence = new DcmPixelSequence(DcmTag(DCM_PixelData, EVR_OB));
+        sequence->insert(new DcmPixelItem(DcmTag(DCM_Item, EVR_OB)));
+        OFList<Uint32> frameSizes;
+        for (const std::vector<sRange>& frame : frames) {
+            Uint32 size = 0;
+            for (const sRange& range : frame) {
+                DcmPixelItem* item = new DcmPixelItem(DcmTag(DCM_Item, EVR_OB));
+                sequence->insert(item);
+                const Uint32 length = static_cast<Uint32>(range.length);
+                status = item->createValueFromTempFile(new DcmInputFileStreamFactory(range.path.c_str(), range.offset), length, EBO_LittleEndian);
+                if (status.bad()) {
+                    delete sequence;
+                    delete pixelData;
+                    return NULL;
+                }
+                size += length + 8;
+            }
+            frameSizes.push_back(size);
+        }
+        pixelData->putOriginalRepresentation(xfer, NULL, sequence);
+        dataset.insert(pixelData, OFTrue);
+        if (frames.size() > 1 && DcmCodec::createOffsetTables(&dataset, sequence, frameSizes, OFTrue).bad()) {
+            DCMNET_DEBUG("no offset table for the merged frames");
+        }
+        return pixelData;
+    }
+
+    Uint16 bitsAllocated = 0;
+    dataset.findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+    pixelData->setVR(bitsAllocated > 8 ? EVR_OW : EVR_OB);
+    std::vector<sRange> ranges;
+    offile_off_t length = 0;
+    for (const std::vector<sRange>& frame : frames) {
+        for (const sRange& range : frame) {
+            ranges.push_back(range);
+            length += range.length;
+        }
+    }
+    // values have an even length
+    if (length % 2 != 0) {
+        sRange padding = { std::string(), 0, 1 };
+        ranges.push_back(padding);
+        ++length;
+    }
+    status = length > 0xFFFFFFFE ? EC_ElemLengthExceeds32BitField
+        : pixelData->createValueFromTempFile(new RangeStreamFactory(ranges, 0), static_cast<Uint32>(length), transfer.getByteOrder());
+    if (status.bad()) {
+        delete pixelData;
+        return NULL;
+    }
+    dataset.insert(pixelData, OFTrue);
+    return pixelData;
+}
+
+// the fragments of a frame as ranges of its file
+std::vector<sRange> frameRanges(const std::string& path, const FrameIndex& index, size_t frame)
+{
+    std::vector<sRange> ranges;
+    for (const FrameIndex::Fragment& fragment : index.fragments(frame)) {
+        sRange range = { path, fragment.offset, static_cast<offile_off_t>(fragment.length) };
+        ranges.push_back(range);
+    }
+    return ranges;
+}
+
+// attributes of functional group macros whose classic counterparts have another name
+DcmTagKey classicTag(const DcmTagKey& tag)
+{
+    if (tag == DCM_FrameType) return DCM_ImageType;
+    if (tag == DCM_FrameAcquisitionNumber) return DCM_AcquisitionNumber;
+    if (tag == DCM_FrameAcquisitionDateTime) return DCM_AcquisitionDateTime;
+    if (tag == DCM_EffectiveEchoTime) return DCM_EchoTime;
+    return tag;
+}
+
+// copies the attributes of the functional group macros in groups, the item of the shared or of the
+// per-frame functional groups of a frame, into dataset
+void flatten(DcmItem& groups, DcmItem& dataset)
+{
+    for (unsigned long g = 0; g < groups.card(); ++g) {
+        DcmElement* group = groups.getElement(g);
+        DcmItem* macro = group->ident() == EVR_SQ ? static_cast<DcmSequenceOfItems*>(group)->getItem(0) : NULL;
+        if (macro == NULL || group->getTag() == DCM_ConversionSourceAttributesSequence) {
+            continue;
+        }
+        // the frame content describes the position of the frame in the dimensions, only its
+        // acquisition is kept
+        const bool frameContent = group->getTag() == DCM_FrameContentSequence;
+        for (unsigned long e = 0; e < macro->card(); ++e) {
+            DcmElement* element = macro->getElement(e);
+            const DcmTagKey tag = classicTag(element->getTag());
+            OFString value;
+            if (tag != element->getTag()) {
+                if (element->getOFStringArray(value).good() && !value.empty()) {
+                    dataset.putAndInsertOFStringArray(tag, value);
+                }
+            }
+            else if (!frameContent) {
+                dataset.insert(OFstatic_cast(DcmElement*, element->clone()), OFTrue);
+            }
+        }
+    }
+}
+
+// attributes of enhanced images that classic images do not have
+const DcmTagKey enhancedOnly[] = {
+    DCM_NumberOfFrames, DCM_SharedFunctionalGroupsSequence, DCM_PerFrameFunctionalGroupsSequence,
+    DCM_DimensionOrganizationSequence, DCM_DimensionIndexSequence, DCM_DimensionOrganizationType,
+    DCM_ConcatenationUID, DCM_ConcatenationFrameOffsetNumber, DCM_InConcatenationNumber, DCM_InConcatenationTotalNumber,
+    DCM_SOPInstanceUIDOfConcatenationSource, DCM_RepresentativeFrameNumber, DCM_ExtendedOffsetTable,
+    DCM_ExtendedOffsetTableLengths, DCM_PixelPresentation, DCM_VolumetricProperties,
+    DCM_VolumeBasedCalculationTechnique, DCM_ComplexImageComponent, DCM_AcquisitionContrast
+};
+
+// a functional group macro of merged images and the attributes it takes from them
+struct sMacro {
+    DcmTagKey sequence;
+    DcmTagKey tags[3];
+    size_t count;
+    // kept per frame even if all images agree
+    bool perFrame;
+};
+
+const sMacro macros[] = {
+    { DCM_PixelMeasuresSequence, { DCM_PixelSpacing, DCM_SliceThickness }, 2, false },
+    { DCM_PlaneOrientationSequence, { DCM_ImageOrientationPatient }, 1, false },
+    { DCM_PlanePositionSequence, { DCM_ImagePositionPatient }, 1, true },
+    { DCM_PixelValueTransformationSequence, { DCM_RescaleIntercept, DCM_RescaleSlope, DCM_RescaleType }, 3, false },
+    { DCM_FrameVOILUTSequence, { DCM_WindowCenter, DCM_WindowWidth, DCM_WindowCenterWidthExplanation }, 3, false },
+};
+
+const size_t macroCount = sizeof(macros) / sizeof(macros[0]);
+
+// attributes that all merged images must agree on
+const DcmTagKey pixelFormat[] = {
+    DCM_SOPClassUID, DCM_Rows, DCM_Columns, DCM_SamplesPerPixel, DCM_PhotometricInterpretation, DCM_BitsAllocated,
+    DCM_BitsStored, DCM_HighBit, DCM_PixelRepresentation, DCM_PlanarConfiguration, DCM_SeriesInstanceUID
+};
+
+// what a merged image keeps of its header
+struct sImage {
+    std::string path;
+    std::shared_ptr<const FrameIndex> index;
+    E_TransferSyntax xfer;
+    OFString sopClassUID;
+    OFString sopInstanceUID;
+    OFString acquisitionNumber;
+    OFString acquisitionDateTime;
+    // values of the attributes of each macro
+    std::vector<OFString> values[macroCount];
+    double position;
+    Sint32 instanceNumber;
+};
+
+}
+
+const char* MultiframeConverter::classicSOPClass(const std::string& sopClass)
+{
+    if (sopClass == UID_EnhancedCTImageStorage || sopClass == UID_LegacyConvertedEnhancedCTImageStorage) {
+        return UID_CTImageStorage;
+    }
+    if (sopClass == UID_EnhancedMRImageStorage || sopClass == UID_LegacyConvertedEnhancedMRImageStorage) {
+        return UID_MRImageStorage;
+    }
+    if (sopClass == UID_EnhancedPETImageStorage || sopClass == UID_LegacyConvertedEnhancedPETImageStorage) {
+        return UID_PositronEmissionTomographyImageStorage;
+    }
+    return NULL;
+}
+
+const char* MultiframeConverter::enhancedSOPClass(const std::string& sopClass)
+{
+    if (sopClass == UID_CTImageStorage) {
+        return UID_LegacyConvertedEnhancedCTImageStorage;
+    }
+    if (sopClass == UID_MRImageStorage) {
+        return UID_LegacyConvertedEnhancedMRImageStorage;
+    }
+    if (sopClass == UID_PositronEmissionTomographyImageStorage) {
+        return UID_LegacyConvertedEnhancedPETImageStorage;
+    }
+    return NULL;
+}
+
+bool MultiframeConverter::split(const std::string& file, const InstanceFunction& converted, std::string& error)
+{
+    std::shared_ptr<const FrameIndex> index = FrameIndex::get(file, error);
+    if (!index) {
+        return false;
+    }
+    DcmFileFormat source;
+    OFCondition status = source.loadFileUntilTag(OFFilename(file.c_str()), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+    if (status.bad()) {
+        error = status.text();
+        return false;
+    }
+    DcmDataset* base = source.getDataset();
+    OFString sopClassUID;
+    OFString sopInstanceUID;
+    base->findAndGetOFString(DCM_SOPClassUID, sopClassUID);
+    base->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
+    const char* classic = classicSOPClass(sopClassUID.c_str());
+    if (classic == NULL) {
+        error = "not an enhanced CT, MR or PET image";
+        return false;
+    }
+
+    // the functional groups are taken out of the header copied for each frame
+    std::unique_ptr<DcmElement> shared(base->remove(DCM_SharedFunctionalGroupsSequence));
+    std::unique_ptr<DcmElement> perFrame(base->remove(DCM_PerFrameFunctionalGroupsSequence));
+    DcmSequenceOfItems* perFrameItems = perFrame && perFrame->ident() == EVR_SQ ? static_cast<DcmSequenceOfItems*>(perFrame.get()) : NULL;
+    if (perFrameItems != NULL && perFrameItems->card() != index->frames()) {
+        error = "the per-frame functional groups do not match the frames";
+        return false;
+    }
+    DcmItem* sharedItem = shared && shared->ident() == EVR_SQ ? static_cast<DcmSequenceOfItems*>(shared.get())->getItem(0) : NULL;
+    Uint32 frameOffset = 0;
+    base->findAndGetUint32(DCM_ConcatenationFrameOffsetNumber, frameOffset);
+    for (const DcmTagKey& tag : enhancedOnly) {
+        base->findAndDeleteElement(tag);
+    }
+
+    char uid[100];
+    for (size_t frame = 0; frame < index->frames(); ++frame) {
+        DcmFileFormat instance(base, OFTrue);
+        DcmDataset* dataset = instance.getDataset();
+        if (sharedItem != NULL) {
+            flatten(*sharedItem, *dataset);
+        }
+        if (perFrameItems != NULL) {
+            flatten(*perFrameItems->getItem(static_cast<unsigned long>(frame)), *dataset);
+        }
+        dataset->putAndInsertString(DCM_SOPClassUID, classic);
+        dataset->putAndInsertString(DCM_SOPInstanceUID, dcmGenerateUniqueIdentifier(uid, SITE_INSTANCE_UID_ROOT));
+        char number[32];
+        snprintf(number, sizeof(number), "%lu", static_cast<unsigned long>(frameOffset + frame + 1));
+        dataset->putAndInsertString(DCM_InstanceNumber, number);
+        // each image refers to the frame it was made of
+        dataset->findAndDeleteElement(DCM_SourceImageSequence);
+        DcmItem* reference = NULL;
+        if (dataset->findOrCreateSequenceItem(DCM_SourceImageSequence, reference).good()) {
+            reference->putAndInsertString(DCM_ReferencedSOPClassUID, sopClassUID.c_str());
+            reference->putAndInsertString(DCM_ReferencedSOPInstanceUID, sopInstanceUID.c_str());
+            snprintf(number, sizeof(number), "%lu", static_cast<unsigned long>(frame + 1));
+            reference->putAndInsertString(DCM_ReferencedFrameNumber, number);
+        }
+        if (pixelData(*dataset, std::vector<std::vector<sRange>>(1, frameRanges(file, *index, frame)), index->transferSyntax(), status) == NULL) {
+            error = status.text();
+            return false;
+        }
+        if (!converted(instance, index->transferSyntax())) {
+            error = "cancelled";
+            return false;
+        }
+    }
+    DCMNET_DEBUG("split " << index->frames() << " frames of " << file);
+    return true;
+}
+
+bool MultiframeConverter::merge(const std::vector<std::string>& files, const InstanceFunction& converted, std::string& error)
+{
+    if (files.empty()) {
+        error = "no images";
+        return false;
+    }
+    // the headers are only read for what the merged image takes from them
+    std::vector<sImage> images(files.size());
+    bool positioned = true;
+    OFString first[sizeof(pixelFormat) / sizeof(pixelFormat[0])];
+    for (size_t i = 0; i < files.size(); ++i) {
+        sImage& image = images[i];
+        image.path = files[i];
+        image.index = FrameIndex::get(files[i], error);
+        if (!image.index) {
+            error = files[i] + ": " + error;
+            return false;
+        }
+        if (image.index->frames() != 1) {
+            error = files[i] + ": not a single frame image";
+            return false;
+        }
+        image.xfer = image.index->transferSyntax();
+        DcmFileFormat source;
+        OFCondition status = source.loadFileUntilTag(OFFilename(files[i].c_str()), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+        if (status.bad()) {
+            error = files[i] + ": " + status.text();
+            return false;
+        }
+        DcmDataset* dataset = source.getDataset();
+        for (size_t t = 0; t < sizeof(pixelFormat) / sizeof(pixelFormat[0]); ++t) {
+            OFString value;
+            dataset->findAndGetOFStringArray(pixelFormat[t], value);
+            if (i == 0) {
+                first[t] = value;
+            }
+            else if (value != first[t]) {
+                error = files[i] + ": " + DcmTag(pixelFormat[t]).getTagName() + " differs from the other images";
+                return false;
+            }
+        }
+        if (image.xfer != images[0].xfer) {
+            error = files[i] + ": the transfer syntax differs from the other images";
+            return false;
+        }
+        dataset->findAndGetOFString(DCM_SOPClassUID, image.sopClassUID);
+        dataset->findAndGetOFString(DCM_SOPInstanceUID, image.sopInstanceUID);
+        dataset->findAndGetOFString(DCM_AcquisitionNumber, image.acquisitionNumber);
+        if (dataset->findAndGetOFString(DCM_AcquisitionDateTime, image.acquisitionDateTime).bad() || image.acquisitionDateTime.empty()) {
+            OFString date;
+            OFString time;
+            if (dataset->findAndGetOFString(DCM_AcquisitionDate, date).good() && !date.empty()) {
+                dataset->findAndGetOFString(DCM_AcquisitionTime, time);
+                image.acquisitionDateTime = date + time;
+            }
+        }
+        for (size_t m = 0; m < macroCount; ++m) {
+            image.values[m].resize(macros[m].count);
+            for (size_t t = 0; t < macros[m].count; ++t) {
+                dataset->findAndGetOFStringArray(macros[m].tags[t], image.values[m][t]);
+            }
+        }
+        image.instanceNumber = 0;
+        dataset->findAndGetSint32(DCM_InstanceNumber, image.instanceNumber);
+        // the distance of the plane from the origin along its normal
+        Float64 orientation[6];
+        Float64 position[3];
+        bool planar = true;
+        for (unsigned long k = 0; k < 6 && planar; ++k) {
+            planar = dataset->findAndGetFloat64(DCM_ImageOrientationPatient, orientation[k], k).good()
+                && (k >= 3 || dataset->findAndGetFloat64(DCM_ImagePositionPatient, position[k], k).good());
+        }
+        image.position = planar
+            ? (orientation[1] * orientation[5] - orientation[2] * orientation[4]) * position[0]
+                + (orientation[2] * orientation[3] - orientation[0] * orientation[5]) * position[1]
+                + (orientation[0] * orientation[4] - orientation[1] * orientation[3]) * position[2]
+            : 0;
+        positioned = positioned && planar;
+    }
+    const char* enhanced = enhancedSOPClass(images[0].sopClassUID.c_str());
+    if (enhanced == NULL) {
+        error = "not a classic CT, MR or PET image";
+        return false;
+    }
+    // along the normal if all images are positioned, else by InstanceNumber
+    std::stable_sort(images.begin(), images.end(), [positioned](const sImage& a, const sImage& b) {
+        return positioned && a.position != b.position ? a.position < b.position : a.instanceNumber < b.instanceNumber;
+    });
+
+    DcmFileFormat merged;
+    OFCondition status = merged.loadFileUntilTag(OFFilename(images[0].path.c_str()), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData);
+    if (status.bad()) {
+        error = status.text();
+        return false;
+    }
+    // the meta header is made anew for the merged instance
+    merged.getMetaInfo()->clear();
+    DcmDataset* dataset = merged.getDataset();
+    for (const sMacro& macro : macros) {
+        for (size_t t = 0; t < macro.count; ++t) {
+            dataset->findAndDeleteElement(macro.tags[t]);
+        }
+    }
+    dataset->findAndDeleteElement(DCM_SliceLocation);
+    dataset->findAndDeleteElement(DCM_ExtendedOffsetTable);
+    dataset->findAndDeleteElement(DCM_ExtendedOffsetTableLengths);
+    char uid[100];
+    dataset->putAndInsertString(DCM_SOPClassUID, enhanced);
+    dataset->putAndInsertString(DCM_SOPInstanceUID, dcmGenerateUniqueIdentifier(uid, SITE_INSTANCE_UID_ROOT));
+    dataset->putAndInsertString(DCM_InstanceNumber, "1");
+    char frames[32];
+    snprintf(frames, sizeof(frames), "%lu", static_cast<unsigned long>(images.size()));
+    dataset->putAndInsertString(DCM_NumberOfFrames, frames);
+
+    // a macro is shared if all images agree on it
+    const bool ct = images[0].sopClassUID == UID_CTImageStorage;
+    DcmItem* shared = NULL;
+    dataset->findOrCreateSequenceItem(DCM_SharedFunctionalGroupsSequence, shared);
+    DcmSequenceOfItems* perFrame = new DcmSequenceOfItems(DCM_PerFrameFunctionalGroupsSequence);
+    dataset->insert(perFrame, OFTrue);
+    for (size_t i = 0; i < images.size(); ++i) {
+        perFrame->append(new DcmItem());
+    }
+    for (size_t m = 0; m < macroCount; ++m) {
+        const sMacro& macro = macros[m];
+        bool same = !macro.perFrame;
+        bool present = false;
+        for (const sImage& image : images) {
+            same = same && image.values[m] == images[0].values[m];
+            for (const OFString& value : image.values[m]) {
+                present = present || !value.empty();
+            }
+        }
+        if (!present) {
+            continue;
+        }
+        for (size_t i = 0; i < (same ? 1 : images.size()); ++i) {
+            DcmItem* groups = same ? shared : perFrame->getItem(static_cast<unsigned long>(i));
+            DcmItem* item = NULL;
+            if (groups == NULL || groups->findOrCreateSequenceItem(macro.sequence, item).bad()) {
+                continue;
+            }
+            for (size_t t = 0; t < macro.count; ++t) {
+                if (!images[i].values[m][t].empty()) {
+                    item->putAndInsertOFStringArray(macro.tags[t], images[i].values[m][t]);
+                }
+            }
+            if (macro.sequence == DCM_PixelValueTransformationSequence && !item->tagExistsWithValue(DCM_RescaleType)) {
+                item->putAndInsertString(DCM_RescaleType, ct ? "HU" : "US");
+            }
+        }
+    }
+    // the acquisition and the source of each frame
+    std::vector<std::vector<sRange>> ranges;
+    for (size_t i = 0; i < images.size(); ++i) {
+        const sImage& image = images[i];
+        DcmItem* groups = perFrame->getItem(static_cast<unsigned long>(i));
+        DcmItem* item = NULL;
+        if (groups->findOrCreateSequenceItem(DCM_FrameContentSequence, item).good()) {
+            if (!image.acquisitionNumber.empty()) {
+                item->putAndInsertOFStringArray(DCM_FrameAcquisitionNumber, image.acquisitionNumber);
+            }
+            if (!image.acquisitionDateTime.empty()) {
+                item->putAndInsertOFStringArray(DCM_FrameAcquisitionDateTime, image.acquisitionDateTime);
+            }
+        }
+        if (groups->findOrCreateSequenceItem(DCM_ConversionSourceAttributesSequence, item).good()) {
+            item->putAndInsertOFStringArray(DCM_ReferencedSOPClassUID, image.sopClassUID);
+            item->putAndInsertOFStringArray(DCM_ReferencedSOPInstanceUID, image.sopInstanceUID);
+        }
+        ranges.push_back(frameRanges(image.path, *image.index, 0));
+    }
+
+    if (pixelData(*dataset, ranges, images[0].xfer, status) == NULL) {
+        error = status.text();
+        return false;
+    }
+    if (!converted(merged, images[0].xfer)) {
+        error = "cancelled";
+        return false;
+    }
+    DCMNET_DEBUG("merged " << images.size() << " images into one of " << enhanced);
+    return true;
+}
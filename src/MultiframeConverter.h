@@ -0,0 +1,41 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+
+// Converts between Enhanced multi-frame CT, MR and PET images and the classic single frame images of
+// these modalities, for nodes that only accept one of them. split() makes an instance of each frame
+// with the attributes of the shared and its per-frame functional groups, as far as the classic image
+// has them, merge() combines the classic images of a series into one Legacy Converted Enhanced image
+// whose functional groups are shared where the images agree. Pixel data is not loaded: the frames are
+// located with the FrameIndex of each file and read from the source files while the converted
+// instances are written, so memory is bounded by the attributes whatever the size of the frames.
+class MultiframeConverter
+{
+public:
+    // called with each converted instance and the transfer syntax of its pixel data, the source files
+    // must not change until it returned. Returns false to stop the conversion
+    typedef std::function<bool(DcmFileFormat& file, E_TransferSyntax xfer)> InstanceFunction;
+
+    // the classic SOP class the frames of sopClass are split into, NULL if it is no enhanced or legacy
+    // converted enhanced CT, MR or PET image
+    static const char* classicSOPClass(const std::string& sopClass);
+
+    // the Legacy Converted Enhanced SOP class classic images of sopClass are merged into, NULL if it is
+    // no CT, MR or PET image
+    static const char* enhancedSOPClass(const std::string& sopClass);
+
+    // splits a multi-frame image into one instance per frame, in the order of the frames. False with
+    // error set if it is no enhanced image or cannot be read
+    static bool split(const std::string& file, const InstanceFunction& converted, std::string& error);
+
+    // merges the classic images of one series into a single instance, the frames sorted along the
+    // normal of the image planes or else by InstanceNumber. False with error set if the images differ
+    // in SOP class, matrix, pixel format or transfer syntax, or cannot be read
+    static bool merge(const std::vector<std::string>& files, const InstanceFunction& converted, std::string& error);
+};
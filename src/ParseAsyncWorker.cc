@@ -4,7 +4,10 @@
 #include <list>
 #include <memory>
 #include <sstream>
+#include <set>
+#include <vector>
 
+#include "ParseCache.h"
 #include "Utils.h"
 
 #include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
@@ -24,20 +27,164 @@
 #include "dcmtk/dcmnet/diutil.h"
 #include "dcmtk/ofstd/ofconapp.h"
 #include "dcmtk/dcmdata/dcjson.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcstack.h"
+#include "dcmtk/dcmdata/dcarena.h"
 #include "dcmtk/ofstd/ofstream.h"
 
 #ifdef WITH_ZLIB
 #include <zlib.h>
 #endif
 
+namespace
+{
+
+// writes binary values as BulkDataURI "<prefix>GGGGEEEE" instead of inlining them
+template <class Format>
+class BulkDataJsonFormat : public Format
+{
+public:
+    BulkDataJsonFormat(const OFString& prefix, DcmItem* dataset)
+        : Format(OFFalse), m_prefix(prefix)
+    {
+        DcmStack stack;
+        while (dataset->nextObject(stack, OFTrue).good())
+        {
+            DcmObject* object = stack.top();
+            if (isBinary(object->ident()) || object->getTag() == DCM_PixelData)
+            {
+                m_tags.insert(object->getTag());
+            }
+        }
+    }
+
+    virtual OFBool asBulkDataURI(const DcmTagKey& tag, OFString& uri)
+    {
+        if (m_tags.count(tag) == 0)
+        {
+            return OFFalse;
+        }
+        char key[9];
+        sprintf(key, "%04X%04X", tag.getGroup(), tag.getElement());
+        uri = m_prefix + key;
+        return OFTrue;
+    }
+
+private:
+    static bool isBinary(DcmEVR vr)
+    {
+        return vr == EVR_OB || vr == EVR_OW || vr == EVR_OF || vr == EVR_OD || vr == EVR_OL || vr == EVR_OV
+            || vr == EVR_UN || vr == EVR_ox || vr == EVR_pixelSQ;
+    }
+
+    OFString m_prefix;
+    std::set<DcmTagKey> m_tags;
+};
+
+// stream buffer appending to a string in blocks, the serialized JSON ends up
+// in the result string without copying it out of an ostringstream
+class StringAppendBuffer : public std::streambuf
+{
+public:
+    explicit StringAppendBuffer(std::string& target)
+        : m_target(target)
+    {
+        setp(m_buffer, m_buffer + sizeof(m_buffer));
+    }
+
+    ~StringAppendBuffer()
+    {
+        sync();
+    }
+
+protected:
+    virtual int_type overflow(int_type c)
+    {
+        sync();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual std::streamsize xsputn(const char* s, std::streamsize n)
+    {
+        if (n > epptr() - pptr())
+        {
+            sync();
+            if (n >= static_cast<std::streamsize>(sizeof(m_buffer)))
+            {
+                m_target.append(s, static_cast<size_t>(n));
+                return n;
+            }
+        }
+        memcpy(pptr(), s, static_cast<size_t>(n));
+        pbump(static_cast<int>(n));
+        return n;
+    }
+
+    virtual int sync()
+    {
+        m_target.append(pbase(), static_cast<size_t>(pptr() - pbase()));
+        setp(m_buffer, m_buffer + sizeof(m_buffer));
+        return 0;
+    }
+
+private:
+    std::string& m_target;
+    char m_buffer[16384];
+};
+
+// removes the top level attributes that are not listed
+void filterAttributes(DcmDataset* dset, const std::vector<std::string>& includeTags)
+{
+    std::set<DcmTagKey> included;
+    for (const std::string& key : includeTags)
+    {
+        included.insert(ns::toElement(key, std::string()).xtag);
+    }
+    for (unsigned long i = dset->card(); i > 0; --i)
+    {
+        DcmElement* element = dset->getElement(i - 1);
+        if (included.count(element->getTag()) == 0)
+        {
+            delete dset->remove(element);
+        }
+    }
+}
+
+// the dataset as one JSON object
+OFCondition writeJson(DcmDataset* dset, std::ostream& stream, DcmJsonFormat& format)
+{
+    stream << format.indent() << "{" << format.newline();
+    OFCondition status = dset->writeJson(stream, format);
+    stream << format.newline() << format.indent() << "}" << format.newline();
+    return status;
+}
+
+// the options that change the JSON of a file, the free form prefix of BulkDataURIs last
+std::string cacheOptions(const ns::sInput& in)
+{
+    std::string options = in.compact ? "compact|" : "pretty|";
+    options += in.stopAtTag + "|";
+    for (const std::string& key : in.includeTags)
+    {
+        options += key + ",";
+    }
+    return options + "|" + in.bulkDataURI;
+}
+
+} // namespace
+
 ParseAsyncWorker::ParseAsyncWorker(std::string data, Function &callback)
     : BaseAsyncWorker(data, callback) {
-    ns::registerCodecs();
 }
 
 void ParseAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-    ns::sInput in = ns::parseInputJson(_input);
+    ns::sInput in = GetInput();
 
     EnableVerboseLogging(in.verbose);
 
@@ -46,15 +193,80 @@ void ParseAsyncWorker::Execute(const ExecutionProgress &progress)
         return;
     }
 
-    OFFilename ifname(in.sourcePath.c_str());
-    DcmFileFormat dfile;
-    OFCondition status = dfile.loadFile(ifname, EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect);
-    if (status.bad()) {
+    std::string output;
+    OFCondition status = parse(OFFilename(in.sourcePath.c_str()), in, output);
+    if (status == EC_InvalidFilename) {
         SetErrorJson("Invalid source path set, no DICOM files found");
         return;
     }
+    if (status.bad()) {
+        SetErrorJson(std::string("Cannot convert dataset: ") + status.text());
+        return;
+    }
+    _jsonOutput = NativeResult() ? json::parse(output) : json(std::move(output));
+}
+
+OFCondition ParseAsyncWorker::parse(const OFFilename& path, const ns::sInput& in, std::string& output)
+{
+    const char* name = path.getCharPointer();
+    if (name == NULL || !ParseCache::isEnabled()) {
+        return parseFile(path, in, output);
+    }
+    const std::string options = cacheOptions(in);
+    ParseCache::Stamp stamp;
+    ParseCache::Result cached = ParseCache::get(name, options, stamp);
+    if (cached) {
+        output = *cached;
+        return EC_Normal;
+    }
+    OFCondition status = parseFile(path, in, output);
+    if (status.good()) {
+        ParseCache::put(name, options, stamp, std::make_shared<const std::string>(output));
+    }
+    return status;
+}
+
+OFCondition ParseAsyncWorker::parseFile(const OFFilename& path, const ns::sInput& in, std::string& output)
+{
+    // the whole element tree is freed at once when the dataset goes out of scope
+    std::unique_ptr<DcmArenaScope> arena;
+    if (in.arenaAllocation) {
+        arena.reset(new DcmArenaScope());
+    }
+    DcmFileFormat dfile;
+    // values written as BulkDataURI need not be loaded at all
+    const Uint32 maxReadLength = in.bulkDataURI.empty() ? DCM_MaxReadLength : 256;
+    const DcmTagKey stopAtTag = in.stopAtTag.empty() ? DCM_UndefinedTagKey : ns::toElement(in.stopAtTag, std::string()).xtag;
+    OFCondition status = dfile.loadFileUntilTag(path, EXS_Unknown, EGL_noChange, maxReadLength, ERM_autoDetect, stopAtTag);
+    if (status.bad()) {
+        return EC_InvalidFilename;
+    }
     DcmDataset *dset = dfile.getDataset();
-    std::ostringstream stream;
-    dset->writeJson(stream, DcmJsonFormatPretty());
-    _jsonOutput = stream.str();
+    if (!in.includeTags.empty()) {
+        filterAttributes(dset, in.includeTags);
+    }
+    output.clear();
+    StringAppendBuffer buffer(output);
+    std::ostream stream(&buffer);
+    if (!in.bulkDataURI.empty() && in.compact) {
+        BulkDataJsonFormat<DcmJsonFormatCompact> format(in.bulkDataURI.c_str(), dset);
+        status = writeJson(dset, stream, format);
+    }
+    else if (!in.bulkDataURI.empty()) {
+        BulkDataJsonFormat<DcmJsonFormatPretty> format(in.bulkDataURI.c_str(), dset);
+        status = writeJson(dset, stream, format);
+    }
+    else if (in.compact) {
+        DcmJsonFormatCompact format(OFFalse);
+        status = writeJson(dset, stream, format);
+    }
+    else {
+        DcmJsonFormatPretty format(OFFalse);
+        status = writeJson(dset, stream, format);
+    }
+    stream.flush();
+    if (status.bad()) {
+        output.clear();
+    }
+    return status;
 }
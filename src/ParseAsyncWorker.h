@@ -2,6 +2,10 @@
 
 #include "BaseAsyncWorker.h"
 
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofcond.h"
+#include "dcmtk/ofstd/offile.h"
+
 using namespace Napi;
 
 class ParseAsyncWorker : public BaseAsyncWorker
@@ -11,4 +15,13 @@ class ParseAsyncWorker : public BaseAsyncWorker
 
         void Execute(const ExecutionProgress& progress);
 
+        // loads a file as requested by the parse options and converts its dataset to DICOM JSON,
+        // EC_InvalidFilename if it is not a readable DICOM file. Safe to call from several threads.
+        // Answered from the ParseCache while the file is unchanged, if the cache is enabled
+        static OFCondition parse(const OFFilename& path, const ns::sInput& in, std::string& output);
+
+    private:
+        // parse() without the cache
+        static OFCondition parseFile(const OFFilename& path, const ns::sInput& in, std::string& output);
+
 };
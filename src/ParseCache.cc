@@ -0,0 +1,181 @@
+#include "ParseCache.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+
+#include "Metrics.h"
+
+namespace
+{
+
+struct sCacheEntry {
+    ParseCache::Result result;
+    ParseCache::Stamp stamp;
+    size_t bytes;
+    std::list<std::string>::iterator lru;
+};
+
+std::mutex cacheMutex;
+std::map<std::string, sCacheEntry> cache;
+// keys, most recently used first
+std::list<std::string> cacheLru;
+size_t cacheMaxBytes = 0;
+size_t cacheBytes = 0;
+std::atomic<bool> cacheEnabled(false);
+std::atomic<size_t> cacheHits(0);
+std::atomic<size_t> cacheMisses(0);
+
+// size and modification time of a file in ns, false if it cannot be accessed
+bool fileStatus(const std::string& path, ParseCache::Stamp& stamp)
+{
+#ifdef HAVE_WINDOWS_H
+    struct _stati64 st;
+    if (_stati64(path.c_str(), &st) != 0)
+        return false;
+    stamp.mtime = static_cast<long long>(st.st_mtime) * 1000000000LL;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#if defined(__APPLE__)
+    stamp.mtime = static_cast<long long>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+#endif
+    stamp.size = static_cast<long long>(st.st_size);
+    return true;
+}
+
+// path and options, the options cannot contain a line break
+std::string cacheKey(const std::string& path, const std::string& options)
+{
+    return options + "\n" + path;
+}
+
+// removes an entry, cacheMutex is held
+void erase(std::map<std::string, sCacheEntry>::iterator it)
+{
+    cacheBytes -= it->second.bytes;
+    cacheLru.erase(it->second.lru);
+    cache.erase(it);
+}
+
+// drops the least recently used results beyond the limit, cacheMutex is held
+void evict()
+{
+    while (cacheBytes > cacheMaxBytes && !cacheLru.empty()) {
+        erase(cache.find(cacheLru.back()));
+    }
+}
+
+}
+
+ParseCache::Result ParseCache::get(const std::string& path, const std::string& options, Stamp& stamp)
+{
+    static Metrics::Counter& hitCounter = Metrics::counter("parse_cache_requests_total", {{"result", "hit"}});
+    static Metrics::Counter& missCounter = Metrics::counter("parse_cache_requests_total", {{"result", "miss"}});
+
+    stamp = Stamp();
+    if (!cacheEnabled) {
+        return Result();
+    }
+    if (!fileStatus(path, stamp)) {
+        stamp.size = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        std::map<std::string, sCacheEntry>::iterator it = cache.find(cacheKey(path, options));
+        if (it != cache.end()) {
+            if (stamp.size >= 0 && it->second.stamp.size == stamp.size && it->second.stamp.mtime == stamp.mtime) {
+                ++cacheHits;
+                hitCounter.add();
+                cacheLru.splice(cacheLru.begin(), cacheLru, it->second.lru);
+                return it->second.result;
+            }
+            // changed or gone, parsed again
+            erase(it);
+        }
+    }
+    ++cacheMisses;
+    missCounter.add();
+    return Result();
+}
+
+void ParseCache::put(const std::string& path, const std::string& options, const Stamp& stamp, const Result& result)
+{
+    if (!cacheEnabled || !result || stamp.size < 0) {
+        return;
+    }
+    const std::string key = cacheKey(path, options);
+    const size_t bytes = key.size() + result->size();
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (bytes > cacheMaxBytes) {
+        return;
+    }
+    std::map<std::string, sCacheEntry>::iterator it = cache.find(key);
+    if (it == cache.end()) {
+        cacheLru.push_front(key);
+        it = cache.insert(std::make_pair(key, sCacheEntry())).first;
+        it->second.lru = cacheLru.begin();
+    }
+    else {
+        cacheBytes -= it->second.bytes;
+        cacheLru.splice(cacheLru.begin(), cacheLru, it->second.lru);
+    }
+    it->second.result = result;
+    it->second.stamp = stamp;
+    it->second.bytes = bytes;
+    cacheBytes += bytes;
+    evict();
+}
+
+void ParseCache::configure(size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cacheMaxBytes = maxBytes;
+    cacheEnabled = maxBytes > 0;
+    evict();
+}
+
+bool ParseCache::isEnabled()
+{
+    return cacheEnabled;
+}
+
+void ParseCache::clear()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.clear();
+    cacheLru.clear();
+    cacheBytes = 0;
+}
+
+size_t ParseCache::hits()
+{
+    return cacheHits;
+}
+
+size_t ParseCache::misses()
+{
+    return cacheMisses;
+}
+
+size_t ParseCache::entries()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cache.size();
+}
+
+size_t ParseCache::bytes()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cacheBytes;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+// JSON of parsed files kept for later parses of the same files, which services generating thumbnails,
+// metadata or routing decisions request again and again. Entries are keyed by path and a string
+// describing the parse options, and are only returned while the file has the size and modification
+// time it had when it was parsed, a changed file is parsed again. The cache is process wide and
+// disabled by default, least recently used entries are dropped beyond the size limit.
+class ParseCache
+{
+public:
+    // the JSON of a parsed file
+    typedef std::shared_ptr<const std::string> Result;
+
+    // size and modification time (ns) of a file, taken before it is parsed so a change while it is
+    // parsed invalidates the entry
+    struct Stamp {
+        Stamp() : size(-1), mtime(0) {}
+        long long size;
+        long long mtime;
+    };
+
+    // the cached JSON of path parsed with options, NULL if there is none or the file changed since.
+    // stamp is set to the current status of the file, its size is -1 if it cannot be accessed
+    static Result get(const std::string& path, const std::string& options, Stamp& stamp);
+
+    // caches the JSON of path parsed with options while the file is as stamped, unless the cache is
+    // disabled, the file could not be accessed or the JSON alone exceeds the limit
+    static void put(const std::string& path, const std::string& options, const Stamp& stamp, const Result& result);
+
+    // limits the bytes of cached JSON, 0 disables the cache and drops all entries
+    static void configure(size_t maxBytes);
+
+    // true if a limit is set
+    static bool isEnabled();
+
+    // drops all cached results
+    static void clear();
+
+    // number of get() calls answered from the cache and not
+    static size_t hits();
+    static size_t misses();
+
+    // number and bytes of cached results
+    static size_t entries();
+    static size_t bytes();
+};
@@ -0,0 +1,244 @@
+#include "ParseDirectoryAsyncWorker.h"
+#include "ParseAsyncWorker.h"
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "Utils.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offilsys.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmdata/dcdatutl.h"
+
+namespace
+{
+
+// directories still to be listed and files still to be parsed, shared by all threads. Files are
+// taken first so that the backlog of listed but unparsed files stays small
+class ParseWork
+{
+public:
+    ParseWork() : m_busy(0) {}
+
+    void addDirectory(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_directories.push_back(path);
+        m_changed.notify_one();
+    }
+
+    void addFiles(const std::vector<std::string>& paths)
+    {
+        if (paths.empty()) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_files.insert(m_files.end(), paths.begin(), paths.end());
+        m_changed.notify_all();
+    }
+
+    // returns false once there is nothing left and no other thread can add more
+    bool next(std::string& path, bool& directory)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        --m_busy;
+        m_changed.wait(lock, [this] { return !m_files.empty() || !m_directories.empty() || m_busy == 0; });
+        if (!m_files.empty()) {
+            path = m_files.front();
+            m_files.pop_front();
+            directory = false;
+        }
+        else if (!m_directories.empty()) {
+            path = m_directories.back();
+            m_directories.pop_back();
+            directory = true;
+        }
+        else {
+            m_changed.notify_all();
+            return false;
+        }
+        ++m_busy;
+        return true;
+    }
+
+    // every thread counts as busy until it asks for work
+    void start(size_t threads)
+    {
+        m_busy = threads;
+    }
+
+private:
+    std::deque<std::string> m_files;
+    std::deque<std::string> m_directories;
+    size_t m_busy;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+};
+
+// collects parse results and sends them once a chunk is full
+class ParseResults
+{
+public:
+    ParseResults(BaseAsyncWorker* worker, const BaseAsyncWorker::ExecutionProgress& progress, size_t chunkSize)
+        : m_worker(worker), m_progress(progress), m_chunkSize(chunkSize), m_chunk(json::array()), m_files(0), m_failed(0) {}
+
+    void add(const std::string& path, const std::string& dataset)
+    {
+        json v = json::object();
+        v["Filepath"] = path;
+        v["Dataset"] = json::parse(dataset, nullptr, false);
+        json chunk;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_files;
+            m_chunk.push_back(v);
+            if (m_chunk.size() < m_chunkSize) return;
+            chunk.swap(m_chunk);
+            m_chunk = json::array();
+        }
+        send(chunk);
+    }
+
+    void failed(const std::string& path)
+    {
+        DCMNET_DEBUG("not a DICOM file: " << path);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_failed;
+    }
+
+    // sends the last partial chunk, returns the totals
+    json finish()
+    {
+        json chunk;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            chunk.swap(m_chunk);
+            m_chunk = json::array();
+        }
+        if (!chunk.empty()) send(chunk);
+        json v = json::object();
+        v["files"] = m_files;
+        v["failed"] = m_failed;
+        return v;
+    }
+
+    size_t files() const { return m_files; }
+
+private:
+    void send(const json& chunk)
+    {
+        m_worker->SendResponse(ns::createResponse(ns::PENDING, "PARSE_RESULTS", chunk), m_progress);
+    }
+
+    BaseAsyncWorker* m_worker;
+    const BaseAsyncWorker::ExecutionProgress& m_progress;
+    size_t m_chunkSize;
+    json m_chunk;
+    size_t m_files;
+    size_t m_failed;
+    std::mutex m_mutex;
+};
+
+// lists one directory, subdirectories are queued for any thread to list
+void listDirectory(const std::string& path, ParseWork& work)
+{
+    std::vector<std::string> files;
+    for (OFdirectory_iterator it((OFpath(path.c_str()))); it != OFdirectory_iterator(); ++it) {
+        const OFString entry = it->path().native();
+        if (OFStandard::dirExists(entry)) {
+            work.addDirectory(entry.c_str());
+        }
+        else {
+            files.push_back(entry.c_str());
+        }
+    }
+    work.addFiles(files);
+}
+
+}
+
+ParseDirectoryAsyncWorker::ParseDirectoryAsyncWorker(std::string data, Function &callback)
+    : BaseAsyncWorker(data, callback) {
+}
+
+void ParseDirectoryAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    std::vector<std::string> roots = in.sourcePaths;
+    if (!in.sourcePath.empty()) {
+        roots.push_back(in.sourcePath);
+    }
+    if (roots.empty()) {
+        SetErrorJson("No source path set");
+        return;
+    }
+
+    ParseWork work;
+    std::vector<std::string> files;
+    for (const std::string& root : roots) {
+        if (OFStandard::dirExists(root.c_str())) {
+            work.addDirectory(root);
+        }
+        else {
+            files.push_back(root);
+        }
+    }
+    work.addFiles(files);
+
+    // the results are parsed again for the chunks, compact JSON is cheaper to produce and to read
+    in.compact = true;
+    const size_t threads = in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    ParseResults results(this, progress, in.chunkSize > 0 ? static_cast<size_t>(in.chunkSize) : 100);
+    DCMNET_INFO("parsing " << roots.size() << " paths using " << threads << " threads");
+
+    work.start(threads);
+    std::vector<std::thread> workers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t i = 0; i < threads; ++i) {
+        workers.push_back(std::thread([this, &work, &results, &in, logLevel]() {
+            OFLog::setThreadLogLevel(logLevel);
+            std::string path;
+            bool directory = false;
+            while (work.next(path, directory)) {
+                // once cancelled the remaining work is taken and dropped, so that no thread waits for more
+                if (Cancelled()) {
+                    continue;
+                }
+                if (directory) {
+                    listDirectory(path, work);
+                    continue;
+                }
+                std::string dataset;
+                const OFFilename filename(path.c_str());
+                if (DcmDataUtil::isDicomFile(filename) && ParseAsyncWorker::parse(filename, in, dataset).good()) {
+                    results.add(path, dataset);
+                }
+                else {
+                    results.failed(path);
+                }
+            }
+        }));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    json totals = results.finish();
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    if (results.files() == 0) {
+        SetErrorJson("Invalid source path set, no DICOM files found");
+        return;
+    }
+    _jsonOutput = NativeResult() ? totals : json(totals.dump());
+}
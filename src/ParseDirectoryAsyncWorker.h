@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// parses all files below one or more directories on a pool of threads which also walk the
+// directories, results are sent in chunks as they become available
+class ParseDirectoryAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        ParseDirectoryAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,46 @@
+#include "PeerTable.h"
+
+PeerTable::PeerTable() : _current(std::make_shared<Table>()), _published(false)
+{
+}
+
+size_t PeerTable::replace(const std::vector<sPeer>& peers)
+{
+    std::lock_guard<std::mutex> lock(_writer);
+    return publish(peers);
+}
+
+void PeerTable::initialize(const std::vector<sPeer>& peers)
+{
+    std::lock_guard<std::mutex> lock(_writer);
+    if (!_published) {
+        publish(peers);
+    }
+}
+
+size_t PeerTable::publish(const std::vector<sPeer>& peers)
+{
+    std::shared_ptr<Table> table = std::make_shared<Table>();
+    table->reserve(peers.size());
+    for (const sPeer& peer : peers) {
+        table->emplace(peer.aet, peer);
+    }
+    std::atomic_store(&_current, std::shared_ptr<const Table>(table));
+    _published = true;
+    return table->size();
+}
+
+std::shared_ptr<const PeerTable::sPeer> PeerTable::find(const char* aet) const
+{
+    const std::shared_ptr<const Table> table = std::atomic_load(&_current);
+    Table::const_iterator it = table->find(aet != NULL ? aet : "");
+    if (it == table->end()) {
+        return std::shared_ptr<const sPeer>();
+    }
+    return std::shared_ptr<const sPeer>(table, &it->second);
+}
+
+size_t PeerTable::size() const
+{
+    return std::atomic_load(&_current)->size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TransferPolicy.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/dimse.h"
+
+// AE titles known to an SCP, hashed by AE title. A published table is never changed: replace() builds
+// the next one and swaps it in, so the peers can be reconfigured from JS while the SCP runs. Lookups
+// of associations and C-MOVE destinations load the current table atomically and never wait on a writer,
+// a lookup that started before a replace() finishes on the table it found.
+class PeerTable
+{
+public:
+    struct sPeer {
+        std::string aet;
+        std::string hostname;
+        int port;
+        TransferPolicy::eChoice compression;   // overrides the transfer policy for associations with the peer
+        bool fixedPriority;                    // priority applies instead of the one of each C-GET/C-MOVE request
+        T_DIMSE_Priority priority;
+    };
+
+    PeerTable();
+
+    // publishes peers as the new table, of peers with the same AE title the first one counts.
+    // Returns the number of AE titles in the table
+    size_t replace(const std::vector<sPeer>& peers);
+
+    // replace() unless a table was published before, e.g. from JS before the SCP started
+    void initialize(const std::vector<sPeer>& peers);
+
+    // the peer with the AE title, NULL if unknown. Keeps the table it was found in alive
+    std::shared_ptr<const sPeer> find(const char* aet) const;
+
+    size_t size() const;
+
+private:
+    typedef std::unordered_map<std::string, sPeer> Table;
+
+    // builds and swaps in the table, _writer is held
+    size_t publish(const std::vector<sPeer>& peers);
+
+    std::shared_ptr<const Table> _current;
+    // replacements are serialized, readers load _current atomically
+    std::mutex _writer;
+    bool _published;
+};
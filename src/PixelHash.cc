@@ -0,0 +1,103 @@
+#include "PixelHash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#include "dcmtk/ofstd/ofcrc32.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfcache.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmdata/dcpixseq.h"
+#include "dcmtk/dcmdata/dcpxitem.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+
+namespace
+{
+
+std::atomic<bool> enabled(false);
+
+// values longer than this are left in the file when it is loaded and read in chunks
+const Uint32 maxReadLength = 4096;
+
+bool addValue(DcmElement* element, OFCRC32C& crc, DcmFileCache& cache, std::vector<Uint8>& buffer, std::string& error)
+{
+    const Uint32 length = element->getLength();
+    for (Uint32 offset = 0; offset < length; ) {
+        const Uint32 count = std::min(length - offset, PixelHash::chunkSize);
+        buffer.resize(count);
+        OFCondition cond = element->getPartialValue(buffer.data(), offset, count, &cache, EBO_LittleEndian);
+        if (cond.bad()) {
+            error = cond.text();
+            return false;
+        }
+        crc.addBlock(buffer.data(), count);
+        offset += count;
+    }
+    return true;
+}
+
+}
+
+void PixelHash::configure(bool enable)
+{
+    enabled = enable;
+}
+
+bool PixelHash::isEnabled()
+{
+    return enabled;
+}
+
+bool PixelHash::ofDataset(DcmItem* dataset, std::string& hash, std::string& error)
+{
+    OFCRC32C crc;
+    DcmFileCache cache;
+    std::vector<Uint8> buffer;
+    DcmElement* element = NULL;
+    if (dataset->findAndGetElement(DCM_PixelData, element).good() && element != NULL && element->ident() == EVR_PixelData) {
+        DcmPixelData* pixelData = OFstatic_cast(DcmPixelData*, element);
+        E_TransferSyntax xfer = EXS_Unknown;
+        const DcmRepresentationParameter* param = NULL;
+        pixelData->getOriginalRepresentationKey(xfer, param);
+        if (DcmXfer(xfer).isEncapsulated()) {
+            DcmPixelSequence* sequence = NULL;
+            if (pixelData->getEncapsulatedRepresentation(xfer, param, sequence).bad() || sequence == NULL) {
+                error = "invalid encapsulated pixel data";
+                return false;
+            }
+            for (unsigned long i = 0; i < sequence->card(); ++i) {
+                DcmPixelItem* item = NULL;
+                if (sequence->getItem(item, i).bad() || !addValue(item, crc, cache, buffer, error)) {
+                    return false;
+                }
+            }
+        }
+        else if (!addValue(pixelData, crc, cache, buffer, error)) {
+            return false;
+        }
+    }
+    char text[9];
+    snprintf(text, sizeof(text), "%08x", crc.getCRC32());
+    hash = text;
+    return true;
+}
+
+bool PixelHash::ofFile(const std::string& file, std::string& sopInstanceUID, std::string& hash, std::string& error)
+{
+    DcmFileFormat fileformat;
+    OFCondition cond = DcmQueryRetrievePackFile::isMember(file.c_str())
+        ? DcmQueryRetrievePackFile::load(file.c_str(), fileformat)
+        : fileformat.loadFile(file.c_str(), EXS_Unknown, EGL_noChange, maxReadLength);
+    if (cond.bad()) {
+        error = cond.text();
+        return false;
+    }
+    OFString uid;
+    fileformat.getDataset()->findAndGetOFString(DCM_SOPInstanceUID, uid);
+    sopInstanceUID = uid.c_str();
+    return ofDataset(fileformat.getDataset(), hash, error);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcitem.h"
+
+// CRC-32C of the pixel data of instances as stored, without decoding it: the value of native pixel
+// data in little endian, the fragments of encapsulated pixel data including the basic offset table
+// in the order of the file. The values of files are streamed from disk in chunks, the file is never
+// loaded whole. The index keeps the hashes of the instances stored while enabled so a later verify
+// finds files whose pixel data changed on disk
+class PixelHash
+{
+public:
+    // hashes the pixel data of the instances the index gets from now on
+    static void configure(bool enabled);
+
+    // true between configure(true) and configure(false)
+    static bool isEnabled();
+
+    // the hash of the pixel data of dataset, eight hex digits. An instance without pixel data
+    // hashes to the CRC of no bytes
+    static bool ofDataset(DcmItem* dataset, std::string& hash, std::string& error);
+
+    // the hash of the pixel data and the SOPInstanceUID of the instance in file, which may be a
+    // member of a pack
+    static bool ofFile(const std::string& file, std::string& sopInstanceUID, std::string& hash, std::string& error);
+
+    // bytes of the pixel data read from a file at once
+    static const Uint32 chunkSize = 1 << 20;
+};
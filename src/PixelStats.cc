@@ -0,0 +1,313 @@
+#include "PixelStats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfcache.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+
+// SSE2 is part of every x86-64 CPU and NEON of every AArch64 CPU
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PIXELSTATS_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define PIXELSTATS_NEON
+#include <arm_neon.h>
+#endif
+
+const double PixelStats::clipPercent = 0.5;
+
+namespace
+{
+
+std::atomic<bool> enabled(false);
+
+// how the stored values are laid out in the samples
+struct sLayout
+{
+    unsigned int bitsStored;
+    unsigned int highBit;
+    bool isSigned;
+};
+
+// the stored value of a sample, sign extended if signed
+inline int storedValue(unsigned int sample, const sLayout& layout)
+{
+    if (layout.isSigned) {
+        // the high bit goes to the sign bit and back with an arithmetic shift
+        const int shifted = OFstatic_cast(Sint32, OFstatic_cast(Uint32, sample) << (31 - layout.highBit));
+        return shifted >> (32 - layout.bitsStored);
+    }
+    const unsigned int mask = layout.bitsStored >= 32 ? 0xFFFFFFFFu : (1u << layout.bitsStored) - 1;
+    return OFstatic_cast(int, (sample >> (layout.highBit + 1 - layout.bitsStored)) & mask);
+}
+
+// masks the 16 bit samples of a frame to their stored values in place and returns their range
+void normalize(Uint16* samples, size_t count, const sLayout& layout, int& minimum, int& maximum)
+{
+    size_t i = 0;
+    minimum = layout.isSigned ? 32767 : 65535;
+    maximum = layout.isSigned ? -32768 : 0;
+#if defined(PIXELSTATS_SSE2)
+    if (count >= 8) {
+        // unsigned samples using all 16 bits are compared as signed ones with the sign bit flipped
+        const short flip = (!layout.isSigned && layout.bitsStored == 16) ? OFstatic_cast(short, 0x8000) : 0;
+        const __m128i bias = _mm_set1_epi16(flip);
+        const __m128i mask = _mm_set1_epi16(OFstatic_cast(short, layout.bitsStored >= 16 ? 0xFFFF : (1u << layout.bitsStored) - 1));
+        const __m128i left = _mm_cvtsi32_si128(15 - layout.highBit);
+        const __m128i right = _mm_cvtsi32_si128(layout.isSigned ? 16 - layout.bitsStored : layout.highBit + 1 - layout.bitsStored);
+        __m128i low = _mm_set1_epi16(32767);
+        __m128i high = _mm_set1_epi16(-32768);
+        for (; i + 8 <= count; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            v = layout.isSigned ? _mm_sra_epi16(_mm_sll_epi16(v, left), right) : _mm_and_si128(_mm_srl_epi16(v, right), mask);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), v);
+            v = _mm_xor_si128(v, bias);
+            low = _mm_min_epi16(low, v);
+            high = _mm_max_epi16(high, v);
+        }
+        short lows[8];
+        short highs[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lows), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(highs), high);
+        for (int lane = 0; lane < 8; ++lane) {
+            const short lo = OFstatic_cast(short, lows[lane] ^ flip);
+            const short hi = OFstatic_cast(short, highs[lane] ^ flip);
+            minimum = std::min(minimum, layout.isSigned ? OFstatic_cast(int, lo) : OFstatic_cast(int, OFstatic_cast(Uint16, lo)));
+            maximum = std::max(maximum, layout.isSigned ? OFstatic_cast(int, hi) : OFstatic_cast(int, OFstatic_cast(Uint16, hi)));
+        }
+    }
+#elif defined(PIXELSTATS_NEON)
+    if (count >= 8) {
+        if (layout.isSigned) {
+            const int16x8_t left = vdupq_n_s16(OFstatic_cast(int16_t, 15 - layout.highBit));
+            const int16x8_t right = vdupq_n_s16(OFstatic_cast(int16_t, -OFstatic_cast(int, 16 - layout.bitsStored)));
+            int16x8_t low = vdupq_n_s16(32767);
+            int16x8_t high = vdupq_n_s16(-32768);
+            for (; i + 8 <= count; i += 8) {
+                int16x8_t v = vreinterpretq_s16_u16(vld1q_u16(samples + i));
+                // a shift by a negative count is an arithmetic right shift
+                v = vshlq_s16(vshlq_s16(v, left), right);
+                vst1q_u16(samples + i, vreinterpretq_u16_s16(v));
+                low = vminq_s16(low, v);
+                high = vmaxq_s16(high, v);
+            }
+            minimum = vminvq_s16(low);
+            maximum = vmaxvq_s16(high);
+        }
+        else {
+            const int16x8_t right = vdupq_n_s16(OFstatic_cast(int16_t, -OFstatic_cast(int, layout.highBit + 1 - layout.bitsStored)));
+            const uint16x8_t mask = vdupq_n_u16(OFstatic_cast(uint16_t, layout.bitsStored >= 16 ? 0xFFFF : (1u << layout.bitsStored) - 1));
+            uint16x8_t low = vdupq_n_u16(65535);
+            uint16x8_t high = vdupq_n_u16(0);
+            for (; i + 8 <= count; i += 8) {
+                uint16x8_t v = vandq_u16(vshlq_u16(vld1q_u16(samples + i), right), mask);
+                vst1q_u16(samples + i, v);
+                low = vminq_u16(low, v);
+                high = vmaxq_u16(high, v);
+            }
+            minimum = vminvq_u16(low);
+            maximum = vmaxvq_u16(high);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        const int value = storedValue(samples[i], layout);
+        samples[i] = OFstatic_cast(Uint16, value);
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+    }
+}
+
+// counts of the stored values from base on, grown as frames with other values come along
+struct sCounts
+{
+    sCounts() : base(0) {}
+
+    void extend(int minimum, int maximum)
+    {
+        if (counts.empty()) {
+            base = minimum;
+            counts.assign(maximum - minimum + 1, 0);
+            return;
+        }
+        const int first = std::min(base, minimum);
+        const int last = std::max(base + OFstatic_cast(int, counts.size()) - 1, maximum);
+        if (first == base && last == base + OFstatic_cast(int, counts.size()) - 1) {
+            return;
+        }
+        std::vector<unsigned long long> extended(last - first + 1, 0);
+        std::copy(counts.begin(), counts.end(), extended.begin() + (base - first));
+        counts.swap(extended);
+        base = first;
+    }
+
+    int base;
+    std::vector<unsigned long long> counts;
+};
+
+// the stored value below which fraction of the pixels are
+size_t percentile(const std::vector<unsigned long long>& counts, unsigned long long total, double fraction)
+{
+    const unsigned long long target = OFstatic_cast(unsigned long long, fraction * total);
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        sum += counts[i];
+        if (sum > target) {
+            return i;
+        }
+    }
+    return counts.size() - 1;
+}
+
+}
+
+void PixelStats::configure(bool enable)
+{
+    enabled = enable;
+}
+
+bool PixelStats::isEnabled()
+{
+    return enabled;
+}
+
+bool PixelStats::ofDataset(DcmItem* dataset, DcmPixelStats& stats, std::string& error)
+{
+    DcmElement* element = NULL;
+    if (dataset->findAndGetElement(DCM_PixelData, element).bad() || element == NULL || element->ident() != EVR_PixelData) {
+        return false;
+    }
+    Uint16 samplesPerPixel = 1;
+    Uint16 bitsAllocated = 0;
+    Uint16 bitsStored = 0;
+    Uint16 highBit = 0;
+    Uint16 pixelRepresentation = 0;
+    dataset->findAndGetUint16(DCM_SamplesPerPixel, samplesPerPixel);
+    dataset->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+    dataset->findAndGetUint16(DCM_BitsStored, bitsStored);
+    dataset->findAndGetUint16(DCM_HighBit, highBit);
+    dataset->findAndGetUint16(DCM_PixelRepresentation, pixelRepresentation);
+    if (samplesPerPixel != 1 || (bitsAllocated != 8 && bitsAllocated != 16) || bitsStored == 0 || bitsStored > bitsAllocated ||
+        highBit >= bitsAllocated || highBit + 1 < bitsStored) {
+        return false;
+    }
+    sLayout layout;
+    layout.bitsStored = bitsStored;
+    layout.highBit = highBit;
+    layout.isSigned = pixelRepresentation == 1;
+
+    DcmPixelData* pixelData = OFstatic_cast(DcmPixelData*, element);
+    Sint32 frames = 1;
+    dataset->findAndGetSint32(DCM_NumberOfFrames, frames);
+    Uint32 frameSize = 0;
+    OFCondition cond = pixelData->getUncompressedFrameSize(dataset, frameSize);
+    if (cond.bad() || frameSize == 0) {
+        error = cond.bad() ? cond.text() : "empty frames";
+        return false;
+    }
+    const size_t samples = frameSize / (bitsAllocated / 8);
+    // a frame of 16 bit samples plus the pad byte, aligned for their access
+    std::vector<Uint16> buffer((frameSize + 2) / 2);
+    sCounts counts;
+    DcmFileCache cache;
+    Uint32 startFragment = 0;
+    for (Sint32 frame = 0; frame < std::max<Sint32>(frames, 1); ++frame) {
+        // native pixel data is copied, encapsulated pixel data decoded unless its native representation is kept
+        OFString colorModel;
+        cond = pixelData->getUncompressedFrame(dataset, OFstatic_cast(Uint32, frame), startFragment, buffer.data(),
+            OFstatic_cast(Uint32, buffer.size() * 2), colorModel, &cache);
+        if (cond.bad()) {
+            error = cond.text();
+            return false;
+        }
+        if (bitsAllocated == 8) {
+            // at most 256 values, counted as they are
+            counts.extend(layout.isSigned ? -128 : 0, layout.isSigned ? 127 : 255);
+            const Uint8* bytes = reinterpret_cast<const Uint8*>(buffer.data());
+            for (size_t i = 0; i < samples; ++i) {
+                ++counts.counts[storedValue(bytes[i], layout) - counts.base];
+            }
+        }
+        else {
+            int minimum = 0;
+            int maximum = 0;
+            normalize(buffer.data(), samples, layout, minimum, maximum);
+            counts.extend(minimum, maximum);
+            if (layout.isSigned) {
+                for (size_t i = 0; i < samples; ++i) {
+                    ++counts.counts[OFstatic_cast(Sint16, buffer[i]) - counts.base];
+                }
+            }
+            else {
+                for (size_t i = 0; i < samples; ++i) {
+                    ++counts.counts[buffer[i] - counts.base];
+                }
+            }
+        }
+    }
+
+    // the range of the values that occur
+    size_t first = 0;
+    size_t last = counts.counts.size() - 1;
+    while (first < last && counts.counts[first] == 0) {
+        ++first;
+    }
+    while (last > first && counts.counts[last] == 0) {
+        --last;
+    }
+    unsigned long long total = 0;
+    for (size_t i = first; i <= last; ++i) {
+        total += counts.counts[i];
+    }
+    const size_t low = percentile(counts.counts, total, clipPercent / 100);
+    const size_t high = percentile(counts.counts, total, 1 - clipPercent / 100);
+
+    stats.histogram.assign(bins, 0);
+    const double width = OFstatic_cast(double, last - first + 1) / bins;
+    for (size_t i = first; i <= last; ++i) {
+        stats.histogram[std::min(bins - 1, OFstatic_cast(size_t, (i - first) / width))] += counts.counts[i];
+    }
+
+    // the modality LUT of CT and the like, the window is given in its output
+    Float64 slope = 1;
+    Float64 intercept = 0;
+    dataset->findAndGetFloat64(DCM_RescaleSlope, slope);
+    dataset->findAndGetFloat64(DCM_RescaleIntercept, intercept);
+    if (slope == 0) {
+        slope = 1;
+    }
+    const double values[] = {
+        slope * (counts.base + OFstatic_cast(int, first)) + intercept,
+        slope * (counts.base + OFstatic_cast(int, last)) + intercept,
+        slope * (counts.base + OFstatic_cast(int, low)) + intercept,
+        slope * (counts.base + OFstatic_cast(int, high)) + intercept
+    };
+    stats.minimum = std::min(values[0], values[1]);
+    stats.maximum = std::max(values[0], values[1]);
+    stats.low = std::min(values[2], values[3]);
+    stats.high = std::max(values[2], values[3]);
+    if (slope < 0) {
+        std::reverse(stats.histogram.begin(), stats.histogram.end());
+    }
+    stats.windowCenter = (stats.low + stats.high) / 2;
+    stats.windowWidth = std::max(stats.high - stats.low, 1.0);
+    return true;
+}
+
+bool PixelStats::ofFile(const std::string& file, DcmPixelStats& stats, std::string& error)
+{
+    DcmFileFormat fileformat;
+    OFCondition cond = DcmQueryRetrievePackFile::isMember(file.c_str())
+        ? DcmQueryRetrievePackFile::load(file.c_str(), fileformat)
+        : fileformat.loadFile(file.c_str());
+    if (cond.bad()) {
+        error = cond.text();
+        return false;
+    }
+    return ofDataset(fileformat.getDataset(), stats, error);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcitem.h"
+
+#include "dcmidxdb.h"
+
+// Statistics of the pixel values of grayscale instances, computed while they are stored so a viewer
+// windows them without decoding them once more: minimum, maximum, a histogram and the values
+// clipPercent of the pixels are below and above, whose range is the window preset. Native pixel data is read as
+// received, encapsulated pixel data is decoded frame by frame unless the SCP decoded it for
+// transcoding already. The samples of 16 bit frames are masked to BitsStored and their range found
+// with SSE2 or NEON before they are counted
+class PixelStats
+{
+public:
+    // computes the statistics of the instances the index gets from now on
+    static void configure(bool enabled);
+
+    // true between configure(true) and configure(false)
+    static bool isEnabled();
+
+    // the statistics of the pixel data of dataset. False without error if there are none to compute,
+    // e.g. for instances without pixel data, color images and samples wider than 16 bit
+    static bool ofDataset(DcmItem* dataset, DcmPixelStats& stats, std::string& error);
+
+    // the statistics of the instance in file, which may be a member of a pack
+    static bool ofFile(const std::string& file, DcmPixelStats& stats, std::string& error);
+
+    // bins of DcmPixelStats::histogram
+    static const size_t bins = 64;
+
+    // percent of the pixels below the low and above the high value of the window preset
+    static const double clipPercent;
+};
@@ -0,0 +1,133 @@
+#include "PrefetchAsyncWorker.h"
+
+#include <chrono>
+
+#include "json.h"
+#include "Utils.h"
+#include "AssociationPool.h"
+#include "Prefetcher.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+
+PrefetchAsyncWorker::PrefetchAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void PrefetchAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (!in.source.valid()) {
+        SetErrorJson("Source not set");
+        return;
+    }
+    if (in.jobs.empty()) {
+        SetErrorJson("Jobs not set");
+        return;
+    }
+    for (const ns::sPrefetchJob& job : in.jobs) {
+        if (job.patientId.empty()) {
+            SetErrorJson("Job without patientId");
+            return;
+        }
+        if (!job.peer.valid() && !in.target.valid()) {
+            SetErrorJson("Target not set");
+            return;
+        }
+    }
+    if (!in.storagePath.empty()) {
+        if (!OFStandard::dirExists(in.storagePath.c_str())) {
+            SetErrorJson("Specified storage path does not exist: " + in.storagePath);
+            return;
+        }
+        if (!DcmIndexDatabasePool::configure(in.indexBackend == "postgresql" ?
+                DcmIndexDatabasePool::POSTGRESQL : DcmIndexDatabasePool::SQLITE, in.indexConnection)) {
+            SetErrorJson("Index backend not available in this build: " + in.indexBackend);
+            return;
+        }
+        DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    }
+    AssociationPool::configure(in.associationIdleTimeout);
+
+    Prefetcher::sOptions options;
+    options.source = in.source;
+    options.target = in.target;
+    options.destination = in.destination;
+    options.network = in.network;
+    options.storagePath = in.storagePath;
+    if (in.peerAssociations > 0) {
+        options.peerAssociations = in.peerAssociations;
+    }
+
+    // progress at most once a second
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    auto elapsed = [&start]() {
+        return static_cast<long long>(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000);
+    };
+    const Prefetcher::sProgress state = Prefetcher::run(options, in.jobs, [&](const Prefetcher::sStudy& study) {
+        json v = json::object();
+        v["job"] = study.job;
+        v["PatientID"] = study.patientId;
+        v["StudyInstanceUID"] = study.studyInstanceUID;
+        v["status"] = Prefetcher::name(study.status);
+        if (study.remoteInstances >= 0) {
+            v["instances"] = study.remoteInstances;
+        }
+        if (study.status == Prefetcher::PRESENT) {
+            v["localInstances"] = study.localInstances;
+        }
+        else if (study.status != Prefetcher::CANCELLED) {
+            v["completed"] = study.completed;
+            v["failed"] = study.failed;
+            v["warning"] = study.warning;
+            v["elapsed"] = static_cast<long long>(study.seconds * 1000);
+        }
+        if (!study.error.empty()) {
+            v["error"] = study.error;
+        }
+        SendResponse(ns::createResponse(ns::PENDING, "PREFETCH_STUDY", v), progress);
+    }, [&](size_t job, const std::string& error) {
+        json v = json::object();
+        v["job"] = job;
+        v["PatientID"] = in.jobs[job].patientId;
+        v["error"] = error;
+        SendResponse(ns::createResponse(ns::PENDING, "PREFETCH_FAILED", v), progress);
+    }, [&](const Prefetcher::sProgress& p) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported < std::chrono::seconds(1)) {
+            return;
+        }
+        reported = now;
+        json v = json::object();
+        v["jobs"] = p.jobs;
+        v["queried"] = p.queried;
+        v["studies"] = p.studies;
+        v["present"] = p.present;
+        v["moved"] = p.moved;
+        v["failed"] = p.failed;
+        v["instances"] = p.instances;
+        v["elapsed"] = elapsed();
+        SendResponse(ns::createResponse(ns::PENDING, "PREFETCH_PROGRESS", v), progress);
+    }, CancelFlag());
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+
+    json v = json::object();
+    v["jobs"] = state.jobs;
+    v["studies"] = state.studies;
+    v["present"] = state.present;
+    v["moved"] = state.moved;
+    v["failed"] = state.failed;
+    v["instances"] = state.instances;
+    v["elapsed"] = elapsed();
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// prefetch of prior studies with the Prefetcher, one C-FIND per job and one C-MOVE per study not held
+// locally, run concurrently on each peer
+class PrefetchAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        PrefetchAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
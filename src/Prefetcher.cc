@@ -0,0 +1,368 @@
+#include "Prefetcher.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <thread>
+
+#include "AssociationPool.h"
+#include "Metrics.h"
+#include "dcmidxdb.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcuid.h"
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+// a C-FIND of a job or a C-MOVE of one of its studies, taken lowest rank first
+struct sTask
+{
+    int rank;           // 0 for high priority, 1 medium, 2 low
+    int kind;           // queries before moves of the same rank
+    size_t seq;
+    size_t job;
+    std::string study;
+    int remoteInstances;
+
+    bool operator<(const sTask& other) const
+    {
+        // std::priority_queue has the largest on top
+        if (rank != other.rank) return rank > other.rank;
+        if (kind != other.kind) return kind > other.kind;
+        return seq > other.seq;
+    }
+};
+
+enum { QUERY, MOVE };
+
+int rankOf(const std::string& priority)
+{
+    return priority == "high" ? 0 : priority == "low" ? 2 : 1;
+}
+
+struct sPeer
+{
+    ns::sIdent ident;
+    std::priority_queue<sTask> tasks;
+};
+
+// state shared by the threads of a run
+class PrefetchRun
+{
+public:
+    PrefetchRun(const Prefetcher::sOptions& options, const std::vector<ns::sPrefetchJob>& jobs,
+        const std::function<void(const Prefetcher::sStudy&)>& onStudy,
+        const std::function<void(size_t, const std::string&)>& onQueryFailed,
+        const std::function<void(const Prefetcher::sProgress&)>& onProgress,
+        const std::atomic<bool>* cancel)
+        : _options(options), _jobs(jobs), _onStudy(onStudy), _onQueryFailed(onQueryFailed), _onProgress(onProgress),
+          _cancel(cancel), _outstanding(0), _seq(0)
+    {
+        _progress.jobs = jobs.size();
+    }
+
+    Prefetcher::sProgress run()
+    {
+        std::map<std::string, size_t> peerOf;
+        for (size_t i = 0; i < _jobs.size(); ++i) {
+            const ns::sIdent& ident = _jobs[i].peer.valid() ? _jobs[i].peer : _options.target;
+            const std::string key = ident.aet + "@" + ident.ip + ":" + std::to_string(ident.port);
+            std::map<std::string, size_t>::iterator it = peerOf.find(key);
+            if (it == peerOf.end()) {
+                it = peerOf.insert(std::make_pair(key, _peers.size())).first;
+                _peers.push_back(std::unique_ptr<sPeer>(new sPeer()));
+                _peers.back()->ident = ident;
+            }
+            _peers[it->second]->tasks.push(sTask{rankOf(_jobs[i].priority), QUERY, _seq++, i, std::string(), -1});
+            _outstanding++;
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < _peers.size(); ++p) {
+            for (size_t t = 0; t < std::max<size_t>(_options.peerAssociations, 1); ++t) {
+                threads.push_back(std::thread(&PrefetchRun::work, this, p));
+            }
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        return _progress;
+    }
+
+private:
+    bool cancelled() const
+    {
+        return _cancel != NULL && _cancel->load();
+    }
+
+    void work(size_t p)
+    {
+        sPeer& peer = *_peers[p];
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_outstanding > 0) {
+            if (peer.tasks.empty()) {
+                // moves of queries still running on other threads may come in
+                _wake.wait_for(lock, std::chrono::milliseconds(Prefetcher::pollInterval));
+                continue;
+            }
+            const sTask task = peer.tasks.top();
+            peer.tasks.pop();
+            lock.unlock();
+            if (task.kind == QUERY) {
+                query(peer, task);
+            }
+            else {
+                move(peer, task);
+            }
+            lock.lock();
+            _outstanding--;
+            _onProgress(_progress);
+            _wake.notify_all();
+        }
+    }
+
+    // the studies of the job on the peer, moves are queued for those not held locally
+    void query(sPeer& peer, const sTask& task)
+    {
+        if (cancelled()) {
+            return;
+        }
+        const ns::sPrefetchJob& job = _jobs[task.job];
+        std::vector< std::pair<std::string, int> > studies;
+        OFCondition cond = AssociationPool::run(_options.source, peer.ident, _options.network, [&](CancellableSCU& scu) -> OFCondition {
+            studies.clear();
+            scu.setCancelFlag(_cancel);
+            scu.setPriority(ns::dimsePriority(job.priority));
+            scu.setFindResponseHandler([&](DcmDataset* response) {
+                OFString uid;
+                OFString count;
+                response->findAndGetOFString(DCM_StudyInstanceUID, uid);
+                response->findAndGetOFString(DCM_NumberOfStudyRelatedInstances, count);
+                if (!uid.empty()) {
+                    studies.push_back(std::make_pair(std::string(uid.c_str()), count.empty() ? -1 : std::atoi(count.c_str())));
+                }
+                return true;
+            });
+            T_ASC_PresentationContextID pcid = scu.findPresentationContextID(UID_FINDStudyRootQueryRetrieveInformationModel, "");
+            if (pcid == 0) {
+                return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
+            }
+            DcmDataset keys;
+            keys.putAndInsertString(DCM_QueryRetrieveLevel, "STUDY");
+            keys.putAndInsertString(DCM_PatientID, job.patientId.c_str());
+            keys.putAndInsertString(DCM_StudyInstanceUID, "");
+            keys.putAndInsertString(DCM_NumberOfStudyRelatedInstances, "");
+            for (const ns::sTag& tag : job.tags) {
+                const ns::DicomElement el = ns::toElement(tag.key, tag.value);
+                if (el.xtag != DCM_QueryRetrieveLevel && el.xtag != DCM_PatientID) {
+                    keys.putAndInsertString(el.xtag, el.value.c_str());
+                }
+            }
+            return scu.sendFINDRequest(pcid, &keys, NULL);
+        });
+
+        std::vector<Prefetcher::sStudy> present;
+        std::vector<sTask> moves;
+        if (cond.good()) {
+            DcmIndexDatabase* db = !_options.storagePath.empty() ? DcmIndexDatabasePool::acquireReader(_options.storagePath.c_str()) : NULL;
+            for (const std::pair<std::string, int>& study : studies) {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (!_seen.insert(study.first).second) {
+                        continue;
+                    }
+                }
+                const int local = db != NULL && db->isInitialized() ? localInstances(db, study.first) : 0;
+                if (local > 0 && local >= study.second) {
+                    Prefetcher::sStudy result;
+                    result.job = task.job;
+                    result.patientId = job.patientId;
+                    result.studyInstanceUID = study.first;
+                    result.remoteInstances = study.second;
+                    result.localInstances = local;
+                    result.status = Prefetcher::PRESENT;
+                    present.push_back(result);
+                }
+                else {
+                    moves.push_back(sTask{task.rank, MOVE, 0, task.job, study.first, study.second});
+                }
+            }
+            DcmIndexDatabasePool::release(db);
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _progress.queried++;
+        if (cond.bad()) {
+            Metrics::counter("prefetch_queries_failed_total").add();
+            _onQueryFailed(task.job, cond.text());
+            return;
+        }
+        _progress.studies += present.size() + moves.size();
+        for (const Prefetcher::sStudy& result : present) {
+            finish(result);
+        }
+        for (sTask& move : moves) {
+            move.seq = _seq++;
+            peer.tasks.push(move);
+            _outstanding++;
+        }
+    }
+
+    // NumberOfStudyRelatedInstances of the study in the local index, 0 if it is not there
+    int localInstances(DcmIndexDatabase* db, const std::string& study) const
+    {
+        std::list<DcmSmallDcmElm> request;
+        request.push_back(DcmSmallDcmElm(DCM_StudyInstanceUID, study));
+        request.push_back(DcmSmallDcmElm(DCM_NumberOfStudyRelatedInstances, ""));
+        DcmIndexFindCursor* cursor = db->openFind(request, STUDY_LEVEL);
+        if (cursor == NULL) {
+            return 0;
+        }
+        int count = 0;
+        std::list<DcmSmallDcmElm> row;
+        while (cursor->next(row)) {
+            for (const DcmSmallDcmElm& el : row) {
+                if (el.XTag() == DCM_NumberOfStudyRelatedInstances) {
+                    count += std::atoi(el.valueField().c_str());
+                }
+            }
+        }
+        delete cursor;
+        return count;
+    }
+
+    void move(sPeer& peer, const sTask& task)
+    {
+        const ns::sPrefetchJob& job = _jobs[task.job];
+        Prefetcher::sStudy result;
+        result.job = task.job;
+        result.patientId = job.patientId;
+        result.studyInstanceUID = task.study;
+        result.remoteInstances = task.remoteInstances;
+        if (cancelled()) {
+            result.status = Prefetcher::CANCELLED;
+            std::lock_guard<std::mutex> lock(_mutex);
+            finish(result);
+            return;
+        }
+
+        const Clock::time_point started = Clock::now();
+        Uint16 status = STATUS_Success;
+        const std::string destination = !_options.destination.empty() ? _options.destination : _options.source.aet;
+        OFCondition cond = AssociationPool::run(_options.source, peer.ident, _options.network, [&](CancellableSCU& scu) -> OFCondition {
+            scu.setCancelFlag(_cancel);
+            scu.setPriority(ns::dimsePriority(job.priority));
+            scu.setMoveResponseHandler([&](const RetrieveResponse& response) {
+                status = response.m_status;
+                result.completed = response.m_numberOfCompletedSubops;
+                result.failed = response.m_numberOfFailedSubops;
+                result.warning = response.m_numberOfWarningSubops;
+            });
+            T_ASC_PresentationContextID pcid = scu.findPresentationContextID(UID_MOVEStudyRootQueryRetrieveInformationModel, "");
+            if (pcid == 0) {
+                return DIMSE_NOVALIDPRESENTATIONCONTEXTID;
+            }
+            DcmDataset keys;
+            keys.putAndInsertString(DCM_QueryRetrieveLevel, "STUDY");
+            keys.putAndInsertString(DCM_StudyInstanceUID, task.study.c_str());
+            OFList<RetrieveResponse*> responses;
+            OFCondition moved = scu.sendMOVERequest(pcid, destination.c_str(), &keys, &responses);
+            for (RetrieveResponse* response : responses) {
+                delete response;
+            }
+            return moved;
+        }, AssociationPool::QUERY_RETRIEVE, AssociationPool::NO_RETRY);
+        result.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+        if (cond.bad()) {
+            result.status = Prefetcher::FAILED;
+            result.error = cond.text();
+        }
+        else if (status == STATUS_MOVE_Cancel_SubOperationsTerminatedDueToCancelIndication) {
+            result.status = Prefetcher::CANCELLED;
+        }
+        else if (status != STATUS_Success && status != STATUS_MOVE_Warning_SubOperationsCompleteOneOrMoreFailures) {
+            result.status = Prefetcher::FAILED;
+            result.error = std::string("C-MOVE status ") + DU_cmoveStatusString(status);
+        }
+        else {
+            result.status = result.failed > 0 ? Prefetcher::FAILED : Prefetcher::MOVED;
+        }
+        Metrics::histogram("prefetch_move_seconds").record(result.seconds);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        finish(result);
+    }
+
+    // counts and hands on the outcome of a study, with _mutex held
+    void finish(const Prefetcher::sStudy& result)
+    {
+        switch (result.status) {
+        case Prefetcher::PRESENT:
+            _progress.present++;
+            break;
+        case Prefetcher::MOVED:
+            _progress.moved++;
+            break;
+        case Prefetcher::FAILED:
+            _progress.failed++;
+            break;
+        default:
+            break;
+        }
+        _progress.instances += result.completed + result.warning;
+        Metrics::counter("prefetch_studies_total", {{"status", Prefetcher::name(result.status)}}).add();
+        _onStudy(result);
+    }
+
+    const Prefetcher::sOptions& _options;
+    const std::vector<ns::sPrefetchJob>& _jobs;
+    const std::function<void(const Prefetcher::sStudy&)>& _onStudy;
+    const std::function<void(size_t, const std::string&)>& _onQueryFailed;
+    const std::function<void(const Prefetcher::sProgress&)>& _onProgress;
+    const std::atomic<bool>* _cancel;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::vector< std::unique_ptr<sPeer> > _peers;
+    // tasks queued or running on any peer, the threads stop at 0
+    size_t _outstanding;
+    size_t _seq;
+    std::set<std::string> _seen;
+    Prefetcher::sProgress _progress;
+};
+
+}
+
+Prefetcher::sProgress Prefetcher::run(const sOptions& options, const std::vector<ns::sPrefetchJob>& jobs,
+    const std::function<void(const sStudy&)>& onStudy,
+    const std::function<void(size_t job, const std::string& error)>& onQueryFailed,
+    const std::function<void(const sProgress&)>& onProgress,
+    const std::atomic<bool>* cancel)
+{
+    PrefetchRun prefetch(options, jobs, onStudy, onQueryFailed, onProgress, cancel);
+    return prefetch.run();
+}
+
+const char* Prefetcher::name(eStatus status)
+{
+    switch (status) {
+        case MOVED:
+            return "moved";
+        case PRESENT:
+            return "present";
+        case FAILED:
+            return "failed";
+        default:
+            return "cancelled";
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+// Prefetch of prior studies, e.g. ahead of the worklist of the next day. The studies of the patient of
+// each job that match its keys are queried from the job's peer, the studies an earlier job found already
+// and those the local index holds with all their instances are left out, and the others are moved to
+// the destination. Each peer gets peerAssociations threads on pooled associations, which take the
+// queries and moves of its jobs high before medium before low priority, and queries before the moves
+// of the same priority so the moves are known early. A slow peer does not hold up the others.
+class Prefetcher
+{
+public:
+    enum eStatus {
+        MOVED,          // all sub-operations of the C-MOVE completed, or some with warnings
+        PRESENT,        // held by the local index already
+        FAILED,         // the C-MOVE or some of its sub-operations failed
+        CANCELLED       // not moved since the request was cancelled
+    };
+
+    struct sOptions {
+        sOptions() : peerAssociations(defaultPeerAssociations) {}
+        ns::sIdent source;
+        // peer of the jobs without one
+        ns::sIdent target;
+        // AE title the studies are moved to, the source if empty
+        std::string destination;
+        ns::sNetworkOptions network;
+        // storage area whose index is checked for the studies, none if empty
+        std::string storagePath;
+        size_t peerAssociations;
+    };
+
+    struct sStudy {
+        sStudy() : job(0), remoteInstances(-1), localInstances(0), status(MOVED), completed(0), failed(0), warning(0), seconds(0) {}
+        size_t job;
+        std::string patientId;
+        std::string studyInstanceUID;
+        // NumberOfStudyRelatedInstances of the peer, -1 if it did not return one
+        int remoteInstances;
+        int localInstances;
+        eStatus status;
+        // sub-operations of the C-MOVE
+        unsigned int completed;
+        unsigned int failed;
+        unsigned int warning;
+        double seconds;
+        std::string error;
+    };
+
+    struct sProgress {
+        sProgress() : jobs(0), queried(0), studies(0), present(0), moved(0), failed(0), instances(0) {}
+        size_t jobs;
+        // jobs whose C-FIND is done, studies found over all of them
+        size_t queried;
+        size_t studies;
+        size_t present;
+        size_t moved;
+        size_t failed;
+        // instances moved
+        size_t instances;
+    };
+
+    // runs the jobs until all are done or cancel is set. onStudy is called for each study found, with
+    // the outcome of its move, onQueryFailed for each job whose C-FIND failed and onProgress after each
+    // query and move. The callbacks are not called concurrently
+    static sProgress run(const sOptions& options, const std::vector<ns::sPrefetchJob>& jobs,
+        const std::function<void(const sStudy&)>& onStudy,
+        const std::function<void(size_t job, const std::string& error)>& onQueryFailed,
+        const std::function<void(const sProgress&)>& onProgress,
+        const std::atomic<bool>* cancel = NULL);
+
+    // "moved", "present", "failed" or "cancelled"
+    static const char* name(eStatus status);
+
+    static const size_t defaultPeerAssociations = 2;
+
+    // upper bound of a wait for work, cancel is checked in between (ms)
+    static const int pollInterval = 100;
+};
@@ -0,0 +1,143 @@
+#include "PyramidAsyncWorker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "WsiPyramid.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+
+namespace
+{
+
+typedef std::map<DB_FindAttrExt, std::string, DB_FindAttrExtCompare> Attributes;
+
+}
+
+PyramidAsyncWorker::PyramidAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void PyramidAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.storagePath.empty()) {
+        SetErrorJson("No storage path set");
+        return;
+    }
+    std::vector<std::string> files(in.sourcePaths);
+    if (!in.sourcePath.empty()) {
+        files.push_back(in.sourcePath);
+    }
+    if (files.empty()) {
+        SetErrorJson("No source paths set");
+        return;
+    }
+
+    ns::applyCodecSettings(in);
+
+    // JPEG baseline by default, as the levels of most scanners are
+    const DcmXfer writeXfer(in.writeTransfer.empty() ? "1.2.840.10008.1.2.4.50" : in.writeTransfer.c_str());
+    if (!writeXfer.isEncapsulated()) {
+        SetErrorJson("Write transfer syntax must be encapsulated, not " + in.writeTransfer);
+        return;
+    }
+    const ns::sRepresentationParameters parameters(in.lossyQuality, in.restartRows);
+
+    WsiPyramid::sOptions options;
+    options.xfer = writeXfer.getXfer();
+    options.param = parameters.get(options.xfer);
+    options.threads = in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    options.storagePath = in.storagePath;
+
+    DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(in.storagePath.c_str());
+    if (db == NULL || !db->isInitialized()) {
+        DcmIndexDatabasePool::release(db);
+        SetErrorJson("Cannot open the index of " + in.storagePath);
+        return;
+    }
+
+    // progress at most once a second
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    const WsiPyramid::ProgressFunction onProgress = [&](size_t done, size_t total) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            json v = json::object();
+            v["tiles"] = done;
+            v["totalTiles"] = total;
+            v["elapsed"] = std::chrono::duration<double>(now - start).count();
+            SendResponse(ns::createResponse(ns::PENDING, "PYRAMID_PROGRESS", v), progress);
+        }
+        return !Cancelled();
+    };
+
+    json levels = json::array();
+    size_t insertFailures = 0;
+    const WsiPyramid::LevelFunction onLevel = [&](DcmDataset* dataset, const std::string& filename) {
+        std::vector<Attributes> batch(1);
+        db->extractMetaData(dataset, filename.c_str(), batch.back());
+        for (bool ok : db->insertBatch(batch)) {
+            if (!ok) {
+                ++insertFailures;
+            }
+        }
+        OFString sopInstanceUID;
+        Uint32 columns = 0;
+        Uint32 rows = 0;
+        Sint32 frames = 0;
+        dataset->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
+        dataset->findAndGetUint32(DCM_TotalPixelMatrixColumns, columns);
+        dataset->findAndGetUint32(DCM_TotalPixelMatrixRows, rows);
+        dataset->findAndGetSint32(DCM_NumberOfFrames, frames);
+        json level = json::object();
+        level["SOPInstanceUID"] = sopInstanceUID.c_str();
+        level["Filepath"] = filename;
+        level["columns"] = columns;
+        level["rows"] = rows;
+        level["frames"] = frames;
+        levels.push_back(level);
+    };
+
+    std::string skipped;
+    std::string error;
+    const bool built = WsiPyramid::build(files, options, onProgress, onLevel, skipped, error);
+    DcmIndexDatabasePool::release(db);
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    if (!built) {
+        SetErrorJson("Cannot build the pyramid: " + error);
+        return;
+    }
+    DCMNET_INFO("built " << levels.size() << " pyramid levels in " << elapsed << " s");
+
+    json v = json::object();
+    v["levels"] = levels;
+    if (!skipped.empty()) {
+        v["skipped"] = skipped;
+    }
+    v["failed"] = insertFailures;
+    v["elapsed"] = elapsed;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// builds the missing lower resolution levels of a whole slide image series from its base level,
+// writes them as the storage SCP lays them out below storagePath and inserts them into its index
+class PyramidAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        PyramidAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
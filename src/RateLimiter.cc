@@ -0,0 +1,167 @@
+#include "RateLimiter.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "TransferPolicy.h"
+
+RateLimiter::RateLimiter(const ns::sRateLimit& aeLimits, const ns::sRateLimit& ipLimits)
+    : _aeLimits(aeLimits), _ipLimits(ipLimits)
+{
+}
+
+bool RateLimiter::enabled() const
+{
+    return _aeLimits.enabled() || _ipLimits.enabled();
+}
+
+RateLimiter::eVerdict RateLimiter::admit(const char* aet, const char* presentationAddress)
+{
+    if (!enabled()) {
+        return ADMITTED;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Clock::time_point now = Clock::now();
+    sBucket* buckets[2] = {NULL, NULL};
+    const ns::sRateLimit* limits[2] = {&_aeLimits, &_ipLimits};
+    if (_aeLimits.enabled()) {
+        buckets[0] = &bucket(_ae, aet != NULL ? aet : "", _aeLimits, now);
+    }
+    if (_ipLimits.enabled()) {
+        buckets[1] = &bucket(_ip, TransferPolicy::hostOf(presentationAddress), _ipLimits, now);
+    }
+    // nothing is taken from either bucket if one refuses
+    for (size_t i = 0; i < 2; ++i) {
+        if (buckets[i] != NULL && limits[i]->concurrentAssociations > 0 && buckets[i]->active >= limits[i]->concurrentAssociations) {
+            return CONCURRENCY_EXCEEDED;
+        }
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        if (buckets[i] != NULL && limits[i]->associationsPerSecond > 0) {
+            refill(*buckets[i], *limits[i], now);
+            if (buckets[i]->tokens < 1) {
+                return RATE_EXCEEDED;
+            }
+        }
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        if (buckets[i] != NULL) {
+            if (limits[i]->associationsPerSecond > 0) {
+                buckets[i]->tokens -= 1;
+            }
+            buckets[i]->active++;
+        }
+    }
+    return ADMITTED;
+}
+
+void RateLimiter::release(const char* aet, const char* presentationAddress)
+{
+    if (!enabled()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    Buckets::iterator it = _ae.find(aet != NULL ? aet : "");
+    if (it != _ae.end() && it->second.active > 0) {
+        it->second.active--;
+    }
+    it = _ip.find(TransferPolicy::hostOf(presentationAddress));
+    if (it != _ip.end() && it->second.active > 0) {
+        it->second.active--;
+    }
+}
+
+double RateLimiter::throttle(const char* aet, const char* presentationAddress, uint64_t bytes)
+{
+    if (_aeLimits.bytesPerSecond <= 0 && _ipLimits.bytesPerSecond <= 0) {
+        return 0;
+    }
+    double wait = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const Clock::time_point now = Clock::now();
+        if (_aeLimits.bytesPerSecond > 0) {
+            sBucket& ae = bucket(_ae, aet != NULL ? aet : "", _aeLimits, now);
+            refillBytes(ae, _aeLimits, now);
+            ae.byteTokens -= static_cast<double>(bytes);
+            wait = std::max(wait, -ae.byteTokens / _aeLimits.bytesPerSecond);
+        }
+        if (_ipLimits.bytesPerSecond > 0) {
+            sBucket& ip = bucket(_ip, TransferPolicy::hostOf(presentationAddress), _ipLimits, now);
+            refillBytes(ip, _ipLimits, now);
+            ip.byteTokens -= static_cast<double>(bytes);
+            wait = std::max(wait, -ip.byteTokens / _ipLimits.bytesPerSecond);
+        }
+    }
+    // the debt is taken already, concurrent senders to the peer queue up behind it
+    if (wait > 0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+    return wait;
+}
+
+const char* RateLimiter::name(eVerdict verdict)
+{
+    switch (verdict) {
+        case RATE_EXCEEDED:
+            return "rate";
+        case CONCURRENCY_EXCEEDED:
+            return "concurrency";
+        default:
+            return "admitted";
+    }
+}
+
+RateLimiter::sBucket& RateLimiter::bucket(Buckets& buckets, const std::string& key, const ns::sRateLimit& limit, Clock::time_point now)
+{
+    Buckets::iterator it = buckets.find(key);
+    if (it != buckets.end()) {
+        return it->second;
+    }
+    if (buckets.size() >= sweepThreshold) {
+        sweep(buckets, limit, now);
+    }
+    sBucket& created = buckets[key];
+    created.tokens = capacity(limit);
+    created.refilled = now;
+    created.byteTokens = limit.bytesPerSecond;
+    created.bytesRefilled = now;
+    return created;
+}
+
+void RateLimiter::refill(sBucket& bucket, const ns::sRateLimit& limit, Clock::time_point now)
+{
+    if (limit.associationsPerSecond > 0) {
+        const double elapsed = std::chrono::duration<double>(now - bucket.refilled).count();
+        bucket.tokens = std::min(capacity(limit), bucket.tokens + elapsed * limit.associationsPerSecond);
+    }
+    bucket.refilled = now;
+}
+
+void RateLimiter::refillBytes(sBucket& bucket, const ns::sRateLimit& limit, Clock::time_point now)
+{
+    if (limit.bytesPerSecond > 0) {
+        const double elapsed = std::chrono::duration<double>(now - bucket.bytesRefilled).count();
+        bucket.byteTokens = std::min(static_cast<double>(limit.bytesPerSecond), bucket.byteTokens + elapsed * limit.bytesPerSecond);
+    }
+    bucket.bytesRefilled = now;
+}
+
+double RateLimiter::capacity(const ns::sRateLimit& limit)
+{
+    return limit.burst > 0 ? limit.burst : std::max(limit.associationsPerSecond, 1);
+}
+
+void RateLimiter::sweep(Buckets& buckets, const ns::sRateLimit& limit, Clock::time_point now)
+{
+    for (Buckets::iterator it = buckets.begin(); it != buckets.end();) {
+        refill(it->second, limit, now);
+        refillBytes(it->second, limit, now);
+        if (it->second.active == 0 && it->second.tokens >= capacity(limit) && it->second.byteTokens >= limit.bytesPerSecond) {
+            it = buckets.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "Utils.h"
+
+// Limits of the associations of the SCPs per calling AE title and per IP, so that one misbehaving
+// router cannot starve the modalities. Each new association takes a token of the buckets of its AE
+// title and its IP, which refill at associationsPerSecond up to burst, and a slot of their
+// concurrentAssociations until release(). Checked right after an A-ASSOCIATE-RQ is received, a
+// refusal costs no negotiation. Bytes sent by C-MOVE sub-operations take tokens of a second pair of
+// buckets refilling at bytesPerSecond, a sender running into debt sleeps until it is paid back.
+// Buckets of peers that are idle and full are dropped when the table grows. Thread safe.
+class RateLimiter
+{
+public:
+    enum eVerdict {
+        ADMITTED,
+        RATE_EXCEEDED,          // no association token left for the AE title or the IP
+        CONCURRENCY_EXCEEDED    // all slots of the AE title or the IP taken
+    };
+
+    RateLimiter(const ns::sRateLimit& aeLimits, const ns::sRateLimit& ipLimits);
+
+    // false if no limit is set, nothing needs to be checked then
+    bool enabled() const;
+
+    // takes a token and a slot of the AE title and the IP of the presentation address unless one is
+    // exceeded. An admitted association must be released
+    eVerdict admit(const char* aet, const char* presentationAddress);
+    void release(const char* aet, const char* presentationAddress);
+
+    // waits until bytes may be sent to the AE title and the IP, returns the seconds waited
+    double throttle(const char* aet, const char* presentationAddress, uint64_t bytes);
+
+    static const char* name(eVerdict verdict);
+
+    // peers tracked before idle ones are dropped
+    static const size_t sweepThreshold = 4096;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // token bucket, tokens may go negative for bytes sent on credit
+    struct sBucket {
+        sBucket() : tokens(0), active(0), byteTokens(0) {}
+        double tokens;
+        Clock::time_point refilled;
+        int active;
+        double byteTokens;
+        Clock::time_point bytesRefilled;
+    };
+
+    typedef std::unordered_map<std::string, sBucket> Buckets;
+
+    // the bucket of key, created full. _mutex is held
+    sBucket& bucket(Buckets& buckets, const std::string& key, const ns::sRateLimit& limit, Clock::time_point now);
+    static void refill(sBucket& bucket, const ns::sRateLimit& limit, Clock::time_point now);
+    static void refillBytes(sBucket& bucket, const ns::sRateLimit& limit, Clock::time_point now);
+    static double capacity(const ns::sRateLimit& limit);
+    // drops the buckets with neither associations nor debt that have refilled. _mutex is held
+    static void sweep(Buckets& buckets, const ns::sRateLimit& limit, Clock::time_point now);
+
+    const ns::sRateLimit _aeLimits;
+    const ns::sRateLimit _ipLimits;
+    Buckets _ae;
+    Buckets _ip;
+    std::mutex _mutex;
+};
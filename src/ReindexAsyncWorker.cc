@@ -0,0 +1,336 @@
+#include "ReindexAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offilsys.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdatutl.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+
+namespace
+{
+
+typedef std::map<DB_FindAttrExt, std::string, DB_FindAttrExtCompare> Attributes;
+
+// instances per index transaction, as the ingest queue commits them
+const size_t batchSize = 1000;
+
+// directories still to be listed and files still to be parsed, shared by all threads. Files are
+// taken first so that the backlog of listed but unparsed files stays small, also with millions of
+// files in the storage area
+class ScanWork
+{
+public:
+    ScanWork() : _busy(0) {}
+
+    void addDirectory(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _directories.push_back(path);
+        _changed.notify_one();
+    }
+
+    void addFiles(const std::vector<std::string>& paths)
+    {
+        if (paths.empty()) return;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _files.insert(_files.end(), paths.begin(), paths.end());
+        _changed.notify_all();
+    }
+
+    // returns false once there is nothing left and no other thread can add more
+    bool next(std::string& path, bool& directory)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        --_busy;
+        _changed.wait(lock, [this] { return !_files.empty() || !_directories.empty() || _busy == 0; });
+        if (!_files.empty()) {
+            path = _files.front();
+            _files.pop_front();
+            directory = false;
+        }
+        else if (!_directories.empty()) {
+            path = _directories.back();
+            _directories.pop_back();
+            directory = true;
+        }
+        else {
+            _changed.notify_all();
+            return false;
+        }
+        ++_busy;
+        return true;
+    }
+
+    // every thread counts as busy until it asks for work
+    void start(size_t threads) { _busy = threads; }
+
+private:
+    std::deque<std::string> _files;
+    std::deque<std::string> _directories;
+    size_t _busy;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+};
+
+// batches handed from the parsing threads to the thread inserting them, bounded so parsing
+// waits for a slow index instead of piling up memory
+class BatchQueue
+{
+public:
+    BatchQueue() : _producers(0) {}
+
+    void start(size_t producers) { _producers = producers; }
+
+    void push(std::vector<Attributes>& batch)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]() { return _batches.size() < 4; });
+        _batches.push_back(std::vector<Attributes>());
+        _batches.back().swap(batch);
+        _changed.notify_all();
+    }
+
+    void finished()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        --_producers;
+        _changed.notify_all();
+    }
+
+    // false once all producers finished and all batches were taken
+    bool pop(std::vector<Attributes>& batch)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this]() { return !_batches.empty() || _producers == 0; });
+        if (_batches.empty()) {
+            return false;
+        }
+        batch.swap(_batches.front());
+        _batches.pop_front();
+        _changed.notify_all();
+        return true;
+    }
+
+private:
+    std::deque<std::vector<Attributes> > _batches;
+    size_t _producers;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+};
+
+// the index files, their journals and the caches of the SCP (.transcode-cache) are not instances
+bool isStorageFile(const std::string& name)
+{
+    if (name.empty() || name[0] == '.') {
+        return false;
+    }
+    static const char* const suffixes[] = { ".db", ".db-wal", ".db-shm", ".db-journal" };
+    for (const char* suffix : suffixes) {
+        const size_t length = strlen(suffix);
+        if (name.size() >= length && name.compare(name.size() - length, length, suffix) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isPackFile(const std::string& path)
+{
+    const size_t length = strlen(DcmQueryRetrievePackFile::extension);
+    return path.size() > length && path.compare(path.size() - length, length, DcmQueryRetrievePackFile::extension) == 0;
+}
+
+// lists one directory, subdirectories are queued for any thread to list
+void listDirectory(const std::string& path, ScanWork& work)
+{
+    std::vector<std::string> files;
+    for (OFdirectory_iterator it((OFpath(path.c_str()))); it != OFdirectory_iterator(); ++it) {
+        if (!isStorageFile(it->path().filename().native().c_str())) {
+            continue;
+        }
+        const OFString entry = it->path().native();
+        if (OFStandard::dirExists(entry)) {
+            work.addDirectory(entry.c_str());
+        }
+        else {
+            files.push_back(entry.c_str());
+        }
+    }
+    work.addFiles(files);
+}
+
+}
+
+ReindexAsyncWorker::ReindexAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void ReindexAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.storagePath.empty()) {
+        SetErrorJson("No storage path set");
+        return;
+    }
+    if (!OFStandard::dirExists(in.storagePath.c_str())) {
+        SetErrorJson("Specified storage path does not exist: " + in.storagePath);
+        return;
+    }
+    if (!DcmIndexDatabasePool::configure(in.indexBackend == "postgresql" ?
+            DcmIndexDatabasePool::POSTGRESQL : DcmIndexDatabasePool::SQLITE, in.indexConnection)) {
+        SetErrorJson("Index backend not available in this build: " + in.indexBackend);
+        return;
+    }
+
+    DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(in.storagePath.c_str());
+    if (db == NULL || !db->isInitialized() || !db->beginBulkLoad()) {
+        DcmIndexDatabasePool::release(db);
+        SetErrorJson("Cannot open the index of " + in.storagePath);
+        return;
+    }
+
+    const size_t threads = in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    DCMNET_INFO("indexing the files of " << in.storagePath << " using " << threads << " threads");
+
+    std::atomic<size_t> files(0);
+    std::atomic<size_t> parseFailures(0);
+    ScanWork work;
+    work.addDirectory(in.storagePath);
+    work.start(threads);
+    BatchQueue queue;
+    queue.start(threads);
+    std::vector<std::thread> workers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            std::vector<Attributes> batch;
+            std::string path;
+            bool directory = false;
+            OFString sopInstanceUID;
+            while (work.next(path, directory)) {
+                if (Cancelled()) {
+                    continue;
+                }
+                if (directory) {
+                    listDirectory(path, work);
+                    continue;
+                }
+                ++files;
+                // the instances of a pack file are indexed by their member names
+                if (isPackFile(path)) {
+                    std::vector<OFString> members;
+                    if (DcmQueryRetrievePackFile::list(path.c_str(), members).bad()) {
+                        DCMNET_DEBUG("not a pack file: " << path);
+                        ++parseFailures;
+                    }
+                    for (const OFString& member : members) {
+                        DcmFileFormat file;
+                        if (DcmQueryRetrievePackFile::load(member.c_str(), file, DCM_PixelData).bad() ||
+                            file.getDataset()->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID).bad() || sopInstanceUID.empty()) {
+                            DCMNET_DEBUG("not a DICOM instance: " << member);
+                            ++parseFailures;
+                            continue;
+                        }
+                        batch.push_back(Attributes());
+                        db->extractMetaData(file.getDataset(), member.c_str(), batch.back());
+                        if (batch.size() >= batchSize) {
+                            queue.push(batch);
+                        }
+                    }
+                    continue;
+                }
+                // the header is all the index needs, parsing stops at the pixel data
+                const OFFilename filename(path.c_str());
+                DcmFileFormat file;
+                if (!DcmDataUtil::isDicomFile(filename) ||
+                    file.loadFileUntilTag(filename, EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData).bad() ||
+                    file.getDataset()->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID).bad() || sopInstanceUID.empty()) {
+                    DCMNET_DEBUG("not a DICOM instance: " << path);
+                    ++parseFailures;
+                    continue;
+                }
+                batch.push_back(Attributes());
+                db->extractMetaData(file.getDataset(), path.c_str(), batch.back());
+                if (batch.size() >= batchSize) {
+                    queue.push(batch);
+                }
+            }
+            if (!batch.empty()) {
+                queue.push(batch);
+            }
+            queue.finished();
+        }));
+    }
+
+    // the index is written by this thread only, progress at most once a second
+    size_t inserted = 0;
+    size_t insertFailures = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    std::vector<Attributes> batch;
+    while (queue.pop(batch)) {
+        for (bool ok : db->insertBatch(batch)) {
+            ok ? ++inserted : ++insertFailures;
+        }
+        batch.clear();
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            json v = json::object();
+            v["files"] = static_cast<size_t>(files);
+            v["instances"] = inserted;
+            v["elapsed"] = std::chrono::duration<double>(now - start).count();
+            SendResponse(ns::createResponse(ns::PENDING, "REINDEX_PROGRESS", v), progress);
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // also after a cancelled import, the index stays usable with what was loaded so far
+    const bool indexed = db->endBulkLoad();
+    DcmIndexDatabasePool::release(db);
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DCMNET_INFO("indexed " << inserted << " instances of " << files << " files in " << elapsed << " s");
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    if (!indexed) {
+        SetErrorJson("Cannot build the indexes of " + in.storagePath);
+        return;
+    }
+    json v = json::object();
+    v["files"] = static_cast<size_t>(files);
+    v["instances"] = inserted;
+    v["failed"] = insertFailures + parseFailures;
+    v["elapsed"] = elapsed;
+    v["instancesPerSecond"] = elapsed > 0 ? static_cast<double>(inserted) / elapsed : 0;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// indexes the files already in a storage area: the directories are listed and the headers parsed on
+// a pool of threads, the instances are bulk loaded into the index of storagePath in batches
+class ReindexAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        ReindexAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -0,0 +1,280 @@
+#include "RenderFrameAsyncWorker.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+#include "Utils.h"
+#include "BufferPool.h"
+#include "FrameIndex.h"
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+
+#define INCLUDE_CSTDIO
+#define INCLUDE_CSTRING
+#include "dcmtk/ofstd/ofstdinc.h"
+
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmimgle/dcmimage.h"
+#include "dcmtk/dcmimage/diregist.h" /* include to support color images */
+#include "dcmtk/dcmjpeg/dipijpeg.h"
+#ifdef WITH_LIBPNG
+#include "dcmtk/dcmimage/dipipng.h"
+#endif
+
+#include "json.h"
+
+using json = nlohmann::json;
+
+namespace
+{
+
+// written images (JPEG and PNG) unless raw output is requested
+enum eFormat {
+    FORMAT_RAW,
+    FORMAT_JPEG,
+    FORMAT_PNG
+};
+
+// rendered and failed frames of all threads
+struct sRenderTotals {
+    sRenderTotals() : frames(0), failed(0) {}
+    std::atomic<size_t> frames;
+    std::atomic<size_t> failed;
+};
+
+// the plugins only write to C streams, the image is written to a temporary file and read back
+bool writeToBuffer(DicomImage& image, const DiPluginFormat& plugin, unsigned char*& buffer, size_t& length)
+{
+    FILE* stream = tmpfile();
+    if (stream == NULL) {
+        return false;
+    }
+    bool written = image.writePluginFormat(&plugin, stream) != 0;
+    long size = written ? ftell(stream) : -1;
+    if (size > 0 && fseek(stream, 0, SEEK_SET) == 0) {
+        length = static_cast<size_t>(size);
+        buffer = BufferPool::acquire(length);
+        if (fread(buffer, 1, length, stream) != length) {
+            BufferPool::release(buffer);
+            buffer = NULL;
+        }
+    }
+    fclose(stream);
+    return buffer != NULL;
+}
+
+// scaled copy fitting into width x height, width or height may be zero to derive it from the
+// other one. Returns NULL if the image is to be used unscaled or cannot be scaled
+DicomImage* scale(const DicomImage& image, int width, int height)
+{
+    if (width <= 0 && height <= 0) {
+        return NULL;
+    }
+    double factor = 0;
+    if (width > 0 && height > 0) {
+        factor = std::min(static_cast<double>(width) / image.getWidth(), static_cast<double>(height) / image.getHeight());
+    }
+    else {
+        factor = width > 0 ? static_cast<double>(width) / image.getWidth() : static_cast<double>(height) / image.getHeight();
+    }
+    const unsigned long columns = std::max(static_cast<unsigned long>(std::lround(image.getWidth() * factor)), 1ul);
+    const unsigned long rows = std::max(static_cast<unsigned long>(std::lround(image.getHeight() * factor)), 1ul);
+    // area averaging keeps thumbnails of large images free of aliasing
+    const int interpolate = factor < 1 ? 5 : 1;
+    return image.createScaledImage(columns, rows, interpolate, 0 /*aspect*/);
+}
+
+// renders frame imageFrame of the data set as frame of path and sends it, returns an error message
+// or an empty string
+std::string renderFrame(DcmFileFormat& dfile, const std::string& path, Uint32 frame, Uint32 imageFrame, const ns::sInput& in,
+    eFormat format, BaseAsyncWorker* worker, const BaseAsyncWorker::ExecutionProgress& progress)
+{
+    // only the requested frame is decompressed
+    DicomImage image(&dfile, EXS_Unknown, CIF_UsePartialAccessToPixelData | CIF_NeverAccessEmbeddedOverlays, imageFrame, 1);
+    if (image.getStatus() != EIS_Normal) {
+        return DicomImage::getString(image.getStatus());
+    }
+    if (imageFrame >= image.getNumberOfFrames()) {
+        return "frame number out of range";
+    }
+
+    std::unique_ptr<DicomImage> scaled(scale(image, in.width, in.height));
+    DicomImage& output = scaled ? *scaled : image;
+    if (output.getStatus() != EIS_Normal) {
+        return "cannot scale image";
+    }
+
+    if (output.isMonochrome()) {
+        if (in.window.size() == 2 && in.window[1] > 0) {
+            output.setWindow(in.window[0], in.window[1]);
+        }
+        else if (output.getWindowCount() > 0) {
+            output.setWindow(0);
+        }
+        else {
+            output.setMinMaxWindow();
+        }
+    }
+
+    unsigned char* buffer = NULL;
+    size_t length = 0;
+    if (format == FORMAT_RAW) {
+        length = output.getOutputDataSize(8);
+        buffer = BufferPool::acquire(length);
+        if (length == 0 || !output.getOutputData(buffer, length, 8)) {
+            BufferPool::release(buffer);
+            return "cannot render image";
+        }
+    }
+    else if (format == FORMAT_JPEG) {
+        DiJPEGPlugin plugin;
+        if (in.lossyQuality > 0 && in.lossyQuality <= 100) {
+            plugin.setQuality(static_cast<unsigned int>(in.lossyQuality));
+        }
+        if (!writeToBuffer(output, plugin, buffer, length)) {
+            return "cannot write JPEG image";
+        }
+    }
+#ifdef WITH_LIBPNG
+    else {
+        DiPNGPlugin plugin;
+        plugin.setInterlaceType(E_pngInterlaceNone);
+        plugin.setMetainfoType(E_pngNoMetainfo);
+        if (!writeToBuffer(output, plugin, buffer, length)) {
+            return "cannot write PNG image";
+        }
+    }
+#endif
+
+    json v = json::object();
+    v["Filepath"] = path;
+    v["frame"] = frame;
+    v["Columns"] = output.getWidth();
+    v["Rows"] = output.getHeight();
+    v["SamplesPerPixel"] = output.isMonochrome() ? 1 : 3;
+    v["format"] = format == FORMAT_RAW ? "raw" : format == FORMAT_JPEG ? "jpeg" : "png";
+    v["length"] = length;
+    worker->SendBuffer(ns::createResponse(ns::PENDING, "RENDERED_FRAME", v), buffer, length, progress);
+    return std::string();
+}
+
+}
+
+RenderFrameAsyncWorker::RenderFrameAsyncWorker(std::string data, Function &callback)
+    : BaseAsyncWorker(data, callback) {
+}
+
+void RenderFrameAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    std::vector<std::string> files = in.sourcePaths;
+    if (!in.sourcePath.empty()) {
+        files.insert(files.begin(), in.sourcePath);
+    }
+    if (files.empty()) {
+        SetErrorJson("No source path set");
+        return;
+    }
+
+    eFormat format = FORMAT_RAW;
+    if (in.format == "jpeg") {
+        format = FORMAT_JPEG;
+    }
+    else if (in.format == "png") {
+#ifdef WITH_LIBPNG
+        format = FORMAT_PNG;
+#else
+        SetErrorJson("PNG output is not supported by this build");
+        return;
+#endif
+    }
+    else if (!in.format.empty() && in.format != "raw") {
+        SetErrorJson("Invalid format, raw, jpeg or png expected");
+        return;
+    }
+
+    // the same frames are rendered for each file
+    std::vector<Uint32> frames;
+    for (int frame : in.frames) {
+        if (frame < 0) {
+            SetErrorJson("Invalid frame number");
+            return;
+        }
+        frames.push_back(static_cast<Uint32>(frame));
+    }
+    if (frames.empty()) {
+        frames.push_back(static_cast<Uint32>(in.frame > 0 ? in.frame : 0));
+    }
+
+    // files are distributed over the threads, the frames of a file are rendered in order
+    const size_t threads = std::min(in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1), files.size());
+    std::atomic<size_t> next(0);
+    sRenderTotals totals;
+    std::vector<std::thread> workers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t i = 0; i < threads; ++i) {
+        workers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            for (size_t f = next++; f < files.size() && !Cancelled(); f = next++) {
+                const std::string& path = files[f];
+                // with a frame index only the fragments of the rendered frames are read
+                std::string error;
+                std::shared_ptr<const FrameIndex> index = FrameIndex::get(path, error);
+                DcmFileFormat dfile;
+                if (!index) {
+                    DCMNET_DEBUG("cannot index " << path << ", loading the whole file: " << error);
+                    OFCondition status = dfile.loadFile(OFFilename(path.c_str()));
+                    if (status.bad()) {
+                        DCMNET_WARN("cannot render " << path << ": " << status.text());
+                        totals.failed += frames.size();
+                        continue;
+                    }
+                }
+                for (Uint32 frame : frames) {
+                    if (!index) {
+                        error = renderFrame(dfile, path, frame, frame, in, format, this, progress);
+                    }
+                    else if (frame >= index->frames()) {
+                        error = "frame number out of range";
+                    }
+                    else {
+                        OFCondition status = index->loadFrame(frame, dfile);
+                        error = status.good() ? renderFrame(dfile, path, frame, 0, in, format, this, progress) : status.text();
+                    }
+                    if (error.empty()) {
+                        ++totals.frames;
+                    }
+                    else {
+                        DCMNET_WARN("cannot render frame " << frame << " of " << path << ": " << error);
+                        ++totals.failed;
+                    }
+                }
+            }
+        }));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    if (totals.frames == 0) {
+        SetErrorJson("No frames rendered");
+        return;
+    }
+    json v = json::object();
+    v["frames"] = totals.frames.load();
+    v["failed"] = totals.failed.load();
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// renders frames of one or more files to scaled 8 bit images, raw or encoded as JPEG (or PNG if
+// built with libpng). Each image is sent as a buffer as soon as it is available
+class RenderFrameAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        RenderFrameAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
@@ -5,9 +5,29 @@
 #include <sstream>
 #include <memory>
 #include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <unordered_set>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include "json.h"
 #include "Utils.h"
+#include "BaseAsyncWorker.h"
+#include "BufferPool.h"
+#include "CpuPlacement.h"
+#include "Metrics.h"
+#include "StorageBackend.h"
+#include "Forwarder.h"
+#include "StoreProxy.h"
+#include "StoreRules.h"
+#include "TransferPolicy.h"
 
 using json = nlohmann::json;
 
@@ -18,12 +38,15 @@ using json = nlohmann::json;
 #include "dcmtk/ofstd/ofstd.h"
 #include "dcmtk/ofstd/ofconapp.h"
 #include "dcmtk/ofstd/ofdatime.h"
+#include "dcmtk/ofstd/oftrace.h"
 #include "dcmtk/dcmnet/dicom.h" /* for DICOM_APPLICATION_ACCEPTOR */
 #include "dcmtk/dcmnet/dimse.h"
 #include "dcmtk/dcmnet/diutil.h"
 #include "dcmtk/dcmnet/dcmtrans.h" /* for dcmSocketSend/ReceiveTimeout */
 #include "dcmtk/dcmnet/dcasccfg.h" /* for class DcmAssociationConfiguration */
 #include "dcmtk/dcmnet/dcasccff.h" /* for class DcmAssociationConfigurationFile */
+#include "dcmtk/dcmnet/scppool.h"
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"
 #include "dcmtk/dcmdata/dcfilefo.h"
 #include "dcmtk/dcmdata/dcuid.h"
 #include "dcmtk/dcmdata/dcdict.h"
@@ -31,6 +54,8 @@ using json = nlohmann::json;
 #include "dcmtk/dcmdata/dcmetinf.h"
 #include "dcmtk/dcmdata/dcuid.h" /* for dcmtk version name */
 #include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcjson.h"
+#include "dcmtk/dcmdata/dcarena.h"  /* for DcmArenaScope */
 #include "dcmtk/dcmdata/dcostrmz.h" /* for dcmZlibCompressionLevel */
 
 #include "dcmtk/dcmdata/dcostrma.h"
@@ -49,23 +74,597 @@ using json = nlohmann::json;
 #include "base64.h"
 #include <iostream>
 
+#ifdef _WIN32
+#include <io.h>    /* for _commit() */
+#else
+#include <fcntl.h>
+#include <unistd.h> /* for fsync() */
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
 struct StoreCallbackData
 {
     char* imageFileName;
     OFString storageDir;
-    DcmFileFormat* dcmff;
+    std::shared_ptr<DcmFileFormat> dcmff;
     T_ASC_Association* assoc;
-    Napi::AsyncProgressQueueWorker<char>::ExecutionProgress* progress;
+    // shared by all associations, sending is thread safe
+    const BaseAsyncWorker::ExecutionProgress* progress;
+    BaseAsyncWorker* worker;
+    bool binaryBuffer;
+    bool refuseOverBudget;
+    int shardDigits;
+    const std::vector<DcmTagKey>* eventTags;
+    const StoreRules* storeRules;
+    SeriesAggregator* series;
+    bool seriesEventsOnly;
+    // the dataset from its first to its last PDV, for the transfer policy
+    std::chrono::steady_clock::time_point receiveStarted;
+    Uint64 receivedBytes;
+    double receiveSeconds;
 };
 
 // ------------------------------------------------------------------------------------------------------------
 
+static void measureReceive(StoreCallbackData* cbdata, const T_DIMSE_StoreProgress* progress)
+{
+    if (progress->state == DIMSE_StoreBegin)
+    {
+        cbdata->receiveStarted = std::chrono::steady_clock::now();
+    }
+    else if (progress->state == DIMSE_StoreEnd)
+    {
+        cbdata->receivedBytes = progress->progressBytes > 0 ? OFstatic_cast(Uint64, progress->progressBytes) : 0;
+        cbdata->receiveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cbdata->receiveStarted).count();
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+static void sendResponse(StoreCallbackData* cbdata, const json& response, size_t payloadBytes = 0)
+{
+    if (cbdata->worker != NULL) {
+        cbdata->worker->SendResponse(response, *cbdata->progress, payloadBytes);
+    }
+    else {
+        std::string msg = ns::dumpResponse(response);
+        cbdata->progress->Send(msg.c_str(), msg.length());
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+// reports an instance written to disk, with a FILE_STORAGE event and to the series it is collected in
+static void sendStored(StoreCallbackData* cbdata, const json& v)
+{
+    if (cbdata->series->isEnabled()) {
+        SeriesAggregator::sInstance instance;
+        instance.sopInstanceUID = v.at("SOPInstanceUID").get<std::string>();
+        instance.filepath = v.at("Filepath").get<std::string>();
+        if (v.contains("Attributes")) instance.attributes = v.at("Attributes");
+        cbdata->series->add(cbdata->assoc, v.at("StudyInstanceUID").get<std::string>(), v.at("SeriesInstanceUID").get<std::string>(), instance);
+    }
+    if (!cbdata->seriesEventsOnly) {
+        sendResponse(cbdata, ns::createResponse(ns::PENDING, "FILE_STORAGE", v));
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+// true if the storage event of a dataset, of about bytes, fits into the in-flight budget of the worker.
+// Otherwise the C-STORE is held back until it does, which in turn holds back the peer over TCP, or
+// refused with Out of Resources; a refused dataset is neither stored nor reported
+static bool admitEvent(StoreCallbackData* cbdata, size_t bytes, T_DIMSE_C_StoreRSP* rsp)
+{
+    if (cbdata->worker == NULL || cbdata->worker->AdmitInFlight(bytes, false)) {
+        return true;
+    }
+    if (!cbdata->refuseOverBudget) {
+        Metrics::counter("scp_backpressure_total", {{"scp", "store"}, {"action", "delay"}}).add();
+        Metrics::Timer timer(Metrics::histogram("scp_backpressure_seconds", {{"scp", "store"}}));
+        if (cbdata->worker->AdmitInFlight(bytes, true)) {
+            return true;
+        }
+    }
+    else {
+        Metrics::counter("scp_backpressure_total", {{"scp", "store"}, {"action", "refuse"}}).add();
+    }
+    DCMNET_WARN("refusing C-STORE, storage events in flight to JS exceed the budget");
+    rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+// applies the store rules to a received instance of sopClass. False if they reject it, otherwise
+// storageDir is set to where it is stored
+static bool acceptInstance(StoreCallbackData* cbdata, const char* sopClass, DcmDataset* dataset, OFString& storageDir)
+{
+    storageDir = cbdata->storageDir;
+    const T_ASC_Parameters* params = cbdata->assoc->params;
+    if (cbdata->storeRules->acceptInstance(params->DULparams.callingAPTitle, params->DULparams.calledAPTitle,
+            params->DULparams.callingPresentationAddress, sopClass, dataset, storageDir)) {
+        return true;
+    }
+    DCMNET_DEBUG("store rules: rejecting " << dcmFindNameOfUID(sopClass, sopClass) << " instance from " << params->DULparams.callingAPTitle);
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+// queues the instance for the forwarding rules it matches, as a link to file if set, otherwise
+// written from the dataset of cbdata, which is sent as it is if shared. False if it could not be queued
+static bool forwardInstance(StoreCallbackData* cbdata, const char* sopClass, DcmDataset* dataset, const OFString& file, E_TransferSyntax xfer, bool shared)
+{
+    if (!Forwarder::isConfigured()) {
+        return true;
+    }
+    OFString modality;
+    dataset->findAndGetOFString(DCM_Modality, modality);
+    return Forwarder::enqueue(cbdata->assoc->params->DULparams.callingAPTitle, sopClass, modality.c_str(), xfer,
+        file.c_str(), file.empty() ? cbdata->dcmff : std::shared_ptr<DcmFileFormat>(), shared);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+// the configured attributes of a received dataset in the DICOM JSON model, null if none are configured,
+// so that consumers do not have to load the file again
+static json projectAttributes(StoreCallbackData* cbdata, DcmItem* dataset)
+{
+    if (cbdata->eventTags->empty()) {
+        return json();
+    }
+    DcmDataset projection;
+    for (const DcmTagKey& key : *cbdata->eventTags) {
+        DcmElement* element = NULL;
+        if (dataset->findAndGetElement(key, element).good() && element != NULL) {
+            projection.insert(OFstatic_cast(DcmElement*, element->clone()));
+        }
+    }
+    std::ostringstream stream;
+    DcmJsonFormatCompact format(OFFalse);
+    stream << "{";
+    OFCondition cond = projection.writeJson(stream, format);
+    stream << "}";
+    if (cond.bad()) {
+        DCMNET_WARN("cannot convert attributes of the received dataset: " << cond.text());
+        return json();
+    }
+    return json::parse(stream.str(), nullptr, false);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+namespace {
+
+    // study directories known to exist, so that only the first instance of a study hits the file system
+    class KnownDirectories {
+    public:
+        // the oldest entries are forgotten first, which only costs another stat for their studies
+        static const size_t maxEntries = 16384;
+
+        bool contains(const std::string& dir)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return entries.count(dir) > 0;
+        }
+
+        void insert(const std::string& dir)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!entries.insert(dir).second) {
+                return;
+            }
+            order.push_back(dir);
+            if (order.size() > maxEntries) {
+                entries.erase(order.front());
+                order.pop_front();
+            }
+        }
+
+    private:
+        std::mutex mutex;
+        std::unordered_set<std::string> entries;
+        std::deque<std::string> order;
+    };
+
+    KnownDirectories knownDirectories;
+
+    OFCondition ensureDirectory(const OFString& directory, const OFString& storageDir)
+    {
+        const std::string key(directory.c_str());
+        if (knownDirectories.contains(key)) {
+            return EC_Normal;
+        }
+        if (!OFStandard::dirExists(directory)) {
+            OFCondition cond = OFStandard::createDirectory(directory, storageDir);
+            if (cond.bad()) {
+                return cond;
+            }
+        }
+        knownDirectories.insert(key);
+        return EC_Normal;
+    }
+
+    // <storageDir>/<StudyInstanceUID>, or <storageDir>/<hash prefix>/<StudyInstanceUID> with sharding,
+    // which keeps the number of entries per directory small for large archives
+    OFString studyDirectory(const OFString& storageDir, const OFString& studyInstanceUID, int shardDigits)
+    {
+        OFString base = storageDir;
+        if (shardDigits > 0) {
+            // FNV-1a, stable across platforms and runs
+            Uint32 hash = 2166136261U;
+            for (size_t i = 0; i < studyInstanceUID.length(); ++i) {
+                hash ^= OFstatic_cast(unsigned char, studyInstanceUID[i]);
+                hash *= 16777619U;
+            }
+            char hex[9];
+            OFStandard::snprintf(hex, sizeof(hex), "%08x", hash);
+            OFString shard(hex, OFstatic_cast(size_t, shardDigits < 8 ? shardDigits : 8));
+            OFStandard::combineDirAndFilename(base, storageDir, shard, OFTrue);
+        }
+        OFString result;
+        OFStandard::combineDirAndFilename(result, base, studyInstanceUID, OFTrue);
+        return result;
+    }
+
+    // presentation contexts the storeOnly SCP accepts, built once per process. Accepting a
+    // proposed context is a lookup of its abstract syntax and of each proposed transfer
+    // syntax, instead of a scan of all storage SOP classes per transfer syntax.
+    class NegotiationTable {
+    public:
+        static const NegotiationTable& instance()
+        {
+            static const NegotiationTable table;
+            return table;
+        }
+
+        // 1 to prefer compressed transfer syntaxes for an abstract syntax, 0 uncompressed, -1 the tables below
+        typedef std::function<int(const char*)> Preference;
+
+        // same result as ASC_acceptContextsWithPreferredTransferSyntaxes() with the tables below,
+        // unless preference picks the lossless or the uncompressed table for a storage SOP class
+        OFCondition accept(T_ASC_Parameters* params, const Preference& preference) const
+        {
+            int n = ASC_countPresentationContexts(params);
+            if (n == 0) {
+                return ASC_NOPRESENTATIONCONTEXTPROPOSED;
+            }
+            for (int i = 0; i < n; i++) {
+                T_ASC_PresentationContext pc;
+                OFCondition cond = ASC_getPresentationContext(params, i, &pc);
+                if (cond.bad()) {
+                    return cond;
+                }
+
+                std::unordered_map<std::string, const Ranks*>::const_iterator abstractSyntax = abstractSyntaxes.find(pc.abstractSyntax);
+                if (abstractSyntax == abstractSyntaxes.end()) {
+                    cond = ASC_refusePresentationContext(params, pc.presentationContextID, ASC_P_ABSTRACTSYNTAXNOTSUPPORTED);
+                    if (cond.bad()) {
+                        return cond;
+                    }
+                    continue;
+                }
+
+                // the most wanted of the proposed transfer syntaxes
+                const Ranks* table = abstractSyntax->second;
+                const int compressed = preference ? preference(pc.abstractSyntax) : -1;
+                if (compressed == 0) {
+                    table = &uncompressedTransferSyntaxes;
+                }
+                else if (compressed == 1 && table == &allTransferSyntaxes) {
+                    table = &losslessTransferSyntaxes;
+                }
+                const Ranks& ranks = *table;
+                const char* accepted = NULL;
+                size_t acceptedRank = 0;
+                for (int k = 0; k < OFstatic_cast(int, pc.transferSyntaxCount); k++) {
+                    Ranks::const_iterator rank = ranks.find(pc.proposedTransferSyntaxes[k]);
+                    if (rank != ranks.end() && (accepted == NULL || rank->second < acceptedRank)) {
+                        accepted = rank->first.c_str();
+                        acceptedRank = rank->second;
+                    }
+                }
+
+                if (accepted != NULL) {
+                    cond = ASC_acceptPresentationContext(params, pc.presentationContextID, accepted, ASC_SC_ROLE_DEFAULT);
+                    // SCP/SCU role selection failed, reject presentation context
+                    if (cond == ASC_SCPSCUROLESELECTIONFAILED) {
+                        cond = ASC_refusePresentationContext(params, pc.presentationContextID, ASC_P_NOREASON);
+                    }
+                }
+                else {
+                    cond = ASC_refusePresentationContext(params, pc.presentationContextID, ASC_P_TRANSFERSYNTAXESNOTSUPPORTED);
+                }
+                if (cond.bad()) {
+                    return cond;
+                }
+            }
+            return EC_Normal;
+        }
+
+    private:
+        // preference of an accepted transfer syntax, lower is preferred
+        typedef std::unordered_map<std::string, size_t> Ranks;
+
+        NegotiationTable()
+        {
+            // accept all ts
+            transferSyntaxes.push_back(UID_JPEG2000TransferSyntax);
+            transferSyntaxes.push_back(UID_JPEG2000LosslessOnlyTransferSyntax);
+            transferSyntaxes.push_back(UID_HTJ2KTransferSyntax);
+            transferSyntaxes.push_back(UID_HTJ2KLosslessRPCLTransferSyntax);
+            transferSyntaxes.push_back(UID_HTJ2KLosslessTransferSyntax);
+            transferSyntaxes.push_back(UID_JPEGProcess2_4TransferSyntax);
+            transferSyntaxes.push_back(UID_JPEGProcess1TransferSyntax);
+            transferSyntaxes.push_back(UID_JPEGProcess14SV1TransferSyntax);
+            transferSyntaxes.push_back(UID_JPEGLSLossyTransferSyntax);
+            transferSyntaxes.push_back(UID_JPEGLSLosslessTransferSyntax);
+            transferSyntaxes.push_back(UID_RLELosslessTransferSyntax);
+            transferSyntaxes.push_back(UID_MPEG2MainProfileAtMainLevelTransferSyntax);
+            transferSyntaxes.push_back(UID_MPEG2MainProfileAtHighLevelTransferSyntax);
+            transferSyntaxes.push_back(UID_MPEG4HighProfileLevel4_1TransferSyntax);
+            transferSyntaxes.push_back(UID_MPEG4BDcompatibleHighProfileLevel4_1TransferSyntax);
+            transferSyntaxes.push_back(UID_MPEG4HighProfileLevel4_2_For2DVideoTransferSyntax);
+            transferSyntaxes.push_back(UID_MPEG4HighProfileLevel4_2_For3DVideoTransferSyntax);
+            transferSyntaxes.push_back(UID_MPEG4StereoHighProfileLevel4_2TransferSyntax);
+            transferSyntaxes.push_back(UID_HEVCMainProfileLevel5_1TransferSyntax);
+            transferSyntaxes.push_back(UID_HEVCMain10ProfileLevel5_1TransferSyntax);
+#ifdef WITH_ZLIB
+            transferSyntaxes.push_back(UID_DeflatedExplicitVRLittleEndianTransferSyntax);
+#endif
+            if (gLocalByteOrder == EBO_LittleEndian) {
+                transferSyntaxes.push_back(UID_LittleEndianExplicitTransferSyntax);
+                transferSyntaxes.push_back(UID_BigEndianExplicitTransferSyntax);
+            }
+            else {
+                transferSyntaxes.push_back(UID_BigEndianExplicitTransferSyntax);
+                transferSyntaxes.push_back(UID_LittleEndianExplicitTransferSyntax);
+            }
+            transferSyntaxes.push_back(UID_LittleEndianImplicitTransferSyntax);
+
+            for (size_t i = 0; i < transferSyntaxes.size(); i++) {
+                allTransferSyntaxes[transferSyntaxes[i]] = i;
+            }
+            // non-image objects, e.g. structured reports and encapsulated documents, prefer deflate over all others
+            nonImageTransferSyntaxes = allTransferSyntaxes;
+#ifdef WITH_ZLIB
+            nonImageTransferSyntaxes[UID_DeflatedExplicitVRLittleEndianTransferSyntax] = 0;
+            for (size_t i = 0; i < transferSyntaxes.size(); i++) {
+                if (strcmp(transferSyntaxes[i], UID_DeflatedExplicitVRLittleEndianTransferSyntax) != 0) {
+                    nonImageTransferSyntaxes[transferSyntaxes[i]] = i + 1;
+                }
+            }
+#endif
+
+            // slow links get lossless compression for images, fast ones uncompressed data for all objects
+            const char* lossless[] = {
+                UID_JPEGLSLosslessTransferSyntax,
+                UID_HTJ2KLosslessTransferSyntax,
+                UID_JPEG2000LosslessOnlyTransferSyntax,
+                UID_JPEGProcess14SV1TransferSyntax,
+                UID_RLELosslessTransferSyntax
+            };
+            const char* uncompressed[] = {
+                gLocalByteOrder == EBO_LittleEndian ? UID_LittleEndianExplicitTransferSyntax : UID_BigEndianExplicitTransferSyntax,
+                gLocalByteOrder == EBO_LittleEndian ? UID_BigEndianExplicitTransferSyntax : UID_LittleEndianExplicitTransferSyntax,
+                UID_LittleEndianImplicitTransferSyntax
+            };
+            rankFirst(losslessTransferSyntaxes, lossless, sizeof(lossless) / sizeof(lossless[0]));
+            rankFirst(uncompressedTransferSyntaxes, uncompressed, sizeof(uncompressed) / sizeof(uncompressed[0]));
+
+            // Verification and the Storage SOP Classes from dcuid.h
+            abstractSyntaxes[UID_VerificationSOPClass] = &allTransferSyntaxes;
+            for (int i = 0; i < numberOfDcmAllStorageSOPClassUIDs; i++) {
+                abstractSyntaxes[dcmAllStorageSOPClassUIDs[i]] = dcmIsImageStorageSOPClassUID(dcmAllStorageSOPClassUIDs[i])
+                    ? &allTransferSyntaxes : &nonImageTransferSyntaxes;
+            }
+        }
+
+        // ranks the given transfer syntaxes first, the others after them in the order of transferSyntaxes
+        void rankFirst(Ranks& ranks, const char* const* first, size_t count) const
+        {
+            for (size_t i = 0; i < count; i++) {
+                ranks[first[i]] = i;
+            }
+            for (size_t i = 0; i < transferSyntaxes.size(); i++) {
+                if (ranks.find(transferSyntaxes[i]) == ranks.end()) {
+                    ranks[transferSyntaxes[i]] = count + i;
+                }
+            }
+        }
+
+        std::vector<const char*> transferSyntaxes;
+        Ranks allTransferSyntaxes;
+        Ranks nonImageTransferSyntaxes;
+        Ranks losslessTransferSyntaxes;
+        Ranks uncompressedTransferSyntaxes;
+        std::unordered_map<std::string, const Ranks*> abstractSyntaxes;
+    };
+
+    struct sWriteTicket {
+        sWriteTicket() : done(false), cond(EC_Normal) {}
+        bool done;
+        OFCondition cond;
+    };
+
+    struct sWriteJob {
+        std::shared_ptr<DcmFileFormat> dcmff;
+        OFString directory;
+        OFString storageDir;
+        OFString fileName;
+        E_TransferSyntax xfer;
+        std::shared_ptr<sWriteTicket> ticket;
+    };
+
+    bool syncFile(const OFString& fileName)
+    {
+#ifdef _WIN32
+        FILE* f = fopen(fileName.c_str(), "rb+");
+        if (f == NULL) {
+            return false;
+        }
+        bool ok = _commit(_fileno(f)) == 0;
+        fclose(f);
+        return ok;
+#else
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+#endif
+    }
+
+    OFCondition writeFile(const sWriteJob& job, StoreWriteQueue::eDurability durability)
+    {
+        OFCondition cond = ensureDirectory(job.directory, job.storageDir);
+        if (cond.bad()) {
+            DCMNET_ERROR("failed to create directory " << job.directory);
+            return cond;
+        }
+        cond = job.dcmff->saveFile(job.fileName.c_str(), job.xfer, EET_ExplicitLength, EGL_recalcGL, EPD_withoutPadding, 0, 0, EWM_fileformat);
+        if (cond.good() && durability == StoreWriteQueue::SYNCED && !syncFile(job.fileName)) {
+            cond = makeOFCondition(OFM_dcmnet, 0, OF_error, "cannot flush file to disk");
+        }
+        std::string error;
+        if (cond.good() && !StorageArea::stored(job.fileName.c_str(), error)) {
+            cond = makeOFCondition(OFM_dcmnet, 0, OF_error, error.c_str());
+        }
+        if (cond.bad()) {
+            DCMNET_ERROR("cannot write DICOM file " << job.fileName << ": " << cond.text());
+            // delete incomplete file
+            OFStandard::deleteFile(job.fileName);
+        }
+        return cond;
+    }
+
+    // I/O threads shared by all associations, they live as long as the process
+    class StoreWriter {
+    public:
+        StoreWriter(size_t threads, StoreWriteQueue::eDurability mode)
+            : durability(mode), maxQueued(4 * threads), writing(0)
+        {
+            for (size_t i = 0; i < threads; ++i) {
+                std::thread(&StoreWriter::run, this).detach();
+            }
+        }
+
+        void run();
+
+        StoreWriteQueue::eDurability durability;
+        // receiving blocks once this many files are waiting, which bounds the datasets kept in memory
+        size_t maxQueued;
+        // jobs taken by an I/O thread and not yet done
+        size_t writing;
+        std::deque<sWriteJob> jobs;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable written;
+    };
+
+    void StoreWriter::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [this] { return !jobs.empty(); });
+            sWriteJob job = jobs.front();
+            jobs.pop_front();
+            ++writing;
+            written.notify_all();
+            lock.unlock();
+
+            OFCondition cond = writeFile(job, durability);
+            // release the dataset before waking up the receiver
+            job.dcmff.reset();
+
+            lock.lock();
+            job.ticket->done = true;
+            job.ticket->cond = cond;
+            --writing;
+            written.notify_all();
+        }
+    }
+
+    std::mutex storeWriterMutex;
+    StoreWriter* storeWriter = NULL;
+    size_t storeWriteThreads = 4;
+    StoreWriteQueue::eDurability storeWriteDurability = StoreWriteQueue::WRITTEN;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+void StoreWriteQueue::configure(size_t threads, eDurability durability)
+{
+    std::lock_guard<std::mutex> lock(storeWriterMutex);
+    storeWriteThreads = threads > 0 ? threads : 1;
+    storeWriteDurability = durability;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+OFCondition StoreWriteQueue::write(const std::shared_ptr<DcmFileFormat>& dcmff, const OFString& directory, const OFString& storageDir, const OFString& fileName, E_TransferSyntax xfer)
+{
+    StoreWriter* writer = NULL;
+    {
+        std::lock_guard<std::mutex> lock(storeWriterMutex);
+        if (storeWriter == NULL) {
+            storeWriter = new StoreWriter(storeWriteThreads, storeWriteDurability);
+        }
+        writer = storeWriter;
+    }
+
+    sWriteJob job;
+    job.dcmff = dcmff;
+    job.directory = directory;
+    job.storageDir = storageDir;
+    job.fileName = fileName;
+    job.xfer = xfer;
+    job.ticket = std::make_shared<sWriteTicket>();
+
+    std::unique_lock<std::mutex> lock(writer->mutex);
+    writer->written.wait(lock, [writer] { return writer->jobs.size() < writer->maxQueued; });
+    writer->jobs.push_back(job);
+    writer->wakeup.notify_one();
+
+    if (writer->durability == QUEUED) {
+        return EC_Normal;
+    }
+
+    writer->written.wait(lock, [&job] { return job.ticket->done; });
+    return job.ticket->cond;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+void StoreWriteQueue::flush()
+{
+    StoreWriter* writer = NULL;
+    {
+        std::lock_guard<std::mutex> lock(storeWriterMutex);
+        writer = storeWriter;
+    }
+    if (writer == NULL) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(writer->mutex);
+    writer->written.wait(lock, [writer] { return writer->jobs.empty() && writer->writing == 0; });
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
 void storeSCPCallback(void* callbackData, T_DIMSE_StoreProgress* progress, T_DIMSE_C_StoreRQ* req,
     char* /*imageFileName*/, DcmDataset** imageDataSet, T_DIMSE_C_StoreRSP* rsp, DcmDataset** statusDetail)
 {
     DIC_UI sopClass;
     DIC_UI sopInstance;
 
+    measureReceive(OFstatic_cast(StoreCallbackData*, callbackData), progress);
+
     // if this is the final call of this function, save the data which was received to a file
     // (note that we could also save the image somewhere else, put it in database, etc.)
     if (progress->state == DIMSE_StoreEnd)
@@ -87,36 +686,70 @@ void storeSCPCallback(void* callbackData, T_DIMSE_StoreProgress* progress, T_DIM
             (*imageDataSet)->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID);
             (*imageDataSet)->findAndGetOFString(DCM_SOPInstanceUID, sopInstanceUID);
 
+            // before the dataset may be handed over to an I/O thread
+            json attributes = projectAttributes(cbdata, *imageDataSet);
+
             // determine the transfer syntax which shall be used to write the information to the file
             E_TransferSyntax xfer = xfer = (*imageDataSet)->getOriginalXfer();
 
+            // check the image to make sure it is consistent, i.e. that its sopClass and sopInstance correspond
+            // to those mentioned in the request. If not, set the status in the response message variable.
+            // This is done first since the dataset may be handed over to an I/O thread below.
+            if (rsp->DimseStatus == STATUS_Success)
+            {
+                // which SOP class and SOP instance ?
+                if (!DU_findSOPClassAndInstanceInDataSet(*imageDataSet, sopClass, sizeof(sopClass), sopInstance, sizeof(sopInstance), OFFalse))
+                {
+                    rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+                }
+                else if (strcmp(sopClass, req->AffectedSOPClassUID) != 0)
+                {
+                    rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+                }
+                else if (strcmp(sopInstance, req->AffectedSOPInstanceUID) != 0)
+                {
+                    rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+                }
+            }
+
+            // the store rules decide before anything is forwarded, written or reported
+            OFString storageDir = cbdata->storageDir;
+            if (rsp->DimseStatus == STATUS_Success && !acceptInstance(cbdata, sopClass, *imageDataSet, storageDir))
+            {
+                rsp->DimseStatus = StoreRules::rejectedStatus;
+                return;
+            }
+
+            // queued for forwarding before the dataset is handed over to an I/O thread
+            if (cbdata->imageFileName && rsp->DimseStatus == STATUS_Success && !forwardInstance(cbdata, sopClass, *imageDataSet, "", xfer, false))
+            {
+                rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+                return;
+            }
+
+            // buffer storage events carry the dataset, as it is or base64 encoded
+            size_t eventBytes = 0;
+            if (!cbdata->imageFileName) {
+                eventBytes = (*imageDataSet)->calcElementLength(xfer, EET_ExplicitLength);
+                if (!cbdata->binaryBuffer) eventBytes = (eventBytes + 2) / 3 * 4;
+            }
+            if (!admitEvent(cbdata, eventBytes, rsp)) {
+                return;
+            }
+
             // if a filename is give we save the image to disk
             if (cbdata->imageFileName) {
 
-                OFString baseStr;
-                OFStandard::combineDirAndFilename(baseStr, cbdata->storageDir, studyInstanceUID, OFTrue);
-                if (!OFStandard::dirExists(baseStr))
-                {
-                    if (OFStandard::createDirectory(baseStr, cbdata->storageDir).bad())
-                    {
-                        std::cerr << "failed to create directory " << baseStr.c_str() << std::endl;
-                        return;
-                    }
-                }
+                OFString baseStr = studyDirectory(storageDir, studyInstanceUID, cbdata->shardDigits);
 
                 OFString fileName;
                 OFStandard::combineDirAndFilename(fileName, baseStr, cbdata->imageFileName, OFTrue);
 
-                OFCondition cond = cbdata->dcmff->saveFile(fileName.c_str(), xfer, EET_ExplicitLength, EGL_recalcGL, EPD_withoutPadding, 0, 0, EWM_fileformat);
+                OFCondition cond = StoreWriteQueue::write(cbdata->dcmff, baseStr, storageDir, fileName, xfer);
 
                 if (cond.bad())
                 {
-                    std::cerr << cond.text() << std::endl;
-                    std::cerr << "cannot write DICOM file " << fileName.c_str() << std::endl;
                     rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
-
-                    // delete incomplete file
-                    OFStandard::deleteFile(fileName);
                 }
                 else {
                     json v = json::object();
@@ -124,22 +757,22 @@ void storeSCPCallback(void* callbackData, T_DIMSE_StoreProgress* progress, T_DIM
                     v["SeriesInstanceUID"] = seriesInstanceUID.c_str();
                     v["SOPInstanceUID"] = sopInstanceUID.c_str();
                     v["Filepath"] = fileName.c_str();
-                    std::string msg = ns::createJsonResponse(ns::PENDING, "FILE_STORAGE", v);
-                    cbdata->progress->Send(msg.c_str(), msg.length());
+                    if (!attributes.is_null()) v["Attributes"] = attributes;
+                    sendStored(cbdata, v);
                 }
             }
-            // else we store in buffer and send as base64
+            // else we store in buffer and send it as binary buffer or base64
             else {
                 E_EncodingType encodingType = EET_ExplicitLength;
 
                 /* open file for output */
-                DcmFileFormat* dcmff = cbdata->dcmff;
+                DcmFileFormat* dcmff = cbdata->dcmff.get();
                 dcmff->validateMetaInfo(xfer, EWM_fileformat);
                 dcmff->removeInvalidGroups();
                 Uint32 length = dcmff->calcElementLength(xfer, encodingType);
                 
-                unsigned char* buffer;
-                buffer = new unsigned char[length];
+                // reused across instances and associations, handed back once JS drops the buffer
+                unsigned char* buffer = BufferPool::acquire(length);
 
                 DcmOutputBufferStream buffStream(buffer, length);
 
@@ -159,170 +792,864 @@ void storeSCPCallback(void* callbackData, T_DIMSE_StoreProgress* progress, T_DIM
                       std::cerr << "exception: " << e.what()  << std::endl;
                     }
 
-                    if (cond.good()) {
+                    // the dataset is not used here any more once serialized, it is forwarded as received
+                    if (cond.good() && rsp->DimseStatus == STATUS_Success && !forwardInstance(cbdata, sopClass, *imageDataSet, "", xfer, true)) {
+                        rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+                        cond = EC_MemoryExhausted;
+                    }
+
+                    if (cond.good() && cbdata->binaryBuffer) {
+                        // hand the serialized bytes over to JS as they are, only the UIDs go into the message
+                        json v = json::object();
+                        v["StudyInstanceUID"] = studyInstanceUID.c_str();
+                        v["SeriesInstanceUID"] = seriesInstanceUID.c_str();
+                        v["SOPInstanceUID"] = sopInstanceUID.c_str();
+                        v["length"] = length;
+                        if (!attributes.is_null()) v["Attributes"] = attributes;
+                        cbdata->worker->SendBuffer(ns::createResponse(ns::PENDING, "BUFFER_STORAGE", v), buffer, length, *cbdata->progress);
+                        buffer = NULL;
+                    }
+                    else if (cond.good()) {
                         std::string encoded = base64_encode(reinterpret_cast<const unsigned char*>(buffer), length);
+                        const size_t encodedLength = encoded.size();
                         json v = json::object();
                         v["StudyInstanceUID"] = studyInstanceUID.c_str();
                         v["SeriesInstanceUID"] = seriesInstanceUID.c_str();
                         v["SOPInstanceUID"] = sopInstanceUID.c_str();
-                        v["base64"] = encoded.c_str();
-                        std::string msg = ns::createJsonResponse(ns::PENDING, "BUFFER_STORAGE", v);
-                        cbdata->progress->Send(msg.c_str(), msg.length());
+                        // the encoded dataset is moved into the message, not copied
+                        v["base64"] = std::move(encoded);
+                        if (!attributes.is_null()) v["Attributes"] = attributes;
+                        sendResponse(cbdata, ns::createResponse(ns::PENDING, "BUFFER_STORAGE", v), encodedLength);
                     }
-                    delete[] buffer;
-                } 
+                }
+                BufferPool::release(buffer);
                 if (cond.bad()) {
                   std::cerr << cond.text() << std::endl;
                 }
             }
 
+        }
+        else {
+            std::cerr << "dataset is NULL" << std::endl;
+        }
+    }
+}
+    
+// ------------------------------------------------------------------------------------------------------------
 
-            // check the image to make sure it is consistent, i.e. that its sopClass and sopInstance correspond
-            // to those mentioned in the request. If not, set the status in the response message variable.
-            if (rsp->DimseStatus == STATUS_Success)
-            {
-                // which SOP class and SOP instance ?
-                if (!DU_findSOPClassAndInstanceInDataSet(*imageDataSet, sopClass, sizeof(sopClass), sopInstance, sizeof(sopInstance), OFFalse))
-                {
-                    rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
-                }
-                else if (strcmp(sopClass, req->AffectedSOPClassUID) != 0)
-                {
-                    rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+static void storeSCPFileCallback(void* callbackData, T_DIMSE_StoreProgress* progress, T_DIMSE_C_StoreRQ* req,
+    char* imageFileName, DcmDataset** /*imageDataSet*/, T_DIMSE_C_StoreRSP* rsp, DcmDataset** statusDetail)
+{
+    measureReceive(OFstatic_cast(StoreCallbackData*, callbackData), progress);
+
+    // the dataset has been written to imageFileName as received, move it into place once complete
+    if (progress->state != DIMSE_StoreEnd)
+    {
+        return;
+    }
+
+    // do not send status detail information
+    *statusDetail = NULL;
+
+    StoreCallbackData* cbdata = OFstatic_cast(StoreCallbackData*, callbackData);
+
+    if (rsp->DimseStatus != STATUS_Success)
+    {
+        OFStandard::deleteFile(imageFileName);
+        return;
+    }
+
+    // only the header up to the pixel data is parsed, larger values are not loaded at all
+    DcmFileFormat dcmff;
+    OFCondition cond = dcmff.loadFileUntilTag(imageFileName, EXS_Unknown, EGL_noChange, 256, ERM_fileOnly, DCM_PixelData);
+    DIC_UI sopClass;
+    DIC_UI sopInstance;
+    if (cond.bad() || !DU_findSOPClassAndInstanceInDataSet(dcmff.getDataset(), sopClass, sizeof(sopClass), sopInstance, sizeof(sopInstance), OFFalse))
+    {
+        rsp->DimseStatus = STATUS_STORE_Error_CannotUnderstand;
+    }
+    else if (strcmp(sopClass, req->AffectedSOPClassUID) != 0 || strcmp(sopInstance, req->AffectedSOPInstanceUID) != 0)
+    {
+        rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+    }
+    if (rsp->DimseStatus != STATUS_Success)
+    {
+        OFStandard::deleteFile(imageFileName);
+        return;
+    }
+
+    OFString storageDir;
+    if (!acceptInstance(cbdata, sopClass, dcmff.getDataset(), storageDir))
+    {
+        rsp->DimseStatus = StoreRules::rejectedStatus;
+        OFStandard::deleteFile(imageFileName);
+        return;
+    }
+
+    OFString studyInstanceUID;
+    OFString seriesInstanceUID;
+    dcmff.getDataset()->findAndGetOFString(DCM_StudyInstanceUID, studyInstanceUID);
+    dcmff.getDataset()->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID);
+
+    if (!admitEvent(cbdata, 0, rsp))
+    {
+        OFStandard::deleteFile(imageFileName);
+        return;
+    }
+
+    OFString baseStr = studyDirectory(storageDir, studyInstanceUID, cbdata->shardDigits);
+    if (ensureDirectory(baseStr, storageDir).bad())
+    {
+        std::cerr << "failed to create directory " << baseStr.c_str() << std::endl;
+        rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+        OFStandard::deleteFile(imageFileName);
+        return;
+    }
+
+    OFString fileName;
+    OFStandard::combineDirAndFilename(fileName, baseStr, cbdata->imageFileName, OFTrue);
+    bool moved = OFStandard::renameFile(imageFileName, fileName);
+    // the storage path of a store rule may be on another file system than the partial file
+    if (!moved && storageDir != cbdata->storageDir && OFStandard::copyFile(imageFileName, fileName))
+    {
+        OFStandard::deleteFile(imageFileName);
+        moved = true;
+    }
+    if (!moved)
+    {
+        std::cerr << "cannot write DICOM file " << fileName.c_str() << std::endl;
+        rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+        OFStandard::deleteFile(imageFileName);
+        return;
+    }
+    std::string error;
+    if (!StorageArea::stored(fileName.c_str(), error))
+    {
+        DCMNET_ERROR("cannot hand DICOM file " << fileName << " to the storage backend: " << error);
+        rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+        OFStandard::deleteFile(fileName);
+        return;
+    }
+    // the queued file is a link to the file as received
+    if (!forwardInstance(cbdata, sopClass, dcmff.getDataset(), fileName, dcmff.getDataset()->getOriginalXfer(), false))
+    {
+        rsp->DimseStatus = STATUS_STORE_Refused_OutOfResources;
+        OFStandard::deleteFile(fileName);
+        return;
+    }
+
+    json v = json::object();
+    v["StudyInstanceUID"] = studyInstanceUID.c_str();
+    v["SeriesInstanceUID"] = seriesInstanceUID.c_str();
+    v["SOPInstanceUID"] = sopInstance;
+    v["Filepath"] = fileName.c_str();
+    // only attributes up to the pixel data have been parsed
+    json attributes = projectAttributes(cbdata, dcmff.getDataset());
+    if (!attributes.is_null()) v["Attributes"] = attributes;
+    sendStored(cbdata, v);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+OFCondition RetrieveScp::echoSCP(T_ASC_Association* assoc, T_DIMSE_Message* msg, T_ASC_PresentationContextID presID)
+{
+    // assign the actual information of the C-Echo-RQ command to a local variable
+    T_DIMSE_C_EchoRQ* req = &msg->msg.CEchoRQ;
+
+    /* the echo succeeded !! */
+    OFCondition cond = DIMSE_sendEchoResponse(assoc, presID, req, STATUS_Success, NULL);
+    return cond;
+}
+    
+// ------------------------------------------------------------------------------------------------------------
+
+OFCondition RetrieveScp::storeSCP(T_ASC_Association* assoc, T_DIMSE_Message* msg, T_ASC_PresentationContextID presID, const OFString& outputDirectory, const BaseAsyncWorker::ExecutionProgress& progress)
+{
+    OFCondition cond = EC_Normal;
+    T_DIMSE_C_StoreRQ* req;
+    char imageFileName[2048];
+
+    // assign the actual information of the C-STORE-RQ command to a local variable
+    req = &msg->msg.CStoreRQ;
+    OFTraceContext traceContext(0, req->AffectedSOPInstanceUID);
+    OFTraceSpan span("store.receive");
+
+    // relayed to the proxy destinations as it arrives, neither written nor reported
+    if (StoreProxy::isConfigured())
+    {
+        return StoreProxy::relay(assoc, presID, req, dimseBlockMode(), m_dimseTimeout);
+    }
+
+    // format output
+    sprintf(imageFileName, "%s.%s", req->AffectedSOPInstanceUID, "dcm");
+
+    // initialize some variables
+    StoreCallbackData callbackData;
+    callbackData.assoc = assoc;
+    callbackData.imageFileName = m_writeFile ? imageFileName : NULL;
+    callbackData.storageDir = outputDirectory;
+    // shared with the I/O thread writing the file
+    callbackData.dcmff = std::make_shared<DcmFileFormat>();
+    callbackData.progress = &progress;
+    callbackData.worker = m_worker;
+    callbackData.binaryBuffer = m_binaryBuffer;
+    callbackData.refuseOverBudget = m_refuseOverBudget;
+    callbackData.shardDigits = m_shardDigits;
+    callbackData.eventTags = &m_eventTags;
+    callbackData.storeRules = &m_storeRules;
+    callbackData.series = &m_series;
+    callbackData.seriesEventsOnly = m_seriesEventsOnly;
+    callbackData.receivedBytes = 0;
+    callbackData.receiveSeconds = 0;
+
+    if (m_writeFile && m_streamToFile)
+    {
+        // receive into a partial file next to the study directories, it is renamed when complete
+        OFString partFileName;
+        OFStandard::combineDirAndFilename(partFileName, outputDirectory, OFString(imageFileName) + ".part", OFTrue);
+        cond = DIMSE_storeProvider(assoc, presID, req, partFileName.c_str(), OFTrue, NULL, storeSCPFileCallback, &callbackData, dimseBlockMode(), m_dimseTimeout);
+        addReceived(assoc, callbackData.receivedBytes, callbackData.receiveSeconds);
+        return cond;
+    }
+
+    // define an address where the information which will be received over the network will be stored
+    DcmDataset* dset = callbackData.dcmff->getDataset();
+
+    // elements created while receiving are allocated from the arena, it lives until the
+    // dataset has been released by the I/O thread
+    std::unique_ptr<DcmArenaScope> arena;
+    if (m_arenaAllocation)
+        arena.reset(new DcmArenaScope());
+
+    cond = DIMSE_storeProvider(assoc, presID, req, NULL, OFTrue, &dset, storeSCPCallback, &callbackData, dimseBlockMode(), m_dimseTimeout);
+    addReceived(assoc, callbackData.receivedBytes, callbackData.receiveSeconds);
+
+    // if some error occurred, dump corresponding information and remove the outfile if necessary
+    if (cond.bad())
+    {
+        std::cerr << "Store SCP failed: " << cond.text() << std::endl;
+
+        // remove file
+        if (strcmp(imageFileName, NULL_DEVICE_NAME) != 0)
+            OFStandard::deleteFile(imageFileName);
+    }
+    return cond;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+namespace {
+
+    // poll interval of the storeOnly event loop without wakeup sockets (ms)
+    const int fallbackPollInterval = 50;
+
+    // processing of an association ends on release, abort or any other error
+    bool associationOpen(const OFCondition& cond)
+    {
+        return cond == EC_Normal || cond == DIMSE_NODATAAVAILABLE || cond == DIMSE_OUTOFRESOURCES;
+    }
+
+    OFCondition freeAssociation(T_ASC_Association* assoc)
+    {
+        OFCondition cond = ASC_dropSCPAssociation(assoc);
+        if (cond.bad())
+        {
+            std::cerr << cond.text() << std::endl;
+            return cond;
+        }
+        cond = ASC_destroyAssociation(&assoc);
+        if (cond.bad())
+        {
+            std::cerr << cond.text() << std::endl;
+        }
+        return cond;
+    }
+
+    // trace numbers of the associations being served, the commands of an association may be
+    // processed by different threads of the event loop
+    std::mutex traceMutex;
+    std::unordered_map<const T_ASC_Association*, Uint64> traceAssociations;
+
+    void beginTraceAssociation(const T_ASC_Association* assoc)
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        traceAssociations[assoc] = OFTrace::nextAssociation();
+    }
+
+    void endTraceAssociation(const T_ASC_Association* assoc)
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        traceAssociations.erase(assoc);
+    }
+
+    Uint64 traceAssociation(const T_ASC_Association* assoc)
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        std::unordered_map<const T_ASC_Association*, Uint64>::const_iterator it = traceAssociations.find(assoc);
+        return it != traceAssociations.end() ? it->second : 0;
+    }
+
+    DcmNativeSocketType associationSocket(T_ASC_Association* assoc)
+    {
+        DcmTransportConnection* connection = DUL_getTransportConnection(assoc->DULassociation);
+        return connection != NULL ? connection->getSocket() : DCMNET_INVALID_SOCKET;
+    }
+
+    void closeSocket(DcmNativeSocketType s)
+    {
+        if (s == DCMNET_INVALID_SOCKET) {
+            return;
+        }
+#ifdef _WIN32
+        closesocket(s);
+#else
+        close(s);
+#endif
+    }
+
+    // a connected pair of loopback sockets, a byte written to the second one ends a poll on the first
+    bool createWakeupSockets(DcmNativeSocketType sockets[2])
+    {
+        sockets[0] = sockets[1] = DCMNET_INVALID_SOCKET;
+        DcmNativeSocketType listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener == DCMNET_INVALID_SOCKET) {
+            return false;
+        }
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t length = sizeof(addr);
+        bool ok = bind(listener, OFreinterpret_cast(struct sockaddr*, &addr), sizeof(addr)) == 0
+            && listen(listener, 1) == 0
+            && getsockname(listener, OFreinterpret_cast(struct sockaddr*, &addr), &length) == 0;
+        if (ok) {
+            sockets[1] = socket(AF_INET, SOCK_STREAM, 0);
+            ok = sockets[1] != DCMNET_INVALID_SOCKET
+                && connect(sockets[1], OFreinterpret_cast(struct sockaddr*, &addr), sizeof(addr)) == 0;
+        }
+        if (ok) {
+            sockets[0] = accept(listener, NULL, NULL);
+            ok = sockets[0] != DCMNET_INVALID_SOCKET;
+        }
+        closeSocket(listener);
+        if (!ok) {
+            closeSocket(sockets[0]);
+            closeSocket(sockets[1]);
+            sockets[0] = sockets[1] = DCMNET_INVALID_SOCKET;
+        }
+        return ok;
+    }
+
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+// serves the negotiated associations of the storeOnly SCP. Idle associations wait in a single poll set,
+// a fixed number of threads process the ones with pending data and hand them back once the peer has
+// nothing more to send, so idle or slow peers do not hold up the others. With the "spread" placement of
+// "association" the threads form a pool per NUMA node and each association stays with the pool it
+// was assigned to, so its datasets are received, parsed and stored by threads of one node.
+class StoreAssociationReactor
+{
+public:
+    // receives and handles one command of an association
+    typedef std::function<OFCondition(T_ASC_Association*)> CommandHandler;
+
+    // releases or aborts an association once processing ended with cond, and frees it
+    typedef std::function<void(T_ASC_Association*, OFCondition)> FinishHandler;
+
+    StoreAssociationReactor(size_t threads, const CommandHandler& onCommand, const FinishHandler& onFinish)
+        : m_onCommand(onCommand), m_onFinish(onFinish), m_stopping(false)
+    {
+        if (!createWakeupSockets(m_wakeup)) {
+            DCMNET_WARN("cannot create wakeup sockets, new associations are polled every " << fallbackPollInterval << " ms");
+        }
+        // the verbosity of the SCP request applies to its associations
+        const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+        m_poller = std::thread([this, logLevel]() { OFLog::setThreadLogLevel(logLevel); poll(); });
+        // the pools are complete before the threads run, associations may arrive before
+        std::vector<int> nodes;
+        for (size_t i = 0; i < threads; ++i) {
+            nodes.push_back(CpuPlacement::assign("association"));
+            m_pools[nodes.back()];
+        }
+        for (int node : nodes) {
+            sPool* pool = &m_pools[node];
+            m_workers.push_back(std::thread([this, logLevel, node, pool]() {
+                OFLog::setThreadLogLevel(logLevel);
+                CpuPlacement::bind(node);
+                work(*pool);
+                CpuPlacement::release("association", node);
+            }));
+        }
+    }
+
+    // associations still open are aborted
+    ~StoreAssociationReactor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            wakeup();
+        }
+        for (auto& pool : m_pools) {
+            pool.second.readyChanged.notify_all();
+        }
+        m_poller.join();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+        for (auto& pool : m_pools) {
+            for (T_ASC_Association* assoc : pool.second.ready) {
+                m_onFinish(assoc, ASC_SHUTDOWNAPPLICATION);
+            }
+        }
+        for (T_ASC_Association* assoc : m_idle) {
+            m_onFinish(assoc, ASC_SHUTDOWNAPPLICATION);
+        }
+        closeSocket(m_wakeup[0]);
+        closeSocket(m_wakeup[1]);
+    }
+
+    // takes over a negotiated association
+    void add(T_ASC_Association* assoc)
+    {
+        sPool* pool = NULL;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // the pool with the fewest associations
+            for (auto& p : m_pools) {
+                if (pool == NULL || p.second.associations < pool->associations) {
+                    pool = &p.second;
                 }
-                else if (strcmp(sopInstance, req->AffectedSOPInstanceUID) != 0)
-                {
-                    rsp->DimseStatus = STATUS_STORE_Error_DataSetDoesNotMatchSOPClass;
+            }
+            ++pool->associations;
+            m_poolOf[assoc] = pool;
+            // usually the first command is about to arrive, a worker hands it to the poller otherwise
+            pool->ready.push_back(assoc);
+        }
+        pool->readyChanged.notify_one();
+    }
+
+private:
+    // the threads of a node and the associations assigned to it
+    struct sPool {
+        sPool() : associations(0) {}
+        std::condition_variable readyChanged;
+        // associations with pending data, waiting for a worker
+        std::deque<T_ASC_Association*> ready;
+        size_t associations;
+    };
+
+    // called with m_mutex held
+    void wakeup()
+    {
+        if (m_wakeup[1] != DCMNET_INVALID_SOCKET) {
+            char byte = 0;
+            (void) send(m_wakeup[1], &byte, 1, 0);
+        }
+    }
+
+    void poll()
+    {
+        const bool wakeable = m_wakeup[0] != DCMNET_INVALID_SOCKET;
+        const size_t first = wakeable ? 1 : 0;
+        std::vector<struct pollfd> fds;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping) {
+            // m_idle only grows while unlocked, the first count entries are the ones polled
+            const size_t count = m_idle.size();
+            fds.clear();
+            struct pollfd pfd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (wakeable) {
+                pfd.fd = m_wakeup[0];
+                fds.push_back(pfd);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                pfd.fd = associationSocket(m_idle[i]);
+                fds.push_back(pfd);
+            }
+            lock.unlock();
+
+#ifdef _WIN32
+            int found = fds.empty() ? 0 : WSAPoll(&fds[0], OFstatic_cast(ULONG, fds.size()), wakeable ? -1 : fallbackPollInterval);
+#else
+            int found = fds.empty() ? 0 : ::poll(&fds[0], OFstatic_cast(nfds_t, fds.size()), wakeable ? -1 : fallbackPollInterval);
+#endif
+            if (fds.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(fallbackPollInterval));
+            }
+            if (found > 0 && wakeable && fds[0].revents != 0) {
+                char buf[256];
+                (void) recv(m_wakeup[0], buf, sizeof(buf), 0);
+            }
+
+            lock.lock();
+            if (found <= 0) {
+                continue;
+            }
+            std::vector<T_ASC_Association*> idle;
+            for (size_t i = 0; i < m_idle.size(); ++i) {
+                // readable, closed or failed, the command handler tells which
+                if (i < count && fds[first + i].revents != 0) {
+                    sPool* pool = m_poolOf[m_idle[i]];
+                    pool->ready.push_back(m_idle[i]);
+                    pool->readyChanged.notify_one();
+                }
+                else {
+                    idle.push_back(m_idle[i]);
                 }
             }
+            m_idle.swap(idle);
         }
-        else {
-            std::cerr << "dataset is NULL" << std::endl;
+    }
+
+    void work(sPool& pool)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            pool.readyChanged.wait(lock, [this, &pool] { return m_stopping || !pool.ready.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            T_ASC_Association* assoc = pool.ready.front();
+            pool.ready.pop_front();
+            lock.unlock();
+
+            // process commands as long as the peer keeps sending
+            OFCondition cond = EC_Normal;
+            while (associationOpen(cond) && ASC_dataWaiting(assoc, 0)) {
+                cond = m_onCommand(assoc);
+            }
+
+            lock.lock();
+            if (associationOpen(cond) && !m_stopping) {
+                m_idle.push_back(assoc);
+                wakeup();
+                continue;
+            }
+            --pool.associations;
+            m_poolOf.erase(assoc);
+            lock.unlock();
+            m_onFinish(assoc, associationOpen(cond) ? OFCondition(ASC_SHUTDOWNAPPLICATION) : cond);
+            lock.lock();
         }
     }
-}
-    
-// ------------------------------------------------------------------------------------------------------------
 
-OFCondition RetrieveScp::echoSCP(T_ASC_Association* assoc, T_DIMSE_Message* msg, T_ASC_PresentationContextID presID)
-{
-    // assign the actual information of the C-Echo-RQ command to a local variable
-    T_DIMSE_C_EchoRQ* req = &msg->msg.CEchoRQ;
+    CommandHandler m_onCommand;
+    FinishHandler m_onFinish;
+    DcmNativeSocketType m_wakeup[2];
+    std::mutex m_mutex;
+    // by node, -1 for threads left to the scheduler. Not changed once the threads run
+    std::map<int, sPool> m_pools;
+    std::unordered_map<T_ASC_Association*, sPool*> m_poolOf;
+    // associations waiting for data
+    std::vector<T_ASC_Association*> m_idle;
+    bool m_stopping;
+    std::thread m_poller;
+    std::vector<std::thread> m_workers;
+};
 
-    /* the echo succeeded !! */
-    OFCondition cond = DIMSE_sendEchoResponse(assoc, presID, req, STATUS_Success, NULL);
-    return cond;
-}
-    
 // ------------------------------------------------------------------------------------------------------------
 
-OFCondition RetrieveScp::storeSCP(T_ASC_Association* assoc, T_DIMSE_Message* msg, T_ASC_PresentationContextID presID, const OFString& outputDirectory, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress)
+// serves the associations of the storeOnly SCP on the dcmnet SCP pool: each received association is
+// negotiated and processed by a worker thread of its own, up to a maximum number of threads. Further
+// associations wait in a bounded queue for the next worker becoming available or are rejected.
+class StoreSCPPool : public DcmBaseSCPPool
 {
-    OFCondition cond = EC_Normal;
-    T_DIMSE_C_StoreRQ* req;
-    char imageFileName[2048];
+public:
+    // negotiates, processes and frees an association
+    typedef std::function<OFCondition(T_ASC_Association*)> AssociationHandler;
 
-    // assign the actual information of the C-STORE-RQ command to a local variable
-    req = &msg->msg.CStoreRQ;
+    StoreSCPPool(Uint16 threads, Uint16 queueSize, const AssociationHandler& onAssociation)
+        : m_onAssociation(onAssociation), m_sharedConfig(getConfig())
+    {
+        setMaxThreads(threads);
+        setMaxQueuedAssociations(queueSize);
+    }
 
-    // format output
-    sprintf(imageFileName, "%s.%s", req->AffectedSOPInstanceUID, "dcm");
+    // waits for the workers to finish their associations, queued ones are rejected
+    ~StoreSCPPool()
+    {
+        joinWorkers();
+    }
 
-    // initialize some variables
-    StoreCallbackData callbackData;
-    callbackData.assoc = assoc;
-    callbackData.imageFileName = m_writeFile ? imageFileName : NULL;
-    callbackData.storageDir = outputDirectory;
-    DcmFileFormat dcmff;
-    callbackData.dcmff = &dcmff;
-    callbackData.progress = const_cast<Napi::AsyncProgressQueueWorker<char>::ExecutionProgress*>(&progress);
+    // hands a received association to a worker or the queue, rejects and frees it if both are full
+    bool run(T_ASC_Association* assoc)
+    {
+        OFCondition cond = runAssociation(assoc, m_sharedConfig);
+        if (cond.bad())
+        {
+            DCMNET_WARN("rejecting association: " << cond.text());
+            rejectAssociation(assoc, cond == NET_EC_SCPBusy ? ASC_REASON_SP_PRES_LOCALLIMITEXCEEDED : ASC_REASON_SP_PRES_TEMPORARYCONGESTION);
+            dropAndDestroyAssociation(assoc);
+            return false;
+        }
+        return true;
+    }
 
-    // define an address where the information which will be received over the network will be stored
-    DcmDataset* dset = dcmff.getDataset();
+protected:
+    class Worker : public DcmBaseSCPPool::DcmBaseSCPWorker
+    {
+    public:
+        explicit Worker(StoreSCPPool& pool)
+            : DcmBaseSCPWorker(pool), m_onAssociation(pool.m_onAssociation), m_busy(false) {}
 
-    cond = DIMSE_storeProvider(assoc, presID, req, NULL, OFTrue, &dset, storeSCPCallback, &callbackData, DIMSE_BLOCKING, 0);
+        // the presentation contexts are negotiated by the handler
+        virtual OFCondition setSharedConfig(const DcmSharedSCPConfig& /*config*/) { return EC_Normal; }
 
-    // if some error occurred, dump corresponding information and remove the outfile if necessary
-    if (cond.bad())
+        virtual OFBool busy() { return m_busy; }
+
+    protected:
+        virtual OFCondition workerListen(T_ASC_Association* const assoc)
+        {
+            // the association is served on the node the "association" placement assigns
+            CpuPlacement::Scope placement("association");
+            m_busy = true;
+            OFCondition cond = m_onAssociation(assoc);
+            m_busy = false;
+            return cond;
+        }
+
+    private:
+        AssociationHandler m_onAssociation;
+        OFBool m_busy;
+    };
+
+    virtual DcmBaseSCPWorker* createSCPWorker()
     {
-        std::cerr << "Store SCP failed: " << cond.text() << std::endl;
+        return new Worker(*this);
+    }
 
-        // remove file
-        if (strcmp(imageFileName, NULL_DEVICE_NAME) != 0)
-            OFStandard::deleteFile(imageFileName);
+private:
+    AssociationHandler m_onAssociation;
+    DcmSharedSCPConfig m_sharedConfig;
+};
+
+// ------------------------------------------------------------------------------------------------------------
+
+OFCondition RetrieveScp::processCommands(T_ASC_Association* assoc, const OFString& outputDirectory, const BaseAsyncWorker::ExecutionProgress& progress)
+{
+    OFCondition cond = EC_Normal;
+
+    // start a loop to be able to receive more than one DIMSE command, a peer that
+    // sends nothing within the DIMSE timeout is aborted
+    while (associationOpen(cond))
+    {
+        cond = processCommand(assoc, outputDirectory, progress);
+        if (cond == DIMSE_NODATAAVAILABLE)
+        {
+            break;
+        }
     }
     return cond;
 }
 
 // ------------------------------------------------------------------------------------------------------------
 
-OFCondition RetrieveScp::processCommands(T_ASC_Association* assoc, const OFString& outputDirectory, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress)
+OFCondition RetrieveScp::processCommand(T_ASC_Association* assoc, const OFString& outputDirectory, const BaseAsyncWorker::ExecutionProgress& progress)
 {
     OFCondition cond = EC_Normal;
     T_DIMSE_Message msg;
     T_ASC_PresentationContextID presID = 0;
     DcmDataset* statusDetail = NULL;
+    OFTraceContext traceContext(OFTrace::enabled() ? traceAssociation(assoc) : 0);
 
-    // start a loop to be able to receive more than one DIMSE command
-    while (cond == EC_Normal || cond == DIMSE_NODATAAVAILABLE || cond == DIMSE_OUTOFRESOURCES)
+    // receive a DIMSE command over the network
+    cond = DIMSE_receiveCommand(assoc, dimseBlockMode(), m_dimseTimeout, &presID, &msg, &statusDetail);
+
+    // if the command which was received has extra status
+    // detail information, dump this information
+    if (statusDetail != NULL)
     {
-        // receive a DIMSE command over the network
-        cond = DIMSE_receiveCommand(assoc, DIMSE_BLOCKING, 0, &presID, &msg, &statusDetail);
+        // OFLOG_DEBUG(storescpLogger, "Status Detail:" << OFendl << DcmObject::PrintHelper(*statusDetail));
+        delete statusDetail;
+    }
 
-        // if the command which was received has extra status
-        // detail information, dump this information
-        if (statusDetail != NULL)
+    // check if peer did release or abort, or if we have a valid message
+    if (cond == EC_Normal)
+    {
+        // not idle while the command is handled, however long its dataset takes
+        markAssociation(assoc, true);
+        // in case we received a valid message, process this command
+        // note that storescp can only process a C-ECHO-RQ and a C-STORE-RQ
+        switch (msg.CommandField)
+        {
+        case DIMSE_C_ECHO_RQ:
+            // process C-ECHO-Request
+            cond = echoSCP(assoc, &msg, presID);
+            break;
+        case DIMSE_C_STORE_RQ:
         {
-            // OFLOG_DEBUG(storescpLogger, "Status Detail:" << OFendl << DcmObject::PrintHelper(*statusDetail));
-            delete statusDetail;
+            // process C-STORE-Request
+            Metrics::Timer timer(Metrics::histogram("scp_operation_seconds", {{"scp", "store"}, {"operation", "store"}}));
+            cond = storeSCP(assoc, &msg, presID, outputDirectory, progress);
+            Metrics::counter("scp_operations_total", {{"scp", "store"}, {"operation", "store"}, {"result", cond.good() ? "success" : "failure"}}).add();
+            break;
         }
+        default:
+            OFString tempStr;
+            // we cannot handle this kind of message
+            cond = DIMSE_BADCOMMANDTYPE;
+            std::cerr << "unsupported DIMSE command received" << std::endl;
+            break;
+        }
+        markAssociation(assoc, false);
+    }
+    return cond;
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+void RetrieveScp::addReceived(T_ASC_Association* assoc, Uint64 bytes, double seconds)
+{
+    if (bytes == 0)
+    {
+        return;
+    }
+    const char* callingAETitle = assoc->params->DULparams.callingAPTitle;
+    const char* callingHost = assoc->params->DULparams.callingPresentationAddress;
+    if (m_config != NULL)
+    {
+        m_config->transferCompleted(callingAETitle, callingHost, bytes, seconds);
+    }
+    else
+    {
+        TransferPolicy::recordTransfer(TransferPolicy::hostOf(callingHost), bytes, seconds);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+bool RetrieveScp::admitAssociation(T_ASC_Association* assoc)
+{
+    if (m_config == NULL || m_config->admitAssociation(assoc->params->DULparams.callingAPTitle, assoc->params->DULparams.callingPresentationAddress))
+    {
+        return true;
+    }
+    DCMNET_INFO("Refusing association of " << assoc->params->DULparams.callingPresentationAddress << ":"
+        << assoc->params->DULparams.callingAPTitle << ", limits of the peer exceeded");
+    T_ASC_RejectParameters rej =
+    {
+        ASC_RESULT_REJECTEDTRANSIENT,
+        ASC_SOURCE_SERVICEPROVIDER_PRESENTATION_RELATED,
+        ASC_REASON_SP_PRES_LOCALLIMITEXCEEDED };
+    OFCondition cond = ASC_rejectAssociation(assoc, &rej);
+    if (cond.bad())
+    {
+        std::cerr << cond.text() << std::endl;
+    }
+    return false;
+}
+
+void RetrieveScp::releaseAssociation(T_ASC_Association* assoc)
+{
+    if (m_config != NULL)
+    {
+        m_config->associationReleased(assoc->params->DULparams.callingAPTitle, assoc->params->DULparams.callingPresentationAddress);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------
 
-        // check if peer did release or abort, or if we have a valid message
-        if (cond == EC_Normal)
+void RetrieveScp::sendSeries(const std::vector<SeriesAggregator::sSeries>& series)
+{
+    for (const SeriesAggregator::sSeries& completed : series)
+    {
+        json instances = json::array();
+        for (const SeriesAggregator::sInstance& instance : completed.instances)
         {
-            // in case we received a valid message, process this command
-            // note that storescp can only process a C-ECHO-RQ and a C-STORE-RQ
-            switch (msg.CommandField)
-            {
-            case DIMSE_C_ECHO_RQ:
-                // process C-ECHO-Request
-                cond = echoSCP(assoc, &msg, presID);
-                break;
-            case DIMSE_C_STORE_RQ:
-                // process C-STORE-Request
-                cond = storeSCP(assoc, &msg, presID, outputDirectory, progress);
-                break;
-            default:
-                OFString tempStr;
-                // we cannot handle this kind of message
-                cond = DIMSE_BADCOMMANDTYPE;
-                std::cerr << "unsupported DIMSE command received" << std::endl;
-                break;
-            }
+            json i = json::object();
+            i["SOPInstanceUID"] = instance.sopInstanceUID;
+            i["Filepath"] = instance.filepath;
+            if (!instance.attributes.is_null()) i["Attributes"] = instance.attributes;
+            instances.push_back(i);
+        }
+        json v = json::object();
+        v["StudyInstanceUID"] = completed.studyInstanceUID;
+        v["SeriesInstanceUID"] = completed.seriesInstanceUID;
+        v["CallingAETitle"] = completed.callingAet;
+        v["Reason"] = completed.reason;
+        v["Instances"] = instances;
+        DCMNET_DEBUG("series " << completed.seriesInstanceUID << " from " << completed.callingAet << " complete ("
+            << completed.reason << "), " << completed.instances.size() << " instances");
+        const json response = ns::createResponse(ns::PENDING, "SERIES_COMPLETE", v);
+        if (m_worker != NULL)
+        {
+            m_worker->SendResponse(response, *m_progress);
+        }
+        else
+        {
+            std::string msg = ns::dumpResponse(response);
+            m_progress->Send(msg.c_str(), msg.length());
         }
     }
-    return cond;
+}
+
+void RetrieveScp::finishSeries()
+{
+    if (m_progress != NULL)
+    {
+        sendSeries(m_series.stop());
+    }
 }
 
 // ------------------------------------------------------------------------------------------------------------
 
-OFCondition RetrieveScp::acceptAssociation(T_ASC_Network* net, DcmAssociationConfiguration& asccfg, OFBool secureConnection, const OFString& outputDirectory, const OFString& aet, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress)
+OFCondition RetrieveScp::finishAssociation(T_ASC_Association* assoc, OFCondition cond)
+{
+    releaseAssociation(assoc);
+    Metrics::gauge("scp_associations", {{"scp", "store"}}).add(-1);
+    endTraceAssociation(assoc);
+    StoreProxy::finish(assoc);
+    sendSeries(m_series.finish(assoc, cond != DUL_PEERREQUESTEDRELEASE));
+    {
+        std::lock_guard<std::mutex> lock(m_openMutex);
+        m_open.erase(assoc);
+    }
+    m_openChanged.notify_all();
+    if (cond == DUL_PEERREQUESTEDRELEASE)
+    {
+        cond = ASC_acknowledgeRelease(assoc);
+    }
+    else if (cond == DUL_PEERABORTEDASSOCIATION)
+    {
+        std::cerr << "Peer aborted association" << std::endl;
+    }
+    else if (cond == ASC_SHUTDOWNAPPLICATION)
+    {
+        /* still open when the SCP stops */
+        cond = ASC_abortAssociation(assoc);
+    }
+    else
+    {
+        /* some kind of error so abort the association */
+        std::cerr << "DIMSE failure (aborting association): " << cond.text() << std::endl;
+
+        cond = ASC_abortAssociation(assoc);
+    }
+    return freeAssociation(assoc);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+OFCondition RetrieveScp::acceptAssociation(T_ASC_Network* net, DcmAssociationConfiguration& asccfg, OFBool secureConnection, const OFString& outputDirectory, const OFString& aet, const BaseAsyncWorker::ExecutionProgress& progress)
 {
-    char buf[BUFSIZ];
     T_ASC_Association* assoc;
     OFCondition cond;
     OFString temp_str;
 
-    const char* knownAbstractSyntaxes[] =
+    // the caller gets to check whether the SCP is to stop every second
+    if (!ASC_associationWaiting(net, 1))
     {
-        UID_VerificationSOPClass };
-
-    const char* transferSyntaxes[] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, // 10
-                                        NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, // 20
-                                        NULL };                                                      // +1
-    int numTransferSyntaxes = 0;
+        return EC_Normal;
+    }
 
-    cond = ASC_receiveAssociation(net, &assoc, ASC_DEFAULTMAXPDU, NULL, NULL, secureConnection);
+    cond = ASC_receiveAssociation(net, &assoc, OFstatic_cast(int, m_maxPDU), NULL, NULL, secureConnection);
 
     // if some kind of error occurred, take care of it
     if (cond.bad())
@@ -342,51 +1669,100 @@ OFCondition RetrieveScp::acceptAssociation(T_ASC_Network* net, DcmAssociationCon
         goto cleanup;
     }
 
-    // accept all ts
-    transferSyntaxes[0] = UID_JPEG2000TransferSyntax;
-    transferSyntaxes[1] = UID_JPEG2000LosslessOnlyTransferSyntax;
-    transferSyntaxes[2] = UID_JPEGProcess2_4TransferSyntax;
-    transferSyntaxes[3] = UID_JPEGProcess1TransferSyntax;
-    transferSyntaxes[4] = UID_JPEGProcess14SV1TransferSyntax;
-    transferSyntaxes[5] = UID_JPEGLSLossyTransferSyntax;
-    transferSyntaxes[6] = UID_JPEGLSLosslessTransferSyntax;
-    transferSyntaxes[7] = UID_RLELosslessTransferSyntax;
-    transferSyntaxes[8] = UID_MPEG2MainProfileAtMainLevelTransferSyntax;
-    transferSyntaxes[9] = UID_MPEG2MainProfileAtHighLevelTransferSyntax;
-    transferSyntaxes[10] = UID_MPEG4HighProfileLevel4_1TransferSyntax;
-    transferSyntaxes[11] = UID_MPEG4BDcompatibleHighProfileLevel4_1TransferSyntax;
-    transferSyntaxes[12] = UID_MPEG4HighProfileLevel4_2_For2DVideoTransferSyntax;
-    transferSyntaxes[13] = UID_MPEG4HighProfileLevel4_2_For3DVideoTransferSyntax;
-    transferSyntaxes[14] = UID_MPEG4StereoHighProfileLevel4_2TransferSyntax;
-    transferSyntaxes[15] = UID_HEVCMainProfileLevel5_1TransferSyntax;
-    transferSyntaxes[16] = UID_HEVCMain10ProfileLevel5_1TransferSyntax;
-    transferSyntaxes[17] = UID_DeflatedExplicitVRLittleEndianTransferSyntax;
-
-    if (gLocalByteOrder == EBO_LittleEndian)
-    {
-        transferSyntaxes[18] = UID_LittleEndianExplicitTransferSyntax;
-        transferSyntaxes[19] = UID_BigEndianExplicitTransferSyntax;
+    /* peers over their rate or concurrency limits are refused before any negotiation */
+    if (!admitAssociation(assoc))
+    {
+        goto cleanup;
     }
-    else {
-        transferSyntaxes[18] = UID_BigEndianExplicitTransferSyntax;
-        transferSyntaxes[19] = UID_LittleEndianExplicitTransferSyntax;
+
+    if (m_pool)
+    {
+        /* a worker of the pool negotiates the association and processes its commands */
+        const OFString callingAETitle = assoc->params->DULparams.callingAPTitle;
+        const OFString callingHost = assoc->params->DULparams.callingPresentationAddress;
+        if (!m_pool->run(assoc) && m_config != NULL)
+        {
+            m_config->associationReleased(callingAETitle.c_str(), callingHost.c_str());
+        }
+        return EC_Normal;
+    }
+
+    cond = negotiateAssociation(assoc, aet);
+    if (cond.bad())
+    {
+        releaseAssociation(assoc);
+        goto cleanup;
     }
-    transferSyntaxes[20] = UID_LittleEndianImplicitTransferSyntax;
-    numTransferSyntaxes = 21;
 
+    if (m_reactor)
+    {
+        /* the event loop processes the commands once the peer sends them */
+        m_reactor->add(assoc);
+        return EC_Normal;
+    }
+
+    /* now do the real work, i.e. receive DIMSE commands over the network connection */
+    /* which was established and handle these commands correspondingly. In case of */
+    /* storescp only C-ECHO-RQ and C-STORE-RQ commands can be processed. */
+    cond = processCommands(assoc, outputDirectory, progress);
+    return finishAssociation(assoc, cond);
+
+cleanup:
+    return freeAssociation(assoc);
+}
+
+// ------------------------------------------------------------------------------------------------------------
+
+OFCondition RetrieveScp::negotiateAssociation(T_ASC_Association* assoc, const OFString& aet)
+{
+    char buf[BUFSIZ];
+    OFCondition cond;
+
+    /* accept the Verification SOP Class and all Storage SOP Classes with the preferred transfer syntax,
+     * or with the one the transfer policy or the configuration of the peer prefers on its link */
+    const char* callingAETitle = assoc->params->DULparams.callingAPTitle;
+    const char* calledAETitle = assoc->params->DULparams.calledAPTitle;
+    const char* callingHost = assoc->params->DULparams.callingPresentationAddress;
+
+    /* peers the store rules reject as a whole are rejected before any negotiation */
+    if (m_storeRules.rejectsAssociation(callingAETitle, calledAETitle, callingHost))
     {
-        /* accept the Verification SOP Class if presented */
-        cond = ASC_acceptContextsWithPreferredTransferSyntaxes(assoc->params, knownAbstractSyntaxes, DIM_OF(knownAbstractSyntaxes), transferSyntaxes, numTransferSyntaxes);
+        T_ASC_RejectParameters rej =
+        {
+            ASC_RESULT_REJECTEDPERMANENT,
+            ASC_SOURCE_SERVICEUSER,
+            ASC_REASON_SU_CALLINGAETITLENOTRECOGNIZED };
+        cond = ASC_rejectAssociation(assoc, &rej);
         if (cond.bad())
         {
-            goto cleanup;
+            std::cerr << cond.text() << std::endl;
+            return cond;
         }
+        return DUL_ASSOCIATIONREJECTED;
+    }
 
-        /* the array of Storage SOP Class UIDs comes from dcuid.h */
-        cond = ASC_acceptContextsWithPreferredTransferSyntaxes(assoc->params, dcmAllStorageSOPClassUIDs, numberOfDcmAllStorageSOPClassUIDs, transferSyntaxes, numTransferSyntaxes);
-        if (cond.bad())
+    const DcmQueryRetrieveConfig* config = m_config;
+    cond = NegotiationTable::instance().accept(assoc->params, [config, callingAETitle, callingHost](const char* sopClass) {
+        return config != NULL ? config->preferCompressed(callingAETitle, callingHost, sopClass)
+            : TransferPolicy::preferCompressed(TransferPolicy::hostOf(callingHost), callingAETitle, sopClass);
+    });
+    if (cond.bad())
+    {
+        return cond;
+    }
+
+    /* the SOP classes the store rules reject whatever the attributes of their instances are not accepted at all */
+    if (m_storeRules.isConfigured())
+    {
+        const int count = ASC_countPresentationContexts(assoc->params);
+        for (int i = 0; i < count; i++)
         {
-            goto cleanup;
+            T_ASC_PresentationContext pc;
+            if (ASC_getPresentationContext(assoc->params, i, &pc).good() && pc.resultReason == ASC_P_ACCEPTANCE
+                && m_storeRules.rejectsSopClass(callingAETitle, calledAETitle, callingHost, pc.abstractSyntax))
+            {
+                ASC_refusePresentationContext(assoc->params, pc.presentationContextID, ASC_P_USERREJECTION);
+            }
         }
     }
 
@@ -410,58 +1786,124 @@ OFCondition RetrieveScp::acceptAssociation(T_ASC_Network* net, DcmAssociationCon
         if (cond.bad())
         {
             std::cerr << cond.text() << std::endl;
+            return cond;
         }
-        goto cleanup;
+        return DUL_ASSOCIATIONREJECTED;
     }
-    else
+
+    cond = ASC_acknowledgeAssociation(assoc);
+    if (cond.bad())
     {
-        cond = ASC_acknowledgeAssociation(assoc);
-        if (cond.bad())
-        {
-            std::cerr << cond.text() << std::endl;
-            goto cleanup;
-        }
+        std::cerr << cond.text() << std::endl;
+        return cond;
     }
+    // released again in finishAssociation()
+    Metrics::gauge("scp_associations", {{"scp", "store"}}).add(1);
+    Metrics::counter("scp_associations_total", {{"scp", "store"}}).add();
+    beginTraceAssociation(assoc);
+    std::lock_guard<std::mutex> lock(m_openMutex);
+    m_open[assoc] = std::chrono::steady_clock::now();
+    return cond;
+}
 
-    /* now do the real work, i.e. receive DIMSE commands over the network connection */
-    /* which was established and handle these commands correspondingly. In case of */
-    /* storescp only C-ECHO-RQ and C-STORE-RQ commands can be processed. */
-    cond = processCommands(assoc, outputDirectory, progress);
 
-    if (cond == DUL_PEERREQUESTEDRELEASE)
+OFCondition RetrieveScp::waitForAssociation(T_ASC_Network* theNet, const BaseAsyncWorker::ExecutionProgress& progress)
+{
+    m_progress = &progress;
+    if (m_poolThreads > 0 && !m_pool)
     {
-        cond = ASC_acknowledgeRelease(assoc);
+        // progress outlives the SCP, it belongs to the worker's Execute()
+        const BaseAsyncWorker::ExecutionProgress* executionProgress = &progress;
+        m_pool = std::make_shared<StoreSCPPool>(m_poolThreads, m_poolQueueSize,
+            [this, executionProgress](T_ASC_Association* assoc) {
+                OFCondition cond = negotiateAssociation(assoc, m_aet);
+                if (cond.bad())
+                {
+                    releaseAssociation(assoc);
+                    return freeAssociation(assoc);
+                }
+                return finishAssociation(assoc, processCommands(assoc, m_outputDirectory, *executionProgress));
+            });
     }
-    else if (cond == DUL_PEERABORTEDASSOCIATION)
+    else if (m_poolThreads == 0 && m_eventLoopThreads > 0 && !m_reactor)
     {
-        std::cerr << "Peer aborted association" << std::endl;
+        // progress outlives the SCP, it belongs to the worker's Execute()
+        const BaseAsyncWorker::ExecutionProgress* executionProgress = &progress;
+        m_reactor = std::make_shared<StoreAssociationReactor>(m_eventLoopThreads,
+            [this, executionProgress](T_ASC_Association* assoc) {
+                return processCommand(assoc, m_outputDirectory, *executionProgress);
+            },
+            [this](T_ASC_Association* assoc, OFCondition cond) {
+                finishAssociation(assoc, cond);
+            });
     }
-    else
-    {
-        /* some kind of error so abort the association */
-        std::cerr << "DIMSE failure (aborting association): " << cond.text() << std::endl;
+    reapIdleAssociations();
+    sendSeries(m_series.quiet());
+    return acceptAssociation(theNet, asccfg, m_secureConnection, m_outputDirectory, m_aet, progress);
+}
 
-        cond = ASC_abortAssociation(assoc);
-    }
+// ------------------------------------------------------------------------------------------------------------
 
-cleanup:
-    cond = ASC_dropSCPAssociation(assoc);
-    if (cond.bad())
+void RetrieveScp::markAssociation(T_ASC_Association* assoc, bool busy)
+{
+    if (m_idleTimeout <= 0)
     {
-        std::cerr << cond.text() << std::endl;
-        return cond;
+        return;
     }
-    cond = ASC_destroyAssociation(&assoc);
-    if (cond.bad())
+    std::lock_guard<std::mutex> lock(m_openMutex);
+    std::unordered_map<T_ASC_Association*, std::chrono::steady_clock::time_point>::iterator it = m_open.find(assoc);
+    if (it != m_open.end())
     {
-        std::cerr << cond.text() << std::endl;
+        it->second = busy ? std::chrono::steady_clock::time_point::max() : std::chrono::steady_clock::now();
     }
+}
 
-    return cond;
+void RetrieveScp::reapIdleAssociations()
+{
+    if (m_idleTimeout <= 0)
+    {
+        return;
+    }
+    const std::chrono::steady_clock::time_point idleSince = std::chrono::steady_clock::now() - std::chrono::milliseconds(m_idleTimeout);
+    std::lock_guard<std::mutex> lock(m_openMutex);
+    for (auto& open : m_open)
+    {
+        if (open.second > idleSince)
+        {
+            continue;
+        }
+        DCMNET_INFO("aborting association of " << open.first->params->DULparams.callingPresentationAddress << ":"
+            << open.first->params->DULparams.callingAPTitle << ", no command for " << m_idleTimeout << " ms");
+        Metrics::counter("scp_idle_aborted_total", {{"scp", "store"}}).add();
+        // its thread or the event loop fails reading and finishes it, it is not reaped twice meanwhile
+        DcmTransportConnection* connection = DUL_getTransportConnection(open.first->DULassociation);
+        if (connection != NULL)
+        {
+            connection->interrupt();
+        }
+        open.second = std::chrono::steady_clock::time_point::max();
+    }
 }
 
+// ------------------------------------------------------------------------------------------------------------
 
-OFCondition RetrieveScp::waitForAssociation(T_ASC_Network* theNet, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress)
+bool RetrieveScp::drain(int timeout)
 {
-    return acceptAssociation(theNet, asccfg, false, m_outputDirectory, m_aet, progress);
-}
\ No newline at end of file
+    std::unique_lock<std::mutex> lock(m_openMutex);
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+    if (m_openChanged.wait_until(lock, deadline, [this] { return m_open.empty(); }))
+    {
+        return true;
+    }
+    DCMNET_WARN("interrupting " << m_open.size() << " associations still open after " << timeout << " ms");
+    // their threads fail reading or writing and finish them, the reactor and pool are joined afterwards
+    for (auto& open : m_open)
+    {
+        DcmTransportConnection* connection = DUL_getTransportConnection(open.first->DULassociation);
+        if (connection != NULL)
+        {
+            connection->interrupt();
+        }
+    }
+    return false;
+}
@@ -1,34 +1,197 @@
 #pragma once
 
-#include <napi.h>
+#include "BaseAsyncWorker.h"
+#include "SeriesAggregator.h"
+#include "StoreRules.h"
 
 #include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
 #include "dcmtk/ofstd/oftypes.h"
 #include "dcmtk/dcmnet/assoc.h"
 #include "dcmtk/dcmnet/dimse.h"
 #include "dcmtk/dcmnet/dcasccfg.h"
+#include "dcmtk/dcmdata/dcxfer.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class DcmFileFormat;
+class DcmQueryRetrieveConfig;
+class StoreAssociationReactor;
+class StoreSCPPool;
+
+// writes received datasets on a pool of I/O threads, so that slow storage does not hold up the network
+class StoreWriteQueue
+{
+public:
+    enum eDurability {
+        // a store is acknowledged once queued, write errors are only logged
+        QUEUED,
+        // a store is acknowledged once the file is written
+        WRITTEN,
+        // a store is acknowledged once the file is flushed to the device
+        SYNCED
+    };
+
+    // settings are taken over by I/O threads started afterwards
+    static void configure(size_t threads, eDurability durability);
+
+    // writes the file, creating its directory below storageDir if needed
+    static OFCondition write(const std::shared_ptr<DcmFileFormat>& dcmff, const OFString& directory, const OFString& storageDir, const OFString& fileName, E_TransferSyntax xfer);
+
+    // waits until all files queued so far are written, including those acknowledged once queued
+    static void flush();
+};
 
 class RetrieveScp 
 {
 public:
-    RetrieveScp(const OFString& outputDirectory, const OFString& aet, bool writeFile) : m_outputDirectory(outputDirectory), m_aet(aet), m_writeFile(writeFile) {}
+    RetrieveScp(const OFString& outputDirectory, const OFString& aet, bool writeFile, bool binaryBuffer = false, BaseAsyncWorker* worker = NULL)
+        : m_outputDirectory(outputDirectory), m_aet(aet), m_writeFile(writeFile), m_binaryBuffer(binaryBuffer && worker != NULL), m_streamToFile(false), m_arenaAllocation(false), m_refuseOverBudget(false), m_seriesEventsOnly(false), m_shardDigits(0), m_maxPDU(ASC_DEFAULTMAXPDU), m_dimseTimeout(0), m_idleTimeout(0), m_eventLoopThreads(0), m_poolThreads(0), m_poolQueueSize(0), m_secureConnection(OFFalse), m_config(NULL), m_worker(worker), m_progress(NULL) {}
+
+    // accepts and serves the next association, returns EC_Normal after a second without one
+    OFCondition waitForAssociation(T_ASC_Network* theNet, const BaseAsyncWorker::ExecutionProgress& progress);
+
+    // waits up to timeout ms for the open associations of the event loop or pool to end, once
+    // waitForAssociation() is no longer called. The connections of the ones still open are
+    // interrupted, returns false if there were any
+    bool drain(int timeout);
+
+    // sends the series still collected as complete, once waitForAssociation() is no longer called
+    void finishSeries();
+
+    // write received datasets to disk exactly as they arrive instead of parsing and re-encoding them,
+    // only used when files are written
+    void setStreamToFile(bool streamToFile) { m_streamToFile = streamToFile; }
+
+    // allocate the elements of each received dataset from an arena that is freed in one go
+    // once the dataset has been written and its events sent
+    void setArenaAllocation(bool arenaAllocation) { m_arenaAllocation = arenaAllocation; }
+
+    // past the in-flight budget of the worker, answer C-STOREs with Out of Resources instead of
+    // holding back the response (and with it the peer) until JS caught up
+    void setRefuseOverBudget(bool refuse) { m_refuseOverBudget = refuse; }
+
+    // store studies below a directory named after the first hex digits of a hash of the
+    // Study Instance UID (up to 8), 0 stores them directly in the output directory
+    void setShardDigits(int shardDigits) { m_shardDigits = shardDigits; }
+
+    // attributes copied from each received dataset into its storage event, as DICOM JSON
+    void setEventTags(const std::vector<DcmTagKey>& tags) { m_eventTags = tags; }
+
+    // largest PDU accepted from peers, offered in the A-ASSOCIATE-AC
+    void setMaxPDU(Uint32 maxPDU) { m_maxPDU = maxPDU; }
 
-    OFCondition waitForAssociation(T_ASC_Network* theNet, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress);
+    // seconds to wait for the rest of a DIMSE message once it started to arrive, 0 waits forever
+    void setDimseTimeout(int seconds) { m_dimseTimeout = seconds; }
+
+    // ms an association may wait for its next command before it is aborted, 0 keeps idle ones open.
+    // Checked by waitForAssociation(), so it takes up to a second longer
+    void setIdleTimeout(int ms) { m_idleTimeout = ms; }
+
+    // serve associations from an event loop: idle associations wait in a poll set and this many
+    // threads process the ones with pending data. 0 serves one association at a time on the caller
+    void setEventLoopThreads(size_t threads) { m_eventLoopThreads = threads; }
+
+    // serve associations on the dcmnet SCP pool instead: each one gets a worker thread of its own,
+    // up to threads at a time; queueSize more wait for a free worker, others are rejected.
+    // Takes precedence over the event loop, 0 disables the pool
+    void setPool(Uint16 threads, Uint16 queueSize) { m_poolThreads = threads; m_poolQueueSize = queueSize; }
+
+    // accept associations over the transport layer of the network only, i.e. TLS once it is secured
+    void setSecureConnection(OFBool secureConnection) { m_secureConnection = secureConnection; }
+
+    // peers whose configuration overrides the transfer policy, may be NULL
+    void setConfig(const DcmQueryRetrieveConfig* config) { m_config = config; }
+
+    // accept and storage decisions of this SCP, by default everything is accepted
+    void setStoreRules(const StoreRules& rules) { m_storeRules = rules; }
+
+    // send a SERIES_COMPLETE event with the instances of each series written to disk once none arrived
+    // for quietPeriod ms, or with completeOnRelease once the associations that delivered it ended. Quiet
+    // series are checked by waitForAssociation(), so they take up to a second longer. With eventsOnly no
+    // FILE_STORAGE event is sent per instance. 0 sends none
+    void setSeriesAggregation(int quietPeriod, bool completeOnRelease, bool eventsOnly)
+    {
+        m_series.configure(quietPeriod, completeOnRelease);
+        m_seriesEventsOnly = eventsOnly && m_series.isEnabled();
+    }
 
 protected:
 
-    OFCondition acceptAssociation(T_ASC_Network* net, DcmAssociationConfiguration& asccfg, OFBool secureConnection, const OFString& outputDirectory, const OFString& aet, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress);
+    OFCondition acceptAssociation(T_ASC_Network* net, DcmAssociationConfiguration& asccfg, OFBool secureConnection, const OFString& outputDirectory, const OFString& aet, const BaseAsyncWorker::ExecutionProgress& progress);
     
-    OFCondition processCommands(T_ASC_Association* assoc, const OFString& outputDirectory, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress);
+    OFCondition processCommands(T_ASC_Association* assoc, const OFString& outputDirectory, const BaseAsyncWorker::ExecutionProgress& progress);
+
+    // receives and handles a single DIMSE command
+    OFCondition processCommand(T_ASC_Association* assoc, const OFString& outputDirectory, const BaseAsyncWorker::ExecutionProgress& progress);
+
+    // negotiates the presentation contexts and acknowledges or rejects the association
+    OFCondition negotiateAssociation(T_ASC_Association* assoc, const OFString& aet);
 
-    OFCondition storeSCP(T_ASC_Association* assoc, T_DIMSE_Message* msg, T_ASC_PresentationContextID presID, const OFString& outputDirectory, const Napi::AsyncProgressQueueWorker<char>::ExecutionProgress& progress);
+    // measures the link to the peer of assoc with a dataset received from it
+    void addReceived(T_ASC_Association* assoc, Uint64 bytes, double seconds);
+
+    // checks the association against the limits of its peer in the configuration and rejects it if they
+    // are exceeded. An admitted association is released by finishAssociation() or releaseAssociation()
+    bool admitAssociation(T_ASC_Association* assoc);
+
+    // frees the slot an admitted association holds in the limits of its peer
+    void releaseAssociation(T_ASC_Association* assoc);
+
+    // sends a SERIES_COMPLETE event for each series
+    void sendSeries(const std::vector<SeriesAggregator::sSeries>& series);
+
+    // marks an open association as busy with a command, or as idle from now on once it is handled
+    void markAssociation(T_ASC_Association* assoc, bool busy);
+
+    // interrupts the connections of the associations idle for longer than the idle timeout, their
+    // threads or the event loop then abort them
+    void reapIdleAssociations();
+
+    // acknowledges a release or aborts the association, depending on how processing ended, and frees it
+    OFCondition finishAssociation(T_ASC_Association* assoc, OFCondition cond);
+
+    OFCondition storeSCP(T_ASC_Association* assoc, T_DIMSE_Message* msg, T_ASC_PresentationContextID presID, const OFString& outputDirectory, const BaseAsyncWorker::ExecutionProgress& progress);
 
     OFCondition echoSCP(T_ASC_Association* assoc, T_DIMSE_Message* msg, T_ASC_PresentationContextID presID);
 
+    T_DIMSE_BlockingMode dimseBlockMode() const { return m_dimseTimeout > 0 ? DIMSE_NONBLOCKING : DIMSE_BLOCKING; }
+
 private:
     OFString m_outputDirectory;
     OFString m_aet;
     DcmAssociationConfiguration asccfg;
     bool m_writeFile;
+    bool m_binaryBuffer;
+    bool m_streamToFile;
+    bool m_arenaAllocation;
+    bool m_refuseOverBudget;
+    bool m_seriesEventsOnly;
+    int m_shardDigits;
+    Uint32 m_maxPDU;
+    int m_dimseTimeout;
+    int m_idleTimeout;
+    std::vector<DcmTagKey> m_eventTags;
+    size_t m_eventLoopThreads;
+    Uint16 m_poolThreads;
+    Uint16 m_poolQueueSize;
+    OFBool m_secureConnection;
+    const DcmQueryRetrieveConfig* m_config;
+    StoreRules m_storeRules;
+    SeriesAggregator m_series;
+    BaseAsyncWorker* m_worker;
+    // of the worker's Execute(), set by waitForAssociation()
+    const BaseAsyncWorker::ExecutionProgress* m_progress;
+    // negotiated associations until finishAssociation(), with the time since they are idle, max() while
+    // a command is handled
+    std::mutex m_openMutex;
+    std::condition_variable m_openChanged;
+    std::unordered_map<T_ASC_Association*, std::chrono::steady_clock::time_point> m_open;
+    // declared last, their threads use the members above until they are destroyed
+    std::shared_ptr<StoreAssociationReactor> m_reactor;
+    std::shared_ptr<StoreSCPPool> m_pool;
 };
@@ -0,0 +1,722 @@
+#ifdef WITH_OBJECT_STORAGE
+
+#include "S3Storage.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include <openssl/err.h>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#include "Metrics.h"
+
+namespace
+{
+
+#ifdef _WIN32
+typedef SOCKET socket_t;
+const socket_t invalidSocket = INVALID_SOCKET;
+#define closeSocket closesocket
+#else
+typedef int socket_t;
+const socket_t invalidSocket = -1;
+#define closeSocket ::close
+#endif
+
+// bytes moved per read and write of bodies
+const size_t ioBufferSize = 64 * 1024;
+
+std::string hex(const unsigned char* data, size_t length)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(length * 2);
+    for (size_t i = 0; i < length; ++i) {
+        result += digits[data[i] >> 4];
+        result += digits[data[i] & 0x0F];
+    }
+    return result;
+}
+
+std::string sha256Hex(const std::string& data)
+{
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), digest);
+    return hex(digest, sizeof(digest));
+}
+
+// raw HMAC-SHA256 of data
+std::string hmac(const std::string& key, const std::string& data)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()), reinterpret_cast<const unsigned char*>(data.data()),
+        data.size(), digest, &length);
+    return std::string(reinterpret_cast<const char*>(digest), length);
+}
+
+// percent encoding of everything but the unreserved characters of RFC 3986, as the canonical
+// request of Signature Version 4 expects it. Paths keep their '/'
+std::string uriEncode(const std::string& value, bool path)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    std::string result;
+    for (unsigned char c : value) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' || (path && c == '/')) {
+            result += static_cast<char>(c);
+        }
+        else {
+            result += '%';
+            result += digits[c >> 4];
+            result += digits[c & 0x0F];
+        }
+    }
+    return result;
+}
+
+// text of the first element of an XML response, empty if there is none
+std::string xmlValue(const std::string& xml, const std::string& element)
+{
+    const std::string open = "<" + element + ">";
+    const size_t start = xml.find(open);
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    const size_t end = xml.find("</" + element + ">", start + open.size());
+    return end == std::string::npos ? std::string() : xml.substr(start + open.size(), end - start - open.size());
+}
+
+// UTC time of a request as x-amz-date (20240102T030405Z)
+std::string amzDate()
+{
+    const time_t now = time(NULL);
+    struct tm utc;
+#ifdef _WIN32
+    gmtime_s(&utc, &now);
+#else
+    gmtime_r(&now, &utc);
+#endif
+    char text[32];
+    strftime(text, sizeof(text), "%Y%m%dT%H%M%SZ", &utc);
+    return text;
+}
+
+SSL_CTX* tlsContext()
+{
+    static std::once_flag once;
+    static SSL_CTX* context = NULL;
+    std::call_once(once, []() {
+        OPENSSL_init_ssl(0, NULL);
+        context = SSL_CTX_new(TLS_client_method());
+        if (context != NULL) {
+            SSL_CTX_set_default_verify_paths(context);
+            SSL_CTX_set_verify(context, SSL_VERIFY_PEER, NULL);
+        }
+    });
+    return context;
+}
+
+// TCP connection to the endpoint, TLS for https, carrying one request
+class Connection
+{
+public:
+    Connection() : m_socket(invalidSocket), m_ssl(NULL) {}
+    ~Connection() { close(); }
+
+    bool open(const std::string& host, const std::string& port, bool tls, std::string& error)
+    {
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* addresses = NULL;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0 || addresses == NULL) {
+            error = "cannot resolve " + host;
+            return false;
+        }
+        for (struct addrinfo* a = addresses; a != NULL && m_socket == invalidSocket; a = a->ai_next) {
+            m_socket = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (m_socket != invalidSocket && connect(m_socket, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0) {
+                closeSocket(m_socket);
+                m_socket = invalidSocket;
+            }
+        }
+        freeaddrinfo(addresses);
+        if (m_socket == invalidSocket) {
+            error = "cannot connect to " + host + ":" + port;
+            return false;
+        }
+        if (!tls) {
+            return true;
+        }
+
+        SSL_CTX* context = tlsContext();
+        m_ssl = context != NULL ? SSL_new(context) : NULL;
+        if (m_ssl == NULL) {
+            error = "cannot set up TLS";
+            return false;
+        }
+        SSL_set_tlsext_host_name(m_ssl, host.c_str());
+        SSL_set1_host(m_ssl, host.c_str());
+        SSL_set_fd(m_ssl, static_cast<int>(m_socket));
+        if (SSL_connect(m_ssl) != 1) {
+            char reason[256];
+            ERR_error_string_n(ERR_get_error(), reason, sizeof(reason));
+            error = "TLS handshake with " + host + " failed: " + reason;
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const char* data, size_t length)
+    {
+        while (length > 0) {
+            const int chunk = static_cast<int>(std::min<size_t>(length, 1 << 30));
+            const int written = m_ssl != NULL ? SSL_write(m_ssl, data, chunk) : static_cast<int>(send(m_socket, data, chunk, 0));
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    // bytes read, 0 at the end of the stream and -1 on errors
+    long read(char* data, size_t length)
+    {
+        const int chunk = static_cast<int>(std::min<size_t>(length, 1 << 30));
+        if (m_ssl != NULL) {
+            const int received = SSL_read(m_ssl, data, chunk);
+            if (received > 0) {
+                return received;
+            }
+            return SSL_get_error(m_ssl, received) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+        }
+        return static_cast<long>(recv(m_socket, data, chunk, 0));
+    }
+
+    void close()
+    {
+        if (m_ssl != NULL) {
+            SSL_shutdown(m_ssl);
+            SSL_free(m_ssl);
+            m_ssl = NULL;
+        }
+        if (m_socket != invalidSocket) {
+            closeSocket(m_socket);
+            m_socket = invalidSocket;
+        }
+    }
+
+private:
+    socket_t m_socket;
+    SSL* m_ssl;
+};
+
+// buffered reading of the status line, the headers and the body of a response
+class ResponseReader
+{
+public:
+    explicit ResponseReader(Connection& connection) : m_connection(connection), m_buffer(ioBufferSize), m_begin(0), m_end(0) {}
+
+    bool readLine(std::string& line)
+    {
+        line.clear();
+        for (;;) {
+            if (m_begin == m_end && !fill()) {
+                return false;
+            }
+            const char c = m_buffer[m_begin++];
+            if (c == '\n') {
+                if (!line.empty() && line[line.size() - 1] == '\r') {
+                    line.erase(line.size() - 1);
+                }
+                return true;
+            }
+            line += c;
+        }
+    }
+
+    // length bytes, or everything up to the end of the stream for npos
+    bool readBody(Uint64 length, const std::function<bool(const char*, size_t)>& sink)
+    {
+        const bool toEnd = length == static_cast<Uint64>(-1);
+        while (length > 0) {
+            if (m_begin == m_end && !fill()) {
+                return toEnd;
+            }
+            const size_t chunk = static_cast<size_t>(std::min<Uint64>(length, m_end - m_begin));
+            if (!sink(&m_buffer[m_begin], chunk)) {
+                return false;
+            }
+            m_begin += chunk;
+            if (!toEnd) {
+                length -= chunk;
+            }
+        }
+        return true;
+    }
+
+    bool readChunked(const std::function<bool(const char*, size_t)>& sink)
+    {
+        std::string line;
+        for (;;) {
+            if (!readLine(line)) {
+                return false;
+            }
+            const Uint64 length = strtoull(line.c_str(), NULL, 16);
+            if (length == 0) {
+                // trailers up to the empty line
+                while (readLine(line) && !line.empty()) {}
+                return true;
+            }
+            if (!readBody(length, sink) || !readLine(line)) {
+                return false;
+            }
+        }
+    }
+
+private:
+    bool fill()
+    {
+        const long received = m_connection.read(&m_buffer[0], m_buffer.size());
+        if (received <= 0) {
+            return false;
+        }
+        m_begin = 0;
+        m_end = static_cast<size_t>(received);
+        return true;
+    }
+
+    Connection& m_connection;
+    std::vector<char> m_buffer;
+    size_t m_begin;
+    size_t m_end;
+};
+
+struct sResponse {
+    int status;
+    // names in lower case
+    std::map<std::string, std::string> headers;
+    // bodies of errors and of responses without sink
+    std::string body;
+};
+
+// body of a request, a text or a range of a file
+struct sBody {
+    sBody() : text(NULL), file(NULL), offset(0), length(0) {}
+    const std::string* text;
+    OFFile* file;
+    Uint64 offset;
+    Uint64 length;
+};
+
+}
+
+class S3StorageBackendPrivate
+{
+public:
+    S3StorageBackendPrivate() : valid(false), tls(false) {}
+
+    bool parse(const std::string& url);
+
+    // object path of a key in requests and in the canonical request
+    std::string objectPath(const std::string& key) const
+    {
+        return uriEncode("/" + bucket + "/" + prefix + key, true);
+    }
+
+    // runs a request, retried on connection errors and server errors. sink takes the body of a 2xx
+    // response, reset is called before each attempt so the sink can start over
+    bool request(const std::string& method, const std::string& key, const std::map<std::string, std::string>& query,
+        const sBody& body, const std::vector<std::string>& headers, const std::function<bool(const char*, size_t)>& sink,
+        const std::function<bool()>& reset, sResponse& response, std::string& error) const;
+
+    bool attempt(const std::string& method, const std::string& key, const std::map<std::string, std::string>& query,
+        const sBody& body, const std::vector<std::string>& headers, const std::function<bool(const char*, size_t)>& sink,
+        sResponse& response, std::string& error) const;
+
+    // Authorization and x-amz headers of Signature Version 4, the payload is not signed
+    std::vector<std::string> sign(const std::string& method, const std::string& path, const std::string& query) const;
+
+    // message of a failed request
+    static std::string failure(const std::string& method, const std::string& key, const sResponse& response);
+
+    bool valid;
+    bool tls;
+    std::string host;
+    std::string port;
+    // Host header, with the port unless it is the default one
+    std::string hostHeader;
+    std::string bucket;
+    // prepended to all keys, ends with '/' unless empty
+    std::string prefix;
+    std::string region;
+    std::string accessKey;
+    std::string secretKey;
+};
+
+bool S3StorageBackendPrivate::parse(const std::string& url)
+{
+    const size_t scheme = url.find("://");
+    if (scheme == std::string::npos) {
+        return false;
+    }
+    const std::string protocol = url.substr(0, scheme);
+    if (protocol != "http" && protocol != "https") {
+        return false;
+    }
+    tls = protocol == "https";
+    const size_t pathStart = url.find('/', scheme + 3);
+    const std::string authority = url.substr(scheme + 3, pathStart == std::string::npos ? std::string::npos : pathStart - scheme - 3);
+    const size_t colon = authority.rfind(':');
+    host = authority.substr(0, colon);
+    port = colon == std::string::npos ? (tls ? "443" : "80") : authority.substr(colon + 1);
+    hostHeader = colon == std::string::npos ? host : authority;
+
+    std::string path = pathStart == std::string::npos ? std::string() : url.substr(pathStart + 1);
+    while (!path.empty() && path[path.size() - 1] == '/') {
+        path.erase(path.size() - 1);
+    }
+    const size_t slash = path.find('/');
+    bucket = path.substr(0, slash);
+    prefix = slash == std::string::npos ? std::string() : path.substr(slash + 1) + "/";
+    return !host.empty() && !bucket.empty();
+}
+
+std::vector<std::string> S3StorageBackendPrivate::sign(const std::string& method, const std::string& path, const std::string& query) const
+{
+    const std::string date = amzDate();
+    const std::string day = date.substr(0, 8);
+    static const std::string payload = "UNSIGNED-PAYLOAD";
+    std::vector<std::string> headers;
+    headers.push_back("x-amz-content-sha256: " + payload);
+    headers.push_back("x-amz-date: " + date);
+    if (accessKey.empty()) {
+        return headers;
+    }
+
+    static const std::string signedHeaders = "host;x-amz-content-sha256;x-amz-date";
+    const std::string canonical = method + "\n" + path + "\n" + query + "\n"
+        + "host:" + hostHeader + "\n" + "x-amz-content-sha256:" + payload + "\n" + "x-amz-date:" + date + "\n\n"
+        + signedHeaders + "\n" + payload;
+    const std::string scope = day + "/" + region + "/s3/aws4_request";
+    const std::string stringToSign = "AWS4-HMAC-SHA256\n" + date + "\n" + scope + "\n" + sha256Hex(canonical);
+    const std::string key = hmac(hmac(hmac(hmac("AWS4" + secretKey, day), region), "s3"), "aws4_request");
+    const std::string signature = hmac(key, stringToSign);
+    headers.push_back("Authorization: AWS4-HMAC-SHA256 Credential=" + accessKey + "/" + scope
+        + ", SignedHeaders=" + signedHeaders + ", Signature="
+        + hex(reinterpret_cast<const unsigned char*>(signature.data()), signature.size()));
+    return headers;
+}
+
+std::string S3StorageBackendPrivate::failure(const std::string& method, const std::string& key, const sResponse& response)
+{
+    std::ostringstream message;
+    message << "S3 " << method << " " << key << ": HTTP " << response.status;
+    const std::string code = xmlValue(response.body, "Code");
+    if (!code.empty()) {
+        message << " " << code;
+    }
+    const std::string text = xmlValue(response.body, "Message");
+    if (!text.empty()) {
+        message << ": " << text;
+    }
+    return message.str();
+}
+
+bool S3StorageBackendPrivate::attempt(const std::string& method, const std::string& key, const std::map<std::string, std::string>& query,
+    const sBody& body, const std::vector<std::string>& headers, const std::function<bool(const char*, size_t)>& sink,
+    sResponse& response, std::string& error) const
+{
+    // the map keeps the parameters sorted by name, as the canonical query string needs them
+    std::string queryString;
+    for (const auto& parameter : query) {
+        if (!queryString.empty()) {
+            queryString += '&';
+        }
+        queryString += uriEncode(parameter.first, false) + "=" + uriEncode(parameter.second, false);
+    }
+    const std::string path = objectPath(key);
+
+    std::ostringstream head;
+    head << method << " " << path << (queryString.empty() ? "" : "?") << queryString << " HTTP/1.1\r\n"
+         << "Host: " << hostHeader << "\r\n"
+         << "Connection: close\r\n";
+    for (const std::string& header : sign(method, path, queryString)) {
+        head << header << "\r\n";
+    }
+    for (const std::string& header : headers) {
+        head << header << "\r\n";
+    }
+    const Uint64 contentLength = body.text != NULL ? body.text->size() : body.length;
+    if (contentLength > 0 || method == "PUT" || method == "POST") {
+        head << "Content-Length: " << contentLength << "\r\n";
+    }
+    head << "\r\n";
+
+    Connection connection;
+    if (!connection.open(host, port, tls, error)) {
+        return false;
+    }
+    const std::string text = head.str();
+    bool sent = connection.write(text.data(), text.size());
+    if (sent && body.text != NULL) {
+        sent = connection.write(body.text->data(), body.text->size());
+    }
+    else if (sent && body.file != NULL) {
+        // parts are streamed from the file, only one buffer is held in memory
+        std::vector<char> buffer(ioBufferSize);
+        sent = body.file->fseek(static_cast<offile_off_t>(body.offset), SEEK_SET) == 0;
+        for (Uint64 remaining = body.length; sent && remaining > 0;) {
+            const size_t chunk = static_cast<size_t>(std::min<Uint64>(remaining, buffer.size()));
+            sent = body.file->fread(&buffer[0], 1, chunk) == chunk && connection.write(&buffer[0], chunk);
+            remaining -= chunk;
+        }
+    }
+    if (!sent) {
+        error = "cannot send request to " + host;
+        return false;
+    }
+
+    ResponseReader reader(connection);
+    std::string line;
+    if (!reader.readLine(line) || line.compare(0, 5, "HTTP/") != 0 || line.size() < 12) {
+        error = "invalid response from " + host;
+        return false;
+    }
+    response.status = atoi(line.c_str() + 9);
+    response.headers.clear();
+    response.body.clear();
+    while (reader.readLine(line) && !line.empty()) {
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        size_t value = colon + 1;
+        while (value < line.size() && line[value] == ' ') {
+            ++value;
+        }
+        response.headers[name] = line.substr(value);
+    }
+
+    const bool success = response.status >= 200 && response.status < 300;
+    std::function<bool(const char*, size_t)> target = sink;
+    if (!success || !target) {
+        target = [&response](const char* data, size_t length) { response.body.append(data, length); return true; };
+    }
+    bool complete = true;
+    if (method != "HEAD" && response.status != 204 && response.status != 304) {
+        std::map<std::string, std::string>::const_iterator encoding = response.headers.find("transfer-encoding");
+        std::map<std::string, std::string>::const_iterator length = response.headers.find("content-length");
+        if (encoding != response.headers.end() && encoding->second.find("chunked") != std::string::npos) {
+            complete = reader.readChunked(target);
+        }
+        else if (length != response.headers.end()) {
+            complete = reader.readBody(strtoull(length->second.c_str(), NULL, 10), target);
+        }
+        else {
+            complete = reader.readBody(static_cast<Uint64>(-1), target);
+        }
+    }
+    if (!complete) {
+        error = "incomplete response from " + host;
+        return false;
+    }
+    return true;
+}
+
+bool S3StorageBackendPrivate::request(const std::string& method, const std::string& key, const std::map<std::string, std::string>& query,
+    const sBody& body, const std::vector<std::string>& headers, const std::function<bool(const char*, size_t)>& sink,
+    const std::function<bool()>& reset, sResponse& response, std::string& error) const
+{
+    Metrics::Timer timer(Metrics::histogram("storage_request_seconds", {{"backend", "s3"}, {"method", method}}));
+    for (int attempt = 1;; ++attempt) {
+        if (reset && !reset()) {
+            error = "cannot write the local file of " + key;
+            return false;
+        }
+        error.clear();
+        response.status = 0;
+        const bool done = this->attempt(method, key, query, body, headers, sink, response, error);
+        // throttling (503 SlowDown) and other server errors are transient as well
+        const bool transient = !done || response.status >= 500;
+        if (!transient || attempt >= S3StorageBackend::maxAttempts) {
+            if (done && (response.status < 200 || response.status >= 300)) {
+                error = failure(method, key, response);
+            }
+            Metrics::counter("storage_requests_total", {{"backend", "s3"}, {"method", method},
+                {"result", error.empty() ? "success" : "failure"}}).add();
+            return error.empty();
+        }
+        DCMNET_DEBUG("S3 " << method << " " << key << " failed (" << (done ? failure(method, key, response) : error) << "), retrying");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100 << attempt));
+    }
+}
+
+S3StorageBackend::S3StorageBackend(const std::string& url, const std::string& region, const std::string& accessKey, const std::string& secretKey)
+: d(new S3StorageBackendPrivate())
+{
+    d->valid = d->parse(url);
+    d->region = region.empty() ? "us-east-1" : region;
+    d->accessKey = accessKey;
+    d->secretKey = secretKey;
+    if (!d->valid) {
+        DCMNET_ERROR("invalid object storage URL: " << url);
+    }
+}
+
+S3StorageBackend::~S3StorageBackend()
+{
+    delete d;
+}
+
+bool S3StorageBackend::isValid() const
+{
+    return d->valid;
+}
+
+bool S3StorageBackend::put(const std::string& file, const std::string& key, std::string& error)
+{
+    OFFile source;
+    if (!source.fopen(file.c_str(), "rb")) {
+        error = "cannot open " + file;
+        return false;
+    }
+    source.fseek(0, SEEK_END);
+    const Uint64 size = static_cast<Uint64>(source.ftell());
+
+    const std::map<std::string, std::string> none;
+    const std::vector<std::string> headers;
+    sResponse response;
+    sBody body;
+    body.file = &source;
+    if (size <= partSize) {
+        body.length = size;
+        return d->request("PUT", key, none, body, headers, NULL, NULL, response, error);
+    }
+
+    // multipart upload, aborted if a part fails so the store does not keep the parts
+    std::map<std::string, std::string> query;
+    query["uploads"] = "";
+    if (!d->request("POST", key, query, sBody(), headers, NULL, NULL, response, error)) {
+        return false;
+    }
+    const std::string uploadId = xmlValue(response.body, "UploadId");
+    if (uploadId.empty()) {
+        error = "S3 POST " + key + ": no upload id";
+        return false;
+    }
+    std::string complete = "<CompleteMultipartUpload>";
+    bool uploaded = true;
+    for (Uint64 offset = 0, part = 1; uploaded && offset < size; offset += partSize, ++part) {
+        query.clear();
+        query["partNumber"] = std::to_string(part);
+        query["uploadId"] = uploadId;
+        body.offset = offset;
+        body.length = std::min<Uint64>(partSize, size - offset);
+        uploaded = d->request("PUT", key, query, body, headers, NULL, NULL, response, error);
+        complete += "<Part><PartNumber>" + std::to_string(part) + "</PartNumber><ETag>" + response.headers["etag"] + "</ETag></Part>";
+    }
+    complete += "</CompleteMultipartUpload>";
+    query.clear();
+    query["uploadId"] = uploadId;
+    if (uploaded) {
+        sBody completeBody;
+        completeBody.text = &complete;
+        uploaded = d->request("POST", key, query, completeBody, headers, NULL, NULL, response, error);
+        // the completion may fail after the status line was sent
+        if (uploaded && response.body.find("<Error>") != std::string::npos) {
+            error = S3StorageBackendPrivate::failure("POST", key, response);
+            uploaded = false;
+        }
+    }
+    if (!uploaded) {
+        std::string abortError;
+        d->request("DELETE", key, query, sBody(), headers, NULL, NULL, response, abortError);
+    }
+    return uploaded;
+}
+
+bool S3StorageBackend::get(const std::string& key, const std::string& file, std::string& error)
+{
+    // written next to the file and renamed once complete, hidden so a reindex skips it
+    OFString directory;
+    OFString name;
+    OFStandard::getDirNameFromPath(directory, file.c_str(), OFFalse);
+    OFStandard::getFilenameFromPath(name, file.c_str());
+    const std::string temporary = std::string(directory.c_str()) + PATH_SEPARATOR + "." + name.c_str() + ".fetch";
+
+    OFFile target;
+    sResponse response;
+    const bool done = d->request("GET", key, std::map<std::string, std::string>(), sBody(), std::vector<std::string>(),
+        [&target](const char* data, size_t length) { return target.fwrite(data, 1, length) == length; },
+        [&target, &temporary]() { target.fclose(); return target.fopen(temporary.c_str(), "wb") != OFFalse; },
+        response, error);
+    const bool written = target.fclose() == 0;
+    if (done && written && OFStandard::renameFile(temporary.c_str(), file.c_str())) {
+        return true;
+    }
+    if (error.empty()) {
+        error = "cannot write " + file;
+    }
+    OFStandard::deleteFile(temporary.c_str());
+    return false;
+}
+
+bool S3StorageBackend::getRange(const std::string& key, Uint64 offset, size_t length, void* buffer, std::string& error)
+{
+    if (length == 0) {
+        return true;
+    }
+    std::vector<std::string> headers;
+    headers.push_back("Range: bytes=" + std::to_string(offset) + "-" + std::to_string(offset + length - 1));
+    size_t received = 0;
+    char* target = static_cast<char*>(buffer);
+    sResponse response;
+    if (!d->request("GET", key, std::map<std::string, std::string>(), sBody(), headers,
+            [&](const char* data, size_t chunk) {
+                if (received + chunk > length) return false;
+                memcpy(target + received, data, chunk);
+                received += chunk;
+                return true;
+            },
+            [&received]() { received = 0; return true; }, response, error)) {
+        return false;
+    }
+    if (response.status != 206 || received != length) {
+        error = "S3 GET " + key + ": the range " + std::to_string(offset) + "+" + std::to_string(length) + " is not available";
+        return false;
+    }
+    return true;
+}
+
+#endif
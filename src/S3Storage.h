@@ -0,0 +1,41 @@
+#pragma once
+
+#ifdef WITH_OBJECT_STORAGE
+
+#include "StorageBackend.h"
+
+class S3StorageBackendPrivate;
+
+// Objects in a bucket of an S3 compatible store (AWS S3, MinIO, Ceph RGW, ...) with path style
+// addressing, so any endpoint works without DNS names per bucket. Requests are signed with AWS
+// Signature Version 4 unless no access key is set. Files larger than partSize are uploaded as
+// multipart uploads streamed from disk one part at a time, downloads are streamed to disk.
+class S3StorageBackend : public StorageBackend
+{
+public:
+    // url is <scheme>://<host>[:<port>]/<bucket>[/<prefix>], scheme http or https
+    S3StorageBackend(const std::string& url, const std::string& region, const std::string& accessKey, const std::string& secretKey);
+    virtual ~S3StorageBackend();
+
+    virtual bool isValid() const;
+
+    virtual bool put(const std::string& file, const std::string& key, std::string& error);
+
+    virtual bool get(const std::string& key, const std::string& file, std::string& error);
+
+    virtual bool getRange(const std::string& key, Uint64 offset, size_t length, void* buffer, std::string& error);
+
+    // size of the parts of multipart uploads
+    static const size_t partSize = 8 * 1024 * 1024;
+
+    // attempts per request on connection errors and 5xx responses
+    static const int maxAttempts = 3;
+
+private:
+    /* not defined */ S3StorageBackend(const S3StorageBackend& clone);
+    /* not defined */ S3StorageBackend& operator=(const S3StorageBackend& clone);
+
+    S3StorageBackendPrivate* d;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "SeriesAggregator.h"
+
+#include "Metrics.h"
+
+#include "dcmtk/dcmnet/diutil.h"
+
+SeriesAggregator::SeriesAggregator()
+    : m_quietPeriod(0), m_completeOnRelease(true)
+{
+}
+
+void SeriesAggregator::configure(int quietPeriod, bool completeOnRelease)
+{
+    m_quietPeriod = quietPeriod > 0 ? quietPeriod : 0;
+    m_completeOnRelease = completeOnRelease;
+    if (m_quietPeriod > 0) {
+        DCMNET_INFO("series complete after " << m_quietPeriod << " ms without instances"
+            << (m_completeOnRelease ? " or once their associations ended" : ""));
+    }
+}
+
+void SeriesAggregator::add(T_ASC_Association* assoc, const std::string& studyInstanceUID, const std::string& seriesInstanceUID, const sInstance& instance)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<std::string, sEntry>::iterator it = m_entries.find(seriesInstanceUID);
+    if (it == m_entries.end()) {
+        it = m_entries.insert(std::make_pair(seriesInstanceUID, sEntry())).first;
+        it->second.series.studyInstanceUID = studyInstanceUID;
+        it->second.series.seriesInstanceUID = seriesInstanceUID;
+        it->second.series.callingAet = assoc->params->DULparams.callingAPTitle;
+    }
+    it->second.series.instances.push_back(instance);
+    it->second.associations.insert(assoc);
+    it->second.lastArrival = std::chrono::steady_clock::now();
+}
+
+std::vector<SeriesAggregator::sSeries> SeriesAggregator::finish(T_ASC_Association* assoc, bool aborted)
+{
+    std::vector<sSeries> completed;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::map<std::string, sEntry>::iterator it = m_entries.begin(); it != m_entries.end();) {
+        std::map<std::string, sEntry>::iterator next = it;
+        ++next;
+        // a series still arriving on another association is not complete yet
+        if (it->second.associations.erase(assoc) > 0 && it->second.associations.empty() && m_completeOnRelease) {
+            complete(it, aborted ? "aborted" : "released", m_entries, completed);
+        }
+        it = next;
+    }
+    return completed;
+}
+
+std::vector<SeriesAggregator::sSeries> SeriesAggregator::quiet()
+{
+    std::vector<sSeries> completed;
+    if (m_quietPeriod <= 0) {
+        return completed;
+    }
+    const std::chrono::steady_clock::time_point quietSince = std::chrono::steady_clock::now() - std::chrono::milliseconds(m_quietPeriod);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::map<std::string, sEntry>::iterator it = m_entries.begin(); it != m_entries.end();) {
+        std::map<std::string, sEntry>::iterator next = it;
+        ++next;
+        if (it->second.lastArrival <= quietSince) {
+            complete(it, "quiet", m_entries, completed);
+        }
+        it = next;
+    }
+    return completed;
+}
+
+std::vector<SeriesAggregator::sSeries> SeriesAggregator::stop()
+{
+    std::vector<sSeries> completed;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_entries.empty()) {
+        complete(m_entries.begin(), "stopped", m_entries, completed);
+    }
+    return completed;
+}
+
+void SeriesAggregator::complete(std::map<std::string, sEntry>::iterator it, const char* reason, std::map<std::string, sEntry>& entries, std::vector<sSeries>& completed)
+{
+    Metrics::counter("scp_series_completed_total", {{"reason", reason}}).add();
+    completed.push_back(sSeries());
+    completed.back().studyInstanceUID.swap(it->second.series.studyInstanceUID);
+    completed.back().seriesInstanceUID.swap(it->second.series.seriesInstanceUID);
+    completed.back().callingAet.swap(it->second.series.callingAet);
+    completed.back().instances.swap(it->second.series.instances);
+    completed.back().reason = reason;
+    entries.erase(it);
+}
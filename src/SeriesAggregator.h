@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/assoc.h"
+
+// Collects the instances a store SCP received per series, so that JS gets one event per completed
+// series with its instances instead of having to group a storage event per instance itself. A series
+// is complete once no instance of it arrived for the quiet period, or once the associations that
+// delivered it are released, unless only the quiet period counts. Instances of a series arriving
+// after it was completed start it over. Any thread may add instances and complete series.
+class SeriesAggregator
+{
+public:
+    struct sInstance {
+        std::string sopInstanceUID;
+        std::string filepath;
+        // attributes of the storage event, null without eventTags
+        json attributes;
+    };
+
+    struct sSeries {
+        std::string studyInstanceUID;
+        std::string seriesInstanceUID;
+        std::string callingAet;
+        // "released", "aborted", "quiet" or "stopped"
+        std::string reason;
+        std::vector<sInstance> instances;
+    };
+
+    // disabled
+    SeriesAggregator();
+
+    // completes series without arrivals for quietPeriod ms, 0 disables the aggregation. With
+    // completeOnRelease, series are also complete once the associations that delivered them ended
+    void configure(int quietPeriod, bool completeOnRelease);
+
+    // true if instances are collected
+    bool isEnabled() const { return m_quietPeriod > 0; }
+
+    // adds an instance stored from assoc to its series
+    void add(T_ASC_Association* assoc, const std::string& studyInstanceUID, const std::string& seriesInstanceUID, const sInstance& instance);
+
+    // the series complete now that assoc ended, aborted or released
+    std::vector<sSeries> finish(T_ASC_Association* assoc, bool aborted);
+
+    // the series without arrivals for the quiet period
+    std::vector<sSeries> quiet();
+
+    // all series collected so far, once the SCP stopped
+    std::vector<sSeries> stop();
+
+private:
+    struct sEntry {
+        sSeries series;
+        // associations that delivered instances and have not ended yet
+        std::set<T_ASC_Association*> associations;
+        std::chrono::steady_clock::time_point lastArrival;
+    };
+
+    // moves the entry out as a series complete for reason, m_mutex is held
+    static void complete(std::map<std::string, sEntry>::iterator it, const char* reason, std::map<std::string, sEntry>& entries, std::vector<sSeries>& completed);
+
+    int m_quietPeriod;
+    bool m_completeOnRelease;
+    std::mutex m_mutex;
+    // by Series Instance UID
+    std::map<std::string, sEntry> m_entries;
+};
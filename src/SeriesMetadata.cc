@@ -0,0 +1,198 @@
+#include "SeriesMetadata.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <sstream>
+
+#include "Metrics.h"
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcelem.h"
+#include "dcmtk/dcmdata/dcjson.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+
+std::atomic<bool> enabled(false);
+
+// appends and reads of the same series are serialized, series spread over the stripes by path
+const size_t lockStripes = 64;
+std::mutex stripes[lockStripes];
+
+std::mutex& stripeOf(const std::string& path)
+{
+    return stripes[std::hash<std::string>()(path) % lockStripes];
+}
+
+// UIDs become path names, anything else than digits and dots is refused
+bool isUid(const std::string& uid)
+{
+    return !uid.empty() && uid.size() <= 64 && uid.find_first_not_of("0123456789.") == std::string::npos && uid[0] != '.';
+}
+
+std::string studyDirectory(const std::string& storagePath, const std::string& studyInstanceUID)
+{
+    return storagePath + "/.metadata/" + studyInstanceUID;
+}
+
+std::string seriesFile(const std::string& storagePath, const std::string& studyInstanceUID, const std::string& seriesInstanceUID)
+{
+    return studyDirectory(storagePath, studyInstanceUID) + "/" + seriesInstanceUID + ".gz";
+}
+
+bool isBulkData(DcmElement* element)
+{
+    const DcmTagKey key = element->getTag().getXTag();
+    if (key == DCM_PixelData || key == DCM_FloatPixelData || key == DCM_DoubleFloatPixelData) {
+        return true;
+    }
+    switch (element->ident()) {
+    case EVR_OB:
+    case EVR_OW:
+    case EVR_OF:
+    case EVR_OD:
+    case EVR_OL:
+    case EVR_OV:
+    case EVR_UN:
+    case EVR_ox:
+    case EVR_pixelSQ:
+        return element->getLength() > SeriesMetadata::bulkDataThreshold;
+    default:
+        return false;
+    }
+}
+
+}
+
+void SeriesMetadata::configure(bool enable)
+{
+#ifndef WITH_ZLIB
+    if (enable) {
+        DCMNET_WARN("series metadata needs zlib, it is not kept");
+        enable = false;
+    }
+#endif
+    enabled = enable;
+}
+
+bool SeriesMetadata::isEnabled()
+{
+    return enabled;
+}
+
+bool SeriesMetadata::toJson(DcmItem* dataset, std::string& text)
+{
+    std::ostringstream stream;
+    DcmJsonFormatCompact format(OFFalse);
+    stream << "{";
+    bool first = true;
+    for (unsigned long i = 0; i < dataset->card(); ++i) {
+        DcmElement* element = dataset->getElement(i);
+        if (element == NULL || isBulkData(element)) {
+            continue;
+        }
+        if (!first) {
+            stream << ",";
+        }
+        first = false;
+        if (element->writeJson(stream, format).bad()) {
+            return false;
+        }
+    }
+    stream << "}";
+    text = stream.str();
+    return true;
+}
+
+bool SeriesMetadata::add(const std::string& storagePath, DcmItem* dataset, std::string& error)
+{
+#ifdef WITH_ZLIB
+    OFString study;
+    OFString series;
+    OFString sop;
+    dataset->findAndGetOFString(DCM_StudyInstanceUID, study);
+    dataset->findAndGetOFString(DCM_SeriesInstanceUID, series);
+    dataset->findAndGetOFString(DCM_SOPInstanceUID, sop);
+    if (!isUid(study.c_str()) || !isUid(series.c_str()) || !isUid(sop.c_str())) {
+        error = "invalid instance UIDs";
+        return false;
+    }
+    std::string record;
+    if (!toJson(dataset, record)) {
+        error = "cannot convert the attributes to DICOM JSON";
+        return false;
+    }
+    // one record per line, the JSON writer escapes line breaks within values
+    record = std::string(sop.c_str()) + "\t" + record + "\n";
+
+    const std::string directory = studyDirectory(storagePath, study.c_str());
+    const std::string file = seriesFile(storagePath, study.c_str(), series.c_str());
+    std::lock_guard<std::mutex> lock(stripeOf(file));
+    if (!OFStandard::dirExists(directory.c_str()) && OFStandard::createDirectory(directory.c_str(), storagePath.c_str()).bad()) {
+        error = "cannot create " + directory;
+        return false;
+    }
+    gzFile gz = gzopen(file.c_str(), "ab");
+    if (gz == NULL) {
+        error = "cannot open " + file;
+        return false;
+    }
+    const bool written = gzwrite(gz, record.data(), static_cast<unsigned>(record.size())) == static_cast<int>(record.size());
+    if (gzclose(gz) != Z_OK || !written) {
+        error = "cannot write " + file;
+        return false;
+    }
+    Metrics::counter("series_metadata_bytes_total").add(record.size());
+    return true;
+#else
+    error = "built without zlib";
+    return false;
+#endif
+}
+
+bool SeriesMetadata::read(const std::string& storagePath, const std::string& studyInstanceUID,
+    const std::string& seriesInstanceUID, std::map<std::string, std::string>& instances)
+{
+#ifdef WITH_ZLIB
+    if (!isUid(studyInstanceUID) || !isUid(seriesInstanceUID)) {
+        return false;
+    }
+    const std::string file = seriesFile(storagePath, studyInstanceUID, seriesInstanceUID);
+    std::string content;
+    {
+        std::lock_guard<std::mutex> lock(stripeOf(file));
+        gzFile gz = gzopen(file.c_str(), "rb");
+        if (gz == NULL) {
+            return false;
+        }
+        gzbuffer(gz, 128 * 1024);
+        char buffer[64 * 1024];
+        int length = 0;
+        // a member cut short by another process still writing it ends the read
+        while ((length = gzread(gz, buffer, sizeof(buffer))) > 0) {
+            content.append(buffer, static_cast<size_t>(length));
+        }
+        gzclose(gz);
+    }
+
+    size_t begin = 0;
+    size_t end = 0;
+    while ((end = content.find('\n', begin)) != std::string::npos) {
+        const size_t tab = content.find('\t', begin);
+        if (tab != std::string::npos && tab < end) {
+            instances[content.substr(begin, tab - begin)] = content.substr(tab + 1, end - tab - 1);
+        }
+        begin = end + 1;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
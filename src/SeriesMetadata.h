@@ -0,0 +1,37 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcitem.h"
+
+// Metadata of the instances of each series kept next to the index of a storage area, one gzip file
+// per series at .metadata/<StudyInstanceUID>/<SeriesInstanceUID>.gz, so the headers of a whole
+// study are read without opening a single instance file. Every stored instance is appended as a
+// gzip member of its own holding its SOPInstanceUID and its DICOM JSON without bulk data. The files
+// are only appended to: an instance stored again is appended again and its last record wins, and
+// the record a reader sees being written is skipped.
+class SeriesMetadata
+{
+public:
+    // appends the instances the index gets from now on to the metadata of their series
+    static void configure(bool enabled);
+
+    // true between configure(true) and configure(false)
+    static bool isEnabled();
+
+    // appends the attributes of dataset, in UTF-8, to the metadata of its series in storagePath
+    static bool add(const std::string& storagePath, DcmItem* dataset, std::string& error);
+
+    // the DICOM JSON of the instances of a series by SOPInstanceUID, false if there is no metadata
+    static bool read(const std::string& storagePath, const std::string& studyInstanceUID,
+        const std::string& seriesInstanceUID, std::map<std::string, std::string>& instances);
+
+    // the DICOM JSON of dataset without its pixel data and other binary values longer than
+    // bulkDataThreshold. False if it cannot be converted
+    static bool toJson(DcmItem* dataset, std::string& text);
+
+    // bytes of a binary value that are left out of the metadata
+    static const Uint32 bulkDataThreshold = 1024;
+};
@@ -4,9 +4,29 @@
 #include <sstream>
 #include <memory>
 #include <list>
+#include <algorithm>
 
 #include "json.h"
 #include "Utils.h"
+#include "BufferPool.h"
+#include "Metrics.h"
+#include "StorageBackend.h"
+#include "ContentStore.h"
+#include "StorageTier.h"
+#include "TlsTransport.h"
+#include "TransferPolicy.h"
+#include "UringTransport.h"
+#include "Cluster.h"
+#include "Forwarder.h"
+#include "StoreProxy.h"
+#include "StoreRules.h"
+#include "PixelHash.h"
+#include "PixelStats.h"
+#include "SeriesMetadata.h"
+#include "Worklist.h"
+#include "StorageCommitment.h"
+#include "AssociationPool.h"
+#include "WarmStart.h"
 
 using json = nlohmann::json;
 
@@ -15,26 +35,105 @@ using json = nlohmann::json;
 #include "dcmtk/ofstd/ofstd.h"
 #include "dcmtk/dcmnet/diutil.h"
 #include "dcmtk/dcmdata/dcdict.h"
+#include "dcmtk/dcmdata/dcistrmf.h"
 #include "dcmtk/dcmqrdb/dcmqrsrv.h"
 #include "dcmtk/dcmqrdb/dcmqrcbf.h" 
 #include "dcmtk/dcmqrdb/dcmqrcbm.h" 
 #include "dcmtk/dcmqrdb/dcmqrcbg.h"
 #include "dcmtk/dcmqrdb/dcmqrcbs.h"
 #include "dcmtk/dcmqrdb/dcmqropt.h"
+#include "dcmtk/dcmqrdb/dcmqrsch.h"
 
 #include "dcmsqlhdl.h"
+#include "dcmsqldb.h"
 #include "RetrieveScp.h"
 
-ServerAsyncWorker::ServerAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+ServerAsyncWorker::ServerAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback),
+                                                                               _stop(std::make_shared<sStopRequest>()),
+                                                                               _peers(std::make_shared<PeerTable>())
 {
-    ns::registerCodecs();
+}
+
+Function ServerAsyncWorker::StopFunction(Napi::Env env)
+{
+    std::shared_ptr<sStopRequest> stop = _stop;
+    return Function::New(env, [stop](const CallbackInfo& info) -> Napi::Value {
+        if (info.Length() > 0 && info[0].IsNumber()) {
+            stop->drainTimeout = info[0].As<Number>().Int32Value();
+        }
+        stop->requested = true;
+        return info.Env().Undefined();
+    }, "stop");
+}
+
+void ServerAsyncWorker::Abandon()
+{
+    BaseAsyncWorker::Abandon();
+    _stop->drainTimeout = 0;
+    _stop->requested = true;
+}
+
+namespace {
+    PeerTable::sPeer toPeer(const ns::sIdent& ident)
+    {
+        PeerTable::sPeer peer;
+        peer.aet = ident.aet;
+        peer.hostname = ident.ip;
+        peer.port = ident.port;
+        peer.compression = TransferPolicy::parse(ident.compression);
+        peer.fixedPriority = !ident.priority.empty();
+        peer.priority = ns::dimsePriority(ident.priority);
+        return peer;
+    }
+}
+
+Function ServerAsyncWorker::PeersFunction(Napi::Env env)
+{
+    std::shared_ptr<PeerTable> table = _peers;
+    return Function::New(env, [table](const CallbackInfo& info) -> Napi::Value {
+        if (info.Length() < 1 || !info[0].IsArray()) {
+            TypeError::New(info.Env(), "array of peers expected").ThrowAsJavaScriptException();
+            return info.Env().Undefined();
+        }
+        Array list = info[0].As<Array>();
+        std::vector<PeerTable::sPeer> peers;
+        peers.reserve(list.Length());
+        for (uint32_t i = 0; i < list.Length(); ++i) {
+            Value value = list.Get(i);
+            if (!value.IsObject()) {
+                TypeError::New(info.Env(), "peer is not an object").ThrowAsJavaScriptException();
+                return info.Env().Undefined();
+            }
+            Object object = value.As<Object>();
+            ns::sIdent ident;
+            ident.aet = object.Get("aet").IsString() ? object.Get("aet").As<String>().Utf8Value() : std::string();
+            ident.ip = object.Get("ip").IsString() ? object.Get("ip").As<String>().Utf8Value() : std::string();
+            ident.port = object.Get("port").IsNumber() ? object.Get("port").As<Number>().Int32Value() : 0;
+            ident.compression = object.Get("compression").IsString() ? object.Get("compression").As<String>().Utf8Value() : std::string();
+            ident.priority = object.Get("priority").IsString() ? object.Get("priority").As<String>().Utf8Value() : std::string();
+            if (!ident.valid()) {
+                TypeError::New(info.Env(), "peer needs aet, ip and port").ThrowAsJavaScriptException();
+                return info.Env().Undefined();
+            }
+            peers.push_back(toPeer(ident));
+        }
+        return Number::New(info.Env(), static_cast<double>(table->replace(peers)));
+    }, "setPeers");
 }
 
 void ServerAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-  ns::sInput in = ns::parseInputJson(_input);
+  ns::sInput in = GetInput();
 
   EnableVerboseLogging(in.verbose);
+  ns::applyCodecSettings(in);
+  TransferPolicy::setCpuBudget(in.compressionCpuBudget);
+  Metrics::enableSchedulerTiming();
+  if (in.prioritySlots > 0) {
+      // process wide, shared with the other SCPs
+      DcmQueryRetrieveScheduler::configure(OFstatic_cast(size_t, in.prioritySlots));
+      DCMNET_INFO("priority scheduler: " << in.prioritySlots << " slots for C-GET/C-MOVE sub-operations, read-ahead and background compression");
+  }
 
   if (!in.source.valid())
   {
@@ -49,7 +148,8 @@ void ServerAsyncWorker::Execute(const ExecutionProgress &progress)
   }
 
   int opt_port = in.source.port;
-  static OFString opt_outputDirectory =  OFString(in.storagePath.c_str());
+  // per SCP, several SCPs of a process serve different storage paths
+  OFString opt_outputDirectory = OFString(in.storagePath.c_str());
 
   T_ASC_Network *net;
   DcmAssociationConfiguration asccfg;
@@ -85,13 +185,65 @@ void ServerAsyncWorker::Execute(const ExecutionProgress &progress)
     return;
   }
 
+  /* the index of a store only SCP is written by whoever imports its files */
+  if (!in.storeOnly && !DcmIndexDatabasePool::configure(in.indexBackend == "postgresql" ?
+          DcmIndexDatabasePool::POSTGRESQL : DcmIndexDatabasePool::SQLITE, in.indexConnection))
+  {
+    SetErrorJson(std::string("Index backend not available in this build: ") + in.indexBackend);
+    return;
+  }
+
+  {
+    DcmSQLiteTuning tuning;
+    tuning.cacheSize = in.indexTuning.cacheSize;
+    tuning.mmapSize = in.indexTuning.mmapSize;
+    tuning.pageSize = in.indexTuning.pageSize;
+    tuning.journalMode = in.indexTuning.journalMode;
+    tuning.synchronous = in.indexTuning.synchronous;
+    tuning.tempStore = in.indexTuning.tempStore;
+    std::string error;
+    if (!DcmSQLiteDatabase::configureTuning(tuning, error)) {
+      SetErrorJson("Invalid indexTuning: " + error);
+      return;
+    }
+  }
+
+  /* the storage area becomes a cache of the object store, files are uploaded once written */
+  const char* accessKey = getenv("AWS_ACCESS_KEY_ID");
+  const char* secretKey = getenv("AWS_SECRET_ACCESS_KEY");
+  if (!StorageArea::configure(in.storageBackend == "s3" ? StorageArea::S3 : StorageArea::LOCAL, in.storagePath, in.storageUrl,
+          in.storageRegion, !in.storageAccessKey.empty() || accessKey == NULL ? in.storageAccessKey : std::string(accessKey),
+          !in.storageSecretKey.empty() || secretKey == NULL ? in.storageSecretKey : std::string(secretKey),
+          OFstatic_cast(size_t, std::max(in.storageCacheSize, 0)) * 1024 * 1024))
+  {
+    SetErrorJson(std::string("Storage backend not available in this build or invalid storageUrl: ") + in.storageBackend);
+    return;
+  }
+  if (in.storageBackend == "s3") {
+      DCMNET_INFO("storage backend: " << in.storageUrl << ", " << std::max(in.storageCacheSize, 0) << " MB cached locally");
+  }
+  StorageTier::configure(in.storagePath, in.coldPath, StorageTier::defaultThreads);
+  if (!in.coldPath.empty()) {
+      DCMNET_INFO("cold tier: " << in.coldPath << ", files are recalled for C-MOVE and C-GET");
+  }
+
   /* initialize network, i.e. create an instance of T_ASC_Network*. */
-  OFCondition cond = ASC_initializeNetwork(NET_ACCEPTOR, opt_port, 30, &net);
+  OFCondition cond = ASC_initializeNetwork(NET_ACCEPTOR, opt_port, in.network.acseTimeoutSeconds(), &net);
   if (cond.bad())
   {
     SetErrorJson(std::string("Cannot create network: ") + std::string(cond.text()));
     return;
   }
+  ASC_setTCPSocketOptions(net, in.network.socketBufferSize, in.network.tcpNoDelay);
+  ASC_setTCPKeepAlive(net, in.network.tcpKeepAlive, in.network.keepAliveIntervalSeconds(), ns::sNetworkOptions::keepAliveProbes);
+  cond = TlsTransport::secure(net, true, in.network);
+  if (cond.bad())
+  {
+    SetErrorJson(std::string("Cannot initialize TLS: ") + std::string(cond.text()));
+    ASC_dropNetwork(&net);
+    return;
+  }
+  UringTransport::apply(net, in.network);
 
   /* drop root privileges now and revert to the calling user id (if we are running as setuid root) */
   if (OFStandard::dropPrivileges().bad())
@@ -101,32 +253,143 @@ void ServerAsyncWorker::Execute(const ExecutionProgress &progress)
   }
 
   T_ASC_Network* network = NULL;
-  cond = ASC_initializeNetwork(NET_REQUESTOR, 0, 10000, &network);
+  cond = ASC_initializeNetwork(NET_REQUESTOR, 0, in.network.acseTimeoutSeconds(), &network);
 
   if (cond.bad()) {
       OFString temp_str;
       DCMNET_ERROR("Failed to create requestor network: " << DimseCondition::dump(temp_str, cond));
       return;
   }
+  ASC_setTCPSocketOptions(network, in.network.socketBufferSize, in.network.tcpNoDelay);
+  ASC_setTCPKeepAlive(network, in.network.tcpKeepAlive, in.network.keepAliveIntervalSeconds(), ns::sNetworkOptions::keepAliveProbes);
+  OFCondition tlsCond = TlsTransport::secure(network, false, in.network);
+  if (tlsCond.bad()) {
+      DCMNET_ERROR("Failed to secure requestor network: " << tlsCond.text());
+  }
+  UringTransport::apply(network, in.network);
+
+  /* the accept and storage decisions of a store only SCP, compiled once and applied natively */
+  StoreRules storeRules;
+  std::string rulesError;
+  if (in.storeOnly && !storeRules.compile(in.storeRules, rulesError))
+  {
+    SetErrorJson("Invalid storeRules: " + rulesError);
+    ASC_dropNetwork(&network);
+    ASC_dropNetwork(&net);
+    return;
+  }
+  if (!in.storeOnly && !in.storeRules.empty()) {
+      DCMNET_WARN("storeRules only apply to store only SCPs, ignored");
+  }
+
+  /* instances received by a store only SCP are queued for forwarding before they are acknowledged,
+     or relayed as they arrive and only queued for the proxy destinations that fail to take them */
+  const std::vector<ns::sIdent> spillTo = in.proxySpill ? in.proxyDestinations : std::vector<ns::sIdent>();
+  const std::string queueDirectory = in.forwardQueuePath.empty() ? std::string(opt_outputDirectory.c_str()) + "/.forward" : in.forwardQueuePath;
+  if (in.storeOnly && (!in.forwardRules.empty() || !spillTo.empty())) {
+      if (!Forwarder::configure(queueDirectory, in.forwardRules, spillTo, in.source, in.network,
+              in.forwardAssociations > 0 ? OFstatic_cast(size_t, in.forwardAssociations) : Forwarder::defaultAssociations))
+      {
+        SetErrorJson(std::string("Cannot create forwarding queue: ") + queueDirectory);
+        ASC_dropNetwork(&network);
+        ASC_dropNetwork(&net);
+        return;
+      }
+      DCMNET_INFO("forwarding: " << in.forwardRules.size() << " rules, queued in " << queueDirectory);
+  }
+  else if (!in.forwardRules.empty() || !in.proxyDestinations.empty()) {
+      DCMNET_WARN("forwardRules and proxyDestinations only apply to store only SCPs, ignored");
+  }
+  if (in.storeOnly && in.storageCommitment) {
+      DCMNET_WARN("storageCommitment only applies to the query/retrieve SCP, ignored");
+  }
+  if (in.storeOnly && in.warmStart) {
+      DCMNET_WARN("warmStart only applies to the query/retrieve SCP, ignored");
+  }
+  if (in.storeOnly && !StoreProxy::configure(in.proxyDestinations, in.source, in.network, in.proxySpill, queueDirectory))
+  {
+    SetErrorJson(std::string("Cannot create proxy network"));
+    Forwarder::stop();
+    ASC_dropNetwork(&network);
+    ASC_dropNetwork(&net);
+    return;
+  }
+
+  DCMNET_INFO("max PDU: " << in.network.maxReceivePDU());
+  bool drained = true;
+  std::vector<PeerTable::sPeer> peers;
+  for (const ns::sIdent& peer : in.peers) {
+      peers.push_back(toPeer(peer));
+  }
+  _peers->initialize(peers);
+  DcmQueryRetriveConfigExt cfg(_peers);
+  std::shared_ptr<RateLimiter> limiter = std::make_shared<RateLimiter>(in.aeLimits, in.ipLimits);
+  if (limiter->enabled()) {
+      cfg.setRateLimiter(limiter);
+      DCMNET_INFO("association limits per AE title: " << in.aeLimits.associationsPerSecond << "/s, "
+          << in.aeLimits.concurrentAssociations << " at a time, " << in.aeLimits.bytesPerSecond << " bytes/s; per IP: "
+          << in.ipLimits.associationsPerSecond << "/s, " << in.ipLimits.concurrentAssociations << " at a time, "
+          << in.ipLimits.bytesPerSecond << " bytes/s (0 is no limit)");
+  }
   if (in.storeOnly) {
-      RetrieveScp scp(opt_outputDirectory, in.source.aet.c_str(), in.writeFile);
-      while (cond.good()) {
+      StoreWriteQueue::configure(in.writeThreads > 0 ? in.writeThreads : 4,
+          in.writeDurability == "queued" ? StoreWriteQueue::QUEUED :
+          in.writeDurability == "fsync" ? StoreWriteQueue::SYNCED : StoreWriteQueue::WRITTEN);
+      RetrieveScp scp(opt_outputDirectory, in.source.aet.c_str(), in.writeFile, in.binaryBuffer, this);
+      scp.setStreamToFile(in.streamToFile);
+      scp.setSecureConnection(in.network.tls);
+      scp.setConfig(&cfg);
+      scp.setStoreRules(storeRules);
+      scp.setArenaAllocation(in.arenaAllocation);
+      if (in.maxInFlightSize > 0 || in.maxInFlightMessages > 0) {
+          SetInFlightBudget(OFstatic_cast(size_t, std::max(in.maxInFlightSize, 0)) * 1024 * 1024, OFstatic_cast(size_t, std::max(in.maxInFlightMessages, 0)));
+          scp.setRefuseOverBudget(in.inFlightPolicy == "refuse");
+          DCMNET_INFO("in-flight budget: " << std::max(in.maxInFlightSize, 0) << " MB, " << std::max(in.maxInFlightMessages, 0)
+              << " events, " << (in.inFlightPolicy == "refuse" ? "refusing" : "delaying") << " C-STOREs past it");
+      }
+      scp.setShardDigits(in.storageShardDigits > 0 ? in.storageShardDigits : 0);
+      std::vector<DcmTagKey> eventTags;
+      for (const std::string& key : in.eventTags) {
+          eventTags.push_back(ns::toElement(key, std::string()).xtag);
+      }
+      scp.setEventTags(eventTags);
+      scp.setSeriesAggregation(in.seriesQuietPeriod, in.seriesComplete != "quiet", in.seriesEventsOnly);
+      scp.setMaxPDU(in.network.maxReceivePDU());
+      scp.setDimseTimeout(in.network.dimseTimeoutSeconds(0));
+      scp.setIdleTimeout(in.associationIdleTimeout);
+      scp.setEventLoopThreads(in.eventLoopThreads >= 0 ? in.eventLoopThreads : 4);
+      if (in.poolThreads > 0) {
+          scp.setPool(OFstatic_cast(Uint16, std::min(in.poolThreads, 65535)), OFstatic_cast(Uint16, std::min(std::max(in.poolQueueSize, 0), 65535)));
+          DCMNET_INFO("SCP pool: " << in.poolThreads << " threads, " << std::max(in.poolQueueSize, 0) << " queued associations");
+      }
+      while (cond.good() && !_stop->requested) {
           cond = scp.waitForAssociation(net, progress);
       }
+      drained = scp.drain(_stop->drainTimeout);
+      scp.finishSeries();
   }
   else {
-      DcmQueryRetriveConfigExt cfg;
-      for (auto peer: in.peers) {
-          cfg.addPeer(peer.aet.c_str(), peer.ip.c_str(), peer.port);
-      }
       cfg.setStorageArea(in.storagePath.c_str());
       cfg.setPermissiveMode(in.permissive);
+      cfg.setMoveOrder(in.moveOrder == "database" ? DcmQueryRetriveConfigExt::MOVE_DATABASE :
+          in.moveOrder == "instance" ? DcmQueryRetriveConfigExt::MOVE_INSTANCE : DcmQueryRetriveConfigExt::MOVE_LOCATION);
  
       DcmQueryRetrieveOptions options;
       options.net_ = network;
       options.allowShutdown_ = true;
-      options.disableGetSupport_ = true;
-      options.maxAssociations_ = 128;
+      options.secureConnection_ = in.network.tls;
+      options.maxAssociations_ = in.maxAssociations > 0 ? in.maxAssociations : 128;
+      // associations are served on threads of this process, each with a database handle of its own from
+      // the index pool: a child forked from node would copy its heap on write and inherit a broken event loop
+      options.singleProcess_ = OFTrue;
+      options.keepDBHandleDuringAssociation_ = OFTrue;
+      options.maxPDU_ = in.network.maxReceivePDU();
+      // peers may keep associations open without sending anything, there is no timeout by default
+      options.blockMode_ = in.network.dimseBlockMode(0);
+      options.dimse_timeout_ = in.network.dimseTimeoutSeconds(0);
+      options.acse_timeout_ = in.network.acseTimeoutSeconds();
+      // DIMSE timeouts are whole seconds
+      options.idle_timeout_ = in.associationIdleTimeout > 0 ? (in.associationIdleTimeout + 999) / 1000 : 0;
       DcmXfer netTransPrefer = in.netTransferPrefer.empty() ? DcmXfer(EXS_Unknown) : DcmXfer(in.netTransferPrefer.c_str());
       DcmXfer netTransPropose = in.netTransferPropose.empty() ? DcmXfer(EXS_Unknown) : DcmXfer(in.netTransferPropose.c_str());
       DcmXfer writeTrans = in.writeTransfer.empty() ? DcmXfer(EXS_Unknown) : DcmXfer(in.writeTransfer.c_str());
@@ -136,18 +399,177 @@ void ServerAsyncWorker::Execute(const ExecutionProgress &progress)
       DCMNET_INFO("write transfer syntax (recompress if different to accepted ts): " << writeTrans.getXferName());
       DCMNET_INFO("max associations: " << options.maxAssociations_);
       DCMNET_INFO("permissive mode: " << in.permissive);
+      DCMNET_INFO("C-MOVE sub-operation order: " << (in.moveOrder.empty() ? "location" : in.moveOrder));
 
       options.networkTransferSyntax_ = netTransPrefer.getXfer();
       options.networkTransferSyntaxOut_ = netTransPropose.getXfer();
       options.writeTransferSyntax_ = writeTrans.getXfer();
 
+      options.moveSubAssociations_ = in.moveAssociations > 1 ? in.moveAssociations : 1;
+      DCMNET_INFO("sub-associations per C-MOVE: " << options.moveSubAssociations_);
+      options.moveReadAhead_ = in.moveReadAhead >= 0 ? in.moveReadAhead : 8;
+      if (options.moveSubAssociations_ == 1) {
+          DCMNET_INFO("files read ahead by C-MOVE sub-operations: up to " << options.moveReadAhead_);
+      }
+      options.findReadAhead_ = in.findReadAhead >= 0 ? in.findReadAhead : 32;
+
+      if (in.asyncOperations > 1) {
+          options.asyncOperationsWindow_ = std::min(in.asyncOperations, 65535);
+          options.moveAsyncOperations_ = options.asyncOperationsWindow_;
+          DCMNET_INFO("asynchronous operations window: " << options.asyncOperationsWindow_);
+      }
+
+      // each C-MOVE response of the SCP, including the final one, is reported with its throughput
+      options.moveProgress_ = [this, &progress](const DcmQueryRetrieveMoveProgress& move) {
+          json v = ns::moveProgress(move.remaining, move.completed, move.failed, move.warning, move.elapsed);
+          v["requestor"] = move.requestorAETitle;
+          v["destination"] = move.destinationAETitle;
+          v["status"] = move.status;
+          SendResponse(ns::createResponse(ns::PENDING, "MOVE_PROGRESS", v), progress);
+      };
+
+      options.operationTiming_ = [](const char* operation, double seconds, OFBool success) {
+          Metrics::histogram("scp_operation_seconds", {{"scp", "qr"}, {"operation", operation}}).record(seconds);
+          Metrics::counter("scp_operations_total", {{"scp", "qr"}, {"operation", operation}, {"result", success ? "success" : "failure"}}).add();
+      };
+
+      if (in.transcodeCacheSize > 0) {
+          options.transcodeCacheSize_ = OFstatic_cast(size_t, in.transcodeCacheSize) * 1024 * 1024;
+          options.transcodeCacheDirectory_ = in.transcodeCachePath.empty() ?
+              OFString((in.storagePath + "/.transcode-cache").c_str()) : OFString(in.transcodeCachePath.c_str());
+          DCMNET_INFO("transcode cache: " << in.transcodeCacheSize << " MB in " << options.transcodeCacheDirectory_);
+      }
+
+      if (in.compressThreads > 0 && options.writeTransferSyntax_ != EXS_Unknown) {
+          options.compressionThreads_ = OFstatic_cast(size_t, in.compressThreads);
+          DCMNET_INFO("files converted to the write transfer syntax after the response by " << in.compressThreads << " low priority threads");
+      }
+
+      if (in.bufferPoolSize > 0) {
+          BufferPool::configure(OFstatic_cast(size_t, in.bufferPoolSize) * 1024 * 1024);
+          DCMNET_INFO("buffer pool: " << in.bufferPoolSize << " MB");
+      }
+
+      if (in.skipDuplicates) {
+          options.skipDuplicates_ = OFTrue;
+          DCMNET_INFO("instances already stored are acknowledged without being written again");
+      }
+
+      if (in.packSeries) {
+          if (in.storageBackend == "s3" || options.compressionThreads_ > 0) {
+              DCMNET_WARN("packSeries is not available with the s3 storage backend or compressThreads, instances are stored as files");
+          }
+          else {
+              options.packSeries_ = OFTrue;
+              DCMNET_INFO("instances appended to one pack file per series");
+          }
+      }
+
+      ContentStore::configure(in.linkDuplicates ? ContentStore::defaultFiles : 0);
+      if (in.linkDuplicates) {
+          DCMNET_INFO("stored files identical to one of the last " << ContentStore::defaultFiles << " are replaced by hard links");
+      }
+
+      if (in.storageBackend == "s3" || in.linkDuplicates) {
+          const bool upload = in.storageBackend == "s3";
+          options.storedFile_ = [upload](const char* filename) {
+              // linked before the upload, the cached copy then shares its blocks as well
+              ContentStore::deduplicate(filename);
+              std::string error;
+              if (upload && !StorageArea::stored(filename, error)) {
+                  DCMNET_ERROR("cannot upload " << filename << ": " << error);
+                  return OFFalse;
+              }
+              return OFTrue;
+          };
+      }
+      if (in.storageBackend == "s3" || !in.coldPath.empty()) {
+          options.fetchFile_ = [](const char* filename) {
+              std::string error;
+              if (!StorageTier::recall(filename, error) || !StorageArea::fetch(filename, error)) {
+                  DCMNET_ERROR("cannot fetch " << filename << ": " << error);
+                  return OFFalse;
+              }
+              return OFTrue;
+          };
+      }
+
+      if (in.worklist) {
+          options.worklistFind_ = Worklist::find;
+          DCMNET_INFO("modality worklist: " << Worklist::size() << " items");
+      }
+      if (in.storageCommitment) {
+          AssociationPool::configure(in.associationIdleTimeout);
+          StorageCommitment::configure(in.source, in.peers, in.network);
+          options.storageCommitmentReport_ = [](const char* callingAETitle, const DcmDataset& eventInfo, Uint16 eventTypeID) {
+              StorageCommitment::report(callingAETitle, eventInfo, eventTypeID);
+          };
+      }
+
+      if (in.fileMapCacheSize > 0) {
+          DcmFileMapCache::setMaxEntries(OFstatic_cast(size_t, in.fileMapCacheSize));
+          DCMNET_INFO("file mapping cache: " << in.fileMapCacheSize << " files");
+      }
+
+      DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+      DcmIndexIngestQueue::configure(in.ingestBatchSize > 0 ? in.ingestBatchSize : 64,
+          in.ingestMaxDelay >= 0 ? in.ingestMaxDelay : 50,
+          in.ingestDurability == "queued" ? DcmIndexIngestQueue::QUEUED : DcmIndexIngestQueue::COMMIT);
+      SeriesMetadata::configure(in.seriesMetadata);
+      PixelHash::configure(in.pixelHashes);
+      PixelStats::configure(in.pixelStats);
+
+      if (!in.clusterNode.empty()) {
+          DcmClusterNode node;
+          node.name = in.clusterNode;
+          node.aeTitle = in.source.aet;
+          node.host = !in.clusterHost.empty() ? in.clusterHost : std::string(OFStandard::getHostName().c_str());
+          node.port = in.source.port;
+          node.storagePath = opt_outputDirectory.c_str();
+          node.heartbeat = 0;
+          if (Cluster::join(node, in.clusterHeartbeat)) {
+              DCMNET_INFO("cluster: joined as " << node.name << " (" << node.aeTitle << "@" << node.host << ":" << node.port << ")");
+          }
+          else {
+              DCMNET_WARN("cluster: the index keeps no membership, " << node.name << " runs on its own");
+          }
+      }
+
       DcmQueryRetrieveSQLiteDatabaseHandleFactory factory(&cfg);
       DcmAssociationConfiguration associationConfiguration;
 
+      // warms the caches while the SCP already serves associations
+      if (in.warmStart) {
+          WarmStart::restore(in.storagePath);
+      }
+
       DcmQueryRetrieveSCP scp(cfg, options, factory, associationConfiguration);
-      while (cond.good()) {
+      while (cond.good() && !_stop->requested) {
           cond = scp.waitForAssociation(net);
       }
+      drained = scp.drainAssociations(_stop->drainTimeout);
+      StorageCommitment::stop();
+      Cluster::leave();
+  }
+
+  // the associations have ended, what they queued is written before the request completes
+  if (in.storeOnly) {
+      StoreWriteQueue::flush();
+      StoreProxy::stop();
+      Forwarder::stop();
+  }
+  else {
+      DcmIndexIngestQueue::stop(in.storagePath);
+      if (in.warmStart) {
+          std::string warmError;
+          WarmStart::stop(in.storagePath);
+          if (_stop->requested && !WarmStart::save(in.storagePath, warmError)) {
+              DCMNET_WARN("warm start: " << warmError);
+          }
+      }
+  }
+  if (_stop->requested) {
+      DCMNET_INFO("SCP stopped" << (drained ? "" : ", associations still open were interrupted"));
   }
     
   /* drop the network, i.e. free memory of T_ASC_Network* structure. This call */
@@ -160,4 +582,9 @@ void ServerAsyncWorker::Execute(const ExecutionProgress &progress)
   }
 
   OFStandard::shutdownNetwork();
+
+  json v = json::object();
+  v["stopped"] = _stop->requested.load();
+  v["drained"] = drained;
+  _jsonOutput = NativeResult() ? v : json(v.dump());
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "BaseAsyncWorker.h"
+#include "PeerTable.h"
 
 using namespace Napi;
 
@@ -11,4 +12,29 @@ class ServerAsyncWorker : public BaseAsyncWorker
 
         void Execute(const ExecutionProgress& progress);
 
+        // returns the function JS calls with a drain timeout in ms (default 10000) to stop the SCP:
+        // no more associations are accepted, open ones get until the timeout to finish before their
+        // connections are interrupted, then the queued file writes and index inserts are flushed.
+        // A storeOnly SCP without event loop and pool stops once its current association ended
+        Function StopFunction(Napi::Env env);
+
+        // returns the function JS calls with an array of peers { aet, ip, port, compression } to replace
+        // those the SCP accepts associations from and sends C-MOVE responses to. Associations negotiated
+        // afterwards see the new peers, returns the number of AE titles
+        Function PeersFunction(Napi::Env env);
+
+        // stops the SCP without waiting for open associations
+        void Abandon();
+
+    private:
+        struct sStopRequest {
+            sStopRequest() : requested(false), drainTimeout(10000) {}
+            std::atomic<bool> requested;
+            std::atomic<int> drainTimeout;
+        };
+
+        // shared with the stop function returned to JS which may outlive the worker
+        std::shared_ptr<sStopRequest> _stop;
+        // shared with the peers function returned to JS, initialized from the peers option on start
+        std::shared_ptr<PeerTable> _peers;
 };
@@ -6,6 +6,7 @@
 #include <sstream>
 
 #include "Utils.h"
+#include "TlsTransport.h"
 #include "json.h"
 
 using json = nlohmann::json;
@@ -50,7 +51,7 @@ ShutdownAsyncWorker::ShutdownAsyncWorker(std::string data, Function &callback)
 
 void ShutdownAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-    ns::sInput in = ns::parseInputJson(_input);
+    ns::sInput in = GetInput();
 
     EnableVerboseLogging(in.verbose);
 
@@ -74,14 +75,14 @@ void ShutdownAsyncWorker::Execute(const ExecutionProgress &progress)
     const char *opt_peerTitle = in.target.aet.c_str();
     const char *opt_ourTitle = in.source.aet.c_str();
 
-    OFCmdUnsignedInt opt_maxReceivePDULength = ASC_DEFAULTMAXPDU;
+    OFCmdUnsignedInt opt_maxReceivePDULength = in.network.maxReceivePDU();
     OFCmdUnsignedInt opt_repeatCount = 1;
     OFBool opt_abortAssociation = OFFalse;
     OFCmdUnsignedInt opt_numXferSyntaxes = 1;
     OFCmdUnsignedInt opt_numPresentationCtx = 1;
     OFCmdUnsignedInt maxXferSyntaxes =
         OFstatic_cast(OFCmdUnsignedInt, (DIM_OF(transferSyntaxes)));
-    int opt_acse_timeout = 30;
+    int opt_acse_timeout = in.network.acseTimeoutSeconds();
 
     T_ASC_Network *net;
     T_ASC_Parameters *params;
@@ -98,6 +99,13 @@ void ShutdownAsyncWorker::Execute(const ExecutionProgress &progress)
         SetErrorJson(cond.text());
         return;
     }
+    ASC_setTCPSocketOptions(net, in.network.socketBufferSize, in.network.tcpNoDelay);
+    cond = TlsTransport::secure(net, false, in.network);
+    if (cond.bad())
+    {
+        SetErrorJson(cond.text());
+        return;
+    }
 
     /* initialize association parameters, i.e. create an instance of T_ASC_Parameters*. */
     cond = ASC_createAssociationParameters(&params, opt_maxReceivePDULength);
@@ -115,6 +123,7 @@ void ShutdownAsyncWorker::Execute(const ExecutionProgress &progress)
     /* corresponding values into the association parameters.*/
     sprintf(peerHost, "%s:%d", opt_peer, OFstatic_cast(int, opt_port));
     ASC_setPresentationAddresses(params, OFStandard::getHostName().c_str(), peerHost);
+    ASC_setTransportLayerType(params, in.network.tls);
 
     /* Set the presentation contexts which will be negotiated */
     /* when the network connection will be established */
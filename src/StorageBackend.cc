@@ -0,0 +1,321 @@
+#include "StorageBackend.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#include "Metrics.h"
+#include "S3Storage.h"
+
+namespace
+{
+
+// size of a file, false if it cannot be accessed
+bool fileSize(const std::string& path, Uint64& size)
+{
+#ifdef HAVE_WINDOWS_H
+    struct _stati64 st;
+    if (_stati64(path.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#endif
+    size = static_cast<Uint64>(st.st_size);
+    return true;
+}
+
+bool copyFile(const std::string& from, const std::string& to, std::string& error)
+{
+    OFFile source;
+    OFFile target;
+    if (!source.fopen(from.c_str(), "rb")) {
+        error = "cannot open " + from;
+        return false;
+    }
+    if (!target.fopen(to.c_str(), "wb")) {
+        error = "cannot create " + to;
+        return false;
+    }
+    std::vector<char> buffer(64 * 1024);
+    size_t length;
+    while ((length = source.fread(&buffer[0], 1, buffer.size())) > 0) {
+        if (target.fwrite(&buffer[0], 1, length) != length) {
+            error = "cannot write " + to;
+            return false;
+        }
+    }
+    if (target.fclose() != 0) {
+        error = "cannot write " + to;
+        return false;
+    }
+    return true;
+}
+
+struct sCachedFile {
+    Uint64 size;
+    std::list<std::string>::iterator lru;
+};
+
+std::mutex areaMutex;
+// signalled whenever a fetch ends
+std::condition_variable fetchDone;
+// NULL for the local backend, nothing is cached then
+std::shared_ptr<StorageBackend> areaBackend;
+// storage area without trailing separator
+std::string areaRoot;
+Uint64 cacheLimit = 0;
+// local files uploaded or fetched by this process, most recently used first
+std::map<std::string, sCachedFile> cached;
+std::list<std::string> cachedLru;
+Uint64 cachedTotal = 0;
+// files being fetched, readers of the same file wait for the first fetch
+std::set<std::string> fetching;
+
+Metrics::Gauge& cacheBytes()
+{
+    static Metrics::Gauge& gauge = Metrics::gauge("storage_cache_bytes");
+    return gauge;
+}
+
+// key of a file in the storage area, empty for files outside of it
+std::string keyOf(const std::string& path)
+{
+    if (areaRoot.empty() || path.size() <= areaRoot.size() + 1 || path.compare(0, areaRoot.size(), areaRoot) != 0) {
+        return std::string();
+    }
+    const char separator = path[areaRoot.size()];
+    if (separator != '/' && separator != PATH_SEPARATOR) {
+        return std::string();
+    }
+    std::string key = path.substr(areaRoot.size() + 1);
+    std::replace(key.begin(), key.end(), static_cast<char>(PATH_SEPARATOR), '/');
+    return key;
+}
+
+// marks a local file as most recently used, areaMutex is held
+void touch(const std::string& path, Uint64 size)
+{
+    std::map<std::string, sCachedFile>::iterator it = cached.find(path);
+    if (it == cached.end()) {
+        cachedLru.push_front(path);
+        it = cached.insert(std::make_pair(path, sCachedFile())).first;
+        it->second.lru = cachedLru.begin();
+    }
+    else {
+        cachedLru.splice(cachedLru.begin(), cachedLru, it->second.lru);
+        cachedTotal -= it->second.size;
+        cacheBytes().add(-static_cast<int64_t>(it->second.size));
+    }
+    it->second.size = size;
+    cachedTotal += size;
+    cacheBytes().add(static_cast<int64_t>(size));
+}
+
+// deletes the least recently used local files beyond the cache size, the most recent one is
+// always kept as it is about to be read. areaMutex is held
+void evict()
+{
+    while (cacheLimit > 0 && cachedTotal > cacheLimit && cachedLru.size() > 1) {
+        const std::string path = cachedLru.back();
+        std::map<std::string, sCachedFile>::iterator it = cached.find(path);
+        cachedTotal -= it->second.size;
+        cacheBytes().add(-static_cast<int64_t>(it->second.size));
+        cached.erase(it);
+        cachedLru.pop_back();
+        // readers which opened the file before keep reading it
+        if (!OFStandard::deleteFile(path.c_str())) {
+            DCMNET_DEBUG("storage cache: cannot delete " << path);
+        }
+    }
+}
+
+}
+
+std::string LocalStorageBackend::path(const std::string& key) const
+{
+    std::string path = m_root + PATH_SEPARATOR + key;
+    std::replace(path.begin() + static_cast<std::ptrdiff_t>(m_root.size()), path.end(), '/', static_cast<char>(PATH_SEPARATOR));
+    return path;
+}
+
+bool LocalStorageBackend::put(const std::string& file, const std::string& key, std::string& error)
+{
+    const std::string target = path(key);
+    return file == target || copyFile(file, target, error);
+}
+
+bool LocalStorageBackend::get(const std::string& key, const std::string& file, std::string& error)
+{
+    const std::string source = path(key);
+    return file == source || copyFile(source, file, error);
+}
+
+bool LocalStorageBackend::getRange(const std::string& key, Uint64 offset, size_t length, void* buffer, std::string& error)
+{
+    OFFile file;
+    if (!file.fopen(path(key).c_str(), "rb")) {
+        error = "cannot open " + key;
+        return false;
+    }
+    if (file.fseek(static_cast<offile_off_t>(offset), SEEK_SET) != 0 || file.fread(buffer, 1, length) != length) {
+        error = "cannot read " + key;
+        return false;
+    }
+    return true;
+}
+
+bool StorageArea::configure(eBackend backend, const std::string& root, const std::string& url,
+    const std::string& region, const std::string& accessKey, const std::string& secretKey, size_t cacheSize)
+{
+    std::shared_ptr<StorageBackend> created;
+    if (backend == S3) {
+#ifdef WITH_OBJECT_STORAGE
+        created.reset(new S3StorageBackend(url, region, accessKey, secretKey));
+        if (!created->isValid()) {
+            return false;
+        }
+#else
+        (void)url; (void)region; (void)accessKey; (void)secretKey;
+        return false;
+#endif
+    }
+
+    std::string normalized = root;
+    while (normalized.size() > 1 && (normalized[normalized.size() - 1] == '/' || normalized[normalized.size() - 1] == PATH_SEPARATOR)) {
+        normalized.erase(normalized.size() - 1);
+    }
+    std::lock_guard<std::mutex> lock(areaMutex);
+    areaBackend = created;
+    areaRoot = created ? normalized : std::string();
+    cacheLimit = static_cast<Uint64>(cacheSize);
+    evict();
+    return true;
+}
+
+bool StorageArea::isRemote(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(areaMutex);
+    return areaBackend && !keyOf(path).empty();
+}
+
+bool StorageArea::stored(const std::string& path, std::string& error)
+{
+    std::shared_ptr<StorageBackend> backend;
+    std::string key;
+    {
+        std::lock_guard<std::mutex> lock(areaMutex);
+        backend = areaBackend;
+        key = backend ? keyOf(path) : std::string();
+    }
+    if (key.empty()) {
+        return true;
+    }
+
+    Uint64 size = 0;
+    const bool uploaded = fileSize(path, size) && backend->put(path, key, error);
+    Metrics::counter("storage_uploads_total", {{"result", uploaded ? "success" : "failure"}}).add();
+    if (!uploaded) {
+        if (error.empty()) {
+            error = "cannot access " + path;
+        }
+        return false;
+    }
+    Metrics::counter("storage_upload_bytes_total").add(size);
+
+    std::lock_guard<std::mutex> lock(areaMutex);
+    touch(path, size);
+    evict();
+    return true;
+}
+
+bool StorageArea::fetch(const std::string& path, std::string& error)
+{
+    std::shared_ptr<StorageBackend> backend;
+    std::string key;
+    std::string root;
+    Uint64 size = 0;
+    {
+        std::unique_lock<std::mutex> lock(areaMutex);
+        backend = areaBackend;
+        key = backend ? keyOf(path) : std::string();
+        root = areaRoot;
+        if (key.empty()) {
+            return true;
+        }
+        fetchDone.wait(lock, [&path]() { return fetching.count(path) == 0; });
+        if (fileSize(path, size)) {
+            Metrics::counter("storage_fetches_total", {{"result", "cached"}}).add();
+            touch(path, size);
+            return true;
+        }
+        fetching.insert(path);
+    }
+
+    // the parent directories may have been removed when the storage area was cleaned up
+    OFString directory;
+    OFStandard::getDirNameFromPath(directory, path.c_str(), OFFalse);
+    if (!directory.empty() && !OFStandard::dirExists(directory)) {
+        OFStandard::createDirectory(directory, root.c_str());
+    }
+    const bool fetched = backend->get(key, path, error) && fileSize(path, size);
+    Metrics::counter("storage_fetches_total", {{"result", fetched ? "fetched" : "failure"}}).add();
+
+    std::lock_guard<std::mutex> lock(areaMutex);
+    fetching.erase(path);
+    fetchDone.notify_all();
+    if (!fetched) {
+        if (error.empty()) {
+            error = "cannot fetch " + path;
+        }
+        return false;
+    }
+    touch(path, size);
+    evict();
+    return true;
+}
+
+bool StorageArea::readRange(const std::string& path, Uint64 offset, size_t length, void* buffer, std::string& error)
+{
+    OFFile file;
+    if (file.fopen(path.c_str(), "rb")) {
+        if (file.fseek(static_cast<offile_off_t>(offset), SEEK_SET) != 0 || file.fread(buffer, 1, length) != length) {
+            error = "cannot read " + path;
+            return false;
+        }
+        return true;
+    }
+
+    std::shared_ptr<StorageBackend> backend;
+    std::string key;
+    {
+        std::lock_guard<std::mutex> lock(areaMutex);
+        backend = areaBackend;
+        key = backend ? keyOf(path) : std::string();
+    }
+    if (key.empty()) {
+        error = "cannot open " + path;
+        return false;
+    }
+    Metrics::counter("storage_range_reads_total").add();
+    return backend->getRange(key, offset, length, buffer, error);
+}
+
+Uint64 StorageArea::cachedBytes()
+{
+    std::lock_guard<std::mutex> lock(areaMutex);
+    return cachedTotal;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftypes.h"
+
+// Store of the instance files of a storage area, addressed by their path relative to the storage
+// area with '/' separators. The SCPs always write and read files on local disk, a backend other
+// than the local one keeps the files elsewhere and the storage area only caches them.
+class StorageBackend
+{
+public:
+    virtual ~StorageBackend() {}
+
+    // false if the backend could not be set up, e.g. because of an invalid URL
+    virtual bool isValid() const = 0;
+
+    // copies a local file to key
+    virtual bool put(const std::string& file, const std::string& key, std::string& error) = 0;
+
+    // copies key to a local file, the file is replaced once complete
+    virtual bool get(const std::string& key, const std::string& file, std::string& error) = 0;
+
+    // bytes [offset, offset + length) of key
+    virtual bool getRange(const std::string& key, Uint64 offset, size_t length, void* buffer, std::string& error) = 0;
+};
+
+// The files in the storage area on local disk are the store itself
+class LocalStorageBackend : public StorageBackend
+{
+public:
+    explicit LocalStorageBackend(const std::string& root) : m_root(root) {}
+
+    virtual bool isValid() const { return true; }
+
+    virtual bool put(const std::string& file, const std::string& key, std::string& error);
+
+    virtual bool get(const std::string& key, const std::string& file, std::string& error);
+
+    virtual bool getRange(const std::string& key, Uint64 offset, size_t length, void* buffer, std::string& error);
+
+private:
+    std::string path(const std::string& key) const;
+
+    std::string m_root;
+};
+
+// Process wide backend of the storage area the SCP stores to. With an object store the local files
+// are a read-through cache: files are uploaded once written, fetched when missing and the least
+// recently used ones deleted beyond the cache size. Paths outside the storage area are left alone.
+class StorageArea
+{
+public:
+    enum eBackend {
+        // the files in the storage area
+        LOCAL,
+        // an S3 compatible object store, when built with DCMTK_OBJECT_STORAGE
+        S3
+    };
+
+    // backend of the files below root from now on. url is <scheme>://<host>[:<port>]/<bucket>[/<prefix>],
+    // cacheSize the bytes of local files kept for an object store, 0 keeps all. False if the backend is
+    // not built in or cannot be set up
+    static bool configure(eBackend backend, const std::string& root, const std::string& url,
+        const std::string& region, const std::string& accessKey, const std::string& secretKey, size_t cacheSize);
+
+    // true if the file belongs to a storage area kept in an object store
+    static bool isRemote(const std::string& path);
+
+    // hands a file written to the storage area to the backend, the local copy stays cached
+    static bool stored(const std::string& path, std::string& error);
+
+    // makes sure the file exists on local disk, fetching it from the backend if needed
+    static bool fetch(const std::string& path, std::string& error);
+
+    // bytes of a file read from the local copy if there is one, from the backend otherwise
+    static bool readRange(const std::string& path, Uint64 offset, size_t length, void* buffer, std::string& error);
+
+    // bytes of the local files kept for the object store
+    static Uint64 cachedBytes();
+};
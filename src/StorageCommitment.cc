@@ -0,0 +1,166 @@
+#include "StorageCommitment.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#include "AssociationPool.h"
+#include "Metrics.h"
+
+namespace
+{
+
+struct sReport {
+    ns::sIdent peer;
+    std::shared_ptr<DcmDataset> eventInfo;
+    Uint16 eventTypeID;
+    int attempts;
+    std::chrono::steady_clock::time_point retryAt;
+};
+
+std::mutex commitMutex;
+std::condition_variable commitChanged;
+bool stopping = false;
+std::deque<sReport> reports;
+std::thread sender;
+ns::sIdent commitSource;
+std::vector<ns::sIdent> commitPeers;
+ns::sNetworkOptions commitNetwork;
+
+void updateQueued()
+{
+    Metrics::gauge("storage_commitment_queued").set(static_cast<int64_t>(reports.size()));
+}
+
+OFCondition deliver(sReport& report)
+{
+    OFString transactionUID;
+    report.eventInfo->findAndGetOFString(DCM_TransactionUID, transactionUID);
+    Uint16 status = 0;
+    OFCondition cond = AssociationPool::run(commitSource, report.peer, commitNetwork, [&](CancellableSCU& scu) {
+        const T_ASC_PresentationContextID pcid = scu.findAnyPresentationContextID(UID_StorageCommitmentPushModelSOPClass, "");
+        if (pcid == 0) {
+            return OFCondition(DIMSE_NOVALIDPRESENTATIONCONTEXTID);
+        }
+        return scu.sendEVENTREPORTRequest(pcid, UID_StorageCommitmentPushModelSOPInstance, report.eventTypeID, report.eventInfo.get(), status);
+    }, AssociationPool::STORAGE_COMMITMENT);
+    if (cond.good() && status != STATUS_Success) {
+        DCMNET_WARN("storage commitment: " << report.peer.aet << " answered 0x" << STD_NAMESPACE hex << status
+            << STD_NAMESPACE dec << " to the report of " << transactionUID);
+    }
+    else if (cond.good()) {
+        DCMNET_INFO("storage commitment: report of " << transactionUID << " sent to " << report.peer.aet);
+    }
+    return cond;
+}
+
+// delivers the reports in the order they were queued, those waiting for a retry are passed over
+void sendReports()
+{
+    std::unique_lock<std::mutex> lock(commitMutex);
+    while (!stopping) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::deque<sReport>::iterator due = std::find_if(reports.begin(), reports.end(),
+            [&now](const sReport& r) { return r.retryAt <= now; });
+        if (due == reports.end()) {
+            std::chrono::steady_clock::time_point next = now + std::chrono::seconds(StorageCommitment::maxBackoff);
+            for (const sReport& r : reports) {
+                next = std::min(next, r.retryAt);
+            }
+            commitChanged.wait_until(lock, next);
+            continue;
+        }
+        sReport report = *due;
+        reports.erase(due);
+        lock.unlock();
+
+        OFCondition cond = deliver(report);
+
+        lock.lock();
+        if (cond.good()) {
+            Metrics::counter("storage_commitment_reports_total", {{"result", "sent"}}).add();
+        }
+        else if (++report.attempts >= StorageCommitment::maxAttempts) {
+            DCMNET_ERROR("storage commitment: cannot send a report to " << report.peer.aet << ", dropped after "
+                << report.attempts << " attempts: " << cond.text());
+            Metrics::counter("storage_commitment_reports_total", {{"result", "failed"}}).add();
+        }
+        else {
+            const int backoff = std::min(StorageCommitment::minBackoff << std::min(report.attempts - 1, 16), StorageCommitment::maxBackoff);
+            DCMNET_WARN("storage commitment: cannot send a report to " << report.peer.aet << ", retried in " << backoff << "s: " << cond.text());
+            report.retryAt = std::chrono::steady_clock::now() + std::chrono::seconds(backoff);
+            reports.push_back(report);
+        }
+        updateQueued();
+    }
+}
+
+}
+
+void StorageCommitment::configure(const ns::sIdent& source, const std::vector<ns::sIdent>& peers, const ns::sNetworkOptions& network)
+{
+    stop();
+    std::lock_guard<std::mutex> lock(commitMutex);
+    commitSource = source;
+    commitPeers = peers;
+    commitNetwork = network;
+    stopping = false;
+    sender = std::thread(sendReports);
+}
+
+void StorageCommitment::stop()
+{
+    std::thread stopped;
+    {
+        std::lock_guard<std::mutex> lock(commitMutex);
+        if (!sender.joinable()) {
+            return;
+        }
+        stopping = true;
+        stopped = std::move(sender);
+    }
+    commitChanged.notify_all();
+    stopped.join();
+
+    std::lock_guard<std::mutex> lock(commitMutex);
+    if (!reports.empty()) {
+        DCMNET_WARN("storage commitment: " << reports.size() << " reports not sent are dropped");
+        reports.clear();
+        updateQueued();
+    }
+}
+
+void StorageCommitment::report(const std::string& callingAet, const DcmDataset& eventInfo, Uint16 eventTypeID)
+{
+    std::lock_guard<std::mutex> lock(commitMutex);
+    std::vector<ns::sIdent>::const_iterator peer = std::find_if(commitPeers.begin(), commitPeers.end(),
+        [&callingAet](const ns::sIdent& p) { return p.aet == callingAet; });
+    if (peer == commitPeers.end()) {
+        DCMNET_WARN("storage commitment: " << callingAet << " is not a known peer, its report is dropped");
+        Metrics::counter("storage_commitment_reports_total", {{"result", "failed"}}).add();
+        return;
+    }
+    sReport entry;
+    entry.peer = *peer;
+    entry.eventInfo = std::make_shared<DcmDataset>(eventInfo);
+    entry.eventTypeID = eventTypeID;
+    entry.attempts = 0;
+    entry.retryAt = std::chrono::steady_clock::now();
+    reports.push_back(entry);
+    updateQueued();
+    commitChanged.notify_one();
+}
+
+size_t StorageCommitment::queued()
+{
+    std::lock_guard<std::mutex> lock(commitMutex);
+    return reports.size();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcdatset.h"
+
+// N-EVENT-REPORTs of the Storage Commitment requests a Q/R SCP accepted. The SCP looks up the
+// requested instances while the requester waits for the N-ACTION response and queues the report,
+// which a sender thread delivers on an association of its own to the requester, looked up by AE
+// title in the peers. The associations are pooled so a modality committing instance after
+// instance gets its reports over one association. A requester that cannot be reached is retried
+// with exponential backoff until maxAttempts, reports still queued at stop() are dropped.
+class StorageCommitment
+{
+public:
+    // sends the reports queued from now on to the peers, calling itself source over network
+    static void configure(const ns::sIdent& source, const std::vector<ns::sIdent>& peers, const ns::sNetworkOptions& network);
+
+    // stops the sender once the report it is sending is delivered or failed
+    static void stop();
+
+    // queues the report owed to callingAet, dropped with a warning if it is not a known peer
+    static void report(const std::string& callingAet, const DcmDataset& eventInfo, Uint16 eventTypeID);
+
+    // reports queued and not delivered yet
+    static size_t queued();
+
+    // attempts to deliver a report before it is dropped
+    static const int maxAttempts = 8;
+
+    // seconds between the attempts, doubled up to maxBackoff
+    static const int minBackoff = 1;
+    static const int maxBackoff = 120;
+};
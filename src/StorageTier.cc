@@ -0,0 +1,292 @@
+#include "StorageTier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#include "Metrics.h"
+
+namespace
+{
+
+// size and modification time of a file, false if it cannot be accessed
+bool fileStatus(const std::string& path, long long& size, long long& mtime)
+{
+#ifdef HAVE_WINDOWS_H
+    struct _stati64 st;
+    if (_stati64(path.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#endif
+    size = static_cast<long long>(st.st_size);
+    mtime = static_cast<long long>(st.st_mtime);
+    return true;
+}
+
+bool exists(const std::string& path)
+{
+    long long size, mtime;
+    return fileStatus(path, size, mtime);
+}
+
+// hidden file next to path, a reindex never picks it up
+std::string temporaryFile(const std::string& path, const char* suffix)
+{
+    OFString directory;
+    OFString name;
+    OFStandard::getDirNameFromPath(directory, path.c_str(), OFFalse);
+    OFStandard::getFilenameFromPath(name, path.c_str());
+    std::string result = directory.c_str();
+    if (!result.empty()) {
+        result += PATH_SEPARATOR;
+    }
+    return result + "." + name.c_str() + suffix;
+}
+
+bool makeParentDirectory(const std::string& path)
+{
+    OFString directory;
+    OFStandard::getDirNameFromPath(directory, path.c_str(), OFFalse);
+    return directory.empty() || OFStandard::dirExists(directory) || OFStandard::createDirectory(directory, OFFilename()).good();
+}
+
+bool copyFile(const std::string& from, const std::string& to)
+{
+    OFFile source;
+    OFFile target;
+    if (!source.fopen(from.c_str(), "rb") || !target.fopen(to.c_str(), "wb")) {
+        return false;
+    }
+    std::vector<char> buffer(1024 * 1024);
+    size_t length;
+    while ((length = source.fread(&buffer[0], 1, buffer.size())) > 0) {
+        if (target.fwrite(&buffer[0], 1, length) != length) {
+            return false;
+        }
+    }
+    return target.fclose() == 0;
+}
+
+// never destroyed, the recall threads still wait on them when the process exits
+std::mutex& tierMutex = *new std::mutex;
+// signalled whenever a recall ends or a file is queued
+std::condition_variable& tierChanged = *new std::condition_variable;
+std::string hotRoot;
+std::string coldRoot;
+size_t recallThreads = 0;
+// files being recalled, a retrieval of the same file waits for it
+std::set<std::string> recalling;
+// prefetched files waiting for a recall thread
+std::deque<std::string> queued;
+std::atomic<size_t> recalledFiles(0);
+
+void recallThread()
+{
+    std::unique_lock<std::mutex> lock(tierMutex);
+    while (true) {
+        tierChanged.wait(lock, []() { return !queued.empty(); });
+        const std::string path = queued.front();
+        queued.pop_front();
+        lock.unlock();
+        std::string error;
+        if (!StorageTier::recall(path, error)) {
+            DCMNET_WARN("cannot recall " << path << " from the cold tier: " << error);
+        }
+        lock.lock();
+    }
+}
+
+std::string withoutTrailingSeparator(const std::string& path)
+{
+    std::string result = path;
+    while (result.size() > 1 && (result[result.size() - 1] == '/' || result[result.size() - 1] == PATH_SEPARATOR)) {
+        result.erase(result.size() - 1);
+    }
+    return result;
+}
+
+}
+
+void StorageTier::configure(const std::string& hot, const std::string& cold, size_t threads)
+{
+    std::lock_guard<std::mutex> lock(tierMutex);
+    hotRoot = withoutTrailingSeparator(hot);
+    coldRoot = cold.empty() ? std::string() : withoutTrailingSeparator(cold);
+    // the threads live as long as the process, as the store writers do
+    for (; !coldRoot.empty() && recallThreads < std::max<size_t>(threads, 1); ++recallThreads) {
+        std::thread(recallThread).detach();
+    }
+}
+
+bool StorageTier::isConfigured()
+{
+    std::lock_guard<std::mutex> lock(tierMutex);
+    return !coldRoot.empty();
+}
+
+std::string StorageTier::relocate(const std::string& path, const std::string& fromRoot, const std::string& toRoot)
+{
+    const std::string from = withoutTrailingSeparator(fromRoot);
+    if (from.empty() || path.size() <= from.size() + 1 || path.compare(0, from.size(), from) != 0 ||
+        (path[from.size()] != '/' && path[from.size()] != PATH_SEPARATOR)) {
+        return std::string();
+    }
+    return withoutTrailingSeparator(toRoot) + path.substr(from.size());
+}
+
+bool StorageTier::migrate(const std::string& path, const std::string& coldFile, E_TransferSyntax xfer,
+    unsigned long long& hotBytes, unsigned long long& coldBytes, std::string& error)
+{
+    long long size = 0;
+    long long mtime = 0;
+    if (!fileStatus(path, size, mtime)) {
+        error = "cannot access " + path;
+        return false;
+    }
+    DcmFileFormat fileformat;
+    OFCondition cond = fileformat.loadFile(path.c_str());
+    if (cond.bad()) {
+        error = std::string("cannot read ") + path + ": " + cond.text();
+        return false;
+    }
+    DcmDataset* dataset = fileformat.getDataset();
+    E_TransferSyntax target = dataset->getOriginalXfer();
+    if (xfer != EXS_Unknown && xfer != target) {
+        dataset->chooseRepresentation(xfer, NULL);
+        if (dataset->canWriteXfer(xfer)) {
+            target = xfer;
+        }
+        else {
+            // e.g. a lossless codec for a photometric interpretation it cannot encode
+            DCMNET_DEBUG("cannot convert " << path << " to " << DcmXfer(xfer).getXferName() << ", it is moved as is");
+        }
+    }
+
+    const std::string temporary = temporaryFile(coldFile, ".tier");
+    if (!makeParentDirectory(coldFile)) {
+        error = "cannot create the directory of " + coldFile;
+        return false;
+    }
+    cond = fileformat.saveFile(temporary.c_str(), target, EET_ExplicitLength, EGL_recalcGL, EPD_withoutPadding, 0, 0, EWM_fileformat);
+    if (cond.bad() || !OFStandard::renameFile(temporary.c_str(), coldFile.c_str())) {
+        error = "cannot write " + coldFile + (cond.bad() ? std::string(": ") + cond.text() : std::string());
+        OFStandard::deleteFile(temporary.c_str());
+        return false;
+    }
+
+    long long currentSize = 0;
+    long long currentMtime = 0;
+    if (!fileStatus(path, currentSize, currentMtime) || currentSize != size || currentMtime != mtime) {
+        // stored again while being migrated, the newer file stays hot
+        OFStandard::deleteFile(coldFile.c_str());
+        error = path + " changed while being migrated";
+        return false;
+    }
+    // readers which opened the hot file before keep reading it
+    if (!OFStandard::deleteFile(path.c_str())) {
+        OFStandard::deleteFile(coldFile.c_str());
+        error = "cannot delete " + path;
+        return false;
+    }
+    long long written = 0;
+    fileStatus(coldFile, written, mtime);
+    hotBytes += static_cast<unsigned long long>(size);
+    coldBytes += static_cast<unsigned long long>(written);
+    return true;
+}
+
+bool StorageTier::recall(const std::string& path, std::string& error)
+{
+    std::string coldFile;
+    {
+        std::unique_lock<std::mutex> lock(tierMutex);
+        coldFile = coldRoot.empty() ? std::string() : relocate(path, hotRoot, coldRoot);
+        if (coldFile.empty()) {
+            return true;
+        }
+        tierChanged.wait(lock, [&path]() { return recalling.count(path) == 0; });
+        if (exists(path) || !exists(coldFile)) {
+            return true;
+        }
+        recalling.insert(path);
+    }
+
+    Metrics::Timer timer(Metrics::histogram("storage_recall_seconds"));
+    const std::string temporary = temporaryFile(path, ".recall");
+    bool recalled = makeParentDirectory(path) && copyFile(coldFile, temporary) && OFStandard::renameFile(temporary.c_str(), path.c_str());
+    if (recalled) {
+        // the instance is kept on one tier only, the next migration moves it again
+        OFStandard::deleteFile(coldFile.c_str());
+        ++recalledFiles;
+    }
+    else {
+        OFStandard::deleteFile(temporary.c_str());
+        error = "cannot copy " + coldFile + " to " + path;
+    }
+    Metrics::counter("storage_recalls_total", {{"result", recalled ? "success" : "failure"}}).add();
+
+    std::lock_guard<std::mutex> lock(tierMutex);
+    recalling.erase(path);
+    tierChanged.notify_all();
+    return recalled;
+}
+
+bool StorageTier::isCold(const std::string& path)
+{
+    std::string coldFile;
+    {
+        std::lock_guard<std::mutex> lock(tierMutex);
+        coldFile = coldRoot.empty() ? std::string() : relocate(path, hotRoot, coldRoot);
+    }
+    return !coldFile.empty() && exists(coldFile);
+}
+
+void StorageTier::prefetch(const std::vector<std::string>& paths)
+{
+    std::string hot;
+    std::string cold;
+    {
+        std::lock_guard<std::mutex> lock(tierMutex);
+        hot = hotRoot;
+        cold = coldRoot;
+    }
+    if (cold.empty()) {
+        return;
+    }
+    // the lookups run without the lock, only files that are cold are queued
+    std::vector<std::string> recalls;
+    for (const std::string& path : paths) {
+        const std::string coldFile = relocate(path, hot, cold);
+        if (!coldFile.empty() && !exists(path) && exists(coldFile)) {
+            recalls.push_back(path);
+        }
+    }
+    if (recalls.empty()) {
+        return;
+    }
+    DCMNET_DEBUG("recalling " << recalls.size() << " files from the cold tier");
+    std::lock_guard<std::mutex> lock(tierMutex);
+    queued.insert(queued.end(), recalls.begin(), recalls.end());
+    tierChanged.notify_all();
+}
+
+size_t StorageTier::recalled()
+{
+    return recalledFiles;
+}
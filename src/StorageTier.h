@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcxfer.h"
+
+// Cold tier of a storage area: a second directory, e.g. on cheaper disks or a mounted bucket,
+// holding the files of studies that were neither stored to nor retrieved for a while, usually
+// compressed. The index keeps the path of the hot tier, a file migrated to the cold tier is at the
+// same path relative to the cold directory. A retrieval recalls the file to the hot tier, and
+// prefetch() recalls the other files of the same request on a pool of threads, so the latency of
+// the cold tier is paid about once per request instead of once per instance.
+class StorageTier
+{
+public:
+    // cold directory of the files below hotRoot from now on, an empty coldRoot disables recalls.
+    // threads recall prefetched files in parallel
+    static void configure(const std::string& hotRoot, const std::string& coldRoot, size_t threads);
+
+    // true once a cold directory is configured
+    static bool isConfigured();
+
+    // path of a file below fromRoot moved below toRoot, empty for files outside of fromRoot
+    static std::string relocate(const std::string& path, const std::string& fromRoot, const std::string& toRoot);
+
+    // writes a hot file to coldFile, converted to xfer unless EXS_Unknown or not encodable, and
+    // deletes the hot file. A file replaced meanwhile stays on the hot tier. The sizes of both
+    // files are added to hotBytes and coldBytes
+    static bool migrate(const std::string& path, const std::string& coldFile, E_TransferSyntax xfer,
+        unsigned long long& hotBytes, unsigned long long& coldBytes, std::string& error);
+
+    // moves the file back from the cold tier if it is not on the hot tier, waits for a recall of
+    // the same file already running. True if there is nothing to recall
+    static bool recall(const std::string& path, std::string& error);
+
+    // true if the file was migrated to the cold tier and not recalled since
+    static bool isCold(const std::string& path);
+
+    // queues the recall of files, those on the hot tier are skipped
+    static void prefetch(const std::vector<std::string>& paths);
+
+    // number of files recalled by this process
+    static size_t recalled();
+
+    // default number of threads recalling prefetched files
+    static const size_t defaultThreads = 8;
+};
@@ -4,9 +4,22 @@
 #include <sstream>
 #include <memory>
 #include <list>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <fstream>
+
+#include <sys/stat.h>
 
 #include "json.h"
 #include "Utils.h"
+#include "DicomJsonReader.h"
+#include "DirectoryScanner.h"
+#include "TlsTransport.h"
 
 using json = nlohmann::json;
 
@@ -20,6 +33,10 @@ using json = nlohmann::json;
 #include "dcmtk/dcmdata/cmdlnarg.h"  /* for prepareCmdLineArgs */
 #include "dcmtk/dcmdata/dcostrmz.h"  /* for dcmZlibCompressionLevel */
 #include "dcmtk/dcmnet/dstorscu.h"   /* for DcmStorageSCU */
+#include "dcmtk/dcmnet/scu.h"        /* for DcmSCU */
+#include "dcmtk/dcmdata/dcdatutl.h"  /* for DcmDataUtil */
+#include "dcmtk/dcmdata/dcistrmb.h"  /* for DcmInputBufferStream */
+#include "dcmtk/dcmdata/dcdeftag.h"  /* for DCM_SOPClassUID */
 
 #include "dcmtk/dcmjpeg/djdecode.h"  /* for JPEG decoders */
 #include "dcmtk/dcmjpls/djdecode.h"  /* for JPEG-LS decoders */
@@ -32,18 +49,280 @@ using json = nlohmann::json;
 #define PATTERN_MATCHING_AVAILABLE
 #endif
 
-StoreAsyncWorker::StoreAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+namespace
 {
-    ns::registerCodecs();
+    // maximum number of presentation contexts in a single association negotiation
+    const size_t maxPresentationContexts = 128;
+
+    struct sStoreItem
+    {
+        sStoreItem() : valid(false), index(0) {}
+        OFFilename file;
+        OFString sopClass;
+        OFString sopInstance;
+        OFString xfer;
+        bool valid;
+        // set for instances sent from memory, which have no file
+        std::shared_ptr<DcmDataset> dataset;
+        size_t index;
+
+        // the file or the position of the instance in memory, for messages
+        std::string name() const
+        {
+            return file.isEmpty() ? "dataset " + std::to_string(index) : std::string(file.getCharPointer());
+        }
+    };
+
+    // stops sending after the current SOP instance once the request has been cancelled
+    class CancellableStorageSCU : public DcmStorageSCU
+    {
+    public:
+        explicit CancellableStorageSCU(const std::atomic<bool>* cancelled) : m_cancelled(cancelled) {}
 
-    m_acse_timeout = 60;
-    m_dimse_timeout = 60;
+    protected:
+        virtual OFBool shouldStopAfterCurrentSOPInstance()
+        {
+            return m_cancelled->load() || DcmStorageSCU::shouldStopAfterCurrentSOPInstance();
+        }
+
+    private:
+        const std::atomic<bool>* m_cancelled;
+    };
+
+    // the presentation contexts and instances of one association negotiation
+    struct sAssociationPlan
+    {
+        std::set<OFString> sopClasses;
+        std::set<std::pair<OFString, OFString> > encapsulated;  // sop class, transfer syntax
+        std::vector<sStoreItem> items;
+
+        size_t contexts() const
+        {
+            return sopClasses.size() + encapsulated.size();
+        }
+    };
+
+    // groups the instances into as few negotiations as their presentation contexts allow: one
+    // uncompressed context per SOP class, which also serves as fallback for compressed files, and one
+    // per compressed transfer syntax of the class. SOP classes are packed first fit decreasing, none
+    // has more compressed transfer syntaxes than fit into a negotiation. The instances of each
+    // negotiation are sorted by their context
+    std::vector<sAssociationPlan> planAssociations(const std::vector<sStoreItem>& items)
+    {
+        std::map<OFString, std::set<OFString> > classes;  // sop class, compressed transfer syntaxes
+        for (const sStoreItem& item : items)
+        {
+            std::set<OFString>& xfers = classes[item.sopClass];
+            if (DcmXfer(item.xfer.c_str()).isEncapsulated())
+            {
+                xfers.insert(item.xfer);
+            }
+        }
+        std::vector<std::pair<size_t, OFString> > units;  // contexts, sop class
+        for (const std::pair<const OFString, std::set<OFString> >& c : classes)
+        {
+            units.push_back(std::make_pair(1 + c.second.size(), c.first));
+        }
+        std::stable_sort(units.begin(), units.end(), [](const std::pair<size_t, OFString>& a, const std::pair<size_t, OFString>& b) {
+            return a.first > b.first;
+        });
+
+        std::vector<sAssociationPlan> plans;
+        std::map<OFString, size_t> planOf;
+        for (const std::pair<size_t, OFString>& unit : units)
+        {
+            size_t p = 0;
+            while (p < plans.size() && plans[p].contexts() + unit.first > maxPresentationContexts)
+            {
+                ++p;
+            }
+            if (p == plans.size())
+            {
+                plans.push_back(sAssociationPlan());
+            }
+            plans[p].sopClasses.insert(unit.second);
+            for (const OFString& xfer : classes[unit.second])
+            {
+                plans[p].encapsulated.insert(std::make_pair(unit.second, xfer));
+            }
+            planOf[unit.second] = p;
+        }
+
+        for (const sStoreItem& item : items)
+        {
+            plans[planOf[item.sopClass]].items.push_back(item);
+        }
+        // uncompressed files share the context of their SOP class
+        auto context = [](const sStoreItem& item) {
+            return std::make_pair(item.sopClass, DcmXfer(item.xfer.c_str()).isEncapsulated() ? item.xfer : OFString());
+        };
+        for (sAssociationPlan& plan : plans)
+        {
+            std::stable_sort(plan.items.begin(), plan.items.end(), [&context](const sStoreItem& a, const sStoreItem& b) {
+                return context(a) < context(b);
+            });
+        }
+        return plans;
+    }
+
+    bool fileStatus(const OFFilename& fname, long long& size, long long& mtime)
+    {
+#ifdef HAVE_WINDOWS_H
+        struct _stati64 st;
+        if (_stati64(fname.getCharPointer(), &st) != 0)
+            return false;
+#else
+        struct stat st;
+        if (stat(fname.getCharPointer(), &st) != 0)
+            return false;
+#endif
+        size = static_cast<long long>(st.st_size);
+        mtime = static_cast<long long>(st.st_mtime);
+        return true;
+    }
+
+    // SOP class, instance and transfer syntax of files sent before, by path, so files whose size and
+    // modification time did not change are planned without reading their headers again. The entries
+    // can be written from the index as well: {"files": {"<path>": {"sopClassUID", "sopInstanceUID",
+    // "transferSyntaxUID", "size", "mtime"}}}, size and mtime are only checked for files found below
+    // the source path
+    class StoreManifest
+    {
+    public:
+        explicit StoreManifest(const std::string& path) : m_path(path), m_entries(json::object()), m_pending(0)
+        {
+            if (m_path.empty())
+                return;
+            std::ifstream stream(m_path.c_str());
+            if (!stream)
+                return;
+            json manifest = json::parse(stream, nullptr, false);
+            if (!manifest.is_object() || !manifest.contains("files") || !manifest["files"].is_object())
+            {
+                DCMNET_WARN("ignoring invalid store manifest: " << m_path);
+                return;
+            }
+            m_entries = manifest["files"];
+            DCMNET_INFO("store manifest: " << m_entries.size() << " files");
+        }
+
+        // all files of the manifest, as recorded
+        void items(std::vector<sStoreItem>& items) const
+        {
+            for (json::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+            {
+                sStoreItem item;
+                item.file = OFFilename(it.key().c_str());
+                fill(*it, item);
+                items.push_back(item);
+            }
+        }
+
+        // true if the file did not change since it was recorded
+        bool lookup(sStoreItem& item) const
+        {
+            json::const_iterator it = m_entries.find(item.file.getCharPointer());
+            long long size = 0, mtime = 0;
+            if (it == m_entries.end() || !it->is_object() || !fileStatus(item.file, size, mtime))
+                return false;
+            if (it->value("size", -1LL) != size || it->value("mtime", -1LL) != mtime)
+                return false;
+            fill(*it, item);
+            return item.valid;
+        }
+
+        void record(const sStoreItem& item)
+        {
+            long long size = 0, mtime = 0;
+            if (m_path.empty() || !item.valid || !fileStatus(item.file, size, mtime))
+                return;
+            json entry = json::object();
+            entry["sopClassUID"] = item.sopClass.c_str();
+            entry["sopInstanceUID"] = item.sopInstance.c_str();
+            entry["transferSyntaxUID"] = item.xfer.c_str();
+            entry["size"] = size;
+            entry["mtime"] = mtime;
+            m_entries[item.file.getCharPointer()] = entry;
+            ++m_pending;
+        }
+
+        void save()
+        {
+            if (m_pending == 0)
+                return;
+            json manifest = json::object();
+            manifest["files"] = m_entries;
+            const std::string tmpPath = m_path + "_";
+            {
+                std::ofstream stream(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+                stream << manifest.dump();
+                if (!stream)
+                {
+                    DCMNET_WARN("failed writing store manifest: " << tmpPath);
+                    return;
+                }
+            }
+            OFStandard::deleteFile(OFFilename(m_path.c_str()));
+            if (!OFStandard::renameFile(OFFilename(tmpPath.c_str()), OFFilename(m_path.c_str())))
+            {
+                DCMNET_WARN("failed renaming store manifest: " << tmpPath);
+                return;
+            }
+            m_pending = 0;
+        }
+
+    private:
+        static void fill(const json& entry, sStoreItem& item)
+        {
+            if (!entry.is_object())
+                return;
+            item.sopClass = entry.value("sopClassUID", std::string()).c_str();
+            item.sopInstance = entry.value("sopInstanceUID", std::string()).c_str();
+            item.xfer = entry.value("transferSyntaxUID", std::string()).c_str();
+            item.valid = !item.sopClass.empty() && !item.sopInstance.empty() && !item.xfer.empty();
+        }
+
+        std::string m_path;
+        json m_entries;
+        size_t m_pending;
+    };
+
+    // reads the meta header of the files not known from the manifest, split over the given number of threads
+    void prescanFile(sStoreItem& item)
+    {
+        if (item.valid || !DcmDataUtil::isDicomFile(item.file)) return;
+        OFCondition status = DcmDataUtil::getSOPInstanceFromFile(item.file, item.sopClass, item.sopInstance, item.xfer, ERM_metaOnly);
+        item.valid = status.good() && !item.sopClass.empty() && !item.sopInstance.empty() && !item.xfer.empty();
+    }
+
+    // a DICOM file, with or without preamble and meta header, or a bare dataset in memory
+    DcmDataset* parseDataset(const std::string& bytes)
+    {
+        if (bytes.empty())
+        {
+            return NULL;
+        }
+        DcmInputBufferStream stream;
+        stream.setBuffer(bytes.data(), OFstatic_cast(offile_off_t, bytes.size()));
+        stream.setEos();
+        DcmFileFormat fileformat;
+        fileformat.transferInit();
+        OFCondition status = fileformat.read(stream, EXS_Unknown, EGL_noChange, DCM_MaxReadLength);
+        fileformat.transferEnd();
+        return status.good() ? fileformat.getAndRemoveDataset() : NULL;
+    }
+}
+
+StoreAsyncWorker::StoreAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
     m_sourceDirectory = "";
+    m_asyncOperations = 1;
+    m_priority = DIMSE_PRIORITY_MEDIUM;
 }
 
 void StoreAsyncWorker::Execute(const ExecutionProgress &progress)
 {
-    ns::sInput in = ns::parseInputJson(_input);
+    ns::sInput in = GetInput();
 
     EnableVerboseLogging(in.verbose);
 
@@ -59,18 +338,50 @@ void StoreAsyncWorker::Execute(const ExecutionProgress &progress)
         return;
     }
 
-    if (!setScanDirectory(in.sourcePath.c_str())) {
+    if (!in.datasets.empty()) {
+        setDatasets(in.datasets);
+        if (m_datasets.empty()) {
+            SetErrorJson("No valid DICOM datasets set");
+            return;
+        }
+    }
+    else if (!in.jsonDatasets.empty()) {
+        setJsonDatasets(in.jsonDatasets, in.bulkData);
+        if (m_datasets.empty()) {
+            SetErrorJson("No valid DICOM JSON datasets set");
+            return;
+        }
+    }
+    else if ((!in.sourcePath.empty() || in.manifestPath.empty()) && !setScanDirectory(in.sourcePath.c_str())) {
         SetErrorJson("Invalid source path set, no DICOM files found");
         return;
     }
+    m_manifestPath = in.manifestPath;
 
     // DcmXfer netTransPropose = in.netTransferPropose.empty() ? DcmXfer(EXS_Unknown) : DcmXfer(in.netTransferPropose.c_str());
     // DCMNET_INFO("proposed network transfer syntax for outgoing associations: " << netTransPropose.getXferName());
     // m_networkTransferSyntax = netTransPropose.getXfer();
 
-    bool success = sendStoreRequest(in.target.aet.c_str(), in.target.ip.c_str(), OFstatic_cast(Uint16, in.target.port), in.source.aet.c_str() );
+    m_network = in.network;
+    m_priority = ns::dimsePriority(in.priority);
+    m_asyncOperations = OFstatic_cast(Uint16, std::min(std::max(in.asyncOperations, 1), 65535));
+    if (m_asyncOperations > 1)
+    {
+        DCMNET_INFO("proposing an asynchronous operations window of " << m_asyncOperations << " outstanding C-STORE requests");
+    }
+
+    bool success = false;
+    if (in.parallelism > 1 || !m_manifestPath.empty()) {
+        success = sendPlannedStoreRequest(in.target.aet.c_str(), in.target.ip.c_str(), OFstatic_cast(Uint16, in.target.port), in.source.aet.c_str(), static_cast<size_t>(std::max(in.parallelism, 1)));
+    }
+    else {
+        success = sendStoreRequest(in.target.aet.c_str(), in.target.ip.c_str(), OFstatic_cast(Uint16, in.target.port), in.source.aet.c_str() );
+    }
 
-    if (!success) {
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+    }
+    else if (!success) {
         SetErrorJson("Failed to send DICOM files to target");
     }
 
@@ -99,6 +410,95 @@ bool StoreAsyncWorker::setScanDirectory(const OFFilename &dir)
 
 }
 
+size_t StoreAsyncWorker::setDatasets(std::vector<std::string>& datasets)
+{
+    std::vector<std::shared_ptr<DcmDataset> > parsed(datasets.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> parsers;
+    const size_t threads = std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), datasets.size());
+    for (size_t t = 0; t < threads; ++t)
+    {
+        parsers.push_back(std::thread([&datasets, &parsed, &next]() {
+            for (size_t i = next++; i < datasets.size(); i = next++)
+            {
+                parsed[i].reset(parseDataset(datasets[i]));
+                std::string().swap(datasets[i]);
+            }
+        }));
+    }
+    for (std::thread& parser : parsers)
+    {
+        parser.join();
+    }
+
+    size_t invalid = 0;
+    m_datasets.clear();
+    for (size_t i = 0; i < parsed.size(); ++i)
+    {
+        if (!parsed[i])
+        {
+            DCMNET_ERROR("bad DICOM dataset " << i << ", ignoring it");
+            ++invalid;
+        }
+        m_datasets.push_back(parsed[i]);
+    }
+    return invalid;
+}
+
+size_t StoreAsyncWorker::setJsonDatasets(std::vector<std::string>& texts, const std::map<std::string, std::string>& bulkData)
+{
+    const DicomJsonReader::BulkDataFunction resolve = [&bulkData](const std::string& uri, const char*& data, size_t& length) {
+        std::map<std::string, std::string>::const_iterator it = bulkData.find(uri);
+        if (it == bulkData.end())
+        {
+            return false;
+        }
+        data = it->second.data();
+        length = it->second.size();
+        return true;
+    };
+    std::vector<std::vector<std::shared_ptr<DcmDataset> > > read(texts.size());
+    std::vector<std::string> errors(texts.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> readers;
+    const size_t threads = std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), texts.size());
+    for (size_t t = 0; t < threads; ++t)
+    {
+        readers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < texts.size(); i = next++)
+            {
+                if (!DicomJsonReader::read(texts[i].data(), texts[i].size(), resolve, [&read, i](DcmDataset* dataset) {
+                        read[i].push_back(std::shared_ptr<DcmDataset>(dataset));
+                        return true;
+                    }, errors[i]))
+                {
+                    read[i].clear();
+                }
+                std::string().swap(texts[i]);
+            }
+        }));
+    }
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+
+    size_t invalid = 0;
+    m_datasets.clear();
+    for (size_t i = 0; i < read.size(); ++i)
+    {
+        if (!errors[i].empty())
+        {
+            DCMNET_ERROR("bad DICOM JSON " << i << ", ignoring it: " << errors[i]);
+            // kept as a failed instance, as a dataset that cannot be parsed is
+            m_datasets.push_back(std::shared_ptr<DcmDataset>());
+            ++invalid;
+        }
+        m_datasets.insert(m_datasets.end(), read[i].begin(), read[i].end());
+    }
+    return invalid;
+}
+
 bool StoreAsyncWorker::sendStoreRequest(const OFString& peerTitle, const OFString& peerIP, Uint16 peerPort, const OFString& ourTitle)
 {
     bool m_checkUIDValues = false;
@@ -123,23 +523,7 @@ bool StoreAsyncWorker::sendStoreRequest(const OFString& peerTitle, const OFStrin
     T_ASC_Network* net = NULL;
     T_ASC_Parameters* params = NULL;
 
-    /* create list of input files */
-    DCMNET_INFO("determining input files ...");
-
-    OFStandard::searchDirectoryRecursively(m_sourceDirectory, inputFiles,
-        OFFilename() /*Pattern */, OFFilename() /*dirPrefix*/, OFTrue);
-
-
-    /* check whether there are any input files at all */
-    if (inputFiles.empty())
-    {
-        DCMNET_ERROR("no input files to be sent");
-        return false;
-    }
-
-
-
-    DcmStorageSCU storageSCU;
+    CancellableStorageSCU storageSCU(CancelFlag());
     OFCondition status;
     unsigned long numInvalidFiles = 0;
 
@@ -147,26 +531,52 @@ bool StoreAsyncWorker::sendStoreRequest(const OFString& peerTitle, const OFStrin
     storageSCU.setReadFromDICOMDIRMode(OFFalse);
     storageSCU.setHaltOnInvalidFileMode(OFFalse);
 
-    DCMNET_INFO("checking input files ...");
-    /* iterate over all input filenames */
-    const char* currentFilename = NULL;
-    OFListIterator(OFFilename) if_iter = inputFiles.begin();
-    OFListIterator(OFFilename) if_last = inputFiles.end();
-    while (if_iter != if_last)
+    if (!m_datasets.empty())
     {
-        const OFFilename& currentFilename = (*if_iter);
-        const char* filename = currentFilename.getCharPointer();
-        /* and add them to the list of instances to be transmitted */
-        status = storageSCU.addDicomFile(currentFilename, ERM_fileOnly, m_checkUIDValues);
-        if (status.bad())
+        /* the datasets stay owned by this worker, they are sent as parsed */
+        for (const std::shared_ptr<DcmDataset>& dataset : m_datasets)
+        {
+            status = dataset ? storageSCU.addDataset(dataset.get(), EXS_Unknown, DcmStorageSCU::HM_doNothing, m_checkUIDValues) : EC_IllegalCall;
+            if (status.bad())
+            {
+                ++numInvalidFiles;
+            }
+        }
+    }
+    else
+    {
+        /* create list of input files */
+        DCMNET_INFO("determining input files ...");
+
+        DirectoryScanner::list(m_sourceDirectory, std::max<size_t>(std::thread::hardware_concurrency(), 1), inputFiles);
+
+        /* check whether there are any input files at all */
+        if (inputFiles.empty())
+        {
+            DCMNET_ERROR("no input files to be sent");
+            return false;
+        }
+
+        DCMNET_INFO("checking input files ...");
+        /* iterate over all input filenames */
+        OFListIterator(OFFilename) if_iter = inputFiles.begin();
+        OFListIterator(OFFilename) if_last = inputFiles.end();
+        while (if_iter != if_last)
         {
-            /* check for empty filename */
-            if (strlen(filename) == 0)
-                filename = "<empty string>";
-            DCMNET_ERROR("bad DICOM file: " << filename << ": " << status.text() << ", ignoring file");
-            ++numInvalidFiles;
+            const OFFilename& currentFilename = (*if_iter);
+            const char* filename = currentFilename.getCharPointer();
+            /* and add them to the list of instances to be transmitted */
+            status = storageSCU.addDicomFile(currentFilename, ERM_fileOnly, m_checkUIDValues);
+            if (status.bad())
+            {
+                /* check for empty filename */
+                if (strlen(filename) == 0)
+                    filename = "<empty string>";
+                DCMNET_ERROR("bad DICOM file: " << filename << ": " << status.text() << ", ignoring file");
+                ++numInvalidFiles;
+            }
+            ++if_iter;
         }
-        ++if_iter;
     }
 
     /* check whether there are any valid input files */
@@ -185,16 +595,27 @@ bool StoreAsyncWorker::sendStoreRequest(const OFString& peerTitle, const OFStrin
     storageSCU.setPeerPort(OFstatic_cast(Uint16, peerPort));
     storageSCU.setPeerAETitle(peerTitle);
     storageSCU.setAETitle(ourTitle);
-    storageSCU.setMaxReceivePDULength(OFstatic_cast(Uint32, ASC_DEFAULTMAXPDU));
-    storageSCU.setACSETimeout(OFstatic_cast(Uint32, m_acse_timeout));
-    storageSCU.setDIMSETimeout(OFstatic_cast(Uint32, m_dimse_timeout));
-    storageSCU.setDIMSEBlockingMode(DIMSE_BLOCKING);
+    storageSCU.setMaxReceivePDULength(m_network.maxReceivePDU());
+    storageSCU.setTCPSocketOptions(m_network.socketBufferSize, m_network.tcpNoDelay);
+    storageSCU.setACSETimeout(OFstatic_cast(Uint32, m_network.acseTimeoutSeconds()));
+    storageSCU.setDIMSETimeout(OFstatic_cast(Uint32, m_network.dimseTimeoutSeconds()));
+    storageSCU.setDIMSEBlockingMode(m_network.dimseBlockMode());
+    storageSCU.setAsyncOperationsWindow(m_asyncOperations);
+    storageSCU.setPriority(m_priority);
     storageSCU.setVerbosePCMode(OFTrue);
     storageSCU.setDatasetConversionMode(OFTrue);
     storageSCU.setDecompressionMode(DcmStorageSCU::DM_losslessOnly);
     storageSCU.setHaltOnUnsuccessfulStoreMode(OFFalse);
     storageSCU.setAllowIllegalProposalMode(OFTrue);
+    storageSCU.setProposeDeflatedMode(OFTrue);
 
+    /* encrypt the associations (if requested) */
+    status = TlsTransport::secure(storageSCU, m_network);
+    if (status.bad())
+    {
+        DCMNET_ERROR("cannot initialize TLS: " << status.text());
+        return false;
+    }
 
     /* add presentation contexts to be negotiated (if there are still any) */
     while ((status = storageSCU.addPresentationContexts()).good())
@@ -253,6 +674,11 @@ bool StoreAsyncWorker::sendStoreRequest(const OFString& peerTitle, const OFStrin
         }
         /* close current network association */
         storageSCU.releaseAssociation();
+        if (Cancelled())
+        {
+            DCMNET_INFO("request cancelled, " << storageSCU.getNumberOfSOPInstancesToBeSent() << " SOP instances not sent");
+            return false;
+        }
     }
 
     /* if anything went wrong, report it to the logger */
@@ -265,3 +691,261 @@ bool StoreAsyncWorker::sendStoreRequest(const OFString& peerTitle, const OFStrin
     /* make sure that everything is cleaned up properly */
     return true;
 }
+
+bool StoreAsyncWorker::sendPlannedStoreRequest(const OFString& peerTitle, const OFString& peerIP, Uint16 peerPort, const OFString& ourTitle, size_t associations)
+{
+    std::vector<sStoreItem> items;
+    if (!m_datasets.empty())
+    {
+        // the datasets are parsed already, they are sent from memory
+        for (size_t i = 0; i < m_datasets.size(); ++i)
+        {
+            sStoreItem item;
+            item.index = i;
+            item.dataset = m_datasets[i];
+            if (item.dataset)
+            {
+                item.dataset->findAndGetOFString(DCM_SOPClassUID, item.sopClass);
+                item.dataset->findAndGetOFString(DCM_SOPInstanceUID, item.sopInstance);
+                item.xfer = DcmXfer(item.dataset->getOriginalXfer()).getXferID();
+                item.valid = !item.sopClass.empty() && !item.sopInstance.empty() && !item.xfer.empty();
+            }
+            items.push_back(item);
+        }
+    }
+    else if (m_sourceDirectory.isEmpty())
+    {
+        // the files of the manifest are sent as recorded, without listing or reading them first
+        StoreManifest(m_manifestPath).items(items);
+        if (items.empty())
+        {
+            DCMNET_ERROR("no input files to be sent");
+            return false;
+        }
+    }
+    else
+    {
+        // only the meta header of files not in the manifest is read, by the thread that found them
+        // while the others go on listing, the dataset is parsed once when it is sent
+        DCMNET_INFO("determining and checking input files ...");
+        StoreManifest manifest(m_manifestPath);
+        std::mutex itemsMutex;
+        std::vector<std::pair<sStoreItem, bool> > found;
+        DirectoryScanner::scan(m_sourceDirectory, std::max<size_t>(std::thread::hardware_concurrency(), 1),
+            [&manifest, &itemsMutex, &found](const OFFilename& file) {
+                sStoreItem item;
+                item.file = file;
+                const bool known = manifest.lookup(item);
+                if (!known)
+                {
+                    prescanFile(item);
+                }
+                std::lock_guard<std::mutex> lock(itemsMutex);
+                found.push_back(std::make_pair(item, known));
+            },
+            [this]() { return Cancelled(); });
+        if (found.empty())
+        {
+            DCMNET_ERROR("no input files to be sent");
+            return false;
+        }
+
+        // sent in the order of their paths, whichever thread found them
+        std::sort(found.begin(), found.end(), [](const std::pair<sStoreItem, bool>& a, const std::pair<sStoreItem, bool>& b) {
+            return strcmp(a.first.file.getCharPointer(), b.first.file.getCharPointer()) < 0;
+        });
+        items.reserve(found.size());
+        for (const std::pair<sStoreItem, bool>& item : found)
+        {
+            if (!item.second)
+            {
+                manifest.record(item.first);
+            }
+            items.push_back(item.first);
+        }
+        manifest.save();
+    }
+
+    std::vector<sStoreItem> sendItems;
+    for (const sStoreItem& item : items)
+    {
+        if (!item.valid)
+        {
+            DCMNET_ERROR("bad DICOM file: " << item.name() << ", ignoring file");
+            continue;
+        }
+        sendItems.push_back(item);
+    }
+    if (sendItems.empty())
+    {
+        DCMNET_FATAL("no valid input files to be processed");
+        return false;
+    }
+
+    const std::vector<sAssociationPlan> plans = planAssociations(sendItems);
+    DCMNET_INFO("in total, there are " << sendItems.size() << " SOP instances to be sent in "
+        << plans.size() << " association negotiations over up to " << associations << " associations each, "
+        << (items.size() - sendItems.size()) << " invalid files are ignored");
+
+    std::atomic<size_t> sent(0);
+    std::atomic<size_t> failed(0);
+    bool negotiated = true;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t p = 0; p < plans.size() && !Cancelled(); ++p)
+    {
+        const sAssociationPlan& plan = plans[p];
+        const std::vector<sStoreItem>& planItems = plan.items;
+        const size_t connections = std::min(associations, planItems.size());
+        // files are claimed one by one, so fast associations take over the share of slow ones
+        std::atomic<size_t> next(0);
+        std::atomic<size_t> connected(0);
+        std::vector<std::thread> senders;
+        for (size_t a = 0; a < connections; ++a)
+        {
+            senders.push_back(std::thread([&, a]() {
+                OFLog::setThreadLogLevel(logLevel);
+                DcmSCU scu;
+                scu.setPeerHostName(peerIP);
+                scu.setPeerPort(peerPort);
+                scu.setPeerAETitle(peerTitle);
+                scu.setAETitle(ourTitle);
+                scu.setMaxReceivePDULength(m_network.maxReceivePDU());
+                scu.setTCPSocketOptions(m_network.socketBufferSize, m_network.tcpNoDelay);
+                scu.setACSETimeout(OFstatic_cast(Uint32, m_network.acseTimeoutSeconds()));
+                scu.setDIMSETimeout(OFstatic_cast(Uint32, m_network.dimseTimeoutSeconds()));
+                scu.setDIMSEBlockingMode(m_network.dimseBlockMode());
+                scu.setAsyncOperationsWindow(m_asyncOperations);
+                scu.setPriority(m_priority);
+                scu.setVerbosePCMode(OFTrue);
+                scu.setDatasetConversionMode(OFTrue);
+
+                OFList<OFString> uncompressed;
+                uncompressed.push_back(UID_LittleEndianExplicitTransferSyntax);
+                uncompressed.push_back(UID_LittleEndianImplicitTransferSyntax);
+                OFList<OFString> deflated;
+                deflated.push_back(UID_DeflatedExplicitVRLittleEndianTransferSyntax);
+                deflated.push_back(UID_LittleEndianExplicitTransferSyntax);
+                deflated.push_back(UID_LittleEndianImplicitTransferSyntax);
+                for (const OFString& sopClass : plan.sopClasses)
+                {
+                    scu.addPresentationContext(sopClass, ns::preferDeflate(sopClass.c_str()) ? deflated : uncompressed);
+                }
+                for (const std::pair<OFString, OFString>& pc : plan.encapsulated)
+                {
+                    OFList<OFString> xfers;
+                    xfers.push_back(pc.second);
+                    scu.addPresentationContext(pc.first, xfers);
+                }
+
+                OFCondition status = TlsTransport::secure(scu, m_network);
+                if (status.good())
+                {
+                    status = scu.initNetwork();
+                }
+                if (status.good())
+                {
+                    status = scu.negotiateAssociation();
+                }
+                if (status.bad())
+                {
+                    DCMNET_ERROR("association " << a << ": cannot negotiate network association: " << status.text());
+                    return;
+                }
+                ++connected;
+
+                // with a granted asynchronous operations window further requests are sent while
+                // the responses of the earlier ones are outstanding
+                const size_t window = scu.getAsyncOperationsWindow();
+                std::map<Uint16, size_t> outstanding;  // message ID, index of the item
+                auto complete = [&](size_t i, const OFCondition& result, Uint16 rspStatusCode) {
+                    if (result.good() && rspStatusCode == STATUS_Success)
+                    {
+                        ++sent;
+                    }
+                    else
+                    {
+                        ++failed;
+                        DCMNET_ERROR("association " << a << ": cannot send " << planItems[i].name() << ": "
+                            << (result.good() ? DU_cstoreStatusString(rspStatusCode) : result.text()));
+                    }
+                };
+                auto receive = [&]() -> OFCondition {
+                    Uint16 messageID = 0;
+                    Uint16 rspStatusCode = 0;
+                    OFCondition result = scu.receiveSTOREResponse(messageID, rspStatusCode);
+                    std::map<Uint16, size_t>::iterator request = outstanding.find(messageID);
+                    if (result.good() && request == outstanding.end())
+                    {
+                        DCMNET_ERROR("association " << a << ": C-STORE response for unknown message ID " << messageID);
+                        result = makeOFCondition(OFM_dcmnet, DIMSEC_UNEXPECTEDRESPONSE, OF_error, "Unexpected Response");
+                    }
+                    if (result.bad())
+                    {
+                        // the responses still outstanding are not going to be matched any more
+                        for (const std::pair<const Uint16, size_t>& o : outstanding)
+                        {
+                            complete(o.second, result, 0);
+                        }
+                        outstanding.clear();
+                        return result;
+                    }
+                    complete(request->second, result, rspStatusCode);
+                    outstanding.erase(request);
+                    return result;
+                };
+                auto closed = [&]() {
+                    if (status == DUL_PEERREQUESTEDRELEASE || status == DUL_PEERABORTEDASSOCIATION || status == DUL_NETWORKCLOSED)
+                    {
+                        // the remaining files are picked up by the other associations
+                        scu.closeAssociation(status == DUL_PEERREQUESTEDRELEASE ? DCMSCU_PEER_REQUESTED_RELEASE : DCMSCU_PEER_ABORTED_ASSOCIATION);
+                        return true;
+                    }
+                    return false;
+                };
+
+                for (size_t i = next++; i < planItems.size() && !Cancelled(); i = next++)
+                {
+                    const sStoreItem& item = planItems[i];
+                    T_ASC_PresentationContextID pcid = scu.findAnyPresentationContextID(item.sopClass, item.xfer);
+                    Uint16 messageID = 0;
+                    status = pcid == 0 ? DIMSE_NOVALIDPRESENTATIONCONTEXTID : scu.sendSTORERequestAsync(pcid, item.file, item.dataset.get(), messageID);
+                    if (status.good())
+                    {
+                        outstanding[messageID] = i;
+                        while (status.good() && outstanding.size() >= window)
+                        {
+                            status = receive();
+                        }
+                    }
+                    else
+                    {
+                        complete(i, status, 0);
+                    }
+                    if (closed())
+                    {
+                        return;
+                    }
+                }
+                while (!outstanding.empty())
+                {
+                    status = receive();
+                }
+                if (closed())
+                {
+                    return;
+                }
+                scu.releaseAssociation();
+            }));
+        }
+        for (std::thread& sender : senders)
+        {
+            sender.join();
+        }
+        negotiated = negotiated && connected > 0;
+    }
+
+    // files claimed by no association because all of them failed
+    size_t unsent = sendItems.size() - sent - failed;
+    DCMNET_INFO("sent " << sent << " SOP instances, " << failed << " failed, " << unsent << " not sent");
+    return negotiated && unsent == 0;
+}
@@ -12,6 +12,11 @@
 #include "dcmtk/ofstd/offile.h"
 
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
 using namespace Napi;
 
 class DcmDataset;
@@ -28,11 +33,31 @@ class StoreAsyncWorker : public BaseAsyncWorker
     protected:
         bool setScanDirectory(const OFFilename &dir);
 
+        // parses the DICOM files or datasets held in memory into m_datasets, releasing their bytes.
+        // Returns the number of those that cannot be parsed
+        size_t setDatasets(std::vector<std::string>& datasets);
+
+        // builds m_datasets from DICOM JSON texts with their bulk data, releasing the texts. Returns
+        // the number of texts that cannot be read
+        size_t setJsonDatasets(std::vector<std::string>& texts, const std::map<std::string, std::string>& bulkData);
+
         bool sendStoreRequest(const OFString& peerTitle, const OFString& peerIP, Uint16 peerPort,  const OFString& ourTitle);
 
+        // plans the negotiations from the SOP classes and transfer syntaxes known before sending,
+        // each carrying as many presentation contexts as fit, and sends the instances of each over
+        // up to the given number of associations at once, sorted by presentation context
+        bool sendPlannedStoreRequest(const OFString& peerTitle, const OFString& peerIP, Uint16 peerPort, const OFString& ourTitle, size_t associations);
+
 private:
 
         OFFilename            m_sourceDirectory;
-        unsigned long         m_acse_timeout;
-        unsigned long         m_dimse_timeout;
+        // instances sent from memory instead of the files below m_sourceDirectory
+        std::vector<std::shared_ptr<DcmDataset> > m_datasets;
+        // SOP classes, instances and transfer syntaxes of the files, see StoreManifest
+        std::string           m_manifestPath;
+        ns::sNetworkOptions   m_network;
+        // outstanding C-STORE requests proposed per association
+        Uint16                m_asyncOperations;
+        // of the C-STORE requests
+        T_DIMSE_Priority      m_priority;
 };
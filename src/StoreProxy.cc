@@ -0,0 +1,431 @@
+#include "StoreProxy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmdata/dcostrma.h"
+#include "dcmtk/dcmdata/dcostrmf.h"
+#include "dcmtk/dcmdata/dcuid.h"
+
+#include "Forwarder.h"
+#include "Metrics.h"
+#include "TlsTransport.h"
+
+namespace
+{
+
+enum eOutcome {
+    TOOK,
+    REFUSED,        // the destination answered with an error status
+    UNAVAILABLE     // the destination cannot be reached or is out of resources
+};
+
+// the association to a destination of an incoming association, and the instance being relayed
+struct sOutgoing {
+    ns::sIdent peer;
+    std::string name;           // AE@host:port
+    T_ASC_Association* assoc;
+    int failures;               // attempts in a row to open the association that failed
+    std::chrono::steady_clock::time_point retryAt;
+    T_ASC_PresentationContextID presID;
+    DIC_US messageID;
+    bool relaying;              // the command was sent, the data set follows
+    eOutcome outcome;
+    Uint16 status;
+};
+
+struct sRelay {
+    std::vector<sOutgoing> outgoing;
+};
+
+std::mutex proxyMutex;
+bool configured = false;
+std::vector<ns::sIdent> proxyDestinations;
+ns::sIdent proxySource;
+ns::sNetworkOptions proxyNetwork;
+bool proxySpill = false;
+std::string proxySpillDirectory;
+T_ASC_Network* requestor = NULL;
+// by incoming association, each only used by the thread serving it
+std::map<T_ASC_Association*, std::shared_ptr<sRelay> > relays;
+std::atomic<unsigned> spillSequence(0);
+
+void close(sOutgoing& out, bool abort)
+{
+    if (out.assoc == NULL) {
+        return;
+    }
+    if (abort) {
+        ASC_abortAssociation(out.assoc);
+    }
+    else {
+        ASC_releaseAssociation(out.assoc);
+    }
+    ASC_dropAssociation(out.assoc);
+    ASC_destroyAssociation(&out.assoc);
+    out.assoc = NULL;
+    out.relaying = false;
+}
+
+// proposes the presentation contexts accepted on incoming, each with the transfer syntax its
+// data sets arrive in, so that they can be passed on as they are
+OFCondition open(T_ASC_Association* incoming, sOutgoing& out, const ns::sNetworkOptions& network)
+{
+    T_ASC_Parameters* params = NULL;
+    OFCondition cond = ASC_createAssociationParameters(&params, OFstatic_cast(int, network.maxReceivePDU()));
+    if (cond.bad()) {
+        return cond;
+    }
+    DIC_NODENAME peerHost;
+    OFStandard::snprintf(peerHost, sizeof(peerHost), "%s:%d", out.peer.ip.c_str(), out.peer.port);
+    ASC_setPresentationAddresses(params, OFStandard::getHostName().c_str(), peerHost);
+    ASC_setAPTitles(params, proxySource.aet.c_str(), out.peer.aet.c_str(), NULL);
+    ASC_setTransportLayerType(params, network.tls ? OFTrue : OFFalse);
+
+    T_ASC_PresentationContextID id = 1;
+    const int count = ASC_countPresentationContexts(incoming->params);
+    for (int i = 0; i < count && cond.good() && id < 255; ++i) {
+        T_ASC_PresentationContext pc;
+        if (ASC_getPresentationContext(incoming->params, i, &pc).good() && pc.resultReason == ASC_P_ACCEPTANCE) {
+            const char* xfer = pc.acceptedTransferSyntax;
+            cond = ASC_addPresentationContext(params, id, pc.abstractSyntax, &xfer, 1);
+            id += 2;
+        }
+    }
+    if (cond.good()) {
+        cond = ASC_requestAssociation(requestor, params, &out.assoc);
+    }
+    if (cond.good() && ASC_countAcceptedPresentationContexts(params) == 0) {
+        cond = DIMSE_NOVALIDPRESENTATIONCONTEXTID;
+        close(out, true);
+        return cond;
+    }
+    if (cond.bad()) {
+        /* destroying the association also frees the parameters */
+        if (out.assoc != NULL) {
+            ASC_dropAssociation(out.assoc);
+            ASC_destroyAssociation(&out.assoc);
+            out.assoc = NULL;
+        }
+        else {
+            ASC_destroyAssociationParameters(&params);
+        }
+    }
+    return cond;
+}
+
+// sends the command of req to out, opening its association first if needed
+void begin(T_ASC_Association* incoming, sOutgoing& out, T_DIMSE_C_StoreRQ* req, const char* xfer, const ns::sNetworkOptions& network)
+{
+    out.relaying = false;
+    out.outcome = UNAVAILABLE;
+    out.status = STATUS_STORE_Refused_OutOfResources;
+    if (out.assoc == NULL) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now < out.retryAt) {
+            return;
+        }
+        OFCondition cond = open(incoming, out, network);
+        if (cond.bad()) {
+            const int backoff = std::min(StoreProxy::minBackoff << std::min(out.failures, 16), StoreProxy::maxBackoff);
+            out.failures++;
+            out.retryAt = now + std::chrono::seconds(backoff);
+            DCMNET_WARN("proxy: cannot open an association with " << out.name << ", retrying in " << backoff << " s: " << cond.text());
+            return;
+        }
+        out.failures = 0;
+    }
+    out.presID = ASC_findAcceptedPresentationContextID(out.assoc, req->AffectedSOPClassUID, xfer);
+    if (out.presID == 0) {
+        DCMNET_WARN("proxy: " << out.name << " accepts no presentation context for " << dcmFindNameOfUID(req->AffectedSOPClassUID, req->AffectedSOPClassUID) << " in " << xfer);
+        return;
+    }
+    T_DIMSE_Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.CommandField = DIMSE_C_STORE_RQ;
+    msg.msg.CStoreRQ = *req;
+    msg.msg.CStoreRQ.MessageID = out.assoc->nextMsgID++;
+    msg.msg.CStoreRQ.DataSetType = DIMSE_DATASET_PRESENT;
+    out.messageID = msg.msg.CStoreRQ.MessageID;
+    OFCondition cond = DIMSE_sendMessageCommand(out.assoc, out.presID, &msg);
+    if (cond.bad()) {
+        DCMNET_WARN("proxy: cannot send to " << out.name << ": " << cond.text());
+        close(out, true);
+        return;
+    }
+    out.relaying = true;
+}
+
+// the C-STORE-RSP of out to the instance just relayed
+void complete(sOutgoing& out, const ns::sNetworkOptions& network)
+{
+    if (!out.relaying) {
+        return;
+    }
+    out.relaying = false;
+    T_DIMSE_Message rsp;
+    T_ASC_PresentationContextID presID = 0;
+    DcmDataset* statusDetail = NULL;
+    OFCondition cond = DIMSE_receiveCommand(out.assoc, network.dimseBlockMode(), network.dimseTimeoutSeconds(), &presID, &rsp, &statusDetail);
+    delete statusDetail;
+    if (cond.bad() || rsp.CommandField != DIMSE_C_STORE_RSP || rsp.msg.CStoreRSP.MessageIDBeingRespondedTo != out.messageID) {
+        DCMNET_WARN("proxy: no C-STORE response from " << out.name << (cond.bad() ? std::string(": ") + cond.text() : std::string()));
+        close(out, true);
+        return;
+    }
+    out.status = rsp.msg.CStoreRSP.DimseStatus;
+    if (out.status == STATUS_Success || DICOM_WARNING_STATUS(out.status)) {
+        out.outcome = TOOK;
+    }
+    // out of resources, 0xA7xx
+    else if ((out.status & 0xff00) != STATUS_STORE_Refused_OutOfResources) {
+        out.outcome = REFUSED;
+    }
+}
+
+// passes the fragments of a data set on to the destinations while it is received. The last
+// fragment is held back until the data set is complete, since only then it is known to be the last
+class RelayConsumer : public DcmConsumer
+{
+public:
+    RelayConsumer(sRelay& relay, bool keep) : m_relay(relay), m_keep(keep) {}
+
+    virtual OFBool good() const { return OFTrue; }
+    virtual OFCondition status() const { return EC_Normal; }
+    virtual OFBool isFlushed() const { return OFTrue; }
+    virtual offile_off_t avail() const { return OFnumeric_limits<offile_off_t>::max(); }
+    virtual void flush() {}
+
+    virtual offile_off_t write(const void* buf, offile_off_t buflen)
+    {
+        pass(OFFalse);
+        const unsigned char* data = OFstatic_cast(const unsigned char*, buf);
+        m_pending.assign(data, data + buflen);
+        if (m_keep) {
+            m_data.insert(m_data.end(), data, data + buflen);
+        }
+        return buflen;
+    }
+
+    // sends the fragment held back as the last one
+    void finish() { pass(OFTrue); }
+
+    // the whole data set, if kept
+    const std::vector<unsigned char>& data() const { return m_data; }
+
+private:
+    void pass(OFBool last)
+    {
+        if (m_pending.empty()) {
+            return;
+        }
+        for (sOutgoing& out : m_relay.outgoing) {
+            if (out.relaying && DIMSE_sendDataSetFragment(out.assoc, out.presID, m_pending.data(), OFstatic_cast(Uint32, m_pending.size()), last).bad()) {
+                DCMNET_WARN("proxy: cannot relay to " << out.name);
+                close(out, true);
+            }
+        }
+        m_pending.clear();
+    }
+
+    sRelay& m_relay;
+    bool m_keep;
+    std::vector<unsigned char> m_pending;
+    std::vector<unsigned char> m_data;
+};
+
+class RelayStream : public DcmOutputStream
+{
+public:
+    RelayStream(sRelay& relay, bool keep) : DcmOutputStream(&m_consumer), m_consumer(relay, keep) {}
+
+    RelayConsumer& consumer() { return m_consumer; }
+
+private:
+    RelayConsumer m_consumer;
+};
+
+// writes the data set as received to a file and queues it for out
+bool spillInstance(T_ASC_Association* assoc, T_ASC_PresentationContextID presID, T_DIMSE_C_StoreRQ* req, const char* xfer,
+    const std::vector<unsigned char>& data, const sOutgoing& out, const std::string& directory)
+{
+    const std::string path = directory + "/" + req->AffectedSOPInstanceUID + "-" + std::to_string(spillSequence++) + ".part";
+    DcmOutputFileStream* stream = NULL;
+    bool written = DIMSE_createFilestream(OFFilename(path.c_str()), req, assoc, presID, OFTrue, &stream).good();
+    if (written) {
+        written = stream->write(data.data(), OFstatic_cast(offile_off_t, data.size())) == OFstatic_cast(offile_off_t, data.size());
+        stream->flush();
+        written = written && stream->good();
+        delete stream;
+    }
+    if (!written || !Forwarder::enqueueFile(out.peer, req->AffectedSOPClassUID, xfer, path)) {
+        OFStandard::deleteFile(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
+
+bool StoreProxy::configure(const std::vector<ns::sIdent>& destinations, const ns::sIdent& source,
+    const ns::sNetworkOptions& network, bool spill, const std::string& spillDirectory)
+{
+    stop();
+    if (destinations.empty()) {
+        return true;
+    }
+    T_ASC_Network* net = NULL;
+    OFCondition cond = ASC_initializeNetwork(NET_REQUESTOR, 0, network.acseTimeoutSeconds(), &net);
+    if (cond.good()) {
+        ASC_setTCPSocketOptions(net, network.socketBufferSize, network.tcpNoDelay);
+        cond = TlsTransport::secure(net, false, network);
+    }
+    if (cond.bad()) {
+        DCMNET_ERROR("proxy: cannot create requestor network: " << cond.text());
+        if (net != NULL) {
+            ASC_dropNetwork(&net);
+        }
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(proxyMutex);
+    requestor = net;
+    proxyDestinations = destinations;
+    proxySource = source;
+    proxyNetwork = network;
+    proxySpill = spill;
+    proxySpillDirectory = spillDirectory;
+    configured = true;
+    for (const ns::sIdent& destination : destinations) {
+        DCMNET_INFO("proxy: relaying C-STOREs to " << destination.aet << "@" << destination.ip << ":" << destination.port
+            << (spill ? ", spilled to the forwarding queue when it fails" : ""));
+    }
+    return true;
+}
+
+void StoreProxy::stop()
+{
+    std::lock_guard<std::mutex> lock(proxyMutex);
+    if (!configured) {
+        return;
+    }
+    configured = false;
+    ASC_dropNetwork(&requestor);
+    requestor = NULL;
+}
+
+bool StoreProxy::isConfigured()
+{
+    std::lock_guard<std::mutex> lock(proxyMutex);
+    return configured;
+}
+
+OFCondition StoreProxy::relay(T_ASC_Association* assoc, T_ASC_PresentationContextID presID, T_DIMSE_C_StoreRQ* req,
+    T_DIMSE_BlockingMode blockMode, int timeout)
+{
+    Metrics::Timer timer(Metrics::histogram("proxy_store_seconds"));
+    std::shared_ptr<sRelay> relay;
+    ns::sNetworkOptions network;
+    bool spill;
+    std::string spillDirectory;
+    {
+        std::lock_guard<std::mutex> lock(proxyMutex);
+        std::shared_ptr<sRelay>& r = relays[assoc];
+        if (!r) {
+            r = std::make_shared<sRelay>();
+            for (const ns::sIdent& destination : proxyDestinations) {
+                sOutgoing out;
+                out.peer = destination;
+                out.name = destination.aet + "@" + destination.ip + ":" + std::to_string(destination.port);
+                out.assoc = NULL;
+                out.failures = 0;
+                out.retryAt = std::chrono::steady_clock::now();
+                out.relaying = false;
+                r->outgoing.push_back(out);
+            }
+        }
+        relay = r;
+        network = proxyNetwork;
+        spill = proxySpill;
+        spillDirectory = proxySpillDirectory;
+    }
+
+    T_ASC_PresentationContext pc;
+    OFCondition cond = ASC_findAcceptedPresentationContext(assoc->params, presID, &pc);
+    if (cond.bad()) {
+        return cond;
+    }
+
+    // the command goes out to every destination before the first PDV of the data set arrives
+    for (sOutgoing& out : relay->outgoing) {
+        begin(assoc, out, req, pc.acceptedTransferSyntax, network);
+    }
+
+    RelayStream stream(*relay, spill);
+    T_ASC_PresentationContextID dataPresID = 0;
+    cond = DIMSE_receiveDataSetInFile(assoc, blockMode, timeout, &dataPresID, &stream, NULL, NULL);
+    if (cond.good() && dataPresID != presID) {
+        cond = DIMSE_BADDATA;
+    }
+    if (cond.bad()) {
+        // the destinations are in the middle of the data set, their associations cannot go on
+        for (sOutgoing& out : relay->outgoing) {
+            if (out.relaying) {
+                close(out, true);
+            }
+        }
+        return cond;
+    }
+    stream.consumer().finish();
+    for (sOutgoing& out : relay->outgoing) {
+        complete(out, network);
+    }
+
+    T_DIMSE_C_StoreRSP rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.DimseStatus = STATUS_Success;
+    for (sOutgoing& out : relay->outgoing) {
+        const char* result = "relayed";
+        if (out.outcome == REFUSED) {
+            result = "refused";
+            if (rsp.DimseStatus == STATUS_Success) {
+                rsp.DimseStatus = out.status;
+            }
+        }
+        else if (out.outcome == UNAVAILABLE && spill && spillInstance(assoc, presID, req, pc.acceptedTransferSyntax, stream.consumer().data(), out, spillDirectory)) {
+            result = "spilled";
+        }
+        else if (out.outcome == UNAVAILABLE) {
+            result = "failed";
+            if (rsp.DimseStatus == STATUS_Success) {
+                rsp.DimseStatus = STATUS_STORE_Refused_OutOfResources;
+            }
+        }
+        Metrics::counter("proxy_instances_total", {{"destination", out.name}, {"result", result}}).add();
+    }
+    return DIMSE_sendStoreResponse(assoc, presID, req, &rsp, NULL);
+}
+
+void StoreProxy::finish(T_ASC_Association* assoc)
+{
+    std::shared_ptr<sRelay> relay;
+    {
+        std::lock_guard<std::mutex> lock(proxyMutex);
+        std::map<T_ASC_Association*, std::shared_ptr<sRelay> >::iterator it = relays.find(assoc);
+        if (it == relays.end()) {
+            return;
+        }
+        relay = it->second;
+        relays.erase(it);
+    }
+    for (sOutgoing& out : relay->outgoing) {
+        close(out, false);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/assoc.h"
+#include "dcmtk/dcmnet/dimse.h"
+
+// Cut-through relay of the C-STOREs received by a store SCP to one or more destinations, without
+// writing them. Each incoming association gets associations of its own to the destinations, opened
+// at its first C-STORE and proposing the presentation contexts it accepted, so the PDVs of a data
+// set are passed on unchanged while they arrive and the C-STORE is answered once the destinations
+// answered theirs, about one network hop after the last PDV. A destination that refuses an instance
+// has its status passed back. One that cannot be reached, or is out of resources, fails the C-STORE
+// with Out of Resources unless spilling: then the data set is kept in memory while it is relayed
+// and queued on disk by the Forwarder for that destination, and the C-STORE succeeds.
+class StoreProxy
+{
+public:
+    // relays the C-STOREs to destinations from now on, calling itself source over network. With
+    // spill, instances are spilled to spillDirectory, which has to be on the file system of the
+    // forwarding queue. False if the requestor network cannot be created
+    static bool configure(const std::vector<ns::sIdent>& destinations, const ns::sIdent& source,
+        const ns::sNetworkOptions& network, bool spill, const std::string& spillDirectory);
+
+    // drops the requestor network, the associations end with their incoming ones
+    static void stop();
+
+    // true between configure() with destinations and stop()
+    static bool isConfigured();
+
+    // receives the data set of req on presID of assoc, relays it to the destinations and answers req
+    static OFCondition relay(T_ASC_Association* assoc, T_ASC_PresentationContextID presID, T_DIMSE_C_StoreRQ* req,
+        T_DIMSE_BlockingMode blockMode, int timeout);
+
+    // releases the associations to the destinations opened for assoc, once it ended
+    static void finish(T_ASC_Association* assoc);
+
+    // seconds a destination that could not be reached is not tried again for an incoming association,
+    // doubled up to maxBackoff
+    static const int minBackoff = 1;
+    static const int maxBackoff = 30;
+};
@@ -0,0 +1,262 @@
+#include "StoreRules.h"
+
+#include <cstring>
+#include <memory>
+
+#include "Metrics.h"
+#include "TransferPolicy.h"
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+namespace
+{
+
+// a condition on one value, compiled from a pattern with * and ? wildcards
+struct sPattern {
+    enum eKind {
+        ANY,        // empty pattern or "*"
+        EXACT,      // no wildcards
+        PREFIX,     // a single trailing *
+        WILDCARD    // anything else
+    };
+
+    sPattern() : kind(ANY) {}
+
+    explicit sPattern(const std::string& pattern) : kind(ANY), text(pattern)
+    {
+        const size_t wildcard = pattern.find_first_of("*?");
+        if (pattern.empty() || pattern == "*") {
+            kind = ANY;
+        }
+        else if (wildcard == std::string::npos) {
+            kind = EXACT;
+        }
+        else if (wildcard == pattern.size() - 1 && pattern[wildcard] == '*') {
+            kind = PREFIX;
+            text.erase(wildcard);
+        }
+        else {
+            kind = WILDCARD;
+        }
+    }
+
+    bool matches(const char* value) const
+    {
+        switch (kind)
+        {
+        case ANY:
+            return true;
+        case EXACT:
+            return text == value;
+        case PREFIX:
+            return strncmp(value, text.c_str(), text.size()) == 0;
+        default:
+            return matchWildcard(text.c_str(), value);
+        }
+    }
+
+    static bool matchWildcard(const char* pattern, const char* value)
+    {
+        // backtracks to the last * only, which is enough for patterns without character classes
+        const char* star = NULL;
+        const char* resume = NULL;
+        while (*value != '\0') {
+            if (*pattern == '?' || *pattern == *value) {
+                ++pattern;
+                ++value;
+            }
+            else if (*pattern == '*') {
+                star = pattern++;
+                resume = value;
+            }
+            else if (star != NULL) {
+                pattern = star + 1;
+                value = ++resume;
+            }
+            else {
+                return false;
+            }
+        }
+        while (*pattern == '*') {
+            ++pattern;
+        }
+        return *pattern == '\0';
+    }
+
+    eKind kind;
+    std::string text;
+};
+
+struct sTagCondition {
+    DcmTagKey key;
+    sPattern pattern;
+};
+
+struct sCompiledRule {
+    sPattern callingAet;
+    sPattern calledAet;
+    sPattern callingHost;
+    sPattern sopClass;
+    std::vector<sTagCondition> tags;
+    bool reject;
+    OFString storagePath;
+
+    bool matchesAssociation(const char* aet, const char* called, const std::string& host) const
+    {
+        return callingAet.matches(aet) && calledAet.matches(called) && callingHost.matches(host.c_str());
+    }
+
+    bool matchesTags(DcmItem* dataset) const
+    {
+        OFString value;
+        for (const sTagCondition& tag : tags) {
+            value.clear();
+            // all values of the attribute, separated by backslashes, missing attributes are empty
+            dataset->findAndGetOFStringArray(tag.key, value);
+            if (!tag.pattern.matches(value.c_str())) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+void countRejected(const char* stage)
+{
+    Metrics::counter("store_rules_rejected_total", {{"stage", stage}}).add();
+}
+
+}
+
+struct StoreRules::sRuleSet {
+    std::vector<sCompiledRule> rules;
+};
+
+StoreRules::StoreRules()
+{
+}
+
+bool StoreRules::compile(const std::vector<sRule>& rules, std::string& error)
+{
+    std::shared_ptr<sRuleSet> compiled = std::make_shared<sRuleSet>();
+    compiled->rules.reserve(rules.size());
+    for (size_t i = 0; i < rules.size(); ++i) {
+        const sRule& rule = rules[i];
+        const std::string name = "store rule " + std::to_string(i + 1);
+        sCompiledRule c;
+        c.callingAet = sPattern(rule.callingAet);
+        c.calledAet = sPattern(rule.calledAet);
+        c.callingHost = sPattern(rule.callingHost);
+        c.sopClass = sPattern(rule.sopClass);
+        if (rule.action.empty() || rule.action == "accept") {
+            c.reject = false;
+        }
+        else if (rule.action == "reject") {
+            c.reject = true;
+        }
+        else {
+            error = name + ": unknown action " + rule.action;
+            return false;
+        }
+        for (const ns::sTag& tag : rule.tags) {
+            if (tag.key.size() != 8 || tag.key.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+                error = name + ": tag key " + tag.key + " is not GGGGEEEE";
+                return false;
+            }
+            sTagCondition condition;
+            condition.key = ns::toElement(tag.key, std::string()).xtag;
+            condition.pattern = sPattern(tag.value);
+            c.tags.push_back(condition);
+        }
+        if (!rule.storagePath.empty()) {
+            if (c.reject) {
+                error = name + ": rejecting rules store nothing, storagePath is not allowed";
+                return false;
+            }
+            OFStandard::normalizeDirName(c.storagePath, rule.storagePath.c_str());
+            if (!OFStandard::dirExists(c.storagePath) && OFStandard::createDirectory(c.storagePath, OFString()).bad()) {
+                error = name + ": cannot create storage path " + rule.storagePath;
+                return false;
+            }
+        }
+        compiled->rules.push_back(c);
+    }
+    m_rules = compiled;
+    if (!rules.empty()) {
+        DCMNET_INFO("store rules: " << rules.size() << " rules applied to associations and received instances");
+    }
+    return true;
+}
+
+bool StoreRules::isConfigured() const
+{
+    return m_rules && !m_rules->rules.empty();
+}
+
+bool StoreRules::rejectsAssociation(const char* callingAet, const char* calledAet, const char* callingHost) const
+{
+    if (!m_rules) {
+        return false;
+    }
+    const std::string host = TransferPolicy::hostOf(callingHost);
+    for (const sCompiledRule& rule : m_rules->rules) {
+        if (!rule.matchesAssociation(callingAet, calledAet, host)) {
+            continue;
+        }
+        // a rule on SOP classes or attributes leaves the decision to the presentation contexts or instances
+        if (rule.sopClass.kind != sPattern::ANY || !rule.tags.empty()) {
+            return false;
+        }
+        if (rule.reject) {
+            DCMNET_INFO("store rules: rejecting association of " << callingAet << " (" << host << ") to " << calledAet);
+            countRejected("association");
+        }
+        return rule.reject;
+    }
+    return false;
+}
+
+bool StoreRules::rejectsSopClass(const char* callingAet, const char* calledAet, const char* callingHost, const char* sopClass) const
+{
+    if (!m_rules) {
+        return false;
+    }
+    const std::string host = TransferPolicy::hostOf(callingHost);
+    for (const sCompiledRule& rule : m_rules->rules) {
+        if (!rule.matchesAssociation(callingAet, calledAet, host) || !rule.sopClass.matches(sopClass)) {
+            continue;
+        }
+        if (!rule.tags.empty()) {
+            return false;
+        }
+        if (rule.reject) {
+            countRejected("presentation_context");
+        }
+        return rule.reject;
+    }
+    return false;
+}
+
+bool StoreRules::acceptInstance(const char* callingAet, const char* calledAet, const char* callingHost, const char* sopClass,
+    DcmItem* dataset, OFString& storagePath) const
+{
+    if (!isConfigured()) {
+        return true;
+    }
+    const std::string host = TransferPolicy::hostOf(callingHost);
+    for (const sCompiledRule& rule : m_rules->rules) {
+        if (!rule.matchesAssociation(callingAet, calledAet, host) || !rule.sopClass.matches(sopClass) || !rule.matchesTags(dataset)) {
+            continue;
+        }
+        if (rule.reject) {
+            countRejected("instance");
+            return false;
+        }
+        if (!rule.storagePath.empty()) {
+            storagePath = rule.storagePath;
+        }
+        return true;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcitem.h"
+
+// Accept and storage decisions of a store SCP, taken natively instead of by a storage event handler
+// that moves or deletes files once they are written. The rules are compiled once: tag keys are
+// resolved and each pattern is classified as any, exact, prefix or wildcard match. The first rule
+// whose conditions all match decides. Rules without conditions on attributes are applied while an
+// association is negotiated: matching any SOP class, they reject the association, matching one, they
+// refuse its presentation contexts. The others are applied to each instance once it is received, a
+// rejected instance is answered with rejectedStatus and neither stored, forwarded nor reported, an
+// accepted one is stored below the storage path of its rule if it has one. Each SCP has rules of its
+// own, copies share the compiled rules, which are never modified, so any thread may apply them.
+class StoreRules
+{
+public:
+    typedef ns::sStoreRule sRule;
+
+    // no rules, accepts everything
+    StoreRules();
+
+    // compiles rules and applies them from now on, an empty list accepts everything. False if a rule
+    // is invalid, e.g. with an unknown action or a tag key other than "GGGGEEEE", or its storage path
+    // cannot be created, the rules applied so far stay in place then
+    bool compile(const std::vector<sRule>& rules, std::string& error);
+
+    // true if any rules are applied
+    bool isConfigured() const;
+
+    // true if an association of callingAet at callingHost to calledAet is rejected as a whole
+    bool rejectsAssociation(const char* callingAet, const char* calledAet, const char* callingHost) const;
+
+    // true if the instances of sopClass are rejected on such an association whatever their attributes,
+    // its presentation contexts are refused then
+    bool rejectsSopClass(const char* callingAet, const char* calledAet, const char* callingHost, const char* sopClass) const;
+
+    // false if the instance of sopClass with the attributes of dataset is rejected. Otherwise
+    // storagePath is set to the storage path of the accepting rule, it is left as it is without one
+    bool acceptInstance(const char* callingAet, const char* calledAet, const char* callingHost, const char* sopClass,
+        DcmItem* dataset, OFString& storagePath) const;
+
+    // C-STORE status of rejected instances, Refused: Not Authorized
+    static const Uint16 rejectedStatus = 0x0124;
+
+private:
+    struct sRuleSet;
+
+    std::shared_ptr<const sRuleSet> m_rules;
+};
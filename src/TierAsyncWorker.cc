@@ -0,0 +1,220 @@
+#include "TierAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "json.h"
+#include "Utils.h"
+#include "dcmsqldb.h"
+#include "StorageTier.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+
+namespace
+{
+
+// modification time of a file, false if it is not on this tier
+bool modificationTime(const std::string& path, long long& mtime)
+{
+#ifdef HAVE_WINDOWS_H
+    struct _stati64 st;
+    if (_stati64(path.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#endif
+    mtime = static_cast<long long>(st.st_mtime);
+    return true;
+}
+
+}
+
+TierAsyncWorker::TierAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void TierAsyncWorker::Execute(const ExecutionProgress &progress)
+{
+    ns::sInput in = GetInput();
+
+    EnableVerboseLogging(in.verbose);
+
+    if (in.storagePath.empty()) {
+        SetErrorJson("No storage path set");
+        return;
+    }
+    if (in.coldPath.empty()) {
+        SetErrorJson("No cold path set");
+        return;
+    }
+    if (!OFStandard::dirExists(in.storagePath.c_str())) {
+        SetErrorJson("Specified storage path does not exist: " + in.storagePath);
+        return;
+    }
+    if (!OFStandard::dirExists(in.coldPath.c_str())) {
+        SetErrorJson("Specified cold path does not exist: " + in.coldPath);
+        return;
+    }
+    DcmXfer coldTransfer = in.writeTransfer.empty() ? DcmXfer(EXS_Unknown) : DcmXfer(in.writeTransfer.c_str());
+    if (!in.writeTransfer.empty() && coldTransfer.getXfer() == EXS_Unknown) {
+        SetErrorJson("Unknown transfer syntax: " + in.writeTransfer);
+        return;
+    }
+    if (!DcmIndexDatabasePool::configure(in.indexBackend == "postgresql" ?
+            DcmIndexDatabasePool::POSTGRESQL : DcmIndexDatabasePool::SQLITE, in.indexConnection)) {
+        SetErrorJson("Index backend not available in this build: " + in.indexBackend);
+        return;
+    }
+
+    DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(in.storagePath.c_str());
+    if (db == NULL || !db->isInitialized()) {
+        DcmIndexDatabasePool::release(db);
+        SetErrorJson("Cannot open the index of " + in.storagePath);
+        return;
+    }
+
+    // the files of every study, the index is read once and released before the migration
+    std::map<std::string, std::vector<std::string> > studies;
+    std::list<DcmSmallDcmElm> request;
+    request.push_back(DcmSmallDcmElm(DCM_StudyInstanceUID, ""));
+    request.push_back(DcmSmallDcmElm(DCM_PrivateFileName, ""));
+    DcmIndexFindCursor* cursor = db->openFind(request, IMAGE_LEVEL);
+    if (cursor != NULL) {
+        std::list<DcmSmallDcmElm> row;
+        while (cursor->next(row) && !Cancelled()) {
+            std::string study;
+            std::string file;
+            for (const DcmSmallDcmElm& el : row) {
+                if (el.XTag() == DCM_StudyInstanceUID) {
+                    study = el.valueField();
+                }
+                else if (el.XTag() == DCM_PrivateFileName) {
+                    file = el.valueField();
+                }
+            }
+            if (!file.empty()) {
+                studies[study].push_back(file);
+            }
+        }
+        delete cursor;
+    }
+    // retrievals of the SCP, recorded by the SQLite index only. Otherwise the age of the files decides
+    const std::map<std::string, long long> accessed = db->studyAccessTimes();
+    DcmIndexDatabasePool::release(db);
+
+    // a study stays hot as long as any of its files was stored or any of it was retrieved recently
+    const long long cutoff = static_cast<long long>(time(NULL)) - static_cast<long long>(std::max(in.tierAfterDays, 0)) * 86400;
+    std::vector<std::string> files;
+    size_t idleStudies = 0;
+    for (const std::pair<const std::string, std::vector<std::string> >& study : studies) {
+        std::map<std::string, long long>::const_iterator access = accessed.find(study.first);
+        long long lastActivity = access != accessed.end() ? access->second : 0;
+        std::vector<std::string> hot;
+        for (const std::string& file : study.second) {
+            long long mtime = 0;
+            if (modificationTime(file, mtime)) {
+                lastActivity = std::max(lastActivity, mtime);
+                hot.push_back(file);
+            }
+        }
+        if (!hot.empty() && lastActivity < cutoff) {
+            ++idleStudies;
+            files.insert(files.end(), hot.begin(), hot.end());
+        }
+    }
+
+    const size_t threads = std::min(in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1),
+        std::max<size_t>(files.size(), 1));
+    DCMNET_INFO("migrating " << files.size() << " files of " << idleStudies << " studies to " << in.coldPath << " using " << threads << " threads");
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> migrated(0);
+    std::atomic<size_t> failures(0);
+    std::mutex bytesMutex;
+    unsigned long long hotBytes = 0;
+    unsigned long long coldBytes = 0;
+    size_t running = threads;
+    std::condition_variable finished;
+    std::vector<std::thread> workers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            unsigned long long hot = 0;
+            unsigned long long cold = 0;
+            for (size_t i = next++; i < files.size() && !Cancelled(); i = next++) {
+                const std::string coldFile = StorageTier::relocate(files[i], in.storagePath, in.coldPath);
+                std::string error;
+                if (coldFile.empty()) {
+                    DCMNET_WARN(files[i] << " is outside of " << in.storagePath << ", it stays hot");
+                    ++failures;
+                }
+                else if (!StorageTier::migrate(files[i], coldFile, coldTransfer.getXfer(), hot, cold, error)) {
+                    DCMNET_WARN("cannot migrate " << files[i] << ": " << error);
+                    ++failures;
+                }
+                else {
+                    ++migrated;
+                }
+            }
+            std::lock_guard<std::mutex> lock(bytesMutex);
+            hotBytes += hot;
+            coldBytes += cold;
+            --running;
+            finished.notify_all();
+        }));
+    }
+
+    // progress at most once a second, from this thread only
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lock(bytesMutex);
+        while (!finished.wait_for(lock, std::chrono::seconds(1), [&running]() { return running == 0; })) {
+            json v = json::object();
+            v["studies"] = idleStudies;
+            v["instances"] = static_cast<size_t>(migrated);
+            v["total"] = files.size();
+            v["elapsed"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            lock.unlock();
+            SendResponse(ns::createResponse(ns::PENDING, "TIER_PROGRESS", v), progress);
+            lock.lock();
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    DCMNET_INFO("migrated " << migrated << " files, " << hotBytes << " bytes hot, " << coldBytes << " bytes cold, in " << elapsed << " s");
+
+    // also after a cancelled migration every file is on exactly one tier
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    json v = json::object();
+    v["studies"] = idleStudies;
+    v["instances"] = static_cast<size_t>(migrated);
+    v["failed"] = static_cast<size_t>(failures);
+    v["hotBytes"] = hotBytes;
+    v["coldBytes"] = coldBytes;
+    v["elapsed"] = elapsed;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
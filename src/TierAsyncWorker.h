@@ -0,0 +1,16 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// migrates the studies of a storage area which were neither stored to nor retrieved for
+// tierAfterDays days to its cold tier, converted to writeTransfer. The index keeps the hot paths,
+// the SCP recalls the files when they are retrieved
+class TierAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        TierAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
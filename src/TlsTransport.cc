@@ -0,0 +1,577 @@
+#include "TlsTransport.h"
+
+#include "dcmtk/dcmnet/cond.h"
+
+#ifdef WITH_TLS
+
+#include <chrono>
+#include <climits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "dcmtk/dcmnet/dcmtrans.h"
+#include "dcmtk/ofstd/ofstd.h"
+
+#include "Metrics.h"
+
+namespace {
+
+    // TLS 1.2 suites, forward secret AES-GCM first, CBC only as fallback for old peers
+    const char* defaultCiphers =
+        "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+        "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
+        "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+        "DHE-RSA-AES128-GCM-SHA256:DHE-RSA-AES256-GCM-SHA384:"
+        "ECDHE-RSA-AES128-SHA256:AES128-SHA";
+
+    // TLS 1.3 suites in the same order
+    const char* defaultCipherSuites = "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256";
+
+    // distinguishes the sessions of this addon in the server side cache
+    const unsigned char sessionIdContext[] = "dicom-dimse-native";
+
+    std::string lastError()
+    {
+        std::string text;
+        unsigned long code;
+        while ((code = ERR_get_error()) != 0) {
+            char buffer[256];
+            ERR_error_string_n(code, buffer, sizeof(buffer));
+            if (!text.empty()) {
+                text += "; ";
+            }
+            text += buffer;
+        }
+        return text.empty() ? "unknown TLS error" : text;
+    }
+
+    // address and port of the peer of a connected socket, keys the sessions of requested connections
+    std::string peerAddress(DcmNativeSocketType s)
+    {
+        struct sockaddr_storage addr;
+        socklen_t length = sizeof(addr);
+        if (getpeername(s, OFreinterpret_cast(struct sockaddr*, &addr), &length) != 0) {
+            return std::string();
+        }
+        char host[64] = { 0 };
+        unsigned short port = 0;
+        if (addr.ss_family == AF_INET) {
+            const struct sockaddr_in* in = OFreinterpret_cast(const struct sockaddr_in*, &addr);
+            inet_ntop(AF_INET, OFconst_cast(struct in_addr*, &in->sin_addr), host, sizeof(host));
+            port = ntohs(in->sin_port);
+        }
+        else if (addr.ss_family == AF_INET6) {
+            const struct sockaddr_in6* in6 = OFreinterpret_cast(const struct sockaddr_in6*, &addr);
+            inet_ntop(AF_INET6, OFconst_cast(struct in6_addr*, &in6->sin6_addr), host, sizeof(host));
+            port = ntohs(in6->sin6_port);
+        }
+        return std::string(host) + ":" + std::to_string(port);
+    }
+
+    // the last session of each peer of requested connections, least recently stored ones are dropped
+    class SessionCache
+    {
+    public:
+        ~SessionCache()
+        {
+            for (Entry& entry : m_entries) {
+                SSL_SESSION_free(entry.second);
+            }
+        }
+
+        // takes over the reference of session
+        void put(const std::string& peer, SSL_SESSION* session)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            remove(peer);
+            m_entries.push_front(Entry(peer, session));
+            m_index[peer] = m_entries.begin();
+            while (m_entries.size() > TlsTransport::maxSessions) {
+                m_index.erase(m_entries.back().first);
+                SSL_SESSION_free(m_entries.back().second);
+                m_entries.pop_back();
+            }
+        }
+
+        // a new reference to the session of peer, NULL if there is none
+        SSL_SESSION* get(const std::string& peer)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = m_index.find(peer);
+            if (it == m_index.end()) {
+                return NULL;
+            }
+            SSL_SESSION* session = it->second->second;
+            SSL_SESSION_up_ref(session);
+            return session;
+        }
+
+    private:
+        typedef std::pair<std::string, SSL_SESSION*> Entry;
+
+        void remove(const std::string& peer)
+        {
+            std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = m_index.find(peer);
+            if (it != m_index.end()) {
+                SSL_SESSION_free(it->second->second);
+                m_entries.erase(it->second);
+                m_index.erase(it);
+            }
+        }
+
+        std::mutex m_mutex;
+        std::list<Entry> m_entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    };
+
+    class TlsTransportLayer;
+
+    // index of the layer in the ex_data of each SSL, for the new session callback
+    int layerIndex()
+    {
+        static const int index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+        return index;
+    }
+
+    // index of the peer address in the ex_data of each requested SSL
+    int peerIndex()
+    {
+        static const int index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+        return index;
+    }
+
+    void recordHandshake(bool acceptor, SSL* ssl, double seconds)
+    {
+        const char* role = acceptor ? "server" : "client";
+        Metrics::counter("tls_handshakes_total", {{"role", role}, {"session", SSL_session_reused(ssl) ? "resumed" : "new"}}).add();
+        Metrics::histogram("tls_handshake_seconds", {{"role", role}}).record(seconds);
+    }
+
+    class TlsConnection : public DcmTransportConnection
+    {
+    public:
+        TlsConnection(DcmNativeSocketType openSocket, SSL* ssl, SessionCache* sessions, const std::string& serverName)
+            : DcmTransportConnection(openSocket), m_ssl(ssl), m_sessions(sessions), m_serverName(serverName)
+        {
+            SSL_set_fd(m_ssl, OFstatic_cast(int, openSocket));
+        }
+
+        virtual ~TlsConnection()
+        {
+            close();
+        }
+
+        virtual DcmTransportLayerStatus serverSideHandshake()
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (SSL_accept(m_ssl) != 1) {
+                DCMNET_ERROR("TLS handshake with the requestor failed: " << lastError());
+                Metrics::counter("tls_handshakes_total", {{"role", "server"}, {"session", "failed"}}).add();
+                return TCS_tlsError;
+            }
+            recordHandshake(true, m_ssl, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            return TCS_ok;
+        }
+
+        virtual DcmTransportLayerStatus clientSideHandshake()
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            // sessions of TLS 1.3 arrive after the handshake, the new session callback stores them
+            const std::string peer = peerAddress(getSocket());
+            if (!peer.empty()) {
+                m_peer = peer;
+                SSL_set_ex_data(m_ssl, peerIndex(), &m_peer);
+                SSL_SESSION* session = m_sessions->get(m_peer);
+                if (session != NULL) {
+                    SSL_set_session(m_ssl, session);
+                    SSL_SESSION_free(session);
+                }
+            }
+            if (!m_serverName.empty() && !expectServerName()) {
+                DCMNET_ERROR("TLS handshake with the acceptor failed: invalid tlsServerName " << m_serverName << ": " << lastError());
+                Metrics::counter("tls_handshakes_total", {{"role", "client"}, {"session", "failed"}}).add();
+                return TCS_tlsError;
+            }
+            if (SSL_connect(m_ssl) != 1) {
+                DCMNET_ERROR("TLS handshake with the acceptor failed: " << lastError());
+                Metrics::counter("tls_handshakes_total", {{"role", "client"}, {"session", "failed"}}).add();
+                return TCS_tlsError;
+            }
+            recordHandshake(false, m_ssl, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            return TCS_ok;
+        }
+
+        virtual DcmTransportLayerStatus renegotiate(const char* /* newSuite */)
+        {
+            // renegotiation is not part of TLS 1.3 and disabled for TLS 1.2
+            return TCS_illegalCall;
+        }
+
+        virtual ssize_t read(void* buf, size_t nbyte)
+        {
+            if (m_ssl == NULL) {
+                return -1;
+            }
+            const int result = SSL_read(m_ssl, buf, OFstatic_cast(int, nbyte > INT_MAX ? INT_MAX : nbyte));
+            if (result > 0) {
+                return result;
+            }
+            // a close notify of the peer ends the connection like a closed socket
+            return SSL_get_error(m_ssl, result) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+        }
+
+        virtual ssize_t write(void* buf, size_t nbyte)
+        {
+            if (m_ssl == NULL) {
+                return -1;
+            }
+            const int result = SSL_write(m_ssl, buf, OFstatic_cast(int, nbyte > INT_MAX ? INT_MAX : nbyte));
+            return result > 0 ? result : -1;
+        }
+
+        virtual void close()
+        {
+            if (m_ssl != NULL) {
+                // a one way close notify, the peer may be gone already
+                SSL_shutdown(m_ssl);
+                SSL_free(m_ssl);
+                m_ssl = NULL;
+            }
+            if (getSocket() != DCMNET_INVALID_SOCKET) {
+#ifdef _WIN32
+                (void) shutdown(getSocket(), 1 /* SD_SEND */);
+                (void) closesocket(getSocket());
+#else
+                (void) ::close(getSocket());
+#endif
+                setSocket(DCMNET_INVALID_SOCKET);
+            }
+        }
+
+        virtual unsigned long getPeerCertificateLength()
+        {
+            return getPeerCertificate(NULL, 0);
+        }
+
+        virtual unsigned long getPeerCertificate(void* buf, unsigned long bufLen)
+        {
+            X509* certificate = m_ssl != NULL ? SSL_get_peer_certificate(m_ssl) : NULL;
+            if (certificate == NULL) {
+                return 0;
+            }
+            unsigned long length = 0;
+            const int size = i2d_X509(certificate, NULL);
+            if (size > 0) {
+                length = OFstatic_cast(unsigned long, size);
+                if (buf != NULL) {
+                    if (bufLen < length) {
+                        length = 0;
+                    }
+                    else {
+                        unsigned char* out = OFstatic_cast(unsigned char*, buf);
+                        i2d_X509(certificate, &out);
+                    }
+                }
+            }
+            X509_free(certificate);
+            return length;
+        }
+
+        virtual OFBool networkDataAvailable(int timeout)
+        {
+            // records already decrypted are not visible on the socket
+            if (m_ssl != NULL && SSL_pending(m_ssl) > 0) {
+                return OFTrue;
+            }
+            fd_set fdset;
+            FD_ZERO(&fdset);
+            FD_SET(getSocket(), &fdset);
+            struct timeval t;
+            t.tv_sec = timeout;
+            t.tv_usec = 0;
+            // the first parameter is ignored on Windows
+            return select(OFstatic_cast(int, getSocket() + 1), &fdset, NULL, NULL, &t) > 0;
+        }
+
+        virtual OFBool isTransparentConnection()
+        {
+            return OFFalse;
+        }
+
+        virtual OFString& dumpConnectionParameters(OFString& str)
+        {
+            if (m_ssl == NULL) {
+                str = "Transport connection: TLS, closed.";
+                return str;
+            }
+            str = "Transport connection: ";
+            str += SSL_get_version(m_ssl);
+            str += ", cipher suite ";
+            str += SSL_get_cipher_name(m_ssl);
+            str += SSL_session_reused(m_ssl) ? ", resumed session." : ", new session.";
+            return str;
+        }
+
+        virtual const char* errorString(DcmTransportLayerStatus code)
+        {
+            switch (code)
+            {
+                case TCS_ok:
+                    return "no error";
+                case TCS_noConnection:
+                    return "no secure connection in place";
+                case TCS_tlsError:
+                    return "TLS error";
+                case TCS_illegalCall:
+                    return "illegal call";
+                case TCS_unspecifiedError:
+                    return "unspecified error";
+            }
+            return "unknown error code";
+        }
+
+    private:
+        // names the acceptor by SNI and, if its certificate is verified, requires the certificate to
+        // match the name, addresses are not sent as SNI and match the IP entries of the certificate
+        bool expectServerName()
+        {
+            unsigned char address[16];
+            const char* name = m_serverName.c_str();
+            const bool literal = inet_pton(AF_INET, name, address) == 1 || inet_pton(AF_INET6, name, address) == 1;
+            if (!literal && SSL_set_tlsext_host_name(m_ssl, name) != 1) {
+                return false;
+            }
+            if ((SSL_get_verify_mode(m_ssl) & SSL_VERIFY_PEER) == 0) {
+                return true;
+            }
+            return literal ? X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(m_ssl), name) == 1 : SSL_set1_host(m_ssl, name) == 1;
+        }
+
+        SSL* m_ssl;
+        SessionCache* m_sessions;
+        std::string m_peer;
+        std::string m_serverName;
+    };
+
+    // creates the TLS connections of one role and set of options
+    class TlsTransportLayer : public DcmTransportLayer
+    {
+    public:
+        TlsTransportLayer(bool acceptor, const std::string& serverName)
+            : m_acceptor(acceptor), m_serverName(acceptor ? std::string() : serverName), m_context(NULL) {}
+
+        virtual ~TlsTransportLayer()
+        {
+            if (m_context != NULL) {
+                SSL_CTX_free(m_context);
+            }
+        }
+
+        bool initialize(const ns::sNetworkOptions& network, std::string& error)
+        {
+            OPENSSL_init_ssl(0, NULL);
+            m_context = SSL_CTX_new(m_acceptor ? TLS_server_method() : TLS_client_method());
+            if (m_context == NULL) {
+                error = lastError();
+                return false;
+            }
+            SSL_CTX_set_min_proto_version(m_context, TLS1_2_VERSION);
+            long options = SSL_OP_NO_COMPRESSION;
+#ifdef SSL_OP_NO_RENEGOTIATION
+            options |= SSL_OP_NO_RENEGOTIATION;
+#endif
+            if (m_acceptor) {
+                options |= SSL_OP_CIPHER_SERVER_PREFERENCE;
+            }
+            SSL_CTX_set_options(m_context, options);
+            SSL_CTX_set_mode(m_context, SSL_MODE_AUTO_RETRY);
+
+            const std::string ciphers = network.tlsCiphers.empty() ? defaultCiphers : network.tlsCiphers;
+            if (SSL_CTX_set_cipher_list(m_context, ciphers.c_str()) != 1) {
+                error = "invalid tlsCiphers: " + lastError();
+                return false;
+            }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            SSL_CTX_set_ciphersuites(m_context, defaultCipherSuites);
+#endif
+
+            if (!network.tlsCertificate.empty()) {
+                if (SSL_CTX_use_certificate_chain_file(m_context, network.tlsCertificate.c_str()) != 1) {
+                    error = "cannot load tlsCertificate " + network.tlsCertificate + ": " + lastError();
+                    return false;
+                }
+                const std::string& key = network.tlsPrivateKey.empty() ? network.tlsCertificate : network.tlsPrivateKey;
+                if (SSL_CTX_use_PrivateKey_file(m_context, key.c_str(), SSL_FILETYPE_PEM) != 1 ||
+                    SSL_CTX_check_private_key(m_context) != 1) {
+                    error = "cannot load tlsPrivateKey " + key + ": " + lastError();
+                    return false;
+                }
+            }
+            else if (m_acceptor) {
+                error = "tlsCertificate is required to accept TLS connections";
+                return false;
+            }
+
+            const std::string& ca = network.tlsCaCertificates;
+            const bool loaded = ca.empty() ? SSL_CTX_set_default_verify_paths(m_context) == 1
+                : OFStandard::dirExists(ca.c_str()) ? SSL_CTX_load_verify_locations(m_context, NULL, ca.c_str()) == 1
+                : SSL_CTX_load_verify_locations(m_context, ca.c_str(), NULL) == 1;
+            if (!loaded) {
+                error = "cannot load tlsCaCertificates " + ca + ": " + lastError();
+                return false;
+            }
+            if (network.tlsVerifyPeer != 0) {
+                // peers authenticate each other, requestors need a certificate as well
+                SSL_CTX_set_verify(m_context, m_acceptor ? SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT : SSL_VERIFY_PEER, NULL);
+            }
+            else {
+                SSL_CTX_set_verify(m_context, SSL_VERIFY_NONE, NULL);
+            }
+
+            SSL_CTX_set_timeout(m_context, TlsTransport::sessionTimeout);
+            if (m_acceptor) {
+                // session IDs for TLS 1.2 peers without ticket support, tickets for all others
+                SSL_CTX_set_session_id_context(m_context, sessionIdContext, sizeof(sessionIdContext) - 1);
+                SSL_CTX_set_session_cache_mode(m_context, SSL_SESS_CACHE_SERVER);
+                SSL_CTX_sess_set_cache_size(m_context, 20 * TlsTransport::maxSessions);
+            }
+            else {
+                SSL_CTX_set_session_cache_mode(m_context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+                SSL_CTX_sess_set_new_cb(m_context, &TlsTransportLayer::newSession);
+            }
+            return true;
+        }
+
+        virtual DcmTransportConnection* createConnection(DcmNativeSocketType openSocket, OFBool useSecureLayer)
+        {
+            if (!useSecureLayer) {
+                return DcmTransportLayer::createConnection(openSocket, useSecureLayer);
+            }
+            SSL* ssl = SSL_new(m_context);
+            if (ssl == NULL) {
+                DCMNET_ERROR("cannot create TLS connection: " << lastError());
+                return NULL;
+            }
+            SSL_set_ex_data(ssl, layerIndex(), this);
+            return new TlsConnection(openSocket, ssl, &m_sessions, m_serverName);
+        }
+
+    private:
+        static int newSession(SSL* ssl, SSL_SESSION* session)
+        {
+            TlsTransportLayer* layer = OFstatic_cast(TlsTransportLayer*, SSL_get_ex_data(ssl, layerIndex()));
+            const std::string* peer = OFstatic_cast(const std::string*, SSL_get_ex_data(ssl, peerIndex()));
+            if (layer == NULL || peer == NULL || peer->empty()) {
+                return 0;
+            }
+            // the cache keeps the reference
+            layer->m_sessions.put(*peer, session);
+            return 1;
+        }
+
+        bool m_acceptor;
+        std::string m_serverName;
+        SSL_CTX* m_context;
+        SessionCache m_sessions;
+    };
+
+    std::mutex layersMutex;
+    std::map<std::string, std::unique_ptr<TlsTransportLayer> > layers;
+
+}
+
+bool TlsTransport::isAvailable()
+{
+    return true;
+}
+
+DcmTransportLayer* TlsTransport::layer(bool acceptor, const ns::sNetworkOptions& network, std::string& error)
+{
+    const std::string key = std::string(acceptor ? "acceptor" : "requestor") + '\n' + network.tlsCertificate + '\n' +
+        network.tlsPrivateKey + '\n' + network.tlsCaCertificates + '\n' + network.tlsCiphers + '\n' +
+        std::to_string(network.tlsVerifyPeer) + (acceptor ? std::string() : '\n' + network.tlsServerName);
+    std::lock_guard<std::mutex> lock(layersMutex);
+    std::map<std::string, std::unique_ptr<TlsTransportLayer> >::iterator it = layers.find(key);
+    if (it != layers.end()) {
+        return it->second.get();
+    }
+    std::unique_ptr<TlsTransportLayer> created(new TlsTransportLayer(acceptor, network.tlsServerName));
+    if (!created->initialize(network, error)) {
+        return NULL;
+    }
+    TlsTransportLayer* result = created.get();
+    layers[key] = std::move(created);
+    return result;
+}
+
+#else
+
+bool TlsTransport::isAvailable()
+{
+    return false;
+}
+
+DcmTransportLayer* TlsTransport::layer(bool /* acceptor */, const ns::sNetworkOptions& /* network */, std::string& error)
+{
+    error = "TLS not available in this build, rebuild with --CDDCMTK_TLS=ON";
+    return NULL;
+}
+
+#endif
+
+OFCondition TlsTransport::secure(T_ASC_Network* net, bool acceptor, const ns::sNetworkOptions& network)
+{
+    if (!network.tls) {
+        return EC_Normal;
+    }
+    std::string error;
+    DcmTransportLayer* tlayer = layer(acceptor, network, error);
+    if (tlayer == NULL) {
+        return makeOFCondition(OFM_dcmnet, DULC_TLSERROR, OF_error, error.c_str());
+    }
+    return ASC_setTransportLayer(net, tlayer, 0 /* shared, not owned by the network */);
+}
+
+OFCondition TlsTransport::secure(DcmSCU& scu, const ns::sNetworkOptions& network)
+{
+    if (!network.tls) {
+        return EC_Normal;
+    }
+    std::string error;
+    DcmTransportLayer* tlayer = layer(false, network, error);
+    if (tlayer == NULL) {
+        return makeOFCondition(OFM_dcmnet, DULC_TLSERROR, OF_error, error.c_str());
+    }
+    return scu.useSecureConnection(tlayer);
+}
+
+OFCondition TlsTransport::secure(DcmFindSCU& findscu, const ns::sNetworkOptions& network)
+{
+    if (!network.tls) {
+        return EC_Normal;
+    }
+    std::string error;
+    DcmTransportLayer* tlayer = layer(false, network, error);
+    if (tlayer == NULL) {
+        return makeOFCondition(OFM_dcmnet, DULC_TLSERROR, OF_error, error.c_str());
+    }
+    return findscu.setTransportLayer(tlayer);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/assoc.h"
+#include "dcmtk/dcmnet/scu.h"
+#include "dcmtk/dcmnet/dfindscu.h"
+
+#include "Utils.h"
+
+// DICOM over TLS (PS3.15 Annex B) for the associations of all requests. Requests with the same
+// role and TLS options share one transport layer and its SSL_CTX, which lives as long as the
+// process, so certificates and keys are loaded once and sessions survive the request. Accepted
+// connections offer session tickets and a server side session cache, requested connections
+// resume the last session of their peer address, so repeated short associations skip the
+// certificate exchange and key agreement. AES-GCM suites are preferred, which OpenSSL runs on
+// the AES and carry-less multiplication instructions of the CPU where available.
+class TlsTransport
+{
+public:
+    // true if the addon is built with TLS support
+    static bool isAvailable();
+
+    // the shared layer for the TLS options of network, NULL with error set if TLS is not available
+    // or the certificate, key or CA certificates cannot be loaded
+    static DcmTransportLayer* layer(bool acceptor, const ns::sNetworkOptions& network, std::string& error);
+
+    // encrypts the associations accepted or requested over net if network.tls is set, requested
+    // associations also need ASC_setTransportLayerType(params, network.tls)
+    static OFCondition secure(T_ASC_Network* net, bool acceptor, const ns::sNetworkOptions& network);
+
+    // encrypts the associations of scu if network.tls is set, also after initNetwork() again
+    static OFCondition secure(DcmSCU& scu, const ns::sNetworkOptions& network);
+
+    // encrypts the queries of findscu if network.tls is set, after initializeNetwork()
+    static OFCondition secure(DcmFindSCU& findscu, const ns::sNetworkOptions& network);
+
+    // sessions of requested connections kept per peer address
+    static const size_t maxSessions = 1024;
+
+    // seconds a session can be resumed
+    static const long sessionTimeout = 3600;
+};
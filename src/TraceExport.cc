@@ -0,0 +1,112 @@
+#include "TraceExport.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/oftrace.h"
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+using json = nlohmann::json;
+
+namespace
+{
+
+// spans of all threads recorded since the last export
+OFVector<OFTraceEvent> drain(size_t& dropped)
+{
+    OFVector<OFTraceEvent> events;
+    dropped = OFTrace::drain(events);
+    return events;
+}
+
+std::string hex(uint64_t value, int digits)
+{
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%0*llx", digits, static_cast<unsigned long long>(value));
+    return buffer;
+}
+
+// distinguishes the traces of this process from those of other processes with the same association numbers
+uint64_t processSalt()
+{
+    static const uint64_t salt = std::random_device()() * 0x100000000ull + std::random_device()();
+    return salt;
+}
+
+}
+
+json TraceExport::chrome()
+{
+    size_t dropped = 0;
+    OFVector<OFTraceEvent> events = drain(dropped);
+    const long pid = static_cast<long>(OFStandard::getProcessID());
+
+    json trace = json::array();
+    for (const OFTraceEvent& event : events) {
+        json args = json::object();
+        if (event.association) {
+            args["dicom.association"] = event.association;
+        }
+        if (event.instance[0]) {
+            args["dicom.sopInstanceUID"] = event.instance;
+        }
+        trace.push_back({
+            {"name", event.name},
+            {"cat", "dcmtk"},
+            {"ph", "X"},
+            // microseconds
+            {"ts", event.start / 1000.0},
+            {"dur", event.duration / 1000.0},
+            {"pid", pid},
+            {"tid", event.thread},
+            {"args", args}});
+    }
+    json v = json::object();
+    v["traceEvents"] = trace;
+    v["displayTimeUnit"] = "ms";
+    v["otherData"] = {{"dropped", dropped}};
+    return v;
+}
+
+json TraceExport::otlp(const std::string& serviceName)
+{
+    size_t dropped = 0;
+    OFVector<OFTraceEvent> events = drain(dropped);
+    const uint64_t salt = processSalt();
+
+    static std::atomic<uint64_t> spanNumber(0);
+    json spans = json::array();
+    for (const OFTraceEvent& event : events) {
+        json attributes = json::array();
+        attributes.push_back({{"key", "thread.id"}, {"value", {{"intValue", std::to_string(event.thread)}}}});
+        if (event.association) {
+            attributes.push_back({{"key", "dicom.association"}, {"value", {{"intValue", std::to_string(event.association)}}}});
+        }
+        if (event.instance[0]) {
+            attributes.push_back({{"key", "dicom.sopInstanceUID"}, {"value", {{"stringValue", event.instance}}}});
+        }
+        // spans outside an association get a trace of their own
+        const uint64_t trace = event.association ? event.association : (1ull << 63) | ++spanNumber;
+        spans.push_back({
+            {"traceId", hex(salt, 16) + hex(trace, 16)},
+            {"spanId", hex(salt ^ ++spanNumber, 16)},
+            {"name", event.name},
+            // SPAN_KIND_INTERNAL
+            {"kind", 1},
+            {"startTimeUnixNano", std::to_string(event.start)},
+            {"endTimeUnixNano", std::to_string(event.start + event.duration)},
+            {"attributes", attributes}});
+    }
+
+    json resource = {{"attributes", json::array({{{"key", "service.name"}, {"value", {{"stringValue", serviceName}}}}})}};
+    json scopeSpans = {{"scope", {{"name", "dcmtk"}}}, {"spans", spans}};
+    json v = json::object();
+    v["resourceSpans"] = json::array({{{"resource", resource}, {"scopeSpans", json::array({scopeSpans})}}});
+    if (dropped > 0) {
+        DCMNET_WARN(dropped << " trace spans dropped, the per-thread trace buffers were full");
+    }
+    return v;
+}
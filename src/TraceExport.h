@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+#include "json.h"
+
+// Converts the trace spans recorded by OFTraceSpan in DCMTK and in the addon. Each call drains the
+// per-thread buffers, so spans are exported once. Spans carry the association they belong to
+// (dicom.association) and the SOP instance processed (dicom.sopInstanceUID) if known.
+class TraceExport
+{
+public:
+    // Chrome trace event format (chrome://tracing, Perfetto): complete events per thread
+    static nlohmann::json chrome();
+
+    // OTLP/JSON ExportTraceServiceRequest, the spans of an association share a trace id
+    static nlohmann::json otlp(const std::string& serviceName);
+};
@@ -0,0 +1,191 @@
+#include "TransferPolicy.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "Metrics.h"
+
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmdata/dcostrmz.h"  /* for dcmZlibCompressionLevel */
+#include "dcmtk/dcmnet/diutil.h"
+
+namespace
+{
+
+// weight of a new measurement in the moving averages
+const double smoothing = 0.25;
+
+// a decision flips once the bandwidth is this far past the break-even point
+const double hysteresis = 1.25;
+
+// peers kept, the oldest entries are dropped beyond
+const size_t maxLinks = 4096;
+
+struct sLink {
+    sLink() : bandwidth(0), pendingBytes(0), pendingSeconds(0), image(TransferPolicy::DEFAULT), other(TransferPolicy::DEFAULT) {}
+    double bandwidth;               // bytes per second, 0 until minTransferSize was transferred
+    uint64_t pendingBytes;          // transferred since the last measurement
+    double pendingSeconds;
+    TransferPolicy::eChoice image;  // last decision for images
+    TransferPolicy::eChoice other;  // last decision for other objects
+};
+
+std::mutex policyMutex;
+std::map<std::string, sLink> links;
+std::atomic<int> cpuBudget(1);
+
+// lossless image encoders until measured: JPEG-LS runs at about 40 MB/s per core and halves
+// CT and MR images, some more
+double imageEncodeRate = 40e6;
+double imageRatio = 2.5;
+
+double smooth(double average, double value)
+{
+    return average > 0 ? average + smoothing * (value - average) : value;
+}
+
+// deflate rate per core and ratio on structured reports and similar objects at the current level
+void deflateEstimate(double& rate, double& ratio)
+{
+    int level = 6;
+#ifdef WITH_ZLIB
+    level = dcmZlibCompressionLevel.get();
+#endif
+    rate = level <= 3 ? 80e6 : level <= 6 ? 30e6 : 10e6;
+    ratio = level == 0 ? 1.0 : 4.0;
+}
+
+const char* choiceName(TransferPolicy::eChoice choice)
+{
+    return choice == TransferPolicy::COMPRESSED ? "compressed" : choice == TransferPolicy::UNCOMPRESSED ? "uncompressed" : "default";
+}
+
+}
+
+TransferPolicy::eChoice TransferPolicy::parse(const std::string& mode)
+{
+    if (mode == "compressed") {
+        return COMPRESSED;
+    }
+    if (mode == "uncompressed") {
+        return UNCOMPRESSED;
+    }
+    return DEFAULT;
+}
+
+void TransferPolicy::setCpuBudget(int cores)
+{
+    if (cores >= 0) {
+        cpuBudget = cores;
+    }
+}
+
+void TransferPolicy::recordTransfer(const std::string& host, uint64_t bytes, double seconds)
+{
+    if (host.empty() || bytes == 0 || seconds < 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(policyMutex);
+    std::map<std::string, sLink>::iterator link = links.find(host);
+    if (link == links.end()) {
+        if (links.size() >= maxLinks) {
+            links.erase(links.begin());
+        }
+        link = links.insert(std::make_pair(host, sLink())).first;
+    }
+    // small datasets are added up until they are large enough to measure the bandwidth rather than the latency
+    link->second.pendingBytes += bytes;
+    link->second.pendingSeconds += seconds;
+    if (link->second.pendingBytes >= minTransferSize && link->second.pendingSeconds > 0) {
+        link->second.bandwidth = smooth(link->second.bandwidth, OFstatic_cast(double, link->second.pendingBytes) / link->second.pendingSeconds);
+        link->second.pendingBytes = 0;
+        link->second.pendingSeconds = 0;
+    }
+}
+
+void TransferPolicy::recordEncoding(E_TransferSyntax xfer, uint64_t bytes, uint64_t compressedBytes, double seconds)
+{
+    if (!DcmXfer(xfer).isLossless() || bytes == 0 || compressedBytes == 0 || seconds <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(policyMutex);
+    imageEncodeRate = smooth(imageEncodeRate, OFstatic_cast(double, bytes) / seconds);
+    imageRatio = smooth(imageRatio, OFstatic_cast(double, bytes) / OFstatic_cast(double, compressedBytes));
+}
+
+double TransferPolicy::bandwidth(const std::string& host)
+{
+    std::lock_guard<std::mutex> lock(policyMutex);
+    std::map<std::string, sLink>::const_iterator link = links.find(host);
+    return link != links.end() ? link->second.bandwidth : 0;
+}
+
+TransferPolicy::eChoice TransferPolicy::decide(const std::string& host, const std::string& aet, const char* sopClassUID, eChoice override)
+{
+    if (override != DEFAULT) {
+        return override;
+    }
+    if (sopClassUID == NULL || !dcmIsaStorageSOPClassUID(sopClassUID, ESSC_All)) {
+        return DEFAULT;
+    }
+    const bool image = dcmIsImageStorageSOPClassUID(sopClassUID) ? true : false;
+#ifndef WITH_ZLIB
+    if (!image) {
+        // nothing to compress other objects with
+        return DEFAULT;
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(policyMutex);
+    std::map<std::string, sLink>::iterator link = links.find(host);
+    if (link == links.end() || link->second.bandwidth <= 0) {
+        return DEFAULT;
+    }
+
+    double rate = imageEncodeRate;
+    double ratio = imageRatio;
+    if (!image) {
+        deflateEstimate(rate, ratio);
+    }
+    // bandwidth below which compressing and then sending is faster than sending as is
+    const double breakEven = cpuBudget * rate * (ratio > 1 ? 1 - 1 / ratio : 0);
+    const double bandwidth = link->second.bandwidth;
+
+    eChoice& last = image ? link->second.image : link->second.other;
+    eChoice choice = last;
+    if (bandwidth * hysteresis < breakEven) {
+        choice = COMPRESSED;
+    }
+    else if (bandwidth > breakEven * hysteresis) {
+        choice = UNCOMPRESSED;
+    }
+    else if (choice == DEFAULT) {
+        choice = bandwidth < breakEven ? COMPRESSED : UNCOMPRESSED;
+    }
+
+    if (choice != last) {
+        DCMNET_INFO("transfer policy: " << (image ? "images" : "other objects") << " to and from " << aet << " (" << host << ") "
+            << choiceName(choice) << ", measured " << bandwidth / 1e6 << " MB/s, break-even " << breakEven / 1e6 << " MB/s");
+        Metrics::counter("transfer_policy_changes_total", {{"objects", image ? "image" : "other"}, {"choice", choiceName(choice)}}).add();
+        last = choice;
+    }
+    return choice;
+}
+
+int TransferPolicy::preferCompressed(const std::string& host, const std::string& aet, const char* sopClassUID, eChoice override)
+{
+    eChoice choice = decide(host, aet, sopClassUID, override);
+    return choice == COMPRESSED ? 1 : choice == UNCOMPRESSED ? 0 : -1;
+}
+
+std::string TransferPolicy::hostOf(const char* presentationAddress)
+{
+    std::string address = presentationAddress != NULL ? presentationAddress : "";
+    // a single colon separates the port, IPv6 addresses have several
+    size_t colon = address.find(':');
+    if (colon != std::string::npos && address.find(':', colon + 1) == std::string::npos) {
+        address.erase(colon);
+    }
+    return address;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcxfer.h"
+
+// Chooses between compressed and uncompressed transfer syntaxes per peer and SOP class. Sending a
+// dataset compressed costs bytes/encodeRate seconds of CPU and saves bytes*(1-1/ratio)/bandwidth
+// seconds on the wire, so it pays off on links slower than budget*encodeRate*(1-1/ratio). The
+// bandwidth of each peer is measured on the datasets sent to and received from it, encode rate and
+// compression ratio of the lossless image codecs on their encoder calls, deflate is estimated from
+// its level. Images are compared against the lossless codecs, other objects against deflate. Peers
+// that have not been measured keep the configured transfer syntaxes, and a decision only flips back
+// once the bandwidth moved clearly past the break-even point, changed decisions are logged.
+class TransferPolicy
+{
+public:
+    enum eChoice {
+        DEFAULT,        // the configured transfer syntaxes
+        COMPRESSED,     // lossless compressed images, deflated other objects
+        UNCOMPRESSED    // explicit or implicit VR little endian
+    };
+
+    // "compressed" or "uncompressed", anything else ("auto") is DEFAULT
+    static eChoice parse(const std::string& mode);
+
+    // cores that may be spent compressing the data of the associations, negative values keep the
+    // current budget, 0 never prefers compression for measured peers
+    static void setCpuBudget(int cores);
+
+    // bytes sent to or received from host in seconds of transfer, e.g. a single dataset. Transfers are
+    // added up until they reach minTransferSize, below which the latency rather than the bandwidth counts
+    static void recordTransfer(const std::string& host, uint64_t bytes, double seconds);
+
+    // an encoder call of xfer that compressed bytes to compressedBytes in seconds
+    static void recordEncoding(E_TransferSyntax xfer, uint64_t bytes, uint64_t compressedBytes, double seconds);
+
+    // the measured bandwidth to host in bytes per second, 0 if not measured yet
+    static double bandwidth(const std::string& host);
+
+    // the transfer syntaxes for sopClassUID on the link to host, aet only names the peer in the log.
+    // A choice other than DEFAULT overrides the measurement, e.g. configured for the peer
+    static eChoice decide(const std::string& host, const std::string& aet, const char* sopClassUID, eChoice override = DEFAULT);
+
+    // decide() as used by DcmQueryRetrieveConfig::preferCompressed(): 1, 0 or -1 for DEFAULT
+    static int preferCompressed(const std::string& host, const std::string& aet, const char* sopClassUID, eChoice override = DEFAULT);
+
+    // the host of a presentation address "host:port"
+    static std::string hostOf(const char* presentationAddress);
+
+    // bytes added up for a measurement
+    static const uint64_t minTransferSize = 256 * 1024;
+};
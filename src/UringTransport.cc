@@ -0,0 +1,481 @@
+#include "UringTransport.h"
+
+#include "dcmtk/dcmnet/dcmlayer.h"
+#include "dcmtk/dcmnet/dcmtrans.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+#include <atomic>
+
+#ifdef WITH_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+    // a submission and completion queue pair shared with the kernel, used by one thread at a time.
+    // Entries are prepared with next() and submitted together by run(), which waits for all of them
+    class Ring
+    {
+    public:
+        Ring()
+            : m_fd(-1), m_sqRing(NULL), m_cqRing(NULL), m_sqes(NULL), m_sqRingSize(0), m_cqRingSize(0), m_sqesSize(0),
+              m_sqTail(NULL), m_sqMask(NULL), m_sqArray(NULL), m_cqHead(NULL), m_cqTail(NULL), m_cqMask(NULL), m_cqes(NULL), m_prepared(0) {}
+
+        ~Ring()
+        {
+            destroy();
+        }
+
+        // creates the ring, errno is set if it fails
+        bool create(unsigned entries)
+        {
+            struct io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            m_fd = OFstatic_cast(int, syscall(__NR_io_uring_setup, entries, &params));
+            if (m_fd < 0) {
+                return false;
+            }
+            m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(__u32);
+            m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+            const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMap) {
+                m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+            }
+            m_sqRing = map(m_sqRingSize, IORING_OFF_SQ_RING);
+            m_cqRing = singleMap ? m_sqRing : map(m_cqRingSize, IORING_OFF_CQ_RING);
+            m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+            void* sqes = map(m_sqesSize, IORING_OFF_SQES);
+            if (m_sqRing == NULL || m_cqRing == NULL || sqes == NULL) {
+                const int error = errno;
+                if (sqes != NULL) {
+                    munmap(sqes, m_sqesSize);
+                }
+                destroy();
+                errno = error;
+                return false;
+            }
+            char* sq = OFstatic_cast(char*, m_sqRing);
+            m_sqTail = OFreinterpret_cast(unsigned*, sq + params.sq_off.tail);
+            m_sqMask = OFreinterpret_cast(unsigned*, sq + params.sq_off.ring_mask);
+            m_sqArray = OFreinterpret_cast(unsigned*, sq + params.sq_off.array);
+            m_sqes = OFstatic_cast(struct io_uring_sqe*, sqes);
+            char* cq = OFstatic_cast(char*, m_cqRing);
+            m_cqHead = OFreinterpret_cast(unsigned*, cq + params.cq_off.head);
+            m_cqTail = OFreinterpret_cast(unsigned*, cq + params.cq_off.tail);
+            m_cqMask = OFreinterpret_cast(unsigned*, cq + params.cq_off.ring_mask);
+            m_cqes = OFreinterpret_cast(struct io_uring_cqe*, cq + params.cq_off.cqes);
+            return true;
+        }
+
+        void destroy()
+        {
+            if (m_sqes != NULL) {
+                munmap(m_sqes, m_sqesSize);
+            }
+            if (m_cqRing != NULL && m_cqRing != m_sqRing) {
+                munmap(m_cqRing, m_cqRingSize);
+            }
+            if (m_sqRing != NULL) {
+                munmap(m_sqRing, m_sqRingSize);
+            }
+            if (m_fd >= 0) {
+                ::close(m_fd);
+            }
+            m_fd = -1;
+            m_sqRing = m_cqRing = NULL;
+            m_sqes = NULL;
+        }
+
+        // true if the kernel supports all of the given operations
+        bool supports(const __u8* opcodes, size_t count)
+        {
+            const size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+            std::unique_ptr<char[]> buffer(new char[size]);
+            memset(buffer.get(), 0, size);
+            struct io_uring_probe* probe = OFreinterpret_cast(struct io_uring_probe*, buffer.get());
+            if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+                return false;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (opcodes[i] > probe->last_op || !(probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // lets READ_FIXED requests with buf_index 0 use the buffer without mapping it each time
+        bool registerBuffer(void* data, size_t length)
+        {
+            struct iovec iov;
+            iov.iov_base = data;
+            iov.iov_len = length;
+            return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+        }
+
+        // lets requests with IOSQE_FIXED_FILE and fd 0 use the file without looking it up each time
+        bool registerFile(int fd)
+        {
+            return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_FILES, &fd, 1) == 0;
+        }
+
+        // a cleared entry whose user_data is its position among the prepared ones
+        struct io_uring_sqe* next()
+        {
+            const unsigned index = (*m_sqTail + m_prepared) & *m_sqMask;
+            struct io_uring_sqe* sqe = &m_sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->user_data = m_prepared++;
+            m_sqArray[index] = index;
+            return sqe;
+        }
+
+        // submits the prepared entries with one system call and waits for their completions,
+        // whose results are stored by user_data. Returns 0 or a negative errno value
+        int run(int* results)
+        {
+            const unsigned count = m_prepared;
+            m_prepared = 0;
+            __atomic_store_n(m_sqTail, *m_sqTail + count, __ATOMIC_RELEASE);
+            unsigned toSubmit = count;
+            unsigned completed = 0;
+            while (true) {
+                unsigned head = *m_cqHead;
+                const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+                while (head != tail) {
+                    const struct io_uring_cqe* cqe = &m_cqes[head & *m_cqMask];
+                    if (cqe->user_data < count) {
+                        results[cqe->user_data] = cqe->res;
+                    }
+                    ++head;
+                    ++completed;
+                }
+                __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+                if (completed >= count && toSubmit == 0) {
+                    return 0;
+                }
+                const long entered = syscall(__NR_io_uring_enter, m_fd, toSubmit, count - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+                if (entered >= 0) {
+                    toSubmit -= std::min(toSubmit, OFstatic_cast(unsigned, entered));
+                }
+                // requests already submitted still refer to the buffers of the caller, so waiting for
+                // them is only given up if the ring itself is broken
+                else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    return -errno;
+                }
+            }
+        }
+
+    private:
+        void* map(size_t size, off_t offset)
+        {
+            void* result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+            return result == MAP_FAILED ? NULL : result;
+        }
+
+        int m_fd;
+        void* m_sqRing;
+        void* m_cqRing;
+        struct io_uring_sqe* m_sqes;
+        size_t m_sqRingSize;
+        size_t m_cqRingSize;
+        size_t m_sqesSize;
+        unsigned* m_sqTail;
+        unsigned* m_sqMask;
+        unsigned* m_sqArray;
+        unsigned* m_cqHead;
+        unsigned* m_cqTail;
+        unsigned* m_cqMask;
+        struct io_uring_cqe* m_cqes;
+        unsigned m_prepared;
+    };
+
+    // operations used by the connections
+    const __u8 requiredOperations[] = { IORING_OP_READV, IORING_OP_WRITEV, IORING_OP_READ_FIXED, IORING_OP_LINK_TIMEOUT };
+
+    // unencrypted connection reading and writing through a ring of its own, or through the
+    // socket calls of DcmTCPConnection if no ring can be created
+    class UringConnection : public DcmTCPConnection
+    {
+    public:
+        explicit UringConnection(DcmNativeSocketType openSocket)
+            : DcmTCPConnection(openSocket), m_buffer(new char[UringTransport::bufferSize]), m_begin(0), m_end(0),
+              m_ready(false), m_fixedBuffer(false), m_fixedFile(false),
+              m_receiveTimeout(dcmSocketReceiveTimeout.get()), m_sendTimeout(dcmSocketSendTimeout.get())
+        {
+            if (openSocket == DCMNET_INVALID_SOCKET) {
+                return;
+            }
+            if (!m_ring.create(UringTransport::ringEntries)) {
+                DCMNET_WARN("cannot create io_uring, association uses socket calls: " << strerror(errno));
+                return;
+            }
+            // registration fails where it is charged against a small RLIMIT_MEMLOCK, which only costs speed
+            m_fixedBuffer = m_ring.registerBuffer(m_buffer.get(), UringTransport::bufferSize);
+            m_fixedFile = m_ring.registerFile(openSocket);
+            m_ready = true;
+        }
+
+        virtual ~UringConnection()
+        {
+            close();
+        }
+
+        virtual ssize_t read(void* buf, size_t nbyte)
+        {
+            if (!m_ready) {
+                return DcmTCPConnection::read(buf, nbyte);
+            }
+            if (m_begin == m_end) {
+                if (nbyte >= UringTransport::bufferSize) {
+                    return receive(buf, nbyte, false);
+                }
+                const ssize_t received = receive(m_buffer.get(), UringTransport::bufferSize, m_fixedBuffer);
+                if (received <= 0) {
+                    return received;
+                }
+                m_begin = 0;
+                m_end = OFstatic_cast(size_t, received);
+            }
+            const size_t count = std::min(nbyte, m_end - m_begin);
+            memcpy(buf, m_buffer.get() + m_begin, count);
+            m_begin += count;
+            return OFstatic_cast(ssize_t, count);
+        }
+
+        virtual ssize_t write(void* buf, size_t nbyte)
+        {
+            DcmTransportBlock block = { buf, nbyte };
+            return writeBlocks(&block, 1);
+        }
+
+        virtual ssize_t writeBlocks(const DcmTransportBlock* blocks, size_t count)
+        {
+            struct iovec iov[16];
+            if (!m_ready || count == 0 || count > sizeof(iov) / sizeof(iov[0])) {
+                return DcmTCPConnection::writeBlocks(blocks, count);
+            }
+            size_t remaining = 0;
+            for (size_t i = 0; i < count; ++i) {
+                iov[i].iov_base = OFconst_cast(void*, blocks[i].data);
+                iov[i].iov_len = blocks[i].length;
+                remaining += blocks[i].length;
+            }
+            // a send may be short, continue behind the last byte written
+            struct iovec* next = iov;
+            unsigned nextCount = OFstatic_cast(unsigned, count);
+            ssize_t result = 0;
+            while (remaining > 0) {
+                struct io_uring_sqe* sqe = prepare(IORING_OP_WRITEV);
+                sqe->addr = OFreinterpret_cast(__u64, next);
+                sqe->len = nextCount;
+                const ssize_t written = complete(sqe, m_sendTimeout);
+                if (written == -1 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    return result > 0 ? result : written;
+                }
+                countBytesSent(OFstatic_cast(size_t, written));
+                result += written;
+                remaining -= OFstatic_cast(size_t, written);
+                size_t skip = OFstatic_cast(size_t, written);
+                while (nextCount > 0 && skip >= next->iov_len) {
+                    skip -= next->iov_len;
+                    ++next;
+                    --nextCount;
+                }
+                if (nextCount > 0) {
+                    next->iov_base = OFstatic_cast(char*, next->iov_base) + skip;
+                    next->iov_len -= skip;
+                }
+            }
+            return result;
+        }
+
+        virtual void close()
+        {
+            // the socket is registered with the ring, which goes first
+            m_ring.destroy();
+            m_ready = false;
+            m_begin = m_end = 0;
+            DcmTCPConnection::close();
+        }
+
+        virtual OFBool networkDataAvailable(int timeout)
+        {
+            // data read ahead is not visible on the socket
+            if (m_begin != m_end) {
+                return OFTrue;
+            }
+            return DcmTCPConnection::networkDataAvailable(timeout);
+        }
+
+        virtual OFBool isTransparentConnection()
+        {
+            // polling the socket alone misses data read ahead
+            return m_ready ? OFFalse : OFTrue;
+        }
+
+        virtual OFString& dumpConnectionParameters(OFString& str)
+        {
+            if (!m_ready) {
+                return DcmTCPConnection::dumpConnectionParameters(str);
+            }
+            str = "Transport connection: TCP/IP through io_uring, unencrypted.";
+            return str;
+        }
+
+    private:
+        // an entry for the socket
+        struct io_uring_sqe* prepare(__u8 opcode)
+        {
+            struct io_uring_sqe* sqe = m_ring.next();
+            sqe->opcode = opcode;
+            if (m_fixedFile) {
+                sqe->fd = 0;
+                sqe->flags |= IOSQE_FIXED_FILE;
+            }
+            else {
+                sqe->fd = getSocket();
+            }
+            return sqe;
+        }
+
+        // reads into the registered buffer or any other one
+        ssize_t receive(void* data, size_t length, bool fixed)
+        {
+            struct iovec iov;
+            iov.iov_base = data;
+            iov.iov_len = length;
+            struct io_uring_sqe* sqe = prepare(fixed ? IORING_OP_READ_FIXED : IORING_OP_READV);
+            if (fixed) {
+                sqe->addr = OFreinterpret_cast(__u64, data);
+                sqe->len = OFstatic_cast(__u32, length);
+                sqe->buf_index = 0;
+            }
+            else {
+                sqe->addr = OFreinterpret_cast(__u64, &iov);
+                sqe->len = 1;
+            }
+            const ssize_t received = complete(sqe, m_receiveTimeout);
+            if (received > 0) {
+                countBytesReceived(OFstatic_cast(size_t, received));
+            }
+            return received;
+        }
+
+        // submits the transfer in sqe with a linked timeout of the given seconds, 0 waits forever.
+        // Fails with errno EAGAIN on timeout, like a socket call with SO_RCVTIMEO or SO_SNDTIMEO
+        ssize_t complete(struct io_uring_sqe* sqe, Sint32 timeout)
+        {
+            struct __kernel_timespec ts;
+            if (timeout > 0) {
+                sqe->flags |= IOSQE_IO_LINK;
+                ts.tv_sec = timeout;
+                ts.tv_nsec = 0;
+                struct io_uring_sqe* timer = m_ring.next();
+                timer->opcode = IORING_OP_LINK_TIMEOUT;
+                timer->fd = -1;
+                timer->addr = OFreinterpret_cast(__u64, &ts);
+                timer->len = 1;
+            }
+            int results[2] = { 0, 0 };
+            const int error = m_ring.run(results);
+            if (error < 0) {
+                errno = -error;
+                return -1;
+            }
+            if (results[0] >= 0) {
+                return results[0];
+            }
+            errno = results[0] == -ECANCELED ? EAGAIN : -results[0];
+            return -1;
+        }
+
+        Ring m_ring;
+        std::unique_ptr<char[]> m_buffer;
+        size_t m_begin;
+        size_t m_end;
+        bool m_ready;
+        bool m_fixedBuffer;
+        bool m_fixedFile;
+        Sint32 m_receiveTimeout;
+        Sint32 m_sendTimeout;
+    };
+
+    class UringTransportLayer : public DcmTransportLayer
+    {
+    public:
+        virtual DcmTransportConnection* createConnection(DcmNativeSocketType openSocket, OFBool useSecureLayer)
+        {
+            if (useSecureLayer) {
+                return DcmTransportLayer::createConnection(openSocket, useSecureLayer);
+            }
+            return new UringConnection(openSocket);
+        }
+    };
+
+}
+
+bool UringTransport::isAvailable()
+{
+    static const bool available = []() {
+        Ring ring;
+        return ring.create(ringEntries) && ring.supports(requiredOperations, sizeof(requiredOperations));
+    }();
+    return available;
+}
+
+DcmTransportLayer* UringTransport::layer()
+{
+    if (!isAvailable()) {
+        return NULL;
+    }
+    // shared by all networks for the life of the process
+    static UringTransportLayer shared;
+    return &shared;
+}
+
+#else
+
+bool UringTransport::isAvailable()
+{
+    return false;
+}
+
+DcmTransportLayer* UringTransport::layer()
+{
+    return NULL;
+}
+
+#endif
+
+OFCondition UringTransport::apply(T_ASC_Network* net, const ns::sNetworkOptions& network)
+{
+    if (!network.ioUring || network.tls) {
+        return EC_Normal;
+    }
+    DcmTransportLayer* tlayer = layer();
+    if (tlayer == NULL) {
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true)) {
+#ifdef WITH_IO_URING
+            DCMNET_WARN("io_uring not permitted by the kernel, associations use socket calls");
+#else
+            DCMNET_WARN("io_uring not available in this build, rebuild with --CDDCMTK_IO_URING=ON on Linux");
+#endif
+        }
+        return EC_Normal;
+    }
+    return ASC_setTransportLayer(net, tlayer, 0 /* shared, not owned by the network */);
+}
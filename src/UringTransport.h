@@ -0,0 +1,33 @@
+#pragma once
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/assoc.h"
+
+#include "Utils.h"
+
+// Linux io_uring for the reads and writes of unencrypted associations. Each connection has a small
+// ring of its own with its socket and a read-ahead buffer registered, so a PDU header, its body and
+// often the next PDU arrive with one system call instead of one read() each, and the blocks of a
+// PDU are written with one vectored request. A receive or send timeout is a linked timeout request
+// submitted together with the transfer. Connections fall back to plain socket calls where the kernel
+// or a seccomp profile refuses rings.
+class UringTransport
+{
+public:
+    // true if the addon is built with io_uring support and the kernel creates rings
+    static bool isAvailable();
+
+    // the shared layer for unencrypted connections, NULL if io_uring is not available
+    static DcmTransportLayer* layer();
+
+    // lets the associations accepted or requested over net read and write through io_uring if
+    // network.ioUring is set and network.tls is not, plain sockets are kept with a warning if
+    // io_uring is not available
+    static OFCondition apply(T_ASC_Network* net, const ns::sNetworkOptions& network);
+
+    // bytes of the read-ahead buffer of each connection, larger reads go to the caller directly
+    static const size_t bufferSize = 65536;
+
+    // submission queue entries of each ring, a transfer and its timeout take two
+    static const unsigned ringEntries = 4;
+};
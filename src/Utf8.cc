@@ -0,0 +1,54 @@
+#include "Utf8.h"
+
+// SSE2 is part of every x86-64 CPU and NEON of every AArch64 CPU
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define UTF8_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define UTF8_NEON
+#include <arm_neon.h>
+#endif
+
+size_t Utf8::asciiLength(const char* value, size_t length)
+{
+    size_t i = 0;
+#if defined(UTF8_SSE2)
+    for (; i + 16 <= length; i += 16) {
+        // the sign bits are set for bytes from 0x80
+        const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(value + i)));
+        if (mask != 0) {
+            for (int bit = 0; !(mask & (1 << bit)); ++bit) {
+                ++i;
+            }
+            return i;
+        }
+    }
+#elif defined(UTF8_NEON)
+    for (; i + 16 <= length; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(value + i))) >= 0x80) {
+            break;
+        }
+    }
+#endif
+    while (i < length && static_cast<unsigned char>(value[i]) < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+void Utf8::appendLatin1(std::string& out, const char* value, size_t length)
+{
+    size_t i = 0;
+    while (i < length) {
+        // ASCII runs are copied as a whole
+        const size_t ascii = asciiLength(value + i, length - i);
+        out.append(value + i, ascii);
+        i += ascii;
+        // U+0080 to U+00FF are 0xC2 or 0xC3 followed by the low six bits
+        for (; i < length && static_cast<unsigned char>(value[i]) >= 0x80; ++i) {
+            const unsigned char ch = static_cast<unsigned char>(value[i]);
+            out.push_back(static_cast<char>(0xc0 | ch >> 6));
+            out.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Conversion of attribute values to UTF-8. Query results and indexed attributes are mostly plain
+// ASCII, which is detected 16 bytes at a time and passed on as it is. Of ISO_IR 100 (Latin-1) text
+// only the runs of bytes from 0x80 are expanded to two byte sequences.
+class Utf8
+{
+public:
+    // number of leading ASCII bytes of value
+    static size_t asciiLength(const char* value, size_t length);
+
+    static bool isAscii(const char* value, size_t length) { return asciiLength(value, length) == length; }
+
+    // appends Latin-1 text as UTF-8
+    static void appendLatin1(std::string& out, const char* value, size_t length);
+};
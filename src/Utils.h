@@ -4,9 +4,17 @@
 #include <sstream>
 #include <memory>
 #include <list>
+#include <map>
+#include <vector>
 #include <iomanip>
+#include <algorithm>
+#include <mutex>
 
 #include "json.h"
+#include "Utf8.h"
+#include "Metrics.h"
+#include "base64.h"
+#include "GpuCodec.h"
 using json = nlohmann::json;
 
 #include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
@@ -16,9 +24,14 @@ using json = nlohmann::json;
 #include "dcmtk/ofstd/ofcond.h"    /* for class OFCondition */
 #include "dcmtk/dcmdata/dcxfer.h"  /* for E_TransferSyntax */
 #include "dcmtk/dcmnet/dimse.h"    /* for T_DIMSE_BlockingMode */
+#include "dcmtk/dcmdata/dcuid.h"   /* for dcmIsImageStorageSOPClassUID */
+#include "dcmtk/dcmdata/dcostrmz.h" /* for dcmZlibCompressionLevel */
+#include "dcmtk/dcmdata/dcostrmf.h" /* for dcmLargeFileWriteSize */
 
 #include "dcmtk/dcmjpeg/djdecode.h"     /* for dcmjpeg decoders */
 #include "dcmtk/dcmjpeg/djencode.h"     /* for dcmjpeg encoders */
+#include "dcmtk/dcmjpeg/djrplol.h"      /* for DJ_RPLossless */
+#include "dcmtk/dcmjpeg/djrploss.h"     /* for DJ_RPLossy */
 #include "dcmtk/dcmdata/dcrledrg.h"     /* for DcmRLEDecoderRegistration */
 #include "dcmtk/dcmdata/dcrleerg.h"     /* for DcmRLEEncoderRegistration */
 #include "dcmtk/dcmjpls/djdecode.h"     /* for dcmjpls decoder */
@@ -37,6 +50,44 @@ namespace ns {
 
     typedef std::list<DicomElement> DicomObject;
 
+    // attributes of one query response without a heap node per element: the tags in one array
+    // and the values back to back in one string, value i ends at m_ends[i]
+    class DicomResponse
+    {
+    public:
+        void reserve(size_t elements) {
+            m_tags.reserve(elements);
+            m_ends.reserve(elements);
+        }
+
+        // appends a value, with latin1 set bytes from 0x80 are converted to UTF-8
+        void add(const DcmTagKey& tag, const char* value, size_t length, bool latin1) {
+            if (latin1) {
+                Utf8::appendLatin1(m_values, value, length);
+            }
+            else {
+                m_values.append(value, length);
+            }
+            m_tags.push_back(tag);
+            m_ends.push_back(static_cast<Uint32>(m_values.size()));
+        }
+
+        size_t size() const { return m_tags.size(); }
+
+        const DcmTagKey& tag(size_t i) const { return m_tags[i]; }
+
+        const char* value(size_t i) const { return m_values.data() + begin(i); }
+
+        size_t length(size_t i) const { return m_ends[i] - begin(i); }
+
+    private:
+        size_t begin(size_t i) const { return i == 0 ? 0 : m_ends[i - 1]; }
+
+        std::vector<DcmTagKey> m_tags;
+        std::vector<Uint32> m_ends;
+        std::string m_values;
+    };
+
      // a simple struct to model a person
     struct sTag {
         std::string key;
@@ -66,13 +117,133 @@ namespace ns {
         std::string aet;
         std::string ip;
         int port;
-        inline bool valid() {
+        std::string compression;    // transfer policy for the peer: "compressed", "uncompressed" or "auto"
+        std::string priority;       // C-GET/C-MOVE sub-operations of the peer: "high", "medium" or "low", empty for the request's
+        inline bool valid() const {
             return !aet.empty() && !ip.empty() && port > 0;
         } 
     };
 
+    // DIMSE priority of "high", "medium" or "low", anything else is the default
+    inline T_DIMSE_Priority dimsePriority(const std::string& priority, T_DIMSE_Priority defaultPriority = DIMSE_PRIORITY_MEDIUM) {
+        if (priority == "high") return DIMSE_PRIORITY_HIGH;
+        if (priority == "medium") return DIMSE_PRIORITY_MEDIUM;
+        if (priority == "low") return DIMSE_PRIORITY_LOW;
+        return defaultPriority;
+    }
+
+    // storeScp: instances whose calling AE title, Modality and SOP Class UID match are forwarded to
+    // destination, empty values match all
+    struct sForwardRule {
+        std::string callingAet;
+        std::string modality;
+        std::string sopClass;
+        sIdent destination;
+        std::string format;         // "classic" splits enhanced CT, MR and PET images into single frame images for the destination
+    };
+
+    // storeScp: accepts or rejects associations and instances, the first rule whose conditions all match
+    // decides. Conditions left out match any, values may contain * and ? wildcards
+    struct sStoreRule {
+        std::string callingAet;
+        std::string calledAet;
+        std::string callingHost;
+        std::string sopClass;
+        std::vector<sTag> tags;     // attributes of the instance, their values separated by backslashes
+        std::string action;         // "accept" (default) or "reject"
+        std::string storagePath;    // accepted instances are stored below it instead of the storage path of the SCP
+    };
+
+    // prefetch: the studies of patientId matching tags are queried from peer and moved
+    struct sPrefetchJob {
+        std::string patientId;
+        std::vector<sTag> tags;
+        sIdent peer;                // the target of the request if not valid
+        std::string priority;       // "high", "medium" (default) or "low"
+    };
+
+    // anonymize: what is done to the attribute tag ("GGGGEEEE") wherever it occurs, action is "remove",
+    // "empty", "replace" with value or "remapUID"
+    struct sAnonymizeRule {
+        std::string tag;
+        std::string action;
+        std::string value;
+    };
+
+    // PDU size and socket options of the associations of a request, unset values keep the dcmnet defaults
+    struct sNetworkOptions {
+        sNetworkOptions() : maxPdu(0), socketBufferSize(-1), tcpNoDelay(-1), tcpKeepAlive(0), tcpKeepAliveInterval(0), acseTimeout(0), dimseTimeout(-1), tls(false), tlsVerifyPeer(-1), ioUring(false) {}
+        int maxPdu;             // bytes, 0 for ASC_DEFAULTMAXPDU
+        int socketBufferSize;   // SO_SNDBUF/SO_RCVBUF in bytes, -1 for TCP_BUFFER_LENGTH or the system default
+        int tcpNoDelay;         // 1 disables the Nagle algorithm, -1 for TCP_NODELAY or the build default
+        int tcpKeepAlive;       // s without traffic before keepalive probes, 0 disables them
+        int tcpKeepAliveInterval;   // s between the probes, 0 for defaultKeepAliveInterval
+        int acseTimeout;        // s to wait for association negotiation and release, 0 for defaultAcseTimeout
+        int dimseTimeout;       // s to wait for each DIMSE message, 0 waits forever, -1 for the default of the request
+        bool tls;               // DICOM over TLS, see TlsTransport
+        std::string tlsCertificate;     // PEM certificate chain, required to accept TLS associations
+        std::string tlsPrivateKey;      // PEM private key, defaults to tlsCertificate
+        std::string tlsCaCertificates;  // PEM file or hashed directory of trusted CAs, the system store if empty
+        std::string tlsCiphers;         // OpenSSL cipher list for TLS 1.2, AES-GCM first if empty
+        int tlsVerifyPeer;      // 0 accepts any peer certificate, verified otherwise
+        std::string tlsServerName;      // host name or address the acceptor's certificate must match, also sent as SNI
+        bool ioUring;           // reads and writes of unencrypted associations through io_uring, see UringTransport
+        // timeouts used unless set, SCPs wait forever for DIMSE messages by default
+        static const int defaultAcseTimeout = 30;
+        static const int defaultDimseTimeout = 60;
+        static const int defaultKeepAliveInterval = 15;
+        // unanswered keepalive probes before a peer is given up
+        static const int keepAliveProbes = 4;
+        inline int keepAliveIntervalSeconds() const {
+            return tcpKeepAliveInterval > 0 ? tcpKeepAliveInterval : defaultKeepAliveInterval;
+        }
+        inline int acseTimeoutSeconds() const {
+            return acseTimeout > 0 ? acseTimeout : defaultAcseTimeout;
+        }
+        inline int dimseTimeoutSeconds(int defaultTimeout = defaultDimseTimeout) const {
+            return dimseTimeout >= 0 ? dimseTimeout : defaultTimeout;
+        }
+        // DIMSE timeouts only apply in non-blocking mode
+        inline T_DIMSE_BlockingMode dimseBlockMode(int defaultTimeout = defaultDimseTimeout) const {
+            return dimseTimeoutSeconds(defaultTimeout) > 0 ? DIMSE_NONBLOCKING : DIMSE_BLOCKING;
+        }
+        // dcmnet rejects PDUs outside ASC_MINIMUMPDUSIZE..ASC_MAXIMUMPDUSIZE
+        inline Uint32 maxReceivePDU() const {
+            if (maxPdu <= 0) {
+                return ASC_DEFAULTMAXPDU;
+            }
+            if (maxPdu < ASC_MINIMUMPDUSIZE) {
+                return ASC_MINIMUMPDUSIZE;
+            }
+            return OFstatic_cast(Uint32, maxPdu > ASC_MAXIMUMPDUSIZE ? ASC_MAXIMUMPDUSIZE : maxPdu);
+        }
+    };
+
+    // storeScp: limits of the associations of each calling AE title or IP, 0 is no limit, see RateLimiter
+    struct sRateLimit {
+        sRateLimit() : associationsPerSecond(0), burst(0), concurrentAssociations(0), bytesPerSecond(0) {}
+        int associationsPerSecond;  // refill of the token bucket new associations take a token of
+        int burst;                  // size of that bucket, associationsPerSecond if 0
+        int concurrentAssociations;
+        int bytesPerSecond;         // sent by C-MOVE sub-operations
+        inline bool enabled() const {
+            return associationsPerSecond > 0 || concurrentAssociations > 0 || bytesPerSecond > 0;
+        }
+    };
+
+    // storeScp: PRAGMAs of the SQLite index connections of the process, see DcmSQLiteTuning
+    struct sIndexTuning {
+        sIndexTuning() : cacheSize(0), mmapSize(0), pageSize(0) {}
+        int cacheSize;              // MB per connection
+        int mmapSize;               // MB per index file
+        int pageSize;               // bytes, for new indexes
+        std::string journalMode;
+        std::string synchronous;
+        std::string tempStore;
+    };
+
     struct sInput {
-        sInput() : verbose(false), permissive(false), storeOnly(false), writeFile(true), lossyQuality(80), enableRecompression(false) {}
+        sInput() : verbose(false), permissive(false), storeOnly(false), writeFile(true), binaryBuffer(false), nativeResult(false), lossyQuality(80), maxAssociations(0), ingestBatchSize(0), ingestMaxDelay(0), indexShards(0), associationIdleTimeout(0), parallelism(0), j2kThreads(-1), j2kLayers(-1), restartRows(0), extendedOffsetTable(-1), largeObjectSize(-1), directWriteSize(-1), compressionCpuBudget(-1), clusterHeartbeat(-1), forwardAssociations(0), peerAssociations(0), transcodeCacheSize(0), compressThreads(0), storageCacheSize(0), tierAfterDays(0), fileMapCacheSize(0), bufferPoolSize(0), maxInFlightSize(0), maxInFlightMessages(0), moveAssociations(0), moveReadAhead(-1), findReadAhead(-1), prioritySlots(0), asyncOperations(0), writeThreads(0), storageShardDigits(0), eventLoopThreads(-1), poolThreads(0), poolQueueSize(0), eventBatchSize(0), eventFlushInterval(0), seriesQuietPeriod(0), chunkSize(0), maxResults(0), pageSize(0), cacheTtl(0), findCacheSize(0), deadline(0), rate(0), duration(0), maxRequests(0), patients(0), studiesPerPatient(0), seriesPerStudy(0), instancesPerSeries(0), seed(0), frame(0), reduce(0), offset(0), length(-1), width(0), height(0), enableRecompression(false), reuseAssociation(false), streamToFile(false), compact(false), arenaAllocation(false), pixelData(false), skipDuplicates(false), linkDuplicates(false), packSeries(false), proxySpill(false), seriesEventsOnly(false), seriesMetadata(false), pixelHashes(false), pixelStats(false), worklist(false), storageCommitment(false), warmStart(false), removePrivateTags(false) {}
         sIdent source;
         sIdent target;
         std::string storagePath;
@@ -82,14 +253,224 @@ namespace ns {
         std::string netTransferPropose;
         std::string writeTransfer;
         std::string charset;
+        std::string ingestDurability;
+        std::string writeDurability;
+        // storeOnly: what a C-STORE gets past the in-flight budget, "delay" (default) or "refuse"
+        std::string inFlightPolicy;
+        // storeOnly: when a series is complete, "release" (default) once its associations ended or it was
+        // quiet for seriesQuietPeriod, "quiet" only once it was quiet
+        std::string seriesComplete;
+        // "sqlite" (default) or "postgresql", indexConnection is the libpq connection string of the latter
+        std::string indexBackend;
+        std::string indexConnection;
+        // getBulkDataRange: top level attribute ("GGGGEEEE") whose value is read, the pixel data by default
+        std::string bulkDataTag;
+        // "local" (default) or "s3", storageUrl is <scheme>://<host>[:<port>]/<bucket>[/<prefix>] of the latter
+        std::string storageBackend;
+        std::string storageUrl;
+        std::string storageRegion;
+        std::string storageAccessKey;
+        std::string storageSecretKey;
+        // name of this SCP in the cluster sharing its index, clusterHost its address for the other nodes
+        std::string clusterNode;
+        std::string clusterHost;
+        // order of C-MOVE sub-operations: "location" (default), "instance" or "database"
+        std::string moveOrder;
+        // "high", "medium" (default) or "low": DIMSE priority of the C-STORE, C-GET and C-MOVE requests,
+        // also orders the requests queued for their operation
+        std::string priority;
+        std::string transcodeCachePath;
+        // queryIndex: continuation token of the previous page
+        std::string pageToken;
+        // watchIndex: changeToken of an earlier result to continue after, empty follows the changes from now on
+        std::string changeToken;
+        std::string manifestPath;
+        // cold tier of storagePath, files of studies idle for tierAfterDays days are migrated to it
+        std::string coldPath;
+        // parseFile: stop reading at this attribute ("GGGGEEEE"), it is not included
+        std::string stopAtTag;
+        // parseFile: prefix of the BulkDataURI written instead of binary values, the tag is appended
+        std::string bulkDataURI;
+        // renderFrame: "raw" (default), "jpeg" or "png", exportStudy: "zip" (default) or "tar",
+        // convertMultiframe: "classic" (default) or "enhanced"
+        std::string format;
+        // getScu: "disk" (default) or "memory" to hand received instances to JS as buffers
+        std::string storageMode;
+        // createDicomdir: application profile of the media, "general" (default), "dvd-jpeg", "dvd-j2k",
+        // "usb-jpeg", "usb-j2k", "bd-jpeg", "bd-j2k" or "mime"
+        std::string profile;
+        // createDicomdir: File-set ID of the DICOMDIR, up to 16 characters
+        std::string fileSetId;
         std::vector<sTag> tags;
+        // findScuBatch: the attributes of each query
+        std::vector<std::vector<sTag> > queries;
         std::vector<sIdent> peers;
+        std::vector<sForwardRule> forwardRules;
+        std::vector<sStoreRule> storeRules;
+        std::vector<sPrefetchJob> jobs;
+        // anonymize: the profile applied, the default profile if empty
+        std::vector<sAnonymizeRule> anonymizeRules;
+        // anonymize: prefix of the UIDs generated by remapUID, and a JSON file of the UIDs remapped by
+        // earlier requests that the new ones are added to
+        std::string uidRoot;
+        std::string uidMapPath;
+        // storeScp: queue of the forwarded instances, defaults to <storagePath>/.forward
+        std::string forwardQueuePath;
+        // storeScp: destinations each received instance is relayed to as it arrives
+        std::vector<sIdent> proxyDestinations;
+        // attributes ("GGGGEEEE") included in storage events
+        std::vector<std::string> eventTags;
+        // parseFile: top level attributes ("GGGGEEEE") to output, all if empty
+        std::vector<std::string> includeTags;
+        // parseDirectory: further files or directories to parse, buildPyramid: the instances of the series
+        std::vector<std::string> sourcePaths;
+        // storeScu: DICOM files or datasets in memory, sent instead of the files below sourcePath
+        std::vector<std::string> datasets;
+        // storeScu, importJson: DICOM JSON texts, each a dataset or an array of them
+        std::vector<std::string> jsonDatasets;
+        // storeScu, importJson: bytes of the BulkDataURIs of jsonDatasets
+        std::map<std::string, std::string> bulkData;
+        // generateDatasets: modalities of the generated studies, all known ones if empty
+        std::vector<std::string> modalities;
+        // getScu: transfer syntaxes proposed for the storage sub-operations before the uncompressed ones
+        std::vector<std::string> storageTransferSyntaxes;
+        // decodeFrame: [left, top, width, height] of the decoded region, the whole frame if empty
+        std::vector<int> region;
+        // renderFrame: frames rendered for each file, only frame if empty
+        std::vector<int> frames;
+        // renderFrame: [center, width] of the VOI window, the first window of the image or min/max if empty
+        std::vector<double> window;
+        sNetworkOptions network;
+        sRateLimit aeLimits;
+        sRateLimit ipLimits;
+        sIndexTuning indexTuning;
         int lossyQuality;
+        int maxAssociations;
+        int ingestBatchSize;
+        int ingestMaxDelay;
+        // SQLite files a new index is split into by StudyInstanceUID, 0 or 1 for a single image.db
+        int indexShards;
+        int associationIdleTimeout;
+        int parallelism;
+        int j2kThreads;
+        // quality layers of the JPEG 2000 code-streams written, 1 for a single layer
+        int j2kLayers;
+        // packet order of the JPEG 2000 code-streams written: lrcp, rlcp, rpcl, pcrl or cprl
+        std::string j2kProgression;
+        // image rows per restart interval of lossless JPEG images, 0 for none
+        int restartRows;
+        // 1 to write the Extended Offset Table when compressing multi-frame images, -1 keeps the current setting
+        int extendedOffsetTable;
+        // MB from which written files are preallocated and written in large blocks, and with direct I/O,
+        // 0 disables it, negative values keep the current setting
+        int largeObjectSize;
+        int directWriteSize;
+        // cores the transfer policy may spend compressing for slow links, -1 keeps the current setting
+        int compressionCpuBudget;
+        int clusterHeartbeat;
+        // storeScp: associations per forwarding destination
+        int forwardAssociations;
+        // prefetch: queries and moves running on each peer at a time
+        int peerAssociations;
+        int transcodeCacheSize;
+        // threads converting received files to writeTransfer after the C-STORE response, 0 converts before it
+        int compressThreads;
+        // MB of local files kept for an object storage backend, 0 keeps all
+        int storageCacheSize;
+        // tier: days without stores or retrievals before a study moves to coldPath
+        int tierAfterDays;
+        int fileMapCacheSize;
+        int bufferPoolSize;
+        // storeOnly: MB and storage events on their way to JS before C-STOREs are held back, 0 is no limit
+        int maxInFlightSize;
+        int maxInFlightMessages;
+        int moveAssociations;
+        // most files read ahead of the one being sent by serial C-MOVE sub-operations, 0 disables it
+        int moveReadAhead;
+        // most C-FIND responses read from the index ahead of the one being sent, 0 disables it
+        int findReadAhead;
+        // C-GET/C-MOVE sub-operations, files read ahead and background compressions running at a time
+        // in the process, shared by priority class, 0 (default) is no limit
+        int prioritySlots;
+        // outstanding C-STORE operations per association, 1 or less waits for each response
+        int asyncOperations;
+        int writeThreads;
+        int storageShardDigits;
+        int eventLoopThreads;
+        int poolThreads;
+        int poolQueueSize;
+        int eventBatchSize;
+        int eventFlushInterval;
+        // storeOnly: ms without instances after which a series is complete, 0 sends no SERIES_COMPLETE events
+        int seriesQuietPeriod;
+        int chunkSize;
+        // C-FIND responses accepted before a C-CANCEL is sent, 0 accepts all
+        int maxResults;
+        // queryIndex: matches per page, 0 returns all
+        int pageSize;
+        // ms an identical earlier C-FIND result is reused, 0 always queries the peer
+        int cacheTtl;
+        // C-FIND results kept in the cache, 0 keeps the current limit
+        int findCacheSize;
+        // findScuFederated: ms until the merged responses are returned without the peers still running, 0 waits for all
+        int deadline;
+        // loadTest: C-STORE requests per second over all associations, 0 sends as fast as the peer responds
+        int rate;
+        // loadTest: seconds the test runs
+        int duration;
+        // loadTest: C-STORE requests sent at most, 0 is no limit
+        int maxRequests;
+        // generateDatasets: the hierarchy generated, 0 draws the counts from the distribution of the modality
+        int patients;
+        int studiesPerPatient;
+        int seriesPerStudy;
+        int instancesPerSeries;
+        int seed;
+        int frame;
+        int reduce;
+        // getBulkDataRange: first byte and number of bytes of the value, the rest of it if negative
+        long long offset;
+        long long length;
+        int width;
+        int height;
         bool verbose;
         bool permissive;
         bool storeOnly;
         bool writeFile;
+        bool binaryBuffer;
+        bool nativeResult;
         bool enableRecompression;
+        bool reuseAssociation;
+        bool streamToFile;
+        bool compact;
+        bool arenaAllocation;
+        // generateDatasets: include pixel data in the written files
+        bool pixelData;
+        // scp: acknowledge instances already in the index without writing them again
+        bool skipDuplicates;
+        // scp: replace stored files identical to a recently stored one by hard links to it
+        bool linkDuplicates;
+        // scp: append the instances of a series to one pack file instead of a file each
+        bool packSeries;
+        // storeScp: queue instances a proxy destination fails to take instead of refusing them
+        bool proxySpill;
+        // storeOnly: send SERIES_COMPLETE events only, no FILE_STORAGE event per instance
+        bool seriesEventsOnly;
+        // scp: keep the metadata of each series next to the index for retrieveMetadata()
+        bool seriesMetadata;
+        // scp: record the CRC-32C of the pixel data of each stored instance in the index for verify()
+        bool pixelHashes;
+        // scp: record the range, histogram and window preset of the pixel values of each stored
+        // grayscale instance in the index for retrievePixelStats()
+        bool pixelStats;
+        // scp: answer Modality Worklist queries from the items upserted from JS
+        bool worklist;
+        // scp: accept Storage Commitment requests and send their reports to the peers
+        bool storageCommitment;
+        // scp: snapshot the hot studies when stopped and warm the caches from it when started
+        bool warmStart;
+        // anonymize: remove all private attributes
+        bool removePrivateTags;
         inline bool valid() {
             return source.valid() && target.valid();
         }
@@ -105,6 +486,48 @@ namespace ns {
         return "";
     }
 
+    inline std::vector<std::string> toStringList(const json& in, const std::string& key) {
+        std::vector<std::string> list;
+        try {
+            auto items = in.at(key);
+            for (json::iterator it = items.begin(); it != items.end(); ++it) {
+                list.push_back((*it).get<std::string>());
+            }
+        }
+        catch(json::exception&) {
+            // no error log on purpose
+        }
+        return list;
+    }
+
+    inline std::vector<int> toIntList(const json& in, const std::string& key) {
+        std::vector<int> list;
+        try {
+            auto items = in.at(key);
+            for (json::iterator it = items.begin(); it != items.end(); ++it) {
+                list.push_back((*it).get<int>());
+            }
+        }
+        catch(json::exception&) {
+            // no error log on purpose
+        }
+        return list;
+    }
+
+    inline std::vector<double> toDoubleList(const json& in, const std::string& key) {
+        std::vector<double> list;
+        try {
+            auto items = in.at(key);
+            for (json::iterator it = items.begin(); it != items.end(); ++it) {
+                list.push_back((*it).get<double>());
+            }
+        }
+        catch(json::exception&) {
+            // no error log on purpose
+        }
+        return list;
+    }
+
     inline int toInt(const json& in, const std::string& key) {
         try {
             return in.at(key).get<int>();
@@ -123,22 +546,179 @@ namespace ns {
         return -1;
     }
 
+    // as toInt for offsets and lengths beyond 2 GB
+    inline long long toInt64(const json& in, const std::string& key) {
+        try {
+            return in.at(key).get<long long>();
+        }
+        catch(json::exception&) {
+            // no error log on purpose
+        }
+        // try again from string
+        try {
+            return std::stoll(in.at(key).get<std::string>());
+        }
+        catch(json::exception&) {
+            // no error log on purpose
+        }
+        // fail
+        return -1;
+    }
 
-    static bool codecsRegistered = false;
 
-    static void registerCodecs() {
-        if (!codecsRegistered) {
+    // registers all codecs and freezes the data dictionary once per process, called by the module Init.
+    // The codec parameters registered here only hold defaults, every call applies its own settings
+    // with applyCodecSettings() and passes its representation parameters to chooseRepresentation()
+    inline void registerCodecs() {
+        static std::once_flag registered;
+        std::call_once(registered, []() {
+            // first, so the GPU decoders are chosen over the CPU ones where available
+            GpuCodec::registerCodecs();
             DcmRLEDecoderRegistration::registerCodecs();
             DJDecoderRegistration::registerCodecs();
             DJLSDecoderRegistration::registerCodecs();
             FMJPEG2KDecoderRegistration::registerCodecs();
-            
+
             DJEncoderRegistration::registerCodecs();
             DJLSEncoderRegistration::registerCodecs();
             DcmRLEEncoderRegistration::registerCodecs();
             FMJPEG2KEncoderRegistration::registerCodecs();
-            codecsRegistered = true;
+            // the dictionary is never modified afterwards, parallel parsers then look up tags without locking
+            dcmDataDict.freeze();
+            Metrics::enableCodecTiming();
+        });
+    }
+
+    // OpenJPEG threads per JPEG 2000 frame for all registered codecs, negative values keep the current setting
+    static void setJ2KThreads(int threads) {
+        if (threads >= 0) {
+            FMJPEG2KDecoderRegistration::setNumThreads(static_cast<Uint16>(threads));
+            FMJPEG2KEncoderRegistration::setNumThreads(static_cast<Uint16>(threads));
+        }
+    }
+
+    // quality layers and packet order of the JPEG 2000 code-streams written by the registered
+    // encoders, a negative number of layers or an empty order keeps the current one
+    inline void setJ2KProgression(int layers, const std::string& order) {
+        static std::mutex mutex;
+        static int currentLayers = 1;
+        static J2K_ProgressionOrder currentOrder = EJ2KPO_default;
+        if (layers < 0 && order.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (layers >= 0) {
+            currentLayers = std::max(layers, 1);
+        }
+        if (!order.empty()) {
+            static const char* const names[] = { "lrcp", "rlcp", "rpcl", "pcrl", "cprl" };
+            static const J2K_ProgressionOrder orders[] = { EJ2KPO_LRCP, EJ2KPO_RLCP, EJ2KPO_RPCL, EJ2KPO_PCRL, EJ2KPO_CPRL };
+            std::string name(order);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            const size_t count = sizeof(names) / sizeof(names[0]);
+            size_t i = 0;
+            while (i < count && name != names[i]) {
+                ++i;
+            }
+            if (i < count) {
+                currentOrder = orders[i];
+            }
+            else {
+                DCMNET_WARN("unknown JPEG 2000 progression order " << order << ", keeping the current one");
+            }
+        }
+        FMJPEG2KEncoderRegistration::setProgression(static_cast<Uint16>(currentLayers), currentOrder);
+    }
+
+    // threads coding the frames of a multi-frame image in parallel for the JPEG-LS and RLE codecs
+    // and the true lossless JPEG encoder, decoding the restart intervals of a lossless JPEG frame
+    // and coding the segments of a single RLE frame. The codecs are registered once for the process,
+    // it is set for all of them by setFrameThreads() of the addon
+    static void setFrameThreads(Uint16 threads) {
+        DJLSDecoderRegistration::setNumThreads(threads);
+        DJLSEncoderRegistration::setNumThreads(threads);
+        DJEncoderRegistration::setNumThreads(threads);
+        DJDecoderRegistration::setNumThreads(threads);
+        GpuCodec::setNumThreads(threads);
+        DcmRLEDecoderRegistration::setNumThreads(threads);
+        DcmRLEEncoderRegistration::setNumThreads(threads);
+    }
+
+    // offset tables written by all encoders for multi-frame images: 1 for the Extended Offset Table,
+    // 0 for the Basic Offset Table, negative values keep the current setting
+    static void setExtendedOffsetTable(int extended) {
+        if (extended >= 0) {
+            dcmCreateExtendedOffsetTable.set(extended > 0);
+        }
+    }
+
+    // C-STORE requests and C-MOVE sub-operations send the data set of a file as stored when it has the
+    // negotiated transfer syntax, from the page cache to the socket. DCMTK reads the flag for every
+    // message sent, it is set for the whole process by setZeroCopySend() of the addon
+    static void setZeroCopySend(bool enabled) {
+        dcmSendFileDataUnchanged.set(enabled);
+    }
+
+    // zlib level of all data sets written or sent in Deflated Explicit VR Little Endian, 1 is fastest,
+    // 9 is smallest. DCMTK reads it for every deflated stream, it is set for the whole process
+    // by setDeflateLevel() of the addon
+    static void setDeflateLevel(int level) {
+#ifdef WITH_ZLIB
+        dcmZlibCompressionLevel.set(std::max(0, std::min(level, 9)));
+#else
+        (void)level;
+#endif
+    }
+
+    // files written from now on that are expected to have at least largeObjectSize MB are preallocated
+    // and written in 4 MB blocks, those of at least directWriteSize MB bypass the page cache as well.
+    // 0 disables either, negative values keep the current setting
+    static void setLargeFileWrites(int largeObjectSize, int directWriteSize) {
+        const int maxSize = 4095;
+        if (largeObjectSize >= 0) {
+            dcmLargeFileWriteSize.set(static_cast<Uint32>(std::min(largeObjectSize, maxSize)) * 1024 * 1024);
+        }
+        if (directWriteSize >= 0) {
+            dcmDirectFileWriteSize.set(static_cast<Uint32>(std::min(directWriteSize, maxSize)) * 1024 * 1024);
+        }
+    }
+
+    // codec settings of a call, negative values keep the settings of earlier calls
+    inline void applyCodecSettings(const sInput& in) {
+        setJ2KThreads(in.j2kThreads);
+        setJ2KProgression(in.j2kLayers, in.j2kProgression);
+        setExtendedOffsetTable(in.extendedOffsetTable);
+        setLargeFileWrites(in.largeObjectSize, in.directWriteSize);
+    }
+
+    // representation parameters of a call, created once and shared by all files the call encodes
+    struct sRepresentationParameters {
+        sRepresentationParameters(int quality, int restartRows) : lossless(6, 0, restartRows), lossy(quality) {}
+
+        // parameters for encoding to the given transfer syntax, NULL for the defaults of its codec
+        const DcmRepresentationParameter* get(E_TransferSyntax xfer) const {
+            if (xfer == EXS_JPEGProcess14SV1 || xfer == EXS_JPEGProcess14) {
+                return &lossless;
+            }
+            if (xfer == EXS_JPEGProcess1 || xfer == EXS_JPEGProcess2_4) {
+                return &lossy;
+            }
+            return NULL;
         }
+
+        DJ_RPLossless lossless;
+        DJ_RPLossy lossy;
+    };
+
+    // non-image storage SOP classes, e.g. structured reports, RT structure sets and encapsulated
+    // documents, shrink most with Deflated Explicit VR Little Endian, images are better served by their codecs
+    inline bool preferDeflate(const char* sopClassUID) {
+#ifdef WITH_ZLIB
+        return sopClassUID != NULL && dcmIsaStorageSOPClassUID(sopClassUID, ESSC_All) && !dcmIsImageStorageSOPClassUID(sopClassUID);
+#else
+        (void)sopClassUID;
+        return false;
+#endif
     }
 
     inline void to_json(json& j, const sTag& p) {
@@ -150,6 +730,22 @@ namespace ns {
         p.value = toString(j, "value");
     }
 
+    inline void from_json(const json& j, sRateLimit& p) {
+        p.associationsPerSecond = toInt(j, "associationsPerSecond");
+        p.burst = toInt(j, "burst");
+        p.concurrentAssociations = toInt(j, "concurrentAssociations");
+        p.bytesPerSecond = toInt(j, "bytesPerSecond");
+    }
+
+    inline void from_json(const json& j, sIndexTuning& p) {
+        p.cacheSize = toInt(j, "cacheSize");
+        p.mmapSize = toInt(j, "mmapSize");
+        p.pageSize = toInt(j, "pageSize");
+        p.journalMode = toString(j, "journalMode");
+        p.synchronous = toString(j, "synchronous");
+        p.tempStore = toString(j, "tempStore");
+    }
+
     inline void to_json(json& j, const sIdent& p) {
         j = json{{"aet", p.aet}, {"ip", p.ip}, {"port", p.port}};
     }
@@ -158,6 +754,8 @@ namespace ns {
         p.aet = toString(j, "aet");
         p.ip = toString(j, "ip");
         p.port = toInt(j, "port");
+        p.compression = toString(j, "compression");
+        p.priority = toString(j, "priority");
     }
 
 
@@ -170,13 +768,46 @@ namespace ns {
         try {
             in.target = j.at("target").get<sIdent>();
         } catch(...) {}
+        try {
+            in.aeLimits = j.at("aeLimits").get<sRateLimit>();
+        } catch(...) {}
+        try {
+            in.ipLimits = j.at("ipLimits").get<sRateLimit>();
+        } catch(...) {}
+        try {
+            in.indexTuning = j.at("indexTuning").get<sIndexTuning>();
+        } catch(...) {}
         in.destination = toString(j, "destination");
         in.storagePath = toString(j, "storagePath");
         in.sourcePath = toString(j, "sourcePath");
         in.netTransferPrefer = toString(j, "netTransferPrefer");
         in.netTransferPropose = toString(j, "netTransferPropose");
         in.writeTransfer = toString(j, "writeTransfer");
+        in.bulkDataTag = toString(j, "tag");
         in.charset = toString(j, "charset");
+        in.pageToken = toString(j, "pageToken");
+        in.changeToken = toString(j, "changeToken");
+        in.ingestDurability = toString(j, "ingestDurability");
+        in.writeDurability = toString(j, "writeDurability");
+        in.inFlightPolicy = toString(j, "inFlightPolicy");
+        in.seriesComplete = toString(j, "seriesComplete");
+        in.indexBackend = toString(j, "indexBackend");
+        in.indexConnection = toString(j, "indexConnection");
+        in.storageBackend = toString(j, "storageBackend");
+        in.storageUrl = toString(j, "storageUrl");
+        in.storageRegion = toString(j, "storageRegion");
+        in.storageAccessKey = toString(j, "storageAccessKey");
+        in.storageSecretKey = toString(j, "storageSecretKey");
+        in.clusterNode = toString(j, "clusterNode");
+        in.clusterHost = toString(j, "clusterHost");
+        in.moveOrder = toString(j, "moveOrder");
+        in.priority = toString(j, "priority");
+        in.stopAtTag = toString(j, "stopAtTag");
+        in.bulkDataURI = toString(j, "bulkDataURI");
+        in.format = toString(j, "format");
+        in.storageMode = toString(j, "storageMode");
+        in.profile = toString(j, "profile");
+        in.fileSetId = toString(j, "fileSetId");
         try {
             auto tags = j.at("tags");
             for (json::iterator it = tags.begin(); it != tags.end(); ++it) {
@@ -184,6 +815,12 @@ namespace ns {
                 in.tags.push_back(tag);
             }
         } catch(...) {}
+        try {
+            auto queries = j.at("queries");
+            for (json::iterator it = queries.begin(); it != queries.end(); ++it) {
+                in.queries.push_back((*it).get<std::vector<sTag> >());
+            }
+        } catch(...) {}
         try {
             auto tags = j.at("peers");
             for (json::iterator it = tags.begin(); it != tags.end(); ++it) {
@@ -191,6 +828,92 @@ namespace ns {
                 in.peers.push_back(peer);
             }
         } catch(...) {}
+        try {
+            auto rules = j.at("forwardRules");
+            for (json::iterator it = rules.begin(); it != rules.end(); ++it) {
+                sForwardRule rule;
+                rule.callingAet = toString(*it, "callingAet");
+                rule.modality = toString(*it, "modality");
+                rule.sopClass = toString(*it, "sopClass");
+                rule.destination = (*it).at("destination").get<sIdent>();
+                rule.format = toString(*it, "format");
+                in.forwardRules.push_back(rule);
+            }
+        } catch(...) {}
+        try {
+            auto rules = j.at("storeRules");
+            for (json::iterator it = rules.begin(); it != rules.end(); ++it) {
+                sStoreRule rule;
+                rule.callingAet = toString(*it, "callingAet");
+                rule.calledAet = toString(*it, "calledAet");
+                rule.callingHost = toString(*it, "callingHost");
+                rule.sopClass = toString(*it, "sopClass");
+                try {
+                    rule.tags = (*it).at("tags").get<std::vector<sTag> >();
+                } catch(...) {}
+                rule.action = toString(*it, "action");
+                rule.storagePath = toString(*it, "storagePath");
+                in.storeRules.push_back(rule);
+            }
+        } catch(...) {}
+        try {
+            auto jobs = j.at("jobs");
+            for (json::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+                sPrefetchJob job;
+                job.patientId = toString(*it, "patientId");
+                try {
+                    job.tags = (*it).at("tags").get<std::vector<sTag> >();
+                } catch(...) {}
+                try {
+                    job.peer = (*it).at("peer").get<sIdent>();
+                } catch(...) {}
+                job.priority = toString(*it, "priority");
+                in.jobs.push_back(job);
+            }
+        } catch(...) {}
+        try {
+            auto rules = j.at("rules");
+            for (json::iterator it = rules.begin(); it != rules.end(); ++it) {
+                sAnonymizeRule rule;
+                rule.tag = toString(*it, "tag");
+                rule.action = toString(*it, "action");
+                rule.value = toString(*it, "value");
+                in.anonymizeRules.push_back(rule);
+            }
+        } catch(...) {}
+        in.uidRoot = toString(j, "uidRoot");
+        in.uidMapPath = toString(j, "uidMapPath");
+        try {
+            auto destinations = j.at("proxyDestinations");
+            for (json::iterator it = destinations.begin(); it != destinations.end(); ++it) {
+                in.proxyDestinations.push_back((*it).get<sIdent>());
+            }
+        } catch(...) {}
+        in.eventTags = toStringList(j, "eventTags");
+        in.includeTags = toStringList(j, "includeTags");
+        in.sourcePaths = toStringList(j, "sourcePaths");
+        // JSON text carries the datasets base64 encoded
+        for (const std::string& encoded : toStringList(j, "datasets")) {
+            try {
+                in.datasets.push_back(base64_decode(encoded));
+            }
+            catch (...) {
+                // kept so that it is reported as invalid with its index
+                in.datasets.push_back(std::string());
+            }
+        }
+        in.jsonDatasets = toStringList(j, "jsonDatasets");
+        try {
+            auto bulkData = j.at("bulkData");
+            for (json::iterator it = bulkData.begin(); it != bulkData.end(); ++it) {
+                in.bulkData[it.key()] = base64_decode(it.value().get<std::string>());
+            }
+        } catch(...) {}
+        in.modalities = toStringList(j, "modalities");
+        in.storageTransferSyntaxes = toStringList(j, "storageTransferSyntaxes");
+        in.region = toIntList(j, "region");
+        in.frames = toIntList(j, "frames");
+        in.window = toDoubleList(j, "window");
         try {
             in.permissive = j.at("permissive");
         } catch(...) {}
@@ -204,6 +927,78 @@ namespace ns {
             in.writeFile = j.at("writeFile");
         }
         catch (...) {}
+        try {
+            in.binaryBuffer = j.at("binaryBuffer");
+        }
+        catch (...) {}
+        try {
+            in.streamToFile = j.at("streamToFile");
+        }
+        catch (...) {}
+        try {
+            in.compact = j.at("compact");
+        }
+        catch (...) {}
+        try {
+            in.arenaAllocation = j.at("arenaAllocation");
+        }
+        catch (...) {}
+        try {
+            in.pixelData = j.at("pixelData");
+        }
+        catch (...) {}
+        try {
+            in.skipDuplicates = j.at("skipDuplicates");
+        }
+        catch (...) {}
+        try {
+            in.linkDuplicates = j.at("linkDuplicates");
+        }
+        catch (...) {}
+        try {
+            in.packSeries = j.at("packSeries");
+        }
+        catch (...) {}
+        try {
+            in.proxySpill = j.at("proxySpill");
+        }
+        catch (...) {}
+        try {
+            in.seriesEventsOnly = j.at("seriesEventsOnly");
+        }
+        catch (...) {}
+        try {
+            in.seriesMetadata = j.at("seriesMetadata");
+        }
+        catch (...) {}
+        try {
+            in.pixelHashes = j.at("pixelHashes");
+        }
+        catch (...) {}
+        try {
+            in.pixelStats = j.at("pixelStats");
+        }
+        catch (...) {}
+        try {
+            in.worklist = j.at("worklist");
+        }
+        catch (...) {}
+        try {
+            in.storageCommitment = j.at("storageCommitment");
+        }
+        catch (...) {}
+        try {
+            in.warmStart = j.at("warmStart");
+        }
+        catch (...) {}
+        try {
+            in.removePrivateTags = j.at("removePrivateTags");
+        }
+        catch (...) {}
+        try {
+            in.nativeResult = j.at("nativeResult");
+        }
+        catch (...) {}
         try {
             in.enableRecompression = j.at("enableRecompression");
         }
@@ -212,6 +1007,290 @@ namespace ns {
             in.lossyQuality = toInt(j, "lossyQuality");
         }
         catch (...) {}
+        try {
+            in.maxAssociations = toInt(j, "maxAssociations");
+        }
+        catch (...) {}
+        try {
+            in.ingestBatchSize = toInt(j, "ingestBatchSize");
+        }
+        catch (...) {}
+        try {
+            in.ingestMaxDelay = toInt(j, "ingestMaxDelay");
+        }
+        catch (...) {}
+        try {
+            in.indexShards = toInt(j, "indexShards");
+        }
+        catch (...) {}
+        try {
+            in.reuseAssociation = j.at("reuseAssociation");
+        }
+        catch (...) {}
+        try {
+            in.associationIdleTimeout = toInt(j, "associationIdleTimeout");
+        }
+        catch (...) {}
+        try {
+            in.parallelism = toInt(j, "parallelism");
+        }
+        catch (...) {}
+        try {
+            in.j2kThreads = toInt(j, "j2kThreads");
+        }
+        catch (...) {}
+        try {
+            in.j2kLayers = toInt(j, "j2kLayers");
+        }
+        catch (...) {}
+        in.j2kProgression = toString(j, "j2kProgression");
+        try {
+            in.restartRows = toInt(j, "restartRows");
+        }
+        catch (...) {}
+        try {
+            in.extendedOffsetTable = j.at("extendedOffsetTable").get<bool>() ? 1 : 0;
+        }
+        catch (...) {}
+        try {
+            in.largeObjectSize = toInt(j, "largeObjectSize");
+        }
+        catch (...) {}
+        try {
+            in.directWriteSize = toInt(j, "directWriteSize");
+        }
+        catch (...) {}
+        try {
+            in.compressionCpuBudget = toInt(j, "compressionCpuBudget");
+            in.clusterHeartbeat = toInt(j, "clusterHeartbeat");
+        }
+        catch (...) {}
+        try {
+            in.transcodeCacheSize = toInt(j, "transcodeCacheSize");
+        }
+        catch (...) {}
+        try {
+            in.transcodeCachePath = toString(j, "transcodeCachePath");
+        }
+        catch (...) {}
+        try {
+            in.compressThreads = toInt(j, "compressThreads");
+        }
+        catch (...) {}
+        try {
+            in.storageCacheSize = toInt(j, "storageCacheSize");
+        }
+        catch (...) {}
+        try {
+            in.tierAfterDays = toInt(j, "tierAfterDays");
+        }
+        catch (...) {}
+        try {
+            in.coldPath = toString(j, "coldPath");
+        }
+        catch (...) {}
+        try {
+            in.fileMapCacheSize = toInt(j, "fileMapCacheSize");
+        }
+        catch (...) {}
+        try {
+            in.bufferPoolSize = toInt(j, "bufferPoolSize");
+        }
+        catch (...) {}
+        try {
+            in.maxInFlightSize = toInt(j, "maxInFlightSize");
+            in.maxInFlightMessages = toInt(j, "maxInFlightMessages");
+        }
+        catch (...) {}
+        try {
+            in.manifestPath = toString(j, "manifestPath");
+        }
+        catch (...) {}
+        try {
+            in.moveAssociations = toInt(j, "moveAssociations");
+        }
+        catch (...) {}
+        try {
+            in.forwardQueuePath = toString(j, "forwardQueuePath");
+            in.forwardAssociations = toInt(j, "forwardAssociations");
+        }
+        catch (...) {}
+        try {
+            in.peerAssociations = toInt(j, "peerAssociations");
+        }
+        catch (...) {}
+        try {
+            in.moveReadAhead = toInt(j, "moveReadAhead");
+        }
+        catch (...) {}
+        try {
+            in.findReadAhead = toInt(j, "findReadAhead");
+        }
+        catch (...) {}
+        try {
+            in.prioritySlots = toInt(j, "prioritySlots");
+        }
+        catch (...) {}
+        try {
+            in.asyncOperations = toInt(j, "asyncOperations");
+        }
+        catch (...) {}
+        try {
+            in.writeThreads = toInt(j, "writeThreads");
+        }
+        catch (...) {}
+        try {
+            in.storageShardDigits = toInt(j, "storageShardDigits");
+        }
+        catch (...) {}
+        try {
+            in.eventLoopThreads = toInt(j, "eventLoopThreads");
+        }
+        catch (...) {}
+        try {
+            in.poolThreads = toInt(j, "poolThreads");
+        }
+        catch (...) {}
+        try {
+            in.poolQueueSize = toInt(j, "poolQueueSize");
+        }
+        catch (...) {}
+        try {
+            in.eventBatchSize = toInt(j, "eventBatchSize");
+        }
+        catch (...) {}
+        try {
+            in.eventFlushInterval = toInt(j, "eventFlushInterval");
+        }
+        catch (...) {}
+        try {
+            in.seriesQuietPeriod = toInt(j, "seriesQuietPeriod");
+        }
+        catch (...) {}
+        try {
+            in.chunkSize = toInt(j, "chunkSize");
+        }
+        catch (...) {}
+        try {
+            in.maxResults = toInt(j, "maxResults");
+        }
+        catch (...) {}
+        try {
+            in.pageSize = toInt(j, "pageSize");
+        }
+        catch (...) {}
+        try {
+            in.cacheTtl = toInt(j, "cacheTtl");
+        }
+        catch (...) {}
+        try {
+            in.findCacheSize = toInt(j, "findCacheSize");
+        }
+        catch (...) {}
+        try {
+            in.deadline = toInt(j, "deadline");
+        }
+        catch (...) {}
+        try {
+            in.rate = toInt(j, "rate");
+        }
+        catch (...) {}
+        try {
+            in.duration = toInt(j, "duration");
+        }
+        catch (...) {}
+        try {
+            in.maxRequests = toInt(j, "maxRequests");
+        }
+        catch (...) {}
+        try {
+            in.patients = toInt(j, "patients");
+        }
+        catch (...) {}
+        try {
+            in.studiesPerPatient = toInt(j, "studiesPerPatient");
+        }
+        catch (...) {}
+        try {
+            in.seriesPerStudy = toInt(j, "seriesPerStudy");
+        }
+        catch (...) {}
+        try {
+            in.instancesPerSeries = toInt(j, "instancesPerSeries");
+        }
+        catch (...) {}
+        try {
+            in.seed = toInt(j, "seed");
+        }
+        catch (...) {}
+        try {
+            in.frame = toInt(j, "frame");
+        }
+        catch (...) {}
+        try {
+            in.reduce = toInt(j, "reduce");
+        }
+        catch (...) {}
+        try {
+            in.offset = toInt64(j, "offset");
+        }
+        catch (...) {}
+        try {
+            in.length = toInt64(j, "length");
+        }
+        catch (...) {}
+        try {
+            in.width = toInt(j, "width");
+        }
+        catch (...) {}
+        try {
+            in.height = toInt(j, "height");
+        }
+        catch (...) {}
+        try {
+            in.network.maxPdu = toInt(j, "maxPdu");
+        }
+        catch (...) {}
+        try {
+            in.network.socketBufferSize = toInt(j, "socketBufferSize");
+        }
+        catch (...) {}
+        try {
+            in.network.tcpNoDelay = j.at("tcpNoDelay").get<bool>() ? 1 : 0;
+        }
+        catch (...) {}
+        try {
+            in.network.tcpKeepAlive = toInt(j, "tcpKeepAlive");
+        }
+        catch (...) {}
+        try {
+            in.network.tcpKeepAliveInterval = toInt(j, "tcpKeepAliveInterval");
+        }
+        catch (...) {}
+        try {
+            in.network.acseTimeout = toInt(j, "acseTimeout");
+        }
+        catch (...) {}
+        try {
+            in.network.dimseTimeout = j.at("dimseTimeout").get<int>();
+        }
+        catch (...) {}
+        try {
+            in.network.tls = j.at("tls").get<bool>();
+        }
+        catch (...) {}
+        in.network.tlsCertificate = toString(j, "tlsCertificate");
+        in.network.tlsPrivateKey = toString(j, "tlsPrivateKey");
+        in.network.tlsCaCertificates = toString(j, "tlsCaCertificates");
+        in.network.tlsCiphers = toString(j, "tlsCiphers");
+        try {
+            in.network.tlsVerifyPeer = j.at("tlsVerifyPeer").get<bool>() ? 1 : 0;
+        }
+        catch (...) {}
+        try {
+            in.network.ioUring = j.at("ioUring").get<bool>();
+        }
+        catch (...) {}
         return in;
     }
 
@@ -222,8 +1301,9 @@ namespace ns {
         FAILURE = 2
     };
  
-    inline std::string createJsonResponse(eStatus status, const std::string& message, const json& j = {}) {
-    std::string meaning = "success";
+    // the container is taken by value, so callers can move large results into the response
+    inline json createResponse(eStatus status, const std::string& message, json j = {}) {
+        std::string meaning = "success";
         if (status == PENDING) {
             meaning = "pending";
         }
@@ -231,11 +1311,32 @@ namespace ns {
             meaning = "failure";
         }
         json v = json::object();
-        v["container"] = j;
+        v["container"] = std::move(j);
         v["message"] = message;
         v["code"] = (int)status;
         v["status"] = meaning;
-        return v.dump(-1, ' ', true, nlohmann::detail::error_handler_t::replace);
+        return v;
+    }
+
+    // sub-operation counters of a C-MOVE response, elapsed in ms since the request and the
+    // throughput of the finished (completed, failed or warning) sub-operations
+    inline json moveProgress(unsigned int remaining, unsigned int completed, unsigned int failed, unsigned int warning, double seconds) {
+        json v = json::object();
+        v["remaining"] = remaining;
+        v["completed"] = completed;
+        v["failed"] = failed;
+        v["warning"] = warning;
+        v["elapsed"] = static_cast<long long>(seconds * 1000);
+        v["instancesPerSecond"] = seconds > 0 ? (completed + failed + warning) / seconds : 0.0;
+        return v;
+    }
+
+    inline std::string dumpResponse(const json& response) {
+        return response.dump(-1, ' ', true, nlohmann::detail::error_handler_t::replace);
+    }
+
+    inline std::string createJsonResponse(eStatus status, const std::string& message, json j = {}) {
+        return dumpResponse(createResponse(status, message, std::move(j)));
     }
 
 } // namespace ns
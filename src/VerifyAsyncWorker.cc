@@ -0,0 +1,262 @@
+#include "VerifyAsyncWorker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "json.h"
+#include "Utils.h"
+#include "PixelHash.h"
+#include "StorageBackend.h"
+#include "StorageTier.h"
+#include "dcmsqldb.h"
+
+using json = nlohmann::json;
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
+
+namespace
+{
+
+struct sHashItem {
+    sHashItem() : ok(false), skipped(false) {}
+    std::string file;
+    std::string sopInstanceUID;
+    // recorded at ingest, empty when only hashing
+    std::string expected;
+    std::string hash;
+    std::string error;
+    bool ok;
+    // on the cold tier, which may have recompressed it
+    bool skipped;
+};
+
+// the items hashed by the pool, drained by the request thread
+class HashedQueue
+{
+public:
+    explicit HashedQueue(size_t producers) : running(producers) {}
+
+    void push(const sHashItem& item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.push_back(item);
+        changed.notify_one();
+    }
+
+    void finished()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --running;
+        changed.notify_one();
+    }
+
+    // waits up to timeout for items, false once all producers finished and everything is drained
+    bool drain(std::vector<sHashItem>& drained, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait_for(lock, timeout, [this] { return !items.empty() || running == 0; });
+        drained.swap(items);
+        items.clear();
+        return !drained.empty() || running > 0;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<sHashItem> items;
+    size_t running;
+};
+
+void hash(sHashItem& item, bool indexed)
+{
+    if (indexed) {
+        const std::string container = DcmQueryRetrievePackFile::container(item.file.c_str()).c_str();
+        if (StorageTier::isCold(container)) {
+            item.skipped = true;
+            return;
+        }
+        if (!StorageArea::fetch(container, item.error)) {
+            return;
+        }
+    }
+    std::string sopInstanceUID;
+    item.ok = PixelHash::ofFile(item.file, sopInstanceUID, item.hash, item.error);
+    if (item.sopInstanceUID.empty()) {
+        item.sopInstanceUID = sopInstanceUID;
+    }
+}
+
+}
+
+VerifyAsyncWorker::VerifyAsyncWorker(std::string data, Function &callback) : BaseAsyncWorker(data, callback)
+{
+}
+
+void VerifyAsyncWorker::Execute(const ExecutionProgress& progress)
+{
+    ns::sInput in = GetInput();
+    EnableVerboseLogging(in.verbose);
+
+    // with a storage path the indexed instances are verified, otherwise the source files hashed
+    const bool indexed = !in.storagePath.empty();
+    std::vector<sHashItem> items;
+    if (indexed) {
+        if (!OFStandard::dirExists(in.storagePath.c_str())) {
+            SetErrorJson("Specified storage path does not exist: " + in.storagePath);
+            return;
+        }
+        DcmSQLiteDatabase::configureShards(in.indexShards > 0 ? in.indexShards : 1);
+        DcmIndexDatabase* db = DcmIndexDatabasePool::acquireReader(in.storagePath.c_str());
+        if (db == NULL || !db->isInitialized()) {
+            DcmIndexDatabasePool::release(db);
+            SetErrorJson("Cannot open the index of " + in.storagePath);
+            return;
+        }
+        const std::map<std::string, std::string> hashes = db->pixelHashes();
+        std::vector<std::string> uids;
+        for (const auto& h : hashes) {
+            uids.push_back(h.first);
+        }
+        // instances deleted since they were hashed are not in the index anymore
+        const std::map<std::string, std::string> files = db->instanceFiles(uids);
+        DcmIndexDatabasePool::release(db);
+        for (const auto& f : files) {
+            sHashItem item;
+            item.sopInstanceUID = f.first;
+            item.file = f.second;
+            item.expected = hashes.at(f.first);
+            items.push_back(item);
+        }
+        if (items.empty()) {
+            SetErrorJson("No pixel hashes recorded in the index of " + in.storagePath);
+            return;
+        }
+    }
+    else {
+        if (in.sourcePath.empty()) {
+            SetErrorJson("No source or storage path set");
+            return;
+        }
+        OFList<OFFilename> fileNameList;
+        const OFFilename sourcePath(in.sourcePath.c_str());
+        if (OFStandard::dirExists(sourcePath)) {
+            OFStandard::searchDirectoryRecursively(sourcePath, fileNameList, OFFilename(), OFFilename(), OFTrue);
+        }
+        else if (OFStandard::fileExists(sourcePath)) {
+            fileNameList.push_back(sourcePath);
+        }
+        for (OFListIterator(OFFilename) iter = fileNameList.begin(); iter != fileNameList.end(); ++iter) {
+            sHashItem item;
+            item.file = iter->getCharPointer();
+            items.push_back(item);
+        }
+        if (items.empty()) {
+            SetErrorJson("Invalid source path set, no DICOM files found");
+            return;
+        }
+    }
+
+    const size_t threads = std::min(items.size(),
+        in.parallelism > 0 ? static_cast<size_t>(in.parallelism) : std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    DCMNET_INFO((indexed ? "verifying " : "hashing ") << items.size() << " files using " << threads << " threads");
+
+    std::atomic<size_t> next(0);
+    HashedQueue hashed(threads);
+    std::vector<std::thread> hashers;
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    for (size_t i = 0; i < threads; ++i) {
+        hashers.push_back(std::thread([&]() {
+            OFLog::setThreadLogLevel(logLevel);
+            for (size_t n = next++; n < items.size() && !Cancelled(); n = next++) {
+                sHashItem item = items[n];
+                hash(item, indexed);
+                hashed.push(item);
+            }
+            hashed.finished();
+        }));
+    }
+
+    // mismatches and hashes are passed on as they come, progress at most once a second
+    size_t files = 0, ok = 0, mismatched = 0, skipped = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point reported = start;
+    std::vector<sHashItem> drained;
+    while (hashed.drain(drained, std::chrono::milliseconds(1000))) {
+        for (const sHashItem& item : drained) {
+            ++files;
+            if (item.skipped) {
+                ++skipped;
+                continue;
+            }
+            json v = json::object();
+            v["file"] = item.file;
+            v["sopInstanceUID"] = item.sopInstanceUID;
+            if (!item.ok) {
+                DCMNET_WARN("cannot hash the pixel data of " << item.file << ": " << item.error);
+                v["error"] = item.error;
+                SendResponse(ns::createResponse(ns::PENDING, indexed ? "VERIFY_FAILED" : "PIXEL_HASH_FAILED", v), progress);
+            }
+            else if (!indexed) {
+                ++ok;
+                v["hash"] = item.hash;
+                SendResponse(ns::createResponse(ns::PENDING, "PIXEL_HASH", v), progress);
+            }
+            else if (item.hash != item.expected) {
+                ++mismatched;
+                DCMNET_WARN("pixel data of " << item.file << " changed: hash " << item.hash << ", recorded " << item.expected);
+                v["expected"] = item.expected;
+                v["hash"] = item.hash;
+                SendResponse(ns::createResponse(ns::PENDING, "VERIFY_MISMATCH", v), progress);
+            }
+            else {
+                ++ok;
+            }
+        }
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (indexed && now - reported >= std::chrono::seconds(1)) {
+            reported = now;
+            json v = json::object();
+            v["instances"] = items.size();
+            v["checked"] = files;
+            v["mismatched"] = mismatched;
+            v["elapsed"] = std::chrono::duration<double>(now - start).count();
+            SendResponse(ns::createResponse(ns::PENDING, "VERIFY_PROGRESS", v), progress);
+        }
+    }
+    for (std::thread& hasher : hashers) {
+        hasher.join();
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const size_t failed = files - ok - mismatched - skipped;
+    DCMNET_INFO((indexed ? "verified " : "hashed ") << ok << " of " << files << " files in " << elapsed << " s");
+
+    if (Cancelled()) {
+        SetErrorJson("Request cancelled");
+        return;
+    }
+    json v = json::object();
+    if (indexed) {
+        v["instances"] = files;
+        v["verified"] = ok;
+        v["mismatched"] = mismatched;
+        v["failed"] = failed;
+        v["skipped"] = skipped;
+    }
+    else {
+        v["files"] = files;
+        v["hashed"] = ok;
+        v["failed"] = failed;
+    }
+    v["elapsed"] = elapsed;
+    v["filesPerSecond"] = elapsed > 0 ? static_cast<double>(files) / elapsed : 0;
+    _jsonOutput = NativeResult() ? v : json(v.dump());
+}
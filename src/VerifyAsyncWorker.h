@@ -0,0 +1,16 @@
+#pragma once
+
+#include "BaseAsyncWorker.h"
+
+using namespace Napi;
+
+// hashes the pixel data of DICOM files as stored on a pool of threads, see PixelHash: the instances
+// of the index of storagePath are rehashed and compared to the hashes recorded at ingest, or the
+// files below sourcePath are hashed and their hashes passed to JS
+class VerifyAsyncWorker : public BaseAsyncWorker
+{
+    public:
+        VerifyAsyncWorker(std::string data, Function &callback);
+
+        void Execute(const ExecutionProgress& progress);
+};
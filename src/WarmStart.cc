@@ -0,0 +1,256 @@
+#include "WarmStart.h"
+#include "Metrics.h"
+#include "SeriesMetadata.h"
+#include "dcmidxdb.h"
+#include "json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "dcmtk/config/osconfig.h" /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+    typedef std::unordered_map<std::string, unsigned long long> Counts;
+
+    // a thread warming the caches of a storage area
+    struct sRestore {
+        sRestore() : cancel(false) {}
+        std::thread thread;
+        std::atomic<bool> cancel;
+    };
+
+    std::mutex warmMutex;
+    std::map<std::string, Counts> counts;
+    std::map<std::string, std::shared_ptr<sRestore> > restores;
+
+    std::string snapshotFile(const std::string& storagePath)
+    {
+        return storagePath + "/.warm-start.json";
+    }
+
+    // the studies with the most accesses, most first, expects warmMutex to be locked
+    std::vector<std::pair<std::string, unsigned long long> > hottest(const Counts& studies, size_t limit)
+    {
+        std::vector<std::pair<std::string, unsigned long long> > result(studies.begin(), studies.end());
+        std::sort(result.begin(), result.end(), [](const std::pair<std::string, unsigned long long>& a,
+            const std::pair<std::string, unsigned long long>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        if (result.size() > limit) {
+            result.resize(limit);
+        }
+        return result;
+    }
+
+    // runs the image level query of a study and reads the metadata of its series, which brings their
+    // pages into the page caches. False if the study is not in the index
+    bool warmStudy(DcmIndexDatabase* db, const std::string& storagePath, const std::string& study)
+    {
+        std::list<DcmSmallDcmElm> request;
+        request.push_back(DcmSmallDcmElm(DCM_StudyInstanceUID, study));
+        for (const DB_FindAttrExt& attribute : DcmIndexDatabase::indexedAttributes()) {
+            if (attribute.tag != DCM_StudyInstanceUID && !DcmIndexDatabase::isAggregateAttribute(attribute.tag)) {
+                request.push_back(DcmSmallDcmElm(attribute.tag, ""));
+            }
+        }
+        DcmIndexFindCursor* cursor = db->openFind(request, IMAGE_LEVEL);
+        if (cursor == NULL) {
+            return false;
+        }
+        std::set<std::string> series;
+        std::list<DcmSmallDcmElm> row;
+        bool found = false;
+        while (cursor->next(row)) {
+            found = true;
+            for (const DcmSmallDcmElm& el : row) {
+                if (el.XTag() == DCM_SeriesInstanceUID) {
+                    series.insert(el.valueField());
+                }
+            }
+        }
+        delete cursor;
+        if (SeriesMetadata::isEnabled()) {
+            for (const std::string& uid : series) {
+                std::map<std::string, std::string> instances;
+                SeriesMetadata::read(storagePath, study, uid, instances);
+            }
+        }
+        return found;
+    }
+
+    void warm(const std::string& storagePath, const std::vector<std::string>& studies, const std::atomic<bool>& cancel)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DcmIndexDatabase* db = DcmIndexDatabasePool::acquireReader(OFFilename(storagePath.c_str()));
+        if (db == NULL || !db->isInitialized()) {
+            DcmIndexDatabasePool::release(db);
+            DCMNET_WARN("warm start: cannot open the index of " << storagePath);
+            return;
+        }
+        for (size_t s = 0; s < db->shardCount(); ++s) {
+            db->readAhead(s, WarmStart::readAheadBytes);
+        }
+        size_t warmed = 0;
+        for (const std::string& study : studies) {
+            if (cancel) {
+                break;
+            }
+            if (warmStudy(db, storagePath, study)) {
+                ++warmed;
+            }
+        }
+        DcmIndexDatabasePool::release(db);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Metrics::counter("warm_start_studies_total").add(warmed);
+        Metrics::histogram("warm_start_seconds").record(seconds);
+        DCMNET_INFO("warm start: " << warmed << " of " << studies.size() << " studies of " << storagePath
+            << " warmed in " << seconds << " s" << (cancel ? ", cancelled" : ""));
+    }
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+const size_t WarmStart::maxStudies;
+const size_t WarmStart::readAheadBytes;
+
+void WarmStart::record(const std::string& storagePath, const std::string& studyInstanceUID)
+{
+    if (studyInstanceUID.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(warmMutex);
+    Counts& studies = counts[storagePath];
+    ++studies[studyInstanceUID];
+    // bounded by keeping the hottest, the older accesses count half from then on so studies that
+    // turned cold give way
+    if (studies.size() > 4 * maxStudies) {
+        Counts kept;
+        for (const auto& study : hottest(studies, maxStudies)) {
+            kept[study.first] = (study.second + 1) / 2;
+        }
+        studies.swap(kept);
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool WarmStart::save(const std::string& storagePath, std::string& error)
+{
+    json snapshot = json::object();
+    snapshot["version"] = 1;
+    snapshot["saved"] = static_cast<long long>(time(NULL));
+    snapshot["studies"] = json::array();
+    {
+        std::lock_guard<std::mutex> lock(warmMutex);
+        for (const auto& study : hottest(counts[storagePath], maxStudies)) {
+            snapshot["studies"].push_back({{"uid", study.first}, {"hits", study.second}});
+        }
+    }
+
+    DcmIndexDatabase* db = DcmIndexDatabasePool::acquire(OFFilename(storagePath.c_str()));
+    if (db != NULL && db->isInitialized()) {
+        for (size_t s = 0; s < db->shardCount(); ++s) {
+            db->optimize(s);
+        }
+    }
+    DcmIndexDatabasePool::release(db);
+
+    // replaced atomically, a crash while writing leaves the previous snapshot
+    const std::string file = snapshotFile(storagePath);
+    const std::string temporary = file + ".tmp";
+    {
+        std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        out << snapshot.dump();
+        if (!out.flush()) {
+            error = "Cannot write " + temporary;
+            out.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), file.c_str()) != 0) {
+        error = "Cannot replace " + file;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void WarmStart::restore(const std::string& storagePath)
+{
+    stop(storagePath);
+
+    std::ifstream in(snapshotFile(storagePath).c_str(), std::ios::binary);
+    if (!in) {
+        DCMNET_DEBUG("warm start: no snapshot in " << storagePath);
+        return;
+    }
+    json snapshot = json::parse(in, nullptr, false);
+    if (snapshot.is_discarded() || !snapshot.is_object() || !snapshot.contains("studies") || !snapshot["studies"].is_array()) {
+        DCMNET_WARN("warm start: ignoring the invalid snapshot " << snapshotFile(storagePath));
+        return;
+    }
+
+    std::vector<std::string> studies;
+    std::shared_ptr<sRestore> restore = std::make_shared<sRestore>();
+    {
+        std::lock_guard<std::mutex> lock(warmMutex);
+        Counts& current = counts[storagePath];
+        for (const json& study : snapshot["studies"]) {
+            if (!study.is_object() || !study.contains("uid") || !study["uid"].is_string()) {
+                continue;
+            }
+            const std::string uid = study["uid"].get<std::string>();
+            studies.push_back(uid);
+            if (study.contains("hits") && study["hits"].is_number_unsigned()) {
+                current[uid] += (study["hits"].get<unsigned long long>() + 1) / 2;
+            }
+            if (studies.size() == maxStudies) {
+                break;
+            }
+        }
+        restores[storagePath] = restore;
+    }
+    DCMNET_INFO("warm start: warming the caches of " << storagePath << " for " << studies.size() << " studies");
+    sRestore* r = restore.get();
+    restore->thread = std::thread([storagePath, studies, r]() { warm(storagePath, studies, r->cancel); });
+}
+
+//--------------------------------------------------------------------------------------------
+
+void WarmStart::stop(const std::string& storagePath)
+{
+    std::shared_ptr<sRestore> restore;
+    {
+        std::lock_guard<std::mutex> lock(warmMutex);
+        std::map<std::string, std::shared_ptr<sRestore> >::iterator it = restores.find(storagePath);
+        if (it == restores.end()) {
+            return;
+        }
+        restore = it->second;
+        restores.erase(it);
+    }
+    restore->cancel = true;
+    if (restore->thread.joinable()) {
+        restore->thread.join();
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+// Warm restart of a query/retrieve SCP: its caches start cold after a deployment and the first
+// queries wait for the disk. While the SCP runs, the studies queried by StudyInstanceUID and
+// retrieved are counted per storage area. When the SCP is stopped, the hottest of them are written
+// to <storagePath>/.warm-start.json and the statistics of the query planner are refreshed; SQLite
+// keeps the statistics in the index for the next start. When the SCP starts again, a thread of its
+// own asks the system to read the index files into its page cache. It then runs the image level
+// query of each hot study, hottest first, and reads the series metadata of the study if it is
+// kept. All of this runs while the SCP already serves associations.
+class WarmStart
+{
+public:
+    // counts a query or retrieval of a study in storagePath
+    static void record(const std::string& storagePath, const std::string& studyInstanceUID);
+
+    // writes the maxStudies hottest studies of storagePath and refreshes the planner statistics of
+    // its index. False with error if the snapshot cannot be written
+    static bool save(const std::string& storagePath, std::string& error);
+
+    // reads the snapshot of storagePath, if there is one, and starts warming the caches from it.
+    // The counts of the snapshot carry over, halved, into the counts of the new run
+    static void restore(const std::string& storagePath);
+
+    // cancels warming the caches of storagePath and waits for it to end
+    static void stop(const std::string& storagePath);
+
+    // studies kept in a snapshot
+    static const size_t maxStudies = 1000;
+
+    // bytes of each index file read ahead
+    static const size_t readAheadBytes = 1024 * 1024 * 1024;
+};
@@ -0,0 +1,315 @@
+#include "Worklist.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+
+#include "Metrics.h"
+
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcelem.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+namespace
+{
+
+enum eMatching { MATCH_STRING, MATCH_NAME, MATCH_DATE, MATCH_TIME };
+
+struct sField {
+    const char* name;
+    DcmTagKey tag;
+    bool step;          // in the Scheduled Procedure Step Sequence
+    eMatching matching;
+};
+
+const sField fields[Worklist::FIELD_COUNT] = {
+    { "accessionNumber", DCM_AccessionNumber, false, MATCH_STRING },
+    { "patientName", DCM_PatientName, false, MATCH_NAME },
+    { "patientID", DCM_PatientID, false, MATCH_STRING },
+    { "patientBirthDate", DCM_PatientBirthDate, false, MATCH_DATE },
+    { "patientSex", DCM_PatientSex, false, MATCH_STRING },
+    { "studyInstanceUID", DCM_StudyInstanceUID, false, MATCH_STRING },
+    { "requestedProcedureID", DCM_RequestedProcedureID, false, MATCH_STRING },
+    { "requestedProcedureDescription", DCM_RequestedProcedureDescription, false, MATCH_STRING },
+    { "referringPhysicianName", DCM_ReferringPhysicianName, false, MATCH_NAME },
+    { "modality", DCM_Modality, true, MATCH_STRING },
+    { "scheduledStationAETitle", DCM_ScheduledStationAETitle, true, MATCH_STRING },
+    { "scheduledStationName", DCM_ScheduledStationName, true, MATCH_STRING },
+    { "scheduledProcedureStepStartDate", DCM_ScheduledProcedureStepStartDate, true, MATCH_DATE },
+    { "scheduledProcedureStepStartTime", DCM_ScheduledProcedureStepStartTime, true, MATCH_TIME },
+    { "scheduledPerformingPhysicianName", DCM_ScheduledPerformingPhysicianName, true, MATCH_NAME },
+    { "scheduledProcedureStepDescription", DCM_ScheduledProcedureStepDescription, true, MATCH_STRING },
+    { "scheduledProcedureStepID", DCM_ScheduledProcedureStepID, true, MATCH_STRING }
+};
+
+// fields looked up by value before the others are matched, the most selective first
+const Worklist::eField indexed[] = {
+    Worklist::SCHEDULED_STATION_AE_TITLE, Worklist::PATIENT_ID, Worklist::ACCESSION_NUMBER, Worklist::MODALITY
+};
+const size_t indexCount = sizeof(indexed) / sizeof(indexed[0]);
+
+typedef std::shared_ptr<const Worklist::Item> ItemPtr;
+
+struct sTable {
+    std::map<std::string, ItemPtr> items;   // by identity
+    std::unordered_map<std::string, std::vector<ItemPtr> > byValue[indexCount];
+    std::map<std::string, std::vector<ItemPtr> > byDate;
+};
+
+std::shared_ptr<const sTable> current = std::make_shared<sTable>();
+// upserts are serialized, readers load current atomically
+std::mutex writer;
+
+std::string identity(const Worklist::Item& item)
+{
+    return item[Worklist::ACCESSION_NUMBER] + "\\" + item[Worklist::STEP_ID];
+}
+
+// fills the indexes of a table from its items
+void index(sTable& table)
+{
+    for (const std::pair<const std::string, ItemPtr>& entry : table.items) {
+        const ItemPtr& item = entry.second;
+        for (size_t i = 0; i < indexCount; ++i) {
+            table.byValue[i][(*item)[indexed[i]]].push_back(item);
+        }
+        table.byDate[(*item)[Worklist::START_DATE]].push_back(item);
+    }
+}
+
+// swaps in the table, writer is held
+size_t publish(const std::shared_ptr<sTable>& table)
+{
+    index(*table);
+    std::atomic_store(&current, std::shared_ptr<const sTable>(table));
+    Metrics::gauge("worklist_items").set(static_cast<int64_t>(table->items.size()));
+    return table->items.size();
+}
+
+bool wildcardMatch(const char* pattern, const char* value, bool ignoreCase)
+{
+    const char* star = NULL;
+    const char* resume = NULL;
+    while (*value) {
+        const char p = *pattern;
+        if (p == '*') {
+            star = pattern++;
+            resume = value;
+        }
+        else if (p == '?' || (p != 0 && (ignoreCase ? std::tolower(static_cast<unsigned char>(p)) == std::tolower(static_cast<unsigned char>(*value)) : p == *value))) {
+            ++pattern;
+            ++value;
+        }
+        else if (star) {
+            pattern = star + 1;
+            value = ++resume;
+        }
+        else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        ++pattern;
+    }
+    return *pattern == 0;
+}
+
+// range matching of DA and TM values, bounds compared on their own length so 1200 includes 120030
+bool rangeMatch(const std::string& key, const std::string& value)
+{
+    const size_t dash = key.find('-');
+    const std::string low = dash == std::string::npos ? key : key.substr(0, dash);
+    const std::string high = dash == std::string::npos ? key : key.substr(dash + 1);
+    if (value.empty()) {
+        return false;
+    }
+    return (low.empty() || value.compare(0, low.size(), low) >= 0) && (high.empty() || value.compare(0, high.size(), high) <= 0);
+}
+
+bool matchesKey(const sField& field, const std::string& key, const std::string& value)
+{
+    // a list of values matches any of them
+    size_t begin = 0;
+    while (true) {
+        const size_t end = key.find('\\', begin);
+        const std::string single = key.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        if (field.matching == MATCH_DATE || field.matching == MATCH_TIME) {
+            if (rangeMatch(single, value)) {
+                return true;
+            }
+        }
+        else if (wildcardMatch(single.c_str(), value.c_str(), field.matching == MATCH_NAME)) {
+            return true;
+        }
+        if (end == std::string::npos) {
+            return false;
+        }
+        begin = end + 1;
+    }
+}
+
+bool isSingleValue(const std::string& key)
+{
+    return key.find_first_of("*?\\") == std::string::npos;
+}
+
+// the matching keys of the query, empty for universal matching
+Worklist::Item queryKeys(DcmDataset& query)
+{
+    Worklist::Item keys;
+    DcmItem* step = NULL;
+    query.findAndGetSequenceItem(DCM_ScheduledProcedureStepSequence, step, 0);
+    for (size_t f = 0; f < Worklist::FIELD_COUNT; ++f) {
+        DcmItem* item = fields[f].step ? step : &query;
+        OFString value;
+        if (item != NULL && item->findAndGetOFStringArray(fields[f].tag, value).good()) {
+            keys[f] = value.c_str();
+        }
+    }
+    // a single wildcard matches everything, values absent or not
+    for (std::string& key : keys) {
+        if (key.find_first_not_of('*') == std::string::npos) {
+            key.clear();
+        }
+    }
+    return keys;
+}
+
+// sets the attributes of the query known to the worklist, those it does not know are returned empty
+void fill(DcmItem& response, const Worklist::Item& item, bool step)
+{
+    std::vector<DcmTagKey> tags;
+    for (unsigned long i = 0; i < response.card(); ++i) {
+        tags.push_back(response.getElement(i)->getTag().getXTag());
+    }
+    for (const DcmTagKey& tag : tags) {
+        if (tag == DCM_SpecificCharacterSet || (!step && tag == DCM_ScheduledProcedureStepSequence)) {
+            continue;
+        }
+        size_t f = 0;
+        while (f < Worklist::FIELD_COUNT && !(fields[f].step == step && fields[f].tag == tag)) {
+            ++f;
+        }
+        if (f < Worklist::FIELD_COUNT) {
+            response.putAndInsertString(tag, item[f].c_str());
+        }
+        else {
+            response.insertEmptyElement(tag, OFTrue);
+        }
+    }
+}
+
+DcmDataset* response(DcmDataset& query, const Worklist::Item& item)
+{
+    DcmDataset* result = new DcmDataset(query);
+    fill(*result, item, false);
+    DcmItem* step = NULL;
+    if (result->findAndGetSequenceItem(DCM_ScheduledProcedureStepSequence, step, 0).good()) {
+        fill(*step, item, true);
+    }
+    result->putAndInsertString(DCM_SpecificCharacterSet, "ISO_IR 192");
+    return result;
+}
+
+}
+
+const char* Worklist::fieldName(size_t field)
+{
+    return field < FIELD_COUNT ? fields[field].name : "";
+}
+
+size_t Worklist::upsert(const std::vector<Item>& items)
+{
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<sTable> table = std::make_shared<sTable>();
+    table->items = std::atomic_load(&current)->items;
+    for (const Item& item : items) {
+        if (item[ACCESSION_NUMBER].empty() && item[STEP_ID].empty()) {
+            DCMNET_WARN("worklist item without AccessionNumber and ScheduledProcedureStepID, skipped");
+            continue;
+        }
+        table->items[identity(item)] = std::make_shared<const Item>(item);
+    }
+    return publish(table);
+}
+
+size_t Worklist::remove(const std::vector<Item>& items)
+{
+    std::lock_guard<std::mutex> lock(writer);
+    std::shared_ptr<sTable> table = std::make_shared<sTable>();
+    table->items = std::atomic_load(&current)->items;
+    for (const Item& item : items) {
+        table->items.erase(identity(item));
+    }
+    return publish(table);
+}
+
+void Worklist::clear()
+{
+    std::lock_guard<std::mutex> lock(writer);
+    publish(std::make_shared<sTable>());
+}
+
+size_t Worklist::size()
+{
+    return std::atomic_load(&current)->items.size();
+}
+
+void Worklist::find(DcmDataset& query, std::vector<DcmDataset*>& matches)
+{
+    const std::shared_ptr<const sTable> table = std::atomic_load(&current);
+    const Item keys = queryKeys(query);
+
+    // the candidates come from the first index with a single value key, or the dates in range
+    std::vector<ItemPtr> candidates;
+    bool selected = false;
+    for (size_t i = 0; i < indexCount && !selected; ++i) {
+        const std::string& key = keys[indexed[i]];
+        if (!key.empty() && isSingleValue(key)) {
+            std::unordered_map<std::string, std::vector<ItemPtr> >::const_iterator it = table->byValue[i].find(key);
+            if (it != table->byValue[i].end()) {
+                candidates = it->second;
+            }
+            selected = true;
+        }
+    }
+    const std::string& date = keys[START_DATE];
+    if (!selected && !date.empty() && date.find_first_of("*?\\") == std::string::npos) {
+        const size_t dash = date.find('-');
+        const std::string low = dash == std::string::npos ? date : date.substr(0, dash);
+        const std::string high = dash == std::string::npos ? date : date.substr(dash + 1);
+        std::map<std::string, std::vector<ItemPtr> >::const_iterator it = low.empty() ? table->byDate.begin() : table->byDate.lower_bound(low);
+        std::map<std::string, std::vector<ItemPtr> >::const_iterator end = high.empty() ? table->byDate.end() : table->byDate.upper_bound(high);
+        for (; it != end; ++it) {
+            candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+        }
+        selected = true;
+    }
+    if (!selected) {
+        for (const std::pair<const std::string, ItemPtr>& entry : table->items) {
+            candidates.push_back(entry.second);
+        }
+    }
+
+    std::vector<ItemPtr> found;
+    for (const ItemPtr& item : candidates) {
+        bool match = true;
+        for (size_t f = 0; f < FIELD_COUNT && match; ++f) {
+            match = keys[f].empty() || matchesKey(fields[f], keys[f], (*item)[f]);
+        }
+        if (match) {
+            found.push_back(item);
+        }
+    }
+    std::stable_sort(found.begin(), found.end(), [](const ItemPtr& a, const ItemPtr& b) {
+        return std::tie((*a)[START_DATE], (*a)[START_TIME]) < std::tie((*b)[START_DATE], (*b)[START_TIME]);
+    });
+    for (const ItemPtr& item : found) {
+        matches.push_back(response(query, *item));
+    }
+    Metrics::counter("worklist_matches_total").add(found.size());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcdatset.h"
+
+// Modality Worklist of the Q/R SCP: the scheduled procedure steps are kept in memory and updated from
+// JS, so modalities polling every few seconds are answered without a database or a worklist server
+// of their own. A published table is never changed, upserts build the next one from the current one,
+// sharing the unchanged items, and swap it in. C-FIND requests match against the table current when
+// they arrive and never wait on a writer. Items are indexed by Scheduled Station AE Title, Patient ID,
+// Accession Number and Modality, and ordered by Scheduled Procedure Step Start Date.
+class Worklist
+{
+public:
+    // attributes of a scheduled procedure step, MODALITY and those after it are in the Scheduled
+    // Procedure Step Sequence
+    enum eField {
+        ACCESSION_NUMBER,
+        PATIENT_NAME,
+        PATIENT_ID,
+        PATIENT_BIRTH_DATE,
+        PATIENT_SEX,
+        STUDY_INSTANCE_UID,
+        REQUESTED_PROCEDURE_ID,
+        REQUESTED_PROCEDURE_DESCRIPTION,
+        REFERRING_PHYSICIAN_NAME,
+        MODALITY,
+        SCHEDULED_STATION_AE_TITLE,
+        SCHEDULED_STATION_NAME,
+        START_DATE,
+        START_TIME,
+        PERFORMING_PHYSICIAN_NAME,
+        STEP_DESCRIPTION,
+        STEP_ID,
+        FIELD_COUNT
+    };
+
+    // values in UTF-8 by field, an item is identified by its AccessionNumber and ScheduledProcedureStepID
+    typedef std::array<std::string, FIELD_COUNT> Item;
+
+    // name of a field in JS, e.g. "scheduledStationAETitle"
+    static const char* fieldName(size_t field);
+
+    // adds the items or replaces those with the same identity, items without AccessionNumber and
+    // ScheduledProcedureStepID are skipped. Returns the number of items afterwards
+    static size_t upsert(const std::vector<Item>& items);
+
+    // removes the items with the identity of those given, returns the number of items afterwards
+    static size_t remove(const std::vector<Item>& items);
+
+    // removes all items
+    static void clear();
+
+    static size_t size();
+
+    // the responses to a C-FIND request of the Modality Worklist Information Model: the attributes of
+    // the query filled from each matching item, ordered by start date and time. Owned by the caller
+    static void find(DcmDataset& query, std::vector<DcmDataset*>& matches);
+};
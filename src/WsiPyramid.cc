@@ -0,0 +1,766 @@
+#include "WsiPyramid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "FrameIndex.h"
+
+#include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/offile.h"
+#include "dcmtk/dcmdata/dccodec.h"
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcfilefo.h"
+#include "dcmtk/dcmdata/dcistrmf.h"
+#include "dcmtk/dcmdata/dcpixel.h"
+#include "dcmtk/dcmdata/dcpixseq.h"
+#include "dcmtk/dcmdata/dcpxitem.h"
+#include "dcmtk/dcmdata/dcuid.h"
+#include "dcmtk/dcmnet/diutil.h"
+
+// SSE2 is part of every x86-64 CPU and NEON of every AArch64 CPU
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define WSIPYRAMID_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define WSIPYRAMID_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// calls fn(i) for each i below count on up to threads threads, the calling one included
+void parallelFor(size_t count, size_t threads, const std::function<void(size_t)>& fn)
+{
+    std::atomic<size_t> next(0);
+    const OFLogger::LogLevel logLevel = OFLog::getThreadLogLevel();
+    auto run = [&]() {
+        OFLog::setThreadLogLevel(logLevel);
+        for (size_t i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < std::min(threads, count); ++t) {
+        workers.push_back(std::thread(run));
+    }
+    run();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// converts 8 bit YBR_FULL pixels to RGB in place
+void ybrToRgb(Uint8* pixels, size_t count)
+{
+    for (size_t i = 0; i < count; ++i, pixels += 3) {
+        const double y = pixels[0];
+        const double cb = pixels[1] - 128.0;
+        const double cr = pixels[2] - 128.0;
+        const double rgb[3] = { y + 1.402 * cr, y - 0.344136 * cb - 0.714136 * cr, y + 1.772 * cb };
+        for (int c = 0; c < 3; ++c) {
+            pixels[c] = static_cast<Uint8>(std::min(std::max(rgb[c] + 0.5, 0.0), 255.0));
+        }
+    }
+}
+
+// a VOLUME image of the series
+struct sImage {
+    std::string file;
+    Uint32 columns;
+    Uint32 rows;
+};
+
+// a level of the pyramid while it is built, the base level is the first one
+struct sLevel {
+    sLevel() : columns(0), rows(0), tileColumns(0), tileRows(0), tilesAcross(0), tilesDown(0), bandRows(0), build(false), spilled(0) {}
+
+    // of the total pixel matrix and of the tiles
+    Uint32 columns;
+    Uint32 rows;
+    Uint32 tileColumns;
+    Uint32 tileRows;
+    Uint32 tilesAcross;
+    Uint32 tilesDown;
+    // a row of tiles over the width of the level, filled from the top
+    std::vector<Uint8> band;
+    Uint32 bandRows;
+    // missing from the series, its tiles are encoded and the level written
+    bool build;
+    std::string sopInstanceUID;
+    // the encoded tiles in frame order, each padded to an even length
+    OFString tileFile;
+    OFFile tiles;
+    std::vector<Uint32> tileLengths;
+    Uint64 spilled;
+};
+
+class PyramidBuilder
+{
+public:
+    PyramidBuilder(const WsiPyramid::sOptions& options, const WsiPyramid::ProgressFunction& progress)
+        : m_options(options), m_progress(progress), m_samplesPerPixel(1), m_instanceNumber(0), m_done(0), m_total(0), m_failed(false), m_encodedAttributes(false)
+    {
+    }
+
+    ~PyramidBuilder()
+    {
+        // tiles of levels not written, e.g. after an error
+        for (sLevel& level : m_levels) {
+            if (level.tiles.open()) {
+                level.tiles.fclose();
+            }
+            if (!level.tileFile.empty()) {
+                OFStandard::deleteFile(level.tileFile);
+            }
+        }
+    }
+
+    // reads the base level of the series and plans the levels below it, false with skipped set if
+    // there is nothing to build
+    bool plan(const std::vector<std::string>& files, std::string& skipped)
+    {
+        std::vector<sImage> images;
+        for (const std::string& file : files) {
+            DcmFileFormat fileformat;
+            if (fileformat.loadFileUntilTag(file.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData).bad()) {
+                DCMNET_WARN("cannot read " << file << ", ignoring it for the pyramid");
+                continue;
+            }
+            DcmDataset* dataset = fileformat.getDataset();
+            OFString sopClassUID;
+            OFString flavor;
+            sImage image;
+            image.file = file;
+            image.columns = 0;
+            image.rows = 0;
+            dataset->findAndGetOFString(DCM_SOPClassUID, sopClassUID);
+            dataset->findAndGetOFString(DCM_ImageType, flavor, 2);
+            dataset->findAndGetUint32(DCM_TotalPixelMatrixColumns, image.columns);
+            dataset->findAndGetUint32(DCM_TotalPixelMatrixRows, image.rows);
+            if (sopClassUID == UID_VLWholeSlideMicroscopyImageStorage && flavor == "VOLUME" && image.columns > 0 && image.rows > 0) {
+                images.push_back(image);
+            }
+        }
+        if (images.empty()) {
+            skipped = "no VL Whole Slide Microscopy VOLUME image";
+            return false;
+        }
+        const sImage& base = *std::max_element(images.begin(), images.end(), [](const sImage& a, const sImage& b) {
+            return OFstatic_cast(Uint64, a.columns) * a.rows < OFstatic_cast(Uint64, b.columns) * b.rows;
+        });
+        m_baseFile = base.file;
+        if (!checkBase(skipped)) {
+            return false;
+        }
+
+        // halved until a level fits into a tile, levels within a pixel of an image of the series are there already
+        sLevel& first = m_levels[0];
+        size_t missing = 0;
+        while (m_levels.back().columns > first.tileColumns || m_levels.back().rows > first.tileRows) {
+            const sLevel& above = m_levels.back();
+            m_levels.emplace_back();
+            sLevel& level = m_levels.back();
+            level.columns = (above.columns + 1) / 2;
+            level.rows = (above.rows + 1) / 2;
+            level.tileColumns = std::min(first.tileColumns, level.columns);
+            level.tileRows = std::min(first.tileRows, level.rows);
+            level.tilesAcross = (level.columns + level.tileColumns - 1) / level.tileColumns;
+            level.tilesDown = (level.rows + level.tileRows - 1) / level.tileRows;
+            level.build = std::none_of(images.begin(), images.end(), [&level](const sImage& image) {
+                return std::abs(OFstatic_cast(long, image.columns) - OFstatic_cast(long, level.columns)) <= 1
+                    && std::abs(OFstatic_cast(long, image.rows) - OFstatic_cast(long, level.rows)) <= 1;
+            });
+            if (level.build) {
+                ++missing;
+                m_total += OFstatic_cast(size_t, level.tilesAcross) * level.tilesDown;
+            }
+        }
+        if (missing == 0) {
+            skipped = "the pyramid is complete";
+            return false;
+        }
+        m_total += OFstatic_cast(size_t, first.tilesAcross) * first.tilesDown;
+        return true;
+    }
+
+    // builds the levels planned and writes them, false with error set on failure
+    bool run(const WsiPyramid::LevelFunction& written, std::string& error)
+    {
+        m_frames = FrameIndex::get(m_baseFile, error);
+        if (!m_frames) {
+            return false;
+        }
+        sLevel& base = m_levels[0];
+        if (m_frames->frames() != OFstatic_cast(size_t, base.tilesAcross) * base.tilesDown) {
+            error = "the base level has " + std::to_string(m_frames->frames()) + " frames instead of " +
+                std::to_string(OFstatic_cast(size_t, base.tilesAcross) * base.tilesDown) + " tiles";
+            return false;
+        }
+        if (!prepare(error)) {
+            return false;
+        }
+        DCMNET_INFO("building " << m_levels.size() - 1 << " pyramid levels below " << base.columns << "x" << base.rows
+            << " from " << m_baseFile << " with " << m_options.threads << " threads");
+
+        for (Uint32 tileRow = 0; tileRow < base.tilesDown; ++tileRow) {
+            if (!decodeBand(tileRow) || !addRows(1, base.band.data(), base.bandRows)) {
+                error = m_error;
+                return false;
+            }
+        }
+        // the rows of the last band of each level, the levels below get theirs from it
+        for (size_t l = 1; l < m_levels.size(); ++l) {
+            if (m_levels[l].bandRows > 0 && !emitBand(l)) {
+                error = m_error;
+                return false;
+            }
+        }
+        for (size_t l = 1; l < m_levels.size(); ++l) {
+            if (m_levels[l].build && !writeLevel(l, written, error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // the base level is a single plane of 8 bit samples in TILED_FULL order, false with skipped set otherwise
+    bool checkBase(std::string& skipped)
+    {
+        if (m_base.loadFileUntilTag(m_baseFile.c_str(), EXS_Unknown, EGL_noChange, DCM_MaxReadLength, ERM_autoDetect, DCM_PixelData).bad()) {
+            skipped = "cannot read " + m_baseFile;
+            return false;
+        }
+        DcmDataset* dataset = m_base.getDataset();
+        OFString organization;
+        OFString photometric;
+        Uint16 columns = 0;
+        Uint16 rows = 0;
+        Uint16 samplesPerPixel = 0;
+        Uint16 bitsAllocated = 0;
+        Uint16 planarConfiguration = 0;
+        Uint16 opticalPaths = 1;
+        Uint32 focalPlanes = 1;
+        Sint32 instanceNumber = 0;
+        dataset->findAndGetOFString(DCM_DimensionOrganizationType, organization);
+        dataset->findAndGetOFString(DCM_PhotometricInterpretation, photometric);
+        dataset->findAndGetUint16(DCM_Columns, columns);
+        dataset->findAndGetUint16(DCM_Rows, rows);
+        dataset->findAndGetUint16(DCM_SamplesPerPixel, samplesPerPixel);
+        dataset->findAndGetUint16(DCM_BitsAllocated, bitsAllocated);
+        dataset->findAndGetUint16(DCM_PlanarConfiguration, planarConfiguration);
+        dataset->findAndGetUint16(DCM_NumberOfOpticalPaths, opticalPaths);
+        dataset->findAndGetUint32(DCM_TotalPixelMatrixFocalPlanes, focalPlanes);
+        dataset->findAndGetSint32(DCM_InstanceNumber, instanceNumber);
+        if (!organization.empty() && organization != "TILED_FULL") {
+            skipped = "the base level is " + std::string(organization.c_str()) + ", not TILED_FULL";
+        }
+        else if (opticalPaths > 1 || focalPlanes > 1 || dataset->tagExists(DCM_ConcatenationUID)) {
+            skipped = "the base level has several optical paths, focal planes or instances";
+        }
+        else if (bitsAllocated != 8 || (samplesPerPixel != 1 && samplesPerPixel != 3) || planarConfiguration != 0 || columns == 0 || rows == 0) {
+            skipped = "the base level is not a color-by-pixel image of 8 bit samples";
+        }
+        else if (samplesPerPixel == 1 ? (photometric != "MONOCHROME1" && photometric != "MONOCHROME2") : photometric == "PALETTE COLOR") {
+            skipped = "the base level has an unsupported photometric interpretation " + std::string(photometric.c_str());
+        }
+        if (!skipped.empty()) {
+            return false;
+        }
+        m_samplesPerPixel = samplesPerPixel;
+        m_instanceNumber = instanceNumber;
+
+        m_levels.emplace_back();
+        sLevel& base = m_levels.back();
+        dataset->findAndGetUint32(DCM_TotalPixelMatrixColumns, base.columns);
+        dataset->findAndGetUint32(DCM_TotalPixelMatrixRows, base.rows);
+        base.tileColumns = columns;
+        base.tileRows = rows;
+        base.tilesAcross = (base.columns + columns - 1) / columns;
+        base.tilesDown = (base.rows + rows - 1) / rows;
+
+        // the image pixel module of the tiles, decoded and encoded on their own
+        const DcmTagKey keys[] = { DCM_SOPClassUID, DCM_SamplesPerPixel, DCM_PhotometricInterpretation, DCM_Rows, DCM_Columns,
+            DCM_BitsAllocated, DCM_BitsStored, DCM_HighBit, DCM_PixelRepresentation, DCM_PlanarConfiguration };
+        for (const DcmTagKey& key : keys) {
+            DcmElement* element = NULL;
+            if (dataset->findAndGetElement(key, element).good() && element != NULL) {
+                m_decodeTile.insert(OFstatic_cast(DcmElement*, element->clone()), OFTrue);
+                m_encodeTile.insert(OFstatic_cast(DcmElement*, element->clone()), OFTrue);
+            }
+        }
+        // decoded tiles are RGB
+        if (m_samplesPerPixel == 3) {
+            m_encodeTile.putAndInsertString(DCM_PhotometricInterpretation, "RGB");
+        }
+        return true;
+    }
+
+    // allocates the bands and opens the tile files of the levels to build
+    bool prepare(std::string& error)
+    {
+        OFString studyInstanceUID;
+        m_base.getDataset()->findAndGetOFString(DCM_StudyInstanceUID, studyInstanceUID);
+        if (studyInstanceUID.empty()) {
+            error = "the base level has no Study Instance UID";
+            return false;
+        }
+        OFStandard::combineDirAndFilename(m_directory, m_options.storagePath.c_str(), studyInstanceUID, OFTrue);
+        if (!OFStandard::dirExists(m_directory) && OFStandard::createDirectory(m_directory, m_options.storagePath.c_str()).bad()) {
+            error = "cannot create " + std::string(m_directory.c_str());
+            return false;
+        }
+        for (sLevel& level : m_levels) {
+            level.band.resize(OFstatic_cast(size_t, level.columns) * level.tileRows * m_samplesPerPixel);
+            if (!level.build) {
+                continue;
+            }
+            char uid[100];
+            level.sopInstanceUID = dcmGenerateUniqueIdentifier(uid, SITE_INSTANCE_UID_ROOT);
+            OFStandard::combineDirAndFilename(level.tileFile, m_directory, OFString(uid) + ".tiles", OFTrue);
+            if (!level.tiles.fopen(level.tileFile, "wb")) {
+                error = "cannot create " + std::string(level.tileFile.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // decodes a row of tiles of the base level into its band
+    bool decodeBand(Uint32 tileRow)
+    {
+        sLevel& base = m_levels[0];
+        base.bandRows = std::min(base.tileRows, base.rows - tileRow * base.tileRows);
+        const size_t tileBytes = OFstatic_cast(size_t, base.tileColumns) * base.tileRows * m_samplesPerPixel;
+        parallelFor(base.tilesAcross, m_options.threads, [&](size_t column) {
+            if (m_failed) {
+                return;
+            }
+            std::vector<Uint8> tile(tileBytes);
+            std::string error;
+            if (!decodeTile(OFstatic_cast(size_t, tileRow) * base.tilesAcross + column, tile.data(), tileBytes, error)) {
+                fail("cannot decode tile " + std::to_string(column) + " of tile row " + std::to_string(tileRow) + ": " + error);
+                return;
+            }
+            const Uint32 left = OFstatic_cast(Uint32, column) * base.tileColumns;
+            const size_t width = std::min(base.tileColumns, base.columns - left) * m_samplesPerPixel;
+            for (Uint32 y = 0; y < base.bandRows; ++y) {
+                memcpy(&base.band[(OFstatic_cast(size_t, y) * base.columns + left) * m_samplesPerPixel],
+                    &tile[OFstatic_cast(size_t, y) * base.tileColumns * m_samplesPerPixel], width);
+            }
+        });
+        m_done += base.tilesAcross;
+        return !m_failed && reportProgress();
+    }
+
+    // decodes frame into pixels, RGB for color images
+    bool decodeTile(size_t frame, Uint8* pixels, size_t length, std::string& error)
+    {
+        const size_t frameLength = m_frames->frameLength(frame);
+        OFString colorModel;
+        OFCondition cond;
+        if (!m_frames->encapsulated()) {
+            if (frameLength != length) {
+                error = "native frame of " + std::to_string(frameLength) + " bytes";
+                return false;
+            }
+            cond = m_frames->readFrame(frame, pixels);
+            m_decodeTile.findAndGetOFString(DCM_PhotometricInterpretation, colorModel);
+        }
+        else {
+            // a single fragment holding the bytes of the frame, padded to an even length
+            DcmDataset tile(m_decodeTile);
+            DcmPixelSequence* sequence = new DcmPixelSequence(DcmTag(DCM_PixelData, EVR_OB));
+            sequence->insert(new DcmPixelItem(DcmTag(DCM_Item, EVR_OB)));
+            DcmPixelItem* fragment = new DcmPixelItem(DcmTag(DCM_Item, EVR_OB));
+            sequence->insert(fragment);
+            Uint8* data = NULL;
+            cond = fragment->createUint8Array(OFstatic_cast(Uint32, (frameLength + 1) & ~size_t(1)), data);
+            if (cond.good()) {
+                if (frameLength % 2 != 0) {
+                    data[frameLength] = 0;
+                }
+                cond = m_frames->readFrame(frame, data);
+            }
+            DcmPixelData* pixelData = new DcmPixelData(DCM_PixelData);
+            pixelData->putOriginalRepresentation(m_frames->transferSyntax(), NULL, sequence);
+            tile.insert(pixelData);
+            Uint32 startFragment = 0;
+            if (cond.good()) {
+                cond = pixelData->getUncompressedFrame(&tile, 0, startFragment, pixels, OFstatic_cast(Uint32, length), colorModel);
+            }
+        }
+        if (cond.bad()) {
+            error = cond.text();
+            return false;
+        }
+        if (m_samplesPerPixel == 3 && colorModel == "YBR_FULL") {
+            ybrToRgb(pixels, length / 3);
+        }
+        else if (m_samplesPerPixel == 3 && colorModel != "RGB") {
+            error = "decoded to " + std::string(colorModel.c_str()) + " instead of RGB";
+            return false;
+        }
+        return true;
+    }
+
+    // halves rows of the level above into level l, emitting each row of tiles it completes
+    bool addRows(size_t l, const Uint8* rows, Uint32 count)
+    {
+        const sLevel& above = m_levels[l - 1];
+        sLevel& level = m_levels[l];
+        const size_t aboveStride = OFstatic_cast(size_t, above.columns) * m_samplesPerPixel;
+        const size_t stride = OFstatic_cast(size_t, level.columns) * m_samplesPerPixel;
+        const Uint32 halved = (count + 1) / 2;
+        Uint32 done = 0;
+        while (done < halved) {
+            const Uint32 chunk = std::min(halved - done, level.tileRows - level.bandRows);
+            Uint8* band = &level.band[level.bandRows * stride];
+            const Uint32 first = done;
+            parallelFor(chunk, m_options.threads, [&](size_t i) {
+                const size_t row = 2 * (first + i);
+                const Uint8* upper = rows + row * aboveStride;
+                const Uint8* lower = row + 1 < count ? upper + aboveStride : upper;
+                WsiPyramid::downsampleRow(upper, lower, above.columns, m_samplesPerPixel, band + i * stride);
+            });
+            level.bandRows += chunk;
+            done += chunk;
+            if (level.bandRows == level.tileRows && !emitBand(l)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // encodes the band of level l if it is built and halves it into the level below
+    bool emitBand(size_t l)
+    {
+        sLevel& level = m_levels[l];
+        if (level.build && !encodeBand(level)) {
+            return false;
+        }
+        if (l + 1 < m_levels.size() && !addRows(l + 1, level.band.data(), level.bandRows)) {
+            return false;
+        }
+        level.bandRows = 0;
+        return true;
+    }
+
+    bool encodeBand(sLevel& level)
+    {
+        std::vector<std::vector<Uint8> > encoded(level.tilesAcross);
+        const size_t tileBytes = OFstatic_cast(size_t, level.tileColumns) * level.tileRows * m_samplesPerPixel;
+        parallelFor(level.tilesAcross, m_options.threads, [&](size_t column) {
+            if (m_failed) {
+                return;
+            }
+            std::vector<Uint8> tile(tileBytes);
+            cutTile(level, OFstatic_cast(Uint32, column) * level.tileColumns, tile.data());
+            std::string error;
+            if (!encodeTile(level, tile, encoded[column], error)) {
+                fail("cannot encode a tile of the " + std::to_string(level.columns) + "x" + std::to_string(level.rows) + " level: " + error);
+            }
+        });
+        if (m_failed) {
+            return false;
+        }
+        for (std::vector<Uint8>& tile : encoded) {
+            if (tile.size() % 2 != 0) {
+                tile.push_back(0);
+            }
+            if (level.tiles.fwrite(tile.data(), 1, tile.size()) != tile.size()) {
+                fail("cannot write " + std::string(level.tileFile.c_str()));
+                return false;
+            }
+            level.tileLengths.push_back(OFstatic_cast(Uint32, tile.size()));
+            level.spilled += tile.size();
+        }
+        m_done += level.tilesAcross;
+        return reportProgress();
+    }
+
+    // copies the tile at column left out of the band, repeating the last column and row of the level
+    // into the part of the tile past it
+    void cutTile(const sLevel& level, Uint32 left, Uint8* tile) const
+    {
+        const size_t spp = m_samplesPerPixel;
+        const size_t width = std::min(level.tileColumns, level.columns - left);
+        for (Uint32 y = 0; y < level.tileRows; ++y) {
+            const Uint8* source = &level.band[(OFstatic_cast(size_t, std::min(y, level.bandRows - 1)) * level.columns + left) * spp];
+            Uint8* target = tile + OFstatic_cast(size_t, y) * level.tileColumns * spp;
+            memcpy(target, source, width * spp);
+            for (size_t x = width; x < level.tileColumns; ++x) {
+                memcpy(target + x * spp, source + (width - 1) * spp, spp);
+            }
+        }
+    }
+
+    // the bytes of the fragments of tile encoded in the transfer syntax of the levels
+    bool encodeTile(const sLevel& level, const std::vector<Uint8>& pixels, std::vector<Uint8>& encoded, std::string& error)
+    {
+        DcmDataset tile(m_encodeTile);
+        tile.putAndInsertUint16(DCM_Columns, OFstatic_cast(Uint16, level.tileColumns));
+        tile.putAndInsertUint16(DCM_Rows, OFstatic_cast(Uint16, level.tileRows));
+        OFCondition cond = tile.putAndInsertUint8Array(DCM_PixelData, pixels.data(), OFstatic_cast(unsigned long, pixels.size()));
+        if (cond.good()) {
+            cond = tile.chooseRepresentation(m_options.xfer, m_options.param);
+        }
+        DcmElement* element = NULL;
+        DcmPixelSequence* sequence = NULL;
+        if (cond.good()) {
+            cond = tile.findAndGetElement(DCM_PixelData, element);
+        }
+        if (cond.good()) {
+            E_TransferSyntax xfer = EXS_Unknown;
+            const DcmRepresentationParameter* param = NULL;
+            DcmPixelData* pixelData = OFstatic_cast(DcmPixelData*, element);
+            pixelData->getCurrentRepresentationKey(xfer, param);
+            cond = xfer == m_options.xfer ? pixelData->getEncapsulatedRepresentation(xfer, param, sequence) : EC_CannotChangeRepresentation;
+        }
+        for (unsigned long i = 1; cond.good() && sequence != NULL && i < sequence->card(); ++i) {
+            DcmPixelItem* fragment = NULL;
+            Uint8* data = NULL;
+            cond = sequence->getItem(fragment, i);
+            if (cond.good()) {
+                cond = fragment->getUint8Array(data);
+            }
+            if (cond.good() && data != NULL) {
+                encoded.insert(encoded.end(), data, data + fragment->getLength());
+            }
+        }
+        if (cond.bad()) {
+            error = cond.text();
+            return false;
+        }
+        // the photometric interpretation and lossy compression the encoder recorded, the same for every tile
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_encodedAttributes) {
+            const DcmTagKey keys[] = { DCM_PhotometricInterpretation, DCM_LossyImageCompression, DCM_LossyImageCompressionMethod };
+            for (const DcmTagKey& key : keys) {
+                DcmElement* attribute = NULL;
+                if (tile.findAndGetElement(key, attribute).good() && attribute != NULL) {
+                    m_encoded.insert(OFstatic_cast(DcmElement*, attribute->clone()), OFTrue);
+                }
+            }
+            m_encodedAttributes = true;
+        }
+        return true;
+    }
+
+    // writes level l as a new instance of the series, its pixel data read from the tile file as it is saved
+    bool writeLevel(size_t l, const WsiPyramid::LevelFunction& written, std::string& error)
+    {
+        sLevel& level = m_levels[l];
+        const sLevel& base = m_levels[0];
+        level.tiles.fclose();
+
+        DcmFileFormat fileformat(m_base.getDataset(), OFTrue);
+        DcmDataset* dataset = fileformat.getDataset();
+        dataset->putAndInsertString(DCM_SOPInstanceUID, level.sopInstanceUID.c_str());
+        dataset->putAndInsertString(DCM_ImageType, "DERIVED\\PRIMARY\\VOLUME\\RESAMPLED");
+        dataset->putAndInsertString(DCM_InstanceNumber, std::to_string(m_instanceNumber + OFstatic_cast(Sint32, l)).c_str());
+        dataset->putAndInsertString(DCM_DimensionOrganizationType, "TILED_FULL");
+        dataset->putAndInsertUint16(DCM_Columns, OFstatic_cast(Uint16, level.tileColumns));
+        dataset->putAndInsertUint16(DCM_Rows, OFstatic_cast(Uint16, level.tileRows));
+        dataset->putAndInsertUint32(DCM_TotalPixelMatrixColumns, level.columns);
+        dataset->putAndInsertUint32(DCM_TotalPixelMatrixRows, level.rows);
+        dataset->putAndInsertString(DCM_NumberOfFrames, std::to_string(level.tileLengths.size()).c_str());
+        dataset->findAndDeleteElement(DCM_PerFrameFunctionalGroupsSequence);
+        dataset->findAndDeleteElement(DCM_LossyImageCompressionRatio);
+        if (m_samplesPerPixel == 3) {
+            dataset->putAndInsertString(DCM_PhotometricInterpretation, "RGB");
+        }
+        for (unsigned long i = 0; i < m_encoded.card(); ++i) {
+            dataset->insert(OFstatic_cast(DcmElement*, m_encoded.getElement(i)->clone()), OFTrue);
+        }
+        // a pixel of the level spans the pixels it was halved from
+        DcmItem* shared = NULL;
+        DcmItem* measures = NULL;
+        Float64 rowSpacing = 0;
+        Float64 columnSpacing = 0;
+        if (dataset->findAndGetSequenceItem(DCM_SharedFunctionalGroupsSequence, shared).good()
+            && shared->findAndGetSequenceItem(DCM_PixelMeasuresSequence, measures).good()
+            && measures->findAndGetFloat64(DCM_PixelSpacing, rowSpacing, 0).good()
+            && measures->findAndGetFloat64(DCM_PixelSpacing, columnSpacing, 1).good()) {
+            char spacing[40];
+            OFStandard::snprintf(spacing, sizeof(spacing), "%.9g\\%.9g", rowSpacing * base.rows / level.rows, columnSpacing * base.columns / level.columns);
+            measures->putAndInsertString(DCM_PixelSpacing, spacing);
+        }
+
+        DcmPixelSequence* sequence = new DcmPixelSequence(DcmTag(DCM_PixelData, EVR_OB));
+        sequence->insert(new DcmPixelItem(DcmTag(DCM_Item, EVR_OB)));
+        OFList<Uint32> frameSizes;
+        offile_off_t offset = 0;
+        for (Uint32 length : level.tileLengths) {
+            DcmPixelItem* fragment = new DcmPixelItem(DcmTag(DCM_Item, EVR_OB));
+            fragment->createValueFromTempFile(new DcmInputFileStreamFactory(level.tileFile, offset), length, EBO_LittleEndian);
+            sequence->insert(fragment);
+            frameSizes.push_back(length + 8);
+            offset += length;
+        }
+        DcmPixelData* pixelData = new DcmPixelData(DCM_PixelData);
+        pixelData->putOriginalRepresentation(m_options.xfer, NULL, sequence);
+        dataset->insert(pixelData, OFTrue);
+        if (DcmCodec::createOffsetTables(dataset, sequence, frameSizes, OFTrue).bad()) {
+            DCMNET_DEBUG("no offset table for the " << level.columns << "x" << level.rows << " level");
+        }
+
+        OFString filename;
+        OFStandard::combineDirAndFilename(filename, m_directory, OFString(level.sopInstanceUID.c_str()) + ".dcm", OFTrue);
+        OFCondition cond = fileformat.saveFile(filename.c_str(), m_options.xfer);
+        if (cond.bad()) {
+            error = "cannot write " + std::string(filename.c_str()) + ": " + cond.text();
+            OFStandard::deleteFile(filename);
+            return false;
+        }
+        DCMNET_DEBUG("wrote the " << level.columns << "x" << level.rows << " level of " << level.tileLengths.size()
+            << " tiles, " << level.spilled << " bytes, to " << filename);
+        written(dataset, filename.c_str());
+        OFStandard::deleteFile(level.tileFile);
+        level.tileFile.clear();
+        return true;
+    }
+
+    bool reportProgress()
+    {
+        if (m_progress && !m_progress(m_done, m_total)) {
+            m_error = "cancelled";
+            return false;
+        }
+        return true;
+    }
+
+    // records the first error, the threads stop at their next tile
+    void fail(const std::string& error)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_failed) {
+            m_error = error;
+            m_failed = true;
+        }
+    }
+
+    const WsiPyramid::sOptions& m_options;
+    const WsiPyramid::ProgressFunction& m_progress;
+    std::string m_baseFile;
+    // the attributes of the base level, without its pixel data
+    DcmFileFormat m_base;
+    std::shared_ptr<const FrameIndex> m_frames;
+    Uint16 m_samplesPerPixel;
+    Sint32 m_instanceNumber;
+    OFString m_directory;
+    // not relocated, their tile files are open
+    std::deque<sLevel> m_levels;
+    DcmDataset m_decodeTile;
+    DcmDataset m_encodeTile;
+    size_t m_done;
+    size_t m_total;
+    std::mutex m_mutex;
+    std::atomic<bool> m_failed;
+    std::string m_error;
+    // the attributes the encoder set on the first tile
+    bool m_encodedAttributes;
+    DcmDataset m_encoded;
+};
+
+}
+
+bool WsiPyramid::build(const std::vector<std::string>& files, const sOptions& options, const ProgressFunction& progress,
+    const LevelFunction& written, std::string& skipped, std::string& error)
+{
+    if (!DcmXfer(options.xfer).isEncapsulated()) {
+        error = "the levels are written in an encapsulated transfer syntax";
+        return false;
+    }
+    PyramidBuilder builder(options, progress);
+    if (!builder.plan(files, skipped)) {
+        DCMNET_INFO("no pyramid levels built: " << skipped);
+        return true;
+    }
+    return builder.run(written, error);
+}
+
+void WsiPyramid::downsampleRow(const Uint8* upper, const Uint8* lower, size_t width, size_t samplesPerPixel, Uint8* out)
+{
+    const size_t spp = samplesPerPixel;
+    const size_t pairs = width / 2;
+    size_t x = 0;
+#if defined(WSIPYRAMID_SSE2)
+    if (spp == 1) {
+        // the even and odd samples of 16 pixels in 16 bit lanes, added into 8 boxes
+        const __m128i even = _mm_set1_epi16(0x00FF);
+        const __m128i two = _mm_set1_epi16(2);
+        for (; x + 8 <= pairs; x += 8) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper + 2 * x));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower + 2 * x));
+            __m128i sum = _mm_add_epi16(_mm_and_si128(a, even), _mm_srli_epi16(a, 8));
+            sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_and_si128(b, even), _mm_srli_epi16(b, 8)));
+            sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(sum, sum));
+        }
+    }
+    else if (spp == 3) {
+        // the rows of 32 pixels are added in 16 bit lanes, their pixel pairs then one by one
+        const size_t blockPixels = 32;
+        Uint16 sums[blockPixels * 3];
+        const __m128i zero = _mm_setzero_si128();
+        for (; 2 * x + blockPixels <= width; x += blockPixels / 2) {
+            const Uint8* a = upper + 2 * x * 3;
+            const Uint8* b = lower + 2 * x * 3;
+            for (size_t s = 0; s < blockPixels * 3; s += 16) {
+                const __m128i ra = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + s));
+                const __m128i rb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + s));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + s), _mm_add_epi16(_mm_unpacklo_epi8(ra, zero), _mm_unpacklo_epi8(rb, zero)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + s + 8), _mm_add_epi16(_mm_unpackhi_epi8(ra, zero), _mm_unpackhi_epi8(rb, zero)));
+            }
+            Uint8* target = out + x * 3;
+            for (size_t p = 0; p < blockPixels * 3; p += 6, target += 3) {
+                target[0] = static_cast<Uint8>((sums[p] + sums[p + 3] + 2) >> 2);
+                target[1] = static_cast<Uint8>((sums[p + 1] + sums[p + 4] + 2) >> 2);
+                target[2] = static_cast<Uint8>((sums[p + 2] + sums[p + 5] + 2) >> 2);
+            }
+        }
+    }
+#elif defined(WSIPYRAMID_NEON)
+    if (spp == 1) {
+        for (; x + 8 <= pairs; x += 8) {
+            const uint8x16_t a = vld1q_u8(upper + 2 * x);
+            const uint8x16_t b = vld1q_u8(lower + 2 * x);
+            vst1_u8(out + x, vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a), vpaddlq_u8(b)), 2));
+        }
+    }
+    else if (spp == 3) {
+        // 16 pixels split into their channels, each added pairwise into 8 boxes
+        for (; x + 8 <= pairs; x += 8) {
+            const uint8x16x3_t a = vld3q_u8(upper + 6 * x);
+            const uint8x16x3_t b = vld3q_u8(lower + 6 * x);
+            uint8x8x3_t boxes;
+            boxes.val[0] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[0]), vpaddlq_u8(b.val[0])), 2);
+            boxes.val[1] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[1]), vpaddlq_u8(b.val[1])), 2);
+            boxes.val[2] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[2]), vpaddlq_u8(b.val[2])), 2);
+            vst3_u8(out + 3 * x, boxes);
+        }
+    }
+#endif
+    for (; x < pairs; ++x) {
+        for (size_t c = 0; c < spp; ++c) {
+            const size_t i = 2 * x * spp + c;
+            out[x * spp + c] = static_cast<Uint8>((upper[i] + upper[i + spp] + lower[i] + lower[i + spp] + 2) >> 2);
+        }
+    }
+    // an odd last column is halved on its own
+    if (width % 2 != 0) {
+        for (size_t c = 0; c < spp; ++c) {
+            const size_t i = (width - 1) * spp + c;
+            out[pairs * spp + c] = static_cast<Uint8>((upper[i] + lower[i] + 1) >> 1);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "dcmtk/config/osconfig.h"    /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/dcmdata/dcxfer.h"
+
+class DcmRepresentationParameter;
+
+// Builds the lower resolution levels of a VL Whole Slide Microscopy pyramid from its base level, so a
+// viewer can pan a slide that arrived as one huge image. The tiles of the base level are decoded a
+// row of tiles at a time on a pool of threads and each row is halved with a 2x2 box filter into the
+// next level, which is halved into the one after it as soon as it has a row of tiles of its own, so
+// all levels are built in a single pass over the base level and only a row of tiles per level is
+// kept in memory. The encoded tiles of a level are spilled to a file next to it until the level is
+// written. Levels are halved until they fit into a single tile, those the series has already are
+// not built again.
+class WsiPyramid
+{
+public:
+    struct sOptions {
+        sOptions() : xfer(EXS_JPEGProcess1), param(NULL), threads(1) {}
+
+        // encapsulated transfer syntax of the new levels and the parameters of its encoder
+        E_TransferSyntax xfer;
+        const DcmRepresentationParameter* param;
+        size_t threads;
+        // the levels are written as <storagePath>/<StudyInstanceUID>/<SOPInstanceUID>.dcm
+        std::string storagePath;
+    };
+
+    // tiles decoded from the base level and encoded into new levels so far, of total. Returns false
+    // to cancel
+    typedef std::function<bool(size_t done, size_t total)> ProgressFunction;
+
+    // called with each level written, before its dataset is freed
+    typedef std::function<void(DcmDataset* dataset, const std::string& filename)> LevelFunction;
+
+    // builds the levels missing below the largest VOLUME image among files, the instances of one
+    // series. True without levels and skipped set to the reason if files hold no tiled single plane
+    // VL Whole Slide Microscopy image of 8 bit samples or its pyramid is complete, false with error
+    // set if a level cannot be built
+    static bool build(const std::vector<std::string>& files, const sOptions& options, const ProgressFunction& progress,
+        const LevelFunction& written, std::string& skipped, std::string& error);
+
+    // halves a row of width pixels of samplesPerPixel 8 bit samples with the row below it, into
+    // (width + 1) / 2 pixels, each the rounded mean of a 2x2 box. The last column is repeated if width is odd
+    static void downsampleRow(const Uint8* upper, const Uint8* lower, size_t width, size_t samplesPerPixel, Uint8* out);
+};
@@ -29,6 +29,9 @@
 
    René Nyffenegger rene.nyffenegger@adp-gmbh.ch
 
+   Altered: whole blocks are encoded and decoded by AVX2 kernels, chosen at
+   run time, or NEON kernels, the table-driven loops handle the rest.
+
 */
 
 #include "base64.h"
@@ -36,6 +39,15 @@
 #include <algorithm>
 #include <stdexcept>
 
+// AVX2 is checked for at run time, NEON is part of every AArch64 CPU
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define BASE64_NEON
+#include <arm_neon.h>
+#endif
+
  //
  // Depending on the url parameter in base64_chars, one of
  // two sets of base64 characters needs to be chosen.
@@ -70,6 +82,200 @@ static unsigned int pos_of_char(const unsigned char chr) {
     throw std::runtime_error("Input is not valid base64-encoded data.");
 }
 
+#if defined(BASE64_AVX2)
+//
+// 24 bytes become 32 characters: the bytes of each group of three are spread
+// over a 32 bit lane, the four 6 bit indices shifted into its bytes and
+// translated to characters by adding an offset looked up per index range.
+//
+__attribute__((target("avx2")))
+static size_t encode_blocks_avx2(unsigned char const* in, size_t len, char* out, bool url) {
+    const __m256i spread = _mm256_set_epi8(
+        10, 11,  9, 10,  7,  8,  6,  7,  4,  5,  3,  4,  1,  2,  0,  1,
+        10, 11,  9, 10,  7,  8,  6,  7,  4,  5,  3,  4,  1,  2,  0,  1);
+    const char c62 = url ? '-' : '+';
+    const char c63 = url ? '_' : '/';
+    const __m256i offsets = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, static_cast<char>(c62 - 62), static_cast<char>(c63 - 63), 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, static_cast<char>(c62 - 62), static_cast<char>(c63 - 63), 'A', 0, 0);
+
+    size_t pos = 0;
+    size_t out_pos = 0;
+    // both halves are loaded with 16 bytes of which 12 are used
+    for (; pos + 32 <= len; pos += 24, out_pos += 32) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos + 12));
+        const __m256i bytes = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), spread);
+
+        const __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        const __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(ac, bd);
+
+        // 0 for 26..51, 13 for 0..25, 1..10 for the digits, 11 and 12 for the last two
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+        const __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + out_pos), chars);
+    }
+    return pos;
+}
+
+//
+// 32 characters become 24 bytes. Characters of both alphabets are accepted as
+// by pos_of_char(), a block with padding or anything else is left to the
+// table-driven loop. 32 bytes are stored for each block.
+//
+__attribute__((target("avx2")))
+static size_t decode_blocks_avx2(const char* in, size_t len, char* out, size_t capacity) {
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+    size_t pos = 0;
+    size_t out_pos = 0;
+    for (; pos + 32 <= len && out_pos + 32 <= capacity; pos += 32, out_pos += 24) {
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos));
+        const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+        const __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+        const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+        const __m256i c62 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('+')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('-')));
+        const __m256i c63 = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+        const __m256i symbol = _mm256_or_si256(c62, c63);
+        const __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, symbol));
+        if (_mm256_movemask_epi8(valid) != -1) {
+            break;
+        }
+
+        __m256i offset = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+        offset = _mm256_or_si256(offset, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+        offset = _mm256_or_si256(offset, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+        __m256i values = _mm256_andnot_si256(symbol, _mm256_add_epi8(c, offset));
+        values = _mm256_or_si256(values, _mm256_and_si256(c62, _mm256_set1_epi8(62)));
+        values = _mm256_or_si256(values, _mm256_and_si256(c63, _mm256_set1_epi8(63)));
+
+        // a b c d become a << 18 | b << 12 | c << 6 | d in each 32 bit lane
+        const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        const __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(groups, pack), join);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + out_pos), bytes);
+    }
+    return pos;
+}
+#endif
+
+#if defined(BASE64_NEON)
+//
+// 48 bytes become 64 characters, the loads and stores (de)interleave the
+// groups of three bytes and four characters.
+//
+static size_t encode_blocks_neon(unsigned char const* in, size_t len, char* out, bool url) {
+    const uint8_t* chars = reinterpret_cast<const uint8_t*>(base64_chars[url]);
+    uint8x16x4_t table;
+    table.val[0] = vld1q_u8(chars);
+    table.val[1] = vld1q_u8(chars + 16);
+    table.val[2] = vld1q_u8(chars + 32);
+    table.val[3] = vld1q_u8(chars + 48);
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+
+    size_t pos = 0;
+    size_t out_pos = 0;
+    for (; pos + 48 <= len; pos += 48, out_pos += 64) {
+        const uint8x16x3_t bytes = vld3q_u8(in + pos);
+        uint8x16x4_t indices;
+        indices.val[0] = vshrq_n_u8(bytes.val[0], 2);
+        indices.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[0], 4), vshrq_n_u8(bytes.val[1], 4)), mask);
+        indices.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[1], 2), vshrq_n_u8(bytes.val[2], 6)), mask);
+        indices.val[3] = vandq_u8(bytes.val[2], mask);
+        uint8x16x4_t result;
+        for (int i = 0; i < 4; ++i) {
+            result.val[i] = vqtbl4q_u8(table, indices.val[i]);
+        }
+        vst4q_u8(reinterpret_cast<uint8_t*>(out + out_pos), result);
+    }
+    return pos;
+}
+
+// the 6 bit values of 16 characters, the bytes of invalid are set for characters outside both alphabets
+static uint8x16_t decode_values_neon(uint8x16_t c, uint8x16_t& invalid) {
+    const uint8x16_t upper = vandq_u8(vcgeq_u8(c, vdupq_n_u8('A')), vcleq_u8(c, vdupq_n_u8('Z')));
+    const uint8x16_t lower = vandq_u8(vcgeq_u8(c, vdupq_n_u8('a')), vcleq_u8(c, vdupq_n_u8('z')));
+    const uint8x16_t digit = vandq_u8(vcgeq_u8(c, vdupq_n_u8('0')), vcleq_u8(c, vdupq_n_u8('9')));
+    const uint8x16_t c62 = vorrq_u8(vceqq_u8(c, vdupq_n_u8('+')), vceqq_u8(c, vdupq_n_u8('-')));
+    const uint8x16_t c63 = vorrq_u8(vceqq_u8(c, vdupq_n_u8('/')), vceqq_u8(c, vdupq_n_u8('_')));
+    const uint8x16_t symbol = vorrq_u8(c62, c63);
+    invalid = vorrq_u8(invalid, vmvnq_u8(vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, symbol))));
+
+    uint8x16_t offset = vandq_u8(upper, vdupq_n_u8(static_cast<uint8_t>(-'A')));
+    offset = vorrq_u8(offset, vandq_u8(lower, vdupq_n_u8(static_cast<uint8_t>(26 - 'a'))));
+    offset = vorrq_u8(offset, vandq_u8(digit, vdupq_n_u8(static_cast<uint8_t>(52 - '0'))));
+    uint8x16_t values = vbicq_u8(vaddq_u8(c, offset), symbol);
+    values = vorrq_u8(values, vandq_u8(c62, vdupq_n_u8(62)));
+    return vorrq_u8(values, vandq_u8(c63, vdupq_n_u8(63)));
+}
+
+//
+// 64 characters become 48 bytes, a block with padding or invalid characters
+// is left to the table-driven loop.
+//
+static size_t decode_blocks_neon(const char* in, size_t len, char* out, size_t capacity) {
+    size_t pos = 0;
+    size_t out_pos = 0;
+    for (; pos + 64 <= len && out_pos + 48 <= capacity; pos += 64, out_pos += 48) {
+        const uint8x16x4_t c = vld4q_u8(reinterpret_cast<const uint8_t*>(in + pos));
+        uint8x16_t invalid = vdupq_n_u8(0);
+        const uint8x16_t a = decode_values_neon(c.val[0], invalid);
+        const uint8x16_t b = decode_values_neon(c.val[1], invalid);
+        const uint8x16_t d = decode_values_neon(c.val[2], invalid);
+        const uint8x16_t e = decode_values_neon(c.val[3], invalid);
+        if (vmaxvq_u8(invalid) != 0) {
+            break;
+        }
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(d, 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(d, 6), e);
+        vst3q_u8(reinterpret_cast<uint8_t*>(out + out_pos), bytes);
+    }
+    return pos;
+}
+#endif
+
+//
+// Encodes the whole blocks at the start of in to out, which takes 4/3 of the
+// bytes. Returns the number of bytes encoded, a multiple of 3.
+//
+static size_t encode_blocks(unsigned char const* in, size_t len, char* out, bool url) {
+#if defined(BASE64_AVX2)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2 ? encode_blocks_avx2(in, len, out, url) : 0;
+#elif defined(BASE64_NEON)
+    return encode_blocks_neon(in, len, out, url);
+#else
+    (void) in; (void) len; (void) out; (void) url;
+    return 0;
+#endif
+}
+
+//
+// Decodes the whole blocks of valid characters at the start of in to out,
+// writing at most capacity bytes. Returns the number of characters decoded,
+// a multiple of 4.
+//
+static size_t decode_blocks(const char* in, size_t len, char* out, size_t capacity) {
+#if defined(BASE64_AVX2)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2 ? decode_blocks_avx2(in, len, out, capacity) : 0;
+#elif defined(BASE64_NEON)
+    return decode_blocks_neon(in, len, out, capacity);
+#else
+    (void) in; (void) len; (void) out; (void) capacity;
+    return 0;
+#endif
+}
+
 static std::string insert_linebreaks(std::string str, size_t distance) {
  //
  // Provided by https://github.com/JomaCorpFX, adapted by me.
@@ -125,31 +331,36 @@ std::string base64_encode(unsigned char const* bytes_to_encode, size_t in_len, b
  //
     const char* base64_chars_ = base64_chars[url];
 
-    std::string ret;
-    ret.reserve(len_encoded);
+    std::string ret(len_encoded, '\0');
+    char* out = &ret[0];
 
-    unsigned int pos = 0;
+ //
+ // The whole blocks are done by the vector kernels, the characters
+ // are written in place from there on.
+ //
+    size_t pos = len_encoded ? encode_blocks(bytes_to_encode, in_len, out, url) : 0;
+    size_t out_pos = pos / 3 * 4;
 
     while (pos < in_len) {
-        ret.push_back(base64_chars_[(bytes_to_encode[pos + 0] & 0xfc) >> 2]);
+        out[out_pos++] = base64_chars_[(bytes_to_encode[pos + 0] & 0xfc) >> 2];
 
         if (pos+1 < in_len) {
-           ret.push_back(base64_chars_[((bytes_to_encode[pos + 0] & 0x03) << 4) + ((bytes_to_encode[pos + 1] & 0xf0) >> 4)]);
+           out[out_pos++] = base64_chars_[((bytes_to_encode[pos + 0] & 0x03) << 4) + ((bytes_to_encode[pos + 1] & 0xf0) >> 4)];
 
            if (pos+2 < in_len) {
-              ret.push_back(base64_chars_[((bytes_to_encode[pos + 1] & 0x0f) << 2) + ((bytes_to_encode[pos + 2] & 0xc0) >> 6)]);
-              ret.push_back(base64_chars_[  bytes_to_encode[pos + 2] & 0x3f]);
+              out[out_pos++] = base64_chars_[((bytes_to_encode[pos + 1] & 0x0f) << 2) + ((bytes_to_encode[pos + 2] & 0xc0) >> 6)];
+              out[out_pos++] = base64_chars_[  bytes_to_encode[pos + 2] & 0x3f];
            }
            else {
-              ret.push_back(base64_chars_[(bytes_to_encode[pos + 1] & 0x0f) << 2]);
-              ret.push_back(trailing_char);
+              out[out_pos++] = base64_chars_[(bytes_to_encode[pos + 1] & 0x0f) << 2];
+              out[out_pos++] = static_cast<char>(trailing_char);
            }
         }
         else {
 
-            ret.push_back(base64_chars_[(bytes_to_encode[pos + 0] & 0x03) << 4]);
-            ret.push_back(trailing_char);
-            ret.push_back(trailing_char);
+            out[out_pos++] = base64_chars_[(bytes_to_encode[pos + 0] & 0x03) << 4];
+            out[out_pos++] = static_cast<char>(trailing_char);
+            out[out_pos++] = static_cast<char>(trailing_char);
         }
 
         pos += 3;
@@ -187,8 +398,16 @@ static std::string decode(String encoded_string, bool remove_linebreaks) {
  // enough space in the string to be returned.
  //
     size_t approx_length_of_decoded_string = length_of_string / 4 * 3;
-    std::string ret;
-    ret.reserve(approx_length_of_decoded_string);
+    std::string ret(approx_length_of_decoded_string, '\0');
+
+ //
+ // The vector kernels decode the whole blocks up to the first one with
+ // padding or invalid characters, the loop below goes on from there.
+ //
+    if (approx_length_of_decoded_string) {
+       pos = decode_blocks(encoded_string.data(), length_of_string, &ret[0], ret.size());
+    }
+    ret.resize(pos / 4 * 3);
 
     while (pos < length_of_string) {
     //
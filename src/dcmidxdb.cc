@@ -0,0 +1,710 @@
+#include "dcmidxdb.h"
+#include "dcmsqldb.h"
+#ifdef WITH_POSTGRESQL
+#include "dcmpgdb.h"
+#endif
+
+#include "dcmtk/config/osconfig.h"  /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/ofstd/oftrace.h"
+
+#include "Utf8.h"
+#include "Metrics.h"
+
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+    std::vector<DB_FindAttrExt> definedAttribs() {
+        std::vector<DB_FindAttrExt> result;
+
+        // PATIENT
+        result.push_back(DB_FindAttrExt(DCM_PatientBirthDate, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientSex, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientName, PATIENT_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientID, PATIENT_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientBirthTime, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_RETIRED_OtherPatientIDs, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_OtherPatientNames, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_EthnicGroup, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientComments, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NumberOfPatientRelatedStudies, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NumberOfPatientRelatedSeries, PATIENT_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NumberOfPatientRelatedInstances, PATIENT_LEVEL, OPTIONAL_KEY));
+
+        // STUDY
+        result.push_back(DB_FindAttrExt(DCM_SpecificCharacterSet, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_StudyDate, STUDY_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_StudyTime, STUDY_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_StudyID, STUDY_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_AccessionNumber, STUDY_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_ReferringPhysicianName, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_StudyDescription, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NameOfPhysiciansReadingStudy, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_StudyInstanceUID, STUDY_LEVEL, UNIQUE_KEY));
+        result.push_back(DB_FindAttrExt(DCM_RETIRED_OtherStudyNumbers, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_AdmittingDiagnosesDescription, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientAge, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientSize, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientWeight, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_Occupation, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_AdditionalPatientHistory, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NumberOfStudyRelatedSeries, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NumberOfStudyRelatedInstances, STUDY_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_ModalitiesInStudy, STUDY_LEVEL, OPTIONAL_KEY));
+
+        // SERIES
+        result.push_back(DB_FindAttrExt(DCM_SeriesNumber, SERIE_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SeriesInstanceUID, SERIE_LEVEL, UNIQUE_KEY));
+        result.push_back(DB_FindAttrExt(DCM_Modality, SERIE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SeriesDescription, SERIE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SeriesDate, SERIE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SeriesTime, SERIE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_BodyPartExamined, SERIE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PatientPosition, SERIE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_ProtocolName, SERIE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NumberOfSeriesRelatedInstances, SERIE_LEVEL, OPTIONAL_KEY));
+
+
+        // IMAGE
+        result.push_back(DB_FindAttrExt(DCM_InstanceNumber, IMAGE_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SOPInstanceUID, IMAGE_LEVEL, UNIQUE_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SliceLocation, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_ImageType, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_NumberOfFrames, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_Rows, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_Columns, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_WindowWidth, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_WindowCenter, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PhotometricInterpretation, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_RescaleSlope, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_RescaleIntercept, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SamplesPerPixel, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PixelSpacing, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_BitsAllocated, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_BitsStored, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_HighBit, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PixelRepresentation, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_ImagePositionPatient, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_ImageOrientationPatient, IMAGE_LEVEL, OPTIONAL_KEY));
+        result.push_back(DB_FindAttrExt(DCM_SOPClassUID, IMAGE_LEVEL, REQUIRED_KEY));
+        result.push_back(DB_FindAttrExt(DCM_PrivateFileName, IMAGE_LEVEL, OPTIONAL_KEY));
+        return result;
+    }
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+const std::vector<DB_FindAttrExt>& DcmIndexDatabase::indexedAttributes()
+{
+    static const std::vector<DB_FindAttrExt> attributes = definedAttribs();
+    return attributes;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmIndexDatabase::isAggregateAttribute(const DcmTagKey& key)
+{
+    return key == DCM_ModalitiesInStudy ||
+           key == DCM_NumberOfStudyRelatedSeries ||
+           key == DCM_NumberOfStudyRelatedInstances ||
+           key == DCM_NumberOfSeriesRelatedInstances;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::vector<DB_FindAttrExt> DcmIndexDatabase::definedAttributes() const
+{
+    return indexedAttributes();
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::list< std::list<DcmSmallDcmElm> > DcmIndexDatabase::find(std::list<DcmSmallDcmElm> findRequestList,
+    DB_LEVEL queryLevel, DB_LEVEL qLevel, DB_LEVEL lLevel) const
+{
+    std::list< std::list<DcmSmallDcmElm> > resultContainer;
+
+    DcmIndexFindCursor* cursor = openFind(findRequestList, queryLevel);
+    if (cursor == NULL) {
+        return resultContainer;
+    }
+
+    std::list<DcmSmallDcmElm> responseList;
+    while (cursor->next(responseList)) {
+        resultContainer.push_back(responseList);
+    }
+    delete cursor;
+    return resultContainer;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::map<std::string, std::string> DcmIndexDatabase::instanceFiles(const std::vector<std::string>& sopInstanceUIDs) const
+{
+    std::map<std::string, std::string> files;
+    for (const std::string& uid : sopInstanceUIDs) {
+        std::list<DcmSmallDcmElm> request;
+        request.push_back(DcmSmallDcmElm(DCM_SOPInstanceUID, uid.c_str()));
+        request.push_back(DcmSmallDcmElm(DCM_PrivateFileName, ""));
+        DcmIndexFindCursor* cursor = openFind(request, IMAGE_LEVEL);
+        if (cursor == NULL) {
+            continue;
+        }
+        std::list<DcmSmallDcmElm> row;
+        if (cursor->next(row)) {
+            for (const DcmSmallDcmElm& el : row) {
+                if (el.XTag() == DCM_PrivateFileName && !el.valueField().empty()) {
+                    files[uid] = el.valueField();
+                }
+            }
+        }
+        delete cursor;
+    }
+    return files;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmIndexDatabase::extractMetaData(DcmDataset* dataset, const OFString& filename,
+    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& insertMap) const
+{
+    // the common character sets are converted value by value without touching the data set,
+    // plain ASCII values are taken as they are
+    OFString charset;
+    dataset->findAndGetOFStringArray(DCM_SpecificCharacterSet, charset, OFFalse);
+    const bool latin1 = charset == "ISO_IR 100";
+    if (!latin1 && !charset.empty() && charset != "ISO_IR 6" && charset != "ISO_IR 192") {
+        dataset->convertToUTF8();
+    }
+
+    const std::vector<DB_FindAttrExt>& definedTags = indexedAttributes();
+    for (size_t i = 0; i < definedTags.size(); ++i) {
+
+        // counters are maintained by the index itself, ignore what the sender claims
+        if (isAggregateAttribute(definedTags[i].tag)) {
+            continue;
+        }
+
+        OFCondition ec = EC_Normal;
+        const char* strPtr = NULL;
+        Uint16 intPtr = 0;
+        ec = dataset->findAndGetString(definedTags[i].tag, strPtr);
+        if ((ec == EC_Normal) && (strPtr != NULL)) {
+            DB_FindAttrExt tag = definedTags[i];
+            const size_t length = strlen(strPtr);
+            std::string& value = insertMap[tag];
+            if (latin1 && !Utf8::isAscii(strPtr, length)) {
+                value.clear();
+                Utf8::appendLatin1(value, strPtr, length);
+            }
+            else {
+                value.assign(strPtr, length);
+            }
+        }
+        else {
+            ec = dataset->findAndGetUint16(definedTags[i].tag, intPtr);
+            if ((ec == EC_Normal) && (intPtr != 0)) {
+                DB_FindAttrExt tag = definedTags[i];
+                insertMap[tag] = std::to_string(intPtr);
+            }
+        }
+    }
+
+    // add filename to private field
+    insertMap[DB_FindAttrExt(DCM_PrivateFileName, IMAGE_LEVEL, OPTIONAL_KEY)] = filename.c_str();
+}
+
+//--------------------------------------------------------------------------------------------
+
+namespace {
+
+    std::mutex poolMutex;
+    std::map<std::string, std::vector<DcmIndexDatabase*> > idleConnections;
+    std::map<std::string, std::vector<DcmIndexDatabase*> > idleReaders;
+    std::set<std::string> initializedStorages;
+    // storages whose schema a connection is creating, the others wait for it on schemaCreated
+    std::set<std::string> creatingStorages;
+    std::condition_variable schemaCreated;
+    // storages whose shards were all opened by a writing connection, readers can open them
+    std::set<std::string> readableStorages;
+    // connections handed out since the last configure(), true for readers. The others are
+    // closed on release
+    std::map<DcmIndexDatabase*, bool> borrowedConnections;
+    DcmIndexDatabasePool::eBackend poolBackend = DcmIndexDatabasePool::SQLITE;
+    std::string poolConnection;
+
+}
+
+bool DcmIndexDatabasePool::configure(eBackend backend, const std::string& connection)
+{
+#ifndef WITH_POSTGRESQL
+    if (backend == POSTGRESQL) {
+        DCMNET_ERROR("PostgreSQL index requested, but the addon is built without DCMTK_POSTGRESQL");
+        return false;
+    }
+#endif
+
+    std::vector<DcmIndexDatabase*> closed;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (backend == poolBackend && connection == poolConnection) {
+            return true;
+        }
+        poolBackend = backend;
+        poolConnection = connection;
+        for (auto& item : idleConnections) {
+            closed.insert(closed.end(), item.second.begin(), item.second.end());
+        }
+        for (auto& item : idleReaders) {
+            closed.insert(closed.end(), item.second.begin(), item.second.end());
+        }
+        idleConnections.clear();
+        idleReaders.clear();
+        initializedStorages.clear();
+        readableStorages.clear();
+        borrowedConnections.clear();
+    }
+    for (auto db : closed) {
+        delete db;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+
+DcmIndexDatabase* DcmIndexDatabasePool::acquire(const OFFilename& path)
+{
+    std::string storage(path.getCharPointer());
+    bool createSchema = false;
+    eBackend backend = SQLITE;
+    std::string connection;
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        // a connection that does not create the schema must not use the storage before it exists
+        schemaCreated.wait(lock, [&storage]() { return creatingStorages.count(storage) == 0; });
+        std::vector<DcmIndexDatabase*>& idle = idleConnections[storage];
+        if (!idle.empty()) {
+            DcmIndexDatabase* db = idle.back();
+            idle.pop_back();
+            borrowedConnections[db] = false;
+            return db;
+        }
+        createSchema = initializedStorages.insert(storage).second;
+        if (createSchema) {
+            creatingStorages.insert(storage);
+        }
+        backend = poolBackend;
+        connection = poolConnection;
+    }
+
+    DcmIndexDatabase* db = NULL;
+#ifdef WITH_POSTGRESQL
+    if (backend == POSTGRESQL) {
+        db = new DcmPostgresDatabase(path, connection, createSchema);
+    }
+#endif
+    if (db == NULL) {
+        db = new DcmSQLiteDatabase(path, createSchema);
+    }
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (createSchema) {
+        if (!db->isInitialized()) {
+            // let the next connection try again
+            initializedStorages.erase(storage);
+        }
+        creatingStorages.erase(storage);
+        schemaCreated.notify_all();
+    }
+    if (backend == poolBackend && connection == poolConnection) {
+        borrowedConnections[db] = false;
+    }
+    return db;
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmIndexDatabase* DcmIndexDatabasePool::acquireReader(const OFFilename& path)
+{
+    std::string storage(path.getCharPointer());
+    bool readable = false;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        std::vector<DcmIndexDatabase*>& idle = idleReaders[storage];
+        if (!idle.empty()) {
+            DcmIndexDatabase* db = idle.back();
+            idle.pop_back();
+            borrowedConnections[db] = true;
+            return db;
+        }
+        readable = readableStorages.count(storage) > 0;
+    }
+
+    if (!readable) {
+        // the files of the index and of all of its shards must exist for a read-only open
+        DcmIndexDatabase* writer = acquire(path);
+        readable = writer->isInitialized();
+        for (size_t s = 0; readable && s < writer->shardCount(); ++s) {
+            readable = writer->shard(s) != NULL;
+        }
+        release(writer);
+    }
+
+    eBackend backend = SQLITE;
+    std::string connection;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (readable) {
+            readableStorages.insert(storage);
+        }
+        backend = poolBackend;
+        connection = poolConnection;
+    }
+
+    DcmIndexDatabase* db = NULL;
+#ifdef WITH_POSTGRESQL
+    if (backend == POSTGRESQL) {
+        // every transaction sees a snapshot, there is nothing to separate
+        db = new DcmPostgresDatabase(path, connection, false);
+    }
+#endif
+    if (db == NULL) {
+        db = new DcmSQLiteDatabase(path, false, true);
+    }
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (backend == poolBackend && connection == poolConnection) {
+        borrowedConnections[db] = true;
+    }
+    return db;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmIndexDatabasePool::release(DcmIndexDatabase* db)
+{
+    if (db == NULL) {
+        return;
+    }
+
+    if (db->isInitialized()) {
+        db->trimStatementCache(maxCachedStatements);
+    }
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        // connections opened before the backend was configured again are closed
+        std::map<DcmIndexDatabase*, bool>::iterator borrowed = borrowedConnections.find(db);
+        if (borrowed != borrowedConnections.end()) {
+            const bool reader = borrowed->second;
+            borrowedConnections.erase(borrowed);
+            std::vector<DcmIndexDatabase*>& idle = (reader ? idleReaders : idleConnections)[db->storagePath()];
+            if (db->isInitialized() && idle.size() < maxIdleConnections) {
+                idle.push_back(db);
+                return;
+            }
+        }
+    }
+    delete db;
+}
+
+//--------------------------------------------------------------------------------------------
+
+namespace {
+
+    struct sIngestTicket {
+        sIngestTicket() : done(false), ok(false) {}
+        bool done;
+        bool ok;
+    };
+
+    struct sIngestJob {
+        std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare > metaData;
+        std::shared_ptr<sIngestTicket> ticket;
+        std::chrono::steady_clock::time_point queuedAt;
+        // recorded once the instance is committed, unless empty
+        std::string sopInstanceUID;
+        std::string pixelHash;
+        std::shared_ptr<DcmPixelStats> pixelStats;
+    };
+
+    // batches committed per storage area, for the change log readers
+    std::mutex commitMutex;
+    std::condition_variable commitSignal;
+    std::map<std::string, unsigned long long> commitCounts;
+
+    // one writer thread per shard of a storage area, committing queued instances in batches
+    class IngestWriter {
+    public:
+        IngestWriter(const OFFilename& path, size_t index, size_t size, int delay, DcmIndexIngestQueue::eDurability mode)
+            : storage(path), shard(index), batchSize(size), maxDelay(delay), durability(mode), queued(0), committedCount(0), stopping(false) {}
+
+        void run();
+
+        OFFilename storage;
+        size_t shard;
+        size_t batchSize;
+        int maxDelay;
+        DcmIndexIngestQueue::eDurability durability;
+        // number of instances queued and committed so far, batches are committed in order
+        unsigned long long queued;
+        unsigned long long committedCount;
+        std::deque<sIngestJob> jobs;
+        // set by DcmIndexIngestQueue::stop(), the thread commits the jobs left and ends
+        bool stopping;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable committed;
+    };
+
+    void IngestWriter::run()
+    {
+        DcmIndexDatabase* router = DcmIndexDatabasePool::acquire(storage);
+        // without its shard insertBatch() fails the instances one by one
+        DcmIndexDatabase* db = router->isInitialized() ? router->shard(shard) : NULL;
+        if (db == NULL) {
+            db = router;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wakeup.wait(lock, [this] { return !jobs.empty() || stopping; });
+            if (jobs.empty()) {
+                break;
+            }
+
+            // waiting stores are committed with whatever queued up meanwhile, without
+            // a store waiting for its commit we can afford to collect a larger batch
+            if (durability == DcmIndexIngestQueue::QUEUED && !stopping && jobs.size() < batchSize) {
+                wakeup.wait_for(lock, std::chrono::milliseconds(maxDelay), [this] { return jobs.size() >= batchSize || stopping; });
+            }
+
+            size_t count = std::min(jobs.size(), batchSize);
+            std::vector<sIngestJob> batch(jobs.begin(), jobs.begin() + count);
+            jobs.erase(jobs.begin(), jobs.begin() + count);
+            lock.unlock();
+
+            std::vector< std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare > > metaData;
+            for (auto job : batch) {
+                metaData.push_back(job.metaData);
+            }
+            std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+            std::vector<bool> result;
+            {
+                OFTraceSpan span("sql.insertBatch");
+                result = db->insertBatch(metaData);
+            }
+            std::chrono::steady_clock::time_point done = std::chrono::steady_clock::now();
+            DCMNET_DEBUG("Committed " << count << " instances to the index");
+
+            std::map<std::string, std::string> hashes;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (result[i] && !batch[i].pixelHash.empty()) {
+                    hashes[batch[i].sopInstanceUID] = batch[i].pixelHash;
+                }
+            }
+            if (!hashes.empty()) {
+                db->recordPixelHashes(hashes);
+            }
+            std::map<std::string, DcmPixelStats> stats;
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (result[i] && batch[i].pixelStats) {
+                    stats[batch[i].sopInstanceUID] = *batch[i].pixelStats;
+                }
+            }
+            if (!stats.empty()) {
+                db->recordPixelStats(stats);
+            }
+
+            Metrics::histogram("db_insert_batch_seconds").record(std::chrono::duration<double>(done - started).count());
+            // from queueing the instance until its batch is committed
+            Metrics::Histogram& latency = Metrics::histogram("db_insert_seconds");
+            for (size_t i = 0; i < batch.size(); ++i) {
+                latency.record(std::chrono::duration<double>(done - batch[i].queuedAt).count());
+            }
+            Metrics::counter("db_inserts_total", {{"result", "success"}}).add(std::count(result.begin(), result.end(), true));
+            Metrics::counter("db_inserts_total", {{"result", "failure"}}).add(std::count(result.begin(), result.end(), false));
+
+            lock.lock();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                batch[i].ticket->done = true;
+                batch[i].ticket->ok = result[i];
+            }
+            committedCount += count;
+            committed.notify_all();
+
+            if (std::count(result.begin(), result.end(), true) > 0) {
+                std::lock_guard<std::mutex> commitLock(commitMutex);
+                ++commitCounts[storage.getCharPointer()];
+                commitSignal.notify_all();
+            }
+        }
+        lock.unlock();
+        DcmIndexDatabasePool::release(router);
+    }
+
+    std::mutex ingestMutex;
+    // writers run until their storage area is stopped, stores and flushes waiting on one keep it alive.
+    // Never destroyed, the writers of storage areas that were not stopped still run when the process exits
+    std::map<std::pair<std::string, size_t>, std::shared_ptr<IngestWriter> >& ingestWriters =
+        *new std::map<std::pair<std::string, size_t>, std::shared_ptr<IngestWriter> >;
+    size_t ingestBatchSize = 64;
+    int ingestMaxDelay = 50;
+    DcmIndexIngestQueue::eDurability ingestDurability = DcmIndexIngestQueue::COMMIT;
+
+    // the writer of a shard, locked so that stop() cannot end it before the caller queued its job
+    std::shared_ptr<IngestWriter> ingestWriter(const std::string& storage, size_t shard, std::unique_lock<std::mutex>& writerLock)
+    {
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        std::shared_ptr<IngestWriter>& writer = ingestWriters[std::make_pair(storage, shard)];
+        if (!writer) {
+            writer = std::make_shared<IngestWriter>(OFFilename(storage.c_str()), shard, ingestBatchSize, ingestMaxDelay, ingestDurability);
+            writer->thread = std::thread(&IngestWriter::run, writer.get());
+        }
+        writerLock = std::unique_lock<std::mutex>(writer->mutex);
+        return writer;
+    }
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmIndexIngestQueue::configure(size_t batchSize, int maxDelay, eDurability durability)
+{
+    std::lock_guard<std::mutex> lock(ingestMutex);
+    ingestBatchSize = batchSize > 0 ? batchSize : 1;
+    ingestMaxDelay = maxDelay >= 0 ? maxDelay : 0;
+    ingestDurability = durability;
+}
+
+//--------------------------------------------------------------------------------------------
+
+OFCondition DcmIndexIngestQueue::store(const DcmIndexDatabase* db, DcmDataset* dataset, const OFString& filename,
+    const std::string& pixelHash, const DcmPixelStats* pixelStats)
+{
+    if (!db->isInitialized()) {
+        DCMNET_WARN("database not initialized");
+        return EC_IllegalParameter;
+    }
+
+    sIngestJob job;
+    job.ticket = std::make_shared<sIngestTicket>();
+    db->extractMetaData(dataset, filename, job.metaData);
+    job.queuedAt = std::chrono::steady_clock::now();
+    if (!pixelHash.empty() || pixelStats != NULL) {
+        OFString uid;
+        dataset->findAndGetOFString(DCM_SOPInstanceUID, uid);
+        job.sopInstanceUID = uid.c_str();
+        job.pixelHash = pixelHash;
+    }
+    if (pixelStats != NULL) {
+        job.pixelStats = std::make_shared<DcmPixelStats>(*pixelStats);
+    }
+
+    // the lock goes before the writer it locks
+    std::shared_ptr<IngestWriter> writer;
+    std::unique_lock<std::mutex> lock;
+    writer = ingestWriter(db->storagePath(), db->shardOf(job.metaData), lock);
+    writer->jobs.push_back(job);
+    writer->queued++;
+    writer->wakeup.notify_one();
+
+    if (writer->durability == QUEUED) {
+        return EC_Normal;
+    }
+
+    writer->committed.wait(lock, [&job] { return job.ticket->done; });
+    if (!job.ticket->ok) {
+        DCMNET_ERROR("Failed inserting metadata into db");
+        return EC_IllegalParameter;
+    }
+    return EC_Normal;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmIndexIngestQueue::flush(const std::string& storagePath)
+{
+    std::vector< std::shared_ptr<IngestWriter> > writers;
+    {
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        std::map<std::pair<std::string, size_t>, std::shared_ptr<IngestWriter> >::iterator it =
+            ingestWriters.lower_bound(std::make_pair(storagePath, size_t(0)));
+        for (; it != ingestWriters.end() && it->first.first == storagePath; ++it) {
+            writers.push_back(it->second);
+        }
+    }
+
+    // instances queued later on by other associations are not waited for
+    std::vector<unsigned long long> targets;
+    for (auto writer : writers) {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        targets.push_back(writer->queued);
+    }
+    for (size_t i = 0; i < writers.size(); ++i) {
+        IngestWriter* writer = writers[i].get();
+        const unsigned long long target = targets[i];
+        std::unique_lock<std::mutex> lock(writer->mutex);
+        writer->committed.wait(lock, [writer, target] { return writer->committedCount >= target; });
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmIndexIngestQueue::stop(const std::string& storagePath)
+{
+    std::vector< std::shared_ptr<IngestWriter> > writers;
+    {
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        std::map<std::pair<std::string, size_t>, std::shared_ptr<IngestWriter> >::iterator it =
+            ingestWriters.lower_bound(std::make_pair(storagePath, size_t(0)));
+        while (it != ingestWriters.end() && it->first.first == storagePath) {
+            writers.push_back(it->second);
+            it = ingestWriters.erase(it);
+        }
+    }
+
+    // stores queued their jobs before the writers left the map, they are committed before the threads end
+    for (auto writer : writers) {
+        std::lock_guard<std::mutex> lock(writer->mutex);
+        writer->stopping = true;
+        writer->wakeup.notify_one();
+    }
+    for (auto writer : writers) {
+        writer->thread.join();
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+unsigned long long DcmIndexIngestQueue::commits(const std::string& storagePath)
+{
+    std::lock_guard<std::mutex> lock(commitMutex);
+    std::map<std::string, unsigned long long>::const_iterator it = commitCounts.find(storagePath);
+    return it != commitCounts.end() ? it->second : 0;
+}
+
+//--------------------------------------------------------------------------------------------
+
+unsigned long long DcmIndexIngestQueue::waitForCommit(const std::string& storagePath, unsigned long long seen, int timeout)
+{
+    std::unique_lock<std::mutex> lock(commitMutex);
+    commitSignal.wait_for(lock, std::chrono::milliseconds(timeout), [&storagePath, seen] { return commitCounts[storagePath] > seen; });
+    return commitCounts[storagePath];
+}
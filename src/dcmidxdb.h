@@ -0,0 +1,286 @@
+#ifndef DCMIDXDB_H
+#define DCMIDXDB_H
+
+#include "dcmsqldef.h"
+
+#include "dcmtk/config/osconfig.h"     /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmqrdb/dcmqrcnf.h"
+
+#include <vector>
+#include <list>
+#include <map>
+#include <string>
+
+class DcmDataset;
+
+// private field to be used to store filename of imported files
+#define DCM_PrivateFileName                            DcmTagKey(0x0011, 0x0011)
+
+// private C-FIND keys of the SCP: matches per page (IS) and the continuation token (UT) of the page
+// before, each response of a page carries the token after it, see DcmIndexDatabase::openFindPage()
+#define DCM_PrivatePageSize                            DcmTagKey(0x0011, 0x0012)
+#define DCM_PrivatePageToken                           DcmTagKey(0x0011, 0x0013)
+
+// An SCP of a cluster sharing the index, as announced on its last heartbeat
+struct DcmClusterNode
+{
+    DcmClusterNode() : port(0), heartbeat(0) {}
+
+    // unique within the cluster
+    std::string name;
+    std::string aeTitle;
+    std::string host;
+    int port;
+    // the files stored below it are read by this node
+    std::string storagePath;
+    // seconds since the epoch
+    long long heartbeat;
+};
+
+// A study, series or instance added to the index, see DcmIndexDatabase::changesSince()
+struct DcmIndexChange
+{
+    enum eAction {
+        CREATED,
+        // a study or series got further instances
+        UPDATED
+    };
+
+    DcmIndexChange() : level(IMAGE_LEVEL), action(CREATED), time(0) {}
+
+    DB_LEVEL level;
+    eAction action;
+    // the UIDs down to the level
+    std::string studyInstanceUID;
+    std::string seriesInstanceUID;
+    std::string sopInstanceUID;
+    // seconds since the epoch the instance was committed
+    long long time;
+};
+
+// Statistics of the pixel values of an instance in modality units, i.e. with RescaleSlope and
+// RescaleIntercept applied, computed while it is stored, see PixelStats
+struct DcmPixelStats
+{
+    DcmPixelStats() : minimum(0), maximum(0), low(0), high(0), windowCenter(0), windowWidth(1) {}
+
+    double minimum;
+    double maximum;
+    // the values at the low and high percentile, the bounds of the window preset
+    double low;
+    double high;
+    double windowCenter;
+    double windowWidth;
+    // pixel counts of equally wide bins from minimum to maximum
+    std::vector<unsigned long long> histogram;
+};
+
+// Forward only cursor over the matches of a find request
+class DcmIndexFindCursor
+{
+public:
+    virtual ~DcmIndexFindCursor() {}
+
+    // fetch the next match, returns false once the cursor is exhausted or closed
+    virtual bool next(std::list<DcmSmallDcmElm>& responseList) = 0;
+
+    // stop fetching and hand the statement back to its connection
+    virtual void close() = 0;
+
+    // continuation token after the last match returned by a paged cursor, empty before the first
+    // match and for cursors which are not paged
+    virtual std::string position() const { return std::string(); }
+};
+
+// Connection to the index of a storage area, which maps the attributes of the stored instances
+// to their files. The query/retrieve handle and the ingest queue only talk to this interface,
+// the backends are the SQLite files of the storage area and a PostgreSQL server shared by SCPs
+// on several hosts
+class DcmIndexDatabase
+{
+public:
+    virtual ~DcmIndexDatabase() {}
+
+    // path of the storage area this connection belongs to
+    virtual const std::string& storagePath() const = 0;
+
+    virtual bool isInitialized() const = 0;
+
+    // drop cached statements once the cache grows beyond maxStatements,
+    // must only be called while no statement is in use
+    virtual void trimStatementCache(size_t maxStatements) = 0;
+
+    std::list< std::list<DcmSmallDcmElm> > find(std::list<DcmSmallDcmElm> findRequestList,
+        DB_LEVEL queryLevel, DB_LEVEL qLevel, DB_LEVEL lLevel) const;
+
+    // same as find() but the matches are fetched one by one, the caller owns the cursor
+    // and must delete it before the connection is released
+    virtual DcmIndexFindCursor* openFind(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel) const = 0;
+
+    // one page of at most limit matches in an order which does not change as instances are added,
+    // after the match whose position() is after, from the first one if it is empty. A page costs the
+    // same however many matches come before it. NULL if the token is invalid or the backend cannot page
+    virtual DcmIndexFindCursor* openFindPage(const std::list<DcmSmallDcmElm>& /* findRequestList */, DB_LEVEL /* queryLevel */,
+        size_t /* limit */, const std::string& /* after */) const { return NULL; }
+
+    virtual OFCondition insertMetaData(DcmDataset* dataset, const OFString& filename) = 0;
+
+    // the files of the indexed ones of the instances by SOPInstanceUID. Backends look them up in
+    // batches, the default finds them one by one
+    virtual std::map<std::string, std::string> instanceFiles(const std::vector<std::string>& sopInstanceUIDs) const;
+
+    // insert many instances in a single transaction, returns the outcome per instance
+    virtual std::vector<bool> insertBatch(const std::vector< std::map< DB_FindAttrExt, std::string,
+        DB_FindAttrExtCompare > >& batch) = 0;
+
+    // collect the indexed attributes of a dataset, converts the dataset to UTF-8
+    void extractMetaData(DcmDataset* dataset, const OFString& filename,
+        std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& insertMap) const;
+
+    std::vector<DB_FindAttrExt> definedAttributes() const;
+
+    // backends splitting the index write their shards with a writer each, the others have one
+    virtual size_t shardCount() const { return 1; }
+    virtual size_t shardOf(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& /* keyValueList */) const { return 0; }
+    virtual DcmIndexDatabase* shard(size_t index) const { return index == 0 ? const_cast<DcmIndexDatabase*>(this) : NULL; }
+
+    // bulk import into the index, inserts in between only maintain the indexes needed by the
+    // inserts themselves and endBulkLoad() builds the others again. Queries are slow meanwhile
+    virtual bool beginBulkLoad() { return true; }
+    virtual bool endBulkLoad() { return true; }
+
+    // the studies were retrieved at time (seconds since the epoch), the tiering of the storage area
+    // keeps recently retrieved studies on the hot tier. Backends without access times ignore it
+    virtual bool recordStudyAccess(const std::vector<std::string>& /* studyInstanceUIDs */, long long /* time */) { return true; }
+
+    // time of the last recorded retrieval by StudyInstanceUID, empty for backends without access times
+    virtual std::map<std::string, long long> studyAccessTimes() const { return std::map<std::string, long long>(); }
+
+    // cluster membership kept next to the index: a node announces itself on every heartbeat and
+    // leaves with a heartbeat of 0. Backends without membership ignore it and return false
+    virtual bool announceNode(const DcmClusterNode& /* node */) { return false; }
+
+    // the nodes whose last heartbeat is at or after since (seconds since the epoch)
+    virtual std::vector<DcmClusterNode> clusterNodes(long long /* since */) const { return std::vector<DcmClusterNode>(); }
+
+    // the pixel data hashes (see PixelHash) of stored instances by SOPInstanceUID, kept for later
+    // integrity scans. Backends without hashes ignore them
+    virtual bool recordPixelHashes(const std::map<std::string, std::string>& /* hashes */) { return true; }
+
+    // the recorded hashes by SOPInstanceUID, empty for backends without hashes
+    virtual std::map<std::string, std::string> pixelHashes() const { return std::map<std::string, std::string>(); }
+
+    // the pixel statistics (see PixelStats) of stored instances by SOPInstanceUID, for windowing them
+    // without decoding. Backends without statistics ignore them
+    virtual bool recordPixelStats(const std::map<std::string, DcmPixelStats>& /* stats */) { return true; }
+
+    // the recorded statistics of the instances by SOPInstanceUID, empty for backends without statistics
+    virtual std::map<std::string, DcmPixelStats> pixelStats(const std::vector<std::string>& /* sopInstanceUIDs */) const
+        { return std::map<std::string, DcmPixelStats>(); }
+
+    // change log for downstream consumers: each new instance is appended along with the highest level
+    // it created, in commit order per shard. Returns the changes of at most limit instances after
+    // position, a sequence number per shard with 0 before the first one, and advances position past
+    // them. A study or series is reported UPDATED at most once per call. Backends without a log
+    // return none
+    virtual std::vector<DcmIndexChange> changesSince(std::vector<long long>& /* position */, size_t /* limit */) const
+        { return std::vector<DcmIndexChange>(); }
+
+    // the position after the last change logged so far, to follow the changes from now on
+    virtual std::vector<long long> changeLogEnd() const { return std::vector<long long>(shardCount(), 0); }
+
+    // maintenance in small steps, see DcmIndexMaintenance. Each step is a transaction of its own, so
+    // the ingest writers wait for one step at most. Backends without maintenance have nothing to do
+
+    // up to limit instances of a shard with an id above after and their files, in id order. after is
+    // advanced past them, false once the shard is exhausted
+    virtual bool scanInstances(size_t /* shard */, long long& /* after */, size_t /* limit */,
+        std::vector< std::pair<long long, std::string> >& /* files */) const { return false; }
+
+    // removes instances of a shard by id along with their series, studies and patients left empty,
+    // the counters of the others are corrected. Returns the number of instances removed
+    virtual size_t removeInstances(size_t /* shard */, const std::vector<long long>& /* ids */) { return 0; }
+
+    // returns free pages of a shard to the file system and refreshes the statistics of the query
+    // planner for about budget ms. Returns the pages freed
+    virtual size_t compact(size_t /* shard */, int /* budget */) { return 0; }
+
+    // refreshes the statistics of the query planner of a shard where they are stale, the index keeps
+    // them for the connections opened after a restart. False if they cannot be written
+    virtual bool optimize(size_t /* shard */) { return true; }
+
+    // asks the system to read up to maxBytes of the files of a shard into its page cache in the
+    // background, so the first queries after a restart do not wait for the disk
+    virtual void readAhead(size_t /* shard */, size_t /* maxBytes */) const {}
+
+    // the attributes kept in the index, by level
+    static const std::vector<DB_FindAttrExt>& indexedAttributes();
+
+    // counters and lists maintained by the index itself from the instances below
+    static bool isAggregateAttribute(const DcmTagKey& key);
+};
+
+// Process wide pool of open connections, one list of idle connections per storage area.
+// Database handles borrow a connection for the lifetime of an association and hand it back
+// afterwards, so the schema is only created by the first connection opened on a storage area.
+class DcmIndexDatabasePool
+{
+public:
+    enum eBackend {
+        // <storageArea>/image.db and its shards
+        SQLITE,
+        // a PostgreSQL server, when built with DCMTK_POSTGRESQL
+        POSTGRESQL
+    };
+
+    // backend of the connections opened from now on, connection is a libpq connection string.
+    // Idle connections to another backend are closed, false if the backend is not built in
+    static bool configure(eBackend backend, const std::string& connection);
+
+    static DcmIndexDatabase* acquire(const OFFilename& path);
+
+    // connection for finds and retrieves, which does not wait for the ingest writers and
+    // cannot insert. The index is created by a writing connection first if needed
+    static DcmIndexDatabase* acquireReader(const OFFilename& path);
+
+    static void release(DcmIndexDatabase* db);
+
+    // number of idle connections of each kind kept per storage area
+    static const size_t maxIdleConnections = 16;
+
+    // number of prepared statements kept per idle connection
+    static const size_t maxCachedStatements = 128;
+};
+
+// Process wide group commit queue for index inserts. Stores of all associations on a storage area
+// are handed to one writer thread per shard which commits them in batches of up to batchSize instances.
+class DcmIndexIngestQueue
+{
+public:
+    enum eDurability {
+        // a store returns once its batch is committed, batches contain whatever queued up during the previous commit
+        COMMIT,
+        // a store returns once queued, the writer waits up to maxDelay ms for a full batch
+        QUEUED
+    };
+
+    // settings are taken over by writers started afterwards
+    static void configure(size_t batchSize, int maxDelay, eDurability durability);
+
+    // pixelHash is recorded along with the instance unless empty, pixelStats unless NULL
+    static OFCondition store(const DcmIndexDatabase* db, DcmDataset* dataset, const OFString& filename,
+        const std::string& pixelHash = std::string(), const DcmPixelStats* pixelStats = NULL);
+
+    // wait until the instances queued so far for the storage area are committed
+    static void flush(const std::string& storagePath);
+
+    // commit the instances queued for the storage area and end its writer threads, later
+    // stores start new ones
+    static void stop(const std::string& storagePath);
+
+    // number of batches committed to the storage area by this process so far. waitForCommit() returns
+    // once it exceeds seen or after timeout ms, change log readers use it instead of polling
+    static unsigned long long commits(const std::string& storagePath);
+    static unsigned long long waitForCommit(const std::string& storagePath, unsigned long long seen, int timeout);
+};
+#endif
@@ -0,0 +1,756 @@
+#ifdef WITH_POSTGRESQL
+
+#include "dcmpgdb.h"
+
+#include "dcmtk/config/osconfig.h"  /* make sure OS specific configuration is included first */
+#include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dctag.h"
+#include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/ofstd/oftrace.h"
+
+#include <libpq-fe.h>
+
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+
+namespace {
+
+    // type of all parameters, the columns are text like in the SQLite index
+    const Oid textOid = 25;
+
+    // serializes the schema creation of SCPs starting at the same time
+    const char* schemaLock = "SELECT pg_advisory_xact_lock(4476824);";
+
+    const std::string& levelName(DB_LEVEL level) {
+        static const std::string names[] = { "patient", "study", "series", "image" };
+        return names[level];
+    }
+
+    // the same column names as the SQLite index, looked up once
+    const std::string& columnName(const DcmTagKey& tag) {
+        static const std::map<DcmTagKey, std::string> names = []() {
+            std::map<DcmTagKey, std::string> result;
+            for (auto attr : DcmIndexDatabase::indexedAttributes()) {
+                result[attr.tag] = DcmTag(attr.tag).getTagName();
+            }
+            return result;
+        }();
+        static const std::string undefined;
+        std::map<DcmTagKey, std::string>::const_iterator it = names.find(tag);
+        return it != names.end() ? it->second : undefined;
+    }
+
+    DB_LEVEL attributeLevel(const DcmTagKey& tag, bool& defined) {
+        for (auto attr : DcmIndexDatabase::indexedAttributes()) {
+            if (attr.tag == tag) {
+                defined = true;
+                return attr.level;
+            }
+        }
+        defined = false;
+        return PATIENT_LEVEL;
+    }
+
+    bool isNameAttribute(const DcmTagKey& tag) {
+        return DcmTag(tag).getEVR() == EVR_PN;
+    }
+
+    bool isDateOrTimeAttribute(const DcmTagKey& tag) {
+        const DcmEVR vr = DcmTag(tag).getEVR();
+        return vr == EVR_DA || vr == EVR_TM;
+    }
+
+    // the columns of the staging table, everything but the aggregates
+    const std::vector<DB_FindAttrExt>& stagedAttributes() {
+        static const std::vector<DB_FindAttrExt> attributes = []() {
+            std::vector<DB_FindAttrExt> result;
+            for (auto attr : DcmIndexDatabase::indexedAttributes()) {
+                if (!DcmIndexDatabase::isAggregateAttribute(attr.tag)) {
+                    result.push_back(attr);
+                }
+            }
+            return result;
+        }();
+        return attributes;
+    }
+
+    // DICOM wildcards as a LIKE pattern, with backslash as escape character
+    std::string likePattern(const std::string& value) {
+        std::string result;
+        for (char c : value) {
+            if (c == '*') {
+                result += '%';
+            }
+            else if (c == '?') {
+                result += '_';
+            }
+            else {
+                if (c == '%' || c == '_' || c == '\\') {
+                    result += '\\';
+                }
+                result += c;
+            }
+        }
+        return result;
+    }
+
+    // smallest string above all strings starting with prefix, empty if there is none
+    std::string prefixEnd(std::string prefix) {
+        while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) >= 0x7F) {
+            prefix.erase(prefix.size() - 1);
+        }
+        if (!prefix.empty()) {
+            prefix.back() = static_cast<char>(prefix.back() + 1);
+        }
+        return prefix;
+    }
+
+    void appendCopyValue(std::string& row, const std::string& value) {
+        for (char c : value) {
+            switch (c) {
+            case '\\': row += "\\\\"; break;
+            case '\t': row += "\\t"; break;
+            case '\n': row += "\\n"; break;
+            case '\r': row += "\\r"; break;
+            default: row += c; break;
+            }
+        }
+    }
+
+    std::string join(const std::vector<std::string>& elements, const char* delimiter) {
+        std::string result;
+        for (size_t i = 0; i < elements.size(); ++i) {
+            if (i > 0) {
+                result += delimiter;
+            }
+            result += elements[i];
+        }
+        return result;
+    }
+
+}
+
+//--------------------------------------------------------------------------------------------
+
+class DcmPostgresDatabasePrivate {
+public:
+    DcmPostgresDatabasePrivate() : connection(NULL), initialized(false), staging(false) {}
+
+    PGconn* connection;
+    bool initialized;
+    std::string storagePath;
+    // prepared statements by their SQL text
+    std::map<std::string, std::string> statements;
+    // the temporary staging table of the session exists
+    bool staging;
+};
+
+//--------------------------------------------------------------------------------------------
+
+class DcmPostgresFindCursorPrivate {
+public:
+    DcmPostgresFindCursorPrivate() : result(NULL), row(0), charsetRequested(false) {}
+
+    PGresult* result;
+    int row;
+    std::vector<DcmTagKey> trackList;
+    bool charsetRequested;
+};
+
+//--------------------------------------------------------------------------------------------
+
+DcmPostgresFindCursor::DcmPostgresFindCursor(DcmPostgresFindCursorPrivate* priv) : d(priv)
+{
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmPostgresFindCursor::~DcmPostgresFindCursor()
+{
+    close();
+    delete d;
+    d = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmPostgresFindCursor::next(std::list<DcmSmallDcmElm>& responseList)
+{
+    responseList.clear();
+    if (d->result == NULL || d->row >= PQntuples(d->result)) {
+        close();
+        return false;
+    }
+
+    for (size_t j = 0; j < d->trackList.size(); j++) {
+        std::string valueStr(PQgetvalue(d->result, d->row, static_cast<int>(j)));
+        if (d->trackList[j] == DCM_ModalitiesInStudy) {
+            // sorted and without duplicates
+            std::set<std::string> modalities;
+            std::istringstream stream(valueStr);
+            std::string modality;
+            while (std::getline(stream, modality, '\\')) {
+                if (!modality.empty()) {
+                    modalities.insert(modality);
+                }
+            }
+            valueStr = join(std::vector<std::string>(modalities.begin(), modalities.end()), "\\");
+        }
+        responseList.push_back(DcmSmallDcmElm(d->trackList[j], valueStr));
+    }
+    ++d->row;
+
+    if (d->charsetRequested) {
+        responseList.push_back(DcmSmallDcmElm(DCM_SpecificCharacterSet, "ISO_IR 192"));
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmPostgresFindCursor::close()
+{
+    if (d->result != NULL) {
+        PQclear(d->result);
+        d->result = NULL;
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmPostgresDatabase::DcmPostgresDatabase(const OFFilename& path, const std::string& connection, bool createSchema)
+    : d(new DcmPostgresDatabasePrivate)
+{
+    d->storagePath = path.getCharPointer();
+    d->connection = PQconnectdb(connection.c_str());
+    if (PQstatus(d->connection) != CONNECTION_OK) {
+        DCMNET_ERROR("Cannot connect to the PostgreSQL index: " << PQerrorMessage(d->connection));
+        return;
+    }
+    // values are UTF-8 like in the SQLite index, see extractMetaData()
+    PQsetClientEncoding(d->connection, "UTF8");
+    d->initialized = !createSchema || createTables();
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmPostgresDatabase::~DcmPostgresDatabase()
+{
+    PQfinish(d->connection);
+    delete d;
+    d = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+
+const std::string& DcmPostgresDatabase::storagePath() const
+{
+    return d->storagePath;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmPostgresDatabase::isInitialized() const
+{
+    return d->initialized;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmPostgresDatabase::trimStatementCache(size_t maxStatements)
+{
+    if (d->statements.size() > maxStatements && execute("DEALLOCATE ALL;")) {
+        d->statements.clear();
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmPostgresDatabase::execute(const std::string& sql) const
+{
+    PGresult* result = PQexec(d->connection, sql.c_str());
+    const ExecStatusType status = PQresultStatus(result);
+    const bool ok = status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK;
+    if (!ok) {
+        DCMNET_ERROR("PostgreSQL index: " << PQresultErrorMessage(result) << " in " << sql);
+    }
+    PQclear(result);
+    return ok;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::string DcmPostgresDatabase::prepared(const std::string& sql, size_t parameters) const
+{
+    std::map<std::string, std::string>::iterator it = d->statements.find(sql);
+    if (it != d->statements.end()) {
+        return it->second;
+    }
+
+    const std::string name = "dcm" + std::to_string(d->statements.size());
+    const std::vector<Oid> types(parameters, textOid);
+    PGresult* result = PQprepare(d->connection, name.c_str(), sql.c_str(), static_cast<int>(parameters),
+        types.empty() ? NULL : &types[0]);
+    const bool ok = PQresultStatus(result) == PGRES_COMMAND_OK;
+    if (!ok) {
+        DCMNET_ERROR("PostgreSQL index: " << PQresultErrorMessage(result) << " in " << sql);
+    }
+    PQclear(result);
+    if (!ok) {
+        return std::string();
+    }
+    d->statements[sql] = name;
+    return name;
+}
+
+//--------------------------------------------------------------------------------------------
+
+PGresult* DcmPostgresDatabase::query(const std::string& sql, const std::vector<std::string>& parameters) const
+{
+    const std::string name = prepared(sql, parameters.size());
+    if (name.empty()) {
+        return NULL;
+    }
+
+    std::vector<const char*> values;
+    for (const std::string& parameter : parameters) {
+        values.push_back(parameter.c_str());
+    }
+    PGresult* result = PQexecPrepared(d->connection, name.c_str(), static_cast<int>(values.size()),
+        values.empty() ? NULL : &values[0], NULL, NULL, 0);
+    const ExecStatusType status = PQresultStatus(result);
+    if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) {
+        DCMNET_ERROR("PostgreSQL index: " << PQresultErrorMessage(result) << " in " << sql);
+        PQclear(result);
+        return NULL;
+    }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmPostgresDatabase::createTables()
+{
+    std::vector<std::string> statements;
+    for (int level = PATIENT_LEVEL; level <= IMAGE_LEVEL; ++level) {
+        const std::string& table = levelName(static_cast<DB_LEVEL>(level));
+        std::string create = "CREATE TABLE IF NOT EXISTS " + table + "(id BIGSERIAL PRIMARY KEY, referenceId BIGINT NOT NULL DEFAULT 0";
+        for (auto attr : indexedAttributes()) {
+            if (attr.level != level) {
+                continue;
+            }
+            create += ", " + columnName(attr.tag) + " TEXT";
+            // the patient identity is unique, so a missing ID or name is stored as empty
+            if (attr.tag == DCM_PatientID || attr.tag == DCM_PatientName) {
+                create += " NOT NULL DEFAULT ''";
+            }
+            else if (attr.keyAttr == UNIQUE_KEY) {
+                create += " UNIQUE";
+            }
+        }
+        if (level == PATIENT_LEVEL) {
+            create += ", UNIQUE(PatientID, PatientName)";
+        }
+        statements.push_back(create + ");");
+        statements.push_back("CREATE INDEX IF NOT EXISTS " + table + "Index ON " + table + "(referenceId);");
+    }
+
+    // person names are matched case-insensitively, text_pattern_ops serves prefix LIKEs
+    statements.push_back("CREATE INDEX IF NOT EXISTS patientPatientNameUpperIndex ON patient(upper(PatientName) text_pattern_ops);");
+    statements.push_back("CREATE INDEX IF NOT EXISTS patientPatientIDIndex ON patient(PatientID text_pattern_ops);");
+    statements.push_back("CREATE INDEX IF NOT EXISTS studyStudyDateIndex ON study(StudyDate COLLATE \"C\");");
+    statements.push_back("CREATE INDEX IF NOT EXISTS studyAccessionNumberIndex ON study(AccessionNumber);");
+    statements.push_back("CREATE INDEX IF NOT EXISTS seriesModalityIndex ON series(referenceId, Modality);");
+    statements.push_back("CREATE TABLE IF NOT EXISTS clusterNodes(name TEXT PRIMARY KEY, aeTitle TEXT, host TEXT, port INTEGER, storagePath TEXT, heartbeat BIGINT);");
+
+    if (!execute("BEGIN;") || !execute(schemaLock)) {
+        return false;
+    }
+    for (const std::string& statement : statements) {
+        if (!execute(statement)) {
+            execute("ROLLBACK;");
+            return false;
+        }
+    }
+    return execute("COMMIT;");
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmPostgresFindCursor* DcmPostgresDatabase::openFind(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel) const
+{
+    OFTraceSpan span("sql.openFind");
+    if (!d->initialized) {
+        DCMNET_WARN("database not initialized");
+        return NULL;
+    }
+
+    if (findRequestList.empty()) {
+        DCMNET_WARN("request is empty!");
+        return NULL;
+    }
+
+    std::vector<std::string> selectColumns;
+    std::vector<std::string> fromTables;
+    std::vector<std::string> whereColumns;
+    std::vector<std::string> orderColumns;
+    std::vector<std::string> parameters;
+    std::vector<DcmTagKey> trackList;
+    bool charsetRequested = false;
+
+    for (int level = PATIENT_LEVEL; level <= queryLevel; ++level) {
+        const std::string& table = levelName(static_cast<DB_LEVEL>(level));
+        if (level == PATIENT_LEVEL) {
+            fromTables.push_back(table);
+        }
+        else {
+            const std::string& parent = levelName(static_cast<DB_LEVEL>(level - 1));
+            fromTables.push_back("JOIN " + table + " ON " + table + ".referenceId = " + parent + ".id");
+        }
+        orderColumns.push_back(table + ".id");
+    }
+
+    for (auto e : findRequestList) {
+        bool defined = false;
+        const DB_LEVEL level = attributeLevel(e.XTag(), defined);
+        if (!defined) {
+            DCMNET_WARN("tag not registered");
+        }
+        if (level > queryLevel) {
+            continue;
+        }
+        if (e.XTag() == DCM_SpecificCharacterSet) {
+            charsetRequested = true;
+            continue;
+        }
+
+        const std::string column = levelName(level) + "." + columnName(e.XTag());
+        const std::string valueStr = e.valueField();
+        const bool aggregate = isAggregateAttribute(e.XTag());
+        const std::string selected = aggregate
+            ? "COALESCE(" + column + ", '" + (e.XTag() == DCM_ModalitiesInStudy ? "" : "0") + "')"
+            : "COALESCE(" + column + ", '')";
+        // person names are matched case-insensitively on the expression of their index
+        const std::string matched = !aggregate && isNameAttribute(e.XTag()) ? "upper(" + column + ")" : column;
+        const std::string value = matched != column ? "upper($" : "($";
+        const std::string next = std::to_string(parameters.size() + 1);
+        const size_t wildcard = valueStr.find_first_of("*?");
+
+        if (valueStr.empty() || valueStr == "*") {
+            // returned, not matched
+        }
+        else if (aggregate) {
+            parameters.push_back(valueStr);
+            // whole values of the backslash separated ModalitiesInStudy, as the SQLite index
+            whereColumns.push_back(e.XTag() == DCM_ModalitiesInStudy
+                ? "strpos('\\' || " + selected + " || '\\', '\\' || $" + next + "::text || '\\') > 0"
+                : selected + " = $" + next);
+        }
+        else if (wildcard != std::string::npos) {
+            parameters.push_back(likePattern(valueStr));
+            whereColumns.push_back(matched + " LIKE " + value + next + ")");
+        }
+        else if (isDateOrTimeAttribute(e.XTag()) && valueStr.find('-') != std::string::npos) {
+            // YYYYMMDD and HHMMSS compare as bytes, the end of a time range includes its finer values
+            const std::string first = valueStr.substr(0, valueStr.find('-'));
+            const std::string second = valueStr.substr(valueStr.find('-') + 1);
+            if (!first.empty()) {
+                parameters.push_back(first);
+                whereColumns.push_back(column + " COLLATE \"C\" >= $" + std::to_string(parameters.size()));
+            }
+            if (!second.empty()) {
+                const bool time = DcmTag(e.XTag()).getEVR() == EVR_TM;
+                parameters.push_back(time ? prefixEnd(second) : second);
+                whereColumns.push_back(column + " COLLATE \"C\" " + (time ? "<" : "<=") + " $" + std::to_string(parameters.size()));
+            }
+        }
+        else {
+            parameters.push_back(valueStr);
+            whereColumns.push_back(matched + " = " + value + next + ")");
+        }
+
+        trackList.push_back(e.XTag());
+        selectColumns.push_back(selected);
+    }
+
+    // keep at least one column so that the statement stays valid for charset only requests
+    selectColumns.push_back(levelName(queryLevel) + ".id");
+
+    std::string sql = "SELECT " + join(selectColumns, ", ") + " FROM " + join(fromTables, " ");
+    if (!whereColumns.empty()) {
+        sql += " WHERE " + join(whereColumns, " AND ");
+    }
+    sql += " ORDER BY " + join(orderColumns, ", ");
+    DCMNET_DEBUG("find: " << sql);
+
+    PGresult* result = query(sql, parameters);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    DcmPostgresFindCursorPrivate* cursor = new DcmPostgresFindCursorPrivate;
+    cursor->result = result;
+    cursor->trackList = trackList;
+    cursor->charsetRequested = charsetRequested;
+    return new DcmPostgresFindCursor(cursor);
+}
+
+//--------------------------------------------------------------------------------------------
+
+OFCondition DcmPostgresDatabase::insertMetaData(DcmDataset* dataset, const OFString& filename)
+{
+    std::vector< std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare > > batch(1);
+    extractMetaData(dataset, filename, batch[0]);
+    if (!insertBatch(batch)[0]) {
+        DCMNET_ERROR("Failed inserting metadata into db");
+        return EC_IllegalParameter;
+    }
+    return EC_Normal;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmPostgresDatabase::copyBatch(const std::vector< std::map< DB_FindAttrExt, std::string,
+    DB_FindAttrExtCompare > >& batch)
+{
+    const std::vector<DB_FindAttrExt>& attributes = stagedAttributes();
+    std::vector<std::string> columns;
+    for (auto attr : attributes) {
+        columns.push_back(columnName(attr.tag));
+    }
+
+    if (!d->staging) {
+        std::string create = "CREATE TEMPORARY TABLE IF NOT EXISTS ingest(" + join(columns, " TEXT, ") + " TEXT) ON COMMIT DELETE ROWS;";
+        if (!execute(create)) {
+            return false;
+        }
+        d->staging = true;
+    }
+
+    std::string rows;
+    for (const auto& keyValueList : batch) {
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            if (i > 0) {
+                rows += '\t';
+            }
+            std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >::const_iterator it = keyValueList.find(attributes[i]);
+            if (it != keyValueList.end()) {
+                appendCopyValue(rows, it->second);
+            }
+            else if (attributes[i].tag != DCM_PatientID && attributes[i].tag != DCM_PatientName) {
+                rows += "\\N";
+            }
+        }
+        rows += '\n';
+    }
+
+    PGresult* result = PQexec(d->connection, ("COPY ingest(" + join(columns, ", ") + ") FROM STDIN;").c_str());
+    const bool started = PQresultStatus(result) == PGRES_COPY_IN;
+    if (!started) {
+        DCMNET_ERROR("PostgreSQL index: " << PQresultErrorMessage(result) << " in COPY");
+    }
+    PQclear(result);
+    if (!started) {
+        return false;
+    }
+
+    bool ok = PQputCopyData(d->connection, rows.data(), static_cast<int>(rows.size())) == 1;
+    ok = PQputCopyEnd(d->connection, ok ? NULL : "batch not sent") == 1 && ok;
+    while ((result = PQgetResult(d->connection)) != NULL) {
+        if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+            DCMNET_ERROR("PostgreSQL index: " << PQresultErrorMessage(result) << " in COPY");
+            ok = false;
+        }
+        PQclear(result);
+    }
+    return ok;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::vector<bool> DcmPostgresDatabase::insertBatch(const std::vector< std::map< DB_FindAttrExt, std::string,
+    DB_FindAttrExtCompare > >& batch)
+{
+    std::vector<bool> result(batch.size(), false);
+    if (!d->initialized) {
+        DCMNET_WARN("database not initialized");
+        return result;
+    }
+    if (batch.empty()) {
+        return result;
+    }
+
+    // each level takes the rows it does not know yet, the first instance of a patient, study or
+    // series in the batch provides its attributes. Rows inserted meanwhile by another SCP are
+    // left alone by ON CONFLICT and joined like our own
+    static const std::vector<std::string> merges = []() {
+        static const DcmTagKey keys[] = { DCM_PatientID, DCM_StudyInstanceUID, DCM_SeriesInstanceUID, DCM_SOPInstanceUID };
+        std::vector<std::string> result;
+        for (int level = PATIENT_LEVEL; level <= IMAGE_LEVEL; ++level) {
+            const std::string& table = levelName(static_cast<DB_LEVEL>(level));
+            std::vector<std::string> columns;
+            std::vector<std::string> values;
+            for (auto attr : stagedAttributes()) {
+                if (attr.level == level) {
+                    columns.push_back(columnName(attr.tag));
+                    values.push_back("i." + columnName(attr.tag));
+                }
+            }
+            std::string distinct;
+            std::string conflict;
+            std::string parent;
+            if (level == PATIENT_LEVEL) {
+                distinct = "i.PatientID, i.PatientName";
+                conflict = "PatientID, PatientName";
+            }
+            else {
+                const std::string& parentTable = levelName(static_cast<DB_LEVEL>(level - 1));
+                distinct = "i." + columnName(keys[level]);
+                conflict = columnName(keys[level]);
+                parent = level == STUDY_LEVEL
+                    ? " JOIN patient p ON p.PatientID = i.PatientID AND p.PatientName = i.PatientName"
+                    : " JOIN " + parentTable + " p ON p." + columnName(keys[level - 1]) + " = i." + columnName(keys[level - 1]);
+                columns.insert(columns.begin(), "referenceId");
+                values.insert(values.begin(), "p.id");
+            }
+            result.push_back("INSERT INTO " + table + "(" + join(columns, ", ") + ") SELECT DISTINCT ON (" + distinct + ") "
+                + join(values, ", ") + " FROM ingest i" + parent + " ORDER BY " + distinct
+                + " ON CONFLICT (" + conflict + ") DO NOTHING;");
+        }
+
+        // counters and modalities of the series and studies the batch added to
+        result.push_back("UPDATE series SET NumberOfSeriesRelatedInstances = "
+            "(SELECT count(*) FROM image WHERE image.referenceId = series.id)::text "
+            "WHERE SeriesInstanceUID IN (SELECT SeriesInstanceUID FROM ingest);");
+        result.push_back("UPDATE study SET NumberOfStudyRelatedSeries = "
+            "(SELECT count(*) FROM series WHERE series.referenceId = study.id)::text, "
+            "NumberOfStudyRelatedInstances = (SELECT count(*) FROM image JOIN series ON image.referenceId = series.id "
+            "WHERE series.referenceId = study.id)::text, "
+            "ModalitiesInStudy = (SELECT string_agg(DISTINCT Modality, '\\') FROM series "
+            "WHERE series.referenceId = study.id AND Modality <> '') "
+            "WHERE StudyInstanceUID IN (SELECT StudyInstanceUID FROM ingest);");
+        return result;
+    }();
+
+    // one transaction, thus one sync, for the whole batch
+    if (!execute("BEGIN;")) {
+        DCMNET_ERROR("Failed to begin ingest transaction");
+        return result;
+    }
+
+    bool ok = copyBatch(batch);
+    for (size_t i = 0; ok && i < merges.size(); ++i) {
+        ok = execute(merges[i]);
+    }
+
+    // instances in the index at the end of the transaction, new or known before
+    std::set<std::string> indexed;
+    if (ok) {
+        PGresult* rows = query("SELECT i.SOPInstanceUID FROM ingest i JOIN image m ON m.SOPInstanceUID = i.SOPInstanceUID;",
+            std::vector<std::string>());
+        ok = rows != NULL;
+        for (int row = 0; ok && row < PQntuples(rows); ++row) {
+            indexed.insert(PQgetvalue(rows, row, 0));
+        }
+        PQclear(rows);
+    }
+
+    if (!ok || !execute("COMMIT;")) {
+        DCMNET_ERROR("Failed to commit ingest transaction");
+        execute("ROLLBACK;");
+        // a staging table created by this transaction is gone as well
+        d->staging = false;
+        return result;
+    }
+
+    const DB_FindAttrExt sopInstanceUID(DCM_SOPInstanceUID, IMAGE_LEVEL, UNIQUE_KEY);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >::const_iterator it = batch[i].find(sopInstanceUID);
+        result[i] = it != batch[i].end() && indexed.count(it->second) > 0;
+    }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmPostgresDatabase::announceNode(const DcmClusterNode& node)
+{
+    if (!d->initialized) {
+        return false;
+    }
+    std::vector<std::string> parameters;
+    parameters.push_back(node.name);
+    parameters.push_back(node.aeTitle);
+    parameters.push_back(node.host);
+    parameters.push_back(std::to_string(node.port));
+    parameters.push_back(node.storagePath);
+    parameters.push_back(std::to_string(node.heartbeat));
+    PGresult* result = query("INSERT INTO clusterNodes(name, aeTitle, host, port, storagePath, heartbeat) "
+        "VALUES($1, $2, $3, $4::integer, $5, $6::bigint) ON CONFLICT(name) DO UPDATE SET aeTitle = EXCLUDED.aeTitle, "
+        "host = EXCLUDED.host, port = EXCLUDED.port, storagePath = EXCLUDED.storagePath, heartbeat = EXCLUDED.heartbeat;", parameters);
+    PQclear(result);
+    return result != NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::map<std::string, std::string> DcmPostgresDatabase::instanceFiles(const std::vector<std::string>& sopInstanceUIDs) const
+{
+    std::map<std::string, std::string> files;
+    if (!d->initialized || sopInstanceUIDs.empty()) {
+        return files;
+    }
+    // the UIDs as one text array parameter, quoted as array elements
+    std::string uids = "{";
+    for (size_t i = 0; i < sopInstanceUIDs.size(); ++i) {
+        uids += (i == 0 ? "\"" : ",\"");
+        for (char c : sopInstanceUIDs[i]) {
+            if (c == '"' || c == '\\') {
+                uids += '\\';
+            }
+            uids += c;
+        }
+        uids += "\"";
+    }
+    uids += "}";
+    PGresult* rows = query("SELECT " + columnName(DCM_SOPInstanceUID) + ", " + columnName(DCM_PrivateFileName) + " FROM "
+        + levelName(IMAGE_LEVEL) + " WHERE " + columnName(DCM_SOPInstanceUID) + " = ANY($1::text[]);",
+        std::vector<std::string>(1, uids));
+    for (int row = 0; rows != NULL && row < PQntuples(rows); ++row) {
+        if (!PQgetisnull(rows, row, 1) && *PQgetvalue(rows, row, 1) != '\0') {
+            files[PQgetvalue(rows, row, 0)] = PQgetvalue(rows, row, 1);
+        }
+    }
+    PQclear(rows);
+    return files;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::vector<DcmClusterNode> DcmPostgresDatabase::clusterNodes(long long since) const
+{
+    std::vector<DcmClusterNode> nodes;
+    if (!d->initialized) {
+        return nodes;
+    }
+    PGresult* rows = query("SELECT name, aeTitle, host, port, storagePath, heartbeat FROM clusterNodes WHERE heartbeat >= $1::bigint ORDER BY name;",
+        std::vector<std::string>(1, std::to_string(since)));
+    for (int row = 0; rows != NULL && row < PQntuples(rows); ++row) {
+        DcmClusterNode node;
+        node.name = PQgetvalue(rows, row, 0);
+        node.aeTitle = PQgetvalue(rows, row, 1);
+        node.host = PQgetvalue(rows, row, 2);
+        node.port = atoi(PQgetvalue(rows, row, 3));
+        node.storagePath = PQgetvalue(rows, row, 4);
+        node.heartbeat = atoll(PQgetvalue(rows, row, 5));
+        nodes.push_back(node);
+    }
+    PQclear(rows);
+    return nodes;
+}
+
+#endif
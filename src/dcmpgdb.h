@@ -0,0 +1,85 @@
+#ifndef DCMPGDB_H
+#define DCMPGDB_H
+
+#include "dcmidxdb.h"
+
+#include <vector>
+#include <string>
+
+class DcmPostgresDatabasePrivate;
+class DcmPostgresFindCursorPrivate;
+
+// Forward only cursor over the matches of a find request, the rows arrive with the query
+class DcmPostgresFindCursor : public DcmIndexFindCursor
+{
+public:
+    virtual ~DcmPostgresFindCursor();
+
+    virtual bool next(std::list<DcmSmallDcmElm>& responseList);
+
+    // drop the rows not fetched yet
+    virtual void close();
+
+private:
+    friend class DcmPostgresDatabase;
+
+    DcmPostgresFindCursor(DcmPostgresFindCursorPrivate* priv);
+    /* not defined */ DcmPostgresFindCursor(const DcmPostgresFindCursor& clone);
+    /* not defined */ DcmPostgresFindCursor& operator=(const DcmPostgresFindCursor& clone);
+
+    DcmPostgresFindCursorPrivate* d;
+};
+
+// Index on a PostgreSQL server, shared by SCPs on several hosts which store to the same storage
+// area, one database per storage area. The tables and columns are those of the SQLite index.
+// Statements are prepared once per connection, batches are copied into a temporary table and
+// merged into the hierarchy with one INSERT ... SELECT per level
+class DcmPostgresDatabase : public DcmIndexDatabase
+{
+public:
+    // connection is a libpq connection string, e.g. "host=db dbname=pacs user=scp"
+    DcmPostgresDatabase(const OFFilename& path, const std::string& connection, bool createSchema = true);
+    virtual ~DcmPostgresDatabase();
+
+    virtual const std::string& storagePath() const;
+
+    virtual bool isInitialized() const;
+
+    virtual void trimStatementCache(size_t maxStatements);
+
+    virtual DcmPostgresFindCursor* openFind(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel) const;
+
+    virtual OFCondition insertMetaData(DcmDataset* dataset, const OFString& filename);
+
+    // one COPY into the staging table and one transaction for the whole batch
+    virtual std::vector<bool> insertBatch(const std::vector< std::map< DB_FindAttrExt, std::string,
+        DB_FindAttrExtCompare > >& batch);
+
+    // one statement for all SOPInstanceUIDs
+    virtual std::map<std::string, std::string> instanceFiles(const std::vector<std::string>& sopInstanceUIDs) const;
+
+    // kept in the clusterNodes table
+    virtual bool announceNode(const DcmClusterNode& node);
+    virtual std::vector<DcmClusterNode> clusterNodes(long long since) const;
+
+protected:
+
+    bool createTables();
+
+    // run a statement without parameters, false and logged on error
+    bool execute(const std::string& sql) const;
+
+    // name of the statement prepared for the SQL text, empty on error
+    std::string prepared(const std::string& sql, size_t parameters) const;
+
+    // rows of the (prepared) statement, NULL and logged on error, to be freed with PQclear()
+    struct pg_result* query(const std::string& sql, const std::vector<std::string>& parameters) const;
+
+    // the batch as rows of the staging table in COPY text format
+    bool copyBatch(const std::vector< std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare > >& batch);
+
+private:
+    DcmPostgresDatabasePrivate* d;
+};
+
+#endif
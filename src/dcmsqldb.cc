@@ -5,8 +5,10 @@
 #include "dcmtk/dcmdata/dcdict.h"
 #include "dcmtk/dcmdata/dcdicent.h"
 #include "dcmtk/dcmnet/diutil.h"
+#include "dcmtk/ofstd/oftrace.h"
 
 #include "sqlite3pp.h"
+#include "Metrics.h"
 
 #include <set>
 #include <map>
@@ -15,6 +17,23 @@
 #include <string>
 #include <random>
 #include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <ctime>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace uuid {
     static std::random_device              rd;
@@ -54,10 +73,243 @@ namespace {
 
     static GlobalDcmDataDictionary* DICT = new GlobalDcmDataDictionary();
 
+    const std::vector<DB_FindAttrExt>& definedAttribs() {
+        return DcmIndexDatabase::indexedAttributes();
+    }
+
+    // a column of a level. Person names also keep an uppercase copy, which their matching and
+    // its index use as DICOM matches them case-insensitively, dates and times an integer copy
+    // (YYYYMMDD, HHMMSSFFFFFF) for their range matching
+    enum eColumn { StoredColumn, UpperColumn, IntegerColumn };
+    struct sColumn {
+        DcmTagKey tag;
+        std::string name;
+        eColumn kind;
+    };
+    typedef std::vector<sColumn> ColumnList;
+
+    // how a find request key restricts the matches, part of the statement shape
+    enum eMatch {
+        NoMatch = 'n',
+        AggregateMatch = 'a',
+        // GLOB on the column, person names on their uppercase copy
+        WildcardMatch = 'w',
+        // a single leading wildcard free prefix (DOE^*), a range scan on the column
+        PrefixMatch = 'p',
+        // a word in a name (*JOHN*), looked up in the full text index of the patient names
+        SearchMatch = 's',
+        // on the integer copy of a date or time, an open end is the lowest or highest value
+        RangeMatch = 'r',
+        IntegerMatch = 'i',
+        // dates and times which do not normalize, compared as text
+        TextRangeMatch = 't',
+        ValueMatch = 'v'
+    };
+
+    // how a page of a find continues, part of the statement shape, see DcmSQLiteDatabase::openFindPage()
+    enum ePage {
+        NoPage = 0,
+        FirstPage = 'f',
+        // after a match with a StudyDate, the studies without one follow with an UndatedPage
+        DatedPage = 'd',
+        UndatedPage = 'u',
+        // after a patient with a PatientName and after one without
+        NamedPage = 'p',
+        UnnamedPage = 'q'
+    };
+
+    const char* upperSuffix = "Upper";
+    const char* integerSuffix = "Int";
+
+    // same as SQLite's UPPER(), which only folds ASCII
+    std::string asciiUpper(std::string value) {
+        for (std::string::iterator c = value.begin(); c != value.end(); ++c) {
+            if (*c >= 'a' && *c <= 'z') {
+                *c = static_cast<char>(*c - 'a' + 'A');
+            }
+        }
+        return value;
+    }
+
+    // GLOB treats * and ? like DICOM, only [ needs to be quoted
+    std::string globPattern(const std::string& value) {
+        std::string result;
+        for (char c : value) {
+            if (c == '[') {
+                result += "[[]";
+            }
+            else {
+                result += c;
+            }
+        }
+        return result;
+    }
+
+    // *WORD* with a single word of letters and digits, as the full text index tokenizes names
+    bool isSearchTerm(const std::string& value, std::string& term) {
+        if (value.size() < 3 || value.front() != '*' || value.back() != '*') {
+            return false;
+        }
+        term = value.substr(1, value.size() - 2);
+        for (char c : term) {
+            const unsigned char u = static_cast<unsigned char>(c);
+            if (u < 0x80 && !isalnum(u)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // smallest string above all strings starting with prefix, empty if there is none
+    std::string prefixEnd(std::string prefix) {
+        while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xFF) {
+            prefix.erase(prefix.size() - 1);
+        }
+        if (!prefix.empty()) {
+            prefix.back() = static_cast<char>(prefix.back() + 1);
+        }
+        return prefix;
+    }
+
+    // column names of the defined attributes, looked up once since the dictionary takes its lock
+    const std::map<DcmTagKey, std::string>& columnNames() {
+        static const std::map<DcmTagKey, std::string> names = []() {
+            std::map<DcmTagKey, std::string> result;
+            for (auto attr : definedAttribs()) {
+                result[attr.tag] = DICT->rdlock().findEntry(attr.tag, NULL)->getTagName();
+            }
+            return result;
+        }();
+        return names;
+    }
+
     std::string getTagName(const DcmTagKey& tag) {
+        std::map<DcmTagKey, std::string>::const_iterator it = columnNames().find(tag);
+        if (it != columnNames().end()) {
+            return it->second;
+        }
         return DICT->rdlock().findEntry(tag, NULL)->getTagName();
     }
 
+    // VR of the defined attributes, EVR_UNKNOWN for others
+    DcmEVR definedVR(const DcmTagKey& tag) {
+        static const std::map<DcmTagKey, DcmEVR> vrs = []() {
+            std::map<DcmTagKey, DcmEVR> result;
+            for (auto attr : definedAttribs()) {
+                result[attr.tag] = DcmTag(attr.tag).getEVR();
+            }
+            return result;
+        }();
+        std::map<DcmTagKey, DcmEVR>::const_iterator it = vrs.find(tag);
+        return it != vrs.end() ? it->second : EVR_UNKNOWN;
+    }
+
+    bool isNameAttribute(const DcmTagKey& tag) {
+        return definedVR(tag) == EVR_PN;
+    }
+
+    bool isIntegerAttribute(const DcmTagKey& tag) {
+        return definedVR(tag) == EVR_DA || definedVR(tag) == EVR_TM;
+    }
+
+    // numbers are kept in INTEGER columns by indexes created since, the counters maintained
+    // by the index stay text as their matching compares COALESCE(column, '0')
+    bool isNumberAttribute(const DcmTagKey& tag) {
+        const DcmEVR vr = definedVR(tag);
+        return (vr == EVR_IS || vr == EVR_US || vr == EVR_SS || vr == EVR_UL || vr == EVR_SL)
+            && !DcmIndexDatabase::isAggregateAttribute(tag);
+    }
+
+    // instance attributes whose few values repeat on millions of rows, indexes created since
+    // keep each value once in the dictionary table and its id in the column. The position and
+    // the file of an instance are its own and stay text
+    bool isInternedAttribute(const DcmTagKey& tag) {
+        static const std::set<DcmTagKey> interned = []() {
+            std::set<DcmTagKey> result;
+            for (auto attr : definedAttribs()) {
+                const DcmEVR vr = definedVR(attr.tag);
+                if (attr.level == IMAGE_LEVEL && attr.keyAttr != UNIQUE_KEY
+                    && (vr == EVR_CS || vr == EVR_UI || vr == EVR_DS || vr == EVR_LO)
+                    && attr.tag != DCM_ImagePositionPatient && attr.tag != DCM_SliceLocation
+                    && attr.tag != DCM_PrivateFileName) {
+                    result.insert(attr.tag);
+                }
+            }
+            return result;
+        }();
+        return interned.count(tag) > 0;
+    }
+
+    // dictionary ids remembered per connection, the dictionary of a busy archive has a few
+    // thousand values
+    const size_t internCacheSize = 65536;
+
+    // the columns of a level in the order of definedAttribs(), the copies follow their column
+    const ColumnList& levelColumns(DB_LEVEL level) {
+        static const std::vector<ColumnList> columns = []() {
+            std::vector<ColumnList> result(IMAGE_LEVEL + 1);
+            for (auto attr : definedAttribs()) {
+                sColumn column = { attr.tag, getTagName(attr.tag), StoredColumn };
+                result[attr.level].push_back(column);
+                if (isNameAttribute(attr.tag)) {
+                    column.name = getTagName(attr.tag) + upperSuffix;
+                    column.kind = UpperColumn;
+                    result[attr.level].push_back(column);
+                }
+                if (isIntegerAttribute(attr.tag)) {
+                    column.name = getTagName(attr.tag) + integerSuffix;
+                    column.kind = IntegerColumn;
+                    result[attr.level].push_back(column);
+                }
+            }
+            return result;
+        }();
+        return columns[level];
+    }
+
+    // digits of DA (YYYYMMDD, also the old YYYY.MM.DD) or TM (HH[MM[SS[.FFFFFF]]], also with
+    // colons) values, a time is filled up to microseconds with 0 or, for the end of a range, 9
+    bool normalizedDate(const std::string& value, std::string& digits) {
+        digits.clear();
+        for (char c : value) {
+            if (isdigit(static_cast<unsigned char>(c))) {
+                digits += c;
+            }
+            else if (c != '.' && c != ' ') {
+                return false;
+            }
+        }
+        return digits.size() == 8;
+    }
+
+    bool normalizedTime(const std::string& value, bool rangeEnd, std::string& digits) {
+        digits.clear();
+        std::string fraction;
+        bool inFraction = false;
+        for (char c : value) {
+            if (isdigit(static_cast<unsigned char>(c))) {
+                (inFraction ? fraction : digits) += c;
+            }
+            else if (c == '.' && !inFraction) {
+                inFraction = true;
+            }
+            else if (c != ':' && c != ' ') {
+                return false;
+            }
+        }
+        if (digits.empty() || digits.size() > 6 || digits.size() % 2 != 0 || fraction.size() > 6
+            || (!fraction.empty() && digits.size() != 6)) {
+            return false;
+        }
+        digits += fraction;
+        digits.resize(12, rangeEnd ? '9' : '0');
+        return true;
+    }
+
+    bool normalizedValue(const DcmTagKey& tag, const std::string& value, bool rangeEnd, std::string& digits) {
+        return definedVR(tag) == EVR_DA ? normalizedDate(value, digits) : normalizedTime(value, rangeEnd, digits);
+    }
+
     bool contains(const std::string& text, const std::string& value) {
         return (text.find(value) != std::string::npos);
     }
@@ -108,752 +360,2895 @@ namespace {
             }
         }
     }
-    std::string levelName(DB_LEVEL level) {
-        std::string result;
-        switch (level) {
-        case PATIENT_LEVEL:
-            result = "patient";
-            break;
-        case STUDY_LEVEL:
-            result = "study";
-            break;
-        case SERIE_LEVEL:
-            result = "series";
-            break;
-        case IMAGE_LEVEL:
-            result = "image";
-            break;
-        default:
+    const std::string& levelName(DB_LEVEL level) {
+        static const std::string names[] = { "patient", "study", "series", "image" };
+        static const std::string undefined;
+        if (level < PATIENT_LEVEL || level > IMAGE_LEVEL) {
             DCMNET_ERROR("tableName not defined");
-            break;
+            return undefined;
         }
-
-        return result;
-    }
-
-
-    std::vector<DB_FindAttrExt> definedAttribs() {
-        std::vector<DB_FindAttrExt> result;
-
-        // PATIENT
-        result.push_back(DB_FindAttrExt(DCM_PatientBirthDate, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientSex, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientName, PATIENT_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientID, PATIENT_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientBirthTime, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_RETIRED_OtherPatientIDs, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_OtherPatientNames, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_EthnicGroup, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientComments, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NumberOfPatientRelatedStudies, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NumberOfPatientRelatedSeries, PATIENT_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NumberOfPatientRelatedInstances, PATIENT_LEVEL, OPTIONAL_KEY));
-
-        // STUDY
-        result.push_back(DB_FindAttrExt(DCM_SpecificCharacterSet, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_StudyDate, STUDY_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_StudyTime, STUDY_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_StudyID, STUDY_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_AccessionNumber, STUDY_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_ReferringPhysicianName, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_StudyDescription, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NameOfPhysiciansReadingStudy, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_StudyInstanceUID, STUDY_LEVEL, UNIQUE_KEY));
-        result.push_back(DB_FindAttrExt(DCM_RETIRED_OtherStudyNumbers, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_AdmittingDiagnosesDescription, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientAge, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientSize, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientWeight, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_Occupation, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_AdditionalPatientHistory, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NumberOfStudyRelatedSeries, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NumberOfStudyRelatedInstances, STUDY_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_ModalitiesInStudy, STUDY_LEVEL, OPTIONAL_KEY));
-
-        // SERIES
-        result.push_back(DB_FindAttrExt(DCM_SeriesNumber, SERIE_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SeriesInstanceUID, SERIE_LEVEL, UNIQUE_KEY));
-        result.push_back(DB_FindAttrExt(DCM_Modality, SERIE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SeriesDescription, SERIE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SeriesDate, SERIE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SeriesTime, SERIE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_BodyPartExamined, SERIE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PatientPosition, SERIE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_ProtocolName, SERIE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NumberOfSeriesRelatedInstances, SERIE_LEVEL, OPTIONAL_KEY));
-
-
-        // IMAGE
-        result.push_back(DB_FindAttrExt(DCM_InstanceNumber, IMAGE_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SOPInstanceUID, IMAGE_LEVEL, UNIQUE_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SliceLocation, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_ImageType, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_NumberOfFrames, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_Rows, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_Columns, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_WindowWidth, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_WindowCenter, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PhotometricInterpretation, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_RescaleSlope, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_RescaleIntercept, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SamplesPerPixel, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PixelSpacing, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_BitsAllocated, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_BitsStored, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_HighBit, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PixelRepresentation, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_ImagePositionPatient, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_ImageOrientationPatient, IMAGE_LEVEL, OPTIONAL_KEY));
-        result.push_back(DB_FindAttrExt(DCM_SOPClassUID, IMAGE_LEVEL, REQUIRED_KEY));
-        result.push_back(DB_FindAttrExt(DCM_PrivateFileName, IMAGE_LEVEL, OPTIONAL_KEY));
-        return result;
+        return names[level];
     }
 
-}
-
-
-class DcmSQLiteDatabasePrivate {
-public:
-    std::vector<DB_FindAttrExt> definedTags;
-    sqlite3pp::database* db;
-    bool initialized;
-};
-
-//--------------------------------------------------------------------------------------------
-
-DcmSQLiteDatabase::DcmSQLiteDatabase(const OFFilename& path) : d(new DcmSQLiteDatabasePrivate)
-{
-     std::string storage(path.getCharPointer());
-     storage.append("/image.db");
-     d->db = new sqlite3pp::database(storage.c_str());
-     d->definedTags = definedAttribs();
-     d->initialized = createTables();
-}
-
-//--------------------------------------------------------------------------------------------
-
-DcmSQLiteDatabase::~DcmSQLiteDatabase()
-{
-    delete d;
-    d = NULL;
-}
-
-//--------------------------------------------------------------------------------------------
-
-std::list< std::list<DcmSmallDcmElm> > DcmSQLiteDatabase::find(std::list<DcmSmallDcmElm> findRequestList,
-    DB_LEVEL queryLevel, DB_LEVEL qLevel, DB_LEVEL lLevel) const
-{
 
-    std::list< std::list<DcmSmallDcmElm> > resultContainer;
+    struct sIndexSpec {
+        sIndexSpec(DB_LEVEL l, const std::string& n) : level(l), name(n), unique(false) {}
+        DB_LEVEL level;
+        std::string name;
+        std::vector<std::string> columns;
+        bool unique;
+    };
 
-    if (!d->initialized) {
-        DCMNET_WARN("database not initialized");
-        return resultContainer;
-    }
+    // bump whenever the index spec changes, existing databases are upgraded on open
+    const int schemaVersion = 6;
 
-    if (findRequestList.empty()) {
-        DCMNET_WARN("request is empty!");
-        return resultContainer;
-    }
+    std::vector<sIndexSpec> definedIndexes() {
+        std::vector<sIndexSpec> result;
 
-    sQRes queryRoot;
-    queryRoot.id = 0;
+        // hierarchy, used by the joins and the parent lookups
+        for (int level = PATIENT_LEVEL; level <= IMAGE_LEVEL; ++level) {
+            sIndexSpec spec(static_cast<DB_LEVEL>(level), levelName(static_cast<DB_LEVEL>(level)) + "Index");
+            spec.columns.push_back("referenceId");
+            result.push_back(spec);
+        }
 
-    std::list< sQRes > patRes = query(findRequestList, queryLevel, PATIENT_LEVEL, queryRoot, resultContainer);
-    for(auto queryPat: patRes) {
-        std::list< sQRes > stdRes = query(findRequestList, queryLevel, STUDY_LEVEL, queryPat, resultContainer);
-        for(auto queryStd: stdRes) {
-            std::list< sQRes > serRes = query(findRequestList, queryLevel, SERIE_LEVEL, queryStd, resultContainer);
-            for(auto querySer: serRes) {
-                std::list< sQRes > imgRes = query(findRequestList, queryLevel, IMAGE_LEVEL, querySer, resultContainer);
-                for(auto queryImg: imgRes) {
-                    query(findRequestList, PATIENT_LEVEL, IMAGE_LEVEL, queryImg, resultContainer);
+        // matching keys of patient and study level queries, UNIQUE_KEY attributes (the UIDs)
+        // are already indexed through their UNIQUE column constraint
+        for (auto attr : definedAttribs()) {
+            if (attr.keyAttr == REQUIRED_KEY && attr.level <= STUDY_LEVEL) {
+                sIndexSpec spec(attr.level, levelName(attr.level) + getTagName(attr.tag) + "Index");
+                spec.columns.push_back(getTagName(attr.tag));
+                result.push_back(spec);
+
+                // date and time ranges
+                if (isIntegerAttribute(attr.tag)) {
+                    sIndexSpec integer(attr.level, levelName(attr.level) + getTagName(attr.tag) + integerSuffix + "Index");
+                    integer.columns.push_back(getTagName(attr.tag) + integerSuffix);
+                    result.push_back(integer);
                 }
             }
         }
-    }
-    return resultContainer;
-}
-
-//--------------------------------------------------------------------------------------------
-
-std::list< sQRes > DcmSQLiteDatabase::query(const std::list<DcmSmallDcmElm> & findRequestList, 
-    DB_LEVEL queryLevel, DB_LEVEL currentLevel, const sQRes & preResults, std::list< std::list<DcmSmallDcmElm> > & finalResuls) const
-{
-    std::list< sQRes > responseContainer;
 
-    if (queryLevel < currentLevel) {
-        finalResuls.push_back(preResults.resultList);
-        return responseContainer;
-    }
+        // patient lookup during ingest and the conflict target of its upsert
+        sIndexSpec patient(PATIENT_LEVEL, "patientIdentityUniqueIndex");
+        patient.columns.push_back(getTagName(DCM_PatientID));
+        patient.columns.push_back(getTagName(DCM_PatientName));
+        patient.unique = true;
+        result.push_back(patient);
 
-    std::vector <DcmTagKey> trackList;
-    std::vector < std::string > selectColumns;
-    std::vector < std::string > whereColumns;
-    std::vector < std::string > whereBindings;
-    std::vector < std::string > whereBindingNames;
+        // case-insensitive, prefix and wildcard matching of patient names
+        sIndexSpec patientName(PATIENT_LEVEL, "patientPatientNameUpperIndex");
+        patientName.columns.push_back(getTagName(DCM_PatientName) + upperSuffix);
+        result.push_back(patientName);
 
-    DcmSmallDcmElm modInStudyElm;
-    DcmSmallDcmElm numStudiesElm;
-    DcmSmallDcmElm numSeriesElm;
-    DcmSmallDcmElm charsetElm;
+        // covers the ModalitiesInStudy subqueries and modality filters
+        sIndexSpec modality(SERIE_LEVEL, "seriesModalityIndex");
+        modality.columns.push_back("referenceId");
+        modality.columns.push_back(getTagName(DCM_Modality));
+        result.push_back(modality);
 
-    for(auto e: findRequestList) {
+        return result;
+    }
 
-        if (tagLevel(e.XTag()) != currentLevel) {
-            continue;
+    // primary keys of recently inserted or looked up patients, studies and series, so that the
+    // instances of a series only cost their own INSERT. Rows are only deleted when duplicate
+    // patients are merged on upgrade, the keys stay valid unless a transaction is rolled back
+    class IdCache {
+    public:
+        explicit IdCache(size_t capacity) : capacity_(capacity) {}
+
+        bool find(const std::string& key, OFlonglong& id) {
+            static Metrics::Counter& hits = Metrics::counter("db_id_cache_total", {{"result", "hit"}});
+            static Metrics::Counter& misses = Metrics::counter("db_id_cache_total", {{"result", "miss"}});
+            std::unordered_map<std::string, sEntry>::iterator it = entries_.find(key);
+            if (it == entries_.end()) {
+                misses.add();
+                return false;
+            }
+            hits.add();
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            id = it->second.id;
+            return true;
         }
 
-        if (e.XTag() == DCM_SpecificCharacterSet) {
-            charsetElm = e;
-            continue;
+        void insert(const std::string& key, OFlonglong id) {
+            std::unordered_map<std::string, sEntry>::iterator it = entries_.find(key);
+            if (it != entries_.end()) {
+                it->second.id = id;
+                lru_.splice(lru_.begin(), lru_, it->second.lru);
+                return;
+            }
+            lru_.push_front(key);
+            sEntry entry = {id, lru_.begin()};
+            entries_[key] = entry;
+            if (entries_.size() > capacity_) {
+                entries_.erase(lru_.back());
+                lru_.pop_back();
+            }
         }
 
-        if (e.XTag() == DCM_ModalitiesInStudy) {
-            modInStudyElm = e;
-            continue;
+        void clear() {
+            entries_.clear();
+            lru_.clear();
         }
 
-        if (e.XTag() == DCM_NumberOfStudyRelatedSeries) {
-            numStudiesElm = e;
-            continue;
-        }
+    private:
+        struct sEntry {
+            OFlonglong id;
+            std::list<std::string>::iterator lru;
+        };
 
-        if (e.XTag() == DCM_NumberOfSeriesRelatedInstances) {
-            numSeriesElm = e;
-            continue;
-        }
+        size_t capacity_;
+        std::unordered_map<std::string, sEntry> entries_;
+        std::list<std::string> lru_;
+    };
 
-        if ( !e.valueField().empty() ) {
+    // entries per level, a few hundred studies are ingested at the same time at most
+    const size_t idCacheSize = 1024;
 
-            std::string whereStr = getTagName( e.XTag() );
-            std::string valueStr = e.valueField();
+    // bumped by DcmSQLiteDatabase::invalidateIdCaches(), connections clear their caches when it changed
+    std::atomic<unsigned> idCacheGeneration(0);
 
-            if (contains(valueStr, "*") || contains(valueStr, "?") || contains(valueStr, "^") || contains(valueStr, " ")) {
-                std::string whereColumnStr = whereStr + " LIKE UPPER( :" +  whereStr + " )";
-                std::string testStr = valueStr;
-                whereColumns.push_back(whereColumnStr);
-                replace(valueStr, std::string("*"), std::string("%"));
-                replace(valueStr, std::string("?"), std::string("_"));
-                whereBindings.push_back(valueStr);
-                whereBindingNames.push_back(std::string(":") + whereStr);
-            }
-            else if ( isDateOrTimeField(e.XTag()) && contains(valueStr, "-")) {
-                whereColumns.push_back(whereStr + std::string(" BETWEEN :" ) + whereStr + "1 AND :" + whereStr + "2");
-                whereBindings.push_back(firstp(valueStr));
-                whereBindings.push_back(secondp(valueStr));
-                whereBindingNames.push_back(std::string(":") + whereStr + "1");
-                whereBindingNames.push_back(std::string(":") + whereStr + "2");
-            }
-            else {
-                whereColumns.push_back(whereStr + std::string(" = :") + whereStr);
-                whereBindings.push_back(valueStr);
-                whereBindingNames.push_back(std::string(":") + whereStr);
-            }
-        }
+    // shards of the indexes created from now on, see DcmSQLiteDatabase::configureShards()
+    std::atomic<size_t> configuredShards(1);
 
-        selectColumns.push_back(getTagName( e.XTag() ));
-        trackList.push_back( e.XTag() );
-    }
+    // PRAGMAs of the connections opened from now on, see DcmSQLiteDatabase::configureTuning()
+    std::mutex tuningMutex;
+    DcmSQLiteTuning configuredTuning;
 
-    selectColumns.push_back("id");
-    whereColumns.push_back("referenceId = :referenceId");
-    whereBindings.push_back(std::to_string(preResults.id));
-    trackList.push_back(DcmTagKey());
- 
-    std::string prepare = std::string("SELECT ") + join(selectColumns, " , ") + std::string(" FROM ") + levelName(currentLevel) 
-        + std::string(" WHERE ") + join(whereColumns, " AND ");
+    DcmSQLiteTuning currentTuning()
+    {
+        std::lock_guard<std::mutex> lock(tuningMutex);
+        return configuredTuning;
+    }
 
-    sqlite3pp::query query(*d->db, prepare.c_str());
-    for (int i = 0; i < whereBindings.size(); ++i) {
-        const std::string bindValue = whereBindings.at(i);
-        if (i == whereBindings.size() -1) {
-            query.bind(":referenceId", std::stoi(bindValue));
+    // shard files whose schema a connection creates or created already, the connections to a shard
+    // whose schema is still being created wait for it on shardCreated
+    std::mutex shardMutex;
+    std::set<std::string> initializedShards;
+    std::set<std::string> creatingShards;
+    std::condition_variable shardCreated;
+
+    // how long a statement waits for a lock before it fails with SQLITE_BUSY, and how often an
+    // ingest transaction tries to get the write lock
+    const int busyTimeout = 5000;
+    const int busyAttempts = 3;
+
+    // backs off like sqlite3_busy_timeout(), 0 once busyTimeout ms have been waited
+    int busyWait(int count)
+    {
+        static const int delays[] = { 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+        static const int steps = sizeof(delays) / sizeof(delays[0]);
+        int waited = 0;
+        for (int i = 0; i < count; ++i) {
+            waited += delays[std::min(i, steps - 1)];
         }
-        else {
-            const std::string bindName = whereBindingNames.at(i);
-            query.bind(bindName.c_str(), bindValue, sqlite3pp::copy);
+        if (waited >= busyTimeout) {
+            return 0;
         }
+        const int delay = std::min(delays[std::min(count, steps - 1)], busyTimeout - waited);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+        return 1;
     }
 
-    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
-
-        std::list<DcmSmallDcmElm> responseList;
-        if (trackList.size() == selectColumns.size() ) {
-            for (int j = 0; j < selectColumns.size(); j++) {
-                if (j == selectColumns.size() - 1) {
-                    OFlonglong value = (*i).get<OFlonglong>(j);
-                    DcmSmallDcmElm newElem(trackList[j], std::to_string(value));
-                    responseList.push_back(newElem);
-                }
-                else {
-                    const char* value = (*i).get<char const*>(j);
-                    DcmSmallDcmElm newElem(trackList[j], value ? value : "");
-                    responseList.push_back(newElem);
-                }
-            }
-        }
-        else {
-            DCMNET_ERROR("track list doesn't match selection");
+    // FNV-1a, stable across platforms and runs
+    unsigned shardHash(const std::string& value)
+    {
+        unsigned hash = 2166136261U;
+        for (size_t i = 0; i < value.length(); ++i) {
+            hash ^= static_cast<unsigned char>(value[i]);
+            hash *= 16777619U;
         }
+        return hash;
+    }
 
-        sQRes res;
-        res.id = std::stoi(responseList.back().valueField());
-        responseList.pop_back();
+}
 
-        for (auto elm : preResults.resultList) {
-            responseList.push_back(elm);
-        }
 
-        bool discardResult = false;
+class DcmSQLiteDatabasePrivate {
+public:
+    DcmSQLiteDatabasePrivate() : patientIds(idCacheSize), studyIds(idCacheSize), seriesIds(idCacheSize), idCacheGeneration(::idCacheGeneration.load()),
+        nameSearch(false), readOnly(false), interned(false), shardIndex(0), shardCount(1) {}
 
-        int numberOfSeries = 0;
+    std::vector<DB_FindAttrExt> definedTags;
+    sqlite3pp::database* db;
+    bool initialized;
+    std::string storagePath;
+    std::map<std::string, sqlite3pp::query*> queries;
+    std::map<std::string, sqlite3pp::command*> commands;
+    // statements by the columns they bind, see insertatt() and openFind()
+    std::map<std::string, sqlite3pp::command*> insertShapes;
+    std::map<std::string, std::string> findShapes;
+    // keyed by PatientID and PatientName, and by the UIDs
+    IdCache patientIds;
+    IdCache studyIds;
+    IdCache seriesIds;
+    unsigned idCacheGeneration;
+    // the patient names are in the full text index patientNameSearch
+    bool nameSearch;
+    // opened with SQLITE_OPEN_READONLY, for the find and move path
+    bool readOnly;
+    // the image table keeps the values of isInternedAttribute() in the dictionary table
+    bool interned;
+    std::unordered_map<std::string, OFlonglong> internedIds;
+    size_t shardIndex;
+    size_t shardCount;
+    // connections to the other shards, opened by shard()
+    std::vector<DcmSQLiteDatabase*> shards;
+
+    void clearIdCaches() {
+        patientIds.clear();
+        studyIds.clear();
+        seriesIds.clear();
+        internedIds.clear();
+    }
 
-        if (charsetElm.XTag() == DCM_SpecificCharacterSet) {
-            DcmSmallDcmElm specificCharset(charsetElm.XTag(), "ISO_IR 192");
-            responseList.push_back(specificCharset);
+    void clearStatements() {
+        for (auto item : queries) {
+            delete item.second;
         }
-
-        if (modInStudyElm.XTag() == DCM_ModalitiesInStudy) {
-            std::vector<std::string> modalities = modalitiesInStudy(res.id, numberOfSeries);
-            if (!modInStudyElm.valueField().empty()) {
-                if (!contains( modalities, modInStudyElm.valueField())) {
-                    discardResult = true;
-                }
-            }
-            DcmSmallDcmElm modalitiesInStudy(modInStudyElm.XTag(), join(modalities, "\\"));
-            responseList.push_back(modalitiesInStudy);
+        for (auto item : commands) {
+            delete item.second;
         }
+        queries.clear();
+        commands.clear();
+        insertShapes.clear();
+        findShapes.clear();
+    }
+};
 
-        if (numStudiesElm.XTag() == DCM_NumberOfStudyRelatedSeries) {
-            if (numberOfSeries == 0)
-                modalitiesInStudy(res.id, numberOfSeries);
-            std::string numSeriesString;
-            numSeriesString = std::to_string(numberOfSeries);
-            if (!numStudiesElm.valueField().empty()) {
-                if (numSeriesString != numStudiesElm.valueField()) {
-                    discardResult = true;
-                }
-            }
-            DcmSmallDcmElm numberOfStudyRelatedSeries(numStudiesElm);
-            numberOfStudyRelatedSeries.setValue(numSeriesString);
-            responseList.push_back(numberOfStudyRelatedSeries);
-        }
+//--------------------------------------------------------------------------------------------
 
-        if (numSeriesElm.XTag() == DCM_NumberOfSeriesRelatedInstances) {
-            std::string numberOfInstancesInSeries;
-            int nb = numSeriesInstances(res.id);
-            numberOfInstancesInSeries = std::to_string(nb);
-            if (!numSeriesElm.valueField().empty()) {
-                if (numberOfInstancesInSeries != numSeriesElm.valueField()) {
-                    discardResult = true;
-                }
-            }
-            DcmSmallDcmElm numberOfSeriesRelatedInstances(numSeriesElm);
-            numberOfSeriesRelatedInstances.setValue(numberOfInstancesInSeries);
-            responseList.push_back(numberOfSeriesRelatedInstances);
-        }
+DcmSQLiteDatabase::DcmSQLiteDatabase(const OFFilename& path, bool createSchema, bool readOnly) : d(new DcmSQLiteDatabasePrivate)
+{
+    d->readOnly = readOnly;
+    open(path, createSchema && !readOnly);
+    if (d->initialized) {
+        const size_t stored = storedShardCount();
+        d->shardCount = stored > 0 ? stored : 1;
+    }
+    d->shards.resize(d->shardCount, NULL);
+}
 
-        if (!discardResult) {
-            res.resultList = responseList;
-            responseContainer.push_back(res);
-        }
+//--------------------------------------------------------------------------------------------
 
-    }
-    return responseContainer;
+DcmSQLiteDatabase::DcmSQLiteDatabase(const OFFilename& path, size_t shard, size_t shardCount, bool createSchema, bool readOnly) :
+    d(new DcmSQLiteDatabasePrivate)
+{
+    d->shardIndex = shard;
+    d->shardCount = shardCount;
+    d->readOnly = readOnly;
+    open(path, createSchema && !readOnly);
+    d->shards.resize(d->shardCount, NULL);
 }
 
 //--------------------------------------------------------------------------------------------
 
-std::vector<std::string> DcmSQLiteDatabase::modalitiesInStudy(long long studyReferenceId, int& seriesSearched) const
+void DcmSQLiteDatabase::open(const OFFilename& path, bool createSchema)
 {
-    seriesSearched = 0;
-    std::vector<std::string> resultString;
-    std::set<std::string> resultSet;
-   
-    std::string prepare = "SELECT " + getTagName(DCM_Modality) + " FROM " 
-        + levelName(SERIE_LEVEL) + " WHERE referenceId = :refId";
+     d->storagePath = path.getCharPointer();
+     std::string storage(d->storagePath);
+     if (d->shardIndex == 0) {
+         storage.append("/image.db");
+     }
+     else {
+         storage.append("/image-" + std::to_string(d->shardIndex) + ".db");
+     }
+     d->definedTags = definedAttribs();
+     try {
+         d->db = new sqlite3pp::database(storage.c_str(), d->readOnly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+     }
+     catch (std::exception& e) {
+         // a read-only connection cannot create the file
+         DCMNET_ERROR("Cannot open " << storage << ": " << e.what());
+         d->db = new sqlite3pp::database();
+         d->initialized = false;
+         return;
+     }
+     d->initialized = configureConnection() && (!createSchema || createTables());
+     d->nameSearch = d->initialized && nameSearchAvailable() && hasNameSearch();
+     d->interned = d->initialized && hasInternedColumns();
+}
 
-    sqlite3pp::query query(*d->db, prepare.c_str());
-    query.bind(":refId", studyReferenceId);
+//--------------------------------------------------------------------------------------------
 
-    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
-        for (int j = 0; j < query.column_count(); ++j) {
-            seriesSearched++;
-            resultSet.insert((*i).get<char const*>(j));
+DcmSQLiteDatabase::~DcmSQLiteDatabase()
+{
+    for (auto shard : d->shards) {
+        if (shard != this) {
+            delete shard;
         }
     }
-
-    for(auto modality: resultSet) {
-        resultString.push_back(modality);
-    }
-    return resultString;
+    // statements must be finalized before the connection can be closed
+    d->clearStatements();
+    delete d->db;
+    delete d;
+    d = NULL;
 }
 
 //--------------------------------------------------------------------------------------------
 
-int DcmSQLiteDatabase::numSeriesInstances(long long seriesReferenceId) const
+const std::string& DcmSQLiteDatabase::storagePath() const
 {
-    int result = 0;
-    std::string prepare = "SELECT " + getTagName(DCM_SOPInstanceUID) + " FROM "
-        + levelName(IMAGE_LEVEL) + " WHERE referenceId = :refId";
-
-    sqlite3pp::query query(*d->db, prepare.c_str());
-    query.bind(":refId", seriesReferenceId);
-
-    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
-        result++;
-    }
-    return result;
+    return d->storagePath;
 }
 
 //--------------------------------------------------------------------------------------------
 
-bool DcmSQLiteDatabase::isDateField(const DcmTagKey& key) const
+bool DcmSQLiteDatabase::isInitialized() const
 {
-    DcmTag t(key);
-    return t.getVR().getEVR() == EVR_DA;
+    return d->initialized;
 }
 
-//------------------------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------------
 
-bool DcmSQLiteDatabase::isTimeField(const DcmTagKey& key) const
+size_t DcmSQLiteDatabase::shardCount() const
 {
-    DcmTag t(key);
-    return t.getVR().getEVR() == EVR_TM;
+    return d->shardCount;
 }
 
-//------------------------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------------
 
-bool DcmSQLiteDatabase::isDateOrTimeField(const DcmTagKey& key) const
+size_t DcmSQLiteDatabase::shardIndex() const
 {
-    DcmTag t(key);
-    DcmEVR evr = t.getVR().getEVR();
-    return  (evr == EVR_DA || evr == EVR_DT || evr == EVR_TM);
+    return d->shardIndex;
 }
 
 //--------------------------------------------------------------------------------------------
 
-std::string DcmSQLiteDatabase::firstp( const std::string& value ) const
+size_t DcmSQLiteDatabase::shardOf(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList) const
 {
-    std::size_t pos = value.find("-");
-    if (pos == std::string::npos) {
-        DCMNET_WARN("no range sign found");
-        return value;
+    if (d->shardCount <= 1) {
+        return 0;
+    }
+    // series and instances stay with their study
+    std::string studyInstanceUID;
+    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >::const_iterator iter =
+        keyValueList.find(DB_FindAttrExt(DCM_StudyInstanceUID, STUDY_LEVEL, UNIQUE_KEY));
+    if (iter != keyValueList.end()) {
+        studyInstanceUID = iter->second;
     }
-    return value.substr(0, pos-1);
+    return shardHash(studyInstanceUID) % d->shardCount;
 }
 
 //--------------------------------------------------------------------------------------------
 
-std::string DcmSQLiteDatabase::secondp( const std::string& value ) const
+void DcmSQLiteDatabase::trimStatementCache(size_t maxStatements)
 {
-    std::size_t pos = value.find("-");
-    if (pos == std::string::npos) {
-        DCMNET_WARN("no range sign found");
-        return value;
+    if (d->queries.size() + d->commands.size() > maxStatements) {
+        d->clearStatements();
+    }
+    for (auto shard : d->shards) {
+        if (shard != NULL) {
+            shard->trimStatementCache(maxStatements);
+        }
     }
-    return value.substr(pos + 1, value.length()-1);
 }
 
 //--------------------------------------------------------------------------------------------
 
-DB_LEVEL DcmSQLiteDatabase::tagLevel( DcmTagKey key ) const
+sqlite3pp::query& DcmSQLiteDatabase::cachedQuery(const std::string& sql) const
 {
-    for(auto item: d->definedTags) {
-        if (item.tag == key)
-            return item.level;
+    std::map<std::string, sqlite3pp::query*>::iterator it = d->queries.find(sql);
+    if (it == d->queries.end()) {
+        it = d->queries.insert(std::make_pair(sql, new sqlite3pp::query(*d->db, sql.c_str()))).first;
     }
-    DCMNET_WARN("tag not registered");
-    return PATIENT_LEVEL;
+    // every parameter is bound again by the caller, resetting is enough
+    it->second->reset();
+    return *it->second;
 }
 
 //--------------------------------------------------------------------------------------------
 
-std::vector<DB_FindAttrExt> DcmSQLiteDatabase::definedAttributes() const
+sqlite3pp::command& DcmSQLiteDatabase::cachedCommand(const std::string& sql) const
 {
-    return d->definedTags;
+    std::map<std::string, sqlite3pp::command*>::iterator it = d->commands.find(sql);
+    if (it == d->commands.end()) {
+        it = d->commands.insert(std::make_pair(sql, new sqlite3pp::command(*d->db, sql.c_str()))).first;
+    }
+    it->second->reset();
+    return *it->second;
 }
 
 //--------------------------------------------------------------------------------------------
 
-OFCondition DcmSQLiteDatabase::insertMetaData(DcmDataset* dataset, const OFString& filename)
+sqlite3pp::query* DcmSQLiteDatabase::checkoutQuery(const std::string& sql) const
 {
-    if (!d->initialized) {
-        DCMNET_WARN("database not initialized");
-        return EC_IllegalParameter;
+    // the statement leaves the cache while a cursor owns it, so that
+    // cachedQuery() never resets a statement which is still stepping
+    sqlite3pp::query* query = NULL;
+    std::map<std::string, sqlite3pp::query*>::iterator it = d->queries.find(sql);
+    if (it != d->queries.end()) {
+        query = it->second;
+        d->queries.erase(it);
+        query->reset();
     }
+    else {
+        query = new sqlite3pp::query(*d->db, sql.c_str());
+    }
+    return query;
+}
 
-    OFCondition status = EC_Normal;
+//--------------------------------------------------------------------------------------------
 
-    dataset->convertToUTF8();
-    DcmXfer original_xfer(dataset->getOriginalXfer());
+void DcmSQLiteDatabase::checkinQuery(const std::string& sql, sqlite3pp::query* query) const
+{
+    query->reset();
+    if (!d->queries.insert(std::make_pair(sql, query)).second) {
+        delete query;
+    }
+}
 
-    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare > insertMap;
+//--------------------------------------------------------------------------------------------
 
-    for (int i = 0; i < d->definedTags.size(); ++i) {
+// position of a match in the order of the pages. Patients by their identity, PatientID and
+// PatientName, which the shards have in common. Studies and below by the integer StudyDate unless
+// the study has none, the shard and the ids from the study down to the query level
+struct DcmSQLiteFindPage {
+    DcmSQLiteFindPage() : named(false), dated(false), date(0), shard(0) {}
+
+    std::string patientID;
+    bool named;
+    std::string patientName;
+    bool dated;
+    long long date;
+    size_t shard;
+    std::vector<long long> ids;
+
+    // the ids a position at queryLevel has
+    static size_t idCount(DB_LEVEL queryLevel) {
+        return queryLevel >= STUDY_LEVEL ? queryLevel - STUDY_LEVEL + 1 : 0;
+    }
 
-        OFCondition ec = EC_Normal;
-        const char* strPtr = NULL;
-        Uint16 intPtr = 0;
-        ec = dataset->findAndGetString(d->definedTags[i].tag, strPtr);
-        if ((ec == EC_Normal) && (strPtr != NULL)) {
-            DB_FindAttrExt tag = d->definedTags[i];
-            insertMap[tag] = std::string(strPtr);
-        }
-        else {
-            ec = dataset->findAndGetUint16(d->definedTags[i].tag, intPtr);
-            if ((ec == EC_Normal) && (intPtr != 0)) {
-                DB_FindAttrExt tag = d->definedTags[i];
-                insertMap[tag] = std::to_string(intPtr);
+    // before other in the order of the pages: patients by identity, a missing name first, studies
+    // newest first with those without a date last, then the higher shard and ids
+    bool before(const DcmSQLiteFindPage& other, DB_LEVEL queryLevel) const {
+        if (queryLevel == PATIENT_LEVEL) {
+            if (patientID != other.patientID) {
+                return patientID < other.patientID;
             }
+            if (named != other.named) {
+                return !named;
+            }
+            return patientName < other.patientName;
+        }
+        if (dated != other.dated) {
+            return dated;
+        }
+        if (dated && date != other.date) {
+            return date > other.date;
+        }
+        if (shard != other.shard) {
+            return shard > other.shard;
         }
+        return ids > other.ids;
     }
 
-    // add filename to private field
-    insertMap[DB_FindAttrExt(DCM_PrivateFileName, IMAGE_LEVEL, OPTIONAL_KEY)] = filename.c_str();
+    // <level>.<hex PatientID>.<hex PatientName or n> or <level>.<date or n>.<shard>.<id>..., only meant
+    // to be handed back
+    std::string token(DB_LEVEL queryLevel) const {
+        std::string result = std::to_string(static_cast<int>(queryLevel));
+        if (queryLevel == PATIENT_LEVEL) {
+            return result + "." + hex(patientID) + "." + (named ? hex(patientName) : std::string("n"));
+        }
+        result += "." + (dated ? std::to_string(date) : std::string("n")) + "." + std::to_string(shard);
+        for (long long id : ids) {
+            result += "." + std::to_string(id);
+        }
+        return result;
+    }
+
+    bool parse(const std::string& token, DB_LEVEL queryLevel) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        for (size_t dot = token.find('.'); ; dot = token.find('.', start)) {
+            parts.push_back(token.substr(start, dot == std::string::npos ? std::string::npos : dot - start));
+            if (dot == std::string::npos) {
+                break;
+            }
+            start = dot + 1;
+        }
+        if (parts[0] != std::to_string(static_cast<int>(queryLevel))) {
+            return false;
+        }
+        if (queryLevel == PATIENT_LEVEL) {
+            named = parts.size() == 3 && parts[2] != "n";
+            return parts.size() == 3 && unhex(parts[1], patientID) && (!named || unhex(parts[2], patientName));
+        }
+        long long value = 0;
+        if (parts.size() != 3 + idCount(queryLevel) || !number(parts[2], value)) {
+            return false;
+        }
+        dated = parts[1] != "n";
+        if (dated && !number(parts[1], date)) {
+            return false;
+        }
+        shard = static_cast<size_t>(value);
+        ids.clear();
+        for (size_t i = 3; i < parts.size(); ++i) {
+            if (!number(parts[i], value)) {
+                return false;
+            }
+            ids.push_back(value);
+        }
+        return true;
+    }
+
+private:
+    static bool number(const std::string& text, long long& value) {
+        if (text.empty() || text.size() > 18 || text.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        value = std::stoll(text);
+        return true;
+    }
+
+    static std::string hex(const std::string& text) {
+        static const char digits[] = "0123456789abcdef";
+        std::string result;
+        for (unsigned char c : text) {
+            result += digits[c >> 4];
+            result += digits[c & 15];
+        }
+        return result;
+    }
+
+    static bool unhex(const std::string& text, std::string& value) {
+        if (text.size() % 2 != 0 || text.find_first_not_of("0123456789abcdef") != std::string::npos) {
+            return false;
+        }
+        value.clear();
+        for (size_t i = 0; i < text.size(); i += 2) {
+            value += static_cast<char>(std::stoi(text.substr(i, 2), NULL, 16));
+        }
+        return true;
+    }
+};
+
+//--------------------------------------------------------------------------------------------
+
+class DcmSQLiteFindCursorPrivate {
+public:
+    DcmSQLiteFindCursorPrivate() : db(NULL), query(NULL), started(false), charsetRequested(false), part(0), unique(false),
+        paged(false), level(PATIENT_LEVEL), limit(0), returned(0), merge(false), primed(false) {}
+
+    const DcmSQLiteDatabase* db;
+    std::string sql;
+    sqlite3pp::query* query;
+    sqlite3pp::query::iterator row;
+    bool started;
+    std::vector<DcmTagKey> trackList;
+    bool charsetRequested;
+    // cursors of the shards, read one after the other
+    std::vector<DcmSQLiteFindCursor*> parts;
+    size_t part;
+    // a patient with studies on several shards is returned once
+    bool unique;
+    std::set<std::string> seen;
+    // a page: the position of the last match returned and at most limit of them
+    bool paged;
+    DB_LEVEL level;
+    DcmSQLiteFindPage position;
+    size_t limit;
+    size_t returned;
+    // the parts are merged by the position of their next match instead of read one after the other
+    bool merge;
+    bool primed;
+    std::vector< std::list<DcmSmallDcmElm> > heads;
+    std::vector<bool> headed;
+};
+
+//--------------------------------------------------------------------------------------------
+
+DcmSQLiteFindCursor::DcmSQLiteFindCursor(DcmSQLiteFindCursorPrivate* priv) : d(priv)
+{
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmSQLiteFindCursor::~DcmSQLiteFindCursor()
+{
+    close();
+    delete d;
+    d = NULL;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteFindCursor::next(std::list<DcmSmallDcmElm>& responseList)
+{
+    if (d->paged && d->limit > 0 && d->returned >= d->limit) {
+        responseList.clear();
+        close();
+        return false;
+    }
+    if (!fetch(responseList)) {
+        return false;
+    }
+    ++d->returned;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::string DcmSQLiteFindCursor::position() const
+{
+    return d->paged && d->returned > 0 ? d->position.token(d->level) : std::string();
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteFindCursor::fetch(std::list<DcmSmallDcmElm>& responseList)
+{
+    responseList.clear();
+    if (d->merge) {
+        if (!d->primed) {
+            d->heads.resize(d->parts.size());
+            d->headed.resize(d->parts.size());
+            for (size_t i = 0; i < d->parts.size(); ++i) {
+                d->headed[i] = d->parts[i]->next(d->heads[i]);
+            }
+            d->primed = true;
+        }
+        for (;;) {
+            size_t first = d->parts.size();
+            for (size_t i = 0; i < d->parts.size(); ++i) {
+                if (d->headed[i] && (first == d->parts.size() || d->parts[i]->d->position.before(d->parts[first]->d->position, d->level))) {
+                    first = i;
+                }
+            }
+            if (first == d->parts.size()) {
+                close();
+                return false;
+            }
+            // a patient with studies on several shards comes from each of them one after the other
+            const bool repeated = d->level == PATIENT_LEVEL && d->returned > 0
+                && !d->position.before(d->parts[first]->d->position, d->level);
+            responseList.swap(d->heads[first]);
+            d->position = d->parts[first]->d->position;
+            d->headed[first] = d->parts[first]->next(d->heads[first]);
+            if (repeated) {
+                continue;
+            }
+            if (!d->unique) {
+                return true;
+            }
+            std::string key;
+            for (auto& element : responseList) {
+                key += element.valueField();
+                key += '\0';
+            }
+            if (d->seen.insert(key).second) {
+                return true;
+            }
+        }
+    }
+    while (d->part < d->parts.size()) {
+        if (!d->parts[d->part]->next(responseList)) {
+            ++d->part;
+            continue;
+        }
+        d->position = d->parts[d->part]->d->position;
+        if (!d->unique) {
+            return true;
+        }
+        std::string key;
+        for (auto& element : responseList) {
+            key += element.valueField();
+            key += '\0';
+        }
+        if (d->seen.insert(key).second) {
+            return true;
+        }
+    }
+    responseList.clear();
+
+    if (d->query == NULL) {
+        return false;
+    }
+
+    try {
+        if (!d->started) {
+            d->row = d->query->begin();
+            d->started = true;
+        }
+        else {
+            ++d->row;
+        }
+    }
+    catch (std::exception& e) {
+        DCMNET_ERROR("find cursor failed: " << e.what());
+        close();
+        return false;
+    }
+
+    if (d->row == d->query->end()) {
+        close();
+        return false;
+    }
+
+    for (size_t j = 0; j < d->trackList.size(); j++) {
+        const char* value = (*d->row).get<char const*>(static_cast<int>(j));
+        std::string valueStr(value ? value : "");
+
+        if (d->trackList[j] == DCM_ModalitiesInStudy) {
+            // sorted and without duplicates
+            std::set<std::string> modalities;
+            split('\\', modalities, valueStr);
+            modalities.erase(std::string());
+            valueStr = join(modalities, "\\");
+        }
+        responseList.push_back(DcmSmallDcmElm(d->trackList[j], valueStr));
+    }
+
+    if (d->charsetRequested) {
+        responseList.push_back(DcmSmallDcmElm(DCM_SpecificCharacterSet, "ISO_IR 192"));
+    }
+
+    if (d->paged) {
+        // selected after the id of the query level, see findStatement()
+        int column = static_cast<int>(d->trackList.size()) + 1;
+        if (d->level == PATIENT_LEVEL) {
+            const char* id = (*d->row).get<char const*>(column);
+            const char* name = (*d->row).get<char const*>(column + 1);
+            d->position.patientID = id != NULL ? id : "";
+            d->position.named = name != NULL;
+            d->position.patientName = name != NULL ? name : "";
+        }
+        else {
+            d->position.dated = (*d->row).column_type(column) != SQLITE_NULL;
+            d->position.date = d->position.dated ? (*d->row).get<long long>(column) : 0;
+            ++column;
+        }
+        d->position.shard = d->db->shardIndex();
+        d->position.ids.resize(DcmSQLiteFindPage::idCount(d->level));
+        for (size_t i = 0; i < d->position.ids.size(); ++i) {
+            d->position.ids[i] = (*d->row).get<long long>(column++);
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmSQLiteFindCursor::close()
+{
+    for (auto part : d->parts) {
+        delete part;
+    }
+    d->parts.clear();
+    d->seen.clear();
+    d->heads.clear();
+    d->headed.clear();
+    if (d->query != NULL) {
+        d->db->checkinQuery(d->sql, d->query);
+        d->query = NULL;
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::configureConnection()
+{
+    // WAL lets readers proceed on their snapshot while an association is storing, writers wait
+    // for the lock instead of failing immediately with SQLITE_BUSY
+    Metrics::Counter& waits = Metrics::counter("db_busy_waits_total", {{"connection", d->readOnly ? "read" : "write"}});
+    d->db->set_busy_handler([&waits](int count) -> int {
+        if (count == 0) {
+            waits.add();
+        }
+        return busyWait(count);
+    });
+    const DcmSQLiteTuning tuning = currentTuning();
+    if (tuning.cacheSize > 0) {
+        // negative for KiB instead of pages
+        d->db->execute(("PRAGMA cache_size=-" + std::to_string(static_cast<long long>(tuning.cacheSize) * 1024) + ";").c_str());
+    }
+    if (tuning.mmapSize > 0) {
+        d->db->execute(("PRAGMA mmap_size=" + std::to_string(static_cast<long long>(tuning.mmapSize) << 20) + ";").c_str());
+    }
+    if (tuning.tempStore != "default") {
+        d->db->execute(("PRAGMA temp_store=" + tuning.tempStore + ";").c_str());
+    }
+    if (d->readOnly) {
+        // the journal mode is kept in the file, set by the connections writing it
+        return true;
+    }
+    // only take effect on a new index, before its first table
+    if (tuning.pageSize > 0) {
+        d->db->execute(("PRAGMA page_size=" + std::to_string(tuning.pageSize) + ";").c_str());
+    }
+    d->db->execute("PRAGMA auto_vacuum=INCREMENTAL;");
+    if (d->db->execute(("PRAGMA journal_mode=" + tuning.journalMode + ";").c_str()) != 0) {
+        DCMNET_ERROR("Failed to set journal mode " << tuning.journalMode);
+        return false;
+    }
+    d->db->execute(("PRAGMA synchronous=" + tuning.synchronous + ";").c_str());
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmSQLiteDatabase::configureShards(size_t count)
+{
+    configuredShards = count > 0 ? count : 1;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::configureTuning(const DcmSQLiteTuning& options, std::string& error)
+{
+    // unset modes keep the defaults
+    DcmSQLiteTuning tuning = options;
+    const DcmSQLiteTuning defaults;
+    tuning.journalMode = !tuning.journalMode.empty() ? tuning.journalMode : defaults.journalMode;
+    tuning.synchronous = !tuning.synchronous.empty() ? tuning.synchronous : defaults.synchronous;
+    tuning.tempStore = !tuning.tempStore.empty() ? tuning.tempStore : defaults.tempStore;
+    // the values end up in PRAGMA statements, only the known ones are taken
+    static const std::set<std::string> journalModes = { "wal", "truncate", "delete" };
+    static const std::set<std::string> synchronousModes = { "off", "normal", "full", "extra" };
+    static const std::set<std::string> tempStores = { "default", "file", "memory" };
+    if (tuning.cacheSize < 0 || tuning.mmapSize < 0) {
+        error = "cacheSize and mmapSize must not be negative";
+    }
+    else if (tuning.pageSize != 0 && (tuning.pageSize < 512 || tuning.pageSize > 65536 || (tuning.pageSize & (tuning.pageSize - 1)) != 0)) {
+        error = "pageSize must be a power of two from 512 to 65536";
+    }
+    else if (journalModes.count(tuning.journalMode) == 0) {
+        error = "journalMode must be wal, truncate or delete";
+    }
+    else if (synchronousModes.count(tuning.synchronous) == 0) {
+        error = "synchronous must be off, normal, full or extra";
+    }
+    else if (tempStores.count(tuning.tempStore) == 0) {
+        error = "tempStore must be default, file or memory";
+    }
+    else {
+        std::lock_guard<std::mutex> lock(tuningMutex);
+        configuredTuning = tuning;
+        return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmSQLiteDatabase* DcmSQLiteDatabase::shard(size_t index) const
+{
+    if (index == d->shardIndex) {
+        return const_cast<DcmSQLiteDatabase*>(this);
+    }
+    if (index >= d->shards.size()) {
+        return NULL;
+    }
+
+    DcmSQLiteDatabase*& connection = d->shards[index];
+    if (connection == NULL) {
+        // like the pool, only the first connection to a shard creates its schema
+        const std::string file = d->storagePath + "/image-" + std::to_string(index) + ".db";
+        bool createSchema = false;
+        {
+            std::unique_lock<std::mutex> lock(shardMutex);
+            shardCreated.wait(lock, [&file]() { return creatingShards.count(file) == 0; });
+            if (!d->readOnly) {
+                createSchema = initializedShards.insert(file).second;
+                if (createSchema) {
+                    creatingShards.insert(file);
+                }
+            }
+        }
+        connection = new DcmSQLiteDatabase(OFFilename(d->storagePath.c_str()), index, d->shardCount, createSchema, d->readOnly);
+        if (createSchema) {
+            std::lock_guard<std::mutex> lock(shardMutex);
+            if (!connection->isInitialized()) {
+                initializedShards.erase(file);
+            }
+            creatingShards.erase(file);
+            shardCreated.notify_all();
+        }
+        if (!connection->isInitialized()) {
+            DCMNET_ERROR("Cannot open shard " << index << " of the index of " << d->storagePath);
+            delete connection;
+            connection = NULL;
+        }
+    }
+    return connection;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::string DcmSQLiteDatabase::findStatement(const std::vector<DcmTagKey>& trackList, const std::vector<char>& matchList,
+    DB_LEVEL queryLevel, char page) const
+{
+    std::vector < std::string > selectColumns;
+    std::vector < std::string > fromTables;
+    std::vector < std::string > orderColumns;
+    std::vector < std::string > whereColumns;
+
+    for (int level = PATIENT_LEVEL; level <= queryLevel; ++level) {
+        const std::string& table = levelName(static_cast<DB_LEVEL>(level));
+        if (level == PATIENT_LEVEL) {
+            fromTables.push_back(table);
+            whereColumns.push_back(table + ".referenceId = 0");
+        }
+        else {
+            const std::string& parent = levelName(static_cast<DB_LEVEL>(level - 1));
+            fromTables.push_back("JOIN " + table + " ON " + table + ".referenceId = " + parent + ".id");
+        }
+        orderColumns.push_back(table + ".id");
+    }
+
+    for (size_t i = 0; i < trackList.size(); ++i) {
+        const DcmTagKey& tag = trackList[i];
+        const std::string whereStr = getTagName(tag);
+        const std::string& table = levelName(tagLevel(tag));
+        std::string columnStr;
+        // person names are matched on their uppercase copy
+        std::string matchStr;
+        const bool interned = d->interned && isInternedAttribute(tag);
+
+        if (isAggregateField(tag)) {
+            const std::string fallback = (tag == DCM_ModalitiesInStudy) ? "" : "0";
+            columnStr = "COALESCE(" + table + "." + whereStr + ", '" + fallback + "')";
+            matchStr = columnStr;
+        }
+        else if (interned) {
+            // matched on the ids of the dictionary values which match
+            columnStr = "(SELECT value FROM dictionary WHERE id = " + table + "." + whereStr + ")";
+            matchStr = table + "." + whereStr;
+        }
+        else {
+            columnStr = table + "." + whereStr;
+            matchStr = isNameAttribute(tag) ? columnStr + upperSuffix : columnStr;
+        }
+
+        switch (matchList[i]) {
+        case AggregateMatch:
+            if (tag == DCM_ModalitiesInStudy) {
+                // whole values of the backslash separated list, "US" does not match "IVUS"
+                whereColumns.push_back("instr('\\' || " + columnStr + " || '\\', '\\' || :" + whereStr + " || '\\') > 0");
+            }
+            else {
+                whereColumns.push_back(columnStr + " = :" + whereStr);
+            }
+            break;
+        case WildcardMatch:
+            if (interned) {
+                whereColumns.push_back(matchStr + " IN (SELECT id FROM dictionary WHERE value GLOB :" + whereStr + ")");
+            }
+            else {
+                whereColumns.push_back(matchStr + " GLOB :" + whereStr);
+            }
+            break;
+        case PrefixMatch:
+            if (interned) {
+                whereColumns.push_back(matchStr + " IN (SELECT id FROM dictionary WHERE value >= :" + whereStr + "1 AND value < :" + whereStr + "2)");
+            }
+            else {
+                whereColumns.push_back(matchStr + " >= :" + whereStr + "1 AND " + matchStr + " < :" + whereStr + "2");
+            }
+            break;
+        case SearchMatch:
+            // the index finds the names with a word starting with the term, folding case and
+            // diacritics, GLOB keeps the exact matches among them
+            whereColumns.push_back(table + ".id IN (SELECT rowid FROM patientNameSearch WHERE patientNameSearch MATCH :"
+                + whereStr + "1) AND " + matchStr + " GLOB :" + whereStr + "2");
+            break;
+        case RangeMatch:
+            // the text bindings take the INTEGER affinity of the column
+            whereColumns.push_back(columnStr + integerSuffix + " BETWEEN :" + whereStr + "1 AND :" + whereStr + "2");
+            break;
+        case IntegerMatch:
+            whereColumns.push_back(columnStr + integerSuffix + " = :" + whereStr);
+            break;
+        case TextRangeMatch:
+            whereColumns.push_back(columnStr + std::string(" BETWEEN :" ) + whereStr + "1 AND :" + whereStr + "2");
+            break;
+        case ValueMatch:
+            if (interned) {
+                whereColumns.push_back(matchStr + " = (SELECT id FROM dictionary WHERE value = :" + whereStr + ")");
+            }
+            else {
+                whereColumns.push_back(matchStr + std::string(" = :") + whereStr);
+            }
+            break;
+        default:
+            break;
+        }
+
+        selectColumns.push_back(columnStr);
+    }
+
+    // keep at least one column so that the statement stays valid for charset only requests
+    selectColumns.push_back(levelName(queryLevel) + ".id");
+
+    std::string limit;
+    if (page != NoPage) {
+        // the position of each row follows, the keyset continues after the one of the token. The order
+        // is the one of an index, so a page reads no more rows than it returns. The unary + keeps the
+        // planner from starting at the patients by their referenceId, which all of them share
+        orderColumns.clear();
+        whereColumns.front() = "+" + whereColumns.front();
+        if (queryLevel == PATIENT_LEVEL) {
+            // patients without a PatientID are not paged, a NULL does not compare
+            const std::string id = levelName(PATIENT_LEVEL) + "." + getTagName(DCM_PatientID);
+            const std::string name = levelName(PATIENT_LEVEL) + "." + getTagName(DCM_PatientName);
+            selectColumns.push_back(id);
+            selectColumns.push_back(name);
+            orderColumns.push_back(id);
+            orderColumns.push_back(name);
+            whereColumns.push_back(id + " IS NOT NULL");
+            if (page == NamedPage) {
+                whereColumns.push_back("(" + id + ", " + name + ") > (:pagePatientID, :pagePatientName)");
+            }
+            else if (page == UnnamedPage) {
+                whereColumns.push_back(id + " >= :pagePatientID AND (" + id + " > :pagePatientID OR " + name + " IS NOT NULL)");
+            }
+        }
+        else {
+            std::vector<std::string> keyColumns;
+            std::vector<std::string> keyBindings;
+            const std::string date = levelName(STUDY_LEVEL) + "." + getTagName(DCM_StudyDate) + integerSuffix;
+            selectColumns.push_back(date);
+            orderColumns.push_back(date + " DESC");
+            if (page == DatedPage) {
+                keyColumns.push_back(date);
+                keyBindings.push_back(":pageDate");
+            }
+            else if (page == UndatedPage) {
+                whereColumns.push_back(date + " IS NULL");
+            }
+            for (int level = STUDY_LEVEL; level <= queryLevel; ++level) {
+                const std::string id = levelName(static_cast<DB_LEVEL>(level)) + ".id";
+                selectColumns.push_back(id);
+                orderColumns.push_back(id + " DESC");
+                keyColumns.push_back(id);
+                keyBindings.push_back(":pageId" + std::to_string(level - STUDY_LEVEL));
+            }
+            if (page == DatedPage || page == UndatedPage) {
+                whereColumns.push_back("(" + join(keyColumns, ", ") + ") < (" + join(keyBindings, ", ") + ")");
+            }
+        }
+        limit = " LIMIT :pageLimit";
+    }
+
+    return std::string("SELECT ") + join(selectColumns, " , ") + std::string(" FROM ") + join(fromTables, " ")
+        + std::string(" WHERE ") + join(whereColumns, " AND ") + std::string(" ORDER BY ") + join(orderColumns, " , ") + limit;
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmSQLiteFindCursor* DcmSQLiteDatabase::openFind(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel) const
+{
+    if (d->shardCount <= 1) {
+        return openShardFind(findRequestList, queryLevel);
+    }
+
+    // the matches of the shards one after the other, each in the order of its own rows
+    DcmSQLiteFindCursorPrivate* cursor = new DcmSQLiteFindCursorPrivate;
+    cursor->unique = queryLevel == PATIENT_LEVEL;
+    DcmSQLiteFindCursor* merged = new DcmSQLiteFindCursor(cursor);
+    for (size_t i = 0; i < d->shardCount; ++i) {
+        DcmSQLiteDatabase* connection = shard(i);
+        DcmSQLiteFindCursor* part = connection != NULL ? connection->openShardFind(findRequestList, queryLevel) : NULL;
+        if (part == NULL) {
+            delete merged;
+            return NULL;
+        }
+        cursor->parts.push_back(part);
+    }
+    return merged;
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmSQLiteFindCursor* DcmSQLiteDatabase::openFindPage(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel,
+    size_t limit, const std::string& after) const
+{
+    DcmSQLiteFindPage position;
+    if (!after.empty() && (!position.parse(after, queryLevel) || (queryLevel > PATIENT_LEVEL && position.shard >= d->shardCount))) {
+        DCMNET_WARN("invalid page token " << after);
+        return NULL;
+    }
+
+    // the pages of the shards are merged, each shard continues after the position of the token in
+    // the order of all: a lower shard after the date of the token, a higher one before it. Patients
+    // continue after the identity of the token on every shard
+    DcmSQLiteFindCursorPrivate* cursor = new DcmSQLiteFindCursorPrivate;
+    cursor->paged = true;
+    cursor->level = queryLevel;
+    cursor->limit = limit;
+    cursor->merge = true;
+    DcmSQLiteFindCursor* merged = new DcmSQLiteFindCursor(cursor);
+    for (size_t i = 0; i < d->shardCount; ++i) {
+        DcmSQLiteDatabase* connection = shard(i);
+        if (connection == NULL) {
+            delete merged;
+            return NULL;
+        }
+        DcmSQLiteFindPage bound = position;
+        if (i != position.shard) {
+            std::fill(bound.ids.begin(), bound.ids.end(), i < position.shard ? LLONG_MAX : 0);
+        }
+        std::vector<DcmSQLiteFindCursor*> parts;
+        if (after.empty()) {
+            parts.push_back(connection->openShardFind(findRequestList, queryLevel, FirstPage, NULL, limit));
+        }
+        else if (queryLevel == PATIENT_LEVEL) {
+            parts.push_back(connection->openShardFind(findRequestList, queryLevel, position.named ? NamedPage : UnnamedPage,
+                &position, limit));
+        }
+        else if (position.dated) {
+            // all studies without a date come after the token
+            DcmSQLiteFindPage undated;
+            undated.ids.assign(DcmSQLiteFindPage::idCount(queryLevel), LLONG_MAX);
+            parts.push_back(connection->openShardFind(findRequestList, queryLevel, DatedPage, &bound, limit));
+            parts.push_back(connection->openShardFind(findRequestList, queryLevel, UndatedPage, &undated, limit));
+        }
+        else if (i <= position.shard) {
+            parts.push_back(connection->openShardFind(findRequestList, queryLevel, UndatedPage, &bound, limit));
+        }
+        if (std::find(parts.begin(), parts.end(), static_cast<DcmSQLiteFindCursor*>(NULL)) != parts.end()) {
+            for (auto part : parts) {
+                delete part;
+            }
+            delete merged;
+            return NULL;
+        }
+        if (parts.size() == 1) {
+            cursor->parts.push_back(parts.front());
+        }
+        else if (parts.size() > 1) {
+            DcmSQLiteFindCursorPrivate* chain = new DcmSQLiteFindCursorPrivate;
+            chain->paged = true;
+            chain->level = queryLevel;
+            chain->parts = parts;
+            cursor->parts.push_back(new DcmSQLiteFindCursor(chain));
+        }
+    }
+    return merged;
+}
+
+//--------------------------------------------------------------------------------------------
+
+DcmSQLiteFindCursor* DcmSQLiteDatabase::openShardFind(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel,
+    char page, const DcmSQLiteFindPage* after, size_t limit) const
+{
+    OFTraceSpan span("sql.openFind");
+    if (!d->initialized) {
+        DCMNET_WARN("database not initialized");
+        return NULL;
+    }
+
+    if (findRequestList.empty()) {
+        DCMNET_WARN("request is empty!");
+        return NULL;
+    }
+
+    // compile the whole request into one statement joining all levels down to the query level,
+    // every level restriction becomes part of the WHERE clause. The text only depends on the
+    // queried tags and the kind of their match, requests of the same shape share it
+    std::vector <DcmTagKey> trackList;
+    std::vector <char> matchList;
+    std::vector < std::string > whereBindings;
+    std::vector < std::string > whereBindingNames;
+    bool charsetRequested = false;
+    std::string shape(1, static_cast<char>('0' + queryLevel));
+
+    for(auto e: findRequestList) {
+
+        DB_LEVEL level = tagLevel(e.XTag());
+        if (level > queryLevel) {
+            continue;
+        }
+
+        if (e.XTag() == DCM_SpecificCharacterSet) {
+            charsetRequested = true;
+            continue;
+        }
+
+        const std::string whereStr = getTagName( e.XTag() );
+        std::string valueStr = e.valueField();
+        char match = NoMatch;
+
+        if (!isAggregateField(e.XTag()) && isNameAttribute(e.XTag())) {
+            valueStr = asciiUpper(valueStr);
+        }
+        const size_t wildcard = valueStr.find_first_of("*?");
+        std::string searchTerm;
+        std::string digits;
+
+        if (valueStr.empty() || valueStr == "*") {
+            // returned, not matched
+        }
+        else if (isAggregateField(e.XTag())) {
+            // maintained at insert time, see updateAggregates()
+            match = AggregateMatch;
+            whereBindings.push_back(valueStr);
+            whereBindingNames.push_back(std::string(":") + whereStr);
+        }
+        else if (wildcard != std::string::npos && wildcard > 0 && wildcard == valueStr.size() - 1 && valueStr[wildcard] == '*'
+                 && !prefixEnd(valueStr.substr(0, wildcard)).empty() && !isNumberAttribute(e.XTag())) {
+            // not for numbers, which do not order like their text in INTEGER columns and use GLOB
+            match = PrefixMatch;
+            whereBindings.push_back(valueStr.substr(0, wildcard));
+            whereBindings.push_back(prefixEnd(valueStr.substr(0, wildcard)));
+            whereBindingNames.push_back(std::string(":") + whereStr + "1");
+            whereBindingNames.push_back(std::string(":") + whereStr + "2");
+        }
+        else if (d->nameSearch && e.XTag() == DCM_PatientName && isSearchTerm(valueStr, searchTerm)) {
+            match = SearchMatch;
+            whereBindings.push_back("\"" + searchTerm + "\"*");
+            whereBindings.push_back(globPattern(valueStr));
+            whereBindingNames.push_back(std::string(":") + whereStr + "1");
+            whereBindingNames.push_back(std::string(":") + whereStr + "2");
+        }
+        else if (wildcard != std::string::npos) {
+            match = WildcardMatch;
+            whereBindings.push_back(globPattern(valueStr));
+            whereBindingNames.push_back(std::string(":") + whereStr);
+        }
+        else if ( isDateOrTimeField(e.XTag()) && contains(valueStr, "-")) {
+            const std::string first = firstp(valueStr);
+            const std::string second = secondp(valueStr);
+            std::string low;
+            std::string high;
+            if (isIntegerAttribute(e.XTag()) && (first.empty() || normalizedValue(e.XTag(), first, false, low))
+                && (second.empty() || normalizedValue(e.XTag(), second, true, high))) {
+                match = RangeMatch;
+                whereBindings.push_back(low.empty() ? "0" : low);
+                whereBindings.push_back(high.empty() ? "999999999999" : high);
+            }
+            else {
+                match = TextRangeMatch;
+                whereBindings.push_back(first);
+                whereBindings.push_back(second.empty() ? "\xff" : second);
+            }
+            whereBindingNames.push_back(std::string(":") + whereStr + "1");
+            whereBindingNames.push_back(std::string(":") + whereStr + "2");
+        }
+        else if (isIntegerAttribute(e.XTag()) && normalizedValue(e.XTag(), valueStr, false, digits)) {
+            match = IntegerMatch;
+            whereBindings.push_back(digits);
+            whereBindingNames.push_back(std::string(":") + whereStr);
+        }
+        else {
+            match = ValueMatch;
+            whereBindings.push_back(valueStr);
+            whereBindingNames.push_back(std::string(":") + whereStr);
+        }
+
+        trackList.push_back( e.XTag() );
+        matchList.push_back(match);
+        char key[16];
+        snprintf(key, sizeof(key), "%04x%04x%c", e.XTag().getGroup(), e.XTag().getElement(), match);
+        shape += key;
+    }
+
+    if (page != NoPage) {
+        shape += page;
+    }
+    std::map<std::string, std::string>::iterator known = d->findShapes.find(shape);
+    if (known == d->findShapes.end()) {
+        known = d->findShapes.insert(std::make_pair(shape, findStatement(trackList, matchList, queryLevel, page))).first;
+    }
+    const std::string& prepare = known->second;
+
+    if (DCM_dcmnetLogger.isEnabledFor(OFLogger::DEBUG_LOG_LEVEL)) {
+        DCMNET_DEBUG("find: " << prepare);
+        for (auto step : explainQueryPlan(prepare)) {
+            DCMNET_DEBUG("  plan: " << step);
+        }
+    }
+
+    DcmSQLiteFindCursorPrivate* cursor = new DcmSQLiteFindCursorPrivate;
+    cursor->db = this;
+    cursor->sql = prepare;
+    cursor->trackList = trackList;
+    cursor->charsetRequested = charsetRequested;
+    cursor->query = checkoutQuery(prepare);
+    for (size_t i = 0; i < whereBindings.size(); ++i) {
+        cursor->query->bind(whereBindingNames.at(i).c_str(), whereBindings.at(i), sqlite3pp::copy);
+    }
+    if (page != NoPage) {
+        cursor->paged = true;
+        cursor->level = queryLevel;
+        cursor->query->bind(":pageLimit", limit > 0 ? static_cast<long long>(limit) : -1LL);
+        if (after != NULL) {
+            if (page == DatedPage) {
+                cursor->query->bind(":pageDate", after->date);
+            }
+            if (page == NamedPage || page == UnnamedPage) {
+                cursor->query->bind(":pagePatientID", after->patientID, sqlite3pp::copy);
+            }
+            if (page == NamedPage) {
+                cursor->query->bind(":pagePatientName", after->patientName, sqlite3pp::copy);
+            }
+            for (size_t i = 0; i < after->ids.size(); ++i) {
+                cursor->query->bind((":pageId" + std::to_string(i)).c_str(), after->ids[i]);
+            }
+        }
+    }
+    return new DcmSQLiteFindCursor(cursor);
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::isDateField(const DcmTagKey& key) const
+{
+    DcmTag t(key);
+    return t.getVR().getEVR() == EVR_DA;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::isTimeField(const DcmTagKey& key) const
+{
+    DcmTag t(key);
+    return t.getVR().getEVR() == EVR_TM;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::isDateOrTimeField(const DcmTagKey& key) const
+{
+    DcmTag t(key);
+    DcmEVR evr = t.getVR().getEVR();
+    return  (evr == EVR_DA || evr == EVR_DT || evr == EVR_TM);
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::string DcmSQLiteDatabase::firstp( const std::string& value ) const
+{
+    std::size_t pos = value.find("-");
+    if (pos == std::string::npos) {
+        DCMNET_WARN("no range sign found");
+        return value;
+    }
+    return value.substr(0, pos);
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::string DcmSQLiteDatabase::secondp( const std::string& value ) const
+{
+    std::size_t pos = value.find("-");
+    if (pos == std::string::npos) {
+        DCMNET_WARN("no range sign found");
+        return value;
+    }
+    return value.substr(pos + 1, value.length()-1);
+}
+
+//--------------------------------------------------------------------------------------------
+
+DB_LEVEL DcmSQLiteDatabase::tagLevel( DcmTagKey key ) const
+{
+    for(auto item: d->definedTags) {
+        if (item.tag == key)
+            return item.level;
+    }
+    DCMNET_WARN("tag not registered");
+    return PATIENT_LEVEL;
+}
+
+//--------------------------------------------------------------------------------------------
+
+OFCondition DcmSQLiteDatabase::insertMetaData(DcmDataset* dataset, const OFString& filename)
+{
+    if (!d->initialized) {
+        DCMNET_WARN("database not initialized");
+        return EC_IllegalParameter;
+    }
+    if (d->readOnly) {
+        DCMNET_WARN("read-only database connection");
+        return EC_IllegalParameter;
+    }
+
+    OFCondition status = EC_Normal;
+
+    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare > insertMap;
+    extractMetaData(dataset, filename, insertMap);
+
+    DcmSQLiteDatabase* target = shard(shardOf(insertMap));
+    if (target == NULL || !target->insertDb(insertMap)) {
+        DCMNET_ERROR("Failed inserting metadata into db");
+        status = EC_IllegalParameter;
+    }
+    return status;
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::vector<bool> DcmSQLiteDatabase::insertBatch(const std::vector< std::map< DB_FindAttrExt, std::string,
+    DB_FindAttrExtCompare > >& batch)
+{
+    std::vector<bool> result(batch.size(), false);
+    if (!d->initialized) {
+        DCMNET_WARN("database not initialized");
+        return result;
+    }
+    if (d->readOnly) {
+        DCMNET_WARN("read-only database connection");
+        return result;
+    }
+
+    if (d->shardCount > 1) {
+        // one transaction per shard, instances of other shards are handed to their connection
+        std::vector< std::vector<size_t> > parts(d->shardCount);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            parts[shardOf(batch[i])].push_back(i);
+        }
+        if (parts[d->shardIndex].size() != batch.size()) {
+            for (size_t s = 0; s < parts.size(); ++s) {
+                DcmSQLiteDatabase* connection = parts[s].empty() ? NULL : shard(s);
+                if (connection == NULL) {
+                    continue;
+                }
+                std::vector< std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare > > part;
+                for (auto i : parts[s]) {
+                    part.push_back(batch[i]);
+                }
+                std::vector<bool> partResult = connection->insertBatch(part);
+                for (size_t j = 0; j < parts[s].size(); ++j) {
+                    result[parts[s][j]] = partResult[j];
+                }
+            }
+            return result;
+        }
+    }
+
+    // one transaction, thus one sync, for the whole batch. The write lock may be held by
+    // another process on the storage area for longer than the busy timeout
+    int rc = d->db->execute("BEGIN IMMEDIATE;");
+    for (int attempt = 1; rc == SQLITE_BUSY && attempt < busyAttempts; ++attempt) {
+        DCMNET_WARN("Index of " << d->storagePath << " is locked, retrying the ingest transaction");
+        Metrics::counter("db_busy_retries_total").add();
+        rc = d->db->execute("BEGIN IMMEDIATE;");
+    }
+    if (rc != 0) {
+        DCMNET_ERROR("Failed to begin ingest transaction");
+        return result;
+    }
+
+    // a savepoint per instance, a failing instance leaves no rows behind and the others are committed
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (d->db->execute("SAVEPOINT instance;") != 0) {
+            DCMNET_ERROR("Failed to begin the savepoint of an instance of the ingest transaction");
+            continue;
+        }
+        try {
+            result[i] = insertDb(batch[i]);
+        }
+        catch (std::exception& e) {
+            DCMNET_ERROR("Failed inserting metadata into db: " << e.what());
+        }
+        if (!result[i]) {
+            d->db->execute("ROLLBACK TO instance;");
+            // keys of the patient, study or series rows it inserted are gone
+            d->clearIdCaches();
+        }
+        d->db->execute("RELEASE instance;");
+    }
+
+    if (d->db->execute("COMMIT;") != 0) {
+        DCMNET_ERROR("Failed to commit ingest transaction");
+        d->db->execute("ROLLBACK;");
+        std::fill(result.begin(), result.end(), false);
+        // keys of rows inserted by the batch are gone, other connections never saw them
+        d->clearIdCaches();
+    }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmSQLiteDatabase::invalidateIdCaches()
+{
+    ++idCacheGeneration;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::insertDb(const std::map< DB_FindAttrExt, std::string, 
+    DB_FindAttrExtCompare >& keyValueList)
+{
+    const unsigned generation = idCacheGeneration.load();
+    if (d->idCacheGeneration != generation) {
+        d->clearIdCaches();
+        d->idCacheGeneration = generation;
+    }
+
+    Db_Id patIdent = insertpat(keyValueList);
+    Db_Id stdIdent = insertstd(keyValueList, patIdent);
+    Db_Id serIdent = insertser(keyValueList, stdIdent);
+    Db_Id imgIdent = insertimg(keyValueList, serIdent);
+
+    if (!imgIdent.isNew) {
+        DCMNET_WARN("instance already registered, ignoring");
+    }
+    else {
+        // one row per instance, committed along with it
+        sqlite3pp::command& log = cachedCommand("INSERT INTO changeLog(level, StudyInstanceUID, SeriesInstanceUID, SOPInstanceUID, time) VALUES(?, ?, ?, ?, ?);");
+        log.bind(1, static_cast<int>(stdIdent.isNew ? STUDY_LEVEL : serIdent.isNew ? SERIE_LEVEL : IMAGE_LEVEL));
+        log.bind(2, hashv(keyValueList, DCM_StudyInstanceUID), sqlite3pp::copy);
+        log.bind(3, hashv(keyValueList, DCM_SeriesInstanceUID), sqlite3pp::copy);
+        log.bind(4, hashv(keyValueList, DCM_SOPInstanceUID), sqlite3pp::copy);
+        log.bind(5, static_cast<long long int>(std::time(NULL)));
+        if (log.execute() != 0) {
+            DCMNET_WARN("Failed to log the new instance in the change log of " << d->storagePath);
+        }
+        log.reset();
+    }
+
+    updateAggregates(keyValueList, stdIdent, serIdent, imgIdent);
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+void DcmSQLiteDatabase::updateAggregates(const std::map< DB_FindAttrExt, std::string,
+    DB_FindAttrExtCompare >& keyValueList, const Db_Id& studyIdent, const Db_Id& seriesIdent, const Db_Id& imageIdent)
+{
+    // the statements run for every instance, their text is only built once
+    static const std::string study = levelName(STUDY_LEVEL);
+    static const std::string series = levelName(SERIE_LEVEL);
+    static const std::string modalitiesColumn = getTagName(DCM_ModalitiesInStudy);
+    static const std::string studySeriesColumn = getTagName(DCM_NumberOfStudyRelatedSeries);
+    static const std::string studyInstancesColumn = getTagName(DCM_NumberOfStudyRelatedInstances);
+    static const std::string seriesInstancesColumn = getTagName(DCM_NumberOfSeriesRelatedInstances);
+    static const std::string selectModalities = "SELECT " + modalitiesColumn + " FROM " + study + " WHERE id = :id";
+    static const std::string updateStudySeries = "UPDATE " + study + " SET " + modalitiesColumn + " = :modalities, " + studySeriesColumn
+        + " = CAST(COALESCE(" + studySeriesColumn + ", 0) AS INTEGER) + 1 WHERE id = :id";
+    static const std::string updateStudyInstances = "UPDATE " + study + " SET " + studyInstancesColumn
+        + " = CAST(COALESCE(" + studyInstancesColumn + ", 0) AS INTEGER) + 1 WHERE id = :id";
+    static const std::string updateSeriesInstances = "UPDATE " + series + " SET " + seriesInstancesColumn
+        + " = CAST(COALESCE(" + seriesInstancesColumn + ", 0) AS INTEGER) + 1 WHERE id = :id";
+
+    if (seriesIdent.isNew) {
+        std::set<std::string> modalities;
+
+        sqlite3pp::query& query = cachedQuery(selectModalities);
+        query.bind(":id", studyIdent.primaryKey);
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            const char* value = (*i).get<char const*>(0);
+            split('\\', modalities, std::string(value ? value : ""));
+        }
+        modalities.insert(hashv(keyValueList, DCM_Modality));
+        modalities.erase(std::string());
+        std::string modalitiesValue = join(modalities, "\\");
+
+        sqlite3pp::command& cmd = cachedCommand(updateStudySeries);
+        cmd.bind(":modalities", modalitiesValue, sqlite3pp::nocopy);
+        cmd.bind(":id", studyIdent.primaryKey);
+        cmd.execute();
+    }
+
+    if (imageIdent.isNew) {
+        sqlite3pp::command& studyCmd = cachedCommand(updateStudyInstances);
+        studyCmd.bind(":id", studyIdent.primaryKey);
+        studyCmd.execute();
+
+        sqlite3pp::command& seriesCmd = cachedCommand(updateSeriesInstances);
+        seriesCmd.bind(":id", seriesIdent.primaryKey);
+        seriesCmd.execute();
+    }
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::recomputeAggregates(const std::string& studyIds, const std::string& seriesIds)
+{
+    const std::string study = levelName(STUDY_LEVEL);
+    const std::string series = levelName(SERIE_LEVEL);
+    const std::string image = levelName(IMAGE_LEVEL);
+
+    std::string prepare = "UPDATE " + study + " SET "
+        + getTagName(DCM_NumberOfStudyRelatedSeries) + " = (SELECT COUNT(*) FROM " + series
+        + " WHERE " + series + ".referenceId = " + study + ".id), "
+        + getTagName(DCM_NumberOfStudyRelatedInstances) + " = (SELECT COUNT(*) FROM " + image + " JOIN " + series
+        + " ON " + image + ".referenceId = " + series + ".id WHERE " + series + ".referenceId = " + study + ".id), "
+        + getTagName(DCM_ModalitiesInStudy) + " = (SELECT replace(group_concat(DISTINCT " + getTagName(DCM_Modality)
+        + "), ',', '\\') FROM " + series + " WHERE " + series + ".referenceId = " + study + ".id)"
+        + (studyIds.empty() ? "" : " WHERE id IN " + studyIds) + ";";
+    if (d->db->execute(prepare.c_str()) != 0) {
+        DCMNET_ERROR("Failed to compute study aggregates");
+        return false;
+    }
+
+    prepare = "UPDATE " + series + " SET " + getTagName(DCM_NumberOfSeriesRelatedInstances)
+        + " = (SELECT COUNT(*) FROM " + image + " WHERE " + image + ".referenceId = " + series + ".id)"
+        + (seriesIds.empty() ? "" : " WHERE id IN " + seriesIds) + ";";
+    if (d->db->execute(prepare.c_str()) != 0) {
+        DCMNET_ERROR("Failed to compute series aggregates");
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::mergeDuplicatePatients()
+{
+    const std::string patient = levelName(PATIENT_LEVEL);
+    const std::string study = levelName(STUDY_LEVEL);
+    const std::string identity = getTagName(DCM_PatientID) + ", " + getTagName(DCM_PatientName);
+
+    // studies move to the oldest row of their patient, the others go
+    std::string prepare = "UPDATE " + study + " SET referenceId = (SELECT MIN(other.id) FROM " + patient
+        + " AS other JOIN " + patient + " AS own ON other." + getTagName(DCM_PatientID) + " IS own." + getTagName(DCM_PatientID)
+        + " AND other." + getTagName(DCM_PatientName) + " IS own." + getTagName(DCM_PatientName)
+        + " WHERE own.id = " + study + ".referenceId) WHERE referenceId IN (SELECT id FROM " + patient
+        + " WHERE id NOT IN (SELECT MIN(id) FROM " + patient + " GROUP BY " + identity + "));";
+    if (d->db->execute(prepare.c_str()) != 0) {
+        DCMNET_ERROR("Failed to move the studies of duplicate patients");
+        return false;
+    }
+
+    prepare = "DELETE FROM " + patient + " WHERE id NOT IN (SELECT MIN(id) FROM " + patient + " GROUP BY " + identity + ");";
+    if (d->db->execute(prepare.c_str()) != 0) {
+        DCMNET_ERROR("Failed to remove duplicate patients");
+        return false;
+    }
+    if (d->db->changes() > 0) {
+        DCMNET_INFO("Merged " << d->db->changes() << " duplicate patients");
+        invalidateIdCaches();
+    }
+
+    d->db->execute("DROP INDEX IF EXISTS patientIdentityIndex;");
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::isAggregateField(const DcmTagKey& key) const
+{
+    return isAggregateAttribute(key);
+}
+
+//--------------------------------------------------------------------------------------------
+
+Db_Id DcmSQLiteDatabase::insertpat(const std::map< DB_FindAttrExt, std::string, 
+    DB_FindAttrExtCompare >& keyValueList)
+{
+    Db_Id ident;
+    ident.level = PATIENT_LEVEL;
+    ident.isNew = true;
+
+    // try to find the patient with Name + IPP
+    std::string patientId = hashv(keyValueList, DCM_PatientID);
+    std::string patientName = hashv(keyValueList, DCM_PatientName);
+
+    // if patient id is empty, try to find the patient first
+    if (patientId.empty()) {
+        std::string prepare("SELECT " + getTagName(DCM_PatientID) + " FROM patient WHERE " + getTagName(DCM_PatientName) + "= :patName");
+        sqlite3pp::query& query = cachedQuery(prepare);
+        query.bind(":patName", patientName.c_str(), sqlite3pp::nocopy);
+        
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            for (int j = 0; j < query.column_count(); ++j) {
+                patientId = (*i).get<const char*>(j);
+                break;
+            }
+        }
+    }
+
+    // if still empty, create patient id
+    if (patientId.empty()) {
+        patientId = uuid::generate_uuid_v4();
+    }
+
+    const std::string key = patientId + std::string(1, '\0') + patientName;
+    if (d->patientIds.find(key, ident.primaryKey)) {
+        ident.isNew = false;
+        return ident;
+    }
+
+    // both columns are bound, a missing name would be NULL and never conflict
+    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare> modifiedKeyValueList(keyValueList);
+    modifiedKeyValueList[DB_FindAttrExt(DCM_PatientID, PATIENT_LEVEL, REQUIRED_KEY)] = patientId;
+    modifiedKeyValueList[DB_FindAttrExt(DCM_PatientName, PATIENT_LEVEL, REQUIRED_KEY)] = patientName;
+    ident.primaryKey = insertatt(modifiedKeyValueList, 0, PATIENT_LEVEL,
+        getTagName(DCM_PatientID) + ", " + getTagName(DCM_PatientName));
+
+    if (ident.primaryKey != 0 && d->nameSearch) {
+        static const std::string prepare = "INSERT INTO patientNameSearch(rowid, " + getTagName(DCM_PatientName) + ") VALUES (:id, :name)";
+        sqlite3pp::command& cmd = cachedCommand(prepare);
+        cmd.bind(":id", ident.primaryKey);
+        cmd.bind(":name", patientName, sqlite3pp::nocopy);
+        cmd.execute();
+    }
+
+    // inserted by another connection or earlier
+    if (ident.primaryKey == 0) {
+        ident.isNew = false;
+        std::string prepare("SELECT id FROM patient WHERE " + getTagName(DCM_PatientID) + "= :patId AND " + getTagName(DCM_PatientName) + "= :patName");
+        sqlite3pp::query& query = cachedQuery(prepare);
+
+        query.bind(":patId", patientId.c_str(), sqlite3pp::nocopy);
+        query.bind(":patName", patientName.c_str(), sqlite3pp::nocopy);
+
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            ident.primaryKey = (*i).get<OFlonglong>(0);
+        }
+    }
+    d->patientIds.insert(key, ident.primaryKey);
+
+    return ident;
+}
+
+//--------------------------------------------------------------------------------------------
+
+Db_Id DcmSQLiteDatabase::insertstd(const std::map< DB_FindAttrExt, std::string, 
+    DB_FindAttrExtCompare >& keyValueList, Db_Id patientIdent)
+{
+    return insert(keyValueList, patientIdent, DCM_StudyInstanceUID);
+}
 
-    if (!insertDb(insertMap)) {
-        DCMNET_ERROR("Failed inserting metadata into db");
-        status = EC_IllegalParameter;
+Db_Id DcmSQLiteDatabase::insertser(const std::map< DB_FindAttrExt, std::string, 
+    DB_FindAttrExtCompare >& keyValueList, Db_Id studyIdent)
+{
+    return insert(keyValueList, studyIdent, DCM_SeriesInstanceUID);
+}
+
+//--------------------------------------------------------------------------------------------
+
+Db_Id DcmSQLiteDatabase::insertimg(const std::map< DB_FindAttrExt, std::string, 
+    DB_FindAttrExtCompare >& keyValueList, Db_Id seriesIdent)
+{
+    return insert(keyValueList, seriesIdent, DCM_SOPInstanceUID);
+}
+
+//--------------------------------------------------------------------------------------------
+
+Db_Id DcmSQLiteDatabase::insert(const std::map< DB_FindAttrExt, std::string, 
+    DB_FindAttrExtCompare >& keyValueList, Db_Id parentIdent, const DcmTagKey& primary)
+{
+    Db_Id ident;
+    ident.level = static_cast<DB_LEVEL>(static_cast<int>(parentIdent.level) + 1);
+    ident.isNew = true;
+
+    std::string table = levelName(ident.level);
+
+    std::string uid = hashv(keyValueList, primary);
+
+    // instances are new as a rule, their study and series mostly known already
+    IdCache* cache = ident.level == STUDY_LEVEL ? &d->studyIds : ident.level == SERIE_LEVEL ? &d->seriesIds : NULL;
+    if (cache != NULL && cache->find(uid, ident.primaryKey)) {
+        ident.isNew = false;
+        return ident;
+    }
+
+    // a cache miss is usually a new row, so the insert comes first and the lookup only
+    // follows a conflict on the UID
+    ident.primaryKey = insertatt(keyValueList, parentIdent.primaryKey, ident.level, getTagName(primary));
+    if (ident.primaryKey == 0) {
+        ident.isNew = false;
+        std::string prepare("SELECT id FROM " + table + " WHERE " + getTagName(primary) + "= :uid");
+
+        sqlite3pp::query& query = cachedQuery(prepare);
+        query.bind(":uid", uid, sqlite3pp::nocopy);
+
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            ident.primaryKey = (*i).get<OFlonglong>(0);
+        }
+    }
+    if (cache != NULL) {
+        cache->insert(uid, ident.primaryKey);
+    }
+    return ident;
+}
+
+//--------------------------------------------------------------------------------------------
+
+OFlonglong DcmSQLiteDatabase::insertatt(const std::map< DB_FindAttrExt, 
+    std::string, DB_FindAttrExtCompare >& keyValueList, OFlonglong id, DB_LEVEL level, const std::string& conflict)
+{
+    typedef std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare>::const_iterator Iterator;
+    const ColumnList& columns = levelColumns(level);
+
+    // the statement only depends on which columns of the level are present
+    std::string shape(1, static_cast<char>('0' + level));
+    shape += conflict;
+    // NULL for dates and times which do not normalize
+    std::vector<const std::string*> values;
+    // stable addresses for the copies, at most one per column
+    std::vector<std::string> derived;
+    derived.reserve(columns.size());
+    for (const sColumn& column : columns) {
+        Iterator iter = keyValueList.find(DB_FindAttrExt(column.tag, level, OPTIONAL_KEY));
+        shape += (iter != keyValueList.end()) ? '1' : '0';
+        if (iter == keyValueList.end()) {
+            continue;
+        }
+        if (column.kind == UpperColumn) {
+            derived.push_back(asciiUpper(iter->second));
+            values.push_back(&derived.back());
+        }
+        else if (column.kind == IntegerColumn) {
+            derived.push_back(std::string());
+            values.push_back(normalizedValue(column.tag, iter->second, false, derived.back()) ? &derived.back() : NULL);
+        }
+        else if (d->interned && isInternedAttribute(column.tag)) {
+            // the text binding takes the INTEGER affinity of the column
+            const OFlonglong interned = internedId(iter->second);
+            derived.push_back(std::to_string(interned));
+            values.push_back(interned > 0 ? &derived.back() : NULL);
+        }
+        else {
+            values.push_back(&iter->second);
+        }
+    }
+
+    if (level == IMAGE_LEVEL) {
+        Iterator iter = keyValueList.find(DB_FindAttrExt(DCM_PrivateCreator, level, OPTIONAL_KEY));
+        if (iter != keyValueList.end()) {
+            DCMNET_ERROR("Missing filename" << iter->second);
+        }
+    }
+
+    std::map<std::string, sqlite3pp::command*>::iterator it = d->insertShapes.find(shape);
+    if (it == d->insertShapes.end()) {
+        std::vector<std::string> attributs;
+        for (size_t u = 0; u < columns.size(); ++u) {
+            if (shape[u + 1 + conflict.size()] == '1') {
+                attributs.push_back(columns[u].name);
+            }
+        }
+        std::string prepare = "INSERT INTO " + levelName(level) + " ( " + join(attributs, " , ")
+            + ", referenceId ) VALUES ( :" + join(attributs, ", :") + ", :referenceId ) "
+            + "ON CONFLICT ( " + conflict + " ) DO NOTHING";
+        it = d->insertShapes.insert(std::make_pair(shape, &cachedCommand(prepare))).first;
+    }
+
+    sqlite3pp::command& cmd = *it->second;
+    cmd.reset();
+
+    // parameters are numbered in the order of the column list
+    int index = 1;
+    for (auto value : values) {
+        if (value != NULL) {
+            cmd.bind(index++, *value, sqlite3pp::nocopy);
+        }
+        else {
+            cmd.bind(index++, sqlite3pp::null_type());
+        }
+    }
+    cmd.bind(index, static_cast<long long int>(id));
+
+    cmd.execute();
+    // ids start at 1, the row already existed if nothing changed
+    return d->db->changes() > 0 ? d->db->last_insert_rowid() : 0;
+}
+
+//--------------------------------------------------------------------------------------------
+
+OFlonglong DcmSQLiteDatabase::internedId(const std::string& value)
+{
+    std::unordered_map<std::string, OFlonglong>::iterator it = d->internedIds.find(value);
+    if (it != d->internedIds.end()) {
+        return it->second;
+    }
+
+    static const std::string insert = "INSERT INTO dictionary(value) VALUES(:value) ON CONFLICT(value) DO NOTHING";
+    static const std::string select = "SELECT id FROM dictionary WHERE value = :value";
+    sqlite3pp::command& cmd = cachedCommand(insert);
+    cmd.bind(":value", value, sqlite3pp::nocopy);
+    cmd.execute();
+    OFlonglong id = 0;
+    if (d->db->changes() > 0) {
+        id = d->db->last_insert_rowid();
+    }
+    else {
+        sqlite3pp::query& query = cachedQuery(select);
+        query.bind(":value", value, sqlite3pp::nocopy);
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            id = (*i).get<long long int>(0);
+        }
+    }
+
+    if (d->internedIds.size() >= internCacheSize) {
+        d->internedIds.clear();
+    }
+    d->internedIds[value] = id;
+    return id;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::hasInternedColumns() const
+{
+    const std::string column = getTagName(DCM_SOPClassUID);
+    std::string prepare = "PRAGMA table_info(" + levelName(IMAGE_LEVEL) + ");";
+    sqlite3pp::query query(*d->db, prepare.c_str());
+    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+        const char* name = (*i).get<const char*>(1);
+        const char* type = (*i).get<const char*>(2);
+        if (name != NULL && column == name) {
+            return type != NULL && std::string(type) == "INTEGER";
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------
+
+
+std::string DcmSQLiteDatabase::hashv(const std::map< DB_FindAttrExt, std::string, 
+    DB_FindAttrExtCompare >& keyValueList, DcmTagKey key)
+{
+    std::string result;
+    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare>::const_iterator iter;
+    iter = keyValueList.find(DB_FindAttrExt(key, PATIENT_LEVEL, UNIQUE_KEY));
+    if (iter != keyValueList.end()) {
+        result = iter->second;
+    }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::createTables()
+{
+    if (!(createTable(PATIENT_LEVEL) &&
+          createTable(STUDY_LEVEL) &&
+          createTable(SERIE_LEVEL) &&
+          createTable(IMAGE_LEVEL))) {
+        return false;
+    }
+    if (d->db->execute("CREATE TABLE IF NOT EXISTS dictionary(id INTEGER PRIMARY KEY, value TEXT UNIQUE);") != 0) {
+        DCMNET_ERROR("Failed to create the dictionary table");
+        return false;
+    }
+    if (d->shardIndex == 0 && d->db->execute("CREATE TABLE IF NOT EXISTS studyAccess(StudyInstanceUID TEXT PRIMARY KEY, accessed INTEGER);") != 0) {
+        DCMNET_ERROR("Failed to create the study access table");
+        return false;
+    }
+    if (d->shardIndex == 0 && d->db->execute("CREATE TABLE IF NOT EXISTS clusterNodes(name TEXT PRIMARY KEY, aeTitle TEXT, host TEXT, port INTEGER, storagePath TEXT, heartbeat INTEGER);") != 0) {
+        DCMNET_ERROR("Failed to create the cluster nodes table");
+        return false;
+    }
+    if (d->db->execute("CREATE TABLE IF NOT EXISTS pixelHash(SOPInstanceUID TEXT PRIMARY KEY, hash TEXT);") != 0) {
+        DCMNET_ERROR("Failed to create the pixel hash table");
+        return false;
+    }
+    if (d->db->execute("CREATE TABLE IF NOT EXISTS pixelStats(SOPInstanceUID TEXT PRIMARY KEY, minimum REAL, maximum REAL, "
+            "low REAL, high REAL, windowCenter REAL, windowWidth REAL, histogram TEXT);") != 0) {
+        DCMNET_ERROR("Failed to create the pixel statistics table");
+        return false;
+    }
+    // AUTOINCREMENT, a sequence number is never handed out twice
+    if (d->db->execute("CREATE TABLE IF NOT EXISTS changeLog(seq INTEGER PRIMARY KEY AUTOINCREMENT, level INTEGER, "
+            "StudyInstanceUID TEXT, SeriesInstanceUID TEXT, SOPInstanceUID TEXT, time INTEGER);") != 0) {
+        DCMNET_ERROR("Failed to create the change log table");
+        return false;
+    }
+    if (d->shardIndex == 0 && !storeShardCount()) {
+        return false;
+    }
+
+    int version = 0;
+    sqlite3pp::query query(*d->db, "PRAGMA user_version;");
+    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+        version = (*i).get<int>(0);
+    }
+    query.finish();
+
+    if (version >= schemaVersion) {
+        // indexes dropped by an interrupted bulk load
+        return createIndexes() && createNameSearch();
+    }
+
+    DCMNET_INFO("Upgrading database indexes to version " << schemaVersion << ", this may take a while");
+    // version 4 makes the patient identity unique, which fails on the duplicates the
+    // previous SELECT-then-INSERT could leave behind
+    if (version < 4 && !mergeDuplicatePatients()) {
+        return false;
+    }
+    // version 5 matches person names on an uppercase copy, version 6 dates and times on an integer one
+    if (version < 6 && !addDerivedColumns()) {
+        return false;
+    }
+    if (!createIndexes()) {
+        return false;
+    }
+
+    // version 3 keeps the study and series counters up to date at insert time
+    if (version < 3 && !recomputeAggregates()) {
+        return false;
+    }
+
+    // let the planner pick up statistics for the new indexes
+    d->db->execute("PRAGMA optimize;");
+    std::string prepare = "PRAGMA user_version = " + std::to_string(schemaVersion) + ";";
+    d->db->execute(prepare.c_str());
+    return createNameSearch();
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::storeShardCount()
+{
+    if (d->db->execute("CREATE TABLE IF NOT EXISTS settings(name TEXT PRIMARY KEY, value TEXT);") != 0) {
+        DCMNET_ERROR("Failed to create the settings table");
+        return false;
+    }
+
+    const size_t configured = configuredShards.load();
+    const size_t stored = storedShardCount();
+    if (stored > 0) {
+        if (configured > 1 && configured != stored) {
+            DCMNET_WARN("The index of " << d->storagePath << " keeps its " << stored << " shards, " << configured << " are configured");
+        }
+        return true;
+    }
+
+    size_t count = configured;
+    if (count > 1) {
+        // instances indexed before sharding was configured would not be found on their shard
+        sqlite3pp::query patients(*d->db, "SELECT 1 FROM patient LIMIT 1;");
+        if (patients.begin() != patients.end()) {
+            DCMNET_WARN("The index of " << d->storagePath << " already has entries and is not sharded");
+            count = 1;
+        }
+    }
+
+    sqlite3pp::command insert(*d->db, "INSERT OR IGNORE INTO settings(name, value) VALUES('shards', ?);");
+    insert.bind(1, std::to_string(count), sqlite3pp::copy);
+    if (insert.execute() != 0) {
+        DCMNET_ERROR("Failed to store the shard count");
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+size_t DcmSQLiteDatabase::storedShardCount() const
+{
+    size_t count = 0;
+    try {
+        sqlite3pp::query query(*d->db, "SELECT value FROM settings WHERE name = 'shards';");
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            count = static_cast<size_t>((*i).get<long long int>(0));
+        }
+    }
+    catch (std::exception&) {
+        // indexes created before sharding have no settings
+    }
+    return count;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::addDerivedColumns()
+{
+    d->db->execute("BEGIN IMMEDIATE;");
+    bool success = true;
+    for (int level = PATIENT_LEVEL; success && level <= IMAGE_LEVEL; ++level) {
+        success = addDerivedColumns(static_cast<DB_LEVEL>(level));
+    }
+    d->db->execute(success ? "COMMIT;" : "ROLLBACK;");
+    return success;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::addDerivedColumns(DB_LEVEL level)
+{
+    const std::string& table = levelName(level);
+    std::set<std::string> existing;
+    std::string prepare = "PRAGMA table_info(" + table + ");";
+    sqlite3pp::query query(*d->db, prepare.c_str());
+    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+        existing.insert((*i).get<const char*>(1));
+    }
+    query.finish();
+
+    for (const sColumn& column : levelColumns(level)) {
+        if (column.kind == StoredColumn) {
+            continue;
+        }
+        if (existing.count(column.name) == 0) {
+            prepare = "ALTER TABLE " + table + " ADD COLUMN " + column.name
+                + (column.kind == IntegerColumn ? " INTEGER;" : " TEXT;");
+            if (d->db->execute(prepare.c_str()) != 0) {
+                DCMNET_ERROR("Failed to add column " + column.name + " to table: " + table);
+                return false;
+            }
+        }
+        if (column.kind == UpperColumn) {
+            prepare = "UPDATE " + table + " SET " + column.name + " = UPPER(" + getTagName(column.tag) + ");";
+            if (d->db->execute(prepare.c_str()) != 0) {
+                DCMNET_ERROR("Failed to fill column " + column.name + " of table: " + table);
+                return false;
+            }
+            continue;
+        }
+
+        // the normalization of dates and times is not expressible in SQL
+        prepare = "SELECT id, " + getTagName(column.tag) + " FROM " + table + " WHERE " + getTagName(column.tag) + " IS NOT NULL;";
+        sqlite3pp::query values(*d->db, prepare.c_str());
+        prepare = "UPDATE " + table + " SET " + column.name + " = :value WHERE id = :id;";
+        sqlite3pp::command update(*d->db, prepare.c_str());
+        for (sqlite3pp::query::iterator i = values.begin(); i != values.end(); ++i) {
+            std::string digits;
+            update.reset();
+            if (normalizedValue(column.tag, (*i).get<const char*>(1), false, digits)) {
+                update.bind(":value", digits, sqlite3pp::nocopy);
+            }
+            else {
+                update.bind(":value", sqlite3pp::null_type());
+            }
+            update.bind(":id", static_cast<long long int>((*i).get<OFlonglong>(0)));
+            if (update.execute() != 0) {
+                DCMNET_ERROR("Failed to fill column " + column.name + " of table: " + table);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::nameSearchAvailable()
+{
+    return sqlite3_compileoption_used("ENABLE_FTS5") != 0;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::createNameSearch()
+{
+    if (!nameSearchAvailable() || hasNameSearch()) {
+        return true;
+    }
+
+    // contentless, the names are in the patient table already
+    const std::string name = getTagName(DCM_PatientName);
+    std::string prepare = "CREATE VIRTUAL TABLE patientNameSearch USING fts5(" + name + ", content='');";
+    if (d->db->execute(prepare.c_str()) != 0) {
+        DCMNET_ERROR("Failed to create the patient name search index");
+        return false;
+    }
+    DCMNET_INFO("Indexing patient names for word searches");
+    prepare = "INSERT INTO patientNameSearch(rowid, " + name + ") SELECT id, " + name + " FROM patient;";
+    if (d->db->execute(prepare.c_str()) != 0) {
+        DCMNET_ERROR("Failed to fill the patient name search index");
+        return false;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::hasNameSearch() const
+{
+    sqlite3pp::query query(*d->db, "SELECT 1 FROM sqlite_master WHERE name = 'patientNameSearch';");
+    return query.begin() != query.end();
+}
+
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::createTable(DB_LEVEL level)
+{
+    std::string table = levelName(level);
+    std::vector<std::string> list;
+    list.push_back("CREATE TABLE IF NOT EXISTS " + table + "(");
+    list.push_back("id INTEGER PRIMARY KEY AUTOINCREMENT,");
+    list.push_back("referenceId INTEGER,");
+
+    for (auto attr : d->definedTags) {
+        if (attr.level == level) {
+            std::string terminator = ",";
+            if (attr.keyAttr == UNIQUE_KEY)
+                terminator = "UNIQUE,";
+            const bool integer = isNumberAttribute(attr.tag) || isInternedAttribute(attr.tag);
+            list.push_back(getTagName(attr.tag) + (integer ? " INTEGER " : " TEXT ") + terminator);
+            for (const sColumn& column : levelColumns(level)) {
+                if (column.tag == attr.tag && column.kind != StoredColumn) {
+                    list.push_back(column.name + (column.kind == IntegerColumn ? " INTEGER," : " TEXT,"));
+                }
+            }
+        }
+    }
+    list.push_back(" PlaceHoler TEXT");
+    list.push_back(");");
+
+    std::string prepare = join(list, " ");
+
+    if (d->db->execute(prepare.c_str()) != 0) {
+        DCMNET_ERROR("Failed to create table: " + table);
+        return false;
     }
-    return status;
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------
 
-bool DcmSQLiteDatabase::insertDb(const std::map< DB_FindAttrExt, std::string, 
-    DB_FindAttrExtCompare >& keyValueList)
+bool DcmSQLiteDatabase::createIndex(DB_LEVEL level)
 {
-    Db_Id patIdent = insertpat(keyValueList);
-    Db_Id stdIdent = insertstd(keyValueList, patIdent);
-    Db_Id serIdent = insertser(keyValueList, stdIdent);
-    Db_Id imgIdent = insertimg(keyValueList, serIdent);
+    std::string table = levelName(level);
 
-    if (!imgIdent.isNew) {
-        DCMNET_WARN("instance already registered, ignoring");
-    }
+    for (auto spec : definedIndexes()) {
+        if (spec.level != level) {
+            continue;
+        }
 
+        std::string prepare = std::string(spec.unique ? "CREATE UNIQUE INDEX" : "CREATE INDEX")
+            + " IF NOT EXISTS " + spec.name + " ON " + table + "(" + join(spec.columns, ", ") + ");";
+        if (d->db->execute(prepare.c_str()) != 0) {
+            DCMNET_ERROR("Failed to create index " + spec.name + " on table: " + table);
+            return false;
+        }
+    }
     return true;
 }
 
 //--------------------------------------------------------------------------------------------
 
-Db_Id DcmSQLiteDatabase::insertpat(const std::map< DB_FindAttrExt, std::string, 
-    DB_FindAttrExtCompare >& keyValueList)
+bool DcmSQLiteDatabase::createIndexes()
 {
-    Db_Id ident;
-    ident.level = PATIENT_LEVEL;
-    ident.isNew = true;
+    return createIndex(PATIENT_LEVEL) &&
+           createIndex(STUDY_LEVEL) &&
+           createIndex(SERIE_LEVEL) &&
+           createIndex(IMAGE_LEVEL);
+}
 
-    // try to find the patient with Name + IPP
-    std::string patientId = hashv(keyValueList, DCM_PatientID);
-    std::string patientName = hashv(keyValueList, DCM_PatientName);
+//--------------------------------------------------------------------------------------------
 
-    // if patient id is empty, try to find the patient first
-    if (patientId.empty()) {
-        std::string prepare("SELECT " + getTagName(DCM_PatientID) + " FROM patient WHERE " + getTagName(DCM_PatientName) + "= :patName");
-        sqlite3pp::query query(*d->db, prepare.c_str());
-        query.bind(":patName", patientName.c_str(), sqlite3pp::nocopy);
-        
-        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
-            for (int j = 0; j < query.column_count(); ++j) {
-                patientId = (*i).get<const char*>(j);
-                break;
-            }
+bool DcmSQLiteDatabase::dropIndexes()
+{
+    for (auto spec : definedIndexes()) {
+        if (spec.unique) {
+            continue;
+        }
+        std::string prepare = "DROP INDEX IF EXISTS " + spec.name + ";";
+        if (d->db->execute(prepare.c_str()) != 0) {
+            DCMNET_ERROR("Failed to drop index " + spec.name);
+            return false;
         }
     }
+    return true;
+}
 
-    // if still empty, create patient id
-    if (patientId.empty()) {
-        patientId = uuid::generate_uuid_v4();
-    }
+//--------------------------------------------------------------------------------------------
 
-    std::string prepare("SELECT id FROM patient WHERE " + getTagName(DCM_PatientID) + "= :patId AND " + getTagName(DCM_PatientName) + "= :patName");
-    sqlite3pp::query query(*d->db, prepare.c_str());
+bool DcmSQLiteDatabase::beginBulkLoad()
+{
+    if (!d->initialized) {
+        DCMNET_WARN("database not initialized");
+        return false;
+    }
+    if (d->readOnly) {
+        DCMNET_WARN("read-only database connection");
+        return false;
+    }
+    for (size_t s = 0; s < d->shardCount; ++s) {
+        DcmSQLiteDatabase* connection = shard(s);
+        if (connection == NULL || !connection->dropIndexes()) {
+            return false;
+        }
+        connection->d->db->execute("PRAGMA synchronous=OFF;");
+    }
+    return true;
+}
 
-    query.bind(":patId", patientId.c_str(), sqlite3pp::nocopy);
-    query.bind(":patName", patientName.c_str(), sqlite3pp::nocopy);
+//--------------------------------------------------------------------------------------------
 
-    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
-        for (int j = 0; j < query.column_count(); ++j) {
-            ident.primaryKey = (*i).get<OFlonglong>(j);
-            ident.isNew = false;
-            break;
+bool DcmSQLiteDatabase::endBulkLoad()
+{
+    bool result = d->initialized;
+    for (size_t s = 0; s < d->shardCount && result; ++s) {
+        DcmSQLiteDatabase* connection = shard(s);
+        if (connection == NULL) {
+            result = false;
+            continue;
         }
+        DCMNET_INFO("Building the indexes of shard " << s << " of " << d->storagePath);
+        result = connection->createIndexes();
+        connection->d->db->execute(("PRAGMA synchronous=" + currentTuning().synchronous + ";").c_str());
+        connection->d->db->execute("PRAGMA optimize;");
     }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------
 
-    // new patient
-    if (ident.isNew) {
-        std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare> modifiedKeyValueList(keyValueList);
-        modifiedKeyValueList[DB_FindAttrExt(DCM_PatientID, PATIENT_LEVEL, REQUIRED_KEY)] = patientId;
-        ident.primaryKey = insertatt(modifiedKeyValueList, 0, PATIENT_LEVEL);
+bool DcmSQLiteDatabase::recordStudyAccess(const std::vector<std::string>& studyInstanceUIDs, long long time)
+{
+    DcmSQLiteDatabase* connection = shard(0);
+    if (connection == NULL || !d->initialized) {
+        return false;
     }
-    
-    return ident;
+    sqlite3pp::database& db = *connection->d->db;
+    db.execute("BEGIN IMMEDIATE;");
+    sqlite3pp::command& update = connection->cachedCommand("INSERT OR REPLACE INTO studyAccess(StudyInstanceUID, accessed) VALUES(?, ?);");
+    bool success = true;
+    for (const std::string& uid : studyInstanceUIDs) {
+        update.reset();
+        update.bind(1, uid, sqlite3pp::nocopy);
+        update.bind(2, time);
+        success = update.execute() == 0 && success;
+    }
+    update.reset();
+    db.execute(success ? "COMMIT;" : "ROLLBACK;");
+    if (!success) {
+        DCMNET_WARN("Failed to record the access to " << studyInstanceUIDs.size() << " studies of " << d->storagePath);
+    }
+    return success;
 }
 
 //--------------------------------------------------------------------------------------------
 
-Db_Id DcmSQLiteDatabase::insertstd(const std::map< DB_FindAttrExt, std::string, 
-    DB_FindAttrExtCompare >& keyValueList, Db_Id patientIdent)
+std::map<std::string, std::string> DcmSQLiteDatabase::instanceFiles(const std::vector<std::string>& sopInstanceUIDs) const
 {
-    return insert(keyValueList, patientIdent, DCM_StudyInstanceUID);
+    // well below the host parameter limit of SQLite
+    const size_t batchSize = 500;
+    std::map<std::string, std::string> files;
+    const std::string select = "SELECT " + getTagName(DCM_SOPInstanceUID) + ", " + getTagName(DCM_PrivateFileName)
+        + " FROM " + levelName(IMAGE_LEVEL) + " WHERE " + getTagName(DCM_SOPInstanceUID) + " IN (";
+    // instances are spread over the shards by study, which is not known here
+    for (size_t s = 0; s < d->shardCount; ++s) {
+        DcmSQLiteDatabase* connection = shard(s);
+        if (connection == NULL) {
+            continue;
+        }
+        for (size_t begin = 0; begin < sopInstanceUIDs.size(); begin += batchSize) {
+            const size_t end = std::min(begin + batchSize, sopInstanceUIDs.size());
+            std::string sql = select;
+            for (size_t i = begin; i < end; ++i) {
+                sql += i == begin ? "?" : ", ?";
+            }
+            sql += ");";
+            try {
+                sqlite3pp::query query(*connection->d->db, sql.c_str());
+                for (size_t i = begin; i < end; ++i) {
+                    query.bind(static_cast<int>(i - begin + 1), sopInstanceUIDs[i], sqlite3pp::nocopy);
+                }
+                for (sqlite3pp::query::iterator row = query.begin(); row != query.end(); ++row) {
+                    const char* file = (*row).get<const char*>(1);
+                    if (file != NULL && *file != '\0') {
+                        files[(*row).get<std::string>(0)] = file;
+                    }
+                }
+            }
+            catch (std::exception& e) {
+                DCMNET_ERROR("Failed to look up " << (end - begin) << " instances in " << d->storagePath << ": " << e.what());
+            }
+        }
+    }
+    return files;
 }
 
-Db_Id DcmSQLiteDatabase::insertser(const std::map< DB_FindAttrExt, std::string, 
-    DB_FindAttrExtCompare >& keyValueList, Db_Id studyIdent)
+//--------------------------------------------------------------------------------------------
+
+std::map<std::string, long long> DcmSQLiteDatabase::studyAccessTimes() const
 {
-    return insert(keyValueList, studyIdent, DCM_SeriesInstanceUID);
+    std::map<std::string, long long> times;
+    DcmSQLiteDatabase* connection = shard(0);
+    if (connection == NULL) {
+        return times;
+    }
+    try {
+        sqlite3pp::query query(*connection->d->db, "SELECT StudyInstanceUID, accessed FROM studyAccess;");
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            times[(*i).get<std::string>(0)] = (*i).get<long long int>(1);
+        }
+    }
+    catch (std::exception&) {
+        // indexes created before tiering have no access table until a writer opened them
+    }
+    return times;
 }
 
 //--------------------------------------------------------------------------------------------
 
-Db_Id DcmSQLiteDatabase::insertimg(const std::map< DB_FindAttrExt, std::string, 
-    DB_FindAttrExtCompare >& keyValueList, Db_Id seriesIdent)
+bool DcmSQLiteDatabase::announceNode(const DcmClusterNode& node)
 {
-    return insert(keyValueList, seriesIdent, DCM_SOPInstanceUID);
+    DcmSQLiteDatabase* connection = shard(0);
+    if (connection == NULL || !d->initialized) {
+        return false;
+    }
+    sqlite3pp::command& announce = connection->cachedCommand("INSERT OR REPLACE INTO clusterNodes(name, aeTitle, host, port, storagePath, heartbeat) VALUES(?, ?, ?, ?, ?, ?);");
+    announce.reset();
+    announce.bind(1, node.name, sqlite3pp::nocopy);
+    announce.bind(2, node.aeTitle, sqlite3pp::nocopy);
+    announce.bind(3, node.host, sqlite3pp::nocopy);
+    announce.bind(4, node.port);
+    announce.bind(5, node.storagePath, sqlite3pp::nocopy);
+    announce.bind(6, node.heartbeat);
+    const bool success = announce.execute() == 0;
+    announce.reset();
+    if (!success) {
+        DCMNET_WARN("Failed to announce cluster node " << node.name << " in the index of " << d->storagePath);
+    }
+    return success;
 }
 
 //--------------------------------------------------------------------------------------------
 
-Db_Id DcmSQLiteDatabase::insert(const std::map< DB_FindAttrExt, std::string, 
-    DB_FindAttrExtCompare >& keyValueList, Db_Id parentIdent, const DcmTagKey& primary)
+std::vector<DcmClusterNode> DcmSQLiteDatabase::clusterNodes(long long since) const
 {
-    Db_Id ident;
-    ident.level = static_cast<DB_LEVEL>(static_cast<int>(parentIdent.level) + 1);
-    ident.isNew = true;
+    std::vector<DcmClusterNode> nodes;
+    DcmSQLiteDatabase* connection = shard(0);
+    if (connection == NULL) {
+        return nodes;
+    }
+    try {
+        sqlite3pp::query query(*connection->d->db, "SELECT name, aeTitle, host, port, storagePath, heartbeat FROM clusterNodes WHERE heartbeat >= ? ORDER BY name;");
+        query.bind(1, since);
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            DcmClusterNode node;
+            node.name = (*i).get<std::string>(0);
+            node.aeTitle = (*i).get<std::string>(1);
+            node.host = (*i).get<std::string>(2);
+            node.port = (*i).get<int>(3);
+            node.storagePath = (*i).get<std::string>(4);
+            node.heartbeat = (*i).get<long long int>(5);
+            nodes.push_back(node);
+        }
+    }
+    catch (std::exception&) {
+        // indexes created before clustering have no membership table until a writer opened them
+    }
+    return nodes;
+}
 
-    std::string table = levelName(ident.level);
+//--------------------------------------------------------------------------------------------
 
-    std::string uid = hashv(keyValueList, primary);
+bool DcmSQLiteDatabase::recordPixelHashes(const std::map<std::string, std::string>& hashes)
+{
+    if (!d->initialized || hashes.empty()) {
+        return d->initialized;
+    }
+    sqlite3pp::database& db = *d->db;
+    db.execute("BEGIN IMMEDIATE;");
+    sqlite3pp::command& record = cachedCommand("INSERT OR REPLACE INTO pixelHash(SOPInstanceUID, hash) VALUES(?, ?);");
+    bool success = true;
+    for (const auto& hash : hashes) {
+        record.reset();
+        record.bind(1, hash.first, sqlite3pp::nocopy);
+        record.bind(2, hash.second, sqlite3pp::nocopy);
+        success = record.execute() == 0 && success;
+    }
+    record.reset();
+    db.execute(success ? "COMMIT;" : "ROLLBACK;");
+    if (!success) {
+        DCMNET_WARN("Failed to record the pixel hashes of " << hashes.size() << " instances in " << d->storagePath);
+    }
+    return success;
+}
 
-    std::string prepare("SELECT id FROM " + table + " WHERE " + getTagName(primary) + "= :uid");
+//--------------------------------------------------------------------------------------------
 
-    sqlite3pp::query query(*d->db, prepare.c_str());
-    query.bind(":uid", uid, sqlite3pp::nocopy);
+std::map<std::string, std::string> DcmSQLiteDatabase::pixelHashes() const
+{
+    std::map<std::string, std::string> hashes;
+    for (size_t s = 0; s < d->shardCount; ++s) {
+        DcmSQLiteDatabase* connection = shard(s);
+        if (connection == NULL) {
+            continue;
+        }
+        try {
+            sqlite3pp::query query(*connection->d->db, "SELECT SOPInstanceUID, hash FROM pixelHash;");
+            for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+                hashes[(*i).get<std::string>(0)] = (*i).get<std::string>(1);
+            }
+        }
+        catch (std::exception&) {
+            // indexes created before pixel hashes have no hash table until a writer opened them
+        }
+    }
+    return hashes;
+}
 
-    for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
-        for (int j = 0; j < query.column_count(); ++j) {
-            ident.primaryKey = (*i).get<OFlonglong>(j);
-            ident.isNew = false;
-            break;
+//--------------------------------------------------------------------------------------------
+
+bool DcmSQLiteDatabase::recordPixelStats(const std::map<std::string, DcmPixelStats>& stats)
+{
+    if (!d->initialized || stats.empty()) {
+        return d->initialized;
+    }
+    sqlite3pp::database& db = *d->db;
+    db.execute("BEGIN IMMEDIATE;");
+    sqlite3pp::command& record = cachedCommand("INSERT OR REPLACE INTO pixelStats(SOPInstanceUID, minimum, maximum, low, high, "
+        "windowCenter, windowWidth, histogram) VALUES(?, ?, ?, ?, ?, ?, ?, ?);");
+    bool success = true;
+    for (const auto& instance : stats) {
+        // the bin counts as a comma separated list
+        std::string histogram;
+        for (size_t i = 0; i < instance.second.histogram.size(); ++i) {
+            histogram += (i > 0 ? "," : "") + std::to_string(instance.second.histogram[i]);
         }
+        record.reset();
+        record.bind(1, instance.first, sqlite3pp::nocopy);
+        record.bind(2, instance.second.minimum);
+        record.bind(3, instance.second.maximum);
+        record.bind(4, instance.second.low);
+        record.bind(5, instance.second.high);
+        record.bind(6, instance.second.windowCenter);
+        record.bind(7, instance.second.windowWidth);
+        record.bind(8, histogram, sqlite3pp::copy);
+        success = record.execute() == 0 && success;
     }
-    if (ident.isNew) {
-        ident.primaryKey = insertatt(keyValueList, parentIdent.primaryKey, ident.level);
+    record.reset();
+    db.execute(success ? "COMMIT;" : "ROLLBACK;");
+    if (!success) {
+        DCMNET_WARN("Failed to record the pixel statistics of " << stats.size() << " instances in " << d->storagePath);
     }
-    return ident;
+    return success;
 }
 
 //--------------------------------------------------------------------------------------------
 
-OFlonglong DcmSQLiteDatabase::insertatt(const std::map< DB_FindAttrExt, 
-    std::string, DB_FindAttrExtCompare >& keyValueList, OFlonglong id, DB_LEVEL level)
+std::map<std::string, DcmPixelStats> DcmSQLiteDatabase::pixelStats(const std::vector<std::string>& sopInstanceUIDs) const
 {
-    std::vector<std::string> attributs;
-    std::vector<std::string> values;
-    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare>::const_iterator iter;
-    for (iter = keyValueList.begin(); iter != keyValueList.end(); iter++) {
-        if (iter->first.level == level) {
-            std::string attr = getTagName(iter->first.tag);
-            if (!attr.empty()) {
-                attributs.push_back(attr);
-                values.push_back(iter->second);
+    // well below the host parameter limit of SQLite
+    const size_t batchSize = 500;
+    std::map<std::string, DcmPixelStats> stats;
+    for (size_t s = 0; s < d->shardCount; ++s) {
+        DcmSQLiteDatabase* connection = shard(s);
+        if (connection == NULL) {
+            continue;
+        }
+        for (size_t begin = 0; begin < sopInstanceUIDs.size(); begin += batchSize) {
+            const size_t end = std::min(begin + batchSize, sopInstanceUIDs.size());
+            std::string sql = "SELECT SOPInstanceUID, minimum, maximum, low, high, windowCenter, windowWidth, histogram "
+                "FROM pixelStats WHERE SOPInstanceUID IN (";
+            for (size_t i = begin; i < end; ++i) {
+                sql += i == begin ? "?" : ", ?";
             }
-            else {
-                DCMNET_WARN("Tag not found:" << iter->first.tag.toString());
+            sql += ");";
+            try {
+                sqlite3pp::query query(*connection->d->db, sql.c_str());
+                for (size_t i = begin; i < end; ++i) {
+                    query.bind(static_cast<int>(i - begin + 1), sopInstanceUIDs[i], sqlite3pp::nocopy);
+                }
+                for (sqlite3pp::query::iterator row = query.begin(); row != query.end(); ++row) {
+                    DcmPixelStats& instance = stats[(*row).get<std::string>(0)];
+                    instance.minimum = (*row).get<double>(1);
+                    instance.maximum = (*row).get<double>(2);
+                    instance.low = (*row).get<double>(3);
+                    instance.high = (*row).get<double>(4);
+                    instance.windowCenter = (*row).get<double>(5);
+                    instance.windowWidth = (*row).get<double>(6);
+                    const char* histogram = (*row).get<const char*>(7);
+                    while (histogram != NULL && *histogram != '\0') {
+                        char* next = NULL;
+                        instance.histogram.push_back(std::strtoull(histogram, &next, 10));
+                        histogram = *next == ',' ? next + 1 : NULL;
+                    }
+                }
+            }
+            catch (std::exception&) {
+                // indexes created before pixel statistics have no table until a writer opened them
             }
         }
+    }
+    return stats;
+}
 
-        if ((level == IMAGE_LEVEL) && (iter->first.tag == DCM_PrivateCreator)) {
-            DCMNET_ERROR("Missing filename" << iter->second);
+//--------------------------------------------------------------------------------------------
+
+std::vector<DcmIndexChange> DcmSQLiteDatabase::changesSince(std::vector<long long>& position, size_t limit) const
+{
+    std::vector<DcmIndexChange> changes;
+    position.resize(d->shardCount, 0);
+    // a busy shard does not hold back the others
+    const size_t share = std::max<size_t>(1, limit / d->shardCount);
+    // studies and series reported by this call, further instances do not update them again
+    std::set<std::string> reported;
+    for (size_t s = 0; s < d->shardCount; ++s) {
+        DcmSQLiteDatabase* connection = shard(s);
+        if (connection == NULL) {
+            continue;
+        }
+        try {
+            sqlite3pp::query query(*connection->d->db, "SELECT seq, level, StudyInstanceUID, SeriesInstanceUID, SOPInstanceUID, time "
+                "FROM changeLog WHERE seq > ? ORDER BY seq LIMIT ?;");
+            query.bind(1, position[s]);
+            query.bind(2, static_cast<long long int>(share));
+            for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+                position[s] = (*i).get<long long int>(0);
+                const int created = (*i).get<int>(1);
+                DcmIndexChange change;
+                change.studyInstanceUID = (*i).get<std::string>(2);
+                change.seriesInstanceUID = (*i).get<std::string>(3);
+                change.sopInstanceUID = (*i).get<std::string>(4);
+                change.time = (*i).get<long long int>(5);
+                // the parents first, created or updated
+                const DB_LEVEL levels[] = { STUDY_LEVEL, SERIE_LEVEL, IMAGE_LEVEL };
+                for (DB_LEVEL level : levels) {
+                    const std::string& uid = level == STUDY_LEVEL ? change.studyInstanceUID : change.seriesInstanceUID;
+                    if (level != IMAGE_LEVEL && !reported.insert(uid).second && level < created) {
+                        continue;
+                    }
+                    DcmIndexChange event = change;
+                    event.level = level;
+                    event.action = level < created ? DcmIndexChange::UPDATED : DcmIndexChange::CREATED;
+                    if (level < IMAGE_LEVEL) {
+                        event.sopInstanceUID.clear();
+                    }
+                    if (level < SERIE_LEVEL) {
+                        event.seriesInstanceUID.clear();
+                    }
+                    changes.push_back(event);
+                }
+            }
+        }
+        catch (std::exception&) {
+            // indexes created before the change log have none until a writer opened them
         }
     }
+    return changes;
+}
 
-    std::string prepare = "INSERT INTO " + levelName(level) + " ( " + join(attributs, " , ")
-        + ", referenceId ) VALUES ( :" + join(attributs, ", :") + ", :referenceId ) ";
-
-    sqlite3pp::command cmd(*d->db, prepare.c_str());
+//--------------------------------------------------------------------------------------------
 
-    for (int u = 0; u < attributs.size(); u++) {
-        cmd.bind(std::string(std::string(":") + attributs.at(u)).c_str(), values.at(u), sqlite3pp::nocopy);
+std::vector<long long> DcmSQLiteDatabase::changeLogEnd() const
+{
+    std::vector<long long> position(d->shardCount, 0);
+    for (size_t s = 0; s < d->shardCount; ++s) {
+        DcmSQLiteDatabase* connection = shard(s);
+        if (connection == NULL) {
+            continue;
+        }
+        try {
+            sqlite3pp::query query(*connection->d->db, "SELECT MAX(seq) FROM changeLog;");
+            for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+                position[s] = (*i).get<long long int>(0);
+            }
+        }
+        catch (std::exception&) {
+            // no change log yet, nothing logged
+        }
     }
-    cmd.bind(":referenceId", id);
-
-    cmd.execute();
-    return d->db->last_insert_rowid();
+    return position;
 }
 
 //--------------------------------------------------------------------------------------------
 
-
-std::string DcmSQLiteDatabase::hashv(const std::map< DB_FindAttrExt, std::string, 
-    DB_FindAttrExtCompare >& keyValueList, DcmTagKey key)
+bool DcmSQLiteDatabase::scanInstances(size_t index, long long& after, size_t limit, std::vector< std::pair<long long, std::string> >& files) const
 {
-    std::string result;
-    std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare>::const_iterator iter;
-    iter = keyValueList.find(DB_FindAttrExt(key, PATIENT_LEVEL, UNIQUE_KEY));
-    if (iter != keyValueList.end()) {
-        result = iter->second;
+    files.clear();
+    DcmSQLiteDatabase* connection = shard(index);
+    if (connection == NULL || !d->initialized) {
+        return false;
     }
-    return result;
+    const std::string select = "SELECT id, " + getTagName(DCM_PrivateFileName) + " FROM " + levelName(IMAGE_LEVEL)
+        + " WHERE id > ? ORDER BY id LIMIT ?;";
+    try {
+        sqlite3pp::query& query = connection->cachedQuery(select);
+        query.bind(1, after);
+        query.bind(2, static_cast<long long int>(limit));
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            const char* file = (*i).get<const char*>(1);
+            files.push_back(std::make_pair((*i).get<long long int>(0), std::string(file != NULL ? file : "")));
+        }
+        query.reset();
+    }
+    catch (std::exception& e) {
+        DCMNET_ERROR("Failed to scan the instances of " << d->storagePath << ": " << e.what());
+        return false;
+    }
+    if (!files.empty()) {
+        after = files.back().first;
+    }
+    return files.size() == limit;
 }
 
 //--------------------------------------------------------------------------------------------
 
-bool DcmSQLiteDatabase::createTables()
+size_t DcmSQLiteDatabase::removeInstances(size_t index, const std::vector<long long>& ids)
 {
-    return createTable(PATIENT_LEVEL) && 
-           createTable(STUDY_LEVEL) && 
-           createTable(SERIE_LEVEL) && 
-           createTable(IMAGE_LEVEL);
+    DcmSQLiteDatabase* connection = shard(index);
+    if (connection == NULL || !d->initialized || d->readOnly || ids.empty()) {
+        return 0;
+    }
+    return connection->removeShardInstances(ids);
 }
 
 //--------------------------------------------------------------------------------------------
 
-bool DcmSQLiteDatabase::createTable(DB_LEVEL level)
+size_t DcmSQLiteDatabase::removeShardInstances(const std::vector<long long>& ids)
 {
-    std::string table = levelName(level);
-    std::vector<std::string> list;
-    list.push_back("CREATE TABLE IF NOT EXISTS " + table + "(");
-    list.push_back("id INTEGER PRIMARY KEY AUTOINCREMENT,");
-    list.push_back("referenceId INTEGER,");
+    const std::string patient = levelName(PATIENT_LEVEL);
+    const std::string study = levelName(STUDY_LEVEL);
+    const std::string series = levelName(SERIE_LEVEL);
+    const std::string image = levelName(IMAGE_LEVEL);
+    // the ids of a level as "(1,2,3)", empty if there are none
+    auto idList = [this](const std::string& sql) {
+        std::string list;
+        sqlite3pp::query query(*d->db, sql.c_str());
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            list += (list.empty() ? "(" : ",") + std::to_string((*i).get<long long int>(0));
+        }
+        return list.empty() ? list : list + ")";
+    };
+    std::string images;
+    for (long long id : ids) {
+        images += (images.empty() ? "(" : ",") + std::to_string(id);
+    }
+    images += ")";
 
-    for (auto attr : d->definedTags) {
-        if (attr.level == level) {
-            std::string terminator = ",";
-            if (attr.keyAttr == UNIQUE_KEY)
-                terminator = "UNIQUE,";
-            list.push_back(getTagName(attr.tag) + " TEXT " + terminator);
+    // as short as the ingest transactions, which wait for it
+    int rc = d->db->execute("BEGIN IMMEDIATE;");
+    for (int attempt = 1; rc == SQLITE_BUSY && attempt < busyAttempts; ++attempt) {
+        rc = d->db->execute("BEGIN IMMEDIATE;");
+    }
+    if (rc != 0) {
+        DCMNET_WARN("Index of " << d->storagePath << " is locked, instances not removed");
+        return 0;
+    }
+    size_t removed = 0;
+    bool success = true;
+    try {
+        const std::string seriesIds = idList("SELECT DISTINCT referenceId FROM " + image + " WHERE id IN " + images + ";");
+        const std::string studyIds = seriesIds.empty() ? seriesIds
+            : idList("SELECT DISTINCT referenceId FROM " + series + " WHERE id IN " + seriesIds + ";");
+        const std::string patientIds = studyIds.empty() ? studyIds
+            : idList("SELECT DISTINCT referenceId FROM " + study + " WHERE id IN " + studyIds + ";");
+
+        std::vector<std::string> statements;
+        statements.push_back("DELETE FROM pixelHash WHERE SOPInstanceUID IN (SELECT " + getTagName(DCM_SOPInstanceUID)
+            + " FROM " + image + " WHERE id IN " + images + ");");
+        statements.push_back("DELETE FROM pixelStats WHERE SOPInstanceUID IN (SELECT " + getTagName(DCM_SOPInstanceUID)
+            + " FROM " + image + " WHERE id IN " + images + ");");
+        statements.push_back("DELETE FROM " + image + " WHERE id IN " + images + ";");
+        for (size_t i = 0; i < statements.size() && success; ++i) {
+            success = d->db->execute(statements[i].c_str()) == 0;
+        }
+        removed = success ? static_cast<size_t>(d->db->changes()) : 0;
+
+        // the parents left without children go, the others are counted again
+        statements.clear();
+        if (!seriesIds.empty()) {
+            statements.push_back("DELETE FROM " + series + " WHERE id IN " + seriesIds + " AND NOT EXISTS (SELECT 1 FROM "
+                + image + " WHERE " + image + ".referenceId = " + series + ".id);");
         }
+        if (!studyIds.empty()) {
+            statements.push_back("DELETE FROM " + study + " WHERE id IN " + studyIds + " AND NOT EXISTS (SELECT 1 FROM "
+                + series + " WHERE " + series + ".referenceId = " + study + ".id);");
+        }
+        const std::string emptyPatients = patientIds.empty() ? patientIds : " WHERE id IN " + patientIds
+            + " AND NOT EXISTS (SELECT 1 FROM " + study + " WHERE " + study + ".referenceId = " + patient + ".id)";
+        if (!emptyPatients.empty() && d->nameSearch) {
+            // a contentless full text index is told the values of the rows it drops
+            const std::string name = getTagName(DCM_PatientName);
+            statements.push_back("INSERT INTO patientNameSearch(patientNameSearch, rowid, " + name + ") SELECT 'delete', id, "
+                + name + " FROM " + patient + emptyPatients + " AND " + name + " IS NOT NULL;");
+        }
+        if (!emptyPatients.empty()) {
+            statements.push_back("DELETE FROM " + patient + emptyPatients + ";");
+        }
+        for (size_t i = 0; i < statements.size() && success; ++i) {
+            success = d->db->execute(statements[i].c_str()) == 0;
+        }
+        success = success && (studyIds.empty() || recomputeAggregates(studyIds, seriesIds));
     }
-    list.push_back(" PlaceHoler TEXT");
-    list.push_back(");");
+    catch (std::exception& e) {
+        DCMNET_ERROR("Failed to remove instances from " << d->storagePath << ": " << e.what());
+        success = false;
+    }
+    if (!success || d->db->execute("COMMIT;") != 0) {
+        DCMNET_ERROR("Failed to remove " << ids.size() << " instances from " << d->storagePath);
+        d->db->execute("ROLLBACK;");
+        return 0;
+    }
+    // the inserts must not reuse the ids of the series and studies removed
+    invalidateIdCaches();
+    return removed;
+}
 
-    std::string prepare = join(list, " ");
+//--------------------------------------------------------------------------------------------
 
-    if (d->db->execute(prepare.c_str()) != 0) {
-        DCMNET_ERROR("Failed to create table: " + table);
-        return false;
+size_t DcmSQLiteDatabase::compact(size_t index, int budget)
+{
+    DcmSQLiteDatabase* connection = shard(index);
+    if (connection == NULL || !d->initialized || d->readOnly) {
+        return 0;
+    }
+    sqlite3pp::database& db = *connection->d->db;
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget);
+    auto pragma = [&db](const char* sql) {
+        long long value = 0;
+        sqlite3pp::query query(db, sql);
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            value = (*i).get<long long int>(0);
+        }
+        return value;
+    };
+    size_t freed = 0;
+    try {
+        // a few pages per transaction, the ingest writers get the lock in between
+        long long pages = 0;
+        if (pragma("PRAGMA auto_vacuum;") == 2) {
+            pages = pragma("PRAGMA freelist_count;");
+            while (pages > 0 && std::chrono::steady_clock::now() < deadline) {
+                db.execute("PRAGMA incremental_vacuum(64);");
+                const long long left = pragma("PRAGMA freelist_count;");
+                if (left >= pages) {
+                    break;
+                }
+                freed += static_cast<size_t>(pages - left);
+                pages = left;
+            }
+        }
+        // once the pages are freed. Sampled statistics take a few ms per index, also on large tables
+        if (pages == 0 && std::chrono::steady_clock::now() < deadline) {
+            const std::string limit = "PRAGMA analysis_limit=" + std::to_string(analysisLimit) + ";";
+            db.execute(limit.c_str());
+            // prepared statements are planned again with the new statistics on their next step
+            db.execute("ANALYZE;");
+        }
     }
-    return createIndex(level);
+    catch (std::exception& e) {
+        DCMNET_WARN("Failed to compact the index of " << d->storagePath << ": " << e.what());
+    }
+    return freed;
 }
 
 //--------------------------------------------------------------------------------------------
 
-bool DcmSQLiteDatabase::createIndex(DB_LEVEL level)
+bool DcmSQLiteDatabase::optimize(size_t index)
 {
-    std::string table = levelName(level);
-    std::string prepare = "CREATE INDEX IF NOT EXISTS "+ table +"Index ON " + table + "(referenceId);";
- 
-    if (d->db->execute(prepare.c_str()) != 0) {
-        DCMNET_ERROR("Failed to create index on table: " + table);
+    DcmSQLiteDatabase* connection = shard(index);
+    if (connection == NULL || !d->initialized || d->readOnly) {
+        return false;
+    }
+    try {
+        const std::string limit = "PRAGMA analysis_limit=" + std::to_string(analysisLimit) + ";";
+        connection->d->db->execute(limit.c_str());
+        return connection->d->db->execute("PRAGMA optimize;") == 0;
+    }
+    catch (std::exception& e) {
+        DCMNET_WARN("Failed to refresh the statistics of the index of " << d->storagePath << ": " << e.what());
         return false;
     }
-    return true;
 }
 
 //--------------------------------------------------------------------------------------------
 
+void DcmSQLiteDatabase::readAhead(size_t index, size_t maxBytes) const
+{
+#ifdef __linux__
+    const std::string file = d->storagePath + (index == 0 ? std::string("/image.db") : "/image-" + std::to_string(index) + ".db");
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    // the kernel reads asynchronously, the pages stay cached after the descriptor is closed
+    (void) posix_fadvise(fd, 0, static_cast<off_t>(maxBytes), POSIX_FADV_WILLNEED);
+    ::close(fd);
+#else
+    (void) index;
+    (void) maxBytes;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------
+
+std::vector<std::string> DcmSQLiteDatabase::explainQueryPlan(const std::string& sql) const
+{
+    std::vector<std::string> result;
+    std::string prepare = "EXPLAIN QUERY PLAN " + sql;
+
+    try {
+        sqlite3pp::query query(*d->db, prepare.c_str());
+        for (sqlite3pp::query::iterator i = query.begin(); i != query.end(); ++i) {
+            // columns are id, parent, notused and detail
+            const char* detail = (*i).get<char const*>(3);
+            result.push_back(detail ? detail : "");
+        }
+    }
+    catch (std::exception& e) {
+        DCMNET_WARN("Failed to explain query: " << e.what());
+    }
+    return result;
+}
 
+//--------------------------------------------------------------------------------------------
@@ -1,7 +1,7 @@
 #ifndef DCMSQLDB_H
 #define DCMSQLDB_H
 
-#include "dcmsqldef.h"
+#include "dcmidxdb.h"
 
 #include "dcmtk/config/osconfig.h"     /* make sure OS specific configuration is included first */
 #include "dcmtk/dcmqrdb/dcmqrcnf.h"
@@ -12,10 +12,34 @@
 
 class DcmTagKey;
 class DcmSQLiteDatabasePrivate;
+class DcmSQLiteFindCursor;
+class DcmSQLiteFindCursorPrivate;
+struct DcmSQLiteFindPage;
 
+namespace sqlite3pp {
+    class query;
+    class command;
+}
+
+
+// PRAGMAs of the SQLite connections opened from now on, see DcmSQLiteDatabase::configureTuning()
+struct DcmSQLiteTuning
+{
+    DcmSQLiteTuning() : cacheSize(0), mmapSize(0), pageSize(0), journalMode("wal"), synchronous("normal"), tempStore("default") {}
+    // MB of page cache of each connection, 0 for the SQLite default of 2 MB
+    int cacheSize;
+    // MB of each index file read through a memory mapping instead of read() calls, 0 for none
+    int mmapSize;
+    // bytes of a page of the indexes created from now on, a power of two from 512 to 65536, 0 for 4096
+    int pageSize;
+    // "wal", "truncate" or "delete", only WAL lets queries read while an association is storing
+    std::string journalMode;
+    // "off", "normal", "full" or "extra"
+    std::string synchronous;
+    // "default", "file" or "memory" for the temporary tables and indexes of sorts
+    std::string tempStore;
+};
 
-// private field to be used to store filename of imported files
-#define DCM_PrivateFileName                            DcmTagKey(0x0011, 0x0011)
 
 class Db_Id
 {
@@ -27,34 +51,167 @@ public:
     bool isNew;
 };
 
-struct sQRes {
-    OFlonglong id;
-    std::list< DcmSmallDcmElm > resultList;
-};
 
+// Forward only cursor over the matches of a find request, rows are stepped out of SQLite on demand
+class DcmSQLiteFindCursor : public DcmIndexFindCursor
+{
+public:
+    virtual ~DcmSQLiteFindCursor();
+
+    virtual bool next(std::list<DcmSmallDcmElm>& responseList);
+
+    // stop stepping and hand the statement back to its connection
+    virtual void close();
+
+    virtual std::string position() const;
+
+private:
+    friend class DcmSQLiteDatabase;
+
+    // the next match of the statement or the parts, without the limit of a page
+    bool fetch(std::list<DcmSmallDcmElm>& responseList);
+
+    DcmSQLiteFindCursor(DcmSQLiteFindCursorPrivate* priv);
+    /* not defined */ DcmSQLiteFindCursor(const DcmSQLiteFindCursor& clone);
+    /* not defined */ DcmSQLiteFindCursor& operator=(const DcmSQLiteFindCursor& clone);
 
-class DcmSQLiteDatabase
+    DcmSQLiteFindCursorPrivate* d;
+};
+
+// Index in the SQLite files of the storage area
+class DcmSQLiteDatabase : public DcmIndexDatabase
 {
 public:
-    DcmSQLiteDatabase(const OFFilename& path);
-    ~DcmSQLiteDatabase();
+    // read-only connections never create the schema, they see the index as of the start of
+    // each statement and are not blocked by the ingest writers
+    DcmSQLiteDatabase(const OFFilename& path, bool createSchema = true, bool readOnly = false);
+    virtual ~DcmSQLiteDatabase();
+
+    virtual const std::string& storagePath() const;
+
+    virtual bool isInitialized() const;
+
+    // the index of a storage area is split by StudyInstanceUID into shardCount() SQLite files,
+    // image.db and image-<n>.db, each with its own write lock. This connection is on shard
+    // shardIndex(), inserts are routed to the shard of their study and finds run on every shard
+    virtual size_t shardCount() const;
+    size_t shardIndex() const;
+    virtual size_t shardOf(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList) const;
+
+    // connection to a shard of the storage area, this one for its own shard, the others are
+    // opened on first use and owned by this connection. NULL if the shard cannot be opened
+    virtual DcmSQLiteDatabase* shard(size_t index) const;
+
+    // number of shards of the indexes created from now on, an existing index keeps its own
+    static void configureShards(size_t count);
+
+    // PRAGMAs of the connections opened from now on, empty modes keep their defaults. False with
+    // error if a value is not supported
+    static bool configureTuning(const DcmSQLiteTuning& tuning, std::string& error);
+
+    virtual void trimStatementCache(size_t maxStatements);
+
+    virtual DcmSQLiteFindCursor* openFind(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel) const;
+
+    // keyset pages, newest study first: ordered by the integer copy of StudyDate with the studies
+    // without one last, then by the shard and the ids of the levels from the study down to the query
+    // level. Patient level pages by the shard and the patient id, a patient with studies on several
+    // shards may then show up on more than one page. Each shard reads at most limit rows per page
+    virtual DcmSQLiteFindCursor* openFindPage(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel,
+        size_t limit, const std::string& after) const;
+
+    virtual OFCondition insertMetaData(DcmDataset* dataset, const OFString& filename);
+
+    // makes all connections forget the primary keys of patients, studies and series remembered by
+    // their inserts, to be called after rows have been deleted
+    static void invalidateIdCaches();
 
-    std::list< std::list<DcmSmallDcmElm> > find(std::list<DcmSmallDcmElm> findRequestList,
-        DB_LEVEL queryLevel, DB_LEVEL qLevel, DB_LEVEL lLevel) const;
+    // SQLite is built with FTS5, *WORD* patient name keys then use a full text index
+    static bool nameSearchAvailable();
 
-    OFCondition insertMetaData(DcmDataset* dataset, const OFString& filename);
+    // one transaction per shard
+    virtual std::vector<bool> insertBatch(const std::vector< std::map< DB_FindAttrExt, std::string,
+        DB_FindAttrExtCompare > >& batch);
 
-    std::vector<DB_FindAttrExt> definedAttributes() const;
+    // drops the matching key indexes of all shards and stops syncing the batches, an interrupted
+    // import is repeated from the files and its indexes are built again on the next open
+    virtual bool beginBulkLoad();
+    virtual bool endBulkLoad();
+
+    // one statement per shard and batch of SOPInstanceUIDs
+    virtual std::map<std::string, std::string> instanceFiles(const std::vector<std::string>& sopInstanceUIDs) const;
+
+    // kept in the studyAccess table of the first shard
+    virtual bool recordStudyAccess(const std::vector<std::string>& studyInstanceUIDs, long long time);
+    virtual std::map<std::string, long long> studyAccessTimes() const;
+
+    // kept in the clusterNodes table of the first shard, e.g. of SCPs on one host or a shared volume
+    virtual bool announceNode(const DcmClusterNode& node);
+    virtual std::vector<DcmClusterNode> clusterNodes(long long since) const;
+
+    // kept in the pixelHash table of the shard of the instances, recorded with their batch
+    virtual bool recordPixelHashes(const std::map<std::string, std::string>& hashes);
+    virtual std::map<std::string, std::string> pixelHashes() const;
+
+    // kept in the pixelStats table of the shard of the instances, recorded with their batch
+    virtual bool recordPixelStats(const std::map<std::string, DcmPixelStats>& stats);
+    virtual std::map<std::string, DcmPixelStats> pixelStats(const std::vector<std::string>& sopInstanceUIDs) const;
+
+    // kept in the changeLog table of the shard of the instances, written with their batch
+    virtual std::vector<DcmIndexChange> changesSince(std::vector<long long>& position, size_t limit) const;
+    virtual std::vector<long long> changeLogEnd() const;
+
+    // the freed pages of indexes created with incremental auto vacuum are returned by compact(),
+    // older indexes keep them for later inserts. Once none is left ANALYZE samples analysisLimit
+    // rows per index
+    virtual bool scanInstances(size_t shard, long long& after, size_t limit, std::vector< std::pair<long long, std::string> >& files) const;
+    virtual size_t removeInstances(size_t shard, const std::vector<long long>& ids);
+    virtual size_t compact(size_t shard, int budget);
+
+    // PRAGMA optimize with the analysisLimit of compact(), the statistics are in sqlite_stat1
+    virtual bool optimize(size_t shard);
+    virtual void readAhead(size_t shard, size_t maxBytes) const;
+
+    static const int analysisLimit = 1000;
+
+    // EXPLAIN QUERY PLAN diagnostic, one line per step of the plan
+    std::vector<std::string> explainQueryPlan(const std::string& sql) const;
 
 
 protected:
 
-    std::vector<std::string> modalitiesInStudy(long long studyReferenceId, int& seriesSearched) const;
+    // connection to a further shard of the storage area
+    DcmSQLiteDatabase(const OFFilename& path, size_t shard, size_t shardCount, bool createSchema, bool readOnly);
 
-    int numSeriesInstances(long long seriesReferenceId) const;
+    void open(const OFFilename& path, bool createSchema);
+
+    // finds on the shard of this connection only, a page of at most limit rows after the position
+    // after if page is one of the page modes of the statement shape
+    DcmSQLiteFindCursor* openShardFind(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel,
+        char page = 0, const DcmSQLiteFindPage* after = NULL, size_t limit = 0) const;
+
+    // the shard count is fixed when the index is created and kept in its settings table
+    bool storeShardCount();
+    size_t storedShardCount() const;
 
     bool insertDb(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList);
 
+    // maintain ModalitiesInStudy and the NumberOf...Related... counters of the parents
+    void updateAggregates(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList,
+        const Db_Id& studyIdent, const Db_Id& seriesIdent, const Db_Id& imageIdent);
+
+    // for the studies and series of the id lists, e.g. "(1,2)", or all of them
+    bool recomputeAggregates(const std::string& studyIds = std::string(), const std::string& seriesIds = std::string());
+
+    // removeInstances() on the shard of this connection
+    size_t removeShardInstances(const std::vector<long long>& ids);
+
+    // folds patients with the same ID and name into the oldest one, before their identity
+    // becomes unique
+    bool mergeDuplicatePatients();
+
+    bool isAggregateField(const DcmTagKey& key) const;
+
     Db_Id insertpat(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList);
 
     Db_Id insertstd(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList, Db_Id patientIdent);
@@ -65,12 +222,15 @@ protected:
 
     Db_Id insert(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList, Db_Id parentIdent, const DcmTagKey& primary);
 
-    OFlonglong insertatt(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare>& keyValueList, OFlonglong id, DB_LEVEL level);
+    // inserts the row unless one with the same conflict columns exists, returns its id or 0
+    OFlonglong insertatt(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare>& keyValueList, OFlonglong id, DB_LEVEL level,
+        const std::string& conflict);
 
-    std::string hashv(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList, DcmTagKey key);
+    // id of the value in the dictionary table, added if new, 0 on error
+    OFlonglong internedId(const std::string& value);
+    bool hasInternedColumns() const;
 
-    std::list< sQRes > query(const std::list<DcmSmallDcmElm>& findRequestList, DB_LEVEL queryLevel, DB_LEVEL currentLevel,
-        const sQRes& preResults, std::list< std::list<DcmSmallDcmElm> >& finalResuls) const;
+    std::string hashv(const std::map< DB_FindAttrExt, std::string, DB_FindAttrExtCompare >& keyValueList, DcmTagKey key);
 
     bool isDateField(const DcmTagKey& key) const;
     bool isTimeField(const DcmTagKey& key) const;
@@ -81,12 +241,39 @@ protected:
 
     DB_LEVEL tagLevel( DcmTagKey key ) const;
 
+    // prepared statement cache keyed by SQL text, the returned statement is reset
+    // SELECT of a find request from its keys and the kind of their match
+    std::string findStatement(const std::vector<DcmTagKey>& trackList, const std::vector<char>& matchList, DB_LEVEL queryLevel,
+        char page = 0) const;
+
+    sqlite3pp::query& cachedQuery(const std::string& sql) const;
+    sqlite3pp::command& cachedCommand(const std::string& sql) const;
+
+    // take a statement out of the cache for the lifetime of a cursor and hand it back
+    sqlite3pp::query* checkoutQuery(const std::string& sql) const;
+    void checkinQuery(const std::string& sql, sqlite3pp::query* query) const;
+
+    bool configureConnection();
+
     bool createTables();
     bool createTable(DB_LEVEL level);
     bool createIndex(DB_LEVEL level);
+    bool createIndexes();
+    // the indexes which are not UNIQUE, the inserts do not look anything up with them
+    bool dropIndexes();
+    // uppercase copies of the person name columns (schema version 5), integer copies of the
+    // date and time columns (version 6)
+    bool addDerivedColumns();
+    bool addDerivedColumns(DB_LEVEL level);
+
+    // full text index of the patient names, when SQLite is built with FTS5
+    bool createNameSearch();
+    bool hasNameSearch() const;
 
 private:
-    DcmSQLiteDatabasePrivate* d;
+    friend class DcmSQLiteFindCursor;
 
+    DcmSQLiteDatabasePrivate* d;
 };
+
 #endif
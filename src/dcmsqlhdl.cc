@@ -1,48 +1,56 @@
 #include "dcmsqlhdl.h"
 
-#include "dcmsqldb.h"
+#include "dcmidxdb.h"
+#include "Cluster.h"
+#include "CpuPlacement.h"
+#include "StorageBackend.h"
+#include "StorageTier.h"
+#include "PixelHash.h"
+#include "PixelStats.h"
+#include "Metrics.h"
+#include "SeriesMetadata.h"
+#include "IndexMaintenance.h"
+#include "WarmStart.h"
 
 #include "dcmtk/ofstd/ofstdinc.h"
 #include "dcmtk/dcmqrdb/dcmqrdbs.h"
 #include "dcmtk/dcmqrdb/dcmqrcnf.h"
 #include "dcmtk/dcmqrdb/dcmqropt.h"
 #include "dcmtk/dcmqrdb/dcmqridx.h"
+#include "dcmtk/dcmqrdb/dcmqrpck.h"
 #include "dcmtk/dcmnet/diutil.h"
 #include "dcmtk/dcmdata/dcfilefo.h"
 #include "dcmtk/dcmdata/dcdatset.h"
+#include "dcmtk/dcmdata/dcproj.h"
 #include "dcmtk/ofstd/ofstd.h"
+#include "dcmtk/ofstd/oftrace.h"
 #include "dcmtk/dcmdata/dcdeftag.h"
+#include "dcmtk/dcmdata/dcvrut.h"
 
+#include <map>
 #include <queue>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+#include <ctime>
 
+#include <sys/types.h>
+#include <sys/stat.h>
 
-//------------------------------------------------------------------------------------------------------
-
-void DcmQueryRetriveConfigExt::addPeer(const char* AETitle, const char* HostName, int PortNumber)
-{
-    sPeer p;
-    p.aet = std::string(AETitle);
-    p.hostname = std::string(HostName);
-    p.port = PortNumber;
-    _peers.push_back(p);
-}
 
 //------------------------------------------------------------------------------------------------------
 
 int DcmQueryRetriveConfigExt::peerForAETitle(const char* AETitle, const char** HostName, int* PortNumber) const {
 
-    std::list<sPeer>::const_iterator it;
-    for (it = _peers.begin(); it != _peers.end(); it++)
-    {
-        // Access the object through iterator
-        if (strcmp(it->aet.c_str(), AETitle) == 0) {
-            size_t len = strlen(it->hostname.c_str());
-            char* name = new char[len + 1];
-            strcpy(name, it->hostname.c_str());
-            *HostName = name;
-            *PortNumber = it->port;
-            return 1;
-        }
+    std::shared_ptr<const PeerTable::sPeer> peer = _peers->find(AETitle);
+    if (peer) {
+        // a copy, the table may be replaced before the caller is done with it
+        char* name = new char[peer->hostname.size() + 1];
+        strcpy(name, peer->hostname.c_str());
+        *HostName = name;
+        *PortNumber = peer->port;
+        return 1;
     }
     DCMNET_WARN("No matching AET found for AET:" << AETitle);
     return 0;
@@ -54,14 +62,8 @@ int DcmQueryRetriveConfigExt::peerInAETitle(const char* calledAETitle, const cha
 {
     if (_permissive) return 1;
 
-    std::list<sPeer>::const_iterator it;
-    for (it = _peers.begin(); it != _peers.end(); it++)
-    {
-        // Access the object through iterator
-        if (strcmp(it->aet.c_str(), callingAETitle) == 0 /* &&
-            strcmp(it->hostname.c_str(), HostName) == 0 */) {
-            return 1;
-        }
+    if (_peers->find(callingAETitle)) {
+        return 1;
     }
     DCMNET_WARN("No matching AET found for calling AET:" << callingAETitle);
     return 0;
@@ -75,7 +77,80 @@ int DcmQueryRetriveConfigExt::checkForSameVendor(const char* AETitle1, const cha
 
 //------------------------------------------------------------------------------------------------------
 
-DcmQueryRetrieveSQLiteDatabaseHandleFactory::DcmQueryRetrieveSQLiteDatabaseHandleFactory(const DcmQueryRetrieveConfig* config)
+int DcmQueryRetriveConfigExt::preferCompressed(const char* AETitle, const char* HostName, const char* SOPClassUID) const
+{
+    // a compression configured for the peer wins over the measured link
+    std::shared_ptr<const PeerTable::sPeer> peer = _peers->find(AETitle);
+    return TransferPolicy::preferCompressed(TransferPolicy::hostOf(HostName), AETitle, SOPClassUID,
+        peer ? peer->compression : TransferPolicy::DEFAULT);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+void DcmQueryRetriveConfigExt::transferCompleted(const char* AETitle, const char* HostName, Uint64 bytes, double seconds) const
+{
+    TransferPolicy::recordTransfer(TransferPolicy::hostOf(HostName), bytes, seconds);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+T_DIMSE_Priority DcmQueryRetriveConfigExt::priorityForAETitle(const char* AETitle, T_DIMSE_Priority requested) const
+{
+    // a priority class configured for the peer wins over the one of the request
+    std::shared_ptr<const PeerTable::sPeer> peer = _peers->find(AETitle);
+    return peer && peer->fixedPriority ? peer->priority : requested;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+OFBool DcmQueryRetriveConfigExt::admitAssociation(const char* AETitle, const char* HostName) const
+{
+    if (!_limiter) {
+        return OFTrue;
+    }
+    RateLimiter::eVerdict verdict = _limiter->admit(AETitle, HostName);
+    if (verdict != RateLimiter::ADMITTED) {
+        Metrics::counter("scp_refused_total", {{"limit", RateLimiter::name(verdict)}}).add();
+        return OFFalse;
+    }
+    return OFTrue;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+void DcmQueryRetriveConfigExt::associationStarted(const char* /*AETitle*/, const char* /*HostName*/) const
+{
+    // the association, its index queries and sub-operations run on the node of the "association"
+    // placement
+    CpuPlacement::enter("association");
+}
+
+//------------------------------------------------------------------------------------------------------
+
+void DcmQueryRetriveConfigExt::associationReleased(const char* AETitle, const char* HostName) const
+{
+    // nothing if the association was not started on this thread
+    CpuPlacement::leave();
+    if (_limiter) {
+        _limiter->release(AETitle, HostName);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+
+void DcmQueryRetriveConfigExt::throttleTransfer(const char* AETitle, const char* HostName, Uint64 bytes) const
+{
+    if (_limiter) {
+        double seconds = _limiter->throttle(AETitle, HostName, bytes);
+        if (seconds > 0) {
+            Metrics::histogram("scp_throttle_seconds").record(seconds);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+
+DcmQueryRetrieveSQLiteDatabaseHandleFactory::DcmQueryRetrieveSQLiteDatabaseHandleFactory(const DcmQueryRetriveConfigExt* config)
     : DcmQueryRetrieveDatabaseHandleFactory()
     , config_(config)
 {
@@ -89,7 +164,7 @@ DcmQueryRetrieveDatabaseHandle* DcmQueryRetrieveSQLiteDatabaseHandleFactory::cre
     const char* calledAETitle,
     OFCondition& result) const
 {
-    return new DcmQueryRetrieveSQLiteDatabaseHandle(config_->getStorageArea(calledAETitle));
+    return new DcmQueryRetrieveSQLiteDatabaseHandle(config_->getStorageArea(calledAETitle), config_->moveOrder());
 }
 
 //------------------------------------------------------------------------------------------------------
@@ -105,7 +180,7 @@ public:
         CECHO
     };
 
-    DcmQueryRetrieveSQLiteDatabaseHandlePrivate(const OFFilename& path);
+    DcmQueryRetrieveSQLiteDatabaseHandlePrivate(const OFFilename& path, DcmQueryRetriveConfigExt::eMoveOrder order);
     ~DcmQueryRetrieveSQLiteDatabaseHandlePrivate();
 
     bool isSOPClassSupported(const std::string& SOPClassUID, ctype type);
@@ -116,8 +191,6 @@ public:
 
     void DB_DuplicateElement(DB_SmallDcmElmt* src, DB_SmallDcmElmt* dst);
 
-    void DB_MakeResponseList(std::list<DcmSmallDcmElm> lst);
-
     OFCondition DB_FreeElementList(DB_ElementList* lst);
 
     OFCondition DB_GetTagLevel(DcmTagKey tag, DB_LEVEL* level);
@@ -134,18 +207,51 @@ public:
 
     bool containsAttribute(const std::list<DcmSmallDcmElm>& list, DcmTagKey key);
 
-    DcmSQLiteDatabase* db;
+    // pull the next C-FIND match out of the cursor into findMatch
+    void nextFindMatch();
+
+    // builds the response template of the request keys and the query level, the one of the previous
+    // query of the association is kept if the keys are the same
+    void prepareFindTemplate(DB_ElementList* requestList);
+
+    // a copy of the response template with the values of findMatch, NULL if out of memory
+    DcmDataset* makeFindResponse();
+
+    // hands the instance to the ingest queue and appends it to the metadata of its series
+    OFCondition storeInstance(DcmDataset* dataset, const char* imageFileName);
+
+    DcmIndexDatabase* db;
+    DcmIndexFindCursor* findCursor;
     DB_Private_Handle* handle;
     OFFilename storagePath;
     std::queue< std::list< DcmSmallDcmElm > > findResult;
+    // the current match and whether there is one
+    std::list<DcmSmallDcmElm> findMatch;
+    bool findMatched;
+    // a paged find returns the continuation token after each match with it
+    bool findPaged;
+    std::string findPosition;
+    // response with an empty element per request key in dataset order and the query level, copied for
+    // each match, and the keys of its elements in the same order
+    DcmDataset* findTemplate;
+    std::vector<DcmTagKey> findTemplateKeys;
+    DB_LEVEL findTemplateLevel;
     OFFilename rootPath;
+    DcmQueryRetriveConfigExt::eMoveOrder moveOrder;
 };
 
 
 
-DcmQueryRetrieveSQLiteDatabaseHandlePrivate::DcmQueryRetrieveSQLiteDatabaseHandlePrivate(const OFFilename& path)
+DcmQueryRetrieveSQLiteDatabaseHandlePrivate::DcmQueryRetrieveSQLiteDatabaseHandlePrivate(const OFFilename& path, DcmQueryRetriveConfigExt::eMoveOrder order)
 {
-    db = new DcmSQLiteDatabase(path);
+    moveOrder = order;
+    // finds and moves read a snapshot of the index, stores are written by the ingest queue
+    db = DcmIndexDatabasePool::acquireReader(path);
+    findCursor = NULL;
+    findMatched = false;
+    findPaged = false;
+    findTemplate = NULL;
+    findTemplateLevel = PATIENT_LEVEL;
     handle = new DB_Private_Handle;
     storagePath = path;
 }
@@ -155,9 +261,17 @@ DcmQueryRetrieveSQLiteDatabaseHandlePrivate::DcmQueryRetrieveSQLiteDatabaseHandl
 DcmQueryRetrieveSQLiteDatabaseHandlePrivate::~DcmQueryRetrieveSQLiteDatabaseHandlePrivate()
 {
     DB_FreeElementList(handle->findRequestList);
-    DB_FreeElementList(handle->findResponseList);
     delete handle;
     handle = NULL;
+    delete findCursor;
+    findCursor = NULL;
+    delete findTemplate;
+    findTemplate = NULL;
+    // stores may still be queued with the QUEUED durability, make sure they hit the index
+    // before the association ends, a forked child would otherwise lose them
+    DcmIndexIngestQueue::flush(db->storagePath());
+    DcmIndexDatabasePool::release(db);
+    db = NULL;
 }
 
 //------------------------------------------------------------------------------------------------------
@@ -332,55 +446,6 @@ void DcmQueryRetrieveSQLiteDatabaseHandlePrivate::DB_DuplicateElement(DB_SmallDc
 
 //------------------------------------------------------------------------------------------------------
 
-void DcmQueryRetrieveSQLiteDatabaseHandlePrivate::DB_MakeResponseList(std::list<DcmSmallDcmElm> lst)
-{
-    DB_ElementList* pRequestList = NULL;
-    DB_ElementList* plist = NULL;
-    DB_ElementList* last = NULL;
-
-    this->handle->findResponseList = NULL;
-
-    for (pRequestList = this->handle->findRequestList; pRequestList; pRequestList = pRequestList->next) {
-
-        DB_SmallDcmElmt dcmElm;
-        bool elemFound = false;
-        for (auto qElm : lst) {
-            if (qElm.XTag() == pRequestList->elem.XTag) {
-                elemFound = true;
-                dcmElm.XTag = qElm.XTag();
-                char* cstr = new char[qElm.valueField().length() + 1];
-                strcpy(cstr, qElm.valueField().c_str());
-                dcmElm.PValueField = cstr;
-                dcmElm.ValueLength = (Uint32)qElm.valueField().length() + 1;
-                break;
-            }
-
-        }
-
-        if (!elemFound)
-            continue;
-
-        plist = (DB_ElementList*)malloc(sizeof(DB_ElementList));
-        if (plist == NULL) {
-            DCMNET_ERROR("DB_MakeResponseList: out of memory");
-            return;
-        }
-        plist->next = NULL;
-        DB_DuplicateElement(&dcmElm, &plist->elem);
-
-        if (this->handle->findResponseList == NULL) {
-            this->handle->findResponseList = last = plist;
-        }
-        else {
-            last->next = plist;
-            last = plist;
-        }
-
-    }
-}
-
-//------------------------------------------------------------------------------------------------------
-
 OFCondition DcmQueryRetrieveSQLiteDatabaseHandlePrivate::DB_FreeElementList(DB_ElementList* lst)
 {
     if (lst == NULL) return EC_Normal;
@@ -575,6 +640,154 @@ std::string DcmQueryRetrieveSQLiteDatabaseHandlePrivate::levelToString(DB_LEVEL
 
 //------------------------------------------------------------------------------------------------------
 
+OFCondition DcmQueryRetrieveSQLiteDatabaseHandlePrivate::storeInstance(DcmDataset* dataset, const char* imageFileName)
+{
+    // hashed from the file just written, which is what a later verify reads
+    std::string pixelHash;
+    if (PixelHash::isEnabled()) {
+        std::string sopInstanceUID, error;
+        if (!PixelHash::ofFile(imageFileName, sopInstanceUID, pixelHash, error)) {
+            DCMNET_WARN("cannot hash the pixel data of " << imageFileName << ": " << error);
+        }
+    }
+    // from the pixel data in memory, decoded for transcoding already if it was, or else from the file
+    DcmPixelStats pixelStats;
+    bool hasPixelStats = false;
+    if (PixelStats::isEnabled()) {
+        std::string error;
+        hasPixelStats = dataset->tagExists(DCM_PixelData)
+            ? PixelStats::ofDataset(dataset, pixelStats, error)
+            : PixelStats::ofFile(imageFileName, pixelStats, error);
+        if (!error.empty()) {
+            DCMNET_WARN("cannot compute the pixel statistics of " << imageFileName << ": " << error);
+        }
+    }
+    // the ingest queue converts the dataset to UTF-8, which the metadata is kept in as well
+    OFCondition cond = DcmIndexIngestQueue::store(db, dataset, imageFileName, pixelHash, hasPixelStats ? &pixelStats : NULL);
+    if (cond.good() && SeriesMetadata::isEnabled()) {
+        std::string error;
+        if (!SeriesMetadata::add(db->storagePath(), dataset, error)) {
+            DCMNET_WARN("cannot keep the metadata of " << imageFileName << ": " << error);
+        }
+    }
+    return cond;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+void DcmQueryRetrieveSQLiteDatabaseHandlePrivate::nextFindMatch()
+{
+    findMatched = false;
+    if (findCursor == NULL) {
+        return;
+    }
+
+    findMatched = findCursor->next(findMatch);
+    if (findPaged) {
+        findPosition = findCursor->position();
+    }
+    if (!findMatched) {
+        delete findCursor;
+        findCursor = NULL;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+
+void DcmQueryRetrieveSQLiteDatabaseHandlePrivate::prepareFindTemplate(DB_ElementList* requestList)
+{
+    std::vector<DcmTagKey> keys;
+    for (; requestList; requestList = requestList->next) {
+        if (std::find(keys.begin(), keys.end(), requestList->elem.XTag) == keys.end()) {
+            keys.push_back(requestList->elem.XTag);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    if (findTemplate != NULL && keys == findTemplateKeys && handle->queryLevel == findTemplateLevel) {
+        return;
+    }
+
+    delete findTemplate;
+    findTemplate = new DcmDataset;
+    findTemplateKeys.clear();
+    findTemplateLevel = handle->queryLevel;
+    for (const DcmTagKey& key : keys) {
+        DcmElement* dce = DcmItem::newDicomElement(DcmTag(key));
+        if (dce != NULL && findTemplate->insert(dce).good()) {
+            findTemplateKeys.push_back(key);
+        }
+        else {
+            delete dce;
+        }
+    }
+
+    const char* queryLevelString = NULL;
+    switch (findTemplateLevel) {
+    case PATIENT_LEVEL:
+        queryLevelString = PATIENT_LEVEL_STRING;
+        break;
+    case STUDY_LEVEL:
+        queryLevelString = STUDY_LEVEL_STRING;
+        break;
+    case SERIE_LEVEL:
+        queryLevelString = SERIE_LEVEL_STRING;
+        break;
+    case IMAGE_LEVEL:
+        queryLevelString = IMAGE_LEVEL_STRING;
+        break;
+    }
+    DU_putStringDOElement(findTemplate, DCM_QueryRetrieveLevel, queryLevelString);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+DcmDataset* DcmQueryRetrieveSQLiteDatabaseHandlePrivate::makeFindResponse()
+{
+    DcmDataset* response = new DcmDataset(*findTemplate);
+
+    // the elements of the copy in the order of findTemplateKeys, the query level is not among them
+    const size_t count = findTemplateKeys.size();
+    std::vector<DcmElement*> elements(count, NULL);
+    size_t i = 0;
+    for (DcmObject* obj = response->nextInContainer(NULL); obj != NULL; obj = response->nextInContainer(obj)) {
+        if (i < count && obj->getTag() == findTemplateKeys[i]) {
+            elements[i++] = OFstatic_cast(DcmElement*, obj);
+        }
+    }
+
+    // a key the match has no value for is left out of the response, like one the database does not know
+    std::vector<bool> matched(count, false);
+    for (const DcmSmallDcmElm& elem : findMatch) {
+        std::vector<DcmTagKey>::const_iterator it = std::lower_bound(findTemplateKeys.begin(), findTemplateKeys.end(), elem.XTag());
+        if (it == findTemplateKeys.end() || *it != elem.XTag()) {
+            continue;
+        }
+        const size_t slot = it - findTemplateKeys.begin();
+        if (matched[slot] || elements[slot] == NULL) {
+            continue;
+        }
+        matched[slot] = true;
+        if (!elem.valueField().empty() && elements[slot]->putString(elem.valueField().c_str()).bad()) {
+            DCMNET_WARN("nextFindResponse(): cannot put");
+            delete response;
+            return NULL;
+        }
+    }
+    for (size_t slot = 0; slot < count; slot++) {
+        if (!matched[slot] && elements[slot] != NULL) {
+            delete response->remove(elements[slot]);
+        }
+    }
+    if (findPaged) {
+        DcmUnlimitedText* token = new DcmUnlimitedText(DcmTag(DCM_PrivatePageToken, EVR_UT));
+        token->putString(findPosition.c_str());
+        response->insert(token, OFTrue /*replaceOld*/);
+    }
+    return response;
+}
+
+//------------------------------------------------------------------------------------------------------
+
 bool DcmQueryRetrieveSQLiteDatabaseHandlePrivate::containsAttribute(const std::list<DcmSmallDcmElm>& list, DcmTagKey key)
 {
     for (auto item : list) {
@@ -586,8 +799,8 @@ bool DcmQueryRetrieveSQLiteDatabaseHandlePrivate::containsAttribute(const std::l
 
 //------------------------------------------------------------------------------------------------------
 
-DcmQueryRetrieveSQLiteDatabaseHandle::DcmQueryRetrieveSQLiteDatabaseHandle(const OFFilename& path) 
-    : d(new DcmQueryRetrieveSQLiteDatabaseHandlePrivate(path))
+DcmQueryRetrieveSQLiteDatabaseHandle::DcmQueryRetrieveSQLiteDatabaseHandle(const OFFilename& path, DcmQueryRetriveConfigExt::eMoveOrder moveOrder)
+    : d(new DcmQueryRetrieveSQLiteDatabaseHandlePrivate(path, moveOrder))
 {
 }
 
@@ -601,6 +814,31 @@ DcmQueryRetrieveSQLiteDatabaseHandle::~DcmQueryRetrieveSQLiteDatabaseHandle()
 
 //------------------------------------------------------------------------------------------------------
 
+// the value of a private key of the request, also when it arrived as UN without its VR
+static std::string privateKeyValue(DcmDataset* dataset, const DcmTagKey& key)
+{
+    DcmElement* element = NULL;
+    if (dataset->findAndGetElement(key, element).bad() || element == NULL) {
+        return std::string();
+    }
+    OFString value;
+    if (element->getTag().getEVR() == EVR_UN || element->getTag().getEVR() == EVR_OB) {
+        Uint8* bytes = NULL;
+        if (element->getUint8Array(bytes).good() && bytes != NULL) {
+            value.assign(reinterpret_cast<const char*>(bytes), element->getLength());
+        }
+    }
+    else {
+        element->getOFStringArray(value);
+    }
+    const char* begin = value.c_str();
+    const char* end = begin + value.length();
+    OFStandard::trimString(begin, end);
+    return std::string(begin, end);
+}
+
+//------------------------------------------------------------------------------------------------------
+
 OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::startFindRequest( const char *SOPClassUID, DcmDataset *findRequestIdentifiers, 
     DcmQueryRetrieveDatabaseStatus *status )
 {
@@ -634,18 +872,34 @@ OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::startFindRequest( const char *
     */
 
     std::list<DcmSmallDcmElm> findRequestList = d->convertList(d->handle->findRequestList);
+    d->prepareFindTemplate(d->handle->findRequestList);
 
-    std::list< std::list<DcmSmallDcmElm> > resultList = d->db->find(findRequestList, d->handle->queryLevel, qLevel, lLevel);
-
-    for( auto lst: resultList) {
-        d->findResult.push(lst);
+    // a query within a study, e.g. for its series, counts for the snapshot of the hot studies
+    for (const DcmSmallDcmElm& el: findRequestList) {
+        if (el.XTag() == DCM_StudyInstanceUID && el.valueField().find_first_of("\\*?") == std::string::npos) {
+            WarmStart::record(d->storagePath.getCharPointer(), el.valueField());
+        }
     }
 
-    if (!d->findResult.empty()) {
-        auto item = d->findResult.front();
-        d->findResult.pop();
-        d->DB_MakeResponseList(item);
+    // matches are stepped out of the database while the responses are sent. A page size in the
+    // private keys of the request returns one page, continuing after the token of the page before
+    delete d->findCursor;
+    const long pageSize = atol(privateKeyValue(findRequestIdentifiers, DCM_PrivatePageSize).c_str());
+    d->findPaged = pageSize > 0;
+    d->findPosition.clear();
+    if (d->findPaged) {
+        d->findCursor = d->db->openFindPage(findRequestList, d->handle->queryLevel, static_cast<size_t>(pageSize),
+            privateKeyValue(findRequestIdentifiers, DCM_PrivatePageToken));
+        if (d->findCursor == NULL) {
+            d->findMatched = false;
+            status->setStatus(STATUS_FIND_Failed_UnableToProcess);
+            return (EC_IllegalParameter);
+        }
     }
+    else {
+        d->findCursor = d->db->openFind(findRequestList, d->handle->queryLevel);
+    }
+    d->nextFindMatch();
 
     return cond;
 }
@@ -655,75 +909,23 @@ OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::startFindRequest( const char *
 OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::nextFindResponse(DcmDataset **findResponseIdentifiers,
     DcmQueryRetrieveDatabaseStatus *status, const DcmQueryRetrieveCharacterSetOptions& characterSetOptions)
 {
-    DB_ElementList*     plist = NULL;
-    const char*         queryLevelString = NULL;
-    OFCondition         cond = EC_Normal;
-
-    if (d->handle->findResponseList == NULL) {
+    if (!d->findMatched) {
        DCMNET_INFO("nextFindResponse() : STATUS_Success");
         *findResponseIdentifiers = NULL;
         status->setStatus(STATUS_Success);
         return (EC_Normal);
     }
 
-    *findResponseIdentifiers = new DcmDataset;
-    if (*findResponseIdentifiers != NULL) {
-
-        // Put responses
-        for (plist = d->handle->findResponseList; plist != NULL; plist = plist->next) {
-            DcmTag t(plist->elem.XTag);
-            DcmElement* dce = DcmItem::newDicomElement(t);
-            if (dce == NULL) {
-                status->setStatus(STATUS_FIND_Refused_OutOfResources);
-                return QR_EC_IndexDatabaseError;
-            }
-            if (plist->elem.PValueField != NULL &&
-                strlen(plist->elem.PValueField) > 0) {
-                OFCondition ec = dce->putString(plist->elem.PValueField);
-                if (ec != EC_Normal) {
-                    DCMNET_WARN("nextFindResponse(): cannot put");
-                    status->setStatus(STATUS_FIND_Failed_UnableToProcess);
-                    return QR_EC_IndexDatabaseError;
-                }
-            }
-            OFCondition ec = (*findResponseIdentifiers)->insert(dce, OFTrue /*replaceOld*/);
-            if (ec != EC_Normal) {
-                DCMNET_WARN("nextFindResponse(): cannot insert");
-                status->setStatus(STATUS_FIND_Failed_UnableToProcess);
-                return QR_EC_IndexDatabaseError;
-            }
-        }
-
-        switch (d->handle->queryLevel) {
-        case PATIENT_LEVEL:
-            queryLevelString = PATIENT_LEVEL_STRING;
-            break;
-        case STUDY_LEVEL:
-            queryLevelString = STUDY_LEVEL_STRING;
-            break;
-        case SERIE_LEVEL:
-            queryLevelString = SERIE_LEVEL_STRING;
-            break;
-        case IMAGE_LEVEL:
-            queryLevelString = IMAGE_LEVEL_STRING;
-            break;
-        }
-        DU_putStringDOElement(*findResponseIdentifiers, DCM_QueryRetrieveLevel, queryLevelString);
-    }
-    else {
-        return (QR_EC_IndexDatabaseError);
+    // the elements and the query level are set up once per query, a match only fills in the values
+    *findResponseIdentifiers = d->makeFindResponse();
+    if (*findResponseIdentifiers == NULL) {
+        status->setStatus(STATUS_FIND_Failed_UnableToProcess);
+        return QR_EC_IndexDatabaseError;
     }
 
-    d->DB_FreeElementList(d->handle->findResponseList);
-    d->handle->findResponseList = NULL;
-
-    if (!d->findResult.empty()) {
-        auto item = d->findResult.front();
-        d->findResult.pop();
-        d->DB_MakeResponseList(item);
-    }
+    d->nextFindMatch();
 
-    return cond;
+    return EC_Normal;
 
 }
 
@@ -733,11 +935,11 @@ OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::cancelFindRequest( DcmQueryRet
 {
     d->DB_FreeElementList(d->handle->findRequestList);
     d->handle->findRequestList = NULL;
-    d->DB_FreeElementList(d->handle->findResponseList);
-    d->handle->findResponseList = NULL;
-    while (!d->findResult.empty()) {
-        d->findResult.pop();
-    }
+    delete d->findCursor;
+    d->findCursor = NULL;
+    d->findMatched = false;
+    d->findMatch.clear();
+    d->findPaged = false;
 
     status->setStatus(STATUS_FIND_Cancel_MatchingTerminatedDueToCancelRequest);
     return (EC_Normal);
@@ -745,9 +947,72 @@ OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::cancelFindRequest( DcmQueryRet
 
 //------------------------------------------------------------------------------------------------------
 
+// a C-MOVE sub-operation with the keys it is scheduled by
+struct DcmSQLiteMoveEntry {
+    std::list<DcmSmallDcmElm> attributes;
+    size_t series;
+    std::string directory;
+    std::string filename;
+    unsigned long long inode;
+    long instanceNumber;
+};
+
+static DcmSQLiteMoveEntry makeMoveEntry(const std::list<DcmSmallDcmElm>& attributes, size_t series, DcmQueryRetriveConfigExt::eMoveOrder order)
+{
+    DcmSQLiteMoveEntry entry;
+    entry.series = series;
+    entry.inode = 0;
+    entry.instanceNumber = LONG_MAX;
+    for (const DcmSmallDcmElm& el: attributes) {
+        if (el.XTag() == DCM_PrivateFileName) {
+            entry.filename = el.valueField();
+            entry.attributes.push_back(el);
+        }
+        else if (el.XTag() == DCM_SOPClassUID || el.XTag() == DCM_SOPInstanceUID) {
+            entry.attributes.push_back(el);
+        }
+        else if (el.XTag() == DCM_InstanceNumber && !el.valueField().empty()) {
+            entry.instanceNumber = strtol(el.valueField().c_str(), NULL, 10);
+        }
+    }
+    if (order == DcmQueryRetriveConfigExt::MOVE_LOCATION) {
+        const size_t pos = entry.filename.find_last_of("/\\");
+        entry.directory = pos == std::string::npos ? std::string() : entry.filename.substr(0, pos);
+#ifndef HAVE_WINDOWS_H
+        // the inode number approximates the position on disk, files of a directory are usually written in order
+        struct stat st;
+        if (stat(DcmQueryRetrievePackFile::container(entry.filename.c_str()).c_str(), &st) == 0) {
+            entry.inode = static_cast<unsigned long long>(st.st_ino);
+        }
+#endif
+    }
+    return entry;
+}
+
+// sorts the sub-operations of a C-MOVE, ties keep the order of the database
+static void sortMoveEntries(std::vector<DcmSQLiteMoveEntry>& entries, DcmQueryRetriveConfigExt::eMoveOrder order)
+{
+    if (order == DcmQueryRetriveConfigExt::MOVE_LOCATION) {
+        std::stable_sort(entries.begin(), entries.end(), [](const DcmSQLiteMoveEntry& a, const DcmSQLiteMoveEntry& b) {
+            if (a.directory != b.directory) return a.directory < b.directory;
+            if (a.inode != b.inode) return a.inode < b.inode;
+            return a.filename < b.filename;
+        });
+    }
+    else if (order == DcmQueryRetriveConfigExt::MOVE_INSTANCE) {
+        std::stable_sort(entries.begin(), entries.end(), [](const DcmSQLiteMoveEntry& a, const DcmSQLiteMoveEntry& b) {
+            if (a.series != b.series) return a.series < b.series;
+            return a.instanceNumber < b.instanceNumber;
+        });
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+
 OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::startMoveRequest( const char *SOPClassUID, 
     DcmDataset *moveRequestIdentifiers,  DcmQueryRetrieveDatabaseStatus *status )
 {
+    OFTraceSpan         span("sql.startMoveRequest");
     OFCondition         cond = EC_Normal;
     DB_ElementList*     plist = NULL;
     DB_LEVEL            qLevel = PATIENT_LEVEL;
@@ -771,29 +1036,84 @@ OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::startMoveRequest( const char *
 
     d->determineLevelBoundaries(d->handle->rootLevel, qLevel, lLevel);
 
-    std::list<DcmSmallDcmElm> findRequestList = d->convertList(d->handle->findRequestList);
-
-    if (!d->containsAttribute(findRequestList, DCM_SeriesInstanceUID)) {
-        findRequestList.push_back(DcmSmallDcmElm(DCM_SeriesInstanceUID, ""));
+    // one statement resolves the whole request, only the restrictions and the attributes
+    // needed for the sub-operations are selected
+    std::list<DcmSmallDcmElm> imgRequestList;
+    for (const DcmSmallDcmElm& el: d->convertList(d->handle->findRequestList)) {
+        if (!el.valueField().empty()) {
+            imgRequestList.push_back(el);
+        }
+    }
+    const bool tiered = StorageTier::isConfigured();
+    const DcmTagKey requiredKeys[] = { DCM_StudyInstanceUID, DCM_SeriesInstanceUID, DCM_SOPInstanceUID, DCM_SOPClassUID, DCM_PrivateFileName, DCM_InstanceNumber };
+    for (const DcmTagKey& key: requiredKeys) {
+        if (key == DCM_InstanceNumber && d->moveOrder != DcmQueryRetriveConfigExt::MOVE_INSTANCE) {
+            continue;
+        }
+        // forwarded moves are addressed by study and series
+        if (key == DCM_StudyInstanceUID && !tiered && !Cluster::isJoined()) {
+            continue;
+        }
+        if (!d->containsAttribute(imgRequestList, key)) {
+            imgRequestList.push_back(DcmSmallDcmElm(key, ""));
+        }
     }
 
-    std::list< std::list<DcmSmallDcmElm> > seriesResult = d->db->find(findRequestList, SERIE_LEVEL, qLevel, lLevel);
-    for (auto seriesList: seriesResult) {
-        std::list<DcmSmallDcmElm> imgRequestList(seriesList);
-
-        if (!d->containsAttribute(findRequestList, DCM_SOPInstanceUID)) {
-            imgRequestList.push_back(DcmSmallDcmElm(DCM_SOPInstanceUID, ""));
+    std::vector<DcmSQLiteMoveEntry> entries;
+    // studies of the request in the order of the rows
+    std::vector<std::string> studies;
+    DcmIndexFindCursor* cursor = d->db->openFind(imgRequestList, IMAGE_LEVEL);
+    if (cursor != NULL) {
+        // the rows are ordered by patient, study, series and image
+        size_t series = 0;
+        std::string seriesUID;
+        std::list<DcmSmallDcmElm> imgList;
+        while (cursor->next(imgList)) {
+            for (const DcmSmallDcmElm& el: imgList) {
+                if (el.XTag() == DCM_StudyInstanceUID && (studies.empty() || studies.back() != el.valueField())) {
+                    studies.push_back(el.valueField());
+                }
+                if (el.XTag() == DCM_SeriesInstanceUID) {
+                    if (!entries.empty() && el.valueField() != seriesUID) {
+                        ++series;
+                    }
+                    seriesUID = el.valueField();
+                }
+            }
+            entries.push_back(makeMoveEntry(imgList, series, d->moveOrder));
         }
+        delete cursor;
+    }
+    if (!entries.empty()) {
+        status->setStatus(STATUS_Pending);
+    }
 
-        imgRequestList.push_back(DcmSmallDcmElm(DCM_PrivateFileName, ""));
-        imgRequestList.push_back(DcmSmallDcmElm(DCM_SOPClassUID, ""));
+    // random reads across directories are turned into sequential scans
+    sortMoveEntries(entries, d->moveOrder);
 
-        std::list< std::list<DcmSmallDcmElm> > imgResult = d->db->find(imgRequestList, IMAGE_LEVEL, qLevel, lLevel);
-        status->setStatus(STATUS_Pending);
+    if (tiered && !entries.empty()) {
+        // files on the cold tier are recalled in parallel ahead of the sub-operations
+        std::vector<std::string> files;
+        files.reserve(entries.size());
+        for (const DcmSQLiteMoveEntry& entry: entries) {
+            files.push_back(entry.filename);
+        }
+        StorageTier::prefetch(files);
 
-        for(auto imgList: imgResult) {
-            d->findResult.push(imgList);
+        // the connection of the handle only reads, the access times are written by a writer
+        std::sort(studies.begin(), studies.end());
+        studies.erase(std::unique(studies.begin(), studies.end()), studies.end());
+        for (const std::string& study: studies) {
+            WarmStart::record(d->storagePath.getCharPointer(), study);
         }
+        DcmIndexDatabase* writer = DcmIndexDatabasePool::acquire(d->storagePath);
+        if (writer != NULL) {
+            writer->recordStudyAccess(studies, static_cast<long long>(time(NULL)));
+        }
+        DcmIndexDatabasePool::release(writer);
+    }
+    for (DcmSQLiteMoveEntry& entry: entries) {
+        d->findResult.push(std::move(entry.attributes));
     }
 
     if (d->findResult.empty()) {
@@ -846,6 +1166,55 @@ OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::nextMoveResponse(char* SOPClas
 
 //------------------------------------------------------------------------------------------------------
 
+void DcmQueryRetrieveSQLiteDatabaseHandle::takeForwardedMoves(OFList<DcmQueryRetrieveForwardedMove>& moves, DcmQueryRetrieveDatabaseStatus *status)
+{
+    if (!Cluster::isJoined()) {
+        return;
+    }
+
+    std::queue< std::list< DcmSmallDcmElm > > local;
+    // moves by node name and series
+    std::map<std::string, DcmQueryRetrieveForwardedMove*> forwarded;
+    while (!d->findResult.empty()) {
+        std::list<DcmSmallDcmElm> attributes = std::move(d->findResult.front());
+        d->findResult.pop();
+
+        std::string filename, study, series, instance;
+        for (const DcmSmallDcmElm& el: attributes) {
+            if (el.XTag() == DCM_PrivateFileName) filename = el.valueField();
+            else if (el.XTag() == DCM_StudyInstanceUID) study = el.valueField();
+            else if (el.XTag() == DCM_SeriesInstanceUID) series = el.valueField();
+            else if (el.XTag() == DCM_SOPInstanceUID) instance = el.valueField();
+        }
+
+        // files readable here are sent from here, e.g. on storage shared by the nodes
+        DcmClusterNode owner;
+        if (study.empty() || series.empty() || instance.empty() || OFStandard::fileExists(filename.c_str())
+            || !Cluster::ownerOf(filename, owner)) {
+            local.push(std::move(attributes));
+            continue;
+        }
+        // the UIDs of a move fit into one value of explicit VR, i.e. 64 KB
+        DcmQueryRetrieveForwardedMove*& move = forwarded[owner.name + "\\" + series];
+        if (move == NULL || move->sopInstanceUIDs.size() >= 500) {
+            moves.push_back(DcmQueryRetrieveForwardedMove());
+            move = &moves.back();
+            move->aeTitle = owner.aeTitle.c_str();
+            move->hostName = owner.host.c_str();
+            move->port = owner.port;
+            move->studyInstanceUID = study.c_str();
+            move->seriesInstanceUID = series.c_str();
+        }
+        move->sopInstanceUIDs.push_back(instance.c_str());
+    }
+    d->findResult.swap(local);
+    if (d->findResult.empty() && !moves.empty()) {
+        status->setStatus(STATUS_Success);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------
+
 OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::cancelMoveRequest( DcmQueryRetrieveDatabaseStatus *status )
 {
     // not implemented on purpose
@@ -885,14 +1254,112 @@ OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::storeRequest(const char* SOPCl
 {
     DcmFileFormat dcmff;
     OFFilename file(imageFileName);
-    if (dcmff.loadFile(imageFileName).bad())
+
+    // only the indexed attributes are read, unless the metadata of the series is kept as well
+    static const DcmReadProjection indexProjection = []() {
+        DcmReadProjection projection;
+        for (const DB_FindAttrExt& attr : DcmIndexDatabase::indexedAttributes()) {
+            projection.addTag(attr.tag);
+        }
+        projection.addTag(DCM_SOPInstanceUID);
+        return projection;
+    }();
+    if (!SeriesMetadata::isEnabled()) {
+        dcmff.getDataset()->setReadProjection(&indexProjection);
+    }
+
+    // only header attributes are indexed, stop before the pixel data
+    if (dcmff.loadFileUntilTag(imageFileName, EXS_Unknown, EGL_noChange, DCM_MaxReadLength,
+        ERM_autoDetect, DCM_PixelData).bad())
     {
         DCMNET_ERROR("DB: Cannot open file: " << imageFileName << ": " << OFStandard::getLastSystemErrorCode().message());
         status->setStatus(STATUS_STORE_Error_CannotUnderstand);
         return (QR_EC_IndexDatabaseError);
     }
 
-    return d->db->insertMetaData(dcmff.getDataset(), imageFileName);
+    return d->storeInstance(dcmff.getDataset(), imageFileName);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::storeDatasetRequest(const char* SOPClassUID,
+    const char* SOPInstanceUID, const char* imageFileName, DcmDataset* imageDataSet,
+    DcmQueryRetrieveDatabaseStatus* status, OFBool isNew)
+{
+    if (imageDataSet == NULL) {
+        return storeRequest(SOPClassUID, SOPInstanceUID, imageFileName, status, isNew);
+    }
+
+    return d->storeInstance(imageDataSet, imageFileName);
+}
+
+//------------------------------------------------------------------------------------------------------
+
+OFBool DcmQueryRetrieveSQLiteDatabaseHandle::isInstanceStored(const char* SOPInstanceUID)
+{
+    if (SOPInstanceUID == NULL || *SOPInstanceUID == '\0') {
+        return OFFalse;
+    }
+    std::list<DcmSmallDcmElm> request;
+    request.push_back(DcmSmallDcmElm(DCM_SOPInstanceUID, SOPInstanceUID));
+    request.push_back(DcmSmallDcmElm(DCM_PrivateFileName, ""));
+    DcmIndexFindCursor* cursor = d->db->openFind(request, IMAGE_LEVEL);
+    if (cursor == NULL) {
+        return OFFalse;
+    }
+    // instances still waiting in the ingest queue are not seen, they are written again
+    std::string filename;
+    std::list<DcmSmallDcmElm> row;
+    if (cursor->next(row)) {
+        for (const DcmSmallDcmElm& el: row) {
+            if (el.XTag() == DCM_PrivateFileName) {
+                filename = el.valueField();
+            }
+        }
+    }
+    delete cursor;
+    if (filename.empty()) {
+        return OFFalse;
+    }
+    const OFString file = DcmQueryRetrievePackFile::container(filename.c_str());
+    return OFStandard::fileExists(file) || StorageArea::isRemote(file.c_str()) || StorageTier::isCold(file.c_str());
+}
+
+//------------------------------------------------------------------------------------------------------
+
+OFCondition DcmQueryRetrieveSQLiteDatabaseHandle::pruneInvalidRecords()
+{
+    // called after a failed store, the pass must not hold up the association
+    IndexMaintenance::schedule(d->db->storagePath());
+    return EC_Normal;
+}
+
+//------------------------------------------------------------------------------------------------------
+
+void DcmQueryRetrieveSQLiteDatabaseHandle::storedInstances(const OFList<OFString>& SOPInstanceUIDs, OFList<OFString>& stored)
+{
+    std::vector<std::string> uids;
+    for (const OFString& uid : SOPInstanceUIDs) {
+        if (!uid.empty()) {
+            uids.push_back(uid.c_str());
+        }
+    }
+    if (uids.empty()) {
+        return;
+    }
+    // a commitment is usually asked for right after the transfer, the instances must be in the index
+    DcmIndexIngestQueue::flush(d->db->storagePath());
+    const std::map<std::string, std::string> files = d->db->instanceFiles(uids);
+    for (const std::string& uid : uids) {
+        std::map<std::string, std::string>::const_iterator it = files.find(uid);
+        if (it == files.end()) {
+            continue;
+        }
+        const OFString file = DcmQueryRetrievePackFile::container(it->second.c_str());
+        if (OFStandard::fileExists(file) || StorageArea::isRemote(file.c_str()) || StorageTier::isCold(file.c_str())) {
+            stored.push_back(OFString(uid.c_str()));
+        }
+    }
 }
 
 //------------------------------------------------------------------------------------------------------
@@ -6,7 +6,12 @@
 #include "dcmtk/ofstd/offile.h"
 #include "dcmtk/dcmqrdb/dcmqrcnf.h"
 
+#include "TransferPolicy.h"
+#include "PeerTable.h"
+#include "RateLimiter.h"
+
 #include <list>
+#include <memory>
 
 class DcmQueryRetrieveSQLiteDatabaseHandlePrivate;
 class DcmQueryRetrieveConfig;
@@ -16,35 +21,51 @@ class DcmQueryRetriveConfigExt : public DcmQueryRetrieveConfig
 {
 
 public:
-    DcmQueryRetriveConfigExt() : _permissive(false) {}
-    void addPeer(const char* AETitle, const char* HostName, int PortNumber);
+    // order of the C-MOVE sub-operations
+    enum eMoveOrder {
+        MOVE_DATABASE,  // as returned by the queries of each series
+        MOVE_LOCATION,  // by directory, then inode, so that files are read sequentially
+        MOVE_INSTANCE   // by InstanceNumber within each series
+    };
+
+    // peers may be shared with JS, which replaces them while the SCP runs
+    explicit DcmQueryRetriveConfigExt(const std::shared_ptr<PeerTable>& peers = std::make_shared<PeerTable>())
+        : _peers(peers), _permissive(false), _moveOrder(MOVE_LOCATION) {}
+    const std::shared_ptr<PeerTable>& peers() const { return _peers; }
     void setStorageArea(const OFFilename& filename) { _storageArea = filename; }
     void setPermissiveMode(bool enabled) { _permissive = enabled;  }
+    void setMoveOrder(eMoveOrder order) { _moveOrder = order; }
+    // limits per calling AE title and IP, none if not set
+    void setRateLimiter(const std::shared_ptr<RateLimiter>& limiter) { _limiter = limiter; }
+    eMoveOrder moveOrder() const { return _moveOrder; }
 
     // override
     int peerForAETitle(const char* AETitle, const char** HostName, int* PortNumber) const;
     int peerInAETitle(const char* calledAETitle, const char* callingAETitle, const char* HostName) const;
     int checkForSameVendor(const char* AETitle1, const char* AETitle2) const;
+    int preferCompressed(const char* AETitle, const char* HostName, const char* SOPClassUID) const;
+    void transferCompleted(const char* AETitle, const char* HostName, Uint64 bytes, double seconds) const;
+    T_DIMSE_Priority priorityForAETitle(const char* AETitle, T_DIMSE_Priority requested) const;
+    OFBool admitAssociation(const char* AETitle, const char* HostName) const;
+    void associationStarted(const char* AETitle, const char* HostName) const;
+    void associationReleased(const char* AETitle, const char* HostName) const;
+    void throttleTransfer(const char* AETitle, const char* HostName, Uint64 bytes) const;
 
     OFBool writableStorageArea(const char* aeTitle) const { return OFTrue; }
     const char* getStorageArea(const char* aeTitle) const { return _storageArea.getCharPointer(); }
 private:
-
-    struct sPeer {
-        std::string aet;
-        std::string hostname;
-        int port;
-    };
-    std::list<sPeer> _peers;
+    std::shared_ptr<PeerTable> _peers;
+    std::shared_ptr<RateLimiter> _limiter;
     OFFilename _storageArea;
     bool _permissive;
+    eMoveOrder _moveOrder;
 };
 
 class DcmQueryRetrieveSQLiteDatabaseHandleFactory : public DcmQueryRetrieveDatabaseHandleFactory
 {
 public:
 
-     DcmQueryRetrieveSQLiteDatabaseHandleFactory(const DcmQueryRetrieveConfig* config);
+     DcmQueryRetrieveSQLiteDatabaseHandleFactory(const DcmQueryRetriveConfigExt* config);
      ~DcmQueryRetrieveSQLiteDatabaseHandleFactory() {}
 
      DcmQueryRetrieveDatabaseHandle* createDBHandle(
@@ -55,7 +76,7 @@ public:
 private:
     DcmQueryRetrieveSQLiteDatabaseHandleFactory(const DcmQueryRetrieveSQLiteDatabaseHandleFactory& other);
     DcmQueryRetrieveSQLiteDatabaseHandleFactory& operator=(const DcmQueryRetrieveSQLiteDatabaseHandleFactory& other);
-    const DcmQueryRetrieveConfig* config_;
+    const DcmQueryRetriveConfigExt* config_;
 };
 
 
@@ -63,7 +84,8 @@ class DcmQueryRetrieveSQLiteDatabaseHandle : public DcmQueryRetrieveDatabaseHand
 {
 public:
 
-    DcmQueryRetrieveSQLiteDatabaseHandle(const OFFilename &path);
+    DcmQueryRetrieveSQLiteDatabaseHandle(const OFFilename &path,
+        DcmQueryRetriveConfigExt::eMoveOrder moveOrder = DcmQueryRetriveConfigExt::MOVE_LOCATION);
 
     ~DcmQueryRetrieveSQLiteDatabaseHandle();
 
@@ -99,10 +121,24 @@ public:
 
      OFCondition cancelMoveRequest(DcmQueryRetrieveDatabaseStatus *status);
 
+     // instances below the storage path of another live cluster node that are not readable here
+     void takeForwardedMoves(OFList<DcmQueryRetrieveForwardedMove>& moves, DcmQueryRetrieveDatabaseStatus *status);
+
      OFCondition storeRequest( const char *SOPClassUID, const char *SOPInstanceUID, const char *imageFileName, 
         DcmQueryRetrieveDatabaseStatus  *status, OFBool isNew = OFTrue );
 
-     OFCondition pruneInvalidRecords() { return OFCondition(EC_IllegalParameter); }
+     // index the dataset still in memory instead of reading the stored file again
+     OFCondition storeDatasetRequest( const char *SOPClassUID, const char *SOPInstanceUID, const char *imageFileName,
+        DcmDataset *imageDataSet, DcmQueryRetrieveDatabaseStatus  *status, OFBool isNew = OFTrue );
+
+     // the index lists the instance and its file is on disk, in the storage backend or on the cold tier
+     OFBool isInstanceStored(const char *SOPInstanceUID);
+
+     // one batched index lookup after the ingest queue is flushed, then the same file checks
+     void storedInstances(const OFList<OFString>& SOPInstanceUIDs, OFList<OFString>& stored);
+
+     // schedules a background pass of IndexMaintenance over the storage area, returns at once
+     OFCondition pruneInvalidRecords();
 
      void setIdentifierChecking(OFBool checkFind, OFBool checkMove) { }
 
@@ -0,0 +1,72 @@
+import { echoScu, findScu, Result } from '../index';
+import { dataset, importDatasets, node, removeStorage, run, startScp, tempStorage, uid } from './util';
+
+const scu = node('SCU');
+const scp = node('POOLSCP', 2);
+
+let storagePath: string;
+const studies: string[] = [];
+
+beforeAll(async () => {
+  storagePath = tempStorage();
+  for (let i = 0; i < 3; ++i) {
+    studies.push(uid());
+  }
+  await importDatasets(storagePath, studies.map((study) => dataset({
+    '0020000D': ['UI', study],
+    '0020000E': ['UI', uid()],
+    '00080018': ['UI', uid()],
+  })));
+});
+
+afterAll(() => removeStorage(storagePath));
+
+// the responses of a streamed C-FIND, each one as often as it came
+function findStudies(): Promise<{ final: Result, studies: string[] }> {
+  return new Promise((resolve) => {
+    const received: string[] = [];
+    const options = {
+      source: scu,
+      target: scp,
+      reuseAssociation: true,
+      chunkSize: 1,
+      nativeResult: true,
+      tags: [{ key: '00080052', value: 'STUDY' }, { key: '0020000D', value: '' }],
+    };
+    findScu(options, (result: Result) => {
+      if (result.code === 1 && result.message === 'FIND_RESULTS') {
+        for (const match of result.container) {
+          received.push(match['0020000D'].Value[0]);
+        }
+      } else if (result.code !== 1) {
+        resolve({ final: result, studies: received });
+      }
+    });
+  });
+}
+
+test('a pooled association the peer closed is replaced before a request is sent on it', async () => {
+  let running = await startScp({ source: scp, peers: [scu], storagePath, permissive: true });
+  try {
+    expect((await run(echoScu, { source: scu, target: scp, reuseAssociation: true })).code).toBe(0);
+    // the SCP interrupts the idle association when it stops
+    await running.stop();
+    running = await startScp({ source: scp, peers: [scu], storagePath, permissive: true });
+
+    const found = await findStudies();
+    expect(found.final.code).toBe(0);
+    expect(found.studies.sort()).toEqual(studies.slice().sort());
+  } finally {
+    await running.stop();
+  }
+});
+
+test('a request on a pooled association to a stopped peer fails once', async () => {
+  const running = await startScp({ source: scp, peers: [scu], storagePath, permissive: true });
+  expect((await run(echoScu, { source: scu, target: scp, reuseAssociation: true })).code).toBe(0);
+  await running.stop();
+
+  const found = await findStudies();
+  expect(found.final.code).toBe(2);
+  expect(found.studies).toEqual([]);
+});
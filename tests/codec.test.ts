@@ -0,0 +1,69 @@
+import * as fs from 'fs';
+import * as path from 'path';
+import { decodeFrame, recompress, Result } from '../index';
+import { dataset, importDatasets, removeStorage, run, tempStorage, uid } from './util';
+
+const HTJ2K_LOSSLESS = '1.2.840.10008.1.2.4.201';
+const SOP_INSTANCE_UID = '00080018';
+
+// uniformly distributed samples, the worst case of every coder, repeatable through a fixed seed
+function noise(bytes: number, seed: number): Buffer {
+  const buffer = Buffer.alloc(bytes);
+  let state = seed;
+  for (let i = 0; i < bytes; ++i) {
+    state = (Math.imul(state, 1103515245) + 12345) >>> 0;
+    buffer[i] = state >>> 24;
+  }
+  return buffer;
+}
+
+function image(sopInstanceUid: string, rows: number, columns: number, bits: number, pixels: Buffer): any {
+  const us = (value: number) => ({ vr: 'US', Value: [value] });
+  return {
+    ...dataset({ '0020000D': ['UI', uid()], '0020000E': ['UI', uid()], [SOP_INSTANCE_UID]: ['UI', sopInstanceUid] }),
+    '00280002': us(1),
+    '00280004': { vr: 'CS', Value: ['MONOCHROME2'] },
+    '00280010': us(rows),
+    '00280011': us(columns),
+    '00280100': us(bits),
+    '00280101': us(bits),
+    '00280102': us(bits - 1),
+    '00280103': us(0),
+    '7FE00010': { vr: bits > 8 ? 'OW' : 'OB', InlineBinary: pixels.toString('base64') },
+  };
+}
+
+function decode(sourcePath: string): Promise<{ result: Result, pixels?: Buffer }> {
+  return new Promise((resolve) => {
+    let pixels: Buffer | undefined;
+    decodeFrame({ sourcePath, nativeResult: true }, (result: Result, buffer?: Buffer) => {
+      if (buffer) pixels = Buffer.from(buffer);
+      if (result.code !== 1) resolve({ result, pixels });
+    });
+  });
+}
+
+// HT code-blocks of noise exceed the raw size of the samples, the code-stream still has to fit the
+// buffers of the encoder and decode to the same samples
+test.each([
+  { bits: 8, rows: 256, columns: 256 },
+  { bits: 16, rows: 128, columns: 256 },
+])('$bits bit noise is encoded as lossless HTJ2K', async ({ bits, rows, columns }) => {
+  const source = tempStorage();
+  const target = tempStorage();
+  try {
+    const sopInstanceUid = uid();
+    const pixels = noise(rows * columns * bits / 8, 42);
+    await importDatasets(source, [image(sopInstanceUid, rows, columns, bits, pixels)]);
+    const result = await run(recompress, { sourcePath: source, storagePath: target, writeTransfer: HTJ2K_LOSSLESS, parallelism: 1 });
+    expect(result.code).toBe(0);
+    const written = path.join(target, sopInstanceUid);
+    expect(fs.readFileSync(written).includes(HTJ2K_LOSSLESS)).toBe(true);
+    const decoded = await decode(written);
+    expect(decoded.result.code).toBe(0);
+    expect(decoded.pixels && decoded.pixels.equals(pixels)).toBe(true);
+  } finally {
+    removeStorage(source);
+    removeStorage(target);
+  }
+}, 30000);
@@ -0,0 +1,91 @@
+import * as fs from 'fs';
+import * as path from 'path';
+import { getScu, moveScu, storeScu } from '../index';
+import { dataset, node, query, removeStorage, run, RunningScp, startScp, tempStorage, uid } from './util';
+
+const scu = node('SCU');
+const archive = node('CMDSCP', 4);
+const destination = node('CMDDEST', 5);
+
+const STUDY_UID = '0020000D';
+const SOP_INSTANCE_UID = '00080018';
+
+// the command sets of C-STORE, C-GET and C-MOVE requests, their responses and the C-STORE
+// sub-operations are encoded and decoded without a dataset, the requests must work as before
+let storagePath: string;
+let running: RunningScp;
+const study = uid();
+const sent: string[] = [];
+
+beforeAll(async () => {
+  storagePath = tempStorage();
+  running = await startScp({ source: archive, peers: [scu, destination], storagePath, permissive: true });
+  const series = uid();
+  const datasets: any[] = [];
+  for (let i = 0; i < 5; ++i) {
+    sent.push(uid());
+    datasets.push(dataset({ [STUDY_UID]: ['UI', study], '0020000E': ['UI', series], [SOP_INSTANCE_UID]: ['UI', sent[i]] }));
+  }
+  sent.sort();
+  const stored = await run(storeScu, { source: scu, target: archive, jsonDatasets: [JSON.stringify(datasets)] });
+  expect(stored.code).toBe(0);
+}, 30000);
+
+afterAll(async () => {
+  await running.stop();
+  removeStorage(storagePath);
+});
+
+const studyTags = [{ key: '00080052', value: 'STUDY' }, { key: STUDY_UID, value: study }];
+
+function instancesOf(storage: string): Promise<string[]> {
+  return query(storage, [
+    { key: '00080052', value: 'IMAGE' },
+    { key: STUDY_UID, value: study },
+    { key: SOP_INSTANCE_UID, value: '' },
+  ], SOP_INSTANCE_UID);
+}
+
+function files(directory: string): string[] {
+  const result: string[] = [];
+  for (const entry of fs.readdirSync(directory, { withFileTypes: true })) {
+    const name = path.join(directory, entry.name);
+    if (entry.isDirectory()) {
+      result.push(...files(name));
+    } else if (entry.name.endsWith('.dcm')) {
+      result.push(name);
+    }
+  }
+  return result;
+}
+
+test('C-STORE requests are stored and indexed', async () => {
+  expect(await instancesOf(storagePath)).toEqual(sent);
+});
+
+test('C-GET receives every instance through C-STORE sub-operations', async () => {
+  const target = tempStorage();
+  try {
+    const result = await run(getScu, { source: scu, target: archive, tags: studyTags, storagePath: target });
+    expect(result.code).toBe(0);
+    expect(files(target)).toHaveLength(sent.length);
+  } finally {
+    removeStorage(target);
+  }
+}, 30000);
+
+test('C-MOVE sends every instance to the destination', async () => {
+  const target = tempStorage();
+  const receiver = await startScp({ source: destination, peers: [archive], storagePath: target, permissive: true });
+  try {
+    const result = await run(moveScu, { source: scu, target: archive, tags: studyTags, destination: destination.aet });
+    expect(result.code).toBe(0);
+  } finally {
+    await receiver.stop();
+  }
+  try {
+    expect(await instancesOf(target)).toEqual(sent);
+  } finally {
+    removeStorage(target);
+  }
+}, 30000);
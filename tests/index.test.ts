@@ -0,0 +1,94 @@
+import * as fs from 'fs';
+import * as path from 'path';
+import { maintainIndex } from '../index';
+import { dataset, importDatasets, query, removeStorage, run, tempStorage, uid } from './util';
+
+const STUDY_UID = '0020000D';
+const MODALITY = '00080060';
+const MODALITIES_IN_STUDY = '00080061';
+
+let storagePath: string;
+const studies: { [name: string]: string } = {};
+
+// one study per list of series modalities
+beforeAll(async () => {
+  storagePath = tempStorage();
+  const layout: { [name: string]: string[] } = { us: ['US'], ivus: ['IVUS'], ctus: ['CT', 'US'], srivus: ['SR', 'IVUS'], ct: ['CT'] };
+  const datasets: any[] = [];
+  for (const name of Object.keys(layout)) {
+    studies[name] = uid();
+    for (const modality of layout[name]) {
+      datasets.push(dataset({
+        [STUDY_UID]: ['UI', studies[name]],
+        '0020000E': ['UI', uid()],
+        '00080018': ['UI', uid()],
+        [MODALITY]: ['CS', modality],
+      }));
+    }
+  }
+  await importDatasets(storagePath, datasets);
+});
+
+afterAll(() => removeStorage(storagePath));
+
+function studiesWith(modality: string): Promise<string[]> {
+  return query(storagePath, [
+    { key: '00080052', value: 'STUDY' },
+    { key: STUDY_UID, value: '' },
+    { key: MODALITIES_IN_STUDY, value: modality },
+  ], STUDY_UID);
+}
+
+test('ModalitiesInStudy matches whole values', async () => {
+  expect(await studiesWith('US')).toEqual([studies.us, studies.ctus].sort());
+});
+
+test('ModalitiesInStudy does not match a value containing the requested one', async () => {
+  expect(await studiesWith('IVUS')).toEqual([studies.ivus, studies.srivus].sort());
+  expect(await studiesWith('V')).toEqual([]);
+});
+
+test('ModalitiesInStudy holds the modalities of all series', async () => {
+  expect(await studiesWith('CT')).toEqual([studies.ctus, studies.ct].sort());
+});
+
+// the denormalized column is counted again when instances are removed
+test('ModalitiesInStudy follows the series removed from a study', async () => {
+  const area = tempStorage();
+  try {
+    const study = uid();
+    const ultrasound = uid();
+    await importDatasets(area, [
+      dataset({ [STUDY_UID]: ['UI', study], '0020000E': ['UI', uid()], '00080018': ['UI', uid()], [MODALITY]: ['CS', 'CT'] }),
+      dataset({ [STUDY_UID]: ['UI', study], '0020000E': ['UI', uid()], '00080018': ['UI', ultrasound], [MODALITY]: ['CS', 'US'] }),
+    ]);
+    const tags = (modality: string) => [
+      { key: '00080052', value: 'STUDY' },
+      { key: STUDY_UID, value: '' },
+      { key: MODALITIES_IN_STUDY, value: modality },
+    ];
+    expect(await query(area, tags('US'), STUDY_UID)).toEqual([study]);
+
+    fs.unlinkSync(path.join(area, study, ultrasound + '.dcm'));
+    const result = await run(maintainIndex, { storagePath: area });
+    expect(result.code).toBe(0);
+    expect(await query(area, tags('US'), STUDY_UID)).toEqual([]);
+    expect(await query(area, tags('CT'), STUDY_UID)).toEqual([study]);
+  } finally {
+    removeStorage(area);
+  }
+});
+
+// only the first connection creates the schema, the others wait for it
+test('concurrent requests on a new index all see its schema', async () => {
+  const area = tempStorage();
+  try {
+    const tags = [{ key: '00080052', value: 'STUDY' }, { key: STUDY_UID, value: '' }];
+    const results = await Promise.all(Array.from({ length: 8 }, () => query(area, tags, STUDY_UID)));
+    for (const matches of results) {
+      expect(matches).toEqual([]);
+    }
+  } finally {
+    removeStorage(area);
+  }
+});
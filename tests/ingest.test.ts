@@ -0,0 +1,53 @@
+import { storeScu } from '../index';
+import { dataset, node, query, removeStorage, run, startScp, tempStorage, uid } from './util';
+
+const scu = node('SCU');
+const scp = node('INGESTSCP', 3);
+
+const STUDY_UID = '0020000D';
+const SOP_INSTANCE_UID = '00080018';
+
+// instances of one study in two series
+function instances(study: string, count: number): { uids: string[], datasets: any[] } {
+  const series = [uid(), uid()];
+  const uids: string[] = [];
+  const datasets: any[] = [];
+  for (let i = 0; i < count; ++i) {
+    uids.push(uid());
+    datasets.push(dataset({ [STUDY_UID]: ['UI', study], '0020000E': ['UI', series[i % 2]], [SOP_INSTANCE_UID]: ['UI', uids[i]] }));
+  }
+  return { uids, datasets };
+}
+
+function instancesOf(storagePath: string, study: string): Promise<string[]> {
+  return query(storagePath, [
+    { key: '00080052', value: 'IMAGE' },
+    { key: STUDY_UID, value: study },
+    { key: SOP_INSTANCE_UID, value: '' },
+  ], SOP_INSTANCE_UID);
+}
+
+// the instances an SCP only queued for its writer are in the index once it has stopped
+test('stopping the SCP commits the queued instances', async () => {
+  const storagePath = tempStorage();
+  try {
+    const study = uid();
+    const sent: string[] = [];
+    // the second run starts new writer threads for the storage the first one stopped
+    for (const count of [10, 3]) {
+      const running = await startScp({
+        source: scp, peers: [scu], storagePath, permissive: true,
+        ingestDurability: 'queued', ingestBatchSize: 4, ingestMaxDelay: 1000,
+      });
+      const batch = instances(study, count);
+      const stored = await run(storeScu, { source: scu, target: scp, jsonDatasets: [JSON.stringify(batch.datasets)] });
+      expect(stored.code).toBe(0);
+      const stopped = await running.stop();
+      expect(stopped.code).toBe(0);
+      sent.push(...batch.uids);
+      expect(await instancesOf(storagePath, study)).toEqual([...sent].sort());
+    }
+  } finally {
+    removeStorage(storagePath);
+  }
+}, 30000);
@@ -0,0 +1,67 @@
+import * as fs from 'fs';
+import * as path from 'path';
+import { getScu, storeScu } from '../index';
+import { dataset, importDatasets, node, query, removeStorage, run, startScp, tempStorage, uid } from './util';
+
+const scu = node('SCU');
+const scp = node('PIPESCP', 6);
+
+const STUDY_UID = '0020000D';
+const SOP_INSTANCE_UID = '00080018';
+
+function instances(study: string, count: number): { uids: string[], datasets: any[] } {
+  const series = uid();
+  const uids: string[] = [];
+  const datasets: any[] = [];
+  for (let i = 0; i < count; ++i) {
+    uids.push(uid());
+    datasets.push(dataset({ [STUDY_UID]: ['UI', study], '0020000E': ['UI', series], [SOP_INSTANCE_UID]: ['UI', uids[i]] }));
+  }
+  uids.sort();
+  return { uids, datasets };
+}
+
+function countFiles(directory: string): number {
+  let count = 0;
+  for (const entry of fs.readdirSync(directory, { withFileTypes: true })) {
+    if (entry.isDirectory()) {
+      count += countFiles(path.join(directory, entry.name));
+    } else if (entry.name.endsWith('.dcm')) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// an SCP granting an asynchronous operations window streams the sub-operations of a C-GET while
+// requests of the same peer are pipelined on another association, neither one takes the other's
+// messages for its own. A requestor that may send a C-GET is granted a single outstanding request,
+// so nothing else arrives among the C-STORE responses of its sub-operations
+test('pipelined C-STORE requests interleave with the sub-operations of a C-GET', async () => {
+  const storagePath = tempStorage();
+  const target = tempStorage();
+  const stored = uid();
+  const retrieved = uid();
+  const existing = instances(retrieved, 24);
+  await importDatasets(storagePath, existing.datasets);
+  const running = await startScp({ source: scp, peers: [scu], storagePath, permissive: true, asyncOperations: 8 });
+  try {
+    const sent = instances(stored, 24);
+    const [store, get] = await Promise.all([
+      run(storeScu, { source: scu, target: scp, jsonDatasets: [JSON.stringify(sent.datasets)], asyncOperations: 8 }),
+      run(getScu, { source: scu, target: scp, tags: [{ key: '00080052', value: 'STUDY' }, { key: STUDY_UID, value: retrieved }], storagePath: target }),
+    ]);
+    expect(store.code).toBe(0);
+    expect(get.code).toBe(0);
+    expect(countFiles(target)).toBe(existing.uids.length);
+    expect(await query(storagePath, [
+      { key: '00080052', value: 'IMAGE' },
+      { key: STUDY_UID, value: stored },
+      { key: SOP_INSTANCE_UID, value: '' },
+    ], SOP_INSTANCE_UID)).toEqual(sent.uids);
+  } finally {
+    await running.stop();
+    removeStorage(storagePath);
+    removeStorage(target);
+  }
+}, 30000);
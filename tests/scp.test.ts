@@ -0,0 +1,43 @@
+import { echoScu, findScu } from '../index';
+import { node, removeStorage, run, startScp, tempStorage } from './util';
+
+const scu = node('SCU');
+const scp = node('QRSCP', 1);
+
+test('the SCP serves associations at the same time', async () => {
+  const storagePath = tempStorage();
+  const running = await startScp({ source: scp, peers: [scu], storagePath, permissive: true, maxAssociations: 8 });
+  try {
+    const results = await Promise.all(Array.from({ length: 16 }, () => run(echoScu, { source: scu, target: scp })));
+    for (const result of results) {
+      expect(result.code).toBe(0);
+    }
+  } finally {
+    const stopped = await running.stop();
+    expect(stopped.code).toBe(0);
+    removeStorage(storagePath);
+  }
+});
+
+test('a C-FIND without matches leaves the container null', async () => {
+  const storagePath = tempStorage();
+  const running = await startScp({ source: scp, peers: [scu], storagePath, permissive: true });
+  try {
+    const tags = [{ key: '00080052', value: 'STUDY' }, { key: '0020000D', value: '1.2.3.4.5.6.7.8.9' }];
+    const result = await run(findScu, { source: scu, target: scp, tags });
+    expect(result.code).toBe(0);
+    expect(result.container).toBeNull();
+    // the text form, as in earlier versions
+    const text = await new Promise<any>((resolve) => {
+      findScu({ source: scu, target: scp, tags }, (response: any) => {
+        const parsed = JSON.parse(response);
+        if (parsed.code !== 1) resolve(parsed);
+      });
+    });
+    expect(text.code).toBe(0);
+    expect(text.container).toBeNull();
+  } finally {
+    await running.stop();
+    removeStorage(storagePath);
+  }
+});
@@ -0,0 +1,130 @@
+import { execFileSync } from 'child_process';
+import * as fs from 'fs';
+import * as path from 'path';
+import { echoScu, getMetrics } from '../index';
+import { node, removeStorage, run, RunningScp, startScp, tempStorage } from './util';
+
+const scu = node('SCU');
+const scp = node('TLSSCP', 7);
+
+// a CA of its own, the SCP's certificate issued for localhost and 127.0.0.1, the requestor's for its AE title
+let directory: string;
+let available = true;
+
+function openssl(...args: string[]) {
+  execFileSync('openssl', args, { cwd: directory, stdio: 'ignore' });
+}
+
+function issue(name: string, subject: string, extensions: string) {
+  fs.writeFileSync(path.join(directory, name + '.ext'), extensions);
+  openssl('req', '-newkey', 'rsa:2048', '-nodes', '-subj', subject, '-keyout', name + '.key', '-out', name + '.csr');
+  openssl('x509', '-req', '-in', name + '.csr', '-CA', 'ca.pem', '-CAkey', 'ca.key', '-CAcreateserial', '-days', '1',
+    '-extfile', name + '.ext', '-out', name + '.pem');
+}
+
+function file(name: string): string {
+  return path.join(directory, name);
+}
+
+function client(options: any = {}): any {
+  return {
+    source: scu, target: scp, tls: true, tlsCertificate: file('client.pem'), tlsPrivateKey: file('client.key'),
+    tlsCaCertificates: file('ca.pem'), ...options,
+  };
+}
+
+function server(options: any = {}): any {
+  return {
+    source: scp, peers: [scu], storagePath: directory, permissive: true, tls: true,
+    tlsCertificate: file('server.pem'), tlsPrivateKey: file('server.key'), tlsCaCertificates: file('ca.pem'), ...options,
+  };
+}
+
+function resumed(role: string): number {
+  const series = getMetrics().counters.find((counter) => counter.name === 'tls_handshakes_total' &&
+    counter.labels.role === role && counter.labels.session === 'resumed');
+  return series ? series.value : 0;
+}
+
+beforeAll(async () => {
+  directory = tempStorage();
+  openssl('req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-subj', '/CN=Test CA', '-days', '1', '-keyout', 'ca.key', '-out', 'ca.pem');
+  issue('server', '/CN=localhost', 'subjectAltName=DNS:localhost,IP:127.0.0.1\n');
+  issue('client', '/CN=' + scu.aet, 'extendedKeyUsage=clientAuth\n');
+  // nothing listens yet, a build without TLS refuses the request before connecting
+  const probe = await run(echoScu, client());
+  available = !String(probe.message).includes('not available in this build');
+}, 30000);
+
+afterAll(() => {
+  removeStorage(directory);
+});
+
+describe('an SCP verifying its requestors', () => {
+  let running: RunningScp;
+
+  beforeAll(async () => {
+    if (available) {
+      running = await startScp(server(), client());
+    }
+  }, 30000);
+
+  afterAll(async () => {
+    if (available) {
+      await running.stop();
+    }
+  });
+
+  test('the certificate of the SCP matches the address of the target and tlsServerName', async () => {
+    if (!available) return;
+    expect((await run(echoScu, client())).code).toBe(0);
+    expect((await run(echoScu, client({ tlsServerName: 'localhost' }))).code).toBe(0);
+  }, 30000);
+
+  test('a certificate issued for another host is refused unless tlsVerifyPeer is false', async () => {
+    if (!available) return;
+    expect((await run(echoScu, client({ tlsServerName: 'pacs.example.org' }))).code).toBe(2);
+    expect((await run(echoScu, client({ tlsServerName: '127.0.0.2' }))).code).toBe(2);
+    expect((await run(echoScu, client({ tlsServerName: 'pacs.example.org', tlsVerifyPeer: false }))).code).toBe(0);
+  }, 30000);
+
+  test('requestors without a certificate are refused', async () => {
+    if (!available) return;
+    expect((await run(echoScu, client({ tlsCertificate: undefined, tlsPrivateKey: undefined }))).code).toBe(2);
+  }, 30000);
+
+  test('a new association resumes the TLS session of the previous one', async () => {
+    if (!available) return;
+    expect((await run(echoScu, client())).code).toBe(0);
+    const clientResumed = resumed('client');
+    const serverResumed = resumed('server');
+    expect((await run(echoScu, client())).code).toBe(0);
+    expect((await run(echoScu, client())).code).toBe(0);
+    expect(resumed('client')).toBeGreaterThanOrEqual(clientResumed + 2);
+    expect(resumed('server')).toBeGreaterThanOrEqual(serverResumed + 2);
+  }, 30000);
+});
+
+describe('an SCP accepting any requestor', () => {
+  let running: RunningScp;
+
+  beforeAll(async () => {
+    if (available) {
+      running = await startScp(server({ tlsVerifyPeer: false }), client({ tlsVerifyPeer: false }));
+    }
+  }, 30000);
+
+  afterAll(async () => {
+    if (available) {
+      await running.stop();
+    }
+  });
+
+  test('requestors without a certificate are accepted and still verify the SCP', async () => {
+    if (!available) return;
+    const anonymous = { tlsCertificate: undefined, tlsPrivateKey: undefined };
+    expect((await run(echoScu, client({ ...anonymous, tlsVerifyPeer: false }))).code).toBe(0);
+    expect((await run(echoScu, client(anonymous))).code).toBe(0);
+    expect((await run(echoScu, client({ ...anonymous, tlsServerName: 'pacs.example.org' }))).code).toBe(2);
+  }, 30000);
+});
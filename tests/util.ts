@@ -0,0 +1,91 @@
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+import { echoScu, importJson, queryIndex, startStoreScp, stopScp, KeyValue, Node, Result, ScpHandle, storeScpOptions } from '../index';
+
+// a storage area of its own for each test, removed by the caller
+export function tempStorage(): string {
+  return fs.mkdtempSync(path.join(os.tmpdir(), 'dimse-test-'));
+}
+
+export function removeStorage(storagePath: string) {
+  fs.rmSync(storagePath, { recursive: true, force: true });
+}
+
+let uidCounter = 0;
+
+export function uid(): string {
+  return '1.2.826.0.1.3680043.10.1' + process.pid + '.' + (++uidCounter);
+}
+
+// a minimal secondary capture dataset as DICOM JSON, attributes as tag -> [vr, value]
+export function dataset(attributes: { [tag: string]: [string, string] }): any {
+  const result: any = {
+    '00080016': { vr: 'UI', Value: ['1.2.840.10008.5.1.4.1.1.7'] },
+    '00080060': { vr: 'CS', Value: ['OT'] },
+    '00100020': { vr: 'LO', Value: ['PID'] },
+    '00200010': { vr: 'SH', Value: ['1'] },
+  };
+  for (const tag of Object.keys(attributes)) {
+    const [vr, value] = attributes[tag];
+    result[tag] = vr === 'PN' ? { vr, Value: [{ Alphabetic: value }] } : { vr, Value: [value] };
+  }
+  return result;
+}
+
+// resolves with the final result of a request taking nativeResult
+export function run(start: (options: any, callback: (result: Result) => void) => any, options: any): Promise<Result> {
+  return new Promise((resolve) => {
+    start({ ...options, nativeResult: true }, (result: Result) => {
+      if (result.code !== 1) resolve(result);
+    });
+  });
+}
+
+export async function importDatasets(storagePath: string, datasets: any[]): Promise<Result> {
+  const result = await run(importJson, { storagePath, jsonDatasets: [JSON.stringify(datasets)], parallelism: 1 });
+  expect(result.code).toBe(0);
+  return result;
+}
+
+// the values of tag of the matches of a query on the index of storagePath
+export async function query(storagePath: string, tags: KeyValue[], tag: string): Promise<string[]> {
+  const result = await run(queryIndex, { storagePath, tags });
+  expect(result.code).toBe(0);
+  return ((result.container || []) as any[]).map((match) => match[tag].Value[0]).sort();
+}
+
+// a port per test file, jest runs the files in parallel
+export function node(aet: string, offset: number = 0): Node {
+  return { aet, ip: '127.0.0.1', port: 11112 + (process.pid % 1000) * 8 + offset };
+}
+
+export interface RunningScp {
+  handle: ScpHandle;
+  stopped: Promise<Result>;
+  stop(): Promise<Result>;
+}
+
+// starts an SCP and resolves once it answers a C-ECHO, sent with the network options of probe
+export async function startScp(options: storeScpOptions, probeOptions: any = {}): Promise<RunningScp> {
+  let handle: ScpHandle | undefined;
+  const stopped = new Promise<Result>((resolve) => {
+    handle = startStoreScp({ ...options, nativeResult: true }, (result: Result) => {
+      if (result.code !== 1) resolve(result);
+    });
+  });
+  const probe = { ...probeOptions, source: options.peers[0], target: options.source };
+  for (let attempt = 0; attempt < 50; ++attempt) {
+    const result = await run(echoScu, probe);
+    if (result.code === 0) break;
+    await new Promise((resolve) => setTimeout(resolve, 100));
+  }
+  return {
+    handle: handle!,
+    stopped,
+    stop() {
+      stopScp(handle!, 1000);
+      return stopped;
+    },
+  };
+}